@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  main.cpp
+/// \author Ben Crist
+///
+/// \brief  Mesh Converter entry point; converts OBJ files to the demo's
+///         binary mesh files.
+
+///////////////////////////////////////////////////////////////////////////////
+// skeletal_mesh.cpp refers to GL functions, even though none are called
+// (other compilers are given GLEW by CMakeLists.txt).
+#ifdef _MSC_VER
+#ifdef DEBUG
+#pragma comment (lib, "glew32sd.lib")
+#else
+#pragma comment (lib, "glew32s.lib")
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "mesh_file.h"
+#include "obj_reader.h"
+#include "thread_pool.h"
+#include "vertex_welder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a path with its extension (if any) replaced.
+std::string replaceExtension(const std::string& path, const std::string& extension)
+{
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + extension;
+
+    return path.substr(0, dot) + extension;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts one OBJ file and its weights sidecar to a mesh file next
+///         to it.
+///
+/// \param  weld_pool The threads to weld the mesh's vertices on, or nullptr
+///         to weld them on the calling thread.
+/// \return A line describing the result, for the summary.
+std::string convertFile(const std::string& path, VertexFormat format, ThreadPool* weld_pool)
+{
+    std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+    if (extension == ".fbx" || extension == ".FBX")
+        throw std::runtime_error(path + ": FBX files aren't supported; export the mesh as OBJ instead.");
+
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    readObjMesh(path, replaceExtension(path, ".weights"), vertices, indices);
+    size_t welded = weldVertices(vertices, indices, weld_pool);
+    computeOutlineNormals(vertices, indices);
+
+    std::string output_path = replaceExtension(path, ".skm");
+    MeshOptimizationStats stats;
+    saveMeshFile(vertices, indices, format, output_path, &stats);
+
+    std::ostringstream result;
+    result << path << " -> " << output_path << ": "
+           << vertices.size() << " vertices (" << welded << " welded), " << indices.size() / 3 << " triangles, ACMR "
+           << stats.acmr_before << " -> " << stats.acmr_after;
+    return result.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the command line usage to stderr.
+void printUsage()
+{
+    std::cerr << "Usage: MeshConverter [-format full|packed|half|quantized] [-jobs N] file.obj..." << std::endl << std::endl
+              << "Converts each OBJ file, plus the joint weights in the .weights file" << std::endl
+              << "next to it, to a .skm mesh file which SkinningDemo can load." << std::endl << std::endl
+              << "  -format  The vertex format to store (default: half)." << std::endl
+              << "  -jobs    The number of files to convert at once (default: one per" << std::endl
+              << "           hardware thread)." << std::endl;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses the command line, then converts every file given, several
+///         at a time.
+///
+/// \details A file which fails to convert doesn't stop the others.  The
+///         exit code is the number of files which failed.
+int main(int argc, char** argv)
+{
+    VertexFormat format = VERTEX_FORMAT_PACKED_HALF;
+    size_t jobs = 0;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-format" && i + 1 < argc)
+        {
+            std::string name = argv[++i];
+            if (name == "full")
+                format = VERTEX_FORMAT_FULL;
+            else if (name == "packed")
+                format = VERTEX_FORMAT_PACKED;
+            else if (name == "half")
+                format = VERTEX_FORMAT_PACKED_HALF;
+            else if (name == "quantized")
+                format = VERTEX_FORMAT_QUANTIZED;
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        else if (arg == "-jobs" && i + 1 < argc)
+            jobs = size_t(std::atoi(argv[++i]));
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            printUsage();
+            return 1;
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    if (paths.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    // each file is independent, so they're spread across a thread pool.  The
+    // results are collected and printed afterwards so they don't interleave.
+    // A pool only runs one batch at a time, so a single file has the pool
+    // to itself for welding instead.
+    std::vector<std::string> results(paths.size());
+    std::vector<char> failed(paths.size(), 0);
+
+    ThreadPool thread_pool(jobs);
+    ThreadPool* weld_pool = paths.size() == 1 ? &thread_pool : nullptr;
+    std::function<void(size_t)> convert = [&](size_t i)
+    {
+        try
+        {
+            results[i] = convertFile(paths[i], format, weld_pool);
+        }
+        catch (const std::exception& e)
+        {
+            results[i] = e.what();
+            failed[i] = 1;
+        }
+    };
+    if (weld_pool != nullptr)
+        convert(0);
+    else
+        thread_pool.parallelFor(paths.size(), convert);
+
+    int failures = 0;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        if (failed[i])
+        {
+            std::cerr << "Error: " << results[i] << std::endl;
+            ++failures;
+        }
+        else
+            std::cout << results[i] << std::endl;
+    }
+
+    return failures;
+}
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  obj_reader.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of OBJ reading functions.
+
+#include "obj_reader.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The joints and weights of one OBJ position, from the weights
+///         sidecar file.
+struct Influences
+{
+    GLuint joint_indices[MAX_JOINT_INFLUENCES];
+    GLfloat joint_weights[MAX_JOINT_INFLUENCES];
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Throws an exception describing a problem on a line of a file.
+void parseError(const std::string& path, size_t line_number, const std::string& problem)
+{
+    std::ostringstream message;
+    message << path << '(' << line_number << "): " << problem;
+    throw std::runtime_error(message.str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a line starts with a keyword followed by
+///         whitespace, and advances the pointer past the keyword.
+bool consumeKeyword(const char*& line, const char* keyword)
+{
+    size_t length = std::strlen(keyword);
+    if (std::strncmp(line, keyword, length) != 0 || (line[length] != ' ' && line[length] != '\t'))
+        return false;
+
+    line += length;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads the weights sidecar of an OBJ file.
+///
+/// \details Each line of the form "w j0 w0 [j1 w1 [j2 w2 [j3 w3]]]" gives the
+///         joints and weights of the next OBJ position, in the same order as
+///         the OBJ's "v" lines.  Blank lines and lines starting with # are
+///         ignored.  Weights are normalized by the shaders' packing step, so
+///         they don't need to sum to exactly 1.
+void readWeights(const std::string& path, std::vector<Influences>& influences)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+        throw std::runtime_error(path + ": The weights file couldn't be opened.");
+
+    std::string line;
+    for (size_t line_number = 1; std::getline(file, line); ++line_number)
+    {
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+
+        const char* cursor = line.c_str();
+        if (!consumeKeyword(cursor, "w"))
+            continue;
+
+        Influences vertex_influences;
+        size_t count = 0;
+        for (; count < MAX_JOINT_INFLUENCES; ++count)
+        {
+            char* end;
+            long joint = std::strtol(cursor, &end, 10);
+            if (end == cursor)
+                break;
+            cursor = end;
+
+            double weight = std::strtod(cursor, &end);
+            if (end == cursor || joint < 0)
+                parseError(path, line_number, "Expected a joint index and weight.");
+            cursor = end;
+
+            vertex_influences.joint_indices[count] = GLuint(joint);
+            vertex_influences.joint_weights[count] = GLfloat(weight);
+        }
+
+        if (count == 0)
+            parseError(path, line_number, "A vertex must have at least one influence.");
+
+        for (; count < MAX_JOINT_INFLUENCES; ++count)
+        {
+            vertex_influences.joint_indices[count] = 0;
+            vertex_influences.joint_weights[count] = 0.0f;
+        }
+
+        influences.push_back(vertex_influences);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses one vertex reference of an OBJ face ("v", "v/vt",
+///         "v/vt/vn" or "v//vn"), and returns the zero-based position index.
+///         Negative indices count back from the last position read.
+bool parseFaceVertex(const char*& cursor, size_t position_count, size_t& position)
+{
+    char* end;
+    long index = std::strtol(cursor, &end, 10);
+    if (end == cursor)
+        return false;
+
+    // skip the texture coordinate and normal indices; they aren't used.
+    cursor = end;
+    while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t')
+        ++cursor;
+
+    if (index < 0)
+        index += long(position_count) + 1;
+
+    position = size_t(index - 1);
+    return index > 0;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a skinned mesh from an OBJ file and its weights sidecar.
+///
+/// \details The OBJ is streamed a line at a time, so the memory used is
+///         proportional to the mesh's positions and output, not to the size
+///         of the file.  Only "v" and "f" lines are used.  The demo is 2D, so
+///         the z coordinate of each position is ignored, and so are texture
+///         coordinates and normals.
+///
+///         Faces with more than 3 vertices are triangulated as fans.
+///         Vertices are numbered in the order the faces first use them,
+///         which keeps the vertex fetches of nearby triangles close
+///         together.  Positions which end up with identical coordinates
+///         and influences (typically exported separately because of their
+///         texture coordinates or normals) are each still a vertex of
+///         their own; weldVertices() merges them.
+///
+///         Any problem with the files throws an exception whose message
+///         contains the file and line.
+///
+/// \param  obj_path The OBJ file to read.
+/// \param  weights_path The weights sidecar file; see readWeights().
+/// \param  vertices Receives the vertices of the mesh, one per position
+///         the faces use.
+/// \param  indices Receives the indices of the mesh's triangles.
+void readObjMesh(const std::string& obj_path,
+                 const std::string& weights_path,
+                 std::vector<Vertex>& vertices,
+                 std::vector<GLuint>& indices)
+{
+    std::vector<Influences> influences;
+    readWeights(weights_path, influences);
+
+    std::ifstream file(obj_path.c_str());
+    if (!file)
+        throw std::runtime_error(obj_path + ": The file couldn't be opened.");
+
+    vertices.clear();
+    indices.clear();
+
+    std::vector<vec2> positions;
+    std::vector<int> vertex_index;   // the output vertex of each position, or -1
+
+    std::string line;
+    std::vector<GLuint> face;
+    for (size_t line_number = 1; std::getline(file, line); ++line_number)
+    {
+        // files written on Windows keep their \r when read elsewhere.
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+
+        const char* cursor = line.c_str();
+        if (consumeKeyword(cursor, "v"))
+        {
+            char* x_end;
+            char* y_end;
+            float x = float(std::strtod(cursor, &x_end));
+            float y = float(std::strtod(x_end, &y_end));
+            if (x_end == cursor || y_end == x_end)
+                parseError(obj_path, line_number, "Expected a position.");
+
+            positions.push_back(vec2(x, y));
+            vertex_index.push_back(-1);
+        }
+        else if (consumeKeyword(cursor, "f"))
+        {
+            face.clear();
+            size_t position;
+            while (*cursor == ' ' || *cursor == '\t')
+                ++cursor;
+
+            while (*cursor != '\0')
+            {
+                if (!parseFaceVertex(cursor, positions.size(), position) || position >= positions.size())
+                    parseError(obj_path, line_number, "Invalid face vertex.");
+                if (position >= influences.size())
+                    parseError(obj_path, line_number, "The weights file has no weights for this vertex.");
+
+                if (vertex_index[position] < 0)
+                {
+                    Vertex vertex;
+                    vertex.position = positions[position];
+                    std::memcpy(vertex.joint_indices, influences[position].joint_indices, sizeof(vertex.joint_indices));
+                    std::memcpy(vertex.joint_weights, influences[position].joint_weights, sizeof(vertex.joint_weights));
+
+                    vertex_index[position] = int(vertices.size());
+                    vertices.push_back(vertex);
+                }
+
+                face.push_back(GLuint(vertex_index[position]));
+
+                while (*cursor == ' ' || *cursor == '\t')
+                    ++cursor;
+            }
+
+            if (face.size() < 3)
+                parseError(obj_path, line_number, "A face needs at least 3 vertices.");
+
+            for (size_t i = 2; i < face.size(); ++i)
+            {
+                indices.push_back(face[0]);
+                indices.push_back(face[i - 1]);
+                indices.push_back(face[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,20 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  obj_reader.h
+/// \author Ben Crist
+///
+/// \brief  Functions for reading skinned meshes from OBJ files.
+
+#ifndef OBJ_READER_H_
+#define OBJ_READER_H_
+
+#include "skeletal_mesh.h"
+#include <string>
+#include <vector>
+
+void readObjMesh(const std::string& obj_path,
+                 const std::string& weights_path,
+                 std::vector<Vertex>& vertices,
+                 std::vector<GLuint>& indices);
+
+#endif
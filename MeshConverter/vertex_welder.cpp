@@ -0,0 +1,218 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  vertex_welder.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementation of the vertex welding function.
+
+#include "vertex_welder.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+
+namespace {
+
+const GLuint EMPTY_SLOT = GLuint(-1);
+const size_t CHUNK_SIZE = 16384;    ///< Vertices per parallel task.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs a function over the chunks of a range, across a thread pool
+///         if there is one, or on the calling thread if not.
+///
+/// \param  count The size of the range.
+/// \param  body Called with the start and end of each chunk.
+void forEachChunk(ThreadPool* thread_pool, size_t count, const std::function<void(size_t, size_t)>& body)
+{
+    size_t chunk_count = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (thread_pool == nullptr || chunk_count < 2)
+    {
+        body(0, count);
+        return;
+    }
+
+    thread_pool->parallelFor(chunk_count, [&](size_t chunk)
+    {
+        size_t begin = chunk * CHUNK_SIZE;
+        body(begin, std::min(begin + CHUNK_SIZE, count));
+    });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two vertices have exactly the same bits.
+bool isSameVertex(const Vertex& a, const Vertex& b)
+{
+    return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Hashes the bits of a vertex.
+///
+/// \details Every field of a Vertex is 4 bytes, so it has no padding, and
+///         its words can be mixed in directly.
+size_t hashVertex(const Vertex& vertex)
+{
+    GLuint words[sizeof(Vertex) / sizeof(GLuint)];
+    std::memcpy(words, &vertex, sizeof(Vertex));
+
+    unsigned long long hash = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < sizeof(Vertex) / sizeof(GLuint); ++i)
+    {
+        hash ^= words[i];
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+    return size_t(hash);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An open-addressing hash set of vertices, which any number of
+///         threads can insert into at once without locking.
+///
+/// \details Each slot holds the index of a vertex, or EMPTY_SLOT, and is
+///         only ever written with a compare-and-swap: an empty slot is
+///         claimed by the first vertex to reach it, and after that only
+///         replaced by an identical vertex with a lower index.  A slot
+///         never goes back to empty or changes to a different vertex, so
+///         identical vertices always probe to the same slot, however their
+///         inserts interleave, and once they've all been inserted it holds
+///         the first of them.
+class VertexHashSet
+{
+public:
+    VertexHashSet(const std::vector<Vertex>& vertices);
+
+    void insert(GLuint vertex);
+    GLuint find(GLuint vertex) const;
+
+private:
+    VertexHashSet(const VertexHashSet&);            // non-copyable
+    VertexHashSet& operator=(const VertexHashSet&); // non-copyable
+
+    const std::vector<Vertex>& vertices_;
+    std::unique_ptr<std::atomic<GLuint>[]> slots_;
+    size_t mask_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty set with room for all of the vertices, at most
+///         half full.
+VertexHashSet::VertexHashSet(const std::vector<Vertex>& vertices)
+    : vertices_(vertices)
+{
+    size_t capacity = 16;
+    while (capacity < vertices.size() * 2)
+        capacity *= 2;
+
+    slots_.reset(new std::atomic<GLuint>[capacity]);
+    for (size_t i = 0; i < capacity; ++i)
+        slots_[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+    mask_ = capacity - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a vertex, or if an identical one is already in the set,
+///         keeps whichever of them has the lower index.
+void VertexHashSet::insert(GLuint vertex)
+{
+    const Vertex& value = vertices_[vertex];
+    for (size_t slot = hashVertex(value) & mask_; ; slot = (slot + 1) & mask_)
+    {
+        GLuint occupant = slots_[slot].load(std::memory_order_acquire);
+        if (occupant == EMPTY_SLOT)
+        {
+            if (slots_[slot].compare_exchange_strong(occupant, vertex, std::memory_order_acq_rel))
+                return;
+            // another vertex claimed the slot first; occupant now holds it.
+        }
+
+        if (!isSameVertex(vertices_[occupant], value))
+            continue;
+
+        while (vertex < occupant &&
+               !slots_[slot].compare_exchange_weak(occupant, vertex, std::memory_order_acq_rel))
+        {
+        }
+        return;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the index of the vertex in the set identical to one which
+///         was inserted.
+GLuint VertexHashSet::find(GLuint vertex) const
+{
+    const Vertex& value = vertices_[vertex];
+    for (size_t slot = hashVertex(value) & mask_; ; slot = (slot + 1) & mask_)
+    {
+        GLuint occupant = slots_[slot].load(std::memory_order_acquire);
+        if (isSameVertex(vertices_[occupant], value))
+            return occupant;
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Merges the vertices of a mesh which have exactly the same
+///         position, influences, normal and tangent, and points the
+///         triangles at the merged vertices.
+///
+/// \details The vertices are hashed into a VertexHashSet from every thread
+///         at once, then each looks up the first vertex identical to it.
+///         Only numbering the surviving vertices is serial, and it's a
+///         single pass.  The first of each set of identical vertices is the
+///         one kept, and the survivors stay in their order, so the result
+///         is the same however many threads there are, and a mesh whose
+///         vertices were numbered in the order its triangles use them still
+///         is.
+///
+/// \param  vertices The mesh's vertices; receives the unique ones.
+/// \param  indices The indices of the mesh's triangles; remapped onto the
+///         unique vertices.
+/// \param  thread_pool The threads to weld on, or nullptr to do it all on
+///         the calling thread.
+/// \return The number of vertices which were merged away.
+size_t weldVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, ThreadPool* thread_pool)
+{
+    size_t vertex_count = vertices.size();
+    VertexHashSet unique_vertices(vertices);
+    forEachChunk(thread_pool, vertex_count, [&](size_t begin, size_t end)
+    {
+        for (size_t v = begin; v < end; ++v)
+            unique_vertices.insert(GLuint(v));
+    });
+
+    std::vector<GLuint> remap(vertex_count);
+    forEachChunk(thread_pool, vertex_count, [&](size_t begin, size_t end)
+    {
+        for (size_t v = begin; v < end; ++v)
+            remap[v] = unique_vertices.find(GLuint(v));
+    });
+
+    // the first of each set of identical vertices comes before the rest, so
+    // it has its new index by the time they look it up.
+    size_t unique_count = 0;
+    for (size_t v = 0; v < vertex_count; ++v)
+    {
+        if (remap[v] == v)
+        {
+            vertices[unique_count] = vertices[v];
+            remap[v] = GLuint(unique_count++);
+        }
+        else
+            remap[v] = remap[remap[v]];
+    }
+    vertices.resize(unique_count);
+
+    forEachChunk(thread_pool, indices.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            indices[i] = remap[indices[i]];
+    });
+
+    return vertex_count - unique_count;
+}
@@ -0,0 +1,19 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  vertex_welder.h
+/// \author Ben Crist
+///
+/// \brief  The function which merges a mesh's identical vertices, in
+///         parallel.
+
+#ifndef VERTEX_WELDER_H_
+#define VERTEX_WELDER_H_
+
+#include "skeletal_mesh.h"
+#include <vector>
+
+class ThreadPool;
+
+size_t weldVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, ThreadPool* thread_pool);
+
+#endif
@@ -0,0 +1,747 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  kernel_benchmarks.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the CPU kernel microbenchmarks.
+///
+/// \details Each kernel is one stage of the per-frame CPU work: building
+///         local transforms from a pose, flattening the hierarchy, blending
+///         poses (and, as a 3D rig would, their rotations as quaternions),
+///         retargeting them to a rig of other proportions, precombining the
+///         inverse bind transforms, and converting the palette to dual
+///         quaternions.  Where the demo has more than one implementation of
+///         a stage, each is timed separately so they can be compared on the
+///         same data:
+///
+///         - "scalar" is plain GLM, one joint at a time.
+///         - "sse2" is the demo's own intrinsics (computeLocalTransforms(),
+///           blendPoses() and nlerpQuats()).
+///         - "glm_simd" is GLM's experimental simdMat4, including the cost
+///           of converting to and from mat4, since that's what switching the
+///           demo over to it would cost.
+///         - "simd_math" is the demo's simd_math.h, which the hierarchy
+///           pass, the palette and CPU picking are built on: the same SSE2
+///           arithmetic as simdMat4, straight on mat4s.  The "affine_inverse",
+///           "transform_vec4" and "batch_lerp" kernels time its other
+///           operations against plain GLM, on the transforms.
+///         - "levels" and "levels_mt" are HierarchyLevels, without and with
+///           a ThreadPool, including the cost of copying the local
+///           transforms into place, since it works in place.
+///         - "affine_2d" is the same stage on Affine2D rather than mat4, as
+///           the demo's joint transform cache and AFFINE_2D mode do it.
+///         - "fixed" and "affine_2d_fixed" are SkeletonEval, compiled for
+///           the synthetic rig, so the hierarchy pass is unrolled with its
+///           parents as constants.  Only 7 and 32 joint rigs are compiled;
+///           other joint counts skip them.
+///         - "complex" keeps rotations as unit complex numbers instead of
+///           angles or quaternions, so local transforms need no trig.
+///         - "libm" and "fast" compare the C library's sin and cos with
+///           sinCosDegrees(), which every angle-based path now uses.
+///         - "precomputed" is RetargetMap, which carries poses over to a
+///           rig of other proportions with a scale and offset per channel
+///           worked out once, against "scalar" working them out from the
+///           two bind poses for every joint of every pose.
+///         - "encode" and "decode" are the two halves of PoseEncoder and
+///           PoseDecoder.  Each slot's pose is a delta from the previous
+///           slot's, which is the next frame of the same animation, as if
+///           every packet were acknowledged before the next was sent.
+///
+///         The synthetic rig is a single chain, which HierarchyLevels can't
+///         do anything with, so "hierarchy_strands" flattens the same local
+///         transforms through a wide, shallow hierarchy of short strands
+///         instead.  Its levels only get big enough to be split across
+///         threads with thousands of joints.
+///
+///         Every sample is timed as a whole sweep over the instances, and
+///         reported as nanoseconds per joint processed.
+
+#include "kernel_benchmarks.h"
+#include "affine_2d.h"
+#include "hierarchy_levels.h"
+#include "joint_rotation.h"
+#include "palette.h"
+#include "pose.h"
+#include "pose_codec.h"
+#include "profiler.h"
+#include "retarget_map.h"
+#include "simd_math.h"
+#include "skeleton.h"
+#include "skeleton_eval.h"
+#include "synthetic_rig.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+// GLM 0.9.4's simd extension only knows how to align its types for MSVC
+// and the versions of GCC it was released alongside.
+#if (GLM_ARCH & GLM_ARCH_SSE2) && ((GLM_COMPILER & GLM_COMPILER_VC) || (GLM_COMPILER >= GLM_COMPILER_GCC31))
+#define KERNEL_BENCHMARKS_GLM_SIMD
+#include <glm/gtx/simd_mat4.hpp>
+#endif
+
+namespace {
+
+const size_t SAMPLE_COUNT = 15;                 ///< The number of timed samples per configuration.
+const size_t MIN_JOINTS_PER_SAMPLE = 1 << 18;   ///< Enough work per sample that the timer's resolution doesn't matter.
+const size_t MAX_SLOT_JOINTS = 1 << 19;         ///< The most joints' worth of distinct data to allocate per configuration.
+const size_t FLUSH_SIZE = 64 << 20;             ///< Bigger than any last level cache, so writing it evicts everything.
+const size_t STRAND_LENGTH = 8;                 ///< The joints in each chain of the strands skeleton.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The input and output data for every kernel, with one separate
+///         copy (a "slot") per instance.
+///
+/// \details Each slot has its own poses, transforms and palette, so an
+///         instance never reads data that the previous instance left in the
+///         cache.  The blend target and inverse bind transforms are shared,
+///         as they would be by a crowd playing the same animation.
+struct KernelData
+{
+    KernelData(size_t joint_count, size_t slot_count);
+    ~KernelData();
+
+    Skeleton skeleton;
+    Skeleton strands;                           ///< The same number of joints, in short chains off one root.
+    size_t joint_count;
+    size_t slot_count;
+
+    Pose bind_pose;
+    Pose retarget_bind_pose;                    ///< bind_pose with longer bones, and turned, to retarget the sources to.
+    std::unique_ptr<RetargetMap> retarget_map;  ///< From bind_pose to retarget_bind_pose.
+    Pose target;                                ///< The pose every slot's source is blended toward.
+    std::vector<Pose> sources;                  ///< Each slot's input pose.
+    std::vector<Pose> outputs;                  ///< Each slot's blended pose.
+    std::vector<int> parents;                   ///< The parent of each joint, copied out of the skeleton.
+    std::vector<int> strand_parents;            ///< The parent of each joint of strands.
+    std::unique_ptr<HierarchyLevels> levels;
+    std::unique_ptr<HierarchyLevels> strand_levels;
+    ThreadPool thread_pool;
+
+    std::vector<mat4> locals;                   ///< slot_count * joint_count local transforms.
+    std::vector<mat4> transforms;               ///< slot_count * joint_count model-space transforms.
+    std::vector<mat4> palettes;                 ///< slot_count * joint_count skinning matrices.
+    std::vector<vec4> points;                   ///< slot_count * joint_count transformed points.
+    std::vector<DualQuat> dual_quats;
+    std::vector<float> scales;
+
+    std::vector<Affine2D> local_affines;        ///< slot_count * joint_count local transforms, as Affine2D.
+    std::vector<Affine2D> affine_transforms;    ///< slot_count * joint_count model-space transforms, as Affine2D.
+    std::vector<Affine2D> affine_palettes;      ///< slot_count * joint_count skinning transforms, as Affine2D.
+
+    std::vector<glm::quat> target_rotations;    ///< target's rotations as quaternions.
+    std::vector<glm::quat> source_rotations;    ///< Each slot's source rotations as quaternions.
+    std::vector<glm::quat> output_rotations;    ///< Each slot's blended rotations.
+    std::vector<vec2> target_complexes;         ///< target's rotations as unit complex numbers.
+    std::vector<vec2> source_complexes;         ///< Each slot's source rotations as unit complex numbers.
+    std::vector<vec2> output_complexes;         ///< Each slot's blended complex rotations.
+    std::vector<float> sines;                   ///< slot_count * joint_count sines of the source rotations.
+    std::vector<float> cosines;                 ///< slot_count * joint_count cosines of the source rotations.
+
+    PoseEncoder encoder;
+    PoseDecoder decoder;
+    std::vector<std::vector<unsigned char> > packets;   ///< Each slot's source, encoded as a delta from the previous slot's.
+    std::vector<unsigned char> packet;                  ///< Scratch space for the encode kernel.
+    size_t packet_bytes;                                ///< The total size of packets.
+
+private:
+    KernelData(const KernelData&);              // non-copyable
+    KernelData& operator=(const KernelData&);   // non-copyable
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates and fills in every slot's data, so each kernel's
+///         inputs are valid whichever order the kernels are run in.
+KernelData::KernelData(size_t joint_count, size_t slot_count)
+    : joint_count(joint_count),
+      slot_count(slot_count),
+      locals(joint_count * slot_count),
+      transforms(joint_count * slot_count),
+      palettes(joint_count * slot_count),
+      points(joint_count * slot_count),
+      dual_quats(joint_count * slot_count),
+      scales(joint_count * slot_count),
+      local_affines(joint_count * slot_count),
+      affine_transforms(joint_count * slot_count),
+      affine_palettes(joint_count * slot_count),
+      target_rotations(joint_count),
+      source_rotations(joint_count * slot_count),
+      output_rotations(joint_count * slot_count),
+      target_complexes(joint_count),
+      source_complexes(joint_count * slot_count),
+      output_complexes(joint_count * slot_count),
+      sines(joint_count * slot_count),
+      cosines(joint_count * slot_count),
+      encoder(joint_count),
+      decoder(joint_count),
+      packets(slot_count),
+      packet_bytes(0)
+{
+    buildSyntheticSkeleton(skeleton, joint_count);
+    buildSyntheticStrands(strands, joint_count, STRAND_LENGTH);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        parents.push_back(skeleton.getParent(joint));
+        strand_parents.push_back(strands.getParent(joint));
+    }
+    levels.reset(new HierarchyLevels(skeleton));
+    strand_levels.reset(new HierarchyLevels(strands));
+
+    bind_pose = skeleton.allocatePose();
+    setSyntheticBindPose(bind_pose);
+    skeleton.setBindPose(bind_pose);
+
+    retarget_bind_pose = skeleton.allocatePose();
+    copyPose(bind_pose, retarget_bind_pose);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        retarget_bind_pose.translation[joint] *= 1.5f;
+        retarget_bind_pose.rotation[joint] += 10.0f;
+    }
+    retarget_map.reset(new RetargetMap(bind_pose, retarget_bind_pose));
+
+    target = skeleton.allocatePose();
+    animateSyntheticPose(bind_pose, 50, target);
+    rotationsToQuats(target.rotation, joint_count, &target_rotations[0]);
+    rotationsToComplexes(target.rotation, joint_count, &target_complexes[0]);
+
+    for (size_t slot = 0; slot < slot_count; ++slot)
+    {
+        sources.push_back(skeleton.allocatePose());
+        outputs.push_back(skeleton.allocatePose());
+        animateSyntheticPose(bind_pose, slot, sources.back());
+        copyPose(sources.back(), outputs.back());
+        rotationsToQuats(sources.back().rotation, joint_count, &source_rotations[slot * joint_count]);
+        rotationsToComplexes(sources.back().rotation, joint_count, &source_complexes[slot * joint_count]);
+
+        mat4* slot_transforms = &transforms[slot * joint_count];
+        skeleton.computeJointTransforms(sources.back(), slot_transforms);
+        computeLocalTransforms(sources.back(), &locals[slot * joint_count]);
+        computeSkinningPalette(slot_transforms, skeleton.getInverseBindTransforms(), joint_count,
+                               &palettes[slot * joint_count]);
+
+        Affine2D* slot_affines = &affine_transforms[slot * joint_count];
+        skeleton.computeJointAffines(sources.back(), slot_affines);
+        computeLocalAffines(sources.back(), &local_affines[slot * joint_count]);
+        computeAffinePalette(slot_affines, skeleton.getInverseBindAffines(), joint_count,
+                             &affine_palettes[slot * joint_count]);
+
+        encoder.acknowledge(encoder.encode(sources.back(), packets[slot]));
+        packet_bytes += packets[slot].size();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns every pose to the skeleton's pool.
+KernelData::~KernelData()
+{
+    for (size_t slot = 0; slot < slot_count; ++slot)
+    {
+        skeleton.releasePose(sources[slot]);
+        skeleton.releasePose(outputs[slot]);
+    }
+    skeleton.releasePose(target);
+    skeleton.releasePose(retarget_bind_pose);
+    skeleton.releasePose(bind_pose);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Kernels.  Each processes a single slot.
+
+void localTransformsScalar(KernelData& data, size_t slot)
+{
+    const Pose& pose = data.sources[slot];
+    mat4* locals = &data.locals[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+        locals[joint] = getJointLocalTransform(pose, joint);
+}
+
+void localTransformsAffine(KernelData& data, size_t slot)
+{
+    computeLocalAffines(data.sources[slot], &data.local_affines[slot * data.joint_count]);
+}
+
+void localTransformsComplex(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    computeLocalAffines(data.sources[slot], &data.source_complexes[offset], &data.local_affines[offset]);
+}
+
+void sinCosLibm(KernelData& data, size_t slot)
+{
+    const float* degrees = data.sources[slot].rotation;
+    float* sines = &data.sines[slot * data.joint_count];
+    float* cosines = &data.cosines[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        float radians = glm::radians(degrees[joint]);
+        sines[joint] = std::sin(radians);
+        cosines[joint] = std::cos(radians);
+    }
+}
+
+void sinCosFast(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    sinCosDegrees(data.sources[slot].rotation, data.joint_count, &data.sines[offset], &data.cosines[offset]);
+}
+
+void hierarchyScalar(KernelData& data, size_t slot)
+{
+    const mat4* locals = &data.locals[slot * data.joint_count];
+    mat4* transforms = &data.transforms[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        int parent = data.parents[joint];
+        transforms[joint] = parent == Skeleton::NO_PARENT ? locals[joint] : transforms[parent] * locals[joint];
+    }
+}
+
+void hierarchyAffine(KernelData& data, size_t slot)
+{
+    const Affine2D* locals = &data.local_affines[slot * data.joint_count];
+    Affine2D* transforms = &data.affine_transforms[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        int parent = data.parents[joint];
+        transforms[joint] = parent == Skeleton::NO_PARENT ? locals[joint] : composeAffine(transforms[parent], locals[joint]);
+    }
+}
+
+template <size_t N>
+void hierarchyFixed(KernelData& data, size_t slot)
+{
+    SkeletonEval<SyntheticChainRig<N> >::flattenTransforms(&data.locals[slot * N], &data.transforms[slot * N]);
+}
+
+template <size_t N>
+void hierarchyFixedAffine(KernelData& data, size_t slot)
+{
+    SkeletonEval<SyntheticChainRig<N> >::flattenAffines(&data.local_affines[slot * N], &data.affine_transforms[slot * N]);
+}
+
+void hierarchyLevels(KernelData& data, size_t slot)
+{
+    mat4* transforms = &data.transforms[slot * data.joint_count];
+    std::copy(&data.locals[slot * data.joint_count], &data.locals[slot * data.joint_count] + data.joint_count, transforms);
+    data.levels->evaluate(transforms);
+}
+
+void hierarchyStrandsScalar(KernelData& data, size_t slot)
+{
+    const mat4* locals = &data.locals[slot * data.joint_count];
+    mat4* transforms = &data.transforms[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        int parent = data.strand_parents[joint];
+        transforms[joint] = parent == Skeleton::NO_PARENT ? locals[joint] : transforms[parent] * locals[joint];
+    }
+}
+
+void hierarchyStrandsLevels(KernelData& data, size_t slot)
+{
+    mat4* transforms = &data.transforms[slot * data.joint_count];
+    std::copy(&data.locals[slot * data.joint_count], &data.locals[slot * data.joint_count] + data.joint_count, transforms);
+    data.strand_levels->evaluate(transforms);
+}
+
+void hierarchyStrandsLevelsThreaded(KernelData& data, size_t slot)
+{
+    mat4* transforms = &data.transforms[slot * data.joint_count];
+    std::copy(&data.locals[slot * data.joint_count], &data.locals[slot * data.joint_count] + data.joint_count, transforms);
+    data.strand_levels->evaluate(transforms, &data.thread_pool);
+}
+
+void blendScalar(KernelData& data, size_t slot)
+{
+    const Pose& a = data.sources[slot];
+    const Pose& b = data.target;
+    Pose& out = data.outputs[slot];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        out.translation[joint] = glm::mix(a.translation[joint], b.translation[joint], 0.5f);
+        out.rotation[joint] = lerpAngle(a.rotation[joint], b.rotation[joint], 0.5f);
+        out.scale[joint] = glm::mix(a.scale[joint], b.scale[joint], 0.5f);
+    }
+}
+
+void retargetScalar(KernelData& data, size_t slot)
+{
+    const Pose& source = data.sources[slot];
+    const Pose& source_bind = data.bind_pose;
+    const Pose& target_bind = data.retarget_bind_pose;
+    Pose& out = data.outputs[slot];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        float source_length = glm::length(source_bind.translation[joint]);
+        float stretch = source_length > 0 ? glm::length(target_bind.translation[joint]) / source_length : 1.0f;
+        out.translation[joint] = target_bind.translation[joint] +
+                                 (source.translation[joint] - source_bind.translation[joint]) * stretch;
+        out.rotation[joint] = target_bind.rotation[joint] + (source.rotation[joint] - source_bind.rotation[joint]);
+        out.scale[joint] = source.scale[joint] * target_bind.scale[joint] / source_bind.scale[joint];
+    }
+}
+
+void retargetPrecomputed(KernelData& data, size_t slot)
+{
+    data.retarget_map->apply(data.sources[slot], data.outputs[slot]);
+}
+
+void nlerpScalar(KernelData& data, size_t slot)
+{
+    const glm::quat* a = &data.source_rotations[slot * data.joint_count];
+    glm::quat* out = &data.output_rotations[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+        out[joint] = nlerp(a[joint], data.target_rotations[joint], 0.5f);
+}
+
+void paletteScalar(KernelData& data, size_t slot)
+{
+    const mat4* transforms = &data.transforms[slot * data.joint_count];
+    const mat4* inverse_binds = data.skeleton.getInverseBindTransforms();
+    mat4* palette = &data.palettes[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+        palette[joint] = transforms[joint] * inverse_binds[joint];
+}
+
+void paletteSimdMath(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    computeSkinningPalette(&data.transforms[offset], data.skeleton.getInverseBindTransforms(), data.joint_count,
+                           &data.palettes[offset]);
+}
+
+void hierarchySimdMath(KernelData& data, size_t slot)
+{
+    const mat4* locals = &data.locals[slot * data.joint_count];
+    mat4* transforms = &data.transforms[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        int parent = data.parents[joint];
+        transforms[joint] = parent == Skeleton::NO_PARENT ? locals[joint]
+                                                          : multiplyMatrices(transforms[parent], locals[joint]);
+    }
+}
+
+void affineInverseScalar(KernelData& data, size_t slot)
+{
+    const mat4* transforms = &data.transforms[slot * data.joint_count];
+    mat4* inverses = &data.palettes[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+        inverses[joint] = inverseJointTransform(transforms[joint]);
+}
+
+void affineInverseSimdMath(KernelData& data, size_t slot)
+{
+    const mat4* transforms = &data.transforms[slot * data.joint_count];
+    mat4* inverses = &data.palettes[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+        inverses[joint] = invertJointTransform(transforms[joint]);
+}
+
+// each joint's transform takes its local translation, as a point.
+void transformScalar(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+        data.points[offset + joint] = data.transforms[offset + joint] * data.locals[offset + joint][3];
+}
+
+void transformSimdMath(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+        data.points[offset + joint] = transformVector(data.transforms[offset + joint], data.locals[offset + joint][3]);
+}
+
+// halfway from each joint's local transform to its model-space transform.
+void batchLerpScalar(KernelData& data, size_t slot)
+{
+    const float* a = &data.locals[slot * data.joint_count][0][0];
+    const float* b = &data.transforms[slot * data.joint_count][0][0];
+    float* out = &data.palettes[slot * data.joint_count][0][0];
+    for (size_t i = 0; i < data.joint_count * 16; ++i)
+        out[i] = glm::mix(a[i], b[i], 0.5f);
+}
+
+void batchLerpSimdMath(KernelData& data, size_t slot)
+{
+    lerpFloats(&data.locals[slot * data.joint_count][0][0], &data.transforms[slot * data.joint_count][0][0], 0.5f,
+               &data.palettes[slot * data.joint_count][0][0], data.joint_count * 16);
+}
+
+void paletteAffine(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    computeAffinePalette(&data.affine_transforms[offset], data.skeleton.getInverseBindAffines(), data.joint_count,
+                         &data.affine_palettes[offset]);
+}
+
+void nlerpComplex(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    nlerpComplexes(&data.source_complexes[offset], &data.target_complexes[0], 0.5f,
+                   &data.output_complexes[offset], data.joint_count);
+}
+
+void dualQuatScalar(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    computeDualQuatPalette(&data.palettes[offset], data.joint_count, &data.dual_quats[offset], &data.scales[offset]);
+}
+
+void poseEncode(KernelData& data, size_t slot)
+{
+    data.encoder.acknowledge(data.encoder.encode(data.sources[slot], data.packet));
+}
+
+void poseDecode(KernelData& data, size_t slot)
+{
+    const std::vector<unsigned char>& packet = data.packets[slot];
+    GLuint sequence;
+    data.decoder.decode(&packet[0], packet.size(), data.outputs[slot], sequence);
+}
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+void localTransformsSse2(KernelData& data, size_t slot)
+{
+    computeLocalTransforms(data.sources[slot], &data.locals[slot * data.joint_count]);
+}
+
+void blendSse2(KernelData& data, size_t slot)
+{
+    blendPoses(data.sources[slot], data.target, 0.5f, data.outputs[slot]);
+}
+
+void nlerpSse2(KernelData& data, size_t slot)
+{
+    size_t offset = slot * data.joint_count;
+    nlerpQuats(&data.source_rotations[offset], &data.target_rotations[0], 0.5f,
+               &data.output_rotations[offset], data.joint_count);
+}
+#endif
+
+#ifdef KERNEL_BENCHMARKS_GLM_SIMD
+void hierarchyGlmSimd(KernelData& data, size_t slot)
+{
+    const mat4* locals = &data.locals[slot * data.joint_count];
+    mat4* transforms = &data.transforms[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        int parent = data.parents[joint];
+        if (parent == Skeleton::NO_PARENT)
+            transforms[joint] = locals[joint];
+        else
+            transforms[joint] = glm::mat4_cast(glm::simdMat4(transforms[parent]) * glm::simdMat4(locals[joint]));
+    }
+}
+
+void paletteGlmSimd(KernelData& data, size_t slot)
+{
+    const mat4* transforms = &data.transforms[slot * data.joint_count];
+    mat4* palette = &data.palettes[slot * data.joint_count];
+    for (size_t joint = 0; joint < data.joint_count; ++joint)
+    {
+        glm::simdMat4 inverse_bind(data.skeleton.getInverseBindTransforms()[joint]);
+        palette[joint] = glm::mat4_cast(glm::simdMat4(transforms[joint]) * inverse_bind);
+    }
+}
+#endif
+
+typedef void (*KernelFunction)(KernelData& data, size_t slot);
+
+struct Kernel
+{
+    const char* name;
+    const char* path;
+    KernelFunction function;
+    size_t joint_count;     ///< The only number of joints the kernel can run with, or 0 for any.
+};
+
+const Kernel KERNELS[] =
+{
+    { "local_transforms", "scalar", localTransformsScalar, 0 },
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    { "local_transforms", "sse2", localTransformsSse2, 0 },
+#endif
+    { "local_transforms", "affine_2d", localTransformsAffine, 0 },
+    { "local_transforms", "complex", localTransformsComplex, 0 },
+    { "sincos", "libm", sinCosLibm, 0 },
+    { "sincos", "fast", sinCosFast, 0 },
+    { "hierarchy", "scalar", hierarchyScalar, 0 },
+#ifdef KERNEL_BENCHMARKS_GLM_SIMD
+    { "hierarchy", "glm_simd", hierarchyGlmSimd, 0 },
+#endif
+    { "hierarchy", "simd_math", hierarchySimdMath, 0 },
+    { "hierarchy", "levels", hierarchyLevels, 0 },
+    { "hierarchy", "affine_2d", hierarchyAffine, 0 },
+    { "hierarchy", "fixed", hierarchyFixed<7>, 7 },
+    { "hierarchy", "fixed", hierarchyFixed<32>, 32 },
+    { "hierarchy", "affine_2d_fixed", hierarchyFixedAffine<7>, 7 },
+    { "hierarchy", "affine_2d_fixed", hierarchyFixedAffine<32>, 32 },
+    { "hierarchy_strands", "scalar", hierarchyStrandsScalar, 0 },
+    { "hierarchy_strands", "levels", hierarchyStrandsLevels, 0 },
+    { "hierarchy_strands", "levels_mt", hierarchyStrandsLevelsThreaded, 0 },
+    { "blend", "scalar", blendScalar, 0 },
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    { "blend", "sse2", blendSse2, 0 },
+#endif
+    { "retarget", "scalar", retargetScalar, 0 },
+    { "retarget", "precomputed", retargetPrecomputed, 0 },
+    { "rotation_nlerp", "scalar", nlerpScalar, 0 },
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    { "rotation_nlerp", "sse2", nlerpSse2, 0 },
+#endif
+    { "rotation_nlerp", "complex", nlerpComplex, 0 },
+    { "palette", "scalar", paletteScalar, 0 },
+#ifdef KERNEL_BENCHMARKS_GLM_SIMD
+    { "palette", "glm_simd", paletteGlmSimd, 0 },
+#endif
+    { "palette", "simd_math", paletteSimdMath, 0 },
+    { "palette", "affine_2d", paletteAffine, 0 },
+    { "affine_inverse", "scalar", affineInverseScalar, 0 },
+    { "affine_inverse", "simd_math", affineInverseSimdMath, 0 },
+    { "transform_vec4", "scalar", transformScalar, 0 },
+    { "transform_vec4", "simd_math", transformSimdMath, 0 },
+    { "batch_lerp", "scalar", batchLerpScalar, 0 },
+    { "batch_lerp", "simd_math", batchLerpSimdMath, 0 },
+    { "dual_quat", "scalar", dualQuatScalar, 0 },
+    { "pose_codec", "encode", poseEncode, 0 },
+    { "pose_codec", "decode", poseDecode, 0 }
+};
+
+const size_t N_KERNELS = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Evicts everything from the CPU's caches by writing to a buffer
+///         bigger than they are.
+void flushCaches()
+{
+    static std::vector<char> buffer(FLUSH_SIZE);
+    static char value = 0;
+
+    ++value;
+    for (size_t i = 0; i < buffer.size(); i += 64)
+        buffer[i] = value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of separate slots a configuration needs.
+///
+/// \details A warm configuration needs one slot per instance.  A cold one
+///         is timed one sweep per sample, right after flushing the caches,
+///         so it also needs enough slots to keep that sweep long enough to
+///         time accurately.  Either way the slot count is capped by
+///         MAX_SLOT_JOINTS; past that, instances reuse slots, but the data
+///         is already far too large to stay in the cache between uses.
+size_t getSlotCount(size_t joint_count, size_t instance_count, bool cold)
+{
+    size_t slots = instance_count;
+    if (cold)
+        slots = std::max(slots, (MIN_JOINTS_PER_SAMPLE + joint_count - 1) / joint_count);
+
+    return std::max(std::min(slots, MAX_SLOT_JOINTS / joint_count), size_t(1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Times one kernel on one configuration.
+///
+/// \details Warm samples each repeat the sweep over the instances enough
+///         times to process at least MIN_JOINTS_PER_SAMPLE joints, after an
+///         untimed sweep to load the data into the cache.  Cold samples
+///         flush the caches, then sweep once over every slot.
+KernelResult timeKernel(const Kernel& kernel, KernelData& data, size_t instance_count, bool cold)
+{
+    size_t slot_count = getSlotCount(data.joint_count, instance_count, cold);
+    size_t sweep_instances = cold ? std::max(instance_count, slot_count) : instance_count;
+    size_t sweep_joints = sweep_instances * data.joint_count;
+    size_t repetitions = cold ? 1 : (MIN_JOINTS_PER_SAMPLE + sweep_joints - 1) / sweep_joints;
+
+    if (!cold)
+    {
+        for (size_t instance = 0; instance < sweep_instances; ++instance)
+            kernel.function(data, instance % slot_count);
+    }
+
+    TimingStats stats(kernel.name, SAMPLE_COUNT);
+    for (size_t sample = 0; sample < SAMPLE_COUNT; ++sample)
+    {
+        if (cold)
+            flushCaches();
+
+        double start = getTimeMilliseconds();
+        for (size_t repetition = 0; repetition < repetitions; ++repetition)
+        {
+            for (size_t instance = 0; instance < sweep_instances; ++instance)
+                kernel.function(data, instance % slot_count);
+        }
+        stats.addSample(getTimeMilliseconds() - start);
+    }
+
+    double ms_to_ns_per_joint = 1000000.0 / double(sweep_joints * repetitions);
+
+    KernelResult result;
+    result.kernel = kernel.name;
+    result.path = kernel.path;
+    result.cold = cold;
+    result.joint_count = data.joint_count;
+    result.instance_count = instance_count;
+    result.samples = stats.getSampleCount();
+    result.ns_per_joint_p50 = stats.getPercentile(50) * ms_to_ns_per_joint;
+    result.ns_per_joint_mean = stats.getMean() * ms_to_ns_per_joint;
+    return result;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Times every kernel implementation, warm and cold, for every
+///         combination of joint and instance counts.
+///
+/// \details The data for each joint count is generated once, large enough
+///         for the biggest configuration, and shared by all of its
+///         configurations and kernels.  Progress is written to stderr.
+///
+/// \param  joint_counts The skeleton sizes to test.
+/// \param  instance_counts The numbers of instances to process per sample.
+/// \param  results Receives one result per kernel implementation and
+///         configuration.
+void runKernelBenchmarks(const std::vector<size_t>& joint_counts,
+                         const std::vector<size_t>& instance_counts,
+                         std::vector<KernelResult>& results)
+{
+    for (size_t j = 0; j < joint_counts.size(); ++j)
+    {
+        size_t joint_count = joint_counts[j];
+
+        size_t slot_count = 1;
+        for (size_t i = 0; i < instance_counts.size(); ++i)
+            slot_count = std::max(slot_count, getSlotCount(joint_count, instance_counts[i], true));
+
+        std::unique_ptr<KernelData> data(new KernelData(joint_count, slot_count));
+        std::cerr << "pose_codec, " << joint_count << " joints: "
+                  << 8.0 * data->packet_bytes / (slot_count * joint_count) << " bits/joint, from "
+                  << 8 * (sizeof(vec2) + 2 * sizeof(float)) << " uncompressed" << std::endl;
+
+        for (size_t i = 0; i < instance_counts.size(); ++i)
+        {
+            for (int cold = 0; cold < 2; ++cold)
+            {
+                for (size_t k = 0; k < N_KERNELS; ++k)
+                {
+                    if (KERNELS[k].joint_count != 0 && KERNELS[k].joint_count != joint_count)
+                        continue;
+
+                    KernelResult result = timeKernel(KERNELS[k], *data, instance_counts[i], cold != 0);
+                    std::cerr << result.kernel << " (" << result.path << ", " << (cold ? "cold" : "warm") << "), "
+                              << joint_count << " joints, " << instance_counts[i] << " instances: "
+                              << result.ns_per_joint_p50 << " ns/joint" << std::endl;
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  kernel_benchmarks.h
+/// \author Ben Crist
+///
+/// \brief  Functions for timing the CPU pose and palette kernels in
+///         isolation.
+
+#ifndef KERNEL_BENCHMARKS_H_
+#define KERNEL_BENCHMARKS_H_
+
+#include "demo.h"
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The timing of one implementation of one kernel, at one size.
+struct KernelResult
+{
+    std::string kernel;         ///< The stage of the pipeline, e.g. "hierarchy".
+    std::string path;           ///< The implementation: "scalar", "sse2", "glm_simd", "simd_math", "levels", "levels_mt",
+                                ///< "affine_2d", "complex", "libm", "fast", "encode" or "decode".
+    bool cold;                  ///< Whether the caches were flushed before each sample.
+    size_t joint_count;         ///< The number of joints in each instance's skeleton.
+    size_t instance_count;      ///< The number of instances processed per sample.
+    size_t samples;             ///< The number of samples taken.
+    double ns_per_joint_p50;    ///< The median time per joint, in nanoseconds.
+    double ns_per_joint_mean;   ///< The mean time per joint, in nanoseconds.
+};
+
+void runKernelBenchmarks(const std::vector<size_t>& joint_counts,
+                         const std::vector<size_t>& instance_counts,
+                         std::vector<KernelResult>& results);
+
+#endif
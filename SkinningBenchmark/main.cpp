@@ -0,0 +1,1798 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  main.cpp
+/// \author Ben Crist
+///
+/// \brief  Skinning Benchmark entry point; measures the throughput of each
+///         of the demo's skinning backends on synthetic meshes.
+
+///////////////////////////////////////////////////////////////////////////////
+// Make sure we're linking against GLEW and freeGLUT
+// (other compilers are given them by CMakeLists.txt).
+#ifdef _MSC_VER
+#ifdef DEBUG
+#pragma comment (lib, "glew32sd.lib")
+#else
+#pragma comment (lib, "glew32s.lib")
+#endif
+#pragma comment (lib, "freeglut.lib")
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "demo.h"
+#include "camera.h"
+#include "compute_skinner.h"
+#include "cpu_skinner.h"
+#include "joint_local_stream.h"
+#include "kernel_benchmarks.h"
+#include "mesh_meshlets.h"
+#include "mesh_split.h"
+#include "mesh_file.h"
+#include "meshlet_cull_pass.h"
+#include "palette.h"
+#include "perf_suite.h"
+#include "platform.h"
+#include "preview_target.h"
+#include "profiler.h"
+#include "shader.h"
+#include "shader_permutation.h"
+#include "skinned_vertex_cache.h"
+#include "skinning_accuracy.h"
+#include "skinning_kernels.h"
+#include "skinning_shaders.h"
+#include "split_frame_check.h"
+#include "synthetic_rig.h"
+#include "thread_pool.h"
+#include "uniform_ring_buffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Identifies the skinning paths which can be benchmarked.  Each
+///         matches one of the demo's single-mesh skinning modes.
+enum Backend
+{
+    BACKEND_SEPARATE = 0,   ///< Vertex shader skinning with separate pose and bind pose matrices.
+    BACKEND_PALETTE,        ///< Vertex shader skinning with a precombined palette.
+    BACKEND_DUAL_QUAT,      ///< Vertex shader skinning with dual quaternions.
+    BACKEND_AFFINE_2D,      ///< Vertex shader skinning with 2D affine transforms, posed without matrices.
+    BACKEND_SPLIT,          ///< Precombined palette skinning of sub-meshes with palettes of their own joints.
+    BACKEND_FEEDBACK,       ///< Precombined palette skinning captured with transform feedback, then drawn.
+    BACKEND_COMPUTE,        ///< Compute shader skinning; only available on GL 4.3.
+    BACKEND_CPU,            ///< Batched SIMD skinning on a thread pool, streamed to a VBO.
+    BACKEND_MESHLET,        ///< Precombined palette skinning of the meshlets which survive GPU culling; only available on GL 4.3.
+    BACKEND_JOINT_LOCAL,    ///< Vertex shader skinning of positions prebaked into each influence's joint space, by the pose alone.
+    N_BACKENDS
+};
+
+const char* const BACKEND_NAMES[N_BACKENDS] = { "separate", "palette", "dual_quat", "affine_2d", "split", "feedback",
+                                                 "compute", "cpu", "meshlet", "joint_local" };
+const char* const FORMAT_NAMES[] = { "full", "packed", "half", "full_3d", "packed_3d", "half_3d", "quantized" };
+
+const GLuint SKINNING_PALETTE_BINDING = 0;  ///< The uniform buffer binding point of the SkinningPalette block.
+const GLsizei TARGET_SIZE = 512;            ///< The width and height of the offscreen framebuffer.
+
+// -stress draws a grid of instances of each rig, each at its own phase of
+// the animation, and grows it a row and column at a time until a frame of
+// the whole grid takes longer than the budget.
+const double DEFAULT_STRESS_BUDGET_MS = 16.6;   ///< One frame at 60 Hz.
+const size_t MAX_STRESS_GRID_SIZE = 64;         ///< The most instances along each side of the grid.
+const size_t STRESS_WARMUP_FRAMES = 3;          ///< Frames run at each grid size before measuring it.
+const size_t STRESS_FRAMES = 20;                ///< Frames measured at each grid size.
+const size_t STRESS_PHASE_FRAMES = 126;         ///< About one period of animateSyntheticPose()'s wave.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The size of the rig to benchmark.
+struct RigConfig
+{
+    size_t vertex_count;
+    size_t joint_count;
+    size_t influence_count;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The measurements of one backend on one rig.
+struct BenchmarkResult
+{
+    Backend backend;
+    RigConfig rig;
+    size_t vertex_count;        ///< The number of vertices actually generated.
+    size_t frames;
+    double frame_mean_ms;       ///< Wall time from posing to glFinish().
+    double frame_p50_ms;
+    double frame_p90_ms;
+    double frame_p99_ms;
+    double gpu_mean_ms;         ///< GL_TIME_ELAPSED from uploading the palette to the end of the draw.
+    double vertices_per_second; ///< vertex_count / frame_mean_ms.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The largest grid of instances of one rig a backend drew within
+///         the frame budget, with -stress.
+struct StressResult
+{
+    Backend backend;
+    RigConfig rig;
+    size_t vertex_count;        ///< The number of vertices actually generated, per instance.
+    size_t grid_size;           ///< The grid was grid_size x grid_size instances; 0 if even one was over budget.
+    size_t instance_count;      ///< grid_size squared.
+    double frame_mean_ms;       ///< Wall time for the whole grid, at grid_size.
+    double gpu_mean_ms;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Where a preview is looked at from: the point of the rig which
+///         appears at the center of the image, and how much it's magnified.
+struct PreviewCamera
+{
+    vec2 center;
+    float zoom;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One image to render with -previews.
+struct PreviewJob
+{
+    std::string output;     ///< The TGA file to write.
+    RigConfig rig;
+    size_t frame;           ///< The frame of the synthetic animation to pose the rig in.
+    PreviewCamera camera;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Everything needed to skin and draw one synthetic rig, shared by
+///         all of the backends.
+struct Rig
+{
+    Skeleton skeleton;
+    Pose bind_pose;
+    Pose pose;
+    SkeletalMesh mesh;
+    std::vector<mat4> inverse_binds;            ///< The skeleton's, with the mesh's position quantization folded in.
+    std::vector<Affine2D> inverse_bind_affines; ///< The same, as Affine2Ds.
+
+    std::vector<mat4> joint_transforms;
+    std::vector<mat4> skinning_palette;
+    std::vector<DualQuat> dual_quat_palette;
+    std::vector<float> palette_scales;
+    std::vector<Affine2D> joint_affines;
+    std::vector<Affine2D> affine_palette;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The programs and objects one backend draws with.  Only the ones
+///         the backend uses are created.
+struct BackendState
+{
+    BackendState();
+    ~BackendState();
+
+    GLuint programs[MAX_JOINT_INFLUENCES];  ///< programs[n - 1] evaluates n influences.
+    GLuint passthrough_program_id;
+    GLuint compute_program_id;          ///< Skins for BACKEND_COMPUTE, or culls for BACKEND_MESHLET.
+    GLuint compute_draw_program_id;
+
+    std::unique_ptr<UniformRingBuffer> palette_buffer;
+    std::unique_ptr<SkinnedVertexCache> vertex_cache;
+    std::unique_ptr<ComputeSkinner> compute_skinner;
+    std::unique_ptr<CpuSkinner> cpu_skinner;
+    std::unique_ptr<MeshletCullPass> meshlet_pass;
+    std::unique_ptr<JointLocalStream> joint_local_stream;
+
+    std::vector<PaletteSubMesh> sub_meshes;                 ///< BACKEND_SPLIT's pieces of the rig's mesh; only their source_joints are kept once they're uploaded.
+    std::vector<std::unique_ptr<SkeletalMesh> > split_meshes;   ///< Each of sub_meshes, uploaded.
+    size_t split_palette_joints;                            ///< The palette size split_meshes' programs were compiled for.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts with no GL objects.
+BackendState::BackendState()
+    : passthrough_program_id(0),
+      compute_program_id(0),
+      compute_draw_program_id(0),
+      split_palette_joints(0)
+{
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        programs[i] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Deletes every program which was created.
+BackendState::~BackendState()
+{
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        glDeleteProgram(programs[i]);
+
+    glDeleteProgram(passthrough_program_id);
+    glDeleteProgram(compute_program_id);
+    glDeleteProgram(compute_draw_program_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates a rig's skeleton, poses and mesh, and uploads the mesh.
+void initRig(const RigConfig& config, VertexFormat format, Rig& rig)
+{
+    if (config.joint_count < 1)
+        throw std::runtime_error("The skeleton needs at least one joint.");
+    if (format != VERTEX_FORMAT_FULL && config.joint_count > 256)
+        throw std::runtime_error("The packed vertex formats can only address 256 joints.");
+
+    buildSyntheticSkeleton(rig.skeleton, config.joint_count);
+    rig.bind_pose = rig.skeleton.allocatePose(true);
+    rig.pose = rig.skeleton.allocatePose(true);
+    setSyntheticBindPose(rig.bind_pose);
+    rig.skeleton.setBindPose(rig.bind_pose);
+
+    size_t joint_count = config.joint_count;
+    rig.joint_transforms.resize(joint_count);
+    rig.skinning_palette.resize(joint_count);
+    rig.dual_quat_palette.resize(joint_count);
+    rig.palette_scales.resize((joint_count + 3) & ~3, 1.0f);   // padded to a whole number of vec4s
+    rig.joint_affines.resize(joint_count);
+    rig.affine_palette.resize(joint_count);
+
+    buildSyntheticMesh(config.vertex_count, joint_count, config.influence_count,
+                       rig.mesh.vertices, rig.mesh.indices);
+    rig.mesh.vertex_format = format;
+    rig.mesh.uploadMesh();
+
+    // the quantization is the identity for the other formats, so every
+    // backend can use the folded transforms.
+    rig.inverse_binds.resize(joint_count);
+    rig.inverse_bind_affines.resize(joint_count);
+    foldPositionQuantization(rig.skeleton.getInverseBindTransforms(), joint_count, rig.mesh.position_quantization,
+                             rig.inverse_binds.data());
+    for (size_t i = 0; i < joint_count; ++i)
+        rig.inverse_bind_affines[i] = mat4ToAffine(rig.inverse_binds[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compiles the skinning vertex shader for each of a mesh's
+///         partitions, and binds their SkinningPalette blocks.
+///
+/// \param  mesh The rig's mesh, or one of its sub-meshes.
+/// \param  joint_count The number of joints in the programs' palettes.
+/// \param  palette_source Where the programs read their palettes from;
+///         only the uniform block sources are supported.
+/// \param  dual_quaternion Whether the palette is uploaded as dual
+///         quaternions.
+/// \param  affine_2d Whether the palette is uploaded as 2D affine
+///         transforms.
+/// \param  feedback Whether to link the programs for transform feedback into
+///         a SkinnedVertexCache.
+/// \param  joint_local_positions Whether the programs skin a
+///         JointLocalStream's positions, by the separate pose alone.
+void compileSkinningPrograms(const Rig& rig, const SkeletalMesh& mesh, size_t joint_count,
+                             PaletteSource palette_source, bool dual_quaternion, bool affine_2d,
+                             bool feedback, BackendState& state, bool joint_local_positions = false)
+{
+    std::vector<const char*> feedback_varyings;
+    if (feedback)
+    {
+        feedback_varyings.push_back("gl_Position");
+        feedback_varyings.push_back("color");
+    }
+
+    const std::vector<SkeletalMesh::Partition>& partitions = mesh.getPartitions();
+    for (size_t i = 0; i < partitions.size(); ++i)
+    {
+        size_t influences = partitions[i].influence_count;
+        if (state.programs[influences - 1] != 0)
+            continue;
+
+        SkinningPermutation permutation;
+        permutation.palette_source = palette_source;
+        permutation.dual_quaternion = dual_quaternion;
+        permutation.affine_2d = affine_2d;
+        permutation.joint_count = joint_count;
+        permutation.influence_count = influences;
+        permutation.joint_local_positions = joint_local_positions;
+
+        GLuint program_id = compileShaderProgram(generateSkinningVertexShader(permutation, vertex_shader_source,
+                                                                              feedback),
+                                                 generateSkinningFragmentShader(), feedback_varyings);
+        state.programs[influences - 1] = program_id;
+
+        GLuint block_index = glGetUniformBlockIndex(program_id, "SkinningPalette");
+        glUniformBlockBinding(program_id, block_index, SKINNING_PALETTE_BINDING);
+        bindCameraBlock(program_id);
+
+        GLint bind_pose_inv_location = glGetUniformLocation(program_id, "bind_pose_inv");
+        if (bind_pose_inv_location >= 0)
+        {
+            std::vector<vec4> rows(rig.skeleton.getJointCount() * 3);
+            packAffineRows(rig.inverse_binds.data(), rig.skeleton.getJointCount(), rows.data());
+            glUseProgram(program_id);
+            glUniform4fv(bind_pose_inv_location, GLsizei(rows.size()), &rows[0][0]);
+            glUseProgram(0);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the programs and objects a backend needs for a rig.
+///
+/// \details Throws if the backend can't handle the rig on this context, for
+///         instance if the palette doesn't fit in a uniform block.
+///
+/// \param  max_palette_joints The most joints BACKEND_SPLIT may put in a
+///         sub-mesh's palette, or 0 for as many as a uniform block holds.
+void initBackend(Backend backend, Rig& rig, ThreadPool& thread_pool, BackendState& state,
+                 size_t max_palette_joints = 0)
+{
+    size_t joint_count = rig.skeleton.getJointCount();
+
+    if (backend == BACKEND_COMPUTE)
+    {
+        if (!GLEW_VERSION_4_3)
+            throw std::runtime_error("Compute skinning needs OpenGL 4.3.");
+
+        std::ostringstream compute_source;
+        compute_source << "#version 430" << std::endl
+                       << "#define N_JOINTS " << joint_count << std::endl;
+        if (rig.mesh.vertex_format == VERTEX_FORMAT_PACKED)
+            compute_source << "#define VERTEX_FORMAT_PACKED" << std::endl;
+        else if (rig.mesh.vertex_format == VERTEX_FORMAT_PACKED_HALF)
+            compute_source << "#define VERTEX_FORMAT_PACKED_HALF" << std::endl;
+        else if (rig.mesh.vertex_format == VERTEX_FORMAT_QUANTIZED)
+            compute_source << "#define VERTEX_FORMAT_QUANTIZED" << std::endl;
+        compute_source << compute_skinning_shader_source;
+
+        state.compute_program_id = compileComputeProgram(compute_source.str());
+        state.compute_draw_program_id = compileShaderProgram("#version 430\n" + compute_draw_vertex_shader_source,
+                                                             "#version 430\n" + fragment_shader_source);
+        state.compute_skinner.reset(new ComputeSkinner(rig.mesh, joint_count, 1));
+        return;
+    }
+
+    if (backend == BACKEND_CPU || backend == BACKEND_FEEDBACK)
+    {
+        state.passthrough_program_id = compileShaderProgram("#version 330\n" + passthrough_vertex_shader_source,
+                                                            "#version 330\n" + fragment_shader_source);
+        bindCameraBlock(state.passthrough_program_id);
+    }
+
+    if (backend == BACKEND_CPU)
+    {
+        state.cpu_skinner.reset(new CpuSkinner(rig.mesh, thread_pool));
+        return;
+    }
+
+    // the rest skin in the vertex shader, reading the SkinningPalette block.
+    GLint max_block_size = 0;
+    glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &max_block_size);
+
+    if (backend == BACKEND_SPLIT)
+    {
+        // each sub-mesh would be quantized to its own bounds, and need its
+        // own folded palette.
+        if (isQuantizedFormat(rig.mesh.vertex_format))
+            throw std::runtime_error("The split backend doesn't support quantized vertices.");
+
+        // the packed formats' joint indices are bytes, so no palette can
+        // be larger than 256 slots, even when the whole rig is.  A rig
+        // which only uses that many of its joints is renumbered rather
+        // than split.
+        size_t palette_joints = std::min(joint_count, size_t(max_block_size) / (sizeof(mat4) + sizeof(color4)));
+        if (rig.mesh.vertex_format != VERTEX_FORMAT_FULL)
+            palette_joints = std::min(palette_joints, MAX_PACKED_PALETTE_JOINTS);
+        if (max_palette_joints > 0)
+            palette_joints = std::min(palette_joints, max_palette_joints);
+
+        splitMeshByJoints(rig.mesh.vertices, rig.mesh.indices, palette_joints, state.sub_meshes);
+        for (size_t i = 0; i < state.sub_meshes.size(); ++i)
+        {
+            // the sub-mesh's vertices are moved into the mesh, and only kept
+            // on the GPU once they're uploaded.
+            std::unique_ptr<SkeletalMesh> mesh(new SkeletalMesh(std::move(state.sub_meshes[i].vertices),
+                                                                std::move(state.sub_meshes[i].indices)));
+            mesh->vertex_format = rig.mesh.vertex_format;
+            mesh->uploadMesh();
+            mesh->releaseCpuData();
+
+            compileSkinningPrograms(rig, *mesh, palette_joints, PALETTE_SOURCE_UNIFORM_BLOCK,
+                                    false, false, false, state);
+            state.split_meshes.push_back(std::move(mesh));
+        }
+
+        // every sub-mesh draws from its own block, so each frame uses one
+        // region per sub-mesh.
+        state.split_palette_joints = palette_joints;
+        state.palette_buffer.reset(new UniformRingBuffer((sizeof(mat4) + sizeof(color4)) * palette_joints,
+                                                         3 * state.sub_meshes.size()));
+
+        size_t split_vertices = 0;
+        for (size_t i = 0; i < state.sub_meshes.size(); ++i)
+            split_vertices += state.split_meshes[i]->getVertexCount();
+        std::cerr << "Split into " << state.sub_meshes.size() << " sub-meshes of up to " << palette_joints
+                  << " joints, " << split_vertices << " vertices in all." << std::endl;
+        return;
+    }
+
+    GLsizeiptr block_size = (sizeof(mat4) + sizeof(color4)) * joint_count;
+    if (block_size > max_block_size)
+        throw std::runtime_error("The palette doesn't fit in a uniform block.");
+
+    if (backend == BACKEND_MESHLET && !GLEW_VERSION_4_3)
+        throw std::runtime_error("Meshlet culling needs OpenGL 4.3.");
+
+    state.palette_buffer.reset(new UniformRingBuffer(block_size));
+
+    if (backend == BACKEND_SEPARATE)
+        compileSkinningPrograms(rig, rig.mesh, joint_count, PALETTE_SOURCE_SEPARATE, false, false, false, state);
+    else if (backend == BACKEND_JOINT_LOCAL)
+    {
+        // the positions are baked from the float vertices, so the stream
+        // takes the skeleton's own inverse binds, not the folded ones.
+        compileSkinningPrograms(rig, rig.mesh, joint_count, PALETTE_SOURCE_SEPARATE, false, false, false, state, true);
+        state.joint_local_stream.reset(new JointLocalStream(rig.mesh, rig.skeleton.getInverseBindTransforms()));
+        std::cerr << "Baked " << state.joint_local_stream->getInfluenceCount() << " joint-local positions per vertex, "
+                  << state.joint_local_stream->getBufferBytes() << " bytes beside the mesh's "
+                  << rig.mesh.getBufferBytes() << "." << std::endl;
+    }
+    else if (backend == BACKEND_PALETTE)
+        compileSkinningPrograms(rig, rig.mesh, joint_count, PALETTE_SOURCE_UNIFORM_BLOCK, false, false, false, state);
+    else if (backend == BACKEND_DUAL_QUAT)
+        compileSkinningPrograms(rig, rig.mesh, joint_count, PALETTE_SOURCE_UNIFORM_BLOCK, true, false, false, state);
+    else if (backend == BACKEND_AFFINE_2D)
+        compileSkinningPrograms(rig, rig.mesh, joint_count, PALETTE_SOURCE_UNIFORM_BLOCK, false, true, false, state);
+    else if (backend == BACKEND_FEEDBACK)
+    {
+        compileSkinningPrograms(rig, rig.mesh, joint_count, PALETTE_SOURCE_UNIFORM_BLOCK, false, false, true, state);
+        state.vertex_cache.reset(new SkinnedVertexCache(rig.mesh));
+    }
+    else if (backend == BACKEND_MESHLET)
+    {
+        compileSkinningPrograms(rig, rig.mesh, joint_count, PALETTE_SOURCE_UNIFORM_BLOCK, false, false, false, state);
+        state.compute_program_id = compileComputeProgram("#version 430\n" + meshlet_cull_shader_source);
+
+        MeshletMesh meshlets;
+        buildMeshlets(rig.mesh, meshlets);
+        state.meshlet_pass.reset(new MeshletCullPass(rig.mesh, meshlets, joint_count, 1));
+        std::cerr << "Built " << meshlets.meshlets.size() << " meshlets, with "
+                  << meshlets.joints.size() << " joint bounds in all." << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes this frame's copy of the SkinningPalette block, in the
+///         layout the backend's programs were compiled for.
+void uploadPaletteBlock(Backend backend, const Rig& rig, UniformRingBuffer& palette_buffer)
+{
+    size_t joint_count = rig.skeleton.getJointCount();
+
+    char* block = static_cast<char*>(palette_buffer.map());
+    if (backend == BACKEND_SEPARATE || backend == BACKEND_JOINT_LOCAL)
+    {
+        packAffineRows(rig.joint_transforms.data(), joint_count, reinterpret_cast<vec4*>(block));
+        block += joint_count * 3 * sizeof(vec4);
+    }
+    else if (backend == BACKEND_DUAL_QUAT)
+    {
+        std::memcpy(block, rig.dual_quat_palette.data(), joint_count * sizeof(DualQuat));
+        block += joint_count * sizeof(DualQuat);
+        std::memcpy(block, rig.palette_scales.data(), rig.palette_scales.size() * sizeof(float));
+        block += rig.palette_scales.size() * sizeof(float);
+    }
+    else if (backend == BACKEND_AFFINE_2D)
+    {
+        // the colors start at the next whole vec4.
+        std::memcpy(block, rig.affine_palette.data(), joint_count * sizeof(Affine2D));
+        block += (joint_count * sizeof(Affine2D) + sizeof(vec4) - 1) / sizeof(vec4) * sizeof(vec4);
+    }
+    else
+    {
+        packAffineRows(rig.skinning_palette.data(), joint_count, reinterpret_cast<vec4*>(block));
+        block += joint_count * 3 * sizeof(vec4);
+    }
+    std::memcpy(block, rig.pose.color, joint_count * sizeof(color4));
+    palette_buffer.unmap(SKINNING_PALETTE_BINDING);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws each of a mesh's partitions with the program compiled for
+///         its influence count.
+///
+/// \param  vao_id The VAO to draw the partitions from, or 0 for the mesh's
+///         own.
+void drawPartitions(const SkeletalMesh& mesh, const BackendState& state, GLuint vao_id = 0)
+{
+    const std::vector<SkeletalMesh::Partition>& partitions = mesh.getPartitions();
+
+    glBindVertexArray(vao_id != 0 ? vao_id : mesh.vao_id);
+    for (size_t i = 0; i < partitions.size(); ++i)
+    {
+        const SkeletalMesh::Partition& partition = partitions[i];
+        if (partition.index_count == 0)
+            continue;
+
+        glUseProgram(state.programs[partition.influence_count - 1]);
+        glDrawElements(GL_TRIANGLES, partition.index_count, mesh.getIndexType(),
+                       reinterpret_cast<void*>(partition.first_index * mesh.getIndexSize()));
+    }
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves a pose to where a camera sees it.
+///
+/// \details The skinning programs have no view transform; their output is
+///         already in clip space.  So the camera is folded into the root
+///         joints instead, which carries every other joint with them.  The
+///         joints only ever scale uniformly, so zooming is just a scale.
+void applyPreviewCamera(const PreviewCamera& camera, const Skeleton& skeleton, Pose& pose)
+{
+    for (size_t joint = 0; joint < pose.joint_count; ++joint)
+    {
+        if (skeleton.getParent(joint) != Skeleton::NO_PARENT)
+            continue;
+
+        pose.translation[joint] = (pose.translation[joint] - camera.center) * camera.zoom;
+        pose.scale[joint] *= camera.zoom;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Poses, skins and draws one frame of a rig with a backend, over
+///         whatever has already been drawn.
+///
+/// \param  camera Where to look at the rig from, or NULL to draw it as
+///         posed.
+void renderFrame(Backend backend, Rig& rig, BackendState& state, size_t frame, const PreviewCamera* camera = NULL)
+{
+    size_t joint_count = rig.skeleton.getJointCount();
+
+    animateSyntheticPose(rig.bind_pose, frame, rig.pose);
+    if (camera != NULL)
+        applyPreviewCamera(*camera, rig.skeleton, rig.pose);
+    if (backend == BACKEND_AFFINE_2D)
+    {
+        // no matrices at all, so the hierarchy and palette are cheaper too.
+        rig.skeleton.computeJointAffines(rig.pose, rig.joint_affines.data());
+        computeAffinePalette(rig.joint_affines.data(), rig.inverse_bind_affines.data(),
+                             joint_count, rig.affine_palette.data());
+    }
+    else
+        rig.skeleton.computeJointTransforms(rig.pose, rig.joint_transforms.data());
+    if (backend != BACKEND_SEPARATE && backend != BACKEND_AFFINE_2D && backend != BACKEND_JOINT_LOCAL)
+    {
+        // the CPU skinner reads the mesh's float vertices, not its uploaded
+        // ones.
+        const mat4* inverse_binds = backend == BACKEND_CPU ? rig.skeleton.getInverseBindTransforms()
+                                                           : rig.inverse_binds.data();
+        computeSkinningPalette(rig.joint_transforms.data(), inverse_binds, joint_count, rig.skinning_palette.data());
+    }
+    if (backend == BACKEND_DUAL_QUAT)
+    {
+        computeDualQuatPalette(rig.skinning_palette.data(), joint_count,
+                               rig.dual_quat_palette.data(), rig.palette_scales.data());
+    }
+
+    const std::vector<SkeletalMesh::Partition>& partitions = rig.mesh.getPartitions();
+    if (backend == BACKEND_COMPUTE)
+    {
+        GLuint visible_instance = 0;
+        state.compute_skinner->skin(state.compute_program_id, rig.skinning_palette.data(), rig.pose.color,
+                                    &visible_instance, 1);
+        state.compute_skinner->draw(state.compute_draw_program_id);
+    }
+    else if (backend == BACKEND_CPU)
+    {
+        state.cpu_skinner->skin(rig.skinning_palette.data(), rig.pose.color);
+
+        glUseProgram(state.passthrough_program_id);
+        state.cpu_skinner->draw();
+    }
+    else if (backend == BACKEND_FEEDBACK)
+    {
+        uploadPaletteBlock(backend, rig, *state.palette_buffer);
+
+        state.vertex_cache->beginCapture();
+        for (size_t i = 0; i < partitions.size(); ++i)
+        {
+            glUseProgram(state.programs[partitions[i].influence_count - 1]);
+            state.vertex_cache->captureVertices(partitions[i].first_vertex, partitions[i].vertex_count);
+        }
+        state.vertex_cache->endCapture();
+
+        glUseProgram(state.passthrough_program_id);
+        state.vertex_cache->draw();
+        state.palette_buffer->fence();
+    }
+    else if (backend == BACKEND_SPLIT)
+    {
+        // each sub-mesh gathers the entries of its own joints into the slots
+        // its vertices were renumbered to.
+        for (size_t i = 0; i < state.sub_meshes.size(); ++i)
+        {
+            const std::vector<GLuint>& source_joints = state.sub_meshes[i].source_joints;
+
+            char* block = static_cast<char*>(state.palette_buffer->map());
+            vec4* rows = reinterpret_cast<vec4*>(block);
+            color4* colors = reinterpret_cast<color4*>(block + state.split_palette_joints * 3 * sizeof(vec4));
+            for (size_t slot = 0; slot < source_joints.size(); ++slot)
+            {
+                packAffineRows(&rig.skinning_palette[source_joints[slot]], 1, rows + slot * 3);
+                colors[slot] = rig.pose.color[source_joints[slot]];
+            }
+            state.palette_buffer->unmap(SKINNING_PALETTE_BINDING);
+
+            drawPartitions(*state.split_meshes[i], state);
+            state.palette_buffer->fence();
+        }
+    }
+    else if (backend == BACKEND_MESHLET)
+    {
+        // the benchmark draws without face culling, so only the viewport
+        // culls meshlets.
+        state.meshlet_pass->cull(state.compute_program_id, rig.skinning_palette.data(), 1, false);
+        uploadPaletteBlock(backend, rig, *state.palette_buffer);
+
+        for (size_t i = 0; i < partitions.size(); ++i)
+        {
+            if (partitions[i].index_count == 0)
+                continue;
+
+            glUseProgram(state.programs[partitions[i].influence_count - 1]);
+            state.meshlet_pass->draw(i, 1);
+        }
+        glBindVertexArray(0);
+        state.palette_buffer->fence();
+    }
+    else
+    {
+        uploadPaletteBlock(backend, rig, *state.palette_buffer);
+        drawPartitions(rig.mesh, state, state.joint_local_stream ? state.joint_local_stream->getVertexArray() : 0);
+        state.palette_buffer->fence();
+    }
+
+    glUseProgram(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs a backend on a rig for a number of frames, waiting for each
+///         frame to finish before starting the next.
+///
+/// \param  warmup_frames The number of frames to run first without measuring
+///         them, so shader compilation and driver warmup aren't counted.
+/// \param  max_palette_joints Passed on to initBackend().
+BenchmarkResult runBackend(Backend backend, const RigConfig& config, Rig& rig, ThreadPool& thread_pool,
+                           size_t frames, size_t warmup_frames, size_t max_palette_joints)
+{
+    BackendState state;
+    initBackend(backend, rig, thread_pool, state, max_palette_joints);
+
+    TimingStats warmup_stats("warmup");
+    TimingStats frame_stats("frame", frames);
+    GpuTimer gpu_timer("gpu", frames);
+
+    for (size_t frame = 0; frame < warmup_frames + frames; ++frame)
+    {
+        bool measured = frame >= warmup_frames;
+        ScopedTimer timer(measured ? frame_stats : warmup_stats);
+
+        if (measured)
+            gpu_timer.begin();
+        glClear(GL_COLOR_BUFFER_BIT);
+        renderFrame(backend, rig, state, frame);
+        if (measured)
+            gpu_timer.end();
+
+        glFinish();
+    }
+
+    BenchmarkResult result;
+    result.backend = backend;
+    result.rig = config;
+    result.vertex_count = rig.mesh.getVertexCount();
+    result.frames = frames;
+    result.frame_mean_ms = frame_stats.getMean();
+    result.frame_p50_ms = frame_stats.getPercentile(50);
+    result.frame_p90_ms = frame_stats.getPercentile(90);
+    result.frame_p99_ms = frame_stats.getPercentile(99);
+    result.gpu_mean_ms = gpu_timer.getStats().getMean();
+    result.vertices_per_second = result.frame_mean_ms > 0 ? result.vertex_count / (result.frame_mean_ms / 1000.0) : 0;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how many frames an instance of a stress grid is ahead of
+///         the first, scattered by a multiplicative hash so that neighbors'
+///         poses differ, but the same from run to run.
+size_t getStressPhase(size_t instance)
+{
+    return size_t((GLuint(instance) * 2654435761u) >> 8) % STRESS_PHASE_FRAMES;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws one frame of a grid of instances of a rig, each posed,
+///         skinned and drawn by itself, in its own cell of the target.
+///
+/// \details The programs' output is already in clip space, so each instance
+///         is moved into its cell by folding a camera into its pose, as the
+///         previews do.
+///
+/// \param  grid_size The number of instances along each side of the grid.
+/// \param  frame The frame of the first instance's animation.
+void renderStressGrid(Backend backend, Rig& rig, BackendState& state, size_t grid_size, size_t frame)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    PreviewCamera camera;
+    camera.zoom = 1.0f / grid_size;
+    for (size_t row = 0; row < grid_size; ++row)
+    {
+        for (size_t column = 0; column < grid_size; ++column)
+        {
+            vec2 cell_center = vec2(2 * column + 1, 2 * row + 1) / float(grid_size) - vec2(1, 1);
+            camera.center = -cell_center * float(grid_size);
+            renderFrame(backend, rig, state, frame + getStressPhase(row * grid_size + column), &camera);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the largest grid of instances of a rig a backend can draw
+///         within a frame budget.
+///
+/// \details The grid starts at one instance and grows a row and column at a
+///         time, each size run for STRESS_FRAMES frames after
+///         STRESS_WARMUP_FRAMES more, until the mean frame time exceeds the
+///         budget or the grid reaches MAX_STRESS_GRID_SIZE.  Each frame is
+///         waited for before the next starts, as with runBackend().
+///
+/// \param  budget_ms The frame budget.
+/// \param  max_palette_joints Passed on to initBackend().
+StressResult runStress(Backend backend, const RigConfig& config, Rig& rig, ThreadPool& thread_pool,
+                       double budget_ms, size_t max_palette_joints)
+{
+    BackendState state;
+    initBackend(backend, rig, thread_pool, state, max_palette_joints);
+
+    StressResult result;
+    result.backend = backend;
+    result.rig = config;
+    result.vertex_count = rig.mesh.getVertexCount();
+    result.grid_size = 0;
+    result.frame_mean_ms = 0;
+    result.gpu_mean_ms = 0;
+
+    for (size_t grid_size = 1; grid_size <= MAX_STRESS_GRID_SIZE; ++grid_size)
+    {
+        TimingStats warmup_stats("warmup");
+        TimingStats frame_stats("frame", STRESS_FRAMES);
+        GpuTimer gpu_timer("gpu", STRESS_FRAMES);
+
+        for (size_t frame = 0; frame < STRESS_WARMUP_FRAMES + STRESS_FRAMES; ++frame)
+        {
+            bool measured = frame >= STRESS_WARMUP_FRAMES;
+            ScopedTimer timer(measured ? frame_stats : warmup_stats);
+
+            if (measured)
+                gpu_timer.begin();
+            renderStressGrid(backend, rig, state, grid_size, frame);
+            if (measured)
+                gpu_timer.end();
+
+            glFinish();
+        }
+
+        if (frame_stats.getMean() > budget_ms)
+            break;
+
+        result.grid_size = grid_size;
+        result.frame_mean_ms = frame_stats.getMean();
+        result.gpu_mean_ms = gpu_timer.getStats().getMean();
+    }
+
+    result.instance_count = result.grid_size * result.grid_size;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two jobs' rigs are the same size, so one rig can
+///         be drawn for both.
+bool isSameRig(const RigConfig& a, const RigConfig& b)
+{
+    return a.vertex_count == b.vertex_count && a.joint_count == b.joint_count &&
+           a.influence_count == b.influence_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Orders jobs by the size of their rigs, so that the jobs sharing
+///         a rig end up next to each other.
+bool compareJobRigs(const PreviewJob& a, const PreviewJob& b)
+{
+    if (a.rig.vertex_count != b.rig.vertex_count)
+        return a.rig.vertex_count < b.rig.vertex_count;
+    if (a.rig.joint_count != b.rig.joint_count)
+        return a.rig.joint_count < b.rig.joint_count;
+    return a.rig.influence_count < b.rig.influence_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a -previews job list.
+///
+/// \details Each line is one job:
+///
+///             output vertices joints influences frame [center_x center_y zoom]
+///
+///         The camera defaults to the origin at a zoom of 1, which is how
+///         the rigs are benchmarked.  Blank lines and lines starting with #
+///         are skipped.  The first bad line is reported to stderr.
+///
+/// \return false if the file couldn't be read, or a line was bad.
+bool readPreviewJobs(const std::string& path, std::vector<PreviewJob>& jobs)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+    {
+        std::cerr << "Error reading preview job list!" << std::endl
+                  << "   File: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (size_t line_number = 1; std::getline(file, line); ++line_number)
+    {
+        std::istringstream in(line);
+        PreviewJob job;
+        if (!(in >> job.output) || job.output[0] == '#')
+            continue;
+
+        job.camera.center = vec2(0, 0);
+        job.camera.zoom = 1;
+
+        long vertices = 0, joints = 0, influences = 0, frame = -1;
+        bool valid = bool(in >> vertices >> joints >> influences >> frame);
+        if (valid && !(in >> std::ws).eof())
+        {
+            valid = (in >> job.camera.center.x >> job.camera.center.y >> job.camera.zoom) &&
+                    (in >> std::ws).eof();
+        }
+        if (!valid || vertices <= 0 || joints <= 0 || influences < 1 || size_t(influences) > MAX_JOINT_INFLUENCES ||
+            frame < 0 || job.camera.zoom <= 0)
+        {
+            std::cerr << "Error reading preview job list!" << std::endl
+                      << "   File: " << path << std::endl
+                      << "   Line: " << line_number << std::endl;
+            return false;
+        }
+
+        job.rig.vertex_count = size_t(vertices);
+        job.rig.joint_count = size_t(joints);
+        job.rig.influence_count = size_t(influences);
+        job.frame = size_t(frame);
+        jobs.push_back(job);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Renders each job into a PreviewTarget and writes it out, back to
+///         back, with the palette backend.
+///
+/// \details The GPU never waits for the CPU here: each image is read back
+///         while the ones after it are drawn, and encoded and written on the
+///         target's writer thread while later ones are read back.  The jobs
+///         are sorted by rig first, so each rig is built and its programs
+///         compiled once.  A rig which can't be built on this context fails
+///         all of its jobs, with a message.
+///
+/// \return The number of jobs which didn't produce an image.
+int runPreviews(std::vector<PreviewJob>& jobs, VertexFormat format, GLsizei size, ThreadPool& thread_pool)
+{
+    std::stable_sort(jobs.begin(), jobs.end(), compareJobRigs);
+
+    PreviewTarget target(size, size);
+    target.bind();
+    glClearColor(0, 0, 0, 0);
+
+    double start = getTimeMilliseconds();
+    std::unique_ptr<Rig> rig;
+    std::unique_ptr<BackendState> state;
+    int failures = 0;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        const PreviewJob& job = jobs[i];
+        if (i == 0 || !isSameRig(job.rig, jobs[i - 1].rig))
+        {
+            state.reset();
+            if (rig)
+            {
+                rig->skeleton.releasePose(rig->bind_pose);
+                rig->skeleton.releasePose(rig->pose);
+            }
+
+            rig.reset(new Rig());
+            state.reset(new BackendState());
+            try
+            {
+                initRig(job.rig, format, *rig);
+                initBackend(BACKEND_PALETTE, *rig, thread_pool, *state);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Skipping previews of " << job.rig.vertex_count << " vertices, "
+                          << job.rig.joint_count << " joints, " << job.rig.influence_count << " influences: "
+                          << e.what() << std::endl;
+                rig.reset();
+                state.reset();
+            }
+        }
+
+        if (!rig)
+        {
+            ++failures;
+            continue;
+        }
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        renderFrame(BACKEND_PALETTE, *rig, *state, job.frame, &job.camera);
+        target.capture(job.output);
+    }
+
+    target.finish();
+    double elapsed_ms = getTimeMilliseconds() - start;
+
+    if (rig)
+    {
+        state.reset();
+        rig->skeleton.releasePose(rig->bind_pose);
+        rig->skeleton.releasePose(rig->pose);
+    }
+
+    size_t written = target.getWrittenCount();
+    std::cerr << written << " previews written in " << elapsed_ms << " ms";
+    if (elapsed_ms > 0)
+        std::cerr << " (" << written / (elapsed_ms / 1000.0) << " images/s)";
+    std::cerr << std::endl;
+
+    return failures + int(target.getFailureCount());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds one run of a metric to the suite's metrics, adding the
+///         metric if it's the first.
+void addPerfRun(std::vector<PerfMetric>& metrics, const std::string& name, const char* unit, double value)
+{
+    for (size_t i = 0; i < metrics.size(); ++i)
+    {
+        if (metrics[i].name == name)
+        {
+            metrics[i].runs.push_back(value);
+            return;
+        }
+    }
+
+    PerfMetric metric;
+    metric.name = name;
+    metric.unit = unit;
+    metric.runs.push_back(value);
+    metric.median = 0;
+    metric.mad = 0;
+    metrics.push_back(metric);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs the perf suite on one rig, repeat times over, compares each
+///         metric with this machine's baseline in the results file, and
+///         writes the comparisons to stdout.
+///
+/// \details Each repetition times:
+///
+///         - building and uploading the rig ("load/rig") and loading it
+///           back from a mesh file ("load/mesh_file"), which is written
+///           next to the results file first;
+///         - each enabled backend's median frame ("frame/<backend>"), from
+///           posing the hierarchy on the CPU to glFinish();
+///         - the CPU kernels, hierarchy and blending among them, at each of
+///           kernel_joint_counts, in nanoseconds per joint
+///           ("kernel/<kernel>/<path>/<cache>/<joints>").
+///
+///         Every metric is summarized by its median and MAD over the
+///         repetitions.  If there's no baseline for this machine yet, or
+///         record is set, the run becomes the machine's baseline: the file
+///         keeps every other machine's as it was.  A backend which can't
+///         run on this context is skipped, with a message, and left out.
+///
+/// \return The number of metrics which regressed, or 1 if the results file
+///         couldn't be read or written.
+int runPerfSuite(const std::string& results_path, bool record, size_t repeats, double threshold, bool json,
+                 const RigConfig& config, VertexFormat format, const std::vector<char>& enabled, size_t frames,
+                 size_t warmup_frames, size_t max_palette_joints, const std::vector<size_t>& kernel_joint_counts,
+                 const std::string& renderer, const std::string& version, ThreadPool& thread_pool)
+{
+    std::vector<PerfBaseline> baselines;
+    if (!readPerfBaselines(results_path, baselines))
+        return 1;
+
+    std::unique_ptr<Rig> rig(new Rig());
+    initRig(config, format, *rig);
+
+    std::string mesh_path = results_path + ".mesh";
+    saveMeshFile(rig->mesh.vertices, rig->mesh.indices, format, mesh_path);
+
+    std::vector<char> skipped(N_BACKENDS, 0);
+    std::vector<PerfMetric> metrics;
+    for (size_t repeat = 0; repeat < repeats; ++repeat)
+    {
+        std::cerr << "Perf suite run " << repeat + 1 << " of " << repeats << std::endl;
+
+        double start = getTimeMilliseconds();
+        std::unique_ptr<Rig> loaded_rig(new Rig());
+        initRig(config, format, *loaded_rig);
+        glFinish();
+        addPerfRun(metrics, "load/rig", "ms", getTimeMilliseconds() - start);
+        loaded_rig->skeleton.releasePose(loaded_rig->bind_pose);
+        loaded_rig->skeleton.releasePose(loaded_rig->pose);
+        loaded_rig.reset();
+
+        start = getTimeMilliseconds();
+        {
+            SkeletalMesh mesh;
+            loadMeshFile(mesh, mesh_path);
+            glFinish();
+            addPerfRun(metrics, "load/mesh_file", "ms", getTimeMilliseconds() - start);
+        }
+
+        for (size_t backend = 0; backend < N_BACKENDS; ++backend)
+        {
+            if (!enabled[backend] || skipped[backend])
+                continue;
+
+            try
+            {
+                BenchmarkResult result = runBackend(Backend(backend), config, *rig, thread_pool, frames,
+                                                    warmup_frames, max_palette_joints);
+                addPerfRun(metrics, std::string("frame/") + BACKEND_NAMES[backend], "ms", result.frame_p50_ms);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Skipping " << BACKEND_NAMES[backend] << ": " << e.what() << std::endl;
+                skipped[backend] = 1;
+            }
+        }
+
+        std::vector<KernelResult> kernel_results;
+        runKernelBenchmarks(kernel_joint_counts, std::vector<size_t>(1, 100), kernel_results);
+        for (size_t i = 0; i < kernel_results.size(); ++i)
+        {
+            const KernelResult& r = kernel_results[i];
+            std::ostringstream name;
+            name << "kernel/" << r.kernel << "/" << r.path << "/" << (r.cold ? "cold" : "warm") << "/" << r.joint_count;
+            addPerfRun(metrics, name.str(), "ns/joint", r.ns_per_joint_p50);
+        }
+    }
+
+    std::remove(mesh_path.c_str());
+    rig->skeleton.releasePose(rig->bind_pose);
+    rig->skeleton.releasePose(rig->pose);
+
+    // a backend which failed partway through has fewer runs than the
+    // others, so it isn't compared.
+    std::vector<PerfMetric> complete;
+    for (size_t i = 0; i < metrics.size(); ++i)
+    {
+        if (metrics[i].runs.size() == repeats)
+        {
+            summarizePerfMetric(metrics[i]);
+            complete.push_back(metrics[i]);
+        }
+    }
+
+    std::string fingerprint = getPerfFingerprint(renderer, version);
+    std::vector<PerfComparison> comparisons;
+    size_t regressions = comparePerfMetrics(fingerprint, complete, baselines, threshold, comparisons);
+    if (json)
+        writePerfJson(std::cout, comparisons, fingerprint, threshold);
+    else
+        writePerfCsv(std::cout, comparisons, fingerprint);
+
+    if (record || !hasPerfBaselines(fingerprint, baselines))
+    {
+        recordPerfBaselines(fingerprint, complete, baselines);
+        if (!writePerfBaselines(results_path, baselines))
+            return 1;
+        std::cerr << "Recorded " << complete.size() << " baselines for " << fingerprint << std::endl;
+        return 0;
+    }
+
+    std::cerr << regressions << " of " << comparisons.size() << " metrics regressed by more than "
+              << threshold * 100 << "%" << std::endl;
+    return int(regressions);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses a comma separated list of positive numbers.
+///
+/// \return false if any of the list isn't a positive number.
+bool parseSizeList(const std::string& text, std::vector<size_t>& values)
+{
+    values.clear();
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        char* end = nullptr;
+        long value = std::strtol(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || value <= 0)
+            return false;
+        values.push_back(size_t(value));
+    }
+
+    return !values.empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Escapes a string for use inside double quotes in JSON or CSV.
+std::string quote(const std::string& text, bool json)
+{
+    std::string quoted = "\"";
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '"')
+            quoted += json ? "\\\"" : "\"\"";
+        else if (text[i] == '\\' && json)
+            quoted += "\\\\";
+        else
+            quoted += text[i];
+    }
+
+    return quoted + "\"";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the results as CSV, one row per backend and rig.
+void writeCsv(std::ostream& out, const std::vector<BenchmarkResult>& results,
+              VertexFormat format, const std::string& renderer)
+{
+    out << "backend,vertex_format,vertices,joints,influences,frames,"
+           "frame_mean_ms,frame_p50_ms,frame_p90_ms,frame_p99_ms,gpu_mean_ms,vertices_per_second,renderer" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& r = results[i];
+        out << BACKEND_NAMES[r.backend] << ',' << FORMAT_NAMES[format] << ','
+            << r.vertex_count << ',' << r.rig.joint_count << ',' << r.rig.influence_count << ',' << r.frames << ','
+            << r.frame_mean_ms << ',' << r.frame_p50_ms << ',' << r.frame_p90_ms << ',' << r.frame_p99_ms << ','
+            << r.gpu_mean_ms << ',' << r.vertices_per_second << ',' << quote(renderer, false) << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the results as a JSON object, with the renderer and
+///         version strings identifying the hardware.
+void writeJson(std::ostream& out, const std::vector<BenchmarkResult>& results,
+               VertexFormat format, const std::string& renderer, const std::string& version)
+{
+    out << "{" << std::endl
+        << "  \"renderer\": " << quote(renderer, true) << "," << std::endl
+        << "  \"version\": " << quote(version, true) << "," << std::endl
+        << "  \"vertex_format\": \"" << FORMAT_NAMES[format] << "\"," << std::endl
+        << "  \"results\": [" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& r = results[i];
+        out << "    { \"backend\": \"" << BACKEND_NAMES[r.backend] << "\""
+            << ", \"vertices\": " << r.vertex_count
+            << ", \"joints\": " << r.rig.joint_count
+            << ", \"influences\": " << r.rig.influence_count
+            << ", \"frames\": " << r.frames
+            << ", \"frame_mean_ms\": " << r.frame_mean_ms
+            << ", \"frame_p50_ms\": " << r.frame_p50_ms
+            << ", \"frame_p90_ms\": " << r.frame_p90_ms
+            << ", \"frame_p99_ms\": " << r.frame_p99_ms
+            << ", \"gpu_mean_ms\": " << r.gpu_mean_ms
+            << ", \"vertices_per_second\": " << r.vertices_per_second
+            << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl
+        << "}" << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the -stress results as CSV, one row per backend and rig.
+void writeStressCsv(std::ostream& out, const std::vector<StressResult>& results, VertexFormat format,
+                    double budget_ms, const std::string& renderer)
+{
+    out << "backend,vertex_format,vertices,joints,influences,budget_ms,grid_size,instances,"
+           "frame_mean_ms,gpu_mean_ms,renderer" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const StressResult& r = results[i];
+        out << BACKEND_NAMES[r.backend] << ',' << FORMAT_NAMES[format] << ','
+            << r.vertex_count << ',' << r.rig.joint_count << ',' << r.rig.influence_count << ',' << budget_ms << ','
+            << r.grid_size << ',' << r.instance_count << ',' << r.frame_mean_ms << ',' << r.gpu_mean_ms << ','
+            << quote(renderer, false) << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the -stress results as a JSON object, with the renderer
+///         and version strings identifying the hardware.
+void writeStressJson(std::ostream& out, const std::vector<StressResult>& results, VertexFormat format,
+                     double budget_ms, const std::string& renderer, const std::string& version)
+{
+    out << "{" << std::endl
+        << "  \"renderer\": " << quote(renderer, true) << "," << std::endl
+        << "  \"version\": " << quote(version, true) << "," << std::endl
+        << "  \"vertex_format\": \"" << FORMAT_NAMES[format] << "\"," << std::endl
+        << "  \"budget_ms\": " << budget_ms << "," << std::endl
+        << "  \"stress\": [" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const StressResult& r = results[i];
+        out << "    { \"backend\": \"" << BACKEND_NAMES[r.backend] << "\""
+            << ", \"vertices\": " << r.vertex_count
+            << ", \"joints\": " << r.rig.joint_count
+            << ", \"influences\": " << r.rig.influence_count
+            << ", \"grid_size\": " << r.grid_size
+            << ", \"instances\": " << r.instance_count
+            << ", \"frame_mean_ms\": " << r.frame_mean_ms
+            << ", \"gpu_mean_ms\": " << r.gpu_mean_ms
+            << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl
+        << "}" << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the kernel microbenchmark results as CSV, one row per
+///         kernel implementation and configuration.
+void writeKernelCsv(std::ostream& out, const std::vector<KernelResult>& results)
+{
+    out << "kernel,path,cache,joints,instances,samples,ns_per_joint_p50,ns_per_joint_mean" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const KernelResult& r = results[i];
+        out << r.kernel << ',' << r.path << ',' << (r.cold ? "cold" : "warm") << ','
+            << r.joint_count << ',' << r.instance_count << ',' << r.samples << ','
+            << r.ns_per_joint_p50 << ',' << r.ns_per_joint_mean << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the kernel microbenchmark results as a JSON object.
+void writeKernelJson(std::ostream& out, const std::vector<KernelResult>& results)
+{
+    out << "{" << std::endl
+        << "  \"kernels\": [" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const KernelResult& r = results[i];
+        out << "    { \"kernel\": \"" << r.kernel << "\""
+            << ", \"path\": \"" << r.path << "\""
+            << ", \"cache\": \"" << (r.cold ? "cold" : "warm") << "\""
+            << ", \"joints\": " << r.joint_count
+            << ", \"instances\": " << r.instance_count
+            << ", \"samples\": " << r.samples
+            << ", \"ns_per_joint_p50\": " << r.ns_per_joint_p50
+            << ", \"ns_per_joint_mean\": " << r.ns_per_joint_mean
+            << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl
+        << "}" << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a result's worst joints as joint:error pairs, separated
+///         by spaces.
+std::string formatWorstJoints(const AccuracyResult& result)
+{
+    std::ostringstream out;
+    for (size_t i = 0; i < result.worst_joints.size(); ++i)
+        out << (i > 0 ? " " : "") << result.worst_joints[i].joint << ':' << result.worst_joints[i].max_error;
+    return out.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the accuracy results as CSV, one row per path and rig.
+void writeAccuracyCsv(std::ostream& out, const std::vector<AccuracyResult>& results)
+{
+    out << "path,vertices,joints,influences,poses,bytes,reference_bytes,max_error,rms_error,worst_joints" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const AccuracyResult& r = results[i];
+        out << r.path << ',' << r.vertex_count << ',' << r.joint_count << ',' << r.influence_count << ','
+            << r.pose_count << ',' << r.bytes << ',' << r.reference_bytes << ','
+            << r.max_error << ',' << r.rms_error << ',' << formatWorstJoints(r) << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the accuracy results as a JSON object.
+void writeAccuracyJson(std::ostream& out, const std::vector<AccuracyResult>& results)
+{
+    out << "{" << std::endl
+        << "  \"accuracy\": [" << std::endl;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const AccuracyResult& r = results[i];
+        out << "    { \"path\": \"" << r.path << "\""
+            << ", \"vertices\": " << r.vertex_count
+            << ", \"joints\": " << r.joint_count
+            << ", \"influences\": " << r.influence_count
+            << ", \"poses\": " << r.pose_count
+            << ", \"bytes\": " << r.bytes
+            << ", \"reference_bytes\": " << r.reference_bytes
+            << ", \"max_error\": " << r.max_error
+            << ", \"rms_error\": " << r.rms_error
+            << ", \"worst_joints\": [";
+        for (size_t j = 0; j < r.worst_joints.size(); ++j)
+        {
+            out << (j > 0 ? ", " : "") << "{ \"joint\": " << r.worst_joints[j].joint
+                << ", \"max_error\": " << r.worst_joints[j].max_error << " }";
+        }
+        out << "] }" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl
+        << "}" << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the command line usage to stderr.
+void printUsage()
+{
+    std::cerr << "Usage: SkinningBenchmark [-vertices N,...] [-joints N,...] [-influences N,...]" << std::endl
+              << "                         [-format full|packed|half|quantized] [-frames N]" << std::endl
+              << "                         [-warmup N] [-backends name,...] [-palette-joints N]" << std::endl
+              << "                         [-simd level] [-output csv|json] [-platform glut|glfw|egl]" << std::endl << std::endl
+              << "Runs each skinning backend on a synthetic strip mesh for every combination" << std::endl
+              << "of the given sizes, and writes the results to stdout." << std::endl << std::endl
+              << "  -vertices    Vertex counts to test (default: 10000,100000)." << std::endl
+              << "  -joints      Joint counts to test (default: 32)." << std::endl
+              << "  -influences  Joints influencing each vertex, 1 to 4 (default: 4)." << std::endl
+              << "  -format      The vertex format to upload (default: half); quantized stores" << std::endl
+              << "               16-bit positions relative to the mesh's bounds." << std::endl
+              << "  -frames      The number of frames to measure (default: 300)." << std::endl
+              << "  -warmup      The number of frames to run first (default: 30)." << std::endl
+              << "  -backends    Any of separate, palette, dual_quat, affine_2d, split, feedback," << std::endl
+              << "               compute, cpu, meshlet and joint_local (default: all)." << std::endl
+              << "  -palette-joints  The most joints in each of split's sub-mesh palettes" << std::endl
+              << "               (default: as many as a uniform block holds)." << std::endl
+              << "  -simd        The most capable CPU skinning kernel cpu may use: scalar, sse2," << std::endl
+              << "               avx2, avx512 or neon (default: the best this CPU runs)." << std::endl
+              << "  -output      The report format (default: csv)." << std::endl
+              << "  -platform    What creates the GL context: glut, glfw, or egl, which needs no" << std::endl
+              << "               display (default: glut)." << std::endl << std::endl
+              << "       SkinningBenchmark -stress [-budget ms] [rig, format and backend options]" << std::endl << std::endl
+              << "Draws a grid of instances of each rig with each backend, every instance at" << std::endl
+              << "its own phase of the animation, and grows the grid until a frame takes longer" << std::endl
+              << "than the budget.  Reports the most instances each backend drew within it." << std::endl << std::endl
+              << "  -budget      The frame budget in milliseconds (default: " << DEFAULT_STRESS_BUDGET_MS << ")." << std::endl << std::endl
+              << "       SkinningBenchmark -suite results.txt [-record] [-repeat N] [-threshold percent]" << std::endl
+              << "                         [rig, format, frame and backend options] [-output csv|json]" << std::endl << std::endl
+              << "Times rig and mesh file loads, each backend's frame and the CPU kernels on the" << std::endl
+              << "first rig size, several times over, and compares each median with this machine's" << std::endl
+              << "baseline in the results file.  Exits with the number of metrics which slowed down" << std::endl
+              << "by more than the threshold and the runs' noise.  The first run on a machine, or" << std::endl
+              << "one with -record, stores its results as the machine's baseline instead." << std::endl << std::endl
+              << "  -repeat      The number of times to run everything (default: 5)." << std::endl
+              << "  -threshold   The slowdown to flag, in percent (default: " << DEFAULT_PERF_THRESHOLD * 100 << ")." << std::endl << std::endl
+              << "       SkinningBenchmark -kernels [-joints N,...] [-instances N,...] [-output csv|json]" << std::endl << std::endl
+              << "Times the CPU pose and palette kernels on their own, warm and cold, without" << std::endl
+              << "creating a GL context, and reports nanoseconds per joint." << std::endl << std::endl
+              << "  -joints      Joint counts to test (default: 7,32,128,512)." << std::endl
+              << "  -instances   Instances processed per sample (default: 1,100,10000)." << std::endl << std::endl
+              << "       SkinningBenchmark -accuracy [-vertices N,...] [-joints N,...] [-influences N,...]" << std::endl
+              << "                         [-frames N] [-simd level] [-output csv|json]" << std::endl << std::endl
+              << "Skins each rig through the full float reference and each compressed or" << std::endl
+              << "optimized path (the packed, half and quantized vertex formats, dual" << std::endl
+              << "quaternions, 2D affine palettes, the CPU kernel and a compressed clip) in" << std::endl
+              << "every frame of the animation, without creating a GL context, and reports" << std::endl
+              << "each path's size, max and RMS vertex error in clip space, and worst joints." << std::endl << std::endl
+              << "  -frames      The number of poses to test (default: 300)." << std::endl << std::endl
+              << "       SkinningBenchmark -previews jobs.txt [-size N] [-format full|packed|half|quantized]" << std::endl << std::endl
+              << "Renders a preview image for each line of the job list, offscreen and back to" << std::endl
+              << "back, and writes them as TGA files.  Each line is:" << std::endl << std::endl
+              << "  output.tga vertices joints influences frame [center_x center_y zoom]" << std::endl << std::endl
+              << "  -size        The width and height of the images (default: 256)." << std::endl << std::endl
+              << "       SkinningBenchmark -split N [-frames N] [-platform glut|glfw|egl]" << std::endl << std::endl
+              << "Draws a crowd split between N contexts, on each of the platform's GPUs in" << std::endl
+              << "turn, composites the other contexts' shares on the first, and checks every" << std::endl
+              << "frame against the crowd drawn by one context.  Exits with 1 if any differs." << std::endl;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses the command line, creates a hidden window (or, on EGL, an
+///         offscreen surface) for its GL context, then benchmarks every
+///         backend on every rig.
+///
+/// \details Everything is drawn into an offscreen framebuffer, so the
+///         window's size and visibility don't affect the results.  A backend
+///         which can't run a rig on this context is skipped with a message.
+///
+///         With -kernels, the CPU kernel microbenchmarks are run instead,
+///         and no window is created; likewise the accuracy tests with
+///         -accuracy.  With -previews, the jobs are rendered
+///         instead, into a PreviewTarget.  With -stress, each backend's
+///         largest grid of instances within the budget is found instead of
+///         its time per frame.  With -suite, the perf suite is run on the
+///         first of each rig size, and compared with the results file.
+///         With -split, the split frame check is run on the window's
+///         context and as many more as it asks for.
+int main(int argc, char** argv)
+{
+    PlatformType platform_type = PLATFORM_GLUT;
+    if (!findPlatformOption(argc, argv, platform_type))
+    {
+        printUsage();
+        return 1;
+    }
+    std::unique_ptr<Platform> platform(createPlatform(platform_type, argc, argv));
+    if (!platform)
+        return 1;
+
+    std::vector<size_t> vertex_counts(1, 10000);
+    vertex_counts.push_back(100000);
+    std::vector<size_t> joint_counts;
+    std::vector<size_t> instance_counts(1, 1);
+    instance_counts.push_back(100);
+    instance_counts.push_back(10000);
+    std::vector<size_t> influence_counts(1, 4);
+    VertexFormat format = VERTEX_FORMAT_PACKED_HALF;
+    size_t frames = 300;
+    size_t warmup_frames = 30;
+    size_t max_palette_joints = 0;
+    std::vector<char> enabled(N_BACKENDS, 1);
+    bool json = false;
+    bool kernels = false;
+    bool accuracy = false;
+    bool stress = false;
+    double stress_budget_ms = DEFAULT_STRESS_BUDGET_MS;
+    std::string previews_path;
+    GLsizei preview_size = 256;
+    SimdLevel simd_level = N_SIMD_LEVELS;
+    std::string suite_path;
+    bool record = false;
+    size_t repeats = 5;
+    double threshold_percent = DEFAULT_PERF_THRESHOLD * 100;
+    size_t split_renderers = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool valid = has_value;
+        if (arg == "-vertices" && has_value)
+            valid = parseSizeList(argv[++i], vertex_counts);
+        else if (arg == "-joints" && has_value)
+            valid = parseSizeList(argv[++i], joint_counts);
+        else if (arg == "-instances" && has_value)
+            valid = parseSizeList(argv[++i], instance_counts);
+        else if (arg == "-platform" && has_value)
+            ++i;
+        else if (arg == "-kernels")
+            kernels = valid = true;
+        else if (arg == "-accuracy")
+            accuracy = valid = true;
+        else if (arg == "-stress")
+            stress = valid = true;
+        else if (arg == "-suite" && has_value)
+            suite_path = argv[++i];
+        else if (arg == "-record")
+            record = valid = true;
+        else if (arg == "-repeat" && has_value)
+            repeats = size_t(std::atoi(argv[++i]));
+        else if (arg == "-threshold" && has_value)
+            threshold_percent = std::atof(argv[++i]);
+        else if (arg == "-budget" && has_value)
+            stress_budget_ms = std::atof(argv[++i]);
+        else if (arg == "-previews" && has_value)
+            previews_path = argv[++i];
+        else if (arg == "-size" && has_value)
+            preview_size = GLsizei(std::atoi(argv[++i]));
+        else if (arg == "-influences" && has_value)
+            valid = parseSizeList(argv[++i], influence_counts);
+        else if (arg == "-frames" && has_value)
+            frames = size_t(std::atoi(argv[++i]));
+        else if (arg == "-split" && has_value)
+        {
+            split_renderers = size_t(std::atoi(argv[++i]));
+            valid = split_renderers >= 2;
+        }
+        else if (arg == "-warmup" && has_value)
+            warmup_frames = size_t(std::atoi(argv[++i]));
+        else if (arg == "-palette-joints" && has_value)
+            max_palette_joints = size_t(std::atoi(argv[++i]));
+        else if (arg == "-simd" && has_value)
+            valid = parseSimdLevel(argv[++i], simd_level);
+        else if (arg == "-format" && has_value)
+        {
+            std::string name = argv[++i];
+            if (name == "full")
+                format = VERTEX_FORMAT_FULL;
+            else if (name == "packed")
+                format = VERTEX_FORMAT_PACKED;
+            else if (name == "half")
+                format = VERTEX_FORMAT_PACKED_HALF;
+            else if (name == "quantized")
+                format = VERTEX_FORMAT_QUANTIZED;
+            else
+                valid = false;
+        }
+        else if (arg == "-output" && has_value)
+        {
+            std::string name = argv[++i];
+            json = name == "json";
+            valid = json || name == "csv";
+        }
+        else if (arg == "-backends" && has_value)
+        {
+            enabled.assign(N_BACKENDS, 0);
+            std::istringstream names(argv[++i]);
+            std::string name;
+            while (std::getline(names, name, ','))
+            {
+                size_t backend = 0;
+                while (backend < N_BACKENDS && name != BACKEND_NAMES[backend])
+                    ++backend;
+
+                if (backend == N_BACKENDS)
+                    valid = false;
+                else
+                    enabled[backend] = 1;
+            }
+        }
+        else
+            valid = false;
+
+        if (!valid || frames == 0 || preview_size <= 0 || stress_budget_ms <= 0 || repeats == 0 ||
+            threshold_percent <= 0)
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (kernels)
+    {
+        if (joint_counts.empty())
+        {
+            size_t defaults[] = { 7, 32, 128, 512 };
+            joint_counts.assign(defaults, defaults + 4);
+        }
+
+        std::vector<KernelResult> kernel_results;
+        runKernelBenchmarks(joint_counts, instance_counts, kernel_results);
+
+        if (json)
+            writeKernelJson(std::cout, kernel_results);
+        else
+            writeKernelCsv(std::cout, kernel_results);
+
+        return 0;
+    }
+
+    if (accuracy)
+    {
+        if (joint_counts.empty())
+            joint_counts.push_back(32);
+        if (simd_level != N_SIMD_LEVELS)
+            setSkinningSimdLevel(simd_level);
+
+        std::vector<AccuracyResult> accuracy_results;
+        runAccuracyTests(vertex_counts, joint_counts, influence_counts, frames, accuracy_results);
+
+        if (json)
+            writeAccuracyJson(std::cout, accuracy_results);
+        else
+            writeAccuracyCsv(std::cout, accuracy_results);
+
+        return 0;
+    }
+
+    std::vector<PreviewJob> preview_jobs;
+    if (!previews_path.empty() && !readPreviewJobs(previews_path, preview_jobs))
+        return 1;
+
+    if (joint_counts.empty())
+        joint_counts.push_back(32);
+
+    // the window is only needed for its context.
+    WindowDesc window_desc;
+    window_desc.title = "Skinning Benchmark";
+    window_desc.width = 64;
+    window_desc.height = 64;
+    window_desc.double_buffered = false;
+    window_desc.visible = false;
+    PlatformWindow* window = platform->createWindow(window_desc);
+    if (window == nullptr || !platform->initGlew())
+        return 1;
+
+    std::string renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    std::string version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    std::cerr << "Renderer: " << renderer << " (OpenGL " << version << ")" << std::endl;
+
+    if (split_renderers > 0)
+        return runSplitFrameCheck(*platform, *window, split_renderers, frames) ? 0 : 1;
+
+    if (simd_level != N_SIMD_LEVELS)
+        setSkinningSimdLevel(simd_level);
+    std::cerr << "CPU skinning kernel: " << getSimdLevelName(getSkinningSimdLevel())
+              << " (CPU supports " << getSimdLevelName(detectSimdLevel()) << ")" << std::endl;
+
+    // the skinning and passthrough programs draw through a Camera block;
+    // the benchmark's camera never moves from the -1 to 1 square.
+    GLuint camera_buffer_id = 0;
+    CameraBlock camera_block = Camera().getBlock();
+    glGenBuffers(1, &camera_buffer_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, camera_buffer_id);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(camera_block), &camera_block, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, camera_buffer_id);
+
+    if (!previews_path.empty())
+    {
+        ThreadPool thread_pool;
+        try
+        {
+            return runPreviews(preview_jobs, format, preview_size, thread_pool);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Previews failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    GLuint framebuffer_id = 0;
+    GLuint renderbuffer_id = 0;
+    glGenRenderbuffers(1, &renderbuffer_id);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_id);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TARGET_SIZE, TARGET_SIZE);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer_id);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer_id);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "The offscreen framebuffer is incomplete!" << std::endl;
+        return 1;
+    }
+    glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+    glClearColor(0, 0, 0, 0);
+
+    ThreadPool thread_pool;
+    if (!suite_path.empty())
+    {
+        RigConfig config;
+        config.vertex_count = vertex_counts[0];
+        config.joint_count = joint_counts[0];
+        config.influence_count = influence_counts[0];
+
+        int regressions = 0;
+        try
+        {
+            regressions = runPerfSuite(suite_path, record, repeats, threshold_percent / 100, json, config, format,
+                                       enabled, frames, warmup_frames, max_palette_joints, joint_counts, renderer,
+                                       version, thread_pool);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "The perf suite failed: " << e.what() << std::endl;
+            regressions = 1;
+        }
+
+        glDeleteFramebuffers(1, &framebuffer_id);
+        glDeleteRenderbuffers(1, &renderbuffer_id);
+        glDeleteBuffers(1, &camera_buffer_id);
+        return regressions;
+    }
+
+    std::vector<BenchmarkResult> results;
+    std::vector<StressResult> stress_results;
+    int failures = 0;
+
+    for (size_t v = 0; v < vertex_counts.size(); ++v)
+    {
+        for (size_t j = 0; j < joint_counts.size(); ++j)
+        {
+            for (size_t n = 0; n < influence_counts.size(); ++n)
+            {
+                RigConfig config;
+                config.vertex_count = vertex_counts[v];
+                config.joint_count = joint_counts[j];
+                config.influence_count = influence_counts[n];
+
+                std::ostringstream rig_name;
+                rig_name << config.vertex_count << " vertices, " << config.joint_count << " joints, "
+                         << config.influence_count << " influences";
+
+                std::unique_ptr<Rig> rig(new Rig());
+                try
+                {
+                    initRig(config, format, *rig);
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << "Skipping " << rig_name.str() << ": " << e.what() << std::endl;
+                    ++failures;
+                    continue;
+                }
+
+                for (size_t backend = 0; backend < N_BACKENDS; ++backend)
+                {
+                    if (!enabled[backend])
+                        continue;
+
+                    try
+                    {
+                        if (stress)
+                        {
+                            StressResult result = runStress(Backend(backend), config, *rig, thread_pool,
+                                                            stress_budget_ms, max_palette_joints);
+                            std::cerr << BACKEND_NAMES[backend] << ", " << rig_name.str() << ": "
+                                      << result.instance_count << " instances (" << result.grid_size << "x"
+                                      << result.grid_size << ") in " << result.frame_mean_ms << " ms/frame"
+                                      << std::endl;
+                            stress_results.push_back(result);
+                        }
+                        else
+                        {
+                            BenchmarkResult result = runBackend(Backend(backend), config, *rig, thread_pool,
+                                                                frames, warmup_frames, max_palette_joints);
+                            std::cerr << BACKEND_NAMES[backend] << ", " << rig_name.str() << ": "
+                                      << result.frame_mean_ms << " ms/frame, "
+                                      << result.vertices_per_second << " vertices/s" << std::endl;
+                            results.push_back(result);
+                        }
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::cerr << "Skipping " << BACKEND_NAMES[backend] << ", " << rig_name.str() << ": "
+                                  << e.what() << std::endl;
+                        ++failures;
+                    }
+                }
+
+                rig->skeleton.releasePose(rig->bind_pose);
+                rig->skeleton.releasePose(rig->pose);
+            }
+        }
+    }
+
+    if (stress && json)
+        writeStressJson(std::cout, stress_results, format, stress_budget_ms, renderer, version);
+    else if (stress)
+        writeStressCsv(std::cout, stress_results, format, stress_budget_ms, renderer);
+    else if (json)
+        writeJson(std::cout, results, format, renderer, version);
+    else
+        writeCsv(std::cout, results, format, renderer);
+
+    glDeleteFramebuffers(1, &framebuffer_id);
+    glDeleteRenderbuffers(1, &renderbuffer_id);
+    glDeleteBuffers(1, &camera_buffer_id);
+
+    return failures;
+}
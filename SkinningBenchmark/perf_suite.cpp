@@ -0,0 +1,316 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  perf_suite.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the perf suite's baselines and comparisons.
+
+#include "perf_suite.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+/// Scales a median absolute deviation to the standard deviation of normally
+/// distributed runs with the same spread.
+const double MAD_TO_SIGMA = 1.4826;
+
+/// How many standard deviations, from the MAD, a change has to exceed to be
+/// more than noise.
+const double NOISE_SIGMAS = 3.0;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the median of some values, or 0 if there are none.
+double getMedian(std::vector<double> values)
+{
+    if (values.empty())
+        return 0;
+
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double median = values[middle];
+    if (values.size() % 2 == 0)
+        median = (median + *std::max_element(values.begin(), values.begin() + middle)) / 2;
+    return median;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Replaces the tabs and line breaks in a string with spaces, so it
+///         can be a field of the results file.
+std::string flatten(const std::string& text)
+{
+    std::string flat = text;
+    for (size_t i = 0; i < flat.size(); ++i)
+    {
+        if (flat[i] == '\t' || flat[i] == '\n' || flat[i] == '\r')
+            flat[i] = ' ';
+    }
+    return flat;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Escapes a string for use inside double quotes in JSON or CSV.
+std::string quote(const std::string& text, bool json)
+{
+    std::string quoted = "\"";
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '"')
+            quoted += json ? "\\\"" : "\"\"";
+        else if (text[i] == '\\' && json)
+            quoted += "\\\\";
+        else
+            quoted += text[i];
+    }
+
+    return quoted + "\"";
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a string identifying the machine the suite is running
+///         on, which its baselines are recorded under.
+///
+/// \details A timing is only comparable with one from the same GPU, driver,
+///         CPU kernel and thread count, so the fingerprint is all four;
+///         changing any of them starts a new set of baselines rather than
+///         flagging every metric at once.
+///
+/// \param  renderer The GL_RENDERER string.
+/// \param  version The GL_VERSION string, which names the driver.
+std::string getPerfFingerprint(const std::string& renderer, const std::string& version)
+{
+    std::ostringstream fingerprint;
+    fingerprint << renderer << " | OpenGL " << version << " | " << getSimdLevelName(detectSimdLevel())
+                << " | " << std::thread::hardware_concurrency() << " threads";
+    return flatten(fingerprint.str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Works out a metric's median and median absolute deviation from
+///         its runs.
+void summarizePerfMetric(PerfMetric& metric)
+{
+    metric.median = getMedian(metric.runs);
+
+    std::vector<double> deviations(metric.runs.size());
+    for (size_t i = 0; i < metric.runs.size(); ++i)
+        deviations[i] = std::abs(metric.runs[i] - metric.median);
+    metric.mad = getMedian(deviations);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads the baselines in a results file, every machine's.
+///
+/// \details Each line is a fingerprint, a metric name, its median, MAD and
+///         number of runs, separated by tabs; lines starting with # are
+///         comments.  A file which doesn't exist holds no baselines yet.
+///
+/// \return false, after reporting it to stderr, if the file can't be parsed.
+bool readPerfBaselines(const std::string& path, std::vector<PerfBaseline>& baselines)
+{
+    baselines.clear();
+    std::ifstream in(path.c_str());
+    if (!in)
+        return true;
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        PerfBaseline baseline;
+        std::string median;
+        std::string mad;
+        std::string runs;
+        if (!std::getline(fields, baseline.fingerprint, '\t') || !std::getline(fields, baseline.metric, '\t') ||
+            !std::getline(fields, median, '\t') || !std::getline(fields, mad, '\t') || !std::getline(fields, runs))
+        {
+            std::cerr << path << ":" << line_number << ": expected fingerprint, metric, median, mad and runs"
+                      << std::endl;
+            return false;
+        }
+
+        baseline.median = std::atof(median.c_str());
+        baseline.mad = std::atof(mad.c_str());
+        baseline.runs = size_t(std::atoi(runs.c_str()));
+        baselines.push_back(baseline);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes baselines to a results file, replacing what it held.
+///
+/// \return false, after reporting it to stderr, if the file can't be
+///         written.
+bool writePerfBaselines(const std::string& path, const std::vector<PerfBaseline>& baselines)
+{
+    std::ofstream out(path.c_str());
+    if (!out)
+    {
+        std::cerr << "Can't write the perf baselines to " << path << "!" << std::endl;
+        return false;
+    }
+
+    out.precision(9);
+    out << "# SkinningBenchmark -suite baselines: fingerprint, metric, median, mad, runs" << std::endl;
+    for (size_t i = 0; i < baselines.size(); ++i)
+    {
+        const PerfBaseline& b = baselines[i];
+        out << b.fingerprint << '\t' << b.metric << '\t' << b.median << '\t' << b.mad << '\t' << b.runs << std::endl;
+    }
+
+    return bool(out);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Replaces a machine's baselines with a run's metrics, leaving the
+///         other machines' alone.
+void recordPerfBaselines(const std::string& fingerprint, const std::vector<PerfMetric>& metrics,
+                         std::vector<PerfBaseline>& baselines)
+{
+    std::vector<PerfBaseline> kept;
+    for (size_t i = 0; i < baselines.size(); ++i)
+    {
+        if (baselines[i].fingerprint != fingerprint)
+            kept.push_back(baselines[i]);
+    }
+
+    for (size_t i = 0; i < metrics.size(); ++i)
+    {
+        PerfBaseline baseline;
+        baseline.fingerprint = fingerprint;
+        baseline.metric = metrics[i].name;
+        baseline.median = metrics[i].median;
+        baseline.mad = metrics[i].mad;
+        baseline.runs = metrics[i].runs.size();
+        kept.push_back(baseline);
+    }
+
+    baselines.swap(kept);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if any baselines were recorded on a machine.
+bool hasPerfBaselines(const std::string& fingerprint, const std::vector<PerfBaseline>& baselines)
+{
+    for (size_t i = 0; i < baselines.size(); ++i)
+    {
+        if (baselines[i].fingerprint == fingerprint)
+            return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compares each of a run's metrics with its baseline on the same
+///         machine.
+///
+/// \details A metric has only regressed if its median has grown by more
+///         than threshold of the baseline's, and by more than NOISE_SIGMAS
+///         standard deviations, estimated from the larger of the two MADs;
+///         a change within the runs' own spread can't be told from noise,
+///         however large it is.  Improvements are judged the same way.
+///
+/// \param  threshold The fraction of the baseline a median may change by,
+///         like DEFAULT_PERF_THRESHOLD.
+/// \return The number of metrics which regressed.
+size_t comparePerfMetrics(const std::string& fingerprint, const std::vector<PerfMetric>& metrics,
+                          const std::vector<PerfBaseline>& baselines, double threshold,
+                          std::vector<PerfComparison>& comparisons)
+{
+    comparisons.clear();
+    size_t regressions = 0;
+    for (size_t i = 0; i < metrics.size(); ++i)
+    {
+        const PerfMetric& metric = metrics[i];
+        PerfComparison comparison;
+        comparison.metric = &metric;
+        comparison.baseline_median = 0;
+        comparison.baseline_mad = 0;
+        comparison.change = 0;
+        comparison.status = PERF_NEW;
+
+        for (size_t b = 0; b < baselines.size(); ++b)
+        {
+            const PerfBaseline& baseline = baselines[b];
+            if (baseline.fingerprint != fingerprint || baseline.metric != metric.name || baseline.median <= 0)
+                continue;
+
+            double delta = metric.median - baseline.median;
+            double noise = NOISE_SIGMAS * MAD_TO_SIGMA * std::max(metric.mad, baseline.mad);
+            comparison.baseline_median = baseline.median;
+            comparison.baseline_mad = baseline.mad;
+            comparison.change = delta / baseline.median;
+            comparison.status = PERF_UNCHANGED;
+            if (std::abs(comparison.change) > threshold && std::abs(delta) > noise)
+                comparison.status = delta > 0 ? PERF_REGRESSED : PERF_IMPROVED;
+            break;
+        }
+
+        if (comparison.status == PERF_REGRESSED)
+            ++regressions;
+        comparisons.push_back(comparison);
+    }
+
+    return regressions;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the comparisons as CSV, one row per metric.
+void writePerfCsv(std::ostream& out, const std::vector<PerfComparison>& comparisons, const std::string& fingerprint)
+{
+    out << "metric,unit,runs,median,mad,baseline_median,baseline_mad,change_percent,status,fingerprint" << std::endl;
+
+    for (size_t i = 0; i < comparisons.size(); ++i)
+    {
+        const PerfComparison& c = comparisons[i];
+        out << c.metric->name << ',' << c.metric->unit << ',' << c.metric->runs.size() << ','
+            << c.metric->median << ',' << c.metric->mad << ',' << c.baseline_median << ',' << c.baseline_mad << ','
+            << c.change * 100 << ',' << PERF_STATUS_NAMES[c.status] << ',' << quote(fingerprint, false) << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the comparisons as a JSON object, with the fingerprint
+///         and threshold they were made with.
+void writePerfJson(std::ostream& out, const std::vector<PerfComparison>& comparisons, const std::string& fingerprint,
+                   double threshold)
+{
+    out << "{" << std::endl
+        << "  \"fingerprint\": " << quote(fingerprint, true) << "," << std::endl
+        << "  \"threshold_percent\": " << threshold * 100 << "," << std::endl
+        << "  \"metrics\": [" << std::endl;
+
+    for (size_t i = 0; i < comparisons.size(); ++i)
+    {
+        const PerfComparison& c = comparisons[i];
+        out << "    { \"metric\": \"" << c.metric->name << "\""
+            << ", \"unit\": \"" << c.metric->unit << "\""
+            << ", \"runs\": " << c.metric->runs.size()
+            << ", \"median\": " << c.metric->median
+            << ", \"mad\": " << c.metric->mad
+            << ", \"baseline_median\": " << c.baseline_median
+            << ", \"baseline_mad\": " << c.baseline_mad
+            << ", \"change_percent\": " << c.change * 100
+            << ", \"status\": \"" << PERF_STATUS_NAMES[c.status] << "\""
+            << " }" << (i + 1 < comparisons.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl
+        << "}" << std::endl;
+}
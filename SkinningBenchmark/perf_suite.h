@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  perf_suite.h
+/// \author Ben Crist
+///
+/// \brief  Functions for keeping baselines of the benchmarks' timings, per
+///         machine, and flagging the timings which regress from them.
+
+#ifndef PERF_SUITE_H_
+#define PERF_SUITE_H_
+
+#include "demo.h"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/// The default fraction of its baseline a metric's median may grow by
+/// before it's a regression.
+const double DEFAULT_PERF_THRESHOLD = 0.05;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One thing the suite times, repeated, and summarized by its median
+///         and median absolute deviation, which a stray slow run barely
+///         moves.
+struct PerfMetric
+{
+    std::string name;           ///< What was timed, like "frame/palette" or "kernel/hierarchy/sse2/warm/32".
+    std::string unit;           ///< "ms" or "ns/joint"; lower is always better.
+    std::vector<double> runs;   ///< Each repetition's time.
+    double median;
+    double mad;                 ///< The median of the runs' distances from median.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A metric's recorded summary on one machine, as kept in the
+///         results file.
+struct PerfBaseline
+{
+    std::string fingerprint;    ///< The machine it was recorded on; see getPerfFingerprint().
+    std::string metric;
+    double median;
+    double mad;
+    size_t runs;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  How a metric compares with its baseline.
+enum PerfStatus
+{
+    PERF_NEW = 0,       ///< There's no baseline for it on this machine.
+    PERF_UNCHANGED,     ///< Within the threshold, or within the noise.
+    PERF_IMPROVED,      ///< Faster by more than the threshold and the noise.
+    PERF_REGRESSED,     ///< Slower by more than the threshold and the noise.
+    N_PERF_STATUSES
+};
+
+const char* const PERF_STATUS_NAMES[N_PERF_STATUSES] = { "new", "unchanged", "improved", "regressed" };
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One metric's comparison with its baseline.
+struct PerfComparison
+{
+    const PerfMetric* metric;
+    double baseline_median;     ///< 0 if the metric is new.
+    double baseline_mad;
+    double change;              ///< The median's change from the baseline's, as a fraction of it.
+    PerfStatus status;
+};
+
+std::string getPerfFingerprint(const std::string& renderer, const std::string& version);
+void summarizePerfMetric(PerfMetric& metric);
+
+bool readPerfBaselines(const std::string& path, std::vector<PerfBaseline>& baselines);
+bool writePerfBaselines(const std::string& path, const std::vector<PerfBaseline>& baselines);
+void recordPerfBaselines(const std::string& fingerprint, const std::vector<PerfMetric>& metrics,
+                         std::vector<PerfBaseline>& baselines);
+bool hasPerfBaselines(const std::string& fingerprint, const std::vector<PerfBaseline>& baselines);
+
+size_t comparePerfMetrics(const std::string& fingerprint, const std::vector<PerfMetric>& metrics,
+                          const std::vector<PerfBaseline>& baselines, double threshold,
+                          std::vector<PerfComparison>& comparisons);
+void writePerfCsv(std::ostream& out, const std::vector<PerfComparison>& comparisons, const std::string& fingerprint);
+void writePerfJson(std::ostream& out, const std::vector<PerfComparison>& comparisons, const std::string& fingerprint,
+                   double threshold);
+
+#endif
@@ -0,0 +1,966 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_accuracy.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the skinning accuracy tests.
+///
+/// \details The reference is the linear blend skinning of the vertex shader
+///         (vertex_shader_source with a precombined palette), done in full
+///         floats on the CPU from the full float vertices and the exact
+///         pose of every frame of the synthetic animation.  Each path
+///         changes one thing and skins the same way the GPU would:
+///
+///         - "packed", "half" and "quantized" skin each vertex as the
+///           shaders see it once it's uploaded in that vertex format, with
+///           weights quantized to bytes and, for "half" and "quantized",
+///           positions to 16 bits.  "quantized" skins with the folded
+///           inverse bind transforms, as the backends do.
+///         - "dual_quat" skins with the dual quaternion palette, the same
+///           way as the DUAL_QUATERNION shaders.  Unlike the others, its
+///           error isn't lost precision, but how far the change of blending
+///           moves the vertices.
+///         - "affine_2d" poses and precombines the palette as Affine2Ds,
+///           and rebuilds each joint's matrix as the AFFINE_2D shaders do.
+///         - "cpu" is the SIMD skinning kernel CpuSkinner uses.
+///         - "compressed_clip" records the animation into an AnimationClip,
+///           one key per frame, compresses it with the default tolerance,
+///           and poses every frame from the compressed clip instead.
+///           "compressed_clip_cubic" does the same with a cubic clip, which
+///           keeps Hermite curves instead of lines.
+///
+///         Before any rig is measured, checkClipTolerance() compresses a
+///         random walk, keyed at 30 Hz, and samples it between the keys,
+///         where a fit checked only at its removed keys can stray furthest;
+///         the tests stop if any channel is off by more than its tolerance.
+///         checkRigFileNames() then makes sure a rig file refuses the
+///         names it couldn't read back, and checkAngleBlends() that
+///         blendPoses() turns each joint the same way as lerpAngle(), in
+///         its SIMD blocks and its tail alike, even where the angles are
+///         exactly opposite.  checkCommandQueue() has several threads push
+///         into a GLCommandQueue while another drains it, and checks that
+///         every command runs once, in the order its thread pushed it.
+///         checkBatchAffines() compares computeBatchJointAffines() with
+///         Skeleton::computeJointAffines() on random rigs.
+///
+///         No GL context is needed; nothing is uploaded.  The synthetic rig
+///         is the same one the backends are timed on, since mesh files
+///         carry no skeleton or animation to measure with.
+
+#include "skinning_accuracy.h"
+#include "affine_2d.h"
+#include "animation_clip.h"
+#include "compressed_clip.h"
+#include "cpu_skinner.h"
+#include "gl_command_queue.h"
+#include "palette.h"
+#include "rig_file.h"
+#include "skeletal_mesh.h"
+#include "skeleton.h"
+#include "skeleton_batch.h"
+#include "skinning_kernels.h"
+#include "synthetic_rig.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const float SAMPLE_RATE = 60.0f;    ///< The frames per second of the recorded clip.
+
+// checkClipTolerance()'s random walk.
+const float WALK_KEY_RATE = 30.0f;          ///< Keys per second.
+const size_t WALK_KEY_COUNT = 121;
+const size_t WALK_JOINT_COUNT = 16;
+const size_t WALK_SAMPLES_PER_KEY = 8;      ///< Times sampled in each interval between keys.
+
+// checkCommandQueue()'s producers.
+const size_t QUEUE_PRODUCERS = 8;
+const size_t QUEUE_COMMANDS_PER_PRODUCER = 200000;
+
+// checkBatchAffines()'s random rigs.
+const size_t BATCH_CHECK_RIGS = 200;
+const size_t BATCH_CHECK_MAX_JOINTS = 40;
+const size_t BATCH_CHECK_MAX_INSTANCES = 13;    ///< Not a multiple of BATCH_LANES, so the rows are padded.
+
+const char* const RIG_CHECK_PATH = "rig_name_check.json";   ///< Written and removed by checkRigFileNames().
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a pseudo-random number from -1 to 1, the same on every
+///         machine.
+float nextWalkStep(GLuint& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return float(state >> 8) / 8388608.0f - 1.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  What checkCommandQueue()'s commands check against.  Only the
+///         draining thread touches it.
+struct QueueCheck
+{
+    std::vector<size_t> next_sequences;     ///< Each producer's next command, in the order it pushed them.
+    size_t run_count;
+    size_t out_of_order_count;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The arguments checkCommandQueue()'s producers push.
+struct QueueCheckCommand
+{
+    QueueCheck* check;
+    size_t producer;
+    size_t sequence;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs one of checkCommandQueue()'s commands, on the draining
+///         thread.
+void runQueueCheckCommand(void* arguments)
+{
+    const QueueCheckCommand& command = *static_cast<const QueueCheckCommand*>(arguments);
+    QueueCheck& check = *command.check;
+    if (command.sequence != check.next_sequences[command.producer])
+        ++check.out_of_order_count;
+    check.next_sequences[command.producer] = command.sequence + 1;
+    ++check.run_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Pushes one producer's commands, numbered in order.
+void pushQueueCheckCommands(GLCommandQueue& queue, QueueCheck& check, size_t producer)
+{
+    for (size_t sequence = 0; sequence < QUEUE_COMMANDS_PER_PRODUCER; ++sequence)
+    {
+        QueueCheckCommand command = { &check, producer, sequence };
+        queue.push(runQueueCheckCommand, &command, sizeof(command));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how many times over its tolerance a channel's error is.
+float getToleranceRatio(float error, float tolerance)
+{
+    return tolerance > 0 ? std::abs(error) / tolerance : 0.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The synthetic rig one set of paths is measured on.
+struct AccuracyRig
+{
+    Skeleton skeleton;
+    Pose bind_pose;
+    Pose pose;
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<size_t> heaviest_joints;    ///< The joint with the largest weight on each vertex.
+
+    std::vector<mat4> joint_transforms;
+    std::vector<mat4> palette;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds up the errors of one path's vertices over every pose.
+class ErrorAccumulator
+{
+public:
+    ErrorAccumulator(const AccuracyRig& rig)
+        : rig_(&rig),
+          joint_errors_(rig.skeleton.getJointCount(), 0.0),
+          max_error_(0.0),
+          sum_squares_(0.0),
+          sample_count_(0)
+    {
+    }
+
+    void add(const std::vector<vec2>& reference, const std::vector<vec2>& positions)
+    {
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            double error = glm::length(positions[i] - reference[i]);
+            double& joint_error = joint_errors_[rig_->heaviest_joints[i]];
+            joint_error = std::max(joint_error, error);
+            max_error_ = std::max(max_error_, error);
+            sum_squares_ += error * error;
+        }
+        sample_count_ += reference.size();
+    }
+
+    void finish(AccuracyResult& result) const
+    {
+        result.max_error = max_error_;
+        result.rms_error = sample_count_ > 0 ? std::sqrt(sum_squares_ / sample_count_) : 0.0;
+
+        std::vector<JointError> joints;
+        for (size_t i = 0; i < joint_errors_.size(); ++i)
+        {
+            JointError joint;
+            joint.joint = i;
+            joint.max_error = joint_errors_[i];
+            joints.push_back(joint);
+        }
+        std::stable_sort(joints.begin(), joints.end(), moreError);
+        joints.resize(std::min(joints.size(), MAX_WORST_JOINTS));
+        result.worst_joints.swap(joints);
+    }
+
+private:
+    static bool moreError(const JointError& a, const JointError& b)
+    {
+        return a.max_error > b.max_error;
+    }
+
+    const AccuracyRig* rig_;
+    std::vector<double> joint_errors_;
+    double max_error_;
+    double sum_squares_;
+    size_t sample_count_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins one vertex with a palette of matrices, exactly as the
+///         vertex shader does: every weight is applied as stored, without
+///         renormalizing.
+vec2 skinLinear(const Vertex& vertex, const mat4* palette)
+{
+    vec4 coords(vertex.position, 0, 1);
+    vec4 position(0, 0, 0, 0);
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        position += vertex.joint_weights[i] * (palette[vertex.joint_indices[i]] * coords);
+    return vec2(position);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins every vertex linearly with a palette.
+void skinVertices(const std::vector<Vertex>& vertices, const mat4* palette, std::vector<vec2>& positions)
+{
+    positions.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+        positions[i] = skinLinear(vertices[i], palette);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins one vertex with a dual quaternion palette, exactly as the
+///         DUAL_QUATERNION vertex shader does.
+vec2 skinDualQuat(const Vertex& vertex, const DualQuat* dual_quats, const float* scales)
+{
+    vec4 real_0 = dual_quats[vertex.joint_indices[0]].real;
+    vec4 real(0, 0, 0, 0);
+    vec4 dual(0, 0, 0, 0);
+    float scale = 0.0f;
+    float weight_sum = 0.0f;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        const DualQuat& joint = dual_quats[vertex.joint_indices[i]];
+        float weight = glm::dot(real_0, joint.real) < 0.0f ? -vertex.joint_weights[i] : vertex.joint_weights[i];
+        real += weight * joint.real;
+        dual += weight * joint.dual;
+        scale += vertex.joint_weights[i] * scales[vertex.joint_indices[i]];
+        weight_sum += vertex.joint_weights[i];
+    }
+
+    float norm = glm::length(real);
+    real /= norm;
+    dual /= norm;
+    scale /= weight_sum;
+
+    vec3 r(real);
+    vec3 d(dual);
+    vec3 p = vec3(vertex.position, 0) * scale;
+    vec3 t = 2.0f * (real.w * d - dual.w * r + glm::cross(r, d));
+    p += 2.0f * glm::cross(r, glm::cross(r, p) + real.w * p) + t;
+    return vec2(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a packed vertex as the shaders see it, as a full Vertex
+///         with the normalized weights and the given position.
+template <typename PackedVertexType>
+Vertex unpackVertex(const PackedVertexType& packed, const vec2& position)
+{
+    Vertex vertex;
+    vertex.position = position;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        vertex.joint_indices[i] = packed.joint_indices[i];
+        vertex.joint_weights[i] = packed.joint_weights[i] / 255.0f;
+    }
+    return vertex;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns each vertex as the shaders see it once uploaded in a
+///         vertex format.  Only the 2D packed formats are supported.
+std::vector<Vertex> unpackVertices(const std::vector<Vertex>& vertices, VertexFormat format,
+                                   const PositionQuantization& quantization)
+{
+    std::vector<Vertex> unpacked(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        if (format == VERTEX_FORMAT_PACKED)
+        {
+            PackedVertex packed = packVertex(vertices[i]);
+            unpacked[i] = unpackVertex(packed, packed.position);
+        }
+        else if (format == VERTEX_FORMAT_PACKED_HALF)
+        {
+            HalfPackedVertex packed = packVertexHalf(vertices[i]);
+            unpacked[i] = unpackVertex(packed, vec2(float(packed.position.x), float(packed.position.y)));
+        }
+        else
+        {
+            // GL normalizes the shorts to [-1, 1], clamping -32768.
+            QuantizedVertex packed = packVertexQuantized(vertices[i], quantization);
+            vec2 position = glm::max(vec2(packed.position[0], packed.position[1]) / 32767.0f, vec2(-1.0f));
+            unpacked[i] = unpackVertex(packed, position);
+        }
+    }
+    return unpacked;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Poses the rig in a frame of the synthetic animation, and finds
+///         the reference positions of its vertices.
+void skinReference(AccuracyRig& rig, size_t frame, std::vector<vec2>& reference)
+{
+    animateSyntheticPose(rig.bind_pose, frame, rig.pose);
+    rig.skeleton.computeJointTransforms(rig.pose, rig.joint_transforms.data());
+    computeSkinningPalette(rig.joint_transforms.data(), rig.skeleton.getInverseBindTransforms(),
+                           rig.skeleton.getJointCount(), rig.palette.data());
+    skinVertices(rig.vertices, rig.palette.data(), reference);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts a result for a path on a rig.
+AccuracyResult makeResult(const std::string& path, const AccuracyRig& rig, size_t influence_count,
+                          size_t pose_count, size_t bytes, size_t reference_bytes)
+{
+    AccuracyResult result;
+    result.path = path;
+    result.vertex_count = rig.vertices.size();
+    result.joint_count = rig.skeleton.getJointCount();
+    result.influence_count = influence_count;
+    result.pose_count = pose_count;
+    result.bytes = bytes;
+    result.reference_bytes = reference_bytes;
+    result.max_error = 0.0;
+    result.rms_error = 0.0;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Measures every path on one rig.
+void testRig(AccuracyRig& rig, size_t influence_count, size_t pose_count, std::vector<AccuracyResult>& results)
+{
+    size_t joint_count = rig.skeleton.getJointCount();
+    size_t vertex_count = rig.vertices.size();
+    size_t full_vertex_bytes = vertex_count * getVertexSize(VERTEX_FORMAT_FULL);
+    size_t palette_bytes = joint_count * sizeof(mat4);
+    std::vector<vec2> reference;
+    std::vector<vec2> positions;
+
+    // the vertex formats.
+    PositionQuantization quantization = choosePositionQuantization(rig.vertices);
+    std::vector<mat4> folded_inverse_binds(joint_count);
+    foldPositionQuantization(rig.skeleton.getInverseBindTransforms(), joint_count, quantization,
+                             folded_inverse_binds.data());
+    std::vector<mat4> folded_palette(joint_count);
+
+    const VertexFormat formats[] = { VERTEX_FORMAT_PACKED, VERTEX_FORMAT_PACKED_HALF, VERTEX_FORMAT_QUANTIZED };
+    const char* const format_paths[] = { "packed", "half", "quantized" };
+    for (size_t f = 0; f < 3; ++f)
+    {
+        std::vector<Vertex> unpacked = unpackVertices(rig.vertices, formats[f], quantization);
+        ErrorAccumulator errors(rig);
+        for (size_t frame = 0; frame < pose_count; ++frame)
+        {
+            skinReference(rig, frame, reference);
+            const mat4* palette = rig.palette.data();
+            if (isQuantizedFormat(formats[f]))
+            {
+                computeSkinningPalette(rig.joint_transforms.data(), folded_inverse_binds.data(), joint_count,
+                                       folded_palette.data());
+                palette = folded_palette.data();
+            }
+            skinVertices(unpacked, palette, positions);
+            errors.add(reference, positions);
+        }
+
+        results.push_back(makeResult(format_paths[f], rig, influence_count, pose_count,
+                                     vertex_count * getVertexSize(formats[f]), full_vertex_bytes));
+        errors.finish(results.back());
+    }
+
+    // dual quaternions.
+    {
+        std::vector<DualQuat> dual_quats(joint_count);
+        std::vector<float> scales(joint_count);
+        ErrorAccumulator errors(rig);
+        for (size_t frame = 0; frame < pose_count; ++frame)
+        {
+            skinReference(rig, frame, reference);
+            computeDualQuatPalette(rig.palette.data(), joint_count, dual_quats.data(), scales.data());
+
+            positions.resize(vertex_count);
+            for (size_t i = 0; i < vertex_count; ++i)
+                positions[i] = skinDualQuat(rig.vertices[i], dual_quats.data(), scales.data());
+            errors.add(reference, positions);
+        }
+
+        results.push_back(makeResult("dual_quat", rig, influence_count, pose_count,
+                                     joint_count * (sizeof(DualQuat) + sizeof(float)), palette_bytes));
+        errors.finish(results.back());
+    }
+
+    // 2D affine transforms.
+    {
+        std::vector<Affine2D> inverse_bind_affines(joint_count);
+        for (size_t i = 0; i < joint_count; ++i)
+            inverse_bind_affines[i] = mat4ToAffine(rig.skeleton.getInverseBindTransforms()[i]);
+
+        std::vector<Affine2D> joint_affines(joint_count);
+        std::vector<Affine2D> affine_palette(joint_count);
+        std::vector<mat4> palette(joint_count);
+        ErrorAccumulator errors(rig);
+        for (size_t frame = 0; frame < pose_count; ++frame)
+        {
+            skinReference(rig, frame, reference);
+            rig.skeleton.computeJointAffines(rig.pose, joint_affines.data());
+            computeAffinePalette(joint_affines.data(), inverse_bind_affines.data(), joint_count,
+                                 affine_palette.data());
+            for (size_t i = 0; i < joint_count; ++i)
+                palette[i] = affineToMat4(affine_palette[i]);
+
+            skinVertices(rig.vertices, palette.data(), positions);
+            errors.add(reference, positions);
+        }
+
+        results.push_back(makeResult("affine_2d", rig, influence_count, pose_count,
+                                     joint_count * sizeof(Affine2D), palette_bytes));
+        errors.finish(results.back());
+    }
+
+    // the CPU skinning kernel.
+    {
+        SkinningKernel kernel = getSkinningKernel(getSkinningSimdLevel());
+        std::vector<color4> colors(joint_count, color4(1, 1, 1, 1));
+        std::vector<CpuSkinner::SkinnedVertex> skinned(vertex_count);
+        ErrorAccumulator errors(rig);
+        for (size_t frame = 0; frame < pose_count; ++frame)
+        {
+            skinReference(rig, frame, reference);
+            kernel(rig.vertices.data(), vertex_count, rig.palette.data(), colors.data(), skinned.data());
+
+            positions.resize(vertex_count);
+            for (size_t i = 0; i < vertex_count; ++i)
+                positions[i] = vec2(skinned[i].position);
+            errors.add(reference, positions);
+        }
+
+        results.push_back(makeResult("cpu", rig, influence_count, pose_count,
+                                     full_vertex_bytes, full_vertex_bytes));
+        errors.finish(results.back());
+    }
+
+    // the compressed clip, with lines and then Hermite curves between its
+    // keys.
+    for (int cubic = 0; cubic < 2; ++cubic)
+    {
+        AnimationClip clip(joint_count, std::max(pose_count, size_t(1)) / SAMPLE_RATE);
+        for (size_t frame = 0; frame < pose_count; ++frame)
+        {
+            animateSyntheticPose(rig.bind_pose, frame, rig.pose);
+            clip.addPoseKeys(frame / SAMPLE_RATE, rig.pose);
+        }
+        if (cubic)
+            clip.setInterpolation(CLIP_INTERPOLATION_CUBIC);
+        CompressedClip compressed(clip);
+        CompressedClipSampler sampler(compressed);
+
+        Pose clip_pose = rig.skeleton.allocatePose();
+        copyPose(rig.bind_pose, clip_pose);
+        std::vector<mat4> clip_transforms(joint_count);
+        std::vector<mat4> clip_palette(joint_count);
+        ErrorAccumulator errors(rig);
+        for (size_t frame = 0; frame < pose_count; ++frame)
+        {
+            skinReference(rig, frame, reference);
+            sampler.sample(frame / SAMPLE_RATE, clip_pose);
+            rig.skeleton.computeJointTransforms(clip_pose, clip_transforms.data());
+            computeSkinningPalette(clip_transforms.data(), rig.skeleton.getInverseBindTransforms(), joint_count,
+                                   clip_palette.data());
+
+            skinVertices(rig.vertices, clip_palette.data(), positions);
+            errors.add(reference, positions);
+        }
+        rig.skeleton.releasePose(clip_pose);
+
+        const char* path = cubic ? "compressed_clip_cubic" : "compressed_clip";
+        results.push_back(makeResult(path, rig, influence_count, pose_count,
+                                     compressed.getSize(), compressed.getSourceSize()));
+        errors.finish(results.back());
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that a compressed clip stays within its tolerance of its
+///         source everywhere, not only at the source's keys.
+///
+/// \details Each joint's channels take a random walk, one key every
+///         thirtieth of a second, which leaves no curve smooth enough for
+///         the compression to hide behind.  It's compressed with the default
+///         tolerance, linear and then cubic, and both the source and the
+///         compressed clip are sampled several times in each interval
+///         between keys.  If any channel strays further than its tolerance,
+///         this reports the worst one and throws.
+void checkClipTolerance()
+{
+    ClipTolerance tolerance;
+    PosePool poses(WALK_JOINT_COUNT);
+    Pose source_pose = poses.allocate();
+    Pose compressed_pose = poses.allocate();
+
+    for (int cubic = 0; cubic < 2; ++cubic)
+    {
+        float duration = (WALK_KEY_COUNT - 1) / WALK_KEY_RATE;
+        AnimationClip clip(WALK_JOINT_COUNT, duration);
+        GLuint state = 1;
+        for (size_t joint = 0; joint < WALK_JOINT_COUNT; ++joint)
+        {
+            vec2 translation(0);
+            float rotation = 0;
+            float scale = 1;
+            for (size_t key = 0; key < WALK_KEY_COUNT; ++key)
+            {
+                clip.addKey(joint, key / WALK_KEY_RATE, translation, rotation, scale);
+                translation += 0.005f * vec2(nextWalkStep(state), nextWalkStep(state));
+                rotation += 0.5f * nextWalkStep(state);
+                scale = std::max(scale + 0.005f * nextWalkStep(state), 0.1f);
+            }
+        }
+        if (cubic)
+            clip.setInterpolation(CLIP_INTERPOLATION_CUBIC);
+
+        CompressedClip compressed(clip, tolerance);
+        ClipSampler source_sampler(clip);
+        CompressedClipSampler compressed_sampler(compressed);
+
+        float worst_ratio = 0;
+        const char* worst_channel = "";
+        float worst_time = 0;
+        size_t sample_count = (WALK_KEY_COUNT - 1) * WALK_SAMPLES_PER_KEY;
+        for (size_t sample = 0; sample <= sample_count; ++sample)
+        {
+            float time = duration * sample / sample_count;
+            source_sampler.sample(time, source_pose);
+            compressed_sampler.sample(time, compressed_pose);
+            for (size_t joint = 0; joint < WALK_JOINT_COUNT; ++joint)
+            {
+                vec2 translation_error = compressed_pose.translation[joint] - source_pose.translation[joint];
+                float ratios[3] =
+                {
+                    std::max(getToleranceRatio(translation_error.x, tolerance.translation),
+                             getToleranceRatio(translation_error.y, tolerance.translation)),
+                    getToleranceRatio(compressed_pose.rotation[joint] - source_pose.rotation[joint],
+                                      tolerance.rotation),
+                    getToleranceRatio(compressed_pose.scale[joint] - source_pose.scale[joint], tolerance.scale)
+                };
+                const char* const channels[3] = { "translation", "rotation", "scale" };
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    if (ratios[c] > worst_ratio)
+                    {
+                        worst_ratio = ratios[c];
+                        worst_channel = channels[c];
+                        worst_time = time;
+                    }
+                }
+            }
+        }
+
+        // float rounding in the samplers is allowed for, but nothing more.
+        const char* kind = cubic ? "cubic" : "linear";
+        if (worst_ratio > 1.001f)
+        {
+            poses.release(source_pose);
+            poses.release(compressed_pose);
+            std::cerr << "Error compressing a clip!" << std::endl
+                      << "  Error: The " << kind << " clip's " << worst_channel << " is " << worst_ratio
+                      << " times its tolerance at " << worst_time << " s, between its keys." << std::endl;
+            throw std::runtime_error("A compressed clip strays outside its tolerance!");
+        }
+        std::cerr << "The " << kind << " compressed clip stays within " << int(worst_ratio * 100 + 0.5f)
+                  << "% of its tolerance between keys (" << compressed.getKeyCount() << " of "
+                  << WALK_JOINT_COUNT * WALK_KEY_COUNT * CompressedClip::N_CHANNELS << " keys kept)." << std::endl;
+    }
+
+    poses.release(source_pose);
+    poses.release(compressed_pose);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that a rig file's socket and pose names are read back as
+///         they were saved, and that names it couldn't read back are
+///         refused when saving, without touching the file.
+///
+/// \details A small rig with one socket and one named pose is saved and
+///         loaded again, then saved with a quote, a backslash and a line
+///         break in each kind of name.  Each of those saves should report
+///         an error and throw, and the file saved first should still load.
+///         If anything else happens, this reports it and throws.
+void checkRigFileNames()
+{
+    Skeleton skeleton;
+    buildSyntheticSkeleton(skeleton, 3);
+    RigFilePose poses[2];
+    poses[0].name = "bind";
+    poses[0].pose = skeleton.allocatePose(true);
+    setSyntheticBindPose(poses[0].pose);
+    skeleton.setBindPose(poses[0].pose);
+    skeleton.addSocket("hand", 2, mat4(1));
+    poses[1].name = "raised";
+    poses[1].pose = skeleton.allocatePose(true);
+    copyPose(poses[0].pose, poses[1].pose);
+    poses[1].pose.rotation[1] = 45.0f;
+
+    std::string problem;
+    saveRigFile(skeleton, poses, 2, RIG_CHECK_PATH);
+
+    std::cerr << "Checking that rig files refuse names they can't hold; six errors are expected." << std::endl;
+    const char* const bad_names[] = { "say \"hi\"", "back\\slash", "two\nlines" };
+    for (size_t i = 0; i < 3 && problem.empty(); ++i)
+    {
+        for (int socket = 0; socket < 2 && problem.empty(); ++socket)
+        {
+            Skeleton bad_skeleton;
+            buildSyntheticSkeleton(bad_skeleton, 3);
+            bad_skeleton.setBindPose(poses[0].pose);
+            bad_skeleton.addSocket(socket ? bad_names[i] : "hand", 2, mat4(1));
+            std::string pose_name = poses[1].name;
+            if (!socket)
+                poses[1].name = bad_names[i];
+
+            bool refused = false;
+            try
+            {
+                saveRigFile(bad_skeleton, poses, 2, RIG_CHECK_PATH);
+            }
+            catch (const std::runtime_error&)
+            {
+                refused = true;
+            }
+            poses[1].name = pose_name;
+            if (!refused)
+                problem = std::string("A ") + (socket ? "socket" : "pose") + " name with a quote, a backslash or a "
+                          "line break was saved.";
+        }
+    }
+
+    if (problem.empty())
+    {
+        Skeleton loaded;
+        std::vector<RigFilePose> loaded_poses;
+        loadRigFile(RIG_CHECK_PATH, loaded, loaded_poses);
+        if (loaded.getSocketCount() != 1 || loaded.getSocketName(0) != "hand" || loaded_poses.size() != 2 ||
+            loaded_poses[1].name != "raised" || loaded_poses[1].pose.rotation[1] != 45.0f)
+        {
+            problem = "The rig file didn't read back as it was saved.";
+        }
+        for (size_t pose = 0; pose < loaded_poses.size(); ++pose)
+            loaded.releasePose(loaded_poses[pose].pose);
+    }
+
+    std::remove(RIG_CHECK_PATH);
+    skeleton.releasePose(poses[0].pose);
+    skeleton.releasePose(poses[1].pose);
+    if (!problem.empty())
+    {
+        std::cerr << "Error checking rig files!" << std::endl
+                  << "  Error: " << problem << std::endl;
+        throw std::runtime_error("Error checking rig files!");
+    }
+    std::cerr << "Rig files read back the names they were saved with, and refuse the rest." << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that blendPoses() blends every joint's rotation as
+///         lerpAngle() does, around every whole and half turn.
+///
+/// \details The pose has five joints, so the first four are blended in a
+///         SIMD block and the last by the scalar tail, and every joint is
+///         given the same pair of angles.  The pairs are exactly opposite,
+///         or a whole number of turns apart, or just either side of those,
+///         where rounding to the nearest turn can go either way.  If any
+///         joint is blended differently from lerpAngle(), this reports it
+///         and throws.
+void checkAngleBlends()
+{
+    const size_t joint_count = 5;
+    const float pairs[][2] =
+    {
+        { 0.0f, 180.0f }, { 180.0f, 0.0f }, { 0.0f, -180.0f }, { -180.0f, 0.0f },
+        { 10.0f, 190.0f }, { 190.0f, 10.0f }, { 0.0f, 540.0f }, { 0.0f, -540.0f },
+        { 90.0f, 450.0f }, { 0.0f, 179.99f }, { 0.0f, 180.01f }, { 0.0f, -179.99f }, { 0.0f, -180.01f }
+    };
+    const size_t pair_count = sizeof(pairs) / sizeof(pairs[0]);
+    const float t = 0.25f;
+
+    PosePool poses(joint_count);
+    Pose a = poses.allocate();
+    Pose b = poses.allocate();
+    Pose blended = poses.allocate();
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        a.translation[joint] = b.translation[joint] = vec2(0);
+        a.scale[joint] = b.scale[joint] = 1.0f;
+    }
+
+    std::string problem;
+    for (size_t pair = 0; pair < pair_count && problem.empty(); ++pair)
+    {
+        for (size_t joint = 0; joint < joint_count; ++joint)
+        {
+            a.rotation[joint] = pairs[pair][0];
+            b.rotation[joint] = pairs[pair][1];
+        }
+        blendPoses(a, b, t, blended);
+
+        float expected = lerpAngle(pairs[pair][0], pairs[pair][1], t);
+        for (size_t joint = 0; joint < joint_count && problem.empty(); ++joint)
+        {
+            // the two may round their products differently, but a different
+            // turn would be off by a quarter of 360 degrees.
+            if (std::abs(blended.rotation[joint] - expected) > 0.001f)
+            {
+                std::ostringstream message;
+                message << "Blending " << pairs[pair][0] << " to " << pairs[pair][1] << " degrees a quarter of the "
+                        << "way gave " << blended.rotation[joint] << " for joint " << joint << ", rather than "
+                        << expected << ".";
+                problem = message.str();
+            }
+        }
+    }
+
+    poses.release(a);
+    poses.release(b);
+    poses.release(blended);
+    if (!problem.empty())
+    {
+        std::cerr << "Error checking angle blends!" << std::endl
+                  << "  Error: " << problem << std::endl;
+        throw std::runtime_error("Error checking angle blends!");
+    }
+    std::cerr << "blendPoses() turns every joint the same way as lerpAngle()." << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that a GLCommandQueue runs every command pushed to it
+///         exactly once, and each thread's commands in the order it pushed
+///         them, while several threads push at once and another drains.
+///
+/// \details The queue's blocks are small, so they fill, and the arenas grow,
+///         while the producers are pushing.  The calling thread drains
+///         until every producer has finished and nothing is pending.  If a
+///         command is lost, run twice or run out of order, this reports it
+///         and throws.
+void checkCommandQueue()
+{
+    GLCommandQueue queue(4096);
+    QueueCheck check;
+    check.next_sequences.assign(QUEUE_PRODUCERS, 0);
+    check.run_count = 0;
+    check.out_of_order_count = 0;
+
+    std::atomic<size_t> finished(0);
+    std::vector<std::thread> producers;
+    for (size_t producer = 0; producer < QUEUE_PRODUCERS; ++producer)
+    {
+        producers.push_back(std::thread([&queue, &check, &finished, producer]()
+        {
+            pushQueueCheckCommands(queue, check, producer);
+            finished.fetch_add(1);
+        }));
+    }
+
+    size_t drains = 0;
+    size_t drained = 0;
+    while (finished.load() < QUEUE_PRODUCERS || queue.getPendingCount() > 0)
+    {
+        drained += queue.drain();
+        ++drains;
+    }
+    for (size_t producer = 0; producer < QUEUE_PRODUCERS; ++producer)
+        producers[producer].join();
+
+    size_t pushed = QUEUE_PRODUCERS * QUEUE_COMMANDS_PER_PRODUCER;
+    bool complete = true;
+    for (size_t producer = 0; producer < QUEUE_PRODUCERS; ++producer)
+        complete = complete && check.next_sequences[producer] == QUEUE_COMMANDS_PER_PRODUCER;
+    if (check.run_count != pushed || drained != pushed || check.out_of_order_count > 0 || !complete)
+    {
+        std::cerr << "Error checking the GL command queue!" << std::endl
+                  << "  Error: Of " << pushed << " commands pushed, " << check.run_count << " ran ("
+                  << drained << " counted by drain()), and " << check.out_of_order_count
+                  << " ran out of their thread's order." << std::endl;
+        throw std::runtime_error("Error checking the GL command queue!");
+    }
+    std::cerr << "The GL command queue ran all " << pushed << " commands from " << QUEUE_PRODUCERS
+              << " threads once and in order, over " << drains << " drains and " << queue.getBlockCount()
+              << " blocks." << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that computeBatchJointAffines() gives every instance
+///         exactly the transforms Skeleton::computeJointAffines() gives it
+///         alone.
+///
+/// \details Each random rig has its own number of joints, each the child
+///         of a random earlier joint or a root, and its own number of
+///         instances, each in a random pose.  The two have to agree to the
+///         bit, with whichever SIMD path this was built with.  If any
+///         component differs, this reports the first one and throws.
+void checkBatchAffines()
+{
+    GLuint state = 7;
+    std::vector<Affine2D> expected;
+    std::vector<Affine2D> batched;
+    for (size_t rig = 0; rig < BATCH_CHECK_RIGS; ++rig)
+    {
+        size_t joint_count = 1 + size_t(0.5f * (nextWalkStep(state) + 1.0f) * (BATCH_CHECK_MAX_JOINTS - 1));
+        size_t instance_count = 1 + rig % BATCH_CHECK_MAX_INSTANCES;
+
+        Skeleton skeleton;
+        skeleton.addJoint(Skeleton::NO_PARENT);
+        for (size_t joint = 1; joint < joint_count; ++joint)
+        {
+            float choice = 0.5f * (nextWalkStep(state) + 1.0f);
+            skeleton.addJoint(choice < 0.1f ? Skeleton::NO_PARENT : int(choice * 0.999f * joint));
+        }
+
+        PoseBatch poses(joint_count, instance_count);
+        AffineBatch affines(joint_count, instance_count);
+        std::vector<Pose> instance_poses(instance_count);
+        for (size_t instance = 0; instance < instance_count; ++instance)
+        {
+            Pose& pose = instance_poses[instance] = skeleton.allocatePose();
+            for (size_t joint = 0; joint < joint_count; ++joint)
+            {
+                pose.translation[joint] = vec2(nextWalkStep(state), nextWalkStep(state));
+                pose.rotation[joint] = 360.0f * nextWalkStep(state);
+                pose.scale[joint] = 1.0f + 0.5f * nextWalkStep(state);
+            }
+            poses.setPose(instance, pose);
+        }
+        computeBatchJointAffines(skeleton, poses, affines);
+
+        expected.resize(joint_count);
+        batched.resize(joint_count);
+        for (size_t instance = 0; instance < instance_count; ++instance)
+        {
+            skeleton.computeJointAffines(instance_poses[instance], expected.data());
+            affines.getAffines(instance, batched.data());
+            for (size_t joint = 0; joint < joint_count; ++joint)
+            {
+                const Affine2D& want = expected[joint];
+                const Affine2D& got = batched[joint];
+                if (got.x_axis != want.x_axis || got.y_axis != want.y_axis || got.translation != want.translation)
+                {
+                    std::cerr << "Error checking batched joint transforms!" << std::endl
+                              << "  Error: Rig " << rig << ", instance " << instance << " of " << instance_count
+                              << ", joint " << joint << " of " << joint_count
+                              << " doesn't match its transform evaluated alone." << std::endl;
+                    throw std::runtime_error("Error checking batched joint transforms!");
+                }
+            }
+            skeleton.releasePose(instance_poses[instance]);
+        }
+    }
+    std::cerr << "computeBatchJointAffines() matches computeJointAffines() exactly on " << BATCH_CHECK_RIGS
+              << " random rigs." << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Measures every path on a synthetic rig of each combination of
+///         the given sizes, and appends one result per path and rig.
+///
+/// \param  pose_count The number of frames of the synthetic animation to
+///         pose each rig in.
+void runAccuracyTests(const std::vector<size_t>& vertex_counts,
+                      const std::vector<size_t>& joint_counts,
+                      const std::vector<size_t>& influence_counts,
+                      size_t pose_count,
+                      std::vector<AccuracyResult>& results)
+{
+    checkClipTolerance();
+    checkRigFileNames();
+    checkAngleBlends();
+    checkCommandQueue();
+    checkBatchAffines();
+
+    for (size_t v = 0; v < vertex_counts.size(); ++v)
+    {
+        for (size_t j = 0; j < joint_counts.size(); ++j)
+        {
+            for (size_t n = 0; n < influence_counts.size(); ++n)
+            {
+                size_t joint_count = joint_counts[j];
+
+                // the packed formats' joint indices are bytes.
+                if (joint_count < 1 || joint_count > 256)
+                {
+                    std::cerr << "Skipping " << joint_count << " joints: the packed vertex formats need 1 to 256."
+                              << std::endl;
+                    continue;
+                }
+
+                AccuracyRig rig;
+                buildSyntheticSkeleton(rig.skeleton, joint_count);
+                rig.bind_pose = rig.skeleton.allocatePose();
+                rig.pose = rig.skeleton.allocatePose();
+                setSyntheticBindPose(rig.bind_pose);
+                rig.skeleton.setBindPose(rig.bind_pose);
+                rig.joint_transforms.resize(joint_count);
+                rig.palette.resize(joint_count);
+
+                try
+                {
+                    buildSyntheticMesh(vertex_counts[v], joint_count, influence_counts[n], rig.vertices, rig.indices);
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << "Skipping " << joint_count << " joints, " << influence_counts[n]
+                              << " influences: " << e.what() << std::endl;
+                    rig.skeleton.releasePose(rig.bind_pose);
+                    rig.skeleton.releasePose(rig.pose);
+                    continue;
+                }
+
+                rig.heaviest_joints.resize(rig.vertices.size());
+                for (size_t i = 0; i < rig.vertices.size(); ++i)
+                {
+                    const Vertex& vertex = rig.vertices[i];
+                    size_t heaviest = 0;
+                    for (size_t k = 1; k < MAX_JOINT_INFLUENCES; ++k)
+                    {
+                        if (vertex.joint_weights[k] > vertex.joint_weights[heaviest])
+                            heaviest = k;
+                    }
+                    rig.heaviest_joints[i] = vertex.joint_indices[heaviest];
+                }
+
+                testRig(rig, influence_counts[n], pose_count, results);
+
+                rig.skeleton.releasePose(rig.bind_pose);
+                rig.skeleton.releasePose(rig.pose);
+            }
+        }
+    }
+}
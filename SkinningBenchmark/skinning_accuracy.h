@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_accuracy.h
+/// \author Ben Crist
+///
+/// \brief  Functions for measuring how far each compressed or optimized
+///         skinning path strays from the full float reference.
+
+#ifndef SKINNING_ACCURACY_H_
+#define SKINNING_ACCURACY_H_
+
+#include "demo.h"
+#include <string>
+#include <vector>
+
+/// The most joints listed in each AccuracyResult's worst_joints.
+const size_t MAX_WORST_JOINTS = 3;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The largest error of the vertices one joint influences most.
+struct JointError
+{
+    size_t joint;
+    double max_error;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The error of one skinning path on one rig, over a sweep of poses.
+///
+/// \details Errors are distances between each skinned vertex and where the
+///         reference path puts it, in the clip space the skinning programs
+///         output; half the viewport's size in pixels converts them to
+///         pixels.
+struct AccuracyResult
+{
+    std::string path;           ///< "packed", "half", "quantized", "dual_quat", "affine_2d", "cpu",
+                                ///< "compressed_clip" or "compressed_clip_cubic".
+    size_t vertex_count;        ///< The number of vertices actually generated.
+    size_t joint_count;
+    size_t influence_count;
+    size_t pose_count;
+    size_t bytes;               ///< What the path stores: its vertices, palette or clip, in bytes.
+    size_t reference_bytes;     ///< What the reference stores in its place.
+    double max_error;
+    double rms_error;
+    std::vector<JointError> worst_joints;   ///< Largest error first; each vertex counts for its heaviest joint.
+};
+
+void checkClipTolerance();
+void checkRigFileNames();
+void checkAngleBlends();
+void checkCommandQueue();
+void checkBatchAffines();
+void runAccuracyTests(const std::vector<size_t>& vertex_counts,
+                      const std::vector<size_t>& joint_counts,
+                      const std::vector<size_t>& influence_counts,
+                      size_t pose_count,
+                      std::vector<AccuracyResult>& results);
+
+#endif
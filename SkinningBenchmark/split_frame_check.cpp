@@ -0,0 +1,362 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  split_frame_check.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementation of the split frame check.
+///
+/// \details The crowd is a row of overlapping, translucent quads, one per
+///         instance, blended in instance order without a depth buffer, as
+///         the demo draws its crowd; any mistake in the order the layers
+///         are composited in, or in their premultiplied alpha, changes the
+///         colors where the quads overlap.
+
+#include "split_frame_check.h"
+#include "platform.h"
+#include "profiler.h"
+#include "shader.h"
+#include "split_frame.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+const GLsizei CHECK_SIZE = 128;         ///< The width and height of the frame.
+const size_t CHECK_INSTANCES = 48;
+const int MAX_CHANNEL_ERROR = 3;        ///< Rounding each layer to 8 bits is allowed for.
+
+// one quad per draw, from the rectangle in clip space, with no vertex buffer.
+const char* const QUAD_VERTEX_SHADER_SOURCE =
+    "#version 330\n"
+    "uniform vec4 rect;\n"
+    "void main()\n"
+    "{\n"
+    "   vec2 corner = vec2(float(gl_VertexID & 1), float((gl_VertexID >> 1) & 1));\n"
+    "   gl_Position = vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);\n"
+    "}\n";
+
+const char* const QUAD_FRAGMENT_SHADER_SOURCE =
+    "#version 330\n"
+    "uniform vec4 color;\n"
+    "out vec4 frag_color;\n"
+    "void main()\n"
+    "{\n"
+    "   frag_color = color;\n"
+    "}\n";
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One instance of the crowd.
+struct CheckInstance
+{
+    vec4 rect;      ///< x0, y0, x1, y1 in clip space.
+    vec4 color;     ///< Straight, not premultiplied, alpha.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws ranges of the crowd on one context.  Must be created, used
+///         and destroyed with that context current.
+class QuadDrawer
+{
+public:
+    QuadDrawer()
+        : program_id_(compileShaderProgram(QUAD_VERTEX_SHADER_SOURCE, QUAD_FRAGMENT_SHADER_SOURCE)),
+          vao_id_(0)
+    {
+        rect_location_ = glGetUniformLocation(program_id_, "rect");
+        color_location_ = glGetUniformLocation(program_id_, "color");
+        glGenVertexArrays(1, &vao_id_);
+    }
+
+    ~QuadDrawer()
+    {
+        glDeleteVertexArrays(1, &vao_id_);
+        glDeleteProgram(program_id_);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Blends the instances from first up to end over the bound
+    ///         framebuffer, with whatever blend function is set.
+    void draw(const std::vector<CheckInstance>& instances, size_t first, size_t end)
+    {
+        glEnable(GL_BLEND);
+        glUseProgram(program_id_);
+        glBindVertexArray(vao_id_);
+        for (size_t i = first; i < end; ++i)
+        {
+            glUniform4fv(rect_location_, 1, &instances[i].rect[0]);
+            glUniform4fv(color_location_, 1, &instances[i].color[0]);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+private:
+    QuadDrawer(const QuadDrawer&);              // non-copyable
+    QuadDrawer& operator=(const QuadDrawer&);   // non-copyable
+
+    GLuint program_id_;
+    GLuint vao_id_;
+    GLint rect_location_;
+    GLint color_location_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Lays the crowd out for a frame: a row of quads, each overlapping
+///         its neighbours, drifting a little from frame to frame.
+void layOutCrowd(size_t frame, std::vector<CheckInstance>& instances)
+{
+    instances.resize(CHECK_INSTANCES);
+    GLuint state = 12345;
+    for (size_t i = 0; i < CHECK_INSTANCES; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        float x = -0.9f + 1.6f * i / CHECK_INSTANCES + 0.01f * float(frame % 8);
+        float y = -0.8f + 1.2f * float(state >> 24) / 255.0f;
+        instances[i].rect = vec4(x, y, x + 0.3f, y + 0.4f);
+        instances[i].color = vec4(float((state >> 16) & 255) / 255.0f, float((state >> 8) & 255) / 255.0f,
+                                  float(i % 3) * 0.5f, 0.35f + 0.5f * float(i % 4) / 3.0f);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A framebuffer on the presenting context, which stands in for its
+///         window so the results can be read back.
+class CheckFramebuffer
+{
+public:
+    CheckFramebuffer()
+        : framebuffer_id_(0),
+          renderbuffer_id_(0)
+    {
+        glGenRenderbuffers(1, &renderbuffer_id_);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_id_);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, CHECK_SIZE, CHECK_SIZE);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &framebuffer_id_);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer_id_);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            glDeleteFramebuffers(1, &framebuffer_id_);
+            glDeleteRenderbuffers(1, &renderbuffer_id_);
+            std::cerr << "The split frame check's framebuffer is incomplete!" << std::endl;
+            throw std::runtime_error("The split frame check's framebuffer is incomplete!");
+        }
+    }
+
+    ~CheckFramebuffer()
+    {
+        glDeleteFramebuffers(1, &framebuffer_id_);
+        glDeleteRenderbuffers(1, &renderbuffer_id_);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Binds the framebuffer and clears it to an opaque background,
+    ///         with ordinary blending, as the presenting window draws.
+    void bind()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+        glViewport(0, 0, CHECK_SIZE, CHECK_SIZE);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glClearColor(0.2f, 0.2f, 0.25f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    void read(std::vector<unsigned char>& pixels)
+    {
+        pixels.resize(size_t(CHECK_SIZE) * CHECK_SIZE * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_id_);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, CHECK_SIZE, CHECK_SIZE, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+private:
+    CheckFramebuffer(const CheckFramebuffer&);              // non-copyable
+    CheckFramebuffer& operator=(const CheckFramebuffer&);   // non-copyable
+
+    GLuint framebuffer_id_;
+    GLuint renderbuffer_id_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A context which draws a share of each frame into a
+///         SplitFrameTarget, for the presenting context to composite.
+struct SecondaryRenderer
+{
+    SecondaryRenderer() : window(nullptr), start_ms(0) {}
+
+    PlatformWindow* window;
+    std::unique_ptr<QuadDrawer> drawer;
+    std::unique_ptr<SplitFrameTarget> target;
+    SplitFrameLayer layer;
+    double start_ms;    ///< When its share of the frame was started.
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws a crowd split between several contexts, composites it on
+///         the presenting one, and compares every frame with the same crowd
+///         drawn by the presenting context alone.
+///
+/// \details Each secondary context has a hidden window, or an offscreen
+///         surface on EGL, of its own, on the platform's devices in turn,
+///         so on a machine with one GPU they all share it.  Every
+///         secondary renderer is started before any of their layers is
+///         fetched, and the presenting context draws its own share in
+///         between, so the GPUs draw at the same time.  Each renderer's
+///         time, from starting its share to its layer being ready, feeds
+///         the InstanceSplit, so the shares move towards the faster ones
+///         over the frames.
+///
+///         A problem, or a frame which differs from the reference by more
+///         than the rounding of each layer allows, is reported to stderr.
+///
+/// \param  platform Creates the secondary contexts, and destroys them
+///         afterwards.
+/// \param  presenting The window whose context composites the layers.  It's
+///         left current.
+/// \param  renderer_count The number of contexts to split the crowd
+///         between, including the presenting one; at least 2.
+/// \param  frames The number of frames to draw and compare.
+/// \return true if every frame matched.
+bool runSplitFrameCheck(Platform& platform, PlatformWindow& presenting, size_t renderer_count, size_t frames)
+{
+    renderer_count = std::max(renderer_count, size_t(2));
+    size_t device_count = std::max(platform.getDeviceCount(), size_t(1));
+
+    size_t secondary_count = renderer_count - 1;
+    std::unique_ptr<SecondaryRenderer[]> secondaries(new SecondaryRenderer[secondary_count]);
+    bool passed = false;
+    try
+    {
+        for (size_t r = 0; r < secondary_count; ++r)
+        {
+            WindowDesc desc;
+            desc.title = "Split Frame Check";
+            desc.width = CHECK_SIZE;
+            desc.height = CHECK_SIZE;
+            desc.double_buffered = false;
+            desc.visible = false;
+            desc.device = (r + 1) % device_count;
+            secondaries[r].window = platform.createWindow(desc);
+            if (secondaries[r].window == nullptr)
+                throw std::runtime_error("A secondary context couldn't be created.");
+
+            secondaries[r].window->makeCurrent();
+            secondaries[r].drawer.reset(new QuadDrawer());
+            secondaries[r].target.reset(new SplitFrameTarget(CHECK_SIZE, CHECK_SIZE));
+        }
+        std::cerr << "Split frame check: " << renderer_count << " contexts on " << device_count << " device(s)."
+                  << std::endl;
+
+        presenting.makeCurrent();
+        {
+            QuadDrawer drawer;
+            SplitFrameCompositor compositor;
+            CheckFramebuffer composited;
+            CheckFramebuffer reference;
+            InstanceSplit split(renderer_count);
+            std::vector<CheckInstance> instances;
+            std::vector<size_t> first_instances;
+            std::vector<unsigned char> composited_pixels;
+            std::vector<unsigned char> reference_pixels;
+            int worst_error = 0;
+
+            for (size_t frame = 0; frame < frames; ++frame)
+            {
+                layOutCrowd(frame, instances);
+                split.split(instances.size(), first_instances);
+
+                for (size_t r = 0; r < secondary_count; ++r)
+                {
+                    SecondaryRenderer& secondary = secondaries[r];
+                    secondary.window->makeCurrent();
+                    secondary.start_ms = getTimeMilliseconds();
+                    secondary.target->bind();
+                    secondary.drawer->draw(instances, first_instances[r + 1], first_instances[r + 2]);
+                    secondary.target->readBack();
+                }
+
+                // the presenting context's own share goes first, so the
+                // layers go over it in renderer order.
+                presenting.makeCurrent();
+                double start_ms = getTimeMilliseconds();
+                composited.bind();
+                drawer.draw(instances, first_instances[0], first_instances[1]);
+                glFinish();
+                split.record(0, first_instances[1] - first_instances[0], getTimeMilliseconds() - start_ms);
+
+                for (size_t r = 0; r < secondary_count; ++r)
+                {
+                    SecondaryRenderer& secondary = secondaries[r];
+                    secondary.window->makeCurrent();
+                    secondary.target->fetch(secondary.layer);
+                    split.record(r + 1, first_instances[r + 2] - first_instances[r + 1],
+                                 getTimeMilliseconds() - secondary.start_ms);
+                }
+
+                // the framebuffer is still bound on the presenting context.
+                presenting.makeCurrent();
+                for (size_t r = 0; r < secondary_count; ++r)
+                    compositor.composite(secondaries[r].layer);
+                composited.read(composited_pixels);
+
+                reference.bind();
+                drawer.draw(instances, 0, instances.size());
+                reference.read(reference_pixels);
+
+                // only the colors are compared; the window's alpha isn't
+                // shown, and the single context's blend function leaves it
+                // below 1 where the compositor's doesn't.
+                for (size_t i = 0; i < reference_pixels.size(); ++i)
+                {
+                    if (i % 4 == 3)
+                        continue;
+                    worst_error = std::max(worst_error, std::abs(int(composited_pixels[i]) - int(reference_pixels[i])));
+                }
+                if (worst_error > MAX_CHANNEL_ERROR)
+                {
+                    std::cerr << "Error checking split frames!" << std::endl
+                              << "  Error: Frame " << frame << " is off by " << worst_error
+                              << " in a channel from the same crowd drawn by one context." << std::endl;
+                    throw std::runtime_error("The split frame doesn't match a single context's.");
+                }
+            }
+
+            std::cerr << "Split frame check: " << frames << " frames matched one context's to within "
+                      << worst_error << "/255; the last split was";
+            for (size_t r = 0; r < renderer_count; ++r)
+                std::cerr << " " << first_instances[r + 1] - first_instances[r];
+            std::cerr << " of " << instances.size() << " instances." << std::endl;
+            passed = true;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "The split frame check failed: " << e.what() << std::endl;
+    }
+
+    for (size_t r = 0; r < secondary_count; ++r)
+    {
+        if (secondaries[r].window == nullptr)
+            continue;
+        secondaries[r].window->makeCurrent();
+        secondaries[r].target.reset();
+        secondaries[r].drawer.reset();
+        platform.destroyWindow(secondaries[r].window);
+    }
+    presenting.makeCurrent();
+    return passed;
+}
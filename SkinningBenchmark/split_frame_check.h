@@ -0,0 +1,19 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  split_frame_check.h
+/// \author Ben Crist
+///
+/// \brief  A check that a crowd split between several GL contexts, and
+///         composited on the presenting one, draws what one context would.
+
+#ifndef SPLIT_FRAME_CHECK_H_
+#define SPLIT_FRAME_CHECK_H_
+
+#include "demo.h"
+
+class Platform;
+class PlatformWindow;
+
+bool runSplitFrameCheck(Platform& platform, PlatformWindow& presenting, size_t renderer_count, size_t frames);
+
+#endif
@@ -0,0 +1,171 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  synthetic_rig.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the synthetic rig generation functions.
+///
+/// \details The rig is a strip lying along the x axis from -RIG_EXTENT to
+///         RIG_EXTENT, with a chain of joints spaced evenly along its length.
+///         Everything is generated deterministically, so a given
+///         configuration always produces exactly the same work.
+
+#include "synthetic_rig.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+const float RIG_EXTENT = 0.9f;          ///< Half the length of the strip.
+const float RIG_HALF_WIDTH = 0.1f;      ///< Half the width of the strip.
+const float MAX_TOTAL_BEND = 60.0f;     ///< The most the whole chain bends, in degrees.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the distance between neighboring joints of the chain.
+float getSegmentLength(size_t joint_count)
+{
+    return joint_count > 1 ? 2.0f * RIG_EXTENT / (joint_count - 1) : 0.0f;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a single chain of joints to a skeleton, each the child of
+///         the one before it.
+///
+/// \param  skeleton A skeleton with no joints.
+/// \param  joint_count The number of joints to add; at least 1.
+void buildSyntheticSkeleton(Skeleton& skeleton, size_t joint_count)
+{
+    skeleton.addJoint(Skeleton::NO_PARENT);
+    for (size_t joint = 1; joint < joint_count; ++joint)
+        skeleton.addJoint(int(joint - 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a root joint with many short chains of joints hanging off
+///         it, like hair or a cloth proxy, to a skeleton.
+///
+/// \details Only the hierarchy differs from buildSyntheticSkeleton()'s, so
+///         the same poses and transforms can be used with either; this one
+///         is wide and shallow instead of one long dependent chain.
+///
+/// \param  skeleton A skeleton with no joints.
+/// \param  joint_count The number of joints to add; at least 1.
+/// \param  strand_length The number of joints in each chain; at least 1.
+///         The last chain is shorter if the joints run out.
+void buildSyntheticStrands(Skeleton& skeleton, size_t joint_count, size_t strand_length)
+{
+    skeleton.addJoint(Skeleton::NO_PARENT);
+    for (size_t joint = 1; joint < joint_count; ++joint)
+        skeleton.addJoint((joint - 1) % strand_length == 0 ? 0 : int(joint - 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Fills in the straight, unrotated bind pose of a skeleton built by
+///         buildSyntheticSkeleton(), and its colors, if it has them.
+void setSyntheticBindPose(Pose& pose)
+{
+    float segment_length = getSegmentLength(pose.joint_count);
+    for (size_t joint = 0; joint < pose.joint_count; ++joint)
+    {
+        pose.translation[joint] = joint == 0 ? vec2(-RIG_EXTENT, 0) : vec2(segment_length, 0);
+        pose.rotation[joint] = 0.0f;
+        pose.scale[joint] = 1.0f;
+        if (pose.color != nullptr)
+            pose.color[joint] = color4(float(joint % 3 == 0), float(joint % 3 == 1), float(joint % 3 == 2), 1.0f);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Poses the chain for a frame of a looping wave animation.
+///
+/// \details Every joint but the root rotates, each a little out of phase
+///         with its parent, so every palette entry changes every frame.
+///
+/// \param  bind_pose The pose set up by setSyntheticBindPose().
+/// \param  frame The frame number.
+/// \param  pose Receives the animated pose.
+void animateSyntheticPose(const Pose& bind_pose, size_t frame, Pose& pose)
+{
+    copyPose(bind_pose, pose);
+
+    float amplitude = MAX_TOTAL_BEND / std::max(pose.joint_count, size_t(1));
+    for (size_t joint = 1; joint < pose.joint_count; ++joint)
+        pose.rotation[joint] = amplitude * std::sin(frame * 0.05f + joint * 0.5f);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates a gridded strip mesh along the chain.
+///
+/// \details The grid is roughly 16 times as long as it is wide, with at
+///         least as many vertices as requested.  Every vertex is influenced
+///         by exactly influence_count joints: the ones nearest to it along
+///         the chain, weighted by how near they are.
+///
+/// \param  vertex_count The minimum number of vertices to generate.
+/// \param  joint_count The number of joints in the skeleton.
+/// \param  influence_count The number of joints influencing each vertex,
+///         from 1 to MAX_JOINT_INFLUENCES, and no more than joint_count.
+/// \param  vertices Receives the vertices.
+/// \param  indices Receives the triangles' indices.
+void buildSyntheticMesh(size_t vertex_count, size_t joint_count, size_t influence_count,
+                        std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+    if (influence_count < 1 || influence_count > MAX_JOINT_INFLUENCES || influence_count > joint_count)
+        throw std::runtime_error("Each vertex needs between 1 and 4 influences, and no more than there are joints.");
+
+    size_t rows = std::max(size_t(2), size_t(std::sqrt(vertex_count / 16.0)));
+    size_t columns = std::max(size_t(2), (vertex_count + rows - 1) / rows);
+    float segment_length = getSegmentLength(joint_count);
+
+    vertices.clear();
+    vertices.reserve(rows * columns);
+    for (size_t column = 0; column < columns; ++column)
+    {
+        float x = -RIG_EXTENT + 2.0f * RIG_EXTENT * column / (columns - 1);
+        float u = segment_length > 0 ? (x + RIG_EXTENT) / segment_length : 0.0f;
+
+        // the window of influence_count joints centered on the nearest one.
+        int nearest = int(std::floor(u + 0.5f));
+        int first = std::min(std::max(nearest - int(influence_count - 1) / 2, 0), int(joint_count - influence_count));
+
+        Vertex v;
+        float total_weight = 0;
+        for (size_t i = 0; i < influence_count; ++i)
+        {
+            v.joint_indices[i] = GLuint(first + i);
+            v.joint_weights[i] = 1.0f / (1.0f + std::abs(u - (first + i)));
+            total_weight += v.joint_weights[i];
+        }
+        for (size_t i = 0; i < influence_count; ++i)
+            v.joint_weights[i] /= total_weight;
+
+        for (size_t row = 0; row < rows; ++row)
+        {
+            v.position = vec2(x, -RIG_HALF_WIDTH + 2.0f * RIG_HALF_WIDTH * row / (rows - 1));
+            vertices.push_back(v);
+        }
+    }
+
+    indices.clear();
+    indices.reserve((columns - 1) * (rows - 1) * 6);
+    for (size_t column = 0; column + 1 < columns; ++column)
+    {
+        for (size_t row = 0; row + 1 < rows; ++row)
+        {
+            GLuint a = GLuint(column * rows + row);
+            GLuint b = a + GLuint(rows);
+
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(a + 1);
+
+            indices.push_back(a + 1);
+            indices.push_back(b);
+            indices.push_back(b + 1);
+        }
+    }
+}
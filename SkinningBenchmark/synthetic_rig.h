@@ -0,0 +1,38 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  synthetic_rig.h
+/// \author Ben Crist
+///
+/// \brief  Functions for generating skeletons, meshes and animation of any
+///         size, for benchmarking.
+
+#ifndef SYNTHETIC_RIG_H_
+#define SYNTHETIC_RIG_H_
+
+#include "skeletal_mesh.h"
+#include "skeleton.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Describes the skeleton buildSyntheticSkeleton() builds with
+///         JOINT_COUNT joints, for SkeletonEval.
+template <size_t N>
+struct SyntheticChainRig
+{
+    enum { JOINT_COUNT = N };
+
+    template <size_t JOINT>
+    struct Parent
+    {
+        enum { VALUE = int(JOINT) - 1 };
+    };
+};
+
+void buildSyntheticSkeleton(Skeleton& skeleton, size_t joint_count);
+void buildSyntheticStrands(Skeleton& skeleton, size_t joint_count, size_t strand_length);
+void setSyntheticBindPose(Pose& pose);
+void animateSyntheticPose(const Pose& bind_pose, size_t frame, Pose& pose);
+
+void buildSyntheticMesh(size_t vertex_count, size_t joint_count, size_t influence_count,
+                        std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+#endif
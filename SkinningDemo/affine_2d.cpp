@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  affine_2d.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the Affine2D functions.
+
+#include "affine_2d.h"
+#include "joint_rotation.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform from a joint's local coordinate space to
+///         its parent's, like getJointLocalTransform() but as an Affine2D.
+///
+/// \param  pose The pose containing the joint.
+/// \param  joint The index of the joint to generate the transform for.
+Affine2D getJointLocalAffine(const Pose& pose, size_t joint)
+{
+    float s, c;
+    sinCosDegrees(pose.rotation[joint], s, c);
+    s *= pose.scale[joint];
+    c *= pose.scale[joint];
+
+    Affine2D affine;
+    affine.x_axis = vec2(c, s);
+    affine.y_axis = vec2(-s, c);
+    affine.translation = pose.translation[joint];
+    return affine;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates the local-to-parent transforms of every joint in a
+///         pose.
+///
+/// \details The sines and cosines dominate, so they're done a batch at a
+///         time with the stream sinCosDegrees(), and the affines built from
+///         them; there's nothing to transpose.
+///
+/// \param  pose The pose containing the joints.
+/// \param  affines An array of pose.joint_count transforms which receives
+///         the joints' local-to-parent transforms.
+void computeLocalAffines(const Pose& pose, Affine2D* affines)
+{
+    const size_t BATCH = 64;
+    ALIGN16 float sines[BATCH];
+    ALIGN16 float cosines[BATCH];
+    for (size_t first = 0; first < pose.joint_count; first += BATCH)
+    {
+        size_t batch = std::min(BATCH, pose.joint_count - first);
+        sinCosDegrees(&pose.rotation[first], batch, sines, cosines);
+        for (size_t i = 0; i < batch; ++i)
+        {
+            float scale = pose.scale[first + i];
+            Affine2D& affine = affines[first + i];
+            affine.x_axis = vec2(cosines[i], sines[i]) * scale;
+            affine.y_axis = vec2(-sines[i], cosines[i]) * scale;
+            affine.translation = pose.translation[first + i];
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates the local-to-parent transforms of every joint in a
+///         pose whose rotations are kept separately, as unit complex
+///         numbers.
+///
+/// \details Rotations blended with nlerpComplexes() are already the cosines
+///         and sines the transforms need, so this takes no trig at all.
+///         The pose's own rotation channel is ignored.
+///
+/// \param  pose The pose containing the joints' translations and scales.
+/// \param  rotations pose.joint_count unit complex numbers, (cos, sin), one
+///         per joint.
+/// \param  affines An array of pose.joint_count transforms which receives
+///         the joints' local-to-parent transforms.
+void computeLocalAffines(const Pose& pose, const vec2* rotations, Affine2D* affines)
+{
+    for (size_t joint = 0; joint < pose.joint_count; ++joint)
+    {
+        vec2 axis = rotations[joint] * pose.scale[joint];
+        affines[joint].x_axis = axis;
+        affines[joint].y_axis = vec2(-axis.y, axis.x);
+        affines[joint].translation = pose.translation[joint];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform which applies b, then a; the equivalent of
+///         a * b for matrices.
+Affine2D composeAffine(const Affine2D& a, const Affine2D& b)
+{
+    Affine2D result;
+    result.x_axis = a.x_axis * b.x_axis.x + a.y_axis * b.x_axis.y;
+    result.y_axis = a.x_axis * b.y_axis.x + a.y_axis * b.y_axis.y;
+    result.translation = a.x_axis * b.translation.x + a.y_axis * b.translation.y + a.translation;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the inverse of a transform.  Its axes must not be
+///         parallel.
+Affine2D inverseAffine(const Affine2D& affine)
+{
+    float inverse_det = 1.0f / (affine.x_axis.x * affine.y_axis.y - affine.y_axis.x * affine.x_axis.y);
+
+    Affine2D inverse;
+    inverse.x_axis = vec2(affine.y_axis.y, -affine.x_axis.y) * inverse_det;
+    inverse.y_axis = vec2(-affine.y_axis.x, affine.x_axis.x) * inverse_det;
+    inverse.translation = -(inverse.x_axis * affine.translation.x + inverse.y_axis * affine.translation.y);
+    return inverse;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the inverse of a joint transform: any combination of
+///         rotation, translation and uniform scale, in 2D or 3D.
+///
+/// \details The upper 3x3 of such a transform is a rotation times a scale
+///         s, so its inverse is its transpose divided by s squared, which is
+///         the squared length of any of its columns.  The translation is
+///         then carried back through that.  This is a fraction of the work
+///         of a general glm::inverse(), and just as accurate for these
+///         transforms; for anything with shear or non-uniform scale, it's
+///         wrong.
+mat4 inverseJointTransform(const mat4& transform)
+{
+    vec3 x_axis(transform[0]);
+    vec3 y_axis(transform[1]);
+    vec3 z_axis(transform[2]);
+    vec3 translation(transform[3]);
+    float inverse_scale_squared = 1.0f / glm::dot(x_axis, x_axis);
+
+    // the rows of the transposed 3x3 are the original columns.
+    vec3 row_0 = x_axis * inverse_scale_squared;
+    vec3 row_1 = y_axis * inverse_scale_squared;
+    vec3 row_2 = z_axis * inverse_scale_squared;
+    return mat4(row_0.x, row_1.x, row_2.x, 0,
+                row_0.y, row_1.y, row_2.y, 0,
+                row_0.z, row_1.z, row_2.z, 0,
+                -glm::dot(row_0, translation), -glm::dot(row_1, translation), -glm::dot(row_2, translation), 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the mat4 equivalent of a transform whose scale is
+///         uniform, scaling z by the same amount as x and y.
+mat4 affineToMat4(const Affine2D& affine)
+{
+    float z_scale = glm::length(affine.x_axis);
+    return mat4(affine.x_axis.x, affine.x_axis.y, 0, 0,
+                affine.y_axis.x, affine.y_axis.y, 0, 0,
+                0, 0, z_scale, 0,
+                affine.translation.x, affine.translation.y, 0, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the x and y part of a transform which doesn't mix z
+///         into x or y, such as a joint transform built from a Pose.
+Affine2D mat4ToAffine(const mat4& transform)
+{
+    Affine2D affine;
+    affine.x_axis = vec2(transform[0]);
+    affine.y_axis = vec2(transform[1]);
+    affine.translation = vec2(transform[3]);
+    return affine;
+}
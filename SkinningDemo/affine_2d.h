@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  affine_2d.h
+/// \author Ben Crist
+///
+/// \brief  The Affine2D struct, and functions for composing 2D joint
+///         transforms without going through mat4.
+
+#ifndef AFFINE_2D_H_
+#define AFFINE_2D_H_
+
+#include "pose.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A 2D affine transform, stored as the columns of a 3x2 matrix.
+///
+/// \details The joints of a Pose only ever translate, rotate about z and
+///         scale uniformly, so their mat4s are mostly zeros; these 6 floats
+///         are all that change.  Composing two of them takes 12 multiplies
+///         rather than a mat4 product's 64.
+///
+///         The z axis the mat4 transforms carry is left out: a joint's z
+///         scale is the same as its x and y scale, the length of x_axis, so
+///         affineToMat4() rebuilds it.  Arrays of Affine2D are tightly
+///         packed, so two joints fill three std140 vec4s, which is how the
+///         AFFINE_2D skinning shaders read them.
+struct Affine2D
+{
+    vec2 x_axis;        ///< The image of (1, 0).
+    vec2 y_axis;        ///< The image of (0, 1).
+    vec2 translation;   ///< The image of the origin.
+};
+
+Affine2D getJointLocalAffine(const Pose& pose, size_t joint);
+void computeLocalAffines(const Pose& pose, Affine2D* affines);
+void computeLocalAffines(const Pose& pose, const vec2* rotations, Affine2D* affines);
+
+Affine2D composeAffine(const Affine2D& a, const Affine2D& b);
+Affine2D inverseAffine(const Affine2D& affine);
+
+mat4 inverseJointTransform(const mat4& transform);
+
+mat4 affineToMat4(const Affine2D& affine);
+Affine2D mat4ToAffine(const mat4& transform);
+
+#endif
@@ -0,0 +1,447 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  animation_clip.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of AnimationClip and ClipSampler class functions.
+
+#include "animation_clip.h"
+#include "spline_kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a clip with an empty track for each joint.
+///
+/// \param  joint_count The number of joints in the skeleton being animated.
+/// \param  duration The length of the clip in seconds; the period when it's
+///         looped.
+AnimationClip::AnimationClip(size_t joint_count, float duration)
+    : tracks_(joint_count),
+      duration_(duration),
+      interpolation_(CLIP_INTERPOLATION_LINEAR),
+      additive_(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a key to the end of a joint's track.
+///
+/// \details Keys must be added in order of time, so tracks never need to be
+///         sorted.
+///
+/// \param  joint The joint to key.
+/// \param  time When the key is, in seconds; must be later than the track's
+///         last key.
+/// \param  translation The joint's translation relative to its parent.
+/// \param  rotation The joint's rotation in degrees.
+/// \param  scale The joint's uniform scale factor.
+void AnimationClip::addKey(size_t joint, float time, const vec2& translation, float rotation, float scale)
+{
+    assert(joint < tracks_.size());
+    Track& track = tracks_[joint];
+
+    if (!track.times.empty() && time <= track.times.back())
+    {
+        std::cerr << "Key at " << time << "s for joint " << joint << " is not after the track's last key." << std::endl;
+        throw std::runtime_error("Animation keys must be added in order of time.");
+    }
+
+    track.times.push_back(time);
+    track.translations.push_back(translation);
+    track.rotations.push_back(rotation);
+    track.scales.push_back(scale);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Keys every joint at the same time, from a pose.
+void AnimationClip::addPoseKeys(float time, const Pose& pose)
+{
+    assert(pose.joint_count == tracks_.size());
+    for (size_t joint = 0; joint < tracks_.size(); ++joint)
+        addKey(joint, time, pose.translation[joint], pose.rotation[joint], pose.scale[joint]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds an event to the clip's event track.
+///
+/// \details Unlike keys, events can be added in any order; each is
+///         inserted after any others at the same time, so the track stays
+///         sorted.
+///
+/// \param  time When the event happens, in seconds; from 0 up to, but not
+///         including, the clip's duration, for a looped clip.
+/// \param  id What happens, for whoever drains the events.
+void AnimationClip::addEvent(float time, GLuint id)
+{
+    AnimationEvent event;
+    event.time = time;
+    event.id = id;
+
+    std::vector<AnimationEvent>::iterator position = events_.begin();
+    while (position != events_.end() && position->time <= time)
+        ++position;
+    events_.insert(position, event);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves a joint's travel out of its track and into the clip's
+///         root motion track.
+///
+/// \details Every key of the joint is given its first key's translation,
+///         and the root motion track gets how far each key had moved from
+///         it.  The joint's rotation and scale are left in its track.  With
+///         the joint no longer travelling, the bounds of the vertices it
+///         and its descendants influence only need to cover the clip's
+///         poses, not its path, and the instance's own transform carries
+///         the path instead (see sampleRootMotion()).  Any root motion
+///         extracted before is replaced.  Keys must all have been added
+///         first.
+///
+/// \param  joint The joint to take the motion from; normally the root.
+void AnimationClip::extractRootMotion(size_t joint)
+{
+    assert(joint < tracks_.size());
+    Track& track = tracks_[joint];
+
+    root_motion_times_ = track.times;
+    root_motion_.resize(track.translations.size());
+    for (size_t key = 0; key < track.translations.size(); ++key)
+    {
+        root_motion_[key] = track.translations[key] - track.translations[0];
+        track.translations[key] = track.translations[0];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Turns every key into its difference from a reference pose, so
+///         the clip samples deltas to layer onto other poses.
+///
+/// \details The differences are taken as makeAdditivePose() takes them,
+///         rotations the shorter way around, once, when the clip is
+///         imported, rather than by whatever layers it every time it's
+///         sampled.  Keys must all have been added first, and the clip can
+///         only be made additive once.
+///
+/// \param  reference The pose the clip was authored relative to, such as
+///         the bind pose.
+void AnimationClip::makeAdditive(const Pose& reference)
+{
+    assert(reference.joint_count == tracks_.size());
+    if (additive_)
+    {
+        std::cerr << "The clip is already additive." << std::endl;
+        throw std::runtime_error("A clip can only be made additive once.");
+    }
+
+    for (size_t joint = 0; joint < tracks_.size(); ++joint)
+    {
+        Track& track = tracks_[joint];
+        for (size_t key = 0; key < track.times.size(); ++key)
+        {
+            float rotation = track.rotations[key] - reference.rotation[joint];
+            track.translations[key] -= reference.translation[joint];
+            track.rotations[key] = rotation - 360.0f * std::floor(rotation / 360.0f + 0.5f);
+            track.scales[key] -= reference.scale[joint];
+        }
+    }
+
+    additive_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets how the clip's channels move between keys.  Clips are
+///         linear unless this makes them cubic.
+///
+/// \details A cubic clip's keys can be several times further apart than a
+///         linear clip's for the same smoothness, since the curve bends
+///         through each key instead of turning sharply at it.  Root motion
+///         is always linear, since it's sampled a joint at a time anyway.
+void AnimationClip::setInterpolation(ClipInterpolation interpolation)
+{
+    interpolation_ = interpolation;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how far the clip's extracted root motion has moved the
+///         root from its first key at a given time.
+///
+/// \details Before the first key and after the last, the motion holds at
+///         that key's, like ClipSampler::sample(); a looping player wraps
+///         the time itself.  Without extracted root motion, this is zero.
+///
+/// \param  time The time to sample, in seconds.
+vec2 AnimationClip::sampleRootMotion(float time) const
+{
+    if (root_motion_.empty())
+        return vec2(0);
+
+    size_t next = std::upper_bound(root_motion_times_.begin(), root_motion_times_.end(), time) -
+                  root_motion_times_.begin();
+    if (next == 0)
+        return root_motion_.front();
+    if (next == root_motion_.size())
+        return root_motion_.back();
+
+    size_t key = next - 1;
+    float t = (time - root_motion_times_[key]) / (root_motion_times_[next] - root_motion_times_[key]);
+    return glm::mix(root_motion_[key], root_motion_[next], t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of tracks in the clip.
+size_t AnimationClip::getJointCount() const
+{
+    return tracks_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the clip's length in seconds.
+float AnimationClip::getDuration() const
+{
+    return duration_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how the clip's channels move between keys.
+ClipInterpolation AnimationClip::getInterpolation() const
+{
+    return interpolation_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a joint's track.
+const AnimationClip::Track& AnimationClip::getTrack(size_t joint) const
+{
+    assert(joint < tracks_.size());
+    return tracks_[joint];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the clip's events, sorted by time.
+const std::vector<AnimationEvent>& AnimationClip::getEvents() const
+{
+    return events_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns whether root motion has been extracted from the clip.
+bool AnimationClip::hasRootMotion() const
+{
+    return !root_motion_.empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns whether the clip's keys are deltas from a reference
+///         pose; see makeAdditive().
+bool AnimationClip::isAdditive() const
+{
+    return additive_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a sampler positioned at the start of a clip.  The clip
+///         must outlive the sampler.
+ClipSampler::ClipSampler(const AnimationClip& clip)
+    : clip_(&clip),
+      cursors_(clip.getJointCount(), 0),
+      last_time_(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the clip's joint channels at a given time into a pose.
+///
+/// \details Before a track's first key the joint takes that key's values,
+///         and after its last key it holds the last key's values.  Joints
+///         with empty tracks, and every joint's color, are left alone.  A
+///         cubic clip is sampled by sampleCubic().
+///
+/// \param  time The time to sample, in seconds.
+/// \param  pose The pose to write to; must have one joint per track.
+/// \param  mask The joints to sample, or null for all of them.  The rest
+///         are left alone too.
+void ClipSampler::sample(float time, Pose& pose, const JointMask* mask)
+{
+    assert(mask == nullptr || mask->getJointCount() == cursors_.size());
+    assert(pose.joint_count == clip_->getJointCount());
+
+    if (time < last_time_)
+        cursors_.assign(cursors_.size(), 0);
+    last_time_ = time;
+
+    if (clip_->getInterpolation() == CLIP_INTERPOLATION_CUBIC)
+    {
+        sampleCubic(time, pose, mask);
+        return;
+    }
+
+    size_t joint_count = cursors_.size();
+    for (size_t joint = getFirstMaskedJoint(mask); joint < joint_count; joint = getNextMaskedJoint(mask, joint))
+    {
+        const AnimationClip::Track& track = clip_->getTrack(joint);
+        size_t key_count = track.times.size();
+        if (key_count == 0)
+            continue;
+
+        size_t& cursor = cursors_[joint];
+        while (cursor + 1 < key_count && track.times[cursor + 1] <= time)
+            ++cursor;
+
+        size_t next = cursor + 1 < key_count ? cursor + 1 : cursor;
+        float t = 0;
+        if (next != cursor && time > track.times[cursor])
+            t = (time - track.times[cursor]) / (track.times[next] - track.times[cursor]);
+
+        pose.translation[joint] = glm::mix(track.translations[cursor], track.translations[next], t);
+        pose.rotation[joint] = glm::mix(track.rotations[cursor], track.rotations[next], t);
+        pose.scale[joint] = glm::mix(track.scales[cursor], track.scales[next], t);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a cubic clip's joint channels at a given time into a pose,
+///         once sample() has moved back to the start, if it needs to.
+///
+/// \details Each segment between two keys takes its tangents from the keys
+///         either side of it, as glm::catmullRom().  At either end of a
+///         track, the missing neighbour is the end key's partner reflected
+///         through it, so the curve leaves its first key and arrives at its
+///         last heading straight along the line between the two keys, as a
+///         linear clip would.  Outside its keys a track holds, as a linear
+///         one does.
+///
+/// \param  time The time to sample, in seconds.
+/// \param  pose The pose to write to.
+/// \param  mask The joints to sample, or null for all of them.
+void ClipSampler::sampleCubic(float time, Pose& pose, const JointMask* mask)
+{
+    const size_t CHANNELS = 4;
+    size_t channel_count = cursors_.size() * CHANNELS;
+    p0_.resize(channel_count);
+    p1_.resize(channel_count);
+    p2_.resize(channel_count);
+    p3_.resize(channel_count);
+    s_.resize(channel_count);
+
+    // gather the keys around the time.  Tracks without keys, or outside
+    // the mask, are skipped, so the arrays only fill as far as the joints
+    // being sampled need.
+    size_t joint_count = cursors_.size();
+    size_t channel = 0;
+    for (size_t joint = getFirstMaskedJoint(mask); joint < joint_count; joint = getNextMaskedJoint(mask, joint))
+    {
+        const AnimationClip::Track& track = clip_->getTrack(joint);
+        size_t key_count = track.times.size();
+        if (key_count == 0)
+            continue;
+
+        size_t& cursor = cursors_[joint];
+        while (cursor + 1 < key_count && track.times[cursor + 1] <= time)
+            ++cursor;
+
+        size_t next = cursor + 1 < key_count ? cursor + 1 : cursor;
+        float s = 0;
+        if (next != cursor && time > track.times[cursor])
+            s = (time - track.times[cursor]) / (track.times[next] - track.times[cursor]);
+
+        const size_t keys[4] = { cursor > 0 ? cursor - 1 : cursor, cursor, next,
+                                 next + 1 < key_count ? next + 1 : next };
+        float* const streams[4] = { &p0_[channel], &p1_[channel], &p2_[channel], &p3_[channel] };
+        for (size_t k = 0; k < 4; ++k)
+        {
+            streams[k][0] = track.translations[keys[k]].x;
+            streams[k][1] = track.translations[keys[k]].y;
+            streams[k][2] = track.rotations[keys[k]];
+            streams[k][3] = track.scales[keys[k]];
+        }
+        for (size_t c = 0; c < CHANNELS; ++c)
+        {
+            if (keys[0] == cursor)
+                p0_[channel + c] = 2.0f * p1_[channel + c] - p2_[channel + c];
+            if (keys[3] == next)
+                p3_[channel + c] = 2.0f * p2_[channel + c] - p1_[channel + c];
+            s_[channel + c] = s;
+        }
+
+        channel += CHANNELS;
+    }
+
+    if (channel == 0)
+        return;
+    catmullRomStream(&p0_[0], &p1_[0], &p2_[0], &p3_[0], &s_[0], &p1_[0], channel);
+
+    channel = 0;
+    for (size_t joint = getFirstMaskedJoint(mask); joint < joint_count; joint = getNextMaskedJoint(mask, joint))
+    {
+        if (clip_->getTrack(joint).times.empty())
+            continue;
+
+        pose.translation[joint] = vec2(p1_[channel], p1_[channel + 1]);
+        pose.rotation[joint] = p1_[channel + 2];
+        pose.scale[joint] = p1_[channel + 3];
+        channel += CHANNELS;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Samples the clip as though it repeats forever.
+///
+/// \param  time The time to sample, in seconds; any time, even negative,
+///         is wrapped into the clip's duration first.
+/// \param  pose The pose to write to; must have one joint per track.
+/// \param  mask The joints to sample, or null for all of them.
+void ClipSampler::sampleLooped(float time, Pose& pose, const JointMask* mask)
+{
+    float duration = clip_->getDuration();
+    if (duration > 0)
+    {
+        time = std::fmod(time, duration);
+        if (time < 0)
+            time += duration;
+    }
+
+    sample(time, pose, mask);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Pushes the events the clip's looped playback crossed since the
+///         last call to a queue.
+///
+/// \details The first call after the sampler is created or reset only takes
+///         up its position.  The events are found separately from sampling
+///         the pose, so they can be emitted on frames the pose isn't
+///         sampled, and sampling alone never emits them.
+///
+/// \param  time The time playback has reached, in seconds; wrapped into the
+///         clip's duration, as sampleLooped().
+/// \param  instance Passed on in each AnimationNotify.
+/// \param  weight The weight the clip is being blended with, passed on in
+///         each AnimationNotify.
+/// \param  queue The queue to push the events to.
+void ClipSampler::emitLoopedEvents(float time, GLuint instance, float weight, AnimationEventQueue& queue)
+{
+    float duration = clip_->getDuration();
+    if (duration > 0)
+    {
+        time = std::fmod(time, duration);
+        if (time < 0)
+            time += duration;
+    }
+
+    event_cursor_.advance(clip_->getEvents(), time, true, instance, weight, queue);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves every cursor back to the first key, and forgets where the
+///         events were up to.
+void ClipSampler::reset()
+{
+    cursors_.assign(cursors_.size(), 0);
+    last_time_ = 0;
+    event_cursor_.reset();
+}
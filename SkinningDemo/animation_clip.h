@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  animation_clip.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the AnimationClip and ClipSampler classes.
+
+#ifndef ANIMATION_CLIP_H_
+#define ANIMATION_CLIP_H_
+
+#include "demo.h"
+#include "animation_events.h"
+#include "joint_mask.h"
+#include "pose.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  How a clip's channels move between its keys.
+enum ClipInterpolation
+{
+    CLIP_INTERPOLATION_LINEAR = 0,  ///< Straight lines between keys, like blendPoses().
+    CLIP_INTERPOLATION_CUBIC        ///< Smooth curves through the keys; see AnimationClip and CompressedClip.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A keyframed animation of every joint of a skeleton.
+///
+/// \details Each joint has its own track of keys, so joints can be keyed at
+///         different times and rates.  A key sets the joint's translation,
+///         rotation and scale; colors aren't animated.  Tracks are stored as
+///         a structure of arrays, sorted by time, and between two keys each
+///         channel is linearly interpolated, like blendPoses(), unless the
+///         clip is made cubic.  A cubic clip follows the Catmull-Rom spline
+///         through each track's keys instead, which is smooth across every
+///         key, so sparse keys no longer show as corners in the motion.
+///
+///         A clip can have its root joint's travel taken out of its track
+///         into a root motion track, with extractRootMotion(), so the
+///         joint stays put and whatever plays the clip moves the whole
+///         instance instead.
+///
+///         A clip can be made additive, with makeAdditive(), which takes a
+///         reference pose out of every key once, so its samples are deltas
+///         for addPoseDelta() or BlendGraph::addAdditiveDelta() to layer
+///         onto another pose: breathing or leaning on top of whatever the
+///         body is doing, without sampling and subtracting the reference
+///         each frame.
+///
+///         A clip also has a track of events, like footsteps, sorted by
+///         time, which its samplers emit as playback crosses them.
+class AnimationClip
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The keys of a single joint, in order of time.
+    struct Track
+    {
+        std::vector<float> times;           ///< In seconds from the start of the clip.
+        std::vector<vec2> translations;
+        std::vector<float> rotations;       ///< In degrees.
+        std::vector<float> scales;
+    };
+
+    AnimationClip(size_t joint_count, float duration);
+
+    void addKey(size_t joint, float time, const vec2& translation, float rotation, float scale);
+    void addPoseKeys(float time, const Pose& pose);
+    void addEvent(float time, GLuint id);
+    void extractRootMotion(size_t joint);
+    void makeAdditive(const Pose& reference);
+    void setInterpolation(ClipInterpolation interpolation);
+    vec2 sampleRootMotion(float time) const;
+
+    size_t getJointCount() const;
+    float getDuration() const;
+    ClipInterpolation getInterpolation() const;
+    const Track& getTrack(size_t joint) const;
+    const std::vector<AnimationEvent>& getEvents() const;
+    bool hasRootMotion() const;
+    bool isAdditive() const;
+
+private:
+    std::vector<Track> tracks_;
+    std::vector<AnimationEvent> events_;
+    std::vector<float> root_motion_times_;
+    std::vector<vec2> root_motion_;         ///< How far the root has travelled from its first key, at each key.
+    float duration_;
+    ClipInterpolation interpolation_;
+    bool additive_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Samples an AnimationClip into a Pose.
+///
+/// \details The sampler remembers which key each track was last sampled
+///         at.  As long as playback moves forward, finding the keys around
+///         the next sample time only steps past the keys in between, which
+///         is usually none or one, instead of searching the whole track.
+///         Sampling an earlier time (or looping back to the start) restarts
+///         the search from the first key.
+///
+///         The clip's events are found the same way, by a cursor of their
+///         own (see AnimationEventCursor).
+///
+///         Each sampler has its own cursors, so every independently playing
+///         instance of a clip needs its own sampler.
+///
+///         A layer which only drives some joints, like an upper body, can
+///         sample just those, with a JointMask: the other tracks aren't
+///         searched or interpolated at all, and their joints are left as
+///         they were in the pose.  A skipped track's cursor catches up the
+///         next time it's sampled.
+///
+///         A cubic clip is sampled in passes, like CompressedClipSampler:
+///         each joint's four keys around the time are gathered into flat
+///         arrays, one element per channel, which catmullRomStream()
+///         interpolates all at once, and the results are scattered into the
+///         pose.
+class ClipSampler
+{
+public:
+    explicit ClipSampler(const AnimationClip& clip);
+
+    void sample(float time, Pose& pose, const JointMask* mask = nullptr);
+    void sampleLooped(float time, Pose& pose, const JointMask* mask = nullptr);
+    void emitLoopedEvents(float time, GLuint instance, float weight, AnimationEventQueue& queue);
+    void reset();
+
+private:
+    void sampleCubic(float time, Pose& pose, const JointMask* mask);
+
+    const AnimationClip* clip_;
+    std::vector<size_t> cursors_;   ///< The last key at or before last_time_ in each track.
+    float last_time_;
+    AnimationEventCursor event_cursor_;
+
+    // scratch space for sampleCubic(), one element per channel of each joint
+    // with keys.
+    std::vector<float> p0_;
+    std::vector<float> p1_;
+    std::vector<float> p2_;
+    std::vector<float> p3_;
+    std::vector<float> s_;
+};
+
+#endif
@@ -0,0 +1,207 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  animation_events.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of AnimationEventCursor and AnimationEventQueue
+///         class functions.
+
+#include "animation_events.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Orders a time before the events after it, for std::upper_bound().
+bool isBeforeEvent(float time, const AnimationEvent& event)
+{
+    return time < event.time;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a cursor which takes up its position on its first
+///         advance().
+AnimationEventCursor::AnimationEventCursor()
+    : next_(0),
+      last_time_(0),
+      positioned_(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves the cursor to a new time, and pushes every event crossed
+///         on the way to a queue.
+///
+/// \details An event is crossed if it's after the last time and at or
+///         before the new one.  A clip which isn't looped seeks back to an
+///         earlier time without emitting anything.
+///
+/// \param  events The clip's events, sorted by time.  It must be the same
+///         clip every time, until the cursor is reset.
+/// \param  time The time within the clip, in seconds.
+/// \param  looped Whether the clip is playing looped, so that an earlier
+///         time means it wrapped around.
+/// \param  instance Passed on in each AnimationNotify, to say who crossed it.
+/// \param  weight Passed on in each AnimationNotify.
+/// \param  queue The queue to push the events to.
+void AnimationEventCursor::advance(const std::vector<AnimationEvent>& events, float time, bool looped,
+                                   GLuint instance, float weight, AnimationEventQueue& queue)
+{
+    size_t count = events.size();
+    if (!positioned_ || (time < last_time_ && !looped))
+    {
+        next_ = std::upper_bound(events.begin(), events.end(), time, isBeforeEvent) - events.begin();
+        last_time_ = time;
+        positioned_ = true;
+        return;
+    }
+
+    AnimationNotify notify;
+    notify.instance = instance;
+    notify.weight = weight;
+
+    // wrapping around finishes off the clip before starting it again.
+    if (time < last_time_)
+    {
+        for (; next_ < count; ++next_)
+        {
+            notify.id = events[next_].id;
+            queue.push(notify);
+        }
+        next_ = 0;
+    }
+
+    for (; next_ < count && events[next_].time <= time; ++next_)
+    {
+        notify.id = events[next_].id;
+        queue.push(notify);
+    }
+    last_time_ = time;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forgets the cursor's position, so the next advance() takes up a
+///         new one without emitting anything; for when playback stops, or
+///         jumps.
+void AnimationEventCursor::reset()
+{
+    next_ = 0;
+    last_time_ = 0;
+    positioned_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty queue.
+///
+/// \param  capacity The most records the queue can hold at once; rounded up
+///         to a power of two.
+AnimationEventQueue::AnimationEventQueue(size_t capacity)
+    : enqueue_position_(0),
+      dequeue_position_(0),
+      dropped_(0)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+
+    cells_ = new Cell[size];
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; ++i)
+        cells_[i].sequence.store(i);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees the queue's cells, and anything left in them.
+AnimationEventQueue::~AnimationEventQueue()
+{
+    delete[] cells_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a record to the back of the queue.
+///
+/// \details A cell whose sequence equals the enqueue position is free for
+///         that position; one behind it still holds a record from a lap
+///         ago, so the queue is full.  Any other thread may push or pop at
+///         the same time.
+///
+/// \param  notify The record to add.
+/// \return True if it was added, or false if the queue was full, and it was
+///         dropped.
+bool AnimationEventQueue::push(const AnimationNotify& notify)
+{
+    size_t position = enqueue_position_.load();
+    for (;;)
+    {
+        Cell& cell = cells_[position & mask_];
+        ptrdiff_t difference = ptrdiff_t(cell.sequence.load()) - ptrdiff_t(position);
+        if (difference == 0)
+        {
+            if (enqueue_position_.compare_exchange_weak(position, position + 1))
+            {
+                cell.notify = notify;
+                cell.sequence.store(position + 1);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            ++dropped_;
+            return false;
+        }
+        else
+            position = enqueue_position_.load();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes the record at the front of the queue.
+///
+/// \details A cell whose sequence is one past the dequeue position has been
+///         published for it; once taken, its sequence moves a lap ahead,
+///         freeing it for the push which wraps around to it.  Any other
+///         thread may push or pop at the same time.
+///
+/// \param  notify Receives the record.
+/// \return True if a record was taken, or false if the queue was empty.
+bool AnimationEventQueue::pop(AnimationNotify& notify)
+{
+    size_t position = dequeue_position_.load();
+    for (;;)
+    {
+        Cell& cell = cells_[position & mask_];
+        ptrdiff_t difference = ptrdiff_t(cell.sequence.load()) - ptrdiff_t(position + 1);
+        if (difference == 0)
+        {
+            if (dequeue_position_.compare_exchange_weak(position, position + 1))
+            {
+                notify = cell.notify;
+                cell.sequence.store(position + mask_ + 1);
+                return true;
+            }
+        }
+        else if (difference < 0)
+            return false;
+        else
+            position = dequeue_position_.load();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the most records the queue can hold at once.
+size_t AnimationEventQueue::getCapacity() const
+{
+    return mask_ + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of records dropped because the queue was
+///         full, since it was created.
+size_t AnimationEventQueue::getDroppedCount() const
+{
+    return dropped_.load();
+}
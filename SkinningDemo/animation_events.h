@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  animation_events.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the AnimationEventCursor and
+///         AnimationEventQueue classes, and the events clips carry.
+
+#ifndef ANIMATION_EVENTS_H_
+#define ANIMATION_EVENTS_H_
+
+#include "demo.h"
+#include <atomic>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Something which happens at a moment of a clip, like a footstep
+///         or an effect spawning.
+struct AnimationEvent
+{
+    float time;     ///< In seconds from the start of the clip.
+    GLuint id;      ///< What happens; what each id means is up to whoever drains the events.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An event one instance's playback of a clip crossed.
+struct AnimationNotify
+{
+    GLuint id;          ///< The event's id.
+    GLuint instance;    ///< Whatever the player passed to identify itself.
+    float weight;       ///< The weight the clip was being blended with, so a listener can ignore clips which barely show.
+};
+
+class AnimationEventQueue;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the events a clip's playback crosses from one sample to
+///         the next.
+///
+/// \details The cursor remembers the first event after the time it last
+///         advanced to.  Moving forward only steps past the events in
+///         between, which is usually none, so advancing costs the same
+///         however many events the clip has.  Looping back to the start
+///         emits the events up to the end of the clip, then the ones from
+///         its start; a looped clip is taken never to play backwards, so
+///         an earlier time is always a loop.  Only the time within the
+///         clip is passed in, so a jump of a whole loop or more looks like
+///         less than one, and emits each event at most once.
+///
+///         A cursor which hasn't advanced since it was created or reset
+///         takes up its position without emitting anything, so a player
+///         starting partway through a clip doesn't hear everything before
+///         that point.  Finding it is a binary search, once.
+///
+///         Each cursor follows one playback, so every independently
+///         playing instance of a clip needs its own.
+class AnimationEventCursor
+{
+public:
+    AnimationEventCursor();
+
+    void advance(const std::vector<AnimationEvent>& events, float time, bool looped,
+                 GLuint instance, float weight, AnimationEventQueue& queue);
+    void reset();
+
+private:
+    size_t next_;       ///< The first event after last_time_.
+    float last_time_;
+    bool positioned_;   ///< Whether next_ and last_time_ mean anything yet.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A bounded, lock-free queue of AnimationNotify records, which any
+///         number of threads can push to and drain at once.
+///
+/// \details The players of a frame's clips push the events they cross, and
+///         gameplay threads pop them, without ever taking a lock or
+///         allocating.  Each cell carries a sequence number saying whose
+///         turn it is: a pusher claims the next cell by advancing the
+///         enqueue position with a compare-exchange, once the cell's
+///         sequence says it's been drained, and publishes the record by
+///         bumping the sequence; a popper does the same on the other side.
+///         No record is ever seen half written.
+///
+///         The capacity is fixed, and rounded up to a power of two.  Only a
+///         frame or so's events should be waiting, so once it's full, new
+///         events are dropped and counted rather than blocking the players.
+class AnimationEventQueue
+{
+public:
+    explicit AnimationEventQueue(size_t capacity);
+    ~AnimationEventQueue();
+
+    bool push(const AnimationNotify& notify);
+    bool pop(AnimationNotify& notify);
+
+    size_t getCapacity() const;
+    size_t getDroppedCount() const;
+
+private:
+    AnimationEventQueue(const AnimationEventQueue&);            // non-copyable
+    AnimationEventQueue& operator=(const AnimationEventQueue&); // non-copyable
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        AnimationNotify notify;
+    };
+
+    Cell* cells_;
+    size_t mask_;
+    char padding0_[64];                     ///< Keeps the two ends on separate cache lines.
+    std::atomic<size_t> enqueue_position_;
+    char padding1_[64];
+    std::atomic<size_t> dequeue_position_;
+    std::atomic<size_t> dropped_;
+};
+
+#endif
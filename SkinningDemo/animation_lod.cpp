@@ -0,0 +1,210 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  animation_lod.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementation of the AnimationLodScheduler class.
+
+#include "animation_lod.h"
+
+#include <algorithm>
+#include <cassert>
+
+const size_t AnimationLodScheduler::NO_LEADER;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets up the scheduler for a crowd.
+///
+/// \param  levels The animation settings of each level of detail.  Every
+///         update interval must be at least 1.
+/// \param  level_count The number of levels.
+/// \param  share_groups The share group of each instance of the crowd.
+AnimationLodScheduler::AnimationLodScheduler(const AnimationLodLevel* levels, size_t level_count,
+                                             const std::vector<size_t>& share_groups)
+    : levels_(levels, levels + level_count),
+      share_groups_(share_groups),
+      group_count_(0),
+      instances_(share_groups.size()),
+      frame_(0),
+      evaluation_count_(0),
+      leader_count_(0)
+{
+    for (size_t i = 0; i < level_count; ++i)
+        assert(levels[i].update_interval > 0);
+
+    for (size_t instance = 0; instance < share_groups_.size(); ++instance)
+    {
+        InstanceState& state = instances_[instance];
+        state.level = 0;
+        state.leader = instance;
+        state.last_evaluation = 0;
+        state.valid = false;
+        state.has_previous = false;
+        state.evaluate = false;
+        state.interpolation = 1.0f;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Works out what each instance needs this frame, with the share
+///         groups given to the constructor.
+///
+/// \param  instance_levels The level of detail of each instance.
+void AnimationLodScheduler::beginFrame(const GLuint* instance_levels)
+{
+    beginFrame(instance_levels, share_groups_.data());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Works out what each instance needs this frame, with this
+///         frame's share groups.
+///
+/// \details A follower whose group's leader changes starts over when it's
+///         next a leader, as with any follower, so groups which change from
+///         frame to frame are only worth sharing at levels which evaluate
+///         every frame anyway.
+///
+/// \param  instance_levels The level of detail of each instance.
+/// \param  share_groups The share group of each instance, this frame.
+void AnimationLodScheduler::beginFrame(const GLuint* instance_levels, const size_t* share_groups)
+{
+    group_count_ = 0;
+    for (size_t instance = 0; instance < instances_.size(); ++instance)
+        group_count_ = std::max(group_count_, share_groups[instance] + 1);
+
+    group_leaders_.assign(levels_.size() * group_count_, NO_LEADER);
+    evaluation_count_ = 0;
+    leader_count_ = 0;
+
+    for (size_t instance = 0; instance < instances_.size(); ++instance)
+    {
+        InstanceState& state = instances_[instance];
+        size_t level = instance_levels[instance];
+        assert(level < levels_.size());
+
+        if (level != state.level)
+            state.valid = false;
+        state.level = level;
+
+        if (levels_[level].share_poses)
+        {
+            size_t& leader = group_leaders_[level * group_count_ + share_groups[instance]];
+            if (leader != NO_LEADER)
+            {
+                // followers don't keep any poses of their own, so if one
+                // becomes a leader it has to start over.
+                state.leader = leader;
+                state.valid = false;
+                state.evaluate = false;
+                state.interpolation = 1.0f;
+                continue;
+            }
+            leader = instance;
+        }
+
+        state.leader = instance;
+        ++leader_count_;
+
+        // the unsigned differences below are correct even if the frame
+        // numbers wrap.
+        size_t interval = levels_[level].update_interval;
+        if (!state.valid)
+        {
+            state.valid = true;
+            state.has_previous = false;
+            state.evaluate = true;
+            state.last_evaluation = frame_ - instance % interval;
+        }
+        else if (frame_ - state.last_evaluation >= interval)
+        {
+            state.has_previous = true;
+            state.evaluate = true;
+            state.last_evaluation = frame_;
+        }
+        else
+            state.evaluate = false;
+
+        state.interpolation = 1.0f;
+        if (state.has_previous)
+            state.interpolation = std::min(float(frame_ - state.last_evaluation + 1) / interval, 1.0f);
+
+        if (state.evaluate)
+            ++evaluation_count_;
+    }
+
+    ++frame_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Makes every instance start over next frame.
+void AnimationLodScheduler::reset()
+{
+    for (size_t instance = 0; instance < instances_.size(); ++instance)
+        instances_[instance].valid = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of instances in the crowd.
+size_t AnimationLodScheduler::getInstanceCount() const
+{
+    return instances_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the instance whose palette an instance reuses this frame,
+///         which is the instance itself if it's a leader.
+size_t AnimationLodScheduler::getLeader(size_t instance) const
+{
+    return instances_[instance].leader;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if an instance has its own pose this frame.
+bool AnimationLodScheduler::isLeader(size_t instance) const
+{
+    return instances_[instance].leader == instance;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a leader's pose must be evaluated this frame.
+///
+/// \details When it is, the pose evaluated last time becomes the one to
+///         interpolate from.
+bool AnimationLodScheduler::needsEvaluation(size_t instance) const
+{
+    return instances_[instance].evaluate;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how far a leader should be drawn from the pose evaluated
+///         before last toward the one evaluated last.  When this is 1, the
+///         last pose can be used as it is.
+float AnimationLodScheduler::getInterpolation(size_t instance) const
+{
+    return instances_[instance].interpolation;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of poses evaluated this frame.
+size_t AnimationLodScheduler::getEvaluationCount() const
+{
+    return evaluation_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of instances with their own poses this frame.
+size_t AnimationLodScheduler::getLeaderCount() const
+{
+    return leader_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the longest update interval of any level.  A crowd whose
+///         inputs stop changing has settled after twice this many frames.
+size_t AnimationLodScheduler::getMaxUpdateInterval() const
+{
+    size_t interval = 1;
+    for (size_t level = 0; level < levels_.size(); ++level)
+        interval = std::max(interval, levels_[level].update_interval);
+    return interval;
+}
@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  animation_lod.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the AnimationLodScheduler class.
+
+#ifndef ANIMATION_LOD_H_
+#define ANIMATION_LOD_H_
+
+#include "demo.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  How the instances of a crowd at one level of detail are animated.
+struct AnimationLodLevel
+{
+    size_t update_interval; ///< The number of frames between evaluations of an instance's pose.
+    bool share_poses;       ///< Instances in the same share group reuse the first one's pose and palette.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decides, frame by frame, which instances of a crowd need their
+///         poses evaluated, and which can get away with less.
+///
+/// \details Each instance is animated according to the AnimationLodLevel of
+///         its level of detail:
+///
+///         - An instance whose level has an update interval of n only has
+///           its pose evaluated every n frames.  In between, it's drawn
+///           interpolated between its last two evaluated poses, so it
+///           moves smoothly, just up to n - 1 frames behind.  Instances
+///           start out spread over the n frames, so that the evaluations
+///           are spread out too.
+///
+///         - Instances which would be animated identically are put in the
+///           same share group by the caller.  At a level which shares
+///           poses, only the first instance at that level in each group
+///           (its leader) is evaluated at all, and the rest reuse its
+///           palette.  The groups can be given afresh each frame
+///           instead, for instance by an AnimationStateCache, so that only
+///           the instances animated identically that frame are grouped.
+///
+///         An instance whose level changes starts over, with its pose
+///         evaluated straight away and not interpolated until it has been
+///         evaluated twice.  reset() starts every instance over, for when
+///         the crowd hasn't been animated for a while and the poses it
+///         would interpolate between are stale.
+///
+///         beginFrame() must be called once per frame, before any of the
+///         other functions are used for that frame; they can then be
+///         called from any thread.
+class AnimationLodScheduler
+{
+public:
+    AnimationLodScheduler(const AnimationLodLevel* levels, size_t level_count,
+                          const std::vector<size_t>& share_groups);
+
+    void beginFrame(const GLuint* instance_levels);
+    void beginFrame(const GLuint* instance_levels, const size_t* share_groups);
+    void reset();
+
+    size_t getInstanceCount() const;
+    size_t getLeader(size_t instance) const;
+    bool isLeader(size_t instance) const;
+    bool needsEvaluation(size_t instance) const;
+    float getInterpolation(size_t instance) const;
+
+    size_t getEvaluationCount() const;
+    size_t getLeaderCount() const;
+    size_t getMaxUpdateInterval() const;
+
+private:
+    static const size_t NO_LEADER = size_t(-1);
+
+    struct InstanceState
+    {
+        size_t level;           ///< The instance's level of detail as of the last frame.
+        size_t leader;          ///< The instance whose pose this one is drawn with; itself if it's a leader.
+        size_t last_evaluation; ///< The frame the pose was last evaluated in.
+        bool valid;             ///< The instance was a leader at the same level last frame.
+        bool has_previous;      ///< The pose before the last one is still around to interpolate from.
+        bool evaluate;          ///< The pose is evaluated this frame.
+        float interpolation;    ///< How far to draw the pose from the previous evaluation to the last.
+    };
+
+    std::vector<AnimationLodLevel> levels_;
+    std::vector<size_t> share_groups_;
+    size_t group_count_;
+    std::vector<size_t> group_leaders_;     ///< The leader of each share group at each level, this frame.
+    std::vector<InstanceState> instances_;
+    size_t frame_;
+    size_t evaluation_count_;
+    size_t leader_count_;
+};
+
+#endif
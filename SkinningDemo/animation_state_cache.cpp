@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  animation_state_cache.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of AnimationStateKey and AnimationStateCache
+///         functions.
+
+#include "animation_state_cache.h"
+
+#include <cassert>
+#include <cmath>
+
+const size_t AnimationStateKey::MAX_WEIGHTS;
+const size_t AnimationStateCache::NO_STATE;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the key of an instance which plays no clip, with every
+///         weight 0.
+AnimationStateKey::AnimationStateKey()
+    : clip(0),
+      time(0)
+{
+    for (size_t i = 0; i < MAX_WEIGHTS; ++i)
+        weights[i] = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two keys are the same state.
+bool AnimationStateKey::operator==(const AnimationStateKey& other) const
+{
+    if (clip != other.clip || time != other.time)
+        return false;
+
+    for (size_t i = 0; i < MAX_WEIGHTS; ++i)
+    {
+        if (weights[i] != other.weights[i])
+            return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two keys are different states.
+bool AnimationStateKey::operator!=(const AnimationStateKey& other) const
+{
+    return !(*this == other);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty cache.
+///
+/// \param  max_states The most keys added between calls to clear();
+///         typically the number of instances in the crowd.
+AnimationStateCache::AnimationStateCache(size_t max_states)
+    : max_states_(max_states)
+{
+    size_t table_size = 1;
+    while (table_size < 2 * max_states)
+        table_size *= 2;
+
+    table_.assign(table_size, NO_STATE);
+    keys_.reserve(max_states);
+    owners_.reserve(max_states);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forgets every state, for the next frame's keys.
+void AnimationStateCache::clear()
+{
+    // only the slots in use need clearing.
+    size_t mask = table_.size() - 1;
+    for (size_t state = 0; state < keys_.size(); ++state)
+    {
+        size_t slot = hashKey(keys_[state]) & mask;
+        while (table_[slot] != NO_STATE)
+        {
+            table_[slot] = NO_STATE;
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    keys_.clear();
+    owners_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the state of an instance's key, making it the owner of a
+///         new state if no instance has had the key since the last clear().
+///
+/// \return The state, from 0 to getStateCount() - 1.
+size_t AnimationStateCache::add(const AnimationStateKey& key, size_t instance)
+{
+    size_t mask = table_.size() - 1;
+    size_t slot = hashKey(key) & mask;
+    for (; table_[slot] != NO_STATE; slot = (slot + 1) & mask)
+    {
+        if (keys_[table_[slot]] == key)
+            return table_[slot];
+    }
+
+    assert(keys_.size() < max_states_);
+    table_[slot] = keys_.size();
+    keys_.push_back(key);
+    owners_.push_back(instance);
+    return keys_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of different states added since the last
+///         clear().
+size_t AnimationStateCache::getStateCount() const
+{
+    return keys_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the first instance added with a state's key.
+size_t AnimationStateCache::getOwner(size_t state) const
+{
+    return owners_[state];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a state's key.
+const AnimationStateKey& AnimationStateCache::getKey(size_t state) const
+{
+    return keys_[state];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a time or weight to the nearest whole step, for a key.
+GLint AnimationStateCache::quantize(float value, float steps_per_unit)
+{
+    return GLint(std::floor(value * steps_per_unit + 0.5f));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the value a key's steps stand for, to pose an owner
+///         from.
+float AnimationStateCache::dequantize(GLint steps, float steps_per_unit)
+{
+    return float(steps) / steps_per_unit;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Mixes a key's fields into a table index.  Only the low bits
+///         need be used, for a table whose size is a power of two.
+size_t AnimationStateCache::hashKey(const AnimationStateKey& key)
+{
+    // FNV-1a, a word at a time.
+    GLuint hash = 2166136261u;
+    hash = (hash ^ key.clip) * 16777619u;
+    hash = (hash ^ GLuint(key.time)) * 16777619u;
+    for (size_t i = 0; i < AnimationStateKey::MAX_WEIGHTS; ++i)
+        hash = (hash ^ GLuint(key.weights[i])) * 16777619u;
+
+    // the low bits pick the slot, so fold the high ones down into them.
+    return size_t(hash ^ (hash >> 16));
+}
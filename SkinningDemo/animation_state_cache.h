@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  animation_state_cache.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the AnimationStateCache class.
+
+#ifndef ANIMATION_STATE_CACHE_H_
+#define ANIMATION_STATE_CACHE_H_
+
+#include "demo.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Everything an instance of a crowd is posed from, rounded to whole
+///         steps, so that instances whose poses would be the same have equal
+///         keys.
+struct AnimationStateKey
+{
+    static const size_t MAX_WEIGHTS = 2;
+
+    AnimationStateKey();
+
+    bool operator==(const AnimationStateKey& other) const;
+    bool operator!=(const AnimationStateKey& other) const;
+
+    GLuint clip;                ///< The clip playing, or 0 if none is.
+    GLint time;                 ///< The time in the clip, in steps; 0 if none is playing.
+    GLint weights[MAX_WEIGHTS]; ///< The weights the instance blends its inputs with, in steps.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the instances of a crowd which are in the same animation
+///         state this frame, so that each state is posed only once.
+///
+/// \details Each frame, every instance's key is added in turn.  The first
+///         instance with a key owns its state; the rest get the same state
+///         back, and can be drawn with the owner's pose and palette.  The
+///         states are numbered from 0 in the order they're first seen, so
+///         they can stand in for the share groups of an
+///         AnimationLodScheduler.
+///
+///         Rounding the time and the weights to steps is what lets states
+///         be shared at all, so the instances which own them have to be
+///         posed from the rounded values (see quantize() and dequantize()),
+///         or their followers would be drawn with slightly different poses
+///         than their own.
+///
+///         The states are kept in an open-addressed hash table sized for
+///         the crowd, so adding keys never allocates.
+class AnimationStateCache
+{
+public:
+    static const size_t NO_STATE = size_t(-1);
+
+    explicit AnimationStateCache(size_t max_states);
+
+    void clear();
+    size_t add(const AnimationStateKey& key, size_t instance);
+
+    size_t getStateCount() const;
+    size_t getOwner(size_t state) const;
+    const AnimationStateKey& getKey(size_t state) const;
+
+    static GLint quantize(float value, float steps_per_unit);
+    static float dequantize(GLint steps, float steps_per_unit);
+    static size_t hashKey(const AnimationStateKey& key);
+
+private:
+    AnimationStateCache(const AnimationStateCache&);            // non-copyable
+    AnimationStateCache& operator=(const AnimationStateCache&); // non-copyable
+
+    size_t max_states_;
+    std::vector<size_t> table_;     ///< Each slot's state, or NO_STATE; a power of two, at least twice max_states.
+    std::vector<AnimationStateKey> keys_;
+    std::vector<size_t> owners_;    ///< The first instance in each state.
+};
+
+#endif
@@ -0,0 +1,296 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  asset_loader.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of AssetLoader class functions.
+
+#include "asset_loader.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the loader's worker threads.
+///
+/// \param  worker_count The number of threads to run worker stages on; at
+///         least 1.  Loading mostly waits on files, so a couple is enough.
+/// \param  byte_budget The most bytes the loads in flight may say they hold.
+AssetLoader::AssetLoader(size_t worker_count, size_t byte_budget)
+    : byte_budget_(byte_budget),
+      bytes_in_flight_(0),
+      pending_(0),
+      stopping_(false)
+{
+    if (worker_count == 0)
+        worker_count = 1;
+
+    for (size_t i = 0; i < worker_count; ++i)
+        workers_.push_back(std::thread(&AssetLoader::workerMain, this));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops the worker threads once they've finished the stages they're
+///         running.  Stages which haven't started are dropped.
+AssetLoader::~AssetLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    worker_wake_.notify_all();
+
+    for (size_t i = 0; i < workers_.size(); ++i)
+        workers_[i].join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a load with no stages yet.
+///
+/// \param  name What the load's stages are called in the trace; a string
+///         literal, since the trace keeps it.
+/// \param  bytes Roughly how much memory the load holds while it's in
+///         flight: its file's size, say.
+/// \return The load, for addStage() and submit().
+AssetLoader::LoadId AssetLoader::begin(const char* name, size_t bytes)
+{
+    std::unique_ptr<Load> load(new Load());
+    load->name = name;
+    load->bytes = bytes;
+    load->next_stage = 0;
+    load->submitted = false;
+    load->finished = false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    loads_.push_back(std::unique_ptr<Load>());
+    loads_.back().swap(load);
+    return loads_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a stage to the end of a load which hasn't been submitted.
+///
+/// \param  thread Where the stage has to run.
+/// \param  function The stage's work; it may throw to fail the load.
+/// \param  context Passed to function.  It's the caller's, and must outlive
+///         the load.
+void AssetLoader::addStage(LoadId load, StageThread thread, StageFunction function, void* context)
+{
+    Stage stage;
+    stage.thread = thread;
+    stage.function = function;
+    stage.context = context;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(load < loads_.size() && !loads_[load]->submitted);
+    loads_[load]->stages.push_back(stage);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a load to start as soon as the budget allows.
+void AssetLoader::submit(LoadId load)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(load < loads_.size() && !loads_[load]->submitted);
+    loads_[load]->submitted = true;
+    ++pending_;
+    waiting_.push_back(load);
+    startWaitingLoads();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs the render stages which are ready, on the thread which owns
+///         the GL context.
+///
+/// \details Only the stages which were ready when it was called are run;
+///         a render stage which follows one of them waits for the next
+///         call.
+///
+/// \return The number of stages run.
+size_t AssetLoader::update()
+{
+    std::deque<LoadId> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready.swap(render_stages_);
+    }
+
+    for (size_t i = 0; i < ready.size(); ++i)
+        runStage(ready[i]);
+    return ready.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits until a load has finished, running its render stages
+///         meanwhile.  Only the render thread may call it.
+///
+/// \details Other loads' render stages are left for update(), since the
+///         caller may not be ready for them yet.  If one of the load's
+///         stages threw, it's rethrown here.
+void AssetLoader::wait(LoadId load)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            assert(load < loads_.size() && loads_[load]->submitted);
+            std::deque<LoadId>::iterator stage;
+            for (;;)
+            {
+                stage = std::find(render_stages_.begin(), render_stages_.end(), load);
+                if (loads_[load]->finished || stage != render_stages_.end())
+                    break;
+                render_wake_.wait(lock);
+            }
+
+            if (loads_[load]->finished)
+                break;
+            render_stages_.erase(stage);
+        }
+
+        runStage(load);
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error = loads_[load]->error;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true once all of a load's stages have run, or one of
+///         them has failed.
+bool AssetLoader::isFinished(LoadId load) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return loads_[load]->finished;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of loads which have been submitted but haven't
+///         finished, including those waiting for the budget.
+size_t AssetLoader::getPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the total bytes of the loads which have started but
+///         haven't finished.
+size_t AssetLoader::getBytesInFlight() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_in_flight_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The main loop of each worker thread; runs worker stages as they
+///         become ready.
+void AssetLoader::workerMain()
+{
+    TRACE_THREAD("asset loader");
+    for (;;)
+    {
+        LoadId load;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!stopping_ && worker_stages_.empty())
+                worker_wake_.wait(lock);
+
+            if (stopping_)
+                return;
+
+            load = worker_stages_.front();
+            worker_stages_.pop_front();
+        }
+
+        runStage(load);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs a load's next stage on the calling thread, then queues the
+///         stage after it, or finishes the load.
+void AssetLoader::runStage(LoadId load_id)
+{
+    Load* load;
+    Stage stage;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        load = loads_[load_id].get();
+        stage = load->stages[load->next_stage];
+    }
+
+    std::exception_ptr error;
+    try
+    {
+        TRACE_SCOPE(load->name);
+        stage.function(stage.context);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error)
+    {
+        load->error = error;
+        load->next_stage = load->stages.size();
+    }
+    else
+        ++load->next_stage;
+    schedule(load_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the waiting loads, in order, while the budget has room for
+///         them.  The mutex must be held.
+void AssetLoader::startWaitingLoads()
+{
+    while (!waiting_.empty())
+    {
+        LoadId load = waiting_.front();
+        size_t bytes = loads_[load]->bytes;
+        if (bytes_in_flight_ > 0 && bytes_in_flight_ + bytes > byte_budget_)
+            return;
+
+        waiting_.pop_front();
+        bytes_in_flight_ += bytes;
+        schedule(load);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a started load's next stage for its thread, or if it has
+///         none left, finishes the load and lets the next ones start.  The
+///         mutex must be held.
+void AssetLoader::schedule(LoadId load_id)
+{
+    Load& load = *loads_[load_id];
+    if (load.next_stage < load.stages.size())
+    {
+        if (load.stages[load.next_stage].thread == STAGE_WORKER)
+        {
+            worker_stages_.push_back(load_id);
+            worker_wake_.notify_one();
+        }
+        else
+        {
+            render_stages_.push_back(load_id);
+            render_wake_.notify_all();
+        }
+        return;
+    }
+
+    load.finished = true;
+    bytes_in_flight_ -= load.bytes;
+    --pending_;
+    render_wake_.notify_all();
+    startWaitingLoads();
+}
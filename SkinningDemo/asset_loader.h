@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  asset_loader.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the AssetLoader class.
+
+#ifndef ASSET_LOADER_H_
+#define ASSET_LOADER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs asset loads as sequences of stages, each on the thread it
+///         needs, with many loads in flight at once.
+///
+/// \details A load is a list of stages, added with addStage() before it's
+///         submitted.  Each stage is a callback which runs either on one of
+///         the loader's worker threads, for reading and processing files,
+///         or on the render thread, for anything which needs the GL
+///         context, and is only started once the stage before it has
+///         returned.  The stages of different loads run in any order, so a
+///         mesh can be uploading while a rig is still being read.  The
+///         render thread runs the stages waiting for it when it calls
+///         update(), or those of the load it's waiting for in wait().
+///
+///         A stage which throws ends its load: the rest of its stages are
+///         skipped, and wait() rethrows what it threw.
+///
+///         Each load says roughly how many bytes it will hold while it's in
+///         flight.  Loads are only started while the total is within the
+///         loader's budget, in the order they were submitted, so a burst of
+///         loads only holds that much memory at once; one load bigger than
+///         the whole budget is started once nothing else is in flight.
+class AssetLoader
+{
+public:
+    typedef size_t LoadId;
+    typedef void (*StageFunction)(void* context);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Identifies the threads a stage can run on.
+    enum StageThread
+    {
+        STAGE_WORKER = 0,   ///< One of the loader's worker threads.
+        STAGE_RENDER        ///< The thread which owns the GL context, in update() or wait().
+    };
+
+    explicit AssetLoader(size_t worker_count = 2, size_t byte_budget = 64 * 1024 * 1024);
+    ~AssetLoader();
+
+    LoadId begin(const char* name, size_t bytes);
+    void addStage(LoadId load, StageThread thread, StageFunction function, void* context);
+    void submit(LoadId load);
+
+    size_t update();
+    void wait(LoadId load);
+
+    bool isFinished(LoadId load) const;
+    size_t getPendingCount() const;
+    size_t getBytesInFlight() const;
+
+private:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One step of a load.
+    struct Stage
+    {
+        StageThread thread;
+        StageFunction function;
+        void* context;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A load, and how far it has got.
+    struct Load
+    {
+        const char* name;           ///< A string literal, which the trace can keep.
+        size_t bytes;               ///< Held against the budget from when it starts until it finishes.
+        std::vector<Stage> stages;
+        size_t next_stage;          ///< The stage to run next, or stages.size() once they're all done.
+        bool submitted;
+        bool finished;
+        std::exception_ptr error;   ///< What a stage threw, if one did.
+    };
+
+    AssetLoader(const AssetLoader&);            // non-copyable
+    AssetLoader& operator=(const AssetLoader&); // non-copyable
+
+    void workerMain();
+    void runStage(LoadId load);
+    void startWaitingLoads();
+    void schedule(LoadId load);
+
+    std::vector<std::unique_ptr<Load> > loads_;
+    std::deque<LoadId> waiting_;        ///< Submitted loads which the budget hasn't let start yet.
+    std::deque<LoadId> worker_stages_;  ///< Loads whose next stage is waiting for a worker.
+    std::deque<LoadId> render_stages_;  ///< Loads whose next stage is waiting for the render thread.
+    size_t byte_budget_;
+    size_t bytes_in_flight_;
+    size_t pending_;                    ///< Submitted loads which haven't finished.
+
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable worker_wake_;   ///< Signaled when a worker stage is queued, or on shutdown.
+    std::condition_variable render_wake_;   ///< Signaled when a render stage is queued, or a load finishes.
+    bool stopping_;
+};
+
+#endif
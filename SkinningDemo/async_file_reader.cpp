@@ -0,0 +1,622 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  async_file_reader.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of AsyncFileReader class functions.
+
+#include "async_file_reader.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a byte offset down to a multiple of ALIGNMENT.
+size_t roundDown(size_t offset)
+{
+    return offset / AsyncFileReader::ALIGNMENT * AsyncFileReader::ALIGNMENT;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a byte offset up to a multiple of ALIGNMENT.
+size_t roundUp(size_t offset)
+{
+    return roundDown(offset + AsyncFileReader::ALIGNMENT - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates a staging buffer aligned to ALIGNMENT, or returns
+///         nullptr if it can't.
+char* allocateAligned(size_t bytes)
+{
+#ifdef _WIN32
+    return static_cast<char*>(_aligned_malloc(bytes, AsyncFileReader::ALIGNMENT));
+#else
+    void* memory;
+    return posix_memalign(&memory, AsyncFileReader::ALIGNMENT, bytes) == 0 ? static_cast<char*>(memory) : nullptr;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees a buffer from allocateAligned().
+void freeAligned(char* memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One read, from when it's queued until it's released.
+struct AsyncFileReader::Request
+{
+    enum State
+    {
+        FREE = 0,
+        QUEUED,         ///< In queued_ or pending_.
+        IN_FLIGHT,      ///< Handed to the OS.
+        SUCCEEDED,
+        FAILED
+    };
+
+    State state;
+    size_t offset;          ///< What was asked for.
+    size_t length;
+    size_t aligned_offset;  ///< What's actually read: offset and length, widened to ALIGNMENT.
+    size_t aligned_length;
+    char* buffer;           ///< aligned_length bytes, aligned to ALIGNMENT.
+
+#ifdef _WIN32
+    OVERLAPPED overlapped;  ///< Its hEvent is signaled when the read finishes.
+#elif defined(__linux__)
+    struct iovec iov;       ///< What the ring reads into; the kernel may look at it until the read finishes.
+#endif
+};
+
+#ifdef __linux__
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An io_uring: a queue of reads shared with the kernel, and a queue
+///         of their completions.
+///
+/// \details There's no liburing to lean on, so it's set up with the raw
+///         system calls, as the kernel's documentation describes.  Both
+///         queues are rings in memory mapped from the kernel; this side
+///         only ever writes the submission queue's tail and the completion
+///         queue's head.
+struct AsyncFileReader::Ring
+{
+    explicit Ring(unsigned entries);
+    ~Ring();
+
+    void enter(unsigned wait_count);
+
+    int fd;                     ///< The ring, or -1 if it couldn't be set up.
+    void* sq_mapping;
+    size_t sq_mapping_size;
+    void* cq_mapping;           ///< The same as sq_mapping when the kernel maps both rings at once.
+    size_t cq_mapping_size;
+    io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    unsigned unsubmitted;       ///< Entries added to the submission queue since the last io_uring_enter.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets up a ring with room for at least entries reads in flight.
+///         If the kernel doesn't have io_uring, or won't allow it, fd is left
+///         at -1.
+AsyncFileReader::Ring::Ring(unsigned entries)
+    : fd(-1),
+      sq_mapping(MAP_FAILED),
+      sq_mapping_size(0),
+      cq_mapping(MAP_FAILED),
+      cq_mapping_size(0),
+      sqes(nullptr),
+      sqes_size(0),
+      unsubmitted(0)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ring_fd = int(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0)
+        return;
+
+    bool single_mapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    sq_mapping_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_mapping_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (single_mapping)
+        sq_mapping_size = cq_mapping_size = std::max(sq_mapping_size, cq_mapping_size);
+
+    sq_mapping = mmap(nullptr, sq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd, IORING_OFF_SQ_RING);
+    if (single_mapping)
+        cq_mapping = sq_mapping;
+    else
+        cq_mapping = mmap(nullptr, cq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd, IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqe_mapping = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ring_fd, IORING_OFF_SQES);
+    if (sq_mapping == MAP_FAILED || cq_mapping == MAP_FAILED || sqe_mapping == MAP_FAILED)
+    {
+        if (sqe_mapping != MAP_FAILED)
+            munmap(sqe_mapping, sqes_size);
+        close(ring_fd);
+        return;
+    }
+
+    char* sq = static_cast<char*>(sq_mapping);
+    char* cq = static_cast<char*>(cq_mapping);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sqes = static_cast<io_uring_sqe*>(sqe_mapping);
+    fd = ring_fd;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unmaps the rings and closes the ring.  Nothing may be in flight.
+AsyncFileReader::Ring::~Ring()
+{
+    if (sqes != nullptr)
+        munmap(sqes, sqes_size);
+    if (cq_mapping != MAP_FAILED && cq_mapping != sq_mapping)
+        munmap(cq_mapping, cq_mapping_size);
+    if (sq_mapping != MAP_FAILED)
+        munmap(sq_mapping, sq_mapping_size);
+    if (fd >= 0)
+        close(fd);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Hands the kernel the entries added since last time, and
+///         optionally waits for completions.
+///
+/// \param  wait_count How many completions to wait for; 0 returns straight
+///         away.
+void AsyncFileReader::Ring::enter(unsigned wait_count)
+{
+    if (unsubmitted == 0 && wait_count == 0)
+        return;
+
+    long submitted = syscall(__NR_io_uring_enter, fd, unsubmitted, wait_count,
+                             wait_count > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    // if the kernel is too busy to take them all, the rest go next time.
+    if (submitted > 0)
+        unsubmitted -= std::min(unsubmitted, unsigned(submitted));
+}
+#else
+struct AsyncFileReader::Ring
+{
+};
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Opens a file for unbuffered reads.  If it can't be opened,
+///         isOpen() is false, and every read fails.
+///
+/// \param  path The file to read.
+/// \param  queue_depth The most reads to have in flight at once; more are
+///         held until earlier ones finish.
+AsyncFileReader::AsyncFileReader(const std::string& path, size_t queue_depth)
+    : size_(0),
+      queue_depth_(std::max<size_t>(queue_depth, 1)),
+      in_flight_(0)
+{
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, NULL);
+    LARGE_INTEGER file_size;
+    if (file_ != INVALID_HANDLE_VALUE && GetFileSizeEx(file_, &file_size))
+        size_ = size_t(file_size.QuadPart);
+#else
+    // not every file system takes O_DIRECT (tmpfs doesn't), so without it
+    // the reads just go through the page cache.
+    file_ = -1;
+#ifdef O_DIRECT
+    file_ = open(path.c_str(), O_RDONLY | O_DIRECT);
+#endif
+    if (file_ < 0)
+        file_ = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (file_ >= 0 && fstat(file_, &info) == 0)
+        size_ = size_t(info.st_size);
+#ifdef __APPLE__
+    if (file_ >= 0)
+        fcntl(file_, F_NOCACHE, 1);
+#endif
+
+#ifdef __linux__
+    if (file_ >= 0)
+    {
+        ring_.reset(new Ring(unsigned(queue_depth_)));
+        if (ring_->fd < 0)
+            ring_.reset();
+    }
+#endif
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits for the reads in flight, which are writing into buffers
+///         this owns, then closes the file.  Reads which haven't started are
+///         dropped.
+AsyncFileReader::~AsyncFileReader()
+{
+    queued_.clear();
+    pending_.clear();
+    for (size_t i = 0; i < requests_.size(); ++i)
+    {
+        while (requests_[i]->state == Request::IN_FLIGHT)
+            waitForCompletion(i);
+    }
+
+    for (size_t i = 0; i < requests_.size(); ++i)
+    {
+        if (requests_[i]->buffer != nullptr)
+            freeAligned(requests_[i]->buffer);
+    }
+
+#ifdef _WIN32
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+#else
+    ring_.reset();
+    if (file_ >= 0)
+        close(file_);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the file could be opened.
+bool AsyncFileReader::isOpen() const
+{
+#ifdef _WIN32
+    return file_ != INVALID_HANDLE_VALUE;
+#else
+    return file_ >= 0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the file in bytes, or 0 if it isn't open.
+size_t AsyncFileReader::getSize() const
+{
+    return size_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if reads happen in the background, or false if
+///         submit() does them itself before it returns.
+bool AsyncFileReader::isAsynchronous() const
+{
+#ifdef _WIN32
+    return isOpen();
+#else
+    return bool(ring_);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a read of a range of the file, to be started by the next
+///         submit().
+///
+/// \param  offset The start of the range, in bytes from the start of the
+///         file.
+/// \param  length The length of the range in bytes; more than 0.
+/// \return The read, for isComplete(), getData() and release().  If the
+///         file isn't open, it has already failed.
+AsyncFileReader::ReadId AsyncFileReader::read(size_t offset, size_t length)
+{
+    assert(length > 0);
+
+    ReadId id;
+    if (!free_requests_.empty())
+    {
+        id = free_requests_.back();
+        free_requests_.pop_back();
+    }
+    else
+    {
+        id = requests_.size();
+        requests_.push_back(std::unique_ptr<Request>(new Request()));
+    }
+
+    Request& request = *requests_[id];
+    request.offset = offset;
+    request.length = length;
+    request.aligned_offset = roundDown(offset);
+    request.aligned_length = roundUp(offset + length) - request.aligned_offset;
+    request.buffer = allocateAligned(request.aligned_length);
+    if (!isOpen() || request.buffer == nullptr)
+    {
+        request.state = Request::FAILED;
+        return id;
+    }
+
+#ifdef __linux__
+    request.iov.iov_base = request.buffer;
+    request.iov.iov_len = request.aligned_length;
+#endif
+    request.state = Request::QUEUED;
+    queued_.push_back(id);
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the reads queued since the last call, as many at once as
+///         the queue depth allows.  The rest start as earlier reads finish,
+///         in the order they were queued, whenever poll() is called.
+void AsyncFileReader::submit()
+{
+    pending_.insert(pending_.end(), queued_.begin(), queued_.end());
+    queued_.clear();
+    startPending();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects the reads which have finished, without waiting, and
+///         starts pending ones in their place.
+void AsyncFileReader::poll()
+{
+#ifdef _WIN32
+    for (size_t i = 0; i < requests_.size(); ++i)
+    {
+        Request& request = *requests_[i];
+        if (request.state != Request::IN_FLIGHT)
+            continue;
+
+        DWORD bytes_read;
+        if (GetOverlappedResult(file_, &request.overlapped, &bytes_read, FALSE))
+            finish(i, bytes_read, true);
+        else if (GetLastError() != ERROR_IO_INCOMPLETE)
+            finish(i, 0, false);
+    }
+#elif defined(__linux__)
+    if (ring_)
+    {
+        unsigned head = *ring_->cq_head;
+        unsigned tail = __atomic_load_n(ring_->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe& completion = ring_->cqes[head & *ring_->cq_mask];
+            finish(ReadId(completion.user_data), completion.res > 0 ? size_t(completion.res) : 0,
+                   completion.res >= 0);
+        }
+        __atomic_store_n(ring_->cq_head, head, __ATOMIC_RELEASE);
+    }
+#endif
+
+    startPending();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true once a read has either succeeded or failed.  Never
+///         waits.
+bool AsyncFileReader::isComplete(ReadId read)
+{
+    assert(read < requests_.size() && requests_[read]->state != Request::FREE);
+    if (requests_[read]->state == Request::IN_FLIGHT || requests_[read]->state == Request::QUEUED)
+        poll();
+    return requests_[read]->state == Request::SUCCEEDED || requests_[read]->state == Request::FAILED;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits until a read has either succeeded or failed, submitting it
+///         first if it hasn't been.
+void AsyncFileReader::wait(ReadId read)
+{
+    assert(read < requests_.size() && requests_[read]->state != Request::FREE);
+    if (std::find(queued_.begin(), queued_.end(), read) != queued_.end())
+        submit();
+
+    while (!isComplete(read))
+        waitForCompletion(read);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the bytes a read asked for, or nullptr if it failed or
+///         hasn't completed.  They stay valid until the read is released.
+const char* AsyncFileReader::getData(ReadId read) const
+{
+    assert(read < requests_.size());
+    const Request& request = *requests_[read];
+    if (request.state != Request::SUCCEEDED)
+        return nullptr;
+    return request.buffer + (request.offset - request.aligned_offset);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees a read's staging buffer.  A read which hasn't started is
+///         dropped; one in flight is waited for first, since the OS is
+///         still writing into its buffer.
+void AsyncFileReader::release(ReadId read)
+{
+    assert(read < requests_.size() && requests_[read]->state != Request::FREE);
+    Request& request = *requests_[read];
+    if (request.state == Request::QUEUED)
+    {
+        queued_.erase(std::remove(queued_.begin(), queued_.end(), read), queued_.end());
+        pending_.erase(std::remove(pending_.begin(), pending_.end(), read), pending_.end());
+    }
+    while (request.state == Request::IN_FLIGHT)
+        waitForCompletion(read);
+
+    if (request.buffer != nullptr)
+        freeAligned(request.buffer);
+    request.buffer = nullptr;
+    request.state = Request::FREE;
+    free_requests_.push_back(read);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of reads the OS is working on.
+size_t AsyncFileReader::getInFlightCount() const
+{
+    return in_flight_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts pending reads while the queue has room, in one batch.
+void AsyncFileReader::startPending()
+{
+    while (!pending_.empty() && in_flight_ < queue_depth_)
+    {
+        ReadId read = pending_.front();
+        pending_.pop_front();
+        start(read);
+    }
+
+#ifdef __linux__
+    if (ring_)
+        ring_->enter(0);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Hands a read to the OS, or without an asynchronous backend, does
+///         it.
+void AsyncFileReader::start(ReadId read)
+{
+    Request& request = *requests_[read];
+
+#ifdef _WIN32
+    std::memset(&request.overlapped, 0, sizeof(request.overlapped));
+    request.overlapped.Offset = DWORD(request.aligned_offset);
+    request.overlapped.OffsetHigh = DWORD((unsigned long long)request.aligned_offset >> 32);
+    request.overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (request.overlapped.hEvent == NULL)
+    {
+        finish(read, 0, false);
+        return;
+    }
+
+    request.state = Request::IN_FLIGHT;
+    ++in_flight_;
+    if (!ReadFile(file_, request.buffer, DWORD(request.aligned_length), NULL, &request.overlapped) &&
+        GetLastError() != ERROR_IO_PENDING)
+    {
+        finish(read, 0, false);
+    }
+#else
+#ifdef __linux__
+    if (ring_)
+    {
+        unsigned tail = *ring_->sq_tail;
+        unsigned index = tail & *ring_->sq_mask;
+        io_uring_sqe& entry = ring_->sqes[index];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.opcode = IORING_OP_READV;
+        entry.fd = file_;
+        entry.off = request.aligned_offset;
+        entry.addr = (unsigned long long)(size_t)&request.iov;
+        entry.len = 1;
+        entry.user_data = read;
+        ring_->sq_array[index] = index;
+        __atomic_store_n(ring_->sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++ring_->unsubmitted;
+
+        request.state = Request::IN_FLIGHT;
+        ++in_flight_;
+        return;
+    }
+#endif
+
+    // with O_DIRECT, a read is only short at the end of the file.
+    size_t bytes_read = 0;
+    while (bytes_read < request.aligned_length)
+    {
+        ssize_t result = pread(file_, request.buffer + bytes_read, request.aligned_length - bytes_read,
+                               off_t(request.aligned_offset + bytes_read));
+        if (result <= 0)
+            break;
+        bytes_read += size_t(result);
+    }
+    finish(read, bytes_read, true);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records that a read has finished.
+///
+/// \param  bytes_read How much of the widened range was read; the read only
+///         succeeds if that covers the range asked for.
+/// \param  succeeded false if the OS reported an error.
+void AsyncFileReader::finish(ReadId read, size_t bytes_read, bool succeeded)
+{
+    Request& request = *requests_[read];
+    if (request.state == Request::IN_FLIGHT)
+    {
+        --in_flight_;
+#ifdef _WIN32
+        if (request.overlapped.hEvent != NULL)
+            CloseHandle(request.overlapped.hEvent);
+#endif
+    }
+
+    bool covered = bytes_read >= request.offset + request.length - request.aligned_offset;
+    request.state = succeeded && covered ? Request::SUCCEEDED : Request::FAILED;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Blocks until some read in flight finishes: the one given if it's
+///         in flight, or else any which is.
+void AsyncFileReader::waitForCompletion(ReadId read)
+{
+    if (in_flight_ == 0)
+        return;
+
+#ifdef _WIN32
+    ReadId waited = read;
+    for (size_t i = 0; requests_[waited]->state != Request::IN_FLIGHT && i < requests_.size(); ++i)
+        waited = i;
+
+    Request& request = *requests_[waited];
+    DWORD bytes_read;
+    if (GetOverlappedResult(file_, &request.overlapped, &bytes_read, TRUE))
+        finish(waited, bytes_read, true);
+    else
+        finish(waited, 0, false);
+#elif defined(__linux__)
+    ring_->enter(1);
+    poll();
+#endif
+}
@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  async_file_reader.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the AsyncFileReader class.
+
+#ifndef ASYNC_FILE_READER_H_
+#define ASYNC_FILE_READER_H_
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads ranges of a file into staging buffers of its own, with many
+///         reads in flight at once and nothing waiting on them.
+///
+/// \details read() only queues a read; submit() hands everything queued to
+///         the OS in one batch, and returns straight away.  The reads are
+///         done by the OS while the caller carries on: through io_uring on
+///         Linux and overlapped I/O on Windows, with the file opened to
+///         bypass the OS's cache (O_DIRECT, FILE_FLAG_NO_BUFFERING), so
+///         each read goes straight from the drive into its staging buffer.
+///         Keeping a queue of reads in flight is what keeps an NVMe drive
+///         busy; one blocking read at a time leaves it idle between them.
+///
+///         Unbuffered reads have to start and end on a multiple of the
+///         drive's sector size, so each read is widened to ALIGNMENT on both
+///         sides, into a buffer aligned to it; getData() points at the bytes
+///         which were asked for within it.
+///
+///         Where neither is available (an older kernel, a sandbox which
+///         forbids io_uring, or another OS), submit() reads each range with
+///         pread() itself, so everything still works, but synchronously;
+///         isAsynchronous() says which it is.
+///
+///         Reads are polled for, rather than signaled: poll() collects the
+///         ones which have finished, and isComplete() and wait() call it.
+///         The reader isn't thread-safe: it's meant to be used by one
+///         thread, like the ClipDatabase that streams with it.
+class AsyncFileReader
+{
+public:
+    typedef size_t ReadId;
+
+    /// What reads are widened to, and staging buffers aligned to: at least
+    /// the sector size of any drive the demo runs on.
+    static const size_t ALIGNMENT = 4096;
+
+    explicit AsyncFileReader(const std::string& path, size_t queue_depth = 32);
+    ~AsyncFileReader();
+
+    bool isOpen() const;
+    size_t getSize() const;
+    bool isAsynchronous() const;
+
+    ReadId read(size_t offset, size_t length);
+    void submit();
+    void poll();
+
+    bool isComplete(ReadId read);
+    void wait(ReadId read);
+    const char* getData(ReadId read) const;
+    void release(ReadId read);
+
+    size_t getInFlightCount() const;
+
+private:
+    struct Request;
+    struct Ring;
+
+    AsyncFileReader(const AsyncFileReader&);            // non-copyable
+    AsyncFileReader& operator=(const AsyncFileReader&); // non-copyable
+
+    void startPending();
+    void start(ReadId read);
+    void finish(ReadId read, size_t bytes_read, bool succeeded);
+    void waitForCompletion(ReadId read);
+
+    std::vector<std::unique_ptr<Request> > requests_;
+    std::vector<ReadId> free_requests_;     ///< Released requests, for read() to reuse.
+    std::vector<ReadId> queued_;            ///< Read, but not yet submitted.
+    std::deque<ReadId> pending_;            ///< Submitted, and waiting for a free place in the queue.
+    size_t size_;
+    size_t queue_depth_;
+    size_t in_flight_;
+
+#ifdef _WIN32
+    void* file_;                ///< The file's HANDLE; kept as a void* so that this doesn't include windows.h.
+#else
+    int file_;
+    std::unique_ptr<Ring> ring_;    ///< The io_uring, or null if reads are synchronous.
+#endif
+};
+
+#endif
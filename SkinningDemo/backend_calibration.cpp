@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  backend_calibration.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of BackendCalibration and BackendCalibrator
+///         class functions.
+
+#include "backend_calibration.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+/// The first line of every calibration file.
+const char* const CALIBRATION_MAGIC = "SkinningDemo backend calibration 1";
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a GL string, or an empty string if it isn't available.
+std::string getGLString(GLenum name)
+{
+    const GLubyte* str = glGetString(name);
+    return str != nullptr ? std::string(reinterpret_cast<const char*>(str)) : std::string();
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Loads the calibration saved in a file, if it was measured with
+///         the current GL context's driver.  A missing or mismatched file
+///         leaves every bucket uncalibrated.
+///
+/// \param  path The file to load from, and save() to.
+BackendCalibration::BackendCalibration(const std::string& path)
+    : path_(path)
+{
+    driver_ = getGLString(GL_VENDOR) + " / " + getGLString(GL_RENDERER) + " / " + getGLString(GL_VERSION);
+
+    std::ifstream file(path.c_str());
+    std::string magic;
+    std::string driver;
+    if (!std::getline(file, magic) || magic != CALIBRATION_MAGIC ||
+        !std::getline(file, driver) || driver != driver_)
+        return;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream in(line);
+        size_t bucket;
+        Entry entry;
+        if (in >> bucket >> entry.backend >> entry.milliseconds)
+            entries_[bucket] = entry;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Looks up the backend calibrated for a mesh's size.
+///
+/// \param  vertex_count The number of vertices in the mesh.
+/// \param  backend Receives the backend's name, if there is one.
+/// \return false if the mesh's bucket hasn't been calibrated.
+bool BackendCalibration::find(size_t vertex_count, std::string& backend) const
+{
+    std::map<size_t, Entry>::const_iterator it = entries_.find(getBucket(vertex_count));
+    if (it == entries_.end())
+        return false;
+
+    backend = it->second.backend;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records the backend chosen for a mesh's size, replacing whatever
+///         its bucket had before.  Nothing is written until save().
+///
+/// \param  backend The backend's name, which mustn't contain whitespace.
+void BackendCalibration::set(size_t vertex_count, const std::string& backend, double milliseconds)
+{
+    Entry& entry = entries_[getBucket(vertex_count)];
+    entry.backend = backend;
+    entry.milliseconds = milliseconds;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes every bucket to the file.  Failures are ignored; the
+///         meshes will just be calibrated again next time.
+void BackendCalibration::save() const
+{
+    std::ofstream file(path_.c_str(), std::ios::out | std::ios::trunc);
+    if (!file)
+        return;
+
+    file << CALIBRATION_MAGIC << std::endl
+         << driver_ << std::endl;
+    for (std::map<size_t, Entry>::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+        file << it->first << " " << it->second.backend << " " << it->second.milliseconds << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the bucket of a mesh with vertex_count vertices: the
+///         exponent of the largest power of two no greater than it, or 0
+///         for an empty mesh.
+size_t BackendCalibration::getBucket(size_t vertex_count)
+{
+    size_t bucket = 0;
+    while (vertex_count > 1)
+    {
+        vertex_count >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts timing the first candidate.
+///
+/// \param  candidate_count The number of candidates to time; at least 1.
+/// \param  warmup_frames The frames of each candidate thrown away first.
+/// \param  measured_frames The frames of each candidate averaged.
+BackendCalibrator::BackendCalibrator(size_t candidate_count, size_t warmup_frames, size_t measured_frames)
+    : warmup_frames_(warmup_frames),
+      measured_frames_(std::max(measured_frames, size_t(1))),
+      candidate_(0),
+      frame_count_(0),
+      totals_(std::max(candidate_count, size_t(1)), 0.0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a frame of the current candidate, moving on to the next
+///         once it has been measured for long enough.
+///
+/// \param  milliseconds The time the frame cost.
+void BackendCalibrator::addFrame(double milliseconds)
+{
+    if (isFinished())
+        return;
+
+    if (frame_count_ >= warmup_frames_)
+        totals_[candidate_] += milliseconds;
+
+    if (++frame_count_ == warmup_frames_ + measured_frames_)
+    {
+        ++candidate_;
+        frame_count_ = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the candidate to draw the next frame with.
+size_t BackendCalibrator::getCandidate() const
+{
+    return candidate_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true once every candidate has been timed.
+bool BackendCalibrator::isFinished() const
+{
+    return candidate_ == totals_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a finished candidate's mean time per frame.
+double BackendCalibrator::getMilliseconds(size_t candidate) const
+{
+    return totals_[candidate] / measured_frames_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the candidate with the lowest mean time per frame, once
+///         finished.
+size_t BackendCalibrator::getFastest() const
+{
+    return size_t(std::min_element(totals_.begin(), totals_.end()) - totals_.begin());
+}
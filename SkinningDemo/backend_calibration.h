@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  backend_calibration.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the BackendCalibration and BackendCalibrator
+///         classes.
+
+#ifndef BACKEND_CALIBRATION_H_
+#define BACKEND_CALIBRATION_H_
+
+#include "demo.h"
+#include <map>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The fastest skinning backend measured for each size of mesh on
+///         this GPU, kept in a text file between runs.
+///
+/// \details Meshes are grouped into buckets by the power of two just below
+///         their vertex count, since the balance between the backends
+///         moves with the amount of vertex work, not the exact count.
+///
+///         The file starts with the GL vendor, renderer and version strings
+///         it was measured with; if they don't match the current context,
+///         it's ignored, so a new GPU or driver is calibrated again.  Each
+///         line after that is a bucket, the name of its backend, and the
+///         milliseconds per frame it was measured at.
+class BackendCalibration
+{
+public:
+    explicit BackendCalibration(const std::string& path);
+
+    bool find(size_t vertex_count, std::string& backend) const;
+    void set(size_t vertex_count, const std::string& backend, double milliseconds);
+    void save() const;
+
+    static size_t getBucket(size_t vertex_count);
+
+private:
+    BackendCalibration(const BackendCalibration&);              // non-copyable
+    BackendCalibration& operator=(const BackendCalibration&);   // non-copyable
+
+    struct Entry
+    {
+        std::string backend;
+        double milliseconds;
+    };
+
+    std::string path_;
+    std::string driver_;                ///< The GL strings, joined into one line.
+    std::map<size_t, Entry> entries_;   ///< By bucket.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Times a number of candidates one after another, for a fixed
+///         number of frames each, and picks the fastest.
+///
+/// \details The first few frames of each candidate are thrown away: its
+///         programs and buffers are still warming up, and GPU timings lag a
+///         couple of frames behind, so they'd still be timing the candidate
+///         before.  The application switches candidates whenever
+///         getCandidate() changes.
+class BackendCalibrator
+{
+public:
+    explicit BackendCalibrator(size_t candidate_count, size_t warmup_frames = 10, size_t measured_frames = 30);
+
+    void addFrame(double milliseconds);
+
+    size_t getCandidate() const;
+    bool isFinished() const;
+    double getMilliseconds(size_t candidate) const;
+    size_t getFastest() const;
+
+private:
+    size_t warmup_frames_;
+    size_t measured_frames_;
+    size_t candidate_;              ///< The one being timed, or the count once finished.
+    size_t frame_count_;            ///< Frames of it so far, counting the warmup.
+    std::vector<double> totals_;    ///< The total milliseconds measured for each candidate.
+};
+
+#endif
@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  baked_animation.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementation of the BakedAnimation class.
+
+#include "baked_animation.h"
+#include "palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Samples a clip at evenly spaced times and builds the skinning
+///         palette of each sample.
+///
+/// \param  clip The clip to bake.
+/// \param  skeleton The skeleton the clip animates.
+/// \param  rest_pose The pose of any joints the clip has no keys for.
+/// \param  bind_pose_inv The inverse bind pose of each joint.
+/// \param  frame_count The number of frames to spread over the clip; frame
+///         i is sampled at i * duration / frame_count.
+/// \param  palettes Filled in with frame_count palettes of one matrix per
+///         joint, one after the other.
+void bakeClipPalettes(const AnimationClip& clip, const Skeleton& skeleton, const Pose& rest_pose,
+                      const mat4* bind_pose_inv, size_t frame_count, std::vector<mat4>& palettes)
+{
+    size_t joint_count = skeleton.getJointCount();
+    PosePool pool(joint_count, 1);
+    Pose pose = pool.allocate();
+    copyPose(rest_pose, pose);
+
+    std::vector<mat4> transforms(joint_count);
+    palettes.resize(frame_count * joint_count);
+
+    // the frames are sampled in order, so the sampler only ever steps forward.
+    ClipSampler sampler(clip);
+    for (size_t frame = 0; frame < frame_count; ++frame)
+    {
+        sampler.sample(clip.getDuration() * frame / frame_count, pose);
+        skeleton.computeJointTransforms(pose, transforms.data());
+        computeSkinningPalette(transforms.data(), bind_pose_inv, joint_count, &palettes[frame * joint_count]);
+    }
+
+    pool.release(pose);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Bakes a clip and uploads it into a new texture.
+///
+/// \param  clip The clip to bake; played back, it loops.
+/// \param  skeleton The skeleton the clip animates.
+/// \param  rest_pose The pose of any joints the clip has no keys for.
+/// \param  bind_pose_inv The inverse bind pose of each joint.
+/// \param  frame_rate The fewest frames to bake per second of the clip.
+/// \param  half_float Store the texture as RGBA16F instead of RGBA32F.
+BakedAnimation::BakedAnimation(const AnimationClip& clip, const Skeleton& skeleton, const Pose& rest_pose,
+                               const mat4* bind_pose_inv, float frame_rate, bool half_float)
+    : texture_id_(0),
+      frame_count_(std::max(size_t(std::ceil(clip.getDuration() * frame_rate)), size_t(1))),
+      joint_count_(skeleton.getJointCount()),
+      duration_(clip.getDuration()),
+      texel_size_(half_float ? 4 * sizeof(GLushort) : 4 * sizeof(GLfloat))
+{
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    if (joint_count_ * 3 > size_t(max_size) || frame_count_ > size_t(max_size))
+    {
+        std::cerr << "A baked animation of " << joint_count_ << " joints and " << frame_count_
+                  << " frames needs a " << joint_count_ * 3 << "x" << frame_count_ << " texture, but the limit is "
+                  << max_size << "." << std::endl;
+        throw std::runtime_error("The animation is too big to bake into a texture.");
+    }
+
+    std::vector<mat4> palettes;
+    bakeClipPalettes(clip, skeleton, rest_pose, bind_pose_inv, frame_count_, palettes);
+
+    std::vector<vec4> texels;
+    texels.reserve(palettes.size() * 3);
+    for (size_t i = 0; i < palettes.size(); ++i)
+    {
+        texels.push_back(palettes[i][0]);
+        texels.push_back(palettes[i][1]);
+        texels.push_back(palettes[i][3]);
+    }
+
+    glGenTextures(1, &texture_id_);
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glTexImage2D(GL_TEXTURE_2D, 0, half_float ? GL_RGBA16F : GL_RGBA32F, GLsizei(joint_count_ * 3), GLsizei(frame_count_),
+                 0, GL_RGBA, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Deletes the texture.
+BakedAnimation::~BakedAnimation()
+{
+    glDeleteTextures(1, &texture_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the texture holding the baked palettes.
+GLuint BakedAnimation::getTextureId() const
+{
+    return texture_id_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of frames baked, which is the height of the
+///         texture.
+size_t BakedAnimation::getFrameCount() const
+{
+    return frame_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in each frame's palette.
+size_t BakedAnimation::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of frames per second of the clip actually
+///         baked, which may be a little more than was asked for.
+float BakedAnimation::getFrameRate() const
+{
+    return duration_ > 0 ? frame_count_ / duration_ : 0.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the duration of the clip, in seconds.
+float BakedAnimation::getDuration() const
+{
+    return duration_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the texture's storage, in bytes.
+size_t BakedAnimation::getTextureBytes() const
+{
+    return joint_count_ * 3 * frame_count_ * texel_size_;
+}
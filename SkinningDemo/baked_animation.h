@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  baked_animation.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the BakedAnimation class.
+
+#ifndef BAKED_ANIMATION_H_
+#define BAKED_ANIMATION_H_
+
+#include "animation_clip.h"
+#include "skeleton.h"
+#include <vector>
+
+void bakeClipPalettes(const AnimationClip& clip, const Skeleton& skeleton, const Pose& rest_pose,
+                      const mat4* bind_pose_inv, size_t frame_count, std::vector<mat4>& palettes);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A looping AnimationClip, baked into a texture of skinning
+///         palettes, so that a crowd can play it back without any
+///         animation work on the CPU.
+///
+/// \details Each row of the texture is one frame: the precombined palette
+///         current_pose * bind_pose_inv of the clip sampled at that time.
+///         Every joint's matrix takes 3 RGBA texels, holding its x, y and
+///         translation columns; the mesh is flat, so the z column never
+///         affects a skinned vertex and isn't stored.  The texture is
+///         linearly filtered, and repeats vertically, so a shader which
+///         samples the centers of a joint's texels gets that joint's matrix
+///         interpolated between the two frames around any time, including
+///         between the last frame and the first.
+///
+///         The frames are spread evenly over the clip at (at least)
+///         frame_rate per second, so the clip's duration is always a whole
+///         number of frames.  Stored as half floats, the texture is half
+///         the size, which is plenty for model-space palettes.
+class BakedAnimation
+{
+public:
+    BakedAnimation(const AnimationClip& clip, const Skeleton& skeleton, const Pose& rest_pose,
+                   const mat4* bind_pose_inv, float frame_rate, bool half_float);
+    ~BakedAnimation();
+
+    GLuint getTextureId() const;
+    size_t getFrameCount() const;
+    size_t getJointCount() const;
+    float getFrameRate() const;
+    float getDuration() const;
+    size_t getTextureBytes() const;
+
+private:
+    BakedAnimation(const BakedAnimation&);              // non-copyable
+    BakedAnimation& operator=(const BakedAnimation&);   // non-copyable
+
+    GLuint texture_id_;
+    size_t frame_count_;
+    size_t joint_count_;
+    float duration_;
+    size_t texel_size_;     ///< 8 bytes for RGBA16F, 16 for RGBA32F.
+};
+
+#endif
@@ -0,0 +1,658 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  blend_graph.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of BlendGraph and BlendGraphContext class
+///         functions.
+
+#include "blend_graph.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets dst to src * weight, or adds src * weight to it.
+void weightStream(const float* src, float weight, float* dst, size_t n, bool accumulate)
+{
+    if (accumulate)
+    {
+        for (size_t i = 0; i < n; ++i)
+            dst[i] += src[i] * weight;
+    }
+    else
+    {
+        for (size_t i = 0; i < n; ++i)
+            dst[i] = src[i] * weight;
+    }
+}
+
+} // namespace
+
+const size_t BlendGraph::NO_MASK;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty graph.
+///
+/// \param  joint_count The number of joints in every pose the graph blends.
+BlendGraph::BlendGraph(size_t joint_count)
+    : joint_count_(joint_count),
+      input_count_(0),
+      parameter_count_(0),
+      scratch_pose_count_(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a node which reads one of the context's input poses.
+///
+/// \param  input The index of the input, as passed to
+///         BlendGraphContext::setInput().
+BlendGraph::NodeId BlendGraph::addInput(size_t input)
+{
+    Node node;
+    node.operation = OPERATION_INPUT;
+    node.input = input;
+    node.mask = NO_MASK;
+    input_count_ = std::max(input_count_, input + 1);
+    return addNode(node);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a node which linearly interpolates between two nodes.
+///
+/// \param  a The node to use when the parameter is 0.
+/// \param  b The node to use when the parameter is 1.
+/// \param  parameter The index of the interpolation factor parameter.
+/// \param  mask A mask from addMask() which scales the interpolation factor
+///         of each joint, or NO_MASK to blend every joint fully.
+BlendGraph::NodeId BlendGraph::addLerp(NodeId a, NodeId b, size_t parameter, size_t mask)
+{
+    checkNode(a);
+    checkNode(b);
+    checkMask(mask);
+
+    Node node;
+    node.operation = OPERATION_LERP;
+    node.children.push_back(a);
+    node.children.push_back(b);
+    node.parameters.push_back(parameter);
+    node.mask = mask;
+    return addNode(node);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a node which blends any number of nodes by their weights.
+///
+/// \details The weights are normalized when the graph is evaluated, so they
+///         needn't sum to 1.  If they're all 0, the first node is used.
+///
+/// \param  nodes The nodes to blend.
+/// \param  weight_parameters The index of each node's weight parameter.
+BlendGraph::NodeId BlendGraph::addBlend(const std::vector<NodeId>& nodes, const std::vector<size_t>& weight_parameters)
+{
+    if (nodes.empty() || nodes.size() != weight_parameters.size())
+    {
+        std::cerr << "A blend of " << nodes.size() << " nodes was given " << weight_parameters.size() << " weights." << std::endl;
+        throw std::runtime_error("A blend needs one weight per node, and at least one node.");
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+        checkNode(nodes[i]);
+
+    Node node;
+    node.operation = OPERATION_BLEND;
+    node.children = nodes;
+    node.parameters = weight_parameters;
+    node.mask = NO_MASK;
+    return addNode(node);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a node which adds the difference between two nodes to a
+///         third.
+///
+/// \details Translation, rotation and scale are layered; colors come from
+///         the base node.
+///
+/// \param  base The pose to add the layer to.
+/// \param  additive The pose the layer was authored as.
+/// \param  reference The pose the layer is relative to; the layer adds
+///         additive - reference.
+/// \param  parameter The index of the parameter which scales the layer.
+/// \param  mask A mask from addMask() which scales the layer for each joint,
+///         or NO_MASK to apply it to every joint fully.
+BlendGraph::NodeId BlendGraph::addAdditive(NodeId base, NodeId additive, NodeId reference, size_t parameter, size_t mask)
+{
+    checkNode(base);
+    checkNode(additive);
+    checkNode(reference);
+    checkMask(mask);
+
+    Node node;
+    node.operation = OPERATION_ADDITIVE;
+    node.children.push_back(base);
+    node.children.push_back(additive);
+    node.children.push_back(reference);
+    node.parameters.push_back(parameter);
+    node.mask = mask;
+    return addNode(node);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a node which adds a precomputed additive delta to another.
+///
+/// \details Like addAdditive(), but the layer's reference has already been
+///         taken out of it, so evaluating the node reads two poses rather
+///         than three, and does no subtraction.  Colors come from the base
+///         node.
+///
+/// \param  base The pose to add the layer to.
+/// \param  delta The layer, from makeAdditivePose() or a sample of an
+///         additive AnimationClip.
+/// \param  parameter The index of the parameter which scales the layer.
+/// \param  mask A mask from addMask() which scales the layer for each joint,
+///         or NO_MASK to apply it to every joint fully.
+BlendGraph::NodeId BlendGraph::addAdditiveDelta(NodeId base, NodeId delta, size_t parameter, size_t mask)
+{
+    checkNode(base);
+    checkNode(delta);
+    checkMask(mask);
+
+    Node node;
+    node.operation = OPERATION_ADDITIVE_DELTA;
+    node.children.push_back(base);
+    node.children.push_back(delta);
+    node.parameters.push_back(parameter);
+    node.mask = mask;
+    return addNode(node);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a per-joint mask for lerp and additive nodes.
+///
+/// \param  joint_weights How much of the blend each joint gets, usually
+///         from 0 to 1.
+/// \return The mask's index.
+size_t BlendGraph::addMask(const std::vector<float>& joint_weights)
+{
+    if (joint_weights.size() != joint_count_)
+    {
+        std::cerr << "A mask for " << joint_count_ << " joints was given " << joint_weights.size() << " weights." << std::endl;
+        throw std::runtime_error("A mask needs exactly one weight per joint.");
+    }
+
+    masks_.push_back(joint_weights);
+    mask_joints_.push_back(JointMask::fromWeights(joint_weights));
+    return masks_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a mask which gives the joints in a set all of a blend, and
+///         the rest none of it.
+///
+/// \param  joints The joints to blend, such as an arm's chain from
+///         JointMask::addSubtree().
+/// \return The mask's index.
+size_t BlendGraph::addMask(const JointMask& joints)
+{
+    std::vector<float> joint_weights(joints.getJointCount(), 0.0f);
+    for (size_t joint = joints.getNext(0); joint < joint_weights.size(); joint = joints.getNext(joint + 1))
+        joint_weights[joint] = 1.0f;
+    return addMask(joint_weights);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Flattens the nodes which the root depends on into instructions,
+///         and assigns their results to scratch poses.
+///
+/// \details Nodes which the root doesn't depend on are ignored.  A graph
+///         may be recompiled with a different root, but not while any
+///         contexts created for it still exist.
+///
+/// \param  root The node whose result is the output of the graph.
+void BlendGraph::compile(NodeId root)
+{
+    checkNode(root);
+
+    // count how many instructions will read each node's result.  Children
+    // always come before their parents, so walking backwards from the root
+    // visits every parent before its children.
+    std::vector<char> reachable(nodes_.size(), 0);
+    std::vector<size_t> uses(nodes_.size(), 0);
+    reachable[root] = 1;
+    for (size_t node = root + 1; node-- > 0;)
+    {
+        if (!reachable[node])
+            continue;
+
+        for (size_t i = 0; i < nodes_[node].children.size(); ++i)
+        {
+            reachable[nodes_[node].children[i]] = 1;
+            ++uses[nodes_[node].children[i]];
+        }
+    }
+
+    instructions_.clear();
+    operands_.clear();
+    parameters_.clear();
+    scratch_pose_count_ = 0;
+
+    std::vector<Operand> results(nodes_.size());
+    std::vector<char> compiled(nodes_.size(), 0);
+    std::vector<size_t> free_scratch;
+    compileNode(root, true, uses, results, compiled, free_scratch);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in each pose.
+size_t BlendGraph::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns one more than the highest input index used.
+size_t BlendGraph::getInputCount() const
+{
+    return input_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns one more than the highest parameter index used.
+size_t BlendGraph::getParameterCount() const
+{
+    return parameter_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of scratch poses each context needs.
+size_t BlendGraph::getScratchPoseCount() const
+{
+    return scratch_pose_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of instructions the last compile() produced.
+size_t BlendGraph::getInstructionCount() const
+{
+    return instructions_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a node, and notes the parameters it uses.
+BlendGraph::NodeId BlendGraph::addNode(const Node& node)
+{
+    for (size_t i = 0; i < node.parameters.size(); ++i)
+        parameter_count_ = std::max(parameter_count_, node.parameters[i] + 1);
+
+    nodes_.push_back(node);
+    return nodes_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Throws if a node doesn't exist.
+void BlendGraph::checkNode(NodeId node) const
+{
+    if (node >= nodes_.size())
+    {
+        std::cerr << "Blend graph node " << node << " doesn't exist." << std::endl;
+        throw std::runtime_error("Blend graph nodes can only refer to nodes which have already been added.");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Throws if a mask isn't NO_MASK and doesn't exist.
+void BlendGraph::checkMask(size_t mask) const
+{
+    if (mask != NO_MASK && mask >= masks_.size())
+    {
+        std::cerr << "Blend graph mask " << mask << " doesn't exist." << std::endl;
+        throw std::runtime_error("Blend graph masks must be added before they're used.");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Emits the instructions for a node after those of its children
+///         (unless it has already been compiled), and returns where its
+///         result will be.
+///
+/// \details A node's result is assigned a scratch pose before its children's
+///         scratch poses are released, so an instruction never writes over
+///         its own operands.
+BlendGraph::Operand BlendGraph::compileNode(NodeId node, bool is_root, std::vector<size_t>& uses,
+                                            std::vector<Operand>& results, std::vector<char>& compiled,
+                                            std::vector<size_t>& free_scratch)
+{
+    if (compiled[node])
+        return results[node];
+
+    const Node& n = nodes_[node];
+    Operand result;
+
+    // inputs are read where they are, unless the root is an input.
+    if (n.operation == OPERATION_INPUT && !is_root)
+    {
+        result.source = Operand::SOURCE_INPUT;
+        result.index = n.input;
+        results[node] = result;
+        compiled[node] = 1;
+        return result;
+    }
+
+    std::vector<Operand> operands;
+    if (n.operation == OPERATION_INPUT)
+    {
+        Operand input;
+        input.source = Operand::SOURCE_INPUT;
+        input.index = n.input;
+        operands.push_back(input);
+    }
+    for (size_t i = 0; i < n.children.size(); ++i)
+        operands.push_back(compileNode(n.children[i], false, uses, results, compiled, free_scratch));
+
+    if (is_root)
+    {
+        result.source = Operand::SOURCE_OUTPUT;
+        result.index = 0;
+    }
+    else
+    {
+        result.source = Operand::SOURCE_SCRATCH;
+        if (free_scratch.empty())
+            result.index = scratch_pose_count_++;
+        else
+        {
+            result.index = free_scratch.back();
+            free_scratch.pop_back();
+        }
+    }
+
+    Instruction instruction;
+    instruction.operation = n.operation;
+    instruction.result = result;
+    instruction.first_operand = operands_.size();
+    instruction.operand_count = operands.size();
+    instruction.first_parameter = parameters_.size();
+    instruction.mask = n.mask;
+    operands_.insert(operands_.end(), operands.begin(), operands.end());
+    parameters_.insert(parameters_.end(), n.parameters.begin(), n.parameters.end());
+    instructions_.push_back(instruction);
+
+    // release the children's scratch poses once nothing else will read them.
+    for (size_t i = 0; i < n.children.size(); ++i)
+    {
+        NodeId child = n.children[i];
+        if (--uses[child] == 0 && results[child].source == Operand::SOURCE_SCRATCH)
+            free_scratch.push_back(results[child].index);
+    }
+
+    results[node] = result;
+    compiled[node] = 1;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates a context's scratch poses.  Every parameter starts at
+///         0, and every input must be set before evaluating.
+///
+/// \param  graph A compiled graph.  It must outlive the context, and must
+///         not be recompiled while the context exists.
+/// \param  scratch_pool The pool to allocate scratch poses from; its joint
+///         count must match the graph's.
+BlendGraphContext::BlendGraphContext(const BlendGraph& graph, PosePool& scratch_pool)
+    : graph_(graph),
+      scratch_pool_(&scratch_pool),
+      inputs_(graph.getInputCount()),
+      parameters_(graph.getParameterCount(), 0.0f)
+{
+    assert(scratch_pool.getJointCount() == graph.getJointCount());
+
+    for (size_t i = 0; i < graph.getScratchPoseCount(); ++i)
+        scratch_.push_back(scratch_pool.allocate());
+
+    size_t max_operands = 0;
+    for (size_t i = 0; i < graph.instructions_.size(); ++i)
+        max_operands = std::max(max_operands, graph.instructions_[i].operand_count);
+    weights_.resize(max_operands);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a context without scratch poses of its own, which is
+///         only evaluated with scratch poses the caller passes in.  Every
+///         parameter starts at 0, and every input must be set before
+///         evaluating.
+///
+/// \details Scratch poses only hold anything while the graph is being
+///         evaluated, so a crowd whose contexts are evaluated a handful at
+///         a time, on a handful of threads, only needs a set of them per
+///         thread, rather than a set per character.
+///
+/// \param  graph A compiled graph.  It must outlive the context, and must
+///         not be recompiled while the context exists.
+BlendGraphContext::BlendGraphContext(const BlendGraph& graph)
+    : graph_(graph),
+      scratch_pool_(nullptr),
+      inputs_(graph.getInputCount()),
+      parameters_(graph.getParameterCount(), 0.0f)
+{
+    size_t max_operands = 0;
+    for (size_t i = 0; i < graph.instructions_.size(); ++i)
+        max_operands = std::max(max_operands, graph.instructions_[i].operand_count);
+    weights_.resize(max_operands);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the scratch poses, if the context has any, to their
+///         pool.
+BlendGraphContext::~BlendGraphContext()
+{
+    for (size_t i = 0; i < scratch_.size(); ++i)
+        scratch_pool_->release(scratch_[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets one of the poses the graph reads.  Only the pose's pointers
+///         are kept, so its data must stay valid until evaluate() is
+///         finished.
+void BlendGraphContext::setInput(size_t input, const Pose& pose)
+{
+    assert(input < inputs_.size() && pose.joint_count == graph_.getJointCount());
+    inputs_[input] = pose;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets one of the graph's blend parameters.
+void BlendGraphContext::setParameter(size_t parameter, float value)
+{
+    assert(parameter < parameters_.size());
+    parameters_[parameter] = value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs the graph's instructions, and writes the result to a pose.
+///
+/// \details Colors are carried through an instruction only if its result
+///         and every pose it reads have them, so a graph whose scratch pool
+///         has no colors never touches them.
+///
+/// \param  out The pose to write to.  It must not be one of the inputs.
+void BlendGraphContext::evaluate(Pose& out)
+{
+    assert(scratch_.size() == graph_.getScratchPoseCount());
+    evaluate(out, scratch_.empty() ? nullptr : &scratch_[0]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs the graph's instructions with the caller's scratch poses
+///         rather than the context's own, and writes the result to a pose.
+///
+/// \param  out The pose to write to.  It must not be one of the inputs.
+/// \param  scratch The graph's getScratchPoseCount() scratch poses, which
+///         no other evaluation may be using at the same time.  Their
+///         contents are overwritten.
+void BlendGraphContext::evaluate(Pose& out, const Pose* scratch)
+{
+    assert(out.joint_count == graph_.getJointCount());
+    assert(scratch != nullptr || graph_.getScratchPoseCount() == 0);
+    size_t n = out.joint_count;
+
+    for (size_t i = 0; i < graph_.instructions_.size(); ++i)
+    {
+        const BlendGraph::Instruction& instruction = graph_.instructions_[i];
+        const BlendGraph::Operand* operands = &graph_.operands_[instruction.first_operand];
+        const size_t* parameters = instruction.first_parameter < graph_.parameters_.size()
+                                 ? &graph_.parameters_[instruction.first_parameter] : nullptr;
+        const float* mask = instruction.mask == BlendGraph::NO_MASK ? nullptr : &graph_.masks_[instruction.mask][0];
+        const JointMask* mask_joints = mask == nullptr ? nullptr : &graph_.mask_joints_[instruction.mask];
+        Pose result = getPose(scratch, instruction.result, out);
+
+        switch (instruction.operation)
+        {
+            case BlendGraph::OPERATION_INPUT:
+                copyPose(getPose(scratch, operands[0], out), result);
+                break;
+
+            case BlendGraph::OPERATION_LERP:
+            {
+                Pose a = getPose(scratch, operands[0], out);
+                Pose b = getPose(scratch, operands[1], out);
+                float weight = parameters_[parameters[0]];
+                if (mask == nullptr)
+                {
+                    blendPoses(a, b, weight, result);
+                    break;
+                }
+
+                // the joints the mask leaves out are just a's.
+                copyPose(a, result);
+                bool colors = result.color != nullptr && a.color != nullptr && b.color != nullptr;
+                for (size_t joint = mask_joints->getNext(0); joint < n; joint = mask_joints->getNext(joint + 1))
+                {
+                    float t = weight * mask[joint];
+                    result.translation[joint] = glm::mix(a.translation[joint], b.translation[joint], t);
+                    result.rotation[joint] = lerpAngle(a.rotation[joint], b.rotation[joint], t);
+                    result.scale[joint] = glm::mix(a.scale[joint], b.scale[joint], t);
+                    if (colors)
+                        result.color[joint] = glm::mix(a.color[joint], b.color[joint], t);
+                }
+                break;
+            }
+
+            case BlendGraph::OPERATION_BLEND:
+            {
+                float total = 0;
+                for (size_t j = 0; j < instruction.operand_count; ++j)
+                {
+                    weights_[j] = std::max(parameters_[parameters[j]], 0.0f);
+                    total += weights_[j];
+                }
+
+                if (total <= 0)
+                {
+                    weights_.assign(weights_.size(), 0.0f);
+                    weights_[0] = total = 1.0f;
+                }
+
+                bool colors = result.color != nullptr;
+                for (size_t j = 0; j < instruction.operand_count; ++j)
+                    colors = colors && getPose(scratch, operands[j], out).color != nullptr;
+
+                // each channel is a flat stream of floats, so the blend is
+                // just a weighted sum of streams.
+                for (size_t j = 0; j < instruction.operand_count; ++j)
+                {
+                    Pose pose = getPose(scratch, operands[j], out);
+                    float weight = weights_[j] / total;
+                    weightStream(&pose.translation[0].x, weight, &result.translation[0].x, n * 2, j > 0);
+                    weightStream(pose.rotation, weight, result.rotation, n, j > 0);
+                    weightStream(pose.scale, weight, result.scale, n, j > 0);
+                    if (colors)
+                        weightStream(&pose.color[0].r, weight, &result.color[0].r, n * 4, j > 0);
+                }
+                break;
+            }
+
+            case BlendGraph::OPERATION_ADDITIVE:
+            {
+                Pose base = getPose(scratch, operands[0], out);
+                Pose additive = getPose(scratch, operands[1], out);
+                Pose reference = getPose(scratch, operands[2], out);
+                float weight = parameters_[parameters[0]];
+
+                // the colors, and any joints the mask leaves out, are the base's.
+                if (mask != nullptr)
+                    copyPose(base, result);
+                else if (result.color != nullptr && base.color != nullptr)
+                    std::copy(base.color, base.color + n, result.color);
+                for (size_t joint = getFirstMaskedJoint(mask_joints); joint < n; joint = getNextMaskedJoint(mask_joints, joint))
+                {
+                    float t = mask == nullptr ? weight : weight * mask[joint];
+                    result.translation[joint] = base.translation[joint] + t * (additive.translation[joint] - reference.translation[joint]);
+                    result.rotation[joint] = base.rotation[joint] + t * (additive.rotation[joint] - reference.rotation[joint]);
+                    result.scale[joint] = base.scale[joint] + t * (additive.scale[joint] - reference.scale[joint]);
+                }
+                break;
+            }
+
+            case BlendGraph::OPERATION_ADDITIVE_DELTA:
+            {
+                Pose base = getPose(scratch, operands[0], out);
+                Pose delta = getPose(scratch, operands[1], out);
+                float weight = parameters_[parameters[0]];
+                if (mask == nullptr)
+                {
+                    addPoseDelta(base, delta, weight, result);
+                    break;
+                }
+
+                // the colors, and the joints the mask leaves out, are the base's.
+                copyPose(base, result);
+                for (size_t joint = mask_joints->getNext(0); joint < n; joint = mask_joints->getNext(joint + 1))
+                {
+                    float t = weight * mask[joint];
+                    result.translation[joint] = base.translation[joint] + t * delta.translation[joint];
+                    result.rotation[joint] = base.rotation[joint] + t * delta.rotation[joint];
+                    result.scale[joint] = base.scale[joint] + t * delta.scale[joint];
+                }
+                break;
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the pose an operand refers to.
+Pose BlendGraphContext::getPose(const Pose* scratch, const BlendGraph::Operand& operand, const Pose& out) const
+{
+    switch (operand.source)
+    {
+        case BlendGraph::Operand::SOURCE_INPUT:
+            assert(inputs_[operand.index].translation != nullptr);
+            return inputs_[operand.index];
+
+        case BlendGraph::Operand::SOURCE_SCRATCH:
+            return scratch[operand.index];
+
+        default:
+            return out;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Evaluates many characters' graphs on a thread pool.
+///
+/// \param  thread_pool The threads to evaluate the graphs with.
+/// \param  contexts Each character's context, with its inputs and
+///         parameters already set.
+/// \param  outputs The pose each character's result is written to.
+/// \param  count The number of characters.
+void evaluateBlendGraphs(ThreadPool& thread_pool, BlendGraphContext* const* contexts, Pose* outputs, size_t count)
+{
+    thread_pool.parallelFor(count, [=](size_t i) { contexts[i]->evaluate(outputs[i]); });
+}
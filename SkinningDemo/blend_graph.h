@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  blend_graph.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the BlendGraph and BlendGraphContext classes.
+
+#ifndef BLEND_GRAPH_H_
+#define BLEND_GRAPH_H_
+
+#include "demo.h"
+#include "joint_mask.h"
+#include "pose.h"
+#include <vector>
+
+class ThreadPool;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Describes how a character's final pose is blended together from
+///         its input poses.
+///
+/// \details A graph is built from nodes, each of which is one of:
+///
+///         - An input: one of the poses supplied with each evaluation, such
+///           as a sampled clip.
+///         - A lerp between two nodes, by a parameter, optionally scaled per
+///           joint by a mask (for instance, to blend only the upper body).
+///         - A normalized weighted blend of any number of nodes, with one
+///           weight parameter per node.
+///         - An additive layer: the difference between two nodes (the
+///           additive pose and its reference) added to a base node, scaled
+///           by a parameter and optionally by a mask.
+///         - An additive delta: the same, but with the difference taken
+///           ahead of time (see makeAdditivePose() and
+///           AnimationClip::makeAdditive()), so the node just adds it to
+///           the base with one multiply-add per channel.
+///
+///         A mask's weights are kept with a JointMask of the joints they
+///         give any weight to, and masked nodes only work out those joints:
+///         the rest are copied from the node's base (or first) operand in
+///         one go, rather than blended with a weight of 0.
+///
+///         Nodes can only refer to nodes added before them, so every graph
+///         is acyclic, and nodes may be shared.  Once all nodes have been
+///         added, compile() flattens the nodes the root depends on into a
+///         list of instructions in evaluation order, and assigns each
+///         intermediate result a scratch pose.  Scratch poses are reused as
+///         soon as the results in them have been used for the last time, so
+///         evaluating a graph needs no more of them than its widest point.
+///
+///         The graph itself holds no per-character state; every character
+///         evaluates it with its own BlendGraphContext.
+class BlendGraph
+{
+public:
+    typedef size_t NodeId;
+
+    static const size_t NO_MASK = size_t(-1);
+
+    explicit BlendGraph(size_t joint_count);
+
+    NodeId addInput(size_t input);
+    NodeId addLerp(NodeId a, NodeId b, size_t parameter, size_t mask = NO_MASK);
+    NodeId addBlend(const std::vector<NodeId>& nodes, const std::vector<size_t>& weight_parameters);
+    NodeId addAdditive(NodeId base, NodeId additive, NodeId reference, size_t parameter, size_t mask = NO_MASK);
+    NodeId addAdditiveDelta(NodeId base, NodeId delta, size_t parameter, size_t mask = NO_MASK);
+    size_t addMask(const std::vector<float>& joint_weights);
+    size_t addMask(const JointMask& joints);
+
+    void compile(NodeId root);
+
+    size_t getJointCount() const;
+    size_t getInputCount() const;
+    size_t getParameterCount() const;
+    size_t getScratchPoseCount() const;
+    size_t getInstructionCount() const;
+
+private:
+    friend class BlendGraphContext;
+
+    enum Operation
+    {
+        OPERATION_INPUT = 0,
+        OPERATION_LERP,
+        OPERATION_BLEND,
+        OPERATION_ADDITIVE,
+        OPERATION_ADDITIVE_DELTA
+    };
+
+    struct Node
+    {
+        Operation operation;
+        std::vector<NodeId> children;
+        std::vector<size_t> parameters;     ///< One per child for blends; otherwise just one.
+        size_t input;                       ///< For inputs, which of the context's inputs.
+        size_t mask;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Where an instruction reads or writes a pose.  Inputs are read
+    ///         in place, and are never written.
+    struct Operand
+    {
+        enum Source { SOURCE_INPUT, SOURCE_SCRATCH, SOURCE_OUTPUT };
+
+        Source source;
+        size_t index;
+    };
+
+    struct Instruction
+    {
+        Operation operation;    ///< OPERATION_INPUT means copy the operand to the result.
+        Operand result;
+        size_t first_operand;   ///< The instruction's operands are operands_[first_operand, first_operand + operand_count).
+        size_t operand_count;
+        size_t first_parameter; ///< Likewise for parameters_.
+        size_t mask;
+    };
+
+    NodeId addNode(const Node& node);
+    void checkNode(NodeId node) const;
+    void checkMask(size_t mask) const;
+    Operand compileNode(NodeId node, bool is_root, std::vector<size_t>& uses,
+                        std::vector<Operand>& results, std::vector<char>& compiled,
+                        std::vector<size_t>& free_scratch);
+
+    size_t joint_count_;
+    size_t input_count_;
+    size_t parameter_count_;
+    std::vector<Node> nodes_;
+    std::vector<std::vector<float> > masks_;
+    std::vector<JointMask> mask_joints_;    ///< The joints each mask gives any weight to.
+
+    std::vector<Instruction> instructions_;
+    std::vector<Operand> operands_;
+    std::vector<size_t> parameters_;
+    size_t scratch_pose_count_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One character's inputs, parameters and scratch poses for
+///         evaluating a compiled BlendGraph.
+///
+/// \details All of the context's memory is allocated when it's created, so
+///         evaluation never allocates.  Different contexts share nothing
+///         but the (read-only) graph, so they can be evaluated in parallel.
+///         A context created without a scratch pool has no scratch poses
+///         of its own, and is evaluated with the caller's, so that many
+///         characters can share a few sets of them.
+class BlendGraphContext
+{
+public:
+    BlendGraphContext(const BlendGraph& graph, PosePool& scratch_pool);
+    explicit BlendGraphContext(const BlendGraph& graph);
+    ~BlendGraphContext();
+
+    void setInput(size_t input, const Pose& pose);
+    void setParameter(size_t parameter, float value);
+
+    void evaluate(Pose& out);
+    void evaluate(Pose& out, const Pose* scratch);
+
+private:
+    BlendGraphContext(const BlendGraphContext&);            // non-copyable
+    BlendGraphContext& operator=(const BlendGraphContext&); // non-copyable
+
+    Pose getPose(const Pose* scratch, const BlendGraph::Operand& operand, const Pose& out) const;
+
+    const BlendGraph& graph_;
+    PosePool* scratch_pool_;        ///< Where scratch_ came from, or null if it's empty.
+    std::vector<Pose> inputs_;
+    std::vector<float> parameters_;
+    std::vector<Pose> scratch_;
+    std::vector<float> weights_;    ///< Scratch space for normalizing blend weights.
+};
+
+void evaluateBlendGraphs(ThreadPool& thread_pool, BlendGraphContext* const* contexts, Pose* outputs, size_t count);
+
+#endif
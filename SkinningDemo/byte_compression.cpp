@@ -0,0 +1,232 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  byte_compression.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the byte compression functions.
+
+#include "byte_compression.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+const size_t MIN_MATCH = 4;             ///< The shortest match worth a token and an offset.
+const size_t MAX_OFFSET = 65535;        ///< The furthest back a 16-bit offset reaches.
+const size_t HASH_BITS = 12;
+const size_t NO_POSITION = size_t(-1);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Groups the bytes of an array by their place in each element.
+///         Any bytes past the last whole element are copied as they are.
+void shuffleBytes(const unsigned char* data, size_t size, size_t element_size, unsigned char* shuffled)
+{
+    size_t count = size / element_size;
+    for (size_t b = 0; b < element_size; ++b)
+    {
+        for (size_t i = 0; i < count; ++i)
+            shuffled[b * count + i] = data[i * element_size + b];
+    }
+    std::memcpy(shuffled + count * element_size, data + count * element_size, size - count * element_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Undoes shuffleBytes().
+void unshuffleBytes(const unsigned char* shuffled, size_t size, size_t element_size, unsigned char* data)
+{
+    size_t count = size / element_size;
+    for (size_t b = 0; b < element_size; ++b)
+    {
+        for (size_t i = 0; i < count; ++i)
+            data[i * element_size + b] = shuffled[b * count + i];
+    }
+    std::memcpy(data + count * element_size, shuffled + count * element_size, size - count * element_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads 4 bytes as a word, for hashing and comparing sequences.
+unsigned readWord(const unsigned char* bytes)
+{
+    unsigned word;
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the part of a length which didn't fit in its token's
+///         nibble: 255 for every whole 255, then the remainder.
+void writeLengthExtension(size_t length, std::vector<char>& compressed)
+{
+    for (; length >= 255; length -= 255)
+        compressed.push_back(char(255));
+    compressed.push_back(char(length));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a run of literals, followed by a match unless
+///         match_length is 0.
+void writeSequence(const unsigned char* literals, size_t literal_length, size_t offset, size_t match_length,
+                   std::vector<char>& compressed)
+{
+    size_t literal_nibble = literal_length < 15 ? literal_length : 15;
+    size_t match_code = match_length > 0 ? match_length - MIN_MATCH : 0;
+    size_t match_nibble = match_code < 15 ? match_code : 15;
+    compressed.push_back(char((literal_nibble << 4) | match_nibble));
+
+    if (literal_nibble == 15)
+        writeLengthExtension(literal_length - 15, compressed);
+    compressed.insert(compressed.end(), literals, literals + literal_length);
+
+    if (match_length == 0)
+        return;
+
+    compressed.push_back(char(offset & 0xff));
+    compressed.push_back(char(offset >> 8));
+    if (match_nibble == 15)
+        writeLengthExtension(match_code - 15, compressed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports compressed data which doesn't decode to stderr, and
+///         throws.
+void reportCorruption(const char* problem)
+{
+    std::cerr << "Can't decompress corrupted data!" << std::endl
+              << "  Error: " << problem << std::endl;
+    throw std::runtime_error("Can't decompress corrupted data!");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads the extension of a length whose nibble was 15, and adds it
+///         to the length.
+size_t readLengthExtension(const std::vector<char>& compressed, size_t& position, size_t length)
+{
+    unsigned char byte;
+    do
+    {
+        if (position >= compressed.size())
+            reportCorruption("A length runs past the end of the data.");
+        byte = static_cast<unsigned char>(compressed[position++]);
+        length += byte;
+    } while (byte == 255);
+
+    return length;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compresses an array of elements.
+///
+/// \param  data The array.
+/// \param  size The size of the array, in bytes.
+/// \param  element_size The size of each element, in bytes; 1 compresses
+///         the bytes as they are.
+/// \param  compressed Receives the compressed data; anything in it already
+///         is discarded.
+void compressBytes(const void* data, size_t size, size_t element_size, std::vector<char>& compressed)
+{
+    compressed.clear();
+    if (size == 0)
+        return;
+
+    std::vector<unsigned char> input(size);
+    shuffleBytes(static_cast<const unsigned char*>(data), size, element_size > 0 ? element_size : 1, input.data());
+
+    // the most recent position of each hashed 4-byte sequence.
+    std::vector<size_t> table(size_t(1) << HASH_BITS, NO_POSITION);
+    compressed.reserve(size / 2);
+
+    size_t anchor = 0;      // the first byte not written yet
+    size_t position = 0;
+    while (position + MIN_MATCH <= size)
+    {
+        unsigned word = readWord(&input[position]);
+        size_t hash = (word * 2654435761u) >> (32 - HASH_BITS);
+        size_t candidate = table[hash];
+        table[hash] = position;
+
+        if (candidate == NO_POSITION || position - candidate > MAX_OFFSET || readWord(&input[candidate]) != word)
+        {
+            ++position;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (position + length < size && input[candidate + length] == input[position + length])
+            ++length;
+
+        writeSequence(&input[anchor], position - anchor, position - candidate, length, compressed);
+        position += length;
+        anchor = position;
+    }
+
+    // the last sequence is only literals, and may be empty.
+    writeSequence(&input[0] + anchor, size - anchor, 0, 0, compressed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decompresses an array compressed by compressBytes().
+///
+/// \details If the data doesn't decode to exactly size bytes, the problem
+///         is reported to stderr and an exception is thrown.
+///
+/// \param  compressed The compressed data.
+/// \param  element_size The element size it was compressed with.
+/// \param  data Receives the array.
+/// \param  size The size of the array, in bytes.
+void decompressBytes(const std::vector<char>& compressed, size_t element_size, void* data, size_t size)
+{
+    if (size == 0)
+        return;
+
+    std::vector<unsigned char> output(size);
+    size_t position = 0;
+    size_t written = 0;
+    while (position < compressed.size())
+    {
+        unsigned char token = static_cast<unsigned char>(compressed[position++]);
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15)
+            literal_length = readLengthExtension(compressed, position, literal_length);
+        if (literal_length > compressed.size() - position || literal_length > size - written)
+            reportCorruption("A run of literals runs past the end of the data.");
+
+        std::memcpy(&output[written], &compressed[position], literal_length);
+        position += literal_length;
+        written += literal_length;
+
+        // the last sequence has no match.
+        if (position == compressed.size())
+            break;
+
+        if (compressed.size() - position < 2)
+            reportCorruption("A match's offset runs past the end of the data.");
+        size_t offset = static_cast<unsigned char>(compressed[position]) |
+                        (size_t(static_cast<unsigned char>(compressed[position + 1])) << 8);
+        position += 2;
+
+        size_t match_length = token & 15;
+        if (match_length == 15)
+            match_length = readLengthExtension(compressed, position, match_length);
+        match_length += MIN_MATCH;
+
+        if (offset == 0 || offset > written)
+            reportCorruption("A match refers to data before the start.");
+        if (match_length > size - written)
+            reportCorruption("A match runs past the end of the data.");
+
+        // matches may overlap what they write, so they're copied forwards
+        // one byte at a time.
+        for (size_t i = 0; i < match_length; ++i, ++written)
+            output[written] = output[written - offset];
+    }
+
+    if (written != size)
+        reportCorruption("The data decodes to the wrong size.");
+
+    unshuffleBytes(output.data(), size, element_size > 0 ? element_size : 1, static_cast<unsigned char*>(data));
+}
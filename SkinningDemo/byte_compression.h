@@ -0,0 +1,34 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  byte_compression.h
+/// \author Ben Crist
+///
+/// \brief  Lossless compression of arrays of fixed-size elements, for
+///         keeping cold copies of data in memory.
+///
+/// \details The compressor is a small LZ77 coder in the style of LZ4's
+///         block format: a token byte holding the lengths of a run of
+///         literals and of the match after it, the literals, then the
+///         match's 16-bit offset back into what's already been written,
+///         with lengths of 15 or more continued in extra bytes.  It finds
+///         matches greedily through a hash of every 4-byte sequence, so
+///         it's quick to compress and quicker to decompress, and trades
+///         ratio for speed the same way LZ4 does.
+///
+///         Arrays of structs compress poorly byte by byte, since
+///         neighbouring bytes belong to different fields, so the bytes are
+///         shuffled by their place in the element first: all of the
+///         elements' first bytes, then all of their second bytes, and so
+///         on.  The high bytes of floats and the unused bytes of indices
+///         then line up into long runs the coder can match.
+
+#ifndef BYTE_COMPRESSION_H_
+#define BYTE_COMPRESSION_H_
+
+#include <cstddef>
+#include <vector>
+
+void compressBytes(const void* data, size_t size, size_t element_size, std::vector<char>& compressed);
+void decompressBytes(const std::vector<char>& compressed, size_t element_size, void* data, size_t size);
+
+#endif
@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  camera.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of Camera class functions.
+
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a camera looking down -z at the -1 to 1 square.
+Camera::Camera()
+{
+    setOrthographic(-1, 1, -1, 1, -1, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gives the camera an orthographic projection, as glm::ortho().
+///
+/// \param  left The view space x at the left edge of the viewport.
+/// \param  right The view space x at the right edge.
+/// \param  bottom The view space y at the bottom edge.
+/// \param  top The view space y at the top edge.
+/// \param  z_near The distance in front of the camera of the near plane;
+///         may be negative, to see things behind it.
+/// \param  z_far The distance in front of the camera of the far plane.
+void Camera::setOrthographic(float left, float right, float bottom, float top, float z_near, float z_far)
+{
+    projection_ = glm::ortho(left, right, bottom, top, z_near, z_far);
+    view_projection_ = projection_ * view_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gives the camera a perspective projection, as glm::perspective().
+///
+/// \param  fovy The vertical field of view, in degrees.
+/// \param  aspect The viewport's width divided by its height.
+/// \param  z_near The distance in front of the camera of the near plane;
+///         must be positive.
+/// \param  z_far The distance in front of the camera of the far plane.
+void Camera::setPerspective(float fovy, float aspect, float z_near, float z_far)
+{
+    projection_ = glm::perspective(fovy, aspect, z_near, z_far);
+    view_projection_ = projection_ * view_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Places the camera, as glm::lookAt().
+///
+/// \param  eye Where the camera is, in world space.
+/// \param  center A point the camera looks straight at.
+/// \param  up Which way is up; must not be parallel to the view direction.
+void Camera::lookAt(const vec3& eye, const vec3& center, const vec3& up)
+{
+    view_ = glm::lookAt(eye, center, up);
+    view_projection_ = projection_ * view_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform from world space to view space.
+const mat4& Camera::getView() const
+{
+    return view_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform from view space to clip space.
+const mat4& Camera::getProjection() const
+{
+    return projection_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform from world space to clip space.
+const mat4& Camera::getViewProjection() const
+{
+    return view_projection_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the camera as a Camera uniform block, ready to copy into
+///         a uniform buffer as is.
+CameraBlock Camera::getBlock() const
+{
+    CameraBlock block;
+    block.view_projection = view_projection_;
+    return block;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns whether any of a box in the xy plane might be inside the
+///         camera's view volume.
+///
+/// \details The box's corners are taken to clip space, and the box is only
+///         culled if all four are outside the same one of the volume's six
+///         planes.  Comparing against w rather than dividing by it works
+///         for perspective projections too, even with corners behind the
+///         camera.  A box crossing a corner of the volume without touching
+///         it is kept, which is the usual price of testing plane by plane.
+///
+/// \param  box The box, in the space transform maps from.
+/// \param  transform Takes the box to world space.
+bool Camera::isVisible(const BoundingBox& box, const mat4& transform) const
+{
+    if (box.isEmpty())
+        return false;
+
+    mat4 to_clip = view_projection_ * transform;
+    vec4 corners[4] =
+    {
+        to_clip * vec4(box.min.x, box.min.y, 0, 1),
+        to_clip * vec4(box.max.x, box.min.y, 0, 1),
+        to_clip * vec4(box.min.x, box.max.y, 0, 1),
+        to_clip * vec4(box.max.x, box.max.y, 0, 1)
+    };
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        bool all_below = true;
+        bool all_above = true;
+        for (int i = 0; i < 4; ++i)
+        {
+            all_below = all_below && corners[i][axis] < -corners[i].w;
+            all_above = all_above && corners[i][axis] > corners[i].w;
+        }
+        if (all_below || all_above)
+            return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns about how many pixels across a sphere is drawn.
+///
+/// \details Uses the narrower axis of the viewport, as the projection
+///         squeezes it; with a perspective projection, the sphere is taken
+///         to be small next to its distance.  Spheres behind the camera are
+///         0 pixels across.
+///
+/// \param  center The sphere's center, in world space.
+/// \param  radius The sphere's radius, in world space.
+/// \param  viewport The size of the viewport in pixels.
+float Camera::getPixelDiameter(const vec3& center, float radius, const glm::ivec2& viewport) const
+{
+    float w = (view_projection_ * vec4(center, 1)).w;
+    if (w <= 0)
+        return 0;
+
+    float pixels_per_unit = std::min(std::abs(projection_[0][0]) * float(viewport.x),
+                                     std::abs(projection_[1][1]) * float(viewport.y));
+    return radius * pixels_per_unit / w;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the ray through a point of the viewport, from the near
+///         plane towards the far plane.
+///
+/// \param  point The point, in normalized device coordinates (-1 to 1
+///         across the viewport, with +y up).
+/// \param  origin Receives where the ray crosses the near plane, in world
+///         space.
+/// \param  direction Receives the ray's unit direction, in world space.
+void Camera::getRay(const vec2& point, vec3& origin, vec3& direction) const
+{
+    mat4 inverse = glm::inverse(view_projection_);
+    vec4 near_point = inverse * vec4(point, -1, 1);
+    vec4 far_point = inverse * vec4(point, 1, 1);
+
+    origin = vec3(near_point) / near_point.w;
+    direction = glm::normalize(vec3(far_point) / far_point.w - origin);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns where the ray through a point of the viewport crosses
+///         the z = 0 plane, which the demo's scene lies in.
+///
+/// \details A camera looking along the plane never sees it cross, so gets
+///         the ray's origin instead.
+///
+/// \param  point The point, in normalized device coordinates.
+vec2 Camera::unprojectToPlane(const vec2& point) const
+{
+    vec3 origin;
+    vec3 direction;
+    getRay(point, origin, direction);
+    if (direction.z == 0)
+        return vec2(origin);
+
+    return vec2(origin - direction * (origin.z / direction.z));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two cameras have the same view and projection.
+bool Camera::operator==(const Camera& other) const
+{
+    return view_ == other.view_ && projection_ == other.projection_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two cameras' views or projections differ.
+bool Camera::operator!=(const Camera& other) const
+{
+    return !(*this == other);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Binds a program's Camera uniform block, if it has one, to
+///         CAMERA_BINDING.
+void bindCameraBlock(GLuint program_id)
+{
+    GLuint block_index = glGetUniformBlockIndex(program_id, "Camera");
+    if (block_index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program_id, block_index, CAMERA_BINDING);
+}
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  camera.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the Camera class, and the Camera uniform block
+///         every program drawing the scene shares.
+
+#ifndef CAMERA_H_
+#define CAMERA_H_
+
+#include "joint_bounds.h"
+
+const GLuint CAMERA_BINDING = 1;    ///< The uniform buffer binding point of every program's Camera block.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The contents of the Camera uniform block, in the std140 layout.
+struct CameraBlock
+{
+    mat4 view_projection;   ///< Takes world space to clip space.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A view and a projection, which take the scene from world space
+///         to clip space.
+///
+/// \details The view is a glm::lookAt() transform, and the projection is
+///         glm::ortho() or glm::perspective(), so the camera looks down its
+///         own -z axis.  A new camera looks down -z at the -1 to 1 square of
+///         the xy plane, with an orthographic projection from z = 1 to -1,
+///         which draws the scene just as the identity would (but for the
+///         sign of z in clip space).
+///
+///         Cameras are plain values, so they can be handed between threads
+///         by copying them.
+class Camera
+{
+public:
+    Camera();
+
+    void setOrthographic(float left, float right, float bottom, float top, float z_near, float z_far);
+    void setPerspective(float fovy, float aspect, float z_near, float z_far);
+    void lookAt(const vec3& eye, const vec3& center, const vec3& up);
+
+    const mat4& getView() const;
+    const mat4& getProjection() const;
+    const mat4& getViewProjection() const;
+    CameraBlock getBlock() const;
+
+    bool isVisible(const BoundingBox& box, const mat4& transform) const;
+    float getPixelDiameter(const vec3& center, float radius, const glm::ivec2& viewport) const;
+    void getRay(const vec2& point, vec3& origin, vec3& direction) const;
+    vec2 unprojectToPlane(const vec2& point) const;
+
+    bool operator==(const Camera& other) const;
+    bool operator!=(const Camera& other) const;
+
+private:
+    mat4 view_;
+    mat4 projection_;
+    mat4 view_projection_;
+};
+
+void bindCameraBlock(GLuint program_id);
+
+#endif
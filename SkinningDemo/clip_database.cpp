@@ -0,0 +1,401 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  clip_database.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of ClipDatabase class functions.
+
+#include "clip_database.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The start of each clip's block, followed by its arrays:
+///
+///         - keyed_joint_count joints, as GLuints
+///         - the curves' offsets and scales, as floats
+///         - the curves' first keys and key counts, as GLuints
+///         - for cubic clips, the curves' tangent offsets and scales
+///         - event_count AnimationEvents
+///         - key_count key times, values and, for cubic clips, tangents, as
+///           GLushorts
+///
+///         There are keyed_joint_count * CompressedClip::N_CHANNELS
+///         curves.  Every 4-byte array comes
+///         before the 2-byte ones, so each is aligned to its own size.
+struct ClipBlockHeader
+{
+    GLuint joint_count;
+    GLuint interpolation;       ///< A ClipInterpolation.
+    GLuint keyed_joint_count;
+    GLuint key_count;
+    GLuint event_count;
+    GLuint source_size;         ///< CompressedClip::getSourceSize(), in bytes.
+    GLfloat duration;
+    GLfloat time_scale;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a byte offset up to the next multiple of
+///         CLIP_DATABASE_BLOCK_ALIGNMENT.
+GLuint64 roundUpToBlock(GLuint64 offset)
+{
+    return (offset + CLIP_DATABASE_BLOCK_ALIGNMENT - 1) / CLIP_DATABASE_BLOCK_ALIGNMENT * CLIP_DATABASE_BLOCK_ALIGNMENT;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Appends an array to a block.
+template <typename T>
+void appendArray(std::vector<char>& block, const T* values, size_t count)
+{
+    const char* bytes = reinterpret_cast<const char*>(values);
+    block.insert(block.end(), bytes, bytes + count * sizeof(T));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads the next array of a block, if the block holds all of it.
+///
+/// \param  block The start of the block.
+/// \param  block_size The size of the block in bytes.
+/// \param  offset The offset of the array in the block, which is moved on
+///         past it.
+/// \param  values Receives the array.
+/// \param  count The number of values in the array.
+/// \return False if the array runs off the end of the block.
+template <typename T>
+bool readArray(const char* block, GLuint64 block_size, GLuint64& offset, std::vector<T>& values, size_t count)
+{
+    GLuint64 size = GLuint64(count) * sizeof(T);
+    if (offset + size > block_size)
+        return false;
+
+    values.resize(count);
+    if (count > 0)
+        std::memcpy(&values[0], block + offset, size_t(size));
+    offset += size;
+    return true;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Opens a clip database file written by save(), reading only its
+///         header and index.
+///
+/// \details If the file can't be opened, or its index is out of bounds,
+///         the problem is reported to stderr and an exception is thrown.
+///         Problems in a clip's block aren't found until it's unpacked.
+///
+/// \param  path The file to open.
+ClipDatabase::ClipDatabase(const std::string& path)
+    : path_(path),
+      file_(path, false),
+      reader_(path)
+{
+    if (file_.data == nullptr)
+        error("The file couldn't be opened.");
+    if (file_.size < sizeof(ClipDatabaseHeader))
+        error("The file is too small to be a clip database.");
+
+    ClipDatabaseHeader header;
+    std::memcpy(&header, file_.data, sizeof(header));
+    if (std::memcmp(header.magic, "SKCD", 4) != 0)
+        error("The file isn't a clip database.");
+    if (header.version != CLIP_DATABASE_VERSION)
+        error("The file's version isn't supported.");
+    if (GLuint64(sizeof(ClipDatabaseHeader)) + GLuint64(header.clip_count) * sizeof(ClipDatabaseEntry) > file_.size)
+        error("The file's index is out of bounds.");
+
+    entries_.resize(header.clip_count);
+    if (!entries_.empty())
+        std::memcpy(&entries_[0], file_.data + sizeof(ClipDatabaseHeader), entries_.size() * sizeof(ClipDatabaseEntry));
+    for (size_t clip = 0; clip < entries_.size(); ++clip)
+    {
+        const ClipDatabaseEntry& entry = entries_[clip];
+        if (entry.offset > file_.size || entry.size > file_.size - entry.offset || entry.size < sizeof(ClipBlockHeader))
+            error("The file's blocks are out of bounds.");
+    }
+
+    clips_.resize(entries_.size());
+    reads_.resize(entries_.size(), NO_READ);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a library of clips to a clip database file.
+///
+/// \details The clips keep their order, so the first clip given is clip 0
+///         of the database.  If the file can't be written, the problem is
+///         reported to stderr and an exception is thrown.
+///
+/// \param  clips The clips to write.
+/// \param  path The file to write.
+void ClipDatabase::save(const std::vector<const CompressedClip*>& clips, const std::string& path)
+{
+    ClipDatabaseHeader header;
+    std::memcpy(header.magic, "SKCD", 4);
+    header.version = CLIP_DATABASE_VERSION;
+    header.clip_count = GLuint(clips.size());
+    header.block_alignment = CLIP_DATABASE_BLOCK_ALIGNMENT;
+
+    std::vector<std::vector<char> > blocks(clips.size());
+    std::vector<ClipDatabaseEntry> entries(clips.size());
+    GLuint64 offset = sizeof(ClipDatabaseHeader) + clips.size() * sizeof(ClipDatabaseEntry);
+    for (size_t clip = 0; clip < clips.size(); ++clip)
+    {
+        writeBlock(*clips[clip], blocks[clip]);
+
+        offset = roundUpToBlock(offset);
+        entries[clip].offset = offset;
+        entries[clip].size = blocks[clip].size();
+        entries[clip].joint_count = GLuint(clips[clip]->getJointCount());
+        entries[clip].duration = clips[clip]->getDuration();
+        offset += blocks[clip].size();
+    }
+
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (file)
+    {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!entries.empty())
+            file.write(reinterpret_cast<const char*>(&entries[0]), std::streamsize(entries.size() * sizeof(ClipDatabaseEntry)));
+
+        const std::vector<char> padding(CLIP_DATABASE_BLOCK_ALIGNMENT, 0);
+        offset = sizeof(ClipDatabaseHeader) + clips.size() * sizeof(ClipDatabaseEntry);
+        for (size_t clip = 0; clip < clips.size(); ++clip)
+        {
+            file.write(&padding[0], std::streamsize(entries[clip].offset - offset));
+            file.write(&blocks[clip][0], std::streamsize(blocks[clip].size()));
+            offset = entries[clip].offset + blocks[clip].size();
+        }
+    }
+
+    if (!file)
+    {
+        std::cerr << "Error saving clip database!" << std::endl
+                  << "   File: " << path << std::endl;
+        throw std::runtime_error("Error saving clip database!");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of clips in the database.
+size_t ClipDatabase::getClipCount() const
+{
+    return entries_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints a clip animates, without reading
+///         the clip.
+size_t ClipDatabase::getJointCount(size_t clip) const
+{
+    assert(clip < entries_.size());
+    return entries_[clip].joint_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a clip's length in seconds, without reading the clip.
+float ClipDatabase::getDuration(size_t clip) const
+{
+    assert(clip < entries_.size());
+    return entries_[clip].duration;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts reading a clip's block in the background, so that
+///         getClip() won't wait for the disk.  Never waits itself.
+void ClipDatabase::prefetch(size_t clip)
+{
+    prefetch(&clip, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts reading several clips' blocks in the background, all
+///         submitted at once so the drive has them all to work on.  Clips
+///         which are unpacked, or already being read, are skipped.
+void ClipDatabase::prefetch(const size_t* clips, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t clip = clips[i];
+        assert(clip < entries_.size());
+        if (!clips_[clip] && reads_[clip] == NO_READ)
+            reads_[clip] = reader_.read(size_t(entries_[clip].offset), size_t(entries_[clip].size));
+    }
+    reader_.submit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if getClip() can return a clip without reading
+///         anything from disk: it's unpacked, or its prefetch has arrived,
+///         or its block is in memory.
+bool ClipDatabase::isResident(size_t clip)
+{
+    assert(clip < entries_.size());
+    if (clips_[clip])
+        return true;
+    if (reads_[clip] != NO_READ && reader_.isComplete(reads_[clip]) && reader_.getData(reads_[clip]) != nullptr)
+        return true;
+    return file_.isResident(size_t(entries_[clip].offset), size_t(entries_[clip].size));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a clip has been unpacked, and not unloaded since.
+bool ClipDatabase::isLoaded(size_t clip) const
+{
+    assert(clip < entries_.size());
+    return bool(clips_[clip]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a clip, unpacking it from its block the first time it's
+///         asked for.
+///
+/// \details The reference stays valid until the clip is unloaded, or the
+///         database is destroyed.  If the block isn't resident, this waits
+///         for it to be read: for its prefetch to arrive, if it has one.
+///         If it's corrupt, the problem is reported to stderr and an
+///         exception is thrown.
+const CompressedClip& ClipDatabase::getClip(size_t clip)
+{
+    assert(clip < entries_.size());
+    if (!clips_[clip])
+    {
+        const char* block = file_.data + entries_[clip].offset;
+        if (reads_[clip] != NO_READ)
+        {
+            reader_.wait(reads_[clip]);
+            if (reader_.getData(reads_[clip]) != nullptr)
+                block = reader_.getData(reads_[clip]);
+        }
+
+        std::unique_ptr<CompressedClip> compressed(new CompressedClip());
+        readBlock(clip, block, *compressed);
+        clips_[clip] = std::move(compressed);
+
+        if (reads_[clip] != NO_READ)
+            reader_.release(reads_[clip]);
+        reads_[clip] = NO_READ;
+    }
+    return *clips_[clip];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees an unpacked clip's memory.  No sampler may still be
+///         sampling it.  It's unpacked again if it's asked for again.
+void ClipDatabase::unload(size_t clip)
+{
+    assert(clip < entries_.size());
+    clips_[clip].reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Packs a clip into the bytes of its block.
+void ClipDatabase::writeBlock(const CompressedClip& clip, std::vector<char>& block)
+{
+    bool cubic = clip.interpolation_ == CLIP_INTERPOLATION_CUBIC;
+
+    ClipBlockHeader header;
+    header.joint_count = GLuint(clip.joint_count_);
+    header.interpolation = GLuint(clip.interpolation_);
+    header.keyed_joint_count = GLuint(clip.joints_.size());
+    header.key_count = GLuint(clip.key_times_.size());
+    header.event_count = GLuint(clip.events_.size());
+    header.source_size = GLuint(clip.source_size_);
+    header.duration = clip.duration_;
+    header.time_scale = clip.time_scale_;
+
+    std::vector<GLuint> joints(clip.joints_.begin(), clip.joints_.end());
+    size_t curve_count = clip.curve_offsets_.size();
+
+    block.clear();
+    appendArray(block, &header, 1);
+    appendArray(block, joints.data(), joints.size());
+    appendArray(block, clip.curve_offsets_.data(), curve_count);
+    appendArray(block, clip.curve_scales_.data(), curve_count);
+    appendArray(block, clip.curve_first_keys_.data(), curve_count);
+    appendArray(block, clip.curve_key_counts_.data(), curve_count);
+    if (cubic)
+    {
+        appendArray(block, clip.curve_tangent_offsets_.data(), curve_count);
+        appendArray(block, clip.curve_tangent_scales_.data(), curve_count);
+    }
+    appendArray(block, clip.events_.data(), clip.events_.size());
+    appendArray(block, clip.key_times_.data(), clip.key_times_.size());
+    appendArray(block, clip.key_values_.data(), clip.key_values_.size());
+    if (cubic)
+        appendArray(block, clip.key_tangents_.data(), clip.key_tangents_.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unpacks a clip from its block, checking that it's all in bounds.
+///
+/// \param  block The block's bytes: in the mapping, or a prefetch's
+///         staging buffer.
+void ClipDatabase::readBlock(size_t clip, const char* block, CompressedClip& compressed) const
+{
+    GLuint64 block_size = entries_[clip].size;
+
+    ClipBlockHeader header;
+    std::memcpy(&header, block, sizeof(header));
+    if (header.interpolation > CLIP_INTERPOLATION_CUBIC || header.joint_count != entries_[clip].joint_count ||
+        header.keyed_joint_count > header.joint_count || !(header.time_scale > 0))
+    {
+        error("A clip's header is invalid.");
+    }
+
+    bool cubic = header.interpolation == CLIP_INTERPOLATION_CUBIC;
+    size_t curve_count = header.keyed_joint_count * CompressedClip::N_CHANNELS;
+
+    compressed.joint_count_ = header.joint_count;
+    compressed.interpolation_ = ClipInterpolation(header.interpolation);
+    compressed.duration_ = header.duration;
+    compressed.time_scale_ = header.time_scale;
+    compressed.source_size_ = header.source_size;
+
+    std::vector<GLuint> joints;
+    GLuint64 offset = sizeof(ClipBlockHeader);
+    bool in_bounds = readArray(block, block_size, offset, joints, header.keyed_joint_count) &&
+                     readArray(block, block_size, offset, compressed.curve_offsets_, curve_count) &&
+                     readArray(block, block_size, offset, compressed.curve_scales_, curve_count) &&
+                     readArray(block, block_size, offset, compressed.curve_first_keys_, curve_count) &&
+                     readArray(block, block_size, offset, compressed.curve_key_counts_, curve_count) &&
+                     (!cubic || (readArray(block, block_size, offset, compressed.curve_tangent_offsets_, curve_count) &&
+                                 readArray(block, block_size, offset, compressed.curve_tangent_scales_, curve_count))) &&
+                     readArray(block, block_size, offset, compressed.events_, header.event_count) &&
+                     readArray(block, block_size, offset, compressed.key_times_, header.key_count) &&
+                     readArray(block, block_size, offset, compressed.key_values_, header.key_count) &&
+                     (!cubic || readArray(block, block_size, offset, compressed.key_tangents_, header.key_count));
+    if (!in_bounds)
+        error("A clip's arrays are out of bounds.");
+
+    for (size_t i = 0; i < joints.size(); ++i)
+    {
+        if (joints[i] >= header.joint_count)
+            error("A clip's joints are out of bounds.");
+    }
+    for (size_t curve = 0; curve < curve_count; ++curve)
+    {
+        if (GLuint64(compressed.curve_first_keys_[curve]) + compressed.curve_key_counts_[curve] > header.key_count)
+            error("A clip's curves are out of bounds.");
+    }
+    compressed.joints_.assign(joints.begin(), joints.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a problem with the database file and throws an
+///         exception.
+void ClipDatabase::error(const std::string& problem) const
+{
+    std::cerr << "Error loading clip database!" << std::endl
+              << "   File: " << path_ << std::endl
+              << "  Error: " << problem << std::endl;
+
+    throw std::runtime_error("Error loading clip database!");
+}
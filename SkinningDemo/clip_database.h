@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  clip_database.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the ClipDatabase class, and the structs of the
+///         clip database file format.
+
+#ifndef CLIP_DATABASE_H_
+#define CLIP_DATABASE_H_
+
+#include "async_file_reader.h"
+#include "compressed_clip.h"
+#include "mapped_file.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The header at the start of every clip database file.
+///
+/// \details A clip database holds a library of CompressedClips, each in its
+///         own block, which starts on a multiple of block_alignment bytes
+///         so that no two clips share a page.  It consists of:
+///
+///         - this header
+///         - clip_count ClipDatabaseEntries, the index
+///         - each clip's block, as described by its entry
+///
+///         Only the header and the index are read when the file is opened;
+///         a clip's block isn't read from disk until the clip is first
+///         asked for, or prefetched.  Like mesh files, everything is in the
+///         native byte order of the machine which wrote the file.
+struct ClipDatabaseHeader
+{
+    char magic[4];              ///< Always "SKCD".
+    GLuint version;             ///< CLIP_DATABASE_VERSION.
+    GLuint clip_count;
+    GLuint block_alignment;     ///< CLIP_DATABASE_BLOCK_ALIGNMENT, when it was written.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Where a clip database keeps a clip, and what can be known about
+///         the clip without reading it.
+struct ClipDatabaseEntry
+{
+    GLuint64 offset;            ///< The byte offset of the clip's block from the start of the file.
+    GLuint64 size;              ///< The size of the block in bytes.
+    GLuint joint_count;
+    GLfloat duration;           ///< In seconds.
+};
+
+/// The version of the clip database format written by ClipDatabase::save().
+const GLuint CLIP_DATABASE_VERSION = 1;
+
+/// What the clips' blocks are aligned to: the page size of most of the
+/// machines the demo runs on.
+const GLuint CLIP_DATABASE_BLOCK_ALIGNMENT = 4096;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A memory-mapped clip database file, whose clips are read into
+///         memory as they're needed.
+///
+/// \details The file is mapped rather than read, so a library far larger
+///         than the machine's memory can be opened.  getClip() unpacks a
+///         clip from its block the first time it's asked for, which is when
+///         its pages are read from disk, unless they're there already.  To
+///         keep that read off the frame, whoever knows which clips are
+///         coming up (the game, starting a transition or entering an area)
+///         should prefetch() them well beforehand, and can check
+///         isResident() before starting one.  Prefetching never waits: it
+///         queues an unbuffered read of each block through an
+///         AsyncFileReader, straight into a staging buffer, with all of the
+///         clips prefetched at once in flight together, and getClip()
+///         unpacks from that buffer once it's arrived.  A clip which wasn't
+///         prefetched, or whose read failed, is unpacked from the mapping
+///         instead.  Clips that won't be played for a while can be
+///         unload()ed; their pages are clean, so the OS can drop them
+///         whenever it needs the memory.
+///
+///         The database isn't thread-safe: it's meant to be used by the
+///         simulation thread alone.
+class ClipDatabase
+{
+public:
+    explicit ClipDatabase(const std::string& path);
+
+    static void save(const std::vector<const CompressedClip*>& clips, const std::string& path);
+
+    size_t getClipCount() const;
+    size_t getJointCount(size_t clip) const;
+    float getDuration(size_t clip) const;
+
+    void prefetch(size_t clip);
+    void prefetch(const size_t* clips, size_t count);
+    bool isResident(size_t clip);
+    bool isLoaded(size_t clip) const;
+
+    const CompressedClip& getClip(size_t clip);
+    void unload(size_t clip);
+
+private:
+    static const AsyncFileReader::ReadId NO_READ = AsyncFileReader::ReadId(-1);
+
+    ClipDatabase(const ClipDatabase&);              // non-copyable
+    ClipDatabase& operator=(const ClipDatabase&);   // non-copyable
+
+    static void writeBlock(const CompressedClip& clip, std::vector<char>& block);
+    void readBlock(size_t clip, const char* block, CompressedClip& compressed) const;
+    void error(const std::string& problem) const;
+
+    std::string path_;
+    MappedFile file_;
+    AsyncFileReader reader_;
+    std::vector<ClipDatabaseEntry> entries_;
+    std::vector<AsyncFileReader::ReadId> reads_;            ///< Each clip's prefetch, until it's unpacked, or NO_READ.
+    std::vector<std::unique_ptr<CompressedClip> > clips_;   ///< Each clip, once it's been unpacked, or null.
+};
+
+#endif
@@ -0,0 +1,621 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  compressed_clip.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of CompressedClip and CompressedClipSampler class
+///         functions.
+
+#include "compressed_clip.h"
+#include "spline_kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+const float MAX_QUANTIZED = 65535.0f;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Quantizes a value in [0, MAX_QUANTIZED] to the nearest step.
+GLushort quantize(float value)
+{
+    return GLushort(std::min(std::max(value + 0.5f, 0.0f), MAX_QUANTIZED));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if every key strictly between first and last is
+///         within the tolerance of the line from first to last.
+bool keysFitLine(const std::vector<float>& times, const std::vector<float>& values,
+                 size_t first, size_t last, float tolerance)
+{
+    for (size_t key = first + 1; key < last; ++key)
+    {
+        float t = (times[key] - times[first]) / (times[last] - times[first]);
+        if (std::abs(glm::mix(values[first], values[last], t) - values[key]) > tolerance)
+            return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the largest magnitude a cubic takes over an interval,
+///         given its values at the start, a third and two thirds of the way
+///         along, and the end.
+float getCubicPeak(const float values[4])
+{
+    // the cubic in t, from 0 to 3, through the values, by its forward
+    // differences.
+    float d1 = values[1] - values[0];
+    float d2 = values[2] - 2.0f * values[1] + values[0];
+    float d3 = values[3] - 3.0f * values[2] + 3.0f * values[1] - values[0];
+    float a = values[0];
+    float b = d1 - 0.5f * d2 + d3 / 3.0f;
+    float c = 0.5f * (d2 - d3);
+    float d = d3 / 6.0f;
+
+    float peak = std::max(std::abs(values[0]), std::abs(values[3]));
+
+    // between the ends, it peaks only where its slope, b + 2ct + 3dt^2, is
+    // zero.
+    float roots[2];
+    size_t root_count = 0;
+    if (std::abs(d) > 1e-12f)
+    {
+        float discriminant = c * c - 3.0f * b * d;
+        if (discriminant >= 0)
+        {
+            roots[root_count++] = (-c + std::sqrt(discriminant)) / (3.0f * d);
+            roots[root_count++] = (-c - std::sqrt(discriminant)) / (3.0f * d);
+        }
+    }
+    else if (std::abs(c) > 1e-12f)
+    {
+        roots[root_count++] = -b / (2.0f * c);
+    }
+
+    for (size_t i = 0; i < root_count; ++i)
+    {
+        float t = roots[i];
+        if (t > 0 && t < 3)
+            peak = std::max(peak, std::abs(a + t * (b + t * (c + t * d))));
+    }
+    return peak;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the source curve, everywhere from first to
+///         last, is within the tolerance of the Hermite curve from first to
+///         last, with the keys' own tangents.
+///
+/// \details Unlike a line's, a cubic's error against the source needn't
+///         peak at the keys.  On each source segment, though, the error is
+///         the difference of two cubics, so it's a cubic itself, and its
+///         peak there can be found from four samples.
+bool keysFitHermite(const std::vector<float>& times, const std::vector<float>& values,
+                    const std::vector<float>& tangents, size_t first, size_t last, float tolerance)
+{
+    const float SEGMENT_POINTS[4] = { 0.0f, 1.0f / 3.0f, 2.0f / 3.0f, 1.0f };
+
+    float interval = times[last] - times[first];
+    float first_tangent = tangents[first] * interval;
+    float last_tangent = tangents[last] * interval;
+    for (size_t key = first; key < last; ++key)
+    {
+        float segment = times[key + 1] - times[key];
+        float key_tangent = tangents[key] * segment;
+        float next_tangent = tangents[key + 1] * segment;
+        float errors[4];
+        for (size_t i = 0; i < 4; ++i)
+        {
+            float source = 0;
+            hermiteStream(&values[key], &key_tangent, &values[key + 1], &next_tangent,
+                          &SEGMENT_POINTS[i], &source, 1);
+
+            float s = (times[key] + SEGMENT_POINTS[i] * segment - times[first]) / interval;
+            float value = 0;
+            hermiteStream(&values[first], &first_tangent, &values[last], &last_tangent, &s, &value, 1);
+            errors[i] = value - source;
+        }
+        if (getCubicPeak(errors) > tolerance)
+            return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the slope of a cubic clip's curve at each key, in
+///         value per second.
+///
+/// \details These are the tangents of the Catmull-Rom spline ClipSampler
+///         follows through the keys, which are exactly its own where the
+///         keys are evenly spaced, as a baked clip's are.  The end keys
+///         take the slope of the line to their neighbours, as they do
+///         there.
+void computeTangents(const std::vector<float>& times, const std::vector<float>& values,
+                     std::vector<float>& tangents)
+{
+    size_t key_count = values.size();
+    tangents.assign(key_count, 0.0f);
+    for (size_t key = 0; key < key_count && key_count > 1; ++key)
+    {
+        size_t before = key > 0 ? key - 1 : key;
+        size_t after = key + 1 < key_count ? key + 1 : key;
+        tangents[key] = (values[after] - values[before]) / (times[after] - times[before]);
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the default tolerances, which are well below what can be
+///         seen at the demo's scale.
+ClipTolerance::ClipTolerance()
+    : translation(0.0005f),
+      rotation(0.05f),
+      scale(0.0005f)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compresses a clip.
+///
+/// \param  clip The clip to compress.  It isn't referenced afterwards.
+/// \param  tolerance The largest error allowed in each channel.  A clip
+///         too long for a curve's keys to be quantized within it is
+///         refused with an exception.
+CompressedClip::CompressedClip(const AnimationClip& clip, const ClipTolerance& tolerance)
+    : joint_count_(clip.getJointCount()),
+      interpolation_(clip.getInterpolation()),
+      duration_(clip.getDuration()),
+      source_size_(0),
+      events_(clip.getEvents())
+{
+    float end_time = std::max(duration_, 0.0f);
+    for (size_t joint = 0; joint < joint_count_; ++joint)
+    {
+        const std::vector<float>& times = clip.getTrack(joint).times;
+        if (!times.empty())
+            end_time = std::max(end_time, times.back());
+    }
+    time_scale_ = end_time > 0 ? end_time / MAX_QUANTIZED : 1.0f;
+
+    std::vector<float> values;
+    for (size_t joint = 0; joint < joint_count_; ++joint)
+    {
+        const AnimationClip::Track& track = clip.getTrack(joint);
+        size_t key_count = track.times.size();
+        if (key_count == 0)
+            continue;
+
+        joints_.push_back(joint);
+        source_size_ += key_count * (sizeof(float) + sizeof(vec2) + 2 * sizeof(float));
+
+        values.resize(key_count);
+        for (size_t key = 0; key < key_count; ++key)
+            values[key] = track.translations[key].x;
+        addCurve(track.times, values, tolerance.translation);
+
+        for (size_t key = 0; key < key_count; ++key)
+            values[key] = track.translations[key].y;
+        addCurve(track.times, values, tolerance.translation);
+
+        addCurve(track.times, track.rotations, tolerance.rotation);
+        addCurve(track.times, track.scales, tolerance.scale);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty clip, for ClipDatabase to unpack one into.
+CompressedClip::CompressedClip()
+    : joint_count_(0),
+      interpolation_(CLIP_INTERPOLATION_LINEAR),
+      duration_(0),
+      time_scale_(1.0f),
+      source_size_(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compresses one scalar curve, and appends it to the clip.
+///
+/// \details Cubic clips keep each key's tangent as well, and fit Hermite
+///         curves between the keys they keep instead of lines.
+///
+/// \param  times The time of each key, in seconds, in increasing order.
+/// \param  values The value of each key.
+/// \param  tolerance The largest error allowed anywhere on the curve.  If
+///         quantizing the keys alone would exceed it, this reports why and
+///         throws.
+void CompressedClip::addCurve(const std::vector<float>& times, const std::vector<float>& values, float tolerance)
+{
+    float min_value = *std::min_element(values.begin(), values.end());
+    float max_value = *std::max_element(values.begin(), values.end());
+
+    // constant curves are stored as the middle of their range.
+    if (max_value - min_value <= 2.0f * tolerance)
+    {
+        curve_offsets_.push_back(0.5f * (min_value + max_value));
+        curve_scales_.push_back(0.0f);
+        curve_first_keys_.push_back(GLuint(key_times_.size()));
+        curve_key_counts_.push_back(0);
+        if (interpolation_ == CLIP_INTERPOLATION_CUBIC)
+        {
+            curve_tangent_offsets_.push_back(0.0f);
+            curve_tangent_scales_.push_back(0.0f);
+        }
+        return;
+    }
+
+    bool cubic = interpolation_ == CLIP_INTERPOLATION_CUBIC;
+    std::vector<float> tangents;
+    float min_tangent = 0;
+    float max_tangent = 0;
+    if (cubic)
+    {
+        computeTangents(times, values, tangents);
+        min_tangent = *std::min_element(tangents.begin(), tangents.end());
+        max_tangent = *std::max_element(tangents.begin(), tangents.end());
+    }
+
+    // rounding a value to the nearest step is off by up to half a step, and
+    // rounding a key's time shifts the curve by up to half a time step times
+    // its steepest slope.  The rest of the tolerance is left for removing
+    // keys.
+    float max_slope = 0;
+    for (size_t key = 1; key < values.size(); ++key)
+        max_slope = std::max(max_slope, std::abs(values[key] - values[key - 1]) / (times[key] - times[key - 1]));
+
+    float scale = (max_value - min_value) / MAX_QUANTIZED;
+    float quantization_error = 0.5f * scale + 0.5f * time_scale_ * max_slope;
+
+    // a Hermite curve is never steeper than 1.5 times its chord plus both
+    // its tangents, and rounding a tangent moves the curve by at most a
+    // quarter of the interval times half a tangent step, and no interval
+    // is longer than the clip.
+    if (cubic)
+    {
+        float max_tangent_slope = std::max(std::abs(min_tangent), std::abs(max_tangent));
+        quantization_error = 0.5f * scale + 0.5f * time_scale_ * (1.5f * max_slope + 2.0f * max_tangent_slope) +
+                             0.125f * time_scale_ * (max_tangent - min_tangent);
+    }
+
+    // a curve too steep for the clip's time steps can't be kept within the
+    // tolerance by any choice of keys.
+    if (quantization_error > tolerance)
+    {
+        std::cerr << "Error compressing animation clip!" << std::endl
+                  << "  Error: Quantizing a curve's keys would be off by " << quantization_error
+                  << ", more than its tolerance of " << tolerance << "." << std::endl
+                  << "         The clip may be too long for its times to be quantized finely enough."
+                  << std::endl;
+        throw std::runtime_error("Error compressing animation clip!");
+    }
+    float fit_tolerance = tolerance - quantization_error;
+
+    std::vector<size_t> kept(1, 0);
+    for (size_t last = 2; last < values.size(); ++last)
+    {
+        bool fits = cubic ? keysFitHermite(times, values, tangents, kept.back(), last, fit_tolerance)
+                          : keysFitLine(times, values, kept.back(), last, fit_tolerance);
+        if (!fits)
+            kept.push_back(last - 1);
+    }
+    if (values.size() > 1)
+        kept.push_back(values.size() - 1);
+
+    curve_offsets_.push_back(min_value);
+    curve_scales_.push_back(scale);
+    curve_first_keys_.push_back(GLuint(key_times_.size()));
+    curve_key_counts_.push_back(GLuint(kept.size()));
+
+    for (size_t i = 0; i < kept.size(); ++i)
+    {
+        key_times_.push_back(quantize(times[kept[i]] / time_scale_));
+        key_values_.push_back(quantize((values[kept[i]] - min_value) / scale));
+    }
+
+    if (cubic)
+    {
+        // in quantized steps per quantized time step, so the sampler only
+        // has to scale them by the interval.
+        float steps = time_scale_ / scale;
+        float tangent_scale = (max_tangent - min_tangent) * steps / MAX_QUANTIZED;
+        curve_tangent_offsets_.push_back(min_tangent * steps);
+        curve_tangent_scales_.push_back(tangent_scale);
+        for (size_t i = 0; i < kept.size(); ++i)
+        {
+            float tangent = (tangents[kept[i]] - min_tangent) * steps;
+            key_tangents_.push_back(tangent_scale > 0 ? quantize(tangent / tangent_scale) : GLushort(0));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the clip, including any which
+///         aren't animated.
+size_t CompressedClip::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the clip's length in seconds.
+float CompressedClip::getDuration() const
+{
+    return duration_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns whether the clip's curves are lines or Hermite curves,
+///         which is whatever its source clip's were.
+ClipInterpolation CompressedClip::getInterpolation() const
+{
+    return interpolation_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of keys kept, over all curves.
+size_t CompressedClip::getKeyCount() const
+{
+    return key_times_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of curves stored as a single constant.
+size_t CompressedClip::getConstantCurveCount() const
+{
+    return size_t(std::count(curve_key_counts_.begin(), curve_key_counts_.end(), GLuint(0)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a joint has curves in the clip.  One which
+///         doesn't is never written by the sampler.
+bool CompressedClip::hasKeys(size_t joint) const
+{
+    return std::find(joints_.begin(), joints_.end(), joint) != joints_.end();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gets the value a joint's channel holds for the whole clip, if
+///         its curve was stored as a constant.
+///
+/// \param  joint A joint with keys; see hasKeys().
+/// \param  channel The channel's curve.
+/// \param  value Receives the value the sampler always writes.
+/// \return false if the curve moves, leaving value alone.
+bool CompressedClip::getConstantValue(size_t joint, Channel channel, float& value) const
+{
+    size_t curve = (std::find(joints_.begin(), joints_.end(), joint) - joints_.begin()) * N_CHANNELS + channel;
+    assert(curve < curve_key_counts_.size());
+    if (curve_key_counts_[curve] != 0)
+        return false;
+
+    value = curve_offsets_[curve];
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of bytes the compressed clip occupies.
+size_t CompressedClip::getSize() const
+{
+    return sizeof(*this) + joints_.size() * sizeof(size_t) +
+           curve_offsets_.size() * (2 * sizeof(float) + 2 * sizeof(GLuint)) +
+           key_times_.size() * 2 * sizeof(GLushort) + events_.size() * sizeof(AnimationEvent) +
+           curve_tangent_offsets_.size() * 2 * sizeof(float) + key_tangents_.size() * sizeof(GLushort);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of bytes the source clip's keys occupy.
+size_t CompressedClip::getSourceSize() const
+{
+    return source_size_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the clip's events, sorted by time.
+const std::vector<AnimationEvent>& CompressedClip::getEvents() const
+{
+    return events_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a sampler positioned at the start of a clip.  The clip
+///         must outlive the sampler.
+CompressedClipSampler::CompressedClipSampler(const CompressedClip& clip)
+    : clip_(&clip),
+      cursors_(clip.curve_offsets_.size(), 0),
+      last_time_(0),
+      a_(cursors_.size()),
+      b_(cursors_.size()),
+      a_tangents_(cursors_.size()),
+      b_tangents_(cursors_.size()),
+      t_(cursors_.size()),
+      values_(cursors_.size())
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the clip's joint channels at a given time into a pose.
+///
+/// \details Behaves like ClipSampler::sample(), to within the tolerance the
+///         clip was compressed with.  Without a mask, every curve goes
+///         through each pass at once; with one, each joint in it goes
+///         through them in turn, and the curves of the joints outside it
+///         aren't touched, nor are their cursors moved.
+///
+/// \param  time The time to sample, in seconds.
+/// \param  pose The pose to write to; must have as many joints as the clip.
+/// \param  mask The joints to sample, or null for all of them.  The rest
+///         are left as they were.
+void CompressedClipSampler::sample(float time, Pose& pose, const JointMask* mask)
+{
+    assert(pose.joint_count == clip_->joint_count_);
+    assert(mask == nullptr || mask->getJointCount() == clip_->joint_count_);
+
+    float quantized_time = std::min(std::max(time / clip_->time_scale_, 0.0f), MAX_QUANTIZED);
+    if (quantized_time < last_time_)
+        cursors_.assign(cursors_.size(), 0);
+    last_time_ = quantized_time;
+
+    size_t curve_count = cursors_.size();
+    if (curve_count == 0)
+        return;
+
+    if (mask == nullptr)
+    {
+        for (size_t curve = 0; curve < curve_count; ++curve)
+            findKeys(curve, quantized_time);
+        interpolateCurves(0, curve_count);
+        for (size_t i = 0; i < clip_->joints_.size(); ++i)
+            writeJoint(i, pose);
+        return;
+    }
+
+    for (size_t i = 0; i < clip_->joints_.size(); ++i)
+    {
+        if (!mask->test(clip_->joints_[i]))
+            continue;
+
+        size_t first_curve = i * CompressedClip::N_CHANNELS;
+        for (size_t channel = 0; channel < CompressedClip::N_CHANNELS; ++channel)
+            findKeys(first_curve + channel, quantized_time);
+        interpolateCurves(first_curve, CompressedClip::N_CHANNELS);
+        writeJoint(i, pose);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The first pass of sample(): finds the keys either side of the
+///         time on a curve, and how far between them it is.
+///
+/// \details Constant curves are left with a = b = 0, which dequantizes to
+///         the curve's offset.  A cubic clip's key tangents are scaled to
+///         the interval between the keys here too.
+void CompressedClipSampler::findKeys(size_t curve, float quantized_time)
+{
+    GLuint key_count = clip_->curve_key_counts_[curve];
+    if (key_count == 0)
+    {
+        a_[curve] = b_[curve] = t_[curve] = 0;
+        a_tangents_[curve] = b_tangents_[curve] = 0;
+        return;
+    }
+
+    const GLushort* times = &clip_->key_times_[clip_->curve_first_keys_[curve]];
+    const GLushort* values = &clip_->key_values_[clip_->curve_first_keys_[curve]];
+    GLuint& cursor = cursors_[curve];
+    while (cursor + 1 < key_count && times[cursor + 1] <= quantized_time)
+        ++cursor;
+
+    GLuint next = cursor + 1 < key_count ? cursor + 1 : cursor;
+    a_[curve] = values[cursor];
+    b_[curve] = values[next];
+    t_[curve] = next != cursor && quantized_time > times[cursor]
+              ? (quantized_time - times[cursor]) / float(times[next] - times[cursor])
+              : 0.0f;
+
+    if (clip_->interpolation_ == CLIP_INTERPOLATION_CUBIC)
+    {
+        const GLushort* tangents = &clip_->key_tangents_[clip_->curve_first_keys_[curve]];
+        float offset = clip_->curve_tangent_offsets_[curve];
+        float scale = clip_->curve_tangent_scales_[curve];
+        float interval = float(times[next] - times[cursor]);
+        a_tangents_[curve] = (offset + scale * tangents[cursor]) * interval;
+        b_tangents_[curve] = (offset + scale * tangents[next]) * interval;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The second pass of sample(): interpolates and dequantizes a run
+///         of curves whose keys have been found, all the same way.
+void CompressedClipSampler::interpolateCurves(size_t first_curve, size_t count)
+{
+    size_t end = first_curve + count;
+    const float* offsets = &clip_->curve_offsets_[0];
+    const float* scales = &clip_->curve_scales_[0];
+    if (clip_->interpolation_ == CLIP_INTERPOLATION_CUBIC)
+    {
+        hermiteStream(&a_[first_curve], &a_tangents_[first_curve], &b_[first_curve], &b_tangents_[first_curve],
+                      &t_[first_curve], &values_[first_curve], count);
+        for (size_t curve = first_curve; curve < end; ++curve)
+            values_[curve] = offsets[curve] + scales[curve] * values_[curve];
+    }
+    else
+    {
+        for (size_t curve = first_curve; curve < end; ++curve)
+            values_[curve] = offsets[curve] + scales[curve] * (a_[curve] + (b_[curve] - a_[curve]) * t_[curve]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The last pass of sample(): scatters the values of one of the
+///         clip's joints with keys into the pose.
+///
+/// \param  index The joint's index in the clip's joints_, not the skeleton.
+/// \param  pose The pose to write to.
+void CompressedClipSampler::writeJoint(size_t index, Pose& pose) const
+{
+    size_t joint = clip_->joints_[index];
+    const float* joint_values = &values_[index * CompressedClip::N_CHANNELS];
+    pose.translation[joint] = vec2(joint_values[CompressedClip::CHANNEL_TRANSLATION_X],
+                                   joint_values[CompressedClip::CHANNEL_TRANSLATION_Y]);
+    pose.rotation[joint] = joint_values[CompressedClip::CHANNEL_ROTATION];
+    pose.scale[joint] = joint_values[CompressedClip::CHANNEL_SCALE];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Samples the clip as though it repeats forever.
+///
+/// \param  time The time to sample, in seconds; any time, even negative,
+///         is wrapped into the clip's duration first.
+/// \param  pose The pose to write to.
+/// \param  mask The joints to sample, or null for all of them.
+void CompressedClipSampler::sampleLooped(float time, Pose& pose, const JointMask* mask)
+{
+    float duration = clip_->getDuration();
+    if (duration > 0)
+    {
+        time = std::fmod(time, duration);
+        if (time < 0)
+            time += duration;
+    }
+
+    sample(time, pose, mask);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Pushes the events the clip's looped playback crossed since the
+///         last call to a queue, as ClipSampler::emitLoopedEvents().
+///
+/// \param  time The time playback has reached, in seconds.
+/// \param  instance Passed on in each AnimationNotify.
+/// \param  weight The weight the clip is being blended with.
+/// \param  queue The queue to push the events to.
+void CompressedClipSampler::emitLoopedEvents(float time, GLuint instance, float weight, AnimationEventQueue& queue)
+{
+    float duration = clip_->getDuration();
+    if (duration > 0)
+    {
+        time = std::fmod(time, duration);
+        if (time < 0)
+            time += duration;
+    }
+
+    event_cursor_.advance(clip_->events_, time, true, instance, weight, queue);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves every cursor back to the first key, and forgets where the
+///         events were up to.
+void CompressedClipSampler::reset()
+{
+    cursors_.assign(cursors_.size(), 0);
+    last_time_ = 0;
+    event_cursor_.reset();
+}
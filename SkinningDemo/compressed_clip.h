@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  compressed_clip.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the CompressedClip and CompressedClipSampler
+///         classes.
+
+#ifndef COMPRESSED_CLIP_H_
+#define COMPRESSED_CLIP_H_
+
+#include "demo.h"
+#include "animation_clip.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The largest error allowed in each channel when compressing a
+///         clip.
+struct ClipTolerance
+{
+    ClipTolerance();
+
+    float translation;  ///< In model units.
+    float rotation;     ///< In degrees.
+    float scale;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A read-only, compressed copy of an AnimationClip.
+///
+/// \details Each joint's track is split into four scalar curves:
+///         translation x and y, rotation and scale.  Each curve is
+///         compressed separately:
+///
+///         - A curve whose keys all lie within the tolerance of a single
+///           value is stored as just that value, with no keys at all.
+///           Most of a typical rig's scale curves, and many of its
+///           translation curves, end up this way.
+///         - Otherwise, keys are removed wherever the line between their
+///           neighbours stays within the tolerance of every removed key.
+///         - The remaining keys' values are quantized to 16 bits across the
+///           curve's range, and their times to 16 bits across the clip.
+///           Part of the tolerance is reserved for the quantization error,
+///           so the two errors together never exceed it; a clip whose
+///           quantization alone would is refused.
+///
+///         Rotations are 2D angles in degrees, so they are quantized the same
+///         way as the other channels; quantizing across each curve's own
+///         range (instead of across 360 degrees) keeps the precision high
+///         and lets rotations wind past 360 degrees, as the demo's poses do.
+///
+///         A cubic source clip is compressed into cubic Hermite curves
+///         instead of lines.  Each key also keeps its tangent, taken from
+///         the source's Catmull-Rom spline and quantized to 16 bits across
+///         the curve's range of tangents, and keys are removed wherever the
+///         Hermite curve between their neighbours stays within the
+///         tolerance.  A smooth curve needs several times fewer keys this
+///         way, which more than makes up for the tangents.
+class CompressedClip
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The curves of each joint with keys, in order.
+    enum Channel
+    {
+        CHANNEL_TRANSLATION_X = 0,
+        CHANNEL_TRANSLATION_Y,
+        CHANNEL_ROTATION,
+        CHANNEL_SCALE,
+        N_CHANNELS
+    };
+
+    explicit CompressedClip(const AnimationClip& clip, const ClipTolerance& tolerance = ClipTolerance());
+
+    size_t getJointCount() const;
+    float getDuration() const;
+    ClipInterpolation getInterpolation() const;
+    size_t getKeyCount() const;
+    size_t getConstantCurveCount() const;
+    size_t getSize() const;
+    size_t getSourceSize() const;
+    const std::vector<AnimationEvent>& getEvents() const;
+
+    bool hasKeys(size_t joint) const;
+    bool getConstantValue(size_t joint, Channel channel, float& value) const;
+
+private:
+    friend class CompressedClipSampler;
+    friend class ClipDatabase;
+
+    CompressedClip();
+
+    void addCurve(const std::vector<float>& times, const std::vector<float>& values, float tolerance);
+
+    size_t joint_count_;
+    ClipInterpolation interpolation_;
+    std::vector<size_t> joints_;        ///< The joints with keys; joints without any are never written.
+    float duration_;
+    float time_scale_;                  ///< Seconds per quantized time step.
+    size_t source_size_;                ///< The size of the uncompressed keys, in bytes.
+
+    // curve c is channel c % N_CHANNELS of joint joints_[c / N_CHANNELS].
+    // A curve's value is offset + scale * (quantized value).
+    std::vector<float> curve_offsets_;
+    std::vector<float> curve_scales_;
+    std::vector<GLuint> curve_first_keys_;
+    std::vector<GLuint> curve_key_counts_;    ///< 0 for a constant curve, whose value is its offset.
+
+    // only for cubic clips.  A key's tangent is tangent offset + tangent
+    // scale * (quantized tangent), in quantized value steps per quantized
+    // time step.
+    std::vector<float> curve_tangent_offsets_;
+    std::vector<float> curve_tangent_scales_;
+
+    std::vector<GLushort> key_times_;
+    std::vector<GLushort> key_values_;
+    std::vector<GLushort> key_tangents_;      ///< Only for cubic clips.
+
+    std::vector<AnimationEvent> events_;    ///< Copied from the source as they are; there are few enough.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Samples a CompressedClip into a Pose.
+///
+/// \details Like ClipSampler, each curve keeps a cursor, so forward playback
+///         finds its keys in amortized constant time.  Sampling is split
+///         into passes over flat arrays: the first finds each curve's two
+///         keys and interpolation factor, the second dequantizes and
+///         interpolates every curve at once with the same arithmetic (so the
+///         compiler can vectorize it, and constant curves need no branch),
+///         and the last scatters the results into the pose's streams.  A
+///         cubic clip's curves are interpolated by hermiteStream(), with
+///         the first pass also scaling each key's tangent to its interval.
+///         A JointMask limits the passes to the joints in it, as it does
+///         for ClipSampler.  Events are emitted as ClipSampler emits them.
+class CompressedClipSampler
+{
+public:
+    explicit CompressedClipSampler(const CompressedClip& clip);
+
+    void sample(float time, Pose& pose, const JointMask* mask = nullptr);
+    void sampleLooped(float time, Pose& pose, const JointMask* mask = nullptr);
+    void emitLoopedEvents(float time, GLuint instance, float weight, AnimationEventQueue& queue);
+    void reset();
+
+private:
+    void findKeys(size_t curve, float quantized_time);
+    void interpolateCurves(size_t first_curve, size_t count);
+    void writeJoint(size_t index, Pose& pose) const;
+
+    const CompressedClip* clip_;
+    std::vector<GLuint> cursors_;   ///< Each curve's last key at or before last_time_, relative to its first.
+    float last_time_;               ///< The time last sampled, in quantized time steps.
+    AnimationEventCursor event_cursor_;
+
+    // scratch space for the passes of sample(), one element per curve.
+    std::vector<float> a_;
+    std::vector<float> b_;
+    std::vector<float> a_tangents_;
+    std::vector<float> b_tangents_;
+    std::vector<float> t_;
+    std::vector<float> values_;
+};
+
+#endif
@@ -0,0 +1,255 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  compute_skinner.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of ComputeSkinner class functions.
+
+#include "compute_skinner.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the storage buffers for skinning a mesh.
+///
+/// \param  mesh The mesh to skin.  It must already have been uploaded, and
+///         must outlive the skinner.
+/// \param  joint_count The number of joints in each palette.
+/// \param  max_instances The maximum number of instances skin() can be given.
+ComputeSkinner::ComputeSkinner(const SkeletalMesh& mesh, size_t joint_count, size_t max_instances)
+    : mesh_(mesh),
+      joint_count_(joint_count),
+      max_instances_(max_instances),
+      visible_count_(0),
+      cpu_count_(0),
+      cpu_milliseconds_(0),
+      thread_pool_(nullptr)
+{
+    glGenBuffers(1, &palette_buffer_id_);
+    glGenBuffers(1, &color_buffer_id_);
+    glGenBuffers(1, &visible_buffer_id_);
+    glGenBuffers(1, &skinned_buffer_id_);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, palette_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max_instances * joint_count * sizeof(mat4), nullptr, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, color_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, joint_count * sizeof(color4), nullptr, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visible_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max_instances * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+
+    // each skinned vertex is a vec4 position and a vec4 color.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, skinned_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max_instances * mesh.getVertexCount() * sizeof(vec4) * 2, nullptr, GL_DYNAMIC_COPY);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the skinner's storage buffers.
+ComputeSkinner::~ComputeSkinner()
+{
+    glDeleteBuffers(1, &palette_buffer_id_);
+    glDeleteBuffers(1, &color_buffer_id_);
+    glDeleteBuffers(1, &visible_buffer_id_);
+    glDeleteBuffers(1, &skinned_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins every vertex of every visible instance in one dispatch.
+///
+/// \details The skinned vertices are written as shader storage, which isn't
+///         coherent, so a glMemoryBarrier() with
+///         GL_SHADER_STORAGE_BARRIER_BIT has to come between this and
+///         draw(), or anything else which reads them.  The caller places
+///         it, since it knows what reads them next; display()'s FrameGraph
+///         does so.
+///
+/// \param  compute_program_id The skinning compute shader program, compiled
+///         for the mesh's vertex format.
+/// \param  palettes The palettes of all max_instances instances, one after
+///         another, or null if the visible instances' palettes have already
+///         been written into getPaletteBuffer() on the GPU (see
+///         HierarchyComputePass::resolvePalettes()), in which case the CPU
+///         has none to skin with and every instance stays on the GPU.
+/// \param  colors The joint colors, shared by all instances.
+/// \param  visible_instances The indices of the instances to skin.  The
+///         skinned vertices of visible_instances[i] are drawn as instance i
+///         by draw().
+/// \param  visible_count The number of visible instances.
+/// \param  cpu_count How many of the last visible instances to skin on the
+///         CPU instead; none unless canSkinOnCpu().
+void ComputeSkinner::skin(GLuint compute_program_id,
+                          const mat4* palettes,
+                          const color4* colors,
+                          const GLuint* visible_instances,
+                          size_t visible_count,
+                          size_t cpu_count)
+{
+    visible_count_ = std::min(visible_count, max_instances_);
+    cpu_count_ = canSkinOnCpu() && palettes != nullptr ? std::min(cpu_count, visible_count_) : 0;
+    cpu_milliseconds_ = 0;
+    if (visible_count_ == 0)
+        return;
+
+    if (palettes != nullptr)
+    {
+        GLsizeiptr palettes_size = max_instances_ * joint_count_ * sizeof(mat4);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, palette_buffer_id_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, palettes_size, nullptr, GL_STREAM_DRAW);    // orphan last frame's data
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, palettes_size, palettes);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, color_buffer_id_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, joint_count_ * sizeof(color4), colors);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visible_buffer_id_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, visible_count_ * sizeof(GLuint), visible_instances);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mesh_.vbo_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, palette_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, color_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visible_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, skinned_buffer_id_);
+
+    GLuint vertex_count = GLuint(mesh_.getVertexCount());
+    GLuint work_count = GLuint((visible_count_ - cpu_count_) * vertex_count);
+    if (work_count > 0)
+    {
+        glUseProgram(compute_program_id);
+        glUniform1ui(glGetUniformLocation(compute_program_id, "vertex_count"), vertex_count);
+        glUniform1ui(glGetUniformLocation(compute_program_id, "work_count"), work_count);
+        glDispatchCompute((work_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        glUseProgram(0);
+    }
+    if (cpu_count_ == 0)
+        return;
+
+    // the GPU gets on with its share while the pool skins the rest, a
+    // block of each instance's vertices per task, the same as CpuSkinner.
+    double start = getTimeMilliseconds();
+    size_t first_slot = visible_count_ - cpu_count_;
+    size_t blocks_per_instance = (vertex_count + CpuSkinner::BLOCK_SIZE - 1) / CpuSkinner::BLOCK_SIZE;
+    cpu_skinned_.resize(cpu_count_ * vertex_count);
+    thread_pool_->parallelFor(cpu_count_ * blocks_per_instance, [&](size_t task)
+    {
+        size_t slot = task / blocks_per_instance;
+        size_t begin = (task % blocks_per_instance) * CpuSkinner::BLOCK_SIZE;
+        size_t count = std::min(size_t(CpuSkinner::BLOCK_SIZE), vertex_count - begin);
+        const mat4* palette = palettes + visible_instances[first_slot + slot] * joint_count_;
+        skinVerticesBatched(&cpu_vertices_[begin], count, palette, colors,
+                            &cpu_skinned_[slot * vertex_count + begin]);
+    });
+
+    // the dispatch never writes these slots, so the upload doesn't wait for it.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, skinned_buffer_id_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    GLintptr(first_slot * vertex_count * sizeof(CpuSkinner::SkinnedVertex)),
+                    GLsizeiptr(cpu_skinned_.size() * sizeof(CpuSkinner::SkinnedVertex)), cpu_skinned_.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    cpu_milliseconds_ = getTimeMilliseconds() - start;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws the instances skinned by the last call to skin().
+///
+/// \param  draw_program_id A program whose vertex shader reads its vertices
+///         from shader storage binding 4, at
+///         gl_InstanceID * vertex_count + gl_VertexID.
+/// \param  view_count How many times to draw each instance, as for the
+///         cascades of a ShadowPass; the program's instance is then
+///         gl_InstanceID / view_count.
+void ComputeSkinner::draw(GLuint draw_program_id, GLsizei view_count) const
+{
+    if (visible_count_ == 0)
+        return;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, skinned_buffer_id_);
+
+    glUseProgram(draw_program_id);
+    glUniform1ui(glGetUniformLocation(draw_program_id, "vertex_count"), GLuint(mesh_.getVertexCount()));
+
+    // the mesh's VAO supplies the indices; its attributes aren't used.
+    glBindVertexArray(mesh_.vao_id);
+    glDrawElementsInstanced(GL_TRIANGLES, GLsizei(mesh_.getIndexCount()), mesh_.getIndexType(), 0, GLsizei(visible_count_) * view_count);
+    glBindVertexArray(0);
+
+    glUseProgram(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gives the skinner the mesh's vertices, so that skin() can skin
+///         some of the instances on the CPU.
+///
+/// \param  thread_pool The threads to skin them across, which must outlive
+///         the skinner; null, or no vertices, to skin every instance on the
+///         GPU again.
+/// \param  vertices The mesh's vertices in the order they were uploaded,
+///         with their influences sorted as the upload sorted them, so that
+///         they match what the compute shader reads.
+void ComputeSkinner::setCpuVertices(ThreadPool* thread_pool, std::vector<Vertex>&& vertices)
+{
+    thread_pool_ = thread_pool;
+    cpu_vertices_ = std::move(vertices);
+    cpu_skinned_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if skin() can skin instances on the CPU: it has a
+///         vertex for every one the mesh uploaded.
+bool ComputeSkinner::canSkinOnCpu() const
+{
+    return thread_pool_ != nullptr && !cpu_vertices_.empty() && cpu_vertices_.size() == mesh_.getVertexCount();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the storage buffer skin() reads the palettes from,
+///         max_instances palettes of joint_count matrices each.
+GLuint ComputeSkinner::getPaletteBuffer() const
+{
+    return palette_buffer_id_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the storage buffer holding the vertices skinned by the
+///         last call to skin(), in the camera's clip space.
+GLuint ComputeSkinner::getSkinnedBuffer() const
+{
+    return skinned_buffer_id_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of vertices skinned by the last call to
+///         skin(): the mesh's vertices times the visible instances.
+size_t ComputeSkinner::getSkinnedVertexCount() const
+{
+    return visible_count_ * mesh_.getVertexCount();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of instances the last call to skin() skinned,
+///         on the GPU and the CPU together.
+size_t ComputeSkinner::getVisibleCount() const
+{
+    return visible_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of instances the last call to skin() skinned
+///         on the CPU.
+size_t ComputeSkinner::getCpuCount() const
+{
+    return cpu_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how long the last call to skin() spent skinning and
+///         uploading the CPU's instances, in milliseconds.
+double ComputeSkinner::getCpuMilliseconds() const
+{
+    return cpu_milliseconds_;
+}
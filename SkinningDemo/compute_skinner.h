@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  compute_skinner.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the ComputeSkinner class.
+
+#ifndef COMPUTE_SKINNER_H_
+#define COMPUTE_SKINNER_H_
+
+#include "cpu_skinner.h"
+#include "skeletal_mesh.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins many instances of a SkeletalMesh with a compute shader
+///         (GL 4.3), instead of in the vertex shader of each draw.
+///
+/// \details skin() uploads every instance's palette, plus the list of
+///         instances which are actually visible, then runs a single dispatch
+///         over the vertices of all of the visible instances.  Instances
+///         which were culled aren't skinned at all.  The skinned vertices are
+///         written to a shader storage buffer, which draw() reads with a
+///         vertex-pulling shader, drawing every visible instance in a single
+///         instanced draw call.
+///
+///         The compute shader reads the mesh's VBO directly as a storage
+///         buffer, so it must be compiled for the mesh's vertex format.  The
+///         shader storage binding points used are:
+///
+///         - 0: the mesh's vertices
+///         - 1: the palettes, N_JOINTS matrices per instance
+///         - 2: the joint colors, shared by all instances
+///         - 3: the indices of the visible instances
+///         - 4: the skinned vertices (a vec4 position and a vec4 color each)
+///
+///         Given the mesh's vertices in the VBO's order, with
+///         setCpuVertices(), the last of the visible instances can be
+///         skinned on the CPU instead, across a ThreadPool with
+///         skinVerticesBatched() while the GPU runs the dispatch for the
+///         rest, and uploaded into their places in the same buffer, so
+///         draw() draws them all the same.
+class ComputeSkinner
+{
+public:
+    static const GLuint WORKGROUP_SIZE = 64;    ///< Must match the compute shader's local_size_x.
+
+    ComputeSkinner(const SkeletalMesh& mesh, size_t joint_count, size_t max_instances);
+    ~ComputeSkinner();
+
+    void skin(GLuint compute_program_id,
+              const mat4* palettes,
+              const color4* colors,
+              const GLuint* visible_instances,
+              size_t visible_count,
+              size_t cpu_count = 0);
+
+    void draw(GLuint draw_program_id, GLsizei view_count = 1) const;
+
+    void setCpuVertices(ThreadPool* thread_pool, std::vector<Vertex>&& vertices);
+    bool canSkinOnCpu() const;
+
+    GLuint getPaletteBuffer() const;
+    GLuint getSkinnedBuffer() const;
+    size_t getSkinnedVertexCount() const;
+    size_t getVisibleCount() const;
+    size_t getCpuCount() const;
+    double getCpuMilliseconds() const;
+
+private:
+    ComputeSkinner(const ComputeSkinner&);              // non-copyable
+    ComputeSkinner& operator=(const ComputeSkinner&);   // non-copyable
+
+    const SkeletalMesh& mesh_;
+    size_t joint_count_;
+    size_t max_instances_;
+    size_t visible_count_;
+    size_t cpu_count_;                  ///< How many of the last visible instances were skinned on the CPU.
+    double cpu_milliseconds_;           ///< How long skinning them took, uploading included.
+
+    ThreadPool* thread_pool_;           ///< Skins the CPU's instances; null if there are no cpu_vertices_.
+    std::vector<Vertex> cpu_vertices_;  ///< The mesh's vertices in the VBO's order, with their influences sorted.
+    std::vector<CpuSkinner::SkinnedVertex> cpu_skinned_;    ///< The CPU's instances' vertices, before they're uploaded.
+
+    GLuint palette_buffer_id_;
+    GLuint color_buffer_id_;
+    GLuint visible_buffer_id_;
+    GLuint skinned_buffer_id_;
+};
+
+#endif
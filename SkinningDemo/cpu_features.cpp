@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  cpu_features.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the CPU feature detection functions.
+
+#include "cpu_features.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_FEATURES_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+const char* const SIMD_LEVEL_NAMES[N_SIMD_LEVELS] = { "scalar", "sse2", "avx2", "avx512", "neon" };
+
+#ifdef CPU_FEATURES_X86
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs CPUID for a leaf and subleaf.
+///
+/// \param  registers Receives eax, ebx, ecx and edx, in that order.
+void queryCpuid(unsigned leaf, unsigned subleaf, unsigned registers[4])
+{
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, int(leaf), int(subleaf));
+    for (size_t i = 0; i < 4; ++i)
+        registers[i] = unsigned(values[i]);
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the low word of XCR0, the register state the OS saves on
+///         context switches.  Only valid if CPUID reports OSXSAVE.
+unsigned queryEnabledRegisterState()
+{
+#ifdef _MSC_VER
+    return unsigned(_xgetbv(0));
+#else
+    unsigned eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return eax;
+#endif
+}
+#endif
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the most capable SIMD level the CPU and OS support.
+///
+/// \details The AVX levels need the OS to save the wider registers as well
+///         as the CPU to have the instructions, which CPUID's OSXSAVE bit
+///         and XCR0 report.  ARM builds report NEON if they were compiled
+///         for it, since it's part of the baseline on AArch64; ARMv7 builds
+///         without it stay scalar.  This queries the CPU on every call, so
+///         that it can be used while globals are being initialized.
+SimdLevel detectSimdLevel()
+{
+#if defined(CPU_FEATURES_X86)
+    unsigned features[4];
+    queryCpuid(0, 0, features);
+    unsigned max_leaf = features[0];
+
+    queryCpuid(1, 0, features);
+    bool sse2 = (features[3] & (1u << 26)) != 0;
+    bool fma = (features[2] & (1u << 12)) != 0;
+    bool osxsave = (features[2] & (1u << 27)) != 0;
+    bool avx = (features[2] & (1u << 28)) != 0;
+    if (!sse2)
+        return SIMD_LEVEL_SCALAR;
+    if (!osxsave || !avx || !fma || max_leaf < 7)
+        return SIMD_LEVEL_SSE2;
+
+    // XMM and YMM state; then opmask, and the upper halves of ZMM0-15 and
+    // all of ZMM16-31.
+    unsigned register_state = queryEnabledRegisterState();
+    if ((register_state & 0x06) != 0x06)
+        return SIMD_LEVEL_SSE2;
+
+    queryCpuid(7, 0, features);
+    bool avx2 = (features[1] & (1u << 5)) != 0;
+    bool avx512f = (features[1] & (1u << 16)) != 0;
+    if (!avx2)
+        return SIMD_LEVEL_SSE2;
+    if (!avx512f || (register_state & 0xe6) != 0xe6)
+        return SIMD_LEVEL_AVX2;
+    return SIMD_LEVEL_AVX512;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+    return SIMD_LEVEL_NEON;
+#else
+    return SIMD_LEVEL_SCALAR;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if code built for a SIMD level can run here.
+bool isSimdLevelSupported(SimdLevel level)
+{
+    SimdLevel detected = detectSimdLevel();
+    if (level == SIMD_LEVEL_SCALAR)
+        return true;
+    if (level == SIMD_LEVEL_NEON || detected == SIMD_LEVEL_NEON)
+        return level == detected;
+    return level <= detected;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a SIMD level's name, e.g. "avx2", for command lines and
+///         reports.
+const char* getSimdLevelName(SimdLevel level)
+{
+    if (level >= N_SIMD_LEVELS)
+        return "unknown";
+    return SIMD_LEVEL_NAMES[level];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the SIMD level with a name, as from getSimdLevelName().
+///
+/// \return false if no level has the name.
+bool parseSimdLevel(const std::string& name, SimdLevel& level)
+{
+    for (size_t i = 0; i < N_SIMD_LEVELS; ++i)
+    {
+        if (name == SIMD_LEVEL_NAMES[i])
+        {
+            level = SimdLevel(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,38 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  cpu_features.h
+/// \author Ben Crist
+///
+/// \brief  Functions for finding out which SIMD instruction sets the CPU
+///         the program is running on supports.
+
+#ifndef CPU_FEATURES_H_
+#define CPU_FEATURES_H_
+
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The SIMD instruction sets kernels can be built for, from least
+///         to most capable on each architecture.
+///
+/// \details The x86 levels each include the ones before them: AVX2 implies
+///         FMA, and AVX-512 means AVX-512F on top of AVX2.  NEON is the ARM
+///         level, and is only ever detected on ARM builds, where none of the
+///         x86 levels are.
+enum SimdLevel
+{
+    SIMD_LEVEL_SCALAR = 0,
+    SIMD_LEVEL_SSE2,
+    SIMD_LEVEL_AVX2,
+    SIMD_LEVEL_AVX512,
+    SIMD_LEVEL_NEON,
+    N_SIMD_LEVELS
+};
+
+SimdLevel detectSimdLevel();
+bool isSimdLevelSupported(SimdLevel level);
+
+const char* getSimdLevelName(SimdLevel level);
+bool parseSimdLevel(const std::string& name, SimdLevel& level);
+
+#endif
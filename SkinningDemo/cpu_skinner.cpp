@@ -0,0 +1,422 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  cpu_skinner.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of CpuSkinner class functions.
+
+#include "cpu_skinner.h"
+#include "skinning_kernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of representable floats between a and b.
+int getUlpDistance(float a, float b)
+{
+    if (a == b)
+        return 0;
+
+    // map the floats onto a monotonic integer line, so that -0 and +0 meet.
+    int ia, ib;
+    std::memcpy(&ia, &a, sizeof(float));
+    std::memcpy(&ib, &b, sizeof(float));
+    if (ia < 0)
+        ia = int(0x80000000u - unsigned(ia));
+    if (ib < 0)
+        ib = int(0x80000000u - unsigned(ib));
+
+    long long distance = (long long)ia - (long long)ib;
+    return int(std::min(distance < 0 ? -distance : distance, (long long)INT_MAX));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the joint with the most weight in a vertex; the first of
+///         them, if several tie.
+GLuint getDominantJoint(const Vertex& vertex)
+{
+    size_t dominant = 0;
+    for (size_t i = 1; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        if (vertex.joint_weights[i] > vertex.joint_weights[dominant])
+            dominant = i;
+    }
+    return vertex.joint_indices[dominant];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sorts vertices by their dominant joint, and remaps the indices
+///         of their triangles to match.
+///
+/// \details It's a counting sort, so the vertices of each joint keep the
+///         order they were authored in, and their neighbors stay close by.
+///         Consecutive vertices then mostly read the same few palette
+///         entries, which stay in the L1 cache however many joints the
+///         skeleton has; in authored order, a big rig's vertices jump
+///         around the whole palette.
+///
+/// \param  vertices The vertices to sort.
+/// \param  indices The indices of the vertices' triangles.
+/// \param  clustered Receives the sorted vertices.
+/// \param  clustered_indices Receives the indices, pointing into clustered.
+void clusterByDominantJoint(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                            std::vector<Vertex>& clustered, std::vector<GLuint>& clustered_indices)
+{
+    std::vector<GLuint> dominant_joints(vertices.size());
+    GLuint joint_count = 0;
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        dominant_joints[v] = getDominantJoint(vertices[v]);
+        joint_count = std::max(joint_count, dominant_joints[v] + 1);
+    }
+
+    // each joint's first slot is the number of vertices of the joints before it.
+    std::vector<size_t> next_slot(joint_count + 1, 0);
+    for (size_t v = 0; v < vertices.size(); ++v)
+        ++next_slot[dominant_joints[v] + 1];
+    for (size_t joint = 1; joint <= joint_count; ++joint)
+        next_slot[joint] += next_slot[joint - 1];
+
+    std::vector<GLuint> new_vertex_index(vertices.size());
+    clustered.resize(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        size_t slot = next_slot[dominant_joints[v]]++;
+        new_vertex_index[v] = GLuint(slot);
+        clustered[slot] = vertices[v];
+    }
+
+    clustered_indices.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+        clustered_indices[i] = new_vertex_index[indices[i]];
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the streaming VBO for a mesh's skinned vertices, and a VAO
+///         and IBO for drawing them.
+///
+/// \param  mesh The mesh to skin.  It must outlive the skinner, and its
+///         vertices and indices must not change.
+/// \param  thread_pool The threads to skin the vertices with.  It must
+///         outlive the skinner.
+/// \param  order The order to skin the vertices in.  Clustering them costs a
+///         copy of the vertices, and only pays off for big skeletons.
+CpuSkinner::CpuSkinner(const SkeletalMesh& mesh, ThreadPool& thread_pool, VertexOrder order)
+    : mesh_(mesh),
+      thread_pool_(thread_pool),
+      vertices_(mesh.vertices.data()),
+      mapped_vertices_(nullptr),
+      vao_id_(0),
+      vbo_id_(0),
+      ibo_id_(0),
+      index_type_(chooseIndexType(mesh.vertices.size()))
+{
+    glGenVertexArrays(1, &vao_id_);
+    glGenBuffers(1, &vbo_id_);
+    glGenBuffers(1, &ibo_id_);
+
+    glBindVertexArray(vao_id_);
+
+    const std::vector<GLuint>* indices = &mesh.indices;
+    std::vector<GLuint> clustered_indices;
+    if (order == VERTEX_ORDER_JOINT_CLUSTERED)
+    {
+        clusterByDominantJoint(mesh.vertices, mesh.indices, clustered_vertices_, clustered_indices);
+        vertices_ = clustered_vertices_.data();
+        indices = &clustered_indices;
+    }
+
+    std::vector<char> index_data;
+    packIndices(indices->data(), indices->size(), index_type_, index_data);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_id_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_data.size(), index_data.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(SkinnedVertex), nullptr, GL_STREAM_DRAW);
+
+    void* position = reinterpret_cast<void*>(offsetof(SkinnedVertex, position));
+    void* color = reinterpret_cast<void*>(offsetof(SkinnedVertex, color));
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), position);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), color);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the skinner's VAO and buffers.
+CpuSkinner::~CpuSkinner()
+{
+    glDeleteVertexArrays(1, &vao_id_);
+    glDeleteBuffers(1, &vbo_id_);
+    glDeleteBuffers(1, &ibo_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins all of the mesh's vertices into the VBO.
+///
+/// \details The VBO is orphaned and mapped for writing, so the driver can
+///         hand back fresh memory rather than waiting for last frame's draw,
+///         and the thread pool's tasks write their blocks straight into it.
+///
+/// \param  palette The precombined skinning palette (see
+///         computeSkinningPalette()), one matrix per joint.
+/// \param  colors The color of each joint.
+void CpuSkinner::skin(const mat4* palette, const color4* colors)
+{
+    if (mesh_.vertices.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    GLsizeiptr size = mesh_.vertices.size() * sizeof(SkinnedVertex);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);   // orphan last frame's data
+    void* data = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (data == nullptr)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        std::cerr << "Failed to map CPU skinning buffer " << vbo_id_ << "!" << std::endl;
+        throw std::runtime_error("Failed to map CPU skinning buffer!");
+    }
+
+    mapped_vertices_ = static_cast<SkinnedVertex*>(data);
+    size_t block_count = (mesh_.vertices.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    block_bounds_.resize(block_count);
+    thread_pool_.parallelFor(block_count, [=](size_t block) { skinBlock(block, palette, colors); });
+    mapped_vertices_ = nullptr;
+
+    bounds_ = BoundingBox();
+    for (size_t block = 0; block < block_count; ++block)
+        bounds_.expand(block_bounds_[block]);
+
+    // GL_FALSE means the contents were lost (on a display mode change, say);
+    // the next frame rewrites them anyway.
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws the mesh's triangles using the vertices from the last call
+///         to skin(), with the current shader program.
+///
+/// \param  instance_count How many times to draw them, as one instanced
+///         draw; ShadowPass draws once per cascade.
+void CpuSkinner::draw(GLsizei instance_count) const
+{
+    glBindVertexArray(vao_id_);
+    glDrawElementsInstanced(GL_TRIANGLES, GLsizei(mesh_.indices.size()), index_type_, nullptr, instance_count);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the bounds of the vertices from the last call to skin(),
+///         in world space.
+const BoundingBox& CpuSkinner::getBounds() const
+{
+    return bounds_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins one block of BLOCK_SIZE vertices into the mapped VBO;
+///         called by the thread pool.
+///
+/// \param  block The index of the block.  The last block may be partial.
+/// \param  palette The skinning palette.
+/// \param  colors The color of each joint.
+void CpuSkinner::skinBlock(size_t block, const mat4* palette, const color4* colors)
+{
+    size_t first = block * BLOCK_SIZE;
+    size_t count = std::min(BLOCK_SIZE, mesh_.vertices.size() - first);
+
+    SkinnedVertex skinned[BLOCK_SIZE];
+    skinVerticesBatched(vertices_ + first, count, palette, colors, skinned);
+    streamSkinnedVertices(skinned, count, mapped_vertices_ + first);
+    block_bounds_[block] = computeVertexBounds(skinned, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins vertices one at a time with glm.
+///
+/// \details This is the reference implementation that skinVerticesBatched()
+///         is checked against; it's deliberately the same math as the
+///         skinning vertex shader.
+///
+/// \param  vertices The vertices to skin.
+/// \param  count The number of vertices.
+/// \param  palette The precombined skinning palette.
+/// \param  colors The color of each joint.
+/// \param  skinned Receives count skinned vertices.
+void skinVerticesReference(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                           CpuSkinner::SkinnedVertex* skinned)
+{
+    for (size_t v = 0; v < count; ++v)
+    {
+        const Vertex& vertex = vertices[v];
+        vec4 coords(vertex.position, 0, 1);
+        vec4 position(0);
+        color4 color(0);
+
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            float weight = vertex.joint_weights[i];
+            if (weight == 0.0f)
+                continue;
+
+            position += weight * (palette[vertex.joint_indices[i]] * coords);
+            color += weight * colors[vertex.joint_indices[i]];
+        }
+
+        skinned[v].position = position;
+        skinned[v].color = color;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies skinned vertices into a mapped buffer with non-temporal
+///         stores.
+///
+/// \details As with streamTransformedPalette(), a mapped buffer is usually
+///         write-combined memory, which only takes writes at full speed when
+///         whole lines are filled in at once, and stalls if it's read.  Each
+///         pair of vertices is one 64-byte line, written with four
+///         _mm_stream_ps() stores in a row, which also keep the vertices out
+///         of the cache when the destination is ordinary memory.  The stores
+///         are fenced before returning, since another thread may unmap the
+///         buffer.  If the destination isn't 16-byte aligned, or there's no
+///         SSE2, the vertices are just copied.
+///
+/// \param  skinned The vertices to copy.
+/// \param  count The number of vertices.
+/// \param  destination Receives count vertices; must not overlap skinned,
+///         and is never read.
+void streamSkinnedVertices(const CpuSkinner::SkinnedVertex* skinned, size_t count,
+                           CpuSkinner::SkinnedVertex* destination)
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    if ((reinterpret_cast<size_t>(destination) & 15) == 0)
+    {
+        for (size_t v = 0; v < count; ++v)
+        {
+            _mm_stream_ps(&destination[v].position.x, _mm_loadu_ps(&skinned[v].position.x));
+            _mm_stream_ps(&destination[v].color.r, _mm_loadu_ps(&skinned[v].color.r));
+        }
+        _mm_sfence();
+        return;
+    }
+#endif
+
+    std::copy(skinned, skinned + count, destination);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the exact bounds of a run of skinned vertices.
+///
+/// \details With SSE2, the x and y of two vertices are packed into one
+///         register, so each min and max covers a pair of them; the two
+///         halves are folded together at the end.  Meant to be run while the
+///         vertices are still in the cache, as skinBlock() does.
+///
+/// \param  skinned The vertices, whose positions have a w of 1.
+/// \param  count The number of vertices.
+/// \return Their bounds; an empty box if count is 0.
+BoundingBox computeVertexBounds(const CpuSkinner::SkinnedVertex* skinned, size_t count)
+{
+    BoundingBox bounds;
+    size_t v = 0;
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    if (count >= 2)
+    {
+        __m128 lo = _mm_set1_ps(FLT_MAX);
+        __m128 hi = _mm_set1_ps(-FLT_MAX);
+        for (; v + 1 < count; v += 2)
+        {
+            __m128 xy = _mm_movelh_ps(_mm_loadu_ps(&skinned[v].position.x), _mm_loadu_ps(&skinned[v + 1].position.x));
+            lo = _mm_min_ps(lo, xy);
+            hi = _mm_max_ps(hi, xy);
+        }
+        lo = _mm_min_ps(lo, _mm_movehl_ps(lo, lo));
+        hi = _mm_max_ps(hi, _mm_movehl_ps(hi, hi));
+
+        ALIGN16 float lanes[8];
+        _mm_store_ps(lanes, lo);
+        _mm_store_ps(lanes + 4, hi);
+        bounds.min = vec2(lanes[0], lanes[1]);
+        bounds.max = vec2(lanes[4], lanes[5]);
+    }
+#endif
+
+    for (; v < count; ++v)
+        bounds.expand(vec2(skinned[v].position));
+    return bounds;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins a set of vertices with every batched kernel this CPU can
+///         run (see getSkinningKernel()) and with skinVerticesReference(),
+///         and checks that they agree.
+///
+/// \details They don't round identically (the batched kernels sum the
+///         matrix columns in a different order, and may use FMA), so each
+///         component is compared to within max_ulps.  Components which
+///         cancel out to nearly 0 can differ by many ULPs while being equally
+///         accurate, so differences within max_ulps ULPs of 1.0 (the scale of
+///         the mesh's coordinates and colors) are accepted too.
+///         The first mismatch is reported to cerr.
+///
+/// \param  vertices The vertices to skin.
+/// \param  palette The precombined skinning palette.
+/// \param  colors The color of each joint.
+/// \param  max_ulps The largest acceptable difference, in ULPs.
+/// \return true if every component of every vertex agreed.
+bool verifySkinningKernels(const std::vector<Vertex>& vertices, const mat4* palette, const color4* colors,
+                           int max_ulps)
+{
+    const float absolute_tolerance = max_ulps * FLT_EPSILON;
+
+    std::vector<CpuSkinner::SkinnedVertex> reference(vertices.size());
+    std::vector<CpuSkinner::SkinnedVertex> batched(vertices.size());
+    if (vertices.empty())
+        return true;
+
+    skinVerticesReference(vertices.data(), vertices.size(), palette, colors, reference.data());
+
+    for (size_t level = SIMD_LEVEL_SCALAR + 1; level < N_SIMD_LEVELS; ++level)
+    {
+        SkinningKernel kernel = getSkinningKernel(SimdLevel(level));
+        if (!kernel || !isSimdLevelSupported(SimdLevel(level)))
+            continue;
+
+        kernel(vertices.data(), vertices.size(), palette, colors, batched.data());
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            const float* expected = &reference[v].position.x;
+            const float* actual = &batched[v].position.x;
+            for (size_t i = 0; i < 8; ++i)
+            {
+                if (std::abs(expected[i] - actual[i]) <= absolute_tolerance || getUlpDistance(expected[i], actual[i]) <= max_ulps)
+                    continue;
+
+                std::cerr << "Batched skinning kernel (" << getSimdLevelName(SimdLevel(level)) << ") mismatch at vertex "
+                          << v << ", component " << i << ": expected " << expected[i] << ", got " << actual[i]
+                          << " (" << getUlpDistance(expected[i], actual[i]) << " ULPs)" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
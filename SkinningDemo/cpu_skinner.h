@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  cpu_skinner.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the CpuSkinner class.
+
+#ifndef CPU_SKINNER_H_
+#define CPU_SKINNER_H_
+
+#include "joint_bounds.h"
+#include "skeletal_mesh.h"
+#include "thread_pool.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins a SkeletalMesh on the CPU, for hardware (or headless
+///         renderers) which can't run the skinning shaders.
+///
+/// \details skin() evaluates the mesh's vertices, in blocks of BLOCK_SIZE,
+///         across all of a ThreadPool's threads, using skinVerticesBatched().
+///         Each block is skinned into a scratch buffer small enough that
+///         the block's source and skinned vertices stay in the L1 cache,
+///         then streamed straight into the mapped VBO with
+///         streamSkinnedVertices(), so the vertices are never copied again
+///         or pushed through the cache on the way to the GPU.  The
+///         skinned vertices have the same layout as
+///         SkinnedVertexCache::SkinnedVertex, so draw() can use the same
+///         pass-through shader: location 0 is the position and 1 the color.
+///
+///         The skinned vertices are read from mesh.vertices, so they're
+///         drawn with the mesh's original indices rather than its IBO, whose
+///         vertices have been reordered into partitions.  They can be
+///         skinned in the order they were authored in, or clustered by
+///         their dominant joint (see VertexOrder), with the skinner's own
+///         IBO remapped to match.
+///
+///         While each block is still in the cache, its bounds are found with
+///         computeVertexBounds(), and getBounds() gives the union: the
+///         mesh's exact bounds in its current pose, at almost no cost.
+class CpuSkinner
+{
+public:
+    static const size_t BLOCK_SIZE = 256;   ///< The number of vertices skinned by each task.
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Identifies the orders the skinner can skin the vertices in.
+    enum VertexOrder
+    {
+        VERTEX_ORDER_AUTHORED = 0,      ///< mesh.vertices' own order.
+        VERTEX_ORDER_JOINT_CLUSTERED    ///< Grouped by the joint with the most weight, in joint order.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The layout of each skinned vertex.
+    struct SkinnedVertex
+    {
+        vec4 position;
+        color4 color;
+    };
+
+    CpuSkinner(const SkeletalMesh& mesh, ThreadPool& thread_pool, VertexOrder order = VERTEX_ORDER_AUTHORED);
+    ~CpuSkinner();
+
+    void skin(const mat4* palette, const color4* colors);
+
+    void draw(GLsizei instance_count = 1) const;
+
+    const BoundingBox& getBounds() const;
+
+private:
+    CpuSkinner(const CpuSkinner&);              // non-copyable
+    CpuSkinner& operator=(const CpuSkinner&);   // non-copyable
+
+    void skinBlock(size_t block, const mat4* palette, const color4* colors);
+
+    const SkeletalMesh& mesh_;
+    ThreadPool& thread_pool_;
+    std::vector<Vertex> clustered_vertices_;    ///< mesh.vertices, clustered; empty in VERTEX_ORDER_AUTHORED.
+    const Vertex* vertices_;                    ///< The vertices to skin: mesh.vertices or clustered_vertices_.
+    SkinnedVertex* mapped_vertices_;    ///< The VBO's contents, while skin() has it mapped.
+    std::vector<BoundingBox> block_bounds_;     ///< The bounds of each block's vertices, from skinBlock().
+    BoundingBox bounds_;                        ///< The bounds of all of the vertices.
+
+    GLuint vao_id_;
+    GLuint vbo_id_;
+    GLuint ibo_id_;
+    GLenum index_type_;
+};
+
+void skinVerticesReference(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                           CpuSkinner::SkinnedVertex* skinned);
+void skinVerticesBatched(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                         CpuSkinner::SkinnedVertex* skinned);
+void streamSkinnedVertices(const CpuSkinner::SkinnedVertex* skinned, size_t count,
+                           CpuSkinner::SkinnedVertex* destination);
+BoundingBox computeVertexBounds(const CpuSkinner::SkinnedVertex* skinned, size_t count);
+
+bool verifySkinningKernels(const std::vector<Vertex>& vertices, const mat4* palette, const color4* colors,
+                           int max_ulps);
+
+#endif
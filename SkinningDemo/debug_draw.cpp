@@ -0,0 +1,185 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  debug_draw.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of DebugGeometry and DebugDraw class functions.
+
+#include "debug_draw.h"
+
+#include <algorithm>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Removes all lines and points, to start collecting the next
+///         frame's.
+void DebugGeometry::clear()
+{
+    lines_.clear();
+    points_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a line, with its color interpolated between the two ends.
+void DebugGeometry::addLine(const vec4& a, const color4& a_color, const vec4& b, const color4& b_color)
+{
+    Vertex v;
+    v.position = a;
+    v.color = a_color;
+    lines_.push_back(v);
+
+    v.position = b;
+    v.color = b_color;
+    lines_.push_back(v);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a point, drawn at the current glPointSize().
+void DebugGeometry::addPoint(const vec4& position, const color4& color)
+{
+    Vertex v;
+    v.position = position;
+    v.color = color;
+    points_.push_back(v);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds the bones, local axes and joint positions of a posed
+///         skeleton.
+///
+/// \details Each joint gets a point in its pose color, a red line along its
+///         local x axis and a green line along its local y axis.  Each bone
+///         is drawn as a thin wedge from its parent's position to the
+///         joint, blending from the parent's color to the joint's.
+///
+///         Everything is computed from the model-space transforms that were
+///         already found for skinning: a joint's position is its transform's
+///         translation, and its axes are the transform's first two columns.
+///         The parent's position is read directly from the parent's
+///         transform, so no matrices need to be inverted.
+///
+/// \param  skeleton The skeleton the pose is applied to.
+/// \param  pose The pose, which provides the joint colors.
+/// \param  joint_transforms The model-space transform of each joint, as
+///         computed by Skeleton::computeJointTransforms().
+void DebugGeometry::addSkeleton(const Skeleton& skeleton, const Pose& pose, const mat4* joint_transforms)
+{
+    const float AXIS_LENGTH = 0.1f;
+    const float BONE_HALF_WIDTH = 0.05f;
+
+    size_t joint_count = skeleton.getJointCount();
+    lines_.reserve(lines_.size() + joint_count * 8);
+    points_.reserve(points_.size() + joint_count);
+
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        const mat4& transform = joint_transforms[joint];
+        vec4 position = transform[3];
+        int parent = skeleton.getParent(joint);
+
+        if (parent != Skeleton::NO_PARENT)
+        {
+            vec4 parent_position = joint_transforms[parent][3];
+            vec2 bone = vec2(parent_position - position);
+
+            if (bone.x != 0 || bone.y != 0)
+            {
+                // The wedge's width is in the joint's local units, so it
+                // scales with the joint.  Joint transforms only rotate and
+                // uniformly scale, so the length of the x axis is the scale.
+                float width = BONE_HALF_WIDTH * glm::length(vec2(transform[0]));
+                vec2 tangent = glm::normalize(vec2(bone.y, -bone.x)) * width;
+                vec4 parent_0 = parent_position + vec4(tangent, 0, 0);
+                vec4 parent_1 = parent_position - vec4(tangent, 0, 0);
+
+                addLine(parent_0, pose.color[parent], position, pose.color[joint]);
+                addLine(position, pose.color[joint], parent_1, pose.color[parent]);
+            }
+        }
+
+        addLine(position, color4(1, 0, 0, 1), position + transform[0] * AXIS_LENGTH, color4(1, 0, 0, 1));
+        addLine(position, color4(0, 1, 0, 1), position + transform[1] * AXIS_LENGTH, color4(0, 1, 0, 1));
+        addPoint(position, pose.color[joint]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the vertices of the lines, two per line.
+const std::vector<DebugGeometry::Vertex>& DebugGeometry::getLines() const
+{
+    return lines_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the vertices of the points.
+const std::vector<DebugGeometry::Vertex>& DebugGeometry::getPoints() const
+{
+    return points_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the VAO and (initially empty) streaming vertex buffer.
+DebugDraw::DebugDraw()
+    : vao_id_(0),
+      vbo_id_(0),
+      vbo_size_(0)
+{
+    glGenVertexArrays(1, &vao_id_);
+    glGenBuffers(1, &vbo_id_);
+
+    glBindVertexArray(vao_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+
+    void* position = reinterpret_cast<void*>(offsetof(DebugGeometry::Vertex, position));
+    void* color = reinterpret_cast<void*>(offsetof(DebugGeometry::Vertex, color));
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(DebugGeometry::Vertex), position);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(DebugGeometry::Vertex), color);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the VAO and vertex buffer.
+DebugDraw::~DebugDraw()
+{
+    glDeleteVertexArrays(1, &vao_id_);
+    glDeleteBuffers(1, &vbo_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads and draws all of a geometry's lines, then all of its
+///         points.
+///
+/// \details The caller is responsible for binding a program which reads
+///         the position and color attributes.
+void DebugDraw::draw(const DebugGeometry& geometry)
+{
+    typedef DebugGeometry::Vertex Vertex;
+    const std::vector<Vertex>& lines = geometry.getLines();
+    const std::vector<Vertex>& points = geometry.getPoints();
+
+    size_t vertex_count = lines.size() + points.size();
+    if (vertex_count == 0)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    vbo_size_ = std::max(vbo_size_, vertex_count);
+    glBufferData(GL_ARRAY_BUFFER, vbo_size_ * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+    if (!lines.empty())
+        glBufferSubData(GL_ARRAY_BUFFER, 0, lines.size() * sizeof(Vertex), lines.data());
+    if (!points.empty())
+        glBufferSubData(GL_ARRAY_BUFFER, lines.size() * sizeof(Vertex), points.size() * sizeof(Vertex), points.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(vao_id_);
+    if (!lines.empty())
+        glDrawArrays(GL_LINES, 0, GLsizei(lines.size()));
+    if (!points.empty())
+        glDrawArrays(GL_POINTS, GLsizei(lines.size()), GLsizei(points.size()));
+    glBindVertexArray(0);
+}
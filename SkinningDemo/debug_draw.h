@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  debug_draw.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the DebugGeometry and DebugDraw classes.
+
+#ifndef DEBUG_DRAW_H_
+#define DEBUG_DRAW_H_
+
+#include "skeleton.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects colored lines and points on the CPU, for a DebugDraw
+///         to draw.
+///
+/// \details The vertices are in the same layout as
+///         SkinnedVertexCache::SkinnedVertex (a vec4 position at location 0
+///         and a vec4 color at location 1), so they can be drawn with the
+///         same passthrough program.  Positions are given in world space.
+///
+///         Collecting doesn't touch OpenGL, so the geometry can be built on
+///         any thread and handed to the one which draws it.
+class DebugGeometry
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The layout of each vertex in the debug vertex buffer.
+    struct Vertex
+    {
+        vec4 position;
+        color4 color;
+    };
+
+    void clear();
+    void addLine(const vec4& a, const color4& a_color, const vec4& b, const color4& b_color);
+    void addPoint(const vec4& position, const color4& color);
+    void addSkeleton(const Skeleton& skeleton, const Pose& pose, const mat4* joint_transforms);
+
+    const std::vector<Vertex>& getLines() const;
+    const std::vector<Vertex>& getPoints() const;
+
+private:
+    std::vector<Vertex> lines_;     ///< Two vertices per line.
+    std::vector<Vertex> points_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws a DebugGeometry's lines and points with one buffer upload
+///         and two draw calls.
+///
+/// \details Each draw() orphans the buffer before uploading, so the driver
+///         never has to wait for the previous frame's lines to be drawn.
+class DebugDraw
+{
+public:
+    DebugDraw();
+    ~DebugDraw();
+
+    void draw(const DebugGeometry& geometry);
+
+private:
+    DebugDraw(const DebugDraw&);            // non-copyable
+    DebugDraw& operator=(const DebugDraw&); // non-copyable
+
+    GLuint vao_id_;
+    GLuint vbo_id_;
+    size_t vbo_size_;               ///< The number of vertices vbo_id_ has room for.
+};
+
+#endif
@@ -5,8 +5,11 @@
 ///
 /// \brief  Standard header for Skeletal Mesh Skinning Demo.
 ///
-/// \details Includes GLEW and freeglut, and creates global aliases of the
-///         GLM data types we'll be needing to work with.
+/// \details Includes GLEW, and creates global aliases of the GLM data types
+///         we'll be needing to work with.  Nothing but the demo's and the
+///         benchmark's main.cpp uses freeglut, so they include it
+///         themselves, and the rest of the engine can be linked without
+///         it.
 
 #ifndef DEMO_H_
 #define DEMO_H_
@@ -14,13 +17,22 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
 #include <GL/glew.h>
-#include <GL/freeglut.h>
 
 // OpenGL Mathematics library
 // Provides C++ analogs of GLSL vector and matrix data types
 // as well as equivalents for things like gluPerspective().
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Aligns the declaration that follows to a 16-byte boundary, so
+///         that it can be loaded and stored with aligned SIMD instructions.
+#ifdef _MSC_VER
+#define ALIGN16 __declspec(align(16))
+#else
+#define ALIGN16 __attribute__((aligned(16)))
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 // GLM vector & matrix typedefs for convenience.
@@ -28,6 +40,8 @@ typedef glm::vec2 vec2;     ///< 2-component vector of floats
 typedef glm::vec3 vec3;     ///< 3-component vector of floats
 typedef glm::vec4 vec4;     ///< 4-component vector of floats
 typedef glm::vec4 color4;   ///< 4-component vector of floats representing an RGBA color.
+typedef glm::mat3 mat3;     ///< 3x3 matrix of floats
 typedef glm::mat4 mat4;     ///< 4x4 matrix of floats
+typedef glm::quat quat;     ///< Quaternion of floats
 
 #endif
@@ -0,0 +1,342 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  egl_platform.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of EglPlatform class functions.
+
+#ifdef SKINNING_HAVE_EGL
+
+#include "egl_platform.h"
+
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+const double EglPlatform::POLL_MILLISECONDS = 1.0;
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An offscreen pbuffer surface and its context.
+class EglWindow : public PlatformWindow
+{
+public:
+    EglWindow(EGLDisplay display, EGLConfig config, EGLSurface surface, EGLContext context, GLsizei width,
+              GLsizei height);
+    virtual ~EglWindow();
+
+    virtual void makeCurrent();
+    virtual void swapBuffers();
+    virtual bool setSwapInterval(int interval);
+    virtual void resize(GLsizei width, GLsizei height);
+
+    void deliverFirstReshape();
+
+private:
+    EGLDisplay display_;
+    EGLConfig config_;
+    EGLSurface surface_;
+    EGLContext context_;
+    bool first_reshape_pending_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a pbuffer surface of a size.
+///
+/// \return EGL_NO_SURFACE if it couldn't be created.
+EGLSurface createSurface(EGLDisplay display, EGLConfig config, GLsizei width, GLsizei height)
+{
+    const EGLint attributes[] =
+    {
+        EGL_WIDTH, width,
+        EGL_HEIGHT, height,
+        EGL_NONE
+    };
+    return eglCreatePbufferSurface(display, config, attributes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if an EGL extension string has an extension in it.
+bool hasExtension(const char* extensions, const char* name)
+{
+    if (extensions == nullptr)
+        return false;
+
+    size_t length = std::strlen(name);
+    for (const char* start = extensions; (start = std::strstr(start, name)) != nullptr; start += length)
+    {
+        bool starts_word = start == extensions || start[-1] == ' ';
+        bool ends_word = start[length] == ' ' || start[length] == '\0';
+        if (starts_word && ends_word)
+            return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Initializes a display for desktop GL.
+///
+/// \return false if it can't run desktop GL, in which case it's been
+///         terminated.
+bool initDisplay(EGLDisplay display)
+{
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        return false;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        eglTerminate(display);
+        return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds a display for each GPU EGL_EXT_platform_device lists which
+///         can run desktop GL, in the order they're listed.
+///
+/// \details Finds nothing if there's no such extension; some devices, such
+///         as software renderers, only run GLES.
+void getDeviceDisplays(std::vector<EGLDisplay>& displays)
+{
+    const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (!hasExtension(client_extensions, "EGL_EXT_platform_device") ||
+        !hasExtension(client_extensions, "EGL_EXT_device_enumeration"))
+    {
+        return;
+    }
+
+    PFNEGLQUERYDEVICESEXTPROC query_devices =
+        reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (query_devices == nullptr || get_platform_display == nullptr)
+        return;
+
+    EGLint device_count = 0;
+    if (!query_devices(0, nullptr, &device_count) || device_count < 1)
+        return;
+
+    std::vector<EGLDeviceEXT> devices(device_count);
+    if (!query_devices(device_count, devices.data(), &device_count))
+        return;
+
+    for (EGLint i = 0; i < device_count; ++i)
+    {
+        EGLDisplay display = get_platform_display(EGL_PLATFORM_DEVICE_EXT, devices[i], nullptr);
+        if (initDisplay(display))
+            displays.push_back(display);
+    }
+}
+
+EglWindow::EglWindow(EGLDisplay display, EGLConfig config, EGLSurface surface, EGLContext context, GLsizei width,
+                     GLsizei height)
+    : PlatformWindow(width, height),
+      display_(display),
+      config_(config),
+      surface_(surface),
+      context_(context),
+      first_reshape_pending_(true)
+{
+    makeCurrent();
+}
+
+EglWindow::~EglWindow()
+{
+    if (eglGetCurrentContext() == context_)
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display_, context_);
+    eglDestroySurface(display_, surface_);
+}
+
+void EglWindow::makeCurrent()
+{
+    eglMakeCurrent(display_, surface_, surface_, context_);
+}
+
+void EglWindow::swapBuffers()
+{
+    eglSwapBuffers(display_, surface_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the swap interval, which doesn't do anything for a pbuffer
+///         but lets a program which asks for vsync carry on as it would.
+bool EglWindow::setSwapInterval(int interval)
+{
+    makeCurrent();
+    return eglSwapInterval(display_, interval) == EGL_TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Replaces the surface with one of the new size, and reports the
+///         reshape.  The old surface is kept if the new one can't be made.
+void EglWindow::resize(GLsizei width, GLsizei height)
+{
+    EGLSurface surface = createSurface(display_, config_, width, height);
+    if (surface == EGL_NO_SURFACE)
+    {
+        std::cerr << "Couldn't resize an EGL surface to " << width << "x" << height << " (error 0x" << std::hex
+                  << eglGetError() << std::dec << ")." << std::endl;
+        return;
+    }
+
+    eglMakeCurrent(display_, surface, surface, context_);
+    eglDestroySurface(display_, surface_);
+    surface_ = surface;
+    notifyReshape(width, height);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports the surface's size and posts a redisplay, the first time
+///         events are waited for, as a window system does once a new window
+///         is shown and its callbacks have been set.
+void EglWindow::deliverFirstReshape()
+{
+    if (!first_reshape_pending_)
+        return;
+
+    first_reshape_pending_ = false;
+    makeCurrent();
+    notifyReshape(width_, height_);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Opens and initializes an EGL display for desktop GL on each
+///         GPU, or the default display if the GPUs can't be listed.
+///
+/// \return null if there's no display which can run desktop GL; the reason
+///         has been reported to stderr.
+EglPlatform* EglPlatform::create()
+{
+    std::vector<EGLDisplay> displays;
+    getDeviceDisplays(displays);
+    if (displays.empty())
+    {
+        EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (!initDisplay(display))
+        {
+            std::cerr << "Couldn't initialize an EGL display for desktop OpenGL (error 0x" << std::hex
+                      << eglGetError() << std::dec << ")." << std::endl;
+            return nullptr;
+        }
+        displays.push_back(display);
+    }
+
+    return new EglPlatform(displays);
+}
+
+EglPlatform::EglPlatform(const std::vector<EGLDisplay>& displays)
+    : displays_(displays)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the surfaces and their contexts before the displays.
+EglPlatform::~EglPlatform()
+{
+    while (getWindowCount() > 0)
+        destroyWindow(getWindow(getWindowCount() - 1));
+    for (size_t i = 0; i < displays_.size(); ++i)
+        eglTerminate(displays_[i]);
+}
+
+PlatformType EglPlatform::getType() const
+{
+    return PLATFORM_EGL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of GPUs windows can be opened on.
+size_t EglPlatform::getDeviceCount() const
+{
+    return displays_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits out the timeout, since there are never any events.
+///
+/// \param  timeout_milliseconds How long to wait.  A negative timeout, to
+///         wait for the next event, would wait forever, so it waits
+///         POLL_MILLISECONDS instead, as GlutPlatform does.
+void EglPlatform::waitEvents(double timeout_milliseconds)
+{
+    for (size_t i = 0; i < getWindowCount(); ++i)
+        static_cast<EglWindow*>(getWindow(i))->deliverFirstReshape();
+
+    for (size_t i = 0; i < getWindowCount(); ++i)
+    {
+        if (getWindow(i)->isRedisplayPosted())
+            return;
+    }
+
+    double wait = timeout_milliseconds < 0 ? POLL_MILLISECONDS : timeout_milliseconds;
+    if (wait > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(wait * 1000.0)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a pbuffer surface and a compatibility profile context for
+///         it, on the GPU the window asks for.  The window's title, position
+///         and visibility don't matter.
+std::unique_ptr<PlatformWindow> EglPlatform::openWindow(const WindowDesc& desc)
+{
+    EGLDisplay display = displays_[desc.device];
+    const EGLint config_attributes[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count < 1)
+    {
+        std::cerr << "The EGL display has no RGBA8 pbuffer configs for desktop OpenGL." << std::endl;
+        return std::unique_ptr<PlatformWindow>();
+    }
+
+    EGLSurface surface = createSurface(display, config, desc.width, desc.height);
+    if (surface == EGL_NO_SURFACE)
+    {
+        std::cerr << "Couldn't create a " << desc.width << "x" << desc.height << " EGL surface (error 0x"
+                  << std::hex << eglGetError() << std::dec << ")." << std::endl;
+        return std::unique_ptr<PlatformWindow>();
+    }
+
+    // a context which is told about resets is asked for first, and a plain
+    // one if the display doesn't know how to make one.
+    const EGLint context_attributes[] =
+    {
+        EGL_CONTEXT_OPENGL_RESET_NOTIFICATION_STRATEGY_KHR, EGL_LOSE_CONTEXT_ON_RESET_KHR,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT)
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cerr << "Couldn't create an EGL context (error 0x" << std::hex << eglGetError() << std::dec << ")."
+                  << std::endl;
+        eglDestroySurface(display, surface);
+        return std::unique_ptr<PlatformWindow>();
+    }
+
+    return std::unique_ptr<PlatformWindow>(new EglWindow(display, config, surface, context, desc.width,
+                                                          desc.height));
+}
+
+#endif
@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  egl_platform.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the EglPlatform class.
+
+#ifndef EGL_PLATFORM_H_
+#define EGL_PLATFORM_H_
+
+#include "platform.h"
+#include <EGL/egl.h>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A Platform on EGL, with no windows at all: each PlatformWindow is
+///         an offscreen pbuffer surface with a desktop GL context.
+///
+/// \details This is for running without a display server, as the benchmark
+///         does on build machines.  Each GPU found through
+///         EGL_EXT_platform_device, if the driver has it, is a device, so no
+///         X server is needed and windows can be opened on any of the GPUs;
+///         otherwise the default display is the only device.
+///
+///         There's no input, and swapping a pbuffer's buffers does nothing,
+///         so anything drawn has to be read back or drawn into a framebuffer
+///         object.  Resizing a window replaces its surface.
+class EglPlatform : public Platform
+{
+public:
+    static EglPlatform* create();
+    virtual ~EglPlatform();
+
+    virtual PlatformType getType() const;
+    virtual size_t getDeviceCount() const;
+
+    virtual void waitEvents(double timeout_milliseconds);
+
+    static const double POLL_MILLISECONDS;
+
+protected:
+    virtual std::unique_ptr<PlatformWindow> openWindow(const WindowDesc& desc);
+
+private:
+    explicit EglPlatform(const std::vector<EGLDisplay>& displays);
+
+    std::vector<EGLDisplay> displays_;     ///< One per device.
+};
+
+#endif
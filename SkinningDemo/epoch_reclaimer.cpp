@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  epoch_reclaimer.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of EpochReclaimer class functions.
+
+#include "epoch_reclaimer.h"
+
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the readers, none of them pinned.
+///
+/// \param  reader_count The number of threads which will read, each with
+///         its own reader, numbered from 0.
+EpochReclaimer::EpochReclaimer(size_t reader_count)
+    : epoch_(UNPINNED + 1),
+      reader_count_(reader_count),
+      readers_(new Reader[reader_count])
+{
+    for (size_t i = 0; i < reader_count_; ++i)
+    {
+        readers_[i].epoch.store(UNPINNED);
+        readers_[i].depth = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees everything still retired.  No reader may be pinned.
+EpochReclaimer::~EpochReclaimer()
+{
+    for (size_t i = 0; i < retired_.size(); ++i)
+        retired_[i].deleter(retired_[i].object);
+    delete[] readers_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Pins the current epoch for a reader, unless it's pinned already.
+///         Only the thread which owns the reader may call this.
+///
+/// \details The pin is stored before anything it protects is read, and the
+///         writer retires objects only after replacing them, so either the
+///         writer's next reclaim() sees the pin, or the reader sees the
+///         replacement.  Both need the stores to be sequentially consistent.
+void EpochReclaimer::pin(size_t reader)
+{
+    assert(reader < reader_count_);
+    Reader& pinned = readers_[reader];
+    if (pinned.depth++ == 0)
+        pinned.epoch.store(epoch_.load());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unpins a reader, once its outermost pin is done with.
+void EpochReclaimer::unpin(size_t reader)
+{
+    assert(reader < reader_count_ && readers_[reader].depth > 0);
+    Reader& pinned = readers_[reader];
+    if (--pinned.depth == 0)
+        pinned.epoch.store(UNPINNED);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues an object to be deleted, tagged with the current epoch,
+///         and moves the epoch on.
+void EpochReclaimer::retireObject(void* object, Deleter deleter)
+{
+    Retired retired = { object, deleter, epoch_.fetch_add(1) };
+    retired_.push_back(retired);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees every retired object which was replaced before the oldest
+///         epoch any reader has pinned.  Never waits on the readers.
+///
+/// \return The number of objects freed.
+size_t EpochReclaimer::reclaim()
+{
+    if (retired_.empty())
+        return 0;
+
+    GLuint64 oldest = epoch_.load();
+    for (size_t i = 0; i < reader_count_; ++i)
+    {
+        GLuint64 pinned = readers_[i].epoch.load();
+        if (pinned != UNPINNED && pinned < oldest)
+            oldest = pinned;
+    }
+
+    // the objects are retired in epoch order, so the ones to free are a
+    // prefix.
+    size_t freed = 0;
+    while (freed < retired_.size() && retired_[freed].epoch < oldest)
+    {
+        retired_[freed].deleter(retired_[freed].object);
+        ++freed;
+    }
+    retired_.erase(retired_.begin(), retired_.begin() + freed);
+    return freed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of readers.
+size_t EpochReclaimer::getReaderCount() const
+{
+    return reader_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of retired objects which haven't been freed
+///         yet.
+size_t EpochReclaimer::getRetiredCount() const
+{
+    return retired_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the current epoch, which a reader pinning now would pin.
+GLuint64 EpochReclaimer::getEpoch() const
+{
+    return epoch_.load();
+}
@@ -0,0 +1,185 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  epoch_reclaimer.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the EpochReclaimer class, and the
+///         PublishedAsset class template which replaces assets through it.
+
+#ifndef EPOCH_RECLAIMER_H_
+#define EPOCH_RECLAIMER_H_
+
+#include "demo.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees objects which other threads might still be reading only
+///         once none of them can be, without making the readers take a lock.
+///
+/// \details There's a global epoch, and a fixed set of readers, one per
+///         thread which reads.  A reader pins the current epoch before it
+///         reads any object, for as long as a frame or a job, and unpins it
+///         when it's done; pinning is one store, and pins nest, so a job
+///         which runs on a thread with a pinned frame costs nothing more.
+///         An object that's been replaced is retire()d with the epoch it was
+///         replaced in, and the epoch moves on; reclaim() frees every
+///         retired object older than the oldest epoch still pinned, since
+///         any reader which pinned a later one found the replacement.
+///
+///         A reader which stays pinned holds back everything retired since,
+///         so pins shouldn't outlast a frame.  pin() and unpin() are only
+///         for the thread which owns the reader; retire() and reclaim() are
+///         for one writer thread, which needn't pin anything to read the
+///         objects it replaces itself.
+class EpochReclaimer
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Pins a reader's epoch for as long as it's in scope.
+    class Pin
+    {
+    public:
+        Pin(EpochReclaimer& reclaimer, size_t reader) : reclaimer_(reclaimer), reader_(reader)
+        {
+            reclaimer_.pin(reader_);
+        }
+
+        ~Pin() { reclaimer_.unpin(reader_); }
+
+    private:
+        Pin(const Pin&);            // non-copyable
+        Pin& operator=(const Pin&); // non-copyable
+
+        EpochReclaimer& reclaimer_;
+        size_t reader_;
+    };
+
+    explicit EpochReclaimer(size_t reader_count);
+    ~EpochReclaimer();
+
+    void pin(size_t reader);
+    void unpin(size_t reader);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Takes ownership of an object which has just been replaced,
+    ///         and deletes it once no reader can still be reading it.
+    template <typename T>
+    void retire(T* object)
+    {
+        retireObject(object, &deleteObject<T>);
+    }
+
+    size_t reclaim();
+
+    size_t getReaderCount() const;
+    size_t getRetiredCount() const;
+    GLuint64 getEpoch() const;
+
+private:
+    typedef void (*Deleter)(void* object);
+
+    /// The epoch an unpinned reader holds, older than any real one.
+    static const GLuint64 UNPINNED = 0;
+
+    EpochReclaimer(const EpochReclaimer&);              // non-copyable
+    EpochReclaimer& operator=(const EpochReclaimer&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  An object waiting on the readers.
+    struct Retired
+    {
+        void* object;
+        Deleter deleter;
+        GLuint64 epoch;     ///< The epoch it was replaced in.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A reader's pinned epoch, on a cache line of its own so that
+    ///         readers pinning at once don't contend.
+    struct Reader
+    {
+        std::atomic<GLuint64> epoch;    ///< UNPINNED, or the epoch pinned.
+        size_t depth;                   ///< Nested pins; only the owning thread touches it.
+        char padding[64];
+    };
+
+    template <typename T>
+    static void deleteObject(void* object)
+    {
+        delete static_cast<T*>(object);
+    }
+
+    void retireObject(void* object, Deleter deleter);
+
+    std::atomic<GLuint64> epoch_;
+    size_t reader_count_;
+    Reader* readers_;
+    std::vector<Retired> retired_;  ///< Oldest first.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An asset which can be replaced whole while other threads are
+///         reading it.
+///
+/// \details Readers get() the current object while their EpochReclaimer
+///         reader is pinned, and can use it until they unpin.  publish()
+///         swaps a replacement in with one atomic exchange, and retires the
+///         previous object rather than deleting it, so a reader is never
+///         left with a freed object and never waits on the writer.  Only
+///         one thread may publish.
+///
+///         Each publish() also moves the asset's serial on.  A reader which
+///         keeps something built from the object across frames, when it's
+///         unpinned and the object may have been freed, should keep the
+///         serial too, rather than compare pointers which may since have
+///         been reused.
+template <typename T>
+class PublishedAsset
+{
+public:
+    PublishedAsset() : object_(nullptr), serial_(0) {}
+
+    ~PublishedAsset()
+    {
+        delete object_.load();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the current object, or null if none has been
+    ///         published yet.
+    const T* get() const
+    {
+        return object_.load();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the current object, and the serial it was published
+    ///         with, or the object of a later serial.
+    const T* get(size_t& serial) const
+    {
+        serial = serial_.load();
+        return object_.load();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Replaces the object, and retires the previous one to a
+    ///         reclaimer whose readers are the ones which get() it.
+    void publish(std::unique_ptr<T> object, EpochReclaimer& reclaimer)
+    {
+        T* previous = object_.exchange(object.release());
+        serial_.fetch_add(1);
+        if (previous != nullptr)
+            reclaimer.retire(previous);
+    }
+
+private:
+    PublishedAsset(const PublishedAsset&);              // non-copyable
+    PublishedAsset& operator=(const PublishedAsset&);   // non-copyable
+
+    std::atomic<T*> object_;
+    std::atomic<size_t> serial_;    ///< The number of times an object has been published.
+};
+
+#endif
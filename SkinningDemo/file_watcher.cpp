@@ -0,0 +1,263 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  file_watcher.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of FileWatcher class functions, and of the file
+///         helpers.
+
+#include "file_watcher.h"
+#include "clip_database.h"
+#include "vertex_blocks.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gets a file's modification time and size.
+///
+/// \return false if the file doesn't exist, in which case both are set to
+///         values no existing file has.
+bool getFileStamp(const std::string& path, std::time_t& modified, long long& size)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+    {
+        modified = 0;
+        size = -1;
+        return false;
+    }
+
+    modified = info.st_mtime;
+    size = info.st_size;
+    return true;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the watcher's thread, with nothing to watch yet.
+///
+/// \param  poll_milliseconds How long the thread sleeps between polls.
+FileWatcher::FileWatcher(unsigned poll_milliseconds)
+    : poll_milliseconds_(poll_milliseconds),
+      stopping_(false)
+{
+    thread_ = std::thread(&FileWatcher::threadMain, this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops and joins the watcher's thread.  Changes which haven't been
+///         taken are thrown away.
+FileWatcher::~FileWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts watching a file.  Only changes made from now on are
+///         reported; the file doesn't have to exist yet.
+///
+/// \param  path The file to watch.
+/// \param  kind How to read the file when it changes.
+void FileWatcher::watch(const std::string& path, FileKind kind)
+{
+    WatchedFile file;
+    file.path = path;
+    file.kind = kind;
+    getFileStamp(path, file.modified, file.size);
+    file.seen_modified = file.modified;
+    file.seen_size = file.size;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.push_back(file);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if takeChanges() has anything to return.
+bool FileWatcher::hasChanges() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !changes_.empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes the files which have changed since the last call, in the
+///         order they were read.  A file which changed more than once only
+///         appears with its latest contents.
+///
+/// \param  changes Receives the changes; anything in it already is
+///         discarded.
+void FileWatcher::takeChanges(std::vector<Change>& changes)
+{
+    changes.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    changes.swap(changes_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The watcher thread's main loop: polls every file, and reads the
+///         ones which have changed and then settled.
+void FileWatcher::threadMain()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+        wake_.wait_for(lock, std::chrono::milliseconds(poll_milliseconds_));
+        if (stopping_)
+            break;
+
+        // the files are statted and read without the lock, so the render
+        // thread never waits on the disk.  watch() only ever appends to
+        // files_, so the copy's indices stay valid.
+        std::vector<WatchedFile> files = files_;
+        lock.unlock();
+
+        std::vector<Change> changes;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            WatchedFile& file = files[i];
+
+            std::time_t modified;
+            long long size;
+            if (!getFileStamp(file.path, modified, size))
+                continue;
+
+            bool settled = modified == file.seen_modified && size == file.seen_size;
+            file.seen_modified = modified;
+            file.seen_size = size;
+            if (!settled || (modified == file.modified && size == file.size))
+                continue;
+
+            // a broken file is only tried again once it changes again.
+            file.modified = modified;
+            file.size = size;
+
+            Change change;
+            if (readFile(file, change))
+                changes.push_back(change);
+        }
+
+        lock.lock();
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            WatchedFile& file = files_[i];
+            file.modified = files[i].modified;
+            file.size = files[i].size;
+            file.seen_modified = files[i].seen_modified;
+            file.seen_size = files[i].seen_size;
+        }
+
+        for (size_t i = 0; i < changes.size(); ++i)
+        {
+            size_t j = 0;
+            while (j < changes_.size() && changes_[j].path != changes[i].path)
+                ++j;
+
+            if (j < changes_.size())
+                changes_.erase(changes_.begin() + j);
+            changes_.push_back(changes[i]);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a file which has changed.
+///
+/// \return false if it couldn't be read, or if it's a broken mesh file or
+///         clip database.
+bool FileWatcher::readFile(const WatchedFile& file, Change& change) const
+{
+    change.path = file.path;
+    change.kind = file.kind;
+
+    if (file.kind == FILE_TEXT)
+        return readTextFile(file.path, change.text);
+
+    try
+    {
+        if (file.kind == FILE_CLIPS)
+        {
+            // the clip is copied out of the database, so the file isn't
+            // kept mapped while it may be rewritten again.
+            ClipDatabase database(file.path);
+            if (database.getClipCount() == 0)
+            {
+                std::cerr << file.path << " has no clips; keeping the previous clip." << std::endl;
+                return false;
+            }
+            change.clip = std::make_shared<CompressedClip>(database.getClip(0));
+            return true;
+        }
+
+        readMeshFile(file.path, change.mesh);
+        if (file.kind == FILE_MESH_BLOCKS && hasVertexBlockLayout(change.mesh.vertex_format))
+        {
+            encodeVertexBlocks(change.mesh.vertex_format, change.mesh.vertex_data.data(), change.mesh.vertex_count,
+                               change.mesh.vertex_blocks);
+        }
+    }
+    catch (const std::runtime_error&)
+    {
+        // readMeshFile() or ClipDatabase has already reported the problem.
+        return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a whole text file.
+///
+/// \return false if the file couldn't be opened or read.
+bool readTextFile(const std::string& path, std::string& text)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+        return false;
+
+    text.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a whole text file, replacing anything already there.
+///
+/// \return false if the file couldn't be written.
+bool writeTextFile(const std::string& path, const std::string& text)
+{
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+    if (!file)
+        return false;
+
+    file << text;
+    return bool(file);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a directory, if it doesn't exist already.  Failures are
+///         ignored; whatever goes in the directory will fail to be written
+///         instead.
+void makeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  file_watcher.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the FileWatcher class, and the small file
+///         helpers it's used with.
+
+#ifndef FILE_WATCHER_H_
+#define FILE_WATCHER_H_
+
+#include "compressed_clip.h"
+#include "mesh_file.h"
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Watches files for changes on a background thread, and reads the
+///         ones that change, so they can be swapped in at a frame boundary
+///         without the render thread ever touching the disk.
+///
+/// \details Files are polled for their modification time and size, since
+///         there's no portable way to be notified.  A file which has changed
+///         is only read once it has stayed the same for a whole poll, so
+///         that it isn't read while an editor or exporter is still writing
+///         it.  Text files are read as they are; mesh files are read and
+///         checked with readMeshFile(), and are left out if they're broken,
+///         after the problem has been reported to stderr.  A clip database
+///         is opened, and its first clip unpacked, the same way.  Packing a
+///         mesh's vertices into blocks (see encodeVertexBlocks()) is done
+///         here too, so it's off the render thread.
+///
+///         The watcher doesn't need a GL context.  Everything but the
+///         destructor may be called from any thread.
+class FileWatcher
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  How a watched file is read.
+    enum FileKind
+    {
+        FILE_TEXT,  ///< Read into Change::text.
+        FILE_MESH,          ///< Read with readMeshFile() into Change::mesh.
+        FILE_MESH_BLOCKS,   ///< The same, with quantized vertices also packed into Change::mesh.vertex_blocks.
+        FILE_CLIPS          ///< Opened as a ClipDatabase, whose first clip is unpacked into Change::clip.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The new contents of a file which has changed.
+    struct Change
+    {
+        std::string path;
+        FileKind kind;
+        std::string text;
+        MeshFileData mesh;
+        std::shared_ptr<const CompressedClip> clip;
+    };
+
+    explicit FileWatcher(unsigned poll_milliseconds = 250);
+    ~FileWatcher();
+
+    void watch(const std::string& path, FileKind kind);
+
+    bool hasChanges() const;
+    void takeChanges(std::vector<Change>& changes);
+
+private:
+    FileWatcher(const FileWatcher&);            // non-copyable
+    FileWatcher& operator=(const FileWatcher&); // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A watched file, as of the last poll.
+    struct WatchedFile
+    {
+        std::string path;
+        FileKind kind;
+        std::time_t modified;       ///< The modification time the file was last read with.
+        long long size;             ///< The size the file was last read with.
+        std::time_t seen_modified;  ///< The modification time seen by the last poll.
+        long long seen_size;        ///< The size seen by the last poll.
+    };
+
+    void threadMain();
+    bool readFile(const WatchedFile& file, Change& change) const;
+
+    unsigned poll_milliseconds_;
+    std::vector<WatchedFile> files_;
+    std::vector<Change> changes_;   ///< Read, but not taken yet.
+    bool stopping_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread thread_;
+};
+
+bool readTextFile(const std::string& path, std::string& text);
+bool writeTextFile(const std::string& path, const std::string& text);
+void makeDirectory(const std::string& path);
+
+#endif
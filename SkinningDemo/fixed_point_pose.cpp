@@ -0,0 +1,443 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  fixed_point_pose.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the Q16.16 joint transform functions and
+///         FixedPoseEvaluator class functions.
+///
+/// \details Nothing here touches a float except to decode the pose's
+///         channels and encode the results, both exactly.  Every product is
+///         taken in 64 bits and shifted back with unsigned arithmetic, so
+///         nothing depends on how a compiler shifts negative numbers either.
+
+#include "fixed_point_pose.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace {
+
+const int32_t FIXED_ONE = 1 << 16;
+const int32_t QUARTER_TURN = 90 << 16;      ///< In Q16.16 degrees.
+const int32_t FULL_TURN = 360 << 16;
+const int64_t Q30_ONE = int64_t(1) << 30;
+const uint64_t DEGREES_TO_Q30_RADIANS = 18740330;   ///< pi / 180 in Q2.30, times 2^16 for a Q16.16 angle.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the sine and cosine of an angle from 0 to pi / 2 in Q2.30
+///         radians, in Q2.30, from their Taylor series.
+///
+/// \details Six terms of each are within 1e-9 of the true values over the
+///         quadrant, far below Q16.16's resolution.  The series are
+///         evaluated from the last term back, as 1 - x^2 / (n (n + 1)) *
+///         (1 - ...), so every step is a multiply and a small division.
+void sinCosQ30(int64_t x, int64_t& sine, int64_t& cosine)
+{
+    static const int64_t SINE_DIVISORS[] = { 110, 72, 42, 20, 6 };
+    static const int64_t COSINE_DIVISORS[] = { 132, 90, 56, 30, 12, 2 };
+
+    int64_t x2 = (x * x) >> 30;
+
+    int64_t s = Q30_ONE;
+    for (size_t i = 0; i < sizeof(SINE_DIVISORS) / sizeof(SINE_DIVISORS[0]); ++i)
+        s = Q30_ONE - ((x2 * s) >> 30) / SINE_DIVISORS[i];
+    sine = (x * s) >> 30;
+
+    int64_t c = Q30_ONE;
+    for (size_t i = 0; i < sizeof(COSINE_DIVISORS) / sizeof(COSINE_DIVISORS[0]); ++i)
+        c = Q30_ONE - ((x2 * c) >> 30) / COSINE_DIVISORS[i];
+    cosine = c;
+
+    // the last steps can round a hair past the ends of the quadrant.
+    sine = sine < 0 ? 0 : (sine > Q30_ONE ? Q30_ONE : sine);
+    cosine = cosine < 0 ? 0 : (cosine > Q30_ONE ? Q30_ONE : cosine);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a non-negative Q2.30 value to Q16.16.
+int32_t q30ToFixed(int64_t value)
+{
+    return int32_t((value + (1 << 13)) >> 14);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Divides one Q16.16 value by another, truncating towards zero.
+int32_t divFixed(int32_t a, int64_t b)
+{
+    assert(b != 0);
+    return int32_t(int64_t(a) * FIXED_ONE / b);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the square root of an integer, rounded down, one bit
+///         at a time.
+uint64_t squareRoot(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = uint64_t(1) << 62;
+    while (bit > value)
+        bit >>= 2;
+
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  mulFixed() on four lanes at once.
+///
+/// \details SSE2 only multiplies unsigned 32-bit lanes, into 64 bits, so
+///         the even and odd lanes are multiplied separately, and each
+///         product is corrected to the signed one by subtracting the other
+///         operand, shifted up 32 bits, for each negative operand.  Then,
+///         as in mulFixed(), the rounding and shift only need the low 48
+///         bits of each product.
+__m128i mulFixed4(__m128i a, __m128i b)
+{
+    const __m128i low_dwords = _mm_set_epi32(0, -1, 0, -1);
+    const __m128i half = _mm_set_epi32(0, 0x8000, 0, 0x8000);
+
+    __m128i correction = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                                       _mm_and_si128(_mm_srai_epi32(b, 31), a));
+
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    even = _mm_sub_epi64(even, _mm_slli_epi64(correction, 32));
+    odd = _mm_sub_epi64(odd, _mm_andnot_si128(low_dwords, correction));
+
+    // each even result is the low dword of its lane shifted down 16, and
+    // each odd result the high dword of its lane shifted up 16.
+    even = _mm_srli_epi64(_mm_add_epi64(even, half), 16);
+    odd = _mm_slli_epi64(_mm_add_epi64(odd, half), 16);
+    return _mm_or_si128(_mm_and_si128(low_dwords, even), _mm_andnot_si128(low_dwords, odd));
+}
+#endif
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a float to Q16.16, rounding to nearest, with halves
+///         rounded away from zero.
+///
+/// \details The float's bits are decoded as integers, so the result doesn't
+///         depend on the FPU's rounding mode or precision.  Values outside
+///         the Q16.16 range, infinities and NaNs saturate.
+int32_t toFixed(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bool negative = (bits >> 31) != 0;
+    int exponent = int((bits >> 23) & 0xff);
+    uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+
+    // the value is mantissa * 2^(exponent - 150), so in Q16.16 it's
+    // mantissa * 2^(exponent - 134).  Denormals are far too small to matter.
+    int shift = exponent - 134;
+    uint32_t magnitude;
+    if (exponent == 0 || shift < -24)
+        magnitude = 0;
+    else if (shift > 7 || exponent == 0xff)
+        return negative ? INT32_MIN : INT32_MAX;
+    else if (shift >= 0)
+        magnitude = mantissa << shift;
+    else
+        magnitude = (mantissa + (uint32_t(1) << (-shift - 1))) >> -shift;
+
+    if (magnitude > uint32_t(INT32_MAX))
+        return negative ? INT32_MIN : INT32_MAX;
+    return negative ? -int32_t(magnitude) : int32_t(magnitude);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a Q16.16 value to a float.  Every Q16.16 value with
+///         less than 24 significant bits is exact; the rest are rounded
+///         once, to nearest, which IEEE 754 fixes.
+float fromFixed(int32_t value)
+{
+    return float(value) * (1.0f / FIXED_ONE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Multiplies two Q16.16 values, rounding to nearest, with halves
+///         rounded up.
+///
+/// \details The bits of the result only depend on the low 48 bits of the
+///         64-bit product, which are the same whether it's taken as signed
+///         or not, so the rounding and shift are unsigned.  The result must
+///         be in range.
+int32_t mulFixed(int32_t a, int32_t b)
+{
+    uint64_t product = uint64_t(int64_t(a) * int64_t(b)) + 0x8000;
+    return int32_t(uint32_t(product >> 16));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the sine and cosine of an angle in Q16.16 degrees, in
+///         Q16.16, without any floating point.
+///
+/// \details The angle is brought into the first quadrant, exactly, and the
+///         quadrant's sine and cosine swapped and negated into place, so the
+///         results are exact at multiples of 90 degrees.
+void sinCosFixedDegrees(int32_t degrees, int32_t& sine, int32_t& cosine)
+{
+    int32_t angle = degrees % FULL_TURN;
+    if (angle < 0)
+        angle += FULL_TURN;
+    int32_t quadrant = angle / QUARTER_TURN;
+    angle -= quadrant * QUARTER_TURN;
+
+    int64_t radians = int64_t((uint64_t(angle) * DEGREES_TO_Q30_RADIANS + 0x8000) >> 16);
+    int64_t s, c;
+    sinCosQ30(radians, s, c);
+    int32_t fixed_sine = q30ToFixed(s);
+    int32_t fixed_cosine = q30ToFixed(c);
+
+    switch (quadrant)
+    {
+    case 0:
+        sine = fixed_sine;
+        cosine = fixed_cosine;
+        break;
+
+    case 1:
+        sine = fixed_cosine;
+        cosine = -fixed_sine;
+        break;
+
+    case 2:
+        sine = -fixed_sine;
+        cosine = -fixed_cosine;
+        break;
+
+    default:
+        sine = -fixed_cosine;
+        cosine = fixed_sine;
+        break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates a joint's local-to-parent transform in Q16.16, as
+///         getJointLocalAffine().
+FixedAffine2D getJointLocalFixedAffine(const Pose& pose, size_t joint)
+{
+    int32_t s, c;
+    sinCosFixedDegrees(toFixed(pose.rotation[joint]), s, c);
+    int32_t scale = toFixed(pose.scale[joint]);
+    s = mulFixed(s, scale);
+    c = mulFixed(c, scale);
+
+    FixedAffine2D affine;
+    affine.x_axis[0] = c;
+    affine.x_axis[1] = s;
+    affine.y_axis[0] = -s;
+    affine.y_axis[1] = c;
+    affine.translation[0] = toFixed(pose.translation[joint].x);
+    affine.translation[1] = toFixed(pose.translation[joint].y);
+    return affine;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform which applies b, then a, as
+///         composeAffine().  Each product is rounded separately, in the same
+///         order with SSE2 as without.
+FixedAffine2D composeFixedAffine(const FixedAffine2D& a, const FixedAffine2D& b)
+{
+    FixedAffine2D result;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    __m128i a_axes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.x_axis));
+    __m128i b_axes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.x_axis));
+    __m128i b_translation = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b.translation));
+
+    // both result axes at once: a.x_axis * b.?_axis.x + a.y_axis * b.?_axis.y.
+    __m128i a_x = _mm_shuffle_epi32(a_axes, _MM_SHUFFLE(1, 0, 1, 0));
+    __m128i a_y = _mm_shuffle_epi32(a_axes, _MM_SHUFFLE(3, 2, 3, 2));
+    __m128i b_first = _mm_shuffle_epi32(b_axes, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i b_second = _mm_shuffle_epi32(b_axes, _MM_SHUFFLE(3, 3, 1, 1));
+    __m128i axes = _mm_add_epi32(mulFixed4(a_x, b_first), mulFixed4(a_y, b_second));
+
+    __m128i t_first = _mm_shuffle_epi32(b_translation, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128i t_second = _mm_shuffle_epi32(b_translation, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128i translation = _mm_add_epi32(mulFixed4(a_x, t_first), mulFixed4(a_y, t_second));
+    translation = _mm_add_epi32(translation, _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a.translation)));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result.x_axis), axes);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(result.translation), translation);
+#else
+    for (int i = 0; i < 2; ++i)
+    {
+        result.x_axis[i] = mulFixed(a.x_axis[i], b.x_axis[0]) + mulFixed(a.y_axis[i], b.x_axis[1]);
+        result.y_axis[i] = mulFixed(a.x_axis[i], b.y_axis[0]) + mulFixed(a.y_axis[i], b.y_axis[1]);
+        result.translation[i] = mulFixed(a.x_axis[i], b.translation[0]) + mulFixed(a.y_axis[i], b.translation[1])
+                              + a.translation[i];
+    }
+#endif
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the inverse of a transform, as inverseAffine().  Its axes
+///         must not be parallel.
+FixedAffine2D inverseFixedAffine(const FixedAffine2D& affine)
+{
+    int64_t det = int64_t(mulFixed(affine.x_axis[0], affine.y_axis[1])) -
+                  mulFixed(affine.y_axis[0], affine.x_axis[1]);
+
+    FixedAffine2D inverse;
+    inverse.x_axis[0] = divFixed(affine.y_axis[1], det);
+    inverse.x_axis[1] = divFixed(-affine.x_axis[1], det);
+    inverse.y_axis[0] = divFixed(-affine.y_axis[0], det);
+    inverse.y_axis[1] = divFixed(affine.x_axis[0], det);
+    for (int i = 0; i < 2; ++i)
+    {
+        inverse.translation[i] = -(mulFixed(inverse.x_axis[i], affine.translation[0]) +
+                                   mulFixed(inverse.y_axis[i], affine.translation[1]));
+    }
+    return inverse;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a Q16.16 transform to floats, exactly.
+Affine2D fixedAffineToAffine(const FixedAffine2D& affine)
+{
+    Affine2D result;
+    result.x_axis = vec2(fromFixed(affine.x_axis[0]), fromFixed(affine.x_axis[1]));
+    result.y_axis = vec2(fromFixed(affine.y_axis[0]), fromFixed(affine.y_axis[1]));
+    result.translation = vec2(fromFixed(affine.translation[0]), fromFixed(affine.translation[1]));
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Expands a Q16.16 transform to a mat4, as affineToMat4().  The z
+///         scale, the length of the x axis, is an integer square root, so
+///         it's as deterministic as the rest.
+mat4 fixedAffineToMat4(const FixedAffine2D& affine)
+{
+    int64_t x = affine.x_axis[0];
+    int64_t y = affine.x_axis[1];
+    int32_t z_scale = int32_t(squareRoot(uint64_t(x * x) + uint64_t(y * y)));
+
+    Affine2D result = fixedAffineToAffine(affine);
+    return mat4(result.x_axis.x, result.x_axis.y, 0, 0,
+                result.y_axis.x, result.y_axis.y, 0, 0,
+                0, 0, fromFixed(z_scale), 0,
+                result.translation.x, result.translation.y, 0, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies the skeleton's hierarchy and finds its inverse bind
+///         transforms in Q16.16.  They're evaluated from the bind pose
+///         here, rather than converted from the skeleton's float ones, so
+///         they're as deterministic as everything else.
+///
+/// \param  skeleton The skeleton poses will be evaluated for.
+/// \param  bind_pose The pose its meshes were modeled in.
+FixedPoseEvaluator::FixedPoseEvaluator(const Skeleton& skeleton, const Pose& bind_pose)
+    : parents_(skeleton.getJointCount()),
+      inverse_bind_affines_(skeleton.getJointCount()),
+      joint_affines_(skeleton.getJointCount()),
+      palette_(skeleton.getJointCount())
+{
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+        parents_[joint] = skeleton.getParent(joint);
+
+    computeJointAffines(bind_pose, inverse_bind_affines_.data());
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+        inverse_bind_affines_[joint] = inverseFixedAffine(inverse_bind_affines_[joint]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Evaluates a pose's local-to-model transforms and skinning
+///         palette.
+void FixedPoseEvaluator::evaluate(const Pose& pose)
+{
+    assert(pose.joint_count == parents_.size());
+    computeJointAffines(pose, joint_affines_.data());
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+        palette_[joint] = composeFixedAffine(joint_affines_[joint], inverse_bind_affines_[joint]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the local-to-model transforms from the last evaluate().
+const FixedAffine2D* FixedPoseEvaluator::getJointAffines() const
+{
+    return joint_affines_.data();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the skinning palette from the last evaluate().
+const FixedAffine2D* FixedPoseEvaluator::getPalette() const
+{
+    return palette_.data();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts the palette to floats, for the AFFINE_2D shaders.
+void FixedPoseEvaluator::getAffinePalette(Affine2D* palette) const
+{
+    for (size_t joint = 0; joint < palette_.size(); ++joint)
+        palette[joint] = fixedAffineToAffine(palette_[joint]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts the palette to matrices, for the PALETTE shaders and
+///         the CPU skinner.
+void FixedPoseEvaluator::getMatrixPalette(mat4* palette) const
+{
+    for (size_t joint = 0; joint < palette_.size(); ++joint)
+        palette[joint] = fixedAffineToMat4(palette_[joint]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a 64-bit FNV-1a hash of the palette, byte by byte in
+///         little-endian order, so lockstep peers can compare palettes
+///         without exchanging them.
+uint64_t FixedPoseEvaluator::getPaletteHash() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t joint = 0; joint < palette_.size(); ++joint)
+    {
+        const int32_t values[6] =
+        {
+            palette_[joint].x_axis[0], palette_[joint].x_axis[1],
+            palette_[joint].y_axis[0], palette_[joint].y_axis[1],
+            palette_[joint].translation[0], palette_[joint].translation[1]
+        };
+        for (int i = 0; i < 6; ++i)
+        {
+            for (int byte = 0; byte < 4; ++byte)
+            {
+                hash ^= (uint32_t(values[i]) >> (8 * byte)) & 0xff;
+                hash *= 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the local-to-model transform of every joint in a pose,
+///         in one forward pass, as Skeleton::computeJointAffines().
+void FixedPoseEvaluator::computeJointAffines(const Pose& pose, FixedAffine2D* affines) const
+{
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+    {
+        affines[joint] = getJointLocalFixedAffine(pose, joint);
+        int parent = parents_[joint];
+        if (parent != Skeleton::NO_PARENT)
+            affines[joint] = composeFixedAffine(affines[parent], affines[joint]);
+    }
+}
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  fixed_point_pose.h
+/// \author Ben Crist
+///
+/// \brief  The FixedAffine2D struct, Q16.16 joint transform functions, and
+///         the FixedPoseEvaluator class.
+
+#ifndef FIXED_POINT_POSE_H_
+#define FIXED_POINT_POSE_H_
+
+#include "affine_2d.h"
+#include "skeleton.h"
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A 2D affine transform in Q16.16 fixed point, laid out like
+///         Affine2D.
+///
+/// \details The axes come first and are contiguous, so compositions can
+///         load all four of their components into one SSE2 register.
+struct FixedAffine2D
+{
+    int32_t x_axis[2];
+    int32_t y_axis[2];
+    int32_t translation[2];
+};
+
+int32_t toFixed(float value);
+float fromFixed(int32_t value);
+int32_t mulFixed(int32_t a, int32_t b);
+void sinCosFixedDegrees(int32_t degrees, int32_t& sine, int32_t& cosine);
+
+FixedAffine2D getJointLocalFixedAffine(const Pose& pose, size_t joint);
+FixedAffine2D composeFixedAffine(const FixedAffine2D& a, const FixedAffine2D& b);
+FixedAffine2D inverseFixedAffine(const FixedAffine2D& affine);
+Affine2D fixedAffineToAffine(const FixedAffine2D& affine);
+mat4 fixedAffineToMat4(const FixedAffine2D& affine);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Evaluates a skeleton's skinning palette from a pose entirely in
+///         integer arithmetic, so the same pose gives the same palette, to
+///         the bit, whatever the compiler, optimization level or ISA.
+///
+/// \details Floating point palettes drift apart between machines: compilers
+///         contract multiplies and adds into FMAs or not, the x87 rounds
+///         intermediates differently from SSE, and every libm has its own
+///         sin(), so lockstep peers can't compare or skip exchanging them.
+///         Here the pose's channels are converted to Q16.16 by decoding
+///         their bits, which doesn't depend on any rounding mode; the sines
+///         and cosines come from a fixed-point polynomial; and the hierarchy
+///         and palette are composed with 64-bit products, each rounded to
+///         nearest.  The SSE2 compositions use the same products, so they
+///         match the scalar ones exactly.  The results are only converted
+///         back to floats at the end, which is exact.
+///
+///         The Q16.16 range limits translations to +-32768 and the
+///         resolution to 1/65536: ample for the demo's meshes, which span
+///         -1 to 1.  The poses themselves must be the same on every peer,
+///         of course, so they should come from the simulation's own
+///         deterministic state rather than from a float clip sampler.
+class FixedPoseEvaluator
+{
+public:
+    FixedPoseEvaluator(const Skeleton& skeleton, const Pose& bind_pose);
+
+    void evaluate(const Pose& pose);
+
+    const FixedAffine2D* getJointAffines() const;
+    const FixedAffine2D* getPalette() const;
+    void getAffinePalette(Affine2D* palette) const;
+    void getMatrixPalette(mat4* palette) const;
+    uint64_t getPaletteHash() const;
+
+private:
+    FixedPoseEvaluator(const FixedPoseEvaluator&);              // non-copyable
+    FixedPoseEvaluator& operator=(const FixedPoseEvaluator&);   // non-copyable
+
+    void computeJointAffines(const Pose& pose, FixedAffine2D* affines) const;
+
+    std::vector<int> parents_;
+    std::vector<FixedAffine2D> inverse_bind_affines_;
+    std::vector<FixedAffine2D> joint_affines_;     ///< Local-to-model, from the last evaluate().
+    std::vector<FixedAffine2D> palette_;
+};
+
+#endif
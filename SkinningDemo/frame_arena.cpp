@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_arena.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of FrameArena class functions.
+
+#include "frame_arena.h"
+
+#include <algorithm>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a size or address up to the next multiple of 16.
+size_t roundUp16(size_t n)
+{
+    return (n + 15) & ~size_t(15);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the first 16-byte boundary in a block.
+char* alignBlock(char* block)
+{
+    return reinterpret_cast<char*>(roundUp16(reinterpret_cast<size_t>(block)));
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an arena with every region allocated up front, starting
+///         in the first frame.
+///
+/// \param  bytes_per_frame What each region holds before it has to grow.
+/// \param  frame_count The number of frames whose allocations are kept at
+///         once.
+FrameArena::FrameArena(size_t bytes_per_frame, size_t frame_count)
+    : regions_(std::max(frame_count, size_t(1))),
+      current_(0),
+      high_water_(0)
+{
+    for (size_t i = 0; i < regions_.size(); ++i)
+    {
+        regions_[i].capacity = roundUp16(bytes_per_frame);
+        regions_[i].memory = allocateBlock(regions_[i].capacity);
+        regions_[i].used = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Releases all of the arena's memory, whatever is still using it.
+FrameArena::~FrameArena()
+{
+    for (size_t i = 0; i < regions_.size(); ++i)
+    {
+        delete[] regions_[i].memory;
+        for (size_t j = 0; j < regions_[i].overflow.size(); ++j)
+            delete[] regions_[i].overflow[j];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves on to the next region, releasing everything allocated from
+///         it frame_count frames ago.
+///
+/// \details If that frame overflowed the region, the region is reallocated
+///         big enough to hold everything it asked for.
+void FrameArena::beginFrame()
+{
+    high_water_ = std::max(high_water_, regions_[current_].used);
+    current_ = (current_ + 1) % regions_.size();
+    Region& region = regions_[current_];
+
+    for (size_t i = 0; i < region.overflow.size(); ++i)
+        delete[] region.overflow[i];
+    region.overflow.clear();
+
+    if (region.used > region.capacity)
+    {
+        delete[] region.memory;
+        region.capacity = region.used;
+        region.memory = allocateBlock(region.capacity);
+    }
+    region.used = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates uninitialized, 16-byte aligned memory, which stays
+///         valid until frame_count more frames have begun.
+void* FrameArena::allocate(size_t bytes)
+{
+    Region& region = regions_[current_];
+    bytes = roundUp16(bytes);
+
+    size_t offset = region.used;
+    region.used += bytes;
+    if (region.used <= region.capacity)
+        return alignBlock(region.memory) + offset;
+
+    // the rest of the frame's allocations may fit in what's left, but
+    // keeping the offset past the end means everything after the first
+    // overflow goes to the heap, so the next beginFrame() grows the region
+    // to the whole frame's total.
+    region.overflow.push_back(allocateBlock(bytes));
+    return alignBlock(region.overflow.back());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of frames whose allocations are kept at once.
+size_t FrameArena::getFrameCount() const
+{
+    return regions_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns what the current frame's region holds, in bytes, before
+///         it overflows to the heap.
+size_t FrameArena::getCapacity() const
+{
+    return regions_[current_].capacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of bytes the current frame has allocated,
+///         including any which overflowed.
+size_t FrameArena::getUsed() const
+{
+    return regions_[current_].used;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the most bytes any one frame has allocated, the current
+///         frame included, since the arena was created.
+size_t FrameArena::getHighWaterMark() const
+{
+    return std::max(high_water_, regions_[current_].used);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates a heap block with room to align bytes bytes.
+char* FrameArena::allocateBlock(size_t bytes)
+{
+    return new char[bytes + 15];
+}
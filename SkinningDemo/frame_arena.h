@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_arena.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the FrameArena class.
+
+#ifndef FRAME_ARENA_H_
+#define FRAME_ARENA_H_
+
+#include <cstddef>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A linear allocator for data which only lives for a frame or a
+///         few, released all at once rather than piece by piece.
+///
+/// \details The arena has a region of memory per frame in flight, and each
+///         beginFrame() moves on to the next region and empties it, so
+///         whatever was allocated in a frame stays valid until frame_count
+///         more frames have begun.  Data read only within the frame which
+///         wrote it needs just one; data handed to something running behind,
+///         like the GPU or the render thread, needs one more for every frame
+///         it can lag by.
+///
+///         Allocating just bumps an offset, and everything comes back
+///         16-byte aligned, ready for SIMD streams.  No constructors or
+///         destructors are run, so it's only for plain data.  If a frame
+///         asks for more than its region holds, the rest comes from the
+///         heap, and the region is grown to fit the next time it's emptied,
+///         so once the arena has seen a frame's working size, frames never
+///         touch the heap.
+///
+///         An arena belongs to one thread.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t bytes_per_frame, size_t frame_count = 1);
+    ~FrameArena();
+
+    void beginFrame();
+    void* allocate(size_t bytes);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Allocates an uninitialized array of count Ts.
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    size_t getFrameCount() const;
+    size_t getCapacity() const;
+    size_t getUsed() const;
+    size_t getHighWaterMark() const;
+
+private:
+    FrameArena(const FrameArena&);              // non-copyable
+    FrameArena& operator=(const FrameArena&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The memory for one frame in flight.
+    struct Region
+    {
+        char* memory;                   ///< As allocated; the data starts at the first 16-byte boundary.
+        size_t capacity;                ///< In bytes, from that boundary.
+        size_t used;                    ///< Including any overflow.
+        std::vector<char*> overflow;    ///< Heap blocks for what didn't fit, freed when the region is emptied.
+    };
+
+    static char* allocateBlock(size_t bytes);
+
+    std::vector<Region> regions_;
+    size_t current_;                    ///< The region frames are allocating from.
+    size_t high_water_;                 ///< The most any finished frame has allocated, in bytes.
+};
+
+#endif
@@ -0,0 +1,430 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_graph.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of FrameGraph class functions.
+
+#include "frame_graph.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two descriptions would make the same texture.
+bool FrameGraph::TextureDesc::operator==(const TextureDesc& other) const
+{
+    return target == other.target &&
+           internal_format == other.internal_format &&
+           width == other.width &&
+           height == other.height &&
+           layers == other.layers;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty graph, with no textures yet.
+FrameGraph::FrameGraph()
+    : compiled_(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Deletes the transient textures.
+FrameGraph::~FrameGraph()
+{
+    for (size_t i = 0; i < textures_.size(); ++i)
+        glDeleteTextures(1, &textures_[i].texture_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Removes every pass and resource, to start declaring the next
+///         frame's.  The textures are kept for the next compile() to reuse.
+void FrameGraph::reset()
+{
+    resources_.clear();
+    passes_.clear();
+    order_.clear();
+    compiled_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Declares a resource which the caller owns, such as a buffer or a
+///         target which outlives the frame.
+///
+/// \param  name A string literal naming it.
+/// \return The resource, for read() and write().
+FrameGraph::ResourceId FrameGraph::importResource(const char* name)
+{
+    Resource resource;
+    resource.name = name;
+    resource.transient = false;
+    resource.desc.target = 0;
+    resource.desc.internal_format = 0;
+    resource.desc.width = 0;
+    resource.desc.height = 0;
+    resource.desc.layers = 0;
+    resource.texture = size_t(-1);
+    resource.first_use = size_t(-1);
+    resource.last_use = 0;
+    resources_.push_back(resource);
+    return resources_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Declares a texture which only lives for the passes which use it,
+///         for compile() to find storage for.
+///
+/// \param  name A string literal naming it.
+/// \param  desc What the texture holds.
+/// \return The resource, for read(), write() and getTexture().
+FrameGraph::ResourceId FrameGraph::createTexture(const char* name, const TextureDesc& desc)
+{
+    ResourceId id = importResource(name);
+    resources_[id].transient = true;
+    resources_[id].desc = desc;
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a pass, which accesses nothing until read() and write() say
+///         it does.
+///
+/// \param  name A string literal, which the pass's span in the trace is
+///         called.
+/// \param  function Draws the pass.  It has to bind all of the state it
+///         needs, since the passes before it may be any of those it
+///         doesn't depend on.
+/// \param  context Passed to function; it must outlive execute().
+/// \return The pass.
+FrameGraph::PassId FrameGraph::addPass(const char* name, PassFunction function, void* context)
+{
+    assert(!compiled_);
+    Pass pass;
+    pass.name = name;
+    pass.function = function;
+    pass.context = context;
+    pass.level = 0;
+    pass.barriers = 0;
+    passes_.push_back(pass);
+    return passes_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Declares that a pass reads a resource, so it runs after whichever
+///         pass declared before it last wrote the resource.
+void FrameGraph::read(PassId pass, ResourceId resource, ResourceUsage usage)
+{
+    addAccess(pass, resource, usage, false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Declares that a pass writes a resource, so it runs after every
+///         pass declared before it which touches the resource, and before
+///         every one declared after it.
+void FrameGraph::write(PassId pass, ResourceId resource, ResourceUsage usage)
+{
+    addAccess(pass, resource, usage, true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Orders the passes, places their barriers, and gives the
+///         transients their textures.
+void FrameGraph::compile()
+{
+    assert(!compiled_);
+    schedule();
+    placeBarriers();
+    assignTextures();
+    compiled_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs the compiled passes in order, each after its barriers.
+void FrameGraph::execute()
+{
+    assert(compiled_);
+    for (size_t i = 0; i < order_.size(); ++i)
+    {
+        const Pass& pass = passes_[order_[i]];
+        if (pass.barriers != 0)
+            glMemoryBarrier(pass.barriers);
+
+        TRACE_SCOPE(pass.name);
+        pass.function(pass.context);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the texture a transient was given by compile().
+GLuint FrameGraph::getTexture(ResourceId resource) const
+{
+    assert(compiled_ && resources_[resource].transient);
+    size_t texture = resources_[resource].texture;
+    return texture < textures_.size() ? textures_[texture].texture_id : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of passes in the graph.
+size_t FrameGraph::getPassCount() const
+{
+    return passes_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of textures the last compile() gave its
+///         transients; fewer than the transients, if any were aliased.
+size_t FrameGraph::getTextureCount() const
+{
+    return textures_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns roughly how much memory the transients' textures hold.
+size_t FrameGraph::getTransientBytes() const
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < textures_.size(); ++i)
+        bytes += getTextureBytes(textures_[i].desc);
+    return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records one of a pass's accesses.
+void FrameGraph::addAccess(PassId pass, ResourceId resource, ResourceUsage usage, bool write)
+{
+    assert(!compiled_ && pass < passes_.size() && resource < resources_.size());
+    Access access;
+    access.resource = resource;
+    access.usage = usage;
+    access.write = write;
+    passes_[pass].accesses.push_back(access);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Puts each pass at one level past the deepest pass it depends on,
+///         and fills order_ with the levels in turn.
+///
+/// \details An access depends on the last write of its resource declared
+///         before it, and a write also depends on every read since then, so
+///         reads between two writes can run in any order.  Dependencies
+///         are always on passes declared earlier, so one walk over the
+///         passes in declaration order finds every level.
+void FrameGraph::schedule()
+{
+    std::vector<size_t> last_write(resources_.size(), size_t(-1));
+    std::vector<std::vector<PassId> > reads_since_write(resources_.size());
+    size_t level_count = 0;
+    for (PassId id = 0; id < passes_.size(); ++id)
+    {
+        Pass& pass = passes_[id];
+        pass.level = 0;
+        for (size_t i = 0; i < pass.accesses.size(); ++i)
+        {
+            const Access& access = pass.accesses[i];
+            size_t writer = last_write[access.resource];
+            if (writer != size_t(-1) && writer != id)
+                pass.level = std::max(pass.level, passes_[writer].level + 1);
+
+            if (access.write)
+            {
+                const std::vector<PassId>& readers = reads_since_write[access.resource];
+                for (size_t j = 0; j < readers.size(); ++j)
+                {
+                    if (readers[j] != id)
+                        pass.level = std::max(pass.level, passes_[readers[j]].level + 1);
+                }
+            }
+        }
+
+        // the pass's own accesses only take effect once its level is known,
+        // so a pass which reads and writes a resource doesn't wait on itself.
+        for (size_t i = 0; i < pass.accesses.size(); ++i)
+        {
+            const Access& access = pass.accesses[i];
+            if (access.write)
+            {
+                last_write[access.resource] = id;
+                reads_since_write[access.resource].clear();
+            }
+            else
+                reads_since_write[access.resource].push_back(id);
+        }
+        level_count = std::max(level_count, pass.level + 1);
+    }
+
+    order_.clear();
+    for (size_t level = 0; level < level_count; ++level)
+    {
+        for (PassId id = 0; id < passes_.size(); ++id)
+        {
+            if (passes_[id].level == level)
+                order_.push_back(id);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Works out the barriers each pass needs, in the scheduled order,
+///         and where each resource's life starts and ends.
+///
+/// \details After an incoherent write, each later access needs the barrier
+///         bit for its usage, once; a bit which has already been issued
+///         since the write isn't issued again.
+void FrameGraph::placeBarriers()
+{
+    std::vector<bool> incoherent(resources_.size(), false);
+    std::vector<GLbitfield> issued(resources_.size(), 0);
+    for (size_t place = 0; place < order_.size(); ++place)
+    {
+        Pass& pass = passes_[order_[place]];
+        pass.barriers = 0;
+        for (size_t i = 0; i < pass.accesses.size(); ++i)
+        {
+            const Access& access = pass.accesses[i];
+            Resource& resource = resources_[access.resource];
+            resource.first_use = std::min(resource.first_use, place);
+            resource.last_use = std::max(resource.last_use, place);
+
+            GLbitfield bits = getBarrierBits(access.usage);
+            if (incoherent[access.resource] && (issued[access.resource] & bits) != bits)
+            {
+                pass.barriers |= bits;
+                issued[access.resource] |= bits;
+            }
+        }
+
+        for (size_t i = 0; i < pass.accesses.size(); ++i)
+        {
+            const Access& access = pass.accesses[i];
+            if (access.write)
+            {
+                incoherent[access.resource] = access.usage == USAGE_SHADER_STORAGE;
+                issued[access.resource] = 0;
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gives each transient a texture with its description which no
+///         other transient is using for any of the passes it's used in,
+///         creating one if there's none.  Textures left unused are deleted.
+void FrameGraph::assignTextures()
+{
+    for (size_t i = 0; i < textures_.size(); ++i)
+    {
+        textures_[i].used = false;
+        textures_[i].free_from = 0;
+    }
+
+    // give out textures in the order the transients first need them.
+    std::vector<ResourceId> transients;
+    for (ResourceId id = 0; id < resources_.size(); ++id)
+    {
+        if (resources_[id].transient && resources_[id].first_use != size_t(-1))
+            transients.push_back(id);
+    }
+    for (size_t i = 1; i < transients.size(); ++i)
+    {
+        ResourceId id = transients[i];
+        size_t j = i;
+        for (; j > 0 && resources_[transients[j - 1]].first_use > resources_[id].first_use; --j)
+            transients[j] = transients[j - 1];
+        transients[j] = id;
+    }
+
+    for (size_t i = 0; i < transients.size(); ++i)
+    {
+        Resource& resource = resources_[transients[i]];
+        size_t texture = 0;
+        for (; texture < textures_.size(); ++texture)
+        {
+            const Texture& candidate = textures_[texture];
+            if (candidate.desc == resource.desc && (!candidate.used || candidate.free_from <= resource.first_use))
+                break;
+        }
+
+        if (texture == textures_.size())
+        {
+            const TextureDesc& desc = resource.desc;
+            Texture created;
+            created.desc = desc;
+            glGenTextures(1, &created.texture_id);
+            glBindTexture(desc.target, created.texture_id);
+
+            bool depth = desc.internal_format == GL_DEPTH_COMPONENT16 || desc.internal_format == GL_DEPTH_COMPONENT24 ||
+                         desc.internal_format == GL_DEPTH_COMPONENT32F;
+            GLenum format = depth ? GL_DEPTH_COMPONENT : GL_RGBA;
+            GLenum type = depth ? GL_FLOAT : GL_UNSIGNED_BYTE;
+            if (desc.target == GL_TEXTURE_2D_ARRAY)
+                glTexImage3D(desc.target, 0, desc.internal_format, desc.width, desc.height, desc.layers, 0,
+                             format, type, nullptr);
+            else
+                glTexImage2D(desc.target, 0, desc.internal_format, desc.width, desc.height, 0, format, type, nullptr);
+            glTexParameteri(desc.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(desc.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(desc.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(desc.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(desc.target, 0);
+            textures_.push_back(created);
+        }
+
+        textures_[texture].used = true;
+        textures_[texture].free_from = resource.last_use + 1;
+        resource.texture = texture;
+    }
+
+    // drop the textures nothing needed this frame, and renumber the rest.
+    std::vector<size_t> renumbered(textures_.size(), size_t(-1));
+    size_t kept = 0;
+    for (size_t i = 0; i < textures_.size(); ++i)
+    {
+        if (!textures_[i].used)
+        {
+            glDeleteTextures(1, &textures_[i].texture_id);
+            continue;
+        }
+        renumbered[i] = kept;
+        textures_[kept++] = textures_[i];
+    }
+    textures_.resize(kept);
+
+    for (size_t i = 0; i < transients.size(); ++i)
+        resources_[transients[i]].texture = renumbered[resources_[transients[i]].texture];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the glMemoryBarrier() bit that makes an incoherent write
+///         visible to an access of the given kind.
+GLbitfield FrameGraph::getBarrierBits(ResourceUsage usage)
+{
+    switch (usage)
+    {
+    case USAGE_VERTEX_ATTRIBUTES:   return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+    case USAGE_SHADER_STORAGE:      return GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case USAGE_TEXTURE:             return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case USAGE_INDIRECT_COMMANDS:   return GL_COMMAND_BARRIER_BIT;
+    case USAGE_READBACK:            return GL_BUFFER_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT;
+    case USAGE_FRAMEBUFFER:         return GL_FRAMEBUFFER_BARRIER_BIT;
+    case USAGE_TRANSFORM_FEEDBACK:  return GL_TRANSFORM_FEEDBACK_BARRIER_BIT;
+    case USAGE_UPLOAD:              return GL_BUFFER_UPDATE_BARRIER_BIT;
+    default:                        return GL_ALL_BARRIER_BITS;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns roughly how many bytes a texture with a description
+///         holds, for the formats the demo uses.
+size_t FrameGraph::getTextureBytes(const TextureDesc& desc)
+{
+    size_t texel_bytes;
+    switch (desc.internal_format)
+    {
+    case GL_DEPTH_COMPONENT16:  texel_bytes = 2; break;
+    case GL_RGBA16F:            texel_bytes = 8; break;
+    case GL_RGBA32F:            texel_bytes = 16; break;
+    default:                    texel_bytes = 4; break;
+    }
+    return size_t(desc.width) * size_t(desc.height) * size_t(std::max(desc.layers, GLsizei(1))) * texel_bytes;
+}
@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_graph.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the FrameGraph class.
+
+#ifndef FRAME_GRAPH_H_
+#define FRAME_GRAPH_H_
+
+#include "demo.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Orders a frame's render passes from the resources each one says
+///         it reads and writes, places the memory barriers between them,
+///         and gives their transient textures storage which passes that
+///         don't overlap share.
+///
+/// \details Each frame, the passes are added with addPass(), and their
+///         accesses declared with read() and write(); then compile() and
+///         execute().  A read sees the last write declared before it, so
+///         passes declared in the order they'd be drawn in mean what they
+///         say, and two passes which write the same target stay in that
+///         order.  compile() puts each pass at the earliest level its
+///         dependencies allow, and runs the levels in turn, the passes of
+///         each in the order they were declared: a pass which needs nothing
+///         drawn before it, like skinning into a buffer, is hoisted to the
+///         front, so the GPU has the most other work to overlap it with.
+///
+///         Framebuffer, transform feedback and upload writes are coherent
+///         in GL, but shader storage and image writes aren't, so after a
+///         pass writes a resource that way, the next pass to touch it is
+///         preceded by a glMemoryBarrier() for the way it's touched.
+///
+///         Resources are either imported, for buffers and targets which
+///         live longer than a frame, or transient textures, which the graph
+///         creates.  A transient only lives from the first pass which uses
+///         it to the last, so transients with the same description whose
+///         lives don't overlap share one texture.  GL can't place two
+///         textures of different formats in the same memory, so only equal
+///         descriptions are aliased.  The textures are kept from frame to
+///         frame, and any which a frame's graph didn't use are deleted, so
+///         a target that's switched off stops holding memory.
+///
+///         Must be used on the thread which owns the GL context.
+class FrameGraph
+{
+public:
+    typedef size_t ResourceId;
+    typedef size_t PassId;
+    typedef void (*PassFunction)(void* context);
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The ways a pass can touch a resource.
+    enum ResourceUsage
+    {
+        USAGE_VERTEX_ATTRIBUTES = 0,    ///< Read as vertex attributes.
+        USAGE_SHADER_STORAGE,           ///< Read or written as a shader storage buffer or image; writes are incoherent.
+        USAGE_TEXTURE,                  ///< Sampled.
+        USAGE_INDIRECT_COMMANDS,        ///< Read by an indirect draw or dispatch.
+        USAGE_READBACK,                 ///< Copied or mapped back to the CPU.
+        USAGE_FRAMEBUFFER,              ///< Drawn into, or blended with.
+        USAGE_TRANSFORM_FEEDBACK,       ///< Captured into.
+        USAGE_UPLOAD,                   ///< Written by the CPU.
+        N_RESOURCE_USAGES
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  What a transient texture holds.
+    struct TextureDesc
+    {
+        GLenum target;              ///< GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY.
+        GLenum internal_format;
+        GLsizei width;
+        GLsizei height;
+        GLsizei layers;             ///< 1 for GL_TEXTURE_2D.
+
+        bool operator==(const TextureDesc& other) const;
+    };
+
+    FrameGraph();
+    ~FrameGraph();
+
+    void reset();
+
+    ResourceId importResource(const char* name);
+    ResourceId createTexture(const char* name, const TextureDesc& desc);
+
+    PassId addPass(const char* name, PassFunction function, void* context);
+    void read(PassId pass, ResourceId resource, ResourceUsage usage);
+    void write(PassId pass, ResourceId resource, ResourceUsage usage);
+
+    void compile();
+    void execute();
+
+    GLuint getTexture(ResourceId resource) const;
+
+    size_t getPassCount() const;
+    size_t getTextureCount() const;
+    size_t getTransientBytes() const;
+
+private:
+    FrameGraph(const FrameGraph&);              // non-copyable
+    FrameGraph& operator=(const FrameGraph&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One of a pass's declared reads or writes.
+    struct Access
+    {
+        ResourceId resource;
+        ResourceUsage usage;
+        bool write;
+    };
+
+    struct Resource
+    {
+        const char* name;
+        bool transient;
+        TextureDesc desc;           ///< For transients.
+        size_t texture;             ///< The transient's index in textures_, once compiled.
+        size_t first_use;           ///< The first and last places in order_ the resource is touched.
+        size_t last_use;
+    };
+
+    struct Pass
+    {
+        const char* name;           ///< A string literal, which the trace can keep.
+        PassFunction function;
+        void* context;
+        std::vector<Access> accesses;
+        size_t level;               ///< One more than the deepest pass it depends on.
+        GLbitfield barriers;        ///< What has to be waited for before it runs.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A texture the transients are given, kept between frames.
+    struct Texture
+    {
+        TextureDesc desc;
+        GLuint texture_id;
+        size_t free_from;           ///< The place in order_ after the last pass using it this frame.
+        bool used;                  ///< Given to a transient this frame.
+    };
+
+    void addAccess(PassId pass, ResourceId resource, ResourceUsage usage, bool write);
+    void schedule();
+    void placeBarriers();
+    void assignTextures();
+
+    static GLbitfield getBarrierBits(ResourceUsage usage);
+    static size_t getTextureBytes(const TextureDesc& desc);
+
+    std::vector<Resource> resources_;
+    std::vector<Pass> passes_;
+    std::vector<PassId> order_;     ///< The passes in the order they run.
+    std::vector<Texture> textures_;
+    bool compiled_;
+};
+
+#endif
@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_packet.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of FramePacket and FramePacketBuffer functions.
+
+#include "frame_packet.h"
+
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty packet.
+FramePacket::FramePacket()
+    : serial(0),
+      skinning_mode(SKINNING_MODE_SEPARATE),
+      compare_mode(N_SKINNING_MODES),
+      animating(false),
+      block_version(0),
+      palette_stream_buffer_id(0),
+      streamed_palettes(nullptr),
+      streamed_palette_capacity(0),
+      palettes_streamed(false),
+      instance_palette_count(0),
+      half_palettes_packed(false),
+      hierarchy_on_gpu(false),
+      occlusion_culled(false),
+      baked_time(0),
+      pose_milliseconds(0),
+      palette_milliseconds(0),
+      joints_evaluated(0),
+      arena_high_water_bytes(0),
+      input_milliseconds(0),
+      posed_milliseconds(0)
+{
+}
+
+const size_t FramePacketBuffer::N_PACKETS;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a buffer which hasn't had anything published yet.
+FramePacketBuffer::FramePacketBuffer()
+    : write_index_(0),
+      read_index_(1),
+      has_packet_(false),
+      published_(2)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the packet the writer should fill in next.  Its contents
+///         are whatever was written into it three or more frames ago.
+FramePacket& FramePacketBuffer::getWritePacket()
+{
+    return packets_[write_index_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Publishes the packet returned by getWritePacket(), and gives the
+///         writer a different packet to fill in next.
+void FramePacketBuffer::publish()
+{
+    write_index_ = published_.exchange(write_index_ | FRESH) & ~FRESH;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves the reader on to the most recently published packet, if
+///         it hasn't already acquired it.
+///
+/// \return true if there was a new packet.
+bool FramePacketBuffer::acquire()
+{
+    if ((published_.load() & FRESH) == 0)
+        return false;
+
+    read_index_ = published_.exchange(read_index_) & ~FRESH;
+    has_packet_ = true;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if acquire() would move the reader on to a new
+///         packet.  Only the reader may call this, and it stays true until
+///         the reader acquires the packet.
+bool FramePacketBuffer::hasFreshPacket() const
+{
+    return (published_.load() & FRESH) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the packet the reader acquired most recently.  It's only
+///         valid once hasPacket() is true.
+FramePacket& FramePacketBuffer::getReadPacket()
+{
+    return packets_[read_index_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the packet the reader acquired most recently.  It's only
+///         valid once hasPacket() is true.
+const FramePacket& FramePacketBuffer::getReadPacket() const
+{
+    return packets_[read_index_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the reader has acquired any packet yet.
+bool FramePacketBuffer::hasPacket() const
+{
+    return has_packet_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns one of the packets, whoever has it.  This is only for
+///         setting packets up before the writer starts, like giving each
+///         one its own buffers.
+FramePacket& FramePacketBuffer::getPacket(size_t index)
+{
+    assert(index < N_PACKETS);
+    return packets_[index];
+}
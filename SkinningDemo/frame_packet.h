@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_packet.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the FramePacket struct and FramePacketBuffer
+///         class.
+
+#ifndef FRAME_PACKET_H_
+#define FRAME_PACKET_H_
+
+#include "camera.h"
+#include "debug_draw.h"
+#include "hierarchy_compute_pass.h"
+#include "palette.h"
+#include "pose_space_correctives.h"
+#include <atomic>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Identifies the ways the vertex shader can receive joint
+///         transforms.
+enum SkinningMode
+{
+    SKINNING_MODE_SEPARATE = 0, ///< Upload current_pose and bind_pose_inv separately.
+    SKINNING_MODE_PALETTE,      ///< Upload a single precombined skinning palette.
+    SKINNING_MODE_DUAL_QUAT,    ///< Upload the palette as dual quaternions.
+    SKINNING_MODE_AFFINE_2D,    ///< Upload the palette as 2D affine transforms, 6 floats per joint.
+    SKINNING_MODE_INSTANCED,    ///< Draw a crowd of instances with palettes in a texture buffer.
+    SKINNING_MODE_COMPUTE,      ///< Skin the crowd with a compute shader; only available on GL 4.3.
+    SKINNING_MODE_CPU,          ///< Skin on the CPU with a thread pool, and stream the results to a VBO.
+    SKINNING_MODE_BAKED,        ///< Draw a crowd playing the clip from a texture of baked palettes.
+    SKINNING_MODE_TEXTURE_PALETTE,  ///< Read the precombined palette from a texture buffer, so any number of joints fit.
+    N_SKINNING_MODES
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Everything the render thread needs to draw one frame, as
+///         produced by the simulation thread.
+///
+/// \details Only the streams used by skinning_mode and compare_mode are
+///         filled in; the rest keep whatever an older frame left in them.
+///         Once published, a packet isn't changed until the renderer has
+///         moved on to a newer one.
+struct FramePacket
+{
+    FramePacket();
+
+    size_t serial;                          ///< The simulation request this frame answers.
+    SkinningMode skinning_mode;
+    SkinningMode compare_mode;              ///< What the right half of the scene is drawn with, or N_SKINNING_MODES.
+    Camera camera;                          ///< What the frame is seen through, and the crowd was culled against.
+    bool animating;                         ///< The simulation will keep changing without any new input.
+
+    std::vector<mat4> joint_transforms;     ///< The pose's local-to-model transforms, for SKINNING_MODE_SEPARATE.
+    std::vector<mat4> skinning_palette;     ///< For SKINNING_MODE_PALETTE, SKINNING_MODE_CPU and SKINNING_MODE_TEXTURE_PALETTE.
+    std::vector<DualQuat> dual_quat_palette;///< For SKINNING_MODE_DUAL_QUAT.
+    std::vector<float> palette_scales;      ///< For SKINNING_MODE_DUAL_QUAT.
+    std::vector<Affine2D> affine_palette;   ///< For SKINNING_MODE_AFFINE_2D.
+    std::vector<color4> colors;             ///< The pose's joint colors.
+    std::vector<MorphActivation> morph_activations; ///< The corrective morph targets the pose activates.
+    size_t block_version;                   ///< Changes whenever the SkinningPalette block's contents, or the palette texture's, do.
+
+    std::vector<mat4> instance_palettes;    ///< Every instance's palette, for the crowd modes, packed by level of detail.
+    std::vector<GLuint> visible_instances;  ///< The crowd's draw list.
+    std::vector<GLuint> instance_lods;      ///< The level of detail each instance is drawn at.
+    std::vector<GLuint> instance_impostors; ///< Whether each instance is drawn as an impostor, rather than posed and skinned.
+    std::vector<vec4> impostors;            ///< The impostors in view: 3 texels each, their x and y axes and origin, with the frame in w.
+    std::vector<GLuint> instance_slots;     ///< Each instance's palette, counting from the first of its level's.
+    std::vector<GLuint> instance_palette_generations;   ///< Each visible instance's palette generation, which moves on whenever its staged palette changes.
+    std::vector<float> instance_depths;     ///< Each visible instance's depth from 0 to 1, to order its draws by; unless the GPU culls.
+    std::vector<size_t> lod_instance_counts;///< The number of instances drawn at each level of detail.
+    std::vector<size_t> lod_palette_offsets;///< Where each level's palettes start in instance_palettes, in matrices.
+    std::vector<size_t> lod_variant_counts; ///< The number of instances of each variant drawn at each level, by level then variant.
+    std::vector<size_t> lod_variant_first_slots;    ///< The slot of the first instance of each variant at each level, likewise.
+    GLuint palette_stream_buffer_id;        ///< The packet's own buffer for the crowd's palettes, if it has one; see PaletteStream.
+    mat4* streamed_palettes;                ///< The buffer's mapping, while the writer may be filling it in, or null.
+    size_t streamed_palette_capacity;       ///< The number of matrices the buffer holds.
+    bool palettes_streamed;                 ///< The crowd's palettes went into the buffer, laid out like instance_palettes, rather than into instance_palettes.
+    size_t instance_palette_count;          ///< The number of matrices in the crowd's palettes, wherever they went.
+    std::vector<size_t> lod_instance_offsets;///< Where each level's instances start in instance_origins.
+    std::vector<glm::hvec4> half_palettes;  ///< instance_palettes packed into 3 rows of half floats per matrix, when half_palettes_packed.
+    std::vector<vec4> instance_origins;     ///< What each instance's half_palettes translations are relative to, by level and slot.
+    bool half_palettes_packed;              ///< The instanced crowd's palettes all fit in half_palettes, within packHalfPalette()'s guard.
+    bool hierarchy_on_gpu;                  ///< The compute crowd's palettes are built on the GPU from leader_locals, rather than sent in instance_palettes.
+    std::vector<vec4> leader_locals;        ///< The visible instances' leaders' compact local transforms, a skeleton's worth each.
+    std::vector<HierarchyComputePass::PaletteTarget> palette_targets;  ///< Each visible instance, its leader in leader_locals and its placement.
+    bool occlusion_culled;                  ///< The crowd, or the mesh, was culled by occlusion queries; see OcclusionQueries.
+    std::vector<GLuint> occlusion_candidates;   ///< The instances in view, whose proxies are queried, hidden or not.
+    std::vector<mat4> proxy_transforms;     ///< Each instance's proxy for its query, then the mesh's; see OcclusionQueries::getProxyTransform().
+    float baked_time;                       ///< The baked crowd's time in the clip, for SKINNING_MODE_BAKED.
+    BoundingBox joint_box_bounds;           ///< The mesh's, or the visible crowd's, bounds from its joint boxes, in world space; empty if unknown.
+
+    DebugGeometry debug_geometry;           ///< The joints, if they're being drawn.
+
+    double pose_milliseconds;               ///< CPU time spent posing the skeleton and the crowd.
+    double palette_milliseconds;            ///< CPU time spent building the palettes.
+    size_t joints_evaluated;                ///< Joints whose transforms were recomputed, the crowd's included.
+    size_t arena_high_water_bytes;          ///< The simulation_arena's high-water mark.
+    double input_milliseconds;              ///< When the oldest input event the frame answers arrived, or 0; for -latency.
+    double posed_milliseconds;              ///< When the simulation thread finished the frame; for -latency.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Hands frame packets from one writing thread to one reading
+///         thread, without either ever waiting for the other.
+///
+/// \details There are three packets: the writer fills in one, the reader
+///         draws from another, and the third is the most recently published.
+///         Publishing swaps the writer's packet with the published one, and
+///         acquiring swaps the reader's packet with the published one if it's
+///         newer, so the reader always gets the latest frame and the writer
+///         never overwrites a packet the reader is still using.  If the writer
+///         publishes more than once between acquisitions, the older frames
+///         are simply dropped.
+class FramePacketBuffer
+{
+public:
+    FramePacketBuffer();
+
+    FramePacket& getWritePacket();
+    void publish();
+
+    bool acquire();
+    bool hasFreshPacket() const;
+    FramePacket& getReadPacket();
+    const FramePacket& getReadPacket() const;
+    bool hasPacket() const;
+
+    static const size_t N_PACKETS = 3;
+    FramePacket& getPacket(size_t index);
+
+private:
+    FramePacketBuffer(const FramePacketBuffer&);            // non-copyable
+    FramePacketBuffer& operator=(const FramePacketBuffer&); // non-copyable
+
+    static const unsigned FRESH = 4;    ///< Set in published_ when that packet hasn't been acquired yet.
+
+    FramePacket packets_[N_PACKETS];
+    unsigned write_index_;              ///< Only used by the writer.
+    unsigned read_index_;               ///< Only used by the reader.
+    bool has_packet_;                   ///< The reader has acquired at least one packet.
+    std::atomic<unsigned> published_;   ///< The index of the published packet, plus FRESH.
+};
+
+#endif
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_scheduler.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of FrameScheduler class functions.
+
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an idle scheduler.
+///
+/// \param  step_milliseconds The simulated time each animation step covers.
+/// \param  max_steps_per_frame The most steps a single frame may run.  If
+///         frames fall further behind than this, for instance while the
+///         window is being dragged, the extra time is dropped rather than
+///         simulated, so a slow frame can't make the next one slower.
+FrameScheduler::FrameScheduler(double step_milliseconds, size_t max_steps_per_frame)
+    : step_ms_(step_milliseconds),
+      max_steps_(std::max(max_steps_per_frame, size_t(1))),
+      min_frame_interval_ms_(step_milliseconds),
+      frame_requested_(false),
+      idle_(true),
+      last_frame_time_(0),
+      accumulator_ms_(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the least time allowed between the starts of two frames.
+///
+/// \details Defaults to the animation step.  Set it to 0 when the swap
+///         interval already paces frames to the display's refresh rate.
+void FrameScheduler::setMinFrameInterval(double milliseconds)
+{
+    min_frame_interval_ms_ = std::max(milliseconds, 0.0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the least time allowed between the starts of two frames.
+double FrameScheduler::getMinFrameInterval() const
+{
+    return min_frame_interval_ms_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Asks for a frame to be drawn as soon as the frame interval
+///         allows.  Requests made before it starts are all served by it.
+void FrameScheduler::requestFrame()
+{
+    frame_requested_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a frame has been requested since the last one
+///         began.
+bool FrameScheduler::isFrameRequested() const
+{
+    return frame_requested_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how long to wait before the requested frame may begin,
+///         or 0 if it may begin right away.
+///
+/// \param  now The current time in milliseconds, from getTimeMilliseconds().
+double FrameScheduler::getMillisecondsUntilFrame(double now) const
+{
+    if (idle_)
+        return 0;
+
+    return std::max(last_frame_time_ + min_frame_interval_ms_ - now, 0.0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts a frame: consumes the outstanding request, and advances
+///         the clock.
+///
+/// \param  now The current time in milliseconds, from getTimeMilliseconds().
+/// \return The number of fixed steps the animation must advance before this
+///         frame is drawn.
+size_t FrameScheduler::beginFrame(double now)
+{
+    // after an idle period, the time spent idle isn't simulated.
+    double elapsed = idle_ ? step_ms_ : now - last_frame_time_;
+    elapsed = std::min(std::max(elapsed, 0.0), step_ms_ * max_steps_);
+
+    frame_requested_ = false;
+    idle_ = false;
+    last_frame_time_ = now;
+    accumulator_ms_ += elapsed;
+
+    size_t steps = std::min(size_t(accumulator_ms_ / step_ms_), max_steps_);
+    accumulator_ms_ = std::min(accumulator_ms_ - steps * step_ms_, step_ms_);
+    return steps;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finishes a frame.  If nothing requested another frame while it
+///         was being drawn, the scheduler goes idle.
+void FrameScheduler::endFrame()
+{
+    idle_ = !frame_requested_;
+    if (idle_)
+        accumulator_ms_ = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how far the clock is past the last step, as a fraction
+///         of a step from 0 to 1.
+double FrameScheduler::getInterpolation() const
+{
+    return std::min(accumulator_ms_ / step_ms_, 1.0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the simulated time each animation step covers.
+double FrameScheduler::getStepSeconds() const
+{
+    return step_ms_ / 1000.0;
+}
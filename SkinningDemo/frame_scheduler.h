@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_scheduler.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the FrameScheduler class.
+
+#ifndef FRAME_SCHEDULER_H_
+#define FRAME_SCHEDULER_H_
+
+#include "demo.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decides when frames are drawn, and how far the animation
+///         advances in each.
+///
+/// \details Input handlers and anything else which changes the scene call
+///         requestFrame() instead of drawing; any number of requests made
+///         before the next frame is drawn are coalesced into that one frame.
+///         Frames are never started closer together than the minimum frame
+///         interval, so a flood of mouse events can't drive the frame rate
+///         past the display's.
+///
+///         Animation advances in fixed steps of simulated time, however far
+///         apart frames are actually drawn.  beginFrame() returns how many
+///         steps to run to catch up with the clock, and getInterpolation()
+///         how far the clock is past the last of them, for drawing a state
+///         blended between the last two steps.
+///
+///         When no frame has been requested, nothing is drawn at all; the
+///         clock is held, so the first frame after an idle period only
+///         advances by a single step.
+class FrameScheduler
+{
+public:
+    explicit FrameScheduler(double step_milliseconds = 1000.0 / 60.0, size_t max_steps_per_frame = 5);
+
+    void setMinFrameInterval(double milliseconds);
+    double getMinFrameInterval() const;
+
+    void requestFrame();
+    bool isFrameRequested() const;
+    double getMillisecondsUntilFrame(double now) const;
+
+    size_t beginFrame(double now);
+    void endFrame();
+    double getInterpolation() const;
+    double getStepSeconds() const;
+
+private:
+    double step_ms_;
+    size_t max_steps_;
+    double min_frame_interval_ms_;
+
+    bool frame_requested_;
+    bool idle_;                 ///< No frame had been requested when the last one ended.
+    double last_frame_time_;    ///< When the last frame began, in milliseconds.
+    double accumulator_ms_;     ///< Elapsed time not yet consumed by a step.
+};
+
+#endif
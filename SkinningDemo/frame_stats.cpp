@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_stats.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of FrameStats and FrameStatsLog functions.
+
+#include "frame_stats.h"
+
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates stats for a frame which did nothing.
+FrameStats::FrameStats()
+    : frame(0),
+      vertices_skinned(0),
+      joints_evaluated(0),
+      palettes_uploaded(0),
+      palette_bytes_uploaded(0),
+      draw_calls(0),
+      state_changes(0),
+      state_changes_skipped(0),
+      instances_culled(0),
+      arena_high_water_bytes(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records the GPU time of a pass.
+void FrameStats::addGpuPass(const char* name, double milliseconds)
+{
+    PassTime pass;
+    pass.name = name;
+    pass.milliseconds = milliseconds;
+    gpu_passes.push_back(pass);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Opens the log, replacing anything already there.
+///
+/// \param  path The file to write.
+/// \param  interval_frames The number of frames each line covers.
+FrameStatsLog::FrameStatsLog(const std::string& path, size_t interval_frames)
+    : file_(std::fopen(path.c_str(), "w")),
+      interval_frames_(interval_frames > 0 ? interval_frames : 1),
+      frame_count_(0)
+{
+    if (file_ == nullptr)
+    {
+        std::cerr << "Failed to open stats log " << path << " for writing!" << std::endl;
+        throw std::runtime_error("Failed to open stats log!");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Closes the log.  Frames since the last line aren't written.
+FrameStatsLog::~FrameStatsLog()
+{
+    std::fclose(file_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a frame's stats, writing a line if that completes an
+///         interval.  Every frame must have the same passes, in the same
+///         order.
+void FrameStatsLog::add(const FrameStats& stats)
+{
+    if (frame_count_ == 0)
+    {
+        totals_ = FrameStats();
+        totals_.gpu_passes = stats.gpu_passes;
+        for (size_t i = 0; i < totals_.gpu_passes.size(); ++i)
+            totals_.gpu_passes[i].milliseconds = 0;
+    }
+
+    totals_.frame = stats.frame;
+    totals_.vertices_skinned += stats.vertices_skinned;
+    totals_.joints_evaluated += stats.joints_evaluated;
+    totals_.palettes_uploaded += stats.palettes_uploaded;
+    totals_.palette_bytes_uploaded += stats.palette_bytes_uploaded;
+    totals_.draw_calls += stats.draw_calls;
+    totals_.state_changes += stats.state_changes;
+    totals_.state_changes_skipped += stats.state_changes_skipped;
+    totals_.instances_culled += stats.instances_culled;
+    totals_.arena_high_water_bytes = stats.arena_high_water_bytes;
+    for (size_t i = 0; i < totals_.gpu_passes.size() && i < stats.gpu_passes.size(); ++i)
+        totals_.gpu_passes[i].milliseconds += stats.gpu_passes[i].milliseconds;
+
+    if (++frame_count_ == interval_frames_)
+    {
+        write();
+        frame_count_ = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the interval's line.
+void FrameStatsLog::write()
+{
+    double n = double(frame_count_);
+    std::fprintf(file_, "{\"frame\":%lu,\"frames\":%lu", (unsigned long)totals_.frame, (unsigned long)frame_count_);
+    std::fprintf(file_, ",\"vertices_skinned\":%.1f,\"joints_evaluated\":%.1f",
+                 totals_.vertices_skinned / n, totals_.joints_evaluated / n);
+    std::fprintf(file_, ",\"palettes_uploaded\":%.1f,\"palette_bytes_uploaded\":%.1f",
+                 totals_.palettes_uploaded / n, totals_.palette_bytes_uploaded / n);
+    std::fprintf(file_, ",\"draw_calls\":%.1f,\"state_changes\":%.1f,\"state_changes_skipped\":%.1f",
+                 totals_.draw_calls / n, totals_.state_changes / n, totals_.state_changes_skipped / n);
+    std::fprintf(file_, ",\"instances_culled\":%.1f,\"arena_high_water_bytes\":%lu",
+                 totals_.instances_culled / n, (unsigned long)totals_.arena_high_water_bytes);
+
+    std::fputs(",\"gpu_milliseconds\":{", file_);
+    for (size_t i = 0; i < totals_.gpu_passes.size(); ++i)
+    {
+        std::fprintf(file_, "%s\"%s\":%.4f", i == 0 ? "" : ",", totals_.gpu_passes[i].name,
+                     totals_.gpu_passes[i].milliseconds / n);
+    }
+    std::fputs("}}\n", file_);
+    std::fflush(file_);
+}
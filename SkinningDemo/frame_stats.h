@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  frame_stats.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the FrameStats struct and FrameStatsLog class.
+
+#ifndef FRAME_STATS_H_
+#define FRAME_STATS_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  What the engine did to draw one frame.
+///
+/// \details The counters describe the work, not how long it took, so a
+///         frame time regression can be told apart from a change in
+///         content: twice the vertices skinned is a different problem from
+///         the same vertices taking twice as long.  The times are the GPU's
+///         own, per pass, from GpuTimers, so they're a couple of frames
+///         behind the counters.
+struct FrameStats
+{
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The GPU time of one pass.
+    struct PassTime
+    {
+        const char* name;           ///< Must outlive the stats, like a string literal.
+        double milliseconds;
+    };
+
+    FrameStats();
+
+    size_t frame;                   ///< Counts the frames drawn, from 1.
+    size_t vertices_skinned;        ///< Counting each vertex once for every instance drawn with it.
+    size_t joints_evaluated;        ///< Joints whose local-to-model transforms were recomputed.
+    size_t palettes_uploaded;       ///< Whole skinning palettes handed to the GPU, however they got there.
+    size_t palette_bytes_uploaded;
+    size_t draw_calls;              ///< Draw and multi-draw calls, and transform feedback captures.
+    size_t state_changes;           ///< GL binds made through the GLStateCache.
+    size_t state_changes_skipped;   ///< Binds the GLStateCache saw were already in place.
+    size_t instances_culled;        ///< Crowd instances which were culled on the CPU, and never drawn.
+    size_t arena_high_water_bytes;  ///< The most any frame has allocated from the simulation's frame arena.
+    std::vector<PassTime> gpu_passes;
+
+    void addGpuPass(const char* name, double milliseconds);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Appends a summary of the frame stats to a file every so many
+///         frames, one JSON object per line.
+///
+/// \details Each line covers the frames since the last one: the counters
+///         and pass times are averaged over them, and "frame" and
+///         "arena_high_water_bytes" are the last frame's.  Every line is
+///         flushed as it's written, so the file can be followed by a
+///         collector while the program runs; giving a named pipe as the
+///         path streams the lines straight to one.
+class FrameStatsLog
+{
+public:
+    FrameStatsLog(const std::string& path, size_t interval_frames);
+    ~FrameStatsLog();
+
+    void add(const FrameStats& stats);
+
+private:
+    FrameStatsLog(const FrameStatsLog&);            // non-copyable
+    FrameStatsLog& operator=(const FrameStatsLog&); // non-copyable
+
+    void write();
+
+    std::FILE* file_;
+    size_t interval_frames_;
+    size_t frame_count_;            ///< The frames in totals_ so far.
+    FrameStats totals_;             ///< The counters and pass times summed, and the last frame's frame and high water.
+};
+
+#endif
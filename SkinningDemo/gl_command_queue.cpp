@@ -0,0 +1,229 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  gl_command_queue.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of GLCommandQueue class functions.
+
+#include "gl_command_queue.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a byte count up to the next multiple of 16.
+size_t roundUp16(size_t bytes)
+{
+    return (bytes + 15) & ~size_t(15);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates an empty block.  new[] aligns it to 16 bytes on every
+///         platform the demo builds for.
+GLCommandQueue::Block::Block(size_t bytes)
+    : data(new char[bytes]),
+      used(0),
+      next(nullptr)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees the block, but not the ones after it.
+GLCommandQueue::Block::~Block()
+{
+    delete[] data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an arena with no blocks and no commands.
+GLCommandQueue::Arena::Arena()
+    : first(nullptr),
+      current(nullptr),
+      newest(nullptr),
+      writers(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty queue, with one block in each arena.
+///
+/// \param  block_bytes The size of each block; no command can be larger,
+///         arguments and all.
+GLCommandQueue::GLCommandQueue(size_t block_bytes)
+    : block_bytes_(roundUp16(block_bytes)),
+      open_arena_(0),
+      pending_(0),
+      block_count_(2)
+{
+    for (size_t i = 0; i < 2; ++i)
+    {
+        arenas_[i].first = new Block(block_bytes_);
+        arenas_[i].current.store(arenas_[i].first);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees the blocks.  Commands which were never drained are dropped,
+///         since there may no longer be a context to run them in, so the GL
+///         thread should drain() one last time first.
+GLCommandQueue::~GLCommandQueue()
+{
+    size_t pending = pending_.load();
+    if (pending > 0)
+        std::cerr << "Dropping " << pending << " GL commands which were never drained." << std::endl;
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        Block* block = arenas_[i].first;
+        while (block != nullptr)
+        {
+            Block* next = block->next.load();
+            delete block;
+            block = next;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a command for the GL thread.  Any thread may push at any
+///         time, including from a command being run by drain().
+///
+/// \param  function The function to run the command with.
+/// \param  arguments The function's arguments, which are copied; may be
+///         null if argument_bytes is 0.
+/// \param  argument_bytes The size of the arguments.
+void GLCommandQueue::push(GLCommandFunction function, const void* arguments, size_t argument_bytes)
+{
+    const size_t header_bytes = roundUp16(sizeof(Command));
+    size_t bytes = header_bytes + roundUp16(argument_bytes);
+    if (bytes > block_bytes_)
+    {
+        std::cerr << "A GL command with " << argument_bytes << " bytes of arguments doesn't fit in a "
+                  << block_bytes_ << " byte block." << std::endl;
+        throw std::runtime_error("GL command too large for the queue's blocks!");
+    }
+
+    for (;;)
+    {
+        // drain() may close the arena between reading which one is open and
+        // announcing the write, so check it's still open afterwards.
+        size_t index = open_arena_.load();
+        Arena& arena = arenas_[index];
+        ++arena.writers;
+        if (open_arena_.load() != index)
+        {
+            --arena.writers;
+            continue;
+        }
+
+        char* memory = static_cast<char*>(allocate(arena, bytes));
+        Command* command = reinterpret_cast<Command*>(memory);
+        command->function = function;
+        if (argument_bytes > 0)
+            std::memcpy(memory + header_bytes, arguments, argument_bytes);
+        command->next = arena.newest.exchange(command);
+
+        ++pending_;
+        --arena.writers;
+        return;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs every command pushed since the last drain(), in the order
+///         they were pushed.  Only the GL thread may call it.
+///
+/// \return The number of commands run.
+size_t GLCommandQueue::drain()
+{
+    size_t index = open_arena_.load();
+    open_arena_.store(1 - index);
+
+    // once nothing is writing into the closed arena, it's this thread's.
+    Arena& arena = arenas_[index];
+    while (arena.writers.load() != 0)
+        std::this_thread::yield();
+
+    // the list runs from the newest command back; turn it around.
+    Command* command = arena.newest.exchange(nullptr);
+    Command* oldest = nullptr;
+    while (command != nullptr)
+    {
+        Command* next = command->next;
+        command->next = oldest;
+        oldest = command;
+        command = next;
+    }
+
+    const size_t header_bytes = roundUp16(sizeof(Command));
+    size_t count = 0;
+    for (command = oldest; command != nullptr; command = command->next)
+    {
+        command->function(reinterpret_cast<char*>(command) + header_bytes);
+        ++count;
+    }
+
+    pending_ -= count;
+    reset(arena);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of commands pushed but not yet run.
+size_t GLCommandQueue::getPendingCount() const
+{
+    return pending_.load();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of blocks the arenas have grown to, between
+///         them.
+size_t GLCommandQueue::getBlockCount() const
+{
+    return block_count_.load();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reserves space for a command in an open arena, moving on to its
+///         next block, or adding one, if the current block is full.
+void* GLCommandQueue::allocate(Arena& arena, size_t bytes)
+{
+    for (;;)
+    {
+        Block* block = arena.current.load();
+        size_t offset = block->used.fetch_add(bytes);
+        if (offset + bytes <= block_bytes_)
+            return block->data + offset;
+
+        // whoever links a new block first wins; the others free theirs.
+        Block* next = block->next.load();
+        if (next == nullptr)
+        {
+            Block* added = new Block(block_bytes_);
+            if (block->next.compare_exchange_strong(next, added))
+            {
+                next = added;
+                ++block_count_;
+            }
+            else
+                delete added;
+        }
+
+        arena.current.compare_exchange_strong(block, next);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Empties a closed arena's blocks, for when it's next opened.
+void GLCommandQueue::reset(Arena& arena)
+{
+    for (Block* block = arena.first; block != nullptr; block = block->next.load())
+        block->used.store(0);
+    arena.current.store(arena.first);
+}
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  gl_command_queue.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the GLCommandQueue class.
+
+#ifndef GL_COMMAND_QUEUE_H_
+#define GL_COMMAND_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs a command on the GL thread, with its own copy of the
+///         arguments it was pushed with.
+typedef void (*GLCommandFunction)(void* arguments);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects commands from any number of threads, without locks, for
+///         the thread which owns the GL context to run.
+///
+/// \details Commands go into one of two arenas, each a chain of blocks which
+///         commands are bump-allocated from: a thread pushing a command
+///         reserves its space in the open arena with an atomic add, copies
+///         the arguments in, and links it onto the arena's list with an
+///         atomic exchange, so nothing is allocated per command and no
+///         thread ever waits for another.  A new block is only allocated
+///         when an arena's blocks are all full, and it's kept, so once the
+///         arenas have grown to the busiest frame's commands, pushing never
+///         allocates again.
+///
+///         The GL thread calls drain() at a fixed point each frame.  That
+///         swaps the arenas, so new commands go into the other one, waits
+///         for any thread still writing a command into the old one, which
+///         takes no longer than copying its arguments, and runs its commands
+///         in the order they were pushed.  Commands a command pushes are
+///         run by the next drain().
+///
+///         Arguments are copied as bytes, so they must be trivially
+///         copyable, and are aligned to 16 bytes.
+class GLCommandQueue
+{
+public:
+    explicit GLCommandQueue(size_t block_bytes = 16384);
+    ~GLCommandQueue();
+
+    void push(GLCommandFunction function, const void* arguments, size_t argument_bytes);
+    size_t drain();
+
+    size_t getPendingCount() const;
+    size_t getBlockCount() const;
+
+private:
+    GLCommandQueue(const GLCommandQueue&);              // non-copyable
+    GLCommandQueue& operator=(const GLCommandQueue&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A pushed command, followed by its arguments.
+    struct Command
+    {
+        Command* next;                  ///< The command pushed before it, in the same arena.
+        GLCommandFunction function;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A block commands are bump-allocated from.
+    struct Block
+    {
+        explicit Block(size_t bytes);
+        ~Block();
+
+        char* data;
+        std::atomic<size_t> used;       ///< Bytes reserved; may run past the end once it's full.
+        std::atomic<Block*> next;       ///< The block to move on to once it's full.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One of the two sets of blocks commands are pushed into.
+    struct Arena
+    {
+        Arena();
+
+        Block* first;
+        std::atomic<Block*> current;    ///< The block being allocated from.
+        std::atomic<Command*> newest;   ///< The last command pushed, or null.
+        std::atomic<size_t> writers;    ///< The threads which may be writing a command into the arena.
+    };
+
+    void* allocate(Arena& arena, size_t bytes);
+    void reset(Arena& arena);
+
+    size_t block_bytes_;
+    Arena arenas_[2];
+    std::atomic<size_t> open_arena_;    ///< The arena commands are pushed into now.
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> block_count_;
+};
+
+#endif
@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  gl_deletion_queue.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of GLDeletionQueue class functions.
+
+#include "gl_deletion_queue.h"
+
+#include <iostream>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The arguments of a queued deletion: the id, and the list of ids
+///         flush() deletes it with.
+struct QueuedDeletion
+{
+    std::vector<GLuint>* ids;
+    GLuint id;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a queued id to its list, as flush() drains the queue.
+void addQueuedDeletion(void* arguments)
+{
+    QueuedDeletion* deletion = static_cast<QueuedDeletion*>(arguments);
+    deletion->ids->push_back(deletion->id);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty queue.
+GLDeletionQueue::GLDeletionQueue()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the queue.  Anything still pending is leaked, since
+///         there may no longer be a context to delete it in, so the GL
+///         thread should flush() one last time first.
+GLDeletionQueue::~GLDeletionQueue()
+{
+    // draining only lists the ids, which needs no context.
+    commands_.drain();
+    size_t pending = flushing_vertex_arrays_.size() + flushing_buffers_.size() + flushing_textures_.size();
+    if (pending > 0)
+        std::cerr << "Leaking " << pending << " GL objects which were never flushed." << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a vertex array object for glDeleteVertexArrays().  0 is
+///         ignored.
+void GLDeletionQueue::deleteVertexArray(GLuint id)
+{
+    queue(flushing_vertex_arrays_, id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a buffer object for glDeleteBuffers().  0 is ignored.
+void GLDeletionQueue::deleteBuffer(GLuint id)
+{
+    queue(flushing_buffers_, id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a texture for glDeleteTextures().  0 is ignored.
+void GLDeletionQueue::deleteTexture(GLuint id)
+{
+    queue(flushing_textures_, id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Deletes everything queued so far.  Must be called on the thread
+///         which owns the GL context.
+///
+/// \details The vertex arrays are deleted before the buffers, so no buffer
+///         is deleted while a vertex array still refers to it.
+///
+/// \return The number of objects deleted.
+size_t GLDeletionQueue::flush()
+{
+    commands_.drain();
+
+    if (!flushing_vertex_arrays_.empty())
+        glDeleteVertexArrays(GLsizei(flushing_vertex_arrays_.size()), flushing_vertex_arrays_.data());
+    if (!flushing_buffers_.empty())
+        glDeleteBuffers(GLsizei(flushing_buffers_.size()), flushing_buffers_.data());
+    if (!flushing_textures_.empty())
+        glDeleteTextures(GLsizei(flushing_textures_.size()), flushing_textures_.data());
+
+    size_t count = flushing_vertex_arrays_.size() + flushing_buffers_.size() + flushing_textures_.size();
+    flushing_vertex_arrays_.clear();
+    flushing_buffers_.clear();
+    flushing_textures_.clear();
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of objects queued but not yet deleted.
+size_t GLDeletionQueue::getPendingCount() const
+{
+    return commands_.getPendingCount();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues an id to be added to one of the lists flush() deletes.
+///         0 is ignored.
+void GLDeletionQueue::queue(std::vector<GLuint>& ids, GLuint id)
+{
+    if (id == 0)
+        return;
+
+    QueuedDeletion deletion;
+    deletion.ids = &ids;
+    deletion.id = id;
+    commands_.push(&addQueuedDeletion, &deletion, sizeof(deletion));
+}
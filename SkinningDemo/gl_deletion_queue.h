@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  gl_deletion_queue.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the GLDeletionQueue class.
+
+#ifndef GL_DELETION_QUEUE_H_
+#define GL_DELETION_QUEUE_H_
+
+#include "demo.h"
+#include "gl_command_queue.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects GL objects to delete from any thread, and deletes them
+///         on the thread which owns the GL context.
+///
+/// \details Objects which own GL resources can only delete them with the
+///         context current, so one destroyed on a worker thread, or after
+///         whatever was drawing with it has moved on, hands its ids to a
+///         queue instead, and the GL thread calls flush() once a frame.
+///         Each kind of object is deleted with the call for that kind, all
+///         of that frame's ids in one call.
+///
+///         The ids are queued as commands on a GLCommandQueue, so queuing
+///         never takes a lock, and never waits on the GL thread or the
+///         driver; flush() drains the commands into one list of ids per
+///         kind, then deletes each list.
+class GLDeletionQueue
+{
+public:
+    GLDeletionQueue();
+    ~GLDeletionQueue();
+
+    void deleteVertexArray(GLuint id);
+    void deleteBuffer(GLuint id);
+    void deleteTexture(GLuint id);
+
+    size_t flush();
+    size_t getPendingCount() const;
+
+private:
+    GLDeletionQueue(const GLDeletionQueue&);            // non-copyable
+    GLDeletionQueue& operator=(const GLDeletionQueue&); // non-copyable
+
+    void queue(std::vector<GLuint>& ids, GLuint id);
+
+    GLCommandQueue commands_;
+
+    // only used by flush(), and kept between calls so their capacity is
+    // reused.
+    std::vector<GLuint> flushing_vertex_arrays_;
+    std::vector<GLuint> flushing_buffers_;
+    std::vector<GLuint> flushing_textures_;
+};
+
+#endif
@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  gl_state_cache.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of GLStateCache class functions.
+
+#include "gl_state_cache.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a cache which doesn't know any of the context's state
+///         yet.
+GLStateCache::GLStateCache()
+    : call_count_(0),
+      skipped_count_(0)
+{
+    invalidate();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forgets everything the cache has set, so that the next call of
+///         each kind goes through.  Call this after any code which changes
+///         the state without going through the cache.
+void GLStateCache::invalidate()
+{
+    program_known_ = false;
+    vao_known_ = false;
+    for (size_t i = 0; i < N_BUFFER_SLOTS; ++i)
+        buffer_known_[i] = false;
+    blend_known_ = false;
+    blend_func_known_ = false;
+    polygon_mode_known_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  glUseProgram(), unless the program is already in use.
+void GLStateCache::useProgram(GLuint program_id)
+{
+    if (skip(program_known_ && program_id_ == program_id))
+        return;
+
+    glUseProgram(program_id);
+    program_id_ = program_id;
+    program_known_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  glBindVertexArray(), unless the vertex array is already bound.
+void GLStateCache::bindVertexArray(GLuint vao_id)
+{
+    if (skip(vao_known_ && vao_id_ == vao_id))
+        return;
+
+    glBindVertexArray(vao_id);
+    vao_id_ = vao_id;
+    vao_known_ = true;
+
+    // each vertex array has its own element array buffer binding.
+    buffer_known_[BUFFER_SLOT_ELEMENT_ARRAY] = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  glBindBuffer(), unless the buffer is already bound to the target.
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer_id)
+{
+    BufferSlot slot = getBufferSlot(target);
+    if (slot == BUFFER_SLOT_UNTRACKED)
+    {
+        ++call_count_;
+        glBindBuffer(target, buffer_id);
+        return;
+    }
+
+    if (skip(buffer_known_[slot] && buffer_ids_[slot] == buffer_id))
+        return;
+
+    glBindBuffer(target, buffer_id);
+    buffer_ids_[slot] = buffer_id;
+    buffer_known_[slot] = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Enables or disables GL_BLEND, unless it already is.
+void GLStateCache::setBlend(bool enabled)
+{
+    if (skip(blend_known_ && blend_ == enabled))
+        return;
+
+    if (enabled)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+    blend_ = enabled;
+    blend_known_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  glBlendFunc(), unless the factors are already set.
+void GLStateCache::blendFunc(GLenum source_factor, GLenum destination_factor)
+{
+    if (skip(blend_func_known_ && blend_source_ == source_factor && blend_destination_ == destination_factor))
+        return;
+
+    glBlendFunc(source_factor, destination_factor);
+    blend_source_ = source_factor;
+    blend_destination_ = destination_factor;
+    blend_func_known_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  glPolygonMode() for both faces, unless it's already set.
+void GLStateCache::polygonMode(GLenum mode)
+{
+    if (skip(polygon_mode_known_ && polygon_mode_ == mode))
+        return;
+
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    polygon_mode_ = mode;
+    polygon_mode_known_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of calls made to the cache since the counts
+///         were last reset, including the skipped ones.
+size_t GLStateCache::getCallCount() const
+{
+    return call_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of calls the cache didn't pass on to GL since
+///         the counts were last reset.
+size_t GLStateCache::getSkippedCount() const
+{
+    return skipped_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Resets the call counts, typically once per frame.
+void GLStateCache::resetCounts()
+{
+    call_count_ = 0;
+    skipped_count_ = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a key which sorts draws so that those sharing a program
+///         are together, then those sharing a vertex array, then an index
+///         type, then a palette buffer, so that drawing them in order
+///         changes as little state as possible; and sorts the draws which
+///         share all of those front to back.
+///
+/// \details From the top, the key holds 16 bits of program, 12 of vertex
+///         array, 2 of index type, 10 of palette buffer and 24 of depth.
+///         The names GL hands out are small, so they rarely need more, but
+///         a key is only an order: two draws with equal state bits may
+///         still differ, and have to be compared field by field before
+///         they're drawn together.  SORT_KEY_STATE_MASK selects every bit
+///         but the depth's.
+///
+/// \param  program_id The program the draw uses.
+/// \param  vao_id The vertex array the draw uses, or any other small number
+///         which identifies it.
+/// \param  index_type GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+/// \param  palette_id The buffer or texture the draw's palettes are read
+///         from, or 0 if it doesn't matter.
+/// \param  depth The draw's depth from 0, at the near plane, to 1, at the far
+///         plane; it's clamped to that range.
+GLuint64 GLStateCache::makeSortKey(GLuint program_id, GLuint vao_id, GLenum index_type,
+                                   GLuint palette_id, float depth)
+{
+    // the index types are every other enum from GL_UNSIGNED_BYTE.
+    GLuint64 quantized_depth = GLuint64(std::min(std::max(depth, 0.0f), 1.0f) * float(0xffffff));
+    return (GLuint64(program_id & 0xffff) << 48) | (GLuint64(vao_id & 0xfff) << 36) |
+           (GLuint64(((index_type - GL_UNSIGNED_BYTE) >> 1) & 0x3) << 34) |
+           (GLuint64(palette_id & 0x3ff) << 24) | quantized_depth;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the slot a buffer target's binding is remembered in.
+GLStateCache::BufferSlot GLStateCache::getBufferSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:           return BUFFER_SLOT_ARRAY;
+    case GL_ELEMENT_ARRAY_BUFFER:   return BUFFER_SLOT_ELEMENT_ARRAY;
+    case GL_TEXTURE_BUFFER:         return BUFFER_SLOT_TEXTURE;
+    case GL_UNIFORM_BUFFER:         return BUFFER_SLOT_UNIFORM;
+    case GL_DRAW_INDIRECT_BUFFER:   return BUFFER_SLOT_DRAW_INDIRECT;
+    case GL_SHADER_STORAGE_BUFFER:  return BUFFER_SLOT_SHADER_STORAGE;
+    default:                        return BUFFER_SLOT_UNTRACKED;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Counts a call, and returns whether it should be skipped.
+bool GLStateCache::skip(bool unchanged)
+{
+    ++call_count_;
+    if (unchanged)
+        ++skipped_count_;
+    return unchanged;
+}
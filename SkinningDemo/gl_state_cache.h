@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  gl_state_cache.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the GLStateCache class.
+
+#ifndef GL_STATE_CACHE_H_
+#define GL_STATE_CACHE_H_
+
+#include "demo.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Remembers the program, vertex array, buffer bindings, blending
+///         and polygon mode it last set, and skips calls which wouldn't
+///         change them.
+///
+/// \details The cache only knows about the calls made through it.  Code
+///         which binds things itself (most of the demo's classes bind what
+///         they need and then unbind it) must be followed by invalidate(),
+///         or the cache will skip a bind that's actually needed.  Until the
+///         cache has set a piece of state once, it doesn't know its value,
+///         so the first call always goes through.
+///
+///         The element array buffer binding belongs to the vertex array, so
+///         it's forgotten whenever the vertex array changes.  Buffer
+///         targets the cache doesn't track are always bound.
+///
+///         Apart from the sort keys, everything must be called from the
+///         thread which owns the context.
+class GLStateCache
+{
+public:
+    GLStateCache();
+
+    void invalidate();
+
+    void useProgram(GLuint program_id);
+    void bindVertexArray(GLuint vao_id);
+    void bindBuffer(GLenum target, GLuint buffer_id);
+    void setBlend(bool enabled);
+    void blendFunc(GLenum source_factor, GLenum destination_factor);
+    void polygonMode(GLenum mode);
+
+    size_t getCallCount() const;
+    size_t getSkippedCount() const;
+    void resetCounts();
+
+    /// The bits of a makeSortKey() key which hold state, rather than depth.
+    static const GLuint64 SORT_KEY_STATE_MASK = ~GLuint64(0xffffff);
+
+    static GLuint64 makeSortKey(GLuint program_id, GLuint vao_id, GLenum index_type,
+                                GLuint palette_id = 0, float depth = 0.0f);
+
+private:
+    GLStateCache(const GLStateCache&);              // non-copyable
+    GLStateCache& operator=(const GLStateCache&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The buffer targets the cache tracks.
+    enum BufferSlot
+    {
+        BUFFER_SLOT_ARRAY = 0,
+        BUFFER_SLOT_ELEMENT_ARRAY,
+        BUFFER_SLOT_TEXTURE,
+        BUFFER_SLOT_UNIFORM,
+        BUFFER_SLOT_DRAW_INDIRECT,
+        BUFFER_SLOT_SHADER_STORAGE,
+        N_BUFFER_SLOTS,
+        BUFFER_SLOT_UNTRACKED = N_BUFFER_SLOTS
+    };
+
+    static BufferSlot getBufferSlot(GLenum target);
+    bool skip(bool unchanged);
+
+    // each of these is only meaningful while its known_ flag is set.
+    GLuint program_id_;
+    GLuint vao_id_;
+    GLuint buffer_ids_[N_BUFFER_SLOTS];
+    bool blend_;
+    GLenum blend_source_;
+    GLenum blend_destination_;
+    GLenum polygon_mode_;
+
+    bool program_known_;
+    bool vao_known_;
+    bool buffer_known_[N_BUFFER_SLOTS];
+    bool blend_known_;
+    bool blend_func_known_;
+    bool polygon_mode_known_;
+
+    size_t call_count_;
+    size_t skipped_count_;
+};
+
+#endif
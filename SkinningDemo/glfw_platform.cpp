@@ -0,0 +1,280 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  glfw_platform.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of GlfwPlatform class functions.
+
+#ifdef SKINNING_HAVE_GLFW
+
+#include "glfw_platform.h"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A GLFW window.  GLFW's callbacks find it through the window's
+///         user pointer.
+class GlfwWindow : public PlatformWindow
+{
+public:
+    GlfwWindow(GLFWwindow* window, GLsizei width, GLsizei height);
+    virtual ~GlfwWindow();
+
+    virtual void makeCurrent();
+    virtual void swapBuffers();
+    virtual bool setSwapInterval(int interval);
+    virtual void resize(GLsizei width, GLsizei height);
+
+    void deliverFirstReshape();
+
+private:
+    static GlfwWindow* get(GLFWwindow* window);
+    static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
+    static void refreshCallback(GLFWwindow* window);
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void charCallback(GLFWwindow* window, unsigned int codepoint);
+    static void cursorPosCallback(GLFWwindow* window, double x, double y);
+    static void closeCallback(GLFWwindow* window);
+
+    void reportKey(unsigned char key);
+
+    GLFWwindow* window_;
+    bool first_reshape_pending_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports GLFW's errors to stderr as they happen.
+void errorCallback(int error, const char* description)
+{
+    std::cerr << "GLFW error 0x" << std::hex << error << std::dec << ": " << description << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes over a GLFW window, registering for its events, and makes
+///         its context current.
+GlfwWindow::GlfwWindow(GLFWwindow* window, GLsizei width, GLsizei height)
+    : PlatformWindow(width, height),
+      window_(window),
+      first_reshape_pending_(true)
+{
+    glfwSetWindowUserPointer(window_, this);
+    glfwSetFramebufferSizeCallback(window_, framebufferSizeCallback);
+    glfwSetWindowRefreshCallback(window_, refreshCallback);
+    glfwSetKeyCallback(window_, keyCallback);
+    glfwSetCharCallback(window_, charCallback);
+    glfwSetCursorPosCallback(window_, cursorPosCallback);
+    glfwSetWindowCloseCallback(window_, closeCallback);
+    makeCurrent();
+}
+
+GlfwWindow::~GlfwWindow()
+{
+    glfwDestroyWindow(window_);
+}
+
+void GlfwWindow::makeCurrent()
+{
+    glfwMakeContextCurrent(window_);
+}
+
+void GlfwWindow::swapBuffers()
+{
+    glfwSwapBuffers(window_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the number of display refreshes each buffer swap waits for.
+///         GLFW doesn't say whether the driver honoured it.
+bool GlfwWindow::setSwapInterval(int interval)
+{
+    makeCurrent();
+    glfwSwapInterval(interval);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Asks for a new size.  The reshape is reported once the window
+///         system has resized the framebuffer.
+void GlfwWindow::resize(GLsizei width, GLsizei height)
+{
+    glfwSetWindowSize(window_, width, height);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports the framebuffer's size the first time events are waited
+///         for, once the window's callbacks have been set, as GLUT does.
+void GlfwWindow::deliverFirstReshape()
+{
+    if (!first_reshape_pending_)
+        return;
+
+    first_reshape_pending_ = false;
+    int width, height;
+    glfwGetFramebufferSize(window_, &width, &height);
+    makeCurrent();
+    notifyReshape(width, height);
+}
+
+GlfwWindow* GlfwWindow::get(GLFWwindow* window)
+{
+    return static_cast<GlfwWindow*>(glfwGetWindowUserPointer(window));
+}
+
+void GlfwWindow::framebufferSizeCallback(GLFWwindow* window, int width, int height)
+{
+    GlfwWindow* self = get(window);
+    self->first_reshape_pending_ = false;
+    self->makeCurrent();
+    self->notifyReshape(width, height);
+}
+
+void GlfwWindow::refreshCallback(GLFWwindow* window)
+{
+    get(window)->postRedisplay();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports the keys which don't type a character with their ASCII
+///         control codes.
+void GlfwWindow::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action == GLFW_RELEASE)
+        return;
+
+    GlfwWindow* self = get(window);
+    switch (key)
+    {
+        case GLFW_KEY_ESCAPE:
+            self->reportKey(27);
+            break;
+        case GLFW_KEY_ENTER:
+            self->reportKey('\r');
+            break;
+        case GLFW_KEY_TAB:
+            self->reportKey('\t');
+            break;
+        case GLFW_KEY_BACKSPACE:
+            self->reportKey('\b');
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports typed characters, as long as they're ASCII.
+void GlfwWindow::charCallback(GLFWwindow* window, unsigned int codepoint)
+{
+    if (codepoint < 128)
+        get(window)->reportKey((unsigned char)codepoint);
+}
+
+void GlfwWindow::cursorPosCallback(GLFWwindow* window, double x, double y)
+{
+    GlfwWindow* self = get(window);
+    self->makeCurrent();
+    self->notifyMouseMove(int(x), int(y));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a close request.  GLFW leaves the window open, so its
+///         context outlives the callback until the window is destroyed.
+void GlfwWindow::closeCallback(GLFWwindow* window)
+{
+    GlfwWindow* self = get(window);
+    self->makeCurrent();
+    self->notifyClose();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Calls the keyboard callback with the cursor's position.
+void GlfwWindow::reportKey(unsigned char key)
+{
+    double x, y;
+    glfwGetCursorPos(window_, &x, &y);
+    makeCurrent();
+    notifyKeyboard(key, int(x), int(y));
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Initializes GLFW.
+///
+/// \return null if GLFW couldn't be initialized, for instance because
+///         there's no display; GLFW's error has been reported to stderr.
+GlfwPlatform* GlfwPlatform::create()
+{
+    glfwSetErrorCallback(errorCallback);
+    if (!glfwInit())
+        return nullptr;
+
+    return new GlfwPlatform();
+}
+
+GlfwPlatform::GlfwPlatform()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the windows before terminating GLFW, which would
+///         otherwise destroy them from under their PlatformWindows.
+GlfwPlatform::~GlfwPlatform()
+{
+    while (getWindowCount() > 0)
+        destroyWindow(getWindow(getWindowCount() - 1));
+    glfwTerminate();
+}
+
+PlatformType GlfwPlatform::getType() const
+{
+    return PLATFORM_GLFW;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Delivers the pending events, waiting up to the timeout for one if
+///         there's nothing to draw.
+///
+/// \param  timeout_milliseconds How long to wait, or a negative number to
+///         wait for the next event.
+void GlfwPlatform::waitEvents(double timeout_milliseconds)
+{
+    bool redisplay_posted = false;
+    for (size_t i = 0; i < getWindowCount(); ++i)
+    {
+        static_cast<GlfwWindow*>(getWindow(i))->deliverFirstReshape();
+        redisplay_posted = redisplay_posted || getWindow(i)->isRedisplayPosted();
+    }
+
+    if (redisplay_posted || timeout_milliseconds == 0)
+        glfwPollEvents();
+    else if (timeout_milliseconds < 0)
+        glfwWaitEvents();
+    else
+        glfwWaitEventsTimeout(timeout_milliseconds / 1000.0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a window with a compatibility profile context, which
+///         is told about resets where the driver can do that; GLFW leaves
+///         the request out where it can't.
+std::unique_ptr<PlatformWindow> GlfwPlatform::openWindow(const WindowDesc& desc)
+{
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_DOUBLEBUFFER, desc.double_buffered ? GLFW_TRUE : GLFW_FALSE);
+    glfwWindowHint(GLFW_VISIBLE, desc.visible ? GLFW_TRUE : GLFW_FALSE);
+    glfwWindowHint(GLFW_DEPTH_BITS, 24);
+    glfwWindowHint(GLFW_CONTEXT_ROBUSTNESS, GLFW_LOSE_CONTEXT_ON_RESET);
+
+    GLFWwindow* window = glfwCreateWindow(desc.width, desc.height, desc.title.c_str(), nullptr, nullptr);
+    if (window == nullptr)
+        return std::unique_ptr<PlatformWindow>();
+    if (desc.x >= 0 && desc.y >= 0)
+        glfwSetWindowPos(window, desc.x, desc.y);
+
+    return std::unique_ptr<PlatformWindow>(new GlfwWindow(window, desc.width, desc.height));
+}
+
+#endif
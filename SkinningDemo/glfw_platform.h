@@ -0,0 +1,43 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  glfw_platform.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the GlfwPlatform class.
+
+#ifndef GLFW_PLATFORM_H_
+#define GLFW_PLATFORM_H_
+
+#include "platform.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A Platform on GLFW 3.2 or later, which makes native windows and
+///         contexts on Windows, X11, Wayland and macOS.
+///
+/// \details Unlike GLUT, GLFW can wait on its event queue with a timeout,
+///         so an idle RenderLoop sleeps until the next event or timer.
+///         Windows get compatibility profile contexts, since the demo's
+///         overlay uses the fixed function pipeline; GLFW has no fonts, so
+///         drawText() draws nothing.
+///
+///         Key presses reach the keyboard callback as the characters they
+///         type, plus Escape, Enter, Tab and Backspace as their ASCII
+///         control codes, as GLUT reports them.
+class GlfwPlatform : public Platform
+{
+public:
+    static GlfwPlatform* create();
+    virtual ~GlfwPlatform();
+
+    virtual PlatformType getType() const;
+
+    virtual void waitEvents(double timeout_milliseconds);
+
+protected:
+    virtual std::unique_ptr<PlatformWindow> openWindow(const WindowDesc& desc);
+
+private:
+    GlfwPlatform();
+};
+
+#endif
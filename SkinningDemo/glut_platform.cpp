@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  glut_platform.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of GlutPlatform class functions.
+
+#include "glut_platform.h"
+
+#include <GL/freeglut.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <GL/wglew.h>
+#elif !defined(__APPLE__)
+#include <GL/glxew.h>
+#endif
+
+const double GlutPlatform::POLL_MILLISECONDS = 1.0;
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A GLUT window.  GLUT's callbacks find it through the window's
+///         glutSetWindowData() pointer.
+class GlutWindow : public PlatformWindow
+{
+public:
+    explicit GlutWindow(const WindowDesc& desc);
+    virtual ~GlutWindow();
+
+    virtual void makeCurrent();
+    virtual void swapBuffers();
+    virtual bool setSwapInterval(int interval);
+    virtual void resize(GLsizei width, GLsizei height);
+
+private:
+    static GlutWindow* getCurrent();
+    static void reshapeCallback(int width, int height);
+    static void displayCallback();
+    static void keyboardCallback(unsigned char key, int x, int y);
+    static void motionCallback(int x, int y);
+    static void closeCallback();
+
+    int id_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a window, and registers for its events.  GLUT makes the
+///         new window current.
+GlutWindow::GlutWindow(const WindowDesc& desc)
+    : PlatformWindow(desc.width, desc.height)
+{
+    glutInitDisplayMode(GLUT_RGBA | (desc.double_buffered ? GLUT_DOUBLE : GLUT_SINGLE));
+    glutInitWindowPosition(desc.x, desc.y);
+    glutInitWindowSize(desc.width, desc.height);
+    id_ = glutCreateWindow(desc.title.c_str());
+    if (!desc.visible)
+        glutHideWindow();
+
+    glutSetWindowData(this);
+    glutReshapeFunc(reshapeCallback);
+    glutDisplayFunc(displayCallback);
+    glutKeyboardFunc(keyboardCallback);
+    glutPassiveMotionFunc(motionCallback);
+    glutMotionFunc(motionCallback);
+    glutCloseFunc(closeCallback);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the window, unless GLUT already has.
+GlutWindow::~GlutWindow()
+{
+    if (open_)
+    {
+        glutSetWindowData(nullptr);
+        glutDestroyWindow(id_);
+    }
+}
+
+void GlutWindow::makeCurrent()
+{
+    glutSetWindow(id_);
+}
+
+void GlutWindow::swapBuffers()
+{
+    glutSetWindow(id_);
+    glutSwapBuffers();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the number of display refreshes each buffer swap waits for;
+///         1 synchronizes swaps to vertical blanking, 0 doesn't wait.
+///
+/// \return false if the driver doesn't let the interval be changed.
+bool GlutWindow::setSwapInterval(int interval)
+{
+    glutSetWindow(id_);
+
+#ifdef _WIN32
+    if (WGLEW_EXT_swap_control)
+        return wglSwapIntervalEXT(interval) != FALSE;
+#elif !defined(__APPLE__)
+    if (GLXEW_MESA_swap_control)
+        return glXSwapIntervalMESA(interval) == 0;
+
+    // GLX_SGI_swap_control can't turn synchronization off.
+    if (GLXEW_SGI_swap_control && interval > 0)
+        return glXSwapIntervalSGI(interval) == 0;
+#endif
+
+    return false;
+}
+
+void GlutWindow::resize(GLsizei width, GLsizei height)
+{
+    glutSetWindow(id_);
+    glutReshapeWindow(width, height);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the window GLUT is calling back about, or null while it's
+///         being created or destroyed.
+GlutWindow* GlutWindow::getCurrent()
+{
+    return static_cast<GlutWindow*>(glutGetWindowData());
+}
+
+void GlutWindow::reshapeCallback(int width, int height)
+{
+    if (GlutWindow* window = getCurrent())
+        window->notifyReshape(width, height);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Only posts a redisplay: GLUT draws when the window is exposed,
+///         but the RenderLoop decides when the frame is actually drawn.
+void GlutWindow::displayCallback()
+{
+    if (GlutWindow* window = getCurrent())
+        window->postRedisplay();
+}
+
+void GlutWindow::keyboardCallback(unsigned char key, int x, int y)
+{
+    if (GlutWindow* window = getCurrent())
+        window->notifyKeyboard(key, x, y);
+}
+
+void GlutWindow::motionCallback(int x, int y)
+{
+    if (GlutWindow* window = getCurrent())
+        window->notifyMouseMove(x, y);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Called by GLUT just before it destroys a window the window
+///         manager asked to close.  Its context is still current.
+void GlutWindow::closeCallback()
+{
+    if (GlutWindow* window = getCurrent())
+    {
+        window->notifyClose();
+        glutSetWindowData(nullptr);
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Initializes GLUT, which takes the arguments it recognizes out of
+///         argv.
+GlutPlatform::GlutPlatform(int& argc, char** argv)
+{
+    glutInit(&argc, argv);
+    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_CONTINUE_EXECUTION);
+}
+
+PlatformType GlutPlatform::getType() const
+{
+    return PLATFORM_GLUT;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Delivers the pending events, then waits for up to the timeout
+///         if there's nothing to draw.
+///
+/// \param  timeout_milliseconds How long to wait, or a negative number to
+///         wait for the next event.  GLUT can only poll, so no wait is
+///         longer than POLL_MILLISECONDS; the RenderLoop just calls again.
+void GlutPlatform::waitEvents(double timeout_milliseconds)
+{
+    glutMainLoopEvent();
+
+    for (size_t i = 0; i < getWindowCount(); ++i)
+    {
+        if (getWindow(i)->isRedisplayPosted())
+            return;
+    }
+
+    double wait = timeout_milliseconds < 0 ? POLL_MILLISECONDS : std::min(timeout_milliseconds, POLL_MILLISECONDS);
+    if (wait > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(wait * 1000.0)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws text with glutBitmapString() in the 8x13 font.
+bool GlutPlatform::drawText(const std::string& text)
+{
+    glutBitmapString(GLUT_BITMAP_8_BY_13, reinterpret_cast<const unsigned char*>(text.c_str()));
+    return true;
+}
+
+std::unique_ptr<PlatformWindow> GlutPlatform::openWindow(const WindowDesc& desc)
+{
+    return std::unique_ptr<PlatformWindow>(new GlutWindow(desc));
+}
@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  glut_platform.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the GlutPlatform class.
+
+#ifndef GLUT_PLATFORM_H_
+#define GLUT_PLATFORM_H_
+
+#include "platform.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A Platform on freeglut.
+///
+/// \details glutMainLoop() is never entered; waitEvents() runs one pass of
+///         freeglut's loop with glutMainLoopEvent(), so the RenderLoop
+///         decides when frames are drawn.  GLUT can't wait on its event
+///         queue with a timeout, so waiting is done by sleeping in short
+///         slices between passes.
+///
+///         Closing a window from the window manager doesn't end the program,
+///         as it does by default in GLUT; the window's close callback is
+///         called, and then GLUT destroys it.
+class GlutPlatform : public Platform
+{
+public:
+    GlutPlatform(int& argc, char** argv);
+
+    virtual PlatformType getType() const;
+
+    virtual void waitEvents(double timeout_milliseconds);
+    virtual bool drawText(const std::string& text);
+
+    static const double POLL_MILLISECONDS;
+
+protected:
+    virtual std::unique_ptr<PlatformWindow> openWindow(const WindowDesc& desc);
+};
+
+#endif
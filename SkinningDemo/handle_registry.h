@@ -0,0 +1,201 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  handle_registry.h
+/// \author Ben Crist
+///
+/// \brief  The HandleRegistry class template, which owns objects in a dense
+///         array and hands out generational handles to them.
+
+#ifndef HANDLE_REGISTRY_H_
+#define HANDLE_REGISTRY_H_
+
+#include "demo.h"
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Owns a set of objects, packed together in one array, and refers
+///         to each with a handle rather than a pointer.
+///
+/// \details A handle is a slot number and a generation.  Each slot holds
+///         the object's current place in the dense array, so objects can be
+///         moved around in it (removing one moves the last into its place,
+///         keeping the array packed) without any handle changing.  Removing
+///         an object bumps its slot's generation, so stale handles to it,
+///         and to whatever reuses the slot later, are told apart and
+///         resolve to null instead of to the wrong object.
+///
+///         Iterating over the live objects is a walk down the dense array,
+///         in no particular order.  Handles are plain pairs of words, so
+///         they can be written to a file or handed between threads as they
+///         are.
+///
+///         T only needs to be movable, so objects which own resources and
+///         can't be copied are kept as std::unique_ptrs: their own
+///         addresses then never change, and only the pointers are packed.
+///         Neither adding nor removing objects is safe while another thread
+///         is using the registry.
+template <typename T>
+class HandleRegistry
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Refers to an object in a HandleRegistry<T>.  A default
+    ///         constructed handle refers to nothing.
+    struct Handle
+    {
+        Handle() : slot(NO_SLOT), generation(0) {}
+
+        bool isNull() const { return slot == NO_SLOT; }
+        bool operator==(const Handle& other) const { return slot == other.slot && generation == other.generation; }
+        bool operator!=(const Handle& other) const { return !(*this == other); }
+
+        GLuint slot;
+        GLuint generation;  ///< The slot's generation when the object was added.
+    };
+
+    static const GLuint NO_SLOT = GLuint(-1);
+
+    HandleRegistry() {}
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Takes ownership of an object, and returns its handle.
+    Handle add(T object)
+    {
+        GLuint slot;
+        if (free_slots_.empty())
+        {
+            slot = GLuint(slots_.size());
+            Slot new_slot = { 1, 0 };
+            slots_.push_back(new_slot);
+        }
+        else
+        {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        }
+
+        slots_[slot].dense_index = GLuint(objects_.size());
+        objects_.push_back(std::move(object));
+        dense_slots_.push_back(slot);
+
+        Handle handle;
+        handle.slot = slot;
+        handle.generation = slots_[slot].generation;
+        return handle;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Destroys the object a handle refers to, moving the last object
+    ///         into its place.
+    ///
+    /// \return false if the handle didn't refer to a live object.
+    bool remove(Handle handle)
+    {
+        if (!contains(handle))
+            return false;
+
+        Slot& slot = slots_[handle.slot];
+        GLuint last = GLuint(objects_.size() - 1);
+        if (slot.dense_index != last)
+        {
+            std::swap(objects_[slot.dense_index], objects_[last]);
+            dense_slots_[slot.dense_index] = dense_slots_[last];
+            slots_[dense_slots_[last]].dense_index = slot.dense_index;
+        }
+        objects_.pop_back();
+        dense_slots_.pop_back();
+
+        ++slot.generation;
+        free_slots_.push_back(handle.slot);
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Destroys every object, leaving every outstanding handle stale.
+    void clear()
+    {
+        while (!objects_.empty())
+        {
+            Handle handle;
+            handle.slot = dense_slots_.back();
+            handle.generation = slots_[handle.slot].generation;
+            remove(handle);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns true if a handle refers to a live object.
+    bool contains(Handle handle) const
+    {
+        return handle.slot < slots_.size() && slots_[handle.slot].generation == handle.generation;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the object a handle refers to, or null if it's stale.
+    ///         The pointer is only good until the next add() or remove().
+    T* get(Handle handle)
+    {
+        return contains(handle) ? &objects_[slots_[handle.slot].dense_index] : nullptr;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the object a handle refers to, or null if it's stale.
+    const T* get(Handle handle) const
+    {
+        return contains(handle) ? &objects_[slots_[handle.slot].dense_index] : nullptr;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the number of live objects.
+    size_t size() const
+    {
+        return objects_.size();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the live object at a place in the dense array, from 0
+    ///         to size() - 1.
+    T& at(size_t dense_index)
+    {
+        return objects_[dense_index];
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the live object at a place in the dense array.
+    const T& at(size_t dense_index) const
+    {
+        return objects_[dense_index];
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the handle of the live object at a place in the dense
+    ///         array.
+    Handle getHandle(size_t dense_index) const
+    {
+        Handle handle;
+        handle.slot = dense_slots_[dense_index];
+        handle.generation = slots_[handle.slot].generation;
+        return handle;
+    }
+
+private:
+    HandleRegistry(const HandleRegistry&);              // non-copyable
+    HandleRegistry& operator=(const HandleRegistry&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Where a handle's object is, and which generation of handle
+    ///         refers to it.
+    struct Slot
+    {
+        GLuint generation;      ///< Starts at 1, so a default Handle never matches.
+        GLuint dense_index;     ///< The object's place in objects_, while it's live.
+    };
+
+    std::vector<T> objects_;            ///< The live objects, packed.
+    std::vector<GLuint> dense_slots_;   ///< The slot of each object in objects_.
+    std::vector<Slot> slots_;
+    std::vector<GLuint> free_slots_;    ///< Slots whose objects have been removed, ready for reuse.
+};
+
+#endif
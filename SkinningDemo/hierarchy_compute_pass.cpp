@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  hierarchy_compute_pass.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of HierarchyComputePass class functions.
+
+#include "hierarchy_compute_pass.h"
+
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+const GLuint HierarchyComputePass::WORKGROUP_SIZE;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads the levels, and creates the transform buffer.
+///
+/// \param  levels The skeleton's levels.  They must outlive the pass.
+/// \param  instance_capacity The most instances evaluated at once.
+HierarchyComputePass::HierarchyComputePass(const HierarchyLevels& levels, size_t instance_capacity)
+    : levels_(levels),
+      instance_capacity_(instance_capacity),
+      entry_buffer_id_(0),
+      transform_buffer_id_(0),
+      compact_buffer_id_(0),
+      inverse_bind_buffer_id_(0),
+      target_buffer_id_(0)
+{
+    GLint max_instances = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 1, &max_instances);
+    if (instance_capacity > size_t(max_instances))
+    {
+        std::cerr << "A HierarchyComputePass of " << instance_capacity << " instances needs more than the "
+                  << max_instances << " work groups the GL allows in y." << std::endl;
+        throw std::runtime_error("Too many instances for a HierarchyComputePass.");
+    }
+
+    // the roots are never written, so their parents don't matter.
+    std::vector<GLuint> entries;
+    for (size_t entry = 0; entry < levels.getJointCount(); ++entry)
+    {
+        int parent = levels.getParent(entry);
+        entries.push_back(GLuint(levels.getJoint(entry)));
+        entries.push_back(parent == Skeleton::NO_PARENT ? 0u : GLuint(parent));
+    }
+
+    glGenBuffers(1, &entry_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, entry_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, entries.size() * sizeof(GLuint), entries.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &transform_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instance_capacity * levels.getJointCount() * sizeof(mat4),
+                 nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &compact_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, compact_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instance_capacity * levels.getJointCount() * sizeof(vec4),
+                 nullptr, GL_STREAM_DRAW);
+
+    glGenBuffers(1, &inverse_bind_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, inverse_bind_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, levels.getJointCount() * sizeof(mat4), nullptr, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &target_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, target_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instance_capacity * sizeof(PaletteTarget), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the pass's buffers.
+HierarchyComputePass::~HierarchyComputePass()
+{
+    glDeleteBuffers(1, &entry_buffer_id_);
+    glDeleteBuffers(1, &transform_buffer_id_);
+    glDeleteBuffers(1, &compact_buffer_id_);
+    glDeleteBuffers(1, &inverse_bind_buffer_id_);
+    glDeleteBuffers(1, &target_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies local transforms into the transform buffer.
+///
+/// \param  locals instance_count blocks of getJointCount() local transforms.
+/// \param  instance_count The number of instances; at most the capacity.
+void HierarchyComputePass::upload(const mat4* locals, size_t instance_count)
+{
+    assert(instance_count <= instance_capacity_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_buffer_id_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instance_count * levels_.getJointCount() * sizeof(mat4), locals);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads compact local transforms, and expands them into the
+///         transform buffer's matrices, ready for evaluate().
+///
+/// \param  expand_program_id The program built from
+///         local_expand_shader_source.
+/// \param  locals instance_count blocks of getJointCount() compact local
+///         transforms, from computeCompactLocalTransforms().
+/// \param  instance_count The number of instances; at most the capacity.
+void HierarchyComputePass::uploadCompact(GLuint expand_program_id, const vec4* locals, size_t instance_count)
+{
+    assert(instance_count <= instance_capacity_);
+    if (instance_count == 0)
+        return;
+
+    GLuint joint_count = GLuint(levels_.getJointCount());
+    GLsizeiptr size = instance_count * joint_count * sizeof(vec4);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, compact_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instance_capacity_ * joint_count * sizeof(vec4), nullptr,
+                 GL_STREAM_DRAW);  // orphan last frame's data
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, locals);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, transform_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, compact_buffer_id_);
+    glUseProgram(expand_program_id);
+    glUniform1ui(glGetUniformLocation(expand_program_id, "joint_count"), joint_count);
+    glDispatchCompute((joint_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, GLuint(instance_count), 1);
+    glUseProgram(0);
+
+    // evaluate() reads the matrices just written.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts the first instance_count instances' transforms to model
+///         space, in place.
+///
+/// \param  compute_program_id The hierarchy compute shader program.
+/// \param  instance_count The number of instances; at most the capacity.
+void HierarchyComputePass::evaluate(GLuint compute_program_id, size_t instance_count)
+{
+    assert(instance_count <= instance_capacity_);
+    if (instance_count == 0)
+        return;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, transform_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, entry_buffer_id_);
+
+    glUseProgram(compute_program_id);
+    GLint first_entry_location = glGetUniformLocation(compute_program_id, "first_entry");
+    GLint entry_count_location = glGetUniformLocation(compute_program_id, "entry_count");
+    glUniform1ui(glGetUniformLocation(compute_program_id, "joint_count"), GLuint(levels_.getJointCount()));
+
+    for (size_t level = 1; level < levels_.getLevelCount(); ++level)
+    {
+        GLuint entry_count = GLuint(levels_.getLevelSize(level));
+        glUniform1ui(first_entry_location, GLuint(levels_.getLevelStart(level)));
+        glUniform1ui(entry_count_location, entry_count);
+        glDispatchCompute((entry_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, GLuint(instance_count), 1);
+
+        // the next level reads the transforms this one just wrote.
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    glUseProgram(0);
+
+    // the results may be read back, or copied into a palette buffer.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads back the transforms, waiting for evaluate() to finish.
+///         Meant for checking the results, not for every frame.
+///
+/// \param  transforms Receives instance_count blocks of getJointCount()
+///         matrices.
+/// \param  instance_count The number of instances; at most the capacity.
+void HierarchyComputePass::download(mat4* transforms, size_t instance_count) const
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_buffer_id_);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instance_count * levels_.getJointCount() * sizeof(mat4), transforms);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads the skeleton's inverse bind transforms, which
+///         resolvePalettes() folds into every palette.
+void HierarchyComputePass::setInverseBindTransforms(const mat4* inverse_binds)
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, inverse_bind_buffer_id_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, levels_.getJointCount() * sizeof(mat4), inverse_binds);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds skinning palettes from the transforms evaluate() left in
+///         model space, one dispatch for every target.
+///
+/// \details Each target's palette is its placement, times its leader's
+///         transforms, times the inverse bind transforms, written at the
+///         target's instance, getJointCount() matrices each.  Many targets
+///         may share a leader, so the leaders' transforms are only
+///         uploaded and evaluated once however many instances reuse them.
+///         setInverseBindTransforms() must have been called first.
+///
+/// \param  resolve_program_id The program built from
+///         palette_resolve_shader_source.
+/// \param  targets The palettes to build.
+/// \param  target_count The number of targets; at most the capacity.
+/// \param  palette_buffer_id The storage buffer to write the palettes into,
+///         big enough for the highest instance of any target.
+void HierarchyComputePass::resolvePalettes(GLuint resolve_program_id, const PaletteTarget* targets,
+                                           size_t target_count, GLuint palette_buffer_id)
+{
+    assert(target_count <= instance_capacity_);
+    if (target_count == 0)
+        return;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, target_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instance_capacity_ * sizeof(PaletteTarget), nullptr,
+                 GL_STREAM_DRAW);  // orphan last frame's data
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, target_count * sizeof(PaletteTarget), targets);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, transform_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, inverse_bind_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, target_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, palette_buffer_id);
+
+    GLuint joint_count = GLuint(levels_.getJointCount());
+    glUseProgram(resolve_program_id);
+    glUniform1ui(glGetUniformLocation(resolve_program_id, "joint_count"), joint_count);
+    glDispatchCompute((joint_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, GLuint(target_count), 1);
+    glUseProgram(0);
+
+    // the skinning dispatch reads the palettes as storage.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the storage buffer holding the transforms.
+GLuint HierarchyComputePass::getTransformBuffer() const
+{
+    return transform_buffer_id_;
+}
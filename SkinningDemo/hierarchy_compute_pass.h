@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  hierarchy_compute_pass.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the HierarchyComputePass class.
+
+#ifndef HIERARCHY_COMPUTE_PASS_H_
+#define HIERARCHY_COMPUTE_PASS_H_
+
+#include "hierarchy_levels.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts the local transforms of many instances of a skeleton to
+///         model space with a compute shader, one level of the hierarchy
+///         per dispatch.
+///
+/// \details The transforms live in a storage buffer, one block of
+///         getJointCount() matrices per instance, indexed like the
+///         skeleton's joints.  upload() fills it with local transforms
+///         (from computeLocalTransforms()), and evaluate() then does one
+///         dispatch per level after the roots' (see HierarchyLevels), with
+///         an invocation per joint of the level in x and one per instance
+///         in y, and a barrier between levels so each reads its parents'
+///         finished transforms.  Each invocation does one mat4 * mat4, so
+///         this only pays off once the levels and instances are wide enough
+///         to fill the GPU; the dispatches themselves cost the same however
+///         few joints each level has.  Needs GL 4.3.
+///
+///         uploadCompact() uploads a vec4 per joint instead, from
+///         computeCompactLocalTransforms(), and expands them into the
+///         transform buffer on the GPU, for a quarter of the bandwidth.
+///         After evaluate(), resolvePalettes() can go on to build skinning
+///         palettes from the model space transforms, straight into another
+///         buffer, such as ComputeSkinner's, so nothing but the local
+///         transforms and the placements ever leaves the CPU.
+class HierarchyComputePass
+{
+public:
+    static const GLuint WORKGROUP_SIZE = 64;    ///< Must match the compute shaders' local_size_x.
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One palette for resolvePalettes() to build, laid out as
+    ///         palette_resolve_shader_source reads it.
+    struct PaletteTarget
+    {
+        mat4 placement;     ///< Multiplies every matrix of the palette on the left.
+        GLuint instance;    ///< Which palette of the palette buffer to write.
+        GLuint leader;      ///< Which instance of the transform buffer to build it from.
+        GLuint padding[2];
+    };
+
+    HierarchyComputePass(const HierarchyLevels& levels, size_t instance_capacity);
+    ~HierarchyComputePass();
+
+    void upload(const mat4* locals, size_t instance_count);
+    void uploadCompact(GLuint expand_program_id, const vec4* locals, size_t instance_count);
+    void evaluate(GLuint compute_program_id, size_t instance_count);
+    void download(mat4* transforms, size_t instance_count) const;
+
+    void setInverseBindTransforms(const mat4* inverse_binds);
+    void resolvePalettes(GLuint resolve_program_id, const PaletteTarget* targets, size_t target_count,
+                         GLuint palette_buffer_id);
+
+    GLuint getTransformBuffer() const;
+
+private:
+    HierarchyComputePass(const HierarchyComputePass&);              // non-copyable
+    HierarchyComputePass& operator=(const HierarchyComputePass&);   // non-copyable
+
+    const HierarchyLevels& levels_;
+    size_t instance_capacity_;
+    GLuint entry_buffer_id_;        ///< Each joint and its parent, level by level, as uvec2s.
+    GLuint transform_buffer_id_;
+    GLuint compact_buffer_id_;      ///< The compact local transforms, until they're expanded.
+    GLuint inverse_bind_buffer_id_; ///< Indexed like the skeleton's joints.
+    GLuint target_buffer_id_;       ///< resolvePalettes()'s targets, up to the capacity.
+};
+
+#endif
@@ -0,0 +1,240 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  hierarchy_levels.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of HierarchyLevels class functions.
+
+#include "hierarchy_levels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+const size_t HierarchyLevels::MIN_PARALLEL_JOINTS;
+const size_t HierarchyLevels::TASK_JOINTS;
+
+namespace {
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a * b + c, fused into a single instruction when the
+///         compiler targets FMA.
+inline __m128 multiplyAdd(__m128 a, __m128 b, __m128 c)
+{
+#ifdef __FMA__
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+#endif
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sorts a skeleton's joints by depth.
+///
+/// \details Within a level, the joints stay in the skeleton's order, so
+///         siblings, which are usually added together, stay together.
+///
+/// \param  skeleton The skeleton to sort.  Only its hierarchy is copied, so
+///         it doesn't need to outlive the levels.
+HierarchyLevels::HierarchyLevels(const Skeleton& skeleton)
+{
+    size_t joint_count = skeleton.getJointCount();
+
+    // parents come before their children, so each parent's depth is known
+    // by the time its children get to it.
+    std::vector<size_t> depths(joint_count);
+    std::vector<size_t> level_sizes;
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        int parent = skeleton.getParent(joint);
+        depths[joint] = parent == Skeleton::NO_PARENT ? 0 : depths[parent] + 1;
+        if (depths[joint] >= level_sizes.size())
+            level_sizes.push_back(0);
+        ++level_sizes[depths[joint]];
+    }
+
+    level_starts_.push_back(0);
+    for (size_t level = 0; level < level_sizes.size(); ++level)
+        level_starts_.push_back(level_starts_.back() + level_sizes[level]);
+
+    joints_.resize(joint_count);
+    parents_.resize(joint_count);
+    std::vector<size_t> next(level_starts_.begin(), level_starts_.end() - 1);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        size_t entry = next[depths[joint]]++;
+        joints_[entry] = int(joint);
+        parents_[entry] = skeleton.getParent(joint);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the skeleton.
+size_t HierarchyLevels::getJointCount() const
+{
+    return joints_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of levels, which is one more than the depth
+///         of the deepest joint.  Level 0 holds the roots.
+size_t HierarchyLevels::getLevelCount() const
+{
+    return level_starts_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the entry of a level's first joint.
+size_t HierarchyLevels::getLevelStart(size_t level) const
+{
+    return level_starts_[level];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in a level.
+size_t HierarchyLevels::getLevelSize(size_t level) const
+{
+    return level_starts_[level + 1] - level_starts_[level];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the skeleton's index of the joint at an entry.
+///
+/// \param  entry The joint's position in the levels, counting across all of
+///         them from the first root.
+int HierarchyLevels::getJoint(size_t entry) const
+{
+    return joints_[entry];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the skeleton's index of the parent of the joint at an
+///         entry, or Skeleton::NO_PARENT for a root.
+int HierarchyLevels::getParent(size_t entry) const
+{
+    return parents_[entry];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts every joint's local transform to model space, in place.
+///
+/// \details The roots' transforms are already in model space, so the first
+///         level is skipped.  Each later level is done once its parents'
+///         level has finished; parallelFor() only returns when all of its
+///         tasks have, so the levels never overlap.
+///
+/// \param  transforms An array of getJointCount() matrices, indexed like the
+///         skeleton's joints, each holding a joint's local transform.  They
+///         receive the joints' local-to-model transforms.
+/// \param  thread_pool The threads to split large levels across, or NULL to
+///         do everything on the calling thread.
+void HierarchyLevels::evaluate(mat4* transforms, ThreadPool* thread_pool) const
+{
+    for (size_t level = 1; level < getLevelCount(); ++level)
+    {
+        size_t first = level_starts_[level];
+        size_t last = level_starts_[level + 1];
+        if (thread_pool == NULL || last - first < MIN_PARALLEL_JOINTS)
+        {
+            evaluateEntries(transforms, first, last);
+            continue;
+        }
+
+        size_t task_count = (last - first + TASK_JOINTS - 1) / TASK_JOINTS;
+        thread_pool->parallelFor(task_count, [this, transforms, first, last](size_t task)
+        {
+            size_t task_first = first + task * TASK_JOINTS;
+            evaluateEntries(transforms, task_first, std::min(task_first + TASK_JOINTS, last));
+        });
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the local-to-model transformation matrix of every joint
+///         in a pose, like Skeleton::computeJointTransforms(), level by
+///         level.
+///
+/// \param  pose The pose to evaluate.
+/// \param  transforms An array of getJointCount() matrices which will
+///         receive the joints' local-to-model transforms.
+/// \param  thread_pool The threads to split large levels across, or NULL.
+void HierarchyLevels::computeJointTransforms(const Pose& pose, mat4* transforms, ThreadPool* thread_pool) const
+{
+    assert(pose.joint_count == joints_.size());
+    computeLocalTransforms(pose, transforms);
+    evaluate(transforms, thread_pool);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Multiplies the local transforms of a range of entries, all in
+///         one level, by their parents' model-space transforms.
+void HierarchyLevels::evaluateEntries(mat4* transforms, size_t first, size_t last) const
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    for (size_t entry = first; entry < last; ++entry)
+    {
+        const float* parent = &transforms[parents_[entry]][0][0];
+        float* local = &transforms[joints_[entry]][0][0];
+
+        __m128 p0 = _mm_loadu_ps(parent + 0);
+        __m128 p1 = _mm_loadu_ps(parent + 4);
+        __m128 p2 = _mm_loadu_ps(parent + 8);
+        __m128 p3 = _mm_loadu_ps(parent + 12);
+
+        // each column of the product only depends on the same column of the
+        // local transform, so it can be written back over it straight away.
+        for (size_t column = 0; column < 16; column += 4)
+        {
+            __m128 l = _mm_loadu_ps(local + column);
+            __m128 result = _mm_mul_ps(p0, _mm_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0)));
+            result = multiplyAdd(p1, _mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1)), result);
+            result = multiplyAdd(p2, _mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2)), result);
+            result = multiplyAdd(p3, _mm_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 3, 3)), result);
+            _mm_storeu_ps(local + column, result);
+        }
+    }
+#else
+    for (size_t entry = first; entry < last; ++entry)
+        transforms[joints_[entry]] = transforms[parents_[entry]] * transforms[joints_[entry]];
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that two sets of joint transforms agree, such as those of
+///         Skeleton::computeJointTransforms() and HierarchyLevels.
+///
+/// \details The products are rounded differently (SSE sums the columns in
+///         a different order, and may use FMA, and the GPU has its own
+///         rounding), and the differences grow with each level, so each
+///         element is compared to within tolerance of its magnitude, or of
+///         1.0 for elements near 0.  The first mismatch is reported to cerr.
+///
+/// \param  expected The reference transforms.
+/// \param  actual The transforms to check.
+/// \param  joint_count The number of transforms in each.
+/// \param  tolerance The largest acceptable relative difference.
+/// \return true if every element of every transform agreed.
+bool verifyJointTransforms(const mat4* expected, const mat4* actual, size_t joint_count, float tolerance)
+{
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        const float* e = &expected[joint][0][0];
+        const float* a = &actual[joint][0][0];
+        for (size_t i = 0; i < 16; ++i)
+        {
+            if (std::abs(e[i] - a[i]) <= tolerance * std::max(std::abs(e[i]), 1.0f))
+                continue;
+
+            std::cerr << "Joint transform mismatch at joint " << joint << ", element " << i
+                      << ": expected " << e[i] << ", got " << a[i] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
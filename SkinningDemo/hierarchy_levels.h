@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  hierarchy_levels.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the HierarchyLevels class.
+
+#ifndef HIERARCHY_LEVELS_H_
+#define HIERARCHY_LEVELS_H_
+
+#include "skeleton.h"
+#include "thread_pool.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A skeleton's joints grouped by their depth in the hierarchy, so
+///         that the joints of each level can be converted to model space
+///         all at once.
+///
+/// \details Skeleton::computeJointTransforms() walks the joints in order,
+///         and every joint waits on its parent, which is the fastest way for
+///         the few dozen joints of a character.  For skeletons with
+///         thousands of joints, like hair chains, cloth proxies or a whole
+///         crowd rig, that one long dependent chain is the bottleneck.  No
+///         joint depends on another joint at the same depth, though, so
+///         once every level above has been done, a whole level can be done
+///         in any order: four joints at a time with SSE, and, when the
+///         level is big enough to be worth it, split across a ThreadPool.
+///
+///         A skeleton which is one long chain has one joint per level and
+///         gets nothing from this; a wide, shallow one gets the most.  The
+///         levels are also laid out for HierarchyComputePass, which does
+///         the same on the GPU.
+class HierarchyLevels
+{
+public:
+    static const size_t MIN_PARALLEL_JOINTS = 1024; ///< Smaller levels are done on the calling thread.
+    static const size_t TASK_JOINTS = 256;          ///< The joints per ThreadPool task.
+
+    explicit HierarchyLevels(const Skeleton& skeleton);
+
+    size_t getJointCount() const;
+    size_t getLevelCount() const;
+    size_t getLevelStart(size_t level) const;
+    size_t getLevelSize(size_t level) const;
+    int getJoint(size_t entry) const;
+    int getParent(size_t entry) const;
+
+    void evaluate(mat4* transforms, ThreadPool* thread_pool = NULL) const;
+    void computeJointTransforms(const Pose& pose, mat4* transforms, ThreadPool* thread_pool = NULL) const;
+
+private:
+    HierarchyLevels(const HierarchyLevels&);            // non-copyable
+    HierarchyLevels& operator=(const HierarchyLevels&); // non-copyable
+
+    void evaluateEntries(mat4* transforms, size_t first, size_t last) const;
+
+    std::vector<int> joints_;           ///< Every joint, level by level.
+    std::vector<int> parents_;          ///< The parent of each of joints_.
+    std::vector<size_t> level_starts_;  ///< Where each level starts in joints_, then the joint count.
+};
+
+bool verifyJointTransforms(const mat4* expected, const mat4* actual, size_t joint_count, float tolerance);
+
+#endif
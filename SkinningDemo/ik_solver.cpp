@@ -0,0 +1,347 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  ik_solver.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the inverse kinematics solvers.
+
+#include "ik_solver.h"
+#include "joint_rotation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+const float RADIANS_TO_DEGREES = 180.0f / 3.14159265358979f;
+
+/// The number of poses staged through the scratch streams at a time.
+const size_t BLOCK_SIZE = 64;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Where a joint's space is in model space: its origin, rotation
+///         and uniform scale.
+struct JointFrame
+{
+    vec2 origin;
+    float rotation;
+    float scale;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rotates a vector by an angle in degrees.
+vec2 rotate(const vec2& v, float degrees)
+{
+    float s, c;
+    sinCosDegrees(degrees, s, c);
+    return vec2(c * v.x - s * v.y, s * v.x + c * v.y);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the frame of a joint's space in a pose, or model space
+///         itself for Skeleton::NO_PARENT.
+JointFrame getJointFrame(const Skeleton& skeleton, const Pose& pose, int joint)
+{
+    JointFrame frame = { vec2(0, 0), 0.0f, 1.0f };
+    if (joint == Skeleton::NO_PARENT)
+        return frame;
+
+    frame = getJointFrame(skeleton, pose, skeleton.getParent(joint));
+    frame.origin += frame.scale * rotate(pose.translation[joint], frame.rotation);
+    frame.rotation += pose.rotation[joint];
+    frame.scale *= pose.scale[joint];
+    return frame;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves a point in model space into a joint's frame.
+vec2 toFrame(const JointFrame& frame, const vec2& point)
+{
+    return rotate(point - frame.origin, -frame.rotation) / frame.scale;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a chain whose joints aren't each the child of the one
+///         before to stderr, and throws.
+void checkChainLink(const Skeleton& skeleton, size_t parent, size_t child)
+{
+    if (skeleton.getParent(child) == int(parent))
+        return;
+
+    std::cerr << "Invalid IK chain!" << std::endl
+              << "  Joint " << child << " isn't a child of joint " << parent << "." << std::endl;
+    throw std::runtime_error("Invalid IK chain!");
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns where a point in a joint's space is in model space, in a
+///         pose; for instance, where the end of a chain currently is.
+vec2 getModelPosition(const Skeleton& skeleton, const Pose& pose, size_t joint, const vec2& offset)
+{
+    JointFrame frame = getJointFrame(skeleton, pose, int(joint));
+    return frame.origin + frame.scale * rotate(offset, frame.rotation);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Bends a two bone limb in each of many poses so its end reaches
+///         that pose's target, or as close as the bones allow.
+///
+/// \details Everything is solved in the space of root_joint's parent, where
+///         the root joint's origin doesn't move.  The law of cosines gives
+///         both bones' angles from their lengths and the distance to the
+///         target; the distance is clamped to what the bones can span
+///         first, so every target has an answer.  The cost is the same for
+///         every pose, whatever its target.
+///
+/// \param  skeleton The skeleton the poses belong to.
+/// \param  chain The limb to solve.
+/// \param  targets Where each pose's limb should reach, in model space.
+/// \param  poses The poses to solve in place.
+/// \param  pose_count The number of poses and of targets.
+void solveTwoBoneIk(const Skeleton& skeleton, const TwoBoneIkChain& chain, const vec2* targets,
+                    Pose* poses, size_t pose_count)
+{
+    checkChainLink(skeleton, chain.root_joint, chain.mid_joint);
+
+    size_t root = chain.root_joint;
+    size_t mid = chain.mid_joint;
+    float bend = chain.bend_clockwise ? 1.0f : -1.0f;
+    float end_length = std::sqrt(glm::dot(chain.end_offset, chain.end_offset));
+    float end_angle = std::atan2(chain.end_offset.y, chain.end_offset.x) * RADIANS_TO_DEGREES;
+
+    float dx[BLOCK_SIZE];
+    float dy[BLOCK_SIZE];
+    float upper[BLOCK_SIZE];        // the bones' lengths, scaled
+    float lower[BLOCK_SIZE];
+    float cos_root[BLOCK_SIZE];     // the cosines of the triangle's angles at the two joints
+    float cos_mid[BLOCK_SIZE];
+
+    for (size_t first = 0; first < pose_count; first += BLOCK_SIZE)
+    {
+        size_t count = std::min(BLOCK_SIZE, pose_count - first);
+
+        // gather each pose's target and bones into the parent's space.
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Pose& pose = poses[first + i];
+            JointFrame parent = getJointFrame(skeleton, pose, skeleton.getParent(root));
+            vec2 to_target = toFrame(parent, targets[first + i]) - pose.translation[root];
+            const vec2& mid_offset = pose.translation[mid];
+
+            dx[i] = to_target.x;
+            dy[i] = to_target.y;
+            upper[i] = pose.scale[root] * std::sqrt(glm::dot(mid_offset, mid_offset));
+            lower[i] = pose.scale[root] * pose.scale[mid] * end_length;
+        }
+
+        // the triangle between the root, the middle joint and the target.
+        for (size_t i = 0; i < count; ++i)
+        {
+            float u = std::max(upper[i], 1e-6f);
+            float l = std::max(lower[i], 1e-6f);
+            float distance = std::sqrt(dx[i] * dx[i] + dy[i] * dy[i]);
+            distance = std::max(std::min(distance, u + l), std::max(std::abs(u - l), 1e-6f));
+
+            cos_root[i] = std::min(std::max((u * u + distance * distance - l * l) / (2.0f * u * distance), -1.0f), 1.0f);
+            cos_mid[i] = std::min(std::max((u * u + l * l - distance * distance) / (2.0f * u * l), -1.0f), 1.0f);
+        }
+
+        // turn the triangle into the two joints' rotations.
+        for (size_t i = 0; i < count; ++i)
+        {
+            Pose& pose = poses[first + i];
+            const vec2& mid_offset = pose.translation[mid];
+            float mid_angle = std::atan2(mid_offset.y, mid_offset.x) * RADIANS_TO_DEGREES;
+
+            float direction = std::atan2(dy[i], dx[i]) * RADIANS_TO_DEGREES;
+            float upper_angle = direction + bend * std::acos(cos_root[i]) * RADIANS_TO_DEGREES;
+            float lower_angle = upper_angle - bend * (180.0f - std::acos(cos_mid[i]) * RADIANS_TO_DEGREES);
+
+            pose.rotation[root] = upper_angle - mid_angle;
+            pose.rotation[mid] = lower_angle - upper_angle + mid_angle - end_angle;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Bends a chain in each of many poses so its end reaches that
+///         pose's target, with FABRIK.
+///
+/// \details The joints' positions are gathered into the space of the first
+///         joint's parent.  Each iteration then drags the chain's end onto
+///         the target and pulls each joint after it in turn (backward), and
+///         drags the first joint back onto its origin and pulls the rest
+///         after it (forward), keeping every bone's length.  Finally each
+///         joint is rotated to point its bone at the next position.  A
+///         joint pulled onto the point it follows, which has no direction to
+///         be pulled in, is pulled along the x axis.
+///
+///         A block of poses stops early once every one of them is within
+///         tolerance of its target; with a tolerance of 0, every pose
+///         always takes exactly max_iterations, so the cost can be budgeted
+///         ahead of time.
+///
+/// \param  skeleton The skeleton the poses belong to.
+/// \param  chain The chain to solve.
+/// \param  targets Where each pose's chain should reach, in model space.
+/// \param  poses The poses to solve in place.
+/// \param  pose_count The number of poses and of targets.
+/// \param  max_iterations The most iterations to run.
+/// \param  tolerance How far from its target a chain's end may be left.
+/// \param  arena Where the chain's scratch streams come from, if given;
+///         otherwise they're allocated from the heap for the call.
+void solveFabrikIk(const Skeleton& skeleton, const IkChain& chain, const vec2* targets,
+                   Pose* poses, size_t pose_count, size_t max_iterations, float tolerance,
+                   FrameArena* arena)
+{
+    size_t joint_count = chain.joints.size();
+    if (joint_count == 0)
+        return;
+    for (size_t k = 1; k < joint_count; ++k)
+        checkChainLink(skeleton, chain.joints[k - 1], chain.joints[k]);
+
+    // streams of each point on the chain (each joint, then its end), and
+    // of each bone's length, with one entry per pose in the block.
+    size_t point_count = joint_count + 1;
+    size_t scratch_size = (point_count * 2 + joint_count) * BLOCK_SIZE;
+    std::vector<float> heap_scratch;
+    float* xs;
+    if (arena != nullptr)
+        xs = arena->allocate<float>(scratch_size);
+    else
+    {
+        heap_scratch.resize(scratch_size);
+        xs = heap_scratch.data();
+    }
+    float* ys = xs + point_count * BLOCK_SIZE;
+    float* lengths = ys + point_count * BLOCK_SIZE;
+    float target_x[BLOCK_SIZE];
+    float target_y[BLOCK_SIZE];
+
+    for (size_t first = 0; first < pose_count; first += BLOCK_SIZE)
+    {
+        size_t count = std::min(BLOCK_SIZE, pose_count - first);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Pose& pose = poses[first + i];
+            JointFrame parent = getJointFrame(skeleton, pose, skeleton.getParent(chain.joints[0]));
+            vec2 target = toFrame(parent, targets[first + i]);
+            target_x[i] = target.x;
+            target_y[i] = target.y;
+
+            // walk down the chain in the parent's space.
+            JointFrame frame = { vec2(0, 0), 0.0f, 1.0f };
+            for (size_t k = 0; k < point_count; ++k)
+            {
+                const vec2& offset = k < joint_count ? pose.translation[chain.joints[k]] : chain.end_offset;
+                frame.origin += frame.scale * rotate(offset, frame.rotation);
+                xs[k * BLOCK_SIZE + i] = frame.origin.x;
+                ys[k * BLOCK_SIZE + i] = frame.origin.y;
+                if (k > 0)
+                {
+                    vec2 bone(xs[k * BLOCK_SIZE + i] - xs[(k - 1) * BLOCK_SIZE + i],
+                              ys[k * BLOCK_SIZE + i] - ys[(k - 1) * BLOCK_SIZE + i]);
+                    lengths[(k - 1) * BLOCK_SIZE + i] = std::sqrt(glm::dot(bone, bone));
+                }
+                if (k < joint_count)
+                {
+                    frame.rotation += pose.rotation[chain.joints[k]];
+                    frame.scale *= pose.scale[chain.joints[k]];
+                }
+            }
+        }
+
+        float root_x[BLOCK_SIZE];
+        float root_y[BLOCK_SIZE];
+        std::copy(xs, xs + count, root_x);
+        std::copy(ys, ys + count, root_y);
+
+        for (size_t iteration = 0; iteration < max_iterations; ++iteration)
+        {
+            if (tolerance > 0.0f)
+            {
+                bool converged = true;
+                const float* end_x = &xs[joint_count * BLOCK_SIZE];
+                const float* end_y = &ys[joint_count * BLOCK_SIZE];
+                for (size_t i = 0; i < count; ++i)
+                {
+                    float ex = end_x[i] - target_x[i];
+                    float ey = end_y[i] - target_y[i];
+                    converged = converged && ex * ex + ey * ey <= tolerance * tolerance;
+                }
+                if (converged)
+                    break;
+            }
+
+            // backward: from the target towards the first joint.
+            std::copy(target_x, target_x + count, &xs[joint_count * BLOCK_SIZE]);
+            std::copy(target_y, target_y + count, &ys[joint_count * BLOCK_SIZE]);
+            for (size_t k = joint_count; k-- > 0;)
+            {
+                float* x = &xs[k * BLOCK_SIZE];
+                float* y = &ys[k * BLOCK_SIZE];
+                const float* next_x = &xs[(k + 1) * BLOCK_SIZE];
+                const float* next_y = &ys[(k + 1) * BLOCK_SIZE];
+                const float* length = &lengths[k * BLOCK_SIZE];
+                for (size_t i = 0; i < count; ++i)
+                {
+                    float bx = x[i] - next_x[i];
+                    float by = y[i] - next_y[i];
+                    float distance = std::sqrt(bx * bx + by * by);
+                    bx = distance > 1e-6f ? bx : 1.0f;
+                    distance = distance > 1e-6f ? distance : 1.0f;
+                    float scale = length[i] / distance;
+                    x[i] = next_x[i] + bx * scale;
+                    y[i] = next_y[i] + by * scale;
+                }
+            }
+
+            // forward: from the first joint's origin back out to the end.
+            std::copy(root_x, root_x + count, xs);
+            std::copy(root_y, root_y + count, ys);
+            for (size_t k = 1; k < point_count; ++k)
+            {
+                float* x = &xs[k * BLOCK_SIZE];
+                float* y = &ys[k * BLOCK_SIZE];
+                const float* previous_x = &xs[(k - 1) * BLOCK_SIZE];
+                const float* previous_y = &ys[(k - 1) * BLOCK_SIZE];
+                const float* length = &lengths[(k - 1) * BLOCK_SIZE];
+                for (size_t i = 0; i < count; ++i)
+                {
+                    float bx = x[i] - previous_x[i];
+                    float by = y[i] - previous_y[i];
+                    float distance = std::sqrt(bx * bx + by * by);
+                    bx = distance > 1e-6f ? bx : 1.0f;
+                    distance = distance > 1e-6f ? distance : 1.0f;
+                    float scale = length[i] / distance;
+                    x[i] = previous_x[i] + bx * scale;
+                    y[i] = previous_y[i] + by * scale;
+                }
+            }
+        }
+
+        // point each joint's bone at the next position.  A joint's rotation
+        // is relative to the one before, whose frame has already turned.
+        for (size_t i = 0; i < count; ++i)
+        {
+            Pose& pose = poses[first + i];
+            float parent_rotation = 0.0f;
+            for (size_t k = 0; k < joint_count; ++k)
+            {
+                const vec2& offset = k + 1 < joint_count ? pose.translation[chain.joints[k + 1]] : chain.end_offset;
+                float offset_angle = std::atan2(offset.y, offset.x) * RADIANS_TO_DEGREES;
+                float bone_angle = std::atan2(ys[(k + 1) * BLOCK_SIZE + i] - ys[k * BLOCK_SIZE + i],
+                                              xs[(k + 1) * BLOCK_SIZE + i] - xs[k * BLOCK_SIZE + i]) * RADIANS_TO_DEGREES;
+
+                float frame_rotation = bone_angle - offset_angle;
+                pose.rotation[chain.joints[k]] = frame_rotation - parent_rotation;
+                parent_rotation = frame_rotation;
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  ik_solver.h
+/// \author Ben Crist
+///
+/// \brief  The TwoBoneIkChain and IkChain structs, and the inverse
+///         kinematics solvers which bend them to reach targets.
+///
+/// \details The solvers run between blending and the hierarchy pass: they
+///         read each pose's channels, and write new rotations back into them
+///         in place, so the hierarchy pass and everything after it sees a
+///         pose like any other.  Only rotations change; the chains' bone
+///         lengths, and every joint outside them, are left alone.
+///
+///         Each solver takes many poses, one target each, so a whole crowd's
+///         chains are solved in one call.  The work is staged through small
+///         blocks of structure-of-arrays scratch: the poses' frames are
+///         gathered into streams, the arithmetic runs over the streams with
+///         no branches, and the angles are scattered back.
+
+#ifndef IK_SOLVER_H_
+#define IK_SOLVER_H_
+
+#include "frame_arena.h"
+#include "pose.h"
+#include "skeleton.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A limb of two bones, such as an arm or a leg, which is solved
+///         analytically.
+///
+/// \details The upper bone runs from root_joint to mid_joint, which must be
+///         its child, and the lower bone from mid_joint to end_offset, a
+///         point in mid_joint's space (the hand or foot).  A target out of
+///         reach straightens the limb towards it.
+struct TwoBoneIkChain
+{
+    size_t root_joint;
+    size_t mid_joint;
+    vec2 end_offset;        ///< The end of the lower bone, in mid_joint's space.
+    bool bend_clockwise;    ///< Which way the middle joint bends.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A chain of any number of bones, which is solved with FABRIK
+///         (forward and backward reaching inverse kinematics).
+///
+/// \details Each joint after the first must be the child of the one before,
+///         and the last bone runs from the last joint to end_offset.
+struct IkChain
+{
+    std::vector<size_t> joints;
+    vec2 end_offset;        ///< The end of the last bone, in the last joint's space.
+};
+
+vec2 getModelPosition(const Skeleton& skeleton, const Pose& pose, size_t joint, const vec2& offset);
+
+void solveTwoBoneIk(const Skeleton& skeleton, const TwoBoneIkChain& chain, const vec2* targets,
+                    Pose* poses, size_t pose_count);
+void solveFabrikIk(const Skeleton& skeleton, const IkChain& chain, const vec2* targets,
+                   Pose* poses, size_t pose_count, size_t max_iterations, float tolerance = 0.0f,
+                   FrameArena* arena = NULL);
+
+#endif
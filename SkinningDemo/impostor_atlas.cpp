@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  impostor_atlas.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of ImpostorAtlas class functions.
+
+#include "impostor_atlas.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the texture, with room for every frame, and the
+///         framebuffer they're drawn through.
+///
+/// \details The cells are laid out as close to square as they'll go, so
+///         the texture stays within the driver's size limits for as many
+///         frames as possible.  If the framebuffer is incomplete, the
+///         problem is reported to stderr and an exception is thrown.
+///
+/// \param  frame_count The number of frames the atlas holds.
+/// \param  cell_size The width and height of each frame in pixels; a power
+///         of two, so each mipmap level halves the cells exactly.
+ImpostorAtlas::ImpostorAtlas(size_t frame_count, GLsizei cell_size)
+    : texture_id_(0),
+      framebuffer_id_(0),
+      frame_count_(frame_count),
+      columns_(1),
+      rows_(1),
+      cell_size_(cell_size),
+      max_level_(0)
+{
+    assert(frame_count > 0);
+    while (columns_ * columns_ < frame_count)
+        ++columns_;
+    rows_ = (frame_count + columns_ - 1) / columns_;
+
+    for (GLsizei size = cell_size_; size > MIN_MIP_CELL_SIZE; size /= 2)
+        ++max_level_;
+
+    GLsizei width = GLsizei(columns_) * cell_size_;
+    GLsizei height = GLsizei(rows_) * cell_size_;
+    glGenTextures(1, &texture_id_);
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    for (GLint level = 0; level <= max_level_; ++level)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, std::max(width >> level, 1), std::max(height >> level, 1), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max_level_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &framebuffer_id_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id_, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        glDeleteFramebuffers(1, &framebuffer_id_);
+        glDeleteTextures(1, &texture_id_);
+
+        std::cerr << "The impostor framebuffer is incomplete!" << std::endl
+                  << "  Size: " << width << "x" << height << std::endl;
+        throw std::runtime_error("The impostor framebuffer is incomplete!");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the texture and the framebuffer.
+ImpostorAtlas::~ImpostorAtlas()
+{
+    glDeleteFramebuffers(1, &framebuffer_id_);
+    glDeleteTextures(1, &texture_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Binds the framebuffer for drawing the frames into, and clears
+///         the whole atlas to transparent.
+///
+/// \details The viewport is saved for endCapture() to put back, and the
+///         scissor test is left on, to keep each frame inside its cell.
+void ImpostorAtlas::beginCapture()
+{
+    glGetIntegerv(GL_VIEWPORT, saved_viewport_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glViewport(0, 0, GLsizei(columns_) * cell_size_, GLsizei(rows_) * cell_size_);
+    glDisable(GL_SCISSOR_TEST);
+    const GLfloat transparent[4] = { 0, 0, 0, 0 };
+    glClearBufferfv(GL_COLOR, 0, transparent);
+    glEnable(GL_SCISSOR_TEST);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Points the viewport and scissor at a frame's cell, so the next
+///         draws go into it.
+///
+/// \param  frame The frame to draw, from 0 to getFrameCount() - 1.
+void ImpostorAtlas::bindFrame(size_t frame)
+{
+    assert(frame < frame_count_);
+    GLint x = GLint(frame % columns_) * cell_size_;
+    GLint y = GLint(frame / columns_) * cell_size_;
+    glViewport(x, y, cell_size_, cell_size_);
+    glScissor(x, y, cell_size_, cell_size_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unbinds the framebuffer, puts back the viewport, turns the
+///         scissor test back off, and builds the mipmaps from the frames.
+void ImpostorAtlas::endCapture()
+{
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(saved_viewport_[0], saved_viewport_[1], saved_viewport_[2], saved_viewport_[3]);
+
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the name of the atlas texture.
+GLuint ImpostorAtlas::getTextureId() const
+{
+    return texture_id_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of frames in the atlas.
+size_t ImpostorAtlas::getFrameCount() const
+{
+    return frame_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of cells in each row of the atlas.
+size_t ImpostorAtlas::getColumnCount() const
+{
+    return columns_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of rows of cells in the atlas.
+size_t ImpostorAtlas::getRowCount() const
+{
+    return rows_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the width and height of each frame in pixels, at the
+///         texture's full detail.
+GLsizei ImpostorAtlas::getCellSize() const
+{
+    return cell_size_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the texture in bytes, with its mipmaps.
+size_t ImpostorAtlas::getTextureBytes() const
+{
+    size_t width = columns_ * cell_size_;
+    size_t height = rows_ * cell_size_;
+    size_t bytes = 0;
+    for (GLint level = 0; level <= max_level_; ++level)
+        bytes += std::max(width >> level, size_t(1)) * std::max(height >> level, size_t(1)) * 4;
+    return bytes;
+}
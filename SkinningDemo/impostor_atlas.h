@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  impostor_atlas.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the ImpostorAtlas class.
+
+#ifndef IMPOSTOR_ATLAS_H_
+#define IMPOSTOR_ATLAS_H_
+
+#include "demo.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A texture of pre-rendered frames of a skinned mesh, which a
+///         distant instance can be drawn from as a textured quad, without
+///         being posed or skinned.
+///
+/// \details The frames are square cells of one RGBA8 texture, laid out in
+///         rows of getColumnCount() from the bottom left, frame 0 first.
+///         Each frame is drawn into its cell between bindFrame() and the
+///         next bindFrame() or endCapture(), through the texture's own
+///         framebuffer; everything outside the mesh is left transparent,
+///         so the quads can test its alpha.  endCapture() builds the
+///         mipmaps, down to the level whose cells are MIN_MIP_CELL_SIZE
+///         across, so that the smaller levels don't blend neighboring
+///         frames together.
+///
+///         Must be created, used and destroyed on the thread which owns the
+///         GL context.
+class ImpostorAtlas
+{
+public:
+    ImpostorAtlas(size_t frame_count, GLsizei cell_size);
+    ~ImpostorAtlas();
+
+    void beginCapture();
+    void bindFrame(size_t frame);
+    void endCapture();
+
+    GLuint getTextureId() const;
+    size_t getFrameCount() const;
+    size_t getColumnCount() const;
+    size_t getRowCount() const;
+    GLsizei getCellSize() const;
+    size_t getTextureBytes() const;
+
+private:
+    ImpostorAtlas(const ImpostorAtlas&);            // non-copyable
+    ImpostorAtlas& operator=(const ImpostorAtlas&); // non-copyable
+
+    static const GLsizei MIN_MIP_CELL_SIZE = 8;
+
+    GLuint texture_id_;
+    GLuint framebuffer_id_;
+    size_t frame_count_;
+    size_t columns_;
+    size_t rows_;
+    GLsizei cell_size_;
+    GLint max_level_;
+    GLint saved_viewport_[4];   ///< The viewport beginCapture() replaced.
+};
+
+#endif
@@ -0,0 +1,207 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  index_codec.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the index compression functions.
+
+#include "index_codec.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace {
+
+const size_t MAX_CODE_BYTES = 5;        ///< Bytes in the varint of the largest 32-bit number.
+const size_t BLOCK_CODES = 16;          ///< Single-byte codes the SSE2 decoder takes at a time.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns one of the indices, as a GLuint whatever its type.
+GLuint readIndex(const void* indices, size_t i, GLenum index_type)
+{
+    switch (index_type)
+    {
+    case GL_UNSIGNED_BYTE:  return static_cast<const GLubyte*>(indices)[i];
+    case GL_UNSIGNED_SHORT: return static_cast<const GLushort*>(indices)[i];
+    default:                return static_cast<const GLuint*>(indices)[i];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stores a run of decoded indices as the index type, or returns
+///         false if one of them doesn't fit in it.
+bool writeIndices(const GLuint* values, size_t count, GLenum index_type, void* indices, size_t first)
+{
+    switch (index_type)
+    {
+    case GL_UNSIGNED_BYTE:
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (values[i] > 0xFF)
+                return false;
+            static_cast<GLubyte*>(indices)[first + i] = GLubyte(values[i]);
+        }
+        return true;
+
+    case GL_UNSIGNED_SHORT:
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (values[i] > 0xFFFF)
+                return false;
+            static_cast<GLushort*>(indices)[first + i] = GLushort(values[i]);
+        }
+        return true;
+
+    default:
+        std::memcpy(static_cast<GLuint*>(indices) + first, values, count * sizeof(GLuint));
+        return true;
+    }
+}
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Un-zigzags 4 single-byte codes, widened to 32-bit lanes, and sums
+///         them onto the index before them.
+///
+/// \param  codes The codes, one per lane.
+/// \param  base The index before the first code, in every lane; updated to
+///         the last of the 4 new indices.
+/// \param  values Receives the 4 indices.
+inline void decodeLanes(__m128i codes, __m128i& base, GLuint* values)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+
+    __m128i sign = _mm_sub_epi32(zero, _mm_and_si128(codes, one));
+    __m128i deltas = _mm_xor_si128(_mm_srli_epi32(codes, 1), sign);
+
+    // Prefix sum across the lanes, so each holds its offset from the base.
+    deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+    deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+
+    __m128i result = _mm_add_epi32(deltas, base);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values), result);
+    base = _mm_shuffle_epi32(result, 0xFF);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decodes 16 single-byte codes into indices.
+///
+/// \param  bytes The codes; none of them may have its continuation bit set.
+/// \param  previous The index before the first code; updated to the last of
+///         the 16 new indices.
+/// \param  values Receives the 16 indices.
+inline void decodeBlock(const char* bytes, GLuint& previous, GLuint* values)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i codes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+    __m128i low = _mm_unpacklo_epi8(codes, zero);
+    __m128i high = _mm_unpackhi_epi8(codes, zero);
+
+    __m128i base = _mm_set1_epi32(int(previous));
+    decodeLanes(_mm_unpacklo_epi16(low, zero), base, values);
+    decodeLanes(_mm_unpackhi_epi16(low, zero), base, values + 4);
+    decodeLanes(_mm_unpacklo_epi16(high, zero), base, values + 8);
+    decodeLanes(_mm_unpackhi_epi16(high, zero), base, values + 12);
+    previous = values[BLOCK_CODES - 1];
+}
+#endif
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compresses an array of indices.
+///
+/// \param  indices The indices.
+/// \param  index_count The number of indices.
+/// \param  index_type GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+/// \param  encoded Receives the compressed indices, in place of anything it
+///         held before.  The index type and count aren't part of it, so
+///         they must be kept alongside it.
+void encodeIndices(const void* indices, size_t index_count, GLenum index_type, std::vector<char>& encoded)
+{
+    assert(index_type == GL_UNSIGNED_BYTE || index_type == GL_UNSIGNED_SHORT || index_type == GL_UNSIGNED_INT);
+
+    encoded.clear();
+    encoded.reserve(index_count + index_count / 8);
+
+    GLuint previous = 0;
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        GLuint index = readIndex(indices, i, index_type);
+        GLuint delta = index - previous;
+        GLuint code = (delta << 1) ^ (0u - (delta >> 31));
+        previous = index;
+
+        while (code >= 0x80)
+        {
+            encoded.push_back(char((code & 0x7F) | 0x80));
+            code >>= 7;
+        }
+        encoded.push_back(char(code));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decompresses an array of indices compressed by encodeIndices().
+///
+/// \param  encoded The compressed indices.
+/// \param  encoded_size The size of the compressed indices, in bytes.
+/// \param  index_count The number of indices they were compressed from.
+/// \param  index_type The type to decompress them as, which can be smaller
+///         than the one they were compressed from if they all fit in it.
+/// \param  indices Receives the indices; room for index_count of them.
+/// \return false if the compressed indices are cut short, run on past
+///         index_count, or decode to an index too big for index_type, in
+///         which case whatever was written to indices is meaningless.
+bool decodeIndices(const char* encoded, size_t encoded_size, size_t index_count, GLenum index_type, void* indices)
+{
+    assert(index_type == GL_UNSIGNED_BYTE || index_type == GL_UNSIGNED_SHORT || index_type == GL_UNSIGNED_INT);
+
+    GLuint values[BLOCK_CODES];
+    GLuint previous = 0;
+    size_t position = 0;
+    size_t i = 0;
+
+    while (i < index_count)
+    {
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+        if (index_count - i >= BLOCK_CODES && encoded_size - position >= BLOCK_CODES)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(encoded + position));
+            if (_mm_movemask_epi8(bytes) == 0)
+            {
+                decodeBlock(encoded + position, previous, values);
+                if (!writeIndices(values, BLOCK_CODES, index_type, indices, i))
+                    return false;
+
+                position += BLOCK_CODES;
+                i += BLOCK_CODES;
+                continue;
+            }
+        }
+#endif
+
+        GLuint code = 0;
+        for (size_t b = 0; ; ++b)
+        {
+            if (b == MAX_CODE_BYTES || position == encoded_size)
+                return false;
+
+            unsigned char byte = static_cast<unsigned char>(encoded[position++]);
+            if (b == MAX_CODE_BYTES - 1 && byte > 0x0F)
+                return false;   // more than 32 bits
+
+            code |= GLuint(byte & 0x7F) << (7 * b);
+            if (byte < 0x80)
+                break;
+        }
+
+        previous += (code >> 1) ^ (0u - (code & 1));
+        if (!writeIndices(&previous, 1, index_type, indices, i))
+            return false;
+        ++i;
+    }
+
+    return position == encoded_size;
+}
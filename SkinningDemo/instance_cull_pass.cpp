@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  instance_cull_pass.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of InstanceCullPass class functions.
+
+#include "instance_cull_pass.h"
+
+#include <algorithm>
+#include <cassert>
+
+const GLuint InstanceCullPass::WORKGROUP_SIZE;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the pass's buffers, with no meshes added yet.
+///
+/// \param  max_instances The most candidates cull() is given at once.
+InstanceCullPass::InstanceCullPass(size_t max_instances)
+    : max_instances_(max_instances),
+      candidate_buffer_id_(0),
+      joint_bounds_buffer_id_(0),
+      mesh_buffer_id_(0),
+      command_buffer_id_(0),
+      survivor_buffer_id_(0),
+      uploaded_(false)
+{
+    glGenBuffers(1, &candidate_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, candidate_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max_instances * sizeof(Candidate), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenBuffers(1, &joint_bounds_buffer_id_);
+    glGenBuffers(1, &mesh_buffer_id_);
+    glGenBuffers(1, &command_buffer_id_);
+    glGenBuffers(1, &survivor_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the pass's buffers.
+InstanceCullPass::~InstanceCullPass()
+{
+    glDeleteBuffers(1, &candidate_buffer_id_);
+    glDeleteBuffers(1, &joint_bounds_buffer_id_);
+    glDeleteBuffers(1, &mesh_buffer_id_);
+    glDeleteBuffers(1, &command_buffer_id_);
+    glDeleteBuffers(1, &survivor_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a mesh the candidates can be drawn with, and its indirect
+///         commands.
+///
+/// \param  allocation Where the mesh is in the arena it's drawn from.
+/// \param  joint_bounds The bind-pose bounds of the vertices each joint
+///         influences, as from SkeletalMeshBase::getJointBounds().
+/// \param  joint_count The number of matrices in each of the mesh's
+///         palettes; joints past the end of joint_bounds are left empty.
+///
+/// \return The mesh's index, for Candidate::mesh.
+size_t InstanceCullPass::addMesh(const MeshArena::Allocation& allocation, const std::vector<BoundingBox>& joint_bounds,
+                                 size_t joint_count)
+{
+    size_t index_size = getIndexSize(allocation.index_type);
+    assert(allocation.index_offset % index_size == 0);
+
+    CullMesh mesh;
+    mesh.palette_base = 0;
+    mesh.joint_count = GLuint(joint_count);
+    mesh.first_bound = GLuint(joint_bounds_.size());
+    mesh.first_command = GLuint(commands_.size());
+    mesh.command_count = GLuint(allocation.partitions.size());
+    mesh.first_survivor = GLuint(meshes_.size() * max_instances_);
+    mesh.padding[0] = mesh.padding[1] = 0;
+
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        BoundingBox box = joint < joint_bounds.size() ? joint_bounds[joint] : BoundingBox();
+        joint_bounds_.push_back(vec4(box.min, box.max));
+    }
+
+    // every partition gets a command, even an empty one, so a mesh's
+    // commands are always indexed like its partitions.
+    for (size_t i = 0; i < allocation.partitions.size(); ++i)
+    {
+        const SkeletalMesh::Partition& partition = allocation.partitions[i];
+        RenderQueue::DrawElementsIndirectCommand command;
+        command.count = GLuint(partition.index_count);
+        command.instance_count = 0;
+        command.first_index = GLuint(allocation.index_offset / index_size + partition.first_index);
+        command.base_vertex = GLint(allocation.first_vertex);
+        command.base_instance = mesh.first_survivor;
+        commands_.push_back(command);
+    }
+
+    meshes_.push_back(mesh);
+    index_types_.push_back(allocation.index_type);
+    uploaded_ = false;
+    return meshes_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Points RenderQueue::PALETTE_INDEX_ATTRIBUTE of a VAO at the
+///         survivor list, for draw().  RenderQueue::attachPaletteIndices()
+///         points it back.
+void InstanceCullPass::attachSurvivors(GLuint vao_id) const
+{
+    glBindVertexArray(vao_id);
+    glBindBuffer(GL_ARRAY_BUFFER, survivor_buffer_id_);
+    glVertexAttribIPointer(RenderQueue::PALETTE_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), nullptr);
+    glVertexAttribDivisor(RenderQueue::PALETTE_INDEX_ATTRIBUTE, 1);
+    glEnableVertexAttribArray(RenderQueue::PALETTE_INDEX_ATTRIBUTE);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Culls this frame's candidates, leaving the survivors' palette
+///         indices and instance counts for draw().
+///
+/// \details The commands' instance counts are reset in fresh storage first,
+///         so this frame's counting doesn't wait for last frame's draws.
+///         The draws wait for the counting with a command and vertex
+///         attribute barrier.
+///
+/// \param  compute_program_id The instance culling compute shader program.
+/// \param  palette_texture_id The instance_palettes texture buffer, holding
+///         this frame's palettes.  It's left bound to texture unit 0.
+/// \param  candidates The instances which might be visible.
+/// \param  candidate_count The number of candidates; at most max_instances.
+/// \param  palette_offsets Where each mesh's palettes start in the texture
+///         buffer, in matrices.
+void InstanceCullPass::cull(GLuint compute_program_id, GLuint palette_texture_id,
+                            const Candidate* candidates, size_t candidate_count, const size_t* palette_offsets)
+{
+    assert(candidate_count <= max_instances_);
+    for (size_t i = 0; i < meshes_.size(); ++i)
+        meshes_[i].palette_base = GLuint(palette_offsets[i]);
+
+    if (!uploaded_)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, joint_bounds_buffer_id_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(joint_bounds_.size(), size_t(1)) * sizeof(vec4),
+                     joint_bounds_.data(), GL_STATIC_DRAW);
+
+        // each mesh's survivors get room for every instance.
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, survivor_buffer_id_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(meshes_.size(), size_t(1)) * max_instances_ * sizeof(GLuint),
+                     nullptr, GL_DYNAMIC_COPY);
+        uploaded_ = true;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mesh_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshes_.size() * sizeof(CullMesh), meshes_.data(), GL_STREAM_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, command_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands_.size() * sizeof(RenderQueue::DrawElementsIndirectCommand),
+                 commands_.data(), GL_STREAM_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, candidate_buffer_id_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, candidate_count * sizeof(Candidate), candidates);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (candidate_count == 0)
+        return;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, candidate_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, joint_bounds_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mesh_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, command_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, survivor_buffer_id_);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, palette_texture_id);
+
+    glUseProgram(compute_program_id);
+    glUniform1i(glGetUniformLocation(compute_program_id, "instance_palettes"), 0);
+    glUniform1ui(glGetUniformLocation(compute_program_id, "candidate_count"), GLuint(candidate_count));
+    glDispatchCompute(GLuint((candidate_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1, 1);
+    glUseProgram(0);
+
+    // the draws read the counts as commands, and the survivors as attributes.
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws one partition of a mesh for every instance which survived
+///         the last cull(), with a single glDrawElementsIndirect.
+///
+/// \details The VAO the mesh's arena is drawn with must be bound, with the
+///         survivor list attached, and so must the program for the
+///         partition, with its palette_base set to the mesh's palette
+///         offset.  Empty partitions are skipped.
+///
+/// \param  state Binds the command buffer, which is left bound.
+/// \param  mesh The mesh, as returned by addMesh().
+/// \param  partition The partition of the mesh's allocation.
+void InstanceCullPass::draw(GLStateCache& state, size_t mesh, size_t partition) const
+{
+    assert(partition < meshes_[mesh].command_count);
+    size_t command = meshes_[mesh].first_command + partition;
+    if (commands_[command].count == 0)
+        return;
+
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_id_);
+    glDrawElementsIndirect(GL_TRIANGLES, index_types_[mesh],
+                           reinterpret_cast<void*>(command * sizeof(RenderQueue::DrawElementsIndirectCommand)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of meshes added.
+size_t InstanceCullPass::getMeshCount() const
+{
+    return meshes_.size();
+}
@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  instance_cull_pass.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the InstanceCullPass class.
+
+#ifndef INSTANCE_CULL_PASS_H_
+#define INSTANCE_CULL_PASS_H_
+
+#include "mesh_arena.h"
+#include "render_queue.h"
+#include "gl_state_cache.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Culls a crowd of instanced meshes on the GPU with a compute
+///         shader, and draws the survivors with one glDrawElementsIndirect
+///         per partition of each mesh, however many instances there are or
+///         survive.
+///
+/// \details Each mesh (typically one level of detail) is added with the
+///         bind-pose bounds of the vertices each of its joints influences,
+///         and gets one indirect command per partition.  cull() is then
+///         given the candidate instances, each with its mesh and its
+///         palette's index among that mesh's palettes in the
+///         instance_palettes texture buffer.  One invocation per candidate
+///         bounds it by moving each joint's bounds with its palette matrix,
+///         tests that against the viewport, and appends the survivors'
+///         palette indices to their mesh's part of the survivor list,
+///         counting them into the instance counts of the mesh's commands.
+///         Nothing is read back; draw() issues the commands as they were
+///         left.
+///
+///         The survivor list takes the place of RenderQueue's palette index
+///         buffer: attachSurvivors() points PALETTE_INDEX_ATTRIBUTE of a VAO
+///         at it, and each command's base instance is where its mesh's part
+///         of the list starts, so the instanced programs read the right
+///         palette for each surviving instance without any other changes.
+///         Needs GL 4.3.
+class InstanceCullPass
+{
+public:
+    static const GLuint WORKGROUP_SIZE = 64;    ///< Must match the compute shader's local_size_x.
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  An instance which might be visible.
+    struct Candidate
+    {
+        GLuint mesh;            ///< Which of the added meshes it's drawn with.
+        GLuint palette_index;   ///< Its palette's index among the mesh's palettes.
+    };
+
+    explicit InstanceCullPass(size_t max_instances);
+    ~InstanceCullPass();
+
+    size_t addMesh(const MeshArena::Allocation& allocation, const std::vector<BoundingBox>& joint_bounds,
+                   size_t joint_count);
+    void attachSurvivors(GLuint vao_id) const;
+
+    void cull(GLuint compute_program_id, GLuint palette_texture_id,
+              const Candidate* candidates, size_t candidate_count, const size_t* palette_offsets);
+    void draw(GLStateCache& state, size_t mesh, size_t partition) const;
+
+    size_t getMeshCount() const;
+
+private:
+    InstanceCullPass(const InstanceCullPass&);              // non-copyable
+    InstanceCullPass& operator=(const InstanceCullPass&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One added mesh, laid out like the compute shader's CullLod.
+    struct CullMesh
+    {
+        GLuint palette_base;    ///< Where the mesh's palettes start, in matrices; set by cull().
+        GLuint joint_count;
+        GLuint first_bound;
+        GLuint first_command;
+        GLuint command_count;
+        GLuint first_survivor;
+        GLuint padding[2];
+    };
+
+    size_t max_instances_;
+    std::vector<CullMesh> meshes_;
+    std::vector<GLenum> index_types_;   ///< The index type of each mesh's commands.
+    std::vector<vec4> joint_bounds_;    ///< Every mesh's joints' bounds, as min.xy and max.xy.
+    std::vector<RenderQueue::DrawElementsIndirectCommand> commands_;    ///< With instance counts of 0.
+
+    GLuint candidate_buffer_id_;
+    GLuint joint_bounds_buffer_id_;
+    GLuint mesh_buffer_id_;
+    GLuint command_buffer_id_;
+    GLuint survivor_buffer_id_;
+    bool uploaded_;     ///< Whether the bounds and survivor buffers have room for every mesh.
+};
+
+#endif
@@ -0,0 +1,271 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  jiggle_chains.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of JiggleChains class functions.
+
+#include "jiggle_chains.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+const size_t JiggleChains::SUBSTEPS;
+const float JiggleChains::MAX_FRAME_SECONDS = 1.0f / 20.0f;
+const size_t JiggleChains::NO_JOINT;
+const size_t JiggleChains::NEVER;
+
+namespace {
+
+/// Joints closer to their parents than this aren't held away from them.
+const float MIN_DISTANCE_SQUARED = 1e-12f;
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a set of chains with no joints.
+///
+/// \param  skeleton The skeleton the chains' joints are in, which must
+///         outlive them.
+/// \param  instance_count The number of instances to simulate the chains of.
+JiggleChains::JiggleChains(const Skeleton& skeleton, size_t instance_count)
+    : skeleton_(skeleton),
+      instance_count_(instance_count),
+      frame_(1),
+      previous_step_(0),
+      jiggle_of_joint_(skeleton.getJointCount(), NO_JOINT),
+      targeted_frames_(instance_count, NEVER)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a joint to the end of a chain, or starts a new chain with
+///         it if its parent isn't a jiggle joint.
+///
+/// \param  joint The joint; it can't be a root.
+/// \param  stiffness How hard the joint is pulled back to where the
+///         animation puts it, per second squared.  The larger it is, the
+///         less it lags; it should stay well under SUBSTEPS^2 /
+///         MAX_FRAME_SECONDS^2, past which the spring overshoots.
+/// \param  damping How quickly the joint's swinging dies away, per second.
+/// \return The jiggle joint's index.
+size_t JiggleChains::addJoint(size_t joint, float stiffness, float damping)
+{
+    int parent = skeleton_.getParent(joint);
+    if (parent == Skeleton::NO_PARENT || jiggle_of_joint_[joint] != NO_JOINT)
+    {
+        std::cerr << "Joint " << joint << " is a root, or already jiggles." << std::endl;
+        throw std::runtime_error("Invalid jiggle joint!");
+    }
+
+    JiggleJoint jiggle;
+    jiggle.joint = joint;
+    jiggle.parent = parent;
+    jiggle.parent_jiggle = jiggle_of_joint_[parent];
+    jiggle.stiffness = stiffness;
+    jiggle.damping = damping;
+
+    // every lane is stale until it's targeted, so the new streams' values
+    // don't matter.
+    jiggle_of_joint_[joint] = joints_.size();
+    joints_.push_back(jiggle);
+    streams_.resize(joints_.size() * STREAM_COUNT * instance_count_, 0.0f);
+    std::fill(targeted_frames_.begin(), targeted_frames_.end(), NEVER);
+    return joints_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of jiggle joints, in all the chains.
+size_t JiggleChains::getJointCount() const
+{
+    return joints_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies where the animation puts an instance's jiggle joints this
+///         frame into their lanes.
+///
+/// \details Instances touch different lanes, so each one's targets can be
+///         set from its own job; but every instance must be targeted before
+///         simulate() is called.  An instance which wasn't targeted last
+///         frame has its joints moved straight to their targets.
+///
+/// \param  instance The instance.
+/// \param  joint_transforms The instance's local-to-model joint transforms,
+///         as the animation poses them.
+void JiggleChains::setTargets(size_t instance, const mat4* joint_transforms)
+{
+    assert(instance < instance_count_);
+    size_t last_frame = targeted_frames_[instance];
+    bool stale = last_frame != frame_ && last_frame + 1 != frame_;
+    targeted_frames_[instance] = frame_;
+
+    for (size_t jiggle = 0; jiggle < joints_.size(); ++jiggle)
+    {
+        const JiggleJoint& joint = joints_[jiggle];
+        vec2 target(joint_transforms[joint.joint][3]);
+        vec2 parent(joint_transforms[joint.parent][3]);
+
+        getStream(jiggle, STREAM_TARGET_X)[instance] = target.x;
+        getStream(jiggle, STREAM_TARGET_Y)[instance] = target.y;
+        getStream(jiggle, STREAM_PARENT_X)[instance] = parent.x;
+        getStream(jiggle, STREAM_PARENT_Y)[instance] = parent.y;
+        getStream(jiggle, STREAM_LENGTH)[instance] = glm::length(target - parent);
+
+        if (stale)
+        {
+            getStream(jiggle, STREAM_X)[instance] = target.x;
+            getStream(jiggle, STREAM_Y)[instance] = target.y;
+            getStream(jiggle, STREAM_PREVIOUS_X)[instance] = target.x;
+            getStream(jiggle, STREAM_PREVIOUS_Y)[instance] = target.y;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves every instance's jiggle joints on by a frame, towards the
+///         targets they were last set to.
+///
+/// \details The frame is split into SUBSTEPS, and each substep steps the
+///         joints in the order they were added, so each chain's joints are
+///         held to where their parents have just moved.  Instances which
+///         weren't targeted this frame are stepped too, towards their old
+///         targets; it costs less than skipping their lanes would.
+///
+/// \param  seconds How long the frame was; anything past MAX_FRAME_SECONDS
+///         is dropped.
+void JiggleChains::simulate(float seconds)
+{
+    seconds = std::min(seconds, MAX_FRAME_SECONDS);
+    if (seconds > 0)
+    {
+        // Verlet's velocities are the distance moved in the last substep, so
+        // they're scaled when the substeps change length.
+        float step = seconds / SUBSTEPS;
+        float step_ratio = previous_step_ > 0 ? step / previous_step_ : 1.0f;
+        for (size_t substep = 0; substep < SUBSTEPS; ++substep)
+        {
+            for (size_t jiggle = 0; jiggle < joints_.size(); ++jiggle)
+                stepJoint(jiggle, step, substep == 0 ? step_ratio : 1.0f);
+        }
+        previous_step_ = step;
+    }
+    ++frame_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves an instance's jiggle joints in its skinning palette from
+///         where the animation put them to where simulate() last left them.
+///
+/// \details Moving a joint by an offset in model space moves its palette
+///         entry by the same offset, whatever its inverse bind transform is,
+///         so only the translations change.  The palette must have been
+///         built from the joint transforms last given to setTargets().
+///
+/// \param  instance The instance.
+/// \param  palette The instance's palette, in its model space.
+void JiggleChains::applyToPalette(size_t instance, mat4* palette) const
+{
+    assert(instance < instance_count_);
+    for (size_t jiggle = 0; jiggle < joints_.size(); ++jiggle)
+    {
+        vec4& translation = palette[joints_[jiggle].joint][3];
+        translation.x += getStream(jiggle, STREAM_X)[instance] - getStream(jiggle, STREAM_TARGET_X)[instance];
+        translation.y += getStream(jiggle, STREAM_Y)[instance] - getStream(jiggle, STREAM_TARGET_Y)[instance];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the start of one of a jiggle joint's arrays of lanes.
+float* JiggleChains::getStream(size_t jiggle, Stream stream)
+{
+    return &streams_[(jiggle * STREAM_COUNT + stream) * instance_count_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the start of one of a jiggle joint's arrays of lanes.
+const float* JiggleChains::getStream(size_t jiggle, Stream stream) const
+{
+    return &streams_[(jiggle * STREAM_COUNT + stream) * instance_count_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Steps one jiggle joint of every instance by a substep.
+///
+/// \details Each lane is integrated with damped Verlet, with the spring
+///         towards its target as its only force, and is then pulled in or
+///         pushed out along the line from its parent to its bone's length.
+///
+/// \param  jiggle The jiggle joint.
+/// \param  step The substep's length, in seconds.
+/// \param  step_ratio The substep's length over the last one's.
+void JiggleChains::stepJoint(size_t jiggle, float step, float step_ratio)
+{
+    const JiggleJoint& joint = joints_[jiggle];
+    float keep = std::exp(-joint.damping * step) * step_ratio;
+    float pull = joint.stiffness * step * step;
+
+    float* x = getStream(jiggle, STREAM_X);
+    float* y = getStream(jiggle, STREAM_Y);
+    float* previous_x = getStream(jiggle, STREAM_PREVIOUS_X);
+    float* previous_y = getStream(jiggle, STREAM_PREVIOUS_Y);
+    const float* target_x = getStream(jiggle, STREAM_TARGET_X);
+    const float* target_y = getStream(jiggle, STREAM_TARGET_Y);
+    const float* length = getStream(jiggle, STREAM_LENGTH);
+
+    // a chain's first joint hangs from its animated parent; the rest hang
+    // from the jiggle joint before them, which has already been stepped.
+    bool animated_parent = joint.parent_jiggle == NO_JOINT;
+    const float* parent_x = animated_parent ? getStream(jiggle, STREAM_PARENT_X) : getStream(joint.parent_jiggle, STREAM_X);
+    const float* parent_y = animated_parent ? getStream(jiggle, STREAM_PARENT_Y) : getStream(joint.parent_jiggle, STREAM_Y);
+
+    size_t lane = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 keep4 = _mm_set1_ps(keep);
+    const __m128 pull4 = _mm_set1_ps(pull);
+    const __m128 min_distance4 = _mm_set1_ps(MIN_DISTANCE_SQUARED);
+    const __m128 one4 = _mm_set1_ps(1.0f);
+    for (; lane + 4 <= instance_count_; lane += 4)
+    {
+        __m128 x4 = _mm_loadu_ps(x + lane);
+        __m128 y4 = _mm_loadu_ps(y + lane);
+        __m128 next_x = _mm_add_ps(x4, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(x4, _mm_loadu_ps(previous_x + lane)), keep4),
+                                                  _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(target_x + lane), x4), pull4)));
+        __m128 next_y = _mm_add_ps(y4, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(y4, _mm_loadu_ps(previous_y + lane)), keep4),
+                                                  _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(target_y + lane), y4), pull4)));
+        _mm_storeu_ps(previous_x + lane, x4);
+        _mm_storeu_ps(previous_y + lane, y4);
+
+        __m128 parent_x4 = _mm_loadu_ps(parent_x + lane);
+        __m128 parent_y4 = _mm_loadu_ps(parent_y + lane);
+        __m128 dx = _mm_sub_ps(next_x, parent_x4);
+        __m128 dy = _mm_sub_ps(next_y, parent_y4);
+        __m128 distance_squared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 far_enough = _mm_cmpgt_ps(distance_squared, min_distance4);
+        __m128 scale = _mm_div_ps(_mm_loadu_ps(length + lane), _mm_sqrt_ps(_mm_max_ps(distance_squared, min_distance4)));
+        scale = _mm_or_ps(_mm_and_ps(far_enough, scale), _mm_andnot_ps(far_enough, one4));
+
+        _mm_storeu_ps(x + lane, _mm_add_ps(parent_x4, _mm_mul_ps(dx, scale)));
+        _mm_storeu_ps(y + lane, _mm_add_ps(parent_y4, _mm_mul_ps(dy, scale)));
+    }
+#endif
+
+    for (; lane < instance_count_; ++lane)
+    {
+        float next_x = x[lane] + ((x[lane] - previous_x[lane]) * keep + (target_x[lane] - x[lane]) * pull);
+        float next_y = y[lane] + ((y[lane] - previous_y[lane]) * keep + (target_y[lane] - y[lane]) * pull);
+        previous_x[lane] = x[lane];
+        previous_y[lane] = y[lane];
+
+        float dx = next_x - parent_x[lane];
+        float dy = next_y - parent_y[lane];
+        float distance_squared = dx * dx + dy * dy;
+        float scale = distance_squared > MIN_DISTANCE_SQUARED ? length[lane] / std::sqrt(distance_squared) : 1.0f;
+        x[lane] = parent_x[lane] + dx * scale;
+        y[lane] = parent_y[lane] + dy * scale;
+    }
+}
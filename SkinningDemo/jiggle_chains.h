@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  jiggle_chains.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the JiggleChains class.
+
+#ifndef JIGGLE_CHAINS_H_
+#define JIGGLE_CHAINS_H_
+
+#include "skeleton.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Spring-damped secondary motion for chains of joints (hair,
+///         tails, accessories) across every instance of a crowd, added to
+///         their palettes after the hierarchy has been flattened.
+///
+/// \details Each jiggle joint is a Verlet particle sprung towards where the
+///         animation puts it, and held at its bone's length from its parent,
+///         so it lags and swings as the pose moves.  A joint's parent is
+///         either animated, when the joint starts a chain, or the jiggle
+///         joint before it in the chain, so the chains are integrated in the
+///         order their joints were added, root to tip.
+///
+///         The particles are kept as structures of arrays: for each jiggle
+///         joint, one array per coordinate with a lane for every instance.
+///         So simulate() steps four instances at a time with SSE2, joint by
+///         joint, and never gathers anything; the gathers and scatters are
+///         left to setTargets() and applyToPalette(), which each touch one
+///         instance and can run in that instance's own jobs.
+///
+///         The particles move in each instance's model space; the palette
+///         moves each joint by its particle's offset from where the
+///         animation put it, which moves the joint's vertices with it.  The
+///         joints below a jiggle joint which aren't jiggle joints themselves
+///         don't follow, so chains should run out to the skeleton's leaves.
+///
+///         Every frame is integrated in SUBSTEPS equal steps, however long
+///         it was, and frames longer than MAX_FRAME_SECONDS are clamped; so
+///         the cost is fixed, and a hitch slows the motion down rather than
+///         making it explode.  An instance's lanes snap to its targets when
+///         it's targeted after a frame without them, so nothing swings in
+///         from wherever it was left the last time the instance was posed.
+class JiggleChains
+{
+public:
+    static const size_t SUBSTEPS = 4;
+    static const float MAX_FRAME_SECONDS;
+
+    JiggleChains(const Skeleton& skeleton, size_t instance_count);
+
+    size_t addJoint(size_t joint, float stiffness, float damping);
+    size_t getJointCount() const;
+
+    void setTargets(size_t instance, const mat4* joint_transforms);
+    void simulate(float seconds);
+    void applyToPalette(size_t instance, mat4* palette) const;
+
+private:
+    JiggleChains(const JiggleChains&);              // non-copyable
+    JiggleChains& operator=(const JiggleChains&);   // non-copyable
+
+    static const size_t NO_JOINT = size_t(-1);
+    static const size_t NEVER = size_t(-1);
+
+    /// The arrays each jiggle joint has a lane per instance in.
+    enum Stream
+    {
+        STREAM_X,
+        STREAM_Y,
+        STREAM_PREVIOUS_X,
+        STREAM_PREVIOUS_Y,
+        STREAM_TARGET_X,            ///< Where the animation puts the joint.
+        STREAM_TARGET_Y,
+        STREAM_PARENT_X,            ///< Where the animation puts the joint's parent.
+        STREAM_PARENT_Y,
+        STREAM_LENGTH,              ///< The distance between the two.
+        STREAM_COUNT
+    };
+
+    /// One joint of a chain, and how it moves.
+    struct JiggleJoint
+    {
+        size_t joint;
+        int parent;                 ///< The joint's parent in the skeleton.
+        size_t parent_jiggle;       ///< The jiggle joint the parent is, or NO_JOINT if it's animated.
+        float stiffness;            ///< How hard the joint is pulled towards its target, per second squared.
+        float damping;              ///< How quickly the joint's velocity dies away, per second.
+    };
+
+    float* getStream(size_t jiggle, Stream stream);
+    const float* getStream(size_t jiggle, Stream stream) const;
+    void stepJoint(size_t jiggle, float step, float step_ratio);
+
+    const Skeleton& skeleton_;
+    size_t instance_count_;
+    size_t frame_;                              ///< The frame being targeted, which simulate() moves on from.
+    float previous_step_;                       ///< The length of the last substep, in seconds.
+    std::vector<JiggleJoint> joints_;
+    std::vector<size_t> jiggle_of_joint_;       ///< Each skeleton joint's jiggle joint, or NO_JOINT.
+    std::vector<size_t> targeted_frames_;       ///< The frame each instance was last targeted for, or NEVER.
+    std::vector<float> streams_;                ///< STREAM_COUNT arrays of instance_count_ lanes per jiggle joint.
+};
+
+#endif
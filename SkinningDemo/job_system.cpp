@@ -0,0 +1,469 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  job_system.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of JobSystem class functions.
+
+#include "job_system.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#define JOB_THREAD_LOCAL __declspec(thread)
+#else
+#define JOB_THREAD_LOCAL __thread
+#endif
+
+namespace {
+
+/// The index of the calling thread's deque, for a worker; 0 for any other
+/// thread, which is what the thread calling wait() runs its jobs from.
+JOB_THREAD_LOCAL size_t current_thread = 0;
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty deque which can hold up to capacity jobs.
+///
+/// \param  capacity The most jobs the deque will ever hold at once.  It's
+///         rounded up to a power of two.
+JobSystem::JobDeque::JobDeque(size_t capacity)
+    : top_(0),
+      bottom_(0),
+      jobs_(nullptr),
+      mask_(0)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+
+    jobs_ = new std::atomic<Job*>[size];
+    for (size_t i = 0; i < size; ++i)
+        jobs_[i].store(nullptr);
+
+    mask_ = (long long)(size - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the deque.
+JobSystem::JobDeque::~JobDeque()
+{
+    delete[] jobs_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a job to the bottom of the deque.  Only the owning thread
+///         may call this.  The deque is sized so that it can't overflow.
+void JobSystem::JobDeque::push(Job* job)
+{
+    long long bottom = bottom_.load();
+    jobs_[bottom & mask_].store(job);
+    bottom_.store(bottom + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Removes the job at the bottom of the deque, which is the one the
+///         owning thread pushed most recently.  Only the owning thread may
+///         call this.
+///
+/// \details The bottom is claimed before looking at the top, so that a
+///         thief can't take the same job.  If there's only one job left, the
+///         owner and a thief may both be after it, and whichever advances
+///         the top first gets it.
+///
+/// \return The job, or nullptr if the deque was empty.
+JobSystem::Job* JobSystem::JobDeque::pop()
+{
+    long long bottom = bottom_.load() - 1;
+    bottom_.store(bottom);
+    long long top = top_.load();
+
+    if (top > bottom)
+    {
+        bottom_.store(bottom + 1);
+        return nullptr;
+    }
+
+    Job* job = jobs_[bottom & mask_].load();
+    if (top == bottom)
+    {
+        if (!top_.compare_exchange_strong(top, top + 1))
+            job = nullptr;
+
+        bottom_.store(bottom + 1);
+    }
+
+    return job;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Removes the job at the top of the deque, which is the one that's
+///         been waiting longest.  Any thread may call this.
+///
+/// \return The job, or nullptr if the deque was empty or another thread
+///         got the job first.
+JobSystem::Job* JobSystem::JobDeque::steal()
+{
+    long long top = top_.load();
+    long long bottom = bottom_.load();
+    if (top >= bottom)
+        return nullptr;
+
+    Job* job = jobs_[top & mask_].load();
+    if (!top_.compare_exchange_strong(top, top + 1))
+        return nullptr;
+
+    return job;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the job system's worker threads.
+///
+/// \param  thread_count The total number of threads which run jobs,
+///         including the thread calling wait().  If 0, one thread is used
+///         per hardware thread.
+/// \param  max_jobs The most jobs which can be created between two calls to
+///         wait().
+/// \param  topology The NUMA nodes to spread the workers across, or null to
+///         treat the machine as one node.  It must outlive the job system.
+JobSystem::JobSystem(size_t thread_count, size_t max_jobs, const NumaTopology* topology)
+    : topology_(topology),
+      jobs_(nullptr),
+      busy_times_(nullptr),
+      max_jobs_(max_jobs),
+      job_count_(0),
+      submitted_(false),
+      outstanding_(0),
+      generation_(0),
+      stopping_(false)
+{
+    if (thread_count == 0)
+        thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0)
+        thread_count = 1;
+
+    jobs_ = new Job[max_jobs_];
+    busy_times_ = new BusyTime[thread_count];
+    for (size_t i = 0; i < thread_count; ++i)
+        busy_times_[i].nanoseconds.store(0);
+
+    // every job can be in a deque at most once per frame, so no deque ever
+    // needs to hold more than all of them.
+    for (size_t i = 0; i < thread_count; ++i)
+        queues_.push_back(new JobDeque(max_jobs_));
+
+    // the threads are split into one contiguous run per node, starting
+    // with the calling thread on node 0.
+    size_t node_count = getNodeCount();
+    for (size_t node = 0; node < node_count; ++node)
+        node_queues_.push_back(new JobDeque(max_jobs_));
+    for (size_t i = 0; i < thread_count; ++i)
+        queue_nodes_.push_back(i * node_count / thread_count);
+
+    // each thread looks through its own node's deques, starting with the
+    // jobs submitted to the node, before trying the next node's.
+    steal_orders_.resize(thread_count);
+    for (size_t queue = 0; queue < thread_count; ++queue)
+    {
+        for (size_t n = 0; n < node_count; ++n)
+        {
+            size_t node = (queue_nodes_[queue] + n) % node_count;
+            steal_orders_[queue].push_back(node_queues_[node]);
+            for (size_t i = 1; i < thread_count; ++i)
+            {
+                size_t victim = (queue + i) % thread_count;
+                if (queue_nodes_[victim] == node)
+                    steal_orders_[queue].push_back(queues_[victim]);
+            }
+        }
+    }
+
+    threads_.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i)
+        threads_.push_back(std::thread(&JobSystem::workerMain, this, i));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops and joins all of the worker threads.  Any jobs which have
+///         been submitted are finished first.
+JobSystem::~JobSystem()
+{
+    if (submitted_)
+        wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); ++i)
+        threads_[i].join();
+
+    for (size_t i = 0; i < queues_.size(); ++i)
+        delete queues_[i];
+    for (size_t i = 0; i < node_queues_.size(); ++i)
+        delete node_queues_[i];
+
+    delete[] busy_times_;
+    delete[] jobs_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a new job, to be run after the next submit().
+///
+/// \param  function The function the job calls.
+/// \param  data The first argument to pass to function.
+/// \param  index The second argument to pass to function.
+/// \param  prerequisite A job which must finish before this one can start,
+///         or NO_JOB.  More can be added with addDependency().
+/// \param  node The node whose threads should start the job, if it doesn't
+///         wait for anything, or NumaTopology::ANY_NODE.  A job which waits
+///         runs wherever its last prerequisite finished.
+/// \return The new job's id, which is valid until the next wait() returns.
+JobSystem::JobId JobSystem::createJob(JobFunction function, void* data, size_t index, JobId prerequisite,
+                                      size_t node)
+{
+    if (submitted_)
+    {
+        std::cerr << "Jobs can't be created between submit() and wait()!" << std::endl;
+        throw std::runtime_error("Jobs can't be created between submit() and wait()!");
+    }
+
+    if (job_count_ == max_jobs_)
+    {
+        std::cerr << "More than " << max_jobs_ << " jobs were created in one batch!" << std::endl;
+        throw std::runtime_error("Too many jobs!");
+    }
+
+    JobId id = job_count_++;
+    Job& job = jobs_[id];
+    job.function = function;
+    job.data = data;
+    job.index = index;
+    job.dependent = nullptr;
+    job.node = node < node_queues_.size() ? node : NumaTopology::ANY_NODE;
+    job.unfinished.store(0);
+
+    if (prerequisite != NO_JOB)
+        addDependency(id, prerequisite);
+
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Makes one job wait for another to finish before it starts.
+///
+/// \details The prerequisite must have been created before the job, which
+///         keeps the jobs from ever waiting on each other, and can have only
+///         one dependent.
+///
+/// \param  job The job which must wait.
+/// \param  prerequisite The job it waits for.
+void JobSystem::addDependency(JobId job, JobId prerequisite)
+{
+    checkJob(job);
+    checkJob(prerequisite);
+    if (prerequisite >= job)
+    {
+        std::cerr << "Job " << job << " can't wait for job " << prerequisite << ", which was created after it!" << std::endl;
+        throw std::runtime_error("A job can only wait for jobs created before it!");
+    }
+
+    if (jobs_[prerequisite].dependent != nullptr)
+    {
+        std::cerr << "Job " << prerequisite << " already has a dependent!" << std::endl;
+        throw std::runtime_error("A job can only have one dependent!");
+    }
+
+    jobs_[prerequisite].dependent = &jobs_[job];
+    jobs_[job].unfinished.fetch_add(1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts running every job created since the last wait().  Jobs
+///         which don't depend on anything are queued on the calling thread,
+///         or on their node's deque if they have one, from which the
+///         workers steal them; the rest are queued as their prerequisites
+///         finish.
+void JobSystem::submit()
+{
+    if (submitted_ || job_count_ == 0)
+        return;
+
+    submitted_ = true;
+    outstanding_.store(job_count_);
+
+    // push them in reverse so that the calling thread, which pops from the
+    // bottom, starts on the first job, while the workers steal from the end.
+    for (size_t i = job_count_; i-- > 0;)
+    {
+        if (jobs_[i].unfinished.load() == 0)
+        {
+            size_t node = jobs_[i].node;
+            (node == NumaTopology::ANY_NODE ? queues_[0] : node_queues_[node])->push(&jobs_[i]);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+    }
+    start_.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Submits any jobs which haven't been yet, and helps run them until
+///         every one has finished.  All job ids become invalid.
+void JobSystem::wait()
+{
+    submit();
+
+    while (outstanding_.load() > 0)
+    {
+        if (!runJob(0))
+            std::this_thread::yield();
+    }
+
+    job_count_ = 0;
+    submitted_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the total number of threads which run jobs, including
+///         the calling thread.
+size_t JobSystem::getThreadCount() const
+{
+    return queues_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of NUMA nodes the threads are spread across;
+///         1 without a topology.
+size_t JobSystem::getNodeCount() const
+{
+    return topology_ != nullptr ? topology_->getNodeCount() : 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of jobs created since the last wait().
+size_t JobSystem::getJobCount() const
+{
+    return job_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the total time every thread has spent running jobs, in
+///         milliseconds, since the JobSystem was created.
+///
+/// \details Any thread may call this, while jobs are running or not.  The
+///         difference between two calls, out of getThreadCount() times the
+///         time between them, is how busy the threads were meanwhile; the
+///         rest of the time they were asleep, or looking for jobs to steal.
+double JobSystem::getBusyMilliseconds() const
+{
+    unsigned long long nanoseconds = 0;
+    for (size_t i = 0; i < queues_.size(); ++i)
+        nanoseconds += busy_times_[i].nanoseconds.load(std::memory_order_relaxed);
+    return nanoseconds / 1000000.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns which thread is running the calling job, from 0 to
+///         getThreadCount() - 1, so that a job can use scratch memory kept
+///         per thread rather than per job.
+///
+/// \details The thread which calls wait() is 0.  So is any thread which
+///         isn't one of a JobSystem's workers; there's only ever meant to
+///         be one JobSystem.
+size_t JobSystem::getCurrentThread()
+{
+    return current_thread;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The main loop of each worker thread; sleeps until jobs are
+///         submitted, then runs and steals jobs until they've all finished.
+///
+/// \param  queue The index of the thread's own deque.
+void JobSystem::workerMain(size_t queue)
+{
+    TRACE_THREAD("job worker");
+    current_thread = queue;
+    if (topology_ != nullptr)
+        topology_->pinCurrentThread(queue_nodes_[queue]);
+
+    size_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!stopping_ && generation_ == generation)
+                start_.wait(lock);
+
+            if (stopping_)
+                return;
+
+            generation = generation_;
+        }
+
+        // jobs which aren't ready yet will be pushed by whichever thread
+        // finishes their last prerequisite, so keep looking until every job
+        // has finished, not just until the deques are empty.
+        while (outstanding_.load() > 0)
+        {
+            if (!runJob(queue))
+                std::this_thread::yield();
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs one job from a thread's own deque, or if it's empty, one
+///         stolen from another thread's, nearest first.  If the job was the
+///         last thing its dependent was waiting for, the dependent is pushed
+///         onto the thread's own deque, so it runs next.
+///
+/// \param  queue The index of the calling thread's own deque.
+/// \return false if there was no job to run.
+bool JobSystem::runJob(size_t queue)
+{
+    Job* job = queues_[queue]->pop();
+    const std::vector<JobDeque*>& steal_order = steal_orders_[queue];
+    for (size_t i = 0; job == nullptr && i < steal_order.size(); ++i)
+        job = steal_order[i]->steal();
+
+    if (job == nullptr)
+        return false;
+
+    double start = getTimeMilliseconds();
+    job->function(job->data, job->index);
+    std::atomic<unsigned long long>& busy = busy_times_[queue].nanoseconds;
+    busy.store(busy.load(std::memory_order_relaxed) +
+               (unsigned long long)((getTimeMilliseconds() - start) * 1000000.0), std::memory_order_relaxed);
+
+    Job* dependent = job->dependent;
+    if (dependent != nullptr && dependent->unfinished.fetch_sub(1) == 1)
+        queues_[queue]->push(dependent);
+
+    // this must be the job's last use; once outstanding_ reaches zero,
+    // wait() returns and the job may be reused.
+    outstanding_.fetch_sub(1);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Throws if a job id doesn't refer to a job created since the last
+///         wait().
+void JobSystem::checkJob(JobId job) const
+{
+    if (job >= job_count_)
+    {
+        std::cerr << "Job " << job << " doesn't exist!" << std::endl;
+        throw std::runtime_error("Invalid job id!");
+    }
+}
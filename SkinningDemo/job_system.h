@@ -0,0 +1,149 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  job_system.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the JobSystem class.
+
+#ifndef JOB_SYSTEM_H_
+#define JOB_SYSTEM_H_
+
+#include "numa_topology.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs a graph of small jobs, each of which may wait for others to
+///         finish first, across a worker thread per core.
+///
+/// \details Where ThreadPool::parallelFor() runs a batch of identical,
+///         independent tasks, a JobSystem runs chains of different steps:
+///         each job can depend on any number of earlier jobs, and only
+///         becomes ready once they've all finished.  A frame's jobs are
+///         created on the calling thread, submit() starts the ones which
+///         don't depend on anything, and wait() helps run jobs until every
+///         one of them has finished.  The calling thread is free to do
+///         other work between the two.
+///
+///         Every thread (including the calling thread, queue 0) has its own
+///         lock-free work-stealing deque.  A thread pushes and pops jobs at
+///         the bottom of its own deque, so when a job finishes and makes the
+///         next job in its chain ready, that job runs next on the same
+///         thread while its inputs are still in the cache.  Idle threads
+///         steal from the top of other threads' deques.  The queues
+///         themselves never lock; workers only take a mutex to go to sleep
+///         when there's nothing left to run.
+///
+///         Given a NumaTopology, the workers are spread across its nodes and
+///         pinned to them, and each thread steals from threads on its own
+///         node before going to another node.  A job can be created for a
+///         node; if it's ready at submit(), it waits in that node's own
+///         deque, which the node's threads look in first, so work on memory
+///         partitioned between the nodes starts on the node the memory is
+///         on, and its dependents follow it there.  Other nodes only run it
+///         once they have nothing else to do.
+///
+///         Jobs are plain function pointers with a data pointer and an
+///         index, so creating one never allocates, and jobs must not throw.
+///         Each job may have at most one dependent, which is all a chain
+///         (or a set of chains joining into one job) needs.
+class JobSystem
+{
+public:
+    typedef size_t JobId;
+    typedef void (*JobFunction)(void* data, size_t index);
+
+    static const JobId NO_JOB = size_t(-1);
+
+    explicit JobSystem(size_t thread_count = 0, size_t max_jobs = 4096, const NumaTopology* topology = nullptr);
+    ~JobSystem();
+
+    JobId createJob(JobFunction function, void* data, size_t index, JobId prerequisite = NO_JOB,
+                    size_t node = NumaTopology::ANY_NODE);
+    void addDependency(JobId job, JobId prerequisite);
+
+    void submit();
+    void wait();
+
+    size_t getThreadCount() const;
+    size_t getNodeCount() const;
+    size_t getJobCount() const;
+    double getBusyMilliseconds() const;
+
+    static size_t getCurrentThread();
+
+private:
+    struct Job
+    {
+        JobFunction function;
+        void* data;
+        size_t index;
+        Job* dependent;                     ///< The job waiting for this one, if any.
+        size_t node;                        ///< The node to start the job on, if it's ready at submit().
+        std::atomic<size_t> unfinished;     ///< The number of prerequisites which haven't finished.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A Chase-Lev work-stealing deque of ready jobs.  Only its
+    ///         owning thread may push() and pop(); any thread may steal().
+    class JobDeque
+    {
+    public:
+        explicit JobDeque(size_t capacity);
+        ~JobDeque();
+
+        void push(Job* job);
+        Job* pop();
+        Job* steal();
+
+    private:
+        JobDeque(const JobDeque&);              // non-copyable
+        JobDeque& operator=(const JobDeque&);   // non-copyable
+
+        std::atomic<long long> top_;
+        char padding_[64];                      ///< Keeps the owner's end and the thieves' end on separate cache lines.
+        std::atomic<long long> bottom_;
+        std::atomic<Job*>* jobs_;
+        long long mask_;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The time one thread has spent running jobs, in nanoseconds.
+    ///         Only that thread writes it.
+    struct BusyTime
+    {
+        std::atomic<unsigned long long> nanoseconds;
+        char padding[64];                       ///< Keeps each thread's count on its own cache line.
+    };
+
+    JobSystem(const JobSystem&);                // non-copyable
+    JobSystem& operator=(const JobSystem&);     // non-copyable
+
+    void workerMain(size_t queue);
+    bool runJob(size_t queue);
+    void checkJob(JobId job) const;
+
+    std::vector<std::thread> threads_;
+    std::vector<JobDeque*> queues_;     ///< One per worker thread, plus one for the calling thread (queue 0).
+    std::vector<JobDeque*> node_queues_;    ///< One per node, for its jobs ready at submit(); only the calling thread pushes.
+    std::vector<size_t> queue_nodes_;       ///< The node each thread runs on; the calling thread's is taken to be 0.
+    std::vector<std::vector<JobDeque*> > steal_orders_; ///< The deques each thread steals from, nearest first.
+    const NumaTopology* topology_;
+
+    Job* jobs_;
+    BusyTime* busy_times_;              ///< One per thread, indexed like queues_.
+    size_t max_jobs_;
+    size_t job_count_;                  ///< The number of jobs created since the last wait().
+    bool submitted_;                    ///< submit() has been called since the last wait().
+    std::atomic<size_t> outstanding_;   ///< The number of submitted jobs which haven't finished.
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    size_t generation_;                 ///< Incremented by each submit(), so sleeping workers know to look for jobs.
+    bool stopping_;
+};
+
+#endif
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_bounds.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the BoundingBox struct and the skinned bounds
+///         functions.
+
+#include "joint_bounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty box.
+BoundingBox::BoundingBox()
+    : min(std::numeric_limits<float>::max()),
+      max(-std::numeric_limits<float>::max())
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the box doesn't contain any points.
+bool BoundingBox::isEmpty() const
+{
+    return min.x > max.x || min.y > max.y;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Grows the box to contain a point.
+void BoundingBox::expand(const vec2& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Grows the box to contain another box.
+void BoundingBox::expand(const BoundingBox& box)
+{
+    if (box.isEmpty())
+        return;
+
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the box and another box have any points in
+///         common.
+bool BoundingBox::overlaps(const BoundingBox& box) const
+{
+    return !isEmpty() && !box.isEmpty() &&
+           min.x <= box.max.x && box.min.x <= max.x &&
+           min.y <= box.max.y && box.min.y <= max.y;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a point is inside the box or on its edge.
+bool BoundingBox::contains(const vec2& point) const
+{
+    return min.x <= point.x && point.x <= max.x &&
+           min.y <= point.y && point.y <= max.y;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the smallest axis-aligned box containing a box after it
+///         has been transformed in the xy plane.
+///
+/// \details The center is transformed as a point, and the half extents by
+///         the absolute values of the matrix's upper 2x2, which gives the
+///         extents of the transformed box's corners without transforming
+///         each of them.
+BoundingBox transformBox(const BoundingBox& box, const mat4& transform)
+{
+    if (box.isEmpty())
+        return box;
+
+    vec2 center = (box.min + box.max) * 0.5f;
+    vec2 extent = (box.max - box.min) * 0.5f;
+
+    vec2 new_center = vec2(transform * vec4(center, 0, 1));
+    vec2 new_extent(std::abs(transform[0][0]) * extent.x + std::abs(transform[1][0]) * extent.y,
+                    std::abs(transform[0][1]) * extent.x + std::abs(transform[1][1]) * extent.y);
+
+    BoundingBox result;
+    result.min = new_center - new_extent;
+    result.max = new_center + new_extent;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Bounds a skinned mesh in a pose, from the bounds of the vertices
+///         each joint influences.
+///
+/// \details A skinned vertex is a weighted average of where each of its
+///         joints would put it on its own, so it always lies within the
+///         union of its joints' transformed boxes.  This costs one box
+///         transform per joint, however many vertices the mesh has.
+///
+/// \param  joint_bounds The box around the vertices each joint influences,
+///         in the space transforms maps from.  Joints which influence no
+///         vertices have empty boxes.
+/// \param  transforms The transform of each joint.  If the boxes are in the
+///         joint's space, these are the joint transforms; if they're in
+///         bind-pose model space, these are the skinning palette.
+/// \param  joint_count The number of joints.
+BoundingBox computeSkinnedBounds(const BoundingBox* joint_bounds, const mat4* transforms, size_t joint_count)
+{
+    BoundingBox bounds;
+    for (size_t joint = 0; joint < joint_count; ++joint)
+        bounds.expand(transformBox(joint_bounds[joint], transforms[joint]));
+    return bounds;
+}
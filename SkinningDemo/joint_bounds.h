@@ -0,0 +1,35 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_bounds.h
+/// \author Ben Crist
+///
+/// \brief  Functions for bounding skinned meshes by the boxes around the
+///         vertices each joint influences.
+
+#ifndef JOINT_BOUNDS_H_
+#define JOINT_BOUNDS_H_
+
+#include "demo.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An axis-aligned 2D bounding box.  A box with min > max is empty.
+struct BoundingBox
+{
+    BoundingBox();
+
+    bool isEmpty() const;
+    void expand(const vec2& point);
+    void expand(const BoundingBox& box);
+    bool overlaps(const BoundingBox& box) const;
+    bool contains(const vec2& point) const;
+
+    vec2 min;
+    vec2 max;
+};
+
+BoundingBox transformBox(const BoundingBox& box, const mat4& transform);
+
+BoundingBox computeSkinnedBounds(const BoundingBox* joint_bounds, const mat4* transforms, size_t joint_count);
+
+#endif
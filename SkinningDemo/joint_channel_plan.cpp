@@ -0,0 +1,297 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_channel_plan.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of JointChannelPlan class functions.
+
+#include "joint_channel_plan.h"
+#include "joint_rotation.h"
+#include "pose.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+const size_t SINE_BLOCK = 64;   ///< Joints whose sines and cosines are found at a time.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the local transforms of a group of joints which only read
+///         their translations: the constant transform, with the pose's
+///         translation in place of its own.
+void buildTranslateLocals(const GLuint* joints, size_t count, const Pose& pose, const mat4* constants,
+                          mat4* transforms)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        GLuint joint = joints[i];
+        transforms[joint] = constants[joint];
+        transforms[joint][3] = vec4(pose.translation[joint], 0, 1);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the local transforms of a group of joints which only read
+///         their rotations: the constant transform, with the pose's
+///         rotation, at the constant scale, in place of its own.
+void buildRotateLocals(const GLuint* joints, size_t count, const Pose& pose, const mat4* constants,
+                       const float* scales, mat4* transforms)
+{
+    ALIGN16 float degrees[SINE_BLOCK];
+    ALIGN16 float sines[SINE_BLOCK];
+    ALIGN16 float cosines[SINE_BLOCK];
+    for (size_t first = 0; first < count; first += SINE_BLOCK)
+    {
+        size_t block = std::min(SINE_BLOCK, count - first);
+        for (size_t i = 0; i < block; ++i)
+            degrees[i] = pose.rotation[joints[first + i]];
+        sinCosDegrees(degrees, block, sines, cosines);
+
+        for (size_t i = 0; i < block; ++i)
+        {
+            GLuint joint = joints[first + i];
+            float s = sines[i] * scales[joint];
+            float c = cosines[i] * scales[joint];
+            transforms[joint] = constants[joint];
+            transforms[joint][0] = vec4(c, s, 0, 0);
+            transforms[joint][1] = vec4(-s, c, 0, 0);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the local transforms of a group of joints which read
+///         every channel, as getJointLocalTransform() does.
+void buildFullLocals(const GLuint* joints, size_t count, const Pose& pose, mat4* transforms)
+{
+    ALIGN16 float degrees[SINE_BLOCK];
+    ALIGN16 float sines[SINE_BLOCK];
+    ALIGN16 float cosines[SINE_BLOCK];
+    for (size_t first = 0; first < count; first += SINE_BLOCK)
+    {
+        size_t block = std::min(SINE_BLOCK, count - first);
+        for (size_t i = 0; i < block; ++i)
+            degrees[i] = pose.rotation[joints[first + i]];
+        sinCosDegrees(degrees, block, sines, cosines);
+
+        for (size_t i = 0; i < block; ++i)
+        {
+            GLuint joint = joints[first + i];
+            float scale = pose.scale[joint];
+            float s = sines[i] * scale;
+            float c = cosines[i] * scale;
+            transforms[joint] = mat4(   c,    s, 0, 0,
+                                       -s,    c, 0, 0,
+                                        0,    0, scale, 0,
+                                     pose.translation[joint].x, pose.translation[joint].y, 0, 1);
+        }
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a plan in which nothing moves from the reference pose.
+///
+/// \param  skeleton The skeleton to plan for.  It must outlive the plan.
+/// \param  reference A pose of the skeleton, whose channels are kept for the
+///         ones which turn out to be constant; the bind pose, say.
+JointChannelPlan::JointChannelPlan(const Skeleton& skeleton, const Pose& reference)
+    : skeleton_(skeleton),
+      translations_(reference.translation, reference.translation + reference.joint_count),
+      rotations_(reference.rotation, reference.rotation + reference.joint_count),
+      scales_(reference.scale, reference.scale + reference.joint_count),
+      moving_(reference.joint_count, 0)
+{
+    assert(reference.joint_count == skeleton.getJointCount());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the plan.
+JointChannelPlan::~JointChannelPlan()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks the channels of a pose which differ from the reference pose
+///         as moving.
+void JointChannelPlan::addPose(const Pose& pose)
+{
+    assert(pose.joint_count == moving_.size());
+    for (size_t joint = 0; joint < pose.joint_count; ++joint)
+    {
+        markChannel(joint, CHANNEL_TRANSLATION, pose.translation[joint] != translations_[joint]);
+        markChannel(joint, CHANNEL_ROTATION, pose.rotation[joint] != rotations_[joint]);
+        markChannel(joint, CHANNEL_SCALE, pose.scale[joint] != scales_[joint]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks the channels a clip moves, or holds at anything other than
+///         the reference pose's values, as moving.
+///
+/// \details Only constant curves can be left constant: their value is
+///         exactly what the sampler writes.  Joints without keys are never
+///         written at all, so they keep whatever the pose the clip is
+///         sampled into had; that has to be the reference pose, or have
+///         been added too.
+void JointChannelPlan::addClip(const CompressedClip& clip)
+{
+    assert(clip.getJointCount() == moving_.size());
+    for (size_t joint = 0; joint < moving_.size(); ++joint)
+    {
+        if (!clip.hasKeys(joint))
+            continue;
+
+        float x, y, rotation, scale;
+        bool constant_x = clip.getConstantValue(joint, CompressedClip::CHANNEL_TRANSLATION_X, x);
+        bool constant_y = clip.getConstantValue(joint, CompressedClip::CHANNEL_TRANSLATION_Y, y);
+        markChannel(joint, CHANNEL_TRANSLATION, !constant_x || !constant_y || vec2(x, y) != translations_[joint]);
+
+        bool constant = clip.getConstantValue(joint, CompressedClip::CHANNEL_ROTATION, rotation);
+        markChannel(joint, CHANNEL_ROTATION, !constant || rotation != rotations_[joint]);
+
+        constant = clip.getConstantValue(joint, CompressedClip::CHANNEL_SCALE, scale);
+        markChannel(joint, CHANNEL_SCALE, !constant || scale != scales_[joint]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Chooses each joint's opcode from the channels which move, and
+///         works out the constant transforms.  Call it once every pose and
+///         clip has been added.
+void JointChannelPlan::build()
+{
+    size_t joint_count = moving_.size();
+    opcodes_.resize(joint_count);
+    constants_.resize(joint_count);
+    for (size_t opcode = 0; opcode < N_JOINT_OPS; ++opcode)
+        groups_[opcode].clear();
+    composed_joints_.clear();
+    composed_parents_.clear();
+
+    Pose reference;
+    reference.joint_count = joint_count;
+    reference.translation = translations_.data();
+    reference.rotation = rotations_.data();
+    reference.scale = scales_.data();
+
+    // parents come first, so each joint knows whether its parent folded.
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        int parent = skeleton_.getParent(joint);
+        unsigned moving = moving_[joint];
+        constants_[joint] = getJointLocalTransform(reference, joint);
+
+        if (moving == 0 && (parent == Skeleton::NO_PARENT || opcodes_[parent] == JOINT_OP_FOLDED))
+        {
+            opcodes_[joint] = JOINT_OP_FOLDED;
+            if (parent != Skeleton::NO_PARENT)
+                constants_[joint] = constants_[parent] * constants_[joint];
+        }
+        else if (moving == 0)
+            opcodes_[joint] = JOINT_OP_STATIC;
+        else if (moving == CHANNEL_TRANSLATION)
+            opcodes_[joint] = JOINT_OP_TRANSLATE;
+        else if (moving == CHANNEL_ROTATION)
+            opcodes_[joint] = JOINT_OP_ROTATE;
+        else
+            opcodes_[joint] = JOINT_OP_FULL;
+
+        groups_[opcodes_[joint]].push_back(GLuint(joint));
+        if (opcodes_[joint] != JOINT_OP_FOLDED && parent != Skeleton::NO_PARENT)
+        {
+            composed_joints_.push_back(GLuint(joint));
+            composed_parents_.push_back(GLuint(parent));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the plan.
+size_t JointChannelPlan::getJointCount() const
+{
+    return moving_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the ChannelBits of a joint's channels which move.
+unsigned JointChannelPlan::getMovingChannels(size_t joint) const
+{
+    return moving_[joint];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns what build() found a joint's transform needs.
+JointChannelPlan::Opcode JointChannelPlan::getOpcode(size_t joint) const
+{
+    assert(opcodes_.size() == moving_.size());
+    return opcodes_[joint];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints build() gave an opcode.
+size_t JointChannelPlan::getOpcodeCount(Opcode opcode) const
+{
+    return size_t(std::count(opcodes_.begin(), opcodes_.end(), opcode));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a pose keeps every channel the plan says is
+///         constant at its constant value, so the plan's transforms for it
+///         are right.
+bool JointChannelPlan::matches(const Pose& pose) const
+{
+    if (pose.joint_count != moving_.size())
+        return false;
+
+    for (size_t joint = 0; joint < pose.joint_count; ++joint)
+    {
+        unsigned moving = moving_[joint];
+        if ((!(moving & CHANNEL_TRANSLATION) && pose.translation[joint] != translations_[joint]) ||
+            (!(moving & CHANNEL_ROTATION) && pose.rotation[joint] != rotations_[joint]) ||
+            (!(moving & CHANNEL_SCALE) && pose.scale[joint] != scales_[joint]))
+            return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the local-to-model transform of every joint in a pose,
+///         as Skeleton::computeJointTransforms() does, reading only the
+///         channels which move.
+///
+/// \param  pose A pose which matches() the plan.
+/// \param  transforms Receives a transform for each joint.  All of them are
+///         written, the folded ones included, so it can be shared with other
+///         passes.  The local transforms are built in it first.
+void JointChannelPlan::computeJointTransforms(const Pose& pose, mat4* transforms) const
+{
+    assert(opcodes_.size() == pose.joint_count);
+
+    // the folded and static joints' transforms are just copied.
+    for (size_t i = 0; i < groups_[JOINT_OP_FOLDED].size(); ++i)
+        transforms[groups_[JOINT_OP_FOLDED][i]] = constants_[groups_[JOINT_OP_FOLDED][i]];
+    for (size_t i = 0; i < groups_[JOINT_OP_STATIC].size(); ++i)
+        transforms[groups_[JOINT_OP_STATIC][i]] = constants_[groups_[JOINT_OP_STATIC][i]];
+
+    const std::vector<GLuint>& translate = groups_[JOINT_OP_TRANSLATE];
+    const std::vector<GLuint>& rotate = groups_[JOINT_OP_ROTATE];
+    const std::vector<GLuint>& full = groups_[JOINT_OP_FULL];
+    buildTranslateLocals(translate.data(), translate.size(), pose, constants_.data(), transforms);
+    buildRotateLocals(rotate.data(), rotate.size(), pose, constants_.data(), scales_.data(), transforms);
+    buildFullLocals(full.data(), full.size(), pose, transforms);
+
+    // parents come first, so each parent is already in model space.
+    for (size_t i = 0; i < composed_joints_.size(); ++i)
+        transforms[composed_joints_[i]] = transforms[composed_parents_[i]] * transforms[composed_joints_[i]];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks one of a joint's channels as moving, if moves is set.
+void JointChannelPlan::markChannel(size_t joint, unsigned channel, bool moves)
+{
+    if (moves)
+        moving_[joint] |= channel;
+}
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_channel_plan.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the JointChannelPlan class.
+
+#ifndef JOINT_CHANNEL_PLAN_H_
+#define JOINT_CHANNEL_PLAN_H_
+
+#include "compressed_clip.h"
+#include "skeleton.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the channels of a skeleton's joints which never change in
+///         any of the poses and clips it's animated from, and evaluates its
+///         joint transforms without them.
+///
+/// \details The plan starts out with every channel of every joint constant,
+///         at its value in a reference pose.  addPose() and addClip() mark
+///         the channels which take any other value as moving; then build()
+///         gives each joint an opcode for what its local transform needs
+///         from a pose:
+///
+///         - A joint whose channels are all constant, and whose ancestors'
+///           are too, is folded: its model transform is worked out once,
+///           and computeJointTransforms() only copies it.
+///         - A joint whose channels are all constant under a moving parent
+///           keeps its local transform, so all it costs is the product with
+///           its parent's.
+///         - A joint whose rotation and scale are constant keeps its
+///           rotation and scale, and only reads its translation, so it
+///           needs no sine or cosine.
+///         - A joint whose translation and scale are constant only reads
+///           its rotation.
+///         - Anything else reads all of its channels.
+///
+///         build() sorts the joints into a group per opcode, and
+///         computeJointTransforms() runs each group through a kernel of its
+///         own, with nothing to decide per joint: the groups which rotate
+///         gather their angles and find the sines and cosines of a whole
+///         block at once with the stream sinCosDegrees().  Only then are
+///         the local transforms composed with their parents', in one pass
+///         over the joints which aren't folded.
+///
+///         The channels are compared exactly: blending, or adding a layer
+///         onto, channels which are the same everywhere leaves them exactly
+///         as they were, so a blend of the poses and clips the plan was
+///         built from is covered by it too.  One which isn't gets the wrong
+///         transforms for whatever moved that the plan says can't; matches()
+///         checks a pose.
+class JointChannelPlan
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  What a joint's transform needs computing from.
+    enum Opcode
+    {
+        JOINT_OP_FOLDED = 0,    ///< Nothing: its channels and its ancestors' are all constant.
+        JOINT_OP_STATIC,        ///< Its parent's transform and its own constant local transform.
+        JOINT_OP_TRANSLATE,     ///< Its translation; its rotation and scale are constant.
+        JOINT_OP_ROTATE,        ///< Its rotation; its translation and scale are constant.
+        JOINT_OP_FULL,          ///< Every channel.
+        N_JOINT_OPS
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Flags for the channels of a joint which move.
+    enum ChannelBits
+    {
+        CHANNEL_TRANSLATION = 1,
+        CHANNEL_ROTATION = 2,
+        CHANNEL_SCALE = 4
+    };
+
+    JointChannelPlan(const Skeleton& skeleton, const Pose& reference);
+    ~JointChannelPlan();
+
+    void addPose(const Pose& pose);
+    void addClip(const CompressedClip& clip);
+    void build();
+
+    size_t getJointCount() const;
+    unsigned getMovingChannels(size_t joint) const;
+    Opcode getOpcode(size_t joint) const;
+    size_t getOpcodeCount(Opcode opcode) const;
+
+    bool matches(const Pose& pose) const;
+    void computeJointTransforms(const Pose& pose, mat4* transforms) const;
+
+private:
+    JointChannelPlan(const JointChannelPlan&);              // non-copyable
+    JointChannelPlan& operator=(const JointChannelPlan&);   // non-copyable
+
+    void markChannel(size_t joint, unsigned channel, bool moves);
+
+    const Skeleton& skeleton_;
+    std::vector<vec2> translations_;    ///< The reference pose's channels, which the constant ones keep.
+    std::vector<float> rotations_;
+    std::vector<float> scales_;
+    std::vector<unsigned> moving_;      ///< Each joint's ChannelBits.
+    std::vector<Opcode> opcodes_;       ///< Filled in by build().
+    std::vector<GLuint> groups_[N_JOINT_OPS];   ///< The joints with each opcode, in order.
+    std::vector<GLuint> composed_joints_;       ///< The joints which aren't folded or roots, in order.
+    std::vector<GLuint> composed_parents_;      ///< The parent of each of composed_joints_.
+    std::vector<mat4> constants_;       ///< Folded joints' model transforms, and every other joint's local transform in the reference pose.
+};
+
+#endif
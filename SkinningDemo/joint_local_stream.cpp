@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_local_stream.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of JointLocalStream class functions.
+
+#include "joint_local_stream.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+const GLuint JointLocalStream::POSITIONS_ATTRIBUTE;
+
+namespace {
+
+vec4 getBindPosition(const vec2& position)
+{
+    return vec4(position, 0, 1);
+}
+
+vec4 getBindPosition(const vec3& position)
+{
+    return vec4(position, 1);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Bakes the mesh's positions into its joints' spaces, and creates
+///         the VAO which draws them with the rest of the mesh.
+///
+/// \details If the mesh's vertices aren't on the CPU, or don't match what
+///         was uploaded, the problem is reported to stderr and an exception
+///         is thrown.
+///
+/// \param  mesh The mesh to bake, uploaded with uploadMesh().  It must
+///         outlive the stream.
+/// \param  inverse_binds The skeleton's inverse bind transforms, in model
+///         space; any position quantization of the mesh's VBO doesn't
+///         apply, since the positions are baked from its float vertices.
+template <typename VertexType>
+JointLocalStream::JointLocalStream(const BasicSkeletalMesh<VertexType>& mesh, const mat4* inverse_binds)
+    : vao_id_(0),
+      vbo_id_(0),
+      influence_count_(1),
+      vbo_size_(0)
+{
+    const std::vector<GLuint>& remap = mesh.getUploadRemap().vertices;
+    size_t vertex_count = mesh.getVertexCount();
+    if (remap.size() != mesh.vertices.size() || mesh.vertices.size() < vertex_count)
+    {
+        std::cerr << "Can't bake joint-local positions!" << std::endl
+                  << "  Error: The mesh has " << mesh.vertices.size() << " vertices on the CPU, with "
+                  << remap.size() << " remapped, for " << vertex_count << " uploaded." << std::endl;
+        throw std::runtime_error("The mesh's vertices aren't on the CPU to bake joint-local positions from.");
+    }
+
+    const std::vector<SkeletalMeshBase::Partition>& partitions = mesh.getPartitions();
+    for (size_t i = 0; i < partitions.size(); ++i)
+    {
+        if (partitions[i].vertex_count > 0)
+            influence_count_ = std::max(influence_count_, partitions[i].influence_count);
+    }
+
+    // each vertex's influences are sorted the way the upload sorted them,
+    // so the positions go with the uploaded joint indices.
+    std::vector<vec3> positions(vertex_count * influence_count_);
+    for (size_t v = 0; v < mesh.vertices.size(); ++v)
+    {
+        VertexType sorted = sortInfluences(mesh.vertices[v]);
+        vec4 bind_position = getBindPosition(sorted.position);
+        vec3* out = &positions[remap[v] * influence_count_];
+        for (size_t i = 0; i < influence_count_; ++i)
+            out[i] = vec3(inverse_binds[sorted.joint_indices[i]] * bind_position);
+    }
+    vbo_size_ = GLsizeiptr(positions.size() * sizeof(vec3));
+
+    glGenVertexArrays(1, &vao_id_);
+    glGenBuffers(1, &vbo_id_);
+
+    glBindVertexArray(vao_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo_id);
+    setVertexAttributes(mesh.vertex_format);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    glBufferData(GL_ARRAY_BUFFER, vbo_size_, positions.empty() ? nullptr : positions.data(), GL_STATIC_DRAW);
+    GLsizei stride = GLsizei(influence_count_ * sizeof(vec3));
+    for (size_t i = 0; i < influence_count_; ++i)
+    {
+        glVertexAttribPointer(POSITIONS_ATTRIBUTE + GLuint(i), 3, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<void*>(i * sizeof(vec3)));
+        glEnableVertexAttribArray(POSITIONS_ATTRIBUTE + GLuint(i));
+    }
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the stream's VAO and buffer.
+JointLocalStream::~JointLocalStream()
+{
+    glDeleteVertexArrays(1, &vao_id_);
+    glDeleteBuffers(1, &vbo_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the VAO which draws the mesh's partitions with the baked
+///         positions.
+GLuint JointLocalStream::getVertexArray() const
+{
+    return vao_id_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of positions stored for each vertex: the
+///         most influences any of the mesh's partitions evaluates.
+size_t JointLocalStream::getInfluenceCount() const
+{
+    return influence_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the stream's buffer in bytes.
+GLsizeiptr JointLocalStream::getBufferBytes() const
+{
+    return vbo_size_;
+}
+
+template JointLocalStream::JointLocalStream(const SkeletalMesh&, const mat4*);
+template JointLocalStream::JointLocalStream(const SkeletalMesh3D&, const mat4*);
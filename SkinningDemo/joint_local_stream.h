@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_local_stream.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the JointLocalStream class.
+
+#ifndef JOINT_LOCAL_STREAM_H_
+#define JOINT_LOCAL_STREAM_H_
+
+#include "skeletal_mesh.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Each of a mesh's vertices' positions baked into the space of each
+///         joint which influences it, so that a skinning shader can skin it
+///         with the current pose alone, without an inverse bind transform
+///         (see JOINT_LOCAL_POSITIONS in skinning_shaders.cpp).
+///
+/// \details Each vertex gets a vec3 per influence, as many as the mesh's
+///         heaviest partition evaluates, where the mesh's VBO has one
+///         position for all of them; the stream trades that memory for the
+///         bind_pose_inv fetch and matrix product each influence would
+///         otherwise cost, or for precombining the palette on the CPU.  The
+///         positions are read from POSITIONS_ATTRIBUTE onwards, one location
+///         per influence, in the order the mesh's upload sorted each
+///         vertex's influences into, so they line up with its joint
+///         indices.
+///
+///         The stream's VAO reads everything else from the mesh's own VBO
+///         and IBO, with the mesh's attribute locations, so the mesh's
+///         partitions are drawn from it just as from the mesh's VAO.  The
+///         positions are baked from the mesh's vertices on the CPU, through
+///         the upload's remap, so the mesh needs them (and must have been
+///         uploaded with uploadMesh()); a stream has to be built again if
+///         the mesh is.
+class JointLocalStream
+{
+public:
+    static const GLuint POSITIONS_ATTRIBUTE = 11;   ///< The location of the first influence's vec3 position.
+
+    template <typename VertexType>
+    JointLocalStream(const BasicSkeletalMesh<VertexType>& mesh, const mat4* inverse_binds);
+    ~JointLocalStream();
+
+    GLuint getVertexArray() const;
+    size_t getInfluenceCount() const;
+    GLsizeiptr getBufferBytes() const;
+
+private:
+    JointLocalStream(const JointLocalStream&);              // non-copyable
+    JointLocalStream& operator=(const JointLocalStream&);   // non-copyable
+
+    GLuint vao_id_;
+    GLuint vbo_id_;
+    size_t influence_count_;    ///< The number of positions stored per vertex.
+    GLsizeiptr vbo_size_;
+};
+
+#endif
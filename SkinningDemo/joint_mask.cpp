@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_mask.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of JointMask class functions.
+
+#include "joint_mask.h"
+#include "skeleton.h"
+
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the index of the lowest set bit of a word, which mustn't
+///         be 0.
+size_t findLowestBit(std::uint32_t word)
+{
+    assert(word != 0);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, word);
+    return size_t(index);
+#else
+    return size_t(__builtin_ctz(word));
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of set bits in a word.
+size_t countBits(std::uint32_t word)
+{
+    size_t count = 0;
+    for (; word != 0; word &= word - 1)
+        ++count;
+    return count;
+}
+
+} // namespace
+
+const size_t JointMask::WORD_BITS;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a mask with none of a skeleton's joints set.
+///
+/// \param  joint_count The number of joints in the skeleton.
+JointMask::JointMask(size_t joint_count)
+    : words_((joint_count + WORD_BITS - 1) / WORD_BITS, 0),
+      joint_count_(joint_count)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a mask of the joints a per-joint weight mask, like a
+///         BlendGraph mask, gives any weight to.
+///
+/// \param  joint_weights One weight per joint; the joints whose weights
+///         aren't 0 are set.
+JointMask JointMask::fromWeights(const std::vector<float>& joint_weights)
+{
+    JointMask mask(joint_weights.size());
+    for (size_t joint = 0; joint < joint_weights.size(); ++joint)
+    {
+        if (joint_weights[joint] != 0)
+            mask.set(joint);
+    }
+    return mask;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a joint to the mask.
+void JointMask::set(size_t joint)
+{
+    assert(joint < joint_count_);
+    words_[joint / WORD_BITS] |= std::uint32_t(1) << (joint % WORD_BITS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes a joint out of the mask.
+void JointMask::reset(size_t joint)
+{
+    assert(joint < joint_count_);
+    words_[joint / WORD_BITS] &= ~(std::uint32_t(1) << (joint % WORD_BITS));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a joint and every joint below it in the hierarchy to the
+///         mask.
+///
+/// \details A skeleton's joints come after their parents, so the subtree is
+///         found in one pass over the joints after the root.
+///
+/// \param  skeleton The skeleton the mask is for.
+/// \param  root The joint whose chain to add, such as the top of an arm.
+void JointMask::addSubtree(const Skeleton& skeleton, size_t root)
+{
+    assert(skeleton.getJointCount() == joint_count_ && root < joint_count_);
+
+    std::vector<char> in_subtree(joint_count_, 0);
+    in_subtree[root] = 1;
+    set(root);
+    for (size_t joint = root + 1; joint < joint_count_; ++joint)
+    {
+        int parent = skeleton.getParent(joint);
+        if (parent != Skeleton::NO_PARENT && in_subtree[parent])
+        {
+            in_subtree[joint] = 1;
+            set(joint);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the joints which weren't set, and clears those which were,
+///         for instance to make the lower body's mask from the upper's.
+void JointMask::invert()
+{
+    for (size_t i = 0; i < words_.size(); ++i)
+        words_[i] = ~words_[i];
+
+    // the bits past the last joint stay clear, so getNext() and getCount()
+    // never see them.
+    size_t tail = joint_count_ % WORD_BITS;
+    if (tail != 0)
+        words_.back() &= (std::uint32_t(1) << tail) - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns whether a joint is in the mask.
+bool JointMask::test(size_t joint) const
+{
+    assert(joint < joint_count_);
+    return (words_[joint / WORD_BITS] >> (joint % WORD_BITS) & 1) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the first joint in the mask at or after a joint.
+///
+/// \param  joint Where to start looking; may be getJointCount().
+/// \return The joint, or getJointCount() if there are no more.
+size_t JointMask::getNext(size_t joint) const
+{
+    if (joint >= joint_count_)
+        return joint_count_;
+
+    size_t word = joint / WORD_BITS;
+    std::uint32_t bits = words_[word] & (~std::uint32_t(0) << (joint % WORD_BITS));
+    while (bits == 0)
+    {
+        if (++word == words_.size())
+            return joint_count_;
+        bits = words_[word];
+    }
+
+    return word * WORD_BITS + findLowestBit(bits);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the skeleton the mask is for.
+size_t JointMask::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the mask.
+size_t JointMask::getCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < words_.size(); ++i)
+        count += countBits(words_[i]);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the first joint to visit for an optional mask.
+///
+/// \param  mask The joints to visit, or null for all of them.
+/// \return The first joint in the mask (or past the end of it), or 0.
+size_t getFirstMaskedJoint(const JointMask* mask)
+{
+    return mask == nullptr ? 0 : mask->getNext(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the joint to visit after another for an optional mask.
+///
+/// \param  mask The joints to visit, or null for all of them.
+/// \param  joint The joint just visited.
+/// \return The next joint in the mask (or past the end of it), or joint + 1.
+size_t getNextMaskedJoint(const JointMask* mask, size_t joint)
+{
+    return mask == nullptr ? joint + 1 : mask->getNext(joint + 1);
+}
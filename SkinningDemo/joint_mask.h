@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_mask.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the JointMask class.
+
+#ifndef JOINT_MASK_H_
+#define JOINT_MASK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Skeleton;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A set of a skeleton's joints, one bit per joint in the skeleton's
+///         (parent-before-child) order.
+///
+/// \details Masks say which joints a layer of animation touches, such as
+///         the upper body, or one arm's chain, so that samplers and blends
+///         can skip the rest altogether instead of working them out only
+///         to weight them by 0.  The set joints are visited in order with
+///         getNext(), which finds each one with a bit scan, so a mask of a
+///         few joints in a large skeleton costs a few steps, not a step per
+///         joint:
+///
+///             for (size_t joint = mask.getNext(0); joint < n; joint = mask.getNext(joint + 1))
+///
+///         getFirstMaskedJoint() and getNextMaskedJoint() do the same for an
+///         optional mask, visiting every joint when there isn't one.
+///
+///         Masks which are built once, when a graph or layer is set up, and
+///         then only read, can be shared between threads.
+class JointMask
+{
+public:
+    explicit JointMask(size_t joint_count = 0);
+
+    static JointMask fromWeights(const std::vector<float>& joint_weights);
+
+    void set(size_t joint);
+    void reset(size_t joint);
+    void addSubtree(const Skeleton& skeleton, size_t root);
+    void invert();
+
+    bool test(size_t joint) const;
+    size_t getNext(size_t joint) const;
+    size_t getJointCount() const;
+    size_t getCount() const;
+
+private:
+    static const size_t WORD_BITS = 32;
+
+    std::vector<std::uint32_t> words_;
+    size_t joint_count_;
+};
+
+size_t getFirstMaskedJoint(const JointMask* mask);
+size_t getNextMaskedJoint(const JointMask* mask, size_t joint);
+
+#endif
@@ -0,0 +1,376 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_rotation.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the joint rotation quaternion and complex
+///         number functions.
+
+#include "joint_rotation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const float DEGREES_TO_RADIANS = 3.14159265358979f / 180.0f;
+
+// Taylor series coefficients for sin(x) / x and cos(x) in x^2.  Within
+// +-45 degrees, the first terms left out are below 4e-7 and 3e-8.
+const float SIN_C1 = -1.0f / 6.0f;
+const float SIN_C2 = 1.0f / 120.0f;
+const float SIN_C3 = -1.0f / 5040.0f;
+const float COS_C1 = -1.0f / 2.0f;
+const float COS_C2 = 1.0f / 24.0f;
+const float COS_C3 = -1.0f / 720.0f;
+const float COS_C4 = 1.0f / 40320.0f;
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the sine and cosine of an angle in degrees, to within
+///         about 5e-7 of the exact values.
+///
+/// \details The angle is reduced to within 45 degrees of the nearest
+///         multiple of 90, which is exact for the angles a pose can hold
+///         (each multiple of 90 is exactly representable, and subtracting
+///         it from an angle that close cancels without rounding), then
+///         short polynomials give the sine and cosine of what's left.  The
+///         quadrant swaps and negates them.  There's no division and no
+///         table, and because the reduction happens in degrees, the error
+///         doesn't grow with the size of the angle the way it does for
+///         radians.
+///
+///         This is the scalar reference for the stream version.  The two
+///         only round to different quadrants at odd multiples of 45
+///         degrees, where both quadrants give the same accuracy.
+///
+/// \param  degrees The angle.  Its magnitude must be less than about 1e11,
+///         so that the quadrant fits in an int.
+/// \param  sine Receives the sine.
+/// \param  cosine Receives the cosine.
+void sinCosDegrees(float degrees, float& sine, float& cosine)
+{
+    int quadrant = int(std::floor(degrees * (1.0f / 90.0f) + 0.5f));
+    float x = (degrees - float(quadrant) * 90.0f) * DEGREES_TO_RADIANS;
+    float x2 = x * x;
+
+    float s = x + x * x2 * (SIN_C1 + x2 * (SIN_C2 + x2 * SIN_C3));
+    float c = 1.0f + x2 * (COS_C1 + x2 * (COS_C2 + x2 * (COS_C3 + x2 * COS_C4)));
+
+    if (quadrant & 1)
+        std::swap(s, c);
+    sine = (quadrant & 2) ? -s : s;
+    cosine = ((quadrant + 1) & 2) ? -c : c;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the sines and cosines of a stream of angles in degrees,
+///         as the scalar sinCosDegrees().
+///
+/// \details When SSE2 is available, four angles are done per iteration.
+///         Converting to an integer rounds to nearest, which replaces the
+///         floor, and the quadrant's swap and signs become masks.
+///
+/// \param  degrees The angles.
+/// \param  count The number of angles.
+/// \param  sines Receives count sines.
+/// \param  cosines Receives count cosines.
+void sinCosDegrees(const float* degrees, size_t count, float* sines, float* cosines)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 inverse_quarter_turn = _mm_set1_ps(1.0f / 90.0f);
+    const __m128 quarter_turn = _mm_set1_ps(90.0f);
+    const __m128 to_radians = _mm_set1_ps(DEGREES_TO_RADIANS);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i int_one = _mm_set1_epi32(1);
+    const __m128i int_two = _mm_set1_epi32(2);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 angle = _mm_loadu_ps(degrees + i);
+        __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(angle, inverse_quarter_turn));
+        __m128 x = _mm_mul_ps(_mm_sub_ps(angle, _mm_mul_ps(_mm_cvtepi32_ps(quadrant), quarter_turn)), to_radians);
+        __m128 x2 = _mm_mul_ps(x, x);
+
+        __m128 s = _mm_add_ps(_mm_set1_ps(SIN_C2), _mm_mul_ps(x2, _mm_set1_ps(SIN_C3)));
+        s = _mm_add_ps(_mm_set1_ps(SIN_C1), _mm_mul_ps(x2, s));
+        s = _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(x, x2), s));
+
+        __m128 c = _mm_add_ps(_mm_set1_ps(COS_C3), _mm_mul_ps(x2, _mm_set1_ps(COS_C4)));
+        c = _mm_add_ps(_mm_set1_ps(COS_C2), _mm_mul_ps(x2, c));
+        c = _mm_add_ps(_mm_set1_ps(COS_C1), _mm_mul_ps(x2, c));
+        c = _mm_add_ps(one, _mm_mul_ps(x2, c));
+
+        // odd quadrants swap sine and cosine; bit 1 of the quadrant, and of
+        // the quadrant plus one, are where the sine and cosine are negative.
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, int_one), int_one));
+        __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, int_two), 30));
+        __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, int_one), int_two), 30));
+
+        __m128 sine = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+        __m128 cosine = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+        _mm_storeu_ps(sines + i, _mm_xor_ps(sine, sin_sign));
+        _mm_storeu_ps(cosines + i, _mm_xor_ps(cosine, cos_sign));
+    }
+#endif
+
+    for (; i < count; ++i)
+        sinCosDegrees(degrees[i], sines[i], cosines[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the quaternion for a rotation about the z axis.
+///
+/// \param  degrees The angle of rotation, counterclockwise.
+glm::quat rotationToQuat(float degrees)
+{
+    float half_angle = glm::radians(degrees) * 0.5f;
+    return glm::quat(std::cos(half_angle), 0.0f, 0.0f, std::sin(half_angle));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the angle in degrees, from -180 to 180, of a rotation
+///         about the z axis.  Any rotation about other axes is ignored.
+float quatToRotation(const glm::quat& rotation)
+{
+    // q and -q are the same rotation; using the one with w >= 0 keeps the
+    // half angle within +-90 degrees.
+    float sign = rotation.w < 0.0f ? -1.0f : 1.0f;
+    return glm::degrees(2.0f * std::atan2(rotation.z * sign, rotation.w * sign));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a stream of z axis rotations to quaternions.
+void rotationsToQuats(const float* degrees, size_t count, glm::quat* rotations)
+{
+    for (size_t i = 0; i < count; ++i)
+        rotations[i] = rotationToQuat(degrees[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a stream of quaternions to z axis rotations.
+void quatsToRotations(const glm::quat* rotations, size_t count, float* degrees)
+{
+    for (size_t i = 0; i < count; ++i)
+        degrees[i] = quatToRotation(rotations[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Normalized linear interpolation between two unit quaternions,
+///         along the shorter path.
+///
+/// \details q and -q are the same rotation, but interpolating toward the one
+///         on the far side of the hypersphere turns the long way around, so
+///         b is negated if it's more than 90 degrees from a.  The result
+///         doesn't move at a constant angular speed the way a slerp does,
+///         but it's much cheaper, it's exact at t = 0 and t = 1, and for the
+///         small angles typical of blending animations the difference can't
+///         be seen.
+///
+///         This is the scalar reference for nlerpQuats().
+///
+/// \param  a The rotation to use when t == 0.
+/// \param  b The rotation to use when t == 1.
+/// \param  t The interpolation factor.
+glm::quat nlerp(const glm::quat& a, const glm::quat& b, float t)
+{
+    glm::quat target = glm::dot(a, b) < 0.0f ? -b : b;
+    return glm::normalize(a * (1.0f - t) + target * t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Interpolates between two streams of unit quaternions, as nlerp().
+///
+/// \details When SSE2 is available, four joints are processed per
+///         iteration: their quaternions are transposed into one register
+///         per component, so the dot products, sign corrections and
+///         normalizations of all four are done with vertical operations.
+///         The reciprocal square root is refined with one Newton-Raphson
+///         step, which is accurate to about 1e-7.
+///
+/// \param  a The stream of rotations to use when t == 0.
+/// \param  b The stream of rotations to use when t == 1.
+/// \param  t The interpolation factor.
+/// \param  out The stream which receives the results.  It may alias a or b.
+/// \param  count The number of quaternions in each stream.
+void nlerpQuats(const glm::quat* a, const glm::quat* b, float t, glm::quat* out, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 t4 = _mm_set1_ps(t);
+    const __m128 s4 = _mm_set1_ps(1.0f - t);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128 sign_bit = _mm_set1_ps(-0.0f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        // glm::quat is stored x, y, z, w.
+        __m128 ax = _mm_loadu_ps(&a[i].x);
+        __m128 ay = _mm_loadu_ps(&a[i + 1].x);
+        __m128 az = _mm_loadu_ps(&a[i + 2].x);
+        __m128 aw = _mm_loadu_ps(&a[i + 3].x);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+
+        __m128 bx = _mm_loadu_ps(&b[i].x);
+        __m128 by = _mm_loadu_ps(&b[i + 1].x);
+        __m128 bz = _mm_loadu_ps(&b[i + 2].x);
+        __m128 bw = _mm_loadu_ps(&b[i + 3].x);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+        // flip b's sign wherever the dot product is negative.
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                                _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, zero), sign_bit);
+        __m128 bt = _mm_xor_ps(t4, flip);
+
+        __m128 x = _mm_add_ps(_mm_mul_ps(ax, s4), _mm_mul_ps(bx, bt));
+        __m128 y = _mm_add_ps(_mm_mul_ps(ay, s4), _mm_mul_ps(by, bt));
+        __m128 z = _mm_add_ps(_mm_mul_ps(az, s4), _mm_mul_ps(bz, bt));
+        __m128 w = _mm_add_ps(_mm_mul_ps(aw, s4), _mm_mul_ps(bw, bt));
+
+        __m128 length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                           _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+        __m128 r = _mm_rsqrt_ps(length_squared);
+        r = _mm_mul_ps(_mm_mul_ps(half, r), _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(length_squared, r), r)));
+
+        x = _mm_mul_ps(x, r);
+        y = _mm_mul_ps(y, r);
+        z = _mm_mul_ps(z, r);
+        w = _mm_mul_ps(w, r);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&out[i].x, x);
+        _mm_storeu_ps(&out[i + 1].x, y);
+        _mm_storeu_ps(&out[i + 2].x, z);
+        _mm_storeu_ps(&out[i + 3].x, w);
+    }
+#endif
+
+    for (; i < count; ++i)
+        out[i] = nlerp(a[i], b[i], t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the unit complex number (cos, sin) for a rotation about
+///         the z axis.
+///
+/// \param  degrees The angle of rotation, counterclockwise.
+vec2 rotationToComplex(float degrees)
+{
+    vec2 rotation;
+    sinCosDegrees(degrees, rotation.y, rotation.x);
+    return rotation;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the angle in degrees, from -180 to 180, of a rotation
+///         stored as a complex number.  It needn't be normalized.
+float complexToRotation(const vec2& rotation)
+{
+    return glm::degrees(std::atan2(rotation.y, rotation.x));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a stream of z axis rotations to unit complex numbers.
+void rotationsToComplexes(const float* degrees, size_t count, vec2* rotations)
+{
+    // sinCosDegrees() writes separate streams, so convert a few at a time
+    // and interleave them.
+    const size_t BATCH = 64;
+    float sines[BATCH];
+    float cosines[BATCH];
+    for (size_t first = 0; first < count; first += BATCH)
+    {
+        size_t batch = std::min(BATCH, count - first);
+        sinCosDegrees(degrees + first, batch, sines, cosines);
+        for (size_t i = 0; i < batch; ++i)
+            rotations[first + i] = vec2(cosines[i], sines[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a stream of complex numbers to z axis rotations.
+void complexesToRotations(const vec2* rotations, size_t count, float* degrees)
+{
+    for (size_t i = 0; i < count; ++i)
+        degrees[i] = complexToRotation(rotations[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Normalized linear interpolation between two unit complex
+///         numbers.
+///
+/// \details Unlike a quaternion, a complex number has only one
+///         representation of each rotation, so the lerp always takes the
+///         shorter way around, as lerpAngle() does; the two mustn't be
+///         exactly opposite.  Like the quaternion nlerp(), it's exact at
+///         t = 0 and t = 1 but doesn't turn at a constant speed in between;
+///         blending 0 and 90 degrees halfway is exact, but a quarter of the
+///         way gives 18.4 degrees rather than 22.5.
+///
+///         This is the scalar reference for nlerpComplexes().
+///
+/// \param  a The rotation to use when t == 0.
+/// \param  b The rotation to use when t == 1.
+/// \param  t The interpolation factor.
+vec2 nlerp(const vec2& a, const vec2& b, float t)
+{
+    return glm::normalize(a * (1.0f - t) + b * t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Interpolates between two streams of unit complex numbers, as
+///         nlerp().
+///
+/// \details When SSE2 is available, four joints are processed per
+///         iteration, their real and imaginary parts split into one register
+///         each.  The reciprocal square root is refined with one
+///         Newton-Raphson step, as in nlerpQuats().
+///
+/// \param  a The stream of rotations to use when t == 0.
+/// \param  b The stream of rotations to use when t == 1.
+/// \param  t The interpolation factor.
+/// \param  out The stream which receives the results.  It may alias a or b.
+/// \param  count The number of complex numbers in each stream.
+void nlerpComplexes(const vec2* a, const vec2* b, float t, vec2* out, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 t4 = _mm_set1_ps(t);
+    const __m128 s4 = _mm_set1_ps(1.0f - t);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 three = _mm_set1_ps(3.0f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a01 = _mm_loadu_ps(&a[i].x);
+        __m128 a23 = _mm_loadu_ps(&a[i + 2].x);
+        __m128 b01 = _mm_loadu_ps(&b[i].x);
+        __m128 b23 = _mm_loadu_ps(&b[i + 2].x);
+
+        // the interleaved pairs are lerped as they are, then split.
+        __m128 l01 = _mm_add_ps(_mm_mul_ps(a01, s4), _mm_mul_ps(b01, t4));
+        __m128 l23 = _mm_add_ps(_mm_mul_ps(a23, s4), _mm_mul_ps(b23, t4));
+        __m128 x = _mm_shuffle_ps(l01, l23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(l01, l23, _MM_SHUFFLE(3, 1, 3, 1));
+
+        __m128 length_squared = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+        __m128 r = _mm_rsqrt_ps(length_squared);
+        r = _mm_mul_ps(_mm_mul_ps(half, r), _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(length_squared, r), r)));
+
+        x = _mm_mul_ps(x, r);
+        y = _mm_mul_ps(y, r);
+        _mm_storeu_ps(&out[i].x, _mm_unpacklo_ps(x, y));
+        _mm_storeu_ps(&out[i + 2].x, _mm_unpackhi_ps(x, y));
+    }
+#endif
+
+    for (; i < count; ++i)
+        out[i] = nlerp(a[i], b[i], t);
+}
@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_rotation.h
+/// \author Ben Crist
+///
+/// \brief  Functions for representing joint rotations as quaternions or
+///         unit complex numbers, and blending many of them at once.
+///
+/// \details Poses store each joint's rotation as a single angle, which is
+///         all a 2D skeleton needs, and blendPoses() interpolates those
+///         angles exactly.  A 3D skeleton can't blend its rotations one Euler
+///         angle at a time, though, so these functions provide the
+///         quaternion path it would use: rotations about the z axis convert
+///         to and from quaternions exactly, so the quaternion blend can be
+///         checked against the angle blend on the existing rigs.
+///
+///         A 2D rig can also keep its rotations as unit complex numbers,
+///         (cos, sin) pairs, which turn into transforms with no trig at all
+///         and blend with an nlerp just like quaternions.  Where the angles
+///         themselves are needed, sinCosDegrees() gets the sines and cosines
+///         of a whole stream at once, more cheaply than std::sin() and
+///         std::cos().
+
+#ifndef JOINT_ROTATION_H_
+#define JOINT_ROTATION_H_
+
+#include "demo.h"
+
+void sinCosDegrees(float degrees, float& sine, float& cosine);
+void sinCosDegrees(const float* degrees, size_t count, float* sines, float* cosines);
+
+glm::quat rotationToQuat(float degrees);
+float quatToRotation(const glm::quat& rotation);
+
+void rotationsToQuats(const float* degrees, size_t count, glm::quat* rotations);
+void quatsToRotations(const glm::quat* rotations, size_t count, float* degrees);
+
+glm::quat nlerp(const glm::quat& a, const glm::quat& b, float t);
+void nlerpQuats(const glm::quat* a, const glm::quat* b, float t, glm::quat* out, size_t count);
+
+vec2 rotationToComplex(float degrees);
+float complexToRotation(const vec2& rotation);
+
+void rotationsToComplexes(const float* degrees, size_t count, vec2* rotations);
+void complexesToRotations(const vec2* rotations, size_t count, float* degrees);
+
+vec2 nlerp(const vec2& a, const vec2& b, float t);
+void nlerpComplexes(const vec2* a, const vec2* b, float t, vec2* out, size_t count);
+
+#endif
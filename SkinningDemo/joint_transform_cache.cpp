@@ -0,0 +1,180 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_transform_cache.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of JointTransformCache class functions.
+
+#include "joint_transform_cache.h"
+
+#include <cassert>
+#include <cstring>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a cache for poses of a skeleton.  Nothing has been
+///         computed yet, so the first update() recomputes every joint.
+///
+/// \param  skeleton The skeleton whose poses will be evaluated.  The cache
+///         allocates a pose from it, so it must outlive the cache.
+JointTransformCache::JointTransformCache(Skeleton& skeleton)
+    : skeleton_(skeleton),
+      evaluated_(skeleton.allocatePose(true)),
+      transforms_(skeleton.getJointCount()),
+      affines_(skeleton.getJointCount()),
+      dirty_(skeleton.getJointCount(), 0),
+      invalidated_(skeleton.getJointCount(), 1),
+      colors_invalidated_(true),
+      colors_changed_(false),
+      dirty_count_(0),
+      first_dirty_(0),
+      dirty_end_(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the cache's copy of the pose to the skeleton.
+JointTransformCache::~JointTransformCache()
+{
+    skeleton_.releasePose(evaluated_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Brings the cached transforms up to date with a pose.
+///
+/// \details A joint is dirty if its translation, rotation or scale differs
+///         from the last update, if it was invalidated, or if its parent is
+///         dirty.  Colors don't affect the transforms, but whether they've
+///         changed is recorded too, since they're uploaded alongside them.
+///         A pose without colors never changes them.
+///
+/// \param  pose The pose to evaluate.
+/// \return The number of joints whose transforms were recomputed.
+size_t JointTransformCache::update(const Pose& pose)
+{
+    size_t joint_count = transforms_.size();
+    assert(pose.joint_count == joint_count);
+
+    dirty_count_ = 0;
+    first_dirty_ = 0;
+    dirty_end_ = 0;
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        int parent = skeleton_.getParent(joint);
+        bool dirty = invalidated_[joint] ||
+                     pose.translation[joint] != evaluated_.translation[joint] ||
+                     pose.rotation[joint] != evaluated_.rotation[joint] ||
+                     pose.scale[joint] != evaluated_.scale[joint] ||
+                     (parent != Skeleton::NO_PARENT && dirty_[parent]);
+
+        dirty_[joint] = dirty;
+        invalidated_[joint] = 0;
+        if (dirty)
+        {
+            if (dirty_count_ == 0)
+                first_dirty_ = joint;
+
+            dirty_end_ = joint + 1;
+            ++dirty_count_;
+        }
+    }
+
+    colors_changed_ = colors_invalidated_ ||
+                      (pose.color != nullptr &&
+                       std::memcmp(pose.color, evaluated_.color, joint_count * sizeof(color4)) != 0);
+    colors_invalidated_ = false;
+
+    if (dirty_count_ == joint_count)
+    {
+        skeleton_.computeJointAffines(pose, affines_.data());
+        for (size_t joint = 0; joint < joint_count; ++joint)
+            transforms_[joint] = affineToMat4(affines_[joint]);
+    }
+    else
+    {
+        for (size_t joint = first_dirty_; joint < dirty_end_; ++joint)
+        {
+            if (!dirty_[joint])
+                continue;
+
+            int parent = skeleton_.getParent(joint);
+            Affine2D local = getJointLocalAffine(pose, joint);
+            affines_[joint] = parent == Skeleton::NO_PARENT ? local : composeAffine(affines_[parent], local);
+            transforms_[joint] = affineToMat4(affines_[joint]);
+        }
+    }
+
+    if (dirty_count_ > 0 || colors_changed_)
+        copyPose(pose, evaluated_);
+
+    return dirty_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forces a joint (and so all of its descendants) to be recomputed
+///         by the next update(), whether or not it has changed.
+void JointTransformCache::invalidate(size_t joint)
+{
+    invalidated_[joint] = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forces the next update() to recompute every joint, and to report
+///         the colors as changed.
+void JointTransformCache::invalidateAll()
+{
+    invalidated_.assign(invalidated_.size(), 1);
+    colors_invalidated_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the last update() recomputed a joint's transform.
+bool JointTransformCache::isJointDirty(size_t joint) const
+{
+    return dirty_[joint] != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints the last update() recomputed.
+size_t JointTransformCache::getDirtyJointCount() const
+{
+    return dirty_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the first joint the last update() recomputed.  Every
+///         dirty joint is in [getFirstDirtyJoint(), getDirtyJointEnd()),
+///         which is empty if nothing was.
+size_t JointTransformCache::getFirstDirtyJoint() const
+{
+    return first_dirty_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns one past the last joint the last update() recomputed.
+size_t JointTransformCache::getDirtyJointEnd() const
+{
+    return dirty_end_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if any joint's color changed in the last update().
+bool JointTransformCache::haveColorsChanged() const
+{
+    return colors_changed_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the joints' local-to-model transforms as of the last
+///         update().
+const mat4* JointTransformCache::getTransforms() const
+{
+    return transforms_.data();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the same transforms as getTransforms(), as 2D affine
+///         transforms.
+const Affine2D* JointTransformCache::getAffines() const
+{
+    return affines_.data();
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  joint_transform_cache.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the JointTransformCache class.
+
+#ifndef JOINT_TRANSFORM_CACHE_H_
+#define JOINT_TRANSFORM_CACHE_H_
+
+#include "skeleton.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Holds the local-to-model transforms of a pose's joints, and
+///         recomputes only the ones that have changed.
+///
+/// \details The cache keeps a copy of the channels its transforms were
+///         computed from.  Each update() compares the pose against that copy
+///         to find the joints that moved, marks them and (since a joint's
+///         transform depends on all of its ancestors') every joint below
+///         them dirty, and re-evaluates just the dirty joints.  Since
+///         parents always come before their children, both passes are a
+///         single walk over the joints.  When everything is dirty, the
+///         transforms are computed in one batch with
+///         Skeleton::computeJointAffines() instead.
+///
+///         After an update, the dirty joints are the ones whose transforms
+///         (and so whose skinning matrices) need to be rebuilt.  In a
+///         skeleton stored depth-first, each subtree is a contiguous run of
+///         joints, so the dirty range is tight when only one limb moves.
+///
+///         The joints are evaluated as Affine2D transforms, which is all a
+///         2D pose needs, and each dirty joint's is then written out as a
+///         mat4 too, for everything which draws with matrices.
+class JointTransformCache
+{
+public:
+    explicit JointTransformCache(Skeleton& skeleton);
+    ~JointTransformCache();
+
+    size_t update(const Pose& pose);
+
+    void invalidate(size_t joint);
+    void invalidateAll();
+
+    bool isJointDirty(size_t joint) const;
+    size_t getDirtyJointCount() const;
+    size_t getFirstDirtyJoint() const;
+    size_t getDirtyJointEnd() const;
+    bool haveColorsChanged() const;
+
+    const mat4* getTransforms() const;
+    const Affine2D* getAffines() const;
+
+private:
+    JointTransformCache(const JointTransformCache&);            // non-copyable
+    JointTransformCache& operator=(const JointTransformCache&); // non-copyable
+
+    Skeleton& skeleton_;
+    Pose evaluated_;                ///< The channels transforms_ were computed from.
+    std::vector<mat4> transforms_;
+    std::vector<Affine2D> affines_;
+    std::vector<char> dirty_;       ///< Which joints the last update() recomputed.
+    std::vector<char> invalidated_; ///< Joints to recompute on the next update() whether or not they've changed.
+    bool colors_invalidated_;
+    bool colors_changed_;
+    size_t dirty_count_;
+    size_t first_dirty_;
+    size_t dirty_end_;
+};
+
+#endif
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  latency_tracker.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of LatencyTracker class functions.
+
+#include "latency_tracker.h"
+
+#include <cassert>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+/// The names of the stages' timings, as the overlay and formatSummary()
+/// show them.
+const char* const STAGE_NAMES[LatencyTracker::N_STAGES] =
+{
+    "input to pose",
+    "input to upload",
+    "input to submit",
+    "input to swap",
+    "input to gpu done"
+};
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the queries, with nothing timed yet.
+///
+/// \param  window The number of most recent frames each stage's statistics
+///         cover.
+LatencyTracker::LatencyTracker(size_t window)
+    : last_serial_(0),
+      tracking_(false),
+      input_milliseconds_(0),
+      next_query_(0),
+      dropped_(0)
+{
+    for (size_t i = 0; i < N_STAGES; ++i)
+        stats_.push_back(TimingStats(STAGE_NAMES[i], window));
+
+    glGenQueries(GLsizei(N_QUERIES), query_ids_);
+    for (size_t i = 0; i < N_QUERIES; ++i)
+    {
+        pending_[i] = false;
+        query_inputs_[i] = 0;
+        query_offsets_[i] = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the queries, dropping any results still pending.
+LatencyTracker::~LatencyTracker()
+{
+    glDeleteQueries(GLsizei(N_QUERIES), query_ids_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts timing a frame, if its packet answers an event and
+///         hasn't been timed already.
+///
+/// \details The pose's stage is the packet's own, since it happened on the
+///         simulation thread; the rest are marked as the frame reaches them.
+///
+/// \param  serial The packet's serial.
+/// \param  input_milliseconds When the oldest event the packet answers
+///         arrived, or 0 if it doesn't answer one.
+/// \param  posed_milliseconds When the simulation thread finished it.
+void LatencyTracker::beginFrame(size_t serial, double input_milliseconds, double posed_milliseconds)
+{
+    collect();
+
+    tracking_ = input_milliseconds > 0 && serial != last_serial_;
+    last_serial_ = serial;
+    input_milliseconds_ = input_milliseconds;
+    if (tracking_)
+        stats_[STAGE_POSED].addSample(posed_milliseconds - input_milliseconds);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records that the frame has reached a stage before the swap.
+void LatencyTracker::mark(Stage stage)
+{
+    assert(stage != STAGE_POSED && stage < STAGE_PRESENTED);
+    if (tracking_)
+        stats_[stage].addSample(getTimeMilliseconds() - input_milliseconds_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records that the swap has returned, and issues the query which
+///         finds out when the GPU finished the frame.
+///
+/// \details Must be called straight after the swap, so the query follows
+///         everything the frame drew.
+void LatencyTracker::endFrame()
+{
+    if (!tracking_)
+        return;
+    tracking_ = false;
+
+    double now = getTimeMilliseconds();
+    stats_[STAGE_PRESENTED].addSample(now - input_milliseconds_);
+
+    collect();
+    if (pending_[next_query_])
+    {
+        ++dropped_;
+        return;
+    }
+
+    // the GPU's clock is read as late as it's queued, so the offset is
+    // only as exact as the call's own latency, a few microseconds.
+    GLint64 gpu_nanoseconds = 0;
+    glQueryCounter(query_ids_[next_query_], GL_TIMESTAMP);
+    glGetInteger64v(GL_TIMESTAMP, &gpu_nanoseconds);
+    query_offsets_[next_query_] = getTimeMilliseconds() - gpu_nanoseconds / 1000000.0;
+    query_inputs_[next_query_] = input_milliseconds_;
+    pending_[next_query_] = true;
+    next_query_ = (next_query_ + 1) % N_QUERIES;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads back every query the GPU has answered, without waiting
+///         for the rest.
+void LatencyTracker::collect()
+{
+    for (size_t i = 0; i < N_QUERIES; ++i)
+    {
+        if (!pending_[i])
+            continue;
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query_ids_[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 gpu_nanoseconds = 0;
+        glGetQueryObjectui64v(query_ids_[i], GL_QUERY_RESULT, &gpu_nanoseconds);
+        double done_milliseconds = gpu_nanoseconds / 1000000.0 + query_offsets_[i];
+        stats_[STAGE_GPU_DONE].addSample(done_milliseconds - query_inputs_[i]);
+        pending_[i] = false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the frame being drawn answers an event.
+bool LatencyTracker::isTracking() const
+{
+    return tracking_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a stage's times from the event, in milliseconds.
+const TimingStats& LatencyTracker::getStats(Stage stage) const
+{
+    assert(stage < N_STAGES);
+    return stats_[stage];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of frames whose GPU time was dropped because
+///         every query was still pending.
+size_t LatencyTracker::getDroppedCount() const
+{
+    return dropped_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns each stage's median, 90th and 99th percentile, one per
+///         line, for stderr.
+std::string LatencyTracker::formatSummary() const
+{
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < N_STAGES; ++i)
+    {
+        const TimingStats& stats = stats_[i];
+        text << "  " << std::left << std::setw(18) << stats.getName() << std::right
+             << "p50 " << std::setw(7) << stats.getPercentile(50)
+             << "  p90 " << std::setw(7) << stats.getPercentile(90)
+             << "  p99 " << std::setw(7) << stats.getPercentile(99) << " ms over " << stats.getSampleCount()
+             << " frames" << std::endl;
+    }
+    if (dropped_ > 0)
+        text << "  " << dropped_ << " frames' GPU times were dropped, waiting on older queries." << std::endl;
+    return text.str();
+}
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  latency_tracker.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the LatencyTracker class.
+
+#ifndef LATENCY_TRACKER_H_
+#define LATENCY_TRACKER_H_
+
+#include "profiler.h"
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Measures how long an input event takes to reach the screen, at
+///         each stage of the frame which answers it.
+///
+/// \details Every time is in getTimeMilliseconds(), counted from the event:
+///         the simulation thread finishing the pose, the palettes being
+///         uploaded, the draws submitted, the swap returning, and the GPU
+///         finishing the frame.  The last comes from a GL_TIMESTAMP query
+///         issued after the swap (GL 3.3), which is read back frames later,
+///         once it's available, and carried over to the CPU's clock by an
+///         offset measured with glGetInteger64v(GL_TIMESTAMP) as it's
+///         issued.  The GPU finishing is as close to the photons as GL can
+///         see; the display's scan-out adds up to another refresh on top.
+///
+///         Only frames which answer an event are timed: beginFrame() is
+///         given the oldest event the frame's packet answers, or 0.  The
+///         queries are never waited for; if every one is still pending, the
+///         frame's GPU time is dropped and counted.
+///
+///         Must be created, used and destroyed on the thread which owns the
+///         GL context.
+class LatencyTracker
+{
+public:
+    /// The points of the frame which are timed from the event.
+    enum Stage
+    {
+        STAGE_POSED = 0,    ///< The simulation thread finished the packet.
+        STAGE_UPLOADED,     ///< The packet's palettes were uploaded.
+        STAGE_SUBMITTED,    ///< The frame's draws were submitted.
+        STAGE_PRESENTED,    ///< The swap returned.
+        STAGE_GPU_DONE,     ///< The GPU finished everything up to the swap.
+        N_STAGES
+    };
+
+    explicit LatencyTracker(size_t window = 600);
+    ~LatencyTracker();
+
+    void beginFrame(size_t serial, double input_milliseconds, double posed_milliseconds);
+    void mark(Stage stage);
+    void endFrame();
+
+    bool isTracking() const;
+    const TimingStats& getStats(Stage stage) const;
+    size_t getDroppedCount() const;
+    std::string formatSummary() const;
+
+private:
+    LatencyTracker(const LatencyTracker&);              // non-copyable
+    LatencyTracker& operator=(const LatencyTracker&);   // non-copyable
+
+    void collect();
+
+    static const size_t N_QUERIES = 8;
+
+    std::vector<TimingStats> stats_;        ///< One per Stage.
+    size_t last_serial_;                    ///< The packet last timed, which a redraw doesn't time again.
+    bool tracking_;                         ///< The frame being drawn answers an event.
+    double input_milliseconds_;             ///< When the frame's event arrived.
+    GLuint query_ids_[N_QUERIES];
+    bool pending_[N_QUERIES];               ///< Whether each query has a result which hasn't been read.
+    double query_inputs_[N_QUERIES];        ///< The event each pending query's frame answers.
+    double query_offsets_[N_QUERIES];       ///< The CPU's clock minus the GPU's, in milliseconds, as each was issued.
+    size_t next_query_;
+    size_t dropped_;                        ///< Frames whose GPU time was dropped.
+};
+
+#endif
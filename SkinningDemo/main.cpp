@@ -7,222 +7,1109 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Make sure we're linking against GLEW and freeGLUT
+// (other compilers are given them by CMakeLists.txt).
+#ifdef _MSC_VER
 #ifdef DEBUG
 #pragma comment (lib, "glew32sd.lib")
 #else
 #pragma comment (lib, "glew32s.lib")
 #endif
 #pragma comment (lib, "freeglut.lib")
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
 #include "demo.h"
+#include "animation_clip.h"
+#include "animation_lod.h"
+#include "animation_state_cache.h"
+#include "asset_loader.h"
+#include "backend_calibration.h"
+#include "baked_animation.h"
+#include "blend_graph.h"
+#include "camera.h"
+#include "clip_database.h"
+#include "compressed_clip.h"
+#include "compute_skinner.h"
+#include "cpu_skinner.h"
+#include "debug_draw.h"
+#include "epoch_reclaimer.h"
+#include "file_watcher.h"
+#include "fixed_point_pose.h"
+#include "frame_arena.h"
+#include "frame_graph.h"
+#include "frame_packet.h"
+#include "frame_scheduler.h"
+#include "frame_stats.h"
+#include "gl_deletion_queue.h"
+#include "gl_state_cache.h"
+#include "handle_registry.h"
+#include "hierarchy_compute_pass.h"
+#include "hierarchy_levels.h"
+#include "ik_solver.h"
+#include "impostor_atlas.h"
+#include "instance_cull_pass.h"
+#include "jiggle_chains.h"
+#include "job_system.h"
+#include "joint_channel_plan.h"
+#include "joint_transform_cache.h"
+#include "latency_tracker.h"
 #include "skeletal_mesh.h"
-
+#include "skeleton.h"
+#include "skeleton_eval.h"
+#include "mesh_arena.h"
+#include "mesh_file.h"
+#include "mesh_lod.h"
+#include "mesh_picking.h"
+#include "mesh_upload_queue.h"
+#include "mesh_variant.h"
+#include "morph_target_pass.h"
+#include "numa_topology.h"
+#include "occlusion_queries.h"
+#include "palette.h"
+#include "palette_cache.h"
+#include "palette_ring.h"
+#include "palette_stream.h"
+#include "physics_pose_input.h"
+#include "platform.h"
+#include "pose_codec.h"
+#include "posed_mesh.h"
+#include "pose_space_correctives.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "ragdoll.h"
+#include "render_loop.h"
+#include "render_queue.h"
+#include "render_target.h"
+#include "residency_manager.h"
+#include "rig_file.h"
+#include "session_log.h"
+#include "shader.h"
+#include "shader_permutation.h"
+#include "shadow_pass.h"
+#include "skinned_bounds_pass.h"
+#include "skinned_vertex_cache.h"
+#include "skinning_balancer.h"
+#include "skinning_shaders.h"
+#include "skinning_stream.h"
+#include "trace.h"
+#include "uniform_ring_buffer.h"
+#include "validation.h"
+#include "vertex_color_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function Prototypes
 void initGL();
-void initShaderProgram();
+void requestShaderPrograms();
+void finishShaderPrograms();
+void startStartupLoads();
+size_t getFileBytes(const std::string& path);
+void readStartupMesh(void* context);
+void uploadStartupMesh(void* context);
+void readShaderSources(void* context);
+void loadPoses(void* context);
 void initMeshes();
+void buildMeshLodJob(void* data, size_t lod);
 void initPoses();
+void buildRig();
+void loadRig();
+void openClipDatabase();
+void loadShaderSource(const std::string& path, const std::string& builtin, std::string& source);
+void requestSkinningPrograms(ProgramCache& cache, SkinningProgramSet& program_set);
+void useSkinningPrograms(const SkinningProgramSet& program_set);
+void setSkinningProgramUniforms();
+void computeLodJointBounds(size_t lod);
+void initImpostors();
+void initResidency();
+void restoreMeshLod(void* data, size_t lod);
+void startHotReload();
+void applyHotReload();
+bool hasMeshLayout(const MeshFileData& data);
+void reloadMesh();
+void reloadClip(const CompressedClip& loaded);
+void playReloadedClip(const CompressedClip& reloaded);
+void initSkinningBalancer();
+void initGpuHierarchy();
+void waitForSimulation();
+void hotReloadTimer(void* data);
 
 void cleanup();
 
-void reshape(int width, int height);
-void display();
-void keyboard(unsigned char key, int x, int y);
-void mouseMove(int x, int y);
+struct SimulationRequest;
+struct SkinningProgram;
+struct DisplayFrame;
+
+void reshape(PlatformWindow& window, GLsizei width, GLsizei height);
+void display(PlatformWindow& window);
+void beginShadowPass(const Camera& camera, GLuint program_id, const mat4& source_transform);
+void endShadowPass(GLenum polygon_mode);
+void buildFrameGraph(DisplayFrame& frame);
+void bindPaletteTextures(const DisplayFrame& frame);
+void runSkinningPass(void* context);
+void runSkinnedBoundsPass(void* context);
+void runShadowPass(void* context);
+void runScenePass(void* context);
+void runComparisonPass(void* context);
+void runDebugDrawPass(void* context);
+void runResolvePass(void* context);
+void runOverlayPass(void* context);
+size_t packSkinningPaletteBlock(const FramePacket& packet, SkinningMode mode, float palette_blend, char* block);
+size_t uploadPaletteTexture(const FramePacket& packet);
+void drawComparison(const FramePacket& packet, float palette_blend, bool wireframe_overlay, FrameStats& stats);
+void drawImpostors(const FramePacket& packet, FrameStats& stats);
+void bakePose(const DisplayFrame& frame);
+bool acquirePacket();
+bool isComparableMode(SkinningMode mode);
+SkinningMode getCompareMode(SkinningMode mode);
+bool drawsWith(const SimulationRequest& request, SkinningMode mode);
+void postSimulationRequest(size_t steps, float interpolation);
+void postReplayRequest();
+void finishReplay();
+void packRequest(const SimulationRequest& request, GLuint* words);
+void unpackRequest(const GLuint* words, SimulationRequest& request);
+void simulationMain();
+void simulateFrame(const SimulationRequest& request, FramePacket& packet);
+size_t getInstanceNode(size_t instance);
+void startPosingInstances(const SimulationRequest& request, FramePacket& packet);
+void startBuildingInstancePalettes(FramePacket& packet);
+void gatherLeaderLocals(FramePacket& packet);
+void setUpInstanceJob(void* data, size_t instance);
+void blendInstanceJob(void* data, size_t instance);
+void hierarchyInstanceJob(void* data, size_t instance);
+void paletteInstanceJob(void* data, size_t instance);
+void stageInstanceJob(void* data, size_t instance);
+void solveCurrentPoseIk(const SimulationRequest& request);
+void playInstantReplay();
+void emitClipEvents(bool pose_crowd);
+void startRagdoll();
+void stopRagdoll();
+void physicsMain();
+void pickAtMouse(int x, int y);
+void selectInstanceLods(const SimulationRequest& request, FramePacket& packet);
+void layoutInstancePalettes(const SimulationRequest& request, FramePacket& packet);
+void packHalfInstancePalettes(FramePacket& packet);
+bool recordPaletteLayout(const FramePacket& packet, bool half);
+void writeInstancePalettes(const FramePacket& packet, FrameStats& stats);
+float getCrowdPhaseOffset(size_t instance, size_t lod);
+void computeCrowdWeights(float phase, float* weights);
+AnimationStateKey getCrowdStateKey(size_t instance, size_t lod);
+size_t getImpostorFrame(size_t instance, size_t lod);
+size_t getCrowdVariant(size_t instance);
+color4 getCrowdVariantColor(const color4& color, size_t variant);
+AnimationStateKey getCurrentPoseKey();
+size_t getLodJointCount(size_t lod);
+mat4* getInstancePalette(FramePacket& packet, size_t instance);
+const SkeletalMesh& getLodMesh(size_t lod);
+const SkinningProgram& getInstancedProgram(size_t lod, size_t influences);
+GLuint getInstancedProgramId(size_t lod, size_t influences);
+void updateInstanceTransforms();
+void cullInstances(const SimulationRequest& request, FramePacket& packet);
+void createInstanceCullPass();
+void drawProfilerOverlay();
+size_t countSkinnedVertices(const FramePacket& packet);
+void keyboard(PlatformWindow& window, unsigned char key, int x, int y);
+void mouseMove(PlatformWindow& window, int x, int y);
+void zoomCamera(float factor);
+void windowClosed(PlatformWindow& window);
+void requestFrame();
+void frameTimer(void* data);
+void startCalibration(bool force);
+void applySkinningBackend(size_t backend);
+void updateCalibration(SkinningMode mode, double cpu_milliseconds);
+void cancelCalibration();
+void stepAnimation(const SimulationRequest& request);
+
+///////////////////////////////////////////////////////////////////////////////
+// Global Variables
+
+Platform* platform = nullptr;           ///< Creates the window, and delivers its input.
+PlatformWindow* window = nullptr;       ///< The demo's only window; owned by platform.
+RenderLoop* render_loop = nullptr;      ///< Draws the window when a frame is posted, and runs the timers.
+
+glm::ivec2 viewport;        ///< The current size of the viewport in pixels.
+
+// the scene is seen through an orthographic camera looking down at the
+// xy plane, which zooms in on the center of the viewport.  Every program
+// drawing the scene reads it from the Camera block in camera_buffer.
+const float CAMERA_ZOOM_STEP = 1.25f;   ///< How much each press of = or - zooms the camera.
+const float CAMERA_MAX_ZOOM = 8.0f;
+Camera camera;                          ///< GLUT thread.
+float camera_zoom = 1.0f;               ///< GLUT thread: 1 shows the -1 to 1 square.
+UniformRingBuffer* camera_buffer;       ///< Holds a copy of the Camera block for each frame in flight.
+Camera uploaded_camera;                 ///< The camera in the bound Camera block.
+bool camera_uploaded = false;           ///< Whether the Camera block has been bound at all.
+
+// the meshes and clips are owned by registries, and referred to by handle.
+// They're kept behind unique_ptrs, so they never move as the registries
+// pack themselves, and the raw pointers kept alongside some of the handles
+// are just those handles resolved once, when the objects are added.
+typedef HandleRegistry<std::unique_ptr<SkeletalMesh> > MeshRegistry;
+typedef HandleRegistry<std::unique_ptr<AnimationClip> > ClipRegistry;
+MeshRegistry meshes;        ///< GLUT thread; destroyed in cleanup(), while there's still a context.
+
+/// The meshes release their GL objects into this, and the GLUT thread
+/// deletes them at the start of each frame, so a mesh can be dropped from
+/// any thread.
+GLDeletionQueue gl_deletion_queue;
+
+// The demo runs on two threads.  The GLUT thread handles input and owns
+// everything to do with OpenGL; it only ever draws FramePackets.  The
+// simulation thread owns the skeleton, poses, clips and crowd, and turns
+// each SimulationRequest into a packet.  Apart from the request and the
+// packet buffer, which are how the two talk, each of the globals below
+// belongs to exactly one of them.
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  Defines a joint in a particular pose, which is really just a
-///         local coordinate system defined by a translation, rotation, and
-///         scale relative to the parent joint's coordinate system.
-struct JointPose
+/// \brief  What the GLUT thread asks the simulation thread to produce: the
+///         input as of the request, and how far to advance the animation.
+struct SimulationRequest
 {
-    JointPose* parent;
-    color4 color;
-    vec2 translation;
-    float rotation;
-    float scale;
+    size_t serial;                  ///< Increases with every request.
+    size_t steps;                   ///< The number of fixed steps to advance before posing.
+    float step_seconds;             ///< The simulated time each step covers.
+    float interpolation;            ///< How far past the last step to pose, as a fraction of a step.
+    float target_blend_factor;
+    bool play_clip;
+    bool draw_joints;
+    SkinningMode skinning_mode;
+    SkinningMode compare_mode;      ///< The mode the right half is drawn with as well, or N_SKINNING_MODES.
+    bool ik;                        ///< Whether to solve current_pose's IK chains.
+    vec2 ik_target;                 ///< Where the mouse is, in world space, for the reaching chain.
+    bool ragdoll;                   ///< Whether to blend physics_input's latest frame into current_pose.
+    bool gpu_culling;               ///< Whether instance_cull_pass culls the crowd, so every instance needs a palette.
+    bool half_palettes;             ///< Whether to pack the instanced crowd's palettes into half floats.
+    bool motion_vectors;            ///< Whether the crowd's palettes have to go through palette_ring, for its motion vectors.
+    bool impostors;                 ///< Whether the crowd's far instances are drawn from impostor_atlas.
+    bool occlusion_culling;         ///< Whether to leave out what occlusion_queries last found hidden.
+    std::vector<GLuint> hidden_counts;  ///< Each instance's occlusion_hidden_counts, while occlusion_culling is set.
+    Camera camera;                  ///< What the scene is seen through; the crowd is culled against it.
+    glm::ivec2 viewport;            ///< The size of the viewport, which the crowd's levels of detail are chosen for.
+    size_t replay_frame;            ///< The frame of session_player this request replays, when replaying.
+    bool instant_replay;            ///< Whether current_pose plays instant_replay_buffer back instead of being posed.
+    double input_milliseconds;      ///< When the oldest mouse event the request answers arrived, or 0; for -latency.
 };
 
+/// The number of words packRequest() turns a SimulationRequest into, for a
+/// session log.  The serial, replay_frame and input_milliseconds aren't
+/// input, so they're left out, and so is ragdoll: the physics thread's timing can't be replayed,
+/// so the ragdoll is never on in a session that's recorded or replayed.
+/// gpu_culling, half_palettes, motion_vectors and impostors only change how
+/// the crowd is drawn, the
+/// compare_mode only what else the mesh is drawn with, and the camera
+/// only where, so they aren't either; nor is the occlusion
+/// culling, whose results depend on the GPU's timing and only leave out
+/// what can't be seen.  A replay uses whatever is set as it runs, except for
+/// the instant replay, which is off.
+const size_t REQUEST_WORDS = 12;
+
+std::thread simulation_thread;
+std::mutex simulation_mutex;                    ///< Guards the variables up to frame_packets.
+std::condition_variable simulation_wake;        ///< Signaled when a request is posted, or on shutdown.
+std::condition_variable packet_published;       ///< Signaled whenever the simulation thread publishes a packet.
+SimulationRequest simulation_request;           ///< The latest request.
+bool simulation_request_pending = false;        ///< simulation_request hasn't been picked up yet.
+bool simulation_stopping = false;
+size_t published_serial = 0;                    ///< The serial of the latest published packet's request.
+FramePacketBuffer frame_packets;                ///< Hands packets from the simulation thread to the GLUT thread.
+
+// GLUT thread.
+SimulationRequest last_request;                 ///< The last request posted.
+
+// a session can be recorded to a log, and replayed from one as fast as the
+// demo can draw it: see SessionRecorder.  The recorder belongs to the
+// simulation thread; the player is only read once it's loaded.
+std::string record_path;                        ///< Record the session to this log, if not empty.
+std::string replay_path;                        ///< Replay this log instead of following the input, if not empty.
+SessionRecorder* session_recorder;
+SessionPlayer* session_player;
+size_t replay_next_frame = 0;                   ///< The frame of session_player to post next.
+double replay_start_milliseconds;               ///< When the first replayed frame was drawn.
+size_t replay_mismatches = 0;                   ///< Frames whose pose wasn't the one recorded; simulation thread.
+size_t uploaded_block_version = 0;              ///< The block_version of the bound SkinningPalette block.
+size_t uploaded_palette_texture_version = size_t(-1);  ///< The block_version of palette_texture_buffer_id's contents.
+
+// with -palette-rate, the simulation is only asked for a new packet that
+// many times a second, however fast the display draws.  The dual
+// quaternion mode's programs are built with PALETTE_BLEND, and each frame
+// in between blends every joint from the previous packet's palette to the
+// latest one's on the GPU, over one period, so the motion stays smooth for
+// the cost of writing the block again.  The other modes just draw the
+// latest packet until the next one.
+double palette_rate = 0;                        ///< From -palette-rate; 0 asks for a packet every frame.
+double next_palette_milliseconds = 0;           ///< When the next request may be posted.
+size_t deferred_steps = 0;                      ///< Steps the clock has advanced by since the last request.
+bool palette_request_deferred = false;          ///< A request is waiting for next_palette_milliseconds.
+std::vector<DualQuat> previous_dq_palette;      ///< The palette the latest packet's is blended from.
+std::vector<float> previous_palette_scales;
+bool previous_palette_valid = false;            ///< The packet before the latest one was in the dual quaternion mode.
+double palette_arrival_milliseconds = 0;        ///< When the latest packet was acquired.
+float uploaded_palette_blend = -1;              ///< The palette_blend in the bound SkinningPalette block.
+
+// every thread's TRACE_SCOPE()s are streamed to a Chrome trace while the
+// writer is open, which is for the whole session with -trace.
+std::string trace_path;                         ///< Stream a trace to this file, if not empty.
+TraceWriter* trace_writer = nullptr;
+
+// what each frame did, for the overlay, and every STATS_LOG_INTERVAL frames
+// for the log with -stats.  GLUT thread.
+const size_t STATS_LOG_INTERVAL = 60;
+FrameStats last_frame_stats;                    ///< The last frame drawn's.
+std::string stats_path;                         ///< Log the stats to this file, if not empty.
+FrameStatsLog* stats_log = nullptr;
+
+// with -latency, each mouse event is timed through the frame which answers
+// it, to the GPU finishing that frame.  GLUT thread.
+bool latency_enabled = false;                   ///< From -latency.
+LatencyTracker* latency_tracker = nullptr;
+double pending_input_milliseconds = 0;          ///< When the oldest event no request has carried yet arrived, or 0.
+
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  Defines the pose of a skeletal system as an array of each of the
-///         joints that make it up.
-struct Pose
+/// \brief  A compiled skinning shader program.  Its SkinningPalette uniform
+///         block is always bound to SKINNING_PALETTE_BINDING.
+struct SkinningProgram
 {
-    JointPose joints[7];
+    GLuint id;
+    GLuint feedback_id;     ///< The same program, linked to capture its outputs into a SkinnedVertexCache.
+    GLuint wireframe_id;    ///< The same program, outlining its triangles for WIREFRAME_OVERLAY; 0 in the crowd modes.
+    GLuint motion_vector_id;    ///< The same program, drawing motion vectors; only in SKINNING_MODE_INSTANCED.
+    GLint baked_time_location;      ///< The location of the baked_time uniform, in SKINNING_MODE_BAKED.
+    SkinningPermutation permutation;    ///< What the program is built from, if it's used.
+    bool used;                          ///< The mesh has a partition which is drawn with the program.
 };
 
+const GLuint SKINNING_PALETTE_BINDING = 0;  ///< The uniform buffer binding point of the SkinningPalette block.
+UniformRingBuffer* skinning_palette_buffer; ///< Holds a copy of the SkinningPalette block for each frame in flight.
+
+/// One program per mode for each influence count; skinning_programs[mode][n - 1]
+/// evaluates n influences.  Only the influence counts used by the mesh
+/// are compiled.
+SkinningProgram skinning_programs[N_SKINNING_MODES][MAX_JOINT_INFLUENCES];
+SkinningProgramSet* skinning_program_set;   ///< Owns the programs in skinning_programs and lod_programs.
+
+const char* const SHADER_CACHE_DIRECTORY = "shader_cache";  ///< Where ProgramCache saves program binaries.
+ProgramCache* startup_program_cache;        ///< Building the programs initGL() requested, until it finishes them.
+
+// the skinning shaders are built from copies of their sources kept in
+// SHADER_SOURCE_DIRECTORY, which are rebuilt whenever they're edited.  The
+// mesh file is reloaded whenever it's rewritten, too; it's streamed into
+// streamed_mesh over a few frames, then copied over the mesh on the GPU.
+// So is the clip database, from which the crowd and current_pose play the
+// first clip.
+//
+// what the simulation thread reads of the reloaded assets is published
+// whole, and never changed in place; asset_epochs frees whatever was
+// replaced once the frame which might still be reading it has finished,
+// so neither thread waits on the other.
+const char* const SHADER_SOURCE_DIRECTORY = "shaders";
+const char* const SKINNING_VERTEX_SHADER_PATH = "shaders/skinning.vert";
+const char* const SKINNING_FRAGMENT_SHADER_PATH = "shaders/skinning.frag";
+const unsigned HOT_RELOAD_POLL_MILLISECONDS = 250;  ///< How often the render thread checks for reloaded files.
+std::string skinning_vertex_source;         ///< The source skinning_program_set was built from.
+std::string skinning_fragment_source;
+FileWatcher* file_watcher;                  ///< Reads the shader and mesh files when they change.
+ProgramCache* reload_cache;                 ///< Building reload_program_set, if not null.
+SkinningProgramSet* reload_program_set;     ///< The rebuilt skinning programs, swapped in once they're linked.
+bool skinning_sources_changed = false;      ///< The sources have changed since reload_program_set was requested.
+const GLsizeiptr MESH_UPLOAD_BYTES_PER_FRAME = 256 * 1024;  ///< The most of a reloaded mesh streamed per frame.
+MeshUploadQueue* mesh_upload_queue;         ///< Streams reloaded mesh files; null without a mesh file.
+MeshRegistry::Handle streamed_mesh_handle;
+SkeletalMesh* streamed_mesh;                ///< The reloaded mesh being streamed in; never drawn.
+bool mesh_streaming = false;                ///< streamed_mesh is waiting to be copied over the mesh.
+EpochReclaimer* asset_epochs;               ///< One reader per job_system thread; 0 is the simulation thread.
+PublishedAsset<CompressedClip> reloaded_clip;   ///< The clip database's first clip, as last reloaded; null until it is.
+const CompressedClip* sampled_clip;         ///< compressed_clip, or reloaded_clip's clip once the samplers play it.
+size_t sampled_clip_serial = 0;             ///< reloaded_clip's serial, as of when the samplers were last pointed at it.
+bool gpu_vertex_decode = false;             ///< From -gpu-decode.
+GLuint vertex_decode_program_id;            ///< Expands a quantized reloaded mesh's vertex blocks; 0 unless it's used.
+
+GLuint passthrough_program_id;              ///< Draws the vertices captured in skinned_vertex_cache.
+GLuint passthrough_wireframe_program_id;    ///< passthrough_program_id, outlining the triangles for WIREFRAME_OVERLAY.
+SkinnedVertexCache* skinned_vertex_cache;   ///< The mesh's vertices, skinned once per frame when pre_skinning is set.
+SkinningStream* skinning_stream;            ///< The mesh's positions and skinning data alone, for passes which don't shade.
+bool pre_skinning = false;                  ///< Skin with transform feedback first, then draw the cached results.
+
+const GLsizei SHADOW_MAP_RESOLUTION = 1024;     ///< The width and height of each cascade of shadow_pass.
+const size_t N_SHADOW_CASCADES = 3;
+const vec3 LIGHT_DIRECTION(0.3f, -0.5f, -1.0f); ///< The way the shadows' light shines, in world space.
+ShadowPass* shadow_pass;                    ///< The light's cascaded shadow map, drawn from the vertices the frame has skinned.
+GLuint shadow_program_id;                   ///< Draws skinned_vertex_cache's or cpu_skinner's vertices into shadow_pass.
+GLuint shadow_compute_program_id;           ///< Draws compute_skinner's vertices into shadow_pass; 0 without GL 4.3.
+bool draw_shadows = false;                  ///< Draw shadow_pass each frame; the vertex shader modes pre-skin for it.
+
+ThreadPool* thread_pool;                    ///< One thread per hardware thread, used by cpu_skinner.
+NumaTopology* numa_topology;                ///< The machine's NUMA nodes, which job_system's threads and the crowd are split across.
+JobSystem* job_system;                      ///< One thread per hardware thread, used by the simulation thread to pose the crowd.
+CpuSkinner* cpu_skinner;                    ///< Skins the mesh in SKINNING_MODE_CPU.
+CpuSkinner::VertexOrder cpu_vertex_order = CpuSkinner::VERTEX_ORDER_AUTHORED;  ///< From -cpu-order.
+SkinnedMeshPicker* mesh_picker;             ///< Hit-tests the mouse against the mesh with C; null if the mesh has no vertices on the CPU.
+
+MeshRegistry::Handle mesh_handle;
+SkeletalMesh* mesh;                     ///< mesh_handle's mesh.
+VertexColorCache* vertex_color_cache;   ///< Each vertex's blend of its joints' colors, for every level of detail.
+MorphTargetPass* morph_target_pass;     ///< Null without GL 4.3, or if the mesh has no morph targets.
+GLuint morph_target_program_id;
+std::vector<float> morph_weights;       ///< The weight of each of the mesh's morph targets, as B sets them.
+std::vector<MorphActivation> morph_activations; ///< GLUT thread: morph_weights' non-zero weights, then the packet's correctives.
+bool morph_targets_on = false;          ///< Apply every morph target B toggles at full weight.
+
+// the built-in mesh's red elbow has a corrective morph target for bending
+// each way, which pose_correctives ramps in as the forearm bends, to keep
+// the outside of the bend from thinning.  B only toggles the hands.
+const size_t N_HAND_MORPH_TARGETS = 2;          ///< The built-in mesh's targets before its correctives.
+const float ELBOW_CORRECTIVE_START = 10.0f;     ///< How far the forearm bends before a corrective comes in, in degrees.
+const float ELBOW_CORRECTIVE_FULL = 45.0f;      ///< How far it bends for the corrective's full weight.
+PoseSpaceCorrectives* pose_correctives = nullptr;   ///< Simulation thread: current_pose's correctives; null for a loaded mesh.
+std::string mesh_path;                  ///< A mesh file to load instead of the built-in mesh, if not empty.
+const GLuint BUILT_IN_MESH_INDEX_BASE = 1;  ///< The built-in mesh's indices and morph deltas count its vertices from 1, as in the OBJ it came from.
+size_t max_influences = MAX_JOINT_INFLUENCES;   ///< From -max-influences; the built-in mesh is limited to it.
+
+// the rig, clips, shader sources and mesh file need no context to be
+// read, so asset_loader reads them all at once while the window's GL is
+// set up.  The upload of the mesh is the only stage of the startup loads
+// which runs on the render thread, in initMeshes()'s wait.
+AssetLoader* asset_loader;
+AssetLoader::LoadId startup_poses_load;     ///< The rig, its poses and the clips; see initPoses().
+AssetLoader::LoadId startup_shaders_load;   ///< The skinning shaders' sources.
+AssetLoader::LoadId startup_mesh_load;      ///< mesh_path, read then uploaded; only submitted if it's set.
+MeshFileData startup_mesh_data;             ///< mesh_path's contents, between startup_mesh_load's stages.
+
+// the crowd is drawn at a level of detail chosen for each instance by its
+// size on screen.  Level 0 is mesh itself; each level after it merges the
+// skeleton's leaf joints once more, and has about half as many vertices.
+const size_t N_MESH_LODS = 2;                           ///< The most levels of detail, including the full mesh.
+const float LOD_MIN_PIXELS[N_MESH_LODS] = { 96, 0 };    ///< The smallest diameter on screen each level is used at.
+const float LOD_VERTEX_RATIO = 0.5f;                    ///< The fraction of the previous level's vertices each level aims for.
+const float LOD_MAX_ERROR = 0.005f;                     ///< The most area that any one edge collapse may change, in model space.
+size_t mesh_lod_count = 1;                  ///< The levels actually built; meshes loaded from files only have level 0.
+SkeletalMeshLod* mesh_lods[N_MESH_LODS];    ///< The reduced levels; mesh_lods[0] is always null.
+
+/// The bounds of the vertices each joint of each level of detail
+/// influences, in the joint's space, for culling the crowd.  They're
+/// published whole, so a reloaded mesh's can replace them while the
+/// simulation thread culls with the last ones.
+PublishedAsset<std::vector<BoundingBox> > lod_joint_bounds[N_MESH_LODS];
+
+/// The SKINNING_MODE_INSTANCED programs for each reduced level of detail,
+/// indexed like skinning_programs; level 0 uses skinning_programs itself.
+SkinningProgram lod_programs[N_MESH_LODS][MAX_JOINT_INFLUENCES];
+
+// variables relating to instanced rendering.
+const size_t INSTANCE_GRID_SIZE = 10;   ///< The crowd is drawn as a square grid of instances.
+const size_t N_INSTANCES = INSTANCE_GRID_SIZE * INSTANCE_GRID_SIZE;
+const float MESH_RADIUS = 1.2f;         ///< Contains the mesh in every pose; the arms reach about 1.15 from the root.
+
+PaletteRing* palette_ring;              ///< Each frame's instance palettes, and origins, in a region of their own.
+GLuint instance_palette_texture_id;     ///< The texture buffer sampled by the INSTANCED_PALETTE shader.
+GLuint palette_texture_buffer_id;       ///< The palette texture's storage.
+GLuint palette_texture_id;              ///< The texture buffer sampled by the TEXTURE_PALETTE shader.
+std::vector<vec4> palette_texels;       ///< Where uploadPaletteTexture() packs the palette texture's contents.
+PaletteStream* palette_stream;          ///< Lets the stage jobs write the instanced crowd's palettes straight into each packet's own buffer.
+std::vector<mat4> instance_transforms;  ///< The placement of each instance in the grid.
+
+// each instance is moved from its cell by the clip's root motion too.  The
+// camera and the instance's world transform are folded into its palette on
+// the CPU, so the instanced shaders only multiply each vertex by its
+// palette matrices.  The GPU culling reads the palettes' x and y axes as a
+// 2D transform, which only holds for an orthographic camera like the demo's.
+std::vector<mat4> instance_world_transforms;    ///< Simulation thread: each instance's placement this frame.
+
+// the baked crowd plays the clip straight out of a texture, so the CPU
+// doesn't animate it at all; each instance's placement and time offset are
+// uploaded once, into a texture buffer of their own.
+const float BAKED_FRAME_RATE = 30.0f;   ///< The fewest frames per second of the clip to bake.
+BakedAnimation* baked_clip;
+GLuint baked_instance_buffer_id;        ///< The texture buffer's storage.
+GLuint baked_instance_texture_id;       ///< The texture buffer sampled by the BAKED_PALETTE shader.
+
+ComputeSkinner* compute_skinner;        ///< Null if compute shaders aren't supported.
+GLuint compute_skinning_program_id;
+GLuint compute_draw_program_id;
+GLuint compute_draw_wireframe_program_id;
+
+// with -balance-skinning, the last of the compute crowd's visible instances
+// are skinned on the CPU instead, as many as keep the GPU and the CPU
+// equally busy while the job threads have time to spare.
+bool balance_skinning = false;                  ///< From -balance-skinning.
+SkinningBalancer* skinning_balancer = nullptr;  ///< Null unless balance_skinning, and compute_skinner has the mesh's vertices.
+double balance_busy_milliseconds = 0;           ///< job_system's busy time as the last frame started.
+double balance_frame_milliseconds = 0;          ///< When the last frame started.
+
+// with -gpu-hierarchy, the compute crowd sends only its leaders' compact
+// local transforms, and each visible instance's placement, instead of every
+// instance's palette; crowd_hierarchy_pass resolves the hierarchy, then the
+// palettes, on the GPU.
+bool gpu_hierarchy = false;                     ///< From -gpu-hierarchy, unless compute shaders aren't supported.
+HierarchyLevels* crowd_hierarchy_levels = nullptr;
+HierarchyComputePass* crowd_hierarchy_pass = nullptr;   ///< Null unless gpu_hierarchy.
+GLuint local_expand_program_id;
+GLuint crowd_hierarchy_program_id;
+GLuint palette_resolve_program_id;
+NumaPartitionedArray<vec4>* leader_compact_locals = nullptr;    ///< Each leader's compact local transforms, from its hierarchy job.
+std::vector<GLuint> crowd_leader_slots;         ///< Each leader's place in a packet's leader_locals, or NO_LEADER_SLOT.
+const GLuint NO_LEADER_SLOT = GLuint(-1);
+
+bool bake_pose_pending = false;         ///< Z was pressed, so the next frame's pose is baked into POSED_MESH_DIRECTORY.
+
+GLuint skinned_bounds_program_id;       ///< Reduces skinned_vertex_cache's or compute_skinner's vertices to their bounds.
+SkinnedBoundsPass* skinned_bounds_pass; ///< Null if compute shaders aren't supported.
+bool skinned_bounds_reduced = false;    ///< The last frame's skinned vertices went through skinned_bounds_pass.
+
+RenderQueue* render_queue;              ///< Batches the crowd's draws when indirect_draws is set.
+MeshArena* mesh_arena;                  ///< Holds a copy of the mesh for render_queue; null without GL 4.3.
+MeshArena::Allocation mesh_allocations[N_MESH_LODS];   ///< Where each level of detail of the mesh is in mesh_arena.
+
+// the levels of detail are evicted when the demo's GPU memory goes over its
+// budget, and uploaded again when they're next drawn.
+const GLsizeiptr GPU_MEMORY_BUDGET = 64 * 1024 * 1024;
+ResidencyManager* residency_manager;
+ResidencyManager::ResourceId lod_resources[N_MESH_LODS];    ///< The full mesh is a fixed resource; the others can be evicted.
+size_t lod_first_color_vertices[N_MESH_LODS];               ///< Where each level's colors are in vertex_color_cache.
+
+// the instanced crowd comes in N_CROWD_VARIANTS colorings, a stand-in for
+// outfits which share the mesh's topology and weights.  Variant 0 is drawn
+// with each level's own VAO and vertex_color_cache; the others each have a
+// MeshVariant per level, drawing the level's own vertex and index buffers
+// with a packed color cache of their own, so a variant costs a byte per
+// color channel per vertex rather than a copy of the mesh.
+const size_t N_CROWD_VARIANTS = 3;
+MeshVariant* crowd_variants[N_CROWD_VARIANTS - 1][N_MESH_LODS];  ///< Null past mesh_lod_count.
+VertexColorCache* crowd_variant_colors[N_CROWD_VARIANTS - 1];   ///< Laid out like vertex_color_cache.
+std::vector<color4> crowd_variant_joint_colors;                 ///< GLUT thread: a variant's joint colors.
+bool indirect_draws = false;            ///< Draw the instanced crowd with one indirect draw per visible instance.
+
+// with indirect_draws, the crowd can be culled on the GPU instead, and drawn
+// with one indirect draw per partition of each level of detail.
+InstanceCullPass* instance_cull_pass;   ///< Null without GL 4.3.
+GLuint instance_cull_program_id;
+bool gpu_culling = false;               ///< Cull the crowd with instance_cull_pass rather than cullInstances().
+
+// the instanced crowd's palettes can be uploaded as half floats, 24 bytes a
+// matrix rather than 64, plus a full float origin for each instance (see
+// packHalfPalette()).  The GPU culling reads the palettes in full, so they
+// stay in full while it's on, or whenever a frame's don't pass the guard.
+bool half_palettes = false;             ///< Upload the instanced crowd's palettes as half floats.
+GLuint instance_half_palette_texture_id;    ///< An RGBA16F view of palette_ring.
+GLuint instance_origin_texture_id;          ///< An RGBA32F view of palette_ring, sampled as instance_origins.
+
+// the instanced crowd can be drawn as its motion vectors, skinned from this
+// frame's palettes and from last frame's, which palette_ring still holds.
+// The palettes are laid out by level of detail and then by visible
+// instance, so last frame's only belong to the same instances if the same
+// instances were visible at the same levels; each frame's layout is kept
+// to check, and the previous palettes are only read when it matches.
+bool motion_vectors = false;            ///< Draw the instanced crowd's motion vectors rather than its colors.
+std::vector<GLuint> palette_layout;     ///< GLUT thread: the layout of the palettes in palette_ring's latest region.
+std::vector<GLuint> previous_palette_layout;    ///< GLUT thread: the layout of the region before it.
+
+// a region of palette_ring keeps what it was last written with, so when
+// it was written with this frame's layout, only the full palettes whose
+// instance's generation has moved on since are written into it again.  In
+// a crowd which is mostly standing still under a still camera, that's
+// only the instances which are moving.
+std::vector<std::vector<GLuint> > region_palette_layouts;       ///< GLUT thread: the layout each region of palette_ring was last written with; empty if unknown.
+std::vector<std::vector<GLuint> > region_palette_generations;   ///< GLUT thread: the generation of each instance's palette in each region.
+std::vector<std::pair<size_t, size_t> > palette_write_runs;     ///< GLUT thread: the runs of matrices writeInstancePalettes() writes, as offsets and counts.
+
+// with impostors on, and the clip stopped, the instanced crowd's instances
+// smaller on screen than IMPOSTOR_MAX_PIXELS aren't posed, built palettes
+// or skinned at all: each is drawn as a quad showing one of the frames of
+// impostor_atlas, all of them with one instanced draw.  The frames were
+// drawn once, at startup, through the offscreen framebuffer of the atlas.
+const size_t N_IMPOSTOR_FRAMES = 32;        ///< Frames of the crowd's bounce; see initImpostors().
+const GLsizei IMPOSTOR_CELL_SIZE = 64;      ///< The width and height of each frame in pixels.
+const float IMPOSTOR_MAX_PIXELS = 32;       ///< The largest diameter on screen an instance is drawn as an impostor at.
+bool impostors = false;                     ///< Draw the crowd's far instances as impostors.
+ImpostorAtlas* impostor_atlas;
+GLuint impostor_program_id;
+GLuint impostor_vao_id;                     ///< Has no attributes, but a core context can't draw without one.
+GLuint impostor_buffer_id;                  ///< The frame's impostors, as FramePacket::impostors lays them out.
+GLuint impostor_texture_id;                 ///< The texture buffer view of impostor_buffer_id.
+
+// with occlusion_culling, the bounds of each instance of the crowd in view
+// are drawn into an occlusion query after the frame, and instances the
+// latest results found hidden are left out of the next draw list.
+// Instances hidden for OCCLUSION_POSE_SKIP_COUNT queries in a row aren't
+// posed either.  Outside the crowd modes the mesh gets the last query, and
+// is drawn conditionally on it.  The scene draws no depth, so only the
+// proxies' own depth test can hide anything, but a scene with occluders
+// would draw them first.
+const size_t OCCLUSION_POSE_SKIP_COUNT = 4;
+bool occlusion_culling = false;             ///< Cull the crowd, and the mesh, with occlusion_queries.
+OcclusionQueries* occlusion_queries;        ///< One query per instance, then one for the mesh.
+GLuint occlusion_proxy_program_id;
+std::vector<GLuint> occlusion_hidden_counts(N_INSTANCES, 0);    ///< GLUT thread: each instance's hidden count, up to OCCLUSION_POSE_SKIP_COUNT.
+std::vector<InstanceCullPass::Candidate> cull_candidates;  ///< The GLUT thread's copy of the packet's draw list.
+std::vector<size_t> cull_palette_offsets;   ///< Where each level's palettes start in palette_ring, for the cull.
+
+DebugDraw* debug_draw;                  ///< Draws each packet's debug_geometry when draw_joints is set.
+bool draw_joints = true;
+
 ///////////////////////////////////////////////////////////////////////////////
-// Global Variables
+/// \brief  How the mesh's triangles are outlined; W cycles through them.
+enum WireframeMode
+{
+    WIREFRAME_OFF = 0,
+    WIREFRAME_OVERLAY,  ///< Outline the filled triangles in the same pass, with each program's wireframe twin.
+    WIREFRAME_LINES,    ///< Rasterize only the edges, with glPolygonMode(GL_LINE).
+    N_WIREFRAME_MODES
+};
+WireframeMode wireframe_mode = WIREFRAME_OFF;
+
+bool show_profiler = false;                 ///< Draw the timings below over the scene.
+TimingStats pose_stats("pose (cpu)");       ///< Evaluating the joint hierarchy, and the crowd's poses, on the simulation thread.
+TimingStats palette_stats("palette (cpu)"); ///< Building the skinning palette, on the simulation thread.
+TimingStats upload_stats("upload (cpu)");   ///< Uploading the palettes.
+GpuTimer* skinning_gpu_timer;               ///< Skinning and drawing the mesh.
+GpuTimer* debug_draw_gpu_timer;             ///< Drawing the joints.
+GpuTimer* compare_gpu_timer;                ///< Skinning and drawing the mesh's right half with compare_mode.
+
+// the scene can be drawn with multisampling, and at a lower resolution
+// which adapts to hold the GPU time per frame near a budget.  Both are set
+// from the command line, and can be changed with X and R.
+const double DEFAULT_GPU_BUDGET_MILLISECONDS = 8.0;
+RenderTarget* render_target;                ///< The scene is drawn into this, then resolved into the window.
+ResolutionController* resolution_controller;    ///< Chooses render_target's scale while adaptive_resolution is set.
+bool adaptive_resolution = false;
+GLsizei msaa_samples = 1;                   ///< From -msaa.
+double gpu_budget_milliseconds = 0;         ///< From -gpu-budget; 0 if it wasn't given.
+
+GLStateCache gl_state;                      ///< Skips display()'s redundant binds; forgotten after anything that binds for itself.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  What the passes of display()'s frame graph draw, and which of
+///         them there are; see buildFrameGraph().
+struct DisplayFrame
+{
+    const FramePacket* packet;
+    FrameStats* stats;
+    GLenum polygon_mode;            ///< The scene's.
+    bool wireframe_overlay;
+    bool half_palettes_drawn;       ///< The instanced crowd's palettes are read from half_palettes.
+    GLint palette_region_base;      ///< Where the frame's full palettes start in palette_ring, in matrices; 0 if they're streamed.
+    bool pre_skinned;               ///< The skinning pass skins the vertices before anything draws them.
+    bool shadows_drawn;
+    float palette_blend;            ///< How far the dual quaternions are blended from the last packet's.
+    double draw_start;              ///< When the frame started submitting draws, for the calibration.
+    size_t cpu_skinned_instances;   ///< How many of the compute crowd's visible instances are skinned on the CPU.
+    FrameGraph::ResourceId shadow_map;
+};
 
-#pragma region shader source code
-const std::string vertex_shader_source =
-    "#version 330"                                                          "\n"
-                                                                            "\n"
-    "uniform mat4 bind_pose_inv[7];"                                        "\n"
-    "uniform mat4 current_pose[7];"                                         "\n"
-    "uniform vec4 current_pose_colors[7];"                                  "\n"
-                                                                            "\n"
-    "layout(location = 0) in vec2 position;"                                "\n"
-    "layout(location = 1) in uint joint_0_index;"                           "\n"
-    "layout(location = 2) in uint joint_1_index;"                           "\n"
-    "layout(location = 3) in uint joint_2_index;"                           "\n"
-    "layout(location = 4) in float joint_0_weight;"                         "\n"
-    "layout(location = 5) in float joint_1_weight;"                         "\n"
-    "layout(location = 6) in float joint_2_weight;"                         "\n"
-                                                                            "\n"
-    "out vec4 color;"                                                       "\n"
-                                                                            "\n"
-    "void main()"                                                           "\n"
-    "{"                                                                     "\n"
-    "   vec4 vertex_coords = vec4(position, 0, 1);"                         "\n"
-    "   gl_Position = vec4(0,0,0,0);"                                       "\n"
-    "   color = vec4(0,0,0,0);"                                             "\n"
-                                                                            "\n"
-    "   // For each joint affecting this vertex, find the vertex's"         "\n"
-    "   // position relative to the joint in bind pose by using"            "\n"
-    "   // bind_pose_inv, then transform that position using the"           "\n"
-    "   // current pose transform to find the position where the"           "\n"
-    "   // vertex should be considering only that joint."                   "\n"
-    "   //"                                                                 "\n"
-    "   // Take the weighted average of the positions where each"           "\n"
-    "   // joint thinks the vertex should be, and that is the"              "\n"
-    "   // final vertex position."                                          "\n"
-                                                                            "\n"
-    "   // first joint affecting vertex"                                    "\n"
-    "   color += joint_0_weight * current_pose_colors[joint_0_index];"      "\n"
-    "   gl_Position += joint_0_weight * (current_pose[joint_0_index] *"     "\n"
-    "                                   bind_pose_inv[joint_0_index] *"     "\n"
-    "                                   vertex_coords);"                    "\n"
-                                                                            "\n"
-    "   // second joint affecting vertex"                                   "\n"
-    "   color += joint_1_weight * current_pose_colors[joint_1_index];"      "\n"
-    "   gl_Position += joint_1_weight * (current_pose[joint_1_index] *"     "\n"
-    "                                   bind_pose_inv[joint_1_index] *"     "\n"
-    "                                   vertex_coords);"                    "\n"
-                                                                            "\n"
-    "   // third joint affecting vertex"                                    "\n"
-    "   color += joint_2_weight * current_pose_colors[joint_2_index];"      "\n"
-    "   gl_Position += joint_2_weight * (current_pose[joint_2_index] *"     "\n"
-    "                                   bind_pose_inv[joint_2_index] *"     "\n"
-    "                                   vertex_coords);"                    "\n"
-    "}"                                                                     "\n";
-
-const std::string fragment_shader_source = 
-    "#version 330"                                                      "\n"
-                                                                        "\n"
-    "in vec4 color;"                                                    "\n"
-                                                                        "\n"
-    "layout(location = 0) out vec4 out_fragcolor;"                      "\n"
-                                                                        "\n"
-    "void main()"                                                       "\n"
-    "{"                                                                 "\n"
-    "   out_fragcolor = color;"                                         "\n"
-    "}"                                                                 "\n";
-#pragma endregion
+FrameGraph* frame_graph;                    ///< Orders display()'s passes, and holds their transient targets.
+FrameScheduler frame_scheduler;             ///< Coalesces redraw requests and paces the animation.
+bool frame_timer_pending = false;           ///< A frameTimer() callback is waiting to post the requested frame.
+bool vsync = false;                         ///< Buffer swaps wait for the vertical blank, which paces frames instead of frame_scheduler.
 
-glm::ivec2 viewport;        ///< The current size of the viewport in pixels.
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A way of skinning the mesh which startup calibration chooses
+///         between: a skinning mode, with or without pre-skinning.
+struct SkinningBackend
+{
+    const char* name;       ///< The name saved in the calibration file.
+    SkinningMode mode;
+    bool pre_skinning;
+};
+
+// the backends which skin the whole mesh once per frame, so their costs
+// are comparable; the other modes draw a crowd, or change the skinning
+// itself.  The fastest for the mesh's size is chosen at startup, and saved
+// so later runs can skip measuring it.
+const SkinningBackend SKINNING_BACKENDS[] =
+{
+    { "vertex_shader", SKINNING_MODE_PALETTE, false },
+    { "transform_feedback", SKINNING_MODE_PALETTE, true },
+    { "cpu", SKINNING_MODE_CPU, false }
+};
+const size_t N_SKINNING_BACKENDS = sizeof(SKINNING_BACKENDS) / sizeof(SKINNING_BACKENDS[0]);
+const char* const CALIBRATION_PATH = "calibration.txt";
+BackendCalibration* backend_calibration;
+BackendCalibrator* backend_calibrator;          ///< Times calibration_candidates while calibrating; otherwise null.
+std::vector<size_t> calibration_candidates;     ///< The SKINNING_BACKENDS available on this context.
+bool force_calibration = false;                 ///< From -calibrate.
+
+// the user's choices, which are passed on to the simulation with each request.
+SkinningMode skinning_mode = SKINNING_MODE_PALETTE;
+
+// with E, the mesh is drawn twice, skinned with skinning_mode on the left
+// half of the scene and compare_mode on the right, each half timed by its
+// own GPU timer.  Only the modes which skin the one mesh can be compared.
+SkinningMode compare_mode = N_SKINNING_MODES;   ///< N_SKINNING_MODES while there's no comparison.
+bool drawing_left_half = false;                 ///< display() is scissored to the comparison's left half.
+const char* const SKINNING_MODE_NAMES[N_SKINNING_MODES] =
+{
+    "separate", "palette", "dual quaternion", "2D affine", "instanced crowd", "compute crowd", "CPU", "baked crowd",
+    "texture palette"
+};
+float target_blend_factor = 0.0f;           ///< Where the mouse wants blend_factor to be.
+bool play_clip = false;                     ///< When set, the clip drives current_pose and the crowd instead of the mouse.
+bool ik_enabled = false;                    ///< When set, current_pose reaches for the mouse and keeps its feet above the floor.
+vec2 mouse_position(0, 0);                  ///< Where the mouse points at the z = 0 plane, in world space.
+bool ragdoll_enabled = false;               ///< When set, the physics thread runs, and current_pose follows its ragdoll.
+
+// Physics thread.  It only runs while the ragdoll is on, stepping ragdoll
+// at a fixed rate of its own, unrelated to the frame rate or the animation
+// steps, and publishing every step to physics_input, which the simulation
+// thread blends into current_pose.  The two never wait for each other.
+const float PHYSICS_STEP_SECONDS = 1.0f / 120.0f;
+std::thread physics_thread;
+std::atomic<bool> physics_running(false);   ///< Cleared to stop the physics thread.
+Ragdoll* ragdoll;                           ///< Hangs from the root of the bind pose.
+PhysicsPoseInput* physics_input;            ///< Written by the physics thread, read by the simulation thread.
+
+// Simulation thread.
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The demo's hierarchy, as SkeletonEval describes it: a root with
+///         three arms of two joints each.  Every instance shares it, so the
+///         crowd's hierarchy pass is compiled for it.
+struct DemoRig
+{
+    enum { JOINT_COUNT = 7 };
+    template <size_t JOINT> struct Parent;
+};
 
-GLuint shader_program_id = 0;
-GLint current_pose_uniform_location;
-GLint current_pose_colors_uniform_location;
+template <> struct DemoRig::Parent<0> { enum { VALUE = Skeleton::NO_PARENT }; };   // root
+template <> struct DemoRig::Parent<1> { enum { VALUE = 0 }; };
+template <> struct DemoRig::Parent<2> { enum { VALUE = 0 }; };
+template <> struct DemoRig::Parent<3> { enum { VALUE = 0 }; };
+template <> struct DemoRig::Parent<4> { enum { VALUE = 1 }; };
+template <> struct DemoRig::Parent<5> { enum { VALUE = 2 }; };
+template <> struct DemoRig::Parent<6> { enum { VALUE = 3 }; };
 
-SkeletalMesh* mesh;
+typedef SkeletonEval<DemoRig> DemoRigEval;
 
-bool draw_joints = true;
-bool wireframe = false;
+Skeleton skeleton;          ///< The joint hierarchy shared by all poses; built from DemoRig.
 
+/// Scratch which only lives while a frame is simulated, emptied as each one
+/// starts.  Nothing from it goes into a packet, so one frame's worth is kept.
+const size_t SIMULATION_ARENA_BYTES = 64 * 1024;
+FrameArena* simulation_arena;
 
-// variables relating to poses.
 const size_t N_POSES = 3;   ///< The number of different skeleton poses we have available.
 Pose poses[N_POSES];        ///< An array of skeleton poses.
 
+// with -rig, the skeleton and the poses come from a rig file instead, which
+// is written from the built-in rig first if the file doesn't exist yet.
+const char* const RIG_POSE_NAMES[N_POSES] = { "bind", "lowered", "raised" };    ///< poses' names in a rig file.
+std::string rig_path;       ///< From -rig.
+
 size_t left_pose = 2;       ///< The current pose
 size_t right_pose = 1;
 
 Pose current_pose;
+float blend_factor = 0.0f;  ///< How far current_pose is between left_pose and right_pose.
+
+// current_pose's IK chains, solved after blending when the request asks.
+// Joint 1's limb reaches for the mouse, and the two below are feet, kept
+// above the floor; one is solved analytically and one with FABRIK, to show
+// both.
+const vec2 LIMB_END_OFFSET(0.475503f, 0);   ///< The ends of the limbs, past joints 4, 5 and 6.
+const TwoBoneIkChain REACH_CHAIN = { 1, 4, LIMB_END_OFFSET, true };
+const TwoBoneIkChain RIGHT_FOOT_CHAIN = { 3, 6, LIMB_END_OFFSET, true };
+
+// props would be attached at the sockets on the ends of the limbs; the demo
+// just draws their axes along with the joints.
+const float SOCKET_AXIS_LENGTH = 0.1f;
+std::vector<mat4> socket_transforms;        ///< current_pose's sockets, in model space.  Simulation thread.
+bool socket_transforms_valid = false;       ///< socket_transforms matches current_pose_transforms.
+IkChain left_foot_chain;                    ///< Joints 2 and 5.
+const float IK_FLOOR_Y = -0.55f;            ///< The feet are kept above this, in model space.
+const size_t FABRIK_ITERATIONS = 8;         ///< A fixed budget, so the cost is the same every frame.
+
+// blend_factor eases toward the mouse position.  It's simulated in fixed
+// steps, and drawn interpolated between the last two.
+const float BLEND_RESPONSE_TIME = 0.08f;    ///< The time constant of the easing, in seconds.
+float simulated_blend_factor = 0.0f;        ///< blend_factor as of the latest step.
+float previous_blend_factor = 0.0f;         ///< blend_factor as of the step before.
+
+// clip playback.
+ClipRegistry clips;                         ///< Owns the clips.
+ClipRegistry::Handle clip_handle;
+AnimationClip* clip;                        ///< clip_handle's clip, which swings from left_pose to right_pose and back.
+const CompressedClip* compressed_clip;      ///< The compressed copy of clip which is actually played.
+
+// with -clips, the played clip comes from a clip database instead, which is
+// written from clip first if the file doesn't exist yet.
+std::string clip_database_path;             ///< From -clips.
+ClipDatabase* clip_database;                ///< Null unless clip_database_path is set; owns compressed_clip if not.
+CompressedClipSampler* clip_sampler;        ///< Samples compressed_clip into current_pose.
+std::vector<CompressedClipSampler> instance_samplers;   ///< One per instance of the crowd, since each plays at its own offset.
+
+// the clip's events, at each end of its swing, are pushed by the simulation
+// thread for whatever's playing it, and drained by the main thread.  The
+// demo has no gameplay to hand them to, so it only counts them.
+enum ClipEvent { CLIP_EVENT_LEFT = 0, CLIP_EVENT_RIGHT, N_CLIP_EVENTS };
+const GLuint CURRENT_POSE_INSTANCE = GLuint(N_INSTANCES);  ///< The instance current_pose's events are from.
+const size_t ANIMATION_EVENT_CAPACITY = 4096;
+AnimationEventQueue* animation_events;
+std::vector<AnimationEventCursor> instance_event_cursors;  ///< Each instance's place in the clip's events, in its own time.
+bool clip_events_playing = false;           ///< Events were emitted in the last frame simulated.
+bool clip_events_from_crowd = false;        ///< ... and by the crowd, rather than current_pose.
+size_t clip_event_counts[N_CLIP_EVENTS];    ///< How many of each event the main thread has drained.
+
+// the crowd's poses are blended by a graph, evaluated for every instance in
+// parallel: a lerp between two inputs, with an additive wave layered over
+// just the red arm.  The wave is poses[2]'s difference from the bind pose,
+// taken once, so layering it is one multiply-add per channel.
+enum CrowdInput { CROWD_INPUT_FROM = 0, CROWD_INPUT_TO, CROWD_INPUT_WAVE };
+enum CrowdParameter { CROWD_PARAMETER_BLEND = 0, CROWD_PARAMETER_WAVE };
+BlendGraph* crowd_graph;
+Pose crowd_wave_delta;                          ///< poses[2] less poses[0], for the wave layer.
+std::vector<BlendGraphContext*> crowd_contexts; ///< One per instance.
+std::vector<PosePool*> crowd_pose_pools;        ///< One per NUMA node, for its partition of the crowd's poses.
+std::vector<Pose> crowd_thread_poses;           ///< Each of job_system's threads' clip sample, then its scratch poses for crowd_graph.
+size_t crowd_thread_pose_count;                 ///< The number of crowd_thread_poses each thread has.
+std::vector<Pose> crowd_previous_poses;         ///< Each instance's blended pose from the evaluation before last.
+std::vector<Pose> crowd_evaluated_poses;        ///< Each instance's blended pose from the last evaluation.
+std::vector<Pose> crowd_poses;                  ///< Each instance's pose as drawn, when it's between evaluations below full detail, or with gpu_hierarchy.
+
+// distant instances are animated more cheaply: see AnimationLodScheduler.
+// They're evaluated every 4th frame and interpolated in between, and their
+// phase offsets are rounded to N_SHARE_GROUPS steps, so that the instances
+// which round to the same step can all be drawn with one of their palettes.
+//
+// Every level shares whatever instances are animated identically, though:
+// each frame, the instances are grouped by their AnimationStateKey, the
+// clip time and blend weights rounded to STATE_STEPS steps, and only one
+// instance in each group is posed.  At the full level of detail the groups
+// change from frame to frame, which costs nothing since it's evaluated
+// every frame anyway; at the reduced level they're the share groups.
+const AnimationLodLevel ANIMATION_LOD_LEVELS[N_MESH_LODS] = { { 1, true }, { 4, true } };
+const size_t N_SHARE_GROUPS = 16;
+const float STATE_STEPS = 4096.0f;              ///< Steps per second of clip time, and per unit of weight.
+AnimationLodScheduler* crowd_animation_lod;
+std::vector<size_t> instance_share_groups;      ///< Each instance's phase offset, rounded to one of N_SHARE_GROUPS steps.
+AnimationStateCache* crowd_state_cache;
+std::vector<size_t> crowd_states;               ///< Each instance's state in crowd_state_cache, this frame.
+NumaPartitionedArray<mat4>* leader_palettes;    ///< Each leader's palette, before it's placed in the grid.
+std::vector<JobSystem::JobId> crowd_stage_jobs; ///< The last job building or placing each leader's palette, which the next placement waits for.
+std::vector<mat4> staged_palettes;              ///< Each instance's palette as last staged, camera and all, at the skeleton's joint count apart.
+std::vector<GLuint> staged_palette_lods;        ///< The level of detail each was staged at.
+std::vector<GLuint> staged_palette_generations; ///< Moves on for an instance whenever its staged palette differs from the last.
+std::vector<unsigned char> crowd_leaders_needed;///< Each leader leads an instance which hasn't been hidden for long.
+bool crowd_posed = false;                       ///< The crowd was posed in the last frame simulated.
+
+// the ends of the crowd's limbs swing a little behind their poses: each
+// full-detail leader's limbs are jiggle joints, which are stepped for the
+// whole crowd at once between the hierarchy and palette jobs.  Instances
+// drawn at a lower level of detail are posed without them.
+const float JIGGLE_STIFFNESS = 150.0f;          ///< How hard the limbs are pulled back to their poses, per second squared.
+const float JIGGLE_DAMPING = 6.0f;              ///< How quickly the limbs' swinging dies away, per second.
+JiggleChains* crowd_jiggle;                     ///< The limbs of every instance posed at full detail.
+float crowd_jiggle_interpolation = 0.0f;        ///< The request's interpolation, as of the last frame crowd_jiggle was stepped.
+
+// with -fold-static-joints, the full-detail leaders which aren't blending
+// between evaluations are posed through a plan of which channels the
+// crowd's poses and clip ever move, so the joints which never do are
+// copied rather than evaluated.
+bool fold_static_joints = false;                ///< From -fold-static-joints.
+JointChannelPlan* crowd_channel_plan;           ///< Null unless fold_static_joints is set.
+float crowd_blend_factor = 0.0f;                ///< blend_factor, as of the last frame the crowd was posed in.
+bool crowd_clip_playing = false;                ///< clip_playing, as of the last frame the crowd was posed in.
+size_t crowd_quiet_frames = 0;                  ///< The number of frames since the crowd's inputs last changed.
+bool clip_playing = false;                  ///< play_clip, as of the request being simulated.
+float clip_time = 0.0f;                     ///< The clip's playback time as of the latest step, in seconds.
+float previous_clip_time = 0.0f;            ///< The clip's playback time as of the step before.
+float posed_clip_time = 0.0f;               ///< The clip time being posed this frame, between the last two steps.
+JointTransformCache* current_pose_transforms;   ///< current_pose's local-to-model joint transforms, updated only where it changes.
+NumaPartitionedArray<mat4>* instance_joint_transforms; ///< Each instance's joint transforms, between its hierarchy and palette jobs.
+std::vector<mat4> skinning_palette;         ///< current_pose_transforms * the skeleton's inverse bind transforms, used in SKINNING_MODE_PALETTE.
+std::vector<DualQuat> dual_quat_palette;    ///< skinning_palette as dual quaternions, used in SKINNING_MODE_DUAL_QUAT.
+std::vector<float> palette_scales;          ///< The uniform scale of each joint in dual_quat_palette.
+std::vector<Affine2D> affine_palette;       ///< current_pose_transforms' affines * the inverse bind affines, used in SKINNING_MODE_AFFINE_2D.
+
+// the palettes are only rebuilt for the joints that moved, so they remember
+// whether they've kept up with current_pose_transforms.
+bool skinning_palette_valid = false;        ///< skinning_palette matches current_pose_transforms.
+bool dual_quat_palette_valid = false;       ///< dual_quat_palette matches skinning_palette.
+bool affine_palette_valid = false;          ///< affine_palette matches current_pose_transforms.
+SkinningMode block_mode = N_SKINNING_MODES; ///< The mode of the last packet.
+size_t block_version = 0;                   ///< Incremented whenever the SkinningPalette block's contents change.
+
+// in the modes which draw with skinning_palette, current_pose's recent
+// evaluations are kept, for whenever the blend or the clip comes back to a
+// state it was in, as it does while the mouse scrubs back and forth.
+const size_t PALETTE_CACHE_CAPACITY = 256;
+PaletteCache* palette_cache;
+AnimationStateKey drawn_pose_key;           ///< The state the last packet's palette was posed in, if drawn_pose_keyed.
+bool drawn_pose_keyed = false;              ///< The last packet's palette was posed from a state's rounded values.
+
+// with -instant-replay, every frame of current_pose is kept compressed, to
+// play the last few seconds back again with Y.  The palette cache skips
+// posing current_pose, so it isn't used while they're recorded.
+const size_t INSTANT_REPLAY_BYTES = 256 * 1024;
+const size_t INSTANT_REPLAY_KEYFRAME_INTERVAL = 30;
+bool instant_replay_enabled = false;        ///< From -instant-replay.
+bool instant_replay = false;                ///< Y is playing instant_replay_buffer back; GLUT thread.
+PoseReplayBuffer* instant_replay_buffer;    ///< Null unless instant_replay_enabled is set; simulation thread.
+size_t instant_replay_frame = size_t(-1);   ///< The frame being played back, or size_t(-1) when not playing.
+
+// with -deterministic, current_pose's palettes are evaluated in fixed point
+// in the modes which are drawn from skinning_palette or affine_palette, so
+// they're the same to the bit on every machine, as lockstep peers need.
+bool deterministic_poses = false;           ///< From -deterministic.
+FixedPoseEvaluator* fixed_pose_evaluator;   ///< Null unless deterministic_poses is set.
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  Generates and returns a matrix which transforms coordinates from
-///         a joint's local coordinate space to the joint's parent's coordinate
-///         space.
-///
-/// \param  joint_pose The joint to generate the transform for.
-/// \return The joint's local-to-parent transformation matrix.
-mat4 getJointLocalTransform(const JointPose& joint_pose)
-{
-    mat4 transform;
-
-    transform = glm::translate(transform, vec3(joint_pose.translation, 0));
-
-    if (joint_pose.rotation != 0.0f)
-        transform = glm::rotate(transform, joint_pose.rotation, vec3(0, 0, 1));
-
-    if (joint_pose.scale != 1.0f)
-        transform = glm::scale(transform, vec3(joint_pose.scale,
-                                               joint_pose.scale,
-                                               joint_pose.scale));
-
-    return transform;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-/// \brief  Generates and returns a matrix which transforms coordinates from
-///         a joint's local coordinate space to model space.
-///
-/// \param  joint_pose The joint to generate the transform for.
-/// \return The joint's local-to-model transformation matrix.
-mat4 getJointTransform(const JointPose& joint_pose)
-{
-    // if this joint has a parent, then lets start in it's
-    // coordinate space, otherwise start with an identity matrix.
-    if (joint_pose.parent != nullptr)
-        return getJointTransform(*joint_pose.parent) * getJointLocalTransform(joint_pose);
-
-    return getJointLocalTransform(joint_pose);
-}
-
-///////////////////////////////////////////////////////////////////////////////
-/// \brief  Demo entry point.  Initializes the demo, then enters the GLUT
-///         main loop.
+/// \brief  Demo entry point.  Initializes the demo, then runs the render
+///         loop until the window is closed or Esc is pressed.
 ///
 /// \param  argc The number of command line arguments.
 /// \param  argv An array of c-strings representing the command line arguments.
 /// \return A status code indicating the program completed successfully.
 int main(int argc, char** argv)
 {
-    // freeglut initialization
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE);
-    glutInitWindowPosition(100, 100);
-    glutInitWindowSize(800, 800);
-    glutCreateWindow("Skeletal Mesh Skinning Demo");
+    // the platform has to be chosen before anything else reads the command
+    // line, since GLUT takes its own arguments out of it.
+    PlatformType platform_type = PLATFORM_GLUT;
+    if (!findPlatformOption(argc, argv, platform_type))
+        return 1;
+    platform = createPlatform(platform_type, argc, argv);
+    if (platform == nullptr)
+        return 1;
+
+    WindowDesc window_desc;
+    window_desc.title = "Skeletal Mesh Skinning Demo";
+    window_desc.x = 100;
+    window_desc.y = 100;
+    window = platform->createWindow(window_desc);
+    if (window == nullptr)
+    {
+        delete platform;
+        return 1;
+    }
+    render_loop = new RenderLoop(*platform);
 
-    // GLEW initialization
-    GLenum err = glewInit();
-    if (err != GLEW_OK)
+    // anything that isn't an option is the mesh file.
+    for (int i = 1; i < argc; ++i)
     {
-        std::cerr << "Error intitializing GLEW!" << std::endl;
-        return 0;
+        std::string arg = argv[i];
+        if (arg == "-platform" && i + 1 < argc)
+            ++i;
+        else if (arg == "-record" && i + 1 < argc)
+            record_path = argv[++i];
+        else if (arg == "-replay" && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (arg == "-msaa" && i + 1 < argc)
+            msaa_samples = GLsizei(std::atoi(argv[++i]));
+        else if (arg == "-gpu-budget" && i + 1 < argc)
+            gpu_budget_milliseconds = std::atof(argv[++i]);
+        else if (arg == "-calibrate")
+            force_calibration = true;
+        else if (arg == "-trace" && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (arg == "-stats" && i + 1 < argc)
+            stats_path = argv[++i];
+        else if (arg == "-deterministic")
+            deterministic_poses = true;
+        else if (arg == "-clips" && i + 1 < argc)
+            clip_database_path = argv[++i];
+        else if (arg == "-max-influences" && i + 1 < argc)
+            max_influences = size_t(std::atoi(argv[++i]));
+        else if (arg == "-rig" && i + 1 < argc)
+            rig_path = argv[++i];
+        else if (arg == "-gpu-decode")
+            gpu_vertex_decode = true;
+        else if (arg == "-palette-rate" && i + 1 < argc)
+            palette_rate = std::max(std::atof(argv[++i]), 0.0);
+        else if (arg == "-instant-replay")
+            instant_replay_enabled = true;
+        else if (arg == "-fold-static-joints")
+            fold_static_joints = true;
+        else if (arg == "-latency")
+            latency_enabled = true;
+        else if (arg == "-balance-skinning")
+            balance_skinning = true;
+        else if (arg == "-gpu-hierarchy")
+            gpu_hierarchy = true;
+        else if (arg == "-cpu-order" && i + 1 < argc)
+            cpu_vertex_order = std::string(argv[++i]) == "joint-clustered" ? CpuSkinner::VERTEX_ORDER_JOINT_CLUSTERED
+                                                                           : CpuSkinner::VERTEX_ORDER_AUTHORED;
+        else
+            mesh_path = arg;
     }
 
-    initPoses();
+    TRACE_THREAD("render");
+    if (!trace_path.empty())
+        trace_writer = new TraceWriter(trace_path);
+    if (!stats_path.empty())
+        stats_log = new FrameStatsLog(stats_path, STATS_LOG_INTERVAL);
+
+    // the assets are read, and the poses set up, while the context is
+    // created.
+    numa_topology = new NumaTopology();
+    asset_loader = new AssetLoader();
+    startStartupLoads();
+
+    if (!platform->initGlew())
+    {
+        // which lets the stages already running finish first.
+        delete asset_loader;
+        delete render_loop;
+        delete platform;
+        return 1;
+    }
+    asset_loader->wait(startup_poses_load);
+
     initGL();
-   
-    glutReshapeFunc(reshape);
-    glutDisplayFunc(display);
-    glutKeyboardFunc(keyboard);
-    glutPassiveMotionFunc(mouseMove);
-    glutMotionFunc(mouseMove);
-   
-    glutMainLoop();
+    if (!record_path.empty())
+        session_recorder = new SessionRecorder(record_path, REQUEST_WORDS, skeleton.getJointCount());
+    if (!replay_path.empty())
+        session_player = new SessionPlayer(replay_path, REQUEST_WORDS, skeleton.getJointCount());
+    simulation_thread = std::thread(simulationMain);
+    startHotReload();
+
+    // a replay must draw with the modes it was recorded with.
+    if (session_player == nullptr)
+        startCalibration(force_calibration);
+
+    // let the display pace the frames if it can; otherwise the scheduler
+    // caps them at one per animation step.  A replay runs flat out.
+    if (session_player != nullptr)
+    {
+        vsync = false;
+        window->setSwapInterval(0);
+        frame_scheduler.setMinFrameInterval(0);
+    }
+    else
+    {
+        vsync = window->setSwapInterval(1);
+        frame_scheduler.setMinFrameInterval(vsync ? 0 : frame_scheduler.getStepSeconds() * 1000.0);
+    }
 
-    cleanup();
+    WindowCallbacks callbacks;
+    callbacks.reshape = reshape;
+    callbacks.display = display;
+    callbacks.keyboard = keyboard;
+    callbacks.mouse_move = mouseMove;
+    callbacks.close = windowClosed;
+    window->setCallbacks(callbacks);
+
+    render_loop->run();
+
+    // closing the window has already cleaned up, while it still had its
+    // context.
+    if (window->isOpen())
+        cleanup();
+    delete render_loop;
+    delete platform;
     return 0;
 }
 
@@ -234,13 +1121,6 @@ int main(int argc, char** argv)
 ///         and mesh.
 void initGL()
 {
-    // make projection and modelview matrices the identity matrix
-    // for drawing in immediate mode ( glBegin() / glEnd() )
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
     glClearColor(0, 0, 0, 0);
 
     glPointSize(10);
@@ -250,115 +1130,912 @@ void initGL()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_BLEND);
 
-    initShaderProgram();
+    // the mesh's levels of detail are built on job_system's threads.
+    // cpu_skinner and the crowd's jobs are never busy in the same frame, so
+    // their threads take turns rather than competing for the cores.
+    job_system = new JobSystem(0, 4096, numa_topology);
+    asset_epochs = new EpochReclaimer(job_system->getThreadCount());
     initMeshes();
 
-    GLint bind_pose_inv_uniform_location = glGetUniformLocation(shader_program_id, "bind_pose_inv");
-    current_pose_uniform_location        = glGetUniformLocation(shader_program_id, "current_pose");
-    current_pose_colors_uniform_location = glGetUniformLocation(shader_program_id, "current_pose_colors");
+    // the driver builds the programs while the rest of the GL objects are
+    // created and uploaded; nothing checks them until they're needed.
+    requestShaderPrograms();
+
+    skinned_vertex_cache = new SkinnedVertexCache(*mesh);
+    skinning_stream = new SkinningStream(*mesh);
+    std::cerr << "Skinning stream: " << getSkinningVertexSize(mesh->vertex_format) << " of "
+              << getVertexSize(mesh->vertex_format) << " bytes per vertex." << std::endl;
+    shadow_pass = new ShadowPass(SHADOW_MAP_RESOLUTION, N_SHADOW_CASCADES);
+    frame_graph = new FrameGraph();
+    occlusion_queries = new OcclusionQueries(N_INSTANCES + 1);
+
+    thread_pool = new ThreadPool();
+    cpu_skinner = new CpuSkinner(*mesh, *thread_pool, cpu_vertex_order);
+    if (!mesh->vertices.empty())
+        mesh_picker = new SkinnedMeshPicker(mesh->vertices, mesh->indices, skeleton.getJointCount());
+
+    if (compute_skinning_program_id != 0)
+        compute_skinner = new ComputeSkinner(*mesh, skeleton.getJointCount(), N_INSTANCES);
+    if (balance_skinning)
+        initSkinningBalancer();
+    if (gpu_hierarchy)
+        initGpuHierarchy();
+    if (skinned_bounds_program_id != 0)
+        skinned_bounds_pass = new SkinnedBoundsPass();
+
+    // the instanced programs read each instance's palette index from an
+    // attribute, so the mesh's VAO needs it even without indirect draws.
+    render_queue = new RenderQueue(N_INSTANCES);
+    for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        render_queue->attachPaletteIndices(getLodMesh(lod).vao_id);
+
+    debug_draw = new DebugDraw();
+
+    skinning_gpu_timer = new GpuTimer("skinning (gpu)");
+    debug_draw_gpu_timer = new GpuTimer("debug draw (gpu)");
+    compare_gpu_timer = new GpuTimer("compare (gpu)");
+    if (latency_enabled)
+        latency_tracker = new LatencyTracker();
+
+    render_target = new RenderTarget();
+    render_target->setWindowSize(window->getWidth(), window->getHeight());
+    render_target->setSamples(msaa_samples);
+    adaptive_resolution = gpu_budget_milliseconds > 0;
+    resolution_controller = new ResolutionController(adaptive_resolution ? gpu_budget_milliseconds
+                                                                          : DEFAULT_GPU_BUDGET_MILLISECONDS);
+
+    // multi-draw-indirect with base instances needs GL 4.3.
+    if (GLEW_VERSION_4_3)
+    {
+        // every level of detail goes in the arena, so the whole crowd can
+        // still be drawn from one VAO.
+        size_t vertex_count = 0;
+        size_t index_bytes = 0;
+        for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        {
+            const SkeletalMesh& lod_mesh = getLodMesh(lod);
+            vertex_count += lod_mesh.getVertexCount();
+            index_bytes += (lod_mesh.getIndexCount() * lod_mesh.getIndexSize() + 3) & ~size_t(3);
+        }
+
+        mesh_arena = new MeshArena(vertex_count, index_bytes);
+        for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        {
+            if (!mesh_arena->add(getLodMesh(lod), mesh_allocations[lod]))
+                throw std::runtime_error("The mesh doesn't fit in its MeshArena.");
+        }
+        render_queue->attachPaletteIndices(mesh_arena->getVertexArray(mesh->vertex_format));
+
+        if (instance_cull_program_id != 0)
+            createInstanceCullPass();
+    }
+
+    // the skinning shaders read each vertex's color rather than blending it.
+    // The levels of detail go in the same places as in the arena, if there
+    // is one, so its VAO can read the colors too.
+    size_t color_vertex_count = 0;
+    for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        color_vertex_count += getLodMesh(lod).getVertexCount();
+
+    vertex_color_cache = new VertexColorCache(color_vertex_count);
+    size_t first_color_vertex = 0;
+    for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+    {
+        const SkeletalMesh& lod_mesh = getLodMesh(lod);
+        if (mesh_arena != nullptr)
+            first_color_vertex = mesh_allocations[lod].first_vertex;
+
+        vertex_color_cache->addMesh(lod_mesh, first_color_vertex, lod == 0 ? NULL : &mesh_lods[lod]->skeleton.source_joints);
+        vertex_color_cache->attach(lod_mesh.vao_id, first_color_vertex);
+        lod_first_color_vertices[lod] = first_color_vertex;
+        first_color_vertex += lod_mesh.getVertexCount();
+    }
+    if (mesh_arena != nullptr)
+        vertex_color_cache->attach(mesh_arena->getVertexArray(mesh->vertex_format), 0);
+
+    // the morph target offsets are laid out the same way.  Only the full
+    // mesh has morph targets; the levels of detail don't read them.
+    if (morph_target_program_id != 0)
+    {
+        size_t first_vertex = mesh_arena != nullptr ? mesh_allocations[0].first_vertex : 0;
+        morph_target_pass = new MorphTargetPass(*mesh, color_vertex_count, first_vertex);
+        morph_target_pass->attach(mesh->vao_id, first_vertex);
+        if (mesh_arena != nullptr)
+            morph_target_pass->attach(mesh_arena->getVertexArray(mesh->vertex_format), 0);
+        morph_weights.assign(mesh->getMorphTargetCount(), 0.0f);
+    }
+
+    // the crowd's other variants draw each level's own buffers, with colors
+    // blended from the same influences into caches laid out the same way.
+    size_t mesh_bytes = 0;
+    for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        mesh_bytes += size_t(getLodMesh(lod).getBufferBytes());
+    for (size_t v = 0; v < N_CROWD_VARIANTS - 1; ++v)
+    {
+        crowd_variant_colors[v] = new VertexColorCache(color_vertex_count, true);
+        for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        {
+            const SkeletalMesh& lod_mesh = getLodMesh(lod);
+            MeshVariant* variant = new MeshVariant(lod_mesh);
+            crowd_variants[v][lod] = variant;
+
+            crowd_variant_colors[v]->addMesh(lod_mesh, lod_first_color_vertices[lod],
+                                             lod == 0 ? NULL : &mesh_lods[lod]->skeleton.source_joints);
+            crowd_variant_colors[v]->attach(variant->getVertexArray(), lod_first_color_vertices[lod]);
+            render_queue->attachPaletteIndices(variant->getVertexArray());
+            if (lod == 0 && morph_target_pass != nullptr)
+                morph_target_pass->attach(variant->getVertexArray(), lod_first_color_vertices[0]);
+        }
+    }
+    std::cerr << "Crowd variants: " << N_CROWD_VARIANTS << ", "
+              << crowd_variant_colors[0]->getBufferBytes() << " bytes of colors each rather than "
+              << mesh_bytes << " bytes of mesh" << std::endl;
+
+    GLsizei joint_count = GLsizei(skeleton.getJointCount());
+    skinning_palette.resize(joint_count);
+    dual_quat_palette.resize(joint_count);
+    palette_scales.resize((joint_count + 3) & ~3, 1.0f);   // padded to a whole number of vec4s
+    affine_palette.resize(joint_count);
+
+    // the largest layout of the SkinningPalette block is the one with three
+    // affine rows per joint, followed by the colors, unless the dual
+    // quaternions are blended: then there are two palettes and two sets of
+    // scales, and palette_blend.
+    size_t block_bytes = (3 * sizeof(vec4) + sizeof(color4)) * joint_count;
+    if (palette_rate > 0)
+        block_bytes = std::max(block_bytes, (2 * sizeof(DualQuat) + sizeof(color4)) * joint_count +
+                                            2 * palette_scales.size() * sizeof(float) + sizeof(vec4));
+    skinning_palette_buffer = new UniformRingBuffer(block_bytes);
+    camera_buffer = new UniformRingBuffer(sizeof(CameraBlock));
+
+    // every instance's palette is read from an RGBA32F texture buffer, which
+    // views a frame's region of the ring.  A region holds either the full
+    // palettes, or the half float ones and their origins.
+    size_t half_palette_bytes = N_INSTANCES * joint_count * 3 * sizeof(glm::hvec4);
+    half_palette_bytes = (half_palette_bytes + sizeof(vec4) - 1) / sizeof(vec4) * sizeof(vec4);
+    palette_ring = new PaletteRing(GLsizeiptr(std::max(N_INSTANCES * joint_count * sizeof(mat4),
+                                                       half_palette_bytes + N_INSTANCES * sizeof(vec4))));
+    region_palette_layouts.assign(palette_ring->getRegionCount(), std::vector<GLuint>());
+    region_palette_generations.assign(palette_ring->getRegionCount(), std::vector<GLuint>(N_INSTANCES, 0));
+
+    glGenTextures(1, &instance_palette_texture_id);
+    glBindTexture(GL_TEXTURE_BUFFER, instance_palette_texture_id);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette_ring->getBufferId());
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // SKINNING_MODE_TEXTURE_PALETTE reads the one mesh's palette, and its
+    // colors, from a texture buffer of their own, instead of the block.
+    glGenBuffers(1, &palette_texture_buffer_id);
+    glBindBuffer(GL_TEXTURE_BUFFER, palette_texture_buffer_id);
+    glBufferData(GL_TEXTURE_BUFFER, 4 * joint_count * sizeof(vec4), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &palette_texture_id);
+    glBindTexture(GL_TEXTURE_BUFFER, palette_texture_id);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette_texture_buffer_id);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // or they can be packed into half floats, in RGBA16F, beside an RGBA32F
+    // origin for each instance; both are views of the same ring.
+    glGenTextures(1, &instance_half_palette_texture_id);
+    glBindTexture(GL_TEXTURE_BUFFER, instance_half_palette_texture_id);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA16F, palette_ring->getBufferId());
+    glGenTextures(1, &instance_origin_texture_id);
+    glBindTexture(GL_TEXTURE_BUFFER, instance_origin_texture_id);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette_ring->getBufferId());
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // the instanced crowd's palettes skip palette_ring
+    // altogether, and go straight into the packet's own buffer instead.
+    palette_stream = new PaletteStream(N_INSTANCES * joint_count);
+    for (size_t i = 0; i < FramePacketBuffer::N_PACKETS; ++i)
+        palette_stream->attach(frame_packets.getPacket(i));
+
+    float cell_size = 2.0f / INSTANCE_GRID_SIZE;
+    instance_transforms.resize(N_INSTANCES);
+    instance_world_transforms.resize(N_INSTANCES);
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+    {
+        vec2 cell(float(instance % INSTANCE_GRID_SIZE), float(instance / INSTANCE_GRID_SIZE));
+        vec2 center = (cell + 0.5f) * cell_size - 1.0f;
+        instance_transforms[instance] = glm::scale(glm::translate(mat4(), vec3(center, 0)),
+                                                   vec3(cell_size * 0.45f));
+    }
+    for (size_t lod = 1; lod < mesh_lod_count; ++lod)
+        mesh_lods[lod]->setBindPose(skeleton.getInverseBindTransforms());
+
+    // the simulation thread isn't running yet, so the clip can be baked
+    // here.  Each instance of the baked crowd gets the same offset into the
+    // clip as the instanced crowd's instances at full detail.  The clip's
+    // root motion has already been extracted, and the placements are only
+    // uploaded once, so the baked crowd plays the clip in place.
+    baked_clip = new BakedAnimation(*clip, skeleton, poses[0], skeleton.getInverseBindTransforms(), BAKED_FRAME_RATE,
+                                    true);
+
+    std::vector<vec4> baked_instances;
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+    {
+        const mat4& transform = instance_transforms[instance];
+        baked_instances.push_back(transform[0]);
+        baked_instances.push_back(transform[1]);
+        baked_instances.push_back(transform[3]);
+        baked_instances.push_back(vec4(getCrowdPhaseOffset(instance, 0) * baked_clip->getDuration(), 0, 0, 0));
+    }
+
+    glGenBuffers(1, &baked_instance_buffer_id);
+    glBindBuffer(GL_TEXTURE_BUFFER, baked_instance_buffer_id);
+    glBufferData(GL_TEXTURE_BUFFER, baked_instances.size() * sizeof(vec4), baked_instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &baked_instance_texture_id);
+    glBindTexture(GL_TEXTURE_BUFFER, baked_instance_texture_id);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, baked_instance_buffer_id);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    finishShaderPrograms();
+    setSkinningProgramUniforms();
+    initImpostors();
+
+    // the mesh bounds each joint's vertices in bind-pose model space; taking
+    // them into joint space lets the crowd be culled from its joint
+    // transforms, before any palettes are built.
+    for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        computeLodJointBounds(lod);
+
+    initResidency();
+
+#ifndef NDEBUG
+    // make sure every batched CPU skinning kernel this CPU can run agrees
+    // with the reference implementation, using a pose other than the bind
+    // pose.
+    std::vector<mat4> test_transforms(joint_count);
+    std::vector<mat4> test_palette(joint_count);
+    skeleton.computeJointTransforms(poses[1], test_transforms.data());
+    computeSkinningPalette(test_transforms.data(), skeleton.getInverseBindTransforms(), joint_count,
+                           test_palette.data());
+
+    if (!verifySkinningKernels(mesh->vertices, test_palette.data(), poses[1].color, 4))
+        throw std::runtime_error("A batched CPU skinning kernel doesn't match the reference kernel.");
+
+    // the 2D affine palette must be the same transforms as the matrices.
+    std::vector<Affine2D> test_affines(joint_count);
+    skeleton.computeJointAffines(poses[1], test_affines.data());
+    computeAffinePalette(test_affines.data(), skeleton.getInverseBindAffines(), joint_count, test_affines.data());
+    std::vector<mat4> affine_matrices(joint_count);
+    for (GLsizei joint = 0; joint < joint_count; ++joint)
+        affine_matrices[joint] = affineToMat4(test_affines[joint]);
+    if (!verifyJointTransforms(test_palette.data(), affine_matrices.data(), joint_count, 1e-4f))
+        throw std::runtime_error("The 2D affine palette doesn't match the matrix palette.");
+
+    // the level-by-level hierarchy evaluators must agree with the
+    // skeleton's forward pass, on the CPU and, if it can, the GPU.
+    HierarchyLevels hierarchy_levels(skeleton);
+    std::vector<mat4> level_transforms(joint_count);
+    hierarchy_levels.computeJointTransforms(poses[1], level_transforms.data(), thread_pool);
+    if (!verifyJointTransforms(test_transforms.data(), level_transforms.data(), joint_count, 1e-4f))
+        throw std::runtime_error("The hierarchy levels don't match the skeleton's joint transforms.");
+
+    // so must the crowd's pass, compiled for the demo's rig.
+    DemoRigEval::computeJointTransforms(poses[1], level_transforms.data());
+    if (!verifyJointTransforms(test_transforms.data(), level_transforms.data(), joint_count, 1e-4f))
+        throw std::runtime_error("The demo rig's fixed hierarchy pass doesn't match the skeleton's joint transforms.");
+
+    // and the crowd's blend fused into it must match blending first.
+    Pose blended = skeleton.allocatePose();
+    std::vector<mat4> blended_transforms(joint_count);
+    blendPoses(poses[1], poses[2], 0.3f, blended);
+    skeleton.computeJointTransforms(blended, blended_transforms.data());
+    skeleton.releasePose(blended);
+    DemoRigEval::blendJointTransforms(poses[1], poses[2], 0.3f, level_transforms.data());
+    if (!verifyJointTransforms(blended_transforms.data(), level_transforms.data(), joint_count, 1e-4f))
+        throw std::runtime_error("The demo rig's fused blend doesn't match blending the poses first.");
+
+    // the crowd's channel plan has to agree too, for a pose it was planned
+    // from.
+    if (crowd_channel_plan != nullptr)
+    {
+        if (!crowd_channel_plan->matches(poses[1]))
+            throw std::runtime_error("The crowd's channel plan doesn't cover a pose it was planned from.");
+        crowd_channel_plan->computeJointTransforms(poses[1], level_transforms.data());
+        if (!verifyJointTransforms(test_transforms.data(), level_transforms.data(), joint_count, 1e-4f))
+            throw std::runtime_error("The crowd's channel plan doesn't match the skeleton's joint transforms.");
+    }
+
+    // the skeleton's inverse bind transforms come from the affine path, so
+    // check them against the matrix path.
+    std::vector<mat4> test_inverse_binds(joint_count);
+    skeleton.computeJointTransforms(poses[0], test_inverse_binds.data());
+    for (GLsizei joint = 0; joint < joint_count; ++joint)
+        test_inverse_binds[joint] = inverseJointTransform(test_inverse_binds[joint]);
+    if (!verifyJointTransforms(test_inverse_binds.data(), skeleton.getInverseBindTransforms(), joint_count, 1e-4f))
+        throw std::runtime_error("The skeleton's inverse bind transforms don't match its bind pose.");
+
+    if (GLEW_VERSION_4_3)
+    {
+        GLuint hierarchy_program_id = compileComputeProgram("#version 430\n" + hierarchy_shader_source);
+        HierarchyComputePass hierarchy_pass(hierarchy_levels, 1);
+        computeLocalTransforms(poses[1], level_transforms.data());
+        hierarchy_pass.upload(level_transforms.data(), 1);
+        hierarchy_pass.evaluate(hierarchy_program_id, 1);
+        hierarchy_pass.download(level_transforms.data(), 1);
+        glDeleteProgram(hierarchy_program_id);
+
+        if (!verifyJointTransforms(test_transforms.data(), level_transforms.data(), joint_count, 1e-4f))
+            throw std::runtime_error("The hierarchy compute shader doesn't match the skeleton's joint transforms.");
+    }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the uniforms of the skinning programs which depend on the
+///         bind pose and the baked clip, once they've been built.
+void setSkinningProgramUniforms()
+{
+    for (size_t influences = 0; influences < MAX_JOINT_INFLUENCES; ++influences)
+    {
+        const SkinningProgram& program = skinning_programs[SKINNING_MODE_BAKED][influences];
+        if (program.id == 0)
+            continue;
+
+        glUseProgram(program.id);
+        glUniform1f(glGetUniformLocation(program.id, "baked_frame_rate"), baked_clip->getFrameRate());
+    }
+
+    // Only the separate mode programs need the bind pose; in palette mode
+    // it's folded into the palette on the CPU.  It's uploaded as affine
+    // rows, like the palettes.
+    std::vector<vec4> bind_pose_inv_rows(skeleton.getJointCount() * 3);
+    packAffineRows(skeleton.getInverseBindTransforms(), skeleton.getJointCount(), bind_pose_inv_rows.data());
+    for (size_t influences = 0; influences < MAX_JOINT_INFLUENCES; ++influences)
+    {
+        const SkinningProgram& program = skinning_programs[SKINNING_MODE_SEPARATE][influences];
+        if (program.id == 0)
+            continue;
+
+        GLuint program_ids[3] = { program.id, program.feedback_id, program.wireframe_id };
+        for (size_t i = 0; i < 3; ++i)
+        {
+            if (program_ids[i] == 0)
+                continue;
+
+            GLint bind_pose_inv_uniform_location = glGetUniformLocation(program_ids[i], "bind_pose_inv");
+            SKINNING_VALIDATE(validateUniformArray(program_ids[i], "bind_pose_inv", bind_pose_inv_rows.size()));
+
+            glUseProgram(program_ids[i]);
+            glUniform4fv(bind_pose_inv_uniform_location, GLsizei(bind_pose_inv_rows.size()), &bind_pose_inv_rows[0][0]);
+        }
+    }
+    glUseProgram(0);
+}
 
-    mat4 bind_pose_inv_data[7];
-    for (size_t joint = 0; joint < 7; ++joint)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws the crowd's impostor_atlas, and sets up what the
+///         impostors are drawn with.
+///
+/// \details There's a frame for each of N_IMPOSTOR_FRAMES phases of the
+///         crowd's bounce, posed by its blend graph and skinned by
+///         cpu_skinner.  While the clip isn't playing, a state of the crowd
+///         depends only on its phase (see getCrowdStateKey()), and the
+///         second half of the bounce goes back through the first half's
+///         states, so the frames only cover the first half.  The camera
+///         only ever looks straight down at the flat mesh, and an instance's
+///         turn is in its transform, so the frames need no other views of
+///         it, just the one orthographic view which fits the square of
+///         MESH_RADIUS around it to a cell.  That view gets a Camera block
+///         of its own, and the scene's is bound again by the first frame.
+///         The crowd's jiggle isn't in the frames, but it's too small to see
+///         at IMPOSTOR_MAX_PIXELS.
+void initImpostors()
+{
+    impostor_atlas = new ImpostorAtlas(N_IMPOSTOR_FRAMES, IMPOSTOR_CELL_SIZE);
+
+    Camera impostor_camera;
+    impostor_camera.setOrthographic(-MESH_RADIUS, MESH_RADIUS, -MESH_RADIUS, MESH_RADIUS, -1, 1);
+    CameraBlock block = impostor_camera.getBlock();
+    GLuint impostor_camera_buffer_id = 0;
+    glGenBuffers(1, &impostor_camera_buffer_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, impostor_camera_buffer_id);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(block), &block, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, impostor_camera_buffer_id);
+    camera_uploaded = false;
+
+    // the simulation thread isn't running yet, so the crowd's first pool
+    // can lend the graph its scratch poses.
+    size_t joint_count = skeleton.getJointCount();
+    BlendGraphContext context(*crowd_graph, *crowd_pose_pools[0]);
+    context.setInput(CROWD_INPUT_FROM, poses[left_pose]);
+    context.setInput(CROWD_INPUT_TO, poses[right_pose]);
+    context.setInput(CROWD_INPUT_WAVE, crowd_wave_delta);
+    Pose pose = skeleton.allocatePose();
+    std::vector<mat4> transforms(joint_count);
+    std::vector<mat4> palette(joint_count);
+
+    glUseProgram(passthrough_program_id);
+    impostor_atlas->beginCapture();
+    for (size_t frame = 0; frame < N_IMPOSTOR_FRAMES; ++frame)
     {
-        JointPose& jp = poses[0].joints[joint];
-        bind_pose_inv_data[joint] = glm::inverse(getJointTransform(jp));
+        float weights[2];
+        computeCrowdWeights(0.5f * frame / (N_IMPOSTOR_FRAMES - 1), weights);
+        context.setParameter(CROWD_PARAMETER_BLEND, weights[CROWD_PARAMETER_BLEND]);
+        context.setParameter(CROWD_PARAMETER_WAVE, weights[CROWD_PARAMETER_WAVE]);
+        context.evaluate(pose);
+        skeleton.computeJointTransforms(pose, transforms.data());
+        computeSkinningPalette(transforms.data(), skeleton.getInverseBindTransforms(), joint_count, palette.data());
+
+        impostor_atlas->bindFrame(frame);
+        cpu_skinner->skin(palette.data(), poses[0].color);
+        cpu_skinner->draw();
     }
+    impostor_atlas->endCapture();
+    glUseProgram(0);
+    gl_state.invalidate();
 
-    glUseProgram(shader_program_id);
-    glUniformMatrix4fv(bind_pose_inv_uniform_location, 7, GL_FALSE, &bind_pose_inv_data[0][0][0]);
+    skeleton.releasePose(pose);
+    glDeleteBuffers(1, &impostor_camera_buffer_id);
+
+    glUseProgram(impostor_program_id);
+    glUniform1i(glGetUniformLocation(impostor_program_id, "impostor_atlas"), 0);
+    glUniform1i(glGetUniformLocation(impostor_program_id, "impostor_instances"), 1);
+    glUniform1f(glGetUniformLocation(impostor_program_id, "impostor_radius"), MESH_RADIUS);
+    glUniform2i(glGetUniformLocation(impostor_program_id, "impostor_grid"), GLint(impostor_atlas->getColumnCount()),
+                GLint(impostor_atlas->getRowCount()));
     glUseProgram(0);
+
+    glGenVertexArrays(1, &impostor_vao_id);
+    glGenBuffers(1, &impostor_buffer_id);
+    glBindBuffer(GL_TEXTURE_BUFFER, impostor_buffer_id);
+    glBufferData(GL_TEXTURE_BUFFER, N_INSTANCES * 3 * sizeof(vec4), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glGenTextures(1, &impostor_texture_id);
+    glBindTexture(GL_TEXTURE_BUFFER, impostor_texture_id);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, impostor_buffer_id);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes the bounds of the vertices each joint of a level of detail
+///         influences from bind-pose model space into the joint's space.
+void computeLodJointBounds(size_t lod)
+{
+    const std::vector<BoundingBox>& mesh_bounds = getLodMesh(lod).getJointBounds();
+    const mat4* lod_bind_pose_inv = lod == 0 ? skeleton.getInverseBindTransforms()
+                                             : mesh_lods[lod]->bind_pose_inv.data();
+
+    std::unique_ptr<std::vector<BoundingBox> > joint_bounds(new std::vector<BoundingBox>(getLodJointCount(lod)));
+    for (size_t joint = 0; joint < mesh_bounds.size() && joint < joint_bounds->size(); ++joint)
+        (*joint_bounds)[joint] = transformBox(mesh_bounds[joint], lod_bind_pose_inv[joint]);
+    lod_joint_bounds[lod].publish(std::move(joint_bounds), *asset_epochs);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  Compiles and links the vertex and fragment shader into an
-///         executable shader program.
-void initShaderProgram()
+/// \brief  Binds a skinning program's uniform block and texture samplers to
+///         the binding points used by display().
+///
+/// \param  program_id The program to set up.
+/// \param  mode The SkinningMode the program was compiled for.
+void bindSkinningProgramResources(GLuint program_id, size_t mode)
 {
-    // First, compile vertex/fragment shaders.
+    // with VERTEX_COLORS, the crowd modes' programs may not use the block at all.
+    GLuint block_index = glGetUniformBlockIndex(program_id, "SkinningPalette");
+    if (block_index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program_id, block_index, SKINNING_PALETTE_BINDING);
+    bindCameraBlock(program_id);
+
+    // packSkinningPaletteBlock() packs a whole skeleton's palette, in the
+    // layout each mode's block declares.
+    SKINNING_VALIDATE(validateUniformArray(program_id, "skinning_palette", skeleton.getJointCount() * 3));
+    SKINNING_VALIDATE(validateUniformArray(program_id, "current_pose", skeleton.getJointCount() * 3));
+    SKINNING_VALIDATE(validateUniformArray(program_id, "dq_palette", skeleton.getJointCount() * 2));
+    SKINNING_VALIDATE(validateUniformArray(program_id, "current_pose_colors", skeleton.getJointCount()));
+
+    if (mode == SKINNING_MODE_INSTANCED)
+    {
+        glUseProgram(program_id);
+        glUniform1i(glGetUniformLocation(program_id, "instance_palettes"), 0);
+        glUniform1i(glGetUniformLocation(program_id, "instance_origins"), 1);
+        glUseProgram(0);
+    }
+    else if (mode == SKINNING_MODE_BAKED)
+    {
+        glUseProgram(program_id);
+        glUniform1i(glGetUniformLocation(program_id, "baked_palettes"), 0);
+        glUniform1i(glGetUniformLocation(program_id, "baked_instances"), 1);
+        glUseProgram(0);
+    }
+    else if (mode == SKINNING_MODE_TEXTURE_PALETTE)
+    {
+        glUseProgram(program_id);
+        glUniform1i(glGetUniformLocation(program_id, "skinning_palette_texture"), 0);
+        glUseProgram(0);
+    }
+}
 
-    GLuint vert_shader_id = glCreateShader(GL_VERTEX_SHADER);
-    GLuint frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts compiling and linking the vertex and fragment shaders
+///         into an executable shader program for each SkinningMode and each
+///         influence count used by the mesh's partitions, through
+///         startup_program_cache.  The mesh must already have been uploaded.
+///         None of the programs may be used until finishShaderPrograms().
+///
+/// \details Except for the crowd modes, each program is also linked a
+///         second time with its outputs captured by transform feedback, for
+///         pre-skinning into the SkinnedVertexCache.
+///
+///         The skinning programs are built from the copies of the skinning
+///         shaders in SHADER_SOURCE_DIRECTORY, which are written the first
+///         time the demo runs; applyHotReload() rebuilds them whenever
+///         those files are edited.
+void requestShaderPrograms()
+{
+    const PaletteSource mode_palette_sources[N_SKINNING_MODES] =
+    {
+        PALETTE_SOURCE_SEPARATE,
+        PALETTE_SOURCE_UNIFORM_BLOCK,
+        PALETTE_SOURCE_UNIFORM_BLOCK,
+        PALETTE_SOURCE_UNIFORM_BLOCK,
+        PALETTE_SOURCE_TEXTURE_BUFFER,
+        N_PALETTE_SOURCES,  // SKINNING_MODE_COMPUTE uses compute_skinning_shader_source instead
+        N_PALETTE_SOURCES,  // SKINNING_MODE_CPU draws with passthrough_program_id
+        PALETTE_SOURCE_BAKED_TEXTURE,
+        PALETTE_SOURCE_PALETTE_TEXTURE
+    };
+
+    const std::vector<SkeletalMesh::Partition>& partitions = mesh->getPartitions();
+
+    // morph targets are applied by a compute shader, so without one the
+    // full mesh's programs don't read the offsets either.
+    bool morph_targets = GLEW_VERSION_4_3 && mesh->getMorphTargetCount() > 0;
+
+    // work out the permutation each program in skinning_programs and
+    // lod_programs is built from; partitions with the same influence count
+    // share a program.
+    for (size_t mode = 0; mode < N_SKINNING_MODES; ++mode)
+    {
+        if (mode == SKINNING_MODE_COMPUTE || mode == SKINNING_MODE_CPU)
+            continue;
 
-    const char* vert_cstr = vertex_shader_source.c_str();
-    const char* frag_cstr = fragment_shader_source.c_str();
-                                    
-    glShaderSource(vert_shader_id, 1, &vert_cstr, NULL);
-    glShaderSource(frag_shader_id, 1, &frag_cstr, NULL);
+        for (size_t i = 0; i < partitions.size(); ++i)
+        {
+            size_t influences = partitions[i].influence_count;
+
+            SkinningProgram& program = skinning_programs[mode][influences - 1];
+            program.permutation.palette_source = mode_palette_sources[mode];
+            program.permutation.dual_quaternion = mode == SKINNING_MODE_DUAL_QUAT;
+            program.permutation.palette_blend = mode == SKINNING_MODE_DUAL_QUAT && palette_rate > 0;
+            program.permutation.affine_2d = mode == SKINNING_MODE_AFFINE_2D;
+            program.permutation.joint_count = skeleton.getJointCount();
+            program.permutation.influence_count = influences;
+            program.permutation.vertex_colors = true;
+            program.permutation.morph_targets = morph_targets;
+            program.used = true;
+        }
+    }
 
-    glCompileShader(vert_shader_id);
-    glCompileShader(frag_shader_id);
+    // the reduced levels of detail are only drawn instanced.
+    for (size_t lod = 1; lod < mesh_lod_count; ++lod)
+    {
+        const std::vector<SkeletalMesh::Partition>& lod_partitions = mesh_lods[lod]->mesh.getPartitions();
+        for (size_t i = 0; i < lod_partitions.size(); ++i)
+        {
+            size_t influences = lod_partitions[i].influence_count;
+
+            SkinningProgram& program = lod_programs[lod][influences - 1];
+            program.permutation.palette_source = PALETTE_SOURCE_TEXTURE_BUFFER;
+            program.permutation.joint_count = skeleton.getJointCount();
+            program.permutation.lod_joint_count = mesh_lods[lod]->getJointCount();
+            program.permutation.influence_count = influences;
+            program.permutation.vertex_colors = true;
+            program.used = true;
+        }
+    }
 
-    // check if there was a problem with vertex shader compilation.
-    GLint result = GL_FALSE;
-    glGetShaderiv(vert_shader_id, GL_COMPILE_STATUS, &result);
-    if (result != GL_TRUE)
+    // the skinning shaders' sources were read while the context was set up.
+    asset_loader->wait(startup_shaders_load);
+
+    // request every program before checking any of them, so the driver can
+    // build them all at once; unchanged programs are loaded from the cache.
+    startup_program_cache = new ProgramCache(SHADER_CACHE_DIRECTORY);
+    ProgramCache& cache = *startup_program_cache;
+    skinning_program_set = new SkinningProgramSet(skinning_vertex_source, skinning_fragment_source);
+    requestSkinningPrograms(cache, *skinning_program_set);
+
+    cache.requestProgram(passthrough_program_id, "#version 330\n" + passthrough_vertex_shader_source,
+                                                 "#version 330\n" + fragment_shader_source);
+    cache.requestProgram(passthrough_wireframe_program_id, "#version 330\n" + passthrough_vertex_shader_source,
+                         "#version 330\n" + wireframe_fragment_shader_source, std::vector<const char*>(),
+                         "#version 330\n" + wireframe_geometry_shader_source);
+    cache.requestProgram(shadow_program_id, "#version 330\n" + shadow_vertex_shader_source,
+                         "#version 330\n" + shadow_fragment_shader_source, std::vector<const char*>(),
+                         "#version 330\n" + shadow_geometry_shader_source);
+    cache.requestProgram(occlusion_proxy_program_id, "#version 330\n" + occlusion_proxy_vertex_shader_source,
+                         "#version 330\n" + shadow_fragment_shader_source);
+    cache.requestProgram(impostor_program_id, "#version 330\n" + impostor_vertex_shader_source,
+                         "#version 330\n" + impostor_fragment_shader_source);
+
+    // the compute backend is only used when the context supports it.
+    if (GLEW_VERSION_4_3)
     {
-        GLint infolog_len;
-        glGetShaderiv(vert_shader_id, GL_INFO_LOG_LENGTH, &infolog_len);
-        char *infolog = new char[std::max(1, infolog_len)];
-        glGetShaderInfoLog(vert_shader_id, infolog_len, NULL, infolog);
+        std::ostringstream compute_source;
+        compute_source << "#version 430" << std::endl
+                       << "#define N_JOINTS " << skeleton.getJointCount() << std::endl;
+        if (mesh->vertex_format == VERTEX_FORMAT_PACKED)
+            compute_source << "#define VERTEX_FORMAT_PACKED" << std::endl;
+        else if (mesh->vertex_format == VERTEX_FORMAT_PACKED_HALF)
+            compute_source << "#define VERTEX_FORMAT_PACKED_HALF" << std::endl;
+        compute_source << compute_skinning_shader_source;
+
+        cache.requestComputeProgram(compute_skinning_program_id, compute_source.str());
+        if (morph_targets)
+            cache.requestComputeProgram(morph_target_program_id, "#version 430\n" + morph_target_shader_source);
+        cache.requestComputeProgram(instance_cull_program_id, "#version 430\n" + instance_cull_shader_source);
+        cache.requestComputeProgram(skinned_bounds_program_id, "#version 430\n" + skinned_bounds_shader_source);
+        if (gpu_hierarchy)
+        {
+            cache.requestComputeProgram(local_expand_program_id, "#version 430\n" + local_expand_shader_source);
+            cache.requestComputeProgram(crowd_hierarchy_program_id, "#version 430\n" + hierarchy_shader_source);
+            cache.requestComputeProgram(palette_resolve_program_id, "#version 430\n" + palette_resolve_shader_source);
+        }
+        if (gpu_vertex_decode && !mesh_path.empty())
+            cache.requestComputeProgram(vertex_decode_program_id, "#version 430\n" + vertex_decode_shader_source);
+        cache.requestProgram(compute_draw_program_id, "#version 430\n" + compute_draw_vertex_shader_source,
+                                                      "#version 430\n" + fragment_shader_source);
+        cache.requestProgram(compute_draw_wireframe_program_id, "#version 430\n" + compute_draw_vertex_shader_source,
+                             "#version 430\n" + wireframe_fragment_shader_source, std::vector<const char*>(),
+                             "#version 430\n" + wireframe_geometry_shader_source);
+        cache.requestProgram(shadow_compute_program_id, "#version 430\n" + shadow_compute_vertex_shader_source,
+                             "#version 430\n" + shadow_fragment_shader_source, std::vector<const char*>(),
+                             "#version 430\n" + shadow_geometry_shader_source);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits for the programs requestShaderPrograms() started, if the
+///         driver hasn't finished them already, and sets them up.
+void finishShaderPrograms()
+{
+    bool ready = startup_program_cache->isReady();
+    startup_program_cache->finish();
+    bindCameraBlock(passthrough_program_id);
+    bindCameraBlock(passthrough_wireframe_program_id);
+    bindCameraBlock(occlusion_proxy_program_id);
+    bindCameraBlock(impostor_program_id);
+    std::cerr << "Shader programs: " << startup_program_cache->getHitCount() << " loaded from "
+              << SHADER_CACHE_DIRECTORY << ", " << startup_program_cache->getMissCount() << " compiled ("
+              << (ready ? "done" : "still building") << " by the time they were needed), "
+              << skinning_program_set->getProgramCount() << " skinning permutations." << std::endl;
+
+    delete startup_program_cache;
+    startup_program_cache = nullptr;
+    useSkinningPrograms(*skinning_program_set);
+}
 
-        std::cerr << "Error compiling vertex shader!" << std::endl
-                  << "GL Compile Status: " << result << std::endl
-                  << "      GL Info Log: " << infolog << std::endl
-                  << "    Shader Source: " << vertex_shader_source << std::endl;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Submits the startup's loads to asset_loader, which runs them
+///         side by side.
+///
+/// \details Each is waited for where the sequential startup used to do it:
+///         the poses as soon as the context exists, the shader sources in
+///         requestShaderPrograms(), and the mesh in initMeshes().  None of
+///         them depends on another, so the slowest one sets how long they
+///         all take, rather than the sum.
+void startStartupLoads()
+{
+    startup_poses_load = asset_loader->begin("load rig", getFileBytes(rig_path) + getFileBytes(clip_database_path));
+    asset_loader->addStage(startup_poses_load, AssetLoader::STAGE_WORKER, loadPoses, nullptr);
+    asset_loader->submit(startup_poses_load);
 
-        delete[] infolog;
+    startup_shaders_load = asset_loader->begin("load shader sources",
+                                               getFileBytes(SKINNING_VERTEX_SHADER_PATH) +
+                                               getFileBytes(SKINNING_FRAGMENT_SHADER_PATH));
+    asset_loader->addStage(startup_shaders_load, AssetLoader::STAGE_WORKER, readShaderSources, nullptr);
+    asset_loader->submit(startup_shaders_load);
 
-        glDeleteShader(vert_shader_id);
-        glDeleteShader(frag_shader_id);
-        throw std::runtime_error("Error compiling vertex shader!");
+    if (!mesh_path.empty())
+    {
+        startup_mesh_load = asset_loader->begin("load mesh", getFileBytes(mesh_path));
+        asset_loader->addStage(startup_mesh_load, AssetLoader::STAGE_WORKER, readStartupMesh, nullptr);
+        asset_loader->addStage(startup_mesh_load, AssetLoader::STAGE_RENDER, uploadStartupMesh, nullptr);
+        asset_loader->submit(startup_mesh_load);
     }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of a file in bytes, or 0 if it can't be opened
+///         (or the path is empty).
+size_t getFileBytes(const std::string& path)
+{
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    return file ? size_t(file.tellg()) : 0;
+}
 
-    // check if there was a problem with fragment shader compilation.
-    glGetShaderiv(frag_shader_id, GL_COMPILE_STATUS, &result);
-    if (result != GL_TRUE)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  startup_mesh_load's first stage, on a worker: reads and checks
+///         the mesh file given on the command line into startup_mesh_data.
+void readStartupMesh(void*)
+{
+    readMeshFile(mesh_path, startup_mesh_data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  startup_mesh_load's second stage, on the render thread: uploads
+///         startup_mesh_data into the mesh initMeshes() created, and frees
+///         it.
+void uploadStartupMesh(void*)
+{
+    uploadMeshFile(*mesh, startup_mesh_data);
+    startup_mesh_data = MeshFileData();
+    if (getPositionComponents(mesh->vertex_format) != 2)
+    {
+        std::cerr << "Error loading mesh file!" << std::endl
+                  << "   File: " << mesh_path << std::endl
+                  << "  Error: The demo can only draw 2D meshes." << std::endl;
+        throw std::runtime_error("Error loading mesh file!");
+    }
+    if (isQuantizedFormat(mesh->vertex_format))
     {
-        GLint infolog_len;
-        glGetShaderiv(frag_shader_id, GL_INFO_LOG_LENGTH, &infolog_len);
-        char *infolog = new char[std::max(1, infolog_len)];
-        glGetShaderInfoLog(frag_shader_id, infolog_len, NULL, infolog);
+        std::cerr << "Error loading mesh file!" << std::endl
+                  << "   File: " << mesh_path << std::endl
+                  << "  Error: The demo can't draw quantized meshes." << std::endl;
+        throw std::runtime_error("Error loading mesh file!");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  startup_shaders_load's only stage, on a worker: reads the
+///         skinning shaders' sources, which can be edited while the demo
+///         runs.
+void readShaderSources(void*)
+{
+    makeDirectory(SHADER_SOURCE_DIRECTORY);
+    loadShaderSource(SKINNING_VERTEX_SHADER_PATH, vertex_shader_source, skinning_vertex_source);
+    loadShaderSource(SKINNING_FRAGMENT_SHADER_PATH, fragment_shader_source, skinning_fragment_source);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  startup_poses_load's only stage, on a worker; see initPoses().
+void loadPoses(void*)
+{
+    initPoses();
+}
 
-        std::cerr << "Error compiling fragment shader!" << std::endl
-                  << "GL Compile Status: " << result << std::endl
-                  << "      GL Info Log: " << infolog << std::endl
-                  << "    Shader Source: " << fragment_shader_source << std::endl;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads one of the skinning shaders from a file in
+///         SHADER_SOURCE_DIRECTORY, or writes the built-in source there if
+///         the file doesn't exist yet, so it can be edited.
+///
+/// \param  path The file the source is kept in.
+/// \param  builtin The built-in source, from skinning_shaders.cpp.
+/// \param  source Receives the source to build with.
+void loadShaderSource(const std::string& path, const std::string& builtin, std::string& source)
+{
+    if (!readTextFile(path, source))
+    {
+        source = builtin;
+        writeTextFile(path, source);
+    }
+    else if (source != builtin)
+    {
+        // an old copy would hide changes made to skinning_shaders.cpp since.
+        std::cerr << "Skinning shader: using " << path << ", which differs from the built-in source." << std::endl;
+    }
+}
 
-        delete[] infolog;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts building every program in skinning_programs and
+///         lod_programs which the mesh uses, in a new set.
+///
+/// \details Except for the crowd modes, each level 0 program is also linked
+///         a second time for transform feedback, and a third time with the
+///         wireframe geometry shader.  The instanced crowd's programs, at
+///         every level, are linked a second time to draw motion vectors.
+void requestSkinningPrograms(ProgramCache& cache, SkinningProgramSet& program_set)
+{
+    for (size_t mode = 0; mode < N_SKINNING_MODES; ++mode)
+    {
+        for (size_t influences = 0; influences < MAX_JOINT_INFLUENCES; ++influences)
+        {
+            const SkinningProgram& program = skinning_programs[mode][influences];
+            if (!program.used)
+                continue;
 
-        glDeleteShader(vert_shader_id);
-        glDeleteShader(frag_shader_id);
-        throw std::runtime_error("Error compiling fragment shader!");
+            program_set.request(cache, program.permutation);
+            if (mode == SKINNING_MODE_INSTANCED)
+            {
+                SkinningPermutation motion_vector_permutation = program.permutation;
+                motion_vector_permutation.motion_vectors = true;
+                program_set.request(cache, motion_vector_permutation);
+            }
+            else if (mode != SKINNING_MODE_BAKED)
+            {
+                SkinningPermutation wireframe_permutation = program.permutation;
+                wireframe_permutation.wireframe = true;
+                program_set.request(cache, program.permutation, true);
+                program_set.request(cache, wireframe_permutation);
+            }
+        }
     }
 
-    // Next, link shaders together into a program and delete the individual
-    // shaders (we don't need them after the program is linked).
+    for (size_t lod = 1; lod < mesh_lod_count; ++lod)
+    {
+        for (size_t influences = 0; influences < MAX_JOINT_INFLUENCES; ++influences)
+        {
+            const SkinningProgram& program = lod_programs[lod][influences];
+            if (!program.used)
+                continue;
+
+            SkinningPermutation motion_vector_permutation = program.permutation;
+            motion_vector_permutation.motion_vectors = true;
+            program_set.request(cache, program.permutation);
+            program_set.request(cache, motion_vector_permutation);
+        }
+    }
+}
 
-    shader_program_id = glCreateProgram();
-    glAttachShader(shader_program_id, vert_shader_id);
-    glAttachShader(shader_program_id, frag_shader_id);
-    glLinkProgram(shader_program_id);
-  //  glDeleteShader(vert_shader_id);
-    //glDeleteShader(frag_shader_id);
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Points skinning_programs and lod_programs at the programs of a
+///         finished set, and sets up whatever doesn't change per frame.
+///
+/// \details The uniforms which need the bind pose or the baked clip are set
+///         by setSkinningProgramUniforms(), since initGL() only builds those
+///         after the programs.
+void useSkinningPrograms(const SkinningProgramSet& program_set)
+{
+    for (size_t mode = 0; mode < N_SKINNING_MODES; ++mode)
+    {
+        for (size_t influences = 0; influences < MAX_JOINT_INFLUENCES; ++influences)
+        {
+            SkinningProgram& program = skinning_programs[mode][influences];
+            if (!program.used)
+                continue;
+
+            program.id = program_set.getProgram(program.permutation);
+            program.feedback_id = program_set.getProgram(program.permutation, true);
+
+            SkinningPermutation wireframe_permutation = program.permutation;
+            wireframe_permutation.wireframe = true;
+            program.wireframe_id = program_set.getProgram(wireframe_permutation);
+            SkinningPermutation motion_vector_permutation = program.permutation;
+            motion_vector_permutation.motion_vectors = true;
+            program.motion_vector_id = program_set.getProgram(motion_vector_permutation);
+
+            bindSkinningProgramResources(program.id, mode);
+            if (program.feedback_id != 0)
+                bindSkinningProgramResources(program.feedback_id, mode);
+            if (program.wireframe_id != 0)
+                bindSkinningProgramResources(program.wireframe_id, mode);
+            if (program.motion_vector_id != 0)
+                bindSkinningProgramResources(program.motion_vector_id, mode);
+            if (mode == SKINNING_MODE_BAKED)
+                program.baked_time_location = glGetUniformLocation(program.id, "baked_time");
+        }
+    }
 
-    // check if there was a problem with linking.
-    glGetProgramiv(shader_program_id, GL_LINK_STATUS, &result);
-    if (result != GL_TRUE)
+    for (size_t lod = 1; lod < mesh_lod_count; ++lod)
     {
-        GLint infolog_len;
-        glGetProgramiv(shader_program_id, GL_INFO_LOG_LENGTH, &infolog_len);
-        char *infolog = new char[std::max(1, infolog_len)];
-        glGetProgramInfoLog(shader_program_id, infolog_len, NULL, infolog);
+        const std::vector<GLuint>& source_joints = mesh_lods[lod]->skeleton.source_joints;
+        for (size_t influences = 0; influences < MAX_JOINT_INFLUENCES; ++influences)
+        {
+            SkinningProgram& program = lod_programs[lod][influences];
+            if (!program.used)
+                continue;
 
-        std::cerr << "Error linking program!" << std::endl
-                  << "GL Link Status: " << result << std::endl
-                  << "   GL Info Log: " << infolog << std::endl;
+            program.id = program_set.getProgram(program.permutation);
+            SkinningPermutation motion_vector_permutation = program.permutation;
+            motion_vector_permutation.motion_vectors = true;
+            program.motion_vector_id = program_set.getProgram(motion_vector_permutation);
 
-        delete[] infolog;
+            GLuint program_ids[] = { program.id, program.motion_vector_id };
+            for (size_t i = 0; i < sizeof(program_ids) / sizeof(program_ids[0]); ++i)
+            {
+                bindSkinningProgramResources(program_ids[i], SKINNING_MODE_INSTANCED);
 
-        glDeleteProgram(shader_program_id);
-        shader_program_id = 0;
-        throw std::runtime_error("Error linking program!");
+                glUseProgram(program_ids[i]);
+                glUniform1uiv(glGetUniformLocation(program_ids[i], "source_joints"), GLsizei(source_joints.size()),
+                              source_joints.data());
+                glUseProgram(0);
+            }
+        }
     }
 }
 
@@ -369,14 +2046,26 @@ void initShaderProgram()
 /// \details For simplicity's sake, the model was created in Maya and exported
 ///         as an OBJ file, then manually edited into the source code below.
 ///
-///         A mesh loader would be a much more durable solution for a real
-///         game.
+///         If a mesh file was given on the command line, it's uploaded by
+///         startup_mesh_load instead; the built-in mesh can be saved as one by
+///         pressing M.  The demo's CPU and compute skinners and vertex color
+///         blending only read 2D vertices, so 3D mesh files are rejected.
+///         Quantized ones are too, since the demo's palettes, levels of
+///         detail and baked animations all use the skeleton's inverse bind
+///         transforms as they are.
 void initMeshes()
 {
-    mesh = new SkeletalMesh();
-    Vertex v;
-    mesh->vertices.push_back(v);    // unused vertex (the indices used start at 1)
+    mesh_handle = meshes.add(std::unique_ptr<SkeletalMesh>(new SkeletalMesh()));
+    mesh = meshes.get(mesh_handle)->get();
+    mesh->setDeletionQueue(&gl_deletion_queue);
+    if (!mesh_path.empty())
+    {
+        // its upload stage runs in here, now that there's a mesh for it.
+        asset_loader->wait(startup_mesh_load);
+        return;
+    }
 
+    Vertex v;
     v.joint_indices[0] = 0;     v.joint_weights[0] = 0.6f;
     v.joint_indices[1] = 1;     v.joint_weights[1] = 0.1f;
     v.joint_indices[2] = 2;     v.joint_weights[2] = 0.1f;
@@ -592,8 +2281,152 @@ void initMeshes()
     mesh->indices.push_back(22); mesh->indices.push_back(27); mesh->indices.push_back(23);
     mesh->indices.push_back(27); mesh->indices.push_back(22); mesh->indices.push_back(26);
     mesh->indices.push_back(23); mesh->indices.push_back(20); mesh->indices.push_back(22);
+    rebaseIndices(mesh->indices, BUILT_IN_MESH_INDEX_BASE);
+
+    mesh->vertex_format = VERTEX_FORMAT_PACKED_HALF;
+    computeOutlineNormals(mesh->vertices, mesh->indices);
+
+    // many of the weights above don't sum to 1, or list influences of 0.
+    // This has to happen before anything reads them, including the levels
+    // of detail.
+    InfluenceStats influence_stats;
+    normalizeInfluences(mesh->vertices, DEFAULT_MIN_INFLUENCE_WEIGHT, &influence_stats);
+    std::cerr << "Mesh influences: " << influence_stats.normalized_vertices << " vertices normalized, "
+              << influence_stats.pruned_influences << " influences pruned; vertices with 1-4 influences: "
+              << influence_stats.influence_histogram[0] << "/" << influence_stats.influence_histogram[1] << "/"
+              << influence_stats.influence_histogram[2] << "/" << influence_stats.influence_histogram[3] << std::endl;
+    if (max_influences < MAX_JOINT_INFLUENCES)
+    {
+        InfluenceLimitStats limit_stats;
+        limitInfluences(mesh->vertices, max_influences, &limit_stats);
+        std::cerr << "Mesh limited to " << max_influences << " influences: " << limit_stats.limited_vertices
+                  << " vertices lost " << limit_stats.dropped_influences << " influences, "
+                  << limit_stats.mean_dropped_weight << " of their weight on average and at most "
+                  << limit_stats.max_dropped_weight << " (vertex " << limit_stats.worst_vertex << ")." << std::endl;
+    }
+
+    // each level of detail is reduced from the full mesh and skeleton on a
+    // worker thread, while the full mesh is uploaded; only the levels'
+    // uploads have to wait for them.
+    for (size_t lod = 1; lod < N_MESH_LODS; ++lod)
+        job_system->createJob(buildMeshLodJob, nullptr, lod);
+    job_system->submit();
+
+    SKINNING_VALIDATE(validateSkinningVertices(mesh->vertices.data(), mesh->vertices.size(), skeleton.getJointCount(),
+                                               "built-in mesh"));
+
+    MeshOptimizationStats stats;
+    mesh->uploadMesh(&stats);
+    std::cerr << "Mesh vertex cache ACMR: " << stats.acmr_before << " -> " << stats.acmr_after << std::endl;
+
+    // two morph targets: one swells the red arm's hand, the other the
+    // other two hands.
+    std::vector<MorphDelta> deltas;
+    MorphDelta delta;
+    delta.vertex = 3;   delta.delta = vec2(-0.040000,  0.000000);  deltas.push_back(delta);
+    delta.vertex = 4;   delta.delta = vec2( 0.040000,  0.000000);  deltas.push_back(delta);
+    delta.vertex = 5;   delta.delta = vec2( 0.000000,  0.050000);  deltas.push_back(delta);
+    rebaseIndices(deltas, BUILT_IN_MESH_INDEX_BASE);
+    mesh->addMorphTarget(deltas);
+
+    deltas.clear();
+    delta.vertex = 17;  delta.delta = vec2( 0.017500,  0.030311);  deltas.push_back(delta);
+    delta.vertex = 18;  delta.delta = vec2(-0.017500, -0.030311);  deltas.push_back(delta);
+    delta.vertex = 19;  delta.delta = vec2( 0.043301, -0.025000);  deltas.push_back(delta);
+    delta.vertex = 30;  delta.delta = vec2( 0.017500, -0.030311);  deltas.push_back(delta);
+    delta.vertex = 31;  delta.delta = vec2(-0.017500,  0.030311);  deltas.push_back(delta);
+    delta.vertex = 32;  delta.delta = vec2(-0.043301, -0.025000);  deltas.push_back(delta);
+    rebaseIndices(deltas, BUILT_IN_MESH_INDEX_BASE);
+    mesh->addMorphTarget(deltas);
+
+    // and two correctives, which push out the side of the red elbow on the
+    // outside of the bend.
+    deltas.clear();
+    delta.vertex = 15;  delta.delta = vec2( 0.020000,  0.000000);  deltas.push_back(delta);
+    rebaseIndices(deltas, BUILT_IN_MESH_INDEX_BASE);
+    size_t bend_left_target = mesh->addMorphTarget(deltas);
+
+    deltas.clear();
+    delta.vertex = 14;  delta.delta = vec2(-0.020000,  0.000000);  deltas.push_back(delta);
+    rebaseIndices(deltas, BUILT_IN_MESH_INDEX_BASE);
+    size_t bend_right_target = mesh->addMorphTarget(deltas);
+
+    pose_correctives = new PoseSpaceCorrectives(skeleton, 1);
+    pose_correctives->addLinearCorrective(bend_left_target, REACH_CHAIN.mid_joint,
+                                          ELBOW_CORRECTIVE_START, ELBOW_CORRECTIVE_FULL);
+    pose_correctives->addLinearCorrective(bend_right_target, REACH_CHAIN.mid_joint,
+                                          -ELBOW_CORRECTIVE_START, -ELBOW_CORRECTIVE_FULL);
+
+    job_system->wait();
+    for (mesh_lod_count = 1; mesh_lod_count < N_MESH_LODS; ++mesh_lod_count)
+    {
+        SkeletalMeshLod* lod = mesh_lods[mesh_lod_count];
+        SKINNING_VALIDATE(validateSkinningVertices(lod->mesh.vertices.data(), lod->mesh.vertices.size(),
+                                                   lod->getJointCount(), "mesh LOD"));
+        lod->mesh.setCpuDataPolicy(SkeletalMesh::CPU_DATA_COMPRESS);   // only restoreMeshLod() needs them
+        lod->mesh.uploadPrepared();
+
+        std::cerr << "Mesh LOD " << mesh_lod_count << ": " << lod->mesh.getVertexCount() << " vertices, "
+                  << lod->mesh.getIndexCount() / 3 << " triangles, " << lod->getJointCount() << " joints, "
+                  << lod->mesh.getCpuDataBytes() << " bytes kept compressed" << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts tracking the GPU memory of the meshes, palettes and baked
+///         animation against GPU_MEMORY_BUDGET.
+///
+/// \details Only the reduced levels of detail can be evicted; the full mesh
+///         is shared by every skinner and cache, and the copies of the
+///         levels in mesh_arena are drawn from the arena.
+void initResidency()
+{
+    residency_manager = new ResidencyManager(GPU_MEMORY_BUDGET);
+    lod_resources[0] = residency_manager->addFixed("mesh", mesh->getBufferBytes());
+    for (size_t lod = 1; lod < mesh_lod_count; ++lod)
+    {
+        std::ostringstream name;
+        name << "mesh LOD " << lod;
+        lod_resources[lod] = residency_manager->addMesh(name.str(), mesh_lods[lod]->mesh, restoreMeshLod, nullptr, lod);
+    }
+
+    residency_manager->addFixed("skinning palette", skinning_palette_buffer->getBufferBytes());
+    residency_manager->addFixed("camera", camera_buffer->getBufferBytes());
+    residency_manager->addFixed("instance palettes", palette_ring->getBufferBytes());
+    residency_manager->addFixed("baked animation", baked_clip->getTextureBytes() + N_INSTANCES * 4 * sizeof(vec4));
+    residency_manager->addFixed("impostor atlas", impostor_atlas->getTextureBytes() + N_INSTANCES * 3 * sizeof(vec4));
+    residency_manager->addFixed("crowd variant colors", (N_CROWD_VARIANTS - 1) * crowd_variant_colors[0]->getBufferBytes());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads an evicted level of detail again, and reattaches the
+///         attributes initGL() attached to its VAO.  Called by
+///         residency_manager.
+///
+/// \param  lod The level to restore (1 to mesh_lod_count - 1).
+void restoreMeshLod(void*, size_t lod)
+{
+    SkeletalMesh& lod_mesh = mesh_lods[lod]->mesh;
+    lod_mesh.restoreCpuData();
+    lod_mesh.uploadMesh();
+    render_queue->attachPaletteIndices(lod_mesh.vao_id);
+    vertex_color_cache->attach(lod_mesh.vao_id, lod_first_color_vertices[lod]);
+    for (size_t v = 0; v < N_CROWD_VARIANTS - 1; ++v)
+        crowd_variants[v][lod]->update();
+}
 
-    mesh->uploadMesh();
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Job which builds and prepares one level of detail of the mesh,
+///         without touching GL, leaving it for initMeshes() to upload.
+///
+/// \param  lod The level to build (1 to N_MESH_LODS - 1).  Each level merges
+///         one more pass of leaf joints, and aims for LOD_VERTEX_RATIO of
+///         the previous level's vertices.
+void buildMeshLodJob(void*, size_t lod)
+{
+    float vertex_ratio = std::pow(LOD_VERTEX_RATIO, float(lod));
+    mesh_lods[lod] = new SkeletalMeshLod(*mesh, skeleton, lod, vertex_ratio, LOD_MAX_ERROR);
+    mesh_lods[lod]->mesh.setDeletionQueue(&gl_deletion_queue);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -603,279 +2436,4364 @@ void initMeshes()
 ///         raw vertex positions are in.  The next two poses are deformed
 ///         versions of the bind pose with rotations changed.  In addition
 ///         to rotations, translations and scale may also be changed.
+///
+///         With -rig, the skeleton and the poses come from a rig file,
+///         which is written from the built-in rig first if it doesn't exist
+///         yet.
 void initPoses()
 {
-    // poses[0] => bind pose.
-    poses[0].joints[0].color = color4(1.0f, 1.0f, 1.0f, 1.0f);
-    poses[0].joints[0].parent = nullptr;
-    poses[0].joints[0].translation = vec2(0, 0);
-    poses[0].joints[0].rotation = 0.0f;
-    poses[0].joints[0].scale = 1.0f;
+    if (!rig_path.empty() && std::ifstream(rig_path.c_str(), std::ios::in))
+        loadRig();
+    else
+    {
+        buildRig();
+        if (!rig_path.empty())
+        {
+            RigFilePose rig_poses[N_POSES];
+            for (size_t pose = 0; pose < N_POSES; ++pose)
+            {
+                rig_poses[pose].name = RIG_POSE_NAMES[pose];
+                rig_poses[pose].pose = poses[pose];
+            }
+            saveRigFile(skeleton, rig_poses, N_POSES, rig_path);
+            std::cerr << "Saved the rig to " << rig_path << "." << std::endl;
+        }
+    }
 
-    poses[0].joints[1] = poses[0].joints[0];
-    poses[0].joints[1].color = color4(1.0f, 0.0f, 0.0f, 1.0f);
-    poses[0].joints[1].parent = &poses[0].joints[0];
-    poses[0].joints[1].translation = vec2(0, 0.206357);
-    poses[0].joints[1].rotation = 90.0f;
+    SKINNING_VALIDATE(validateSkeleton(skeleton, rig_path.empty() ? "built-in rig" : rig_path.c_str()));
+
+    socket_transforms.resize(skeleton.getSocketCount());
+    current_pose = skeleton.allocatePose(true);
+    current_pose_transforms = new JointTransformCache(skeleton);
+    palette_cache = new PaletteCache(skeleton.getJointCount(), PALETTE_CACHE_CAPACITY);
+    if (instant_replay_enabled)
+        instant_replay_buffer = new PoseReplayBuffer(skeleton.getJointCount(), INSTANT_REPLAY_BYTES,
+                                                     INSTANT_REPLAY_KEYFRAME_INTERVAL);
+    instance_joint_transforms = new NumaPartitionedArray<mat4>(*numa_topology, N_INSTANCES, skeleton.getJointCount());
+    if (gpu_hierarchy)
+        leader_compact_locals = new NumaPartitionedArray<vec4>(*numa_topology, N_INSTANCES, skeleton.getJointCount());
+
+    // the test pose's hash is the same on every machine, so comparing it
+    // is a quick check that two builds are fit for lockstep.
+    if (deterministic_poses)
+    {
+        fixed_pose_evaluator = new FixedPoseEvaluator(skeleton, poses[0]);
+        fixed_pose_evaluator->evaluate(poses[1]);
+        std::cerr << "Deterministic palettes; the test pose's hash is " << std::hex
+                  << fixed_pose_evaluator->getPaletteHash() << std::dec << "." << std::endl;
+    }
 
-    poses[0].joints[2] = poses[0].joints[0];
-    poses[0].joints[2].color = color4(0.0f, 1.0f, 0.0f, 1.0f);
-    poses[0].joints[2].parent = &poses[0].joints[0];
-    poses[0].joints[2].translation = vec2(-0.178710, -0.103178);
-    poses[0].joints[2].rotation = 210.0f;
+    copyPose(poses[0], current_pose);
+
+    left_foot_chain.joints.push_back(2);
+    left_foot_chain.joints.push_back(5);
+    left_foot_chain.end_offset = LIMB_END_OFFSET;
+
+    simulation_arena = new FrameArena(SIMULATION_ARENA_BYTES);
+    ragdoll = new Ragdoll(skeleton, poses[0]);
+    physics_input = new PhysicsPoseInput(skeleton.getJointCount());
+
+    // a looping clip that swings between the two extreme poses.
+    clip_handle = clips.add(std::unique_ptr<AnimationClip>(new AnimationClip(skeleton.getJointCount(), 2.0f)));
+    clip = clips.get(clip_handle)->get();
+    clip->addPoseKeys(0.0f, poses[left_pose]);
+    clip->addPoseKeys(1.0f, poses[right_pose]);
+    clip->addPoseKeys(2.0f, poses[left_pose]);
+    clip->addEvent(0.0f, CLIP_EVENT_LEFT);
+    clip->addEvent(1.0f, CLIP_EVENT_RIGHT);
+
+    // the root's travel moves the crowd's instances instead of their skeletons.
+    clip->extractRootMotion(0);
+
+    compressed_clip = new CompressedClip(*clip);
+    if (!clip_database_path.empty())
+        openClipDatabase();
+    std::cerr << "Compressed the animation clip from " << compressed_clip->getSourceSize() << " to "
+              << compressed_clip->getSize() << " bytes (" << compressed_clip->getKeyCount() << " keys, "
+              << compressed_clip->getConstantCurveCount() << " constant curves)." << std::endl;
+
+    sampled_clip = compressed_clip;
+    clip_sampler = new CompressedClipSampler(*compressed_clip);
+    instance_samplers.assign(N_INSTANCES, CompressedClipSampler(*compressed_clip));
+
+    // the crowd is blended from the clip and the poses, on top of the bind
+    // pose, so whatever none of them move stays as it is in the bind pose.
+    if (fold_static_joints)
+    {
+        crowd_channel_plan = new JointChannelPlan(skeleton, poses[0]);
+        for (size_t pose = 1; pose < N_POSES; ++pose)
+            crowd_channel_plan->addPose(poses[pose]);
+        crowd_channel_plan->addClip(*compressed_clip);
+        crowd_channel_plan->build();
+        std::cerr << "Planned the crowd's joints: "
+                  << crowd_channel_plan->getOpcodeCount(JointChannelPlan::JOINT_OP_FOLDED) << " folded, "
+                  << crowd_channel_plan->getOpcodeCount(JointChannelPlan::JOINT_OP_STATIC) << " static, "
+                  << crowd_channel_plan->getOpcodeCount(JointChannelPlan::JOINT_OP_TRANSLATE) << " translate-only, "
+                  << crowd_channel_plan->getOpcodeCount(JointChannelPlan::JOINT_OP_ROTATE) << " rotate-only, "
+                  << crowd_channel_plan->getOpcodeCount(JointChannelPlan::JOINT_OP_FULL) << " full." << std::endl;
+    }
+    animation_events = new AnimationEventQueue(ANIMATION_EVENT_CAPACITY);
+    instance_event_cursors.assign(N_INSTANCES, AnimationEventCursor());
+
+    // joint 1 and its child 4 make up the red arm; the wave only works out
+    // their channels.
+    size_t joint_count = skeleton.getJointCount();
+    JointMask arm_mask(joint_count);
+    arm_mask.addSubtree(skeleton, 1);
+
+    crowd_wave_delta = skeleton.allocatePose();
+    makeAdditivePose(poses[2], poses[0], crowd_wave_delta);
+
+    crowd_graph = new BlendGraph(joint_count);
+    BlendGraph::NodeId body = crowd_graph->addLerp(crowd_graph->addInput(CROWD_INPUT_FROM),
+                                                   crowd_graph->addInput(CROWD_INPUT_TO),
+                                                   CROWD_PARAMETER_BLEND);
+    BlendGraph::NodeId wave = crowd_graph->addAdditiveDelta(body, crowd_graph->addInput(CROWD_INPUT_WAVE),
+                                                            CROWD_PARAMETER_WAVE, crowd_graph->addMask(arm_mask));
+    crowd_graph->compile(wave);
+
+    // each NUMA node's partition of the crowd keeps its poses, scratch and
+    // palettes in its own memory, so the jobs posing it, which start on
+    // the node's threads, don't reach across to another node for them.
+    for (size_t node = 0; node < numa_topology->getNodeCount(); ++node)
+        crowd_pose_pools.push_back(new PosePool(joint_count, 64, false, numa_topology, node));
+
+    // the clip sample and the graph's scratch poses only hold anything
+    // while an instance's blend job runs, so rather than every instance
+    // having a set, every thread which runs the jobs does; an instance
+    // keeps nothing but the poses it's drawn from.  The clip samples start
+    // as poses[0], for any channels the clip doesn't animate.
+    crowd_thread_pose_count = 1 + crowd_graph->getScratchPoseCount();
+    for (size_t i = 0; i < job_system->getThreadCount() * crowd_thread_pose_count; ++i)
+    {
+        crowd_thread_poses.push_back(skeleton.allocatePose());
+        if (i % crowd_thread_pose_count == 0)
+            streamCopyPose(poses[0], crowd_thread_poses.back());
+    }
 
-    poses[0].joints[3] = poses[0].joints[0];
-    poses[0].joints[3].color = color4(0.0f, 0.0f, 1.0f, 1.0f);
-    poses[0].joints[3].parent = &poses[0].joints[0];
-    poses[0].joints[3].translation = vec2(0.178710, -0.103178);
-    poses[0].joints[3].rotation = -30.0f;
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+    {
+        PosePool& pool = *crowd_pose_pools[getInstanceNode(instance)];
+        crowd_contexts.push_back(new BlendGraphContext(*crowd_graph));
+        crowd_contexts.back()->setInput(CROWD_INPUT_WAVE, crowd_wave_delta);
 
-    poses[0].joints[4] = poses[0].joints[1];
-    poses[0].joints[4].color = color4(1.0f, 1.0f, 0.0f, 1.0f);
-    poses[0].joints[4].parent = &poses[0].joints[1];
-    poses[0].joints[4].translation = vec2(0.475503, 0);
-    poses[0].joints[4].rotation = 0.0f;
+        crowd_previous_poses.push_back(pool.allocate());
+        crowd_evaluated_poses.push_back(pool.allocate());
+        crowd_poses.push_back(pool.allocate());
 
-    poses[0].joints[5] = poses[0].joints[4];
-    poses[0].joints[5].color = color4(0.0f, 1.0f, 1.0f, 1.0f);
-    poses[0].joints[5].parent = &poses[0].joints[2];
+        float offset = std::fmod(instance * 0.618034f, 1.0f);
+        instance_share_groups.push_back(std::min(size_t(offset * N_SHARE_GROUPS), N_SHARE_GROUPS - 1));
+    }
 
-    poses[0].joints[6] = poses[0].joints[4];
-    poses[0].joints[6].color = color4(1.0f, 0.0f, 1.0f, 1.0f);
-    poses[0].joints[6].parent = &poses[0].joints[3];
+    crowd_animation_lod = new AnimationLodScheduler(ANIMATION_LOD_LEVELS, N_MESH_LODS, instance_share_groups);
+    crowd_state_cache = new AnimationStateCache(N_INSTANCES);
+    crowd_states.resize(N_INSTANCES);
+    leader_palettes = new NumaPartitionedArray<mat4>(*numa_topology, N_INSTANCES, skeleton.getJointCount());
+    crowd_stage_jobs.resize(N_INSTANCES);
+    staged_palettes.resize(N_INSTANCES * skeleton.getJointCount());
+    staged_palette_lods.assign(N_INSTANCES, GLuint(-1));
+    staged_palette_generations.assign(N_INSTANCES, 0);
+
+    crowd_jiggle = new JiggleChains(skeleton, N_INSTANCES);
+    crowd_jiggle->addJoint(REACH_CHAIN.mid_joint, JIGGLE_STIFFNESS, JIGGLE_DAMPING);
+    crowd_jiggle->addJoint(left_foot_chain.joints.back(), JIGGLE_STIFFNESS, JIGGLE_DAMPING);
+    crowd_jiggle->addJoint(RIGHT_FOOT_CHAIN.mid_joint, JIGGLE_STIFFNESS, JIGGLE_DAMPING);
+}
 
-    poses[1] = poses[0];
-    poses[1].joints[1].parent = &poses[1].joints[0];
-    poses[1].joints[1].rotation = 45.0f;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds the demo's built-in rig: DemoRigEval's skeleton, its
+///         sockets, and the poses.
+void buildRig()
+{
+    DemoRigEval::buildSkeleton(skeleton);
+    mat4 limb_end = glm::translate(mat4(1), vec3(LIMB_END_OFFSET, 0));
+    skeleton.addSocket("hand", 4, limb_end);
+    skeleton.addSocket("left_foot", 5, limb_end);
+    skeleton.addSocket("right_foot", 6, limb_end);
+
+    // only the poses the mesh's colors come from have them; the crowd's are
+    // just transforms.
+    for (size_t pose = 0; pose < N_POSES; ++pose)
+        poses[pose] = skeleton.allocatePose(true);
+
+    // poses[0] => bind pose.
+    // start with every joint at its parent's origin with no rotation or scaling.
+    for (size_t joint = 0; joint < skeleton.getJointCount(); ++joint)
+    {
+        poses[0].translation[joint] = vec2(0, 0);
+        poses[0].rotation[joint] = 0.0f;
+        poses[0].scale[joint] = 1.0f;
+    }
+
+    poses[0].color[0] = color4(1.0f, 1.0f, 1.0f, 1.0f);
+
+    poses[0].color[1] = color4(1.0f, 0.0f, 0.0f, 1.0f);
+    poses[0].translation[1] = vec2(0, 0.206357);
+    poses[0].rotation[1] = 90.0f;
+
+    poses[0].color[2] = color4(0.0f, 1.0f, 0.0f, 1.0f);
+    poses[0].translation[2] = vec2(-0.178710, -0.103178);
+    poses[0].rotation[2] = 210.0f;
+
+    poses[0].color[3] = color4(0.0f, 0.0f, 1.0f, 1.0f);
+    poses[0].translation[3] = vec2(0.178710, -0.103178);
+    poses[0].rotation[3] = -30.0f;
+
+    poses[0].color[4] = color4(1.0f, 1.0f, 0.0f, 1.0f);
+    poses[0].translation[4] = vec2(0.475503, 0);
+
+    poses[0].color[5] = color4(0.0f, 1.0f, 1.0f, 1.0f);
+    poses[0].translation[5] = vec2(0.475503, 0);
+
+    poses[0].color[6] = color4(1.0f, 0.0f, 1.0f, 1.0f);
+    poses[0].translation[6] = vec2(0.475503, 0);
+    skeleton.setBindPose(poses[0]);
+
+    copyPose(poses[0], poses[1]);
+    poses[1].rotation[1] = 45.0f;
+    poses[1].rotation[2] = 165.0f;
+    poses[1].rotation[3] = -75.0f;
+    poses[1].rotation[4] = -45.0f;
+    poses[1].rotation[5] = -45.0f;
+    poses[1].rotation[6] = -45.0f;
+
+    copyPose(poses[0], poses[2]);
+    poses[2].rotation[1] = 135.0f;
+    poses[2].rotation[2] = 255.0f;
+    poses[2].rotation[3] = 15.0f;
+    poses[2].rotation[4] = 45.0f;
+    poses[2].rotation[5] = 45.0f;
+    poses[2].rotation[6] = 45.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Loads the skeleton and the poses from the rig file given with
+///         -rig.
+///
+/// \details The demo's built-in mesh is weighted to DemoRigEval's joints,
+///         and the hierarchy is evaluated with it, so the file's joints
+///         must have the same parents; everything else about them, their
+///         bind pose, colors and sockets, is up to the file.  poses[1] and
+///         poses[2] are the file's "lowered" and "raised" poses.
+void loadRig()
+{
+    std::vector<RigFilePose> rig_poses;
+    loadRigFile(rig_path, skeleton, rig_poses);
+
+    const RigFilePose* named[N_POSES] = { &rig_poses[0] };
+    for (size_t pose = 1; pose < N_POSES; ++pose)
+        named[pose] = findRigPose(rig_poses, RIG_POSE_NAMES[pose]);
+
+    if (!DemoRigEval::matches(skeleton) || named[1] == nullptr || named[2] == nullptr)
+    {
+        std::cerr << "Error loading rig file!" << std::endl
+                  << "   File: " << rig_path << std::endl
+                  << "  Error: The demo needs the built-in rig's joints, and poses named \""
+                  << RIG_POSE_NAMES[1] << "\" and \"" << RIG_POSE_NAMES[2] << "\"." << std::endl;
+        throw std::runtime_error("Error loading rig file!");
+    }
+
+    for (size_t pose = 0; pose < N_POSES; ++pose)
+    {
+        poses[pose] = skeleton.allocatePose(true);
+        copyPose(named[pose]->pose, poses[pose]);
+    }
+    for (size_t pose = 0; pose < rig_poses.size(); ++pose)
+        skeleton.releasePose(rig_poses[pose].pose);
+
+    std::cerr << "Loaded the rig from " << rig_path << " (" << skeleton.getJointCount() << " joints, "
+              << skeleton.getSocketCount() << " sockets, " << rig_poses.size() << " poses)." << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Opens the clip database given with -clips, and plays its first
+///         clip in place of compressed_clip.
+///
+/// \details If the file doesn't exist yet, compressed_clip is saved to it
+///         first, as a library of one clip.  Opening the database only reads
+///         its index; the clip is prefetched as soon as it's open, since it's
+///         about to play, and unpacked when the samplers are made.  A game
+///         would prefetch the clips a transition or an area will need while
+///         the current ones play, and only start a clip once
+///         ClipDatabase::isResident() says it's in memory.
+void openClipDatabase()
+{
+    if (!std::ifstream(clip_database_path.c_str(), std::ios::in | std::ios::binary))
+    {
+        ClipDatabase::save(std::vector<const CompressedClip*>(1, compressed_clip), clip_database_path);
+        std::cerr << "Saved the animation clip to " << clip_database_path << "." << std::endl;
+    }
+
+    clip_database = new ClipDatabase(clip_database_path);
+    if (clip_database->getClipCount() == 0 || clip_database->getJointCount(0) != skeleton.getJointCount())
+    {
+        std::cerr << "Error loading clip database!" << std::endl
+                  << "   File: " << clip_database_path << std::endl
+                  << "  Error: The database's first clip isn't for the demo's skeleton." << std::endl;
+        throw std::runtime_error("Error loading clip database!");
+    }
+
+    clip_database->prefetch(0);
+    delete compressed_clip;
+    compressed_clip = &clip_database->getClip(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Cleans up the demo in preparation for exit.  Releases all OpenGL
+///         resources remaining.
+void cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(simulation_mutex);
+        simulation_stopping = true;
+    }
+    simulation_wake.notify_one();
+    simulation_thread.join();
+    stopRagdoll();
+    delete ragdoll;
+    delete physics_input;
+    delete simulation_arena;
+
+    delete session_recorder;
+    delete session_player;
+    delete file_watcher;
+    delete reload_cache;
+    delete reload_program_set;
+    delete mesh_upload_queue;
+    glDeleteProgram(vertex_decode_program_id);
+
+    // the skinning programs are owned by skinning_program_set.
+    delete skinning_program_set;
+    for (size_t mode = 0; mode < N_SKINNING_MODES; ++mode)
+    {
+        for (size_t influences = 0; influences < MAX_JOINT_INFLUENCES; ++influences)
+        {
+            skinning_programs[mode][influences].id = 0;
+            skinning_programs[mode][influences].feedback_id = 0;
+            skinning_programs[mode][influences].wireframe_id = 0;
+            skinning_programs[mode][influences].motion_vector_id = 0;
+        }
+    }
+
+    for (size_t lod = 1; lod < mesh_lod_count; ++lod)
+        delete mesh_lods[lod];
+
+    glDeleteProgram(passthrough_program_id);
+    glDeleteProgram(passthrough_wireframe_program_id);
+    glDeleteProgram(shadow_program_id);
+    glDeleteProgram(occlusion_proxy_program_id);
+    delete occlusion_queries;
+
+    delete impostor_atlas;
+    glDeleteProgram(impostor_program_id);
+    glDeleteVertexArrays(1, &impostor_vao_id);
+    glDeleteTextures(1, &impostor_texture_id);
+    glDeleteBuffers(1, &impostor_buffer_id);
+
+    if (compute_skinner != nullptr)
+    {
+        delete compute_skinner;
+        glDeleteProgram(compute_skinning_program_id);
+        glDeleteProgram(compute_draw_program_id);
+        glDeleteProgram(compute_draw_wireframe_program_id);
+        glDeleteProgram(shadow_compute_program_id);
+    }
+    delete skinned_bounds_pass;
+    glDeleteProgram(skinned_bounds_program_id);
+    if (crowd_hierarchy_pass != nullptr)
+    {
+        delete crowd_hierarchy_pass;
+        delete crowd_hierarchy_levels;
+        glDeleteProgram(local_expand_program_id);
+        glDeleteProgram(crowd_hierarchy_program_id);
+        glDeleteProgram(palette_resolve_program_id);
+    }
+
+    delete skinning_gpu_timer;
+    delete debug_draw_gpu_timer;
+    delete compare_gpu_timer;
+    delete skinning_balancer;
+    if (latency_tracker != nullptr)
+    {
+        std::cerr << "Input latency, from each mouse event to the frame answering it:" << std::endl
+                  << latency_tracker->formatSummary();
+        delete latency_tracker;
+    }
+    delete render_target;
+    delete resolution_controller;
+    delete backend_calibrator;
+    delete backend_calibration;
+    delete debug_draw;
+    delete render_queue;
+    if (instance_cull_pass != nullptr)
+    {
+        delete instance_cull_pass;
+        glDeleteProgram(instance_cull_program_id);
+    }
+    delete residency_manager;
+    delete mesh_arena;
+    delete skinned_vertex_cache;
+    delete skinning_stream;
+    delete shadow_pass;
+    delete frame_graph;
+    delete cpu_skinner;
+    delete mesh_picker;
+    delete thread_pool;
+    delete job_system;
+    delete asset_epochs;
+    delete vertex_color_cache;
+    for (size_t v = 0; v < N_CROWD_VARIANTS - 1; ++v)
+    {
+        for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+            delete crowd_variants[v][lod];
+        delete crowd_variant_colors[v];
+    }
+    if (morph_target_pass != nullptr)
+    {
+        delete morph_target_pass;
+        glDeleteProgram(morph_target_program_id);
+    }
+    meshes.clear();
+    delete skinning_palette_buffer;
+    delete camera_buffer;
+
+    glDeleteTextures(1, &instance_palette_texture_id);
+    glDeleteTextures(1, &palette_texture_id);
+    glDeleteBuffers(1, &palette_texture_buffer_id);
+    glDeleteTextures(1, &instance_half_palette_texture_id);
+    glDeleteTextures(1, &instance_origin_texture_id);
+    delete palette_ring;
+    delete palette_stream;
+
+    delete baked_clip;
+    glDeleteTextures(1, &baked_instance_texture_id);
+    glDeleteBuffers(1, &baked_instance_buffer_id);
+
+    for (size_t pose = 0; pose < N_POSES; ++pose)
+        skeleton.releasePose(poses[pose]);
+
+    delete current_pose_transforms;
+    delete palette_cache;
+    delete instant_replay_buffer;
+    delete fixed_pose_evaluator;
+    delete pose_correctives;
+    skeleton.releasePose(current_pose);
+    for (size_t instance = 0; instance < crowd_contexts.size(); ++instance)
+    {
+        delete crowd_contexts[instance];
+        PosePool& pool = *crowd_pose_pools[getInstanceNode(instance)];
+        pool.release(crowd_previous_poses[instance]);
+        pool.release(crowd_evaluated_poses[instance]);
+        pool.release(crowd_poses[instance]);
+    }
+    crowd_contexts.clear();
+    for (size_t i = 0; i < crowd_thread_poses.size(); ++i)
+        skeleton.releasePose(crowd_thread_poses[i]);
+    crowd_thread_poses.clear();
+    for (size_t node = 0; node < crowd_pose_pools.size(); ++node)
+        delete crowd_pose_pools[node];
+    crowd_pose_pools.clear();
+    delete leader_palettes;
+    delete crowd_jiggle;
+    delete crowd_channel_plan;
+    delete instance_joint_transforms;
+    delete leader_compact_locals;
+    delete crowd_graph;
+    skeleton.releasePose(crowd_wave_delta);
+    delete crowd_animation_lod;
+    delete crowd_state_cache;
+
+    instance_samplers.clear();
+    instance_event_cursors.clear();
+    delete animation_events;
+    delete clip_sampler;
+    if (clip_database == nullptr)
+        delete compressed_clip;
+    delete clip_database;
+    clips.clear();
+
+    // the meshes' GL objects were only queued as they were destroyed.
+    gl_deletion_queue.flush();
+    delete asset_loader;
+    delete numa_topology;
+
+    // every other thread has finished, so the trace is complete.
+    delete trace_writer;
+    delete stats_log;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts watching the skinning shader sources, and the mesh file
+///         and clip database, if they were loaded, for changes.
+void startHotReload()
+{
+    file_watcher = new FileWatcher();
+    file_watcher->watch(SKINNING_VERTEX_SHADER_PATH, FileWatcher::FILE_TEXT);
+    file_watcher->watch(SKINNING_FRAGMENT_SHADER_PATH, FileWatcher::FILE_TEXT);
+    if (!mesh_path.empty())
+    {
+        // with -gpu-decode, a quantized mesh crosses the bus as vertex
+        // blocks, packed by the watcher's thread.
+        bool vertex_blocks = vertex_decode_program_id != 0;
+        file_watcher->watch(mesh_path, vertex_blocks ? FileWatcher::FILE_MESH_BLOCKS : FileWatcher::FILE_MESH);
+        mesh_upload_queue = new MeshUploadQueue(MESH_UPLOAD_BYTES_PER_FRAME);
+        mesh_upload_queue->setVertexDecodeProgram(vertex_decode_program_id);
+        streamed_mesh_handle = meshes.add(std::unique_ptr<SkeletalMesh>(new SkeletalMesh()));
+        streamed_mesh = meshes.get(streamed_mesh_handle)->get();
+        streamed_mesh->setDeletionQueue(&gl_deletion_queue);
+    }
+    if (clip_database != nullptr)
+        file_watcher->watch(clip_database_path, FileWatcher::FILE_CLIPS);
+
+    render_loop->addTimer(HOT_RELOAD_POLL_MILLISECONDS, hotReloadTimer, nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Swaps in whatever the FileWatcher has read, at the start of a
+///         frame.
+///
+/// \details The watcher has already read the files on its own thread.  The
+///         skinning programs are rebuilt through a ProgramCache without
+///         waiting on the driver, and only checked and swapped in at the
+///         start of the next frame, so drivers which compile on background
+///         threads get a whole frame to do it.  If they don't build, the
+///         errors are reported and the previous programs are kept.  Platform
+///         doesn't create shared contexts for another thread to compile
+///         with, so this is as far off the render thread as the compile
+///         can get.
+///
+///         A reloaded mesh is streamed in by mesh_upload_queue, a budget's
+///         worth each frame, and only swapped in once all of it has reached
+///         the GPU.
+void applyHotReload()
+{
+    asset_epochs->reclaim();
+    if (mesh_upload_queue != nullptr)
+    {
+        mesh_upload_queue->update(MESH_UPLOAD_BYTES_PER_FRAME);
+        if (mesh_streaming && !mesh_upload_queue->isPending(*streamed_mesh))
+        {
+            mesh_streaming = false;
+            reloadMesh();
+        }
+        else if (mesh_streaming)
+            requestFrame();
+    }
+
+    // the driver may still be compiling; the timer keeps asking for frames
+    // until it's done, and the old programs draw them.
+    if (reload_cache != nullptr && reload_cache->isReady())
+    {
+        try
+        {
+            reload_cache->finish();
+
+            delete skinning_program_set;
+            skinning_program_set = reload_program_set;
+            useSkinningPrograms(*skinning_program_set);
+            setSkinningProgramUniforms();
+            std::cerr << "Skinning shaders reloaded: " << reload_cache->getMissCount() << " compiled." << std::endl;
+        }
+        catch (const std::runtime_error&)
+        {
+            // finish() has already reported the errors.
+            std::cerr << "Keeping the previous skinning shaders." << std::endl;
+            delete reload_program_set;
+        }
+
+        delete reload_cache;
+        reload_cache = nullptr;
+        reload_program_set = nullptr;
+    }
+
+    std::vector<FileWatcher::Change> changes;
+    file_watcher->takeChanges(changes);
+    for (size_t i = 0; i < changes.size(); ++i)
+    {
+        FileWatcher::Change& change = changes[i];
+        if (change.kind == FileWatcher::FILE_MESH)
+        {
+            if (hasMeshLayout(change.mesh))
+            {
+                mesh_upload_queue->enqueue(*streamed_mesh, change.mesh);
+                mesh_streaming = true;
+                requestFrame();
+            }
+            else
+                std::cerr << "The layout of " << mesh_path << " has changed; restart the demo to load it." << std::endl;
+        }
+        else if (change.kind == FileWatcher::FILE_CLIPS)
+            reloadClip(*change.clip);
+        else if (change.path == SKINNING_VERTEX_SHADER_PATH)
+            skinning_vertex_source = change.text;
+        else
+            skinning_fragment_source = change.text;
+
+        if (change.kind == FileWatcher::FILE_TEXT)
+            skinning_sources_changed = true;
+    }
+
+    // sources which change while a rebuild is in flight wait for it.
+    if (skinning_sources_changed && reload_cache == nullptr)
+    {
+        skinning_sources_changed = false;
+        reload_cache = new ProgramCache(SHADER_CACHE_DIRECTORY);
+        reload_program_set = new SkinningProgramSet(skinning_vertex_source, skinning_fragment_source);
+        requestSkinningPrograms(*reload_cache, *reload_program_set);
+        requestFrame();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks whether a reloaded mesh file can be swapped in for the
+///         mesh.
+///
+/// \details Only files with the same layout as the mesh (the same vertex
+///         format, number of vertices and indices, and partitions) can be;
+///         anything else would mean rebuilding the programs, the arena, the
+///         skinners and the caches, which is no quicker than restarting.
+bool hasMeshLayout(const MeshFileData& data)
+{
+    const std::vector<SkeletalMesh::Partition>& partitions = mesh->getPartitions();
+    bool same_layout = data.vertex_format == mesh->vertex_format &&
+                       data.vertex_count == mesh->getVertexCount() &&
+                       data.index_type == mesh->getIndexType() &&
+                       data.index_count == mesh->getIndexCount() &&
+                       data.partitions.size() == partitions.size();
+    for (size_t i = 0; same_layout && i < partitions.size(); ++i)
+    {
+        const SkeletalMesh::Partition& a = data.partitions[i];
+        const SkeletalMesh::Partition& b = partitions[i];
+        same_layout = a.influence_count == b.influence_count && a.index_count == b.index_count &&
+                      a.first_index == b.first_index && a.vertex_count == b.vertex_count &&
+                      a.first_vertex == b.first_vertex;
+    }
+    return same_layout;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies the reloaded mesh in streamed_mesh over the mesh, and
+///         refreshes everything derived from its vertices.
+void reloadMesh()
+{
+    // the simulation thread culls the crowd with lod_joint_bounds, which
+    // are replaced rather than rebuilt in place, so it carries on with the
+    // previous mesh's until its next frame.
+    mesh->copyData(*streamed_mesh);
+    computeLodJointBounds(0);
+    skinning_stream->update();
+
+    // the reloaded vertices are only on the GPU, so the CPU can't skin any
+    // of the compute crowd any more.
+    if (skinning_balancer != nullptr)
+    {
+        compute_skinner->setCpuVertices(nullptr, std::vector<Vertex>());
+        delete skinning_balancer;
+        skinning_balancer = nullptr;
+    }
+
+    // the colors are read back from the new vertices, and laid out like the
+    // arena, as in initGL().
+    size_t first_vertex = 0;
+    if (mesh_arena != nullptr)
+    {
+        mesh_arena->remove(mesh_allocations[0]);
+        if (!mesh_arena->add(*mesh, mesh_allocations[0]))
+            throw std::runtime_error("The mesh doesn't fit in its MeshArena.");
+        first_vertex = mesh_allocations[0].first_vertex;
+        if (instance_cull_pass != nullptr)
+            createInstanceCullPass();
+    }
+
+    vertex_color_cache->addMesh(*mesh, first_vertex);
+    vertex_color_cache->attach(mesh->vao_id, first_vertex);
+    if (mesh_arena != nullptr)
+        vertex_color_cache->attach(mesh_arena->getVertexArray(mesh->vertex_format), 0);
+
+    // the variants share the full mesh's buffers, so they're pointed at the
+    // new ones; their own colors are blended again on the next frame.
+    for (size_t v = 0; v < N_CROWD_VARIANTS - 1; ++v)
+    {
+        crowd_variants[v][0]->update();
+        crowd_variant_colors[v]->addMesh(*mesh, first_vertex);
+        crowd_variant_colors[v]->attach(crowd_variants[v][0]->getVertexArray(), first_vertex);
+    }
+
+    std::cerr << "Reloaded " << mesh_path << "." << std::endl;
+    requestFrame();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Publishes a reloaded clip database's first clip, for the
+///         simulation thread to play from its next frame.
+///
+/// \details The clip replaces whichever one was playing whole, so it has
+///         to be for the demo's skeleton.  With -fold-static-joints, the
+///         crowd's channel plan was built from the clips it started with,
+///         and anything the new one animates that they didn't would be left
+///         out, so the previous clip is kept.  The baked crowd plays the
+///         clip it baked before the database was opened, and carries on.
+void reloadClip(const CompressedClip& loaded)
+{
+    if (loaded.getJointCount() != skeleton.getJointCount())
+    {
+        std::cerr << "The first clip in " << clip_database_path << " isn't for the demo's skeleton; "
+                  << "keeping the previous clip." << std::endl;
+        return;
+    }
+    if (crowd_channel_plan != nullptr)
+    {
+        std::cerr << "The crowd's channel plan was built from the previous clip; restart the demo to play the "
+                  << "reloaded one." << std::endl;
+        return;
+    }
+
+    reloaded_clip.publish(std::unique_ptr<CompressedClip>(new CompressedClip(loaded)), *asset_epochs);
+    std::cerr << "Reloaded " << clip_database_path << "." << std::endl;
+    requestFrame();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Points the samplers at a reloaded clip, on the simulation
+///         thread, before the frame samples anything.
+///
+/// \details The sampled poses which were cached from the previous clip
+///         are dropped, every instance is due to be evaluated again, and
+///         the clip's events start over.
+///         The samplers keep pointing at the clip after the frame has
+///         unpinned it; they're only used again once the next frame has
+///         checked reloaded_clip's serial, and pinned whichever clip it
+///         finds.
+void playReloadedClip(const CompressedClip& reloaded)
+{
+    sampled_clip = &reloaded;
+    *clip_sampler = CompressedClipSampler(reloaded);
+    instance_samplers.assign(N_INSTANCES, CompressedClipSampler(reloaded));
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+        instance_event_cursors[instance].reset();
+    palette_cache->clear();
+    drawn_pose_keyed = false;
+    crowd_animation_lod->reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits until the simulation thread has finished every request
+///         posted so far, so that the data it reads can be changed.
+void waitForSimulation()
+{
+    std::unique_lock<std::mutex> lock(simulation_mutex);
+    while (simulation_request_pending || published_serial != last_request.serial)
+        packet_published.wait(lock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Timer callback which asks for a frame when there's anything for
+///         applyHotReload() to do, since the demo stops drawing when nothing
+///         is moving.  The assets reloads have replaced are freed here too,
+///         so it doesn't take another frame.
+void hotReloadTimer(void* data)
+{
+    asset_epochs->reclaim();
+    if (reload_cache != nullptr || mesh_streaming || file_watcher->hasChanges())
+        requestFrame();
+
+    render_loop->addTimer(HOT_RELOAD_POLL_MILLISECONDS, hotReloadTimer, nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Window callback handling resize events.  The window posts a
+///         redisplay after it.
+///
+/// \param width The window's new width.
+/// \param height The window's new height.
+void reshape(PlatformWindow& window, GLsizei width, GLsizei height)
+{
+    viewport.x = width;
+    viewport.y = height;
+    glViewport(0, 0, width, height);
+    render_target->setWindowSize(width, height);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Window callback to render a frame.
+///
+/// \details There is remarkably little needed to render a skeletal mesh:
+///         just bind the right shader program and vertex array and make sure
+///         the shader's uniforms are up-to-date, then call glDrawElements.
+///
+///         Everything is drawn from the latest FramePacket.  The simulation
+///         thread is asked for the next one before this one is drawn, so it
+///         animates frame N + 1 while this thread submits frame N.
+void display(PlatformWindow& window)
+{
+    TRACE_SCOPE("display");
+
+    // GL work other threads have queued happens here, before anything of
+    // this frame's.
+    gl_deletion_queue.flush();
+    asset_loader->update();
+    applyHotReload();
+
+    // last frame's bounds, or the one's before, are usually ready by now.
+    if (skinned_bounds_pass != nullptr)
+        skinned_bounds_pass->collect();
+
+    double frame_start = getTimeMilliseconds();
+    size_t steps = frame_scheduler.beginFrame(frame_start);
+
+    // the packet being replaced is what the new one's palette is blended from.
+    if (palette_rate > 0 && frame_packets.hasFreshPacket() && frame_packets.hasPacket())
+    {
+        const FramePacket& previous = frame_packets.getReadPacket();
+        previous_palette_valid = previous.skinning_mode == SKINNING_MODE_DUAL_QUAT ||
+                                 previous.compare_mode == SKINNING_MODE_DUAL_QUAT;
+        if (previous_palette_valid)
+        {
+            previous_dq_palette = previous.dual_quat_palette;
+            previous_palette_scales = previous.palette_scales;
+        }
+        palette_arrival_milliseconds = frame_start;
+    }
+    if (acquirePacket())
+    {
+        pose_stats.addSample(frame_packets.getReadPacket().pose_milliseconds);
+        palette_stats.addSample(frame_packets.getReadPacket().palette_milliseconds);
+    }
+
+    AnimationNotify notify;
+    while (animation_events->pop(notify))
+    {
+        if (notify.id < N_CLIP_EVENTS)
+            ++clip_event_counts[notify.id];
+    }
+
+    // the queries the GPU has finished answer for the next request.
+    if (occlusion_culling)
+    {
+        occlusion_queries->collectResults();
+        for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+            occlusion_hidden_counts[instance] =
+                GLuint(std::min(occlusion_queries->getHiddenCount(instance), OCCLUSION_POSE_SKIP_COUNT));
+    }
+
+    if (session_player != nullptr)
+        postReplayRequest();
+    else
+        postSimulationRequest(steps, float(frame_scheduler.getInterpolation()));
+
+    // the very first frame has nothing to draw until the simulation has
+    // produced something.
+    if (!frame_packets.hasPacket())
+    {
+        std::unique_lock<std::mutex> lock(simulation_mutex);
+        while (published_serial == 0)
+            packet_published.wait(lock);
+        lock.unlock();
+        acquirePacket();
+    }
+
+    const FramePacket& packet = frame_packets.getReadPacket();
+    SkinningMode packet_mode = packet.skinning_mode;
+    bool comparing = packet.compare_mode != N_SKINNING_MODES;
+    size_t joint_count = skeleton.getJointCount();
+    if (latency_tracker != nullptr)
+        latency_tracker->beginFrame(packet.serial, packet.input_milliseconds, packet.posed_milliseconds);
+
+    FrameStats stats;
+    stats.frame = last_frame_stats.frame + 1;
+
+    // the latest GPU timings are a couple of frames old, which the
+    // controller allows for.
+    if (adaptive_resolution)
+    {
+        double gpu_milliseconds = skinning_gpu_timer->getStats().getLatest();
+        if (draw_joints)
+            gpu_milliseconds += debug_draw_gpu_timer->getStats().getLatest();
+        if (comparing)
+            gpu_milliseconds += compare_gpu_timer->getStats().getLatest();
+        render_target->setScale(resolution_controller->update(gpu_milliseconds));
+    }
+
+    // so are the compute crowd's, which the split between the GPU and the
+    // CPU is chosen from, along with how busy the job threads were since
+    // the last frame.
+    size_t cpu_skinned_instances = 0;
+    if (skinning_balancer != nullptr)
+    {
+        double busy_milliseconds = job_system->getBusyMilliseconds();
+        double elapsed = frame_start - balance_frame_milliseconds;
+        double idle = 1.0;
+        if (balance_frame_milliseconds > 0 && elapsed > 0)
+            idle = glm::clamp(1.0 - (busy_milliseconds - balance_busy_milliseconds) /
+                                    (elapsed * job_system->getThreadCount()), 0.0, 1.0);
+        balance_busy_milliseconds = busy_milliseconds;
+        balance_frame_milliseconds = frame_start;
+
+        // the CPU can't skin palettes which are only resolved on the GPU.
+        if (packet_mode == SKINNING_MODE_COMPUTE && !packet.hierarchy_on_gpu)
+        {
+            size_t cpu_count = compute_skinner->getCpuCount();
+            float share = skinning_balancer->update(compute_skinner->getVisibleCount() - cpu_count, cpu_count,
+                                                    skinning_gpu_timer->getStats().getLatest(),
+                                                    compute_skinner->getCpuMilliseconds(), idle);
+            cpu_skinned_instances = size_t(share * packet.visible_instances.size() + 0.5f);
+        }
+        else
+            skinning_balancer->reset();
+    }
+
+    // the proxies are depth tested, so the depth has to be cleared for them.
+    render_target->bind();
+    glClear(packet.occlusion_culled ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT);
+    double draw_start = getTimeMilliseconds();
+
+    float palette_blend = 1.0f;     // how far the dual quaternions are blended from the last packet's
+    GLint palette_region_base = 0;  // where the full palettes start in palette_ring
+    {
+        TRACE_SCOPE("palette upload");
+        ScopedTimer timer(upload_stats);
+
+        // every program draws through the packet's camera; like the
+        // SkinningPalette block, the bound copy is kept while it's unchanged.
+        if (!camera_uploaded || packet.camera != uploaded_camera)
+        {
+            CameraBlock block = packet.camera.getBlock();
+            std::memcpy(camera_buffer->map(), &block, sizeof(block));
+            camera_buffer->unmap(CAMERA_BINDING);
+            uploaded_camera = packet.camera;
+            camera_uploaded = true;
+        }
+
+        // streamed palettes are already in the packet's buffer, so the
+        // texture just has to be pointed at it.
+        // the full palettes written into the ring are counted as they're
+        // written, since only the ones which changed are.
+        bool half_palettes_drawn = packet_mode == SKINNING_MODE_INSTANCED && packet.half_palettes_packed;
+        bool palettes_written = packet_mode == SKINNING_MODE_INSTANCED && !half_palettes_drawn &&
+                                !packet.palettes_streamed;
+        if ((packet_mode == SKINNING_MODE_INSTANCED || packet_mode == SKINNING_MODE_COMPUTE) && !palettes_written)
+        {
+            stats.palettes_uploaded += packet.visible_instances.size();
+            if (half_palettes_drawn)
+                stats.palette_bytes_uploaded += packet.half_palettes.size() * sizeof(glm::hvec4) +
+                                                packet.instance_origins.size() * sizeof(vec4);
+            else if (packet.hierarchy_on_gpu)
+                stats.palette_bytes_uploaded += packet.leader_locals.size() * sizeof(vec4) +
+                                                packet.palette_targets.size() * sizeof(HierarchyComputePass::PaletteTarget);
+            else
+                stats.palette_bytes_uploaded += packet.instance_palette_count * sizeof(mat4);
+        }
+
+        // the rest are written into this frame's region of the ring, which
+        // the GPU has long since finished reading, so nothing is orphaned
+        // and nothing waits.  The shaders count from where the region
+        // starts, in whichever matrices and origins it holds.
+        GLint region_matrix = 0;
+        GLint region_origin = 0;
+        GLint previous_region_matrix = 0;
+        GLint previous_region_origin = 0;
+        palette_layout.swap(previous_palette_layout);
+        palette_layout.clear();
+        if (half_palettes_drawn && !packet.half_palettes.empty())
+        {
+            size_t half_palette_bytes = packet.half_palettes.size() * sizeof(glm::hvec4);
+            size_t origin_offset = (half_palette_bytes + sizeof(vec4) - 1) / sizeof(vec4) * sizeof(vec4);
+            size_t origin_bytes = packet.instance_origins.size() * sizeof(vec4);
+            char* region = static_cast<char*>(palette_ring->map(GLsizeiptr(origin_offset + origin_bytes)));
+            std::memcpy(region, packet.half_palettes.data(), half_palette_bytes);
+            std::memcpy(region + origin_offset, packet.instance_origins.data(), origin_bytes);
+            palette_ring->unmap();
+            region_palette_layouts[palette_ring->getRegionIndex()].clear();
+
+            region_matrix = GLint(palette_ring->getRegionOffset() / (3 * sizeof(glm::hvec4)));
+            region_origin = GLint((palette_ring->getRegionOffset() + origin_offset) / sizeof(vec4));
+            if (motion_vectors && recordPaletteLayout(packet, true))
+            {
+                previous_region_matrix = GLint(palette_ring->getPreviousRegionOffset() / (3 * sizeof(glm::hvec4)));
+                previous_region_origin = GLint((palette_ring->getPreviousRegionOffset() + origin_offset) / sizeof(vec4));
+            }
+            else
+            {
+                previous_region_matrix = region_matrix;
+                previous_region_origin = region_origin;
+            }
+        }
+        else if (packet_mode == SKINNING_MODE_INSTANCED && packet.palettes_streamed)
+        {
+            glBindTexture(GL_TEXTURE_BUFFER, instance_palette_texture_id);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, packet.palette_stream_buffer_id);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+        else if (packet_mode == SKINNING_MODE_INSTANCED && !packet.instance_palettes.empty())
+        {
+            bool layout_kept = recordPaletteLayout(packet, false);
+            writeInstancePalettes(packet, stats);
+            region_matrix = GLint(palette_ring->getRegionOffset() / sizeof(mat4));
+            previous_region_matrix = motion_vectors && layout_kept
+                                   ? GLint(palette_ring->getPreviousRegionOffset() / sizeof(mat4)) : region_matrix;
+
+            glBindTexture(GL_TEXTURE_BUFFER, instance_palette_texture_id);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette_ring->getBufferId());
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+        glVertexAttribI3i(PaletteRing::REGION_ATTRIBUTE, region_matrix, region_origin, half_palettes_drawn ? 1 : 0);
+        glVertexAttribI3i(PaletteRing::PREVIOUS_REGION_ATTRIBUTE, previous_region_matrix, previous_region_origin,
+                          half_palettes_drawn ? 1 : 0);
+        palette_region_base = half_palettes_drawn ? 0 : region_matrix;
+
+        // fill in this frame's copy of the SkinningPalette block; it's shared by
+        // all of the partitions' programs.  If nothing in it has changed, the
+        // copy that's still bound is drawn with again.  A copy can't just be
+        // patched, since the next region of the ring holds an older frame.
+        bool blend_palettes = palette_rate > 0 && (packet_mode == SKINNING_MODE_DUAL_QUAT ||
+                                                   packet.compare_mode == SKINNING_MODE_DUAL_QUAT);
+        if (blend_palettes && previous_palette_valid)
+            palette_blend = float(glm::clamp((frame_start - palette_arrival_milliseconds) * palette_rate / 1000.0,
+                                             0.0, 1.0));
+        if (packet_mode == SKINNING_MODE_TEXTURE_PALETTE)
+        {
+            size_t texture_bytes = uploadPaletteTexture(packet);
+            if (texture_bytes > 0)
+                ++stats.palettes_uploaded;
+            stats.palette_bytes_uploaded += texture_bytes;
+        }
+        else if (packet.block_version != uploaded_block_version ||
+                 (blend_palettes && palette_blend != uploaded_palette_blend))
+        {
+            char* block = static_cast<char*>(skinning_palette_buffer->map());
+            size_t block_bytes = packSkinningPaletteBlock(packet, packet_mode, palette_blend, block);
+            skinning_palette_buffer->unmap(SKINNING_PALETTE_BINDING);
+            uploaded_block_version = packet.block_version;
+            uploaded_palette_blend = palette_blend;
+
+            ++stats.palettes_uploaded;
+            stats.palette_bytes_uploaded += block_bytes;
+        }
+
+        // the vertices' colors only need reblending when the joints' change,
+        // and the morph targets only need applying when their weights do.
+        vertex_color_cache->update(packet.colors.data(), joint_count);
+        crowd_variant_joint_colors.resize(joint_count);
+        for (size_t v = 1; v < N_CROWD_VARIANTS; ++v)
+        {
+            for (size_t joint = 0; joint < joint_count; ++joint)
+                crowd_variant_joint_colors[joint] = getCrowdVariantColor(packet.colors[joint], v);
+            crowd_variant_colors[v - 1]->update(crowd_variant_joint_colors.data(), joint_count);
+        }
+        if (morph_target_pass != nullptr)
+        {
+            morph_activations.clear();
+            for (size_t i = 0; i < morph_weights.size(); ++i)
+            {
+                if (morph_weights[i] == 0)
+                    continue;
+
+                MorphActivation activation;
+                activation.target = i;
+                activation.weight = morph_weights[i];
+                morph_activations.push_back(activation);
+            }
+            morph_activations.insert(morph_activations.end(), packet.morph_activations.begin(),
+                                     packet.morph_activations.end());
+            morph_target_pass->apply(morph_target_program_id, morph_activations.data(), morph_activations.size());
+        }
+    }
+    if (latency_tracker != nullptr)
+        latency_tracker->mark(LatencyTracker::STAGE_UPLOADED);
+
+    // any level of detail the crowd is drawn at which has been evicted is
+    // uploaded again.
+    if (packet_mode == SKINNING_MODE_INSTANCED && !indirect_draws)
+    {
+        for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        {
+            if (packet.lod_instance_counts[lod] != 0)
+                residency_manager->use(lod_resources[lod]);
+        }
+    }
+
+    // everything up to here binds for itself.
+    gl_state.invalidate();
+    gl_state.resetCounts();
+
+    // a comparison draws skinning_mode's half first, then compare_mode's.
+    drawing_left_half = comparing;
+    if (comparing)
+    {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(0, 0, render_target->getWidth() / 2, render_target->getHeight());
+    }
+
+    // the crowd modes bind uniforms per program, so they don't have
+    // wireframe twins; their overlay falls back to drawing lines.
+    DisplayFrame frame;
+    frame.packet = &packet;
+    frame.stats = &stats;
+    frame.wireframe_overlay = wireframe_mode == WIREFRAME_OVERLAY &&
+                              packet_mode != SKINNING_MODE_INSTANCED && packet_mode != SKINNING_MODE_BAKED;
+    frame.polygon_mode = wireframe_mode != WIREFRAME_OFF && !frame.wireframe_overlay ? GL_LINE : GL_FILL;
+    frame.half_palettes_drawn = packet_mode == SKINNING_MODE_INSTANCED && packet.half_palettes_packed;
+    frame.palette_region_base = palette_region_base;
+    frame.palette_blend = palette_blend;
+    frame.draw_start = draw_start;
+    frame.cpu_skinned_instances = cpu_skinned_instances;
+    buildFrameGraph(frame);
+
+    // the timer covers every pass up to the end of the scene's.
+    skinned_bounds_reduced = false;
+    TRACE_BEGIN(draw, "draw submission");
+    skinning_gpu_timer->begin();
+    frame_graph->execute();
+    TRACE_END(draw);
+    if (latency_tracker != nullptr)
+        latency_tracker->mark(LatencyTracker::STAGE_SUBMITTED);
+
+    TRACE_BEGIN(swap, "swap");
+    window.swapBuffers();
+    TRACE_END(swap);
+    if (latency_tracker != nullptr)
+        latency_tracker->endFrame();
+    if (bake_pose_pending)
+        bakePose(frame);
+
+    // keep drawing while the simulation is animating, and until it has
+    // answered the latest request.  A replay draws every frame of the log
+    // as soon as it can, then stops.
+    if (session_player != nullptr)
+    {
+        if (replay_next_frame < session_player->getFrameCount() || packet.serial != last_request.serial)
+            window.postRedisplay();
+        else
+            finishReplay();
+    }
+    else if (packet.animating || packet.serial != last_request.serial || backend_calibrator != nullptr ||
+             palette_request_deferred || (previous_palette_valid && uploaded_palette_blend < 1.0f))
+        requestFrame();
+
+    frame_scheduler.endFrame();
+
+    // a reset context can't be drawn with again, and initGL() creates the
+    // passes' objects among the CPU state, so there's no rebuilding them in
+    // a new one short of starting again; stop cleanly instead of drawing
+    // with dead names.
+    if (window.isContextLost())
+    {
+        std::cerr << "The GL context was reset; stopping." << std::endl;
+        render_loop->quit();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Declares the frame's passes, and what each of them reads and
+///         writes, in frame_graph, and compiles it.
+///
+/// \details The modes which skin the vertices once, before drawing them,
+///         get a skinning pass, which writes the skinned vertices; the
+///         skinned bounds, the shadows and the scene all read them, so
+///         they follow it, and the graph issues the barrier the compute
+///         skinner's storage writes need before the first of them.  The
+///         shadow map is a transient, so while shadows are off it holds no
+///         memory.  The comparison and the debug lines draw over the scene,
+///         then it's resolved into the window, and the overlay drawn over
+///         that.
+///
+/// \param  frame What the passes draw.  It's filled in here with which
+///         passes there are, and must outlive frame_graph->execute().
+void buildFrameGraph(DisplayFrame& frame)
+{
+    const FramePacket& packet = *frame.packet;
+    SkinningMode mode = packet.skinning_mode;
+    bool feedback = mode != SKINNING_MODE_COMPUTE && mode != SKINNING_MODE_CPU && mode != SKINNING_MODE_INSTANCED &&
+                    mode != SKINNING_MODE_BAKED && (pre_skinning || draw_shadows);
+    frame.pre_skinned = feedback || mode == SKINNING_MODE_COMPUTE || mode == SKINNING_MODE_CPU;
+    frame.shadows_drawn = frame.pre_skinned && draw_shadows &&
+                          (mode != SKINNING_MODE_COMPUTE || shadow_compute_program_id != 0);
+
+    frame_graph->reset();
+    FrameGraph::ResourceId skinned_vertices = frame_graph->importResource("skinned vertices");
+    FrameGraph::ResourceId scene = frame_graph->importResource("scene");
+    FrameGraph::ResourceId window_buffer = frame_graph->importResource("window");
+
+    // the compute skinner's vertices are read from shader storage, and the
+    // others' as vertex attributes.
+    FrameGraph::ResourceUsage skinned_usage = mode == SKINNING_MODE_COMPUTE ? FrameGraph::USAGE_SHADER_STORAGE
+                                                                            : FrameGraph::USAGE_VERTEX_ATTRIBUTES;
+    FrameGraph::PassId pass;
+    if (frame.pre_skinned)
+    {
+        pass = frame_graph->addPass("skinning", runSkinningPass, &frame);
+        frame_graph->write(pass, skinned_vertices,
+                           mode == SKINNING_MODE_COMPUTE ? FrameGraph::USAGE_SHADER_STORAGE :
+                           mode == SKINNING_MODE_CPU ? FrameGraph::USAGE_UPLOAD : FrameGraph::USAGE_TRANSFORM_FEEDBACK);
+    }
+    if (frame.pre_skinned && mode != SKINNING_MODE_CPU && skinned_bounds_pass != nullptr)
+    {
+        pass = frame_graph->addPass("skinned bounds", runSkinnedBoundsPass, &frame);
+        frame_graph->read(pass, skinned_vertices, FrameGraph::USAGE_SHADER_STORAGE);
+        frame_graph->write(pass, frame_graph->importResource("skinned bounds"), FrameGraph::USAGE_SHADER_STORAGE);
+    }
+    if (frame.shadows_drawn)
+    {
+        frame.shadow_map = frame_graph->createTexture("shadow map", shadow_pass->getTextureDesc());
+        pass = frame_graph->addPass("shadows", runShadowPass, &frame);
+        frame_graph->read(pass, skinned_vertices, skinned_usage);
+        frame_graph->write(pass, frame.shadow_map, FrameGraph::USAGE_FRAMEBUFFER);
+    }
+
+    pass = frame_graph->addPass("scene", runScenePass, &frame);
+    if (frame.pre_skinned)
+        frame_graph->read(pass, skinned_vertices, skinned_usage);
+    frame_graph->write(pass, scene, FrameGraph::USAGE_FRAMEBUFFER);
+
+    if (packet.compare_mode != N_SKINNING_MODES)
+    {
+        pass = frame_graph->addPass("comparison", runComparisonPass, &frame);
+        frame_graph->write(pass, scene, FrameGraph::USAGE_FRAMEBUFFER);
+    }
+    if (draw_joints && !packet.debug_geometry.getLines().empty())
+    {
+        pass = frame_graph->addPass("debug draw", runDebugDrawPass, &frame);
+        frame_graph->write(pass, scene, FrameGraph::USAGE_FRAMEBUFFER);
+    }
+
+    pass = frame_graph->addPass("resolve", runResolvePass, &frame);
+    frame_graph->read(pass, scene, FrameGraph::USAGE_FRAMEBUFFER);
+    frame_graph->write(pass, window_buffer, FrameGraph::USAGE_FRAMEBUFFER);
+
+    pass = frame_graph->addPass("overlay", runOverlayPass, &frame);
+    frame_graph->write(pass, window_buffer, FrameGraph::USAGE_FRAMEBUFFER);
+
+    frame_graph->compile();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Binds the texture buffers the frame's palettes are read from, for
+///         the modes which read them from one.
+void bindPaletteTextures(const DisplayFrame& frame)
+{
+    SkinningMode mode = frame.packet->skinning_mode;
+    if (frame.half_palettes_drawn)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, instance_origin_texture_id);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, instance_half_palette_texture_id);
+    }
+    else if (mode == SKINNING_MODE_INSTANCED)
+        glBindTexture(GL_TEXTURE_BUFFER, instance_palette_texture_id);
+    else if (mode == SKINNING_MODE_TEXTURE_PALETTE)
+        glBindTexture(GL_TEXTURE_BUFFER, palette_texture_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The frame graph's skinning pass: skins the vertices the shadows
+///         and the scene draw, for the modes which skin them beforehand.
+void runSkinningPass(void* context)
+{
+    DisplayFrame& frame = *static_cast<DisplayFrame*>(context);
+    const FramePacket& packet = *frame.packet;
+    if (packet.skinning_mode == SKINNING_MODE_COMPUTE)
+    {
+        // the leaders' local transforms are taken through the hierarchy,
+        // then placed into every visible instance's palette, all on the GPU.
+        const mat4* palettes = packet.instance_palettes.data();
+        if (packet.hierarchy_on_gpu)
+        {
+            size_t leader_count = packet.leader_locals.size() / skeleton.getJointCount();
+            crowd_hierarchy_pass->uploadCompact(local_expand_program_id, packet.leader_locals.data(), leader_count);
+            crowd_hierarchy_pass->evaluate(crowd_hierarchy_program_id, leader_count);
+            crowd_hierarchy_pass->resolvePalettes(palette_resolve_program_id, packet.palette_targets.data(),
+                                                  packet.palette_targets.size(), compute_skinner->getPaletteBuffer());
+            palettes = nullptr;
+        }
+
+        // one dispatch skins every visible instance the CPU doesn't.
+        compute_skinner->skin(compute_skinning_program_id, palettes, packet.colors.data(),
+                              packet.visible_instances.data(), packet.visible_instances.size(),
+                              frame.cpu_skinned_instances);
+        gl_state.invalidate();
+    }
+    else if (packet.skinning_mode == SKINNING_MODE_CPU)
+        cpu_skinner->skin(packet.skinning_palette.data(), packet.colors.data());
+    else
+    {
+        // skin each vertex exactly once, then every pass that draws the mesh
+        // can use the cached results: the shadow cascades, then the camera.
+        const std::vector<SkeletalMesh::Partition>& partitions = mesh->getPartitions();
+        gl_state.bindVertexArray(mesh->vao_id);
+        bindPaletteTextures(frame);
+        skinned_vertex_cache->beginCapture();
+        for (size_t i = 0; i < partitions.size(); ++i)
+        {
+            const SkeletalMesh::Partition& partition = partitions[i];
+            gl_state.useProgram(skinning_programs[packet.skinning_mode][partition.influence_count - 1].feedback_id);
+            skinned_vertex_cache->captureVertices(partition.first_vertex, partition.vertex_count);
+            ++frame.stats->draw_calls;
+        }
+        skinned_vertex_cache->endCapture();
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The frame graph's skinned bounds pass: reduces the skinned
+///         vertices to their bounds, for the overlay to read back later.
+void runSkinnedBoundsPass(void* context)
+{
+    DisplayFrame& frame = *static_cast<DisplayFrame*>(context);
+    const FramePacket& packet = *frame.packet;
+
+    // the compute skinner's vertices are in the camera's clip space, and
+    // the captured ones in world space.
+    if (packet.skinning_mode == SKINNING_MODE_COMPUTE)
+        skinned_bounds_pass->reduce(skinned_bounds_program_id, compute_skinner->getSkinnedBuffer(),
+                                    compute_skinner->getSkinnedVertexCount(),
+                                    glm::inverse(packet.camera.getViewProjection()));
+    else
+        skinned_bounds_pass->reduce(skinned_bounds_program_id, skinned_vertex_cache->getVertexBuffer(),
+                                    mesh->getVertexCount(), mat4(1));
+    skinned_bounds_reduced = true;
+    gl_state.invalidate();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The frame graph's shadow pass: draws the skinned vertices into
+///         every cascade of the shadow map.  For the compute crowd, only the
+///         visible instances are skinned, so only they cast shadows.
+void runShadowPass(void* context)
+{
+    DisplayFrame& frame = *static_cast<DisplayFrame*>(context);
+    const FramePacket& packet = *frame.packet;
+    shadow_pass->setTexture(frame_graph->getTexture(frame.shadow_map));
+    if (packet.skinning_mode == SKINNING_MODE_COMPUTE)
+    {
+        beginShadowPass(packet.camera, shadow_compute_program_id, glm::inverse(packet.camera.getViewProjection()));
+        compute_skinner->draw(shadow_compute_program_id, shadow_pass->getCascadeCount());
+    }
+    else if (packet.skinning_mode == SKINNING_MODE_CPU)
+    {
+        beginShadowPass(packet.camera, shadow_program_id, mat4(1));
+        cpu_skinner->draw(shadow_pass->getCascadeCount());
+    }
+    else
+    {
+        beginShadowPass(packet.camera, shadow_program_id, mat4(1));
+        skinned_vertex_cache->draw(shadow_pass->getCascadeCount());
+    }
+    endShadowPass(frame.polygon_mode);
+    ++frame.stats->draw_calls;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The frame graph's scene pass: draws the mesh or the crowd with
+///         the packet's mode, then the occlusion proxies.
+void runScenePass(void* context)
+{
+    DisplayFrame& frame = *static_cast<DisplayFrame*>(context);
+    const FramePacket& packet = *frame.packet;
+    FrameStats& stats = *frame.stats;
+    SkinningMode packet_mode = packet.skinning_mode;
+    bool comparing = packet.compare_mode != N_SKINNING_MODES;
+    bool wireframe_overlay = frame.wireframe_overlay;
+    bool half_palettes_drawn = frame.half_palettes_drawn;
+
+    gl_state.bindVertexArray(mesh->vao_id);
+    gl_state.polygonMode(frame.polygon_mode);
+
+    // draw each partition with the program specialized for its influence count.
+    bindPaletteTextures(frame);
+    const std::vector<SkeletalMesh::Partition>& partitions = mesh->getPartitions();
+    bool mesh_queried = false;
+    if (packet_mode == SKINNING_MODE_COMPUTE)
+    {
+        // one draw call draws every instance the skinning pass skinned.
+        compute_skinner->draw(wireframe_overlay ? compute_draw_wireframe_program_id : compute_draw_program_id);
+        ++stats.draw_calls;
+        gl_state.invalidate();
+    }
+    else if (packet_mode == SKINNING_MODE_INSTANCED && indirect_draws)
+    {
+        // one draw per partition of each visible instance, at its level of
+        // detail, all issued with a single multi-draw per partition's program.
+        // Each level's draws count palette indices from where its palettes
+        // start, which is set per draw rather than in the programs.
+        if (gpu_culling)
+        {
+            // the packet's draw list is only the candidates; the compute
+            // shader picks the survivors, and writes their instance counts
+            // straight into the draws.
+            cull_candidates.resize(packet.visible_instances.size());
+            for (size_t i = 0; i < packet.visible_instances.size(); ++i)
+            {
+                GLuint instance = packet.visible_instances[i];
+                cull_candidates[i].mesh = packet.instance_lods[instance];
+                cull_candidates[i].palette_index = packet.instance_slots[instance];
+            }
+            // the cull shader reads the palettes from the start of the
+            // buffer, rather than the frame's region.
+            cull_palette_offsets.resize(mesh_lod_count);
+            for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+                cull_palette_offsets[lod] = packet.lod_palette_offsets[lod] + frame.palette_region_base;
+            instance_cull_pass->cull(instance_cull_program_id, instance_palette_texture_id,
+                                     cull_candidates.data(), cull_candidates.size(), cull_palette_offsets.data());
+            gl_state.invalidate();
+
+            gl_state.bindVertexArray(mesh_arena->getVertexArray(mesh->vertex_format));
+            for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+            {
+                const std::vector<SkeletalMesh::Partition>& lod_partitions = mesh_allocations[lod].partitions;
+                glVertexAttribI2i(RenderQueue::PALETTE_BASES_ATTRIBUTE, GLint(packet.lod_palette_offsets[lod]),
+                                  GLint(packet.lod_instance_offsets[lod]));
+                for (size_t j = 0; j < lod_partitions.size(); ++j)
+                {
+                    if (lod_partitions[j].index_count == 0)
+                        continue;
+
+                    gl_state.useProgram(getInstancedProgramId(lod, lod_partitions[j].influence_count));
+                    instance_cull_pass->draw(gl_state, lod, j);
+                    ++stats.draw_calls;
+                }
+            }
+        }
+        else
+        {
+            GLuint palette_buffer_id = half_palettes_drawn ? instance_half_palette_texture_id
+                                                           : instance_palette_texture_id;
+            render_queue->clear();
+            for (size_t i = 0; i < packet.visible_instances.size(); ++i)
+            {
+                GLuint instance = packet.visible_instances[i];
+                size_t lod = packet.instance_lods[instance];
+                float depth = instance < packet.instance_depths.size() ? packet.instance_depths[instance] : 0.0f;
+
+                const MeshArena::Allocation& allocation = mesh_allocations[lod];
+                for (size_t j = 0; j < allocation.partitions.size(); ++j)
+                {
+                    const SkeletalMesh::Partition& partition = allocation.partitions[j];
+                    render_queue->add(getInstancedProgramId(lod, partition.influence_count),
+                                      allocation, partition, packet.instance_slots[instance],
+                                      palette_buffer_id, depth, GLint(packet.lod_palette_offsets[lod]),
+                                      GLint(packet.lod_instance_offsets[lod]));
+                }
+            }
+            render_queue->submit(*mesh_arena, gl_state);
+            stats.draw_calls += render_queue->getBatchCount();
+        }
+    }
+    else if (packet_mode == SKINNING_MODE_BAKED)
+    {
+        // the whole crowd is animated by the shaders; the only thing that
+        // changes from frame to frame is the time.
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, baked_clip->getTextureId());
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, baked_instance_texture_id);
+
+        for (size_t i = 0; i < partitions.size(); ++i)
+        {
+            const SkeletalMesh::Partition& partition = partitions[i];
+            if (partition.index_count == 0)
+                continue;
+
+            const SkinningProgram& program = skinning_programs[SKINNING_MODE_BAKED][partition.influence_count - 1];
+            gl_state.useProgram(program.id);
+            glUniform1f(program.baked_time_location, packet.baked_time);
+            glDrawElementsInstanced(GL_TRIANGLES, partition.index_count, mesh->getIndexType(),
+                                    reinterpret_cast<void*>(partition.first_index * mesh->getIndexSize()),
+                                    GLsizei(N_INSTANCES));
+            ++stats.draw_calls;
+        }
+
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    else if (packet_mode == SKINNING_MODE_CPU)
+    {
+        gl_state.useProgram(wireframe_overlay ? passthrough_wireframe_program_id : passthrough_program_id);
+        cpu_skinner->draw();
+        ++stats.draw_calls;
+        gl_state.invalidate();
+    }
+    else if (packet_mode == SKINNING_MODE_INSTANCED)
+    {
+        // each level of detail is drawn with its own mesh and programs, with
+        // one call per partition for all of the instances of each variant at
+        // that level.  The variants' palettes are grouped within the level's,
+        // so each variant's are found from where its first one is.
+        for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        {
+            const SkeletalMesh& lod_mesh = getLodMesh(lod);
+            if (packet.lod_instance_counts[lod] == 0 || !lod_mesh.isResident())
+                continue;
+
+            for (size_t v = 0; v < N_CROWD_VARIANTS; ++v)
+            {
+                GLsizei instance_count = GLsizei(packet.lod_variant_counts[lod * N_CROWD_VARIANTS + v]);
+                if (instance_count == 0)
+                    continue;
+
+                size_t first_slot = packet.lod_variant_first_slots[lod * N_CROWD_VARIANTS + v];
+                gl_state.bindVertexArray(v == 0 ? lod_mesh.vao_id : crowd_variants[v - 1][lod]->getVertexArray());
+                glVertexAttribI2i(RenderQueue::PALETTE_BASES_ATTRIBUTE,
+                                  GLint(packet.lod_palette_offsets[lod] + first_slot * getLodJointCount(lod)),
+                                  GLint(packet.lod_instance_offsets[lod] + first_slot));
+
+                const std::vector<SkeletalMesh::Partition>& lod_partitions = lod_mesh.getPartitions();
+                for (size_t i = 0; i < lod_partitions.size(); ++i)
+                {
+                    const SkeletalMesh::Partition& partition = lod_partitions[i];
+                    if (partition.index_count == 0)
+                        continue;
+
+                    gl_state.useProgram(getInstancedProgramId(lod, partition.influence_count));
+                    glDrawElementsInstanced(GL_TRIANGLES, partition.index_count, lod_mesh.getIndexType(),
+                                            reinterpret_cast<void*>(partition.first_index * lod_mesh.getIndexSize()),
+                                            instance_count);
+                    ++stats.draw_calls;
+                }
+            }
+        }
+    }
+    else if (frame.pre_skinned)
+    {
+        gl_state.useProgram(wireframe_overlay ? passthrough_wireframe_program_id : passthrough_program_id);
+        skinned_vertex_cache->draw();
+        ++stats.draw_calls;
+        gl_state.invalidate();
+    }
+    else
+    {
+        // the GPU skips the mesh if its last query found it hidden.  Half
+        // of a comparison would always look partly hidden.
+        mesh_queried = packet.occlusion_culled && !comparing;
+        if (mesh_queried)
+            occlusion_queries->beginConditionalRender(N_INSTANCES);
+        for (size_t i = 0; i < partitions.size(); ++i)
+        {
+            const SkeletalMesh::Partition& partition = partitions[i];
+            if (partition.index_count == 0)
+                continue;
+
+            const SkinningProgram& program = skinning_programs[packet_mode][partition.influence_count - 1];
+            gl_state.useProgram(wireframe_overlay ? program.wireframe_id : program.id);
+            glDrawElements(GL_TRIANGLES, partition.index_count, mesh->getIndexType(),
+                           reinterpret_cast<void*>(partition.first_index * mesh->getIndexSize()));
+            ++stats.draw_calls;
+        }
+        if (mesh_queried)
+            occlusion_queries->endConditionalRender(N_INSTANCES);
+    }
+    if (packet_mode == SKINNING_MODE_INSTANCED && !packet.impostors.empty())
+        drawImpostors(packet, stats);
+
+    // the proxies go after everything which could hide them.  Hidden
+    // instances are still queried, to see when they come back out.
+    if (!packet.occlusion_candidates.empty() || mesh_queried)
+    {
+        occlusion_queries->beginProxies(gl_state, occlusion_proxy_program_id);
+        for (size_t i = 0; i < packet.occlusion_candidates.size(); ++i)
+        {
+            GLuint instance = packet.occlusion_candidates[i];
+            occlusion_queries->drawProxy(instance, packet.proxy_transforms[instance]);
+        }
+        if (mesh_queried)
+            occlusion_queries->drawProxy(N_INSTANCES, packet.proxy_transforms[N_INSTANCES]);
+        occlusion_queries->endProxies(gl_state);
+        stats.draw_calls += packet.occlusion_candidates.size() + (mesh_queried ? 1 : 0);
+    }
+
+    skinning_palette_buffer->fence();
+    palette_ring->fence();
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    gl_state.bindVertexArray(0);
+    gl_state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    skinning_gpu_timer->end();
+
+    // the debug lines and the overlay are always drawn filled.
+    gl_state.polygonMode(GL_FILL);
+    if (backend_calibrator != nullptr)
+        updateCalibration(packet_mode, getTimeMilliseconds() - frame.draw_start);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The frame graph's comparison pass: draws compare_mode's half of
+///         the scene.
+void runComparisonPass(void* context)
+{
+    DisplayFrame& frame = *static_cast<DisplayFrame*>(context);
+    drawComparison(*frame.packet, frame.palette_blend, frame.wireframe_overlay, *frame.stats);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The frame graph's debug draw pass: draws joints and bones from the
+///         lines the simulation collected.  The joints of the crowd's
+///         instances aren't drawn.  The passthrough program is often still
+///         in use from drawing the mesh.
+void runDebugDrawPass(void* context)
+{
+    DisplayFrame& frame = *static_cast<DisplayFrame*>(context);
+    debug_draw_gpu_timer->begin();
+    gl_state.useProgram(passthrough_program_id);
+    debug_draw->draw(frame.packet->debug_geometry);
+    ++frame.stats->draw_calls;
+    gl_state.invalidate();
+    debug_draw_gpu_timer->end();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The frame graph's resolve pass: copies the scene into the window,
+///         at the window's full resolution.
+void runResolvePass(void* context)
+{
+    (void)context;
+    camera_buffer->fence();
+
+    // the overlay is drawn with the fixed function pipeline.
+    gl_state.useProgram(0);
+    render_target->resolve();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The frame graph's overlay pass: finishes the frame's stats, now
+///         that everything else has been drawn, and shows them over the
+///         window if the profiler is on.
+void runOverlayPass(void* context)
+{
+    DisplayFrame& frame = *static_cast<DisplayFrame*>(context);
+    const FramePacket& packet = *frame.packet;
+    FrameStats& stats = *frame.stats;
+    SkinningMode packet_mode = packet.skinning_mode;
+    bool comparing = packet.compare_mode != N_SKINNING_MODES;
+    residency_manager->endFrame();
+
+    // the overlay's binds aren't the frame's.
+    stats.vertices_skinned = countSkinnedVertices(packet);
+    stats.joints_evaluated = packet.joints_evaluated;
+    stats.state_changes = gl_state.getCallCount();
+    stats.state_changes_skipped = gl_state.getSkippedCount();
+    if (packet_mode == SKINNING_MODE_INSTANCED || packet_mode == SKINNING_MODE_COMPUTE)
+        stats.instances_culled = N_INSTANCES - packet.visible_instances.size() - packet.impostors.size() / 3;
+    stats.arena_high_water_bytes = packet.arena_high_water_bytes;
+    stats.addGpuPass("skinning", skinning_gpu_timer->getStats().getLatest());
+    stats.addGpuPass("debug_draw", draw_joints ? debug_draw_gpu_timer->getStats().getLatest() : 0.0);
+    stats.addGpuPass("compare", comparing ? compare_gpu_timer->getStats().getLatest() : 0.0);
+    last_frame_stats = stats;
+    if (stats_log != nullptr)
+        stats_log->add(stats);
+
+    if (show_profiler)
+        drawProfilerOverlay();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Fits shadow_pass's cascades to the frame's camera and binds it,
+///         for the vertices the frame has already skinned to be drawn into
+///         every cascade with one instanced draw.
+///
+/// \param  camera The camera the frame is drawn through.
+/// \param  program_id shadow_program_id or shadow_compute_program_id.
+/// \param  source_transform Takes the skinned vertices to world space.
+void beginShadowPass(const Camera& camera, GLuint program_id, const mat4& source_transform)
+{
+    shadow_pass->fitCascades(camera, LIGHT_DIRECTION);
+    gl_state.polygonMode(GL_FILL);
+    glDisable(GL_SCISSOR_TEST);     // the cascades cover the whole scene, whichever half is drawn
+    shadow_pass->begin(program_id, source_transform);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finishes the shadow pass, and goes back to drawing the scene
+///         into render_target.
+///
+/// \param  polygon_mode The scene's polygon mode.
+void endShadowPass(GLenum polygon_mode)
+{
+    shadow_pass->end();
+    gl_state.invalidate();
+    gl_state.polygonMode(polygon_mode);
+    render_target->bind();
+    if (drawing_left_half)
+        glEnable(GL_SCISSOR_TEST);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Fills in a copy of the SkinningPalette block from a packet, laid
+///         out the way one mode's programs read it.
+///
+/// \param  packet The packet to draw, which has mode's streams filled in.
+/// \param  mode The mode whose layout to use.
+/// \param  palette_blend How far to blend the dual quaternions from the
+///         last packet's, when mode blends them (see -palette-rate).
+/// \param  block The mapped block.
+/// \return The number of bytes written.
+size_t packSkinningPaletteBlock(const FramePacket& packet, SkinningMode mode, float palette_blend, char* block)
+{
+    size_t joint_count = skeleton.getJointCount();
+    char* block_start = block;
+    if (mode == SKINNING_MODE_SEPARATE)
+    {
+        packAffineRows(packet.joint_transforms.data(), joint_count, reinterpret_cast<vec4*>(block));
+        block += joint_count * 3 * sizeof(vec4);
+    }
+    else if (mode == SKINNING_MODE_PALETTE)
+    {
+        packAffineRows(packet.skinning_palette.data(), joint_count, reinterpret_cast<vec4*>(block));
+        block += joint_count * 3 * sizeof(vec4);
+    }
+    else if (mode == SKINNING_MODE_DUAL_QUAT)
+    {
+        std::memcpy(block, packet.dual_quat_palette.data(), joint_count * sizeof(DualQuat));
+        block += joint_count * sizeof(DualQuat);
+        std::memcpy(block, packet.palette_scales.data(), packet.palette_scales.size() * sizeof(float));
+        block += packet.palette_scales.size() * sizeof(float);
+    }
+    else if (mode == SKINNING_MODE_AFFINE_2D)
+    {
+        // the colors start at the next whole vec4.
+        std::memcpy(block, packet.affine_palette.data(), joint_count * sizeof(Affine2D));
+        block += (joint_count * sizeof(Affine2D) + sizeof(vec4) - 1) / sizeof(vec4) * sizeof(vec4);
+    }
+    std::memcpy(block, packet.colors.data(), joint_count * sizeof(color4));
+    block += joint_count * sizeof(color4);
+    if (palette_rate > 0 && mode == SKINNING_MODE_DUAL_QUAT)
+    {
+        // until there's a previous palette, the latest one is blended with itself.
+        const std::vector<DualQuat>& from = previous_palette_valid ? previous_dq_palette : packet.dual_quat_palette;
+        const std::vector<float>& from_scales = previous_palette_valid ? previous_palette_scales : packet.palette_scales;
+        std::memcpy(block, from.data(), joint_count * sizeof(DualQuat));
+        block += joint_count * sizeof(DualQuat);
+        std::memcpy(block, from_scales.data(), from_scales.size() * sizeof(float));
+        block += from_scales.size() * sizeof(float);
+
+        vec4 blend(palette_blend, 0, 0, 0);
+        std::memcpy(block, &blend, sizeof(blend));
+        block += sizeof(blend);
+    }
+    return block - block_start;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies a packet's precombined palette and colors into the palette
+///         texture, for SKINNING_MODE_TEXTURE_PALETTE, unless they're
+///         already there.
+///
+/// \details The texture holds three affine rows per joint, then a color per
+///         joint, as one RGBA32F texel each.  Like the instanced crowd's
+///         palettes, the storage is orphaned before it's refilled, so the
+///         draws still reading last frame's don't stall the upload; unlike
+///         the SkinningPalette block, it isn't limited to what fits in
+///         GL_MAX_UNIFORM_BLOCK_SIZE.
+///
+/// \param  packet The packet to draw, which has skinning_palette filled in.
+/// \return The number of bytes uploaded, or 0 if the texture was current.
+size_t uploadPaletteTexture(const FramePacket& packet)
+{
+    if (packet.block_version == uploaded_palette_texture_version)
+        return 0;
+
+    size_t joint_count = skeleton.getJointCount();
+    palette_texels.resize(4 * joint_count);
+    packAffineRows(packet.skinning_palette.data(), joint_count, palette_texels.data());
+    std::copy(packet.colors.begin(), packet.colors.end(), palette_texels.begin() + 3 * joint_count);
+
+    size_t bytes = palette_texels.size() * sizeof(vec4);
+    glBindBuffer(GL_TEXTURE_BUFFER, palette_texture_buffer_id);
+    glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);   // orphan last frame's data
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, palette_texels.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    uploaded_palette_texture_version = packet.block_version;
+    return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws the right half of an A/B comparison: the mesh skinned with
+///         the packet's compare_mode, timed by compare_gpu_timer.
+///
+/// \details display() has already drawn skinning_mode into the left half,
+///         with the scissor test on.  The comparison gets its own copy of
+///         the SkinningPalette block in its own layout, so the next frame
+///         has to upload skinning_mode's again.  It's drawn straight from
+///         the block, or on the CPU, without the shadows or pre-skinning
+///         the left half might have; the timings compare the skinning.
+///
+/// \param  packet The packet being drawn.
+/// \param  palette_blend How far to blend the dual quaternions from the
+///         last packet's, as display() found it.
+/// \param  wireframe_overlay Whether to draw with the wireframe twins.
+/// \param  stats The frame's stats, which the draws are added to.
+void drawComparison(const FramePacket& packet, float palette_blend, bool wireframe_overlay, FrameStats& stats)
+{
+    TRACE_SCOPE("comparison");
+    SkinningMode mode = packet.compare_mode;
+    GLsizei left_width = render_target->getWidth() / 2;
+    drawing_left_half = false;
+    glScissor(left_width, 0, render_target->getWidth() - left_width, render_target->getHeight());
+
+    compare_gpu_timer->begin();
+    if (mode == SKINNING_MODE_CPU)
+    {
+        cpu_skinner->skin(packet.skinning_palette.data(), packet.colors.data());
+        gl_state.useProgram(wireframe_overlay ? passthrough_wireframe_program_id : passthrough_program_id);
+        cpu_skinner->draw();
+        ++stats.draw_calls;
+        gl_state.invalidate();
+    }
+    else
+    {
+        if (mode == SKINNING_MODE_TEXTURE_PALETTE)
+        {
+            size_t texture_bytes = uploadPaletteTexture(packet);
+            if (texture_bytes > 0)
+                ++stats.palettes_uploaded;
+            stats.palette_bytes_uploaded += texture_bytes;
+            glBindTexture(GL_TEXTURE_BUFFER, palette_texture_id);
+        }
+
+        char* block = static_cast<char*>(skinning_palette_buffer->map());
+        size_t block_bytes = packSkinningPaletteBlock(packet, mode, palette_blend, block);
+        skinning_palette_buffer->unmap(SKINNING_PALETTE_BINDING);
+        uploaded_block_version = size_t(-1);
+        ++stats.palettes_uploaded;
+        stats.palette_bytes_uploaded += block_bytes;
+
+        gl_state.bindVertexArray(mesh->vao_id);
+        const std::vector<SkeletalMesh::Partition>& partitions = mesh->getPartitions();
+        for (size_t i = 0; i < partitions.size(); ++i)
+        {
+            const SkeletalMesh::Partition& partition = partitions[i];
+            if (partition.index_count == 0)
+                continue;
+
+            const SkinningProgram& program = skinning_programs[mode][partition.influence_count - 1];
+            gl_state.useProgram(wireframe_overlay ? program.wireframe_id : program.id);
+            glDrawElements(GL_TRIANGLES, partition.index_count, mesh->getIndexType(),
+                           reinterpret_cast<void*>(partition.first_index * mesh->getIndexSize()));
+            ++stats.draw_calls;
+        }
+        gl_state.bindVertexArray(0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        skinning_palette_buffer->fence();
+    }
+    compare_gpu_timer->end();
+
+    glDisable(GL_SCISSOR_TEST);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws a packet's impostors, with one instanced draw of a quad.
+///
+/// \details The impostors are written over the buffer's last contents,
+///         which are orphaned rather than waited for.
+void drawImpostors(const FramePacket& packet, FrameStats& stats)
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, impostor_buffer_id);
+    glBufferData(GL_TEXTURE_BUFFER, N_INSTANCES * 3 * sizeof(vec4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, packet.impostors.size() * sizeof(vec4), packet.impostors.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, impostor_atlas->getTextureId());
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, impostor_texture_id);
+
+    gl_state.bindVertexArray(impostor_vao_id);
+    gl_state.useProgram(impostor_program_id);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(packet.impostors.size() / 3));
+    ++stats.draw_calls;
+    stats.palette_bytes_uploaded += packet.impostors.size() * sizeof(vec4);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves on to the latest packet, if there's a new one, handing
+///         the old one's palette buffer back to the simulation thread
+///         mapped, and unmapping the new one's, ready to draw.
+///
+/// \return true if there was a new packet.
+bool acquirePacket()
+{
+    TRACE_SCOPE("acquire packet");
+    if (!frame_packets.hasFreshPacket())
+        return false;
+
+    // the packet being given up goes back to the simulation thread, which
+    // may stream the crowd's palettes into its buffer, and the new one is
+    // about to be drawn from.
+    palette_stream->map(frame_packets.getReadPacket());
+    frame_packets.acquire();
+    palette_stream->unmap(frame_packets.getReadPacket());
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a mode skins the one mesh, from the
+///         SkinningPalette block or on the CPU, so that it can be drawn on
+///         either side of a comparison.
+bool isComparableMode(SkinningMode mode)
+{
+    return mode == SKINNING_MODE_SEPARATE || mode == SKINNING_MODE_PALETTE || mode == SKINNING_MODE_DUAL_QUAT ||
+           mode == SKINNING_MODE_AFFINE_2D || mode == SKINNING_MODE_CPU || mode == SKINNING_MODE_TEXTURE_PALETTE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the mode to compare a mode with: compare_mode, if both
+///         can be compared and they're different, or N_SKINNING_MODES.
+SkinningMode getCompareMode(SkinningMode mode)
+{
+    if (compare_mode == mode || !isComparableMode(mode) || !isComparableMode(compare_mode))
+        return N_SKINNING_MODES;
+    return compare_mode;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a request's packet is drawn with a mode, on
+///         either side of a comparison.
+bool drawsWith(const SimulationRequest& request, SkinningMode mode)
+{
+    return request.skinning_mode == mode || request.compare_mode == mode;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Passes the current input and the steps the clock has advanced
+///         by on to the simulation thread.
+///
+/// \details Nothing is posted if the simulation has settled and the input
+///         hasn't changed, since the result would be the same as the last
+///         packet (a redraw after a resize, say, costs the simulation
+///         nothing).  If the simulation thread hasn't picked up the last
+///         request yet, the two are merged: the steps add up and the input
+///         is the newest, though with -latency it's timed from the oldest
+///         event either carried.
+///
+/// \param  steps The number of fixed steps frame_scheduler has advanced by.
+/// \param  interpolation How far the clock is past the last step.
+void postSimulationRequest(size_t steps, float interpolation)
+{
+    TRACE_SCOPE("post request");
+    bool input_changed = last_request.serial == 0 ||
+                         target_blend_factor != last_request.target_blend_factor ||
+                         play_clip != last_request.play_clip ||
+                         draw_joints != last_request.draw_joints ||
+                         skinning_mode != last_request.skinning_mode ||
+                         getCompareMode(skinning_mode) != last_request.compare_mode ||
+                         ik_enabled != last_request.ik ||
+                         (ik_enabled && mouse_position != last_request.ik_target) ||
+                         ragdoll_enabled != last_request.ragdoll ||
+                         gpu_culling != last_request.gpu_culling ||
+                         half_palettes != last_request.half_palettes ||
+                         motion_vectors != last_request.motion_vectors ||
+                         impostors != last_request.impostors ||
+                         occlusion_culling != last_request.occlusion_culling ||
+                         (occlusion_culling && occlusion_hidden_counts != last_request.hidden_counts) ||
+                         instant_replay != last_request.instant_replay ||
+                         camera != last_request.camera ||
+                         viewport != last_request.viewport;
+    bool settled = frame_packets.hasPacket() && !frame_packets.getReadPacket().animating &&
+                   frame_packets.getReadPacket().serial == last_request.serial;
+    if (!input_changed && settled)
+    {
+        pending_input_milliseconds = 0;     // nothing will answer it
+        return;
+    }
+
+    // with -palette-rate, the request waits until the next period, and the
+    // steps until then are added to it.
+    if (palette_rate > 0)
+    {
+        double now = getTimeMilliseconds();
+        deferred_steps += steps;
+        palette_request_deferred = now < next_palette_milliseconds;
+        if (palette_request_deferred)
+            return;
+
+        double period = 1000.0 / palette_rate;
+        next_palette_milliseconds += period;
+        if (next_palette_milliseconds <= now)
+            next_palette_milliseconds = now + period;   // fell behind, after an idle spell say
+        steps = deferred_steps;
+        deferred_steps = 0;
+    }
+
+    last_request.serial++;
+    last_request.steps = steps;
+    last_request.step_seconds = float(frame_scheduler.getStepSeconds());
+    last_request.interpolation = interpolation;
+    last_request.target_blend_factor = target_blend_factor;
+    last_request.play_clip = play_clip;
+    last_request.draw_joints = draw_joints;
+    last_request.skinning_mode = skinning_mode;
+    last_request.compare_mode = getCompareMode(skinning_mode);
+    last_request.ik = ik_enabled;
+    last_request.ik_target = mouse_position;
+    last_request.ragdoll = ragdoll_enabled;
+    last_request.gpu_culling = gpu_culling;
+    last_request.half_palettes = half_palettes;
+    last_request.motion_vectors = motion_vectors;
+    last_request.impostors = impostors;
+    last_request.occlusion_culling = occlusion_culling;
+    last_request.instant_replay = instant_replay;
+    last_request.hidden_counts = occlusion_hidden_counts;
+    last_request.camera = camera;
+    last_request.viewport = viewport;
+    last_request.input_milliseconds = pending_input_milliseconds;
+    pending_input_milliseconds = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(simulation_mutex);
+        if (simulation_request_pending)
+        {
+            last_request.steps += simulation_request.steps;
+            if (simulation_request.input_milliseconds > 0 &&
+                (last_request.input_milliseconds == 0 ||
+                 simulation_request.input_milliseconds < last_request.input_milliseconds))
+                last_request.input_milliseconds = simulation_request.input_milliseconds;
+        }
+
+        simulation_request = last_request;
+        simulation_request_pending = true;
+    }
+    simulation_wake.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Posts the next frame of session_player's log, exactly as it was
+///         recorded.
+///
+/// \details Each recorded frame was one request as the simulation thread
+///         picked it up, so a replay never merges requests; it waits for
+///         the simulation thread to pick up the last one first.  That
+///         still leaves the next frame simulating while this one draws.
+void postReplayRequest()
+{
+    if (replay_next_frame >= session_player->getFrameCount())
+        return;
+    if (replay_next_frame == 0)
+        replay_start_milliseconds = getTimeMilliseconds();
+
+    {
+        std::unique_lock<std::mutex> lock(simulation_mutex);
+        while (simulation_request_pending)
+            packet_published.wait(lock);
+    }
+
+    unpackRequest(session_player->getInput(replay_next_frame), last_request);
+    last_request.serial++;
+    last_request.replay_frame = replay_next_frame++;
+    last_request.input_milliseconds = 0;
+    draw_joints = last_request.draw_joints;
+
+    {
+        std::lock_guard<std::mutex> lock(simulation_mutex);
+        simulation_request = last_request;
+        simulation_request_pending = true;
+    }
+    simulation_wake.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports how long the replay took, and whether every pose came
+///         out as recorded, then exits.
+void finishReplay()
+{
+    double milliseconds = getTimeMilliseconds() - replay_start_milliseconds;
+    size_t frame_count = session_player->getFrameCount();
+    waitForSimulation();
+
+    std::cerr << "Replayed " << frame_count << " frames of " << replay_path << " in " << milliseconds << " ms ("
+              << milliseconds / double(std::max(frame_count, size_t(1))) << " ms per frame)." << std::endl;
+    const TimingStats* stats[] = { &pose_stats, &palette_stats, &upload_stats };
+    for (size_t i = 0; i < sizeof(stats) / sizeof(stats[0]); ++i)
+    {
+        std::cerr << "  " << stats[i]->getName() << ": mean " << stats[i]->getMean() << " ms, p99 "
+                  << stats[i]->getPercentile(99.0) << " ms over the last " << stats[i]->getSampleCount()
+                  << " frames" << std::endl;
+    }
+    if (replay_mismatches > 0)
+        std::cerr << "  " << replay_mismatches << " frames didn't pose the same as when they were recorded." << std::endl;
+    else
+        std::cerr << "  Every frame posed exactly as recorded." << std::endl;
+
+    render_loop->quit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Packs the input of a request into REQUEST_WORDS words for a
+///         session log.
+void packRequest(const SimulationRequest& request, GLuint* words)
+{
+    words[0] = GLuint(request.steps);
+    std::memcpy(&words[1], &request.step_seconds, sizeof(float));
+    std::memcpy(&words[2], &request.interpolation, sizeof(float));
+    std::memcpy(&words[3], &request.target_blend_factor, sizeof(float));
+    words[4] = request.play_clip ? 1 : 0;
+    words[5] = request.draw_joints ? 1 : 0;
+    words[6] = GLuint(request.skinning_mode);
+    words[7] = GLuint(request.viewport.x);
+    words[8] = GLuint(request.viewport.y);
+    words[9] = request.ik ? 1 : 0;
+    std::memcpy(&words[10], &request.ik_target.x, sizeof(float));
+    std::memcpy(&words[11], &request.ik_target.y, sizeof(float));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unpacks the input packed by packRequest() into a request.  Its
+///         serial and replay_frame are left alone, the ragdoll is off, and
+///         the crowd is culled wherever it's being culled now, and seen
+///         through the camera as it is now.  The mesh is compared with
+///         compare_mode, if it can be.
+void unpackRequest(const GLuint* words, SimulationRequest& request)
+{
+    request.steps = words[0];
+    std::memcpy(&request.step_seconds, &words[1], sizeof(float));
+    std::memcpy(&request.interpolation, &words[2], sizeof(float));
+    std::memcpy(&request.target_blend_factor, &words[3], sizeof(float));
+    request.play_clip = words[4] != 0;
+    request.draw_joints = words[5] != 0;
+    request.skinning_mode = SkinningMode(words[6]);
+    request.compare_mode = getCompareMode(request.skinning_mode);
+    request.viewport = glm::ivec2(int(words[7]), int(words[8]));
+    request.ik = words[9] != 0;
+    std::memcpy(&request.ik_target.x, &words[10], sizeof(float));
+    std::memcpy(&request.ik_target.y, &words[11], sizeof(float));
+    request.ragdoll = false;
+    request.instant_replay = false;
+    request.gpu_culling = gpu_culling;
+    request.half_palettes = half_palettes;
+    request.motion_vectors = motion_vectors;
+    request.impostors = impostors;
+    request.occlusion_culling = occlusion_culling;
+    request.hidden_counts = occlusion_hidden_counts;
+    request.camera = camera;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The simulation thread's main loop: waits for each request, and
+///         publishes a frame packet for it.
+void simulationMain()
+{
+    TRACE_THREAD("simulation");
+    for (;;)
+    {
+        SimulationRequest request;
+        {
+            std::unique_lock<std::mutex> lock(simulation_mutex);
+            while (!simulation_stopping && !simulation_request_pending)
+                simulation_wake.wait(lock);
+
+            if (simulation_stopping)
+                return;
+
+            request = simulation_request;
+            simulation_request_pending = false;
+        }
+
+        simulateFrame(request, frame_packets.getWritePacket());
+        if (session_recorder != nullptr)
+        {
+            GLuint words[REQUEST_WORDS];
+            packRequest(request, words);
+            session_recorder->record(words, current_pose);
+        }
+        if (session_player != nullptr && !session_player->matchesPose(request.replay_frame, current_pose))
+            ++replay_mismatches;
+        frame_packets.publish();
+
+        {
+            std::lock_guard<std::mutex> lock(simulation_mutex);
+            published_serial = request.serial;
+        }
+        packet_published.notify_all();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Advances the animation, poses the skeleton (or the crowd) and
+///         fills in a frame packet with everything needed to draw it.
+///
+/// \details The thread's epoch is pinned for the whole frame, which
+///         includes every job it waits on, so the published assets that it
+///         and the jobs read stay alive until it returns.
+///
+/// \param  request The input and timing to simulate.
+/// \param  packet The packet to fill in.
+void simulateFrame(const SimulationRequest& request, FramePacket& packet)
+{
+    TRACE_SCOPE("simulate frame");
+    EpochReclaimer::Pin epoch_pin(*asset_epochs, JobSystem::getCurrentThread());
+    simulation_arena->beginFrame();
+    packet.joints_evaluated = 0;
+
+    // a reloaded clip is swapped in before anything samples it.
+    size_t clip_serial = 0;
+    const CompressedClip* played_clip = reloaded_clip.get(clip_serial);
+    if (clip_serial != sampled_clip_serial)
+    {
+        playReloadedClip(*played_clip);
+        sampled_clip_serial = clip_serial;
+    }
+
+    // catch the animation up with the clock, then pose the skeleton between
+    // the last two steps.
+    for (size_t i = 0; i < request.steps; ++i)
+        stepAnimation(request);
+
+    SkinningMode mode = request.skinning_mode;
+    clip_playing = request.play_clip;
+    blend_factor = glm::mix(previous_blend_factor, simulated_blend_factor, request.interpolation);
+    posed_clip_time = glm::mix(previous_clip_time, clip_time, request.interpolation);
+    packet.camera = request.camera;
+
+    // the crowd is posed by the job system's threads while this thread gets
+    // on with current_pose.
+    double pose_start = getTimeMilliseconds();
+    bool pose_crowd = mode == SKINNING_MODE_INSTANCED || mode == SKINNING_MODE_COMPUTE;
+    packet.hierarchy_on_gpu = gpu_hierarchy && mode == SKINNING_MODE_COMPUTE;
+    packet.occlusion_culled = request.occlusion_culling;
+    packet.occlusion_candidates.clear();
+    packet.proxy_transforms.resize(N_INSTANCES + 1);
+    if (pose_crowd)
+    {
+        bool crowd_changed = clip_playing || clip_playing != crowd_clip_playing || blend_factor != crowd_blend_factor;
+        crowd_quiet_frames = crowd_changed ? 0 : crowd_quiet_frames + 1;
+        crowd_clip_playing = clip_playing;
+        crowd_blend_factor = blend_factor;
+
+        // the instances' last poses are stale if other modes were drawn since.
+        if (!crowd_posed)
+            crowd_animation_lod->reset();
+
+        selectInstanceLods(request, packet);
+        startPosingInstances(request, packet);
+    }
+    crowd_posed = pose_crowd;
+
+    // in the modes which draw with skinning_palette, current_pose is posed
+    // from its state's rounded time or weight, so that when the state comes
+    // round again its transforms and palette can come straight from
+    // palette_cache, without posing it at all.  The ragdoll and IK move the
+    // pose in ways its state doesn't capture, and a 2D affine comparison
+    // would be built from transforms the cache leaves stale.
+    bool cache_pose = (mode == SKINNING_MODE_PALETTE || mode == SKINNING_MODE_CPU ||
+                       mode == SKINNING_MODE_TEXTURE_PALETTE) && !request.ragdoll && !request.ik &&
+                      !drawsWith(request, SKINNING_MODE_AFFINE_2D) && instant_replay_buffer == nullptr;
+    AnimationStateKey pose_key;
+    size_t cached_pose = PaletteCache::NO_ENTRY;
+    if (cache_pose)
+    {
+        pose_key = getCurrentPoseKey();
+        cached_pose = palette_cache->find(pose_key);
+    }
+
+    if (cached_pose != PaletteCache::NO_ENTRY)
+    {
+        // current_pose and its transforms are left as they were.
+    }
+    else if (clip_playing)
+    {
+        TRACE_SCOPE("sample clip");
+        float time = cache_pose ? AnimationStateCache::dequantize(pose_key.time, STATE_STEPS) : posed_clip_time;
+        clip_sampler->sampleLooped(time, current_pose);
+    }
+    else
+    {
+        TRACE_SCOPE("blend poses");
+        float factor = cache_pose ? AnimationStateCache::dequantize(pose_key.weights[0], STATE_STEPS) : blend_factor;
+        blendPoses(poses[left_pose], poses[right_pose], factor, current_pose);
+    }
+    if (request.ragdoll)
+    {
+        physics_input->acquire();
+        physics_input->blendInto(skeleton, 1.0f, current_pose);
+    }
+    if (request.ik)
+        solveCurrentPoseIk(request);
+    emitClipEvents(pose_crowd);
+
+    // while the instant replay plays, current_pose is overwritten with the
+    // recorded frames, and nothing new is recorded, so it loops over the
+    // same few seconds.
+    if (instant_replay_buffer != nullptr)
+    {
+        TRACE_SCOPE("instant replay");
+        if (request.instant_replay)
+            playInstantReplay();
+        else
+        {
+            instant_replay_buffer->record(current_pose);
+            instant_replay_frame = size_t(-1);
+        }
+    }
+
+    // the correctives follow the finished pose, ragdoll, IK and all.
+    packet.morph_activations.clear();
+    if (pose_correctives != nullptr)
+    {
+        TRACE_SCOPE("correctives");
+        pose_correctives->evaluate(&current_pose, 1);
+        packet.morph_activations.assign(pose_correctives->getActivations(0),
+                                        pose_correctives->getActivations(0) + pose_correctives->getActivationCount(0));
+    }
+
+    // evaluate the skeleton hierarchy once; the results are used for both
+    // the skinning uniforms and the debug joint rendering below.  Only the
+    // joints which moved since the last frame (and everything below them)
+    // are recomputed.
+    size_t joint_count = skeleton.getJointCount();
+    size_t first_dirty = 0;
+    size_t dirty_end = 0;
+    TRACE_BEGIN(hierarchy, "hierarchy");
+    if (cached_pose == PaletteCache::NO_ENTRY && current_pose_transforms->update(current_pose) > 0)
+    {
+        first_dirty = current_pose_transforms->getFirstDirtyJoint();
+        dirty_end = current_pose_transforms->getDirtyJointEnd();
+    }
+    TRACE_END(hierarchy);
+    packet.joints_evaluated += dirty_end - first_dirty;
+
+    // the mesh's own query, outside the crowd modes.  Its bounds are also
+    // what the overlay compares skinned_bounds_pass's with, unless a cached
+    // pose has left current_pose_transforms behind.
+    packet.joint_box_bounds = BoundingBox();
+    if (!pose_crowd)
+    {
+        BoundingBox bounds = computeSkinnedBounds(lod_joint_bounds[0].get()->data(),
+                                                  current_pose_transforms->getTransforms(), joint_count);
+        if (request.occlusion_culling)
+            packet.proxy_transforms[N_INSTANCES] = OcclusionQueries::getProxyTransform(bounds, mat4());
+        if (cached_pose == PaletteCache::NO_ENTRY)
+            packet.joint_box_bounds = bounds;
+    }
+
+    // this thread helps with whatever's left of the crowd's posing jobs.
+    // Then only the instances which survive culling get palettes, which are
+    // built while this thread gets on with current_pose's.
+    if (pose_crowd)
+    {
+        TRACE_BEGIN(crowd, "wait for crowd poses");
+        job_system->wait();
+        TRACE_END(crowd);
+
+        // the leaders set their jiggle joints' targets in their hierarchy
+        // jobs; the whole crowd's are stepped together, and added to the
+        // palettes in the palette jobs.
+        {
+            TRACE_SCOPE("jiggle crowd");
+            float frame_steps = request.steps + request.interpolation - crowd_jiggle_interpolation;
+            crowd_jiggle->simulate(frame_steps * request.step_seconds);
+            crowd_jiggle_interpolation = request.interpolation;
+        }
+        updateInstanceTransforms();
+        if (request.gpu_culling)
+        {
+            // instance_cull_pass culls them instead.
+            packet.visible_instances.resize(N_INSTANCES);
+            for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+                packet.visible_instances[instance] = GLuint(instance);
+        }
+        else
+            cullInstances(request, packet);
+        layoutInstancePalettes(request, packet);
+        if (packet.hierarchy_on_gpu)
+            gatherLeaderLocals(packet);
+        else
+            startBuildingInstancePalettes(packet);
+    }
+    packet.pose_milliseconds = getTimeMilliseconds() - pose_start;
+
+    double palette_start = getTimeMilliseconds();
+    TRACE_BEGIN(palettes, "build palettes");
+    bool transforms_changed = dirty_end > first_dirty;
+    if (cached_pose != PaletteCache::NO_ENTRY)
+        transforms_changed = !drawn_pose_keyed || pose_key != drawn_pose_key;
+
+    // the fixed point palettes are evaluated whole, from the pose, so they
+    // leave the float ones' dirty ranges behind.  Cached palettes were
+    // evaluated this way when they were inserted.
+    bool fixed_palette = fixed_pose_evaluator != nullptr && cached_pose == PaletteCache::NO_ENTRY &&
+                         (drawsWith(request, SKINNING_MODE_PALETTE) || drawsWith(request, SKINNING_MODE_CPU) ||
+                          drawsWith(request, SKINNING_MODE_AFFINE_2D) ||
+                          drawsWith(request, SKINNING_MODE_TEXTURE_PALETTE));
+    if (fixed_palette)
+        fixed_pose_evaluator->evaluate(current_pose);
+
+    if (drawsWith(request, SKINNING_MODE_PALETTE) || drawsWith(request, SKINNING_MODE_DUAL_QUAT) ||
+        drawsWith(request, SKINNING_MODE_CPU) || drawsWith(request, SKINNING_MODE_TEXTURE_PALETTE))
+    {
+        // each joint's matrices depend only on its own transform, so only
+        // the dirty range needs rebuilding, unless a mode which doesn't use
+        // the palette let it fall behind.
+        size_t first = skinning_palette_valid ? first_dirty : 0;
+        size_t end = skinning_palette_valid ? dirty_end : joint_count;
+        if (cached_pose != PaletteCache::NO_ENTRY)
+        {
+            // which leaves skinning_palette ahead of current_pose_transforms.
+            const mat4* cached_palette = palette_cache->getPalette(cached_pose);
+            std::copy(cached_palette, cached_palette + joint_count, skinning_palette.begin());
+            skinning_palette_valid = false;
+        }
+        else if (fixed_palette)
+        {
+            fixed_pose_evaluator->getMatrixPalette(skinning_palette.data());
+            skinning_palette_valid = false;
+        }
+        else
+        {
+            computeSkinningPalette(current_pose_transforms->getTransforms() + first,
+                                   skeleton.getInverseBindTransforms() + first, end - first,
+                                   skinning_palette.data() + first);
+            skinning_palette_valid = true;
+        }
+
+        if (drawsWith(request, SKINNING_MODE_DUAL_QUAT))
+        {
+            if (!dual_quat_palette_valid)
+            {
+                first = 0;
+                end = joint_count;
+            }
+
+            computeDualQuatPalette(skinning_palette.data() + first, end - first,
+                                   dual_quat_palette.data() + first, palette_scales.data() + first);
+            dual_quat_palette_valid = true;
+        }
+        else if (transforms_changed)
+            dual_quat_palette_valid = false;
+    }
+    else if (transforms_changed)
+    {
+        skinning_palette_valid = false;
+        dual_quat_palette_valid = false;
+    }
+
+    // the affine palette is built straight from the affine joint
+    // transforms, without going through the matrices.
+    if (drawsWith(request, SKINNING_MODE_AFFINE_2D) && fixed_palette)
+    {
+        fixed_pose_evaluator->getAffinePalette(affine_palette.data());
+        affine_palette_valid = false;
+    }
+    else if (drawsWith(request, SKINNING_MODE_AFFINE_2D))
+    {
+        size_t first = affine_palette_valid ? first_dirty : 0;
+        size_t end = affine_palette_valid ? dirty_end : joint_count;
+        computeAffinePalette(current_pose_transforms->getAffines() + first,
+                             skeleton.getInverseBindAffines() + first, end - first,
+                             affine_palette.data() + first);
+        affine_palette_valid = true;
+    }
+    else if (transforms_changed)
+        affine_palette_valid = false;
+
+    if (cache_pose && cached_pose == PaletteCache::NO_ENTRY)
+    {
+        size_t entry = palette_cache->insert(pose_key);
+        std::copy(current_pose_transforms->getTransforms(), current_pose_transforms->getTransforms() + joint_count,
+                  palette_cache->getJointTransforms(entry));
+        std::copy(skinning_palette.begin(), skinning_palette.end(), palette_cache->getPalette(entry));
+        std::copy(current_pose.color, current_pose.color + joint_count, palette_cache->getColors(entry));
+    }
+    drawn_pose_keyed = cache_pose;
+    drawn_pose_key = pose_key;
+
+    packet.half_palettes_packed = false;
+    if (pose_crowd)
+    {
+        job_system->wait();
+        if (mode == SKINNING_MODE_INSTANCED && request.half_palettes && !request.gpu_culling)
+            packHalfInstancePalettes(packet);
+    }
+    TRACE_END(palettes);
+    packet.palette_milliseconds = getTimeMilliseconds() - palette_start;
+    packet.arena_high_water_bytes = simulation_arena->getHighWaterMark();
+
+    // copy out only what this mode, and the one it's compared with, draw with.
+    const mat4* transforms = current_pose_transforms->getTransforms();
+    Pose drawn_pose = current_pose;
+    if (cached_pose != PaletteCache::NO_ENTRY)
+    {
+        transforms = palette_cache->getJointTransforms(cached_pose);
+        drawn_pose.color = palette_cache->getColors(cached_pose);
+    }
+    if (drawsWith(request, SKINNING_MODE_SEPARATE))
+        packet.joint_transforms.assign(transforms, transforms + joint_count);
+    if (drawsWith(request, SKINNING_MODE_PALETTE) || drawsWith(request, SKINNING_MODE_CPU) ||
+        drawsWith(request, SKINNING_MODE_TEXTURE_PALETTE))
+        packet.skinning_palette = skinning_palette;
+    if (drawsWith(request, SKINNING_MODE_DUAL_QUAT))
+    {
+        packet.dual_quat_palette = dual_quat_palette;
+        packet.palette_scales = palette_scales;
+    }
+    if (drawsWith(request, SKINNING_MODE_AFFINE_2D))
+        packet.affine_palette = affine_palette;
+    packet.colors.assign(drawn_pose.color, drawn_pose.color + joint_count);
+
+    if (transforms_changed || current_pose_transforms->haveColorsChanged() || mode != block_mode)
+        ++block_version;
+    block_mode = mode;
+
+    packet.baked_time = posed_clip_time;
+
+    // only the sockets on joints which moved need recomputing, unless the
+    // transforms came from the palette cache instead.
+    if (cached_pose == PaletteCache::NO_ENTRY && socket_transforms_valid)
+        skeleton.updateSocketTransforms(transforms, mat4(1), first_dirty, dirty_end, socket_transforms.data());
+    else
+        skeleton.computeSocketTransforms(transforms, mat4(1), socket_transforms.data());
+    socket_transforms_valid = cached_pose == PaletteCache::NO_ENTRY;
+
+    packet.debug_geometry.clear();
+    if (request.draw_joints && !pose_crowd && mode != SKINNING_MODE_BAKED)
+    {
+        packet.debug_geometry.addSkeleton(skeleton, drawn_pose, transforms);
+        for (size_t socket = 0; socket < socket_transforms.size(); ++socket)
+        {
+            const mat4& transform = socket_transforms[socket];
+            packet.debug_geometry.addLine(transform[3], color4(1, 0, 0, 1),
+                                          transform[3] + transform[0] * SOCKET_AXIS_LENGTH, color4(1, 0, 0, 1));
+            packet.debug_geometry.addLine(transform[3], color4(0, 1, 0, 1),
+                                          transform[3] + transform[1] * SOCKET_AXIS_LENGTH, color4(0, 1, 0, 1));
+        }
+    }
+
+    packet.serial = request.serial;
+    packet.skinning_mode = mode;
+    packet.compare_mode = request.compare_mode;
+    packet.block_version = block_version;
+    packet.input_milliseconds = request.input_milliseconds;
+    packet.posed_milliseconds = getTimeMilliseconds();
+
+    // keep going until the easing settles, or for as long as the clip plays.
+    // The crowd's distant instances take a few more frames to catch up.
+    packet.animating = clip_playing || request.ragdoll || request.instant_replay ||
+                       previous_blend_factor != request.target_blend_factor;
+    if (pose_crowd && crowd_quiet_frames < 2 * crowd_animation_lod->getMaxUpdateInterval())
+        packet.animating = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Overwrites current_pose with the next frame of the instant
+///         replay, starting from the oldest one recorded and looping back
+///         to it after the newest.  Its colors are left as they were posed.
+void playInstantReplay()
+{
+    size_t first = instant_replay_buffer->getFirstFrame();
+    size_t end = instant_replay_buffer->getEndFrame();
+    if (first == end)
+        return;
+
+    if (instant_replay_frame == size_t(-1) || instant_replay_frame + 1 >= end)
+        instant_replay_frame = first;
+    else
+        ++instant_replay_frame;
+    instant_replay_buffer->getFrame(instant_replay_frame, current_pose);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Solves current_pose's IK chains, in place, after blending.
+///
+/// \details A foot is only solved when the animation puts it below the
+///         floor, and then only lifted straight up onto it, so the knee
+///         keeps bending the way the animation bends it the rest of the
+///         time.
+void solveCurrentPoseIk(const SimulationRequest& request)
+{
+    solveTwoBoneIk(skeleton, REACH_CHAIN, &request.ik_target, &current_pose, 1);
+
+    vec2 right_foot = getModelPosition(skeleton, current_pose, RIGHT_FOOT_CHAIN.mid_joint, LIMB_END_OFFSET);
+    if (right_foot.y < IK_FLOOR_Y)
+    {
+        right_foot.y = IK_FLOOR_Y;
+        solveTwoBoneIk(skeleton, RIGHT_FOOT_CHAIN, &right_foot, &current_pose, 1);
+    }
+
+    vec2 left_foot = getModelPosition(skeleton, current_pose, left_foot_chain.joints.back(), LIMB_END_OFFSET);
+    if (left_foot.y < IK_FLOOR_Y)
+    {
+        left_foot.y = IK_FLOOR_Y;
+        solveFabrikIk(skeleton, left_foot_chain, &left_foot, &current_pose, 1, FABRIK_ITERATIONS, 0.0f,
+                      simulation_arena);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Pushes the clip events crossed since the last frame to
+///         animation_events, while the clip plays.
+///
+/// \details The crowd's instances each follow the clip at their own offset
+///         (see getCrowdPhaseOffset()), whether or not their poses were
+///         evaluated this frame, and whichever leader's pose they share;
+///         otherwise the events are current_pose's, which the baked crowd
+///         plays in step with.  Each advance only steps past the events
+///         crossed.  When playback stops, or moves between the two, the
+///         cursors start over, so nothing is emitted for the time skipped.
+///
+/// \param  pose_crowd Whether the crowd is being posed this frame.
+void emitClipEvents(bool pose_crowd)
+{
+    if (!clip_playing || pose_crowd != clip_events_from_crowd)
+    {
+        if (clip_events_playing)
+        {
+            clip_sampler->reset();
+            for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+                instance_event_cursors[instance].reset();
+        }
+        clip_events_from_crowd = pose_crowd;
+    }
+    clip_events_playing = clip_playing;
+    if (!clip_playing)
+        return;
+
+    if (!pose_crowd)
+    {
+        clip_sampler->emitLoopedEvents(posed_clip_time, CURRENT_POSE_INSTANCE, 1.0f, *animation_events);
+        return;
+    }
+
+    const std::vector<AnimationEvent>& events = sampled_clip->getEvents();
+    float duration = sampled_clip->getDuration();
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+    {
+        float time = std::fmod(posed_clip_time + getCrowdPhaseOffset(instance, 0) * duration, duration);
+        if (time < 0)
+            time += duration;
+        instance_event_cursors[instance].advance(events, time, true, GLuint(instance), 1.0f, *animation_events);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the physics thread, carrying on from wherever the ragdoll
+///         was when it was last stopped.
+void startRagdoll()
+{
+    physics_running = true;
+    physics_thread = std::thread(physicsMain);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops the physics thread, if it's running, and waits for it to
+///         finish its step.
+void stopRagdoll()
+{
+    if (!physics_thread.joinable())
+        return;
+
+    physics_running = false;
+    physics_thread.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The physics thread's main loop: steps the ragdoll every
+///         PHYSICS_STEP_SECONDS, and publishes each step to physics_input.
+///
+/// \details The steps are timed against a fixed schedule rather than each
+///         sleep, so they keep to their rate on average however long each
+///         takes.  If the thread falls behind, it steps without sleeping
+///         until it has caught up.
+void physicsMain()
+{
+    TRACE_THREAD("physics");
+    std::chrono::steady_clock::duration step_duration =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(PHYSICS_STEP_SECONDS));
+    std::chrono::steady_clock::time_point next_step = std::chrono::steady_clock::now();
+
+    while (physics_running)
+    {
+        ragdoll->step(PHYSICS_STEP_SECONDS);
+        ragdoll->write(physics_input->getWriteFrame());
+        physics_input->publish();
+
+        next_step += step_duration;
+        std::this_thread::sleep_until(next_step);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Chooses the level of detail each instance of the crowd is drawn
+///         at, and lays out the packet's instance_palettes to suit.
+///
+/// \details An instance is drawn at the first level whose LOD_MIN_PIXELS
+///         its diameter on screen reaches, as the request's camera sees
+///         the sphere of MESH_RADIUS around it (see
+///         Camera::getPixelDiameter()).  Root motion only moves an instance
+///         about its cell, so the cell's center is used.
+///
+///         The compute skinner only has the full mesh, so it always gets
+///         level 0.
+///
+///         With impostors, the instanced crowd's instances below
+///         IMPOSTOR_MAX_PIXELS are drawn from impostor_atlas instead, but
+///         keep the last level, which their states are keyed at.  The atlas
+///         only has the bounce, so not while the clip plays; nor when the
+///         GPU culls, since every instance would need a palette anyway.
+void selectInstanceLods(const SimulationRequest& request, FramePacket& packet)
+{
+    size_t lod_count = request.skinning_mode == SKINNING_MODE_COMPUTE ? 1 : mesh_lod_count;
+    bool use_impostors = request.impostors && request.skinning_mode == SKINNING_MODE_INSTANCED &&
+                         !request.play_clip && !request.gpu_culling;
+
+    packet.instance_lods.resize(N_INSTANCES);
+    packet.instance_impostors.assign(N_INSTANCES, 0);
+    packet.impostors.clear();
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+    {
+        const mat4& transform = instance_transforms[instance];
+        float radius = MESH_RADIUS * glm::length(vec3(transform[0]));
+        float diameter = request.camera.getPixelDiameter(vec3(transform[3]), radius, request.viewport);
+
+        size_t lod = 0;
+        while (lod + 1 < lod_count && diameter < LOD_MIN_PIXELS[lod])
+            ++lod;
+
+        packet.instance_lods[instance] = GLuint(lod);
+        packet.instance_impostors[instance] = use_impostors && diameter < IMPOSTOR_MAX_PIXELS ? 1 : 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Lays out the palettes of the crowd's visible instances in a
+///         packet's instance_palettes.
+///
+/// \details The palettes of the visible instances at each level are packed
+///         together, grouped by variant (see getCrowdVariant()) and then in
+///         order of instance, with a matrix for each of the level's
+///         joints, so culled instances are neither built, uploaded nor
+///         drawn.  The compute skinner looks each visible instance's
+///         palette up by its instance index, so in SKINNING_MODE_COMPUTE
+///         every instance keeps its own place, and the culled instances'
+///         places are just left alone.
+///
+///         The instanced crowd's palettes are streamed into the packet's
+///         own buffer instead, laid out the same way, whenever it's mapped
+///         and they fit; see PaletteStream.
+void layoutInstancePalettes(const SimulationRequest& request, FramePacket& packet)
+{
+    bool compute = request.skinning_mode == SKINNING_MODE_COMPUTE;
+    packet.palettes_streamed = false;
+
+    packet.instance_slots.resize(N_INSTANCES);
+    packet.instance_palette_generations.resize(N_INSTANCES);
+    packet.lod_instance_counts.assign(mesh_lod_count, 0);
+    packet.lod_palette_offsets.assign(mesh_lod_count, 0);
+    packet.lod_instance_offsets.assign(mesh_lod_count, 0);
+    packet.lod_variant_counts.assign(mesh_lod_count * N_CROWD_VARIANTS, 0);
+    packet.lod_variant_first_slots.assign(mesh_lod_count * N_CROWD_VARIANTS, 0);
+    for (size_t i = 0; i < packet.visible_instances.size(); ++i)
+    {
+        GLuint instance = packet.visible_instances[i];
+        size_t lod = packet.instance_lods[instance];
+        ++packet.lod_instance_counts[lod];
+        ++packet.lod_variant_counts[lod * N_CROWD_VARIANTS + getCrowdVariant(instance)];
+    }
+
+    if (compute)
+    {
+        for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+            packet.instance_slots[instance] = GLuint(instance);
+        packet.instance_palette_count = packet.hierarchy_on_gpu ? 0 : N_INSTANCES * skeleton.getJointCount();
+        packet.instance_palettes.resize(packet.instance_palette_count);
+        return;
+    }
+
+    // within each level, the instances of each variant come together, still
+    // in order of instance, so the instanced crowd can draw them all at once.
+    size_t next_slots[N_MESH_LODS * N_CROWD_VARIANTS];
+    for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+    {
+        size_t slot = 0;
+        for (size_t v = 0; v < N_CROWD_VARIANTS; ++v)
+        {
+            packet.lod_variant_first_slots[lod * N_CROWD_VARIANTS + v] = slot;
+            next_slots[lod * N_CROWD_VARIANTS + v] = slot;
+            slot += packet.lod_variant_counts[lod * N_CROWD_VARIANTS + v];
+        }
+    }
+    for (size_t i = 0; i < packet.visible_instances.size(); ++i)
+    {
+        GLuint instance = packet.visible_instances[i];
+        size_t lod = packet.instance_lods[instance];
+        packet.instance_slots[instance] = GLuint(next_slots[lod * N_CROWD_VARIANTS + getCrowdVariant(instance)]++);
+    }
+
+    size_t palette_count = 0;
+    size_t instance_count = 0;
+    for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+    {
+        packet.lod_palette_offsets[lod] = palette_count;
+        packet.lod_instance_offsets[lod] = instance_count;
+        palette_count += packet.lod_instance_counts[lod] * getLodJointCount(lod);
+        instance_count += packet.lod_instance_counts[lod];
+    }
+
+    // half floats are packed from the full palettes, so they aren't
+    // streamed, and neither are palettes whose motion vectors are drawn:
+    // the last packet's buffer is written again as soon as it's given up.
+    bool half = request.skinning_mode == SKINNING_MODE_INSTANCED && request.half_palettes && !request.gpu_culling;
+    packet.palettes_streamed = request.skinning_mode == SKINNING_MODE_INSTANCED && !half && !request.motion_vectors &&
+                               packet.streamed_palettes != nullptr &&
+                               palette_count <= packet.streamed_palette_capacity;
+    if (!packet.palettes_streamed)
+        packet.instance_palettes.resize(palette_count);
+    packet.instance_palette_count = palette_count;
+
+    if (half)
+    {
+        packet.half_palettes.resize(palette_count * 3);
+        packet.instance_origins.resize(instance_count);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records the layout of the palettes a packet writes into
+///         palette_ring, for motion_vectors and writeInstancePalettes(),
+///         and compares it with the last frame's.
+///
+/// \details The layout is the packet's visible instances, in order, with
+///         their levels of detail, and whether the palettes are half
+///         floats; layoutInstancePalettes() places every palette from just
+///         those, so two frames with the same layout put each instance's
+///         palette in the same place in their regions.
+///
+/// \return true if the previous region holds the same instances' palettes
+///         in the same places, so they can be read as their previous ones.
+bool recordPaletteLayout(const FramePacket& packet, bool half)
+{
+    palette_layout.clear();
+    palette_layout.push_back(half ? 1 : 0);
+    for (size_t i = 0; i < packet.visible_instances.size(); ++i)
+    {
+        GLuint instance = packet.visible_instances[i];
+        palette_layout.push_back(instance);
+        palette_layout.push_back(GLuint(packet.instance_lods[instance]));
+    }
+    return palette_layout == previous_palette_layout;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the full palettes in a packet into this frame's region of
+///         palette_ring, skipping those the region already holds, and
+///         counts the ones written in stats.
+///
+/// \details If the region was last written with the layout
+///         recordPaletteLayout() has just recorded, each instance's palette
+///         is where it was, and only those whose generation has moved on
+///         since are written; otherwise, they all are.  With 3 regions, the
+///         region was last written 3 frames ago, so that covers everything
+///         which changed in any of those frames.  The palettes written are
+///         sorted by where they go and merged into runs of neighbors, so
+///         each run is copied and flushed as one range, however many
+///         instances are in it.
+void writeInstancePalettes(const FramePacket& packet, FrameStats& stats)
+{
+    TRACE_SCOPE("write palettes");
+    size_t region = palette_ring->getRegionIndex();
+    std::vector<GLuint>& generations = region_palette_generations[region];
+    bool layout_held = palette_layout == region_palette_layouts[region];
+
+    palette_write_runs.clear();
+    for (size_t i = 0; i < packet.visible_instances.size(); ++i)
+    {
+        GLuint instance = packet.visible_instances[i];
+        if (layout_held && generations[instance] == packet.instance_palette_generations[instance])
+            continue;
+
+        size_t lod = packet.instance_lods[instance];
+        size_t joint_count = getLodJointCount(lod);
+        palette_write_runs.push_back(std::make_pair(packet.lod_palette_offsets[lod] +
+                                                    packet.instance_slots[instance] * joint_count, joint_count));
+        generations[instance] = packet.instance_palette_generations[instance];
+        ++stats.palettes_uploaded;
+    }
+
+    std::sort(palette_write_runs.begin(), palette_write_runs.end());
+    size_t run_count = 0;
+    for (size_t i = 0; i < palette_write_runs.size(); ++i)
+    {
+        if (run_count > 0 && palette_write_runs[run_count - 1].first + palette_write_runs[run_count - 1].second ==
+                             palette_write_runs[i].first)
+            palette_write_runs[run_count - 1].second += palette_write_runs[i].second;
+        else
+            palette_write_runs[run_count++] = palette_write_runs[i];
+    }
+    palette_write_runs.resize(run_count);
+
+    // the region is still mapped when nothing has changed, so that it's
+    // fenced, and the ring moves on, as it would have.
+    size_t palette_bytes = packet.instance_palettes.size() * sizeof(mat4);
+    char* mapped = static_cast<char*>(palette_ring->map(GLsizeiptr(palette_bytes), true));
+    for (size_t i = 0; i < palette_write_runs.size(); ++i)
+    {
+        size_t offset = palette_write_runs[i].first * sizeof(mat4);
+        size_t bytes = palette_write_runs[i].second * sizeof(mat4);
+        std::memcpy(mapped + offset, &packet.instance_palettes[palette_write_runs[i].first], bytes);
+        palette_ring->flush(GLintptr(offset), GLsizeiptr(bytes));
+        stats.palette_bytes_uploaded += bytes;
+    }
+    palette_ring->unmap();
+    region_palette_layouts[region] = palette_layout;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Packs every visible instance's palette in a packet into its
+///         half_palettes, with its origin, if they all pass the guard (see
+///         packHalfPalette()); if not, the full palettes are drawn.
+///
+/// \details The palettes have the camera folded in, so the origins are in
+///         clip space; each instance only has to fit its own pose into the
+///         half floats.  The palettes' jobs must have finished.
+void packHalfInstancePalettes(FramePacket& packet)
+{
+    TRACE_SCOPE("pack half palettes");
+    packet.half_palettes_packed = true;
+    for (size_t i = 0; i < packet.visible_instances.size() && packet.half_palettes_packed; ++i)
+    {
+        GLuint instance = packet.visible_instances[i];
+        size_t lod = packet.instance_lods[instance];
+        size_t offset = packet.lod_palette_offsets[lod] + packet.instance_slots[instance] * getLodJointCount(lod);
+
+        vec3 origin;
+        packet.half_palettes_packed = packHalfPalette(getInstancePalette(packet, instance), getLodJointCount(lod),
+                                                      origin, &packet.half_palettes[offset * 3]);
+        packet.instance_origins[packet.lod_instance_offsets[lod] + packet.instance_slots[instance]] = vec4(origin, 1);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the skeleton of a level of
+///         detail.
+size_t getLodJointCount(size_t lod)
+{
+    return lod == 0 ? skeleton.getJointCount() : mesh_lods[lod]->getJointCount();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns where an instance's palette goes in a packet's
+///         instance_palettes, or its streamed palettes, as laid out by
+///         layoutInstancePalettes().
+mat4* getInstancePalette(FramePacket& packet, size_t instance)
+{
+    size_t lod = packet.instance_lods[instance];
+    size_t offset = packet.lod_palette_offsets[lod] + packet.instance_slots[instance] * getLodJointCount(lod);
+    mat4* palettes = packet.palettes_streamed ? packet.streamed_palettes : packet.instance_palettes.data();
+    return palettes + offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a level of detail's mesh.
+const SkeletalMesh& getLodMesh(size_t lod)
+{
+    return lod == 0 ? *mesh : mesh_lods[lod]->mesh;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of vertices a packet's frame skins, counting
+///         each vertex once for every instance drawn with it.  With GPU
+///         culling, every candidate instance is counted.
+size_t countSkinnedVertices(const FramePacket& packet)
+{
+    switch (packet.skinning_mode)
+    {
+        case SKINNING_MODE_INSTANCED:
+        {
+            size_t vertices = 0;
+            for (size_t lod = 0; lod < packet.lod_instance_counts.size(); ++lod)
+                vertices += packet.lod_instance_counts[lod] * getLodMesh(lod).getVertexCount();
+            return vertices;
+        }
+
+        case SKINNING_MODE_COMPUTE:
+            return packet.visible_instances.size() * mesh->getVertexCount();
+
+        case SKINNING_MODE_BAKED:
+            return N_INSTANCES * mesh->getVertexCount();
+
+        default:
+            return mesh->getVertexCount();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the SKINNING_MODE_INSTANCED program for a level of
+///         detail and number of influences.
+const SkinningProgram& getInstancedProgram(size_t lod, size_t influences)
+{
+    if (lod == 0)
+        return skinning_programs[SKINNING_MODE_INSTANCED][influences - 1];
+    return lod_programs[lod][influences - 1];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the program the instanced crowd is drawn with at a level
+///         of detail and number of influences: the one which draws motion
+///         vectors, while they're shown.
+GLuint getInstancedProgramId(size_t lod, size_t influences)
+{
+    const SkinningProgram& program = getInstancedProgram(lod, influences);
+    return motion_vectors ? program.motion_vector_id : program.id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the NUMA node an instance of the crowd's poses, joint
+///         transforms and palette are on, and its jobs start on.
+///
+/// \details The crowd is split into one contiguous run of instances per
+///         node.  Only the packet's staged palettes, which the GLUT thread
+///         uploads, are shared between the nodes.
+size_t getInstanceNode(size_t instance)
+{
+    return numa_topology->getPartitionNode(instance, N_INSTANCES);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the jobs which pose every instance of the crowd, and
+///         stage their palettes in a packet's instance_palettes.
+///
+/// \details Only the instances crowd_animation_lod picks as leaders need
+///         posing; the rest reuse a leader's pose.  The instances are
+///         grouped by their animation states (see getCrowdStateKey()) first,
+///         so instances at the same level of detail in the same state share
+///         a leader, however far apart they are in the crowd.  Each leader's
+///         update is a chain of three jobs, each of which waits for the one
+///         before: setting up its blend graph's inputs (sampling the clip, if
+///         it's playing), evaluating the graph, and flattening the joint
+///         hierarchy for the joints of its level of detail.  At full detail,
+///         a pose between evaluations is blended in the same pass as the
+///         hierarchy.  The chains are independent, so idle threads steal
+///         whole chains from each other, and each chain normally runs start
+///         to finish on one thread.  Each chain starts on the NUMA node its
+///         leader's poses and transforms are on, and other nodes only steal
+///         it once they run out of their own.  job_system->wait() must be
+///         called before the joint transforms are used.
+///
+///         A leader whose instances have all been hidden from the
+///         occlusion queries for OCCLUSION_POSE_SKIP_COUNT queries in a row
+///         isn't posed at all.  Its transforms are left as they were, which
+///         is what its instances' bounds are queried with until they're
+///         seen again.
+///
+///         Impostors aren't posed either, unless they lead instances which
+///         are drawn from their poses.  selectInstanceLods() must already
+///         have chosen the instances' levels of detail.
+void startPosingInstances(const SimulationRequest& request, FramePacket& packet)
+{
+    crowd_state_cache->clear();
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+        crowd_states[instance] = crowd_state_cache->add(getCrowdStateKey(instance, packet.instance_lods[instance]), instance);
+    crowd_animation_lod->beginFrame(packet.instance_lods.data(), crowd_states.data());
+
+    crowd_leaders_needed.assign(N_INSTANCES, 0);
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+    {
+        if (packet.instance_impostors[instance])
+            continue;
+        if (!request.occlusion_culling || request.hidden_counts[instance] < OCCLUSION_POSE_SKIP_COUNT)
+            crowd_leaders_needed[crowd_animation_lod->getLeader(instance)] = 1;
+    }
+
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+    {
+        if (!crowd_animation_lod->isLeader(instance) || !crowd_leaders_needed[instance])
+            continue;
+
+        JobSystem::JobId job = job_system->createJob(setUpInstanceJob, &packet, instance, JobSystem::NO_JOB,
+                                                     getInstanceNode(instance));
+        job = job_system->createJob(blendInstanceJob, &packet, instance, job);
+        job_system->createJob(hierarchyInstanceJob, &packet, instance, job);
+        packet.joints_evaluated += getLodJointCount(packet.instance_lods[instance]);
+    }
+
+    job_system->submit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the jobs which build the palettes of the crowd's visible
+///         instances, and stage them in a packet's instance_palettes.
+///
+/// \details Each leader with a visible instance reusing its pose, which
+///         normally includes itself, gets a job building its palette.  Each
+///         visible instance then gets a job placing the palette in its cell
+///         of the grid, which waits for the palette.  A job can only have
+///         one dependent, so each placement of a palette waits for the one
+///         before.  job_system->wait() must be called before the palettes
+///         are used.
+///
+///         layoutInstancePalettes() must already have laid out the packet.
+void startBuildingInstancePalettes(FramePacket& packet)
+{
+    crowd_stage_jobs.assign(N_INSTANCES, JobSystem::NO_JOB);
+
+    for (size_t i = 0; i < packet.visible_instances.size(); ++i)
+    {
+        size_t instance = packet.visible_instances[i];
+        size_t leader = crowd_animation_lod->getLeader(instance);
+        if (crowd_stage_jobs[leader] == JobSystem::NO_JOB)
+            crowd_stage_jobs[leader] = job_system->createJob(paletteInstanceJob, &packet, leader, JobSystem::NO_JOB,
+                                                             getInstanceNode(leader));
+
+        crowd_stage_jobs[leader] = job_system->createJob(stageInstanceJob, &packet, instance, crowd_stage_jobs[leader]);
+    }
+
+    job_system->submit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gathers the compact local transforms of the leaders of the
+///         compute crowd's visible instances into a packet's leader_locals,
+///         and each visible instance's palette target, for the GPU to
+///         resolve.
+///
+/// \details Each leader is sent once, however many visible instances reuse
+///         its pose, so only the leaders' local transforms and a placement
+///         per instance are uploaded, rather than a palette per instance.
+///         The placements have the camera folded in, as stageInstanceJob()
+///         folds it into the palettes.  The crowd's posing jobs must have
+///         finished.
+void gatherLeaderLocals(FramePacket& packet)
+{
+    TRACE_SCOPE("gather leader locals");
+    size_t joint_count = skeleton.getJointCount();
+    mat4 view_projection = packet.camera.getViewProjection();
+    crowd_leader_slots.assign(N_INSTANCES, NO_LEADER_SLOT);
+    packet.leader_locals.clear();
+    packet.palette_targets.resize(packet.visible_instances.size());
+    for (size_t i = 0; i < packet.visible_instances.size(); ++i)
+    {
+        GLuint instance = packet.visible_instances[i];
+        size_t leader = crowd_animation_lod->getLeader(instance);
+        if (crowd_leader_slots[leader] == NO_LEADER_SLOT)
+        {
+            crowd_leader_slots[leader] = GLuint(packet.leader_locals.size() / joint_count);
+            const vec4* locals = leader_compact_locals->get(leader);
+            packet.leader_locals.insert(packet.leader_locals.end(), locals, locals + joint_count);
+        }
+
+        HierarchyComputePass::PaletteTarget& target = packet.palette_targets[i];
+        target.placement = view_projection * instance_world_transforms[instance];
+        target.instance = instance;
+        target.leader = crowd_leader_slots[leader];
+        target.padding[0] = 0;
+        target.padding[1] = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how far along the blend, or the clip, an instance of the
+///         crowd is from the others, as a fraction from 0 to 1.
+///
+/// \details Offsetting each instance by the golden ratio keeps the instances
+///         next to each other well apart.  At levels of detail which share
+///         poses, the offset is rounded to the middle of the instance's
+///         share group, so that every instance in the group is animated
+///         identically.
+float getCrowdPhaseOffset(size_t instance, size_t lod)
+{
+    if (ANIMATION_LOD_LEVELS[lod].share_poses)
+        return (instance_share_groups[instance] + 0.5f) / N_SHARE_GROUPS;
+    return std::fmod(instance * 0.618034f, 1.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the state an instance of the crowd is animated in this
+///         frame.
+///
+/// \details Each instance is offset along the blend between left_pose and
+///         right_pose, or along the clip while it plays, so that they don't
+///         all move in lockstep (see getCrowdPhaseOffset()).  The state is
+///         what's left once the offset has been applied: the clip time, and
+///         the weights of the blend graph's parameters.  Instances at
+///         opposite phases of the bounce blend with the same weights, so
+///         they share states too.
+AnimationStateKey getCrowdStateKey(size_t instance, size_t lod)
+{
+    float offset = getCrowdPhaseOffset(instance, lod);
+    float phase = std::fmod(blend_factor + offset, 1.0f);
+
+    AnimationStateKey key;
+    if (clip_playing)
+    {
+        float duration = clip->getDuration();
+        key.clip = clip_handle.slot + 1;
+        key.time = AnimationStateCache::quantize(std::fmod(posed_clip_time + offset * duration, duration), STATE_STEPS);
+    }
+
+    float weights[2];
+    computeCrowdWeights(phase, weights);
+    key.weights[CROWD_PARAMETER_BLEND] = AnimationStateCache::quantize(weights[CROWD_PARAMETER_BLEND], STATE_STEPS);
+    key.weights[CROWD_PARAMETER_WAVE] = AnimationStateCache::quantize(weights[CROWD_PARAMETER_WAVE], STATE_STEPS);
+    return key;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the crowd's blend graph parameters at a phase of its
+///         bounce, from 0 to 1: back and forth between the two poses, and
+///         a wave twice per bounce.  Opposite phases get the same weights.
+///
+/// \param  phase How far through the bounce.
+/// \param  weights Receives the weights, indexed by CrowdParameter.
+void computeCrowdWeights(float phase, float* weights)
+{
+    weights[CROWD_PARAMETER_BLEND] = 1.0f - std::abs(phase * 2.0f - 1.0f);
+    weights[CROWD_PARAMETER_WAVE] = 0.5f - 0.5f * std::cos(phase * 4.0f * glm::pi<float>());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the frame of impostor_atlas which shows an instance of
+///         the crowd at its phase this frame, while the clip isn't playing.
+///
+/// \details The frames only go halfway through the bounce, since the
+///         second half goes back through the same states (see
+///         initImpostors()), so the phase is folded back into the first
+///         half, and rounded to the nearest frame.
+size_t getImpostorFrame(size_t instance, size_t lod)
+{
+    float phase = std::fmod(blend_factor + getCrowdPhaseOffset(instance, lod), 1.0f);
+    float folded = std::min(phase, 1.0f - phase);
+    return std::min(size_t(folded * 2.0f * (N_IMPOSTOR_FRAMES - 1) + 0.5f), N_IMPOSTOR_FRAMES - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns which of the N_CROWD_VARIANTS an instance of the crowd
+///         is drawn as; see crowd_variants.
+size_t getCrowdVariant(size_t instance)
+{
+    return instance % N_CROWD_VARIANTS;
+}
 
-    poses[1].joints[2].parent = &poses[1].joints[0];
-    poses[1].joints[2].rotation = 165.0f;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a joint's color in one of the crowd's variants: the
+///         color's red, green and blue rotated once per variant.
+///
+/// \param  color The joint's color in variant 0.
+/// \param  variant The variant, from 0 to N_CROWD_VARIANTS - 1.
+color4 getCrowdVariantColor(const color4& color, size_t variant)
+{
+    color4 rotated = color;
+    for (size_t i = 0; i < variant; ++i)
+        rotated = color4(rotated.g, rotated.b, rotated.r, rotated.a);
+    return rotated;
+}
 
-    poses[1].joints[3].parent = &poses[1].joints[0];
-    poses[1].joints[3].rotation = -75.0f;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the state current_pose is animated in this frame: the
+///         clip time while the clip plays, otherwise the blend between
+///         left_pose and right_pose.
+AnimationStateKey getCurrentPoseKey()
+{
+    AnimationStateKey key;
+    if (clip_playing)
+    {
+        float duration = clip->getDuration();
+        float time = std::fmod(posed_clip_time, duration);
+        if (time < 0)
+            time += duration;
 
-    poses[1].joints[4].parent = &poses[1].joints[1];
-    poses[1].joints[4].rotation = -45.0f;
+        key.clip = clip_handle.slot + 1;
+        key.time = AnimationStateCache::quantize(time, STATE_STEPS);
+    }
+    else
+        key.weights[0] = AnimationStateCache::quantize(blend_factor, STATE_STEPS);
+    return key;
+}
 
-    poses[1].joints[5].parent = &poses[1].joints[2];
-    poses[1].joints[5].rotation = -45.0f;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets a leader's blend graph inputs and parameters from its state
+///         (see getCrowdStateKey()).
+///
+/// \details The rounded time and weights are used, rather than the
+///         instance's own, so that everything sharing the state is drawn
+///         exactly as the leader is posed.  Nothing needs doing on the
+///         frames an instance's pose isn't evaluated.  While the clip plays,
+///         the inputs are left to blendInstanceJob(), which samples the
+///         clip into its thread's pose.
+void setUpInstanceJob(void*, size_t instance)
+{
+    if (!crowd_animation_lod->needsEvaluation(instance))
+        return;
 
-    poses[1].joints[6].parent = &poses[1].joints[3];
-    poses[1].joints[6].rotation = -45.0f;
+    const AnimationStateKey& key = crowd_state_cache->getKey(crowd_states[instance]);
+    BlendGraphContext& context = *crowd_contexts[instance];
+    if (key.clip == 0)
+    {
+        context.setInput(CROWD_INPUT_FROM, poses[left_pose]);
+        context.setInput(CROWD_INPUT_TO, poses[right_pose]);
+    }
 
+    context.setParameter(CROWD_PARAMETER_BLEND, AnimationStateCache::dequantize(key.weights[CROWD_PARAMETER_BLEND], STATE_STEPS));
+    context.setParameter(CROWD_PARAMETER_WAVE, AnimationStateCache::dequantize(key.weights[CROWD_PARAMETER_WAVE], STATE_STEPS));
+}
 
-    poses[2] = poses[0];
-    poses[2].joints[1].parent = &poses[2].joints[0];
-    poses[2].joints[1].rotation = 135.0f;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Evaluates an instance's blend graph into its pose, if it's due,
+///         and interpolates the pose to draw from the last two evaluations
+///         below full detail, in the packet data points to.  At full detail
+///         the hierarchy job blends them itself, without storing the pose.
+///
+/// \details The clip is sampled, and the graph evaluated, with the poses
+///         of the thread the job runs on, which nothing else running on
+///         the thread can be using until the job returns.
+void blendInstanceJob(void* data, size_t instance)
+{
+    TRACE_SCOPE("blend instance");
+    const FramePacket& packet = *static_cast<const FramePacket*>(data);
+    if (crowd_animation_lod->needsEvaluation(instance))
+    {
+        Pose* thread_poses = &crowd_thread_poses[JobSystem::getCurrentThread() * crowd_thread_pose_count];
+        BlendGraphContext& context = *crowd_contexts[instance];
+        const AnimationStateKey& key = crowd_state_cache->getKey(crowd_states[instance]);
+        if (key.clip != 0)
+        {
+            float time = AnimationStateCache::dequantize(key.time, STATE_STEPS);
+            instance_samplers[instance].sampleLooped(time, thread_poses[0]);
+            context.setInput(CROWD_INPUT_FROM, thread_poses[0]);
+            context.setInput(CROWD_INPUT_TO, thread_poses[0]);
+        }
 
-    poses[2].joints[2].parent = &poses[2].joints[0];
-    poses[2].joints[2].rotation = 255.0f;
+        std::swap(crowd_previous_poses[instance], crowd_evaluated_poses[instance]);
+        context.evaluate(crowd_evaluated_poses[instance], thread_poses + 1);
+    }
 
-    poses[2].joints[3].parent = &poses[2].joints[0];
-    poses[2].joints[3].rotation = 15.0f;
+    float t = crowd_animation_lod->getInterpolation(instance);
+    if (t < 1.0f && packet.instance_lods[instance] != 0)
+        blendPoses(crowd_previous_poses[instance], crowd_evaluated_poses[instance], t, crowd_poses[instance]);
+}
 
-    poses[2].joints[4].parent = &poses[2].joints[1];
-    poses[2].joints[4].rotation = 45.0f;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the joint transforms of an instance's pose, for the
+///         joints of its level of detail in the packet data points to.
+///
+/// \details When the packet's hierarchy is resolved on the GPU, only the
+///         compact local transforms are computed, into
+///         leader_compact_locals; the compute crowd is always at full
+///         detail.  Its jiggle joints are left out, since their targets
+///         are the model space transforms the CPU no longer has.
+void hierarchyInstanceJob(void* data, size_t instance)
+{
+    TRACE_SCOPE("hierarchy instance");
+    const FramePacket& packet = *static_cast<const FramePacket*>(data);
+    size_t lod = packet.instance_lods[instance];
+    mat4* transforms = instance_joint_transforms->get(instance);
 
-    poses[2].joints[5].parent = &poses[2].joints[2];
-    poses[2].joints[5].rotation = 45.0f;
+    float t = crowd_animation_lod->getInterpolation(instance);
+    const Pose& pose = t < 1.0f ? crowd_poses[instance] : crowd_evaluated_poses[instance];
 
-    poses[2].joints[6].parent = &poses[2].joints[3];
-    poses[2].joints[6].rotation = 45.0f;
+    if (packet.hierarchy_on_gpu)
+    {
+        // blendInstanceJob() leaves full detail's blend to this job.
+        if (t < 1.0f)
+            blendPoses(crowd_previous_poses[instance], crowd_evaluated_poses[instance], t, crowd_poses[instance]);
+        computeCompactLocalTransforms(pose, leader_compact_locals->get(instance));
+        return;
+    }
 
-    current_pose = poses[0];
+    if (lod == 0)
+    {
+        if (t < 1.0f)
+            DemoRigEval::blendJointTransforms(crowd_previous_poses[instance], crowd_evaluated_poses[instance], t,
+                                              transforms);
+        else if (crowd_channel_plan != nullptr)
+            crowd_channel_plan->computeJointTransforms(pose, transforms);
+        else
+            DemoRigEval::computeJointTransforms(pose, transforms);
+        crowd_jiggle->setTargets(instance, transforms);
+    }
+    else
+        computeReducedJointTransforms(mesh_lods[lod]->skeleton, pose, transforms);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  Cleans up the demo in preparation for exit.  Releases all OpenGL
-///         resources remaining.
-void cleanup()
+/// \brief  Builds a leader's skinning palette, for the joints of its level
+///         of detail in the packet data points to, with its jiggle joints
+///         where crowd_jiggle left them at full detail.
+void paletteInstanceJob(void* data, size_t instance)
+{
+    TRACE_SCOPE("palette instance");
+    const FramePacket& packet = *static_cast<const FramePacket*>(data);
+    size_t lod = packet.instance_lods[instance];
+    const mat4* lod_bind_pose_inv = lod == 0 ? skeleton.getInverseBindTransforms()
+                                             : mesh_lods[lod]->bind_pose_inv.data();
+
+    computeSkinningPalette(instance_joint_transforms->get(instance), lod_bind_pose_inv,
+                           getLodJointCount(lod), leader_palettes->get(instance));
+    if (lod == 0)
+        crowd_jiggle->applyToPalette(instance, leader_palettes->get(instance));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Places the palette of an instance's leader in the instance's
+///         cell of the grid, as the camera sees it, leaving it in the
+///         packet ready for the upload, or streaming it straight into the
+///         packet's buffer.
+///
+/// \details A palette left in the packet is compared with the one last
+///         left there for the instance, and if it differs at all, or the
+///         level of detail does, the instance's generation moves on; the
+///         packet's instance_palette_generations tells the upload which
+///         palettes palette_ring's regions already hold (see
+///         writeInstancePalettes()).  The palettes have the camera folded
+///         in, so while it moves, every one of them changes.
+void stageInstanceJob(void* data, size_t instance)
 {
-    if (shader_program_id != 0)
+    TRACE_SCOPE("stage instance");
+    FramePacket& packet = *static_cast<FramePacket*>(data);
+    GLuint lod = packet.instance_lods[instance];
+    size_t joint_count = getLodJointCount(lod);
+    const mat4* source = leader_palettes->get(crowd_animation_lod->getLeader(instance));
+    mat4 transform = packet.camera.getViewProjection() * instance_world_transforms[instance];
+    if (packet.palettes_streamed)
     {
-        glDeleteProgram(shader_program_id);
-        shader_program_id = 0;
+        streamTransformedPalette(transform, source, joint_count, getInstancePalette(packet, instance));
+        return;
     }
 
-    delete mesh;
+    mat4* palette = getInstancePalette(packet, instance);
+    transformPalette(transform, source, joint_count, palette);
+
+    mat4* staged = &staged_palettes[instance * skeleton.getJointCount()];
+    if (staged_palette_lods[instance] != lod || std::memcmp(staged, palette, joint_count * sizeof(mat4)) != 0)
+    {
+        std::copy(palette, palette + joint_count, staged);
+        staged_palette_lods[instance] = lod;
+        ++staged_palette_generations[instance];
+    }
+    packet.instance_palette_generations[instance] = staged_palette_generations[instance];
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  GLUT callback handling window resize events.
+/// \brief  Works out where each instance of the crowd is this frame, in
+///         instance_world_transforms.
 ///
-/// \param width The window's new width.
-/// \param height The window's new height.
-void reshape(int width, int height)
+/// \details While the clip plays, each instance is moved from its cell by
+///         the clip's root motion at its state's time, so instances sharing
+///         a state move together, as they're posed together.  The time
+///         wraps with the clip, so the instances stay in their cells.
+///         startPosingInstances() must already have chosen the states.
+void updateInstanceTransforms()
 {
-    glutReshapeWindow(width, height);
-
-    viewport.x = width;
-    viewport.y = height;
-    glViewport(0, 0, width, height);
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
+    {
+        mat4& transform = instance_world_transforms[instance];
+        transform = instance_transforms[instance];
 
-    glutPostRedisplay();
+        const AnimationStateKey& key = crowd_state_cache->getKey(crowd_states[instance]);
+        if (key.clip != 0 && clip->hasRootMotion())
+        {
+            vec2 root_motion = clip->sampleRootMotion(AnimationStateCache::dequantize(key.time, STATE_STEPS));
+            transform = glm::translate(transform, vec3(root_motion, 0));
+        }
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  GLUT callback to render a frame.
+/// \brief  Fills a packet's draw list with the instances of the crowd whose
+///         bounds are in view of the packet's camera.
 ///
-/// \details There is remarkably little needed to render a skeletal mesh:
-///         just bind the right shader program and vertex array and make sure
-///         the shader's uniforms are up-to-date, then call glDrawElements.
-void display()
+/// \details Each instance is bounded in its current pose by transforming
+///         the joint-space bounds of its level of detail with its leader's
+///         joint transforms (see computeSkinnedBounds()); that's one box
+///         per joint, however many vertices the mesh has.  The box is then
+///         tested against the camera from where updateInstanceTransforms()
+///         put the instance (see Camera::isVisible()).  The root's travel
+///         is in the instance's transform rather than its joints, so the
+///         bounds only cover the pose.
+///
+///         With the occlusion culling, every instance in view is a
+///         candidate for the next queries, with its box as its proxy, but
+///         the ones the latest results found hidden are left out of the
+///         draw list.
+///
+///         Impostors may not have been posed, so they're bounded by the
+///         square of MESH_RADIUS around them instead, and those in view go
+///         into the packet's impostors rather than the draw list.  They
+///         aren't queried, since they cost too little to be worth skipping,
+///         and they aren't skinned, so they're left out of its
+///         joint_box_bounds.
+void cullInstances(const SimulationRequest& request, FramePacket& packet)
 {
-    glClear(GL_COLOR_BUFFER_BIT);
+    BoundingBox impostor_bounds;
+    impostor_bounds.expand(vec2(-MESH_RADIUS));
+    impostor_bounds.expand(vec2(MESH_RADIUS));
 
-    glUseProgram(shader_program_id);
-    glBindVertexArray(mesh->vao_id);
-
-    mat4 current_pose_data[7];
-    vec4 current_pose_color_data[7];
-    for (size_t joint = 0; joint < 7; ++joint)
+    packet.visible_instances.clear();
+    packet.instance_depths.resize(N_INSTANCES);
+    for (size_t instance = 0; instance < N_INSTANCES; ++instance)
     {
-        JointPose& jp = current_pose.joints[joint];
-        current_pose_data[joint] = getJointTransform(jp);
-        current_pose_color_data[joint] = jp.color;
-    }
+        size_t lod = packet.instance_lods[instance];
+        if (packet.instance_impostors[instance])
+        {
+            const mat4& world_transform = instance_world_transforms[instance];
+            if (packet.camera.isVisible(impostor_bounds, world_transform))
+            {
+                packet.impostors.push_back(world_transform[0]);
+                packet.impostors.push_back(world_transform[1]);
+                packet.impostors.push_back(vec4(vec3(world_transform[3]), float(getImpostorFrame(instance, lod))));
+            }
+            continue;
+        }
+
+        // without the joint transforms, which the GPU resolves, an instance
+        // is bounded like an impostor.
+        BoundingBox bounds = impostor_bounds;
+        if (!packet.hierarchy_on_gpu)
+        {
+            const mat4* transforms = instance_joint_transforms->get(crowd_animation_lod->getLeader(instance));
+            bounds = computeSkinnedBounds(lod_joint_bounds[lod].get()->data(), transforms, getLodJointCount(lod));
+        }
+        if (!packet.camera.isVisible(bounds, instance_world_transforms[instance]))
+            continue;
 
-    glUniformMatrix4fv(current_pose_uniform_location, 7, GL_FALSE, &current_pose_data[0][0][0]);
-    glUniform4fv(current_pose_colors_uniform_location, 7, &current_pose_color_data[0][0]);
+        if (request.occlusion_culling)
+        {
+            packet.occlusion_candidates.push_back(GLuint(instance));
+            packet.proxy_transforms[instance] = OcclusionQueries::getProxyTransform(bounds, instance_world_transforms[instance]);
+            if (request.hidden_counts[instance] > 0)
+                continue;
+        }
+        packet.visible_instances.push_back(GLuint(instance));
+        packet.joint_box_bounds.expand(transformBox(bounds, instance_world_transforms[instance]));
 
-    glDrawElements(GL_TRIANGLES, mesh->indices.size(), GL_UNSIGNED_SHORT, 0);
+        // the origin's depth is enough to draw the nearer instances of each
+        // of the render queue's batches first.
+        vec4 origin = packet.camera.getViewProjection() * instance_world_transforms[instance][3];
+        packet.instance_depths[instance] = origin.w > 0.0f ? origin.z / origin.w * 0.5f + 0.5f : 0.0f;
+    }
+}
 
-    glBindVertexArray(0);
-    glUseProgram(0);
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates instance_cull_pass, or creates it again once the
+///         levels of detail have moved in mesh_arena, with every level's
+///         joint bounds and commands.
+///
+/// \details The pass is culled with bind-pose bounds and the instances'
+///         palettes, rather than lod_joint_bounds and the leaders' joint
+///         transforms as cullInstances() is, since the palettes are all the
+///         GPU has.
+void createInstanceCullPass()
+{
+    delete instance_cull_pass;
+    instance_cull_pass = new InstanceCullPass(N_INSTANCES);
+    for (size_t lod = 0; lod < mesh_lod_count; ++lod)
+        instance_cull_pass->addMesh(mesh_allocations[lod], getLodMesh(lod).getJointBounds(), getLodJointCount(lod));
+
+    if (gpu_culling)
+        instance_cull_pass->attachSurvivors(mesh_arena->getVertexArray(mesh->vertex_format));
+}
 
-    // draw joints/bones using immediate mode, because it's just for debugging purposes.
-    if (draw_joints)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gives compute_skinner the mesh's vertices in the order they were
+///         uploaded, and creates skinning_balancer to split the crowd
+///         between it and the CPU.
+///
+/// \details The vertices are only on the CPU for the built-in mesh, and a
+///         mesh file's upload doesn't keep where each went, so otherwise
+///         every instance stays on the GPU, and the problem is reported to
+///         stderr.
+void initSkinningBalancer()
+{
+    if (compute_skinner == nullptr)
     {
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
+        std::cerr << "-balance-skinning needs compute shaders; the crowd is skinned on the GPU." << std::endl;
+        return;
+    }
 
-        for (size_t joint = 0; joint < 7; ++joint)
-        {
-            JointPose& joint_pose = current_pose.joints[joint];
+    // each vertex's influences are sorted the way the upload sorted them,
+    // so the CPU's weights match what the compute shader reads.
+    const std::vector<GLuint>& remap = mesh->getUploadRemap().vertices;
+    if (remap.size() != mesh->vertices.size() || mesh->vertices.size() < mesh->getVertexCount())
+    {
+        std::cerr << "-balance-skinning needs the mesh's vertices on the CPU; the crowd is skinned on the GPU."
+                  << std::endl;
+        return;
+    }
 
-            mat4 transform = getJointTransform(joint_pose);
-            glLoadMatrixf(&transform[0][0]);
+    std::vector<Vertex> vertices(mesh->getVertexCount());
+    for (size_t v = 0; v < mesh->vertices.size(); ++v)
+        vertices[remap[v]] = sortInfluences(mesh->vertices[v]);
+    compute_skinner->setCpuVertices(thread_pool, std::move(vertices));
+    skinning_balancer = new SkinningBalancer();
+}
 
-            if (joint_pose.parent)
-            {
-                mat4 parent_to_local_transform = glm::inverse(getJointLocalTransform(joint_pose));
-                vec4 parent_position = parent_to_local_transform * vec4(0, 0, 0, 1);
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates crowd_hierarchy_pass, which resolves the compute crowd's
+///         hierarchy and palettes on the GPU for -gpu-hierarchy.
+///
+/// \details Without compute shaders, there's no compute crowd either, so
+///         gpu_hierarchy is turned off and the problem reported to stderr.
+///         This runs before the simulation thread starts, which reads
+///         gpu_hierarchy without a lock.
+void initGpuHierarchy()
+{
+    if (compute_skinner == nullptr)
+    {
+        std::cerr << "-gpu-hierarchy needs compute shaders; the crowd's palettes are built on the CPU." << std::endl;
+        gpu_hierarchy = false;
+        return;
+    }
 
-                if (parent_position.x != 0 || parent_position.y != 0)
-                {
-                    vec4 tangent = glm::normalize(vec4(parent_position.y, -parent_position.x, 0, 1)) * 0.05f;
-                    vec4 parent_0 = parent_position + tangent;
-                    vec4 parent_1 = parent_position - tangent;
+    crowd_hierarchy_levels = new HierarchyLevels(skeleton);
+    crowd_hierarchy_pass = new HierarchyComputePass(*crowd_hierarchy_levels, N_INSTANCES);
+    crowd_hierarchy_pass->setInverseBindTransforms(skeleton.getInverseBindTransforms());
+}
 
-                    glBegin(GL_LINES);
-                        glColor4fv(&joint_pose.parent->color[0]);
-                        glVertex2fv(&parent_0[0]);
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Bakes the pose of the frame just drawn into a static mesh file in
+///         POSED_MESH_DIRECTORY, or finds it there already.
+///
+/// \details If the frame's skinning pass captured the mesh's vertices with
+///         transform feedback, they're read back from skinned_vertex_cache;
+///         otherwise the CPU skins them from the packet's palette.  Only the
+///         modes which send the packet a palette can bake, since the
+///         normals are turned by it either way.
+void bakePose(const DisplayFrame& frame)
+{
+    bake_pose_pending = false;
+    const FramePacket& packet = *frame.packet;
+    if (mesh->vertices.empty() || mesh->getUploadRemap().vertices.size() != mesh->vertices.size())
+    {
+        std::cerr << "The mesh was loaded from a file, so its pose can't be baked." << std::endl;
+        return;
+    }
+    if (packet.skinning_palette.empty())
+    {
+        std::cerr << "Only the palette, texture palette and CPU modes can bake the pose." << std::endl;
+        return;
+    }
 
-                        glColor4fv(&joint_pose.color[0]);
-                        glVertex2f(0, 0);
-                        glVertex2f(0, 0);
+    bool gpu = frame.pre_skinned && packet.skinning_mode != SKINNING_MODE_CPU;
+    PosedMeshSource source;
+    source.palette = packet.skinning_palette.data();
+    source.joint_count = packet.skinning_palette.size();
+    source.skinned_buffer = gpu ? skinned_vertex_cache->getVertexBuffer() : 0;
+    source.backend = gpu ? std::string("gpu ") + SKINNING_MODE_NAMES[packet.skinning_mode] : std::string("cpu");
+
+    bool cached = false;
+    std::string path = bakePosedMesh(*mesh, source, POSED_MESH_DIRECTORY, cached);
+    if (cached)
+        std::cerr << "The pose was baked already, to " << path << "." << std::endl;
+    else
+        std::cerr << "Baked the pose, skinned on the " << (gpu ? "GPU" : "CPU") << ", to " << path << "."
+                  << std::endl;
+}
 
-                        glColor4fv(&joint_pose.parent->color[0]);
-                        glVertex2fv(&parent_1[0]);
-                    glEnd();
-                }
-            }
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws the rolling mean, median and 99th percentile of each of
+///         the frame's timings in the top left corner of the window.
+///
+/// \details The text is drawn in the platform's bitmap font, which uses the
+///         fixed function raster position; the projection and modelview
+///         matrices are never changed from the identity, so it's given in
+///         clip space.  Only GLUT has a font, so on the other platforms the
+///         overlay is empty.  GPU timings lag a couple of frames behind the
+///         CPU ones.
+void drawProfilerOverlay()
+{
+    const TimingStats* stats[] =
+    {
+        &pose_stats,
+        &palette_stats,
+        &upload_stats,
+        &skinning_gpu_timer->getStats(),
+        &debug_draw_gpu_timer->getStats()
+    };
+    const size_t n_stats = sizeof(stats) / sizeof(stats[0]);
+
+    const float line_height = 30.0f / viewport.y;   // 15 pixels
+    glColor4f(1, 1, 1, 1);
+    for (size_t i = 0; i < n_stats; ++i)
+    {
+        std::string line = formatTimingStats(*stats[i]);
+        glRasterPos2f(-0.98f, 0.98f - line_height * (i + 1));
+        platform->drawText(line);
+    }
 
-            glBegin(GL_LINES);
-                glColor4f(1, 0, 0, 1);
-                glVertex2f(0.0f, 0.0f);
-                glVertex2f(0.1f, 0.0f);
+    std::ostringstream binds;
+    binds << "binds: " << last_frame_stats.state_changes << " calls, " << last_frame_stats.state_changes_skipped
+          << " skipped; " << last_frame_stats.draw_calls << " draws, " << last_frame_stats.vertices_skinned
+          << " vertices, " << last_frame_stats.palettes_uploaded << " palettes ("
+          << last_frame_stats.palette_bytes_uploaded / 1024 << " KB)";
+    glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 1));
+    platform->drawText(binds.str());
+
+    std::ostringstream memory;
+    memory << "gpu memory: " << residency_manager->getResidentBytes() / 1024 << " of "
+           << residency_manager->getBudget() / 1024 << " KB, " << residency_manager->getEvictionCount()
+           << " evicted, " << residency_manager->getRestoreCount() << " restored; "
+           << frame_graph->getTransientBytes() / 1024 << " KB in " << frame_graph->getTextureCount()
+           << " transient targets";
+    glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 2));
+    platform->drawText(memory.str());
+
+    std::ostringstream resolution;
+    resolution << "resolution: " << render_target->getWidth() << "x" << render_target->getHeight() << " ("
+               << int(render_target->getScale() * 100 + 0.5f) << "%), " << render_target->getSamples() << "x msaa";
+    if (adaptive_resolution)
+        resolution << ", adaptive to " << resolution_controller->getTarget() << " ms";
+    glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 3));
+    platform->drawText(resolution.str());
+
+    std::ostringstream events;
+    events << "clip events: " << clip_event_counts[CLIP_EVENT_LEFT] << " left, "
+           << clip_event_counts[CLIP_EVENT_RIGHT] << " right, " << animation_events->getDroppedCount() << " dropped";
+    glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 4));
+    platform->drawText(events.str());
+
+    // the CPU skinner's bounds are this frame's, and skinned_bounds_pass's
+    // a frame or two old; either way, they're as tight as the vertices.
+    const FramePacket& packet = frame_packets.getReadPacket();
+    BoundingBox skinned;
+    std::ostringstream bounds;
+    bounds << std::fixed << std::setprecision(2) << "bounds: ";
+    if (packet.skinning_mode == SKINNING_MODE_CPU)
+    {
+        skinned = cpu_skinner->getBounds();
+        bounds << "cpu ";
+    }
+    else if (skinned_bounds_reduced && skinned_bounds_pass->getBounds(skinned))
+        bounds << "gpu (" << skinned_bounds_pass->getLatency() << " frames old) ";
 
-                glColor4f(0, 1, 0, 1);
-                glVertex2f(0.0f, 0.0f);
-                glVertex2f(0.0f, 0.1f);
-            glEnd();
+    if (skinned.isEmpty() || packet.joint_box_bounds.isEmpty())
+        bounds << "none";
+    else
+    {
+        vec2 tight = skinned.max - skinned.min;
+        vec2 loose = packet.joint_box_bounds.max - packet.joint_box_bounds.min;
+        bounds << tight.x << "x" << tight.y << ", joint boxes " << loose.x << "x" << loose.y << " ("
+               << int(100 * tight.x * tight.y / std::max(loose.x * loose.y, 1e-6f) + 0.5f) << "% of their area)";
+    }
+    glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 5));
+    platform->drawText(bounds.str());
 
-            glColor4fv(&(joint_pose.color[0]));
-            glBegin(GL_POINTS);
-                glVertex2f(0, 0);
-            glEnd();
-        }
+    // the left half is timed by skinning_gpu_timer, with any shadows or
+    // pre-skinning it has.
+    if (packet.compare_mode != N_SKINNING_MODES)
+    {
+        std::ostringstream comparison;
+        comparison << std::fixed << std::setprecision(3) << "compare: " << SKINNING_MODE_NAMES[packet.skinning_mode]
+                   << " " << skinning_gpu_timer->getStats().getMean() << " ms (left), "
+                   << SKINNING_MODE_NAMES[packet.compare_mode] << " " << compare_gpu_timer->getStats().getMean()
+                   << " ms (right)";
+        glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 6));
+        platform->drawText(comparison.str());
+    }
 
-        glPopMatrix();
+    if (skinning_balancer != nullptr && packet.skinning_mode == SKINNING_MODE_COMPUTE)
+    {
+        std::ostringstream split;
+        split << "skinning split: " << compute_skinner->getCpuCount() << " of " << compute_skinner->getVisibleCount()
+              << " instances on the cpu (" << int(skinning_balancer->getCpuShare() * 100 + 0.5f) << "%, "
+              << std::fixed << std::setprecision(3) << compute_skinner->getCpuMilliseconds() << " ms); job threads "
+              << int(skinning_balancer->getIdleFraction() * 100 + 0.5) << "% idle";
+        glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 9));
+        platform->drawText(split.str());
     }
 
-    glutSwapBuffers();
+    // the GPU's time lags the rest by the frames its queries take.
+    if (latency_tracker != nullptr)
+    {
+        glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 7));
+        platform->drawText(formatTimingStats(latency_tracker->getStats(LatencyTracker::STAGE_PRESENTED)));
+        glRasterPos2f(-0.98f, 0.98f - line_height * (n_stats + 8));
+        platform->drawText(formatTimingStats(latency_tracker->getStats(LatencyTracker::STAGE_GPU_DONE)));
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  GLUT callback handing keyboard input keypresses.
+/// \brief  Window callback handing keyboard input keypresses.
 ///
 /// \param  key The ASCII value of the character pressed.
 /// \param  x The x-coordinate of the mouse when the event occured.
 /// \param  y The y-coordinate of the mouse when the event occured.
-void keyboard(unsigned char key, int x, int y)
+void keyboard(PlatformWindow& window, unsigned char key, int x, int y)
 {
+    TRACE_SCOPE("input");
     switch (key)
     {
         case 27:
-            glutLeaveMainLoop();
+            render_loop->quit();
             return;
 
         case 'w':
-            wireframe = !wireframe;
-            glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+            wireframe_mode = WireframeMode((wireframe_mode + 1) % N_WIREFRAME_MODES);
+            break;
+
+        case 'c':
+            pickAtMouse(x, y);
+            break;
+
+        case 'k':
+            ik_enabled = !ik_enabled;
+            break;
+
+        case 'y':
+            if (instant_replay_enabled)
+            {
+                instant_replay = !instant_replay;
+                std::cerr << (instant_replay ? "Playing the instant replay." : "Instant replay off.") << std::endl;
+            }
+            else
+                std::cerr << "Run with -instant-replay to record the poses for an instant replay." << std::endl;
+            break;
+
+        case 'g':
+            if (session_recorder != nullptr || session_player != nullptr)
+                std::cerr << "The ragdoll can't be replayed, so it's off while recording or replaying." << std::endl;
+            else if (ragdoll_enabled)
+            {
+                stopRagdoll();
+                ragdoll_enabled = false;
+            }
+            else
+            {
+                startRagdoll();
+                ragdoll_enabled = true;
+            }
             break;
 
         case 'j':
             draw_joints = !draw_joints;
             break;
 
+        case 'p':
+            cancelCalibration();
+            skinning_mode = SkinningMode((skinning_mode + 1) % N_SKINNING_MODES);
+            if (skinning_mode == SKINNING_MODE_COMPUTE && compute_skinner == nullptr)
+                skinning_mode = SkinningMode((skinning_mode + 1) % N_SKINNING_MODES);
+
+            // meshes loaded from files don't keep their vertices on the CPU.
+            if (skinning_mode == SKINNING_MODE_CPU && mesh->vertices.empty())
+                skinning_mode = SkinningMode((skinning_mode + 1) % N_SKINNING_MODES);
+            break;
+
+        case 'e':
+            // on to the next mode which can be compared with skinning_mode,
+            // then back off.  The CPU needs the mesh's vertices, like P.
+            cancelCalibration();
+            do
+                compare_mode = SkinningMode((compare_mode + 1) % (N_SKINNING_MODES + 1));
+            while (compare_mode != N_SKINNING_MODES && (getCompareMode(skinning_mode) == N_SKINNING_MODES ||
+                                                        (compare_mode == SKINNING_MODE_CPU && mesh->vertices.empty())));
+            if (compare_mode == N_SKINNING_MODES)
+                std::cerr << "Comparison off." << std::endl;
+            else
+                std::cerr << "Comparing " << SKINNING_MODE_NAMES[skinning_mode] << " skinning (left) with "
+                          << SKINNING_MODE_NAMES[compare_mode] << " (right)." << std::endl;
+            break;
+
+        case 'm':
+            if (mesh->vertices.empty())
+                std::cerr << "The mesh was loaded from a file, so it can't be saved." << std::endl;
+            else
+            {
+                saveMeshFile(mesh->vertices, mesh->indices, mesh->vertex_format, "mesh.skm");
+                std::cerr << "Saved the mesh to mesh.skm." << std::endl;
+            }
+            break;
+
+        case 'z':
+            bake_pose_pending = true;
+            requestFrame();
+            break;
+
+        case 't':
+            cancelCalibration();
+            pre_skinning = !pre_skinning;
+            break;
+
+        case 's':
+            draw_shadows = !draw_shadows;
+            break;
+
+        case 'u':
+            half_palettes = !half_palettes;
+            std::cerr << "The instanced crowd's palettes are uploaded in " << (half_palettes ? "half" : "full")
+                      << " floats." << std::endl;
+            break;
+
+        case 'n':
+            motion_vectors = !motion_vectors;
+            break;
+
+        case 'l':
+            impostors = !impostors;
+            break;
+
+        case 'i':
+            if (mesh_arena == nullptr)
+                std::cerr << "Indirect draws need OpenGL 4.3." << std::endl;
+            else if (!indirect_draws)
+                indirect_draws = true;
+            else if (!gpu_culling && instance_cull_pass != nullptr)
+            {
+                // the arena's VAO reads palette indices from the survivors instead.
+                gpu_culling = true;
+                instance_cull_pass->attachSurvivors(mesh_arena->getVertexArray(mesh->vertex_format));
+            }
+            else
+            {
+                if (gpu_culling)
+                    render_queue->attachPaletteIndices(mesh_arena->getVertexArray(mesh->vertex_format));
+                indirect_draws = false;
+                gpu_culling = false;
+            }
+            break;
+
+        case 'f':
+            show_profiler = !show_profiler;
+            break;
+
+        case 'a':
+            play_clip = !play_clip;
+            break;
+
+        case 'b':
+            if (morph_target_pass == nullptr)
+                std::cerr << "Morph targets need OpenGL 4.3, and the built-in mesh." << std::endl;
+            else
+            {
+                morph_targets_on = !morph_targets_on;
+                size_t toggled = pose_correctives != nullptr ? N_HAND_MORPH_TARGETS : morph_weights.size();
+                std::fill(morph_weights.begin(), morph_weights.begin() + toggled, morph_targets_on ? 1.0f : 0.0f);
+            }
+            break;
+
+        case 'o':
+            // the old results mean nothing once the queries have stopped.
+            occlusion_culling = !occlusion_culling;
+            occlusion_queries->reset();
+            std::fill(occlusion_hidden_counts.begin(), occlusion_hidden_counts.end(), 0);
+            std::cerr << "Occlusion culling " << (occlusion_culling ? "on" : "off") << "." << std::endl;
+            break;
+
+        case 'v':
+            if (window.setSwapInterval(vsync ? 0 : 1))
+            {
+                vsync = !vsync;
+                frame_scheduler.setMinFrameInterval(vsync ? 0 : frame_scheduler.getStepSeconds() * 1000.0);
+            }
+            else
+                std::cerr << "The driver doesn't allow the swap interval to be changed." << std::endl;
+            break;
+
+        case 'x':
+            render_target->setSamples(render_target->getSamples() >= render_target->getMaxSamples()
+                                      ? 1 : render_target->getSamples() * 2);
+            break;
+
+        case 'r':
+            adaptive_resolution = !adaptive_resolution;
+            resolution_controller->reset();
+            render_target->setScale(resolution_controller->getScale());
+            break;
+
+        case '=':
+            zoomCamera(CAMERA_ZOOM_STEP);
+            break;
+
+        case '-':
+            zoomCamera(1.0f / CAMERA_ZOOM_STEP);
+            break;
+
         case 'h':
             std::cerr << "Skeletal Mesh Skinning Demo" << std::endl << std::endl
                       << "    H - Display this message." << std::endl
-                      << "    W - Toggle wireframe mode." << std::endl
+                      << "    W - Cycle wireframe modes: off, outlined in the same pass, lines only." << std::endl
                       << "    J - Toggle joint/bone debug rendering." << std::endl
-                      << "  Esc - Exit" << std::endl << std::endl;
+                      << "    C - Report which triangle of the mesh is under the mouse." << std::endl
+                      << "    K - Toggle IK: the top limb reaches for the mouse, and the feet are" << std::endl
+                      << "        kept above the floor." << std::endl
+                      << "    G - Toggle the ragdoll: a physics thread swings the limbs under gravity," << std::endl
+                      << "        and the pose follows it more the further a joint is from the root." << std::endl
+                      << "    Y - Toggle playing back the last few seconds of the pose, with" << std::endl
+                      << "        -instant-replay." << std::endl
+                      << "    P - Cycle skinning mode (separate, palette, dual quaternion, 2D affine," << std::endl
+                      << "        instanced crowd, compute crowd if supported, CPU, baked crowd," << std::endl
+                      << "        texture palette).  The baked crowd plays the clip from a texture," << std::endl
+                      << "        and only moves while A is on.  The texture palette reads the" << std::endl
+                      << "        palette from a texture buffer, which any number of joints fit." << std::endl
+                      << "    E - Cycle an A/B comparison of the mesh: the left half of the scene is" << std::endl
+                      << "        skinned with the mode P chose, the right half with each of the" << std::endl
+                      << "        other single mesh modes in turn (separate, palette, dual" << std::endl
+                      << "        quaternion, 2D affine, CPU, texture palette), then off, each half" << std::endl
+                      << "        timed on the GPU in the F overlay.  The crowd modes can't be" << std::endl
+                      << "        compared." << std::endl
+                      << "    T - Toggle pre-skinning with transform feedback." << std::endl
+                      << "    S - Toggle drawing the mesh into a cascaded shadow map, from the" << std::endl
+                      << "        vertices the frame has already skinned.  The vertex shader modes" << std::endl
+                      << "        pre-skin for it; the instanced and baked crowds cast no shadows." << std::endl
+                      << "    I - Cycle how the instanced crowd is drawn: instanced draws, one" << std::endl
+                      << "        indirect draw per visible instance batched with" << std::endl
+                      << "        glMultiDrawElementsIndirect, or culled by a compute shader and drawn" << std::endl
+                      << "        with one glDrawElementsIndirect per partition of each level." << std::endl
+                      << "    U - Toggle uploading the instanced crowd's palettes as half floats," << std::endl
+                      << "        unless the GPU culls it, or an instance is too large to pack." << std::endl
+                      << "    N - Toggle drawing the instanced crowd's motion vectors since the last" << std::endl
+                      << "        frame, from the palettes it kept, as red (x) and green (y)." << std::endl
+                      << "    L - Toggle drawing the instanced crowd's smallest instances as" << std::endl
+                      << "        impostors, from frames drawn at startup, unless the clip plays" << std::endl
+                      << "        or the GPU culls it." << std::endl
+                      << "    O - Toggle occlusion culling: the crowd's instances, or the mesh, are" << std::endl
+                      << "        queried against the frame's depth after it's drawn, and what was" << std::endl
+                      << "        hidden is skipped next frame, and not posed once hidden for a few." << std::endl
+                      << "        The GPU culling does its own culling." << std::endl
+                      << "    = - Zoom the camera in, up to 8 times." << std::endl
+                      << "    - - Zoom the camera back out." << std::endl
+                      << "    F - Toggle the frame timing overlay (rolling mean, p50 and p99 of the" << std::endl
+                      << "        CPU pose, palette and upload times and the GPU draw times)." << std::endl
+                      << "    A - Toggle playing the animation clip instead of following the mouse." << std::endl
+                      << "    B - Toggle the mesh's morph targets, which swell its hands.  They're" << std::endl
+                      << "        applied before skinning, in the vertex shader skinning modes, like" << std::endl
+                      << "        the correctives which fill out the red elbow as it bends." << std::endl
+                      << "    V - Toggle vsync.  Without it, frames are capped at 60 per second." << std::endl
+                      << "    X - Cycle the scene's multisampling (1, 2, 4, ... samples, up to what" << std::endl
+                      << "        the driver allows)." << std::endl
+                      << "    R - Toggle adaptive resolution, which lowers the scene's resolution to" << std::endl
+                      << "        keep the GPU's draw time within a budget (8 ms by default)." << std::endl
+                      << "    M - Save the mesh to mesh.skm, which can be loaded by passing it" << std::endl
+                      << "        on the command line." << std::endl
+                      << "    Z - Bake the mesh in its current pose into a static mesh file in" << std::endl
+                      << "        " << POSED_MESH_DIRECTORY << "/, named by the pose's hash, so a pose baked" << std::endl
+                      << "        before is found again, even in a later session.  Loaded with the" << std::endl
+                      << "        mesh's bind pose, it draws the pose.  The palette modes read" << std::endl
+                      << "        back what the GPU skinned when they pre-skin (T); the CPU mode" << std::endl
+                      << "        skins it again on the CPU." << std::endl
+                      << "  Esc - Exit" << std::endl << std::endl
+                      << "Command line: SkinningDemo [mesh file] [-record log] [-replay log]" << std::endl
+                      << "                           [-msaa samples] [-gpu-budget ms] [-calibrate]" << std::endl
+                      << "                           [-platform glut|glfw|egl] [-trace file] [-stats file]" << std::endl
+                      << "                           [-deterministic] [-clips file] [-max-influences n]" << std::endl
+                      << "                           [-rig file] [-gpu-decode] [-palette-rate hz]" << std::endl
+                      << "                           [-cpu-order authored|joint-clustered] [-instant-replay]" << std::endl
+                      << "                           [-fold-static-joints] [-latency] [-balance-skinning]" << std::endl
+                      << "                           [-gpu-hierarchy]" << std::endl
+                      << "    -record writes every simulated frame's input and pose to a log." << std::endl
+                      << "    -replay drives the demo from a log, without vsync, as fast as it" << std::endl
+                      << "        can draw, then reports the timings and exits." << std::endl
+                      << "    -msaa draws the scene with that many samples per pixel." << std::endl
+                      << "    -gpu-budget turns adaptive resolution on, with that budget." << std::endl
+                      << "    -calibrate times the skinning backends again, even if " << CALIBRATION_PATH << std::endl
+                      << "        already has a choice for this size of mesh on this GPU.  P or T" << std::endl
+                      << "        during calibration cancels it." << std::endl
+                      << "    -platform creates the window with GLUT (the default), GLFW, or EGL," << std::endl
+                      << "        which draws offscreen with no display, if the build has them." << std::endl
+                      << "    -trace streams every thread's timings to a Chrome trace (trace.json," << std::endl
+                      << "        say) as the demo runs, for chrome://tracing, Perfetto or Tracy's" << std::endl
+                      << "        import-chrome." << std::endl
+                      << "    -stats appends the frame stats (vertices skinned, draw calls, GPU" << std::endl
+                      << "        time per pass and so on) to a file as a line of JSON, averaged" << std::endl
+                      << "        over every " << STATS_LOG_INTERVAL << " frames." << std::endl
+                      << "    -deterministic evaluates the palettes in fixed point, so they're the" << std::endl
+                      << "        same to the bit on every machine, in the palette, 2D affine and CPU" << std::endl
+                      << "        modes." << std::endl
+                      << "    -clips plays the clip from a clip database (clips.skcd, say), which is" << std::endl
+                      << "        memory-mapped and read as the clip is needed.  If the file doesn't" << std::endl
+                      << "        exist, the built-in clip is saved to it first." << std::endl
+                      << "    -max-influences limits the built-in mesh to 1 to 4 joints per vertex," << std::endl
+                      << "        spreading the dropped weights over the joints kept, so it's drawn" << std::endl
+                      << "        with the cheaper shaders; M saves it that way." << std::endl
+                      << "    -rig loads the skeleton's bind pose, colors, sockets and poses from a" << std::endl
+                      << "        JSON rig file (rig.json, say).  If the file doesn't exist, the" << std::endl
+                      << "        built-in rig is saved to it first." << std::endl
+                      << "    -gpu-decode streams a reloaded quantized mesh file to the GPU packed" << std::endl
+                      << "        into compressed vertex blocks, which a compute shader expands into" << std::endl
+                      << "        its vertex buffer (GL 4.3)." << std::endl
+                      << "    -palette-rate only simulates that many frames a second (30, say)" << std::endl
+                      << "        however fast the display draws.  In the dual quaternion mode, the" << std::endl
+                      << "        frames in between blend the last two palettes on the GPU." << std::endl
+                      << "    -cpu-order skins the vertices in the CPU mode in the order they were" << std::endl
+                      << "        authored in (the default), or grouped by the joint which weighs" << std::endl
+                      << "        on each most, so that a big rig's palette entries stay in the" << std::endl
+                      << "        cache." << std::endl
+                      << "    -instant-replay keeps the last few seconds of the pose compressed in" << std::endl
+                      << "        " << INSTANT_REPLAY_BYTES / 1024 << " KB, for Y to play back.  The palette cache isn't used" << std::endl
+                      << "        meanwhile." << std::endl
+                      << "    -fold-static-joints poses the crowd's full-detail instances without the" << std::endl
+                      << "        channels its poses and clip never move, and copies the joints" << std::endl
+                      << "        which never move at all." << std::endl
+                      << "    -latency times each mouse event through the frame which answers it:" << std::endl
+                      << "        posed, uploaded, submitted, swapped and finished by the GPU.  The" << std::endl
+                      << "        overlay shows the last two, and the percentiles of each are" << std::endl
+                      << "        reported on exit." << std::endl
+                      << "    -balance-skinning skins some of the compute crowd on the CPU instead," << std::endl
+                      << "        as many as keep the GPU and the CPU equally busy, while the job" << std::endl
+                      << "        threads have time to spare.  Only the built-in mesh's vertices are" << std::endl
+                      << "        on the CPU to skin." << std::endl
+                      << "    -gpu-hierarchy sends the compute crowd's leaders' local transforms, a" << std::endl
+                      << "        vec4 per joint, instead of every instance's palette, and resolves" << std::endl
+                      << "        the hierarchy and the palettes with compute shaders.  The crowd is" << std::endl
+                      << "        culled by its radius, and its jiggle joints are left out; it's all" << std::endl
+                      << "        skinned on the GPU." << std::endl << std::endl;
             break;
 
         default:
             break;
     }
 
-    glutPostRedisplay();
+    requestFrame();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  GLUT callback handling mouse motion.
+/// \brief  Window callback handling mouse motion.
+///
+/// \details Only records where the pose should blend to; any number of
+///         motion events between two frames cost one pose update, done when
+///         the frame is drawn.  With -latency, the first of them is what
+///         that frame is timed from.
 ///
 /// \param  x The x-coordinate of the mouse when the event occured.
 /// \param  y The y-coordinate of the mouse when the event occured.
-void mouseMove(int x, int y)
+void mouseMove(PlatformWindow& window, int x, int y)
+{
+    TRACE_SCOPE("input");
+    target_blend_factor = float(x) / viewport.x;
+    mouse_position = camera.unprojectToPlane(vec2(2.0f * x / viewport.x - 1.0f, 1.0f - 2.0f * y / viewport.y));
+    if (latency_tracker != nullptr && pending_input_milliseconds == 0)
+        pending_input_milliseconds = getTimeMilliseconds();
+
+    requestFrame();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Zooms the camera in or out about the center of the viewport,
+///         between showing the -1 to 1 square and CAMERA_MAX_ZOOM times
+///         closer.
+///
+/// \param  factor How much closer to zoom; less than 1 zooms out.
+void zoomCamera(float factor)
+{
+    camera_zoom = glm::clamp(camera_zoom * factor, 1.0f, CAMERA_MAX_ZOOM);
+    float half_size = 1.0f / camera_zoom;
+    camera.setOrthographic(-half_size, half_size, -half_size, half_size, -1, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports the triangle of the mesh under the mouse to stderr.
+///
+/// \details The ray goes through the mouse from the camera's near plane
+///         (see Camera::getRay()), through current_pose as the simulation
+///         thread last posed it.  That's the simulation thread's, so it's
+///         waited for first.  The crowd's instances aren't picked.
+///
+/// \param  x The x-coordinate of the mouse, in pixels.
+/// \param  y The y-coordinate of the mouse, in pixels.
+void pickAtMouse(int x, int y)
+{
+    if (mesh_picker == nullptr)
+    {
+        std::cerr << "The mesh was loaded from a file, so it can't be picked." << std::endl;
+        return;
+    }
+    if (skinning_mode == SKINNING_MODE_INSTANCED || skinning_mode == SKINNING_MODE_COMPUTE ||
+        skinning_mode == SKINNING_MODE_BAKED)
+    {
+        std::cerr << "Only the single mesh can be picked, not the crowd." << std::endl;
+        return;
+    }
+
+    waitForSimulation();
+    size_t joint_count = skeleton.getJointCount();
+    std::vector<mat4> palette(joint_count);
+    computeSkinningPalette(current_pose_transforms->getTransforms(), skeleton.getInverseBindTransforms(),
+                           joint_count, palette.data());
+
+    vec3 origin;
+    vec3 direction;
+    camera.getRay(vec2(2.0f * x / viewport.x - 1.0f, 1.0f - 2.0f * y / viewport.y), origin, direction);
+    PickHit hit;
+    if (mesh_picker->pick(origin, direction, palette.data(), hit))
+    {
+        std::cerr << "Picked triangle " << hit.triangle << ", in joint " << hit.joint << "'s cluster (tested "
+                  << hit.tested_triangles << " of " << mesh->indices.size() / 3 << " triangles)." << std::endl;
+    }
+    else
+        std::cerr << "There's no triangle under the mouse." << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Asks for a frame, and makes sure a timer is waiting to post it
+///         once frame_scheduler allows.
+void requestFrame()
+{
+    frame_scheduler.requestFrame();
+    if (frame_timer_pending)
+        return;
+
+    double wait = frame_scheduler.getMillisecondsUntilFrame(getTimeMilliseconds());
+    frame_timer_pending = true;
+    render_loop->addTimer(wait, frameTimer, nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Timer callback which posts the requested frame, unless it has
+///         already been drawn (for instance, after a reshape).
+void frameTimer(void* data)
+{
+    frame_timer_pending = false;
+    if (frame_scheduler.isFrameRequested())
+        window->postRedisplay();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Window callback for the window being closed.  Cleans up while
+///         the window still has its context, since GLUT destroys it as soon
+///         as this returns.
+void windowClosed(PlatformWindow& window)
+{
+    cleanup();
+    render_loop->quit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Chooses the skinning backend for the mesh's size from
+///         CALIBRATION_PATH, or starts timing each of them to find the
+///         fastest if it hasn't been calibrated on this GPU.
+///
+/// \param  force Whether to time them even if the size is calibrated.
+void startCalibration(bool force)
 {
-    float f = float(x) / viewport.x;
-    float g = 1 - f;
+    backend_calibration = new BackendCalibration(CALIBRATION_PATH);
+
+    // meshes loaded from files don't keep their vertices for the CPU
+    // skinner, and transform feedback needs every program linked for it.
+    calibration_candidates.clear();
+    for (size_t i = 0; i < N_SKINNING_BACKENDS; ++i)
+    {
+        const SkinningBackend& backend = SKINNING_BACKENDS[i];
+        bool available = backend.mode != SKINNING_MODE_CPU || !mesh->vertices.empty();
+        const std::vector<SkeletalMesh::Partition>& partitions = mesh->getPartitions();
+        for (size_t j = 0; j < partitions.size() && backend.pre_skinning; ++j)
+            available = available && skinning_programs[backend.mode][partitions[j].influence_count - 1].feedback_id != 0;
+
+        if (available)
+            calibration_candidates.push_back(i);
+    }
 
-    current_pose = poses[left_pose];
-    for (size_t joint = 0; joint < 7; ++joint)
+    std::string name;
+    if (!force && backend_calibration->find(mesh->getVertexCount(), name))
     {
-        JointPose& jp = current_pose.joints[joint];
-        if (jp.parent)
+        for (size_t i = 0; i < calibration_candidates.size(); ++i)
         {
-            ptrdiff_t offset = reinterpret_cast<char*>(jp.parent) - reinterpret_cast<char*>(&poses[left_pose]);
-            jp.parent = reinterpret_cast<JointPose*>(reinterpret_cast<char*>(&current_pose) + offset);
+            if (name != SKINNING_BACKENDS[calibration_candidates[i]].name)
+                continue;
+
+            applySkinningBackend(calibration_candidates[i]);
+            std::cerr << "Skinning with " << name << ", from " << CALIBRATION_PATH << "." << std::endl;
+            return;
         }
+    }
+
+    if (calibration_candidates.size() < 2)
+        return;
+
+    std::cerr << "Calibrating the skinning backends for " << mesh->getVertexCount() << " vertices..." << std::endl;
+    backend_calibrator = new BackendCalibrator(calibration_candidates.size());
+    applySkinningBackend(calibration_candidates[0]);
+    requestFrame();
+}
 
-        current_pose.joints[joint].color = poses[left_pose].joints[joint].color * g +
-                                           poses[right_pose].joints[joint].color * f;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the skinning mode and pre-skinning to one of
+///         SKINNING_BACKENDS.  The mode reaches the packets with the next
+///         simulation request.
+void applySkinningBackend(size_t backend)
+{
+    skinning_mode = SKINNING_BACKENDS[backend].mode;
+    pre_skinning = SKINNING_BACKENDS[backend].pre_skinning;
+}
 
-        current_pose.joints[joint].rotation = poses[left_pose].joints[joint].rotation * g +
-                                              poses[right_pose].joints[joint].rotation * f;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a frame to the calibration, if it was drawn with the
+///         backend being timed, and moves on to the next one when it's
+///         done.  Once every backend has been timed, the fastest is chosen
+///         and saved.
+///
+/// \details A frame's cost is the longer of the CPU time display() spent
+///         uploading, skinning and submitting the mesh, and the GPU time it
+///         took to draw: the two overlap, so the slower one limits the
+///         frame rate.  The GPU times come from the GL_TIME_ELAPSED queries
+///         of skinning_gpu_timer.
+///
+/// \param  mode The skinning mode the frame was drawn with.
+/// \param  cpu_milliseconds Its CPU time.
+void updateCalibration(SkinningMode mode, double cpu_milliseconds)
+{
+    const SkinningBackend& current = SKINNING_BACKENDS[calibration_candidates[backend_calibrator->getCandidate()]];
+    if (mode != current.mode || pre_skinning != current.pre_skinning)
+        return;
 
-        current_pose.joints[joint].scale = poses[left_pose].joints[joint].scale * g +
-                                           poses[right_pose].joints[joint].scale * f;
+    double gpu_milliseconds = skinning_gpu_timer->getStats().getLatest();
+    backend_calibrator->addFrame(std::max(cpu_milliseconds, gpu_milliseconds));
+    if (!backend_calibrator->isFinished())
+    {
+        applySkinningBackend(calibration_candidates[backend_calibrator->getCandidate()]);
+        return;
+    }
 
-        current_pose.joints[joint].translation = poses[left_pose].joints[joint].translation * g +
-                                                 poses[right_pose].joints[joint].translation * f;
+    for (size_t i = 0; i < calibration_candidates.size(); ++i)
+    {
+        std::cerr << "  " << SKINNING_BACKENDS[calibration_candidates[i]].name << ": "
+                  << backend_calibrator->getMilliseconds(i) << " ms/frame" << std::endl;
     }
 
-    glutPostRedisplay();
+    size_t fastest = backend_calibrator->getFastest();
+    const char* name = SKINNING_BACKENDS[calibration_candidates[fastest]].name;
+    backend_calibration->set(mesh->getVertexCount(), name, backend_calibrator->getMilliseconds(fastest));
+    backend_calibration->save();
+    applySkinningBackend(calibration_candidates[fastest]);
+    std::cerr << "Skinning with " << name << "; saved to " << CALIBRATION_PATH << "." << std::endl;
+
+    delete backend_calibrator;
+    backend_calibrator = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops calibrating, if it's still going, without saving anything,
+///         so the user's choice of mode isn't overridden.
+void cancelCalibration()
+{
+    if (backend_calibrator == nullptr)
+        return;
+
+    delete backend_calibrator;
+    backend_calibrator = nullptr;
+    std::cerr << "Calibration cancelled." << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Advances the animation by one fixed step of
+///         request.step_seconds.
+///
+/// \details blend_factor closes a fixed fraction of its distance to the
+///         mouse each step, and snaps to it once it's too close to see.
+///         While the clip is playing, its time advances by the step too.
+void stepAnimation(const SimulationRequest& request)
+{
+    TRACE_SCOPE("step animation");
+    float step = request.step_seconds;
+    float target = request.target_blend_factor;
+
+    previous_blend_factor = simulated_blend_factor;
+    simulated_blend_factor += (target - simulated_blend_factor) * (1.0f - std::exp(-step / BLEND_RESPONSE_TIME));
+    if (std::abs(target - simulated_blend_factor) < 0.0005f)
+        simulated_blend_factor = target;
+
+    if (request.play_clip)
+    {
+        previous_clip_time = clip_time;
+        clip_time += step;
+
+        // keep the time small, so it doesn't lose precision; sampleLooped()
+        // wraps the (now negative) previous time back into the clip.
+        if (clip_time >= clip->getDuration())
+        {
+            clip_time -= clip->getDuration();
+            previous_clip_time -= clip->getDuration();
+        }
+    }
 }
@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mapped_file.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of MappedFile class functions.
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Maps a file into memory.  If anything fails, data is left null.
+///
+/// \param  path The file to map.
+/// \param  sequential Whether the file will be read from start to end, so
+///         the OS should read ahead of each page touched; if not, it reads
+///         only what's touched or prefetched.
+MappedFile::MappedFile(const std::string& path, bool sequential)
+    : data(nullptr),
+      size(0)
+{
+#ifdef _WIN32
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    page_size_ = system_info.dwPageSize;
+
+    mapping_ = NULL;
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS),
+                        NULL);
+    if (file_ == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0)
+        return;
+
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_ == NULL)
+        return;
+
+    data = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data != nullptr)
+        size = size_t(file_size.QuadPart);
+#else
+    page_size_ = size_t(sysconf(_SC_PAGESIZE));
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            data = static_cast<const char*>(mapping);
+            size = size_t(info.st_size);
+            if (!sequential)
+                madvise(mapping, size, MADV_RANDOM);
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed.
+    close(fd);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unmaps the file.
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mapping_ != NULL)
+        CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+#else
+    if (data != nullptr)
+        munmap(const_cast<char*>(data), size);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Asks the OS to start reading a range of the file into memory,
+///         without waiting for it.
+///
+/// \details This is only a hint: it returns straight away, and the pages
+///         may be read in any time afterwards, or dropped again under
+///         memory pressure.  Windows only takes the hint from Windows 8 on.
+///
+/// \param  offset The start of the range, in bytes from the start of the
+///         file.
+/// \param  length The length of the range in bytes; it's clamped to the
+///         end of the file.
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    if (data == nullptr || offset >= size)
+        return;
+
+    // the range has to start on a page.
+    size_t start = offset / page_size_ * page_size_;
+    size_t end = std::min(offset + length, size);
+
+#ifdef _WIN32
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<char*>(data + start);
+    range.NumberOfBytes = end - start;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+    madvise(const_cast<char*>(data + start), end - start, MADV_WILLNEED);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if every page of a range of the file is in memory,
+///         so reading it won't wait for the disk.
+///
+/// \details Windows has no cheap way to ask, so there the whole file
+///         always counts as resident.
+///
+/// \param  offset The start of the range, in bytes from the start of the
+///         file.
+/// \param  length The length of the range in bytes; it's clamped to the
+///         end of the file.
+bool MappedFile::isResident(size_t offset, size_t length) const
+{
+    if (data == nullptr || offset >= size)
+        return data != nullptr;
+
+#ifdef _WIN32
+    return true;
+#else
+    size_t start = offset / page_size_ * page_size_;
+    size_t end = std::min(offset + length, size);
+#ifdef __APPLE__
+    std::vector<char> pages((end - start + page_size_ - 1) / page_size_);
+#else
+    std::vector<unsigned char> pages((end - start + page_size_ - 1) / page_size_);
+#endif
+    if (mincore(const_cast<char*>(data + start), end - start, pages.data()) != 0)
+        return false;
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        if ((pages[i] & 1) == 0)
+            return false;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mapped_file.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the MappedFile class.
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A read-only memory mapping of an entire file, which is unmapped
+///         when the object is destroyed.
+///
+/// \details Mapping a file reads none of it; each page is read from disk
+///         the first time it's touched.  prefetch() asks the OS to start
+///         reading a range in the background, so it's there by the time
+///         it's needed, and isResident() says whether it is yet.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path, bool sequential = true);
+    ~MappedFile();
+
+    void prefetch(size_t offset, size_t length) const;
+    bool isResident(size_t offset, size_t length) const;
+
+    const char* data;   ///< The start of the mapping, or nullptr if the file couldn't be mapped.
+    size_t size;        ///< The size of the file in bytes.
+
+private:
+    MappedFile(const MappedFile&);              // non-copyable
+    MappedFile& operator=(const MappedFile&);   // non-copyable
+
+    size_t page_size_;
+
+#ifdef _WIN32
+    void* file_;                ///< The file's HANDLE; kept as a void* so that this doesn't include windows.h.
+    void* mapping_;             ///< The mapping's HANDLE.
+#endif
+};
+
+#endif
@@ -0,0 +1,348 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_arena.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of RangeAllocator and MeshArena class functions.
+
+#include "mesh_arena.h"
+
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an allocator with all of its capacity free.
+RangeAllocator::RangeAllocator(size_t capacity)
+    : capacity_(capacity),
+      free_space_(capacity)
+{
+    if (capacity > 0)
+        free_ranges_[0] = capacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates a range from the first free range it fits in.
+///
+/// \param  size The size of the range.  Zero-sized ranges are allowed, and
+///         take up no space.
+/// \param  alignment The offset of the range is a multiple of this.
+/// \return The offset of the range, or NO_SPACE if there isn't a free range
+///         big enough.
+size_t RangeAllocator::allocate(size_t size, size_t alignment)
+{
+    assert(alignment > 0);
+    if (size == 0)
+        return 0;
+
+    for (std::map<size_t, size_t>::iterator it = free_ranges_.begin(); it != free_ranges_.end(); ++it)
+    {
+        size_t range_offset = it->first;
+        size_t range_size = it->second;
+        size_t offset = (range_offset + alignment - 1) / alignment * alignment;
+        if (offset + size > range_offset + range_size)
+            continue;
+
+        // split the free range around the allocation, keeping the space lost
+        // to alignment free.
+        free_ranges_.erase(it);
+        if (offset > range_offset)
+            free_ranges_[range_offset] = offset - range_offset;
+        if (offset + size < range_offset + range_size)
+            free_ranges_[offset + size] = range_offset + range_size - (offset + size);
+
+        free_space_ -= size;
+        return offset;
+    }
+
+    return NO_SPACE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees a range returned by allocate(), merging it with the free
+///         ranges on either side of it.
+///
+/// \param  offset The offset returned by allocate().
+/// \param  size The size that was passed to allocate().
+void RangeAllocator::free(size_t offset, size_t size)
+{
+    if (size == 0)
+        return;
+
+    assert(offset + size <= capacity_);
+    free_space_ += size;
+
+    std::map<size_t, size_t>::iterator next = free_ranges_.lower_bound(offset);
+    assert(next == free_ranges_.end() || next->first >= offset + size);
+    if (next != free_ranges_.end() && next->first == offset + size)
+    {
+        size += next->second;
+        free_ranges_.erase(next++);
+    }
+
+    if (next != free_ranges_.begin())
+    {
+        std::map<size_t, size_t>::iterator previous = next;
+        --previous;
+        assert(previous->first + previous->second <= offset);
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+
+    free_ranges_[offset] = size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the total amount of space, free or not.
+size_t RangeAllocator::getCapacity() const
+{
+    return capacity_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the amount of space which isn't allocated.  It may be
+///         fragmented into several ranges.
+size_t RangeAllocator::getFreeSpace() const
+{
+    return free_space_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty allocation, which refers to nothing.
+MeshArena::Allocation::Allocation()
+    : vertex_format(VERTEX_FORMAT_FULL),
+      first_vertex(0),
+      vertex_count(0),
+      index_type(GL_UNSIGNED_SHORT),
+      index_offset(0),
+      index_count(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the arena's IBO.  The VBOs are created when the first
+///         mesh in each format is added.
+///
+/// \param  vertex_capacity The number of vertices each format's VBO holds.
+/// \param  index_capacity The size of the IBO, in bytes.
+MeshArena::MeshArena(size_t vertex_capacity, size_t index_capacity)
+    : vertex_capacity_(vertex_capacity),
+      vertex_allocators_(N_FORMATS, RangeAllocator(vertex_capacity)),
+      ibo_id_(0),
+      index_allocator_(index_capacity)
+{
+    for (size_t i = 0; i < N_FORMATS; ++i)
+    {
+        vao_ids_[i] = 0;
+        vbo_ids_[i] = 0;
+    }
+
+    glGenBuffers(1, &ibo_id_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_id_);
+    glBufferData(GL_COPY_WRITE_BUFFER, index_capacity, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the arena's VAOs and buffers.  Any allocations still in
+///         the arena become invalid.
+MeshArena::~MeshArena()
+{
+    glDeleteVertexArrays(GLsizei(N_FORMATS), vao_ids_);
+    glDeleteBuffers(GLsizei(N_FORMATS), vbo_ids_);
+    glDeleteBuffers(1, &ibo_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies a mesh's vertices and indices into the arena.
+///
+/// \details The arguments are the same as SkeletalMesh::uploadData()'s.
+///         If the vertices are quantized, the caller records their
+///         quantization in the allocation.
+///
+/// \param  allocation Receives where the mesh was stored.
+/// \return false if there isn't enough contiguous space left in the format's
+///         VBO or in the IBO, in which case nothing is stored; the mesh can
+///         be added to another arena instead.
+bool MeshArena::add(VertexFormat format,
+                    const void* vertex_data, size_t vertex_count,
+                    GLenum index_type, const void* index_data, size_t index_count,
+                    const std::vector<SkeletalMesh::Partition>& partitions,
+                    Allocation& allocation)
+{
+    if (!allocate(format, vertex_count, index_type, index_count, partitions, allocation))
+        return false;
+
+    size_t vertex_size = getVertexSize(format);
+    size_t index_size = getIndexSize(index_type);
+    if (vertex_count > 0)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_ids_[format]);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.first_vertex * vertex_size, vertex_count * vertex_size, vertex_data);
+    }
+
+    if (index_count > 0)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_id_);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.index_offset, index_count * index_size, index_data);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies the uploaded vertices and indices of a SkeletalMesh into
+///         the arena.
+///
+/// \details The copy is made on the GPU with glCopyBufferSubData, so this
+///         works for meshes loaded from mesh files, which have no CPU-side
+///         copy.  The mesh itself isn't changed.
+///
+/// \param  mesh The mesh to copy.
+/// \param  allocation Receives where the mesh was stored.
+/// \return false if there isn't enough space; see the other overload.
+bool MeshArena::add(const SkeletalMeshBase& mesh, Allocation& allocation)
+{
+    if (!allocate(mesh.vertex_format, mesh.getVertexCount(), mesh.getIndexType(), mesh.getIndexCount(),
+                  mesh.getPartitions(), allocation))
+    {
+        return false;
+    }
+    allocation.position_quantization = mesh.position_quantization;
+
+    size_t vertex_size = getVertexSize(mesh.vertex_format);
+    size_t index_size = mesh.getIndexSize();
+    if (mesh.getVertexCount() > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.vbo_id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_ids_[mesh.vertex_format]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, allocation.first_vertex * vertex_size,
+                            mesh.getVertexCount() * vertex_size);
+    }
+
+    if (mesh.getIndexCount() > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.ibo_id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_id_);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, allocation.index_offset,
+                            mesh.getIndexCount() * index_size);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees the space used by a mesh added with add(), and resets the
+///         allocation so it refers to nothing.
+void MeshArena::remove(Allocation& allocation)
+{
+    vertex_allocators_[allocation.vertex_format].free(allocation.first_vertex, allocation.vertex_count);
+    index_allocator_.free(allocation.index_offset, allocation.index_count * getIndexSize(allocation.index_type));
+    allocation = Allocation();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Binds the VAO for a vertex format, for drawing meshes in that
+///         format with draw().
+void MeshArena::bind(VertexFormat format) const
+{
+    glBindVertexArray(vao_ids_[format]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the VAO for a vertex format, or 0 if no mesh in that
+///         format has been added yet.
+GLuint MeshArena::getVertexArray(VertexFormat format) const
+{
+    return vao_ids_[format];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws one partition of a mesh in the arena, with the current
+///         shader program.
+///
+/// \details The VAO for the mesh's format must be bound with bind().
+///
+/// \param  allocation The mesh to draw.
+/// \param  partition One of allocation.partitions.
+/// \param  instance_count The number of instances to draw.
+void MeshArena::draw(const Allocation& allocation, const SkeletalMesh::Partition& partition, GLsizei instance_count) const
+{
+    if (partition.index_count == 0)
+        return;
+
+    size_t offset = allocation.index_offset + partition.first_index * getIndexSize(allocation.index_type);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, partition.index_count, allocation.index_type,
+                                      reinterpret_cast<void*>(offset), instance_count,
+                                      GLint(allocation.first_vertex));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reserves space for a mesh's vertices and indices, creating the
+///         VBO and VAO for its format if this is the first mesh in it.
+///
+/// \details The indices are stored aligned to 4 bytes, whatever their type,
+///         so that meshes with different index types can share the IBO and
+///         indirect draws can address them in whole indices.
+///
+/// \return false if either range doesn't fit.
+bool MeshArena::allocate(VertexFormat format, size_t vertex_count,
+                         GLenum index_type, size_t index_count,
+                         const std::vector<SkeletalMesh::Partition>& partitions,
+                         Allocation& allocation)
+{
+    RangeAllocator& vertex_allocator = vertex_allocators_[format];
+    size_t first_vertex = vertex_allocator.allocate(vertex_count, 1);
+    if (first_vertex == RangeAllocator::NO_SPACE)
+        return false;
+
+    size_t index_offset = index_allocator_.allocate(index_count * getIndexSize(index_type), 4);
+    if (index_offset == RangeAllocator::NO_SPACE)
+    {
+        vertex_allocator.free(first_vertex, vertex_count);
+        return false;
+    }
+
+    if (vao_ids_[format] == 0)
+    {
+        glGenVertexArrays(1, &vao_ids_[format]);
+        glGenBuffers(1, &vbo_ids_[format]);
+
+        glBindVertexArray(vao_ids_[format]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_id_);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_ids_[format]);
+        glBufferData(GL_ARRAY_BUFFER, vertex_capacity_ * getVertexSize(format), nullptr, GL_STATIC_DRAW);
+        setVertexAttributes(format);
+
+        // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    allocation.vertex_format = format;
+    allocation.first_vertex = first_vertex;
+    allocation.vertex_count = vertex_count;
+    allocation.index_type = index_type;
+    allocation.index_offset = index_offset;
+    allocation.index_count = index_count;
+    allocation.partitions = partitions;
+    allocation.position_quantization = PositionQuantization();
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the VBO holding the vertices in a format, or 0 if no mesh
+///         in that format has been added yet.
+GLuint MeshArena::getVertexBuffer(VertexFormat format) const
+{
+    return vbo_ids_[format];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the IBO holding the indices of every mesh in the arena.
+GLuint MeshArena::getIndexBuffer() const
+{
+    return ibo_id_;
+}
@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_arena.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the RangeAllocator and MeshArena classes.
+
+#ifndef MESH_ARENA_H_
+#define MESH_ARENA_H_
+
+#include "skeletal_mesh.h"
+#include <map>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Hands out aligned ranges of a fixed amount of space, such as the
+///         bytes of a buffer object.
+///
+/// \details Free ranges are kept sorted by offset, and allocation is first
+///         fit.  Freed ranges are merged with their free neighbors, so
+///         freeing everything always leaves a single free range.
+class RangeAllocator
+{
+public:
+    static const size_t NO_SPACE = size_t(-1);  ///< Returned by allocate() when nothing fits.
+
+    explicit RangeAllocator(size_t capacity);
+
+    size_t allocate(size_t size, size_t alignment);
+    void free(size_t offset, size_t size);
+
+    size_t getCapacity() const;
+    size_t getFreeSpace() const;
+
+private:
+    size_t capacity_;
+    size_t free_space_;
+    std::map<size_t, size_t> free_ranges_;  ///< The size of each free range, by offset.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stores the vertices and indices of many meshes in a few large
+///         buffers, so drawing them doesn't need a buffer or VAO switch per
+///         mesh.
+///
+/// \details There is one VBO and VAO per vertex format, created the first
+///         time a mesh in that format is added, and a single IBO which all of
+///         the VAOs share.  Each mesh is given a range of vertices in its
+///         format's VBO and a range of the IBO, recorded in an Allocation.
+///         Its indices stay relative to its first vertex, so they're uploaded
+///         unchanged, and draw() passes the first vertex as the base vertex
+///         (glDrawElementsInstancedBaseVertex, GL 3.2).
+///
+///         After bind() has bound a format's VAO, any number of meshes in
+///         that format can be drawn without changing any other state.
+///
+///         The data uploaded is in the layout produced by
+///         buildMeshUploadData(), the same as SkeletalMesh::uploadData()
+///         takes, so meshes from mesh files can be added directly.  A
+///         SkeletalMesh which has already been uploaded can also be copied
+///         in on the GPU.
+class MeshArena
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Where a mesh's vertices and indices are stored in the arena.
+    struct Allocation
+    {
+        Allocation();
+
+        VertexFormat vertex_format;                         ///< Which of the VBOs the vertices are in.
+        size_t first_vertex;                                ///< The index of the mesh's first vertex in the VBO.
+        size_t vertex_count;                                ///< The number of vertices.
+        GLenum index_type;                                  ///< The type of the mesh's indices.
+        size_t index_offset;                                ///< The byte offset of the mesh's first index in the IBO.
+        size_t index_count;                                 ///< The number of indices.
+        std::vector<SkeletalMesh::Partition> partitions;    ///< The mesh's partitions, relative to its ranges.
+        PositionQuantization position_quantization;         ///< The mesh's, if it was added from a SkeletalMesh.
+    };
+
+    MeshArena(size_t vertex_capacity, size_t index_capacity);
+    ~MeshArena();
+
+    bool add(VertexFormat format,
+             const void* vertex_data, size_t vertex_count,
+             GLenum index_type, const void* index_data, size_t index_count,
+             const std::vector<SkeletalMesh::Partition>& partitions,
+             Allocation& allocation);
+    bool add(const SkeletalMeshBase& mesh, Allocation& allocation);
+    void remove(Allocation& allocation);
+
+    void bind(VertexFormat format) const;
+    void draw(const Allocation& allocation, const SkeletalMesh::Partition& partition, GLsizei instance_count) const;
+
+    GLuint getVertexArray(VertexFormat format) const;
+    GLuint getVertexBuffer(VertexFormat format) const;
+    GLuint getIndexBuffer() const;
+
+private:
+    MeshArena(const MeshArena&);            // non-copyable
+    MeshArena& operator=(const MeshArena&); // non-copyable
+
+    bool allocate(VertexFormat format, size_t vertex_count,
+                  GLenum index_type, size_t index_count,
+                  const std::vector<SkeletalMesh::Partition>& partitions,
+                  Allocation& allocation);
+
+    static const size_t N_FORMATS = VERTEX_FORMAT_QUANTIZED_3D + 1;
+
+    size_t vertex_capacity_;                ///< The number of vertices each VBO can hold.
+    GLuint vao_ids_[N_FORMATS];             ///< 0 until the first mesh in the format is added.
+    GLuint vbo_ids_[N_FORMATS];
+    std::vector<RangeAllocator> vertex_allocators_;
+    GLuint ibo_id_;
+    RangeAllocator index_allocator_;
+};
+
+#endif
@@ -0,0 +1,354 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_file.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of mesh file functions.
+
+#include "mesh_file.h"
+#include "async_file_reader.h"
+#include "mapped_file.h"
+#include "index_codec.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a byte offset up to the next multiple of 16.
+GLuint64 roundUp16(GLuint64 offset)
+{
+    return (offset + 15) & ~GLuint64(15);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a problem with a mesh file and throws an exception.
+void meshFileError(const std::string& path, const std::string& problem)
+{
+    std::cerr << "Error loading mesh file!" << std::endl
+              << "   File: " << path << std::endl
+              << "  Error: " << problem << std::endl;
+
+    throw std::runtime_error("Error loading mesh file!");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that every index in a block of indices of the given type
+///         refers to one of vertex_count vertices.
+template <typename IndexType>
+bool indicesInBounds(const char* data, size_t index_count, GLuint vertex_count)
+{
+    const IndexType* indices = reinterpret_cast<const IndexType*>(data);
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        if (indices[i] >= vertex_count)
+            return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the position quantization recorded in a mesh file's
+///         header.
+PositionQuantization getPositionQuantization(const MeshFileHeader& header)
+{
+    PositionQuantization quantization;
+    quantization.bias = vec3(header.position_bias[0], header.position_bias[1], header.position_bias[2]);
+    quantization.scale = header.position_scale;
+    return quantization;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks a mesh file in memory thoroughly, including that every
+///         index refers to a vertex in the file.  If there is a problem,
+///         it's reported to stderr and an exception is thrown.  Encoded
+///         indices are decoded along the way.
+///
+/// \param  path The file the data came from, for the error messages.
+/// \param  data The contents of the file.
+/// \param  size The size of the file in bytes.
+/// \param  header Receives the file's header.
+/// \param  partitions Receives the file's partitions.
+/// \param  decoded_indices Receives the decoded indices, if the file's
+///         indices are encoded; left empty otherwise.
+/// \param  indices Receives a pointer to the indices, as index_type: into
+///         the file if they're raw, or into decoded_indices.
+void checkMeshFile(const std::string& path, const char* data, size_t size,
+                   MeshFileHeader& header, std::vector<SkeletalMeshBase::Partition>& partitions,
+                   std::vector<char>& decoded_indices, const char*& indices)
+{
+    if (data == nullptr)
+        meshFileError(path, "The file couldn't be opened.");
+
+    if (size < sizeof(MeshFileHeader))
+        meshFileError(path, "The file is too small to be a mesh file.");
+
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, "SKMF", 4) != 0)
+        meshFileError(path, "The file isn't a mesh file.");
+    if (header.version != MESH_FILE_VERSION)
+        meshFileError(path, "The file's version isn't supported.");
+    if (header.vertex_format > VERTEX_FORMAT_QUANTIZED_3D)
+        meshFileError(path, "The file's vertex format is unknown.");
+    if (header.index_type != GL_UNSIGNED_BYTE &&
+        header.index_type != GL_UNSIGNED_SHORT &&
+        header.index_type != GL_UNSIGNED_INT)
+    {
+        meshFileError(path, "The file's index type is unknown.");
+    }
+    if (header.index_encoding > MESH_INDICES_DELTA_VARINT)
+        meshFileError(path, "The file's index encoding is unknown.");
+    if (!(header.position_scale > 0.0f))
+        meshFileError(path, "The file's position quantization is invalid.");
+
+    VertexFormat format = VertexFormat(header.vertex_format);
+    GLuint64 partitions_size = GLuint64(header.partition_count) * sizeof(MeshFilePartition);
+    GLuint64 vertices_size = GLuint64(header.vertex_count) * getVertexSize(format);
+    GLuint64 indices_size = GLuint64(header.index_count) * getIndexSize(header.index_type);
+    if (header.index_encoding != MESH_INDICES_RAW)
+        indices_size = 0;   // checked when they're decoded
+
+    if (sizeof(MeshFileHeader) + partitions_size > header.vertices_offset ||
+        header.vertices_offset % 16 != 0 ||
+        header.indices_offset % 16 != 0 ||
+        header.vertices_offset + vertices_size > header.indices_offset ||
+        header.indices_offset + indices_size > size)
+    {
+        meshFileError(path, "The file's blocks are out of bounds.");
+    }
+
+    partitions.resize(header.partition_count);
+    const MeshFilePartition* file_partitions = reinterpret_cast<const MeshFilePartition*>(data + sizeof(MeshFileHeader));
+    for (size_t i = 0; i < partitions.size(); ++i)
+    {
+        const MeshFilePartition& p = file_partitions[i];
+        if (p.influence_count < 1 || p.influence_count > MAX_JOINT_INFLUENCES ||
+            GLuint64(p.first_index) + p.index_count > header.index_count ||
+            GLuint64(p.first_vertex) + p.vertex_count > header.vertex_count)
+        {
+            meshFileError(path, "The file's partitions are out of bounds.");
+        }
+
+        partitions[i].influence_count = p.influence_count;
+        partitions[i].index_count = GLsizei(p.index_count);
+        partitions[i].first_index = p.first_index;
+        partitions[i].vertex_count = GLsizei(p.vertex_count);
+        partitions[i].first_vertex = p.first_vertex;
+    }
+
+    decoded_indices.clear();
+    indices = data + header.indices_offset;
+    if (header.index_encoding == MESH_INDICES_DELTA_VARINT)
+    {
+        decoded_indices.resize(size_t(header.index_count) * getIndexSize(header.index_type));
+        if (!decodeIndices(indices, size_t(size - header.indices_offset), header.index_count, header.index_type,
+                           decoded_indices.data()))
+        {
+            meshFileError(path, "The file's indices are corrupt.");
+        }
+        indices = decoded_indices.data();
+    }
+
+    bool indices_in_bounds;
+    if (header.index_type == GL_UNSIGNED_BYTE)
+        indices_in_bounds = indicesInBounds<GLubyte>(indices, header.index_count, header.vertex_count);
+    else if (header.index_type == GL_UNSIGNED_SHORT)
+        indices_in_bounds = indicesInBounds<GLushort>(indices, header.index_count, header.vertex_count);
+    else
+        indices_in_bounds = indicesInBounds<GLuint>(indices, header.index_count, header.vertex_count);
+
+    if (!indices_in_bounds)
+        meshFileError(path, "The file's indices are out of bounds.");
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Saves a mesh's vertices and indices to a mesh file, converted to
+///         a vertex format and partitioned exactly as
+///         SkeletalMesh::uploadMesh() would.
+///
+/// \details No GL context is needed, so this can be used by tools.
+///
+/// \param  vertices The vertices of the mesh; Vertex or Vertex3D.
+/// \param  triangle_indices The indices of the mesh's triangles.
+/// \param  vertex_format The layout to store the vertices in, of the
+///         vertices' dimension.
+/// \param  path The file to write.
+/// \param  stats If not NULL, receives the ACMR of the indices before and
+///         after they were reordered for the vertex cache.
+template <typename VertexType>
+void saveMeshFile(const std::vector<VertexType>& vertices,
+                  const std::vector<GLuint>& triangle_indices,
+                  VertexFormat vertex_format,
+                  const std::string& path,
+                  MeshOptimizationStats* stats)
+{
+    std::vector<char> vertex_data;
+    GLenum index_type;
+    std::vector<char> index_data;
+    std::vector<SkeletalMeshBase::Partition> partitions;
+    PositionQuantization quantization;
+    buildMeshUploadData(vertices, triangle_indices, vertex_format, vertex_data, index_type, index_data, partitions,
+                        stats, NULL, &quantization);
+
+    MeshFileHeader header;
+    std::memcpy(header.magic, "SKMF", 4);
+    header.version = MESH_FILE_VERSION;
+    header.vertex_format = GLuint(vertex_format);
+    header.vertex_count = GLuint(vertices.size());
+    header.index_count = GLuint(triangle_indices.size());
+    header.partition_count = GLuint(partitions.size());
+    header.index_type = index_type;
+    header.vertices_offset = roundUp16(sizeof(MeshFileHeader) + partitions.size() * sizeof(MeshFilePartition));
+    header.indices_offset = roundUp16(header.vertices_offset + vertex_data.size());
+
+    std::vector<char> encoded_indices;
+    encodeIndices(index_data.data(), triangle_indices.size(), index_type, encoded_indices);
+    header.index_encoding = MESH_INDICES_RAW;
+    if (encoded_indices.size() < index_data.size())
+    {
+        header.index_encoding = MESH_INDICES_DELTA_VARINT;
+        index_data.swap(encoded_indices);
+    }
+    for (int i = 0; i < 3; ++i)
+        header.position_bias[i] = quantization.bias[i];
+    header.position_scale = quantization.scale;
+
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Error saving mesh file!" << std::endl
+                  << "   File: " << path << std::endl;
+        throw std::runtime_error("Error saving mesh file!");
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t i = 0; i < partitions.size(); ++i)
+    {
+        MeshFilePartition partition;
+        partition.influence_count = GLuint(partitions[i].influence_count);
+        partition.index_count = GLuint(partitions[i].index_count);
+        partition.first_index = GLuint(partitions[i].first_index);
+        partition.vertex_count = GLuint(partitions[i].vertex_count);
+        partition.first_vertex = GLuint(partitions[i].first_vertex);
+        file.write(reinterpret_cast<const char*>(&partition), sizeof(partition));
+    }
+
+    const char padding[16] = { 0 };
+    GLuint64 offset = sizeof(MeshFileHeader) + partitions.size() * sizeof(MeshFilePartition);
+    file.write(padding, std::streamsize(header.vertices_offset - offset));
+    if (!vertex_data.empty())
+        file.write(&vertex_data[0], std::streamsize(vertex_data.size()));
+
+    offset = header.vertices_offset + vertex_data.size();
+    file.write(padding, std::streamsize(header.indices_offset - offset));
+    if (!index_data.empty())
+        file.write(&index_data[0], std::streamsize(index_data.size()));
+
+    if (!file)
+    {
+        std::cerr << "Error saving mesh file!" << std::endl
+                  << "   File: " << path << std::endl;
+        throw std::runtime_error("Error saving mesh file!");
+    }
+}
+
+template void saveMeshFile(const std::vector<Vertex>& vertices, const std::vector<GLuint>& triangle_indices,
+                           VertexFormat vertex_format, const std::string& path, MeshOptimizationStats* stats);
+template void saveMeshFile(const std::vector<Vertex3D>& vertices, const std::vector<GLuint>& triangle_indices,
+                           VertexFormat vertex_format, const std::string& path, MeshOptimizationStats* stats);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Loads a mesh file written by saveMeshFile() and uploads it.
+///
+/// \details The file is memory-mapped, and its vertex and index blocks are
+///         passed straight to glBufferData (see
+///         SkeletalMeshBase::uploadData()), so the only copy made is the
+///         driver's, unless the indices are encoded and have to be decoded
+///         first.  The mesh's vertices and indices fields are left empty.
+///         Either a 2D or a 3D file can be loaded into any mesh; callers
+///         which can only handle one should check
+///         getPositionComponents(mesh.vertex_format).  The file is checked
+///         with checkMeshFile() before anything is uploaded.
+///
+/// \param  mesh The mesh to upload the file's contents to.
+/// \param  path The file to load.
+void loadMeshFile(SkeletalMeshBase& mesh, const std::string& path)
+{
+    MappedFile file(path);
+
+    MeshFileHeader header;
+    std::vector<SkeletalMeshBase::Partition> partitions;
+    std::vector<char> decoded_indices;
+    const char* indices;
+    checkMeshFile(path, file.data, file.size, header, partitions, decoded_indices, indices);
+
+    mesh.position_quantization = getPositionQuantization(header);
+    mesh.uploadData(VertexFormat(header.vertex_format), file.data + header.vertices_offset, header.vertex_count,
+                    header.index_type, indices, header.index_count, partitions);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads and checks a mesh file written by saveMeshFile(), without
+///         uploading it.
+///
+/// \details No GL context is needed, so this can be called from any thread,
+///         for instance to load a mesh in the background and upload it later
+///         with uploadMeshFile().  If there is a problem with the file, it's
+///         reported to stderr and an exception is thrown.
+///
+///         Everything in the file is copied out anyway, so rather than being
+///         mapped, it's read with one unbuffered AsyncFileReader read,
+///         straight from the drive into a staging buffer, without passing
+///         through the OS's cache.
+///
+/// \param  path The file to read.
+/// \param  data Receives the file's contents.
+void readMeshFile(const std::string& path, MeshFileData& data)
+{
+    AsyncFileReader file(path);
+    const char* contents = nullptr;
+    if (file.getSize() > 0)
+    {
+        AsyncFileReader::ReadId read = file.read(0, file.getSize());
+        file.wait(read);
+        contents = file.getData(read);
+    }
+
+    MeshFileHeader header;
+    std::vector<char> decoded_indices;
+    const char* indices;
+    checkMeshFile(path, contents, file.getSize(), header, data.partitions, decoded_indices, indices);
+
+    data.vertex_format = VertexFormat(header.vertex_format);
+    data.position_quantization = getPositionQuantization(header);
+    data.vertex_count = header.vertex_count;
+    data.index_type = header.index_type;
+    data.index_count = header.index_count;
+
+    const char* vertices = contents + header.vertices_offset;
+    data.vertex_data.assign(vertices, vertices + header.vertex_count * getVertexSize(data.vertex_format));
+    if (header.index_encoding != MESH_INDICES_RAW)
+        data.index_data.swap(decoded_indices);
+    else
+        data.index_data.assign(indices, indices + header.index_count * getIndexSize(header.index_type));
+    data.vertex_blocks.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads a mesh file read by readMeshFile().
+///
+/// \param  mesh The mesh to upload the file's contents to.
+/// \param  data The file's contents.
+void uploadMeshFile(SkeletalMeshBase& mesh, const MeshFileData& data)
+{
+    mesh.position_quantization = data.position_quantization;
+    mesh.uploadData(data.vertex_format, data.vertex_data.data(), data.vertex_count,
+                    data.index_type, data.index_data.data(), data.index_count, data.partitions);
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_file.h
+/// \author Ben Crist
+///
+/// \brief  Functions for saving SkeletalMeshes to, and loading them from,
+///         binary mesh files.
+
+#ifndef MESH_FILE_H_
+#define MESH_FILE_H_
+
+#include "skeletal_mesh.h"
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The header at the start of every mesh file.
+///
+/// \details A mesh file holds exactly the bytes that
+///         SkeletalMesh::uploadMesh() would upload, so loading one is just a
+///         matter of mapping it and handing the blocks to glBufferData.  It
+///         consists of:
+///
+///         - this header
+///         - partition_count MeshFilePartitions
+///         - vertex_count vertices in vertex_format, starting at
+///           vertices_offset (a multiple of 16)
+///         - index_count indices of type index_type, starting at
+///           indices_offset (a multiple of 16), as index_encoding says
+///
+///         The indices are the last block, so if they're encoded, they run
+///         from indices_offset to the end of the file; they're decoded into
+///         a temporary buffer on the way to glBufferData.  saveMeshFile()
+///         only encodes them when that makes the file smaller.
+///
+///         Everything is stored in the native byte order of the machine that
+///         wrote the file; the demo only runs on little-endian machines.
+///         The joint indices in the vertices refer to the demo's skeleton.
+struct MeshFileHeader
+{
+    char magic[4];              ///< Always "SKMF".
+    GLuint version;             ///< MESH_FILE_VERSION.
+    GLuint vertex_format;       ///< A VertexFormat.
+    GLuint vertex_count;
+    GLuint index_count;
+    GLuint partition_count;
+    GLuint index_type;          ///< GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+    GLuint index_encoding;      ///< A MeshIndexEncoding; also keeps the offsets 8-byte aligned.
+    GLuint64 vertices_offset;   ///< The byte offset of the vertices from the start of the file.
+    GLuint64 indices_offset;    ///< The byte offset of the indices from the start of the file.
+    GLfloat position_bias[3];   ///< The PositionQuantization of the vertices; the identity unless they're quantized.
+    GLfloat position_scale;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  How a mesh file's indices are stored.
+enum MeshIndexEncoding
+{
+    MESH_INDICES_RAW,           ///< As index_type, ready for glBufferData.
+    MESH_INDICES_DELTA_VARINT   ///< Compressed by encodeIndices().
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A SkeletalMesh::Partition, as it's stored in a mesh file.
+struct MeshFilePartition
+{
+    GLuint influence_count;
+    GLuint index_count;
+    GLuint first_index;
+    GLuint vertex_count;
+    GLuint first_vertex;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The contents of a mesh file, read into memory by readMeshFile()
+///         to be uploaded later.
+struct MeshFileData
+{
+    VertexFormat vertex_format;
+    PositionQuantization position_quantization;
+    size_t vertex_count;
+    GLenum index_type;
+    size_t index_count;
+    std::vector<char> vertex_data;
+    std::vector<char> index_data;
+    std::vector<SkeletalMeshBase::Partition> partitions;
+    std::vector<GLuint> vertex_blocks;   ///< If not empty, vertex_data packed by encodeVertexBlocks(), for MeshUploadQueue.
+};
+
+/// The version of the mesh file format written by saveMeshFile().
+const GLuint MESH_FILE_VERSION = 5;
+
+template <typename VertexType>
+void saveMeshFile(const std::vector<VertexType>& vertices,
+                  const std::vector<GLuint>& indices,
+                  VertexFormat vertex_format,
+                  const std::string& path,
+                  MeshOptimizationStats* stats = NULL);
+void loadMeshFile(SkeletalMeshBase& mesh, const std::string& path);
+void readMeshFile(const std::string& path, MeshFileData& data);
+void uploadMeshFile(SkeletalMeshBase& mesh, const MeshFileData& data);
+
+#endif
@@ -0,0 +1,474 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_lod.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the SkeletalMeshLod class and the skeleton
+///         reduction and mesh simplification functions.
+
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns twice the signed area of a triangle; positive when its
+///         corners are counterclockwise.
+float getSignedArea(const vec2& a, const vec2& b, const vec2& c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the weight that a vertex gives a joint.
+float getJointWeight(const Vertex& vertex, GLuint joint)
+{
+    float weight = 0.0f;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        if (vertex.joint_indices[i] == joint)
+            weight += vertex.joint_weights[i];
+    }
+
+    return weight;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how differently two vertices are skinned, from 0 when
+///         they have the same influences to 2 when they share none.
+float getInfluenceDifference(const Vertex& a, const Vertex& b)
+{
+    float difference = 0.0f;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        if (a.joint_weights[i] != 0.0f)
+            difference += std::abs(a.joint_weights[i] - getJointWeight(b, a.joint_indices[i]));
+        if (b.joint_weights[i] != 0.0f && getJointWeight(a, b.joint_indices[i]) == 0.0f)
+            difference += b.joint_weights[i];
+    }
+
+    return difference;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Works out the cost of collapsing vertex u onto vertex v.
+///
+/// \details Every triangle using u is changed to use v instead, and the
+///         triangles which use both disappear.  The cost is the change in the
+///         mesh's area, which is zero for vertices inside the mesh and grows
+///         as the outline is cut into, plus the area around u weighted by
+///         how differently u and v are skinned, since that area no longer
+///         deforms the way it did.
+///
+/// \return The cost, or infinity if the collapse would flip a triangle over.
+float getCollapseCost(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                      const std::vector<size_t>& triangles, GLuint u, GLuint v)
+{
+    float old_area = 0.0f;
+    float new_area = 0.0f;
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        const GLuint* corners = &indices[triangles[i] * 3];
+        float area = getSignedArea(vertices[corners[0]].position, vertices[corners[1]].position,
+                                   vertices[corners[2]].position);
+        old_area += std::abs(area);
+
+        if (corners[0] == v || corners[1] == v || corners[2] == v)
+            continue;
+
+        vec2 p[3];
+        for (size_t corner = 0; corner < 3; ++corner)
+            p[corner] = vertices[corners[corner] == u ? v : corners[corner]].position;
+
+        float collapsed_area = getSignedArea(p[0], p[1], p[2]);
+        if (collapsed_area * area <= 0.0f)
+            return std::numeric_limits<float>::infinity();
+
+        new_area += std::abs(collapsed_area);
+    }
+
+    // getSignedArea() gives twice the area.
+    float area_error = std::abs(new_area - old_area) * 0.5f;
+    return area_error + getInfluenceDifference(vertices[u], vertices[v]) * old_area * 0.5f;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the joints a mesh's vertices are weighted to.
+///
+/// \param  vertices The mesh's vertices.
+/// \param  joint_count The number of joints in the skeleton.
+/// \param  used_joints Receives, for each joint, whether any vertex has a
+///         non-zero weight on it.
+void findUsedJoints(const std::vector<Vertex>& vertices, size_t joint_count, std::vector<bool>& used_joints)
+{
+    used_joints.assign(joint_count, false);
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        for (size_t influence = 0; influence < MAX_JOINT_INFLUENCES; ++influence)
+        {
+            GLuint joint = vertices[i].joint_indices[influence];
+            if (vertices[i].joint_weights[influence] != 0.0f && joint < joint_count)
+                used_joints[joint] = true;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Merges a skeleton's leaf joints into their parents, and drops
+///         the joints a mesh doesn't need.
+///
+/// \details Each pass merges every joint that has no children left, apart
+///         from roots, so one pass over the demo's skeleton merges the
+///         forearms into the upper arms, and a second merges the arms into
+///         the root.
+///
+///         Then only the joints the mesh uses, or the joints they were
+///         merged into, and their ancestors are kept; a helmet bound to a
+///         full body rig keeps the head and the spine down to the root, and
+///         nothing else.  The rest are dropped, so an instance drawn with
+///         the reduction computes no local transform, hierarchy product or
+///         palette entry for them.
+///
+/// \param  skeleton The full skeleton.
+/// \param  merge_passes The number of times to merge the remaining leaves.
+/// \param  used_joints For each of the full skeleton's joints, whether the
+///         mesh is weighted to it (see findUsedJoints()), or null to keep
+///         every joint the merging leaves.  If no joint is used, every
+///         joint is kept too.
+/// \param  reduction Receives the reduced skeleton.
+void reduceSkeleton(const Skeleton& skeleton, size_t merge_passes, const std::vector<bool>* used_joints,
+                    SkeletonReduction& reduction)
+{
+    size_t joint_count = skeleton.getJointCount();
+
+    // merged_into[joint] is the joint itself while it's kept.
+    std::vector<GLuint> merged_into(joint_count);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+        merged_into[joint] = GLuint(joint);
+
+    for (size_t pass = 0; pass < merge_passes; ++pass)
+    {
+        std::vector<bool> has_children(joint_count, false);
+        for (size_t joint = 0; joint < joint_count; ++joint)
+        {
+            int parent = skeleton.getParent(joint);
+            if (merged_into[joint] == joint && parent != Skeleton::NO_PARENT)
+                has_children[parent] = true;
+        }
+
+        for (size_t joint = 0; joint < joint_count; ++joint)
+        {
+            int parent = skeleton.getParent(joint);
+            if (merged_into[joint] == joint && !has_children[joint] && parent != Skeleton::NO_PARENT)
+                merged_into[joint] = GLuint(parent);
+        }
+    }
+
+    // a used joint needs whatever it was merged into, and the needed joints
+    // need their parents.  Children come after their parents, so one pass
+    // backwards carries each need all the way up.
+    const GLuint DROPPED = GLuint(-1);
+    if (used_joints != nullptr && std::find(used_joints->begin(), used_joints->end(), true) != used_joints->end())
+    {
+        assert(used_joints->size() == joint_count);
+        std::vector<bool> needed(joint_count, false);
+        for (size_t joint = 0; joint < joint_count; ++joint)
+        {
+            GLuint kept = GLuint(joint);
+            while (merged_into[kept] != kept)
+                kept = merged_into[kept];
+            if ((*used_joints)[joint])
+                needed[kept] = true;
+        }
+
+        for (size_t joint = joint_count; joint-- > 0; )
+        {
+            int parent = skeleton.getParent(joint);
+            if (needed[joint] && parent != Skeleton::NO_PARENT)
+                needed[parent] = true;
+        }
+
+        for (size_t joint = 0; joint < joint_count; ++joint)
+        {
+            int parent = skeleton.getParent(joint);
+            if (merged_into[joint] == joint && !needed[joint])
+                merged_into[joint] = parent == Skeleton::NO_PARENT ? DROPPED : GLuint(parent);
+        }
+    }
+
+    // parents come first, so each joint's parent has already been resolved
+    // to the kept joint it was merged into.  The joints under a dropped root
+    // have no kept joint; no vertex is weighted to them, so they're mapped
+    // to the first kept joint just to stay in range.
+    reduction.source_joints.clear();
+    reduction.parents.clear();
+    reduction.joint_map.resize(joint_count);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        if (merged_into[joint] == DROPPED)
+        {
+            reduction.joint_map[joint] = 0;
+            continue;
+        }
+        if (merged_into[joint] != joint)
+        {
+            reduction.joint_map[joint] = reduction.joint_map[merged_into[joint]];
+            continue;
+        }
+
+        int parent = skeleton.getParent(joint);
+        reduction.joint_map[joint] = GLuint(reduction.source_joints.size());
+        reduction.source_joints.push_back(GLuint(joint));
+        reduction.parents.push_back(parent == Skeleton::NO_PARENT ? Skeleton::NO_PARENT : int(reduction.joint_map[parent]));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the model-space transforms of a reduced skeleton's
+///         joints from a pose of the full skeleton.
+///
+/// \details The merged joints are skipped entirely, so this does less work
+///         than Skeleton::computeJointTransforms() by the number of joints
+///         merged.
+///
+/// \param  reduction The reduced skeleton.
+/// \param  pose A pose of the full skeleton.
+/// \param  transforms Receives a transform for each of the reduced
+///         skeleton's joints.
+void computeReducedJointTransforms(const SkeletonReduction& reduction, const Pose& pose, mat4* transforms)
+{
+    for (size_t joint = 0; joint < reduction.source_joints.size(); ++joint)
+    {
+        transforms[joint] = getJointLocalTransform(pose, reduction.source_joints[joint]);
+
+        int parent = reduction.parents[joint];
+        if (parent != Skeleton::NO_PARENT)
+            transforms[joint] = transforms[parent] * transforms[joint];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves a vertex's influences onto the joints they were merged
+///         into, combining the weights of influences which end up on the
+///         same joint.
+///
+/// \param  vertex The vertex to remap.
+/// \param  joint_map The reduced joint for each of the full skeleton's joints.
+///
+/// \return The remapped vertex, with its influences sorted by weight.
+Vertex remapInfluences(const Vertex& vertex, const std::vector<GLuint>& joint_map)
+{
+    Vertex remapped;
+    remapped.position = vertex.position;
+    remapped.normal = vertex.normal;
+    remapped.tangent = vertex.tangent;
+
+    size_t count = 0;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        if (vertex.joint_weights[i] == 0.0f)
+            continue;
+
+        GLuint joint = joint_map[vertex.joint_indices[i]];
+        size_t slot = 0;
+        while (slot < count && remapped.joint_indices[slot] != joint)
+            ++slot;
+
+        if (slot == count)
+        {
+            remapped.joint_indices[slot] = joint;
+            ++count;
+        }
+        remapped.joint_weights[slot] += vertex.joint_weights[i];
+    }
+
+    return sortInfluences(remapped);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reduces the number of vertices in a 2D mesh by collapsing edges.
+///
+/// \details The cheapest edge collapse is applied until the mesh is down to
+///         the target number of vertices, or until every collapse left
+///         would cost more than max_error (see getCollapseCost()).
+///         Collapsing onto an existing vertex, rather than a new position,
+///         keeps every vertex's skinning data intact.
+///
+///         Each step looks at every edge, so this is only meant for building
+///         levels of detail ahead of time, not for large meshes every frame.
+///         Vertices which no triangle uses are dropped.
+///
+/// \param  vertices The mesh's vertices, which are replaced.
+/// \param  indices The mesh's triangles, which are replaced.
+/// \param  target_vertex_count The number of vertices to stop at.
+/// \param  max_error The highest cost of collapse allowed, in units of area.
+void simplifyMesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                  size_t target_vertex_count, float max_error)
+{
+    assert(indices.size() % 3 == 0);
+    size_t triangle_count = indices.size() / 3;
+    std::vector<bool> triangle_removed(triangle_count, false);
+
+    std::vector<bool> vertex_used(vertices.size(), false);
+    for (size_t i = 0; i < indices.size(); ++i)
+        vertex_used[indices[i]] = true;
+
+    size_t vertex_count = 0;
+    for (size_t i = 0; i < vertices.size(); ++i)
+        vertex_count += vertex_used[i] ? 1 : 0;
+
+    std::vector<std::vector<size_t> > vertex_triangles(vertices.size());
+    while (vertex_count > target_vertex_count)
+    {
+        for (size_t vertex = 0; vertex < vertices.size(); ++vertex)
+            vertex_triangles[vertex].clear();
+        for (size_t triangle = 0; triangle < triangle_count; ++triangle)
+        {
+            if (triangle_removed[triangle])
+                continue;
+            for (size_t corner = 0; corner < 3; ++corner)
+                vertex_triangles[indices[triangle * 3 + corner]].push_back(triangle);
+        }
+
+        float best_cost = std::numeric_limits<float>::infinity();
+        GLuint best_u = 0;
+        GLuint best_v = 0;
+        for (size_t triangle = 0; triangle < triangle_count; ++triangle)
+        {
+            if (triangle_removed[triangle])
+                continue;
+
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                GLuint a = indices[triangle * 3 + corner];
+                GLuint b = indices[triangle * 3 + (corner + 1) % 3];
+
+                float cost = getCollapseCost(vertices, indices, vertex_triangles[a], a, b);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_u = a;
+                    best_v = b;
+                }
+
+                cost = getCollapseCost(vertices, indices, vertex_triangles[b], b, a);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_u = b;
+                    best_v = a;
+                }
+            }
+        }
+
+        if (!(best_cost <= max_error))
+            break;
+
+        const std::vector<size_t>& triangles = vertex_triangles[best_u];
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            GLuint* corners = &indices[triangles[i] * 3];
+            if (corners[0] == best_v || corners[1] == best_v || corners[2] == best_v)
+            {
+                triangle_removed[triangles[i]] = true;
+                continue;
+            }
+
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                if (corners[corner] == best_u)
+                    corners[corner] = best_v;
+            }
+        }
+
+        vertex_used[best_u] = false;
+        --vertex_count;
+    }
+
+    // compact the survivors, keeping their order.
+    std::vector<GLuint> new_index(vertices.size(), 0);
+    std::vector<Vertex> kept_vertices;
+    kept_vertices.reserve(vertex_count);
+    for (size_t vertex = 0; vertex < vertices.size(); ++vertex)
+    {
+        if (!vertex_used[vertex])
+            continue;
+
+        new_index[vertex] = GLuint(kept_vertices.size());
+        kept_vertices.push_back(vertices[vertex]);
+    }
+
+    std::vector<GLuint> kept_indices;
+    kept_indices.reserve(indices.size());
+    for (size_t triangle = 0; triangle < triangle_count; ++triangle)
+    {
+        if (triangle_removed[triangle])
+            continue;
+        for (size_t corner = 0; corner < 3; ++corner)
+            kept_indices.push_back(new_index[indices[triangle * 3 + corner]]);
+    }
+
+    vertices.swap(kept_vertices);
+    indices.swap(kept_indices);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds a lower level of detail of a mesh, and prepares it to be
+///         uploaded.  This doesn't need a GL context, so levels can be built
+///         on worker threads; mesh.uploadPrepared() must then be called on
+///         the thread which owns the context before the level is drawn.
+///
+/// \param  source The full detail mesh.  Its vertices and indices fields
+///         must be filled in, so meshes loaded from mesh files can't be
+///         reduced.
+/// \param  skeleton The skeleton the source mesh is skinned by.
+/// \param  merge_passes The number of times to merge the skeleton's leaf
+///         joints (see reduceSkeleton()).  The joints the source mesh isn't
+///         weighted to are dropped as well.
+/// \param  vertex_ratio The fraction of the source mesh's vertices to aim
+///         for.
+/// \param  max_error The highest cost of any one edge collapse (see
+///         simplifyMesh()).
+SkeletalMeshLod::SkeletalMeshLod(const SkeletalMesh& source, const Skeleton& skeleton, size_t merge_passes,
+                                 float vertex_ratio, float max_error)
+{
+    assert(!source.vertices.empty());
+    std::vector<bool> used_joints;
+    findUsedJoints(source.vertices, skeleton.getJointCount(), used_joints);
+    reduceSkeleton(skeleton, merge_passes, &used_joints, this->skeleton);
+
+    mesh.vertices.resize(source.vertices.size());
+    for (size_t i = 0; i < source.vertices.size(); ++i)
+        mesh.vertices[i] = remapInfluences(source.vertices[i], this->skeleton.joint_map);
+    mesh.indices = source.indices;
+
+    simplifyMesh(mesh.vertices, mesh.indices, size_t(source.vertices.size() * vertex_ratio), max_error);
+
+    mesh.vertex_format = source.vertex_format;
+    mesh.prepareMesh();
+
+    bind_pose_inv.resize(getJointCount());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Picks out the reduced skeleton's inverse bind pose from the full
+///         skeleton's.
+void SkeletalMeshLod::setBindPose(const mat4* bind_pose_inv)
+{
+    for (size_t joint = 0; joint < skeleton.source_joints.size(); ++joint)
+        this->bind_pose_inv[joint] = bind_pose_inv[skeleton.source_joints[joint]];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the reduced skeleton.
+size_t SkeletalMeshLod::getJointCount() const
+{
+    return skeleton.source_joints.size();
+}
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_lod.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the SkeletalMeshLod class, and the functions for
+///         reducing skeletons and simplifying meshes that it's built with.
+
+#ifndef MESH_LOD_H_
+#define MESH_LOD_H_
+
+#include "skeletal_mesh.h"
+#include "skeleton.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A skeleton with some of its leaf joints merged into their
+///         parents, and the joints no vertex of its mesh needs dropped.
+///
+/// \details The joints which are kept stay in the same parent-before-child
+///         order, and are numbered from 0 again.  Since a merged or dropped
+///         joint's only descendants were merged or dropped too, every kept
+///         joint's model-space transform is exactly the same as in the full
+///         skeleton.
+struct SkeletonReduction
+{
+    std::vector<GLuint> source_joints;  ///< The full skeleton's index of each kept joint.
+    std::vector<int> parents;           ///< The parent of each kept joint, or Skeleton::NO_PARENT.
+    std::vector<GLuint> joint_map;      ///< For each joint of the full skeleton, the kept joint it was merged into.
+};
+
+void findUsedJoints(const std::vector<Vertex>& vertices, size_t joint_count, std::vector<bool>& used_joints);
+void reduceSkeleton(const Skeleton& skeleton, size_t merge_passes, const std::vector<bool>* used_joints,
+                    SkeletonReduction& reduction);
+void computeReducedJointTransforms(const SkeletonReduction& reduction, const Pose& pose, mat4* transforms);
+
+Vertex remapInfluences(const Vertex& vertex, const std::vector<GLuint>& joint_map);
+
+void simplifyMesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                  size_t target_vertex_count, float max_error);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A lower level of detail of a SkeletalMesh, with fewer vertices
+///         and triangles, skinned by a reduced skeleton.
+///
+/// \details The vertices' influences are remapped onto the reduced skeleton,
+///         so the joints which were merged away move rigidly with their
+///         parents, and vertices which were only separated by a merged joint
+///         often end up with fewer influences.  The mesh is then simplified
+///         by collapsing the edges which change its outline and skinning the
+///         least.
+///
+///         Drawing an instance at this level of detail only needs a palette
+///         for the reduced skeleton's joints, in the order of
+///         skeleton.source_joints.
+class SkeletalMeshLod
+{
+public:
+    SkeletalMeshLod(const SkeletalMesh& source, const Skeleton& skeleton, size_t merge_passes,
+                    float vertex_ratio, float max_error);
+
+    void setBindPose(const mat4* bind_pose_inv);
+
+    size_t getJointCount() const;
+
+    SkeletonReduction skeleton;
+    SkeletalMesh mesh;
+    std::vector<mat4> bind_pose_inv;    ///< The inverse bind pose of each of the reduced skeleton's joints.
+
+private:
+    SkeletalMeshLod(const SkeletalMeshLod&);            // non-copyable
+    SkeletalMeshLod& operator=(const SkeletalMeshLod&); // non-copyable
+};
+
+#endif
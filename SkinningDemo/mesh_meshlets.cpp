@@ -0,0 +1,319 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_meshlets.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the functions which build and cull a
+///         MeshletMesh.
+
+#include "mesh_meshlets.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+
+/// Marks a mesh vertex which isn't in the meshlet being built.
+const GLuint NOT_IN_MESHLET = ~GLuint(0);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a 2D or 3D position as a vec3; 2D positions are at z = 0.
+vec3 toPosition3D(const vec2& position)
+{
+    return vec3(position, 0);
+}
+
+vec3 toPosition3D(const vec3& position)
+{
+    return position;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves a model-space position into the space a quantized mesh's
+///         uploaded positions are in; the inverse of
+///         PositionQuantization::getTransform().
+vec2 toQuantizationSpace(const vec2& position, const PositionQuantization& quantization)
+{
+    return (position - vec2(quantization.bias)) / quantization.scale;
+}
+
+vec3 toQuantizationSpace(const vec3& position, const PositionQuantization& quantization)
+{
+    return (position - quantization.bias) / quantization.scale;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the cone around the normals of a meshlet's triangles.
+///
+/// \details The axis is the mean of the unit normals.  Degenerate triangles
+///         have no normal and are ignored; a meshlet with nothing but those,
+///         or whose normals reach 90 degrees or more from the axis, can
+///         never be entirely back-facing.
+template <typename VertexType>
+void computeNormalCone(const std::vector<VertexType>& vertices, const MeshletMesh& meshlets, Meshlet& meshlet)
+{
+    std::vector<vec3> normals;
+    normals.reserve(meshlet.triangle_count);
+
+    vec3 sum(0, 0, 0);
+    for (size_t t = 0; t < meshlet.triangle_count; ++t)
+    {
+        const GLubyte* triangle = &meshlets.triangles[(meshlet.first_triangle + t) * 3];
+        vec3 p0 = toPosition3D(vertices[meshlets.vertices[meshlet.first_vertex + triangle[0]]].position);
+        vec3 p1 = toPosition3D(vertices[meshlets.vertices[meshlet.first_vertex + triangle[1]]].position);
+        vec3 p2 = toPosition3D(vertices[meshlets.vertices[meshlet.first_vertex + triangle[2]]].position);
+
+        vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length > 0.0f)
+        {
+            normals.push_back(normal / length);
+            sum += normals.back();
+        }
+    }
+
+    meshlet.cone_axis = vec3(0, 0, 1);
+    meshlet.cone_cutoff = 1.0f;
+
+    float sum_length = glm::length(sum);
+    if (normals.empty() || sum_length < 1e-6f)
+        return;
+
+    meshlet.cone_axis = sum / sum_length;
+    float min_dot = 1.0f;
+    for (size_t i = 0; i < normals.size(); ++i)
+        min_dot = std::min(min_dot, glm::dot(meshlet.cone_axis, normals[i]));
+
+    if (min_dot > 0.0f)
+        meshlet.cone_cutoff = std::sqrt(std::max(1.0f - min_dot * min_dot, 0.0f));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Completes the last meshlet of a MeshletMesh, once all of its
+///         triangles have been added: lists its joints, bounds the vertices
+///         each influences, and finds its normal cone.  Its vertices are
+///         then unmarked in local_index, ready for the next meshlet.
+template <typename VertexType>
+void finishMeshlet(const std::vector<VertexType>& vertices, MeshletMesh& meshlets, std::vector<GLuint>& local_index)
+{
+    Meshlet& meshlet = meshlets.meshlets.back();
+    meshlet.first_joint = GLuint(meshlets.joints.size());
+
+    for (size_t i = 0; i < meshlet.vertex_count; ++i)
+    {
+        GLuint index = meshlets.vertices[meshlet.first_vertex + i];
+        const VertexType& vertex = vertices[index];
+        local_index[index] = NOT_IN_MESHLET;
+
+        for (size_t j = 0; j < MAX_JOINT_INFLUENCES; ++j)
+        {
+            if (vertex.joint_weights[j] == 0)
+                continue;
+
+            // meshlets have few joints, so a linear search is quickest.
+            size_t slot = meshlet.first_joint;
+            while (slot < meshlets.joints.size() && meshlets.joints[slot] != vertex.joint_indices[j])
+                ++slot;
+            if (slot == meshlets.joints.size())
+            {
+                meshlets.joints.push_back(vertex.joint_indices[j]);
+                meshlets.joint_bounds.push_back(BoundingBox());
+            }
+            meshlets.joint_bounds[slot].expand(vec2(vertex.position));
+        }
+    }
+
+    meshlet.joint_count = GLuint(meshlets.joints.size() - meshlet.first_joint);
+    computeNormalCone(vertices, meshlets, meshlet);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts a new, empty meshlet at the end of a MeshletMesh.
+void beginMeshlet(MeshletMesh& meshlets, size_t partition)
+{
+    Meshlet meshlet;
+    meshlet.first_vertex = GLuint(meshlets.vertices.size());
+    meshlet.vertex_count = 0;
+    meshlet.first_triangle = GLuint(meshlets.triangles.size() / 3);
+    meshlet.triangle_count = 0;
+    meshlet.first_joint = GLuint(meshlets.joints.size());
+    meshlet.joint_count = 0;
+    meshlet.partition = GLuint(partition);
+    meshlet.cone_axis = vec3(0, 0, 1);
+    meshlet.cone_cutoff = 1.0f;
+    meshlets.meshlets.push_back(meshlet);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Groups the triangles of each of a mesh's partitions into
+///         meshlets.
+///
+/// \details The triangles are taken in order, and a new meshlet is started
+///         whenever the next one would take the current meshlet past
+///         MAX_MESHLET_VERTICES or MAX_MESHLET_TRIANGLES.  The uploaded
+///         order is already optimized for the vertex cache (see
+///         optimizeTriangleOrder()), which keeps neighbouring triangles
+///         together, so the meshlets come out compact without any
+///         clustering of their own.
+///
+/// \param  vertices The mesh's vertices, in the order they were uploaded.
+/// \param  indices The mesh's indices, in the order they were uploaded.
+/// \param  partitions The mesh's partitions of the indices.
+/// \param  meshlets Receives the meshlets.
+template <typename VertexType>
+void buildMeshlets(const std::vector<VertexType>& vertices, const std::vector<GLuint>& indices,
+                   const std::vector<SkeletalMeshBase::Partition>& partitions, MeshletMesh& meshlets)
+{
+    meshlets = MeshletMesh();
+    std::vector<GLuint> local_index(vertices.size(), NOT_IN_MESHLET);
+
+    for (size_t p = 0; p < partitions.size(); ++p)
+    {
+        const SkeletalMeshBase::Partition& partition = partitions[p];
+        if (partition.index_count == 0)
+            continue;
+
+        beginMeshlet(meshlets, p);
+        size_t end = partition.first_index + partition.index_count;
+        for (size_t i = partition.first_index; i + 2 < end; i += 3)
+        {
+            // a vertex used twice by the triangle only counts once.
+            size_t new_vertices = 0;
+            for (size_t k = 0; k < 3; ++k)
+            {
+                GLuint index = indices[i + k];
+                if (local_index[index] == NOT_IN_MESHLET &&
+                    (k < 1 || indices[i] != index) && (k < 2 || indices[i + 1] != index))
+                {
+                    ++new_vertices;
+                }
+            }
+
+            Meshlet* meshlet = &meshlets.meshlets.back();
+            if (meshlet->vertex_count + new_vertices > MAX_MESHLET_VERTICES ||
+                meshlet->triangle_count == MAX_MESHLET_TRIANGLES)
+            {
+                finishMeshlet(vertices, meshlets, local_index);
+                beginMeshlet(meshlets, p);
+                meshlet = &meshlets.meshlets.back();
+            }
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                GLuint index = indices[i + k];
+                if (local_index[index] == NOT_IN_MESHLET)
+                {
+                    local_index[index] = meshlet->vertex_count++;
+                    meshlets.vertices.push_back(index);
+                }
+                meshlets.triangles.push_back(GLubyte(local_index[index]));
+            }
+            ++meshlet->triangle_count;
+        }
+
+        finishMeshlet(vertices, meshlets, local_index);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds the meshlets of a mesh uploaded with uploadMesh(), from
+///         its vertices and indices as they were uploaded.
+///
+/// \details The mesh must still have its vertices and indices, and not have
+///         been edited since the upload, so that its upload remap is
+///         current (see SkeletalMeshBase::getUploadRemap()).  The meshlets'
+///         vertices then index the mesh's VBO.  The bounds are in the space
+///         of the uploaded positions, so for a quantized mesh they're
+///         culled with the same folded palettes it's drawn with.
+///
+/// \param  mesh The mesh.
+/// \param  meshlets Receives the meshlets.
+template <typename VertexType>
+void buildMeshlets(const BasicSkeletalMesh<VertexType>& mesh, MeshletMesh& meshlets)
+{
+    const MeshUploadRemap& remap = mesh.getUploadRemap();
+    assert(remap.vertices.size() == mesh.vertices.size());
+    assert(remap.triangles.size() * 3 == mesh.indices.size());
+
+    PositionQuantization quantization = mesh.position_quantization;
+    std::vector<VertexType> vertices(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        VertexType& vertex = vertices[remap.vertices[i]];
+        vertex = mesh.vertices[i];
+        vertex.position = toQuantizationSpace(vertex.position, quantization);
+    }
+
+    std::vector<GLuint> indices(mesh.indices.size());
+    for (size_t t = 0; t < remap.triangles.size(); ++t)
+    {
+        for (size_t k = 0; k < 3; ++k)
+            indices[remap.triangles[t] * 3 + k] = remap.vertices[mesh.indices[t * 3 + k]];
+    }
+
+    buildMeshlets(vertices, indices, mesh.getPartitions(), meshlets);
+}
+
+template void buildMeshlets(const std::vector<Vertex>&, const std::vector<GLuint>&,
+                            const std::vector<SkeletalMeshBase::Partition>&, MeshletMesh&);
+template void buildMeshlets(const std::vector<Vertex3D>&, const std::vector<GLuint>&,
+                            const std::vector<SkeletalMeshBase::Partition>&, MeshletMesh&);
+template void buildMeshlets(const SkeletalMesh&, MeshletMesh&);
+template void buildMeshlets(const SkeletalMesh3D&, MeshletMesh&);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Tests whether any of a meshlet could be seen in a pose, exactly
+///         as the meshlet culling compute shader does.
+///
+/// \details The meshlet is bounded by moving each of its joints' bounds
+///         with the joint's palette matrix, and culled if that's entirely
+///         outside clip space's [-1, 1] in x and y.  The palettes' output is
+///         clip space, with no perspective, as the skinning programs' is.
+///
+///         With cull_back_faces, the meshlet is also culled if its normal
+///         cone, turned by every one of its joints, faces entirely away from
+///         the viewer, with front faces wound counterclockwise as GL's
+///         default.  A blend of normals which all face away faces away too,
+///         so this holds for blended vertices as well as rigid ones.  Only
+///         use it for meshes drawn with back faces culled; the meshes the
+///         demo draws without culling may be wound either way.
+///
+/// \param  meshlets The mesh's meshlets.
+/// \param  meshlet The index of the meshlet to test.
+/// \param  palette The skinning palette, indexed by joint.
+/// \param  cull_back_faces Whether to cull back-facing meshlets.
+/// \return false if none of the meshlet can be seen.
+bool isMeshletVisible(const MeshletMesh& meshlets, size_t meshlet, const mat4* palette, bool cull_back_faces)
+{
+    const Meshlet& m = meshlets.meshlets[meshlet];
+
+    BoundingBox bounds;
+    bool back_facing = cull_back_faces && m.cone_cutoff < 1.0f;
+    for (size_t i = m.first_joint; i < m.first_joint + m.joint_count; ++i)
+    {
+        const mat4& transform = palette[meshlets.joints[i]];
+        bounds.expand(transformBox(meshlets.joint_bounds[i], transform));
+
+        if (back_facing)
+        {
+            // normals move with the cofactor matrix, which keeps them
+            // matching the winding even through a mirroring transform.
+            vec3 x_axis(transform[0]);
+            vec3 y_axis(transform[1]);
+            vec3 z_axis(transform[2]);
+            vec3 axis = m.cone_axis.x * glm::cross(y_axis, z_axis) +
+                        m.cone_axis.y * glm::cross(z_axis, x_axis) +
+                        m.cone_axis.z * glm::cross(x_axis, y_axis);
+            float length = glm::length(axis);
+            back_facing = length > 0.0f && -axis.z / length > m.cone_cutoff;
+        }
+    }
+
+    BoundingBox clip;
+    clip.min = vec2(-1, -1);
+    clip.max = vec2(1, 1);
+    return !back_facing && bounds.overlaps(clip);
+}
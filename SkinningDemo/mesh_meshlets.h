@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_meshlets.h
+/// \author Ben Crist
+///
+/// \brief  The MeshletMesh struct, and the functions which build a mesh's
+///         meshlets and cull them.
+
+#ifndef MESH_MESHLETS_H_
+#define MESH_MESHLETS_H_
+
+#include "skeletal_mesh.h"
+#include <vector>
+
+const size_t MAX_MESHLET_VERTICES = 64;     ///< The most vertices in a meshlet.
+const size_t MAX_MESHLET_TRIANGLES = 124;   ///< The most triangles in a meshlet.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One cluster of a mesh's triangles, small enough to be culled and
+///         drawn as a unit.
+///
+/// \details The ranges index the arrays of the MeshletMesh it belongs to.
+///         The cone bounds the bind-pose normals of the meshlet's triangles,
+///         as given by their winding: every normal is within the cone's
+///         half-angle of its axis, and cone_cutoff is the sine of the
+///         half-angle, or 1 if the triangles face too many ways for the
+///         meshlet to ever be entirely back-facing.
+struct Meshlet
+{
+    GLuint first_vertex;    ///< The start of the meshlet's vertices in MeshletMesh::vertices.
+    GLuint vertex_count;
+    GLuint first_triangle;  ///< The start of the meshlet's triangles in MeshletMesh::triangles, in triangles.
+    GLuint triangle_count;
+    GLuint first_joint;     ///< The start of the meshlet's joints in MeshletMesh::joints and joint_bounds.
+    GLuint joint_count;
+    GLuint partition;       ///< The partition of the mesh whose triangles the meshlet holds.
+    vec3 cone_axis;         ///< The unit axis of the normal cone, in bind-pose model space.
+    float cone_cutoff;      ///< The sine of the cone's half-angle, or 1 if it can't be culled.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A mesh's triangles, grouped into meshlets of at most
+///         MAX_MESHLET_VERTICES vertices and MAX_MESHLET_TRIANGLES
+///         triangles.
+///
+/// \details Each meshlet lists the vertices its triangles use, and its
+///         triangles index that list, so they fit in bytes.  It also lists
+///         the joints which influence any of those vertices, each with the
+///         bind-pose bounds of the meshlet's vertices it influences, so a
+///         meshlet can be bounded in any pose from just a few palette
+///         entries, the same way computeSkinnedBounds() bounds a whole mesh.
+///
+///         The meshlets of each of the mesh's partitions come one after
+///         another, in partition order, and never mix partitions, so every
+///         meshlet can be drawn with its partition's program.
+struct MeshletMesh
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<GLuint> vertices;           ///< The mesh's index of each meshlet vertex.
+    std::vector<GLubyte> triangles;         ///< Three indices of the meshlet's vertices per triangle.
+    std::vector<GLuint> joints;             ///< The skeleton's index of each meshlet joint.
+    std::vector<BoundingBox> joint_bounds;  ///< The bind-pose bounds of the meshlet's vertices each meshlet joint influences.
+};
+
+template <typename VertexType>
+void buildMeshlets(const std::vector<VertexType>& vertices, const std::vector<GLuint>& indices,
+                   const std::vector<SkeletalMeshBase::Partition>& partitions, MeshletMesh& meshlets);
+template <typename VertexType>
+void buildMeshlets(const BasicSkeletalMesh<VertexType>& mesh, MeshletMesh& meshlets);
+
+bool isMeshletVisible(const MeshletMesh& meshlets, size_t meshlet, const mat4* palette, bool cull_back_faces);
+
+#endif
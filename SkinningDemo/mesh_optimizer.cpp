@@ -0,0 +1,234 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_optimizer.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of vertex cache optimization functions.
+
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+/// The size of the LRU cache that optimizeTriangleOrder() models when
+/// scoring vertices.  This is deliberately larger than real FIFO caches; it
+/// only needs to rank vertices by how recently they were used.
+const size_t LRU_CACHE_SIZE = 32;
+
+const size_t NO_TRIANGLE = size_t(-1);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Scores a vertex by how much emitting one of its triangles next
+///         would help the vertex cache, as described in Tom Forsyth's
+///         "Linear-Speed Vertex Cache Optimisation".
+///
+/// \details Vertices which were used recently score higher, since they are
+///         probably still in the cache.  The three vertices of the last
+///         triangle get a fixed score, so that the optimizer doesn't just
+///         produce long strips.  Vertices with few remaining triangles get a
+///         boost, so that they are finished off instead of being left as
+///         isolated triangles to be picked up later.
+///
+/// \param  cache_position The vertex's position in the LRU cache, or -1 if
+///         it isn't in the cache.
+/// \param  remaining_triangles The number of triangles using the vertex that
+///         haven't been emitted yet.
+float getVertexScore(int cache_position, size_t remaining_triangles)
+{
+    if (remaining_triangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        if (cache_position < 3)
+            score = 0.75f;
+        else
+        {
+            float scale = 1.0f - float(cache_position - 3) / float(LRU_CACHE_SIZE - 3);
+            score = std::pow(scale, 1.5f);
+        }
+    }
+
+    return score + 2.0f / std::sqrt(float(remaining_triangles));
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reorders triangles, in place, so that consecutive triangles share
+///         as many vertices as possible.
+///
+/// \details This is a greedy algorithm: after each triangle is emitted, the
+///         scores of the vertices in the modeled cache are updated, and the
+///         highest scoring triangle using one of them is emitted next.  If
+///         none of the cached vertices have triangles left, the first
+///         triangle which hasn't been emitted is used instead.  Only the
+///         order of the triangles changes; the winding of each triangle is
+///         preserved.
+///
+/// \param  indices The indices of the triangles to reorder.
+/// \param  index_count The number of indices, a multiple of 3.
+/// \param  vertex_count One more than the highest vertex index used.
+/// \param  triangle_order If not NULL, receives the original position of
+///         each triangle in the new order; it must have room for
+///         index_count / 3 entries.
+void optimizeTriangleOrder(GLuint* indices, size_t index_count, size_t vertex_count,
+                           GLuint* triangle_order)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count < 2)
+    {
+        if (triangle_order && triangle_count == 1)
+            triangle_order[0] = 0;
+        return;
+    }
+
+    // build the list of triangles using each vertex.  Emitted triangles are
+    // removed from the lists, so only the first remaining[v] are valid.
+    std::vector<size_t> remaining(vertex_count, 0);
+    for (size_t i = 0; i < triangle_count * 3; ++i)
+        ++remaining[indices[i]];
+
+    std::vector<size_t> adjacency_offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; ++v)
+        adjacency_offsets[v + 1] = adjacency_offsets[v] + remaining[v];
+
+    std::vector<size_t> adjacency(triangle_count * 3);
+    std::vector<size_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (size_t i = 0; i < triangle_count * 3; ++i)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    std::vector<int> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        vertex_scores[v] = getVertexScore(-1, remaining[v]);
+
+    std::vector<float> triangle_scores(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    size_t best = 0;
+    for (size_t t = 0; t < triangle_count; ++t)
+    {
+        const GLuint* triangle = indices + t * 3;
+        triangle_scores[t] = vertex_scores[triangle[0]] + vertex_scores[triangle[1]] + vertex_scores[triangle[2]];
+        if (triangle_scores[t] > triangle_scores[best])
+            best = t;
+    }
+
+    std::vector<GLuint> output;
+    output.reserve(triangle_count * 3);
+
+    std::vector<GLuint> cache;
+    std::vector<GLuint> new_cache;
+    cache.reserve(LRU_CACHE_SIZE + 3);
+    new_cache.reserve(LRU_CACHE_SIZE + 3);
+
+    size_t next_unemitted = 0;
+    while (best != NO_TRIANGLE)
+    {
+        const GLuint* triangle = indices + best * 3;
+        if (triangle_order)
+            triangle_order[output.size() / 3] = GLuint(best);
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        // remove the triangle from its vertices' lists, and move its vertices
+        // to the front of the cache.
+        new_cache.clear();
+        for (size_t k = 0; k < 3; ++k)
+        {
+            GLuint v = triangle[k];
+            size_t* first = &adjacency[adjacency_offsets[v]];
+            size_t* last = first + remaining[v];
+            std::iter_swap(std::find(first, last, best), last - 1);
+            --remaining[v];
+
+            if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end())
+                new_cache.push_back(v);
+        }
+
+        for (size_t i = 0; i < cache.size(); ++i)
+        {
+            if (std::find(new_cache.begin(), new_cache.end(), cache[i]) == new_cache.end())
+                new_cache.push_back(cache[i]);
+        }
+
+        // rescore every vertex that was in the cache, including the ones which
+        // just fell out of it, then the triangles which use them.
+        for (size_t i = 0; i < new_cache.size(); ++i)
+        {
+            GLuint v = new_cache[i];
+            cache_positions[v] = i < LRU_CACHE_SIZE ? int(i) : -1;
+            vertex_scores[v] = getVertexScore(cache_positions[v], remaining[v]);
+        }
+
+        best = NO_TRIANGLE;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < new_cache.size(); ++i)
+        {
+            GLuint v = new_cache[i];
+            const size_t* first = &adjacency[adjacency_offsets[v]];
+            for (size_t j = 0; j < remaining[v]; ++j)
+            {
+                size_t t = first[j];
+                const GLuint* other = indices + t * 3;
+                triangle_scores[t] = vertex_scores[other[0]] + vertex_scores[other[1]] + vertex_scores[other[2]];
+                if (triangle_scores[t] > best_score)
+                {
+                    best = t;
+                    best_score = triangle_scores[t];
+                }
+            }
+        }
+
+        if (new_cache.size() > LRU_CACHE_SIZE)
+            new_cache.resize(LRU_CACHE_SIZE);
+        cache.swap(new_cache);
+
+        if (best == NO_TRIANGLE)
+        {
+            while (next_unemitted < triangle_count && emitted[next_unemitted])
+                ++next_unemitted;
+            if (next_unemitted < triangle_count)
+                best = next_unemitted;
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the average cache miss ratio of a list of triangles: the
+///         number of vertices which must be transformed per triangle, given
+///         a FIFO post-transform cache like most GPUs have.
+///
+/// \param  indices The indices of the triangles.
+/// \param  index_count The number of indices, a multiple of 3.
+/// \param  cache_size The number of vertices the simulated cache holds.
+/// \return The ACMR, from 3.0 in the worst case down to about 0.5, or 0 if
+///         there are no triangles.
+float computeACMR(const GLuint* indices, size_t index_count, size_t cache_size)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || cache_size == 0)
+        return triangle_count == 0 ? 0.0f : 3.0f;
+
+    // the cache is a ring buffer; next is the slot the next miss replaces.
+    std::vector<GLuint> cache(cache_size, GLuint(-1));
+    size_t next = 0;
+    size_t misses = 0;
+    for (size_t i = 0; i < triangle_count * 3; ++i)
+    {
+        if (std::find(cache.begin(), cache.end(), indices[i]) != cache.end())
+            continue;
+
+        cache[next] = indices[i];
+        next = (next + 1) % cache_size;
+        ++misses;
+    }
+
+    return float(misses) / float(triangle_count);
+}
@@ -0,0 +1,37 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_optimizer.h
+/// \author Ben Crist
+///
+/// \brief  Functions for reordering triangles to make better use of the
+///         GPU's post-transform vertex cache.
+
+#ifndef MESH_OPTIMIZER_H_
+#define MESH_OPTIMIZER_H_
+
+#include "demo.h"
+#include <cstddef>
+
+/// The size of the FIFO cache that computeACMR() simulates when no size is
+/// given.  Most hardware caches at least this many vertices.
+const size_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The average cache miss ratio (vertices transformed per triangle)
+///         of a mesh's indices before and after they were optimized.
+///
+/// \details An ACMR of 3.0 means every vertex of every triangle had to be
+///         transformed; a well-ordered regular grid approaches 0.5.
+struct MeshOptimizationStats
+{
+    float acmr_before;  ///< The ACMR of the indices as given.
+    float acmr_after;   ///< The ACMR of the optimized indices.
+};
+
+void optimizeTriangleOrder(GLuint* indices, size_t index_count, size_t vertex_count,
+                           GLuint* triangle_order = NULL);
+
+float computeACMR(const GLuint* indices, size_t index_count,
+                  size_t cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+#endif
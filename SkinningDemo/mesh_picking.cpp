@@ -0,0 +1,246 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_picking.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of SkinnedMeshPicker class functions.
+
+#include "mesh_picking.h"
+#include "affine_2d.h"
+#include "simd_math.h"
+
+#include <glm/gtx/intersect.hpp>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Tests a ray against both faces of a triangle.
+///
+/// \details glm::intersectRayTriangle() only hits triangles wound
+///         counterclockwise as the ray sees them, so the other face is
+///         tested by swapping two vertices, which swaps the barycentric
+///         coordinates back.
+///
+/// \param  barycentric Receives the weights of v1 and v2 at the hit.
+/// \param  distance Receives how far along the ray the hit is.
+bool intersectTriangle(const vec3& origin, const vec3& direction,
+                       const vec3& v0, const vec3& v1, const vec3& v2, vec2& barycentric, float& distance)
+{
+    vec3 result;
+    if (glm::intersectRayTriangle(origin, direction, v0, v1, v2, result))
+        barycentric = vec2(result.x, result.y);
+    else if (glm::intersectRayTriangle(origin, direction, v0, v2, v1, result))
+        barycentric = vec2(result.y, result.x);
+    else
+        return false;
+
+    distance = result.z;
+    return true;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sorts a mesh's triangles into clusters, and bounds them.
+///
+/// \details If a vertex names a joint the skeleton doesn't have, the problem
+///         is reported to stderr and an exception is thrown.
+///
+/// \param  vertices The mesh's vertices, in the bind pose.
+/// \param  indices The indices of its triangles.
+/// \param  joint_count The number of joints in the skeleton.
+SkinnedMeshPicker::SkinnedMeshPicker(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                                     size_t joint_count)
+    : vertices_(vertices),
+      indices_(indices)
+{
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            if (vertices[v].joint_weights[i] != 0.0f && vertices[v].joint_indices[i] >= joint_count)
+            {
+                std::cerr << "Can't build a picker for the mesh!" << std::endl
+                          << "  Vertex " << v << " is influenced by joint " << vertices[v].joint_indices[i]
+                          << ", but the skeleton has " << joint_count << " joints." << std::endl;
+                throw std::runtime_error("Can't build a picker for the mesh!");
+            }
+        }
+    }
+
+    std::vector<size_t> joint_clusters(joint_count, size_t(-1));
+    std::vector<float> joint_weights(joint_count, 0.0f);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        // the joint with the most weight over the triangle's vertices.
+        size_t joint = 0;
+        float best_weight = -1.0f;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const Vertex& vertex = vertices[indices[t + corner]];
+            for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+            {
+                if (vertex.joint_weights[i] != 0.0f)
+                    joint_weights[vertex.joint_indices[i]] += vertex.joint_weights[i];
+            }
+        }
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const Vertex& vertex = vertices[indices[t + corner]];
+            for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+            {
+                GLuint j = vertex.joint_indices[i];
+                if (vertex.joint_weights[i] == 0.0f)
+                    continue;
+
+                if (joint_weights[j] > best_weight || (joint_weights[j] == best_weight && j < joint))
+                {
+                    joint = j;
+                    best_weight = joint_weights[j];
+                }
+            }
+        }
+
+        if (joint_clusters[joint] == size_t(-1))
+        {
+            joint_clusters[joint] = clusters_.size();
+            clusters_.push_back(Cluster());
+            clusters_.back().joint = joint;
+        }
+        Cluster& cluster = clusters_[joint_clusters[joint]];
+
+        bool rigid = true;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            const Vertex& vertex = vertices[indices[t + corner]];
+            for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+            {
+                GLuint j = vertex.joint_indices[i];
+                if (vertex.joint_weights[i] == 0.0f)
+                    continue;
+
+                joint_weights[j] = 0.0f;
+                rigid = rigid && j == joint;
+
+                size_t b = 0;
+                while (b < cluster.boxes.size() && cluster.boxes[b].joint != j)
+                    ++b;
+                if (b == cluster.boxes.size())
+                {
+                    cluster.boxes.push_back(JointBox());
+                    cluster.boxes.back().joint = j;
+                }
+                cluster.boxes[b].box.expand(vertex.position);
+            }
+        }
+
+        if (rigid)
+            cluster.rigid_triangles.push_back(GLuint(t));
+        else
+            cluster.skinned_triangles.push_back(GLuint(t));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the nearest triangle a ray hits, in a pose.
+///
+/// \param  origin Where the ray starts, in model space.
+/// \param  direction The ray's direction; it needn't be normalized.
+/// \param  palette The pose's skinning palette: each joint's transform
+///         times its inverse bind transform.
+/// \param  hit Receives the nearest hit, if there is one.
+/// \return false if the ray misses the mesh.
+bool SkinnedMeshPicker::pick(const vec3& origin, const vec3& direction, const mat4* palette, PickHit& hit) const
+{
+    if (direction.z == 0.0f)
+        return false;
+
+    float plane_distance = -origin.z / direction.z;
+    if (plane_distance < 0.0f)
+        return false;
+
+    vec2 point = vec2(origin + direction * plane_distance);
+
+    bool found = false;
+    hit.distance = std::numeric_limits<float>::max();
+    hit.tested_triangles = 0;
+    for (size_t c = 0; c < clusters_.size(); ++c)
+    {
+        const Cluster& cluster = clusters_[c];
+
+        BoundingBox bounds;
+        for (size_t b = 0; b < cluster.boxes.size(); ++b)
+            bounds.expand(transformBox(cluster.boxes[b].box, palette[cluster.boxes[b].joint]));
+        if (!bounds.contains(point))
+            continue;
+
+        // an affine transform keeps distances along the ray, so hits in
+        // bind space compare directly with hits in model space.
+        mat4 to_bind = invertJointTransform(palette[cluster.joint]);
+        vec3 bind_origin = vec3(transformVector(to_bind, vec4(origin, 1)));
+        vec3 bind_direction = vec3(transformVector(to_bind, vec4(direction, 0)));
+        for (size_t i = 0; i < cluster.rigid_triangles.size(); ++i)
+        {
+            const GLuint* triangle = &indices_[cluster.rigid_triangles[i]];
+            vec2 barycentric;
+            float distance;
+            if (intersectTriangle(bind_origin, bind_direction, vec3(vertices_[triangle[0]].position, 0),
+                                  vec3(vertices_[triangle[1]].position, 0), vec3(vertices_[triangle[2]].position, 0),
+                                  barycentric, distance) && distance < hit.distance)
+            {
+                found = true;
+                hit.triangle = cluster.rigid_triangles[i] / 3;
+                hit.joint = cluster.joint;
+                hit.distance = distance;
+                hit.barycentric = barycentric;
+            }
+        }
+
+        for (size_t i = 0; i < cluster.skinned_triangles.size(); ++i)
+        {
+            const GLuint* triangle = &indices_[cluster.skinned_triangles[i]];
+            vec2 barycentric;
+            float distance;
+            if (intersectTriangle(origin, direction, skinVertex(triangle[0], palette),
+                                  skinVertex(triangle[1], palette), skinVertex(triangle[2], palette),
+                                  barycentric, distance) && distance < hit.distance)
+            {
+                found = true;
+                hit.triangle = cluster.skinned_triangles[i] / 3;
+                hit.joint = cluster.joint;
+                hit.distance = distance;
+                hit.barycentric = barycentric;
+            }
+        }
+
+        hit.tested_triangles += cluster.rigid_triangles.size() + cluster.skinned_triangles.size();
+    }
+
+    return found;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of clusters, which is the number of joints
+///         with the most weight in at least one triangle.
+size_t SkinnedMeshPicker::getClusterCount() const
+{
+    return clusters_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins a vertex's position on the CPU, as the shaders do.
+vec3 SkinnedMeshPicker::skinVertex(GLuint vertex, const mat4* palette) const
+{
+    const Vertex& v = vertices_[vertex];
+    vec4 position(v.position, 0, 1);
+    vec4 skinned(0);
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        if (v.joint_weights[i] != 0.0f)
+            skinned += v.joint_weights[i] * transformVector(palette[v.joint_indices[i]], position);
+    }
+    return vec3(skinned);
+}
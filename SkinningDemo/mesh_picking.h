@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_picking.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the SkinnedMeshPicker class, and the PickHit
+///         struct it returns.
+
+#ifndef MESH_PICKING_H_
+#define MESH_PICKING_H_
+
+#include "joint_bounds.h"
+#include "skeletal_mesh.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Where a ray hit a skinned mesh.
+struct PickHit
+{
+    size_t triangle;            ///< The triangle hit: its first index is 3 * triangle.
+    size_t joint;               ///< The joint whose cluster the triangle is in.
+    float distance;             ///< How far along the ray, in lengths of its direction.
+    vec2 barycentric;           ///< The weights of the triangle's second and third vertices at the hit.
+    size_t tested_triangles;    ///< The number of triangles the query had to test.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Hit-tests rays against a 2D skinned mesh in any pose, without
+///         skinning the whole mesh.
+///
+/// \details The triangles are split into one cluster per joint, by the
+///         joint with the most weight over their three vertices.  For each
+///         joint which influences any of a cluster's vertices, the cluster
+///         keeps the bind-pose box of those vertices; like
+///         computeSkinnedBounds(), the union of those boxes transformed by
+///         their joints' palette entries is sure to contain the cluster in
+///         any pose.  A ray only has to test the triangles of the clusters
+///         whose boxes it passes through.
+///
+///         Triangles whose vertices all follow the cluster's joint alone
+///         move rigidly with it, so they're tested where they are in the
+///         bind pose, against the ray carried into the joint's bind space
+///         by the inverse of its palette entry.  Only the rest are skinned,
+///         three vertices at a time, to be tested where they are.
+///
+///         The mesh lies in the z = 0 plane, so a ray can only meet it
+///         where it crosses that plane; rays parallel to it never hit.
+///         Both faces of the triangles are hit.
+class SkinnedMeshPicker
+{
+public:
+    SkinnedMeshPicker(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, size_t joint_count);
+
+    bool pick(const vec3& origin, const vec3& direction, const mat4* palette, PickHit& hit) const;
+
+    size_t getClusterCount() const;
+
+private:
+    SkinnedMeshPicker(const SkinnedMeshPicker&);             // non-copyable
+    SkinnedMeshPicker& operator=(const SkinnedMeshPicker&);  // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The bind-pose box of a cluster's vertices influenced by a
+    ///         joint.
+    struct JointBox
+    {
+        size_t joint;
+        BoundingBox box;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The triangles whose vertices a joint has the most weight in.
+    struct Cluster
+    {
+        size_t joint;
+        std::vector<JointBox> boxes;
+        std::vector<GLuint> rigid_triangles;    ///< Only influenced by joint.
+        std::vector<GLuint> skinned_triangles;  ///< The rest.
+    };
+
+    vec3 skinVertex(GLuint vertex, const mat4* palette) const;
+
+    std::vector<Vertex> vertices_;
+    std::vector<GLuint> indices_;
+    std::vector<Cluster> clusters_;     ///< Only the joints with triangles.
+};
+
+#endif
@@ -0,0 +1,260 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_split.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the joint remapping and mesh splitting
+///         functions.
+
+#include "mesh_split.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+const GLuint NO_INDEX = GLuint(-1);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the highest joint index of any of the vertices'
+///         influences.
+GLuint getMaxJoint(const std::vector<Vertex>& vertices)
+{
+    GLuint max_joint = 0;
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+            max_joint = std::max(max_joint, vertices[v].joint_indices[i]);
+    }
+    return max_joint;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects the distinct joints with nonzero weight in a triangle.
+///
+/// \return The number of joints written to joints, at most
+///         3 * MAX_JOINT_INFLUENCES.
+size_t getTriangleJoints(const std::vector<Vertex>& vertices, const GLuint* triangle, GLuint* joints)
+{
+    size_t count = 0;
+    for (size_t corner = 0; corner < 3; ++corner)
+    {
+        const Vertex& vertex = vertices[triangle[corner]];
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            if (vertex.joint_weights[i] == 0.0f)
+                continue;
+
+            size_t j = 0;
+            while (j < count && joints[j] != vertex.joint_indices[i])
+                ++j;
+            if (j == count)
+                joints[count++] = vertex.joint_indices[i];
+        }
+    }
+
+    return count;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Renumbers the joints which influence a mesh as slots of a
+///         palette of its own, without splitting it.
+///
+/// \details A mesh skinned by a large skeleton is often only influenced by
+///         some of its joints; once they're renumbered from 0, its joint
+///         indices can fit in the bytes of the packed vertex formats (see
+///         MAX_PACKED_PALETTE_JOINTS), and the palette it's drawn with only
+///         needs those joints.  The slots are in the same order as the
+///         joints, so parents still come before their children.  Unlike
+///         splitMeshByJoints(), every vertex is kept, in the same order, and
+///         the indices are unchanged, so the mesh stays optimized for the
+///         vertex cache.
+///
+/// \param  vertices The vertices of the mesh.
+/// \param  indices The indices of the mesh's triangles.
+/// \param  max_joints The most slots the palette may have.
+/// \param  palette Receives the renumbered mesh, if it fits.
+/// \return false if more than max_joints joints influence the mesh, in which
+///         case palette is left unchanged and the mesh needs to be split.
+bool remapJointsToPalette(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                          size_t max_joints, PaletteSubMesh& palette)
+{
+    std::vector<GLuint> joint_slots(size_t(getMaxJoint(vertices)) + 1, NO_INDEX);
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            if (vertices[v].joint_weights[i] != 0.0f)
+                joint_slots[vertices[v].joint_indices[i]] = 0;
+        }
+    }
+
+    std::vector<GLuint> source_joints;
+    for (size_t j = 0; j < joint_slots.size(); ++j)
+    {
+        if (joint_slots[j] == NO_INDEX)
+            continue;
+
+        if (source_joints.size() == max_joints)
+            return false;
+
+        joint_slots[j] = GLuint(source_joints.size());
+        source_joints.push_back(GLuint(j));
+    }
+
+    // a mesh with no weight at all still needs a slot 0 for its vertices to
+    // point at.
+    if (source_joints.empty())
+        source_joints.push_back(0);
+
+    palette.source_joints.swap(source_joints);
+    palette.vertices = vertices;
+    palette.indices = indices;
+    for (size_t v = 0; v < palette.vertices.size(); ++v)
+    {
+        Vertex& vertex = palette.vertices[v];
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            if (vertex.joint_weights[i] == 0.0f)
+                vertex.joint_indices[i] = 0;
+            else
+                vertex.joint_indices[i] = joint_slots[vertex.joint_indices[i]];
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Splits a mesh's triangles into sub-meshes which are each
+///         influenced by at most max_joints joints.
+///
+/// \details Sub-meshes are filled one at a time, in a single pass over the
+///         triangles which haven't been placed yet, in their order in the
+///         mesh: each triangle whose joints still fit goes in, and the rest
+///         wait for the next sub-mesh.  The joints a sub-mesh collects only
+///         grow, so a triangle which didn't fit never would have later in
+///         the pass.  Neighbouring triangles are usually listed together
+///         and influenced by the same joints, so this mostly cuts a mesh
+///         along joint boundaries; it doesn't look for the fewest
+///         sub-meshes.
+///
+///         If the whole mesh fits, it isn't split at all: the one sub-mesh
+///         comes from remapJointsToPalette(), with every vertex kept in its
+///         order.
+///
+///         Every triangle must fit on its own; if one is influenced by more
+///         than max_joints joints, the problem is reported to stderr and an
+///         exception is thrown.  Once the mesh is split, vertices which no
+///         triangle uses are dropped.
+///
+/// \param  vertices The vertices of the mesh.
+/// \param  indices The indices of the mesh's triangles.
+/// \param  max_joints The most joints any sub-mesh may be influenced by.
+/// \param  sub_meshes Receives the sub-meshes; anything in it already is
+///         discarded.
+void splitMeshByJoints(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                       size_t max_joints, std::vector<PaletteSubMesh>& sub_meshes)
+{
+    sub_meshes.clear();
+
+    PaletteSubMesh whole_mesh;
+    if (remapJointsToPalette(vertices, indices, max_joints, whole_mesh))
+    {
+        sub_meshes.push_back(PaletteSubMesh());
+        std::swap(sub_meshes.back().source_joints, whole_mesh.source_joints);
+        std::swap(sub_meshes.back().vertices, whole_mesh.vertices);
+        std::swap(sub_meshes.back().indices, whole_mesh.indices);
+        return;
+    }
+
+    // the slot each joint has in the sub-mesh being filled, and the index of
+    // each vertex in it; reset after each sub-mesh from what it used.
+    std::vector<GLuint> joint_slots(size_t(getMaxJoint(vertices)) + 1, NO_INDEX);
+    std::vector<GLuint> vertex_map(vertices.size(), NO_INDEX);
+    std::vector<GLuint> source_vertices;
+
+    std::vector<GLuint> remaining;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        remaining.push_back(GLuint(t));
+
+    std::vector<GLuint> deferred;
+    while (!remaining.empty())
+    {
+        sub_meshes.push_back(PaletteSubMesh());
+        PaletteSubMesh& sub_mesh = sub_meshes.back();
+        source_vertices.clear();
+        deferred.clear();
+
+        for (size_t r = 0; r < remaining.size(); ++r)
+        {
+            const GLuint* triangle = &indices[remaining[r]];
+            GLuint joints[3 * MAX_JOINT_INFLUENCES];
+            size_t joint_count = getTriangleJoints(vertices, triangle, joints);
+            if (joint_count > max_joints)
+            {
+                std::cerr << "Can't split a mesh into sub-meshes of " << max_joints << " joints!" << std::endl
+                          << "  Triangle " << remaining[r] / 3 << " is influenced by "
+                          << joint_count << " joints." << std::endl;
+                throw std::runtime_error("Can't split a mesh into sub-meshes that small!");
+            }
+
+            size_t new_joints = 0;
+            for (size_t j = 0; j < joint_count; ++j)
+                new_joints += joint_slots[joints[j]] == NO_INDEX ? 1 : 0;
+
+            if (sub_mesh.source_joints.size() + new_joints > max_joints)
+            {
+                deferred.push_back(remaining[r]);
+                continue;
+            }
+
+            for (size_t j = 0; j < joint_count; ++j)
+            {
+                if (joint_slots[joints[j]] != NO_INDEX)
+                    continue;
+
+                joint_slots[joints[j]] = GLuint(sub_mesh.source_joints.size());
+                sub_mesh.source_joints.push_back(joints[j]);
+            }
+
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                GLuint source = triangle[corner];
+                if (vertex_map[source] == NO_INDEX)
+                {
+                    // influences with no weight don't matter, so they're
+                    // pointed at slot 0.
+                    Vertex vertex = vertices[source];
+                    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+                    {
+                        if (vertex.joint_weights[i] == 0.0f)
+                            vertex.joint_indices[i] = 0;
+                        else
+                            vertex.joint_indices[i] = joint_slots[vertex.joint_indices[i]];
+                    }
+
+                    vertex_map[source] = GLuint(sub_mesh.vertices.size());
+                    sub_mesh.vertices.push_back(vertex);
+                    source_vertices.push_back(source);
+                }
+                sub_mesh.indices.push_back(vertex_map[source]);
+            }
+        }
+
+        // a sub-mesh whose vertices have no weight at all still needs a
+        // slot 0 for them to point at.
+        if (sub_mesh.source_joints.empty())
+            sub_mesh.source_joints.push_back(0);
+
+        for (size_t j = 0; j < sub_mesh.source_joints.size(); ++j)
+            joint_slots[sub_mesh.source_joints[j]] = NO_INDEX;
+        for (size_t v = 0; v < source_vertices.size(); ++v)
+            vertex_map[source_vertices[v]] = NO_INDEX;
+
+        remaining.swap(deferred);
+    }
+}
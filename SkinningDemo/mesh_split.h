@@ -0,0 +1,43 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_split.h
+/// \author Ben Crist
+///
+/// \brief  The PaletteSubMesh struct, and the functions which renumber a
+///         mesh's joints, or split it, so that each piece fits a limited
+///         palette.
+
+#ifndef MESH_SPLIT_H_
+#define MESH_SPLIT_H_
+
+#include "skeletal_mesh.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The most palette slots a packed vertex format can address, since
+///         their joint indices are bytes.
+const size_t MAX_PACKED_PALETTE_JOINTS = 256;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A piece of a mesh which is influenced by no more than a fixed
+///         number of joints, renumbered from 0 as slots of its own palette.
+///
+/// \details The vertices' joint_indices are slots, not joints: drawing the
+///         sub-mesh only needs the palette entries of its source_joints, in
+///         order, so a skinning program compiled for that many joints can
+///         draw a mesh whose whole palette wouldn't fit in its uniforms.
+///         Vertices on the seams between sub-meshes are copied into each of
+///         them.
+struct PaletteSubMesh
+{
+    std::vector<GLuint> source_joints;  ///< The skeleton's index of each palette slot.
+    std::vector<Vertex> vertices;       ///< Influenced by palette slots.
+    std::vector<GLuint> indices;
+};
+
+bool remapJointsToPalette(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                          size_t max_joints, PaletteSubMesh& palette);
+void splitMeshByJoints(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                       size_t max_joints, std::vector<PaletteSubMesh>& sub_meshes);
+
+#endif
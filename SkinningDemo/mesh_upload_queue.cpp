@@ -0,0 +1,306 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_upload_queue.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of MeshUploadQueue class functions.
+
+#include "mesh_upload_queue.h"
+#include "vertex_blocks.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a fence has signaled, without waiting for it.
+bool isSignaled(GLsync fence)
+{
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the staging buffer.
+///
+/// \param  region_size The size of each region in bytes; no more than this
+///         is staged per update().
+/// \param  region_count The number of regions, which is how many frames of
+///         copies can be in flight at once.
+MeshUploadQueue::MeshUploadQueue(GLsizeiptr region_size, size_t region_count)
+    : staging_buffer_id_(0),
+      region_size_(region_size),
+      current_region_(0),
+      regions_(region_count),
+      decode_program_id_(0)
+{
+    for (size_t i = 0; i < regions_.size(); ++i)
+    {
+        regions_[i].fence = 0;
+        regions_[i].serial = 0;
+    }
+
+    glGenBuffers(1, &staging_buffer_id_);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging_buffer_id_);
+    glBufferData(GL_COPY_READ_BUFFER, region_size_ * regions_.size(), nullptr, GL_STREAM_COPY);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the staging buffer and any outstanding fences.  Meshes
+///         which were still pending are left with whatever had been copied
+///         into them.
+MeshUploadQueue::~MeshUploadQueue()
+{
+    for (size_t i = 0; i < regions_.size(); ++i)
+    {
+        if (regions_[i].fence != 0)
+            glDeleteSync(regions_[i].fence);
+    }
+
+    for (std::list<Upload>::iterator it = uploads_.begin(); it != uploads_.end(); ++it)
+        glDeleteBuffers(1, &it->blocks_buffer_id);
+    glDeleteBuffers(1, &staging_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the program the meshes queued from now on have their vertex
+///         blocks expanded with.
+///
+/// \param  compute_program_id The vertex decode compute shader program, or
+///         0 to always send the vertices themselves.
+void MeshUploadQueue::setVertexDecodeProgram(GLuint compute_program_id)
+{
+    decode_program_id_ = compute_program_id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sizes a mesh's buffers for some prepared mesh data, and queues
+///         the data to be copied into them.
+///
+/// \details If the mesh is already pending, its earlier upload is dropped;
+///         the copies it has already issued still happen first on the GPU,
+///         so they're overwritten by this one's.
+///
+/// \param  mesh The mesh to upload to.  It must outlive the upload, and
+///         mustn't be drawn while isPending() returns true for it.
+/// \param  data The data to upload, as read by readMeshFile().  It's taken
+///         over by the queue, and left empty.
+void MeshUploadQueue::enqueue(SkeletalMeshBase& mesh, MeshFileData& data)
+{
+    for (std::list<Upload>::iterator it = uploads_.begin(); it != uploads_.end(); )
+    {
+        if (it->mesh == &mesh)
+        {
+            glDeleteBuffers(1, &it->blocks_buffer_id);
+            it = uploads_.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    mesh.position_quantization = data.position_quantization;
+    mesh.reserveData(data.vertex_format, data.vertex_data.data(), data.vertex_count,
+                     data.index_type, data.index_count, data.partitions);
+
+    uploads_.push_back(Upload());
+    Upload& upload = uploads_.back();
+    upload.mesh = &mesh;
+    upload.blocks_buffer_id = 0;
+    upload.vertex_bytes = GLsizeiptr(data.vertex_count * getVertexSize(data.vertex_format));
+    if (decode_program_id_ != 0 && !data.vertex_blocks.empty())
+    {
+        upload.vertex_bytes = GLsizeiptr(data.vertex_blocks.size() * sizeof(GLuint));
+        glGenBuffers(1, &upload.blocks_buffer_id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, upload.blocks_buffer_id);
+        glBufferData(GL_COPY_WRITE_BUFFER, upload.vertex_bytes, nullptr, GL_STREAM_COPY);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    else
+        std::vector<GLuint>().swap(data.vertex_blocks);
+    upload.total_bytes = upload.vertex_bytes + GLsizeiptr(data.index_count * getIndexSize(data.index_type));
+    upload.staged_bytes = 0;
+    upload.region = NO_REGION;
+    upload.region_serial = 0;
+    std::swap(upload.data, data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Retires the uploads whose copies have finished, then stages up
+///         to byte_budget more bytes and issues their copies.  Call once
+///         per frame.
+///
+/// \param  byte_budget The most bytes to stage; capped at the region size.
+void MeshUploadQueue::update(GLsizeiptr byte_budget)
+{
+    retireUploads();
+
+    std::list<Upload>::iterator first = uploads_.begin();
+    while (first != uploads_.end() && first->staged_bytes == first->total_bytes)
+        ++first;
+    if (first == uploads_.end())
+        return;
+
+    // the region's last copies must have finished before it's written again.
+    Region& region = regions_[current_region_];
+    if (region.fence != 0)
+    {
+        if (!isSignaled(region.fence))
+            return;
+
+        glDeleteSync(region.fence);
+        region.fence = 0;
+        ++region.serial;
+    }
+
+    GLsizeiptr budget = std::min(byte_budget, region_size_);
+    GLintptr region_offset = GLintptr(current_region_) * region_size_;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, staging_buffer_id_);
+    char* staging = static_cast<char*>(glMapBufferRange(GL_COPY_READ_BUFFER, region_offset, budget,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+
+    copies_.clear();
+    decodes_.clear();
+    GLsizeiptr staged = 0;
+    for (std::list<Upload>::iterator it = first; it != uploads_.end() && staged < budget; ++it)
+    {
+        Upload& upload = *it;
+        while (upload.staged_bytes < upload.total_bytes && staged < budget)
+        {
+            // the vertices and indices are staged separately, since they go
+            // to different buffers.
+            bool vertices = upload.staged_bytes < upload.vertex_bytes;
+            GLintptr offset = vertices ? upload.staged_bytes : upload.staged_bytes - upload.vertex_bytes;
+            GLsizeiptr left = vertices ? upload.vertex_bytes - offset : upload.total_bytes - upload.staged_bytes;
+            const char* source = upload.data.index_data.data();
+            GLuint buffer_id = upload.mesh->ibo_id;
+            if (vertices && upload.blocks_buffer_id != 0)
+            {
+                source = reinterpret_cast<const char*>(upload.data.vertex_blocks.data());
+                buffer_id = upload.blocks_buffer_id;
+            }
+            else if (vertices)
+            {
+                source = upload.data.vertex_data.data();
+                buffer_id = upload.mesh->vbo_id;
+            }
+
+            Copy copy;
+            copy.buffer_id = buffer_id;
+            copy.staging_offset = region_offset + staged;
+            copy.offset = offset;
+            copy.size = std::min(left, budget - staged);
+            std::memcpy(staging + staged, source + offset, copy.size);
+            copies_.push_back(copy);
+
+            staged += copy.size;
+            upload.staged_bytes += copy.size;
+
+            if (vertices && upload.blocks_buffer_id != 0 && upload.staged_bytes == upload.vertex_bytes)
+            {
+                Decode decode;
+                decode.blocks_buffer_id = upload.blocks_buffer_id;
+                decode.vertex_format = upload.data.vertex_format;
+                decode.vertex_count = upload.data.vertex_count;
+                decode.vbo_id = upload.mesh->vbo_id;
+                decodes_.push_back(decode);
+            }
+        }
+
+        upload.region = current_region_;
+        upload.region_serial = region.serial;
+        if (upload.staged_bytes == upload.total_bytes)
+        {
+            MeshFileData empty = MeshFileData();
+            std::swap(upload.data, empty);
+        }
+    }
+
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    for (size_t i = 0; i < copies_.size(); ++i)
+    {
+        const Copy& copy = copies_[i];
+        glBindBuffer(GL_COPY_WRITE_BUFFER, copy.buffer_id);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copy.staging_offset, copy.offset, copy.size);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    // each mesh's blocks have all been copied by now.
+    for (size_t i = 0; i < decodes_.size(); ++i)
+    {
+        const Decode& decode = decodes_[i];
+        decodeVertexBlocks(decode_program_id_, decode.blocks_buffer_id, decode.vertex_format, decode.vertex_count,
+                           decode.vbo_id, 0);
+    }
+
+    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current_region_ = (current_region_ + 1) % regions_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a mesh was queued and hasn't finished uploading.
+bool MeshUploadQueue::isPending(const SkeletalMeshBase& mesh) const
+{
+    for (std::list<Upload>::const_iterator it = uploads_.begin(); it != uploads_.end(); ++it)
+    {
+        if (it->mesh == &mesh)
+            return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of meshes which haven't finished uploading.
+size_t MeshUploadQueue::getPendingCount() const
+{
+    return uploads_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of bytes which haven't been staged yet.
+GLsizeiptr MeshUploadQueue::getPendingBytes() const
+{
+    GLsizeiptr bytes = 0;
+    for (std::list<Upload>::const_iterator it = uploads_.begin(); it != uploads_.end(); ++it)
+        bytes += it->total_bytes - it->staged_bytes;
+    return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if all of an upload has been staged, and the copies
+///         of its last bytes have finished.
+bool MeshUploadQueue::isFinished(const Upload& upload) const
+{
+    if (upload.staged_bytes != upload.total_bytes)
+        return false;
+    if (upload.region == NO_REGION)
+        return true;
+
+    // once a region has been reused, the fence its uploads were waiting on
+    // is known to have signaled.
+    const Region& region = regions_[upload.region];
+    return region.serial != upload.region_serial || isSignaled(region.fence);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forgets every upload which has finished.
+void MeshUploadQueue::retireUploads()
+{
+    for (std::list<Upload>::iterator it = uploads_.begin(); it != uploads_.end(); )
+    {
+        if (isFinished(*it))
+        {
+            glDeleteBuffers(1, &it->blocks_buffer_id);
+            it = uploads_.erase(it);
+        }
+        else
+            ++it;
+    }
+}
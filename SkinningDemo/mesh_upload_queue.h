@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_upload_queue.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the MeshUploadQueue class.
+
+#ifndef MESH_UPLOAD_QUEUE_H_
+#define MESH_UPLOAD_QUEUE_H_
+
+#include "mesh_file.h"
+#include "skeletal_mesh.h"
+#include <list>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Streams meshes into their buffers a few hundred kilobytes per
+///         frame, so that a large mesh never stalls a frame with one big
+///         glBufferData.
+///
+/// \details The mesh data is read and prepared without a GL context (see
+///         readMeshFile() and SkeletalMesh::prepareMesh()), typically on
+///         another thread, then handed to enqueue(), which sizes the mesh's
+///         buffers with SkeletalMeshBase::reserveData() but doesn't fill
+///         them.  Each frame, update() copies up to a byte budget of the
+///         queued data into the next region of a staging buffer, in the
+///         order the meshes were queued, and has the GPU copy it into the
+///         meshes' VBOs and IBOs with glCopyBufferSubData.  A fence is placed
+///         after each region's copies.  A mesh stays pending until the
+///         fence after its last bytes has signaled, and mustn't be drawn
+///         until then.
+///
+///         The staging buffer works like a UniformRingBuffer: each region is
+///         mapped unsynchronized, and only reused once its fence has
+///         signaled.  If it hasn't yet, update() copies nothing that frame
+///         rather than waiting.  Without persistent mapping, which this GLEW
+///         doesn't have, a mapped pointer can't be handed to a worker
+///         thread, so the copy into the staging buffer is done by update()
+///         on the thread which owns the context.
+///
+///         With a vertex decode program (see setVertexDecodeProgram()), a
+///         mesh whose data has vertex blocks (see encodeVertexBlocks()) is
+///         sent as its blocks instead of its vertices, about half as many
+///         bytes, into a buffer of its own.  Once the last of them has been
+///         copied, a compute shader expands them into the mesh's VBO, before
+///         the region's fence, so the mesh is still pending until they have
+///         been.  Needs GL 4.3.
+class MeshUploadQueue
+{
+public:
+    explicit MeshUploadQueue(GLsizeiptr region_size, size_t region_count = 3);
+    ~MeshUploadQueue();
+
+    void setVertexDecodeProgram(GLuint compute_program_id);
+
+    void enqueue(SkeletalMeshBase& mesh, MeshFileData& data);
+    void update(GLsizeiptr byte_budget);
+
+    bool isPending(const SkeletalMeshBase& mesh) const;
+    size_t getPendingCount() const;
+    GLsizeiptr getPendingBytes() const;
+
+private:
+    static const size_t NO_REGION = size_t(-1);
+
+    MeshUploadQueue(const MeshUploadQueue&);            // non-copyable
+    MeshUploadQueue& operator=(const MeshUploadQueue&); // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A mesh whose data is being copied, or whose last copy hasn't
+    ///         finished on the GPU.
+    struct Upload
+    {
+        SkeletalMeshBase* mesh;
+        MeshFileData data;          ///< Freed once all of it has been staged.
+        GLuint blocks_buffer_id;    ///< Where the vertex blocks are copied, or 0 if the vertices go to the VBO.
+        GLsizeiptr vertex_bytes;    ///< The size of the vertex blocks, if they're sent instead.
+        GLsizeiptr total_bytes;     ///< The vertex bytes, then the index bytes.
+        GLsizeiptr staged_bytes;    ///< How much has been copied into the staging buffer.
+        size_t region;              ///< The region the last bytes were staged in, or NO_REGION.
+        size_t region_serial;       ///< The region's serial when they were.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One region of the staging buffer.
+    struct Region
+    {
+        GLsync fence;       ///< After the copies out of the region, or 0.
+        size_t serial;      ///< Increases each time the region's fence is found signaled.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One copy from the staging buffer, issued after the region has
+    ///         been unmapped.
+    struct Copy
+    {
+        GLuint buffer_id;
+        GLintptr staging_offset;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  An upload's vertex blocks to expand into its VBO, once their
+    ///         copies have been issued.
+    struct Decode
+    {
+        GLuint blocks_buffer_id;
+        VertexFormat vertex_format;
+        size_t vertex_count;
+        GLuint vbo_id;
+    };
+
+    bool isFinished(const Upload& upload) const;
+    void retireUploads();
+
+    GLuint staging_buffer_id_;
+    GLsizeiptr region_size_;
+    size_t current_region_;
+    std::vector<Region> regions_;
+    std::list<Upload> uploads_;     ///< In the order they were queued.
+    std::vector<Copy> copies_;
+    std::vector<Decode> decodes_;
+    GLuint decode_program_id_;      ///< Expands vertex blocks, or 0 to send the vertices themselves.
+};
+
+#endif
@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_variant.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of MeshVariant class functions.
+
+#include "mesh_variant.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the variant's VAO, and points it at the mesh's buffers.
+///
+/// \param  mesh The mesh to share the buffers of.  It must outlive the
+///         variant.
+MeshVariant::MeshVariant(const SkeletalMeshBase& mesh)
+    : mesh_(mesh),
+      vao_id_(0)
+{
+    glGenVertexArrays(1, &vao_id_);
+    update();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the variant's VAO.  The mesh's buffers, and the
+///         attached streams, belong to their owners.
+MeshVariant::~MeshVariant()
+{
+    glDeleteVertexArrays(1, &vao_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Points the VAO at the mesh's current VBO and IBO, with the
+///         mesh's vertex format.  Does nothing if the mesh isn't resident.
+void MeshVariant::update()
+{
+    if (!mesh_.isResident())
+        return;
+
+    glBindVertexArray(vao_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_.vbo_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_.ibo_id);
+    setVertexAttributes(mesh_.vertex_format);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the mesh whose buffers the variant draws.
+const SkeletalMeshBase& MeshVariant::getMesh() const
+{
+    return mesh_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the VAO which draws the mesh's partitions with the
+///         variant's attributes.
+GLuint MeshVariant::getVertexArray() const
+{
+    return vao_id_;
+}
@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  mesh_variant.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the MeshVariant class.
+
+#ifndef MESH_VARIANT_H_
+#define MESH_VARIANT_H_
+
+#include "skeletal_mesh.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A VAO which draws a mesh's own vertex and index buffers, with
+///         whatever other attributes are attached to it, so variants of a
+///         mesh which only differ in those share one copy of its positions,
+///         skinning data and triangles.
+///
+/// \details A variant, an outfit's colors say, costs only its own
+///         attribute streams: the mesh's VBO and IBO aren't copied, and the
+///         variant draws the mesh's partitions with the same programs as
+///         the mesh's own VAO.  The streams are attached to
+///         getVertexArray() by whatever owns them (see
+///         VertexColorCache::attach()), at locations the mesh's vertex
+///         format doesn't use.
+///
+///         update() has to be called again whenever the mesh's buffers are
+///         created again, after a reload or being made resident again, say;
+///         it only points the mesh's own attributes and the indices at them,
+///         so the attached streams are left as they were.
+class MeshVariant
+{
+public:
+    explicit MeshVariant(const SkeletalMeshBase& mesh);
+    ~MeshVariant();
+
+    void update();
+
+    const SkeletalMeshBase& getMesh() const;
+    GLuint getVertexArray() const;
+
+private:
+    MeshVariant(const MeshVariant&);            // non-copyable
+    MeshVariant& operator=(const MeshVariant&); // non-copyable
+
+    const SkeletalMeshBase& mesh_;
+    GLuint vao_id_;
+};
+
+#endif
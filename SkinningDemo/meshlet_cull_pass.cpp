@@ -0,0 +1,229 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  meshlet_cull_pass.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of MeshletCullPass class functions.
+
+#include "meshlet_cull_pass.h"
+
+#include <algorithm>
+#include <cassert>
+
+const GLuint MeshletCullPass::WORKGROUP_SIZE;
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a storage buffer holding a copy of an array, with room
+///         for at least one element, since GL can't bind empty buffers.
+template <typename T>
+GLuint createStorageBuffer(const std::vector<T>& data)
+{
+    GLuint buffer_id = 0;
+    glGenBuffers(1, &buffer_id);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_id);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(data.size(), size_t(1)) * sizeof(T),
+                 data.empty() ? nullptr : data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer_id;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads a mesh's meshlets, and creates the commands and the VAO
+///         their survivors are drawn with.
+///
+/// \param  mesh The uploaded mesh the meshlets were built from, and whose
+///         VBO they're drawn from.
+/// \param  meshlets The mesh's meshlets, as from buildMeshlets().
+/// \param  joint_count The number of matrices in each instance's palette.
+/// \param  max_instances The most instances cull() is given at once.
+MeshletCullPass::MeshletCullPass(const SkeletalMeshBase& mesh, const MeshletMesh& meshlets, size_t joint_count,
+                                 size_t max_instances)
+    : joint_count_(joint_count),
+      max_instances_(max_instances),
+      meshlet_count_(meshlets.meshlets.size()),
+      meshlet_buffer_id_(0),
+      meshlet_vertex_buffer_id_(0),
+      triangle_buffer_id_(0),
+      joint_buffer_id_(0),
+      joint_bounds_buffer_id_(0),
+      palette_buffer_id_(0),
+      command_buffer_id_(0),
+      index_buffer_id_(0),
+      vao_id_(0)
+{
+    std::vector<CullMeshlet> cull_meshlets(meshlet_count_);
+    for (size_t i = 0; i < meshlet_count_; ++i)
+    {
+        const Meshlet& meshlet = meshlets.meshlets[i];
+        CullMeshlet& cull_meshlet = cull_meshlets[i];
+        cull_meshlet.first_vertex = meshlet.first_vertex;
+        cull_meshlet.vertex_count = meshlet.vertex_count;
+        cull_meshlet.first_triangle = meshlet.first_triangle;
+        cull_meshlet.triangle_count = meshlet.triangle_count;
+        cull_meshlet.first_joint = meshlet.first_joint;
+        cull_meshlet.joint_count = meshlet.joint_count;
+        cull_meshlet.partition = meshlet.partition;
+        cull_meshlet.padding = 0;
+        cull_meshlet.cone = vec4(meshlet.cone_axis, meshlet.cone_cutoff);
+    }
+
+    // each triangle's three local indices go in the low bytes of one uint.
+    std::vector<GLuint> triangles(meshlets.triangles.size() / 3);
+    for (size_t t = 0; t < triangles.size(); ++t)
+    {
+        triangles[t] = GLuint(meshlets.triangles[t * 3]) |
+                       GLuint(meshlets.triangles[t * 3 + 1]) << 8 |
+                       GLuint(meshlets.triangles[t * 3 + 2]) << 16;
+    }
+
+    std::vector<vec4> joint_bounds(meshlets.joint_bounds.size());
+    for (size_t i = 0; i < joint_bounds.size(); ++i)
+        joint_bounds[i] = vec4(meshlets.joint_bounds[i].min, meshlets.joint_bounds[i].max);
+
+    meshlet_buffer_id_ = createStorageBuffer(cull_meshlets);
+    meshlet_vertex_buffer_id_ = createStorageBuffer(meshlets.vertices);
+    triangle_buffer_id_ = createStorageBuffer(triangles);
+    joint_buffer_id_ = createStorageBuffer(meshlets.joints);
+    joint_bounds_buffer_id_ = createStorageBuffer(joint_bounds);
+
+    glGenBuffers(1, &palette_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, palette_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(max_instances * joint_count, size_t(1)) * sizeof(mat4),
+                 nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // each instance gets room for the whole mesh, and each of its partitions
+    // the same range of that room it has in the mesh's own indices.
+    size_t index_count = mesh.getIndexCount();
+    const std::vector<SkeletalMeshBase::Partition>& partitions = mesh.getPartitions();
+    for (size_t p = 0; p < partitions.size(); ++p)
+    {
+        for (size_t instance = 0; instance < max_instances; ++instance)
+        {
+            RenderQueue::DrawElementsIndirectCommand command;
+            command.count = 0;
+            command.instance_count = 1;
+            command.first_index = GLuint(instance * index_count + partitions[p].first_index);
+            command.base_vertex = 0;
+            command.base_instance = GLuint(instance);
+            commands_.push_back(command);
+        }
+    }
+    glGenBuffers(1, &command_buffer_id_);
+
+    glGenVertexArrays(1, &vao_id_);
+    glGenBuffers(1, &index_buffer_id_);
+
+    glBindVertexArray(vao_id_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_id_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, std::max(max_instances * index_count, size_t(1)) * sizeof(GLuint),
+                 nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo_id);
+    setVertexAttributes(mesh.vertex_format);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the pass's buffers and VAO.
+MeshletCullPass::~MeshletCullPass()
+{
+    glDeleteVertexArrays(1, &vao_id_);
+    glDeleteBuffers(1, &meshlet_buffer_id_);
+    glDeleteBuffers(1, &meshlet_vertex_buffer_id_);
+    glDeleteBuffers(1, &triangle_buffer_id_);
+    glDeleteBuffers(1, &joint_buffer_id_);
+    glDeleteBuffers(1, &joint_bounds_buffer_id_);
+    glDeleteBuffers(1, &palette_buffer_id_);
+    glDeleteBuffers(1, &command_buffer_id_);
+    glDeleteBuffers(1, &index_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Culls every meshlet of every instance in this frame's poses,
+///         leaving the survivors' triangles and counts for draw().
+///
+/// \details The commands' counts are reset in fresh storage first, so this
+///         frame's culling doesn't wait for last frame's draws.  The draws
+///         wait for the culling with a command and element array barrier.
+///
+/// \param  compute_program_id The meshlet culling compute shader program.
+/// \param  palettes Each instance's skinning palette, one after another.
+/// \param  instance_count The number of instances; at most max_instances.
+/// \param  cull_back_faces Whether to cull meshlets which face entirely
+///         away; see isMeshletVisible().
+void MeshletCullPass::cull(GLuint compute_program_id, const mat4* palettes, size_t instance_count,
+                           bool cull_back_faces)
+{
+    assert(instance_count <= max_instances_);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, command_buffer_id_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands_.size() * sizeof(RenderQueue::DrawElementsIndirectCommand),
+                 commands_.data(), GL_STREAM_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, palette_buffer_id_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instance_count * joint_count_ * sizeof(mat4), palettes);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (instance_count == 0 || meshlet_count_ == 0)
+        return;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshlet_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, meshlet_vertex_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, triangle_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, joint_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, joint_bounds_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, palette_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, command_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, index_buffer_id_);
+
+    glUseProgram(compute_program_id);
+    glUniform1ui(glGetUniformLocation(compute_program_id, "meshlet_count"), GLuint(meshlet_count_));
+    glUniform1ui(glGetUniformLocation(compute_program_id, "joint_count"), GLuint(joint_count_));
+    glUniform1ui(glGetUniformLocation(compute_program_id, "max_instances"), GLuint(max_instances_));
+    glUniform1i(glGetUniformLocation(compute_program_id, "cull_back_faces"), cull_back_faces ? 1 : 0);
+    glDispatchCompute(GLuint((meshlet_count_ + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), GLuint(instance_count), 1);
+    glUseProgram(0);
+
+    // the draws read the counts as commands, and the survivors as indices.
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws one partition's surviving meshlets for the first
+///         instance_count instances of the last cull(), with a single
+///         glMultiDrawElementsIndirect.
+///
+/// \details The program for the partition must be bound.  Leaves the pass's
+///         VAO and command buffer bound.
+///
+/// \param  partition The partition of the mesh.
+/// \param  instance_count The number of instances to draw; at most the
+///         number last culled.
+void MeshletCullPass::draw(size_t partition, size_t instance_count) const
+{
+    assert((partition + 1) * max_instances_ <= commands_.size());
+    assert(instance_count <= max_instances_);
+    if (instance_count == 0)
+        return;
+
+    glBindVertexArray(vao_id_);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_id_);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                reinterpret_cast<void*>(partition * max_instances_ *
+                                                        sizeof(RenderQueue::DrawElementsIndirectCommand)),
+                                GLsizei(instance_count), 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of meshlets culled per instance.
+size_t MeshletCullPass::getMeshletCount() const
+{
+    return meshlet_count_;
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  meshlet_cull_pass.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the MeshletCullPass class.
+
+#ifndef MESHLET_CULL_PASS_H_
+#define MESHLET_CULL_PASS_H_
+
+#include "mesh_meshlets.h"
+#include "render_queue.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Culls a mesh's meshlets on the GPU with a compute shader, for
+///         each of several posed instances, and draws the survivors with one
+///         glMultiDrawElementsIndirect per partition.
+///
+/// \details One invocation per meshlet and instance bounds the meshlet by
+///         moving each of its joints' bounds with the instance's palette
+///         matrix, tests that against the viewport, and optionally tests
+///         its normal cone for facing away, exactly as isMeshletVisible()
+///         does.  A survivor reserves room for its triangles in the index
+///         range of its partition's command for its instance, and writes
+///         them there as indices of the mesh's VBO.  Culled meshlets' vertices
+///         are never run through the skinning vertex shader at all.
+///
+///         The commands are laid out by partition, then instance, with each
+///         command's base instance set to its instance, so an instanced
+///         attribute with a divisor of 1 (like the palette index of
+///         RenderQueue) can give each instance's draw its palette.  With a
+///         single instance, the non-instanced skinning programs draw it as
+///         they would draw the mesh.
+///
+///         The pass draws from its own VAO, over the mesh's VBO, so it must
+///         be recreated if the mesh is uploaded again.  Needs GL 4.3.
+class MeshletCullPass
+{
+public:
+    static const GLuint WORKGROUP_SIZE = 64;    ///< Must match the compute shader's local_size_x.
+
+    MeshletCullPass(const SkeletalMeshBase& mesh, const MeshletMesh& meshlets, size_t joint_count,
+                    size_t max_instances);
+    ~MeshletCullPass();
+
+    void cull(GLuint compute_program_id, const mat4* palettes, size_t instance_count, bool cull_back_faces);
+    void draw(size_t partition, size_t instance_count) const;
+
+    size_t getMeshletCount() const;
+
+private:
+    MeshletCullPass(const MeshletCullPass&);              // non-copyable
+    MeshletCullPass& operator=(const MeshletCullPass&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One meshlet, laid out like the compute shader's CullMeshlet.
+    struct CullMeshlet
+    {
+        GLuint first_vertex;
+        GLuint vertex_count;
+        GLuint first_triangle;
+        GLuint triangle_count;
+        GLuint first_joint;
+        GLuint joint_count;
+        GLuint partition;   ///< mesh_partition in the shader, since partition is reserved in GLSL.
+        GLuint padding;
+        vec4 cone;      ///< The cone's axis, and its cutoff in w.
+    };
+
+    size_t joint_count_;
+    size_t max_instances_;
+    size_t meshlet_count_;
+    std::vector<RenderQueue::DrawElementsIndirectCommand> commands_;    ///< With counts of 0.
+
+    GLuint meshlet_buffer_id_;
+    GLuint meshlet_vertex_buffer_id_;
+    GLuint triangle_buffer_id_;
+    GLuint joint_buffer_id_;
+    GLuint joint_bounds_buffer_id_;
+    GLuint palette_buffer_id_;
+    GLuint command_buffer_id_;
+    GLuint index_buffer_id_;    ///< The survivors' triangles; room for every triangle of every instance.
+    GLuint vao_id_;
+};
+
+#endif
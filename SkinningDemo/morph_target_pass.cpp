@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  morph_target_pass.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of MorphTargetPass class functions.
+
+#include "morph_target_pass.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+const GLuint MorphTargetPass::MORPH_OFFSET_ATTRIBUTE;
+const GLuint MorphTargetPass::WORKGROUP_SIZE;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the offset buffer for a mesh's morph targets, with every
+///         offset zero.
+///
+/// \param  mesh The mesh whose morph targets to apply.  It must already have
+///         been uploaded, with all of its targets added, and must outlive
+///         the pass.
+/// \param  vertex_capacity The number of vertices the offset buffer holds.
+/// \param  first_vertex Where the mesh's first vertex is in the buffer.
+MorphTargetPass::MorphTargetPass(const SkeletalMesh& mesh, size_t vertex_capacity, size_t first_vertex)
+    : mesh_(mesh),
+      first_vertex_(first_vertex),
+      offset_buffer_id_(0),
+      active_buffer_id_(0),
+      active_capacity_(std::max(mesh.getMorphTargetCount(), size_t(1))),
+      active_delta_count_(0)
+{
+    if (first_vertex + mesh.getVertexCount() > vertex_capacity)
+    {
+        std::cerr << "A mesh of " << mesh.getVertexCount() << " vertices at vertex " << first_vertex
+                  << " doesn't fit in a MorphTargetPass of " << vertex_capacity << "." << std::endl;
+        throw std::runtime_error("The mesh doesn't fit in the MorphTargetPass.");
+    }
+
+    std::vector<GLint> zeros(vertex_capacity * 2, 0);
+    glGenBuffers(1, &offset_buffer_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, offset_buffer_id_);
+    glBufferData(GL_ARRAY_BUFFER, zeros.size() * sizeof(GLint), zeros.data(), GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &active_buffer_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, active_buffer_id_);
+    glBufferData(GL_ARRAY_BUFFER, active_capacity_ * sizeof(ActiveTarget), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the pass's buffers.
+MorphTargetPass::~MorphTargetPass()
+{
+    glDeleteBuffers(1, &offset_buffer_id_);
+    glDeleteBuffers(1, &active_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds the offsets to a VAO at MORPH_OFFSET_ATTRIBUTE.
+///
+/// \param  vao_id The VAO to add them to.
+/// \param  first_vertex The vertex of the offset buffer which the VAO's
+///         vertex 0 corresponds to.
+void MorphTargetPass::attach(GLuint vao_id, size_t first_vertex) const
+{
+    glBindVertexArray(vao_id);
+    glBindBuffer(GL_ARRAY_BUFFER, offset_buffer_id_);
+    glVertexAttribIPointer(MORPH_OFFSET_ATTRIBUTE, 2, GL_INT, 2 * sizeof(GLint),
+                           reinterpret_cast<void*>(first_vertex * 2 * sizeof(GLint)));
+    glEnableVertexAttribArray(MORPH_OFFSET_ATTRIBUTE);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Recomputes the offsets for a new set of weights.
+///
+/// \param  compute_program_id The morph target compute shader program.
+/// \param  weights The weight of each of the mesh's morph targets.
+void MorphTargetPass::apply(GLuint compute_program_id, const float* weights)
+{
+    dense_.clear();
+    for (size_t i = 0; i < mesh_.getMorphTargetCount(); ++i)
+    {
+        if (weights[i] == 0)
+            continue;
+
+        MorphActivation activation;
+        activation.target = i;
+        activation.weight = weights[i];
+        dense_.push_back(activation);
+    }
+    apply(compute_program_id, dense_.data(), dense_.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Recomputes the offsets for a sparse list of active targets.
+///
+/// \details Targets listed more than once have each weight applied, so
+///         their weights add up.  Targets with a weight of zero, and any
+///         which aren't the mesh's, are skipped.
+///
+/// \param  compute_program_id The morph target compute shader program.
+/// \param  activations The targets to apply, and their weights.
+/// \param  activation_count The number of activations; every target which
+///         isn't listed is left out.
+void MorphTargetPass::apply(GLuint compute_program_id, const MorphActivation* activations, size_t activation_count)
+{
+    bool unchanged = activation_count == activations_.size();
+    for (size_t i = 0; i < activation_count && unchanged; ++i)
+        unchanged = activations[i].target == activations_[i].target && activations[i].weight == activations_[i].weight;
+    if (unchanged)
+        return;
+    activations_.assign(activations, activations + activation_count);
+
+    const std::vector<SkeletalMesh::MorphTarget>& targets = mesh_.getMorphTargets();
+    active_targets_.clear();
+    active_delta_count_ = 0;
+    for (size_t i = 0; i < activation_count; ++i)
+    {
+        size_t target = activations[i].target;
+        if (activations[i].weight == 0 || target >= targets.size() || targets[target].delta_count == 0)
+            continue;
+
+        ActiveTarget active;
+        active.first_delta = GLuint(targets[target].first_delta);
+        active.delta_count = GLuint(targets[target].delta_count);
+        active.work_start = GLuint(active_delta_count_);
+        active.weight = activations[i].weight;
+        active_targets_.push_back(active);
+        active_delta_count_ += targets[target].delta_count;
+    }
+
+    // start from the bind pose, then add on each active delta.
+    glBindBuffer(GL_ARRAY_BUFFER, offset_buffer_id_);
+    glClearBufferSubData(GL_ARRAY_BUFFER, GL_RG32I, first_vertex_ * 2 * sizeof(GLint),
+                         mesh_.getVertexCount() * 2 * sizeof(GLint), GL_RG_INTEGER, GL_INT, nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (active_delta_count_ > 0)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, active_buffer_id_);
+        if (active_targets_.size() > active_capacity_)
+        {
+            active_capacity_ = active_targets_.size();
+            glBufferData(GL_SHADER_STORAGE_BUFFER, active_capacity_ * sizeof(ActiveTarget), nullptr, GL_STREAM_DRAW);
+        }
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, active_targets_.size() * sizeof(ActiveTarget), active_targets_.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mesh_.morph_buffer_id);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, active_buffer_id_);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, offset_buffer_id_);
+
+        GLuint work_count = GLuint(active_delta_count_);
+        glUseProgram(compute_program_id);
+        glUniform1ui(glGetUniformLocation(compute_program_id, "active_count"), GLuint(active_targets_.size()));
+        glUniform1ui(glGetUniformLocation(compute_program_id, "work_count"), work_count);
+        glUniform1ui(glGetUniformLocation(compute_program_id, "first_vertex"), GLuint(first_vertex_));
+        glDispatchCompute((work_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        glUseProgram(0);
+    }
+
+    // the offsets are read as a vertex attribute by the skinning shaders.
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of targets the last apply() found active.
+size_t MorphTargetPass::getActiveTargetCount() const
+{
+    return active_targets_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of deltas the last apply() added up.
+size_t MorphTargetPass::getActiveDeltaCount() const
+{
+    return active_delta_count_;
+}
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  morph_target_pass.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the MorphTargetPass class.
+
+#ifndef MORPH_TARGET_PASS_H_
+#define MORPH_TARGET_PASS_H_
+
+#include "pose_space_correctives.h"
+#include "skeletal_mesh.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Applies a mesh's weighted morph targets with a compute shader,
+///         before the mesh is skinned.
+///
+/// \details The result is an offset for each vertex, which the skinning
+///         shaders compiled with MORPH_TARGETS add to the vertex's bind-pose
+///         position, read from MORPH_OFFSET_ATTRIBUTE.  The offsets are
+///         16.16 fixed point ints, so that every delta can be added to its
+///         vertex with an atomicAdd(), whatever order they run in, and the
+///         sums come out exactly the same every time.
+///
+///         apply() only looks at the targets with non-zero weights, which
+///         can be given as a sparse list, such as PoseSpaceCorrectives
+///         activates, rather than a weight for every target.  Their
+///         delta ranges are batched into one list, uploaded along with the
+///         weights, and one dispatch then handles each active delta of
+///         every active target, so the cost depends on how many vertices
+///         the active targets move rather than on the size of the mesh or
+///         the number of targets.  If the active targets and weights
+///         haven't changed since the last call, nothing is done at all.
+///
+///         The offsets can be placed anywhere in a larger buffer, so that
+///         they can line up with a MeshArena's vertices, like a
+///         VertexColorCache's.  The vertices outside the mesh's range are
+///         never moved.  Needs GL 4.3.
+class MorphTargetPass
+{
+public:
+    static const GLuint MORPH_OFFSET_ATTRIBUTE = 5;     ///< The attribute location of the ivec2 offsets.
+    static const GLuint WORKGROUP_SIZE = 64;            ///< Must match the compute shader's local_size_x.
+
+    MorphTargetPass(const SkeletalMesh& mesh, size_t vertex_capacity, size_t first_vertex);
+    ~MorphTargetPass();
+
+    void attach(GLuint vao_id, size_t first_vertex) const;
+
+    void apply(GLuint compute_program_id, const float* weights);
+    void apply(GLuint compute_program_id, const MorphActivation* activations, size_t activation_count);
+
+    size_t getActiveTargetCount() const;
+    size_t getActiveDeltaCount() const;
+
+private:
+    MorphTargetPass(const MorphTargetPass&);            // non-copyable
+    MorphTargetPass& operator=(const MorphTargetPass&); // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A target with a non-zero weight, in the std430 layout the
+    ///         compute shader reads.
+    struct ActiveTarget
+    {
+        GLuint first_delta;     ///< The target's first delta in the mesh's morph_buffer_id.
+        GLuint delta_count;
+        GLuint work_start;      ///< The invocation which handles the target's first delta.
+        GLfloat weight;
+    };
+
+    const SkeletalMesh& mesh_;
+    size_t first_vertex_;
+    GLuint offset_buffer_id_;
+    GLuint active_buffer_id_;
+    std::vector<ActiveTarget> active_targets_;
+    size_t active_capacity_;        ///< The number of ActiveTargets active_buffer_id_ holds.
+    size_t active_delta_count_;
+    std::vector<MorphActivation> activations_;  ///< The targets and weights last applied.
+    std::vector<MorphActivation> dense_;        ///< Scratch space for the non-zero weights of a dense apply().
+};
+
+#endif
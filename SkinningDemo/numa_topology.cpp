@@ -0,0 +1,275 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  numa_topology.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of NumaTopology class functions.
+
+#include "numa_topology.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+/// mbind()'s policy for memory which should come from one node, but may
+/// come from another rather than failing; numaif.h isn't always installed.
+const int MPOL_PREFERRED_NODE = 1;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a list of numbers like "0-3,8,10-11", as sysfs writes
+///         sets of CPUs and nodes, into the numbers it contains.
+///
+/// \return false if the file couldn't be read.
+bool readNumberList(const std::string& path, std::vector<unsigned>& numbers)
+{
+    std::ifstream file(path.c_str());
+    std::string list;
+    if (!file || !std::getline(file, list))
+        return false;
+
+    std::istringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty())
+            continue;
+
+        size_t dash = range.find('-');
+        unsigned first = unsigned(std::strtoul(range.c_str(), nullptr, 10));
+        unsigned last = dash == std::string::npos ? first : unsigned(std::strtoul(range.c_str() + dash + 1, nullptr, 10));
+        for (unsigned number = first; number <= last; ++number)
+            numbers.push_back(number);
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+const size_t NumaTopology::ANY_NODE;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the machine's NUMA nodes, or takes it to be a single node
+///         if it can't.
+NumaTopology::NumaTopology()
+{
+#ifdef _WIN32
+    ULONG highest_node = 0;
+    if (GetNumaHighestNodeNumber(&highest_node))
+    {
+        for (ULONG node = 0; node <= highest_node; ++node)
+        {
+            ULONGLONG mask = 0;
+            if (!GetNumaNodeProcessorMask(UCHAR(node), &mask) || mask == 0)
+                continue;
+
+            std::vector<unsigned> cpus;
+            for (unsigned cpu = 0; cpu < 64; ++cpu)
+            {
+                if (mask & (ULONGLONG(1) << cpu))
+                    cpus.push_back(cpu);
+            }
+            node_cpus_.push_back(cpus);
+            node_ids_.push_back(unsigned(node));
+        }
+    }
+#elif defined(__linux__)
+    std::vector<unsigned> nodes;
+    if (readNumberList("/sys/devices/system/node/online", nodes))
+    {
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            std::ostringstream path;
+            path << "/sys/devices/system/node/node" << nodes[i] << "/cpulist";
+
+            // nodes with memory and no CPUs have nothing to run work on.
+            std::vector<unsigned> cpus;
+            if (!readNumberList(path.str(), cpus) || cpus.empty())
+                continue;
+
+            node_cpus_.push_back(cpus);
+            node_ids_.push_back(nodes[i]);
+        }
+    }
+#endif
+
+    // a single node is no different from not knowing the topology, and is
+    // left alone the same way.
+    if (node_cpus_.size() <= 1)
+    {
+        node_cpus_.assign(1, std::vector<unsigned>());
+        node_ids_.assign(1, 0);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of nodes; always at least 1.
+size_t NumaTopology::getNodeCount() const
+{
+    return node_cpus_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the CPUs belonging to a node, as the operating system
+///         numbers them.  A machine taken to be one node has none listed.
+const std::vector<unsigned>& NumaTopology::getNodeCpus(size_t node) const
+{
+    assert(node < node_cpus_.size());
+    return node_cpus_[node];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the node an item is on, when a number of items are split
+///         into one contiguous partition per node.
+///
+/// \param  item The item's index.
+/// \param  item_count The number of items being split up.
+size_t NumaTopology::getPartitionNode(size_t item, size_t item_count) const
+{
+    assert(item < item_count);
+    return item * node_cpus_.size() / item_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the first item on a node, when a number of items are
+///         split into one contiguous partition per node.
+///
+/// \param  node The node, or getNodeCount() for the end of the last
+///         partition.
+/// \param  item_count The number of items being split up.
+size_t NumaTopology::getPartitionStart(size_t node, size_t item_count) const
+{
+    assert(node <= node_cpus_.size());
+    size_t node_count = node_cpus_.size();
+    return (node * item_count + node_count - 1) / node_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Keeps the calling thread on a node's CPUs from now on, so the
+///         memory on that node stays close to it.  It may still move
+///         between the node's CPUs.
+///
+/// \return false if the thread couldn't be pinned, or the machine is taken
+///         to be one node, and there's nowhere else for it to go anyway.
+bool NumaTopology::pinCurrentThread(size_t node) const
+{
+    assert(node < node_cpus_.size());
+    const std::vector<unsigned>& cpus = node_cpus_[node];
+    if (cpus.empty())
+        return false;
+
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        if (cpus[i] < sizeof(DWORD_PTR) * 8)
+            mask |= DWORD_PTR(1) << cpus[i];
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        if (cpus[i] < CPU_SETSIZE)
+            CPU_SET(cpus[i], &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates memory which should be on a node, whichever thread
+///         first touches it.
+///
+/// \details The memory comes in whole pages, straight from the operating
+///         system, so this is for big blocks like pose pool chunks and
+///         palettes, not individual objects.  If the node's memory is full
+///         it comes from another node rather than failing.  A machine taken
+///         to be one node uses the usual allocator.
+///
+/// \param  bytes The size of the block; may be 0, for which null is
+///         returned.
+/// \param  node The node to put it on, or ANY_NODE.
+/// \return The block, aligned to at least 16 bytes; release it with
+///         release(), passing the same size.
+void* NumaTopology::allocate(size_t bytes, size_t node) const
+{
+    if (bytes == 0)
+        return nullptr;
+
+    if (node_cpus_[0].empty())
+        return ::operator new(bytes);
+
+    assert(node == ANY_NODE || node < node_ids_.size());
+
+#ifdef _WIN32
+    void* memory = node == ANY_NODE ? VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)
+                                    : VirtualAllocExNuma(GetCurrentProcess(), NULL, bytes, MEM_RESERVE | MEM_COMMIT,
+                                                         PAGE_READWRITE, DWORD(node_ids_[node]));
+    if (memory == NULL)
+        throw std::bad_alloc();
+
+    return memory;
+#elif defined(__linux__)
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        throw std::bad_alloc();
+
+    // a node the mask can't hold just gets the default policy.
+    unsigned long mask = 0;
+    if (node != ANY_NODE && node_ids_[node] < sizeof(mask) * 8)
+    {
+        mask = 1ul << node_ids_[node];
+        syscall(SYS_mbind, memory, bytes, MPOL_PREFERRED_NODE, &mask, sizeof(mask) * 8, 0);
+    }
+    return memory;
+#else
+    return ::operator new(bytes);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees a block from allocate().
+///
+/// \param  memory The block, or null.
+/// \param  bytes The size it was allocated with.
+void NumaTopology::release(void* memory, size_t bytes) const
+{
+    if (memory == nullptr)
+        return;
+
+    if (node_cpus_[0].empty())
+    {
+        ::operator delete(memory);
+        return;
+    }
+
+#ifdef _WIN32
+    (void)bytes;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(memory, bytes);
+#else
+    (void)bytes;
+    ::operator delete(memory);
+#endif
+}
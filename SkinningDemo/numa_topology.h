@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  numa_topology.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the NumaTopology class, and the
+///         NumaPartitionedArray class template.
+
+#ifndef NUMA_TOPOLOGY_H_
+#define NUMA_TOPOLOGY_H_
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The NUMA nodes of the machine: which CPUs belong to each, and
+///         how to put threads and memory on one.
+///
+/// \details On a multi-socket machine each socket has its own memory, and
+///         reaching another socket's memory costs a trip over the link
+///         between them, so work which reads and writes a lot of memory
+///         goes fastest when it runs on the same node that memory is on.
+///         Nodes are numbered from 0 here, whatever the operating system
+///         calls them.
+///
+///         The nodes are found from Windows' NUMA functions, or from
+///         /sys/devices/system/node on Linux.  Anywhere else, or if they
+///         can't be found, the machine is taken to be one node, whose
+///         threads are never pinned and whose memory comes from the usual
+///         allocator, which is exactly what happens without a topology at
+///         all.
+///
+///         Work split into one contiguous run of items per node, like the
+///         demo's crowd, uses getPartitionNode() and getPartitionStart() so
+///         that every array and job agrees on where each item lives.
+class NumaTopology
+{
+public:
+    static const size_t ANY_NODE = size_t(-1);  ///< A node which isn't any particular one.
+
+    NumaTopology();
+
+    size_t getNodeCount() const;
+    const std::vector<unsigned>& getNodeCpus(size_t node) const;
+
+    size_t getPartitionNode(size_t item, size_t item_count) const;
+    size_t getPartitionStart(size_t node, size_t item_count) const;
+
+    bool pinCurrentThread(size_t node) const;
+
+    void* allocate(size_t bytes, size_t node) const;
+    void release(void* memory, size_t bytes) const;
+
+private:
+    std::vector<std::vector<unsigned> > node_cpus_; ///< The CPUs of each node, as the operating system numbers them.
+    std::vector<unsigned> node_ids_;                ///< The operating system's number for each node.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An array of a fixed number of elements per item, split into one
+///         contiguous partition of items per NUMA node, with each
+///         partition's memory on its own node.
+///
+/// \details The items are the same ones, partitioned the same way, as
+///         NumaTopology::getPartitionNode() says, so the jobs working on an
+///         item's elements can be run on the node the elements are on.
+///         Each partition is one allocation; get() finds the partition, so
+///         an item's elements are contiguous, but two items' elements are
+///         only contiguous within a partition.
+template <typename T>
+class NumaPartitionedArray
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Allocates and default constructs every element.
+    ///
+    /// \param  topology The nodes to partition the items across.  It must
+    ///         outlive the array.
+    /// \param  item_count The number of items.
+    /// \param  elements_per_item The number of elements each item has.
+    NumaPartitionedArray(const NumaTopology& topology, size_t item_count, size_t elements_per_item)
+        : topology_(topology),
+          item_count_(item_count),
+          elements_per_item_(elements_per_item)
+    {
+        for (size_t node = 0; node < topology_.getNodeCount(); ++node)
+        {
+            size_t first = topology_.getPartitionStart(node, item_count_);
+            size_t count = (topology_.getPartitionStart(node + 1, item_count_) - first) * elements_per_item_;
+            T* elements = static_cast<T*>(topology_.allocate(count * sizeof(T), node));
+            for (size_t i = 0; i < count; ++i)
+                new (elements + i) T();
+
+            partitions_.push_back(elements);
+            partition_starts_.push_back(first);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Destroys every element, and frees each partition.
+    ~NumaPartitionedArray()
+    {
+        for (size_t node = 0; node < partitions_.size(); ++node)
+        {
+            size_t count = getPartitionElementCount(node);
+            for (size_t i = 0; i < count; ++i)
+                partitions_[node][i].~T();
+
+            topology_.release(partitions_[node], count * sizeof(T));
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the first of an item's elements.
+    T* get(size_t item)
+    {
+        assert(item < item_count_);
+        size_t node = topology_.getPartitionNode(item, item_count_);
+        return partitions_[node] + (item - partition_starts_[node]) * elements_per_item_;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns the first of an item's elements.
+    const T* get(size_t item) const
+    {
+        return const_cast<NumaPartitionedArray*>(this)->get(item);
+    }
+
+    size_t getItemCount() const { return item_count_; }
+    size_t getElementsPerItem() const { return elements_per_item_; }
+
+private:
+    NumaPartitionedArray(const NumaPartitionedArray&);              // non-copyable
+    NumaPartitionedArray& operator=(const NumaPartitionedArray&);   // non-copyable
+
+    size_t getPartitionElementCount(size_t node) const
+    {
+        return (topology_.getPartitionStart(node + 1, item_count_) - partition_starts_[node]) * elements_per_item_;
+    }
+
+    const NumaTopology& topology_;
+    size_t item_count_;
+    size_t elements_per_item_;
+    std::vector<T*> partitions_;            ///< Each node's elements.
+    std::vector<size_t> partition_starts_;  ///< The first item of each node's partition.
+};
+
+#endif
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  occlusion_queries.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of OcclusionQueries class functions.
+
+#include "occlusion_queries.h"
+
+#include <algorithm>
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a query for each object, and the proxies' unit quad.
+///         Every object starts out visible.
+OcclusionQueries::OcclusionQueries(size_t object_count)
+    : query_ids_(object_count, 0),
+      pending_(object_count, 0),
+      issued_(object_count, 0),
+      hidden_counts_(object_count, 0),
+      vao_id_(0),
+      vbo_id_(0),
+      transform_location_(-1)
+{
+    if (object_count > 0)
+        glGenQueries(GLsizei(object_count), query_ids_.data());
+
+    const GLfloat corners[] = { 0, 0,  1, 0,  0, 1,  1, 1 };
+    glGenVertexArrays(1, &vao_id_);
+    glGenBuffers(1, &vbo_id_);
+
+    glBindVertexArray(vao_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glEnableVertexAttribArray(0);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the queries and the quad.
+OcclusionQueries::~OcclusionQueries()
+{
+    if (!query_ids_.empty())
+        glDeleteQueries(GLsizei(query_ids_.size()), query_ids_.data());
+    glDeleteVertexArrays(1, &vao_id_);
+    glDeleteBuffers(1, &vbo_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform drawProxy() takes the unit quad through to
+///         cover a box, in the space transform takes the box to.
+///
+/// \param  bounds The box, in the object's model space.
+/// \param  transform Takes the object's model space to world space.
+mat4 OcclusionQueries::getProxyTransform(const BoundingBox& bounds, const mat4& transform)
+{
+    if (bounds.isEmpty())
+        return glm::scale(transform, vec3(0.0f));
+
+    mat4 corner = glm::translate(mat4(), vec3(bounds.min, 0));
+    return transform * glm::scale(corner, vec3(bounds.max - bounds.min, 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects every issued query's result the GPU has finished, and
+///         counts how many times in a row each object has been hidden.
+///         Never waits; the queries which aren't done are left pending.
+void OcclusionQueries::collectResults()
+{
+    for (size_t object = 0; object < query_ids_.size(); ++object)
+    {
+        if (!pending_[object])
+            continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query_ids_[object], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint any_samples = 0;
+        glGetQueryObjectuiv(query_ids_[object], GL_QUERY_RESULT, &any_samples);
+        hidden_counts_[object] = any_samples ? 0 : hidden_counts_[object] + 1;
+        pending_[object] = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forgets every result, so every object is visible until it's
+///         queried again; for when the results have stopped meaning
+///         anything, because the queries weren't drawn for a while.
+void OcclusionQueries::reset()
+{
+    std::fill(pending_.begin(), pending_.end(), 0);
+    std::fill(issued_.begin(), issued_.end(), 0);
+    std::fill(hidden_counts_.begin(), hidden_counts_.end(), 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets up to draw proxies: binds the quad and the program, and
+///         turns the writes off and the depth test on.
+///
+/// \param  state The state cache the rest of the frame binds through.
+/// \param  program_id A program which reads the quad's corners from
+///         attribute 0 and takes them through its mat4 proxy_transform.
+void OcclusionQueries::beginProxies(GLStateCache& state, GLuint program_id)
+{
+    state.useProgram(program_id);
+    state.bindVertexArray(vao_id_);
+    transform_location_ = glGetUniformLocation(program_id, "proxy_transform");
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws an object's proxy inside its query, unless the query
+///         from an earlier frame still hasn't been collected.
+///
+/// \param  object The object.
+/// \param  proxy_transform Takes the unit quad over the object's bounds,
+///         from getProxyTransform().
+void OcclusionQueries::drawProxy(size_t object, const mat4& proxy_transform)
+{
+    assert(object < query_ids_.size());
+    if (pending_[object])
+        return;
+
+    glUniformMatrix4fv(transform_location_, 1, GL_FALSE, &proxy_transform[0][0]);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, query_ids_[object]);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+    pending_[object] = 1;
+    issued_[object] = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Puts back the state beginProxies() changed.
+void OcclusionQueries::endProxies(GLStateCache& state)
+{
+    glDisable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    state.bindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts skipping draws on the GPU if an object's latest query
+///         found it hidden.  Until its first query, the object is drawn.
+void OcclusionQueries::beginConditionalRender(size_t object) const
+{
+    assert(object < query_ids_.size());
+    if (issued_[object])
+        glBeginConditionalRender(query_ids_[object], GL_QUERY_NO_WAIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops skipping the draws beginConditionalRender() started for
+///         the same object.
+void OcclusionQueries::endConditionalRender(size_t object) const
+{
+    assert(object < query_ids_.size());
+    if (issued_[object])
+        glEndConditionalRender();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns whether the object's latest collected query found it
+///         hidden.
+bool OcclusionQueries::isHidden(size_t object) const
+{
+    assert(object < query_ids_.size());
+    return hidden_counts_[object] > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how many of the object's collected queries in a row
+///         found it hidden, up to the latest one.
+size_t OcclusionQueries::getHiddenCount(size_t object) const
+{
+    assert(object < query_ids_.size());
+    return hidden_counts_[object];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of objects.
+size_t OcclusionQueries::getObjectCount() const
+{
+    return query_ids_.size();
+}
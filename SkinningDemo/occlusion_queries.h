@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  occlusion_queries.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the OcclusionQueries class.
+
+#ifndef OCCLUSION_QUERIES_H_
+#define OCCLUSION_QUERIES_H_
+
+#include "joint_bounds.h"
+#include "gl_state_cache.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds out which of a set of objects were hidden behind the
+///         scene's depth last time they were drawn, by rasterizing a cheap
+///         proxy of each one's bounds inside an occlusion query.
+///
+/// \details Each object has one query.  Its proxy is a quad covering its
+///         bounds, drawn after the scene with the depth test on and color
+///         and depth writes off, so the query only counts whether any of
+///         its samples would have been in front of what was already drawn.
+///         A query is only issued again once the result of the last one has
+///         been collected, so nothing ever waits for the GPU: results are
+///         a frame or two old, which is the temporal reuse that makes the
+///         queries free for the CPU.
+///
+///         The results can be used in two ways:
+///
+///         - An object drawn with its own calls can be wrapped in
+///           beginConditionalRender() and endConditionalRender(), so the
+///           GPU skips the draws if the object's last query found it
+///           hidden.  GL_QUERY_NO_WAIT draws anyway if the query isn't done.
+///         - Objects batched into shared draws, like an instanced crowd, are
+///           left out of the batch by the CPU once collectResults() has seen
+///           them hidden.  Objects hidden for several queries in a row
+///           (getHiddenCount()) can skip their CPU work as well, their
+///           animation for instance.
+///
+///         A hidden object's proxy must still be drawn every frame it's in
+///         view, so it's seen again as soon as it comes out from behind
+///         whatever hid it.  Needs GL 3.3.
+class OcclusionQueries
+{
+public:
+    explicit OcclusionQueries(size_t object_count);
+    ~OcclusionQueries();
+
+    static mat4 getProxyTransform(const BoundingBox& bounds, const mat4& transform);
+
+    void collectResults();
+    void reset();
+
+    void beginProxies(GLStateCache& state, GLuint program_id);
+    void drawProxy(size_t object, const mat4& proxy_transform);
+    void endProxies(GLStateCache& state);
+
+    void beginConditionalRender(size_t object) const;
+    void endConditionalRender(size_t object) const;
+
+    bool isHidden(size_t object) const;
+    size_t getHiddenCount(size_t object) const;
+    size_t getObjectCount() const;
+
+private:
+    OcclusionQueries(const OcclusionQueries&);              // non-copyable
+    OcclusionQueries& operator=(const OcclusionQueries&);   // non-copyable
+
+    std::vector<GLuint> query_ids_;
+    std::vector<unsigned char> pending_;    ///< The object's query has been issued, and its result not collected.
+    std::vector<unsigned char> issued_;     ///< The object's query has been issued at least once.
+    std::vector<size_t> hidden_counts_;     ///< The object's last queries in a row which found it hidden.
+    GLuint vao_id_;
+    GLuint vbo_id_;
+    GLint transform_location_;              ///< proxy_transform in the program given to beginProxies().
+};
+
+#endif
@@ -0,0 +1,297 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  palette.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of skinning palette functions.
+
+#include "palette.h"
+#include "simd_math.h"
+
+#include <cmath>
+
+namespace {
+
+/// The largest value packHalfPalette() packs: past it, half floats step by
+/// more than 1/1024, half a pixel across a 1024 pixel clip space.
+const float HALF_PALETTE_LIMIT = 2.0f;
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Combines each joint's current local-to-model transform with its
+///         inverse bind pose transform.
+///
+/// \details The resulting matrix takes a vertex straight from bind-pose model
+///         space to current-pose model space, so the vertex shader only
+///         needs one matrix fetch and one mat4 * vec4 per influence, instead
+///         of multiplying the two matrices together for every vertex.
+///
+/// \param  joint_transforms The current local-to-model joint transforms.
+/// \param  inverse_bind_transforms The inverse of each joint's local-to-model
+///         transform in the bind pose.
+/// \param  joint_count The number of joints in each array.
+/// \param  palette An array of joint_count matrices which receives the
+///         skinning matrices.
+void computeSkinningPalette(const mat4* joint_transforms,
+                            const mat4* inverse_bind_transforms,
+                            size_t joint_count,
+                            mat4* palette)
+{
+    for (size_t joint = 0; joint < joint_count; ++joint)
+        palette[joint] = multiplyMatrices(joint_transforms[joint], inverse_bind_transforms[joint]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Multiplies every matrix of a palette by a transform on the left,
+///         folding a world or view-projection transform into it.
+///
+/// \details The vertex shader then gets the transformed position straight
+///         out of the palette, without multiplying every vertex by the
+///         transform as well.  With SSE2, each column of the result is the
+///         transform's columns scaled by the palette column's components
+///         and summed, four floats at a time.
+///
+/// \param  transform The transform to apply after each palette matrix.
+/// \param  palette The skinning matrices to transform.
+/// \param  joint_count The number of matrices in each array.
+/// \param  transformed An array of joint_count matrices which receives the
+///         transformed palette; may be palette itself.
+void transformPalette(const mat4& transform,
+                      const mat4* palette,
+                      size_t joint_count,
+                      mat4* transformed)
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 t0 = _mm_loadu_ps(&transform[0][0]);
+    const __m128 t1 = _mm_loadu_ps(&transform[1][0]);
+    const __m128 t2 = _mm_loadu_ps(&transform[2][0]);
+    const __m128 t3 = _mm_loadu_ps(&transform[3][0]);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            __m128 c = _mm_loadu_ps(&palette[joint][column][0]);
+            __m128 sum = _mm_mul_ps(t0, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(t1, _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1))));
+            sum = _mm_add_ps(sum, _mm_mul_ps(t2, _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))));
+            sum = _mm_add_ps(sum, _mm_mul_ps(t3, _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm_storeu_ps(&transformed[joint][column][0], sum);
+        }
+    }
+#else
+    for (size_t joint = 0; joint < joint_count; ++joint)
+        transformed[joint] = transform * palette[joint];
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Multiplies every matrix of a palette by a transform on the left,
+///         like transformPalette(), but writes the results with streaming
+///         stores, for palettes going straight into a mapped buffer.
+///
+/// \details A mapped buffer is usually write-combined memory, which is
+///         never cached: reading it stalls, and writes only go out at full
+///         speed when each 64-byte line is filled in as a whole.  Each
+///         matrix is exactly one line, written four columns in a row with
+///         _mm_stream_ps(), which also goes around the cache when the
+///         destination is ordinary memory, so the palettes don't push the
+///         poses out of it.  The stores are fenced before returning, so the
+///         palette can be handed to another thread.  If the destination
+///         isn't 16-byte aligned, or there's no SSE2, this is just
+///         transformPalette().
+///
+/// \param  transform The transform to apply after each palette matrix.
+/// \param  palette The skinning matrices to transform.
+/// \param  joint_count The number of matrices in each array.
+/// \param  transformed An array of joint_count matrices which receives the
+///         transformed palette; must not overlap palette, and is never
+///         read.
+void streamTransformedPalette(const mat4& transform,
+                              const mat4* palette,
+                              size_t joint_count,
+                              mat4* transformed)
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    if ((reinterpret_cast<size_t>(transformed) & 15) == 0)
+    {
+        const __m128 t0 = _mm_loadu_ps(&transform[0][0]);
+        const __m128 t1 = _mm_loadu_ps(&transform[1][0]);
+        const __m128 t2 = _mm_loadu_ps(&transform[2][0]);
+        const __m128 t3 = _mm_loadu_ps(&transform[3][0]);
+        for (size_t joint = 0; joint < joint_count; ++joint)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                __m128 c = _mm_loadu_ps(&palette[joint][column][0]);
+                __m128 sum = _mm_mul_ps(t0, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(t1, _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1))));
+                sum = _mm_add_ps(sum, _mm_mul_ps(t2, _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))));
+                sum = _mm_add_ps(sum, _mm_mul_ps(t3, _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3))));
+                _mm_stream_ps(&transformed[joint][column][0], sum);
+            }
+        }
+        _mm_sfence();
+        return;
+    }
+#endif
+
+    transformPalette(transform, palette, joint_count, transformed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Packs an affine palette into half floats: the top three rows of
+///         each matrix, less an origin shared by the whole palette.
+///
+/// \details Half floats only have 11 bits of precision, so the matrices'
+///         translations are packed relative to the first joint's, which is
+///         kept in full; the rest only have to span the palette, rather than
+///         reach across the whole scene.  The fourth row of an affine matrix
+///         is always (0, 0, 0, 1), so it isn't packed at all, which brings
+///         each matrix down from 64 bytes to 24.
+///
+///         The guard against losing too much precision is all or nothing:
+///         if any matrix isn't affine, or any value to be packed is larger
+///         than HALF_PALETTE_LIMIT, the palette should be uploaded in full
+///         instead.
+///
+/// \param  palette The palette.
+/// \param  joint_count The number of matrices in the palette.
+/// \param  origin Receives the first matrix's translation, which the rows'
+///         translations are relative to.
+/// \param  rows Receives the three rows of each matrix, in order.
+/// \return Whether every matrix was packed within the limit; if not, the
+///         rows are incomplete.
+bool packHalfPalette(const mat4* palette,
+                     size_t joint_count,
+                     vec3& origin,
+                     glm::hvec4* rows)
+{
+    origin = joint_count > 0 ? vec3(palette[0][3]) : vec3(0);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        const mat4& m = palette[joint];
+        if (m[0][3] != 0 || m[1][3] != 0 || m[2][3] != 0 || m[3][3] != 1)
+            return false;
+
+        for (int row = 0; row < 3; ++row)
+        {
+            vec4 values(m[0][row], m[1][row], m[2][row], m[3][row] - origin[row]);
+            for (int i = 0; i < 4; ++i)
+            {
+                if (!(std::abs(values[i]) <= HALF_PALETTE_LIMIT))
+                    return false;
+            }
+            rows[joint * 3 + row] = glm::hvec4(glm::half(values.x), glm::half(values.y),
+                                               glm::half(values.z), glm::half(values.w));
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Packs affine matrices into the top three of their rows, row
+///         major, dropping the bottom row, which is always (0, 0, 0, 1).
+///
+/// \details This is the layout the SkinningPalette block and bind_pose_inv
+///         take the separate and precombined palettes in: 12 floats a joint
+///         rather than 16.  With SSE2, each matrix is transposed in
+///         registers and its first three rows stored.
+///
+/// \param  matrices The matrices to pack, which must be affine.
+/// \param  matrix_count The number of matrices.
+/// \param  rows An array of matrix_count * 3 rows which receives each
+///         matrix's rows in turn; must not overlap matrices.
+void packAffineRows(const mat4* matrices,
+                    size_t matrix_count,
+                    vec4* rows)
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    for (size_t i = 0; i < matrix_count; ++i)
+    {
+        __m128 r0 = _mm_loadu_ps(&matrices[i][0][0]);
+        __m128 r1 = _mm_loadu_ps(&matrices[i][1][0]);
+        __m128 r2 = _mm_loadu_ps(&matrices[i][2][0]);
+        __m128 r3 = _mm_loadu_ps(&matrices[i][3][0]);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(&rows[i * 3][0], r0);
+        _mm_storeu_ps(&rows[i * 3 + 1][0], r1);
+        _mm_storeu_ps(&rows[i * 3 + 2][0], r2);
+    }
+#else
+    for (size_t i = 0; i < matrix_count; ++i)
+    {
+        const mat4& m = matrices[i];
+        for (int row = 0; row < 3; ++row)
+            rows[i * 3 + row] = vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+    }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Combines each joint's current local-to-model transform with its
+///         inverse bind pose transform, like computeSkinningPalette(), for
+///         2D affine transforms.
+///
+/// \param  joint_affines The current local-to-model joint transforms.
+/// \param  inverse_bind_affines The inverse of each joint's local-to-model
+///         transform in the bind pose.
+/// \param  joint_count The number of joints in each array.
+/// \param  palette An array of joint_count transforms which receives the
+///         skinning transforms, ready to copy into an AFFINE_2D shader's
+///         SkinningPalette block as is.
+void computeAffinePalette(const Affine2D* joint_affines,
+                          const Affine2D* inverse_bind_affines,
+                          size_t joint_count,
+                          Affine2D* palette)
+{
+    for (size_t joint = 0; joint < joint_count; ++joint)
+        palette[joint] = composeAffine(joint_affines[joint], inverse_bind_affines[joint]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts an affine transform consisting of a rotation, uniform
+///         scale, and translation into a dual quaternion and scale factor.
+///
+/// \param  transform The transform to convert.  It must not contain any
+///         shear or non-uniform scaling.
+/// \param  scale Receives the transform's uniform scale factor.
+/// \return The dual quaternion representing the transform's rotation and
+///         translation.
+DualQuat toDualQuat(const mat4& transform, float& scale)
+{
+    scale = glm::length(vec3(transform[0]));
+
+    quat r = glm::quat_cast(mat3(transform) * (1.0f / scale));
+    vec3 t = vec3(transform[3]);
+
+    // dual = 0.5 * (0, t) * r
+    quat d = quat(0.0f, t.x, t.y, t.z) * r * 0.5f;
+
+    DualQuat dq;
+    dq.real = vec4(r.x, r.y, r.z, r.w);
+    dq.dual = vec4(d.x, d.y, d.z, d.w);
+    return dq;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a matrix skinning palette into a dual quaternion palette.
+///
+/// \details Each joint needs 8 floats for the dual quaternion and 1 for its
+///         scale, instead of the 16 floats of a mat4.
+///
+/// \param  skinning_palette An array of joint_count skinning matrices, as
+///         produced by computeSkinningPalette().
+/// \param  joint_count The number of joints in the palette.
+/// \param  dual_quats An array of joint_count dual quaternions which
+///         receives the converted palette.
+/// \param  scales An array of joint_count floats which receives each
+///         joint's scale factor.
+void computeDualQuatPalette(const mat4* skinning_palette,
+                            size_t joint_count,
+                            DualQuat* dual_quats,
+                            float* scales)
+{
+    for (size_t joint = 0; joint < joint_count; ++joint)
+        dual_quats[joint] = toDualQuat(skinning_palette[joint], scales[joint]);
+}
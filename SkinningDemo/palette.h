@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  palette.h
+/// \author Ben Crist
+///
+/// \brief  Functions for building skinning matrix palettes.
+
+#ifndef PALETTE_H_
+#define PALETTE_H_
+
+#include "affine_2d.h"
+#include <glm/gtc/half_float.hpp>
+
+void computeSkinningPalette(const mat4* joint_transforms,
+                            const mat4* inverse_bind_transforms,
+                            size_t joint_count,
+                            mat4* palette);
+
+void transformPalette(const mat4& transform,
+                      const mat4* palette,
+                      size_t joint_count,
+                      mat4* transformed);
+
+void streamTransformedPalette(const mat4& transform,
+                              const mat4* palette,
+                              size_t joint_count,
+                              mat4* transformed);
+
+bool packHalfPalette(const mat4* palette,
+                     size_t joint_count,
+                     vec3& origin,
+                     glm::hvec4* rows);
+
+void packAffineRows(const mat4* matrices,
+                    size_t matrix_count,
+                    vec4* rows);
+
+void computeAffinePalette(const Affine2D* joint_affines,
+                          const Affine2D* inverse_bind_affines,
+                          size_t joint_count,
+                          Affine2D* palette);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A rigid transform plus uniform scale, represented as a unit dual
+///         quaternion.
+///
+/// \details Both parts are stored as (x, y, z, w) so that they can be uploaded
+///         directly as a pair of GLSL vec4s.  The transform applies the scale
+///         first, then the rotation, then the translation.
+struct DualQuat
+{
+    vec4 real;      ///< The rotation quaternion.
+    vec4 dual;      ///< Half the translation, multiplied by the rotation.
+};
+
+DualQuat toDualQuat(const mat4& transform, float& scale);
+
+void computeDualQuatPalette(const mat4* skinning_palette,
+                            size_t joint_count,
+                            DualQuat* dual_quats,
+                            float* scales);
+
+#endif
@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  palette_cache.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of PaletteCache class functions.
+
+#include "palette_cache.h"
+
+#include <cassert>
+
+const size_t PaletteCache::NO_ENTRY;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty cache.
+///
+/// \param  joint_count The number of joints in each cached pose.
+/// \param  capacity The most states to keep at once.
+PaletteCache::PaletteCache(size_t joint_count, size_t capacity)
+    : joint_count_(joint_count),
+      capacity_(capacity > 0 ? capacity : 1),
+      entry_count_(0),
+      bucket_next_(capacity_, NO_ENTRY),
+      newer_(capacity_, NO_ENTRY),
+      older_(capacity_, NO_ENTRY),
+      newest_(NO_ENTRY),
+      oldest_(NO_ENTRY),
+      keys_(capacity_),
+      joint_transforms_(capacity_ * joint_count),
+      palettes_(capacity_ * joint_count),
+      colors_(capacity_ * joint_count),
+      hits_(0),
+      misses_(0)
+{
+    size_t bucket_count = 1;
+    while (bucket_count < capacity_)
+        bucket_count *= 2;
+    buckets_.assign(bucket_count, NO_ENTRY);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forgets every state, as when whatever the poses were evaluated
+///         from has changed.  The hit and miss counts are kept.
+void PaletteCache::clear()
+{
+    buckets_.assign(buckets_.size(), NO_ENTRY);
+    entry_count_ = 0;
+    newest_ = NO_ENTRY;
+    oldest_ = NO_ENTRY;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds a state's entry, and makes it the most recently used.
+///
+/// \return The entry, or NO_ENTRY if the state isn't cached.
+size_t PaletteCache::find(const AnimationStateKey& key)
+{
+    size_t bucket = AnimationStateCache::hashKey(key) & (buckets_.size() - 1);
+    for (size_t entry = buckets_[bucket]; entry != NO_ENTRY; entry = bucket_next_[entry])
+    {
+        if (keys_[entry] == key)
+        {
+            unlink(entry);
+            linkNewest(entry);
+            ++hits_;
+            return entry;
+        }
+    }
+
+    ++misses_;
+    return NO_ENTRY;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds an entry for a state, evicting the least recently used one if
+///         the cache is full.
+///
+/// \details The entry's transforms, palette and colors are left as they were,
+///         for the caller to fill in.
+///
+/// \param  key The state's key, which mustn't already be cached.
+/// \return The new entry, which is the most recently used.
+size_t PaletteCache::insert(const AnimationStateKey& key)
+{
+    size_t entry;
+    if (entry_count_ < capacity_)
+        entry = entry_count_++;
+    else
+    {
+        entry = oldest_;
+        unlink(entry);
+        removeFromBucket(entry);
+    }
+
+    size_t bucket = AnimationStateCache::hashKey(key) & (buckets_.size() - 1);
+    keys_[entry] = key;
+    bucket_next_[entry] = buckets_[bucket];
+    buckets_[bucket] = entry;
+    linkNewest(entry);
+    return entry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns an entry's local-to-model joint transforms.
+mat4* PaletteCache::getJointTransforms(size_t entry)
+{
+    assert(entry < entry_count_);
+    return &joint_transforms_[entry * joint_count_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns an entry's skinning palette.
+mat4* PaletteCache::getPalette(size_t entry)
+{
+    assert(entry < entry_count_);
+    return &palettes_[entry * joint_count_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns an entry's joint colors.
+color4* PaletteCache::getColors(size_t entry)
+{
+    assert(entry < entry_count_);
+    return &colors_[entry * joint_count_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in each cached pose.
+size_t PaletteCache::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the most states the cache keeps at once.
+size_t PaletteCache::getCapacity() const
+{
+    return capacity_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of states cached now.
+size_t PaletteCache::getEntryCount() const
+{
+    return entry_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of calls to find() which found their state.
+size_t PaletteCache::getHitCount() const
+{
+    return hits_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of calls to find() which didn't.
+size_t PaletteCache::getMissCount() const
+{
+    return misses_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes an entry out of the recency list.
+void PaletteCache::unlink(size_t entry)
+{
+    if (newer_[entry] != NO_ENTRY)
+        older_[newer_[entry]] = older_[entry];
+    else
+        newest_ = older_[entry];
+
+    if (older_[entry] != NO_ENTRY)
+        newer_[older_[entry]] = newer_[entry];
+    else
+        oldest_ = newer_[entry];
+
+    newer_[entry] = NO_ENTRY;
+    older_[entry] = NO_ENTRY;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Puts an entry, which isn't in the recency list, at its newest end.
+void PaletteCache::linkNewest(size_t entry)
+{
+    newer_[entry] = NO_ENTRY;
+    older_[entry] = newest_;
+    if (newest_ != NO_ENTRY)
+        newer_[newest_] = entry;
+    else
+        oldest_ = entry;
+    newest_ = entry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes an entry out of its hash bucket's chain.
+void PaletteCache::removeFromBucket(size_t entry)
+{
+    size_t bucket = AnimationStateCache::hashKey(keys_[entry]) & (buckets_.size() - 1);
+    size_t* link = &buckets_[bucket];
+    while (*link != entry)
+    {
+        assert(*link != NO_ENTRY);
+        link = &bucket_next_[*link];
+    }
+    *link = bucket_next_[entry];
+}
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  palette_cache.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the PaletteCache class.
+
+#ifndef PALETTE_CACHE_H_
+#define PALETTE_CACHE_H_
+
+#include "demo.h"
+#include "animation_state_cache.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Remembers the evaluated poses of the animation states seen
+///         recently, so a state seen again needn't be evaluated at all.
+///
+/// \details Scrubbing a timeline, or a blend parameter, back and forth
+///         revisits the same states over and over.  Each entry holds
+///         everything the clips, blending and hierarchy pass produced for
+///         its state: the joints' local-to-model transforms, the skinning
+///         palette built from them, and the joints' colors.  At most
+///         capacity states are kept; once it's full, inserting a state
+///         evicts the one least recently found or inserted.
+///
+///         As with AnimationStateCache, a hit is only exact if the poses
+///         which are cached were evaluated from their keys' rounded time
+///         and weights, not the unrounded ones the keys were made from.
+///
+///         The entries, the hash table and the recency list are all
+///         allocated up front, so finding and inserting never allocate.
+class PaletteCache
+{
+public:
+    static const size_t NO_ENTRY = size_t(-1);
+
+    PaletteCache(size_t joint_count, size_t capacity);
+
+    void clear();
+    size_t find(const AnimationStateKey& key);
+    size_t insert(const AnimationStateKey& key);
+
+    mat4* getJointTransforms(size_t entry);
+    mat4* getPalette(size_t entry);
+    color4* getColors(size_t entry);
+
+    size_t getJointCount() const;
+    size_t getCapacity() const;
+    size_t getEntryCount() const;
+    size_t getHitCount() const;
+    size_t getMissCount() const;
+
+private:
+    PaletteCache(const PaletteCache&);              // non-copyable
+    PaletteCache& operator=(const PaletteCache&);   // non-copyable
+
+    void unlink(size_t entry);
+    void linkNewest(size_t entry);
+    void removeFromBucket(size_t entry);
+
+    size_t joint_count_;
+    size_t capacity_;
+    size_t entry_count_;
+
+    std::vector<size_t> buckets_;       ///< Each bucket's first entry, or NO_ENTRY; a power of two, at least capacity.
+    std::vector<size_t> bucket_next_;   ///< The next entry in each entry's bucket.
+    std::vector<size_t> newer_;         ///< The next more recently used entry, or NO_ENTRY for the newest.
+    std::vector<size_t> older_;         ///< The next less recently used entry, or NO_ENTRY for the oldest.
+    size_t newest_;
+    size_t oldest_;
+    std::vector<AnimationStateKey> keys_;
+
+    std::vector<mat4> joint_transforms_;    ///< joint_count per entry.
+    std::vector<mat4> palettes_;            ///< joint_count per entry.
+    std::vector<color4> colors_;            ///< joint_count per entry.
+
+    size_t hits_;
+    size_t misses_;
+};
+
+#endif
@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  palette_ring.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of PaletteRing class functions.
+
+#include "palette_ring.h"
+
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a new texture buffer in the current OpenGL context, large
+///         enough to hold region_count frames' palettes.
+///
+/// \param  region_bytes The most palette data a frame will write, in bytes.
+/// \param  region_count The number of regions to cycle through.  This should
+///         be at least the number of frames the GPU can be behind the CPU.
+PaletteRing::PaletteRing(GLsizeiptr region_bytes, size_t region_count)
+    : buffer_id_(0),
+      region_size_((region_bytes + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT * REGION_ALIGNMENT),
+      current_region_(0),
+      mapped_region_(NO_REGION),
+      previous_region_(NO_REGION),
+      fences_(region_count, GLsync(0))
+{
+    glGenBuffers(1, &buffer_id_);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_id_);
+    glBufferData(GL_TEXTURE_BUFFER, region_size_ * region_count, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the buffer and any outstanding fences.
+PaletteRing::~PaletteRing()
+{
+    for (size_t i = 0; i < fences_.size(); ++i)
+    {
+        if (fences_[i] != 0)
+            glDeleteSync(fences_[i]);
+    }
+
+    glDeleteBuffers(1, &buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Maps the start of the current region for writing.
+///
+/// \details If the GPU may still be reading the region from the last time it
+///         was used, this waits until it's done.  The previous contents of
+///         the mapped range are discarded, unless it's flushed explicitly:
+///         then they're kept, and only the ranges passed to flush() before
+///         unmap() are updated.
+///
+/// \param  bytes The number of bytes to map, which must fit in a region.
+/// \param  flush_explicitly Whether the caller will flush() what it writes.
+/// \return A pointer to bytes writable bytes.
+void* PaletteRing::map(GLsizeiptr bytes, bool flush_explicitly)
+{
+    assert(bytes > 0 && bytes <= region_size_);
+
+    GLsync& region_fence = fences_[current_region_];
+    if (region_fence != 0)
+    {
+        GLenum result = glClientWaitSync(region_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(region_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);    // 1 ms
+
+        glDeleteSync(region_fence);
+        region_fence = 0;
+    }
+
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    access |= flush_explicitly ? GL_MAP_FLUSH_EXPLICIT_BIT : GL_MAP_INVALIDATE_RANGE_BIT;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_id_);
+    void* data = glMapBufferRange(GL_TEXTURE_BUFFER, getRegionOffset(), bytes, access);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    if (data == nullptr)
+    {
+        std::cerr << "Failed to map palette ring region " << current_region_ << "!" << std::endl;
+        throw std::runtime_error("Failed to map palette ring!");
+    }
+
+    mapped_region_ = current_region_;
+    return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks part of the region mapped by map(), with flush_explicitly,
+///         as written.
+///
+/// \param  offset Where the written bytes start, from the start of the
+///         mapping.
+/// \param  bytes The number of bytes written, which must be within the
+///         mapping.
+void PaletteRing::flush(GLintptr offset, GLsizeiptr bytes)
+{
+    assert(mapped_region_ != NO_REGION);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_id_);
+    glFlushMappedBufferRange(GL_TEXTURE_BUFFER, offset, bytes);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unmaps the current region, so the following draws can read it.
+void PaletteRing::unmap()
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_id_);
+    glUnmapBuffer(GL_TEXTURE_BUFFER);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks the end of the draws which read the region written this
+///         frame, and moves on to the next region.
+///
+/// \details A frame which didn't call map() draws nothing from the ring, so
+///         nothing is fenced, and the next map() writes the same region.
+///         The previous region may have been read again this frame, so its
+///         fence is replaced with one after this frame's draws too.
+void PaletteRing::fence()
+{
+    if (mapped_region_ == NO_REGION)
+        return;
+
+    if (previous_region_ != NO_REGION && previous_region_ != mapped_region_)
+    {
+        if (fences_[previous_region_] != 0)
+            glDeleteSync(fences_[previous_region_]);
+        fences_[previous_region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    fences_[mapped_region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    previous_region_ = mapped_region_;
+    mapped_region_ = NO_REGION;
+    current_region_ = (current_region_ + 1) % fences_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the name of the buffer, which the palette textures view.
+GLuint PaletteRing::getBufferId() const
+{
+    return buffer_id_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns which region map() writes next, from 0 to
+///         getRegionCount() - 1.
+size_t PaletteRing::getRegionIndex() const
+{
+    return current_region_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of regions the ring cycles through.
+size_t PaletteRing::getRegionCount() const
+{
+    return fences_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns where the current region starts in the buffer, in bytes;
+///         a multiple of REGION_ALIGNMENT.
+GLsizeiptr PaletteRing::getRegionOffset() const
+{
+    return region_size_ * GLsizeiptr(current_region_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns where the region written by the frame before this one
+///         starts in the buffer, in bytes, or the current region's offset
+///         if there hasn't been one.
+///
+/// \details With only one region, the previous frame's palettes have
+///         already been overwritten by the time a frame draws.
+GLsizeiptr PaletteRing::getPreviousRegionOffset() const
+{
+    if (previous_region_ == NO_REGION)
+        return getRegionOffset();
+    return region_size_ * GLsizeiptr(previous_region_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the whole buffer, every region included, in
+///         bytes.
+GLsizeiptr PaletteRing::getBufferBytes() const
+{
+    return region_size_ * GLsizeiptr(fences_.size());
+}
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  palette_ring.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the PaletteRing class.
+
+#ifndef PALETTE_RING_H_
+#define PALETTE_RING_H_
+
+#include "demo.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A texture buffer's storage divided into several equally sized
+///         regions, each of which holds a whole frame's instance palettes,
+///         written by the CPU in round-robin order.
+///
+/// \details Each frame, map() maps the next region unsynchronized, so the
+///         driver never has to stall or copy behind the GPU's reads of an
+///         earlier frame's palettes the way orphaning a buffer can.  A fence
+///         is placed after the draws which read the region, and map() only
+///         waits on it when it comes back around to the region, which with
+///         3 regions is normally long since signaled.
+///
+///         The textures which read the palettes view the whole buffer, so
+///         rebinding them from frame to frame costs nothing; the shaders
+///         instead add the region's offset, from getRegionOffset(), to the
+///         palettes they fetch, which is set once a frame as the constant
+///         REGION_ATTRIBUTE rather than as a uniform of every program which
+///         reads the palettes.  Regions are a multiple of REGION_ALIGNMENT
+///         bytes, so the offset is a whole number of full (64 byte) and half
+///         (24 byte) matrices, and of RGBA32F texels.
+///
+///         The region written the frame before is left alone until the
+///         ring comes back around to it, so the frame's draws can read the
+///         previous frame's palettes too, from getPreviousRegionOffset(),
+///         for motion vectors: nothing is evaluated or copied again, and
+///         the shaders are just given a second offset, as the constant
+///         PREVIOUS_REGION_ATTRIBUTE.  fence() fences that region again,
+///         so it isn't overwritten while those reads are in flight either.
+///
+///         A region keeps what it was last written with until it's next
+///         written, so a frame whose palettes are mostly the same as those
+///         the region holds can map it with explicit flushes instead, write
+///         just the palettes which differ, and flush() each run of them.
+///         getRegionIndex() tells the caller which region it's writing, to
+///         keep track of what each holds.
+///
+///         Like UniformRingBuffer, it would be persistently mapped if
+///         ARB_buffer_storage were in the GLEW version used here.
+class PaletteRing
+{
+public:
+    static const GLsizeiptr REGION_ALIGNMENT = 192;    ///< The least common multiple of 64, 24 and 16.
+    static const GLuint REGION_ATTRIBUTE = 9;           ///< The attribute location of the ivec3 the shaders read the region from.
+    static const GLuint PREVIOUS_REGION_ATTRIBUTE = 10; ///< The same, for the previous frame's region.
+
+    PaletteRing(GLsizeiptr region_bytes, size_t region_count = 3);
+    ~PaletteRing();
+
+    void* map(GLsizeiptr bytes, bool flush_explicitly = false);
+    void flush(GLintptr offset, GLsizeiptr bytes);
+    void unmap();
+    void fence();
+
+    GLuint getBufferId() const;
+    size_t getRegionIndex() const;
+    size_t getRegionCount() const;
+    GLsizeiptr getRegionOffset() const;
+    GLsizeiptr getPreviousRegionOffset() const;
+    GLsizeiptr getBufferBytes() const;
+
+private:
+    static const size_t NO_REGION = size_t(-1);
+
+    PaletteRing(const PaletteRing&);            // non-copyable
+    PaletteRing& operator=(const PaletteRing&); // non-copyable
+
+    GLuint buffer_id_;
+    GLsizeiptr region_size_;    ///< The bytes asked for, rounded up to REGION_ALIGNMENT.
+    size_t current_region_;
+    size_t mapped_region_;      ///< The region last written by map(), until it's fenced, or NO_REGION.
+    size_t previous_region_;    ///< The region fenced last, or NO_REGION before the first fence().
+    std::vector<GLsync> fences_;
+};
+
+#endif
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  palette_stream.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of PaletteStream class functions.
+
+#include "palette_stream.h"
+
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a stream which hasn't been attached to any packets yet.
+///
+/// \param  palette_capacity The number of matrices each packet's buffer
+///         holds; every palette the crowd might need in one frame.
+PaletteStream::PaletteStream(size_t palette_capacity)
+    : palette_capacity_(palette_capacity)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys every packet's buffer.  The packets must not be used to
+///         stream palettes afterwards.
+PaletteStream::~PaletteStream()
+{
+    if (!buffer_ids_.empty())
+        glDeleteBuffers(GLsizei(buffer_ids_.size()), &buffer_ids_[0]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gives a packet a buffer of its own, and maps it, ready for the
+///         writer to fill in.
+void PaletteStream::attach(FramePacket& packet)
+{
+    assert(packet.palette_stream_buffer_id == 0);
+
+    GLuint buffer_id = 0;
+    glGenBuffers(1, &buffer_id);
+    buffer_ids_.push_back(buffer_id);
+
+    packet.palette_stream_buffer_id = buffer_id;
+    packet.streamed_palette_capacity = palette_capacity_;
+    map(packet);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Maps a packet's buffer for writing, onto fresh storage, so the
+///         GPU can go on drawing whatever the old storage held.  Does
+///         nothing if it's already mapped.
+///
+/// \details Everything the buffer held is discarded, so every palette the
+///         packet's frame uses must be written before it's drawn.
+void PaletteStream::map(FramePacket& packet)
+{
+    if (packet.streamed_palettes != nullptr)
+        return;
+
+    GLsizeiptr bytes = GLsizeiptr(palette_capacity_ * sizeof(mat4));
+    glBindBuffer(GL_TEXTURE_BUFFER, packet.palette_stream_buffer_id);
+    glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void* data = glMapBufferRange(GL_TEXTURE_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    if (data == nullptr)
+    {
+        std::cerr << "Failed to map palette stream buffer " << packet.palette_stream_buffer_id << "!" << std::endl;
+        throw std::runtime_error("Failed to map palette stream buffer!");
+    }
+
+    packet.streamed_palettes = static_cast<mat4*>(data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unmaps a packet's buffer, so it can be drawn from.  Does nothing
+///         if it isn't mapped.
+void PaletteStream::unmap(FramePacket& packet)
+{
+    if (packet.streamed_palettes == nullptr)
+        return;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, packet.palette_stream_buffer_id);
+    glUnmapBuffer(GL_TEXTURE_BUFFER);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    packet.streamed_palettes = nullptr;
+}
@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  palette_stream.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the PaletteStream class.
+
+#ifndef PALETTE_STREAM_H_
+#define PALETTE_STREAM_H_
+
+#include "frame_packet.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gives each frame packet its own buffer for the crowd's palettes,
+///         mapped whenever the simulation thread might be filling it in, so
+///         the palettes are written straight into memory the GPU reads
+///         rather than into the packet and then copied.
+///
+/// \details Without it, the stage jobs write every palette into the
+///         packet's instance_palettes, and the GLUT thread copies all of
+///         them again with glBufferSubData().  Here the GLUT thread maps a
+///         packet's buffer before handing the packet back to the writer,
+///         and unmaps it once it has acquired the packet again, so the only
+///         time the palettes are written is by the stage jobs, with
+///         streaming stores (see streamTransformedPalette()).  A mapping can
+///         be written from any thread; only mapping and unmapping need the
+///         context.
+///
+///         Remapping orphans the buffer's old storage, which the GPU may
+///         still be drawing the packet's last frame from, so nothing ever
+///         waits.  Only the GLUT thread may call any of the functions, and
+///         only attach() may be called before the packet is first handed
+///         to the writer, since a packet's buffer starts out mapped.
+///
+///         Persistent mapping (ARB_buffer_storage) would save remapping
+///         each frame, but like UniformRingBuffer, this has to make do
+///         without it.
+class PaletteStream
+{
+public:
+    explicit PaletteStream(size_t palette_capacity);
+    ~PaletteStream();
+
+    void attach(FramePacket& packet);
+    void map(FramePacket& packet);
+    void unmap(FramePacket& packet);
+
+private:
+    PaletteStream(const PaletteStream&);            // non-copyable
+    PaletteStream& operator=(const PaletteStream&); // non-copyable
+
+    size_t palette_capacity_;       ///< The size of each buffer, in matrices.
+    std::vector<GLuint> buffer_ids_;
+};
+
+#endif
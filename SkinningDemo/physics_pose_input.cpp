@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  physics_pose_input.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of PhysicsPoseInput class functions.
+
+#include "physics_pose_input.h"
+#include "joint_rotation.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an input which hasn't had anything published yet, with
+///         every frame sized for joint_count joints and weighted 0.
+PhysicsPoseInput::PhysicsPoseInput(size_t joint_count)
+    : write_index_(0),
+      read_index_(1),
+      has_frame_(false),
+      published_(2)
+{
+    for (size_t i = 0; i < 3; ++i)
+    {
+        frames_[i].step = 0;
+        frames_[i].positions.assign(joint_count, vec2(0, 0));
+        frames_[i].rotations.assign(joint_count, 0.0f);
+        frames_[i].scales.assign(joint_count, 1.0f);
+        frames_[i].weights.assign(joint_count, 0.0f);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the frame the physics thread should fill in next.  Its
+///         contents are whatever was written into it three or more steps
+///         ago, so every joint must be written again.
+PhysicsPoseFrame& PhysicsPoseInput::getWriteFrame()
+{
+    return frames_[write_index_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Publishes the frame returned by getWriteFrame(), and gives the
+///         physics thread a different frame to fill in next.
+void PhysicsPoseInput::publish()
+{
+    write_index_ = published_.exchange(write_index_ | FRESH) & ~FRESH;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Moves the animation thread on to the most recently published
+///         frame, if it hasn't already acquired it.
+///
+/// \return true if there was a new frame.
+bool PhysicsPoseInput::acquire()
+{
+    if ((published_.load() & FRESH) == 0)
+        return false;
+
+    read_index_ = published_.exchange(read_index_) & ~FRESH;
+    has_frame_ = true;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the animation thread has acquired any frame yet.
+bool PhysicsPoseInput::hasFrame() const
+{
+    return has_frame_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the frame the animation thread acquired most recently.
+///         It's only valid once hasFrame() is true.
+const PhysicsPoseFrame& PhysicsPoseInput::getReadFrame() const
+{
+    return frames_[read_index_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Blends the acquired frame into an animated pose, in place,
+///         between blending and the hierarchy pass.
+///
+/// \details The model space transforms are turned back into local ones
+///         against their parents' transforms in the same frame, and the
+///         locals are blended with the pose's by each joint's weight, times
+///         weight.  Every joint's local depends only on the frame, so this
+///         is a single pass with no dependencies between joints, and since
+///         it's the locals which blend, a joint which follows the physics
+///         under a parent which doesn't stays attached to the animated
+///         parent, swinging the way the physics swings it, rather than
+///         being torn away to wherever the physics put it.
+///
+///         If nothing has been acquired yet, the pose is left alone.  If
+///         the frame is for a different number of joints than the
+///         skeleton, the problem is reported to stderr and an exception is
+///         thrown.
+///
+/// \param  skeleton The skeleton the pose belongs to.
+/// \param  weight Scales every joint's weight, to fade the physics in and
+///         out as a whole.
+/// \param  pose The animated pose, which receives the blend.
+void PhysicsPoseInput::blendInto(const Skeleton& skeleton, float weight, Pose& pose) const
+{
+    if (!has_frame_)
+        return;
+
+    const PhysicsPoseFrame& frame = frames_[read_index_];
+    size_t joint_count = skeleton.getJointCount();
+    if (frame.positions.size() != joint_count || pose.joint_count != joint_count)
+    {
+        std::cerr << "Can't blend a physics frame into a pose with a different number of joints!" << std::endl
+                  << "  Frame: " << frame.positions.size() << " joints" << std::endl
+                  << "   Pose: " << pose.joint_count << " joints" << std::endl;
+        throw std::runtime_error("Can't blend a physics frame into a pose with a different number of joints!");
+    }
+
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        float t = std::min(std::max(weight * frame.weights[joint], 0.0f), 1.0f);
+        if (t == 0.0f)
+            continue;
+
+        vec2 translation = frame.positions[joint];
+        float rotation = frame.rotations[joint];
+        float scale = frame.scales[joint];
+
+        int parent = skeleton.getParent(joint);
+        if (parent != Skeleton::NO_PARENT)
+        {
+            float s, c;
+            sinCosDegrees(frame.rotations[parent], s, c);
+            vec2 offset = (translation - frame.positions[parent]) / frame.scales[parent];
+            translation = vec2(c * offset.x + s * offset.y, c * offset.y - s * offset.x);
+            rotation -= frame.rotations[parent];
+            scale /= frame.scales[parent];
+        }
+
+        pose.translation[joint] = glm::mix(pose.translation[joint], translation, t);
+        pose.rotation[joint] = lerpAngle(pose.rotation[joint], rotation, t);
+        pose.scale[joint] = glm::mix(pose.scale[joint], scale, t);
+    }
+}
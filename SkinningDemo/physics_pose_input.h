@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  physics_pose_input.h
+/// \author Ben Crist
+///
+/// \brief  The PhysicsPoseFrame struct and PhysicsPoseInput class, through
+///         which a physics simulation running on its own thread drives a
+///         character's joints.
+
+#ifndef PHYSICS_POSE_INPUT_H_
+#define PHYSICS_POSE_INPUT_H_
+
+#include "pose.h"
+#include "skeleton.h"
+#include <atomic>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Where a physics step put each of a character's joints, in model
+///         space, and how much each should follow it.
+///
+/// \details Like a Pose, the frame is a structure of arrays, in the
+///         skeleton's joint order.  The transforms are each joint's whole
+///         frame in model space (the origin, rotation in degrees about the
+///         z axis and uniform scale), as a rigid body simulation keeps
+///         them, rather than relative to the parent.  A weight of 0 leaves
+///         the joint to the animation, and 1 hands it to the physics.
+struct PhysicsPoseFrame
+{
+    size_t step;                    ///< Increases with every physics step published.
+    std::vector<vec2> positions;    ///< Each joint's origin in model space.
+    std::vector<float> rotations;   ///< Each joint's rotation in model space, in degrees.
+    std::vector<float> scales;      ///< Each joint's uniform scale in model space.
+    std::vector<float> weights;     ///< How far each joint blends from the animation to the physics.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Hands one character's physics frames from the physics thread to
+///         the animation thread, and blends the latest into its poses.
+///
+/// \details The handoff works like FramePacketBuffer's: of three frames,
+///         the physics thread fills in one, the animation thread reads
+///         another, and the third is the most recently published, swapped
+///         in and out with a single atomic exchange.  Neither thread ever
+///         waits for the other or allocates; if the physics steps faster
+///         than the animation, the older steps are dropped, and if it steps
+///         slower, the animation keeps blending the last one.
+///
+///         Exactly one thread may call getWriteFrame() and publish(), and
+///         exactly one other may call the rest.
+class PhysicsPoseInput
+{
+public:
+    explicit PhysicsPoseInput(size_t joint_count);
+
+    PhysicsPoseFrame& getWriteFrame();
+    void publish();
+
+    bool acquire();
+    bool hasFrame() const;
+    const PhysicsPoseFrame& getReadFrame() const;
+    void blendInto(const Skeleton& skeleton, float weight, Pose& pose) const;
+
+private:
+    PhysicsPoseInput(const PhysicsPoseInput&);              // non-copyable
+    PhysicsPoseInput& operator=(const PhysicsPoseInput&);   // non-copyable
+
+    static const unsigned FRESH = 4;    ///< Set in published_ when that frame hasn't been acquired yet.
+
+    PhysicsPoseFrame frames_[3];
+    unsigned write_index_;              ///< Only used by the physics thread.
+    unsigned read_index_;               ///< Only used by the animation thread.
+    bool has_frame_;                    ///< The animation thread has acquired at least one frame.
+    std::atomic<unsigned> published_;   ///< The index of the published frame, plus FRESH.
+};
+
+#endif
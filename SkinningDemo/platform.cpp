@@ -0,0 +1,409 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  platform.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of Platform and PlatformWindow class functions,
+///         and of the function which picks a Platform to create.
+
+#include "platform.h"
+#include "glut_platform.h"
+#ifdef SKINNING_HAVE_GLFW
+#include "glfw_platform.h"
+#endif
+#ifdef SKINNING_HAVE_EGL
+#include "egl_platform.h"
+#endif
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+const char* const PLATFORM_TYPE_NAMES[N_PLATFORM_TYPES] = { "glut", "glfw", "egl" };
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Describes an 800x800 visible, double buffered window, placed by
+///         the window manager.
+WindowDesc::WindowDesc()
+    : x(-1),
+      y(-1),
+      width(800),
+      height(800),
+      double_buffered(true),
+      visible(true),
+      device(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a set of callbacks which are all null.
+WindowCallbacks::WindowCallbacks()
+    : reshape(nullptr),
+      display(nullptr),
+      keyboard(nullptr),
+      mouse_move(nullptr),
+      close(nullptr)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an open window with no callbacks.
+PlatformWindow::PlatformWindow(GLsizei width, GLsizei height)
+    : width_(width),
+      height_(height),
+      open_(true),
+      user_data_(nullptr),
+      redisplay_posted_(false),
+      context_lost_(false)
+{
+}
+
+PlatformWindow::~PlatformWindow()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the width of the window's drawable area, in pixels, as
+///         of the last reshape.
+GLsizei PlatformWindow::getWidth() const
+{
+    return width_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the height of the window's drawable area, in pixels, as
+///         of the last reshape.
+GLsizei PlatformWindow::getHeight() const
+{
+    return height_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the functions called when things happen to the window.
+void PlatformWindow::setCallbacks(const WindowCallbacks& callbacks)
+{
+    callbacks_ = callbacks;
+}
+
+const WindowCallbacks& PlatformWindow::getCallbacks() const
+{
+    return callbacks_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets a pointer for the callbacks to find their own state with,
+///         when a program has more than one window.
+void PlatformWindow::setUserData(void* data)
+{
+    user_data_ = data;
+}
+
+void* PlatformWindow::getUserData() const
+{
+    return user_data_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Asks for the window to be drawn the next time the RenderLoop
+///         gets to it.
+void PlatformWindow::postRedisplay()
+{
+    redisplay_posted_ = true;
+}
+
+bool PlatformWindow::isRedisplayPosted() const
+{
+    return redisplay_posted_ && open_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns whether a redisplay was posted, and clears it, so that
+///         the display callback can post the next one.
+bool PlatformWindow::takeRedisplay()
+{
+    bool posted = isRedisplayPosted();
+    redisplay_posted_ = false;
+    return posted;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns false once the window has been closed, after which it
+///         can only be destroyed.
+bool PlatformWindow::isOpen() const
+{
+    return open_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true once the window's context has been reset, by the
+///         driver or by a GPU fault, so that none of its objects can be
+///         used any more.  The context must be current.
+///
+/// \details Needs ARB_robustness, and a context created to be told about
+///         resets, which GLFW and EGL ask for; without them, this is
+///         always false.  GL only reports the reset until it has
+///         finished, so the answer is kept.
+bool PlatformWindow::isContextLost()
+{
+    if (!context_lost_ && GLEW_ARB_robustness)
+        context_lost_ = glGetGraphicsResetStatusARB() != GL_NO_ERROR;
+    return context_lost_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records the window's new size, calls the reshape callback and
+///         posts a redisplay.
+void PlatformWindow::notifyReshape(GLsizei width, GLsizei height)
+{
+    width_ = width;
+    height_ = height;
+    if (callbacks_.reshape != nullptr)
+        callbacks_.reshape(*this, width, height);
+    postRedisplay();
+}
+
+void PlatformWindow::notifyKeyboard(unsigned char key, int x, int y)
+{
+    if (callbacks_.keyboard != nullptr)
+        callbacks_.keyboard(*this, key, x, y);
+}
+
+void PlatformWindow::notifyMouseMove(int x, int y)
+{
+    if (callbacks_.mouse_move != nullptr)
+        callbacks_.mouse_move(*this, x, y);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Calls the close callback, then marks the window closed.
+void PlatformWindow::notifyClose()
+{
+    if (!open_)
+        return;
+
+    if (callbacks_.close != nullptr)
+        callbacks_.close(*this);
+    open_ = false;
+}
+
+Platform::Platform()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys every window which is left, newest first.
+Platform::~Platform()
+{
+    while (!windows_.empty())
+        destroyWindow(windows_.back());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of GPUs windows can be created on.  Only EGL
+///         can choose; the windowing libraries only have the one the window
+///         system picks.
+size_t Platform::getDeviceCount() const
+{
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a window and its context, and makes the context current.
+///
+/// \return null if the window couldn't be created; the reason has been
+///         reported to stderr.
+PlatformWindow* Platform::createWindow(const WindowDesc& desc)
+{
+    if (desc.device >= getDeviceCount())
+    {
+        std::cerr << "Can't create a window on device " << desc.device << "; the " << getPlatformTypeName(getType())
+                  << " platform has " << getDeviceCount() << "." << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<PlatformWindow> window = openWindow(desc);
+    if (!window)
+        return nullptr;
+
+    windows_.push_back(window.release());
+    return windows_.back();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys a window this created, with its context.
+void Platform::destroyWindow(PlatformWindow* window)
+{
+    std::vector<PlatformWindow*>::iterator it = std::find(windows_.begin(), windows_.end(), window);
+    if (it == windows_.end())
+        return;
+
+    windows_.erase(it);
+    delete window;
+}
+
+size_t Platform::getWindowCount() const
+{
+    return windows_.size();
+}
+
+PlatformWindow* Platform::getWindow(size_t index) const
+{
+    return windows_[index];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if any of the windows haven't been closed.
+bool Platform::hasOpenWindows() const
+{
+    for (size_t i = 0; i < windows_.size(); ++i)
+    {
+        if (windows_[i]->isOpen())
+            return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws a line of text at the current raster position, in a fixed
+///         function bitmap font.
+///
+/// \return false if the platform has no bitmap fonts, in which case nothing
+///         is drawn.  Only GLUT has them.
+bool Platform::drawText(const std::string& text)
+{
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Loads the GL entry points for the current context.
+///
+/// \details GLEW also looks for the GLX extensions on X11, and newer
+///         versions report an error if the context isn't a GLX one, as an
+///         EGL context isn't, after they've loaded everything else.  That
+///         error is ignored, since the GLX extensions are only used for
+///         swap intervals, which EGL sets itself.
+///
+/// \return false if the GL entry points couldn't be loaded.
+bool Platform::initGlew()
+{
+    GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY && getType() == PLATFORM_EGL)
+        err = GLEW_OK;
+#endif
+    if (err != GLEW_OK)
+    {
+        std::cerr << "Error initializing GLEW: " << glewGetErrorString(err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a Platform.
+///
+/// \details GLUT takes the arguments it recognizes out of argv, as
+///         glutInit() does, so this should be called before anything else
+///         parses the command line.
+///
+/// \return null if the platform wasn't built, or its library couldn't be
+///         initialized; the reason has been reported to stderr.
+Platform* createPlatform(PlatformType type, int& argc, char** argv)
+{
+    switch (type)
+    {
+        case PLATFORM_GLUT:
+            return new GlutPlatform(argc, argv);
+#ifdef SKINNING_HAVE_GLFW
+        case PLATFORM_GLFW:
+            return GlfwPlatform::create();
+#endif
+#ifdef SKINNING_HAVE_EGL
+        case PLATFORM_EGL:
+            return EglPlatform::create();
+#endif
+        default:
+            break;
+    }
+
+    std::cerr << "This build doesn't include the " << getPlatformTypeName(type) << " platform." << std::endl;
+    return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if createPlatform() can create a platform type.
+bool isPlatformBuilt(PlatformType type)
+{
+    switch (type)
+    {
+        case PLATFORM_GLUT:
+            return true;
+#ifdef SKINNING_HAVE_GLFW
+        case PLATFORM_GLFW:
+            return true;
+#endif
+#ifdef SKINNING_HAVE_EGL
+        case PLATFORM_EGL:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a platform type's name, e.g. "egl", for command lines.
+const char* getPlatformTypeName(PlatformType type)
+{
+    if (type >= N_PLATFORM_TYPES)
+        return "unknown";
+    return PLATFORM_TYPE_NAMES[type];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the platform type with a name, as from
+///         getPlatformTypeName().
+///
+/// \return false if no type has the name.
+bool parsePlatformType(const std::string& name, PlatformType& type)
+{
+    for (size_t i = 0; i < N_PLATFORM_TYPES; ++i)
+    {
+        if (name == PLATFORM_TYPE_NAMES[i])
+        {
+            type = PlatformType(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Looks for a "-platform name" option on the command line, which
+///         has to be known before the platform that parses the rest of the
+///         arguments is created.
+///
+/// \details The option is left in argv, for the program's own parsing to
+///         skip.
+///
+/// \param  type Set to the named type if the option is there; otherwise
+///         left alone.
+/// \return false if the option names a platform which doesn't exist.
+bool findPlatformOption(int argc, char** argv, PlatformType& type)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string(argv[i]) != "-platform")
+            continue;
+
+        if (!parsePlatformType(argv[i + 1], type))
+        {
+            std::cerr << "Unknown platform: " << argv[i + 1] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  platform.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the Platform and PlatformWindow classes, which
+///         hide the windowing library that creates GL contexts and delivers
+///         input.
+
+#ifndef PLATFORM_H_
+#define PLATFORM_H_
+
+#include "demo.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class PlatformWindow;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The windowing libraries a Platform can be built on.
+///
+/// \details GLUT is always built.  GLFW and EGL are built when the build
+///         defines SKINNING_HAVE_GLFW or SKINNING_HAVE_EGL, as CMakeLists.txt
+///         does when it finds them.  EGL has no windows; its PlatformWindows
+///         are offscreen surfaces, for running without a display.
+enum PlatformType
+{
+    PLATFORM_GLUT = 0,
+    PLATFORM_GLFW,
+    PLATFORM_EGL,
+    N_PLATFORM_TYPES
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  How to create a window.
+struct WindowDesc
+{
+    WindowDesc();
+
+    std::string title;
+    int x;                  ///< Where to put the window, or -1 to let the window manager decide.
+    int y;
+    GLsizei width;
+    GLsizei height;
+    bool double_buffered;
+    bool visible;           ///< false for a window which is only needed for its context.
+    size_t device;          ///< The GPU to create the context on, below Platform::getDeviceCount().
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The functions a PlatformWindow calls when things happen to it.
+///         Any of them may be null.
+///
+/// \details They're called from Platform::waitEvents() and RenderLoop::run(),
+///         with the window's context current.  close is called when the
+///         user asks for the window to be closed; GLUT destroys the window
+///         as soon as it returns, so that's the last chance to release GL
+///         objects.
+struct WindowCallbacks
+{
+    WindowCallbacks();
+
+    void (*reshape)(PlatformWindow& window, GLsizei width, GLsizei height);
+    void (*display)(PlatformWindow& window);
+    void (*keyboard)(PlatformWindow& window, unsigned char key, int x, int y);
+    void (*mouse_move)(PlatformWindow& window, int x, int y);
+    void (*close)(PlatformWindow& window);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A window, or an offscreen surface, with its own GL context.
+///
+/// \details Windows are created and destroyed by their Platform.  Drawing
+///         is asked for with postRedisplay(), and done by a RenderLoop,
+///         which calls the display callback; any number of posts before the
+///         loop gets to the window are coalesced into one.
+class PlatformWindow
+{
+public:
+    virtual ~PlatformWindow();
+
+    virtual void makeCurrent() = 0;
+    virtual void swapBuffers() = 0;
+    virtual bool setSwapInterval(int interval) = 0;
+
+    GLsizei getWidth() const;
+    GLsizei getHeight() const;
+    virtual void resize(GLsizei width, GLsizei height) = 0;
+
+    void setCallbacks(const WindowCallbacks& callbacks);
+    const WindowCallbacks& getCallbacks() const;
+    void setUserData(void* data);
+    void* getUserData() const;
+
+    void postRedisplay();
+    bool isRedisplayPosted() const;
+    bool takeRedisplay();
+
+    bool isOpen() const;
+    bool isContextLost();
+
+protected:
+    PlatformWindow(GLsizei width, GLsizei height);
+
+    void notifyReshape(GLsizei width, GLsizei height);
+    void notifyKeyboard(unsigned char key, int x, int y);
+    void notifyMouseMove(int x, int y);
+    void notifyClose();
+
+    GLsizei width_;
+    GLsizei height_;
+    bool open_;
+
+private:
+    WindowCallbacks callbacks_;
+    void* user_data_;
+    bool redisplay_posted_;
+    bool context_lost_;
+
+    // non-copyable
+    PlatformWindow(const PlatformWindow&);
+    void operator=(const PlatformWindow&);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates windows on a windowing library, and waits for and
+///         delivers their events.
+///
+/// \details Only one Platform should exist at a time, and it should only be
+///         used from the thread which created it.  The windows it creates
+///         are destroyed with it, or by destroyWindow().
+///
+///         A platform may be able to create contexts on more than one GPU,
+///         which can't share objects with each other.  GLEW's entry points
+///         are global, so every device has to be driven by the same GL
+///         library, as the GPUs of a machine are through libglvnd.
+class Platform
+{
+public:
+    virtual ~Platform();
+
+    virtual PlatformType getType() const = 0;
+    virtual size_t getDeviceCount() const;
+
+    PlatformWindow* createWindow(const WindowDesc& desc);
+    void destroyWindow(PlatformWindow* window);
+    size_t getWindowCount() const;
+    PlatformWindow* getWindow(size_t index) const;
+    bool hasOpenWindows() const;
+
+    virtual void waitEvents(double timeout_milliseconds) = 0;
+    virtual bool drawText(const std::string& text);
+
+    bool initGlew();
+
+protected:
+    Platform();
+
+    virtual std::unique_ptr<PlatformWindow> openWindow(const WindowDesc& desc) = 0;
+
+private:
+    std::vector<PlatformWindow*> windows_;
+
+    // non-copyable
+    Platform(const Platform&);
+    void operator=(const Platform&);
+};
+
+Platform* createPlatform(PlatformType type, int& argc, char** argv);
+bool isPlatformBuilt(PlatformType type);
+
+const char* getPlatformTypeName(PlatformType type);
+bool parsePlatformType(const std::string& name, PlatformType& type);
+bool findPlatformOption(int argc, char** argv, PlatformType& type);
+
+#endif
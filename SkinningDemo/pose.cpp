@@ -0,0 +1,546 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  pose.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of pose-related functions.
+
+#include "pose.h"
+#include "joint_rotation.h"
+#include "simd_math.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a difference of angles, in turns, to the nearest whole
+///         turn, with halves rounded away from zero.
+///
+/// \details Rounding halves away from zero, rather than up or to even,
+///         treats a and b alike: two angles exactly opposite each other
+///         are blended along the same half of the circle in either order.
+///         lerpAngleStream() rounds its SIMD blocks the same way, so every
+///         joint of a pose does.
+float roundTurns(float turns)
+{
+    float rounded = std::floor(std::abs(turns) + 0.5f);
+    return turns < 0 ? -rounded : rounded;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Interpolates between two streams of angles in degrees, each
+///         along the shorter way around the circle.
+///
+/// \param  a The stream of angles to use when t == 0.
+/// \param  b The stream of angles to use when t == 1.
+/// \param  t The interpolation factor.
+/// \param  out The stream which receives the results.  It may alias a or b.
+/// \param  count The number of angles in each stream.
+void lerpAngleStream(const float* a, const float* b, float t, float* out, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    // SSE2 has no floor, but truncating floors the magnitude, and the sign
+    // goes back on after, as roundTurns() rounds.  A conversion's own
+    // rounding would take halves to even instead.
+    const __m128 t4 = _mm_set1_ps(t);
+    const __m128 turn = _mm_set1_ps(360.0f);
+    const __m128 inverse_turn = _mm_set1_ps(1.0f / 360.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a4 = _mm_loadu_ps(a + i);
+        __m128 delta = _mm_sub_ps(_mm_loadu_ps(b + i), a4);
+        __m128 turns = _mm_mul_ps(delta, inverse_turn);
+        __m128 sign = _mm_and_ps(turns, sign_mask);
+        turns = _mm_add_ps(_mm_andnot_ps(sign_mask, turns), half);
+        turns = _mm_or_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(turns)), sign);
+        delta = _mm_sub_ps(delta, _mm_mul_ps(turns, turn));
+        _mm_storeu_ps(out + i, _mm_add_ps(a4, _mm_mul_ps(delta, t4)));
+    }
+#endif
+
+    for (; i < count; ++i)
+        out[i] = lerpAngle(a[i], b[i], t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a stream of offsets, scaled, to a stream of floats.
+///
+/// \param  base The stream of values to add to.
+/// \param  delta The stream of offsets.
+/// \param  t How much of each offset to add.
+/// \param  out The stream which receives base + delta * t.  It may alias
+///         base or delta.
+/// \param  count The number of floats in each stream.
+void multiplyAddStream(const float* base, const float* delta, float t, float* out, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 t4 = _mm_set1_ps(t);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(base + i), _mm_mul_ps(_mm_loadu_ps(delta + i), t4)));
+#endif
+
+    for (; i < count; ++i)
+        out[i] = base[i] + delta[i] * t;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a byte count up to the next multiple of 16.
+size_t roundUp16(size_t bytes)
+{
+    return (bytes + 15) & ~size_t(15);
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs an empty pose which does not refer to any joint data.
+Pose::Pose()
+    : joint_count(0),
+      translation(nullptr),
+      rotation(nullptr),
+      scale(nullptr),
+      color(nullptr)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs a new pose pool.  No memory is allocated until the
+///         first pose is allocated.
+///
+/// \param  joint_count The number of joints in every pose from this pool.
+/// \param  poses_per_chunk The number of poses to allocate space for each
+///         time the pool runs out of free poses.
+/// \param  colors Whether the poses get a color stream; without one, their
+///         color pointers are null.
+/// \param  topology Allocates the chunks on node, or null to allocate them
+///         from the heap.  It must outlive the pool.
+/// \param  node The NUMA node the poses are for.
+PosePool::PosePool(size_t joint_count, size_t poses_per_chunk, bool colors,
+                   const NumaTopology* topology, size_t node)
+    : joint_count_(joint_count),
+      poses_per_chunk_(poses_per_chunk),
+      colors_(colors),
+      topology_(topology),
+      node_(node)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the pool, releasing the memory for all of its poses,
+///         including ones which have not been released.
+PosePool::~PosePool()
+{
+    for (size_t i = 0; i < chunks_.size(); ++i)
+    {
+        if (topology_ != nullptr)
+            topology_->release(chunks_[i], getChunkSize());
+        else
+            delete[] chunks_[i];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates the channel data for a new pose.  The contents of the
+///         channels are undefined.
+Pose PosePool::allocate()
+{
+    if (free_list_.empty())
+        grow();
+
+    char* block = free_list_.back();
+    free_list_.pop_back();
+
+    size_t n = joint_count_;
+    Pose pose;
+    pose.joint_count = n;
+    pose.translation = reinterpret_cast<vec2*>(block);
+    block += roundUp16(n * sizeof(vec2));
+    pose.rotation = reinterpret_cast<float*>(block);
+    block += roundUp16(n * sizeof(float));
+    pose.scale = reinterpret_cast<float*>(block);
+    block += roundUp16(n * sizeof(float));
+    pose.color = colors_ ? reinterpret_cast<color4*>(block) : nullptr;
+    return pose;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a pose's channel data to the pool so that it can be
+///         reused.  The pose is reset to an empty pose.
+///
+/// \param  pose A pose previously returned by allocate().
+void PosePool::release(Pose& pose)
+{
+    if (pose.translation == nullptr)
+        return;
+
+    assert(pose.joint_count == joint_count_ && (pose.color != nullptr) == colors_);
+    free_list_.push_back(reinterpret_cast<char*>(pose.translation));
+    pose = Pose();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in each pose from this pool.
+size_t PosePool::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the poses from this pool have a color stream.
+bool PosePool::hasColors() const
+{
+    return colors_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of bytes needed to hold all the channel
+///         streams of a pose, including the padding which keeps each stream
+///         16-byte aligned.
+///
+/// \param  joint_count The number of joints in the pose.
+/// \param  colors Whether to count the color stream.
+size_t PosePool::getPoseSize(size_t joint_count, bool colors)
+{
+    return roundUp16(joint_count * sizeof(vec2)) +
+           roundUp16(joint_count * sizeof(float)) * 2 +
+           (colors ? roundUp16(joint_count * sizeof(color4)) : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of each chunk, with room to align it.
+size_t PosePool::getChunkSize() const
+{
+    return getPoseSize(joint_count_, colors_) * poses_per_chunk_ + 15;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates a new chunk of memory and adds the poses in it to the
+///         free list.
+void PosePool::grow()
+{
+    size_t pose_size = getPoseSize(joint_count_, colors_);
+    char* chunk = topology_ != nullptr ? static_cast<char*>(topology_->allocate(getChunkSize(), node_))
+                                       : new char[getChunkSize()];
+    chunks_.push_back(chunk);
+
+    char* aligned = reinterpret_cast<char*>(roundUp16(reinterpret_cast<size_t>(chunk)));
+
+    free_list_.reserve(chunks_.size() * poses_per_chunk_);
+    for (size_t i = poses_per_chunk_; i > 0; --i)
+        free_list_.push_back(aligned + (i - 1) * pose_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates and returns a matrix which transforms coordinates from
+///         a joint's local coordinate space to the joint's parent's coordinate
+///         space.
+///
+/// \details The result is equivalent to translate(T) * rotate(R) * scale(S),
+///         but the matrix is written out directly instead of performing
+///         three full 4x4 matrix multiplies, and the sine and cosine come
+///         from sinCosDegrees() rather than the C library.
+///
+/// \param  pose The pose containing the joint.
+/// \param  joint The index of the joint to generate the transform for.
+/// \return The joint's local-to-parent transformation matrix.
+mat4 getJointLocalTransform(const Pose& pose, size_t joint)
+{
+    float s, c;
+    sinCosDegrees(pose.rotation[joint], s, c);
+    s *= pose.scale[joint];
+    c *= pose.scale[joint];
+
+    return mat4(   c,    s, 0, 0,
+                  -s,    c, 0, 0,
+                   0,    0, pose.scale[joint], 0,
+                pose.translation[joint].x, pose.translation[joint].y, 0, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates the local-to-parent transform of a joint in a blend of
+///         two poses, without storing the blended pose.
+///
+/// \details The channels are blended exactly as blendPoses() blends them,
+///         so this is the same transform getJointLocalTransform() would find
+///         in the blended pose.  The blended values never leave registers,
+///         so a pass which goes straight on to the joint's model transform
+///         (see SkeletonEval::blendJointTransforms()) reads each source pose
+///         once and writes nothing but the transforms.
+///
+/// \param  a The pose to use when t == 0.
+/// \param  b The pose to use when t == 1.
+/// \param  t The interpolation factor.
+/// \param  joint The index of the joint to generate the transform for.
+/// \return The joint's local-to-parent transformation matrix.
+mat4 getBlendedJointLocalTransform(const Pose& a, const Pose& b, float t, size_t joint)
+{
+    vec2 translation = a.translation[joint] + (b.translation[joint] - a.translation[joint]) * t;
+    float scale = a.scale[joint] + (b.scale[joint] - a.scale[joint]) * t;
+
+    float s, c;
+    sinCosDegrees(lerpAngle(a.rotation[joint], b.rotation[joint], t), s, c);
+    s *= scale;
+    c *= scale;
+
+    return mat4(   c,    s, 0, 0,
+                  -s,    c, 0, 0,
+                   0,    0, scale, 0,
+                translation.x, translation.y, 0, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates the local-to-parent transforms of many joints at once.
+///
+/// \details When SSE2 is available, four joints are processed per iteration:
+///         the channel streams are loaded directly, the sines and cosines
+///         come from sinCosDegrees() four at a time, and the matrix columns
+///         are built four joints at a time, then transposed into per-joint
+///         matrices.  Any leftover joints are handled by
+///         getJointLocalTransform().
+///
+/// \param  pose The pose containing the joints.
+/// \param  transforms An array of pose.joint_count matrices which will
+///         receive the joints' local-to-parent transforms.
+void computeLocalTransforms(const Pose& pose, mat4* transforms)
+{
+    size_t joint_count = pose.joint_count;
+    size_t joint = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (; joint + 4 <= joint_count; joint += 4)
+    {
+        ALIGN16 float cos_values[4];
+        ALIGN16 float sin_values[4];
+        sinCosDegrees(&pose.rotation[joint], 4, sin_values, cos_values);
+
+        __m128 scale = _mm_load_ps(&pose.scale[joint]);
+        __m128 c = _mm_mul_ps(_mm_load_ps(cos_values), scale);
+        __m128 s = _mm_mul_ps(_mm_load_ps(sin_values), scale);
+        __m128 neg_s = _mm_sub_ps(zero, s);
+
+        // de-interleave the xy translation pairs into x and y streams.
+        __m128 t01 = _mm_load_ps(&pose.translation[joint].x);
+        __m128 t23 = _mm_load_ps(&pose.translation[joint + 2].x);
+        __m128 tx = _mm_shuffle_ps(t01, t23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 ty = _mm_shuffle_ps(t01, t23, _MM_SHUFFLE(3, 1, 3, 1));
+
+        // Each group of four vectors holds one matrix column for each of
+        // the four joints in SoA form; transposing turns them into one
+        // column vector per joint.
+        __m128 col0_0 = c,      col0_1 = s,    col0_2 = zero,  col0_3 = zero;
+        __m128 col1_0 = neg_s,  col1_1 = c,    col1_2 = zero,  col1_3 = zero;
+        __m128 col2_0 = zero,   col2_1 = zero, col2_2 = scale, col2_3 = zero;
+        __m128 col3_0 = tx,     col3_1 = ty,   col3_2 = zero,  col3_3 = one;
+        _MM_TRANSPOSE4_PS(col0_0, col0_1, col0_2, col0_3);
+        _MM_TRANSPOSE4_PS(col1_0, col1_1, col1_2, col1_3);
+        _MM_TRANSPOSE4_PS(col2_0, col2_1, col2_2, col2_3);
+        _MM_TRANSPOSE4_PS(col3_0, col3_1, col3_2, col3_3);
+
+        float* out = &transforms[joint][0][0];
+        _mm_storeu_ps(out +  0, col0_0); _mm_storeu_ps(out +  4, col1_0); _mm_storeu_ps(out +  8, col2_0); _mm_storeu_ps(out + 12, col3_0);
+        _mm_storeu_ps(out + 16, col0_1); _mm_storeu_ps(out + 20, col1_1); _mm_storeu_ps(out + 24, col2_1); _mm_storeu_ps(out + 28, col3_1);
+        _mm_storeu_ps(out + 32, col0_2); _mm_storeu_ps(out + 36, col1_2); _mm_storeu_ps(out + 40, col2_2); _mm_storeu_ps(out + 44, col3_2);
+        _mm_storeu_ps(out + 48, col0_3); _mm_storeu_ps(out + 52, col1_3); _mm_storeu_ps(out + 56, col2_3); _mm_storeu_ps(out + 60, col3_3);
+    }
+#endif
+
+    for (; joint < joint_count; ++joint)
+        transforms[joint] = getJointLocalTransform(pose, joint);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Generates the local-to-parent transforms of many joints, a vec4
+///         each instead of a matrix, for uploading.
+///
+/// \details Each is (cos * scale, sin * scale, x, y), which is all of
+///         getJointLocalTransform()'s matrix that varies: the z scale is the
+///         length of the first two, as long as the scale is positive, and
+///         the rest is constant.  That's a quarter of the matrix's size.
+///
+/// \param  pose The pose containing the joints.
+/// \param  locals An array of pose.joint_count vectors which will receive
+///         the joints' compact local-to-parent transforms.
+void computeCompactLocalTransforms(const Pose& pose, vec4* locals)
+{
+    for (size_t joint = 0; joint < pose.joint_count; ++joint)
+    {
+        float s, c;
+        sinCosDegrees(pose.rotation[joint], s, c);
+        float scale = pose.scale[joint];
+        locals[joint] = vec4(c * scale, s * scale, pose.translation[joint]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies all of the joint data from one pose to another.
+///
+/// \details Since the channel streams of a pose are allocated as a single
+///         block, this is a single memcpy.  The colors come last, so they
+///         are copied only if both poses have them; otherwise the
+///         destination's colors, if any, are left as they were.
+///
+/// \param  source The pose to copy from.
+/// \param  destination The pose to copy to.  It must have the same number
+///         of joints as source.
+void copyPose(const Pose& source, Pose& destination)
+{
+    assert(source.joint_count == destination.joint_count);
+    bool colors = source.color != nullptr && destination.color != nullptr;
+    std::memcpy(static_cast<void*>(destination.translation), source.translation,
+                PosePool::getPoseSize(source.joint_count, colors));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies all of the joint data from one pose to another with
+///         non-temporal stores, for snapshots which won't be read again soon.
+///
+/// \details A Pose holds nothing but pointers into one 16-byte aligned
+///         block, whose size is a multiple of 16, so the copy is the block
+///         streamed across in 16-byte stores with _mm_stream_ps().  They go
+///         around the cache, so filling in many poses, or a pose another
+///         thread will pick up, doesn't push the poses being worked on out
+///         of it.  The stores are fenced before returning, so the copy can
+///         be handed to another thread.  Colors are copied as in copyPose().
+///         If either pose isn't in an aligned block, or there's no SSE2,
+///         this is just copyPose().
+///
+/// \param  source The pose to copy from.
+/// \param  destination The pose to copy to.  It must have the same number
+///         of joints as source, and is never read.
+void streamCopyPose(const Pose& source, Pose& destination)
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const float* from = &source.translation[0].x;
+    float* to = &destination.translation[0].x;
+    if (((reinterpret_cast<size_t>(from) | reinterpret_cast<size_t>(to)) & 15) == 0)
+    {
+        assert(source.joint_count == destination.joint_count);
+        bool colors = source.color != nullptr && destination.color != nullptr;
+        size_t floats = PosePool::getPoseSize(source.joint_count, colors) / sizeof(float);
+        for (size_t i = 0; i < floats; i += 4)
+            _mm_stream_ps(to + i, _mm_load_ps(from + i));
+        _mm_sfence();
+        return;
+    }
+#endif
+
+    copyPose(source, destination);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Interpolates between two angles along the shorter way around the
+///         circle.
+///
+/// \details Lerping the angles themselves would take the long way whenever
+///         they are more than 180 degrees apart; 255 to 15 degrees would
+///         turn back 240 degrees instead of forward 120.  In 2D this
+///         interpolates at a constant angular speed, like a slerp.
+///
+/// \param  a The angle in degrees to use when t == 0.
+/// \param  b The angle in degrees to use when t == 1.
+/// \param  t The interpolation factor.
+/// \return An angle t of the way from a to b, which may be outside
+///         [0, 360).  If a and b are exactly opposite, a to b and b to a
+///         pass through the same half of the circle.
+float lerpAngle(float a, float b, float t)
+{
+    float delta = b - a;
+    delta -= 360.0f * roundTurns(delta * (1.0f / 360.0f));
+    return a + delta * t;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Blends two poses of the same skeleton together.
+///
+/// \details Every channel is linearly interpolated, except that rotations
+///         turn the shorter way, as lerpAngle().  Colors are blended only
+///         if all three poses have them.
+///         Since poses contain no hierarchy information, each channel is
+///         just a flat stream of floats, and is blended several floats at a
+///         time.
+///
+/// \param  a The pose to use when t == 0.
+/// \param  b The pose to use when t == 1.
+/// \param  t The interpolation factor.
+/// \param  out The pose which receives the blended result.  It may be the
+///         same object as a or b.  All three poses must have the same number
+///         of joints.
+void blendPoses(const Pose& a, const Pose& b, float t, Pose& out)
+{
+    size_t n = out.joint_count;
+    assert(a.joint_count == n && b.joint_count == n);
+
+    lerpFloats(&a.translation[0].x, &b.translation[0].x, t, &out.translation[0].x, n * 2);
+    lerpAngleStream(a.rotation, b.rotation, t, out.rotation, n);
+    lerpFloats(a.scale, b.scale, t, out.scale, n);
+    if (a.color != nullptr && b.color != nullptr && out.color != nullptr)
+        lerpFloats(&a.color[0].r, &b.color[0].r, t, &out.color[0].r, n * 4);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stores the difference between a pose and the pose it was
+///         authored relative to, for addPoseDelta() to layer onto others.
+///
+/// \details Each rotation's difference is taken the shorter way around the
+///         circle, as lerpAngle(), so that scaling it down turns a joint
+///         part of the way there rather than the long way round.  The
+///         delta's colors, if any, are left as they were; additive layers
+///         don't change colors.
+///
+/// \param  pose The pose the layer was authored as.
+/// \param  reference The pose the layer is relative to, such as the bind
+///         pose.
+/// \param  delta The pose which receives pose - reference.  It may be the
+///         same object as pose.  All three poses must have the same number
+///         of joints.
+void makeAdditivePose(const Pose& pose, const Pose& reference, Pose& delta)
+{
+    size_t n = delta.joint_count;
+    assert(pose.joint_count == n && reference.joint_count == n);
+
+    for (size_t joint = 0; joint < n; ++joint)
+    {
+        float rotation = pose.rotation[joint] - reference.rotation[joint];
+        delta.translation[joint] = pose.translation[joint] - reference.translation[joint];
+        delta.rotation[joint] = rotation - 360.0f * std::floor(rotation / 360.0f + 0.5f);
+        delta.scale[joint] = pose.scale[joint] - reference.scale[joint];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Layers a delta from makeAdditivePose() onto a pose.
+///
+/// \details Since the delta was taken ahead of time, every channel is one
+///         multiply-add per float, several floats at a time, with no
+///         reference pose to read or subtract.  The colors are the base's,
+///         if both it and out have them.
+///
+/// \param  base The pose to add the layer to.
+/// \param  delta The layer.
+/// \param  t How much of the layer to add; 1 for all of it.
+/// \param  out The pose which receives the result.  It may be the same
+///         object as base.  All three poses must have the same number of
+///         joints.
+void addPoseDelta(const Pose& base, const Pose& delta, float t, Pose& out)
+{
+    size_t n = out.joint_count;
+    assert(base.joint_count == n && delta.joint_count == n);
+
+    multiplyAddStream(&base.translation[0].x, &delta.translation[0].x, t, &out.translation[0].x, n * 2);
+    multiplyAddStream(base.rotation, delta.rotation, t, out.rotation, n);
+    multiplyAddStream(base.scale, delta.scale, t, out.scale, n);
+    if (base.color != nullptr && out.color != nullptr && base.color != out.color)
+        std::memcpy(static_cast<void*>(out.color), base.color, n * sizeof(color4));
+}
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  pose.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the Pose struct and PosePool class.
+
+#ifndef POSE_H_
+#define POSE_H_
+
+#include "demo.h"
+#include "numa_topology.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Defines the pose of a skeletal system.
+///
+/// \details Each joint in a pose is really just a local coordinate system
+///         defined by a translation, rotation (in degrees), and uniform
+///         scale relative to the parent joint's coordinate system.  The
+///         parent joint is not stored here; the joint hierarchy is a
+///         property of the Skeleton the pose is applied to, and joints are
+///         stored in the same order as the Skeleton's joints.
+///
+///         The pose is stored as a structure of arrays: each channel is a
+///         separate contiguous, 16-byte aligned stream, so that
+///         computeLocalTransforms() can load several joints' worth of a
+///         channel with a single SIMD instruction.
+///
+///         A Pose does not own its channel data; the streams are allocated
+///         in a single block from a PosePool (see Skeleton::allocatePose()).
+///         Copying a Pose object copies the pointers, not the data; use
+///         copyPose() to copy the joint data itself, or streamCopyPose()
+///         for a snapshot another thread will read.
+///
+///         Colors are only for visualization, so they're an optional stream
+///         at the end of the block, which a pool only allocates if it was
+///         asked to.  Without them, a pose is nothing but its transforms,
+///         in half the memory; copyPose() and blendPoses() only touch colors
+///         when every pose involved has them.
+struct Pose
+{
+    Pose();
+
+    size_t joint_count;     ///< The number of joints in each stream.
+    vec2* translation;      ///< Each joint's translation relative to its parent.
+    float* rotation;        ///< Each joint's rotation in degrees about the z axis.
+    float* scale;           ///< Each joint's uniform scale factor.
+    color4* color;          ///< Each joint's visualization color, or null if the pose has none.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates and recycles the channel data for poses which all have
+///         the same number of joints.
+///
+/// \details Pose data is carved out of large 16-byte aligned chunks, and
+///         released poses are kept on a free list for reuse, so once the pool
+///         has grown to its working size, allocating and releasing poses
+///         never touches the heap.  Given a NUMA node, the chunks are
+///         allocated on it, for poses only ever worked on by its threads.
+class PosePool
+{
+public:
+    explicit PosePool(size_t joint_count, size_t poses_per_chunk = 64, bool colors = false,
+                      const NumaTopology* topology = nullptr, size_t node = NumaTopology::ANY_NODE);
+    ~PosePool();
+
+    Pose allocate();
+    void release(Pose& pose);
+
+    size_t getJointCount() const;
+    bool hasColors() const;
+
+    static size_t getPoseSize(size_t joint_count, bool colors);
+
+private:
+    PosePool(const PosePool&);              // non-copyable
+    PosePool& operator=(const PosePool&);   // non-copyable
+
+    void grow();
+    size_t getChunkSize() const;
+
+    size_t joint_count_;
+    size_t poses_per_chunk_;
+    bool colors_;               ///< Whether the poses have a color stream.
+    const NumaTopology* topology_;  ///< Allocates the chunks, if not null.
+    size_t node_;
+    std::vector<char*> chunks_;
+    std::vector<char*> free_list_;
+};
+
+mat4 getJointLocalTransform(const Pose& pose, size_t joint);
+mat4 getBlendedJointLocalTransform(const Pose& a, const Pose& b, float t, size_t joint);
+void computeLocalTransforms(const Pose& pose, mat4* transforms);
+void computeCompactLocalTransforms(const Pose& pose, vec4* locals);
+
+void copyPose(const Pose& source, Pose& destination);
+void streamCopyPose(const Pose& source, Pose& destination);
+float lerpAngle(float a, float b, float t);
+void blendPoses(const Pose& a, const Pose& b, float t, Pose& out);
+void makeAdditivePose(const Pose& pose, const Pose& reference, Pose& delta);
+void addPoseDelta(const Pose& base, const Pose& delta, float t, Pose& out);
+
+#endif
@@ -0,0 +1,620 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  pose_codec.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of PoseEncoder, PoseDecoder and PoseReplayBuffer
+///         class functions.
+
+#include "pose_codec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+enum PoseChannel
+{
+    CHANNEL_TRANSLATION_X = 0,
+    CHANNEL_TRANSLATION_Y,
+    CHANNEL_ROTATION,
+    CHANNEL_SCALE,
+    N_CHANNELS
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Appends values to a packet, a few bits at a time, starting from
+///         the least significant bit of each byte.
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<unsigned char>& bytes)
+        : bytes_(bytes),
+          bit_(0)
+    {
+        bytes_.clear();
+    }
+
+    // a byte's worth of bits at a time, rather than one.
+    void write(GLuint value, size_t bits)
+    {
+        while (bits > 0)
+        {
+            size_t used = bit_ % 8;
+            if (used == 0)
+                bytes_.push_back(0);
+            size_t count = std::min(8 - used, bits);
+            bytes_.back() |= (unsigned char)((value & ((1u << count) - 1)) << used);
+            value >>= count;
+            bits -= count;
+            bit_ += count;
+        }
+    }
+
+private:
+    std::vector<unsigned char>& bytes_;
+    size_t bit_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads back what a BitWriter wrote, refusing to read past the end
+///         of the packet.
+class BitReader
+{
+public:
+    BitReader(const unsigned char* bytes, size_t size)
+        : bytes_(bytes),
+          bit_count_(size * 8),
+          bit_(0)
+    {
+    }
+
+    bool read(GLuint& value, size_t bits)
+    {
+        if (bit_count_ - bit_ < bits)
+            return false;
+
+        value = 0;
+        for (size_t shift = 0; shift < bits; )
+        {
+            size_t used = bit_ % 8;
+            size_t count = std::min(8 - used, bits - shift);
+            GLuint byte = (bytes_[bit_ / 8] >> used) & ((1u << count) - 1);
+            value |= byte << shift;
+            shift += count;
+            bit_ += count;
+        }
+        return true;
+    }
+
+private:
+    const unsigned char* bytes_;
+    size_t bit_count_;
+    size_t bit_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Maps small negative deltas to small unsigned values, so that
+///         they can be written with few bits: 0, -1, 1, -2... become 0, 1,
+///         2, 3...
+GLuint zigzag(GLuint delta)
+{
+    return (delta << 1) ^ (0u - (delta >> 31));
+}
+
+GLuint unzigzag(GLuint value)
+{
+    return (value >> 1) ^ (0u - (value & 1u));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of bits needed to write a value.
+size_t getBitWidth(GLuint value)
+{
+    size_t bits = 0;
+    while (value != 0)
+    {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds a value to the nearest multiple of a step, clamped to the
+///         range of a GLint.
+GLint quantize(float value, float step)
+{
+    double steps = std::floor(double(value) / step + 0.5);
+    steps = std::min(std::max(steps, -2147483648.0), 2147483647.0);
+    return GLint(steps);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Quantizes a pose's channels, channel by channel.
+void quantizePose(const Pose& pose, const PoseQuantization& quantization, GLint* values)
+{
+    size_t joint_count = pose.joint_count;
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        values[CHANNEL_TRANSLATION_X * joint_count + joint] = quantize(pose.translation[joint].x, quantization.translation);
+        values[CHANNEL_TRANSLATION_Y * joint_count + joint] = quantize(pose.translation[joint].y, quantization.translation);
+        values[CHANNEL_ROTATION * joint_count + joint] = quantize(pose.rotation[joint], quantization.rotation);
+        values[CHANNEL_SCALE * joint_count + joint] = quantize(pose.scale[joint], quantization.scale);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes quantized channels back into a pose's streams.  Colors
+///         are left alone.
+void dequantizePose(const GLint* values, const PoseQuantization& quantization, Pose& pose)
+{
+    size_t joint_count = pose.joint_count;
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        pose.translation[joint] = vec2(values[CHANNEL_TRANSLATION_X * joint_count + joint] * quantization.translation,
+                                       values[CHANNEL_TRANSLATION_Y * joint_count + joint] * quantization.translation);
+        pose.rotation[joint] = values[CHANNEL_ROTATION * joint_count + joint] * quantization.rotation;
+        pose.scale[joint] = values[CHANNEL_SCALE * joint_count + joint] * quantization.scale;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the deltas of a pose's quantized channels from a
+///         baseline's: each channel's width, then each joint's changed bits
+///         and deltas (see PoseEncoder).
+///
+/// \param  values The pose's channels, channel by channel.
+/// \param  base The baseline's channels, or null for all zeros.
+/// \param  deltas Scratch space for N_CHANNELS * joint_count deltas.
+void writeDeltas(const GLint* values, const GLint* base, size_t joint_count, GLuint* deltas, BitWriter& writer)
+{
+    size_t widths[N_CHANNELS] = {};
+    for (size_t channel = 0; channel < N_CHANNELS; ++channel)
+    {
+        GLuint widest = 0;
+        for (size_t joint = 0; joint < joint_count; ++joint)
+        {
+            size_t i = channel * joint_count + joint;
+            deltas[i] = zigzag(GLuint(values[i]) - (base != nullptr ? GLuint(base[i]) : 0));
+            widest |= deltas[i];
+        }
+        widths[channel] = getBitWidth(widest);
+    }
+
+    for (size_t channel = 0; channel < N_CHANNELS; ++channel)
+        writer.write(GLuint(widths[channel]), 6);
+
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        GLuint changed = 0;
+        for (size_t channel = 0; channel < N_CHANNELS; ++channel)
+        {
+            if (deltas[channel * joint_count + joint] != 0)
+                changed |= 1u << channel;
+        }
+
+        writer.write(changed != 0 ? 1 : 0, 1);
+        if (changed == 0)
+            continue;
+
+        writer.write(changed, N_CHANNELS);
+        for (size_t channel = 0; channel < N_CHANNELS; ++channel)
+        {
+            if (changed & (1u << channel))
+                writer.write(deltas[channel * joint_count + joint], widths[channel]);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads what writeDeltas() wrote, adding the deltas onto a
+///         baseline's channels.
+///
+/// \param  values The baseline's channels, which become the pose's.
+/// \return false if the deltas are malformed.
+bool readDeltas(BitReader& reader, size_t joint_count, GLint* values)
+{
+    size_t widths[N_CHANNELS];
+    for (size_t channel = 0; channel < N_CHANNELS; ++channel)
+    {
+        GLuint width;
+        if (!reader.read(width, 6) || width > 32)
+            return false;
+        widths[channel] = width;
+    }
+
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        GLuint changed;
+        if (!reader.read(changed, 1))
+            return false;
+        if (changed == 0)
+            continue;
+
+        if (!reader.read(changed, N_CHANNELS))
+            return false;
+        for (size_t channel = 0; channel < N_CHANNELS; ++channel)
+        {
+            if ((changed & (1u << channel)) == 0)
+                continue;
+
+            GLuint delta;
+            if (!reader.read(delta, widths[channel]))
+                return false;
+            size_t i = channel * joint_count + joint;
+            values[i] = GLint(GLuint(values[i]) + unzigzag(delta));
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the default steps, which are well below what can be seen at
+///         the demo's scale; a rotation step of 360/65536 degrees matches
+///         16-bit angles.
+PoseQuantization::PoseQuantization()
+    : translation(1.0f / 4096.0f),
+      rotation(360.0f / 65536.0f),
+      scale(1.0f / 4096.0f)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an encoder for poses of a skeleton.
+///
+/// \param  history The number of sent poses which can be acknowledged.  The
+///         decoder's should be the same.
+PoseEncoder::PoseEncoder(size_t joint_count, const PoseQuantization& quantization, size_t history)
+    : joint_count_(joint_count),
+      quantization_(quantization),
+      next_sequence_(1),
+      sequences_(std::max(history, size_t(1)), 0),
+      history_(sequences_.size() * N_CHANNELS * joint_count),
+      baseline_sequence_(0),
+      baseline_(N_CHANNELS * joint_count),
+      deltas_(N_CHANNELS * joint_count)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Encodes a pose into a packet.
+///
+/// \param  packet Replaced with the encoded pose.
+/// \return The packet's sequence number, which the receiver acknowledges.
+GLuint PoseEncoder::encode(const Pose& pose, std::vector<unsigned char>& packet)
+{
+    assert(pose.joint_count == joint_count_);
+
+    GLuint sequence = next_sequence_++;
+    if (next_sequence_ == 0)
+        next_sequence_ = 1;
+
+    size_t channel_count = N_CHANNELS * joint_count_;
+    size_t slot = sequence % sequences_.size();
+    sequences_[slot] = sequence;
+    GLint* values = channel_count > 0 ? &history_[slot * channel_count] : nullptr;
+    quantizePose(pose, quantization_, values);
+
+    GLuint baseline_sequence = baseline_sequence_;
+    if (baseline_sequence != 0 && sequence - baseline_sequence >= sequences_.size())
+        baseline_sequence = 0;
+
+    BitWriter writer(packet);
+    writer.write(sequence, 32);
+    writer.write(baseline_sequence, 32);
+    writer.write(GLuint(joint_count_), 32);
+    writeDeltas(values, baseline_sequence != 0 ? baseline_.data() : nullptr, joint_count_, deltas_.data(), writer);
+    return sequence;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records that the receiver has decoded a packet, which makes it
+///         the baseline for the packets after it.
+///
+/// \details Acknowledgements can arrive out of order; ones older than the
+///         baseline, or whose poses aren't in the history any more, are
+///         ignored.
+void PoseEncoder::acknowledge(GLuint sequence)
+{
+    if (sequence == 0)
+        return;
+    if (baseline_sequence_ != 0 && GLint(sequence - baseline_sequence_) <= 0)
+        return;
+
+    size_t slot = sequence % sequences_.size();
+    if (sequences_[slot] != sequence)
+        return;
+
+    size_t channel_count = N_CHANNELS * joint_count_;
+    std::copy(history_.begin() + slot * channel_count, history_.begin() + (slot + 1) * channel_count, baseline_.begin());
+    baseline_sequence_ = sequence;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the sequence number of the acknowledged packet the next
+///         one will be a delta from, or 0 if there isn't one.
+GLuint PoseEncoder::getBaseline() const
+{
+    return baseline_sequence_;
+}
+
+size_t PoseEncoder::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a decoder for poses of a skeleton.
+///
+/// \param  quantization Must be the encoder's.
+/// \param  history The number of decoded poses kept as baselines.
+PoseDecoder::PoseDecoder(size_t joint_count, const PoseQuantization& quantization, size_t history)
+    : joint_count_(joint_count),
+      quantization_(quantization),
+      sequences_(std::max(history, size_t(1)), 0),
+      history_(sequences_.size() * N_CHANNELS * joint_count),
+      current_(N_CHANNELS * joint_count)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decodes a packet into a pose.
+///
+/// \param  pose Has its translation, rotation and scale streams overwritten;
+///         it must have the decoder's joint count.
+/// \param  sequence Set to the packet's sequence number.
+/// \return false if the packet is malformed, is for another skeleton, or is
+///         a delta from a pose this hasn't decoded (or has forgotten), in
+///         which case the pose is left alone.
+bool PoseDecoder::decode(const unsigned char* packet, size_t size, Pose& pose, GLuint& sequence)
+{
+    assert(pose.joint_count == joint_count_);
+
+    BitReader reader(packet, size);
+    GLuint packet_sequence, baseline_sequence, joint_count;
+    if (!reader.read(packet_sequence, 32) || !reader.read(baseline_sequence, 32) || !reader.read(joint_count, 32))
+        return false;
+    if (packet_sequence == 0 || joint_count != joint_count_)
+        return false;
+
+    size_t baseline_slot = 0;
+    if (baseline_sequence != 0 && !findFrame(baseline_sequence, baseline_slot))
+        return false;
+
+    for (size_t i = 0; i < current_.size(); ++i)
+        current_[i] = baseline_sequence != 0 ? history_[baseline_slot * current_.size() + i] : 0;
+    if (!readDeltas(reader, joint_count_, current_.data()))
+        return false;
+
+    size_t slot = packet_sequence % sequences_.size();
+    sequences_[slot] = packet_sequence;
+    std::copy(current_.begin(), current_.end(), history_.begin() + slot * current_.size());
+
+    dequantizePose(current_.empty() ? nullptr : &current_[0], quantization_, pose);
+    sequence = packet_sequence;
+    return true;
+}
+
+size_t PoseDecoder::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the history slot holding a decoded pose.
+///
+/// \return false if the pose isn't in the history.
+bool PoseDecoder::findFrame(GLuint sequence, size_t& slot) const
+{
+    slot = sequence % sequences_.size();
+    return sequences_[slot] == sequence;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty replay buffer for poses of a skeleton.
+///
+/// \param  capacity The size of the ring, in bytes.  A keyframe of a
+///         skeleton with moving joints takes up to about 17 bytes a joint.
+/// \param  keyframe_interval How many frames there are from one keyframe to
+///         the next.  Longer intervals compress better, but make random
+///         access slower.
+PoseReplayBuffer::PoseReplayBuffer(size_t joint_count, size_t capacity, size_t keyframe_interval,
+                                   const PoseQuantization& quantization)
+    : joint_count_(joint_count),
+      quantization_(quantization),
+      keyframe_interval_(std::max(keyframe_interval, size_t(1))),
+      ring_(capacity),
+      first_frame_(0),
+      write_offset_(0),
+      bytes_used_(0),
+      latest_(N_CHANNELS * joint_count),
+      values_(N_CHANNELS * joint_count),
+      deltas_(N_CHANNELS * joint_count),
+      cursor_(N_CHANNELS * joint_count),
+      cursor_frame_(size_t(-1))
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compresses a pose into the ring as its newest frame, dropping the
+///         oldest frames if there isn't room.
+///
+/// \param  pose A pose with the buffer's joint count.
+/// \return The new frame's number.  Frames are numbered in the order they
+///         were recorded, from 0, and keep their numbers as older ones are
+///         dropped.
+size_t PoseReplayBuffer::record(const Pose& pose)
+{
+    assert(pose.joint_count == joint_count_);
+    quantizePose(pose, quantization_, values_.data());
+
+    size_t frame = getEndFrame();
+    bool keyframe = frames_.empty() || frame % keyframe_interval_ == 0;
+    encode(keyframe);
+    size_t offset = makeRoom(encoded_.size());
+
+    // the frames before this delta's may all have been dropped to make room
+    // for it; then it has to be a keyframe after all.
+    if (!keyframe && frames_.empty())
+    {
+        keyframe = true;
+        encode(keyframe);
+        offset = makeRoom(encoded_.size());
+    }
+
+    if (!encoded_.empty())
+        std::memcpy(&ring_[offset], encoded_.data(), encoded_.size());
+    Frame record;
+    record.offset = offset;
+    record.size = encoded_.size();
+    record.keyframe = keyframe;
+    frames_.push_back(record);
+    write_offset_ = offset + encoded_.size();
+    bytes_used_ += encoded_.size();
+
+    latest_.swap(values_);
+    return frame;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decodes a recorded frame into a pose.
+///
+/// \param  frame A number record() returned.
+/// \param  pose Has its translation, rotation and scale streams overwritten;
+///         it must have the buffer's joint count.
+/// \return false if the frame has been dropped, or hasn't been recorded
+///         yet, in which case the pose is left alone.
+bool PoseReplayBuffer::getFrame(size_t frame, Pose& pose)
+{
+    assert(pose.joint_count == joint_count_);
+    if (frame < first_frame_ || frame >= getEndFrame())
+        return false;
+
+    // the oldest frame is always a keyframe, so there's one to start from.
+    size_t keyframe = frame;
+    while (!frames_[keyframe - first_frame_].keyframe)
+        --keyframe;
+
+    size_t next = keyframe;
+    if (cursor_frame_ != size_t(-1) && cursor_frame_ >= keyframe && cursor_frame_ <= frame)
+        next = cursor_frame_ + 1;
+    else
+        std::fill(cursor_.begin(), cursor_.end(), 0);
+
+    for (; next <= frame; ++next)
+    {
+        const Frame& record = frames_[next - first_frame_];
+        BitReader reader(record.size > 0 ? &ring_[record.offset] : nullptr, record.size);
+        bool decoded = readDeltas(reader, joint_count_, cursor_.data());
+        assert(decoded);
+        (void)decoded;
+        cursor_frame_ = next;
+    }
+
+    dequantizePose(cursor_.empty() ? nullptr : &cursor_[0], quantization_, pose);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Drops every frame.  The next one recorded keeps counting from
+///         the last one's number, and is a keyframe.
+void PoseReplayBuffer::clear()
+{
+    first_frame_ = getEndFrame();
+    frames_.clear();
+    write_offset_ = 0;
+    bytes_used_ = 0;
+    cursor_frame_ = size_t(-1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of the oldest frame which getFrame() can
+///         decode.
+size_t PoseReplayBuffer::getFirstFrame() const
+{
+    return first_frame_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns one past the number of the newest frame, which is the
+///         number the next frame recorded will get.
+size_t PoseReplayBuffer::getEndFrame() const
+{
+    return first_frame_ + frames_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of bytes of the ring the frames take up.
+size_t PoseReplayBuffer::getBytesUsed() const
+{
+    return bytes_used_;
+}
+
+size_t PoseReplayBuffer::getJointCount() const
+{
+    return joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Encodes values_ into encoded_, as a keyframe or as a delta from
+///         latest_.
+void PoseReplayBuffer::encode(bool keyframe)
+{
+    BitWriter writer(encoded_);
+    writeDeltas(values_.data(), keyframe ? nullptr : latest_.data(), joint_count_, deltas_.data(), writer);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds room in the ring for a frame of the given size, dropping
+///         the oldest frames which are in the way.
+///
+/// \details The frames run around the ring from the oldest to the newest,
+///         so the ones ahead of write_offset_ are the oldest.  A frame
+///         which won't fit before the end of the ring goes at the start,
+///         and the frames between write_offset_ and the end are dropped.
+///
+/// \return Where the frame can go.
+size_t PoseReplayBuffer::makeRoom(size_t size)
+{
+    if (size > ring_.size())
+    {
+        std::cerr << "A " << size << " byte pose doesn't fit in a replay buffer of " << ring_.size() << " bytes!"
+                  << std::endl;
+        throw std::runtime_error("A pose doesn't fit in the replay buffer!");
+    }
+
+    size_t offset = frames_.empty() ? 0 : write_offset_;
+    if (offset + size > ring_.size())
+    {
+        while (!frames_.empty() && frames_.front().offset >= offset)
+            dropOldest();
+        offset = 0;
+    }
+    while (!frames_.empty() && frames_.front().offset >= offset && frames_.front().offset < offset + size)
+        dropOldest();
+    return offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Drops the oldest frame, and the deltas after it which can't be
+///         decoded without it, up to the next keyframe.
+void PoseReplayBuffer::dropOldest()
+{
+    do
+    {
+        bytes_used_ -= frames_.front().size;
+        frames_.pop_front();
+        ++first_frame_;
+    }
+    while (!frames_.empty() && !frames_.front().keyframe);
+
+    if (cursor_frame_ != size_t(-1) && cursor_frame_ < first_frame_)
+        cursor_frame_ = size_t(-1);
+}
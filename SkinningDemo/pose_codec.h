@@ -0,0 +1,176 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  pose_codec.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the PoseEncoder and PoseDecoder classes, which
+///         compress a stream of poses for sending over a network, and the
+///         PoseReplayBuffer class, which keeps the latest poses compressed
+///         for an instant replay.
+
+#ifndef POSE_CODEC_H_
+#define POSE_CODEC_H_
+
+#include "pose.h"
+#include <deque>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The step each channel of a pose is quantized to.  The encoder and
+///         decoder must agree on it.
+struct PoseQuantization
+{
+    PoseQuantization();
+
+    float translation;  ///< In model units.
+    float rotation;     ///< In degrees.
+    float scale;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Encodes poses into packets, each a delta from the latest pose the
+///         receiver has acknowledged.
+///
+/// \details Each joint's translation, rotation and scale are quantized to
+///         the steps of a PoseQuantization, as integers, so rotations can
+///         wind past 360 degrees as the demo's do.  The joints' colors are
+///         only for visualization, and aren't sent.
+///
+///         A packet holds, in order, packed into bits from the least
+///         significant bit of each byte up:
+///
+///         - the packet's sequence number and its baseline's (32 bits each;
+///           a baseline of 0 means the packet is a delta from all zeros)
+///         - the joint count (32 bits)
+///         - for each of the four channels, the number of bits (0 to 32)
+///           each of its deltas is written with (6 bits each)
+///         - for each joint, a bit which is set if any of its channels
+///           changed, followed, if so, by a bit per channel, and each changed
+///           channel's delta, zigzag encoded
+///
+///         so a joint which hasn't moved since the baseline costs one bit,
+///         and a moving one only as many bits as the packet's largest delta
+///         needs.
+///
+///         Packets can be lost, so the encoder keeps the last history poses
+///         it sent, and acknowledge() makes one of them the baseline.  Until
+///         the first acknowledgement, and whenever the baseline falls out of
+///         the history (which the decoder's history of the same length
+///         couldn't hold either), packets are deltas from zeros, which any
+///         decoder can read.
+class PoseEncoder
+{
+public:
+    PoseEncoder(size_t joint_count, const PoseQuantization& quantization = PoseQuantization(), size_t history = 32);
+
+    GLuint encode(const Pose& pose, std::vector<unsigned char>& packet);
+    void acknowledge(GLuint sequence);
+
+    GLuint getBaseline() const;
+    size_t getJointCount() const;
+
+private:
+    size_t joint_count_;
+    PoseQuantization quantization_;
+    GLuint next_sequence_;
+    std::vector<GLuint> sequences_;     ///< The sequence number of each history slot, or 0.
+    std::vector<GLint> history_;        ///< Each slot's quantized channels, channel by channel.
+    GLuint baseline_sequence_;          ///< 0 until a packet has been acknowledged.
+    std::vector<GLint> baseline_;
+    std::vector<GLuint> deltas_;        ///< Scratch space for the packet being encoded.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decodes the packets of a PoseEncoder, straight into the streams
+///         of a Pose.
+///
+/// \details Keeps the last history poses it decoded, so it can decode any
+///         packet whose baseline is one of them.  The receiver should
+///         acknowledge each sequence number decode() returns.
+class PoseDecoder
+{
+public:
+    PoseDecoder(size_t joint_count, const PoseQuantization& quantization = PoseQuantization(), size_t history = 32);
+
+    bool decode(const unsigned char* packet, size_t size, Pose& pose, GLuint& sequence);
+
+    size_t getJointCount() const;
+
+private:
+    bool findFrame(GLuint sequence, size_t& slot) const;
+
+    size_t joint_count_;
+    PoseQuantization quantization_;
+    std::vector<GLuint> sequences_;     ///< The sequence number of each history slot, or 0.
+    std::vector<GLint> history_;        ///< Each slot's quantized channels, channel by channel.
+    std::vector<GLint> current_;        ///< Scratch space for the packet being decoded.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Keeps the most recent poses recorded, compressed into a ring of
+///         a fixed number of bytes, for playing back any of them again.
+///
+/// \details Each frame is quantized as PoseEncoder quantizes its poses, and
+///         stored in the same bit layout as a packet's joints: every
+///         keyframe_interval frames as a delta from all zeros, a keyframe,
+///         and otherwise as a delta from the frame before it, which costs a
+///         joint which hasn't moved one bit.  Once the ring is full, the
+///         oldest frames are dropped to make room, a keyframe's worth at a
+///         time, since the deltas after a keyframe can't be read without it.
+///
+///         getFrame() decodes any frame still in the ring from its keyframe,
+///         so random access costs at most keyframe_interval deltas.  The
+///         last frame it decoded is kept, so playing the frames back in
+///         order only ever decodes one delta per frame.
+///
+///         record() does no allocation once the first few frames have sized
+///         its scratch space, so it's cheap enough to call every frame on
+///         the thread which poses the skeleton.  Only the transforms are
+///         recorded; colors are left alone, as the codec leaves them.
+class PoseReplayBuffer
+{
+public:
+    PoseReplayBuffer(size_t joint_count, size_t capacity, size_t keyframe_interval = 30,
+                     const PoseQuantization& quantization = PoseQuantization());
+
+    size_t record(const Pose& pose);
+    bool getFrame(size_t frame, Pose& pose);
+    void clear();
+
+    size_t getFirstFrame() const;
+    size_t getEndFrame() const;
+    size_t getBytesUsed() const;
+    size_t getJointCount() const;
+
+private:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Where one frame is in the ring.  A frame is never split
+    ///         across the end of the ring.
+    struct Frame
+    {
+        size_t offset;
+        size_t size;
+        bool keyframe;
+    };
+
+    void encode(bool keyframe);
+    size_t makeRoom(size_t size);
+    void dropOldest();
+
+    size_t joint_count_;
+    PoseQuantization quantization_;
+    size_t keyframe_interval_;
+    std::vector<unsigned char> ring_;
+    std::deque<Frame> frames_;
+    size_t first_frame_;                ///< The number of the oldest frame in frames_.
+    size_t write_offset_;               ///< Where the next frame goes, if it fits before the end.
+    size_t bytes_used_;
+    std::vector<GLint> latest_;         ///< The newest frame's quantized channels.
+    std::vector<GLint> values_;         ///< Scratch space for the frame being recorded.
+    std::vector<GLuint> deltas_;        ///< Scratch space for the frame being recorded.
+    std::vector<unsigned char> encoded_;
+    std::vector<GLint> cursor_;         ///< The quantized channels of the last frame getFrame() decoded.
+    size_t cursor_frame_;               ///< That frame's number, or size_t(-1) if there isn't one.
+};
+
+#endif
@@ -0,0 +1,298 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  pose_space_correctives.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of PoseSpaceCorrectives class functions.
+
+#include "pose_space_correctives.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+const size_t PoseSpaceCorrectives::MAX_DRIVER_JOINTS;
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Turns an angle between two rotations into the short way round
+///         from one to the other, from -180 to 180 degrees.
+float wrapDegrees(float degrees)
+{
+    return degrees - 360.0f * std::floor(degrees * (1.0f / 360.0f) + 0.5f);
+}
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  wrapDegrees() for four angles.  The conversion rounds to nearest,
+///         so the two only differ at exactly 180 degrees, which is as far
+///         round one way as the other.
+__m128 wrapDegrees4(__m128 degrees)
+{
+    __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(degrees, _mm_set1_ps(1.0f / 360.0f))));
+    return _mm_sub_ps(degrees, _mm_mul_ps(turns, _mm_set1_ps(360.0f)));
+}
+#endif
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a set of correctives with no drivers.
+///
+/// \param  skeleton The skeleton the driving joints are in, which must
+///         outlive the set.
+/// \param  instance_capacity The most poses evaluate() is given at once.
+PoseSpaceCorrectives::PoseSpaceCorrectives(const Skeleton& skeleton, size_t instance_capacity)
+    : skeleton_(skeleton),
+      instance_capacity_(instance_capacity),
+      activation_starts_(instance_capacity + 1, 0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a corrective which ramps its target in as a joint turns.
+///
+/// \param  target The morph target.
+/// \param  joint The joint whose rotation drives it.
+/// \param  start_degrees The rotation the target starts coming in at.
+/// \param  full_degrees The rotation the target reaches its full weight
+///         at; it may be on either side of start_degrees, but not the same.
+/// \return The corrective's index.
+size_t PoseSpaceCorrectives::addLinearCorrective(size_t target, size_t joint, float start_degrees, float full_degrees)
+{
+    float range = wrapDegrees(full_degrees - start_degrees);
+    if (joint >= skeleton_.getJointCount() || range == 0)
+    {
+        std::cerr << "A linear corrective on joint " << joint << " from " << start_degrees << " to "
+                  << full_degrees << " degrees has no joint or no range." << std::endl;
+        throw std::runtime_error("Invalid corrective driver!");
+    }
+
+    Corrective corrective;
+    corrective.target = target;
+    corrective.radial = false;
+    corrective.first_input = input_slots_.size();
+    corrective.input_count = 1;
+    corrective.scale = 1.0f / range;
+
+    input_slots_.push_back(getJointSlot(joint));
+    input_keys_.push_back(start_degrees);
+    correctives_.push_back(corrective);
+    weights_.resize(correctives_.size() * instance_capacity_, 0.0f);
+    return correctives_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a corrective which brings its target in around a key pose
+///         of a few joints.
+///
+/// \param  target The morph target.
+/// \param  joints The joints whose rotations drive it.
+/// \param  key_degrees Each joint's rotation in the key pose, at which the
+///         target has its full weight.
+/// \param  joint_count The number of joints, from 1 to MAX_DRIVER_JOINTS.
+/// \param  radius_degrees How far from the key pose the target fades out
+///         completely.
+/// \return The corrective's index.
+size_t PoseSpaceCorrectives::addRadialCorrective(size_t target, const size_t* joints, const float* key_degrees,
+                                                 size_t joint_count, float radius_degrees)
+{
+    bool joints_valid = joint_count > 0 && joint_count <= MAX_DRIVER_JOINTS;
+    for (size_t i = 0; i < joint_count && joints_valid; ++i)
+        joints_valid = joints[i] < skeleton_.getJointCount();
+    if (!joints_valid || !(radius_degrees > 0))
+    {
+        std::cerr << "A radial corrective on " << joint_count << " joints with a radius of " << radius_degrees
+                  << " degrees needs 1 to " << MAX_DRIVER_JOINTS << " joints, and a radius." << std::endl;
+        throw std::runtime_error("Invalid corrective driver!");
+    }
+
+    Corrective corrective;
+    corrective.target = target;
+    corrective.radial = true;
+    corrective.first_input = input_slots_.size();
+    corrective.input_count = joint_count;
+    corrective.scale = 1.0f / (radius_degrees * radius_degrees);
+
+    for (size_t i = 0; i < joint_count; ++i)
+    {
+        input_slots_.push_back(getJointSlot(joints[i]));
+        input_keys_.push_back(key_degrees[i]);
+    }
+    correctives_.push_back(corrective);
+    weights_.resize(correctives_.size() * instance_capacity_, 0.0f);
+    return correctives_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of correctives.
+size_t PoseSpaceCorrectives::getCorrectiveCount() const
+{
+    return correctives_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Works out every corrective's weight in a batch of poses, and
+///         lists the non-zero ones for each pose.
+///
+/// \param  poses The poses, of the skeleton's joints.
+/// \param  pose_count The number of poses, up to the set's capacity.  The
+///         lists of any instances past them are left empty.
+void PoseSpaceCorrectives::evaluate(const Pose* poses, size_t pose_count)
+{
+    assert(pose_count <= instance_capacity_);
+    pose_count = std::min(pose_count, instance_capacity_);
+
+    // the only gather: each driving joint's rotation, pose by pose.
+    for (size_t slot = 0; slot < slot_joints_.size(); ++slot)
+    {
+        size_t joint = slot_joints_[slot];
+        float* lanes = &rotations_[slot * instance_capacity_];
+        for (size_t i = 0; i < pose_count; ++i)
+            lanes[i] = poses[i].rotation[joint];
+    }
+
+    for (size_t c = 0; c < correctives_.size(); ++c)
+    {
+        float* weights = &weights_[c * instance_capacity_];
+        if (correctives_[c].radial)
+            evaluateRadial(correctives_[c], pose_count, weights);
+        else
+            evaluateLinear(correctives_[c], pose_count, weights);
+    }
+
+    activations_.clear();
+    for (size_t i = 0; i < pose_count; ++i)
+    {
+        activation_starts_[i] = activations_.size();
+        for (size_t c = 0; c < correctives_.size(); ++c)
+        {
+            float weight = weights_[c * instance_capacity_ + i];
+            if (weight > 0)
+            {
+                MorphActivation activation;
+                activation.target = correctives_[c].target;
+                activation.weight = weight;
+                activations_.push_back(activation);
+            }
+        }
+    }
+    std::fill(activation_starts_.begin() + pose_count, activation_starts_.end(), activations_.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the targets the last evaluate() activated in a pose,
+///         and their weights, in the order their correctives were added.
+///
+/// \details A target driven by more than one corrective is listed once for
+///         each, and its weights add up.
+const MorphActivation* PoseSpaceCorrectives::getActivations(size_t instance) const
+{
+    assert(instance < instance_capacity_);
+    return activations_.empty() ? nullptr : activations_.data() + activation_starts_[instance];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of targets the last evaluate() activated in a
+///         pose.
+size_t PoseSpaceCorrectives::getActivationCount(size_t instance) const
+{
+    assert(instance < instance_capacity_);
+    return activation_starts_[instance + 1] - activation_starts_[instance];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the slot a joint's rotations are gathered into, giving
+///         it one if no driver has read it yet.
+size_t PoseSpaceCorrectives::getJointSlot(size_t joint)
+{
+    std::vector<size_t>::const_iterator found = std::find(slot_joints_.begin(), slot_joints_.end(), joint);
+    if (found != slot_joints_.end())
+        return found - slot_joints_.begin();
+
+    slot_joints_.push_back(joint);
+    rotations_.resize(slot_joints_.size() * instance_capacity_, 0.0f);
+    return slot_joints_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Ramps a linear corrective's weight in every lane: how far its
+///         joint has turned past the start angle, over its whole range,
+///         clamped to 0 to 1.
+void PoseSpaceCorrectives::evaluateLinear(const Corrective& corrective, size_t pose_count, float* weights) const
+{
+    const float* rotations = &rotations_[input_slots_[corrective.first_input] * instance_capacity_];
+    float start = input_keys_[corrective.first_input];
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 start4 = _mm_set1_ps(start);
+    const __m128 scale4 = _mm_set1_ps(corrective.scale);
+    const __m128 zero4 = _mm_setzero_ps();
+    const __m128 one4 = _mm_set1_ps(1.0f);
+    for (; i + 4 <= pose_count; i += 4)
+    {
+        __m128 turned = wrapDegrees4(_mm_sub_ps(_mm_loadu_ps(rotations + i), start4));
+        _mm_storeu_ps(weights + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(turned, scale4), zero4), one4));
+    }
+#endif
+
+    for (; i < pose_count; ++i)
+    {
+        float weight = wrapDegrees(rotations[i] - start) * corrective.scale;
+        weights[i] = std::min(std::max(weight, 0.0f), 1.0f);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Weights a radial corrective in every lane by the distance of its
+///         joints from their key pose, d, as (1 - d^2/r^2)^2, or 0 past r.
+void PoseSpaceCorrectives::evaluateRadial(const Corrective& corrective, size_t pose_count, float* weights) const
+{
+    // sum the squared distances input by input, so every input's lanes are
+    // read in order.
+    std::fill(weights, weights + pose_count, 0.0f);
+    for (size_t input = corrective.first_input; input < corrective.first_input + corrective.input_count; ++input)
+    {
+        const float* rotations = &rotations_[input_slots_[input] * instance_capacity_];
+        float key = input_keys_[input];
+        size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+        const __m128 key4 = _mm_set1_ps(key);
+        for (; i + 4 <= pose_count; i += 4)
+        {
+            __m128 distance = wrapDegrees4(_mm_sub_ps(_mm_loadu_ps(rotations + i), key4));
+            _mm_storeu_ps(weights + i, _mm_add_ps(_mm_loadu_ps(weights + i), _mm_mul_ps(distance, distance)));
+        }
+#endif
+
+        for (; i < pose_count; ++i)
+        {
+            float distance = wrapDegrees(rotations[i] - key);
+            weights[i] += distance * distance;
+        }
+    }
+
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 scale4 = _mm_set1_ps(corrective.scale);
+    const __m128 zero4 = _mm_setzero_ps();
+    const __m128 one4 = _mm_set1_ps(1.0f);
+    for (; i + 4 <= pose_count; i += 4)
+    {
+        __m128 falloff = _mm_max_ps(_mm_sub_ps(one4, _mm_mul_ps(_mm_loadu_ps(weights + i), scale4)), zero4);
+        _mm_storeu_ps(weights + i, _mm_mul_ps(falloff, falloff));
+    }
+#endif
+
+    for (; i < pose_count; ++i)
+    {
+        float falloff = std::max(1.0f - weights[i] * corrective.scale, 0.0f);
+        weights[i] = falloff * falloff;
+    }
+}
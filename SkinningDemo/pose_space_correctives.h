@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  pose_space_correctives.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the PoseSpaceCorrectives class, and the
+///         MorphActivation struct.
+
+#ifndef POSE_SPACE_CORRECTIVES_H_
+#define POSE_SPACE_CORRECTIVES_H_
+
+#include "skeleton.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A morph target to apply, and its weight, in a sparse list of
+///         the targets in use.
+struct MorphActivation
+{
+    size_t target;
+    float weight;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Activates corrective morph targets from the rotations of the
+///         joints they fix up (pose-space deformation), for a batch of
+///         poses at once.
+///
+/// \details Each corrective drives one morph target from one of two kinds
+///         of driver:
+///
+///         - A linear driver ramps the weight from 0 to 1 as one joint turns
+///           from a start angle to the angle the target was sculpted at.
+///         - A radial driver weights the target by how near a few joints
+///           are to a key pose, with a compactly supported radial basis
+///           function: (1 - d^2/r^2)^2 within r degrees of the key, where d
+///           is the distance from it over all the driver's joints, and 0
+///           further out.
+///
+///         evaluate() gathers the driving joints' rotations from every pose
+///         into one array of lanes per joint, then works out each
+///         corrective's weight across all the lanes, four poses at a time
+///         with SSE2.  The weights are then compacted into a sparse list
+///         per pose of the targets with non-zero weights, which is what
+///         MorphTargetPass::apply() takes; so far from their key poses,
+///         correctives cost nothing past the evaluation itself.  Angles are
+///         compared the short way round, so 350 degrees is 20 from 10.
+class PoseSpaceCorrectives
+{
+public:
+    static const size_t MAX_DRIVER_JOINTS = 4;     ///< The most joints one radial driver can read.
+
+    PoseSpaceCorrectives(const Skeleton& skeleton, size_t instance_capacity);
+
+    size_t addLinearCorrective(size_t target, size_t joint, float start_degrees, float full_degrees);
+    size_t addRadialCorrective(size_t target, const size_t* joints, const float* key_degrees, size_t joint_count,
+                               float radius_degrees);
+    size_t getCorrectiveCount() const;
+
+    void evaluate(const Pose* poses, size_t pose_count);
+
+    const MorphActivation* getActivations(size_t instance) const;
+    size_t getActivationCount(size_t instance) const;
+
+private:
+    PoseSpaceCorrectives(const PoseSpaceCorrectives&);              // non-copyable
+    PoseSpaceCorrectives& operator=(const PoseSpaceCorrectives&);   // non-copyable
+
+    struct Corrective
+    {
+        size_t target;
+        bool radial;
+        size_t first_input;         ///< The corrective's first slot and key in input_slots_ and input_keys_.
+        size_t input_count;
+        float scale;                ///< 1 / (full - start) for a linear driver, 1 / r^2 for a radial one.
+    };
+
+    size_t getJointSlot(size_t joint);
+    void evaluateLinear(const Corrective& corrective, size_t pose_count, float* weights) const;
+    void evaluateRadial(const Corrective& corrective, size_t pose_count, float* weights) const;
+
+    const Skeleton& skeleton_;
+    size_t instance_capacity_;
+    std::vector<Corrective> correctives_;
+    std::vector<size_t> input_slots_;           ///< Each driver input's joint, as a slot in slot_joints_.
+    std::vector<float> input_keys_;             ///< Each input's start angle, or key pose angle, in degrees.
+    std::vector<size_t> slot_joints_;           ///< The joints any driver reads, each gathered once.
+    std::vector<float> rotations_;              ///< A lane per instance for each of slot_joints_, in degrees.
+    std::vector<float> weights_;                ///< A lane per instance for each corrective.
+    std::vector<MorphActivation> activations_;  ///< Every instance's non-zero weights, instance by instance.
+    std::vector<size_t> activation_starts_;     ///< Where each instance's activations start, and where the last one's end.
+};
+
+#endif
@@ -0,0 +1,242 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  posed_mesh.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the functions which bake a posed mesh.
+
+#include "posed_mesh.h"
+#include "cpu_skinner.h"
+#include "mesh_file.h"
+#include "skinned_vertex_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Feeds a block of bytes into a 64-bit FNV-1a hash, followed by a 0
+///         byte so that consecutive blocks can't run together.
+void hashBytes(const void* data, size_t size, unsigned long long& hash)
+{
+    const unsigned long long prime = 1099511628211ull;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * prime;
+
+    hash *= prime;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the blend of a vertex's joints' palette matrices, by its
+///         weights.
+mat4 blendPalette(const Vertex& vertex, const mat4* palette)
+{
+    mat4 blended(0);
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        if (vertex.joint_weights[i] != 0)
+            blended += vertex.joint_weights[i] * palette[vertex.joint_indices[i]];
+    }
+    return blended;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Turns a unit vector by the upper 3x3 of a blended matrix, and
+///         renormalizes it, as the skinning shaders do.
+vec3 turnDirection(const mat4& blended, const vec3& direction)
+{
+    vec3 turned = mat3(blended) * direction;
+    float length = glm::length(turned);
+    return length > 0 ? turned / length : direction;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the hash which names a posed mesh in the cache.
+///
+/// \details Everything which changes the result is hashed: the mesh's
+///         vertices and triangles, the palette, to the bit, and the backend
+///         which skins it.  Changing the mesh, the rig or the shaders'
+///         results therefore bakes again rather than reusing a stale file.
+unsigned long long hashPosedMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                                 const PosedMeshSource& source)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    hashBytes(source.backend.data(), source.backend.size(), hash);
+    hashBytes(vertices.data(), vertices.size() * sizeof(Vertex), hash);
+    hashBytes(indices.data(), indices.size() * sizeof(GLuint), hash);
+    hashBytes(source.palette, source.joint_count * sizeof(mat4), hash);
+    return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the path of the mesh file which holds a posed mesh.
+std::string getPosedMeshPath(const std::string& directory, unsigned long long pose_hash)
+{
+    char name[32];
+    std::sprintf(name, "%016llx.skm", pose_hash);
+    return directory + "/" + name;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins a mesh's positions on the CPU.
+///
+/// \param  vertices The vertices to skin, in any order.
+/// \param  palette The pose's skinning palette.
+/// \param  joint_count The number of matrices in the palette.
+/// \param  positions Receives each vertex's skinned position, in the same
+///         order.
+void skinPosedPositions(const std::vector<Vertex>& vertices, const mat4* palette, size_t joint_count,
+                        std::vector<vec4>& positions)
+{
+    // the colors are skinned along with the positions, but aren't kept.
+    std::vector<color4> colors(joint_count, color4(1));
+    std::vector<CpuSkinner::SkinnedVertex> skinned(vertices.size());
+    if (!vertices.empty())
+        skinVerticesBatched(vertices.data(), vertices.size(), palette, colors.data(), skinned.data());
+
+    positions.resize(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v)
+        positions[v] = skinned[v].position;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads back vertices the GPU has skinned, through a pixel pack
+///         buffer, and puts their positions back in the mesh's own order.
+///
+/// \details The skinned vertices are copied into the pack buffer on the GPU,
+///         and it's mapped for reading, which waits for the copy and
+///         everything before it, so this stalls the pipeline; it's only
+///         meant to be done once per bake.
+///
+/// \param  skinned_buffer A buffer of SkinnedVertexCache::SkinnedVertex, in
+///         uploaded order.
+/// \param  remap Where the upload put each of the mesh's vertices.
+/// \param  vertex_count The number of vertices uploaded.
+/// \param  positions Receives each of the mesh's vertices' skinned
+///         positions, in the order of remap.
+void readBackPosedPositions(GLuint skinned_buffer, const MeshUploadRemap& remap, size_t vertex_count,
+                            std::vector<vec4>& positions)
+{
+    typedef SkinnedVertexCache::SkinnedVertex SkinnedVertex;
+    GLsizeiptr size = GLsizeiptr(vertex_count * sizeof(SkinnedVertex));
+
+    GLuint pack_buffer_id = 0;
+    glGenBuffers(1, &pack_buffer_id);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffer_id);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_COPY_READ_BUFFER, skinned_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_PIXEL_PACK_BUFFER, 0, 0, size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    const SkinnedVertex* skinned =
+        static_cast<const SkinnedVertex*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+    if (skinned == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glDeleteBuffers(1, &pack_buffer_id);
+        std::cerr << "Error reading back the skinned vertices!" << std::endl;
+        throw std::runtime_error("Error reading back the skinned vertices!");
+    }
+
+    positions.resize(remap.vertices.size());
+    for (size_t v = 0; v < remap.vertices.size(); ++v)
+        positions[v] = skinned[remap.vertices[v]].position;
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteBuffers(1, &pack_buffer_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds the vertices of a posed mesh.
+///
+/// \details Each vertex takes its skinned position, and its normal and
+///         tangent are turned by its blended palette matrix, the way the
+///         shaders turn them.  The joints and weights are kept, so the
+///         posed mesh is drawn with the joints' colors as before; drawn in
+///         the bind pose, whose palette is all identities, it's the posed
+///         mesh, and any skinning mode draws it with a palette that never
+///         changes, uploaded once.
+///
+/// \param  vertices The mesh's vertices.
+/// \param  palette The palette the positions were skinned with.
+/// \param  positions Each vertex's skinned position.
+/// \param  posed Receives the posed vertices.
+void buildPosedVertices(const std::vector<Vertex>& vertices, const mat4* palette,
+                        const std::vector<vec4>& positions, std::vector<Vertex>& posed)
+{
+    posed = vertices;
+    for (size_t v = 0; v < posed.size(); ++v)
+    {
+        Vertex& vertex = posed[v];
+        mat4 blended = blendPalette(vertex, palette);
+        vertex.position = vec2(positions[v]);
+        vertex.normal = turnDirection(blended, vertex.normal);
+        vertex.tangent = vec4(turnDirection(blended, vec3(vertex.tangent)), vertex.tangent.w);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Bakes a mesh in one pose into a mesh file, unless the cache
+///         already holds it.
+///
+/// \details The file is named by hashPosedMesh(), so a pose which was baked
+///         before, in this session or an earlier one, is found without
+///         skinning anything.  Otherwise the positions are skinned by the
+///         source's backend, and the posed vertices saved in the mesh's own
+///         vertex format with saveMeshFile(), so loadMeshFile() loads them
+///         like any other mesh.  The directory is created if it doesn't
+///         exist.
+///
+/// \param  mesh The mesh to bake.  Its vertices and indices must still be
+///         on the CPU, and uploaded with uploadMesh() if the GPU skinned
+///         them, for the remap.
+/// \param  source The pose, and what skins it.
+/// \param  directory The cache directory, like POSED_MESH_DIRECTORY.
+/// \param  cached Set to true if the file was already in the cache.
+/// \return The path of the posed mesh's file.
+std::string bakePosedMesh(const SkeletalMesh& mesh, const PosedMeshSource& source, const std::string& directory,
+                          bool& cached)
+{
+    std::string path = getPosedMeshPath(directory, hashPosedMesh(mesh.vertices, mesh.indices, source));
+    cached = bool(std::ifstream(path.c_str(), std::ios::binary));
+    if (cached)
+        return path;
+
+    std::vector<vec4> positions;
+    if (source.skinned_buffer != 0)
+        readBackPosedPositions(source.skinned_buffer, mesh.getUploadRemap(), mesh.getVertexCount(), positions);
+    else
+        skinPosedPositions(mesh.vertices, source.palette, source.joint_count, positions);
+
+    if (positions.size() != mesh.vertices.size())
+    {
+        std::cerr << "Error baking the posed mesh: the vertices weren't uploaded with uploadMesh()!" << std::endl;
+        throw std::runtime_error("Error baking the posed mesh!");
+    }
+
+    std::vector<Vertex> posed;
+    buildPosedVertices(mesh.vertices, source.palette, positions, posed);
+
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+    saveMeshFile(posed, mesh.indices, mesh.vertex_format, path);
+    return path;
+}
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  posed_mesh.h
+/// \author Ben Crist
+///
+/// \brief  Functions for baking a mesh in one pose into a static mesh file.
+
+#ifndef POSED_MESH_H_
+#define POSED_MESH_H_
+
+#include "skeletal_mesh.h"
+#include <string>
+#include <vector>
+
+/// The directory the demo keeps its baked poses in, between sessions.
+const char* const POSED_MESH_DIRECTORY = "posed_meshes";
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Where a posed mesh's positions are skinned.
+///
+/// \details The CPU skins them with skinVerticesBatched() from a palette.
+///         The GPU's are read back from vertices it has already skinned,
+///         captured in VBO order as SkinnedVertexCache::SkinnedVertex, so
+///         that the bake matches exactly what that skinning mode draws,
+///         morph targets and correctives included.  Either way, the normals
+///         and tangents are turned by the palette on the CPU.
+struct PosedMeshSource
+{
+    const mat4* palette;    ///< The pose's skinning palette, one matrix per joint.
+    size_t joint_count;
+    GLuint skinned_buffer;  ///< The GPU's skinned vertices, or 0 to skin on the CPU.
+    std::string backend;    ///< Names what skinned them, since the modes' results differ.
+};
+
+unsigned long long hashPosedMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                                 const PosedMeshSource& source);
+std::string getPosedMeshPath(const std::string& directory, unsigned long long pose_hash);
+
+void skinPosedPositions(const std::vector<Vertex>& vertices, const mat4* palette, size_t joint_count,
+                        std::vector<vec4>& positions);
+void readBackPosedPositions(GLuint skinned_buffer, const MeshUploadRemap& remap, size_t vertex_count,
+                            std::vector<vec4>& positions);
+void buildPosedVertices(const std::vector<Vertex>& vertices, const mat4* palette,
+                        const std::vector<vec4>& positions, std::vector<Vertex>& posed);
+
+std::string bakePosedMesh(const SkeletalMesh& mesh, const PosedMeshSource& source, const std::string& directory,
+                          bool& cached);
+
+#endif
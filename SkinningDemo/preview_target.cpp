@@ -0,0 +1,403 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  preview_target.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of ImageWriter and PreviewTarget class functions.
+
+#include "preview_target.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Appends a 16-bit value to a TGA header, little endian whatever
+///         the machine's byte order.
+void appendShort(std::vector<unsigned char>& out, GLsizei value)
+{
+    out.push_back((unsigned char)(value & 0xff));
+    out.push_back((unsigned char)((value >> 8) & 0xff));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Run-length encodes one row of 32-bit pixels as TGA packets.
+///
+/// \details Runs of two or more identical pixels become run packets; the
+///         pixels between them are gathered into raw packets.  Either kind
+///         holds at most 128 pixels, and no packet crosses a row.
+void encodeRow(const unsigned char* row, GLsizei width, std::vector<unsigned char>& out)
+{
+    GLsizei x = 0;
+    while (x < width)
+    {
+        GLsizei run = 1;
+        while (x + run < width && run < 128 && std::memcmp(row + (x + run) * 4, row + x * 4, 4) == 0)
+            ++run;
+
+        if (run > 1)
+        {
+            out.push_back((unsigned char)(0x80 | (run - 1)));
+            out.insert(out.end(), row + x * 4, row + x * 4 + 4);
+            x += run;
+            continue;
+        }
+
+        // gather pixels until the next run starts.
+        GLsizei raw = 1;
+        while (x + raw < width && raw < 128 &&
+               !(x + raw + 1 < width && std::memcmp(row + (x + raw) * 4, row + (x + raw + 1) * 4, 4) == 0))
+            ++raw;
+
+        out.push_back((unsigned char)(raw - 1));
+        out.insert(out.end(), row + x * 4, row + (x + raw) * 4);
+        x += raw;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits for a fence to signal.
+void waitForFence(GLsync fence)
+{
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);    // 1 ms
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes an image as a run-length encoded 32-bit TGA file.
+///
+/// \param  path The file to write; anything already there is replaced.
+/// \param  width The width of the image in pixels.
+/// \param  height The height of the image in pixels.
+/// \param  pixels width * height BGRA pixels, bottom row first.
+/// \return false if the file couldn't be written.
+bool writeTgaFile(const std::string& path, GLsizei width, GLsizei height, const unsigned char* pixels)
+{
+    std::vector<unsigned char> data;
+    data.reserve(18 + size_t(width) * height * 4);
+
+    data.push_back(0);          // no image ID
+    data.push_back(0);          // no color map
+    data.push_back(10);         // run-length encoded true-color
+    data.insert(data.end(), 5, 0);  // color map specification
+    appendShort(data, 0);       // x origin
+    appendShort(data, 0);       // y origin
+    appendShort(data, width);
+    appendShort(data, height);
+    data.push_back(32);         // bits per pixel
+    data.push_back(8);          // 8 alpha bits, bottom row first
+
+    for (GLsizei y = 0; y < height; ++y)
+        encodeRow(pixels + size_t(y) * width * 4, width, data);
+
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+    return bool(file);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the writer's thread, with nothing queued.
+///
+/// \param  max_queued The most images which may wait to be written before
+///         write() waits for room.
+ImageWriter::ImageWriter(size_t max_queued)
+    : max_queued_(max_queued),
+      writing_(false),
+      stopping_(false),
+      written_count_(0),
+      failure_count_(0)
+{
+    thread_ = std::thread(&ImageWriter::threadMain, this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes every image still queued, then stops and joins the
+///         writer's thread.
+ImageWriter::~ImageWriter()
+{
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues an image to be written, waiting first if the queue is
+///         full.
+///
+/// \param  path The file to write.
+/// \param  width The width of the image in pixels.
+/// \param  height The height of the image in pixels.
+/// \param  pixels width * height BGRA pixels, bottom row first.  They're
+///         swapped into the queue rather than copied, so this is left with
+///         whatever the queue had; refill it rather than reading it.
+void ImageWriter::write(const std::string& path, GLsizei width, GLsizei height, std::vector<unsigned char>& pixels)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (queue_.size() >= max_queued_)
+        written_.wait(lock);
+
+    queue_.push_back(Image());
+    Image& image = queue_.back();
+    image.path = path;
+    image.width = width;
+    image.height = height;
+    image.pixels.swap(pixels);
+    lock.unlock();
+
+    wake_.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits until every image queued so far has been written.
+void ImageWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!queue_.empty() || writing_)
+        written_.wait(lock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of images written successfully so far.
+size_t ImageWriter::getWrittenCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of images which couldn't be written.
+size_t ImageWriter::getFailureCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failure_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The writer thread's main loop: encodes and writes the queued
+///         images, in order, until stopped.
+void ImageWriter::threadMain()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        while (queue_.empty() && !stopping_)
+            wake_.wait(lock);
+        if (queue_.empty())
+            break;
+
+        // the image is encoded without the lock, so write() only ever waits
+        // for room in the queue.
+        Image image;
+        std::swap(image.path, queue_.front().path);
+        image.width = queue_.front().width;
+        image.height = queue_.front().height;
+        image.pixels.swap(queue_.front().pixels);
+        queue_.pop_front();
+        writing_ = true;
+        lock.unlock();
+
+        bool written = writeTgaFile(image.path, image.width, image.height, image.pixels.data());
+        if (!written)
+        {
+            std::cerr << "Error writing image!" << std::endl
+                      << "   File: " << image.path << std::endl;
+        }
+
+        lock.lock();
+        writing_ = false;
+        if (written)
+            ++written_count_;
+        else
+            ++failure_count_;
+        written_.notify_all();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the framebuffer and the ring of pixel pack buffers, and
+///         starts the writer.
+///
+/// \details If the framebuffer is incomplete, the problem is reported to
+///         stderr and an exception is thrown.
+///
+/// \param  width The width of the images in pixels.
+/// \param  height The height of the images in pixels.
+/// \param  readback_count The number of pixel pack buffers, which is how
+///         many captures can be in flight at once.
+/// \param  max_queued The most images which may wait to be written.
+PreviewTarget::PreviewTarget(GLsizei width, GLsizei height, size_t readback_count, size_t max_queued)
+    : width_(width),
+      height_(height),
+      framebuffer_id_(0),
+      renderbuffer_id_(0),
+      readbacks_(readback_count),
+      next_readback_(0),
+      writer_(max_queued)
+{
+    glGenRenderbuffers(1, &renderbuffer_id_);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_id_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer_id_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer_id_);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    GLsizeiptr image_size = GLsizeiptr(width_) * height_ * 4;
+    for (size_t i = 0; i < readbacks_.size(); ++i)
+    {
+        readbacks_[i].fence = 0;
+        glGenBuffers(1, &readbacks_[i].buffer_id);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbacks_[i].buffer_id);
+        glBufferData(GL_PIXEL_PACK_BUFFER, image_size, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        for (size_t i = 0; i < readbacks_.size(); ++i)
+            glDeleteBuffers(1, &readbacks_[i].buffer_id);
+        glDeleteFramebuffers(1, &framebuffer_id_);
+        glDeleteRenderbuffers(1, &renderbuffer_id_);
+
+        std::cerr << "The preview framebuffer is incomplete!" << std::endl
+                  << "  Size: " << width_ << "x" << height_ << std::endl;
+        throw std::runtime_error("The preview framebuffer is incomplete!");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finishes every capture, then destroys the framebuffer and
+///         buffers.
+PreviewTarget::~PreviewTarget()
+{
+    finish();
+
+    for (size_t i = 0; i < readbacks_.size(); ++i)
+        glDeleteBuffers(1, &readbacks_[i].buffer_id);
+    glDeleteFramebuffers(1, &framebuffer_id_);
+    glDeleteRenderbuffers(1, &renderbuffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Binds the framebuffer for drawing and reading, and sets the
+///         viewport to cover it.
+void PreviewTarget::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glViewport(0, 0, width_, height_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a copy of what has been drawn into the framebuffer, to be
+///         written to a file once it's complete.
+///
+/// \details If the next buffer of the ring is still holding an earlier
+///         capture, that one is retired first: this is the only place it
+///         waits for the GPU, and by then the copy has usually long
+///         finished.
+void PreviewTarget::capture(const std::string& path)
+{
+    Readback& readback = readbacks_[next_readback_];
+    if (readback.fence != 0)
+        retire(readback);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_id_);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer_id);
+    glReadPixels(0, 0, width_, height_, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.path = path;
+    next_readback_ = (next_readback_ + 1) % readbacks_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits for every capture so far to be read back and written.
+void PreviewTarget::finish()
+{
+    // oldest first, so the images are still written in order.
+    for (size_t i = 0; i < readbacks_.size(); ++i)
+    {
+        Readback& readback = readbacks_[(next_readback_ + i) % readbacks_.size()];
+        if (readback.fence != 0)
+            retire(readback);
+    }
+
+    writer_.flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the width of the images in pixels.
+GLsizei PreviewTarget::getWidth() const
+{
+    return width_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the height of the images in pixels.
+GLsizei PreviewTarget::getHeight() const
+{
+    return height_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of images written successfully so far.
+size_t PreviewTarget::getWrittenCount() const
+{
+    return writer_.getWrittenCount();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of images which couldn't be written.
+size_t PreviewTarget::getFailureCount() const
+{
+    return writer_.getFailureCount();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits for a capture's copy to finish, copies the pixels out of
+///         its buffer, and hands them to the writer, leaving the buffer
+///         free.
+///
+/// \details The pixels have to be copied out before the buffer is unmapped;
+///         a mapped pointer can't be handed to another thread without
+///         persistent mapping, which this GLEW doesn't have.
+void PreviewTarget::retire(Readback& readback)
+{
+    waitForFence(readback.fence);
+    glDeleteSync(readback.fence);
+    readback.fence = 0;
+
+    size_t image_size = size_t(width_) * height_ * 4;
+    std::vector<unsigned char> pixels(image_size);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer_id);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(image_size), GL_MAP_READ_BIT);
+    if (data == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        std::cerr << "Failed to map the readback of " << readback.path << "!" << std::endl;
+        throw std::runtime_error("Failed to map pixel pack buffer!");
+    }
+    std::memcpy(pixels.data(), data, image_size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    writer_.write(readback.path, width_, height_, pixels);
+}
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  preview_target.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the ImageWriter and PreviewTarget classes.
+
+#ifndef PREVIEW_TARGET_H_
+#define PREVIEW_TARGET_H_
+
+#include "demo.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Encodes images and writes them to disk on a background thread.
+///
+/// \details Images are written as run-length encoded 32-bit TGA files,
+///         which need no library and compress the flat backgrounds of
+///         previews well.  The pixels are BGRA, bottom row first, which is
+///         both TGA's default layout and what glReadPixels() returns for
+///         GL_BGRA, so they're written as they come.
+///
+///         The queue holds at most max_queued images; write() waits for
+///         room, so a disk slower than the renderer throttles it rather
+///         than filling memory.  A file which can't be written is reported
+///         to stderr and counted, since there's nobody to throw to on the
+///         writer's thread.  The writer doesn't need a GL context.
+class ImageWriter
+{
+public:
+    explicit ImageWriter(size_t max_queued = 8);
+    ~ImageWriter();
+
+    void write(const std::string& path, GLsizei width, GLsizei height, std::vector<unsigned char>& pixels);
+    void flush();
+
+    size_t getWrittenCount() const;
+    size_t getFailureCount() const;
+
+private:
+    ImageWriter(const ImageWriter&);            // non-copyable
+    ImageWriter& operator=(const ImageWriter&); // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  An image waiting to be written.
+    struct Image
+    {
+        std::string path;
+        GLsizei width;
+        GLsizei height;
+        std::vector<unsigned char> pixels;  ///< width * height BGRA pixels, bottom row first.
+    };
+
+    void threadMain();
+
+    size_t max_queued_;
+    std::deque<Image> queue_;
+    bool writing_;              ///< Whether the thread is writing an image it has taken off the queue.
+    bool stopping_;
+    size_t written_count_;
+    size_t failure_count_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;      ///< Signaled when an image is queued, or on stopping.
+    std::condition_variable written_;   ///< Signaled when an image has been written.
+    std::thread thread_;
+};
+
+bool writeTgaFile(const std::string& path, GLsizei width, GLsizei height, const unsigned char* pixels);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An offscreen framebuffer to render preview images into, which
+///         reads them back asynchronously and hands them to an ImageWriter.
+///
+/// \details capture() doesn't wait for the frame to finish rendering:
+///         glReadPixels() into a pixel pack buffer only queues the copy, and
+///         a fence is placed after it.  The buffers form a ring, and a
+///         buffer is only mapped when it comes round again, by which time
+///         readback_count - 1 more frames have been queued behind it, so the
+///         GPU is always rendering the next frames while the CPU copies out
+///         an older one.  The writer then encodes and writes it on its own
+///         thread.  Images are written in the order they were captured.
+///
+///         Must be created, used and destroyed on the thread which owns the
+///         GL context.
+class PreviewTarget
+{
+public:
+    PreviewTarget(GLsizei width, GLsizei height, size_t readback_count = 3, size_t max_queued = 8);
+    ~PreviewTarget();
+
+    void bind();
+    void capture(const std::string& path);
+    void finish();
+
+    GLsizei getWidth() const;
+    GLsizei getHeight() const;
+    size_t getWrittenCount() const;
+    size_t getFailureCount() const;
+
+private:
+    PreviewTarget(const PreviewTarget&);            // non-copyable
+    PreviewTarget& operator=(const PreviewTarget&); // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One pixel pack buffer of the ring.
+    struct Readback
+    {
+        GLuint buffer_id;
+        GLsync fence;       ///< After the glReadPixels() into the buffer, or 0 if it's free.
+        std::string path;   ///< Where the image being read back is to be written.
+    };
+
+    void retire(Readback& readback);
+
+    GLsizei width_;
+    GLsizei height_;
+    GLuint framebuffer_id_;
+    GLuint renderbuffer_id_;
+    std::vector<Readback> readbacks_;
+    size_t next_readback_;
+    ImageWriter writer_;
+};
+
+#endif
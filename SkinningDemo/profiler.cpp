@@ -0,0 +1,221 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  profiler.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of TimingStats, ScopedTimer and GpuTimer class
+///         functions.
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>    // freeglut has already included it with NOMINMAX
+#else
+#include <chrono>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty set of timing statistics.
+///
+/// \param  name The name shown by formatTimingStats().
+/// \param  window The number of most recent samples to keep.
+TimingStats::TimingStats(const std::string& name, size_t window)
+    : name_(name),
+      window_(std::max(window, size_t(1))),
+      next_sample_(0)
+{
+    samples_.reserve(window_);
+    sorted_.reserve(window_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records a sample, replacing the oldest one if the window is full.
+void TimingStats::addSample(double milliseconds)
+{
+    if (samples_.size() < window_)
+    {
+        samples_.push_back(milliseconds);
+        return;
+    }
+
+    samples_[next_sample_] = milliseconds;
+    next_sample_ = (next_sample_ + 1) % window_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the name given to the constructor.
+const std::string& TimingStats::getName() const
+{
+    return name_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of samples in the window.
+size_t TimingStats::getSampleCount() const
+{
+    return samples_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the mean of the samples in the window, or 0 if there
+///         aren't any.
+double TimingStats::getMean() const
+{
+    if (samples_.empty())
+        return 0;
+
+    double sum = 0;
+    for (size_t i = 0; i < samples_.size(); ++i)
+        sum += samples_[i];
+
+    return sum / samples_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the smallest sample which at least the given percentage
+///         of the window is less than or equal to, or 0 if there aren't any
+///         samples.
+///
+/// \param  percent The percentile to find, from 0 to 100; 50 is the median.
+double TimingStats::getPercentile(double percent) const
+{
+    if (samples_.empty())
+        return 0;
+
+    size_t rank = size_t(std::ceil(percent / 100.0 * samples_.size()));
+    size_t index = std::min(std::max(rank, size_t(1)), samples_.size()) - 1;
+
+    sorted_.assign(samples_.begin(), samples_.end());
+    std::nth_element(sorted_.begin(), sorted_.begin() + index, sorted_.end());
+    return sorted_[index];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the most recent sample, or 0 if there aren't any.
+double TimingStats::getLatest() const
+{
+    if (samples_.empty())
+        return 0;
+
+    if (samples_.size() < window_)
+        return samples_.back();
+
+    return samples_[(next_sample_ + window_ - 1) % window_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the time in milliseconds since some fixed point, from the
+///         highest resolution monotonic clock available.
+///
+/// \details On Windows this is QueryPerformanceCounter(); VS2012's
+///         std::chrono::high_resolution_clock only ticks about once a
+///         millisecond, which is far too coarse for timing kernels.
+double getTimeMilliseconds()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return double(counter.QuadPart) * 1000.0 / double(frequency.QuadPart);
+#else
+    std::chrono::steady_clock::duration now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() / 1000000.0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts timing.
+ScopedTimer::ScopedTimer(TimingStats& stats)
+    : stats_(stats),
+      start_(getTimeMilliseconds())
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops timing, and adds the elapsed time to the stats.
+ScopedTimer::~ScopedTimer()
+{
+    stats_.addSample(getTimeMilliseconds() - start_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the timer's query objects.
+///
+/// \param  name The name of the timer's TimingStats.
+/// \param  window The number of most recent results to keep.
+GpuTimer::GpuTimer(const std::string& name, size_t window)
+    : stats_(name, window),
+      current_query_(0)
+{
+    glGenQueries(N_QUERIES, query_ids_);
+    for (size_t i = 0; i < N_QUERIES; ++i)
+        pending_[i] = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the timer's query objects.
+GpuTimer::~GpuTimer()
+{
+    glDeleteQueries(N_QUERIES, query_ids_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects the result of the next query if it's ready, then starts
+///         timing the commands which follow with it.
+void GpuTimer::begin()
+{
+    GLuint query_id = query_ids_[current_query_];
+    if (pending_[current_query_])
+    {
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query_id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query_id, GL_QUERY_RESULT, &nanoseconds);
+            stats_.addSample(nanoseconds / 1000000.0);
+        }
+
+        pending_[current_query_] = false;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, query_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops timing, and switches to the other query for next time.
+void GpuTimer::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    pending_[current_query_] = true;
+    current_query_ = (current_query_ + 1) % N_QUERIES;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the GPU times collected so far.
+const TimingStats& GpuTimer::getStats() const
+{
+    return stats_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Formats the mean, median and 99th percentile of some timing
+///         statistics as a single line of text.
+///
+/// \param  stats The statistics to format.
+/// \return Something like "skinning (gpu)    mean 0.412  p50 0.398  p99 0.873 ms".
+std::string formatTimingStats(const TimingStats& stats)
+{
+    std::ostringstream text;
+    text << std::left << std::setw(18) << stats.getName() << std::right << std::fixed << std::setprecision(3)
+         << "mean " << std::setw(7) << stats.getMean()
+         << "  p50 " << std::setw(7) << stats.getPercentile(50)
+         << "  p99 " << std::setw(7) << stats.getPercentile(99) << " ms";
+    return text.str();
+}
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  profiler.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the TimingStats, ScopedTimer and GpuTimer
+///         classes.
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "demo.h"
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Keeps the most recent samples of a timing, in milliseconds, and
+///         summarizes them.
+///
+/// \details Samples are kept in a fixed-size ring, so once it's full each
+///         new sample replaces the oldest and the statistics cover a rolling
+///         window of frames.
+class TimingStats
+{
+public:
+    explicit TimingStats(const std::string& name, size_t window = 120);
+
+    void addSample(double milliseconds);
+
+    const std::string& getName() const;
+    size_t getSampleCount() const;
+    double getMean() const;
+    double getPercentile(double percent) const;
+    double getLatest() const;
+
+private:
+    std::string name_;
+    std::vector<double> samples_;
+    size_t window_;
+    size_t next_sample_;                    ///< Where the next sample goes once the window is full.
+    mutable std::vector<double> sorted_;    ///< Scratch space for getPercentile().
+};
+
+double getTimeMilliseconds();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds the CPU time between its construction and destruction to a
+///         TimingStats.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(TimingStats& stats);
+    ~ScopedTimer();
+
+private:
+    ScopedTimer(const ScopedTimer&);            // non-copyable
+    ScopedTimer& operator=(const ScopedTimer&); // non-copyable
+
+    TimingStats& stats_;
+    double start_;  ///< getTimeMilliseconds() when the timer was created.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Measures how long the GPU spends on the commands between begin()
+///         and end() with GL_TIME_ELAPSED queries (GL 3.3).
+///
+/// \details A query's result isn't available until the GPU has caught up,
+///         so the timer alternates between two queries: each begin() reads
+///         back the result of the query issued two frames earlier, if it is
+///         ready, and reuses that query.  Results which still aren't ready
+///         are dropped rather than waited for, so timing never stalls the
+///         pipeline.
+///
+///         Only one GL_TIME_ELAPSED query can be active at a time, so
+///         GpuTimers can't be nested.
+class GpuTimer
+{
+public:
+    explicit GpuTimer(const std::string& name, size_t window = 120);
+    ~GpuTimer();
+
+    void begin();
+    void end();
+
+    const TimingStats& getStats() const;
+
+private:
+    GpuTimer(const GpuTimer&);              // non-copyable
+    GpuTimer& operator=(const GpuTimer&);   // non-copyable
+
+    static const size_t N_QUERIES = 2;
+
+    TimingStats stats_;
+    GLuint query_ids_[N_QUERIES];
+    bool pending_[N_QUERIES];               ///< Whether each query has a result which hasn't been read.
+    size_t current_query_;
+};
+
+std::string formatTimingStats(const TimingStats& stats);
+
+#endif
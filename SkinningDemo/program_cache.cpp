@@ -0,0 +1,408 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  program_cache.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of ProgramCache class functions.
+
+#include "program_cache.h"
+#include "shader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1     // KHR_parallel_shader_compile, which this GLEW predates
+#endif
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Feeds a string into a 64-bit FNV-1a hash, followed by a 0 byte so
+///         that consecutive strings can't run together.
+void hashString(const std::string& str, unsigned long long& hash)
+{
+    const unsigned long long prime = 1099511628211ull;
+
+    for (size_t i = 0; i < str.size(); ++i)
+        hash = (hash ^ (unsigned char)str[i]) * prime;
+
+    hash *= prime;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a GL string, or an empty string if it isn't available.
+std::string getGLString(GLenum name)
+{
+    const GLubyte* str = glGetString(name);
+    return str != nullptr ? std::string(reinterpret_cast<const char*>(str)) : std::string();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the context has an extension, looking through
+///         them one at a time as core contexts require.
+bool hasExtension(const char* name)
+{
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint i = 0; i < extension_count; ++i)
+    {
+        const GLubyte* extension = glGetStringi(GL_EXTENSIONS, GLuint(i));
+        if (extension != nullptr && std::strcmp(reinterpret_cast<const char*>(extension), name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a cache which stores program binaries in a directory.
+///
+/// \details The directory is created if it doesn't exist.  If it can't be
+///         created, programs are still built; they just aren't saved.
+///
+/// \param  directory The directory to load and save program binaries in.
+ProgramCache::ProgramCache(const std::string& directory)
+    : directory_(directory),
+      binaries_supported_(false),
+      parallel_compile_(hasExtension("GL_KHR_parallel_shader_compile") ||
+                        hasExtension("GL_ARB_parallel_shader_compile")),
+      hit_count_(0),
+      miss_count_(0)
+{
+    driver_ = getGLString(GL_VENDOR) + "\n" + getGLString(GL_RENDERER) + "\n" + getGLString(GL_VERSION);
+
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+    {
+        GLint format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        binaries_supported_ = format_count > 0;
+    }
+
+    if (binaries_supported_)
+    {
+#ifdef _WIN32
+        _mkdir(directory_.c_str());
+#else
+        mkdir(directory_.c_str(), 0755);
+#endif
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts building a shader program.
+///
+/// \details program_id is assigned straight away, but the program may not
+///         be used until finish() has been called.  The arguments are the
+///         same as for compileShaderProgram().
+///
+/// \param  program_id Receives the ID of the new program.  It must remain
+///         valid until finish() returns, since finish() replaces it if the
+///         program has to be rebuilt.
+void ProgramCache::requestProgram(GLuint& program_id,
+                                  const std::string& vertex_shader_source,
+                                  const std::string& fragment_shader_source,
+                                  const std::vector<const char*>& feedback_varyings,
+                                  const std::string& geometry_shader_source)
+{
+    std::string path = getCachePath(vertex_shader_source, fragment_shader_source, feedback_varyings,
+                                    geometry_shader_source);
+
+    program_id = glCreateProgram();
+    if (binaries_supported_ && loadProgram(program_id, path))
+    {
+        ++hit_count_;
+        return;
+    }
+
+    ++miss_count_;
+
+    GLuint vert_shader_id = glCreateShader(GL_VERTEX_SHADER);
+    GLuint frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
+
+    const char* vert_cstr = vertex_shader_source.c_str();
+    const char* frag_cstr = fragment_shader_source.c_str();
+
+    glShaderSource(vert_shader_id, 1, &vert_cstr, NULL);
+    glShaderSource(frag_shader_id, 1, &frag_cstr, NULL);
+
+    glCompileShader(vert_shader_id);
+    glCompileShader(frag_shader_id);
+
+    GLuint geom_shader_id = 0;
+    if (!geometry_shader_source.empty())
+    {
+        geom_shader_id = glCreateShader(GL_GEOMETRY_SHADER);
+        const char* geom_cstr = geometry_shader_source.c_str();
+        glShaderSource(geom_shader_id, 1, &geom_cstr, NULL);
+        glCompileShader(geom_shader_id);
+    }
+
+    glAttachShader(program_id, vert_shader_id);
+    glAttachShader(program_id, frag_shader_id);
+    if (geom_shader_id != 0)
+        glAttachShader(program_id, geom_shader_id);
+    if (!feedback_varyings.empty())
+    {
+        // this version of GLEW takes a non-const array of names.
+        std::vector<const GLchar*> varyings(feedback_varyings.begin(), feedback_varyings.end());
+        glTransformFeedbackVaryings(program_id, GLsizei(varyings.size()), &varyings[0], GL_INTERLEAVED_ATTRIBS);
+    }
+    if (binaries_supported_)
+        glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    // the program keeps what it needs from the shaders when it's linked, so
+    // they can be deleted without waiting for the results.
+    glLinkProgram(program_id);
+    glDetachShader(program_id, vert_shader_id);
+    glDetachShader(program_id, frag_shader_id);
+    glDeleteShader(vert_shader_id);
+    glDeleteShader(frag_shader_id);
+    if (geom_shader_id != 0)
+    {
+        glDetachShader(program_id, geom_shader_id);
+        glDeleteShader(geom_shader_id);
+    }
+
+    PendingProgram pending;
+    pending.program_id = &program_id;
+    pending.vertex_shader_source = vertex_shader_source;
+    pending.fragment_shader_source = fragment_shader_source;
+    pending.geometry_shader_source = geometry_shader_source;
+    pending.feedback_varyings = feedback_varyings;
+    pending.path = path;
+    pending_.push_back(pending);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts building a compute program.
+///
+/// \details As with requestProgram(), the program may not be used until
+///         finish() has been called.  Requires GL 4.3.
+///
+/// \param  program_id Receives the ID of the new program, and must remain
+///         valid until finish() returns.
+/// \param  compute_shader_source The complete GLSL source for the compute
+///         shader, including the #version directive.
+void ProgramCache::requestComputeProgram(GLuint& program_id, const std::string& compute_shader_source)
+{
+    std::string path = getComputeCachePath(compute_shader_source);
+
+    program_id = glCreateProgram();
+    if (binaries_supported_ && loadProgram(program_id, path))
+    {
+        ++hit_count_;
+        return;
+    }
+
+    ++miss_count_;
+
+    GLuint shader_id = glCreateShader(GL_COMPUTE_SHADER);
+    const char* cstr = compute_shader_source.c_str();
+    glShaderSource(shader_id, 1, &cstr, NULL);
+    glCompileShader(shader_id);
+
+    glAttachShader(program_id, shader_id);
+    if (binaries_supported_)
+        glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program_id);
+    glDetachShader(program_id, shader_id);
+    glDeleteShader(shader_id);
+
+    PendingProgram pending;
+    pending.program_id = &program_id;
+    pending.compute_shader_source = compute_shader_source;
+    pending.path = path;
+    pending_.push_back(pending);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if finish() won't have to wait for the driver: every
+///         program compiled since the last finish() is built, successfully
+///         or not.
+///
+/// \details Only asks the driver for the programs' completion status, which
+///         never waits.  Without KHR_parallel_shader_compile there's no way
+///         to ask, so this is always true, and finish() waits as it always
+///         has.
+bool ProgramCache::isReady() const
+{
+    if (!parallel_compile_)
+        return true;
+
+    for (size_t i = 0; i < pending_.size(); ++i)
+    {
+        GLint complete = GL_TRUE;
+        glGetProgramiv(*pending_[i].program_id, GL_COMPLETION_STATUS_KHR, &complete);
+        if (complete != GL_TRUE)
+            return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits for every requested program to finish building, and saves
+///         the binaries of the ones that weren't loaded from the cache.
+///
+/// \details If a program failed to build, it's rebuilt with
+///         compileShaderProgram() or compileComputeProgram(), which report
+///         the errors to stderr and throw an exception.
+void ProgramCache::finish()
+{
+    for (size_t i = 0; i < pending_.size(); ++i)
+    {
+        const PendingProgram& pending = pending_[i];
+
+        GLint result = GL_FALSE;
+        glGetProgramiv(*pending.program_id, GL_LINK_STATUS, &result);
+        if (result != GL_TRUE)
+        {
+            // rebuilding reports the errors and throws, or if the failure
+            // was somehow transient, replaces the program.  If it throws,
+            // the ID is left 0 rather than naming a deleted program.
+            glDeleteProgram(*pending.program_id);
+            *pending.program_id = 0;
+            if (!pending.compute_shader_source.empty())
+                *pending.program_id = compileComputeProgram(pending.compute_shader_source);
+            else
+            {
+                *pending.program_id = compileShaderProgram(pending.vertex_shader_source,
+                                                           pending.fragment_shader_source,
+                                                           pending.feedback_varyings,
+                                                           pending.geometry_shader_source);
+            }
+        }
+
+        if (binaries_supported_)
+            saveProgram(*pending.program_id, pending.path);
+    }
+
+    pending_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of requested programs which were loaded from
+///         the cache.
+size_t ProgramCache::getHitCount() const
+{
+    return hit_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of requested programs which had to be
+///         compiled.
+size_t ProgramCache::getMissCount() const
+{
+    return miss_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the path of the file which holds the binary of a program
+///         built from the given sources on the current driver.
+std::string ProgramCache::getCachePath(const std::string& vertex_shader_source,
+                                       const std::string& fragment_shader_source,
+                                       const std::vector<const char*>& feedback_varyings,
+                                       const std::string& geometry_shader_source) const
+{
+    unsigned long long hash = 14695981039346656037ull;
+    hashString(driver_, hash);
+    hashString(vertex_shader_source, hash);
+    hashString(fragment_shader_source, hash);
+    for (size_t i = 0; i < feedback_varyings.size(); ++i)
+        hashString(feedback_varyings[i], hash);
+
+    // programs without a geometry shader keep the paths they always had.
+    if (!geometry_shader_source.empty())
+    {
+        hashString("geometry", hash);
+        hashString(geometry_shader_source, hash);
+    }
+
+    char name[32];
+    std::sprintf(name, "%016llx.bin", hash);
+    return directory_ + "/" + name;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the path of the file which holds the binary of a compute
+///         program built from the given source on the current driver.
+///
+/// \details The stage is hashed too, so a compute shader can never collide
+///         with a graphics program whose sources happen to hash the same.
+std::string ProgramCache::getComputeCachePath(const std::string& compute_shader_source) const
+{
+    unsigned long long hash = 14695981039346656037ull;
+    hashString(driver_, hash);
+    hashString("compute", hash);
+    hashString(compute_shader_source, hash);
+
+    char name[32];
+    std::sprintf(name, "%016llx.bin", hash);
+    return directory_ + "/" + name;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Loads a program binary saved by saveProgram().
+///
+/// \param  program_id The program to load the binary into.
+/// \param  path The file to load from.
+/// \return false if there was no usable binary in the file; the driver can
+///         reject binaries even when they match, in which case the program
+///         must be rebuilt from source.
+bool ProgramCache::loadProgram(GLuint program_id, const std::string& path) const
+{
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+
+    GLenum format;
+    if (!file.read(reinterpret_cast<char*>(&format), sizeof(format)))
+        return false;
+
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return false;
+
+    glProgramBinary(program_id, format, binary.data(), GLsizei(binary.size()));
+
+    GLint result = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &result);
+    return result == GL_TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Saves a linked program's binary, as a GLenum binary format
+///         followed by the binary itself.  Failures are ignored; the program
+///         will just be compiled again next time.
+///
+/// \param  program_id The program to save.
+/// \param  path The file to save to.
+void ProgramCache::saveProgram(GLuint program_id, const std::string& path) const
+{
+    GLint length = 0;
+    glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program_id, length, &length, &format, binary.data());
+
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file)
+        return;
+
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), length);
+}
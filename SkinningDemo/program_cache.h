@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  program_cache.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the ProgramCache class.
+
+#ifndef PROGRAM_CACHE_H_
+#define PROGRAM_CACHE_H_
+
+#include "demo.h"
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds batches of shader programs, reusing program binaries saved
+///         on disk by earlier runs where possible.
+///
+/// \details Each program requested with requestProgram() is looked up in the
+///         cache directory by a hash of its sources, its transform feedback
+///         varyings, and the GL vendor, renderer and version strings, so a
+///         driver update invalidates everything.  Hits are loaded with
+///         glProgramBinary.
+///
+///         Misses are compiled and linked without waiting on any results;
+///         nothing queries their status until finish().  Drivers which
+///         compile on background threads can then work on every program in
+///         the batch at once, instead of stalling on each one in turn.
+///         finish() saves the binaries of the new programs for next time.
+///
+///         Compute programs are built the same way, with
+///         requestComputeProgram(), so a loading screen can request every
+///         program the content needs, graphics and compute, and pay for a
+///         single wait at the end instead of one per compute shader.
+///
+///         With KHR_parallel_shader_compile, isReady() can ask whether the
+///         driver has finished every program in the batch without waiting
+///         for any of them, so the caller can carry on with other work (or
+///         other frames) until finish() won't block.  Without it, the driver
+///         can't be asked, so isReady() always says yes.
+///
+///         Program binaries require GL 4.1 or ARB_get_program_binary.
+///         Without them, every request is a miss and nothing is saved.
+class ProgramCache
+{
+public:
+    explicit ProgramCache(const std::string& directory);
+
+    void requestProgram(GLuint& program_id,
+                        const std::string& vertex_shader_source,
+                        const std::string& fragment_shader_source,
+                        const std::vector<const char*>& feedback_varyings = std::vector<const char*>(),
+                        const std::string& geometry_shader_source = std::string());
+    void requestComputeProgram(GLuint& program_id, const std::string& compute_shader_source);
+
+    bool isReady() const;
+    void finish();
+
+    size_t getHitCount() const;
+    size_t getMissCount() const;
+
+private:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A program which was compiled by requestProgram() or
+    ///         requestComputeProgram(), and hasn't been checked yet.
+    struct PendingProgram
+    {
+        GLuint* program_id;
+        std::string vertex_shader_source;
+        std::string fragment_shader_source;
+        std::string geometry_shader_source; ///< Empty for a program without one.
+        std::string compute_shader_source;  ///< Empty for a graphics program.
+        std::vector<const char*> feedback_varyings;
+        std::string path;
+    };
+
+    std::string getCachePath(const std::string& vertex_shader_source,
+                             const std::string& fragment_shader_source,
+                             const std::vector<const char*>& feedback_varyings,
+                             const std::string& geometry_shader_source) const;
+    std::string getComputeCachePath(const std::string& compute_shader_source) const;
+
+    bool loadProgram(GLuint program_id, const std::string& path) const;
+    void saveProgram(GLuint program_id, const std::string& path) const;
+
+    std::string directory_;
+    std::string driver_;
+    bool binaries_supported_;
+    bool parallel_compile_;             ///< The driver has KHR_parallel_shader_compile, so programs can be polled.
+
+    std::vector<PendingProgram> pending_;
+    size_t hit_count_;
+    size_t miss_count_;
+};
+
+#endif
@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  ragdoll.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of Ragdoll class functions.
+
+#include "ragdoll.h"
+#include "joint_rotation.h"
+
+#include <algorithm>
+
+namespace {
+
+const float GRAVITY = 600.0f;       ///< The angular acceleration of a horizontal bone, in degrees per second squared.
+const float STIFFNESS = 20.0f;      ///< The pull back towards the rest pose, per degree away from it.
+const float DAMPING = 3.0f;         ///< The fraction of the angular velocity lost per second.
+const float START_SPIN = 90.0f;     ///< Each joint's starting angular velocity, alternating in direction.
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a ragdoll at rest in a pose, with each joint given a
+///         small spin so that bones balanced straight up still fall.
+///
+/// \param  skeleton The skeleton whose hierarchy the ragdoll copies.
+/// \param  rest_pose The pose the ragdoll starts in, and is sprung towards.
+Ragdoll::Ragdoll(const Skeleton& skeleton, const Pose& rest_pose)
+    : step_(0)
+{
+    size_t joint_count = skeleton.getJointCount();
+    parents_.resize(joint_count);
+    weights_.resize(joint_count);
+    angular_velocities_.resize(joint_count);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        int parent = skeleton.getParent(joint);
+        parents_[joint] = parent;
+
+        size_t depth = 0;
+        for (int ancestor = parent; ancestor != Skeleton::NO_PARENT; ancestor = skeleton.getParent(ancestor))
+            ++depth;
+        weights_[joint] = depth == 0 ? 0.0f : depth == 1 ? 0.5f : 1.0f;
+
+        angular_velocities_[joint] = parent == Skeleton::NO_PARENT ? 0.0f
+                                   : joint % 2 == 0 ? START_SPIN : -START_SPIN;
+    }
+
+    rest_translations_.assign(rest_pose.translation, rest_pose.translation + joint_count);
+    rest_rotations_.assign(rest_pose.rotation, rest_pose.rotation + joint_count);
+    rest_scales_.assign(rest_pose.scale, rest_pose.scale + joint_count);
+    angles_.assign(joint_count, 0.0f);
+    model_rotations_.resize(joint_count);
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        int parent = parents_[joint];
+        model_rotations_[joint] = rest_rotations_[joint] + (parent == Skeleton::NO_PARENT ? 0.0f : model_rotations_[parent]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Advances the simulation with one semi-implicit Euler step.
+///
+/// \details Gravity's torque on a bone is strongest when it's horizontal,
+///         and pulls it towards hanging straight down; each bone lies
+///         along its joint's x axis, so that's -cos of its rotation in
+///         model space.  The model space rotations from the last step are
+///         used for every joint, so the joints don't depend on each other
+///         within a step.
+///
+/// \param  seconds The simulated time the step covers.
+void Ragdoll::step(float seconds)
+{
+    float damping = std::max(1.0f - DAMPING * seconds, 0.0f);
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+    {
+        if (parents_[joint] == Skeleton::NO_PARENT)
+            continue;
+
+        float s, c;
+        sinCosDegrees(model_rotations_[joint], s, c);
+        float acceleration = -GRAVITY * c - STIFFNESS * angles_[joint];
+        angular_velocities_[joint] = (angular_velocities_[joint] + acceleration * seconds) * damping;
+        angles_[joint] += angular_velocities_[joint] * seconds;
+    }
+
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+    {
+        int parent = parents_[joint];
+        float rotation = rest_rotations_[joint] + angles_[joint];
+        model_rotations_[joint] = rotation + (parent == Skeleton::NO_PARENT ? 0.0f : model_rotations_[parent]);
+    }
+
+    ++step_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes every joint's model space transform and weight, as of
+///         the last step, into a frame.
+void Ragdoll::write(PhysicsPoseFrame& frame) const
+{
+    size_t joint_count = parents_.size();
+    frame.step = step_;
+    frame.positions.resize(joint_count);
+    frame.rotations.assign(model_rotations_.begin(), model_rotations_.end());
+    frame.scales.resize(joint_count);
+    frame.weights.assign(weights_.begin(), weights_.end());
+
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        int parent = parents_[joint];
+        if (parent == Skeleton::NO_PARENT)
+        {
+            frame.positions[joint] = rest_translations_[joint];
+            frame.scales[joint] = rest_scales_[joint];
+            continue;
+        }
+
+        float s, c;
+        sinCosDegrees(model_rotations_[parent], s, c);
+        vec2 offset = frame.scales[parent] * rest_translations_[joint];
+        frame.positions[joint] = frame.positions[parent] + vec2(c * offset.x - s * offset.y, s * offset.x + c * offset.y);
+        frame.scales[joint] = frame.scales[parent] * rest_scales_[joint];
+    }
+}
@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  ragdoll.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the Ragdoll class.
+
+#ifndef RAGDOLL_H_
+#define RAGDOLL_H_
+
+#include "physics_pose_input.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A very simple stand-in for a physics engine's ragdoll: each
+///         joint is a damped pendulum which gravity pulls its bone down
+///         with, sprung loosely towards a rest pose.
+///
+/// \details The root stays where the rest pose puts it, and every other
+///         joint swings about its parent, so the ragdoll hangs from the
+///         root.  Everything the simulation needs is copied from the
+///         skeleton and rest pose when the ragdoll is created, so it can be
+///         stepped on a thread of its own, without touching anything the
+///         animation owns; all it hands back is a PhysicsPoseFrame.
+///
+///         The frame's weights grow with each joint's depth below the root:
+///         the root is left to the animation, the joints just below it
+///         follow the physics halfway, and everything further down follows
+///         it completely, so the limbs flop more the further out they are.
+class Ragdoll
+{
+public:
+    Ragdoll(const Skeleton& skeleton, const Pose& rest_pose);
+
+    void step(float seconds);
+    void write(PhysicsPoseFrame& frame) const;
+
+private:
+    Ragdoll(const Ragdoll&);                // non-copyable
+    Ragdoll& operator=(const Ragdoll&);     // non-copyable
+
+    size_t step_;
+    std::vector<int> parents_;
+    std::vector<vec2> rest_translations_;
+    std::vector<float> rest_rotations_;
+    std::vector<float> rest_scales_;
+    std::vector<float> weights_;
+    std::vector<float> angles_;             ///< Each joint's rotation away from the rest pose, in degrees.
+    std::vector<float> angular_velocities_; ///< In degrees per second.
+    std::vector<float> model_rotations_;    ///< Each joint's rotation in model space, as of the last step.
+};
+
+#endif
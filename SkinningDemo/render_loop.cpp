@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  render_loop.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of RenderLoop class functions.
+
+#include "render_loop.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a loop over a platform's windows, which isn't running.
+RenderLoop::RenderLoop(Platform& platform)
+    : platform_(platform),
+      running_(false),
+      quitting_(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Calls a function once, after a delay, from the loop.
+///
+/// \details Like glutTimerFunc(), a timer only runs once; a function which
+///         should keep running adds itself again.  Timers may be added from
+///         anywhere on the loop's thread, including other timers and window
+///         callbacks, before or while the loop runs.
+///
+/// \param  milliseconds How long to wait.  The timer runs on the first pass
+///         of the loop after that, which is never earlier.
+void RenderLoop::addTimer(double milliseconds, TimerFunction function, void* data)
+{
+    Timer timer;
+    timer.due = getTimeMilliseconds() + std::max(milliseconds, 0.0);
+    timer.function = function;
+    timer.data = data;
+    timers_.push_back(timer);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs the loop until quit() is called, or every window has been
+///         closed.
+void RenderLoop::run()
+{
+    running_ = true;
+    quitting_ = false;
+
+    while (!quitting_ && platform_.hasOpenWindows())
+    {
+        platform_.waitEvents(getTimeout(getTimeMilliseconds()));
+        if (quitting_)
+            break;
+
+        runDueTimers(getTimeMilliseconds());
+        if (quitting_)
+            break;
+
+        drawPostedWindows();
+    }
+
+    running_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Ends the loop once the callback or timer which calls this
+///         returns.  The timers which haven't run are kept.
+void RenderLoop::quit()
+{
+    quitting_ = true;
+}
+
+bool RenderLoop::isRunning() const
+{
+    return running_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs the timers which have come due, in the order they're due.
+///         Timers they add don't run until the next pass, even with no
+///         delay, so a timer which re-adds itself can't starve the windows.
+void RenderLoop::runDueTimers(double now)
+{
+    due_timers_.clear();
+    size_t kept = 0;
+    for (size_t i = 0; i < timers_.size(); ++i)
+    {
+        if (timers_[i].due <= now)
+            due_timers_.push_back(timers_[i]);
+        else
+            timers_[kept++] = timers_[i];
+    }
+    timers_.resize(kept);
+
+    std::stable_sort(due_timers_.begin(), due_timers_.end(), isDueBefore);
+    for (size_t i = 0; i < due_timers_.size() && !quitting_; ++i)
+        due_timers_[i].function(due_timers_[i].data);
+}
+
+bool RenderLoop::isDueBefore(const Timer& a, const Timer& b)
+{
+    return a.due < b.due;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Calls the display callback of each open window with a redisplay
+///         posted.  The redisplay is taken first, so the callback can post
+///         the next one.
+void RenderLoop::drawPostedWindows()
+{
+    for (size_t i = 0; i < platform_.getWindowCount() && !quitting_; ++i)
+    {
+        PlatformWindow* window = platform_.getWindow(i);
+        if (!window->takeRedisplay())
+            continue;
+
+        window->makeCurrent();
+        if (window->getCallbacks().display != nullptr)
+            window->getCallbacks().display(*window);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how long the platform may wait for events: not at all if
+///         a window is waiting to be drawn, until the next timer if there is
+///         one, or else indefinitely (-1).
+double RenderLoop::getTimeout(double now) const
+{
+    for (size_t i = 0; i < platform_.getWindowCount(); ++i)
+    {
+        if (platform_.getWindow(i)->isRedisplayPosted())
+            return 0;
+    }
+
+    if (timers_.empty())
+        return -1;
+
+    double due = timers_[0].due;
+    for (size_t i = 1; i < timers_.size(); ++i)
+        due = std::min(due, timers_[i].due);
+    return std::max(due - now, 0.0);
+}
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  render_loop.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the RenderLoop class.
+
+#ifndef RENDER_LOOP_H_
+#define RENDER_LOOP_H_
+
+#include "platform.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The program's main loop: waits for a Platform's events, runs
+///         timers as they come due, and draws the windows which have posted
+///         a redisplay.
+///
+/// \details Each pass delivers events, then runs the timers which are due,
+///         then calls the display callback of every open window with a
+///         redisplay posted, with its context current.  Between passes the
+///         loop waits for an event, but never past the next timer, and not
+///         at all if a window is waiting to be drawn.  Nothing is drawn but
+///         what was posted, so an idle program doesn't draw.
+///
+///         The loop ends when quit() is called, or once every window has
+///         been closed.
+class RenderLoop
+{
+public:
+    typedef void (*TimerFunction)(void* data);
+
+    explicit RenderLoop(Platform& platform);
+
+    void addTimer(double milliseconds, TimerFunction function, void* data);
+
+    void run();
+    void quit();
+    bool isRunning() const;
+
+private:
+    struct Timer
+    {
+        double due;             ///< getTimeMilliseconds() when it should run.
+        TimerFunction function;
+        void* data;
+    };
+
+    static bool isDueBefore(const Timer& a, const Timer& b);
+
+    void runDueTimers(double now);
+    void drawPostedWindows();
+    double getTimeout(double now) const;
+
+    Platform& platform_;
+    std::vector<Timer> timers_;
+    std::vector<Timer> due_timers_;
+    bool running_;
+    bool quitting_;
+
+    // non-copyable
+    RenderLoop(const RenderLoop&);
+    void operator=(const RenderLoop&);
+};
+
+#endif
@@ -0,0 +1,348 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  render_queue.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of RenderQueue class functions.
+
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+const size_t RADIX_BITS = 8;                        ///< The bits of the key each pass of the sort orders by.
+const size_t RADIX_BUCKETS = 1 << RADIX_BITS;
+const size_t RADIX_PASSES = 64 / RADIX_BITS;
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the palette index buffer and an empty command buffer.
+///
+/// \param  max_palettes One more than the largest palette index which will
+///         be passed to add().
+RenderQueue::RenderQueue(size_t max_palettes)
+    : max_palettes_(max_palettes),
+      recorded_(false),
+      replayed_(false),
+      batch_count_(0),
+      palette_index_buffer_id_(0),
+      command_buffer_id_(0),
+      command_buffer_size_(0)
+{
+    std::vector<GLuint> palette_indices(max_palettes);
+    for (size_t i = 0; i < max_palettes; ++i)
+        palette_indices[i] = GLuint(i);
+
+    glGenBuffers(1, &palette_index_buffer_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, palette_index_buffer_id_);
+    glBufferData(GL_ARRAY_BUFFER, palette_indices.size() * sizeof(GLuint), palette_indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &command_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the queue's buffers.
+RenderQueue::~RenderQueue()
+{
+    glDeleteBuffers(1, &palette_index_buffer_id_);
+    glDeleteBuffers(1, &command_buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets up PALETTE_INDEX_ATTRIBUTE in a VAO, reading one palette
+///         index per instance.
+void RenderQueue::attachPaletteIndices(GLuint vao_id) const
+{
+    glBindVertexArray(vao_id);
+    glBindBuffer(GL_ARRAY_BUFFER, palette_index_buffer_id_);
+    glVertexAttribIPointer(PALETTE_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), nullptr);
+    glVertexAttribDivisor(PALETTE_INDEX_ATTRIBUTE, 1);
+    glEnableVertexAttribArray(PALETTE_INDEX_ATTRIBUTE);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Removes every draw from the queue, to start collecting the next
+///         frame's.  The recording of the last submit() is kept, to replay
+///         if the same draws are queued again.
+void RenderQueue::clear()
+{
+    draws_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a draw of one partition of a mesh in a MeshArena.
+///
+/// \param  program_id The program to draw with; typically the one compiled
+///         for the partition's influence count.
+/// \param  allocation The mesh to draw.
+/// \param  partition One of allocation.partitions.
+/// \param  palette_index The index of the palette the draw should use, which
+///         the vertex shader reads from PALETTE_INDEX_ATTRIBUTE.
+/// \param  palette_buffer_id The texture buffer the palette is read from,
+///         which submit() binds on the active texture unit before the draw's
+///         batch; or 0, to leave whatever is bound.
+/// \param  depth The draw's depth from 0, at the near plane, to 1, at the far
+///         plane, which orders it among the draws it's batched with.
+/// \param  palette_base The matrix the palettes palette_index counts from
+///         start at, which the vertex shader reads from
+///         PALETTE_BASES_ATTRIBUTE.
+/// \param  origin_base The same for the instance origins, if any.
+void RenderQueue::add(GLuint program_id,
+                      const MeshArena::Allocation& allocation,
+                      const SkeletalMesh::Partition& partition,
+                      GLuint palette_index,
+                      GLuint palette_buffer_id,
+                      float depth,
+                      GLint palette_base,
+                      GLint origin_base)
+{
+    assert(palette_index < max_palettes_);
+    if (partition.index_count == 0)
+        return;
+
+    // the arena aligns each mesh's indices to 4 bytes, so its offset is a
+    // whole number of indices of any type.
+    size_t index_size = getIndexSize(allocation.index_type);
+    assert(allocation.index_offset % index_size == 0);
+
+    Draw draw;
+    draw.sort_key = GLStateCache::makeSortKey(program_id, GLuint(allocation.vertex_format), allocation.index_type,
+                                              palette_buffer_id, depth);
+    draw.program_id = program_id;
+    draw.vertex_format = allocation.vertex_format;
+    draw.index_type = allocation.index_type;
+    draw.palette_buffer_id = palette_buffer_id;
+    draw.palette_bases[0] = palette_base;
+    draw.palette_bases[1] = origin_base;
+    draw.command.count = GLuint(partition.index_count);
+    draw.command.instance_count = 1;
+    draw.command.first_index = GLuint(allocation.index_offset / index_size + partition.first_index);
+    draw.command.base_vertex = GLint(allocation.first_vertex);
+    draw.command.base_instance = palette_index;
+    draws_.push_back(draw);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two draws can be issued by the same multi-draw.
+bool RenderQueue::drawSameBatch(const Draw& a, const Draw& b)
+{
+    return a.program_id == b.program_id &&
+           a.vertex_format == b.vertex_format &&
+           a.index_type == b.index_type &&
+           a.palette_buffer_id == b.palette_buffer_id &&
+           a.palette_bases[0] == b.palette_bases[0] &&
+           a.palette_bases[1] == b.palette_bases[1];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if two draws would issue the same command with the
+///         same state.
+bool RenderQueue::drawEqual(const Draw& a, const Draw& b)
+{
+    return drawSameBatch(a, b) &&
+           a.command.count == b.command.count &&
+           a.command.instance_count == b.command.instance_count &&
+           a.command.first_index == b.command.first_index &&
+           a.command.base_vertex == b.command.base_vertex &&
+           a.command.base_instance == b.command.base_instance;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the queued draws are the ones the batches were
+///         recorded from, in the same order.
+bool RenderQueue::matchesRecording() const
+{
+    if (!recorded_ || draws_.size() != recorded_draws_.size())
+        return false;
+
+    for (size_t i = 0; i < draws_.size(); ++i)
+    {
+        if (!drawEqual(draws_[i], recorded_draws_[i]))
+            return false;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Fills sorted_draws_ with the queued draws in order of their keys.
+///
+/// \details The sort is a least significant digit radix sort, RADIX_BITS of
+///         the key at a time, of just the keys and the draws' indices; the
+///         draws themselves are only moved once, at the end.  One sweep
+///         counts every pass's digits, and a pass whose digit is the same
+///         for every key, as the program's top bits usually are, is
+///         skipped.  Each pass is stable, so draws with equal keys stay in
+///         the order they were added.
+void RenderQueue::sortDraws()
+{
+    size_t count = draws_.size();
+    sort_entries_.resize(count);
+    sort_scratch_.resize(count);
+
+    std::vector<size_t> histograms(RADIX_PASSES * RADIX_BUCKETS, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        GLuint64 key = draws_[i].sort_key;
+        sort_entries_[i].key = key;
+        sort_entries_[i].draw = i;
+        for (size_t pass = 0; pass < RADIX_PASSES; ++pass)
+            ++histograms[pass * RADIX_BUCKETS + size_t(key >> (pass * RADIX_BITS)) % RADIX_BUCKETS];
+    }
+
+    for (size_t pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        size_t* histogram = &histograms[pass * RADIX_BUCKETS];
+        size_t shift = pass * RADIX_BITS;
+        if (histogram[size_t(sort_entries_[0].key >> shift) % RADIX_BUCKETS] == count)
+            continue;
+
+        // turn the counts into the position of each digit's first entry.
+        size_t offset = 0;
+        for (size_t digit = 0; digit < RADIX_BUCKETS; ++digit)
+        {
+            size_t digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const SortEntry& entry = sort_entries_[i];
+            sort_scratch_[histogram[size_t(entry.key >> shift) % RADIX_BUCKETS]++] = entry;
+        }
+        sort_entries_.swap(sort_scratch_);
+    }
+
+    sorted_draws_.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        sorted_draws_[i] = draws_[sort_entries_[i].draw];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sorts the queued draws into batches and uploads their commands.
+void RenderQueue::record(GLStateCache& state)
+{
+    recorded_draws_ = draws_;
+    sortDraws();
+
+    commands_.resize(sorted_draws_.size());
+    for (size_t i = 0; i < sorted_draws_.size(); ++i)
+        commands_[i] = sorted_draws_[i].command;
+
+    // the new commands go into fresh storage, so the driver doesn't have to
+    // wait for the last frame's draws to finish reading the old ones.
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_id_);
+    command_buffer_size_ = std::max(command_buffer_size_, commands_.size());
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, command_buffer_size_ * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawElementsIndirectCommand), commands_.data());
+
+    batches_.clear();
+    for (size_t first = 0; first < sorted_draws_.size(); )
+    {
+        size_t last = first + 1;
+        while (last < sorted_draws_.size() && drawSameBatch(sorted_draws_[first], sorted_draws_[last]))
+            ++last;
+
+        Batch batch;
+        batch.program_id = sorted_draws_[first].program_id;
+        batch.vertex_format = sorted_draws_[first].vertex_format;
+        batch.index_type = sorted_draws_[first].index_type;
+        batch.palette_buffer_id = sorted_draws_[first].palette_buffer_id;
+        batch.palette_bases[0] = sorted_draws_[first].palette_bases[0];
+        batch.palette_bases[1] = sorted_draws_[first].palette_bases[1];
+        batch.first_command = first;
+        batch.command_count = last - first;
+        batches_.push_back(batch);
+        first = last;
+    }
+
+    recorded_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Issues all of the queued draws.
+///
+/// \details Unless the draws match the last recording, they're sorted into
+///         batches and all of the indirect commands are uploaded in one go.
+///         Then each batch binds its program, VAO and palette buffer, sets
+///         its palette bases, and issues a single glMultiDrawElementsIndirect.
+///         The queue isn't cleared, so the same draws can be submitted
+///         again, and will be replayed.  The last batch's palette buffer and
+///         bases are left in place.
+///
+/// \param  arena The arena holding every queued mesh.  The recording holds
+///         offsets into it, so if its meshes have moved, the draws added
+///         for them have too, and are recorded again.
+/// \param  state Binds the programs, VAOs and command buffer, skipping
+///         those which are bound already.  The command buffer is left bound.
+void RenderQueue::submit(const MeshArena& arena, GLStateCache& state)
+{
+    batch_count_ = 0;
+    replayed_ = false;
+    if (draws_.empty())
+        return;
+
+    if (matchesRecording())
+    {
+        replayed_ = true;
+        state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_id_);
+    }
+    else
+        record(state);
+
+    // the state cache doesn't track textures or attributes, so the palette
+    // buffers and bases are only set when they change between batches.
+    GLuint palette_buffer_id = 0;
+    bool bases_set = false;
+    for (size_t i = 0; i < batches_.size(); ++i)
+    {
+        const Batch& batch = batches_[i];
+        state.useProgram(batch.program_id);
+        state.bindVertexArray(arena.getVertexArray(batch.vertex_format));
+        if (batch.palette_buffer_id != 0 && batch.palette_buffer_id != palette_buffer_id)
+        {
+            glBindTexture(GL_TEXTURE_BUFFER, batch.palette_buffer_id);
+            palette_buffer_id = batch.palette_buffer_id;
+        }
+        if (!bases_set || batch.palette_bases[0] != batches_[i - 1].palette_bases[0] ||
+                          batch.palette_bases[1] != batches_[i - 1].palette_bases[1])
+        {
+            glVertexAttribI2i(PALETTE_BASES_ATTRIBUTE, batch.palette_bases[0], batch.palette_bases[1]);
+            bases_set = true;
+        }
+        glMultiDrawElementsIndirect(GL_TRIANGLES, batch.index_type,
+                                    reinterpret_cast<void*>(batch.first_command * sizeof(DrawElementsIndirectCommand)),
+                                    GLsizei(batch.command_count), 0);
+        ++batch_count_;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of draws in the queue.
+size_t RenderQueue::getDrawCount() const
+{
+    return draws_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of multi-draw calls the last submit() issued.
+size_t RenderQueue::getBatchCount() const
+{
+    return batch_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the last submit() replayed the recording from an
+///         earlier one, rather than sorting and uploading its draws.
+bool RenderQueue::wasReplayed() const
+{
+    return replayed_;
+}
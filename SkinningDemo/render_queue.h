@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  render_queue.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the RenderQueue class.
+
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+
+#include "mesh_arena.h"
+#include "gl_state_cache.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Collects draws of meshes stored in a MeshArena, then issues them
+///         with as few glMultiDrawElementsIndirect calls (GL 4.3) as
+///         possible.
+///
+/// \details Draws are grouped into batches which share a program, vertex
+///         format, index type, palette buffer and palette bases; each batch
+///         is a single multi-draw, with one indirect command per draw.  Each
+///         draw has a GLStateCache::makeSortKey() key, and the draws are
+///         radix sorted by it, so the batches are issued in an order that
+///         only rebinds the state which differs between them, through a
+///         GLStateCache, and the draws within a batch go front to back.  A
+///         radix sort takes the same few passes over the keys whatever their
+///         order, so tens of thousands of draws sort in well under a
+///         millisecond.
+///
+///         A draw can't set uniforms, so each one instead carries the index
+///         of its skinning palette as its base instance.  Base instances
+///         offset instanced attributes, so the palette index reaches the
+///         vertex shader through PALETTE_INDEX_ATTRIBUTE, which reads
+///         0, 1, 2, ... from a buffer with a divisor of 1.  Any VAO used
+///         with the queue's draws must have that attribute set up with
+///         attachPaletteIndices(); drawn with ordinary instanced calls, the
+///         same attribute just reads the instance index.  Each draw also
+///         carries where its level of detail's palettes and origins start,
+///         which submit() sets as the constant PALETTE_BASES_ATTRIBUTE
+///         between batches, in place of uniforms the programs would share.
+///
+///         Submitting records the sorted batches and uploads their commands
+///         once.  If the next submit() has exactly the same draws, as it
+///         does for a crowd whose visible instances and levels of detail
+///         haven't changed, the recording is replayed: nothing is sorted or
+///         uploaded, and only the binds and multi-draws are issued.
+class RenderQueue
+{
+public:
+    static const GLuint PALETTE_INDEX_ATTRIBUTE = 3;    ///< The attribute location of the uint palette index.
+    static const GLuint PALETTE_BASES_ATTRIBUTE = 8;    ///< The attribute location of the ivec2 palette and origin bases.
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The layout glMultiDrawElementsIndirect reads its commands in.
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+
+    explicit RenderQueue(size_t max_palettes);
+    ~RenderQueue();
+
+    void attachPaletteIndices(GLuint vao_id) const;
+
+    void clear();
+    void add(GLuint program_id,
+             const MeshArena::Allocation& allocation,
+             const SkeletalMesh::Partition& partition,
+             GLuint palette_index,
+             GLuint palette_buffer_id = 0,
+             float depth = 0.0f,
+             GLint palette_base = 0,
+             GLint origin_base = 0);
+    void submit(const MeshArena& arena, GLStateCache& state);
+
+    size_t getDrawCount() const;
+    size_t getBatchCount() const;
+    bool wasReplayed() const;
+
+private:
+    RenderQueue(const RenderQueue&);            // non-copyable
+    RenderQueue& operator=(const RenderQueue&); // non-copyable
+
+    struct Draw
+    {
+        GLuint64 sort_key;  ///< From the program, vertex array, index type, palette buffer and depth.
+        GLuint program_id;
+        VertexFormat vertex_format;
+        GLenum index_type;
+        GLuint palette_buffer_id;
+        GLint palette_bases[2];
+        DrawElementsIndirectCommand command;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A draw's key, and where the draw is in draws_, for sorting.
+    struct SortEntry
+    {
+        GLuint64 key;
+        size_t draw;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A run of sorted draws issued with one multi-draw.
+    struct Batch
+    {
+        GLuint program_id;
+        VertexFormat vertex_format;
+        GLenum index_type;
+        GLuint palette_buffer_id;   ///< Bound to GL_TEXTURE_BUFFER on the active unit, unless it's 0.
+        GLint palette_bases[2];     ///< Set as PALETTE_BASES_ATTRIBUTE.
+        size_t first_command;
+        size_t command_count;
+    };
+
+    static bool drawSameBatch(const Draw& a, const Draw& b);
+    static bool drawEqual(const Draw& a, const Draw& b);
+
+    bool matchesRecording() const;
+    void sortDraws();
+    void record(GLStateCache& state);
+
+    size_t max_palettes_;
+    std::vector<Draw> draws_;
+    std::vector<Draw> recorded_draws_;  ///< The draws the batches were recorded from, in the order they were added.
+    std::vector<Draw> sorted_draws_;
+    std::vector<SortEntry> sort_entries_;
+    std::vector<SortEntry> sort_scratch_;
+    std::vector<DrawElementsIndirectCommand> commands_;
+    std::vector<Batch> batches_;
+    bool recorded_;
+    bool replayed_;
+    size_t batch_count_;
+
+    GLuint palette_index_buffer_id_;
+    GLuint command_buffer_id_;
+    size_t command_buffer_size_;    ///< The number of commands command_buffer_id_ has room for.
+};
+
+#endif
@@ -0,0 +1,306 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  render_target.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of RenderTarget and ResolutionController class
+///         functions.
+
+#include "render_target.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts out drawing straight into the window, with one sample at
+///         full resolution.  No buffers are created until they're needed.
+RenderTarget::RenderTarget()
+    : window_width_(1),
+      window_height_(1),
+      samples_(1),
+      max_samples_(1),
+      scale_(1),
+      allocated_(false),
+      framebuffer_id_(0),
+      color_id_(0),
+      resolve_framebuffer_id_(0),
+      resolve_color_id_(0)
+{
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples_);
+    max_samples_ = std::max(max_samples_, GLsizei(1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the buffers.
+RenderTarget::~RenderTarget()
+{
+    release();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the size of the window the target is resolved into.  The
+///         buffers are reallocated the next time they're bound.
+void RenderTarget::setWindowSize(GLsizei width, GLsizei height)
+{
+    width = std::max(width, GLsizei(1));
+    height = std::max(height, GLsizei(1));
+    if (width != window_width_ || height != window_height_)
+        allocated_ = false;
+
+    window_width_ = width;
+    window_height_ = height;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the number of samples per pixel, clamped to what the driver
+///         allows.  1 turns multisampling off.
+void RenderTarget::setSamples(GLsizei samples)
+{
+    samples = std::min(std::max(samples, GLsizei(1)), max_samples_);
+    if (samples != samples_)
+        allocated_ = false;
+
+    samples_ = samples;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the fraction of the window's width and height the scene is
+///         drawn at, from just above 0 to 1.
+void RenderTarget::setScale(float scale)
+{
+    scale_ = std::min(std::max(scale, 0.01f), 1.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of samples per pixel.
+GLsizei RenderTarget::getSamples() const
+{
+    return samples_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the most samples per pixel setSamples() allows.
+GLsizei RenderTarget::getMaxSamples() const
+{
+    return max_samples_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the fraction of the window's resolution the scene is
+///         drawn at.
+float RenderTarget::getScale() const
+{
+    return scale_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the width the scene is drawn at, in pixels.
+GLsizei RenderTarget::getWidth() const
+{
+    return std::max(GLsizei(window_width_ * scale_ + 0.5f), GLsizei(1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the height the scene is drawn at, in pixels.
+GLsizei RenderTarget::getHeight() const
+{
+    return std::max(GLsizei(window_height_ * scale_ + 0.5f), GLsizei(1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the scene is drawn straight into the window.
+bool RenderTarget::isDirect() const
+{
+    return samples_ == 1 && getWidth() == window_width_ && getHeight() == window_height_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Binds the framebuffer the scene should be drawn into, and sets
+///         the viewport to the scaled size, allocating the buffers first if
+///         the window or the sample count has changed.
+void RenderTarget::bind()
+{
+    if (isDirect())
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, window_width_, window_height_);
+        return;
+    }
+
+    if (!allocated_)
+        allocate();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glViewport(0, 0, getWidth(), getHeight());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Resolves and stretches what has been drawn into the window, then
+///         binds the window's framebuffer, with a viewport covering all of
+///         it, for anything drawn at full resolution, like overlays.
+void RenderTarget::resolve()
+{
+    if (!isDirect())
+    {
+        GLsizei width = getWidth();
+        GLsizei height = getHeight();
+        GLuint source_id = framebuffer_id_;
+        if (samples_ > 1)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_id_);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_framebuffer_id_);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            source_id = resolve_framebuffer_id_;
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source_id);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, window_width_, window_height_, GL_COLOR_BUFFER_BIT,
+                          width == window_width_ && height == window_height_ ? GL_NEAREST : GL_LINEAR);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, window_width_, window_height_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the buffers at the window's size, replacing any from
+///         before.
+///
+/// \details If the framebuffer is incomplete, the problem is reported to
+///         stderr and an exception is thrown.
+void RenderTarget::allocate()
+{
+    release();
+
+    glGenRenderbuffers(1, &color_id_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_id_);
+    if (samples_ > 1)
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_RGBA8, window_width_, window_height_);
+    else
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_width_, window_height_);
+
+    glGenFramebuffers(1, &framebuffer_id_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_id_);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    if (status == GL_FRAMEBUFFER_COMPLETE && samples_ > 1)
+    {
+        glGenRenderbuffers(1, &resolve_color_id_);
+        glBindRenderbuffer(GL_RENDERBUFFER, resolve_color_id_);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_width_, window_height_);
+
+        glGenFramebuffers(1, &resolve_framebuffer_id_);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolve_framebuffer_id_);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolve_color_id_);
+        status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        release();
+        std::cerr << "The scene framebuffer is incomplete!" << std::endl
+                  << "     Size: " << window_width_ << "x" << window_height_ << std::endl
+                  << "  Samples: " << samples_ << std::endl;
+        throw std::runtime_error("The scene framebuffer is incomplete!");
+    }
+
+    allocated_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the buffers, if there are any.
+void RenderTarget::release()
+{
+    glDeleteFramebuffers(1, &framebuffer_id_);
+    glDeleteRenderbuffers(1, &color_id_);
+    glDeleteFramebuffers(1, &resolve_framebuffer_id_);
+    glDeleteRenderbuffers(1, &resolve_color_id_);
+    framebuffer_id_ = color_id_ = resolve_framebuffer_id_ = resolve_color_id_ = 0;
+    allocated_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts at the largest scale, with nothing measured.
+///
+/// \param  target_milliseconds The GPU time per frame to aim for.
+/// \param  min_scale The smallest scale to ever choose.
+/// \param  max_scale The largest scale to ever choose.
+/// \param  interval The number of frames averaged before each adjustment.
+ResolutionController::ResolutionController(double target_milliseconds, float min_scale, float max_scale,
+                                           size_t interval)
+    : target_(target_milliseconds),
+      min_scale_(min_scale),
+      max_scale_(max_scale),
+      scale_(max_scale),
+      interval_(std::max(interval, size_t(1))),
+      frame_count_(0),
+      total_milliseconds_(0),
+      settle_count_(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a frame's GPU time to the average, and adjusts the scale
+///         at the end of each interval.
+///
+/// \param  gpu_milliseconds The GPU time of the latest frame measured.
+/// \return The scale to draw the next frame at.
+float ResolutionController::update(double gpu_milliseconds)
+{
+    if (settle_count_ > 0)
+    {
+        --settle_count_;
+        return scale_;
+    }
+
+    total_milliseconds_ += gpu_milliseconds;
+    if (++frame_count_ < interval_)
+        return scale_;
+
+    double mean = total_milliseconds_ / frame_count_;
+    frame_count_ = 0;
+    total_milliseconds_ = 0;
+    if (mean <= 0 || (mean < target_ * 1.05 && mean > target_ * 0.85))
+        return scale_;
+
+    float ideal = scale_ * float(std::sqrt(target_ / mean));
+    float scale = std::min(std::max(scale_ + (ideal - scale_) * 0.5f, min_scale_), max_scale_);
+    if (scale != scale_)
+    {
+        scale_ = scale;
+        settle_count_ = SETTLE_FRAMES;
+    }
+
+    return scale_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns to the largest scale and forgets everything measured.
+void ResolutionController::reset()
+{
+    scale_ = max_scale_;
+    frame_count_ = 0;
+    total_milliseconds_ = 0;
+    settle_count_ = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the GPU time per frame being aimed for.
+double ResolutionController::getTarget() const
+{
+    return target_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the scale chosen by the last update().
+float ResolutionController::getScale() const
+{
+    return scale_;
+}
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  render_target.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the RenderTarget and ResolutionController
+///         classes.
+
+#ifndef RENDER_TARGET_H_
+#define RENDER_TARGET_H_
+
+#include "demo.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An offscreen framebuffer the scene is drawn into, with a chosen
+///         number of samples and at a fraction of the window's resolution,
+///         then resolved and stretched into the window.
+///
+/// \details The color buffer is always the size of the window, and only
+///         reallocated when the window or the sample count changes.  A
+///         scale below 1 just draws into the bottom left corner of it, so
+///         the scale can change every frame without allocating anything.
+///
+///         A multisample buffer can't be resolved and scaled in one blit,
+///         so with both, resolve() blits the samples into a single-sample
+///         buffer at the scaled size first, then stretches that into the
+///         window.  At a scale of 1 with one sample, there's nothing to do,
+///         so the scene is drawn straight into the window.
+class RenderTarget
+{
+public:
+    RenderTarget();
+    ~RenderTarget();
+
+    void setWindowSize(GLsizei width, GLsizei height);
+    void setSamples(GLsizei samples);
+    void setScale(float scale);
+
+    GLsizei getSamples() const;
+    GLsizei getMaxSamples() const;
+    float getScale() const;
+    GLsizei getWidth() const;
+    GLsizei getHeight() const;
+    bool isDirect() const;
+
+    void bind();
+    void resolve();
+
+private:
+    RenderTarget(const RenderTarget&);              // non-copyable
+    RenderTarget& operator=(const RenderTarget&);   // non-copyable
+
+    void allocate();
+    void release();
+
+    GLsizei window_width_;
+    GLsizei window_height_;
+    GLsizei samples_;
+    GLsizei max_samples_;           ///< GL_MAX_SAMPLES.
+    float scale_;
+    bool allocated_;                ///< Whether the buffers match the window size and sample count.
+
+    GLuint framebuffer_id_;
+    GLuint color_id_;               ///< samples_ samples per pixel.
+    GLuint resolve_framebuffer_id_; ///< Only with more than one sample.
+    GLuint resolve_color_id_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Chooses a RenderTarget scale which holds the GPU's frame time
+///         near a target.
+///
+/// \details The GPU times of the frames are averaged over an interval, and
+///         at the end of each, the scale is moved halfway towards the one
+///         which would hit the target if the time were proportional to the
+///         number of pixels (so to the square of the scale).  Some of the
+///         time, such as skinning the vertices, doesn't depend on the
+///         scale at all, so the estimate is always optimistic; moving only
+///         halfway lets the later intervals correct it without overshoot.
+///
+///         The scale is only lowered once the time is 5% over the target,
+///         and only raised once it's 15% under, so it settles rather than
+///         hunting back and forth.  GPU timings lag a few frames behind, so
+///         the frames just after a change are left out of the next average.
+class ResolutionController
+{
+public:
+    explicit ResolutionController(double target_milliseconds, float min_scale = 0.5f, float max_scale = 1.0f,
+                                  size_t interval = 30);
+
+    float update(double gpu_milliseconds);
+    void reset();
+
+    double getTarget() const;
+    float getScale() const;
+
+private:
+    static const size_t SETTLE_FRAMES = 3;  ///< Frames left out after a change.
+
+    double target_;
+    float min_scale_;
+    float max_scale_;
+    float scale_;
+    size_t interval_;
+    size_t frame_count_;            ///< Frames averaged so far this interval.
+    double total_milliseconds_;     ///< Their total GPU time.
+    size_t settle_count_;           ///< Frames still to be left out.
+};
+
+#endif
@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  residency_manager.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of ResidencyManager class functions.
+
+#include "residency_manager.h"
+
+#include <cassert>
+#include <iostream>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a manager with nothing to manage yet.
+///
+/// \param  budget The most GPU memory the resources should use, in bytes.
+ResidencyManager::ResidencyManager(GLsizeiptr budget)
+    : budget_(budget),
+      frame_(0),
+      eviction_count_(0),
+      restore_count_(0),
+      over_budget_(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts counting a resource which can't be evicted.
+///
+/// \param  name What the resource is called when the budget is reported.
+/// \param  bytes The size of the resource's storage.
+ResidencyManager::ResourceId ResidencyManager::addFixed(const std::string& name, GLsizeiptr bytes)
+{
+    Resource resource;
+    resource.name = name;
+    resource.mesh = nullptr;
+    resource.restore = nullptr;
+    resource.data = nullptr;
+    resource.index = 0;
+    resource.bytes = bytes;
+    resource.last_used = 0;
+    resources_.push_back(resource);
+    return resources_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts managing a mesh, which may be evicted as soon as the next
+///         endFrame() unless it's used first.
+///
+/// \param  name What the mesh is called when the budget is reported.
+/// \param  mesh The mesh, which must outlive the manager.
+/// \param  restore Called by use() to upload the mesh again after it has
+///         been evicted, with data and index.
+/// \param  data Passed to restore.
+/// \param  index Passed to restore.
+ResidencyManager::ResourceId ResidencyManager::addMesh(const std::string& name, SkeletalMeshBase& mesh,
+                                                       RestoreFunction restore, void* data, size_t index)
+{
+    Resource resource;
+    resource.name = name;
+    resource.mesh = &mesh;
+    resource.restore = restore;
+    resource.data = data;
+    resource.index = index;
+    resource.bytes = 0;
+    resource.last_used = 0;
+    resources_.push_back(resource);
+    return resources_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Updates the size of a fixed resource, after it's been
+///         reallocated.
+void ResidencyManager::setFixedBytes(ResourceId resource, GLsizeiptr bytes)
+{
+    assert(resources_[resource].mesh == nullptr);
+    resources_[resource].bytes = bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks a resource as used this frame, restoring it first if it's
+///         a mesh which has been evicted.
+///
+/// \return true if the resource can be drawn.
+bool ResidencyManager::use(ResourceId resource_id)
+{
+    Resource& resource = resources_[resource_id];
+    resource.last_used = frame_ + 1;
+    if (resource.mesh == nullptr || resource.mesh->isResident())
+        return true;
+
+    resource.restore(resource.data, resource.index);
+    ++restore_count_;
+    return resource.mesh->isResident();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Evicts the least recently used meshes until the resources fit in
+///         the budget, then starts the next frame.
+void ResidencyManager::endFrame()
+{
+    GLsizeiptr resident = getResidentBytes();
+    while (resident > budget_)
+    {
+        size_t candidate = findEvictionCandidate();
+        if (candidate == NO_RESOURCE)
+            break;
+
+        Resource& resource = resources_[candidate];
+        resident -= resource.mesh->getBufferBytes();
+        resource.mesh->releaseBuffers();
+        ++eviction_count_;
+    }
+
+    // an overrun is only reported when it starts, not every frame it lasts.
+    if (resident > budget_ && !over_budget_)
+    {
+        std::cerr << "GPU memory over budget: " << resident / 1024 << " KB resident, "
+                  << budget_ / 1024 << " KB allowed." << std::endl;
+        for (size_t i = 0; i < resources_.size(); ++i)
+            std::cerr << "  " << resources_[i].name << ": " << getBytes(resources_[i]) / 1024 << " KB" << std::endl;
+    }
+    over_budget_ = resident > budget_;
+
+    ++frame_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Changes the budget.  Nothing is evicted until the next
+///         endFrame().
+void ResidencyManager::setBudget(GLsizeiptr budget)
+{
+    budget_ = budget;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the budget, in bytes.
+GLsizeiptr ResidencyManager::getBudget() const
+{
+    return budget_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the total size of the fixed resources and the resident
+///         meshes, in bytes.
+GLsizeiptr ResidencyManager::getResidentBytes() const
+{
+    GLsizeiptr bytes = 0;
+    for (size_t i = 0; i < resources_.size(); ++i)
+        bytes += getBytes(resources_[i]);
+    return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of times a mesh has been evicted.
+size_t ResidencyManager::getEvictionCount() const
+{
+    return eviction_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of times an evicted mesh has been restored.
+size_t ResidencyManager::getRestoreCount() const
+{
+    return restore_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the GPU memory a resource is using right now.
+GLsizeiptr ResidencyManager::getBytes(const Resource& resource) const
+{
+    return resource.mesh != nullptr ? resource.mesh->getBufferBytes() : resource.bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the resident mesh which was used least recently, not
+///         counting those used this frame, or NO_RESOURCE if there are none.
+size_t ResidencyManager::findEvictionCandidate() const
+{
+    size_t candidate = NO_RESOURCE;
+    for (size_t i = 0; i < resources_.size(); ++i)
+    {
+        const Resource& resource = resources_[i];
+        if (resource.mesh == nullptr || !resource.mesh->isResident() || resource.last_used == frame_ + 1)
+            continue;
+
+        if (candidate == NO_RESOURCE || resource.last_used < resources_[candidate].last_used)
+            candidate = i;
+    }
+    return candidate;
+}
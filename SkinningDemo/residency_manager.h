@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  residency_manager.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the ResidencyManager class.
+
+#ifndef RESIDENCY_MANAGER_H_
+#define RESIDENCY_MANAGER_H_
+
+#include "skeletal_mesh.h"
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Keeps the GPU memory used by meshes, palettes and animation
+///         textures under a budget, by evicting the meshes which were drawn
+///         least recently.
+///
+/// \details Two kinds of resource are tracked.  Fixed resources, such as
+///         palette buffers and baked animation textures, are only counted;
+///         their sizes are whatever they were last set to.  Meshes are
+///         counted by the actual size of their buffers (see
+///         SkeletalMeshBase::getBufferBytes()), and can be evicted with
+///         SkeletalMeshBase::releaseBuffers().
+///
+///         Before a mesh is drawn, use() marks it as drawn this frame, and
+///         calls its restore function if it has been evicted; that function
+///         must upload the mesh again and reattach anything other objects
+///         had attached to its VAO.  At the end of each frame, endFrame()
+///         evicts meshes, least recently drawn first, until the total is
+///         back under the budget.  A mesh drawn this frame is never
+///         evicted, so a frame which needs more than the budget keeps what
+///         it needs, and the overrun is reported.
+///
+///         Everything must be called from the thread which owns the GL
+///         context.
+class ResidencyManager
+{
+public:
+    typedef size_t ResourceId;
+    typedef void (*RestoreFunction)(void* data, size_t index);
+
+    explicit ResidencyManager(GLsizeiptr budget);
+
+    ResourceId addFixed(const std::string& name, GLsizeiptr bytes);
+    ResourceId addMesh(const std::string& name, SkeletalMeshBase& mesh,
+                       RestoreFunction restore, void* data, size_t index);
+    void setFixedBytes(ResourceId resource, GLsizeiptr bytes);
+
+    bool use(ResourceId resource);
+    void endFrame();
+
+    void setBudget(GLsizeiptr budget);
+    GLsizeiptr getBudget() const;
+    GLsizeiptr getResidentBytes() const;
+    size_t getEvictionCount() const;
+    size_t getRestoreCount() const;
+
+private:
+    static const size_t NO_RESOURCE = size_t(-1);
+
+    ResidencyManager(const ResidencyManager&);              // non-copyable
+    ResidencyManager& operator=(const ResidencyManager&);   // non-copyable
+
+    struct Resource
+    {
+        std::string name;
+        SkeletalMeshBase* mesh;     ///< null for fixed resources.
+        RestoreFunction restore;
+        void* data;
+        size_t index;
+        GLsizeiptr bytes;           ///< The size of a fixed resource.
+        size_t last_used;           ///< One more than the frame the mesh was last drawn in; 0 if it never has been.
+    };
+
+    GLsizeiptr getBytes(const Resource& resource) const;
+    size_t findEvictionCandidate() const;
+
+    std::vector<Resource> resources_;
+    GLsizeiptr budget_;
+    size_t frame_;
+    size_t eviction_count_;
+    size_t restore_count_;
+    bool over_budget_;          ///< The overrun has been reported, and not ended since.
+};
+
+#endif
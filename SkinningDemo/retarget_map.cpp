@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  retarget_map.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of RetargetMap class functions.
+
+#include "retarget_map.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+/// Bind offsets shorter than this are taken to be a joint sitting on its
+/// parent, which has no length to stretch.
+const float MIN_BIND_LENGTH = 1e-6f;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Scales and offsets a stream of floats in place.
+void multiplyAddStream(float* values, const float* scales, const float* offsets, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(values + i), _mm_loadu_ps(scales + i));
+        _mm_storeu_ps(values + i, _mm_add_ps(v, _mm_loadu_ps(offsets + i)));
+    }
+#endif
+
+    for (; i < count; ++i)
+        values[i] = values[i] * scales[i] + offsets[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Offsets a stream of floats in place.
+void addStream(float* values, const float* offsets, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), _mm_loadu_ps(offsets + i)));
+#endif
+
+    for (; i < count; ++i)
+        values[i] += offsets[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Scales a stream of floats in place.
+void multiplyStream(float* values, const float* scales, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(values + i, _mm_mul_ps(_mm_loadu_ps(values + i), _mm_loadu_ps(scales + i)));
+#endif
+
+    for (; i < count; ++i)
+        values[i] *= scales[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a bad joint mapping and throws an exception.
+void retargetError(const std::string& problem)
+{
+    std::cerr << "Error building retarget map!" << std::endl
+              << "  Error: " << problem << std::endl;
+
+    throw std::runtime_error("Error building retarget map!");
+}
+
+} // namespace
+
+const int RetargetMap::NO_SOURCE;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Works out how each target joint follows its source joint.
+///
+/// \param  source_bind_pose The bind pose of the skeleton the clips were
+///         made for, like the demo's poses[0].
+/// \param  target_bind_pose The bind pose of the skeleton to carry them
+///         over to.
+/// \param  source_joints The source joint of each target joint, or
+///         NO_SOURCE.  If it's empty, each target joint is mapped to the
+///         source joint with the same index, for skeletons which only
+///         differ in proportions.
+RetargetMap::RetargetMap(const Pose& source_bind_pose, const Pose& target_bind_pose,
+                         const std::vector<int>& source_joints)
+    : source_joint_count_(source_bind_pose.joint_count),
+      source_joints_(source_joints),
+      identity_(true)
+{
+    size_t n = target_bind_pose.joint_count;
+    if (source_joints_.empty())
+    {
+        if (source_joint_count_ != n)
+            retargetError("Skeletons with different numbers of joints need a joint mapping.");
+
+        for (size_t joint = 0; joint < n; ++joint)
+            source_joints_.push_back(int(joint));
+    }
+    else if (source_joints_.size() != n)
+        retargetError("The joint mapping must have one entry per target joint.");
+
+    translation_scales_.resize(n * 2);
+    translation_offsets_.resize(n * 2);
+    rotation_offsets_.resize(n);
+    scale_factors_.resize(n);
+    for (size_t joint = 0; joint < n; ++joint)
+    {
+        int source = source_joints_[joint];
+        if (source != NO_SOURCE && (source < 0 || size_t(source) >= source_joint_count_))
+            retargetError("A target joint is mapped to a source joint which doesn't exist.");
+
+        identity_ = identity_ && source == int(joint);
+
+        vec2 target_translation = target_bind_pose.translation[joint];
+        if (source == NO_SOURCE)
+        {
+            translation_scales_[joint * 2] = translation_scales_[joint * 2 + 1] = 0;
+            translation_offsets_[joint * 2] = target_translation.x;
+            translation_offsets_[joint * 2 + 1] = target_translation.y;
+            rotation_offsets_[joint] = target_bind_pose.rotation[joint];
+            scale_factors_[joint] = target_bind_pose.scale[joint];
+            continue;
+        }
+
+        vec2 source_translation = source_bind_pose.translation[source];
+        float source_length = glm::length(source_translation);
+        float stretch = source_length > MIN_BIND_LENGTH ? glm::length(target_translation) / source_length : 1.0f;
+        vec2 offset = target_translation - source_translation * stretch;
+
+        translation_scales_[joint * 2] = translation_scales_[joint * 2 + 1] = stretch;
+        translation_offsets_[joint * 2] = offset.x;
+        translation_offsets_[joint * 2 + 1] = offset.y;
+        rotation_offsets_[joint] = target_bind_pose.rotation[joint] - source_bind_pose.rotation[source];
+
+        float source_scale = source_bind_pose.scale[source];
+        scale_factors_[joint] = source_scale != 0 ? target_bind_pose.scale[joint] / source_scale : 1.0f;
+    }
+    identity_ = identity_ && source_joint_count_ == n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Carries a pose of the source skeleton over to the target.
+///
+/// \details The source joints are gathered into the target's streams (a
+///         straight copy of each stream, when the mapping is the identity),
+///         then each stream is scaled and offset in place, four floats at a
+///         time where SSE2 is available.
+///
+/// \param  source A pose of the source skeleton, typically just sampled
+///         from a clip.
+/// \param  target Receives the pose of the target skeleton.  It must not be
+///         the same pose as source.
+void RetargetMap::apply(const Pose& source, Pose& target) const
+{
+    size_t n = source_joints_.size();
+    assert(source.joint_count == source_joint_count_ && target.joint_count == n);
+    assert(source.translation != target.translation);
+    if (n == 0)
+        return;
+
+    bool colors = source.color != nullptr && target.color != nullptr;
+    if (identity_)
+    {
+        std::copy(source.translation, source.translation + n, target.translation);
+        std::copy(source.rotation, source.rotation + n, target.rotation);
+        std::copy(source.scale, source.scale + n, target.scale);
+        if (colors)
+            std::copy(source.color, source.color + n, target.color);
+    }
+    else
+    {
+        for (size_t joint = 0; joint < n; ++joint)
+        {
+            int s = source_joints_[joint];
+            bool mapped = s != NO_SOURCE;
+            target.translation[joint] = mapped ? source.translation[s] : vec2(0);
+            target.rotation[joint] = mapped ? source.rotation[s] : 0.0f;
+            target.scale[joint] = mapped ? source.scale[s] : 1.0f;
+            if (colors && mapped)
+                target.color[joint] = source.color[s];
+        }
+    }
+
+    multiplyAddStream(&target.translation[0].x, &translation_scales_[0], &translation_offsets_[0], n * 2);
+    addStream(target.rotation, &rotation_offsets_[0], n);
+    multiplyStream(target.scale, &scale_factors_[0], n);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the source skeleton.
+size_t RetargetMap::getSourceJointCount() const
+{
+    return source_joint_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the target skeleton.
+size_t RetargetMap::getTargetJointCount() const
+{
+    return source_joints_.size();
+}
@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  retarget_map.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the RetargetMap class.
+
+#ifndef RETARGET_MAP_H_
+#define RETARGET_MAP_H_
+
+#include "pose.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Carries poses of one skeleton over to another skeleton of
+///         different proportions, so both can share the same clips.
+///
+/// \details Each joint of the target skeleton is mapped to a joint of the
+///         source skeleton (or to none), and follows that joint's motion
+///         relative to the two skeletons' bind poses: it turns by as much
+///         as the source joint turns from its bind rotation, scales by as
+///         much, and moves by as much, stretched by the ratio of the two
+///         joints' bind offsets from their parents.  All of that is worked
+///         out once per pair of skeletons, from their bind poses, into a
+///         per-channel scale and offset, so carrying a pose over is one
+///         multiply and add per channel of each joint, over whole streams
+///         at a time, after gathering the source joints into place.
+///         Nothing goes through the hierarchy; the source pose is never
+///         turned into transforms and back.
+///
+///         Target joints with no source joint hold their bind pose.  Colors
+///         aren't retargeted, but are gathered along with the joints when
+///         both poses have them.
+class RetargetMap
+{
+public:
+    static const int NO_SOURCE = -1;    ///< The source joint of a target joint which holds its bind pose.
+
+    RetargetMap(const Pose& source_bind_pose, const Pose& target_bind_pose,
+                const std::vector<int>& source_joints = std::vector<int>());
+
+    void apply(const Pose& source, Pose& target) const;
+
+    size_t getSourceJointCount() const;
+    size_t getTargetJointCount() const;
+
+private:
+    size_t source_joint_count_;
+    std::vector<int> source_joints_;        ///< The source joint of each target joint, or NO_SOURCE.
+    bool identity_;                         ///< Every target joint's source is the joint with the same index.
+
+    // the target's channels are source * scale + offset, with unmapped
+    // joints gathered as the identity: no translation or rotation, and a
+    // scale of 1.
+    std::vector<float> translation_scales_; ///< Two per joint, to line up with the translation stream's floats.
+    std::vector<float> translation_offsets_;
+    std::vector<float> rotation_offsets_;   ///< Rotations are only ever offset.
+    std::vector<float> scale_factors_;      ///< Scales are only ever scaled.
+};
+
+#endif
@@ -0,0 +1,725 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  rig_file.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of rig file functions.
+
+#include "rig_file.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a problem with a rig file and throws an exception.
+void rigFileError(const std::string& path, const std::string& problem)
+{
+    std::cerr << "Error loading rig file!" << std::endl
+              << "   File: " << path << std::endl
+              << "  Error: " << problem << std::endl;
+
+    throw std::runtime_error("Error loading rig file!");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a rig description in one pass, straight into a skeleton
+///         and its poses.
+///
+/// \details The parser walks the text in place.  Strings are read as a
+///         pointer and a length into it, compared against the keys the
+///         format has without being copied, and numbers are converted from
+///         a small buffer on the stack, so nothing is allocated per token;
+///         only the pose and socket names are kept as strings.  The bind
+///         pose's channels are gathered into one array per channel while
+///         the joints are read, since the pose they go into can't be
+///         allocated until every joint has been added.
+class RigParser
+{
+public:
+    RigParser(const char* text, size_t length, const std::string& source)
+        : cursor_(text),
+          end_(text + length),
+          source_(source),
+          line_(1),
+          skeleton_(nullptr),
+          poses_(nullptr)
+    {
+    }
+
+    void parse(Skeleton& skeleton, std::vector<RigFilePose>& poses);
+
+private:
+    RigParser(const RigParser&);              // non-copyable
+    RigParser& operator=(const RigParser&);   // non-copyable
+
+    void parseJoints();
+    void parseJoint(size_t joint);
+    void parseSockets();
+    void parseSocket();
+    void parsePoses();
+    void parsePose();
+
+    void skipSpace();
+    bool consume(char c);
+    void expect(char c);
+    bool listContinues(char close, size_t index);
+    void readString(const char*& begin, size_t& length);
+    void readKey(const char*& begin, size_t& length);
+    float readNumber();
+    vec2 readVec2();
+    color4 readColor();
+    void readChannel(float* values);
+    void readChannel(vec2* values);
+    void readChannel(color4* values);
+    void error(const std::string& problem) const;
+
+    static bool isKey(const char* begin, size_t length, const char* key);
+
+    const char* cursor_;
+    const char* end_;
+    const std::string& source_;
+    size_t line_;                       ///< The line cursor_ is on, for the error messages.
+
+    Skeleton* skeleton_;
+    std::vector<RigFilePose>* poses_;
+
+    std::vector<vec2> translations_;    ///< The bind pose's channels, joint by joint, until it's allocated.
+    std::vector<float> rotations_;
+    std::vector<float> scales_;
+    std::vector<color4> colors_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses the whole description.  The skeleton must have no joints.
+void RigParser::parse(Skeleton& skeleton, std::vector<RigFilePose>& poses)
+{
+    assert(skeleton.getJointCount() == 0);
+    skeleton_ = &skeleton;
+    poses_ = &poses;
+
+    bool has_version = false;
+    expect('{');
+    for (size_t i = 0; listContinues('}', i); ++i)
+    {
+        const char* key;
+        size_t length;
+        readKey(key, length);
+
+        if (isKey(key, length, "version"))
+        {
+            if (readNumber() != float(RIG_FILE_VERSION))
+                error("The file is from a different version of the format.");
+            has_version = true;
+        }
+        else if (isKey(key, length, "joints"))
+        {
+            if (skeleton_->getJointCount() > 0)
+                error("The joints are listed twice.");
+            parseJoints();
+        }
+        else if (isKey(key, length, "sockets"))
+            parseSockets();
+        else if (isKey(key, length, "poses"))
+            parsePoses();
+        else
+            error("Unknown key \"" + std::string(key, length) + "\".");
+    }
+
+    skipSpace();
+    if (cursor_ != end_)
+        error("There's more after the rig's closing brace.");
+    if (!has_version)
+        error("The file has no version.");
+    if (skeleton_->getJointCount() == 0)
+        error("The rig has no joints.");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses the joints, adding them to the skeleton, then allocates
+///         the bind pose, sets it, and makes it the first pose.
+void RigParser::parseJoints()
+{
+    expect('[');
+    for (size_t joint = 0; listContinues(']', joint); ++joint)
+        parseJoint(joint);
+
+    size_t joint_count = skeleton_->getJointCount();
+    if (joint_count == 0)
+        error("The rig has no joints.");
+
+    RigFilePose bind;
+    bind.name = "bind";
+    bind.pose = skeleton_->allocatePose(true);
+    std::copy(translations_.begin(), translations_.end(), bind.pose.translation);
+    std::copy(rotations_.begin(), rotations_.end(), bind.pose.rotation);
+    std::copy(scales_.begin(), scales_.end(), bind.pose.scale);
+    std::copy(colors_.begin(), colors_.end(), bind.pose.color);
+    skeleton_->setBindPose(bind.pose);
+    poses_->push_back(bind);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses one joint, and adds it to the skeleton once its parent
+///         is known.
+void RigParser::parseJoint(size_t joint)
+{
+    translations_.push_back(vec2(0, 0));
+    rotations_.push_back(0.0f);
+    scales_.push_back(1.0f);
+    colors_.push_back(color4(1.0f, 1.0f, 1.0f, 1.0f));
+
+    bool has_parent = false;
+    int parent = Skeleton::NO_PARENT;
+    expect('{');
+    for (size_t i = 0; listContinues('}', i); ++i)
+    {
+        const char* key;
+        size_t length;
+        readKey(key, length);
+
+        if (isKey(key, length, "parent"))
+        {
+            float value = readNumber();
+            parent = int(value);
+            if (float(parent) != value || parent < Skeleton::NO_PARENT || parent >= int(joint))
+                error("A joint's parent must be -1, or a joint listed before it.");
+            has_parent = true;
+        }
+        else if (isKey(key, length, "translation"))
+            translations_[joint] = readVec2();
+        else if (isKey(key, length, "rotation"))
+            rotations_[joint] = readNumber();
+        else if (isKey(key, length, "scale"))
+            scales_[joint] = readNumber();
+        else if (isKey(key, length, "color"))
+            colors_[joint] = readColor();
+        else
+            error("Unknown joint key \"" + std::string(key, length) + "\".");
+    }
+
+    if (!has_parent)
+        error("A joint has no parent; the root's is -1.");
+    skeleton_->addJoint(parent);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses the sockets, adding them to the skeleton.
+void RigParser::parseSockets()
+{
+    if (skeleton_->getJointCount() == 0)
+        error("The sockets must come after the joints.");
+
+    expect('[');
+    for (size_t socket = 0; listContinues(']', socket); ++socket)
+        parseSocket();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses one socket, and adds it to the skeleton.
+void RigParser::parseSocket()
+{
+    std::string name;
+    size_t joint = skeleton_->getJointCount();
+    vec2 offset(0, 0);
+    float rotation = 0.0f;
+
+    expect('{');
+    for (size_t i = 0; listContinues('}', i); ++i)
+    {
+        const char* key;
+        size_t length;
+        readKey(key, length);
+
+        if (isKey(key, length, "name"))
+        {
+            const char* begin;
+            size_t name_length;
+            readString(begin, name_length);
+            name.assign(begin, name_length);
+        }
+        else if (isKey(key, length, "joint"))
+        {
+            float value = readNumber();
+            joint = size_t(value);
+            if (value < 0 || float(joint) != value || joint >= skeleton_->getJointCount())
+                error("A socket's joint isn't one of the rig's joints.");
+        }
+        else if (isKey(key, length, "offset"))
+            offset = readVec2();
+        else if (isKey(key, length, "rotation"))
+            rotation = readNumber();
+        else
+            error("Unknown socket key \"" + std::string(key, length) + "\".");
+    }
+
+    if (name.empty() || joint >= skeleton_->getJointCount())
+        error("A socket needs a name and a joint.");
+    if (skeleton_->findSocket(name) != Skeleton::NO_SOCKET)
+        error("There's more than one socket called \"" + name + "\".");
+
+    mat4 transform = glm::translate(mat4(1), vec3(offset, 0));
+    skeleton_->addSocket(name, joint, glm::rotate(transform, rotation, vec3(0, 0, 1)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses the named poses, adding them after the bind pose.
+void RigParser::parsePoses()
+{
+    if (skeleton_->getJointCount() == 0)
+        error("The poses must come after the joints.");
+
+    expect('[');
+    for (size_t pose = 0; listContinues(']', pose); ++pose)
+        parsePose();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses one named pose, starting from a copy of the bind pose.
+void RigParser::parsePose()
+{
+    RigFilePose named;
+    named.pose = skeleton_->allocatePose(true);
+    copyPose((*poses_)[0].pose, named.pose);
+
+    // added first, so the pose is released with the rest if this throws.
+    poses_->push_back(named);
+    RigFilePose& added = poses_->back();
+
+    expect('{');
+    for (size_t i = 0; listContinues('}', i); ++i)
+    {
+        const char* key;
+        size_t length;
+        readKey(key, length);
+
+        if (isKey(key, length, "name"))
+        {
+            const char* begin;
+            size_t name_length;
+            readString(begin, name_length);
+            added.name.assign(begin, name_length);
+        }
+        else if (isKey(key, length, "translation"))
+            readChannel(added.pose.translation);
+        else if (isKey(key, length, "rotation"))
+            readChannel(added.pose.rotation);
+        else if (isKey(key, length, "scale"))
+            readChannel(added.pose.scale);
+        else if (isKey(key, length, "color"))
+            readChannel(added.pose.color);
+        else
+            error("Unknown pose key \"" + std::string(key, length) + "\".");
+    }
+
+    if (added.name.empty())
+        error("A pose has no name.");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skips whitespace, counting lines.
+void RigParser::skipSpace()
+{
+    for (; cursor_ != end_; ++cursor_)
+    {
+        if (*cursor_ == '\n')
+            ++line_;
+        else if (*cursor_ != ' ' && *cursor_ != '\t' && *cursor_ != '\r')
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skips a character, and the whitespace before it, if it's next.
+bool RigParser::consume(char c)
+{
+    skipSpace();
+    if (cursor_ == end_ || *cursor_ != c)
+        return false;
+
+    ++cursor_;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skips a character which must be next.
+void RigParser::expect(char c)
+{
+    if (!consume(c))
+        error(std::string("Expected '") + c + "'.");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Steps through a list or an object: returns whether there's
+///         another element, skipping the comma before it, or else skips
+///         the closing bracket.
+///
+/// \param  close The list's closing bracket, ']' or '}'.
+/// \param  index The number of elements read so far.
+bool RigParser::listContinues(char close, size_t index)
+{
+    if (index == 0)
+        return !consume(close);
+
+    if (consume(','))
+        return true;
+
+    expect(close);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a string, which is left where it is in the text.  The names
+///         in a rig are plain, so escapes aren't supported.
+void RigParser::readString(const char*& begin, size_t& length)
+{
+    expect('"');
+    begin = cursor_;
+    while (cursor_ != end_ && *cursor_ != '"')
+    {
+        if (*cursor_ == '\\' || *cursor_ == '\n')
+            error("Strings can't have escapes or line breaks.");
+        ++cursor_;
+    }
+
+    if (cursor_ == end_)
+        error("A string isn't closed.");
+    length = size_t(cursor_ - begin);
+    ++cursor_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads an object's key and the colon after it.
+void RigParser::readKey(const char*& begin, size_t& length)
+{
+    readString(begin, length);
+    expect(':');
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a number.
+float RigParser::readNumber()
+{
+    skipSpace();
+    const char* begin = cursor_;
+    while (cursor_ != end_ && *cursor_ != '\0' && std::strchr("+-.0123456789eE", *cursor_) != nullptr)
+        ++cursor_;
+
+    // strtod needs a terminated string, and the mapped file isn't one.
+    char buffer[64];
+    size_t length = size_t(cursor_ - begin);
+    if (length == 0 || length >= sizeof(buffer))
+        error("Expected a number.");
+    std::memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+
+    char* number_end;
+    double value = std::strtod(buffer, &number_end);
+    if (number_end != buffer + length)
+        error("\"" + std::string(buffer) + "\" isn't a number.");
+    return float(value);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a vector, as [x, y].
+vec2 RigParser::readVec2()
+{
+    vec2 value;
+    expect('[');
+    value.x = readNumber();
+    expect(',');
+    value.y = readNumber();
+    expect(']');
+    return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a color, as [r, g, b, a].
+color4 RigParser::readColor()
+{
+    color4 value;
+    expect('[');
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i > 0)
+            expect(',');
+        value[i] = readNumber();
+    }
+    expect(']');
+    return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a list of a pose channel's values, one per joint.
+void RigParser::readChannel(float* values)
+{
+    size_t joint_count = skeleton_->getJointCount();
+    size_t joint = 0;
+    expect('[');
+    for (; listContinues(']', joint); ++joint)
+    {
+        if (joint >= joint_count)
+            error("A pose has more values in a channel than the rig has joints.");
+        values[joint] = readNumber();
+    }
+
+    if (joint != joint_count)
+        error("A pose has fewer values in a channel than the rig has joints.");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a list of a pose channel's values, one per joint.
+void RigParser::readChannel(vec2* values)
+{
+    size_t joint_count = skeleton_->getJointCount();
+    size_t joint = 0;
+    expect('[');
+    for (; listContinues(']', joint); ++joint)
+    {
+        if (joint >= joint_count)
+            error("A pose has more values in a channel than the rig has joints.");
+        values[joint] = readVec2();
+    }
+
+    if (joint != joint_count)
+        error("A pose has fewer values in a channel than the rig has joints.");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a list of a pose channel's values, one per joint.
+void RigParser::readChannel(color4* values)
+{
+    size_t joint_count = skeleton_->getJointCount();
+    size_t joint = 0;
+    expect('[');
+    for (; listContinues(']', joint); ++joint)
+    {
+        if (joint >= joint_count)
+            error("A pose has more values in a channel than the rig has joints.");
+        values[joint] = readColor();
+    }
+
+    if (joint != joint_count)
+        error("A pose has fewer values in a channel than the rig has joints.");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a problem, and the line it's on, and throws.
+void RigParser::error(const std::string& problem) const
+{
+    std::ostringstream message;
+    message << "Line " << line_ << ": " << problem;
+    rigFileError(source_, message.str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns whether a string read from the text is a key.
+bool RigParser::isKey(const char* begin, size_t length, const char* key)
+{
+    return std::strlen(key) == length && std::memcmp(begin, key, length) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a pose channel as a list on one line.
+void writeChannel(std::ostream& file, const float* values, size_t count)
+{
+    file << "[";
+    for (size_t i = 0; i < count; ++i)
+        file << (i > 0 ? ", " : "") << values[i];
+    file << "]";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a vector, as [x, y].
+void writeVec2(std::ostream& file, const vec2& value)
+{
+    file << "[" << value.x << ", " << value.y << "]";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a color, as [r, g, b, a].
+void writeColor(std::ostream& file, const color4& value)
+{
+    file << "[" << value.r << ", " << value.g << ", " << value.b << ", " << value.a << "]";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a name which a rig file can't hold and throws, unless
+///         it can be written and read back as it is.
+///
+/// \details Names are written without escapes, since readString() doesn't
+///         take any, so a quote, a backslash or a control character such as
+///         a line break would leave a file which can't be loaded.
+void checkRigName(const std::string& path, const std::string& name, const char* kind)
+{
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(name[i]);
+        if (c == '"' || c == '\\' || c < 0x20 || c == 0x7f)
+        {
+            std::cerr << "Error saving rig file!" << std::endl
+                      << "   File: " << path << std::endl
+                      << "  Error: The " << kind << " name \"" << name
+                      << "\" has a quote, a backslash or a control character, which rig files can't hold."
+                      << std::endl;
+            throw std::runtime_error("Error saving rig file!");
+        }
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Loads a rig file written by saveRigFile(), or by hand.
+///
+/// \details The file is memory-mapped and parsed in place with parseRig().
+///
+/// \param  path The file.
+/// \param  skeleton Receives the rig's joints, bind pose and sockets; it
+///         must have no joints yet.
+/// \param  poses Receives the bind pose, named "bind", then the named poses
+///         in the order they're listed.  If there's a problem, it's
+///         reported to stderr and an exception is thrown; any poses already
+///         allocated are left in poses.
+void loadRigFile(const std::string& path, Skeleton& skeleton, std::vector<RigFilePose>& poses)
+{
+    MappedFile file(path);
+    if (file.data == nullptr)
+        rigFileError(path, "The file couldn't be opened.");
+
+    parseRig(file.data, file.size, path, skeleton, poses);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Parses a rig description in memory; see loadRigFile().
+///
+/// \param  text The description, which needn't be terminated.
+/// \param  length The length of the description in bytes.
+/// \param  source Where the description came from, for the error messages.
+void parseRig(const char* text, size_t length, const std::string& source, Skeleton& skeleton,
+              std::vector<RigFilePose>& poses)
+{
+    RigParser parser(text, length, source);
+    parser.parse(skeleton, poses);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Saves a skeleton and a set of its poses to a rig file.
+///
+/// \param  skeleton The skeleton, which must have its bind pose.
+/// \param  poses The poses, with colors.  The first is written as the
+///         joints' bind pose, and the rest as named poses, every channel of
+///         them.
+/// \param  pose_count The number of poses, at least 1.
+/// \param  path The file.  If a socket or pose name has a quote, a
+///         backslash or a control character, it's reported and an exception
+///         is thrown before the file is touched.
+void saveRigFile(const Skeleton& skeleton, const RigFilePose* poses, size_t pose_count, const std::string& path)
+{
+    assert(pose_count > 0);
+
+    for (size_t socket = 0; socket < skeleton.getSocketCount(); ++socket)
+        checkRigName(path, skeleton.getSocketName(socket), "socket");
+    for (size_t pose = 1; pose < pose_count; ++pose)
+        checkRigName(path, poses[pose].name, "pose");
+
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Error saving rig file!" << std::endl
+                  << "   File: " << path << std::endl;
+        throw std::runtime_error("Error saving rig file!");
+    }
+
+    // enough digits that every float reads back the same.
+    file.precision(9);
+
+    size_t joint_count = skeleton.getJointCount();
+    const Pose& bind = poses[0].pose;
+    file << "{" << std::endl
+         << "  \"version\": " << RIG_FILE_VERSION << "," << std::endl
+         << "  \"joints\": [" << std::endl;
+    for (size_t joint = 0; joint < joint_count; ++joint)
+    {
+        file << "    { \"parent\": " << skeleton.getParent(joint) << ", \"translation\": ";
+        writeVec2(file, bind.translation[joint]);
+        file << ", \"rotation\": " << bind.rotation[joint] << ", \"scale\": " << bind.scale[joint];
+        if (bind.color != nullptr)
+        {
+            file << ", \"color\": ";
+            writeColor(file, bind.color[joint]);
+        }
+        file << " }" << (joint + 1 < joint_count ? "," : "") << std::endl;
+    }
+
+    // a socket's offset is written as a translation and a rotation, which
+    // is all a 2D rig's offsets have.
+    file << "  ]," << std::endl
+         << "  \"sockets\": [" << std::endl;
+    for (size_t socket = 0; socket < skeleton.getSocketCount(); ++socket)
+    {
+        const mat4& offset = skeleton.getSocketOffset(socket);
+        float rotation = glm::degrees(std::atan2(offset[0][1], offset[0][0]));
+        file << "    { \"name\": \"" << skeleton.getSocketName(socket) << "\", \"joint\": "
+             << skeleton.getSocketJoint(socket) << ", \"offset\": ";
+        writeVec2(file, vec2(offset[3]));
+        file << ", \"rotation\": " << rotation << " }" << (socket + 1 < skeleton.getSocketCount() ? "," : "")
+             << std::endl;
+    }
+
+    file << "  ]," << std::endl
+         << "  \"poses\": [" << std::endl;
+    for (size_t pose = 1; pose < pose_count; ++pose)
+    {
+        const Pose& named = poses[pose].pose;
+        file << "    {" << std::endl
+             << "      \"name\": \"" << poses[pose].name << "\"," << std::endl
+             << "      \"translation\": [";
+        for (size_t joint = 0; joint < joint_count; ++joint)
+        {
+            file << (joint > 0 ? ", " : "");
+            writeVec2(file, named.translation[joint]);
+        }
+        file << "]," << std::endl << "      \"rotation\": ";
+        writeChannel(file, named.rotation, joint_count);
+        file << "," << std::endl << "      \"scale\": ";
+        writeChannel(file, named.scale, joint_count);
+        if (named.color != nullptr)
+        {
+            file << "," << std::endl << "      \"color\": [";
+            for (size_t joint = 0; joint < joint_count; ++joint)
+            {
+                file << (joint > 0 ? ", " : "");
+                writeColor(file, named.color[joint]);
+            }
+            file << "]";
+        }
+        file << std::endl << "    }" << (pose + 1 < pose_count ? "," : "") << std::endl;
+    }
+
+    file << "  ]" << std::endl
+         << "}" << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the first of a rig's poses with a name, or nullptr if
+///         there isn't one.
+const RigFilePose* findRigPose(const std::vector<RigFilePose>& poses, const std::string& name)
+{
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        if (poses[i].name == name)
+            return &poses[i];
+    }
+
+    return nullptr;
+}
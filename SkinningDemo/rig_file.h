@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  rig_file.h
+/// \author Ben Crist
+///
+/// \brief  Functions for loading and saving rig descriptions, and the
+///         RigFilePose struct.
+
+#ifndef RIG_FILE_H_
+#define RIG_FILE_H_
+
+#include "skeleton.h"
+#include "pose.h"
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A named pose from a rig file.  The pose's channels are allocated
+///         from the skeleton's color pose pool, and belong to whoever loaded
+///         the file, who releases them with Skeleton::releasePose().
+struct RigFilePose
+{
+    std::string name;
+    Pose pose;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The version of the rig file format written by saveRigFile().
+///         Rig files describe a skeleton as text: its joints, their bind
+///         pose, sockets, and a set of named poses, as JSON like this:
+///
+/// \code
+///     {
+///       "version": 1,
+///       "joints": [
+///         { "parent": -1, "color": [1, 1, 1, 1] },
+///         { "parent": 0, "translation": [0, 0.2], "rotation": 90, "scale": 1 }
+///       ],
+///       "sockets": [ { "name": "hand", "joint": 1, "offset": [0.5, 0], "rotation": 0 } ],
+///       "poses": [ { "name": "raised", "rotation": [0, 135] } ]
+///     }
+/// \endcode
+///
+/// \details Joints are listed parent-before-child, as the Skeleton keeps
+///         them, and each joint's channels are its bind pose; anything left
+///         out is the identity, and the color is white.  A named pose starts
+///         from the bind pose, and replaces whichever of its channels
+///         ("translation", "rotation", "scale" and "color") it lists, with
+///         one value per joint.  Rotations are in degrees.
+///
+///         "joints" must come before "sockets" and "poses", so the file can
+///         be read in a single pass straight into the skeleton and its
+///         poses: the parser works on the file's bytes in place, without
+///         building a tree or allocating per token, and the bind pose's
+///         channels go through reusable arrays, one per channel.  Anything
+///         the format doesn't have is an error, with the line it's on,
+///         rather than being quietly skipped.
+const int RIG_FILE_VERSION = 1;
+
+void loadRigFile(const std::string& path, Skeleton& skeleton, std::vector<RigFilePose>& poses);
+void parseRig(const char* text, size_t length, const std::string& source, Skeleton& skeleton,
+              std::vector<RigFilePose>& poses);
+void saveRigFile(const Skeleton& skeleton, const RigFilePose* poses, size_t pose_count, const std::string& path);
+
+const RigFilePose* findRigPose(const std::vector<RigFilePose>& poses, const std::string& name);
+
+#endif
@@ -0,0 +1,238 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  session_log.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of SessionRecorder and SessionPlayer class
+///         functions.
+
+#include "session_log.h"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies each channel of a pose, in turn, into words.  A pose
+///         without colors is logged as if they were all 0.
+void packPose(const Pose& pose, GLuint* words)
+{
+    size_t n = pose.joint_count;
+    std::memcpy(words, pose.translation, n * sizeof(vec2));
+    words += n * 2;
+    std::memcpy(words, pose.rotation, n * sizeof(float));
+    words += n;
+    std::memcpy(words, pose.scale, n * sizeof(float));
+    words += n;
+    if (pose.color != nullptr)
+        std::memcpy(words, pose.color, n * sizeof(color4));
+    else
+        std::memset(words, 0, n * sizeof(color4));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reports a problem with a session log and throws an exception.
+void sessionLogError(const std::string& path, const std::string& problem)
+{
+    std::cerr << "Error reading session log!" << std::endl
+              << "   File: " << path << std::endl
+              << "  Error: " << problem << std::endl;
+
+    throw std::runtime_error("Error reading session log!");
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of words a pose of joint_count joints takes
+///         up in a session log.
+size_t getPoseWordCount(size_t joint_count)
+{
+    return joint_count * (sizeof(vec2) + sizeof(float) + sizeof(float) + sizeof(color4)) / sizeof(GLuint);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a session log, overwriting any file already at path, and
+///         writes its header.
+///
+/// \param  path The file to write.
+/// \param  input_words The number of words of input in each frame.
+/// \param  joint_count The number of joints in each frame's pose.
+SessionRecorder::SessionRecorder(const std::string& path, size_t input_words, size_t joint_count)
+    : path_(path),
+      file_(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc),
+      input_words_(input_words),
+      joint_count_(joint_count),
+      previous_(input_words + getPoseWordCount(joint_count), 0),
+      current_(previous_.size()),
+      mask_((previous_.size() + 7) / 8),
+      frame_count_(0),
+      byte_count_(sizeof(SessionLogHeader))
+{
+    SessionLogHeader header;
+    std::memcpy(header.magic, "SKSL", 4);
+    header.version = SESSION_LOG_VERSION;
+    header.input_words = GLuint(input_words);
+    header.joint_count = GLuint(joint_count);
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (!file_)
+    {
+        std::cerr << "Error writing session log!" << std::endl
+                  << "   File: " << path << std::endl;
+        throw std::runtime_error("Error writing session log!");
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Appends a frame to the log.
+///
+/// \param  input input_words words describing what was simulated.
+/// \param  pose The pose the simulation produced.
+void SessionRecorder::record(const GLuint* input, const Pose& pose)
+{
+    assert(pose.joint_count == joint_count_);
+
+    std::memcpy(&current_[0], input, input_words_ * sizeof(GLuint));
+    packPose(pose, &current_[input_words_]);
+
+    std::memset(&mask_[0], 0, mask_.size());
+    changed_.clear();
+    for (size_t i = 0; i < current_.size(); ++i)
+    {
+        if (current_[i] == previous_[i])
+            continue;
+
+        mask_[i / 8] |= (unsigned char)(1 << (i % 8));
+        changed_.push_back(current_[i]);
+    }
+
+    file_.write(reinterpret_cast<const char*>(&mask_[0]), std::streamsize(mask_.size()));
+    if (!changed_.empty())
+        file_.write(reinterpret_cast<const char*>(&changed_[0]), std::streamsize(changed_.size() * sizeof(GLuint)));
+    file_.flush();
+
+    if (!file_)
+    {
+        std::cerr << "Error writing session log!" << std::endl
+                  << "   File: " << path_ << std::endl;
+        throw std::runtime_error("Error writing session log!");
+    }
+
+    previous_.swap(current_);
+    ++frame_count_;
+    byte_count_ += mask_.size() + changed_.size() * sizeof(GLuint);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of frames recorded so far.
+size_t SessionRecorder::getFrameCount() const
+{
+    return frame_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the log so far, in bytes.
+size_t SessionRecorder::getByteCount() const
+{
+    return byte_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads and decodes a session log.
+///
+/// \details If the file can't be read, or wasn't recorded with the same
+///         input size and joint count, the problem is reported to stderr
+///         and an exception is thrown.  A frame cut short at the end of the
+///         file, by a session which ended abruptly, is dropped.
+///
+/// \param  path The file to read.
+/// \param  input_words The number of words of input each frame must have.
+/// \param  joint_count The number of joints each frame's pose must have.
+SessionPlayer::SessionPlayer(const std::string& path, size_t input_words, size_t joint_count)
+    : input_words_(input_words),
+      joint_count_(joint_count),
+      frame_words_(input_words + getPoseWordCount(joint_count))
+{
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file)
+        sessionLogError(path, "The file couldn't be opened.");
+
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    SessionLogHeader header;
+    if (data.size() < sizeof(header))
+        sessionLogError(path, "The file is too small to be a session log.");
+
+    std::memcpy(&header, &data[0], sizeof(header));
+    if (std::memcmp(header.magic, "SKSL", 4) != 0)
+        sessionLogError(path, "The file isn't a session log.");
+    if (header.version != SESSION_LOG_VERSION)
+        sessionLogError(path, "The file was written by a different version of the demo.");
+    if (header.input_words != input_words || header.joint_count != joint_count)
+        sessionLogError(path, "The file was recorded with a different skeleton or input layout.");
+
+    size_t mask_size = (frame_words_ + 7) / 8;
+    std::vector<GLuint> words(frame_words_, 0);
+    size_t offset = sizeof(header);
+    while (offset + mask_size <= data.size())
+    {
+        const unsigned char* mask = reinterpret_cast<const unsigned char*>(&data[offset]);
+        size_t changed_count = 0;
+        for (size_t i = 0; i < frame_words_; ++i)
+            changed_count += (mask[i / 8] >> (i % 8)) & 1;
+
+        const char* changed = &data[0] + offset + mask_size;
+        size_t frame_end = offset + mask_size + changed_count * sizeof(GLuint);
+        if (frame_end > data.size())
+            break;
+
+        for (size_t i = 0; i < frame_words_; ++i)
+        {
+            if ((mask[i / 8] >> (i % 8)) & 1)
+            {
+                std::memcpy(&words[i], changed, sizeof(GLuint));
+                changed += sizeof(GLuint);
+            }
+        }
+
+        frames_.insert(frames_.end(), words.begin(), words.end());
+        offset = frame_end;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of frames in the log.
+size_t SessionPlayer::getFrameCount() const
+{
+    return frames_.size() / frame_words_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the input_words words of a frame's input.
+const GLuint* SessionPlayer::getInput(size_t frame) const
+{
+    assert(frame < getFrameCount());
+    return &frames_[frame * frame_words_];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a pose is bit for bit the one recorded for a
+///         frame.
+///
+/// \details A replay of the same input through the same build is
+///         deterministic, so any difference means the build (or the
+///         machine's floating point) computes the animation differently.
+bool SessionPlayer::matchesPose(size_t frame, const Pose& pose) const
+{
+    assert(frame < getFrameCount() && pose.joint_count == joint_count_);
+
+    std::vector<GLuint> words(getPoseWordCount(joint_count_));
+    packPose(pose, words.data());
+    return std::memcmp(words.data(), &frames_[frame * frame_words_ + input_words_],
+                       words.size() * sizeof(GLuint)) == 0;
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  session_log.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the SessionRecorder and SessionPlayer classes.
+
+#ifndef SESSION_LOG_H_
+#define SESSION_LOG_H_
+
+#include "pose.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The header at the start of every session log.
+///
+/// \details A session log records, for every frame the simulation produced,
+///         the input it was asked to simulate (input_words 32-bit words,
+///         whose meaning is up to the application) and the pose it came up
+///         with, as words too: each channel of the Pose in turn.  Each
+///         frame is stored as a delta from the one before it:
+///
+///         - a bit mask with one bit per word, set for each word which
+///           changed (rounded up to a whole number of bytes)
+///         - the new value of each changed word, in order
+///
+///         The first frame is a delta from all zeros.  Most words don't
+///         change from one frame to the next, so an idle frame costs just
+///         its mask.  Like mesh files, logs are stored in the native byte
+///         order.
+struct SessionLogHeader
+{
+    char magic[4];              ///< Always "SKSL".
+    GLuint version;             ///< SESSION_LOG_VERSION.
+    GLuint input_words;         ///< The number of words of input in each frame.
+    GLuint joint_count;         ///< The number of joints in each frame's pose.
+};
+
+/// The version of the session log format written by SessionRecorder.
+const GLuint SESSION_LOG_VERSION = 1;
+
+size_t getPoseWordCount(size_t joint_count);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Streams each frame's input and pose into a session log, so the
+///         session can be replayed later with a SessionPlayer.
+///
+/// \details Frames are written as they're recorded, so a session that ends
+///         abruptly still leaves every frame up to the last one readable.
+class SessionRecorder
+{
+public:
+    SessionRecorder(const std::string& path, size_t input_words, size_t joint_count);
+
+    void record(const GLuint* input, const Pose& pose);
+
+    size_t getFrameCount() const;
+    size_t getByteCount() const;
+
+private:
+    SessionRecorder(const SessionRecorder&);            // non-copyable
+    SessionRecorder& operator=(const SessionRecorder&); // non-copyable
+
+    std::string path_;
+    std::ofstream file_;
+    size_t input_words_;
+    size_t joint_count_;
+    std::vector<GLuint> previous_;  ///< The last frame's words.
+    std::vector<GLuint> current_;   ///< Scratch space for the frame being recorded.
+    std::vector<unsigned char> mask_;
+    std::vector<GLuint> changed_;   ///< The changed words of the frame being recorded.
+    size_t frame_count_;
+    size_t byte_count_;             ///< The size of the log so far.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a session log written by SessionRecorder, to replay it.
+///
+/// \details The whole log is read and decoded up front, so replaying it
+///         costs no I/O or decoding while frames are being timed.  The
+///         frames are read-only afterwards, so any thread may read them.
+class SessionPlayer
+{
+public:
+    SessionPlayer(const std::string& path, size_t input_words, size_t joint_count);
+
+    size_t getFrameCount() const;
+    const GLuint* getInput(size_t frame) const;
+    bool matchesPose(size_t frame, const Pose& pose) const;
+
+private:
+    SessionPlayer(const SessionPlayer&);            // non-copyable
+    SessionPlayer& operator=(const SessionPlayer&); // non-copyable
+
+    size_t input_words_;
+    size_t joint_count_;
+    size_t frame_words_;            ///< input_words_ plus the pose's words.
+    std::vector<GLuint> frames_;    ///< Every frame's words, decoded.
+};
+
+#endif
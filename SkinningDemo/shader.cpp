@@ -0,0 +1,238 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  shader.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of shader compilation functions.
+
+#include "shader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compiles a vertex and fragment shader, and optionally a geometry
+///         shader, and links them into an executable shader program.
+///
+/// \details If compilation or linking fails, the GL info log and the
+///         offending source are written to stderr and an exception is
+///         thrown.
+///
+/// \param  vertex_shader_source The complete GLSL source for the vertex
+///         shader, including the #version directive.
+/// \param  fragment_shader_source The complete GLSL source for the fragment
+///         shader, including the #version directive.
+/// \param  feedback_varyings The names of vertex shader outputs to capture
+///         with transform feedback, interleaved in the given order.  If
+///         empty, transform feedback is not set up.
+/// \param  geometry_shader_source The complete GLSL source for a geometry
+///         shader between the two, including the #version directive, or
+///         empty for none.
+/// \return The ID of the new shader program.
+GLuint compileShaderProgram(const std::string& vertex_shader_source,
+                            const std::string& fragment_shader_source,
+                            const std::vector<const char*>& feedback_varyings,
+                            const std::string& geometry_shader_source)
+{
+    // First, compile vertex/fragment shaders.
+
+    GLuint vert_shader_id = glCreateShader(GL_VERTEX_SHADER);
+    GLuint frag_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
+
+    const char* vert_cstr = vertex_shader_source.c_str();
+    const char* frag_cstr = fragment_shader_source.c_str();
+
+    glShaderSource(vert_shader_id, 1, &vert_cstr, NULL);
+    glShaderSource(frag_shader_id, 1, &frag_cstr, NULL);
+
+    glCompileShader(vert_shader_id);
+    glCompileShader(frag_shader_id);
+
+    // check if there was a problem with vertex shader compilation.
+    GLint result = GL_FALSE;
+    glGetShaderiv(vert_shader_id, GL_COMPILE_STATUS, &result);
+    if (result != GL_TRUE)
+    {
+        GLint infolog_len;
+        glGetShaderiv(vert_shader_id, GL_INFO_LOG_LENGTH, &infolog_len);
+        char *infolog = new char[std::max(1, infolog_len)];
+        glGetShaderInfoLog(vert_shader_id, infolog_len, NULL, infolog);
+
+        std::cerr << "Error compiling vertex shader!" << std::endl
+                  << "GL Compile Status: " << result << std::endl
+                  << "      GL Info Log: " << infolog << std::endl
+                  << "    Shader Source: " << vertex_shader_source << std::endl;
+
+        delete[] infolog;
+
+        glDeleteShader(vert_shader_id);
+        glDeleteShader(frag_shader_id);
+        throw std::runtime_error("Error compiling vertex shader!");
+    }
+
+    // check if there was a problem with fragment shader compilation.
+    glGetShaderiv(frag_shader_id, GL_COMPILE_STATUS, &result);
+    if (result != GL_TRUE)
+    {
+        GLint infolog_len;
+        glGetShaderiv(frag_shader_id, GL_INFO_LOG_LENGTH, &infolog_len);
+        char *infolog = new char[std::max(1, infolog_len)];
+        glGetShaderInfoLog(frag_shader_id, infolog_len, NULL, infolog);
+
+        std::cerr << "Error compiling fragment shader!" << std::endl
+                  << "GL Compile Status: " << result << std::endl
+                  << "      GL Info Log: " << infolog << std::endl
+                  << "    Shader Source: " << fragment_shader_source << std::endl;
+
+        delete[] infolog;
+
+        glDeleteShader(vert_shader_id);
+        glDeleteShader(frag_shader_id);
+        throw std::runtime_error("Error compiling fragment shader!");
+    }
+
+    GLuint geom_shader_id = 0;
+    if (!geometry_shader_source.empty())
+    {
+        geom_shader_id = glCreateShader(GL_GEOMETRY_SHADER);
+        const char* geom_cstr = geometry_shader_source.c_str();
+        glShaderSource(geom_shader_id, 1, &geom_cstr, NULL);
+        glCompileShader(geom_shader_id);
+
+        // check if there was a problem with geometry shader compilation.
+        glGetShaderiv(geom_shader_id, GL_COMPILE_STATUS, &result);
+        if (result != GL_TRUE)
+        {
+            GLint infolog_len;
+            glGetShaderiv(geom_shader_id, GL_INFO_LOG_LENGTH, &infolog_len);
+            char *infolog = new char[std::max(1, infolog_len)];
+            glGetShaderInfoLog(geom_shader_id, infolog_len, NULL, infolog);
+
+            std::cerr << "Error compiling geometry shader!" << std::endl
+                      << "GL Compile Status: " << result << std::endl
+                      << "      GL Info Log: " << infolog << std::endl
+                      << "    Shader Source: " << geometry_shader_source << std::endl;
+
+            delete[] infolog;
+
+            glDeleteShader(vert_shader_id);
+            glDeleteShader(frag_shader_id);
+            glDeleteShader(geom_shader_id);
+            throw std::runtime_error("Error compiling geometry shader!");
+        }
+    }
+
+    // Next, link shaders together into a program and delete the individual
+    // shaders (we don't need them after the program is linked).
+
+    GLuint program_id = glCreateProgram();
+    glAttachShader(program_id, vert_shader_id);
+    glAttachShader(program_id, frag_shader_id);
+    if (geom_shader_id != 0)
+        glAttachShader(program_id, geom_shader_id);
+    if (!feedback_varyings.empty())
+    {
+        // this version of GLEW takes a non-const array of names.
+        std::vector<const GLchar*> varyings(feedback_varyings.begin(), feedback_varyings.end());
+        glTransformFeedbackVaryings(program_id, GLsizei(varyings.size()), &varyings[0], GL_INTERLEAVED_ATTRIBS);
+    }
+    glLinkProgram(program_id);
+    glDetachShader(program_id, vert_shader_id);
+    glDetachShader(program_id, frag_shader_id);
+    glDeleteShader(vert_shader_id);
+    glDeleteShader(frag_shader_id);
+    if (geom_shader_id != 0)
+    {
+        glDetachShader(program_id, geom_shader_id);
+        glDeleteShader(geom_shader_id);
+    }
+
+    // check if there was a problem with linking.
+    glGetProgramiv(program_id, GL_LINK_STATUS, &result);
+    if (result != GL_TRUE)
+    {
+        GLint infolog_len;
+        glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &infolog_len);
+        char *infolog = new char[std::max(1, infolog_len)];
+        glGetProgramInfoLog(program_id, infolog_len, NULL, infolog);
+
+        std::cerr << "Error linking program!" << std::endl
+                  << "GL Link Status: " << result << std::endl
+                  << "   GL Info Log: " << infolog << std::endl;
+
+        delete[] infolog;
+
+        glDeleteProgram(program_id);
+        throw std::runtime_error("Error linking program!");
+    }
+
+    return program_id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compiles a compute shader and links it into an executable shader
+///         program.
+///
+/// \details As with compileShaderProgram(), failures are written to stderr
+///         and an exception is thrown.
+///
+/// \param  compute_shader_source The complete GLSL source for the compute
+///         shader, including the #version directive.
+/// \return The ID of the new shader program.
+GLuint compileComputeProgram(const std::string& compute_shader_source)
+{
+    GLuint shader_id = glCreateShader(GL_COMPUTE_SHADER);
+
+    const char* cstr = compute_shader_source.c_str();
+    glShaderSource(shader_id, 1, &cstr, NULL);
+    glCompileShader(shader_id);
+
+    // check if there was a problem with compute shader compilation.
+    GLint result = GL_FALSE;
+    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &result);
+    if (result != GL_TRUE)
+    {
+        GLint infolog_len;
+        glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &infolog_len);
+        char *infolog = new char[std::max(1, infolog_len)];
+        glGetShaderInfoLog(shader_id, infolog_len, NULL, infolog);
+
+        std::cerr << "Error compiling compute shader!" << std::endl
+                  << "GL Compile Status: " << result << std::endl
+                  << "      GL Info Log: " << infolog << std::endl
+                  << "    Shader Source: " << compute_shader_source << std::endl;
+
+        delete[] infolog;
+
+        glDeleteShader(shader_id);
+        throw std::runtime_error("Error compiling compute shader!");
+    }
+
+    GLuint program_id = glCreateProgram();
+    glAttachShader(program_id, shader_id);
+    glLinkProgram(program_id);
+    glDetachShader(program_id, shader_id);
+    glDeleteShader(shader_id);
+
+    // check if there was a problem with linking.
+    glGetProgramiv(program_id, GL_LINK_STATUS, &result);
+    if (result != GL_TRUE)
+    {
+        GLint infolog_len;
+        glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &infolog_len);
+        char *infolog = new char[std::max(1, infolog_len)];
+        glGetProgramInfoLog(program_id, infolog_len, NULL, infolog);
+
+        std::cerr << "Error linking program!" << std::endl
+                  << "GL Link Status: " << result << std::endl
+                  << "   GL Info Log: " << infolog << std::endl;
+
+        delete[] infolog;
+
+        glDeleteProgram(program_id);
+        throw std::runtime_error("Error linking program!");
+    }
+
+    return program_id;
+}
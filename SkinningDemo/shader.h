@@ -0,0 +1,22 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  shader.h
+/// \author Ben Crist
+///
+/// \brief  Functions for compiling and linking GLSL shader programs.
+
+#ifndef SHADER_H_
+#define SHADER_H_
+
+#include "demo.h"
+#include <string>
+#include <vector>
+
+GLuint compileShaderProgram(const std::string& vertex_shader_source,
+                            const std::string& fragment_shader_source,
+                            const std::vector<const char*>& feedback_varyings = std::vector<const char*>(),
+                            const std::string& geometry_shader_source = std::string());
+
+GLuint compileComputeProgram(const std::string& compute_shader_source);
+
+#endif
@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  shader_permutation.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the skinning shader generator, and of
+///         SkinningProgramSet class functions.
+
+#include "shader_permutation.h"
+#include "program_cache.h"
+#include "skeletal_mesh.h"
+#include "skinning_shaders.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The #define which selects each PaletteSource in
+///         vertex_shader_source.
+const char* const palette_source_defines[N_PALETTE_SOURCES] =
+{
+    "",
+    "#define PRECOMBINED_PALETTE\n",
+    "#define INSTANCED_PALETTE\n",
+    "#define BAKED_PALETTE\n",
+    "#define TEXTURE_PALETTE\n"
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a description of what's wrong with a permutation, or an
+///         empty string if vertex_shader_source supports it.
+std::string checkPermutation(const SkinningPermutation& permutation)
+{
+    if (permutation.palette_source >= N_PALETTE_SOURCES)
+        return "Unknown palette source.";
+    if (permutation.joint_count == 0)
+        return "The skeleton has no joints.";
+    if (permutation.influence_count == 0 || permutation.influence_count > MAX_JOINT_INFLUENCES)
+        return "The influence count is out of range.";
+    if (permutation.dual_quaternion && permutation.palette_source != PALETTE_SOURCE_UNIFORM_BLOCK)
+        return "Dual quaternions can only be read from the uniform block.";
+    if (permutation.affine_2d && permutation.palette_source != PALETTE_SOURCE_UNIFORM_BLOCK)
+        return "2D affine palettes can only be read from the uniform block.";
+    if (permutation.affine_2d && permutation.dual_quaternion)
+        return "A palette can't be both dual quaternions and 2D affine transforms.";
+    if (permutation.palette_blend && !permutation.dual_quaternion)
+        return "Only dual quaternion palettes can be blended from the previous palette.";
+    if (permutation.lod_joint_count != 0 && permutation.palette_source != PALETTE_SOURCE_TEXTURE_BUFFER)
+        return "Reduced skeletons can only be read from the texture buffer.";
+    if (permutation.lod_joint_count > permutation.joint_count)
+        return "The reduced skeleton has more joints than the full one.";
+    if (permutation.motion_vectors && permutation.palette_source != PALETTE_SOURCE_TEXTURE_BUFFER)
+        return "Only the instanced palettes keep the previous frame's for motion vectors.";
+    if (permutation.motion_vectors && permutation.wireframe)
+        return "A program can't draw both motion vectors and a wireframe.";
+    if (permutation.joint_local_positions && permutation.palette_source != PALETTE_SOURCE_SEPARATE)
+        return "Joint-local positions are only skinned by the separate pose, without a bind pose.";
+    if (permutation.joint_local_positions && (permutation.dual_quaternion || permutation.affine_2d))
+        return "Joint-local positions are only skinned by matrices.";
+    if (permutation.joint_local_positions && permutation.morph_targets)
+        return "Morph targets move bind-pose positions, which joint-local positions don't have.";
+    return std::string();
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the cheapest permutation: a single influence, skinned
+///         from a palette uploaded separately from the bind pose, with its
+///         colors blended in the shader.  The joint count must still be set.
+SkinningPermutation::SkinningPermutation()
+    : palette_source(PALETTE_SOURCE_SEPARATE),
+      dual_quaternion(false),
+      palette_blend(false),
+      affine_2d(false),
+      joint_count(0),
+      lod_joint_count(0),
+      influence_count(1),
+      vertex_colors(false),
+      morph_targets(false),
+      nonuniform_scale(false),
+      wireframe(false),
+      motion_vectors(false),
+      joint_local_positions(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Orders permutations by each of their parameters in turn, so that
+///         they can be used as map keys.
+bool SkinningPermutation::operator<(const SkinningPermutation& other) const
+{
+    if (palette_source != other.palette_source)
+        return palette_source < other.palette_source;
+    if (dual_quaternion != other.dual_quaternion)
+        return dual_quaternion < other.dual_quaternion;
+    if (palette_blend != other.palette_blend)
+        return palette_blend < other.palette_blend;
+    if (affine_2d != other.affine_2d)
+        return affine_2d < other.affine_2d;
+    if (joint_count != other.joint_count)
+        return joint_count < other.joint_count;
+    if (lod_joint_count != other.lod_joint_count)
+        return lod_joint_count < other.lod_joint_count;
+    if (influence_count != other.influence_count)
+        return influence_count < other.influence_count;
+    if (vertex_colors != other.vertex_colors)
+        return vertex_colors < other.vertex_colors;
+    if (morph_targets != other.morph_targets)
+        return morph_targets < other.morph_targets;
+    if (nonuniform_scale != other.nonuniform_scale)
+        return nonuniform_scale < other.nonuniform_scale;
+    if (wireframe != other.wireframe)
+        return wireframe < other.wireframe;
+    if (motion_vectors != other.motion_vectors)
+        return motion_vectors < other.motion_vectors;
+    return joint_local_positions < other.joint_local_positions;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the source of the skinning vertex shader specialized for
+///         a permutation, with its #version directive and #defines.
+///
+/// \details Only the code the permutation needs is compiled; in particular
+///         the influence loop is unrolled to exactly its influence count.
+///         The mesh's vertex inputs are declared from getVertexAttributes(),
+///         at the locations setVertexAttributes() points them to.
+///         Prints the problem to stderr and throws if vertex_shader_source
+///         doesn't support the permutation.
+///
+/// \param  permutation The permutation to specialize the shader for.
+/// \param  source The shader to specialize; vertex_shader_source, or an
+///         edited copy of it.
+/// \param  capture Whether the program will be linked for transform
+///         feedback into a SkinnedVertexCache, which captures positions in
+///         world space rather than taking them through the camera.
+std::string generateSkinningVertexShader(const SkinningPermutation& permutation, const std::string& source,
+                                         bool capture)
+{
+    std::string problem = checkPermutation(permutation);
+    if (!problem.empty())
+    {
+        std::cerr << "Error generating skinning vertex shader!" << std::endl
+                  << "  Error: " << problem << std::endl;
+        throw std::runtime_error(problem);
+    }
+
+    std::ostringstream specialized;
+    specialized << "#version 330" << std::endl
+                << "#define N_JOINTS " << permutation.joint_count << std::endl;
+    if (permutation.lod_joint_count != 0)
+        specialized << "#define N_LOD_JOINTS " << permutation.lod_joint_count << std::endl;
+    specialized << "#define N_INFLUENCES " << permutation.influence_count << std::endl;
+    if (permutation.vertex_colors)
+        specialized << "#define VERTEX_COLORS" << std::endl;
+    if (permutation.morph_targets)
+        specialized << "#define MORPH_TARGETS" << std::endl;
+    if (permutation.nonuniform_scale)
+        specialized << "#define NONUNIFORM_SCALE" << std::endl;
+    if (capture)
+        specialized << "#define SKINNED_VERTEX_CAPTURE" << std::endl;
+    if (permutation.motion_vectors)
+        specialized << "#define MOTION_VECTORS" << std::endl;
+    if (permutation.palette_blend)
+        specialized << "#define PALETTE_BLEND" << std::endl;
+    if (permutation.joint_local_positions)
+        specialized << "#define JOINT_LOCAL_POSITIONS" << std::endl;
+    if (permutation.dual_quaternion)
+        specialized << "#define DUAL_QUATERNION" << std::endl;
+    else if (permutation.affine_2d)
+        specialized << "#define AFFINE_2D" << std::endl;
+    else
+        specialized << palette_source_defines[permutation.palette_source];
+
+    // every vertex format has the same attributes, so any of them declares
+    // the inputs.
+    VertexAttribute attributes[VERTEX_ATTRIBUTE_COUNT];
+    getVertexAttributes(VERTEX_FORMAT_FULL, attributes);
+    for (size_t i = 0; i < VERTEX_ATTRIBUTE_COUNT; ++i)
+        specialized << "layout(location = " << attributes[i].location << ") in " << attributes[i].declaration << ";"
+                    << std::endl;
+    specialized << source;
+
+    return specialized.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the source of the fragment shader every skinning
+///         permutation is linked with.
+///
+/// \param  source fragment_shader_source, or an edited copy of it.
+std::string generateSkinningFragmentShader(const std::string& source)
+{
+    return "#version 330\n" + source;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty set, whose programs will be built from the
+///         given skinning shader sources.
+SkinningProgramSet::SkinningProgramSet(const std::string& vertex_source, const std::string& fragment_source)
+    : vertex_source_(vertex_source),
+      fragment_source_(fragment_source)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Deletes every program in the set.
+SkinningProgramSet::~SkinningProgramSet()
+{
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts building the program for a permutation, unless it has
+///         already been requested.
+///
+/// \param  cache The cache to build the program through.  Its finish() must
+///         be called before the program is used.
+/// \param  permutation The permutation to build.
+/// \param  feedback Whether to link the program for transform feedback into
+///         a SkinnedVertexCache.  Wireframe permutations can't be, since
+///         they'd capture the geometry shader's outputs.
+void SkinningProgramSet::request(ProgramCache& cache, const SkinningPermutation& permutation, bool feedback)
+{
+    Key key(permutation, feedback);
+    if (programs_.find(key) != programs_.end())
+        return;
+
+    if (feedback && permutation.wireframe)
+    {
+        std::cerr << "Error requesting skinning program!" << std::endl
+                  << "  Error: Wireframe programs can't be linked for transform feedback." << std::endl;
+        throw std::runtime_error("Wireframe programs can't be linked for transform feedback.");
+    }
+
+    std::vector<const char*> feedback_varyings;
+    if (feedback)
+    {
+        feedback_varyings.push_back("gl_Position");
+        feedback_varyings.push_back("color");
+    }
+
+    GLuint& program_id = programs_[key];
+    std::string vertex_shader = generateSkinningVertexShader(permutation, vertex_source_, feedback);
+    if (permutation.wireframe)
+    {
+        cache.requestProgram(program_id, vertex_shader, generateSkinningFragmentShader(wireframe_fragment_shader_source),
+                             feedback_varyings, "#version 330\n" + wireframe_geometry_shader_source);
+    }
+    else if (permutation.motion_vectors)
+    {
+        cache.requestProgram(program_id, vertex_shader,
+                             generateSkinningFragmentShader(motion_vector_fragment_shader_source), feedback_varyings);
+    }
+    else
+        cache.requestProgram(program_id, vertex_shader, generateSkinningFragmentShader(fragment_source_), feedback_varyings);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the program built for a permutation, or 0 if it was
+///         never requested.
+GLuint SkinningProgramSet::getProgram(const SkinningPermutation& permutation, bool feedback) const
+{
+    std::map<Key, GLuint>::const_iterator it = programs_.find(Key(permutation, feedback));
+    return it != programs_.end() ? it->second : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of distinct programs in the set.
+size_t SkinningProgramSet::getProgramCount() const
+{
+    return programs_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Deletes every program in the set.
+void SkinningProgramSet::clear()
+{
+    for (std::map<Key, GLuint>::iterator it = programs_.begin(); it != programs_.end(); ++it)
+        glDeleteProgram(it->second);
+    programs_.clear();
+}
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  shader_permutation.h
+/// \author Ben Crist
+///
+/// \brief  Declarations of the SkinningPermutation struct, which describes
+///         one variant of the skinning vertex shader, and the
+///         SkinningProgramSet class, which builds each variant once.
+
+#ifndef SHADER_PERMUTATION_H_
+#define SHADER_PERMUTATION_H_
+
+#include "demo.h"
+#include "skinning_shaders.h"
+#include <map>
+#include <string>
+#include <utility>
+
+class ProgramCache;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Where the skinning vertex shader reads its palette from.
+enum PaletteSource
+{
+    PALETTE_SOURCE_SEPARATE = 0,    ///< current_pose in the SkinningPalette block, times the bind_pose_inv uniform array.
+    PALETTE_SOURCE_UNIFORM_BLOCK,   ///< A precombined palette (or dual quaternions, or 2D affines) in the SkinningPalette block.
+    PALETTE_SOURCE_TEXTURE_BUFFER,  ///< A precombined palette per instance in the instance_palettes texture buffer.
+    PALETTE_SOURCE_BAKED_TEXTURE,   ///< A baked clip in the baked_palettes texture, shared by every instance.
+    PALETTE_SOURCE_PALETTE_TEXTURE, ///< A precombined palette, and the colors, in the skinning_palette_texture texture buffer.
+    N_PALETTE_SOURCES
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The parameters the skinning vertex shader is specialized on.
+///
+/// \details The instanced draws are implied by the palette source: the
+///         texture buffer and baked texture sources are always drawn
+///         instanced, and the uniform block and palette texture ones never
+///         are.  Storage
+///         buffers aren't a palette source, since the vertex shader sticks
+///         to GLSL 3.30; the compute skinner reads its palette from one
+///         instead.
+struct SkinningPermutation
+{
+    SkinningPermutation();
+
+    bool operator<(const SkinningPermutation& other) const;
+
+    PaletteSource palette_source;
+    bool dual_quaternion;       ///< Blend dual quaternions rather than matrices; only from PALETTE_SOURCE_UNIFORM_BLOCK.
+    bool palette_blend;         ///< Blend each joint from the previous palette in the block first; only with dual_quaternion.
+    bool affine_2d;             ///< Read the palette as 2D affine transforms (see Affine2D); only from PALETTE_SOURCE_UNIFORM_BLOCK.
+    size_t joint_count;         ///< The number of joints in the skeleton.
+    size_t lod_joint_count;     ///< The number of joints in a reduced skeleton's palettes, or 0 for the full skeleton.
+    size_t influence_count;     ///< The number of influences evaluated per vertex, from 1 to MAX_JOINT_INFLUENCES.
+    bool vertex_colors;         ///< Read each vertex's blended color from an attribute, rather than blending it.
+    bool morph_targets;         ///< Add each vertex's morph target offset before skinning it.
+    bool nonuniform_scale;      ///< Transform normals by the cofactor matrix, for palettes with nonuniform scale.
+    bool wireframe;             ///< Outline each triangle in the same pass, with wireframe_geometry_shader_source.
+    bool motion_vectors;        ///< Skin with the previous frame's palettes too, and draw the motion between them; only from PALETTE_SOURCE_TEXTURE_BUFFER.
+    bool joint_local_positions; ///< Skin each influence's position, prebaked into its joint's space (see JointLocalStream), by current_pose alone; only from PALETTE_SOURCE_SEPARATE.
+};
+
+std::string generateSkinningVertexShader(const SkinningPermutation& permutation,
+                                         const std::string& source = vertex_shader_source,
+                                         bool capture = false);
+std::string generateSkinningFragmentShader(const std::string& source = fragment_shader_source);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Owns the skinning programs built for a set of permutations,
+///         building each permutation only once however many meshes,
+///         partitions or levels of detail ask for it.
+///
+/// \details request() only starts building a program through a
+///         ProgramCache; getProgram() may not be called for it until the
+///         cache's finish() has returned.  Programs linked for transform
+///         feedback capture gl_Position and color, in the layout of
+///         SkinnedVertexCache::SkinnedVertex, and are kept apart from the
+///         ones that aren't.  Every program is built from the same vertex
+///         and fragment shader sources, which default to the built-in ones,
+///         except that wireframe permutations use the built-in wireframe
+///         geometry and fragment shaders instead of the fragment source,
+///         and motion vector permutations the built-in motion vector
+///         fragment shader.
+class SkinningProgramSet
+{
+public:
+    explicit SkinningProgramSet(const std::string& vertex_source = vertex_shader_source,
+                                const std::string& fragment_source = fragment_shader_source);
+    ~SkinningProgramSet();
+
+    void request(ProgramCache& cache, const SkinningPermutation& permutation, bool feedback = false);
+    GLuint getProgram(const SkinningPermutation& permutation, bool feedback = false) const;
+    size_t getProgramCount() const;
+
+    void clear();
+
+private:
+    SkinningProgramSet(const SkinningProgramSet&);              // non-copyable
+    SkinningProgramSet& operator=(const SkinningProgramSet&);   // non-copyable
+
+    typedef std::pair<SkinningPermutation, bool> Key;
+
+    std::string vertex_source_;
+    std::string fragment_source_;
+
+    // map nodes never move, so the ids can be handed to the ProgramCache.
+    std::map<Key, GLuint> programs_;
+};
+
+#endif
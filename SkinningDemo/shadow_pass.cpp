@@ -0,0 +1,258 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  shadow_pass.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of ShadowPass class functions.
+
+#include "shadow_pass.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+const size_t ShadowPass::MAX_CASCADES;
+const float ShadowPass::SPLIT_BLEND = 0.5f;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the framebuffer all of the shadow map's layers are drawn
+///         into at once.  It has no shadow map until setTexture().
+///
+/// \param  resolution The width and height of each cascade's layer.
+/// \param  cascade_count The number of cascades, from 1 to MAX_CASCADES.
+ShadowPass::ShadowPass(GLsizei resolution, size_t cascade_count)
+    : resolution_(resolution),
+      cascade_count_(std::min(std::max(cascade_count, size_t(1)), MAX_CASCADES)),
+      texture_id_(0),
+      framebuffer_id_(0)
+{
+    for (size_t i = 0; i < MAX_CASCADES; ++i)
+    {
+        cascade_transforms_[i] = mat4(1);
+        cascade_ends_[i] = float(i + 1) / cascade_count_;
+    }
+
+    glGenFramebuffers(1, &framebuffer_id_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the framebuffer.  The shadow map is the caller's.
+ShadowPass::~ShadowPass()
+{
+    glDeleteFramebuffers(1, &framebuffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns what the shadow map has to be: a GL_DEPTH_COMPONENT24
+///         texture array with one layer per cascade.
+FrameGraph::TextureDesc ShadowPass::getTextureDesc() const
+{
+    FrameGraph::TextureDesc desc;
+    desc.target = GL_TEXTURE_2D_ARRAY;
+    desc.internal_format = GL_DEPTH_COMPONENT24;
+    desc.width = resolution_;
+    desc.height = resolution_;
+    desc.layers = GLsizei(cascade_count_);
+    return desc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Attaches the texture the shadow map is drawn into.
+///
+/// \details It's attached again even if it has the same name as the last
+///         one, since the name may have been reused for a new texture.
+///
+/// \param  texture_id A texture made from getTextureDesc().  It's set up
+///         for comparisons with a sampler2DArrayShadow.
+void ShadowPass::setTexture(GLuint texture_id)
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // attaching the whole array makes the framebuffer layered, so the
+    // geometry shader's gl_Layer picks each triangle's cascade.
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_id, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "The shadow map's framebuffer is incomplete (status 0x" << std::hex << status << std::dec
+                  << ")." << std::endl;
+        throw std::runtime_error("Failed to attach the shadow map!");
+    }
+    texture_id_ = texture_id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Places each cascade's view from the light around its slice of
+///         the camera's view volume.
+///
+/// \details The slices' ends are a blend of even and logarithmic steps
+///         along the camera's depth; an orthographic camera, or one whose
+///         near plane is behind it, is split evenly.  Each cascade is the
+///         light's view of the sphere around its slice, which stays the
+///         same size however the camera turns, and reaches a diameter back
+///         towards the light to take in casters just outside the slice.
+///
+/// \param  camera The camera the frame is drawn through.
+/// \param  light_direction The way the light shines, in world space.
+void ShadowPass::fitCascades(const Camera& camera, const vec3& light_direction)
+{
+    // the corners of the near and far planes, in world space.
+    mat4 inverse_view_projection = glm::inverse(camera.getViewProjection());
+    vec3 near_corners[4];
+    vec3 far_corners[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 corner(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f);
+        vec4 near_corner = inverse_view_projection * vec4(corner, -1, 1);
+        vec4 far_corner = inverse_view_projection * vec4(corner, 1, 1);
+        near_corners[i] = vec3(near_corner) / near_corner.w;
+        far_corners[i] = vec3(far_corner) / far_corner.w;
+    }
+
+    mat4 inverse_view = glm::inverse(camera.getView());
+    vec3 eye(inverse_view[3]);
+    vec3 forward = -vec3(inverse_view[2]);
+    float near_distance = glm::dot((near_corners[0] + near_corners[3]) * 0.5f - eye, forward);
+    float far_distance = glm::dot((far_corners[0] + far_corners[3]) * 0.5f - eye, forward);
+    bool logarithmic = near_distance > 0 && far_distance > near_distance;
+
+    vec3 direction = glm::normalize(light_direction);
+    vec3 up = std::abs(direction.y) < 0.99f ? vec3(0, 1, 0) : vec3(1, 0, 0);
+    mat4 light_view = glm::lookAt(vec3(0, 0, 0), direction, up);
+
+    float start = 0;
+    for (size_t cascade = 0; cascade < cascade_count_; ++cascade)
+    {
+        float end = float(cascade + 1) / cascade_count_;
+        if (logarithmic)
+        {
+            float distance = near_distance * std::pow(far_distance / near_distance, end);
+            float logarithmic_end = (distance - near_distance) / (far_distance - near_distance);
+            end += (logarithmic_end - end) * SPLIT_BLEND;
+        }
+
+        vec3 corners[8];
+        vec3 center(0, 0, 0);
+        for (int i = 0; i < 4; ++i)
+        {
+            corners[i] = glm::mix(near_corners[i], far_corners[i], start);
+            corners[i + 4] = glm::mix(near_corners[i], far_corners[i], end);
+            center += corners[i] + corners[i + 4];
+        }
+        center /= 8.0f;
+
+        float radius = 0;
+        for (int i = 0; i < 8; ++i)
+            radius = std::max(radius, glm::length(corners[i] - center));
+        radius = std::max(radius, 1e-4f);
+
+        // move the view in whole texels, so the same texels keep covering
+        // the same parts of the scene.
+        vec3 light_center = vec3(light_view * vec4(center, 1));
+        float texel = 2.0f * radius / resolution_;
+        light_center.x = std::floor(light_center.x / texel) * texel;
+        light_center.y = std::floor(light_center.y / texel) * texel;
+
+        mat4 projection = glm::ortho(light_center.x - radius, light_center.x + radius,
+                                     light_center.y - radius, light_center.y + radius,
+                                     -light_center.z - 2.0f * radius, -light_center.z + radius);
+        cascade_transforms_[cascade] = projection * light_view;
+        cascade_ends_[cascade] = end;
+        start = end;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Binds the shadow map and clears it, ready for every cascade to
+///         be drawn with one draw of cascade_count instances.
+///
+/// \details The program must be built from one of the shadow vertex shaders
+///         and shadow_geometry_shader_source, and setTexture() must have
+///         attached the shadow map.  The camera's framebuffer
+///         and viewport have to be bound again after end().
+///
+/// \param  program_id The program to draw with, which is left in use.
+/// \param  source_transform Takes the vertices being drawn to world space:
+///         the identity for world-space vertices, or the inverse of the
+///         camera's view-projection for ones in its clip space.
+void ShadowPass::begin(GLuint program_id, const mat4& source_transform)
+{
+    assert(texture_id_ != 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glViewport(0, 0, resolution_, resolution_);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    mat4 transforms[MAX_CASCADES];
+    for (size_t i = 0; i < cascade_count_; ++i)
+        transforms[i] = cascade_transforms_[i] * source_transform;
+
+    glUseProgram(program_id);
+    glUniformMatrix4fv(glGetUniformLocation(program_id, "cascade_transforms"), GLsizei(cascade_count_), GL_FALSE,
+                       &transforms[0][0][0]);
+    glUniform1i(glGetUniformLocation(program_id, "cascade_count"), GLint(cascade_count_));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finishes drawing the shadow map, and unbinds it.
+void ShadowPass::end()
+{
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the width and height of each cascade's layer.
+GLsizei ShadowPass::getResolution() const
+{
+    return resolution_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of cascades, which is the number of instances
+///         to draw between begin() and end().
+GLsizei ShadowPass::getCascadeCount() const
+{
+    return GLsizei(cascade_count_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the shadow map last attached with setTexture(): a depth
+///         texture array with one layer per cascade, set up for comparisons
+///         with a sampler2DArrayShadow.
+GLuint ShadowPass::getTextureId() const
+{
+    return texture_id_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform from world space to a cascade's clip
+///         space, as of the last call to fitCascades().
+const mat4& ShadowPass::getCascadeTransform(size_t cascade) const
+{
+    assert(cascade < cascade_count_);
+    return cascade_transforms_[cascade];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how far along the camera's depth, from 0 at its near
+///         plane to 1 at its far plane, a cascade reaches; anything past
+///         one cascade's end should be looked up in the next.
+float ShadowPass::getCascadeEnd(size_t cascade) const
+{
+    assert(cascade < cascade_count_);
+    return cascade_ends_[cascade];
+}
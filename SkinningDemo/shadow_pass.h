@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  shadow_pass.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the ShadowPass class.
+
+#ifndef SHADOW_PASS_H_
+#define SHADOW_PASS_H_
+
+#include "demo.h"
+#include "camera.h"
+#include "frame_graph.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A cascaded shadow map for a directional light, drawn from the
+///         vertices a frame has already skinned.
+///
+/// \details The camera's view volume is cut into cascade_count slices along
+///         its depth, each covered by its own orthographic view from the
+///         light and its own layer of a depth texture array, so the slices
+///         nearest the camera get the most texels.  fitCascades() places the
+///         views each frame; each one's center is snapped to whole texels of
+///         its layer, so the shadow's edges don't crawl as the camera moves.
+///
+///         Every cascade is drawn by one instanced draw of the skinned
+///         vertices, between begin() and end(): the instance picks the
+///         cascade, and a geometry shader sends each triangle to its
+///         cascade's layer (see shadow_vertex_shader_source), so however
+///         many cascades there are, the mesh is skinned once and drawn once.
+///         The layers all share the one viewport, which is why they're
+///         layers of an array rather than viewports of an atlas; that needs
+///         nothing past GL 3.3.
+///
+///         The shadow map itself only has to live while it's drawn and
+///         read, so the pass doesn't own it: it's a FrameGraph transient
+///         made from getTextureDesc(), which setTexture() attaches before
+///         each begin().
+class ShadowPass
+{
+public:
+    static const size_t MAX_CASCADES = 4;   ///< Must match the length of the shaders' cascade_transforms.
+
+    ShadowPass(GLsizei resolution, size_t cascade_count);
+    ~ShadowPass();
+
+    void fitCascades(const Camera& camera, const vec3& light_direction);
+
+    FrameGraph::TextureDesc getTextureDesc() const;
+    void setTexture(GLuint texture_id);
+
+    void begin(GLuint program_id, const mat4& source_transform);
+    void end();
+
+    GLsizei getResolution() const;
+    GLsizei getCascadeCount() const;
+    GLuint getTextureId() const;
+    const mat4& getCascadeTransform(size_t cascade) const;
+    float getCascadeEnd(size_t cascade) const;
+
+private:
+    ShadowPass(const ShadowPass&);              // non-copyable
+    ShadowPass& operator=(const ShadowPass&);   // non-copyable
+
+    static const float SPLIT_BLEND;             ///< 0 splits the depth evenly, 1 logarithmically.
+
+    GLsizei resolution_;
+    size_t cascade_count_;
+    mat4 cascade_transforms_[MAX_CASCADES];     ///< World space to each cascade's clip space.
+    float cascade_ends_[MAX_CASCADES];          ///< How far along the camera's depth each cascade reaches, from 0 to 1.
+
+    GLuint texture_id_;         ///< The shadow map attached to the framebuffer, which the caller owns.
+    GLuint framebuffer_id_;
+};
+
+#endif
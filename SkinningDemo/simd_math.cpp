@@ -0,0 +1,38 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  simd_math.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the batched math operations.
+
+#include "simd_math.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Linearly interpolates between two streams of floats.
+///
+/// \details The streams can be anything made of floats: a pose's channels,
+///         or whole arrays of matrices.  With SSE2, four floats are
+///         interpolated at a time.
+///
+/// \param  a The stream of values to use when t == 0.
+/// \param  b The stream of values to use when t == 1.
+/// \param  t The interpolation factor.
+/// \param  out The stream which receives the results.  It may alias a or b.
+/// \param  count The number of floats in each stream.
+void lerpFloats(const float* a, const float* b, float t, float* out, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 t4 = _mm_set1_ps(t);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a4 = _mm_loadu_ps(a + i);
+        __m128 b4 = _mm_loadu_ps(b + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(a4, _mm_mul_ps(_mm_sub_ps(b4, a4), t4)));
+    }
+#endif
+
+    for (; i < count; ++i)
+        out[i] = a[i] + (b[i] - a[i]) * t;
+}
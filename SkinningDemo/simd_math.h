@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  simd_math.h
+/// \author Ben Crist
+///
+/// \brief  The matrix operations the engine's hot loops are built from,
+///         with SSE2 implementations where they're available.
+
+#ifndef SIMD_MATH_H_
+#define SIMD_MATH_H_
+
+#include "affine_2d.h"
+#include "demo.h"
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+#include <glm/core/intrinsic_matrix.hpp>
+#endif
+
+// These take and return plain mat4s and vec4s, so that a loop can switch to
+// them without changing its data.  With SSE2, they're built on the
+// intrinsics in GLM's core/intrinsic_matrix.hpp, which are what
+// glm::simdMat4 is built on; the simdMat4 type itself needs its data
+// 16-byte aligned, which GLM 0.9.4 only knows how to do for MSVC and older
+// GCCs, and converting a mat4 to and from it costs more than the SIMD saves
+// (see the "glm_simd" path in the kernel benchmarks).  Loading the columns
+// straight out of the mat4s, unaligned, costs nothing on any CPU which
+// runs the demo.  Without SSE2, each is the plain GLM expression.
+//
+// They're inline because they're called once per joint or vertex, usually
+// from another file; a call would cost as much as the arithmetic.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a * b.
+inline mat4 multiplyMatrices(const mat4& a, const mat4& b)
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 in_a[4] = { _mm_loadu_ps(&a[0][0]), _mm_loadu_ps(&a[1][0]), _mm_loadu_ps(&a[2][0]), _mm_loadu_ps(&a[3][0]) };
+    const __m128 in_b[4] = { _mm_loadu_ps(&b[0][0]), _mm_loadu_ps(&b[1][0]), _mm_loadu_ps(&b[2][0]), _mm_loadu_ps(&b[3][0]) };
+    __m128 out[4];
+    glm::detail::sse_mul_ps(in_a, in_b, out);
+
+    mat4 product;
+    for (int column = 0; column < 4; ++column)
+        _mm_storeu_ps(&product[column][0], out[column]);
+    return product;
+#else
+    return a * b;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns m * v.
+inline vec4 transformVector(const mat4& m, const vec4& v)
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    // intrinsic_matrix.hpp declares an overload for a non-const array which
+    // it never defines.
+    const __m128 columns[4] = { _mm_loadu_ps(&m[0][0]), _mm_loadu_ps(&m[1][0]), _mm_loadu_ps(&m[2][0]), _mm_loadu_ps(&m[3][0]) };
+    vec4 result;
+    _mm_storeu_ps(&result[0], glm::detail::sse_mul_ps(columns, _mm_loadu_ps(&v[0])));
+    return result;
+#else
+    return m * v;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the inverse of a joint transform, like
+///         inverseJointTransform(): any combination of rotation,
+///         translation and uniform scale.
+///
+/// \details With SSE2, the scaled axes are transposed in registers, and
+///         the translation is carried back through the transposed axes with
+///         three multiply-adds.
+inline mat4 invertJointTransform(const mat4& transform)
+{
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    __m128 x_axis = _mm_loadu_ps(&transform[0][0]);
+    __m128 y_axis = _mm_loadu_ps(&transform[1][0]);
+    __m128 z_axis = _mm_loadu_ps(&transform[2][0]);
+    __m128 translation = _mm_loadu_ps(&transform[3][0]);
+
+    // the axes' w is 0, so the dot product of x_axis with itself is just
+    // its squared length.
+    __m128 squares = _mm_mul_ps(x_axis, x_axis);
+    squares = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+    squares = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(1, 0, 3, 2)));
+    __m128 inverse_scale_squared = _mm_div_ps(_mm_set1_ps(1.0f), squares);
+
+    __m128 c0 = _mm_mul_ps(x_axis, inverse_scale_squared);
+    __m128 c1 = _mm_mul_ps(y_axis, inverse_scale_squared);
+    __m128 c2 = _mm_mul_ps(z_axis, inverse_scale_squared);
+    __m128 c3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    __m128 moved = _mm_mul_ps(c0, _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(0, 0, 0, 0)));
+    moved = _mm_add_ps(moved, _mm_mul_ps(c1, _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(1, 1, 1, 1))));
+    moved = _mm_add_ps(moved, _mm_mul_ps(c2, _mm_shuffle_ps(translation, translation, _MM_SHUFFLE(2, 2, 2, 2))));
+    c3 = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), moved);
+
+    mat4 inverse;
+    _mm_storeu_ps(&inverse[0][0], c0);
+    _mm_storeu_ps(&inverse[1][0], c1);
+    _mm_storeu_ps(&inverse[2][0], c2);
+    _mm_storeu_ps(&inverse[3][0], c3);
+    return inverse;
+#else
+    return inverseJointTransform(transform);
+#endif
+}
+
+void lerpFloats(const float* a, const float* b, float t, float* out, size_t count);
+
+#endif
@@ -3,76 +3,2324 @@
 /// \file:  skeletal_mesh.cpp
 /// \author Ben Crist
 ///
-/// \brief  Implementations of SkeletalMesh class functions.
+/// \brief  Implementations of SkeletalMesh class functions, for both 2D and
+///         3D vertices.
 
 #include "skeletal_mesh.h"
+#include "byte_compression.h"
+#include "gl_deletion_queue.h"
+#include "index_codec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Quantizes the joint indices and weights of a vertex into the
+///         packed byte representation.
+///
+/// \details The weights are normalized before quantizing, since the packed
+///         formats can only represent weights which sum to 1.  Each weight
+///         is rounded to the nearest 1/255th, and the rounding error is
+///         added to the largest weight.  Putting it anywhere else could move
+///         weight onto an influence that a shader with fewer influences
+///         would ignore.
+template <typename VertexType, typename PackedVertexType>
+void packJoints(const VertexType& vertex, PackedVertexType& packed)
+{
+    float sum = 0.0f;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        sum += vertex.joint_weights[i];
+
+    float scale = sum > 0.0f ? 255.0f / sum : 0.0f;
+
+    int total = 0;
+    size_t largest = 0;
+    int weights[MAX_JOINT_INFLUENCES];
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        assert(vertex.joint_indices[i] <= 255);
+        packed.joint_indices[i] = GLubyte(vertex.joint_indices[i]);
+
+        weights[i] = std::min(std::max(int(vertex.joint_weights[i] * scale + 0.5f), 0), 255);
+        total += weights[i];
+        if (vertex.joint_weights[i] > vertex.joint_weights[largest])
+            largest = i;
+    }
+
+    weights[largest] += 255 - total;
+
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        packed.joint_weights[i] = GLubyte(weights[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stores a position in a packed vertex's position type.
+void toPackedPosition(const vec2& position, vec2& packed)
+{
+    packed = position;
+}
+
+void toPackedPosition(const vec3& position, vec3& packed)
+{
+    packed = position;
+}
+
+void toPackedPosition(const vec2& position, glm::hvec2& packed)
+{
+    packed = glm::hvec2(glm::half(position.x), glm::half(position.y));
+}
+
+void toPackedPosition(const vec3& position, glm::hvec3& packed)
+{
+    packed = glm::hvec3(glm::half(position.x), glm::half(position.y), glm::half(position.z));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vertex to one of the packed layouts, with its position
+///         converted by toPackedPosition().
+template <typename PackedVertexType, typename VertexType>
+PackedVertexType packVertexAs(const VertexType& vertex)
+{
+    PackedVertexType packed;
+    toPackedPosition(vertex.position, packed.position);
+    packJoints(vertex, packed);
+    packed.normal = packNormal(vec4(vertex.normal, 0));
+    packed.tangent = packNormal(vertex.tangent);
+    return packed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a 2D or 3D position as a vec3; 2D positions are at z = 0.
+vec3 toPosition3D(const vec2& position)
+{
+    return vec3(position, 0);
+}
+
+vec3 toPosition3D(const vec3& position)
+{
+    return position;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a component in [-1, 1] to a 16-bit signed normalized
+///         integer, rounding to the nearest.
+GLshort toSnorm16(float value)
+{
+    return GLshort(glm::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a position is inside the bounds a quantization
+///         covers.
+bool fitsQuantization(const vec3& position, const PositionQuantization& quantization)
+{
+    vec3 offset = glm::abs(position - quantization.bias);
+    return std::max(offset.x, std::max(offset.y, offset.z)) <= quantization.scale;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vertex to one of the quantized layouts, with its
+///         position relative to a mesh's bounds.  Any components past the
+///         vertex's own (the padding of a QuantizedVertex3D) are 0.
+template <typename QuantizedVertexType, typename VertexType>
+QuantizedVertexType packVertexQuantizedAs(const VertexType& vertex, const PositionQuantization& quantization)
+{
+    vec3 position = (toPosition3D(vertex.position) - quantization.bias) / quantization.scale;
+
+    QuantizedVertexType packed;
+    const size_t n_shorts = sizeof(packed.position) / sizeof(packed.position[0]);
+    for (size_t i = 0; i < n_shorts; ++i)
+        packed.position[i] = i < VertexLayout<VertexType>::POSITION_COMPONENTS ? toSnorm16(position[int(i)]) : 0;
+
+    packJoints(vertex, packed);
+    packed.normal = packNormal(vec4(vertex.normal, 0));
+    packed.tangent = packNormal(vertex.tangent);
+    return packed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the 2D format with the same layout as a format, so that
+///         the layouts can be told apart without caring about dimensions.
+VertexFormat getLayout(VertexFormat format)
+{
+    if (format == VERTEX_FORMAT_FULL_3D)
+        return VERTEX_FORMAT_FULL;
+    else if (format == VERTEX_FORMAT_PACKED_3D)
+        return VERTEX_FORMAT_PACKED;
+    else if (format == VERTEX_FORMAT_PACKED_HALF_3D)
+        return VERTEX_FORMAT_PACKED_HALF;
+    else if (format == VERTEX_FORMAT_QUANTIZED_3D)
+        return VERTEX_FORMAT_QUANTIZED;
+    else
+        return format;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vector of vertices with a packing function, and stores
+///         the bytes of the packed vertices in a buffer.
+template <typename VertexType, typename PackedVertexType>
+void packVertices(const std::vector<VertexType>& vertices,
+                  PackedVertexType (*pack)(const VertexType&),
+                  std::vector<char>& vertex_data)
+{
+    vertex_data.resize(vertices.size() * sizeof(PackedVertexType));
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        PackedVertexType packed = pack(vertices[i]);
+        std::memcpy(&vertex_data[i * sizeof(PackedVertexType)], &packed, sizeof(PackedVertexType));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sorts a vertex's influences and writes it to a buffer in a vertex
+///         format of its dimension, exactly as buildMeshUploadData() does.
+///         The quantization is only used by the quantized formats.
+template <typename VertexType>
+void writeVertex(const VertexType& vertex, VertexFormat format, const PositionQuantization& quantization, char* data)
+{
+    VertexType sorted = sortInfluences(vertex);
+    if (getLayout(format) == VERTEX_FORMAT_QUANTIZED)
+    {
+        typename VertexLayout<VertexType>::Quantized packed = packVertexQuantized(sorted, quantization);
+        std::memcpy(data, &packed, sizeof(packed));
+    }
+    else if (getLayout(format) == VERTEX_FORMAT_PACKED)
+    {
+        typename VertexLayout<VertexType>::Packed packed = packVertex(sorted);
+        std::memcpy(data, &packed, sizeof(packed));
+    }
+    else if (getLayout(format) == VERTEX_FORMAT_PACKED_HALF)
+    {
+        typename VertexLayout<VertexType>::HalfPacked packed = packVertexHalf(sorted);
+        std::memcpy(data, &packed, sizeof(packed));
+    }
+    else
+        std::memcpy(data, &sorted, sizeof(sorted));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a vertex's position as full floats, whatever its format.
+///         3D positions are projected onto the xy plane, which is all that
+///         the bounds cover.
+template <typename PositionType>
+vec2 getVertexPosition(const BasicVertex<PositionType>& vertex)
+{
+    return vec2(vertex.position);
+}
+
+template <typename PositionType>
+vec2 getVertexPosition(const BasicPackedVertex<PositionType>& vertex)
+{
+    return vec2(vertex.position);
+}
+
+template <typename HalfPositionType>
+vec2 getVertexPosition(const BasicHalfPackedVertex<HalfPositionType>& vertex)
+{
+    return vec2(float(vertex.position.x), float(vertex.position.y));
+}
+
+/// Quantized positions are returned as GL normalizes them, in [-1, 1].
+template <size_t N_POSITION_SHORTS>
+vec2 getVertexPosition(const BasicQuantizedVertex<N_POSITION_SHORTS>& vertex)
+{
+    return glm::max(vec2(vertex.position[0], vertex.position[1]) / 32767.0f, vec2(-1.0f));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Grows the bounds of each joint to contain the vertices it
+///         influences, from vertices stored in one of the vertex formats.
+///         The positions are mapped through the quantization, which is the
+///         identity for every format but the quantized ones.
+template <typename VertexType>
+void expandJointBounds(const void* vertex_data, size_t vertex_count, std::vector<BoundingBox>& joint_bounds,
+                       const PositionQuantization& quantization)
+{
+    vec2 bias(quantization.bias);
+    for (size_t i = 0; i < vertex_count; ++i)
+    {
+        const VertexType& vertex = static_cast<const VertexType*>(vertex_data)[i];
+
+        vec2 position = bias + getVertexPosition(vertex) * quantization.scale;
+        for (size_t j = 0; j < MAX_JOINT_INFLUENCES; ++j)
+        {
+            if (vertex.joint_weights[j] == 0)
+                continue;
+
+            size_t joint = vertex.joint_indices[j];
+            if (joint >= joint_bounds.size())
+                joint_bounds.resize(joint + 1);
+            joint_bounds[joint].expand(position);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads data to a buffer, reusing its existing storage if the
+///         data fits, so that re-uploading a mesh doesn't reallocate it.
+///
+/// \param  target The binding point the buffer is bound to.
+/// \param  storage_size The size of the buffer's storage; updated if the
+///         storage has to be reallocated.
+/// \param  size The size of the data.
+/// \param  data The data to upload.
+void uploadBuffer(GLenum target, GLsizeiptr& storage_size, GLsizeiptr size, const void* data)
+{
+    if (size > 0 && size <= storage_size)
+        glBufferSubData(target, 0, size, data);
+    else
+    {
+        glBufferData(target, size, data, GL_STATIC_DRAW);
+        storage_size = size;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Makes sure the buffer bound to target has room for size bytes,
+///         reallocating it if it doesn't.  Its contents are undefined
+///         afterward.
+void reserveBuffer(GLenum target, GLsizeiptr& storage_size, GLsizeiptr size)
+{
+    if (size > 0 && size <= storage_size)
+        return;
+
+    glBufferData(target, size, nullptr, GL_STATIC_DRAW);
+    storage_size = size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Narrows indices to an index type, and stores their bytes in a
+///         buffer.
+template <typename IndexType>
+void packIndicesAs(const GLuint* indices, size_t index_count, std::vector<char>& index_data)
+{
+    index_data.resize(index_count * sizeof(IndexType));
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        IndexType index = IndexType(indices[i]);
+        std::memcpy(&index_data[i * sizeof(IndexType)], &index, sizeof(IndexType));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The number and GL type of the components of each type of field
+///         a vertex type can have.
+///
+/// \details A GLuint field is a vector packed as GL_INT_2_10_10_10_REV,
+///         which always has 4 components.
+template <GLint N_COMPONENTS, GLenum COMPONENT_TYPE>
+struct BasicAttributeFormat
+{
+    static const GLint COMPONENTS = N_COMPONENTS;
+    static const GLenum TYPE = COMPONENT_TYPE;
+};
+
+template <typename FieldType>
+struct AttributeFormat;
+
+template <> struct AttributeFormat<vec2> : BasicAttributeFormat<2, GL_FLOAT> {};
+template <> struct AttributeFormat<vec3> : BasicAttributeFormat<3, GL_FLOAT> {};
+template <> struct AttributeFormat<vec4> : BasicAttributeFormat<4, GL_FLOAT> {};
+template <> struct AttributeFormat<glm::hvec2> : BasicAttributeFormat<2, GL_HALF_FLOAT> {};
+template <> struct AttributeFormat<glm::hvec3> : BasicAttributeFormat<3, GL_HALF_FLOAT> {};
+template <> struct AttributeFormat<GLshort[2]> : BasicAttributeFormat<2, GL_SHORT> {};
+template <> struct AttributeFormat<GLshort[4]> : BasicAttributeFormat<3, GL_SHORT> {};    // the fourth is padding
+template <> struct AttributeFormat<GLuint[4]> : BasicAttributeFormat<4, GL_UNSIGNED_INT> {};
+template <> struct AttributeFormat<GLubyte[4]> : BasicAttributeFormat<4, GL_UNSIGNED_BYTE> {};
+template <> struct AttributeFormat<GLfloat[4]> : BasicAttributeFormat<4, GL_FLOAT> {};
+template <> struct AttributeFormat<GLuint> : BasicAttributeFormat<4, GL_INT_2_10_10_10_REV> {};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Describes the attribute of one field of a vertex type.
+///
+/// \param  location The attribute location.
+/// \param  offset The offset of the field in the vertex.
+/// \param  integer Whether the shader reads the field as integers; otherwise
+///         fields of integer types are normalized.
+/// \param  declaration The shader's input.
+template <typename FieldType>
+VertexAttribute describeAttribute(GLuint location, size_t offset, bool integer, const char* declaration)
+{
+    VertexAttribute attribute;
+    attribute.location = location;
+    attribute.components = AttributeFormat<FieldType>::COMPONENTS;
+    attribute.type = AttributeFormat<FieldType>::TYPE;
+    attribute.integer = integer;
+    attribute.normalized = !integer && attribute.type != GL_FLOAT && attribute.type != GL_HALF_FLOAT;
+    attribute.offset = offset;
+    attribute.declaration = declaration;
+    return attribute;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Describes the attributes of a vertex type, from the types and
+///         offsets of its fields.
+///
+/// \details The shaders always read the position as a vec3, and GL fills
+///         in z = 0 when there are only 2 components, so the same programs
+///         draw 2D and 3D meshes.  Likewise a float normal is read without
+///         a w, and a packed one's w is ignored.
+///
+/// \param  attributes Receives the VERTEX_ATTRIBUTE_COUNT attributes.
+template <typename VertexType>
+void describeVertexType(VertexAttribute* attributes)
+{
+    typedef decltype(static_cast<VertexType*>(nullptr)->position) PositionField;
+    typedef decltype(static_cast<VertexType*>(nullptr)->joint_indices) IndicesField;
+    typedef decltype(static_cast<VertexType*>(nullptr)->joint_weights) WeightsField;
+    typedef decltype(static_cast<VertexType*>(nullptr)->normal) NormalField;
+    typedef decltype(static_cast<VertexType*>(nullptr)->tangent) TangentField;
+
+    attributes[0] = describeAttribute<PositionField>(POSITION_ATTRIBUTE, offsetof(VertexType, position),
+                                                     false, "vec3 position");
+    attributes[1] = describeAttribute<IndicesField>(JOINT_INDICES_ATTRIBUTE, offsetof(VertexType, joint_indices),
+                                                    true, "uvec4 joint_indices");
+    attributes[2] = describeAttribute<WeightsField>(JOINT_WEIGHTS_ATTRIBUTE, offsetof(VertexType, joint_weights),
+                                                    false, "vec4 joint_weights");
+    attributes[3] = describeAttribute<NormalField>(NORMAL_ATTRIBUTE, offsetof(VertexType, normal),
+                                                   false, "vec3 normal");
+    attributes[4] = describeAttribute<TangentField>(TANGENT_ATTRIBUTE, offsetof(VertexType, tangent),
+                                                    false, "vec4 tangent");
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs a vertex at the origin, which isn't influenced by any
+///         joints, and faces +z.
+template <typename PositionType>
+BasicVertex<PositionType>::BasicVertex()
+    : normal(0, 0, 1),
+      tangent(1, 0, 0, 1)
+{
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        joint_indices[i] = 0;
+        joint_weights[i] = 0.0f;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Packs a unit vector in xyz and a sign in w into the
+///         GL_INT_2_10_10_10_REV layout, as signed normalized integers.
+///
+/// \details glm's uint10_10_10_2_cast() can't be used for this: it only
+///         packs unsigned values, and scales them by 2047, which doesn't fit
+///         in 10 bits.
+GLuint packNormal(const vec4& normal)
+{
+    GLuint packed = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        int bits = i < 3 ? 10 : 2;
+        float max_value = float((1 << (bits - 1)) - 1);
+        int value = int(glm::round(glm::clamp(normal[i], -1.0f, 1.0f) * max_value));
+        packed |= (GLuint(value) & ((1u << bits) - 1)) << (i * 10);
+    }
+    return packed;
+}
+
+template struct BasicVertex<vec2>;
+template struct BasicVertex<vec3>;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vertex to the PackedVertex layout.
+PackedVertex packVertex(const Vertex& vertex)
+{
+    return packVertexAs<PackedVertex>(vertex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vertex to the PackedVertex3D layout.
+PackedVertex3D packVertex(const Vertex3D& vertex)
+{
+    return packVertexAs<PackedVertex3D>(vertex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vertex to the HalfPackedVertex layout.
+HalfPackedVertex packVertexHalf(const Vertex& vertex)
+{
+    return packVertexAs<HalfPackedVertex>(vertex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vertex to the HalfPackedVertex3D layout.
+HalfPackedVertex3D packVertexHalf(const Vertex3D& vertex)
+{
+    return packVertexAs<HalfPackedVertex3D>(vertex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs the identity quantization.
+PositionQuantization::PositionQuantization()
+    : bias(0, 0, 0),
+      scale(1.0f)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the transform from quantized positions to model space.
+mat4 PositionQuantization::getTransform() const
+{
+    return glm::scale(glm::translate(mat4(), bias), vec3(scale));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vertex to the QuantizedVertex layout.
+QuantizedVertex packVertexQuantized(const Vertex& vertex, const PositionQuantization& quantization)
+{
+    return packVertexQuantizedAs<QuantizedVertex>(vertex, quantization);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts a vertex to the QuantizedVertex3D layout.
+QuantizedVertex3D packVertexQuantized(const Vertex3D& vertex, const PositionQuantization& quantization)
+{
+    return packVertexQuantizedAs<QuantizedVertex3D>(vertex, quantization);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true for the formats whose positions are relative to a
+///         PositionQuantization.
+bool isQuantizedFormat(VertexFormat format)
+{
+    return getLayout(format) == VERTEX_FORMAT_QUANTIZED;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Chooses the quantization which fits a mesh's bounds.
+///
+/// \details The bounds are centered on the origin, and scaled by their
+///         largest half extent, so the mesh fills [-1, 1] along that axis
+///         and each step of the 16-bit positions is 1/32767th of it.  A
+///         mesh with no extent at all gets a scale of 1, so that nothing
+///         divides by 0.
+///
+/// \param  vertices The mesh's vertices; Vertex or Vertex3D.
+template <typename VertexType>
+PositionQuantization choosePositionQuantization(const std::vector<VertexType>& vertices)
+{
+    PositionQuantization quantization;
+    if (vertices.empty())
+        return quantization;
+
+    vec3 min_corner = toPosition3D(vertices[0].position);
+    vec3 max_corner = min_corner;
+    for (size_t i = 1; i < vertices.size(); ++i)
+    {
+        vec3 position = toPosition3D(vertices[i].position);
+        min_corner = glm::min(min_corner, position);
+        max_corner = glm::max(max_corner, position);
+    }
+
+    vec3 half_extent = (max_corner - min_corner) * 0.5f;
+    float scale = std::max(half_extent.x, std::max(half_extent.y, half_extent.z));
+    quantization.bias = (min_corner + max_corner) * 0.5f;
+    quantization.scale = scale > 0.0f ? scale : 1.0f;
+    return quantization;
+}
+
+template PositionQuantization choosePositionQuantization(const std::vector<Vertex>&);
+template PositionQuantization choosePositionQuantization(const std::vector<Vertex3D>&);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Folds a mesh's position quantization into its skeleton's inverse
+///         bind transforms, so that palettes computed from the results take
+///         the quantized positions straight to the skinned pose.
+///
+/// \details Skinning then costs nothing extra per vertex.  The results
+///         stay a joint's rotation, translation and uniform scale, so they
+///         can be converted to dual quaternions or Affine2Ds (see
+///         mat4ToAffine()) like any other inverse bind transform.
+///
+/// \param  inverse_bind_transforms The skeleton's inverse bind transforms.
+/// \param  joint_count The number of joints.
+/// \param  quantization The mesh's quantization.
+/// \param  folded Receives the folded transforms; may be
+///         inverse_bind_transforms.
+void foldPositionQuantization(const mat4* inverse_bind_transforms, size_t joint_count,
+                              const PositionQuantization& quantization, mat4* folded)
+{
+    mat4 transform = quantization.getTransform();
+    for (size_t i = 0; i < joint_count; ++i)
+        folded[i] = inverse_bind_transforms[i] * transform;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a copy of a vertex with its influences reordered from the
+///         largest weight to the smallest, so that all of the influences
+///         which actually affect the vertex come first.
+template <typename VertexType>
+VertexType sortInfluences(const VertexType& vertex)
+{
+    VertexType sorted = vertex;
+
+    // insertion sort; there are only 4 influences.
+    for (size_t i = 1; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        for (size_t j = i; j > 0 && sorted.joint_weights[j] > sorted.joint_weights[j - 1]; --j)
+        {
+            std::swap(sorted.joint_weights[j], sorted.joint_weights[j - 1]);
+            std::swap(sorted.joint_indices[j], sorted.joint_indices[j - 1]);
+        }
+    }
+
+    return sorted;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of influences of a vertex with non-zero
+///         weights.  This is always at least 1, since a shader must evaluate
+///         at least one influence.
+template <typename VertexType>
+size_t getInfluenceCount(const VertexType& vertex)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        if (vertex.joint_weights[i] != 0.0f)
+            ++count;
+    }
+
+    return std::max(count, size_t(1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of influences the partition a vertex is
+///         uploaded in evaluates.
+///
+/// \details That's getInfluenceCount(), except that only a vertex whose one
+///         influence has a weight of exactly 1 is rigid.  The rigid
+///         partition's shader doesn't read the weights at all, so one with
+///         any other weight, or none, goes in the partition with two
+///         influences instead, whose second weight is 0.  Normalized meshes
+///         don't have any; normalizeInfluences() divides the one weight by
+///         itself, which is exactly 1.
+template <typename VertexType>
+size_t getPartitionInfluenceCount(const VertexType& vertex)
+{
+    size_t count = getInfluenceCount(vertex);
+    if (count == 1 && sortInfluences(vertex).joint_weights[0] != 1.0f)
+        return 2;
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a copy of a vertex with its influences sorted, the ones
+///         lighter than a threshold dropped, and the rest scaled to sum to 1.
+///
+/// \details Dropped influences get a weight of 0 and joint 0, so that only
+///         the first getInfluenceCount() influences mean anything.  The
+///         heaviest influence is always kept, however light, so a vertex
+///         with any weight at all keeps following some joint.  A vertex with
+///         no weight at all is left as it is.
+///
+/// \param  vertex The vertex to normalize.
+/// \param  min_weight The lightest weight to keep, before rescaling.
+template <typename VertexType>
+VertexType normalizeInfluences(const VertexType& vertex, float min_weight)
+{
+    VertexType normalized = sortInfluences(vertex);
+
+    float sum = normalized.joint_weights[0];
+    for (size_t i = 1; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        if (normalized.joint_weights[i] < min_weight || normalized.joint_weights[i] <= 0.0f)
+        {
+            normalized.joint_indices[i] = 0;
+            normalized.joint_weights[i] = 0.0f;
+        }
+        sum += normalized.joint_weights[i];
+    }
+
+    if (sum <= 0.0f)
+        return vertex;
+
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        normalized.joint_weights[i] /= sum;
+
+    return normalized;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Normalizes every vertex of a mesh with normalizeInfluences(), in
+///         place, before the mesh is uploaded or anything else reads its
+///         weights.
+///
+/// \details Skinning assumes each vertex's weights sum to 1; ones which
+///         don't pull the vertex towards the model's origin.  Pruning light
+///         influences also moves vertices into partitions with fewer
+///         influences (see SkeletalMeshBase::Partition), whose shaders do
+///         less work per vertex.
+///
+/// \param  vertices The vertices to normalize.
+/// \param  min_weight The lightest weight to keep.
+/// \param  stats If not NULL, receives what was changed.
+template <typename VertexType>
+void normalizeInfluences(std::vector<VertexType>& vertices, float min_weight, InfluenceStats* stats)
+{
+    InfluenceStats counts;
+    counts.normalized_vertices = 0;
+    counts.pruned_influences = 0;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        counts.influence_histogram[i] = 0;
+
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        size_t before = 0;
+        float sum = 0.0f;
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            before += vertices[v].joint_weights[i] > 0.0f ? 1 : 0;
+            sum += vertices[v].joint_weights[i];
+        }
+
+        vertices[v] = normalizeInfluences(vertices[v], min_weight);
+
+        size_t after = getInfluenceCount(vertices[v]);
+        if (before > after)
+            counts.pruned_influences += before - after;
+        if (sum > 0.0f && (before > after || std::abs(sum - 1.0f) > 1e-5f))
+            ++counts.normalized_vertices;
+        ++counts.influence_histogram[after - 1];
+    }
+
+    if (stats != NULL)
+        *stats = counts;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a copy of a vertex with its influences sorted, and only
+///         the heaviest max_influences of them kept, their weights scaled
+///         up to make up for the ones dropped.
+///
+/// \details Dropped influences get a weight of 0 and joint 0, as they do in
+///         normalizeInfluences().  A vertex with no weight at all, or no more
+///         influences than the limit, keeps its weights as they are.
+///
+/// \param  vertex The vertex to limit.
+/// \param  max_influences The most influences to keep, from 1 to
+///         MAX_JOINT_INFLUENCES.
+template <typename VertexType>
+VertexType limitInfluences(const VertexType& vertex, size_t max_influences)
+{
+    assert(max_influences >= 1 && max_influences <= MAX_JOINT_INFLUENCES);
+    VertexType limited = sortInfluences(vertex);
+    if (limited.joint_weights[0] <= 0.0f)
+        return vertex;
+
+    float kept = 0.0f;
+    float total = 0.0f;
+    for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+    {
+        total += limited.joint_weights[i];
+        if (i < max_influences)
+            kept += limited.joint_weights[i];
+        else
+        {
+            limited.joint_indices[i] = 0;
+            limited.joint_weights[i] = 0.0f;
+        }
+    }
+
+    if (kept == total)
+        return limited;
+
+    // spreading the dropped weight over the kept influences in proportion
+    // to their own weights keeps their ratios, and the sum where it was.
+    for (size_t i = 0; i < max_influences; ++i)
+        limited.joint_weights[i] *= total / kept;
+
+    return limited;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Limits every vertex of a mesh to a number of influences with
+///         limitInfluences(), in place, so that its partitions can all be
+///         drawn with shaders which evaluate no more than that many.
+///
+/// \details This is for lower-end hardware drawing the same meshes as the
+///         rest: the vertices keep 4 influence slots, but a mesh limited
+///         to 2 only has partitions for 1 and 2 influences, and so only
+///         uses those shader permutations.  It should run after
+///         normalizeInfluences(), and before anything else reads the
+///         weights, or is saved from them.
+///
+/// \param  vertices The vertices to limit.
+/// \param  max_influences The most influences any vertex keeps, from 1 to
+///         MAX_JOINT_INFLUENCES.
+/// \param  stats If not NULL, receives what was changed.
+template <typename VertexType>
+void limitInfluences(std::vector<VertexType>& vertices, size_t max_influences, InfluenceLimitStats* stats)
+{
+    if (max_influences < 1 || max_influences > MAX_JOINT_INFLUENCES)
+    {
+        std::cerr << "Can't limit a mesh to " << max_influences << " influences per vertex; the limit must be 1 to "
+                  << MAX_JOINT_INFLUENCES << "." << std::endl;
+        throw std::runtime_error("Invalid influence limit!");
+    }
+
+    InfluenceLimitStats counts;
+    counts.limited_vertices = 0;
+    counts.dropped_influences = 0;
+    counts.max_dropped_weight = 0.0f;
+    counts.mean_dropped_weight = 0.0f;
+    counts.worst_vertex = 0;
+
+    double dropped_sum = 0.0;
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        VertexType sorted = sortInfluences(vertices[v]);
+        float dropped = 0.0f;
+        size_t dropped_influences = 0;
+        for (size_t i = max_influences; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            if (sorted.joint_weights[i] > 0.0f)
+            {
+                dropped += sorted.joint_weights[i];
+                ++dropped_influences;
+            }
+        }
+        if (dropped_influences == 0)
+            continue;
+
+        vertices[v] = limitInfluences(sorted, max_influences);
+
+        ++counts.limited_vertices;
+        counts.dropped_influences += dropped_influences;
+        dropped_sum += dropped;
+        if (dropped > counts.max_dropped_weight)
+        {
+            counts.max_dropped_weight = dropped;
+            counts.worst_vertex = v;
+        }
+    }
+
+    if (counts.limited_vertices > 0)
+        counts.mean_dropped_weight = float(dropped_sum / counts.limited_vertices);
+    if (stats != NULL)
+        *stats = counts;
+}
+
+template Vertex sortInfluences(const Vertex&);
+template Vertex3D sortInfluences(const Vertex3D&);
+template size_t getInfluenceCount(const Vertex&);
+template size_t getInfluenceCount(const Vertex3D&);
+template size_t getPartitionInfluenceCount(const Vertex&);
+template size_t getPartitionInfluenceCount(const Vertex3D&);
+template Vertex normalizeInfluences(const Vertex&, float);
+template Vertex3D normalizeInfluences(const Vertex3D&, float);
+template void normalizeInfluences(std::vector<Vertex>&, float, InfluenceStats*);
+template void normalizeInfluences(std::vector<Vertex3D>&, float, InfluenceStats*);
+template Vertex limitInfluences(const Vertex&, size_t);
+template Vertex3D limitInfluences(const Vertex3D&, size_t);
+template void limitInfluences(std::vector<Vertex>&, size_t, InfluenceLimitStats*);
+template void limitInfluences(std::vector<Vertex3D>&, size_t, InfluenceLimitStats*);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gives a flat 2D mesh the normals and tangents it would have if it
+///         were inflated into a rounded shape, so that lighting shows how it
+///         bends.
+///
+/// \details The vertices on the mesh's outline (the ends of edges which
+///         only belong to one triangle) lean 45 degrees out of the +z plane,
+///         away from the mesh, and their tangents follow the outline.  Every
+///         other vertex faces +z, with a tangent along +x.
+void computeOutlineNormals(std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+{
+    // count the triangles using each edge, and remember the outward
+    // direction of the edge of the last one.
+    typedef std::pair<GLuint, GLuint> Edge;
+    std::map<Edge, std::pair<size_t, vec2> > edges;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const vec2& a = vertices[indices[i]].position;
+        const vec2& b = vertices[indices[i + 1]].position;
+        const vec2& c = vertices[indices[i + 2]].position;
+        float winding = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) < 0.0f ? -1.0f : 1.0f;
+
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            GLuint u = indices[i + corner];
+            GLuint v = indices[i + (corner + 1) % 3];
+            vec2 direction = vertices[v].position - vertices[u].position;
+
+            std::pair<size_t, vec2>& edge = edges[Edge(std::min(u, v), std::max(u, v))];
+            ++edge.first;
+            edge.second = winding * vec2(direction.y, -direction.x);
+        }
+    }
+
+    // the outline directions are weighted by the edges' lengths.
+    std::vector<vec2> outward(vertices.size(), vec2(0));
+    for (std::map<Edge, std::pair<size_t, vec2> >::const_iterator it = edges.begin(); it != edges.end(); ++it)
+    {
+        if (it->second.first != 1)
+            continue;
+        outward[it->first.first] += it->second.second;
+        outward[it->first.second] += it->second.second;
+    }
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        Vertex& vertex = vertices[i];
+        if (glm::length(outward[i]) > 0.0f)
+        {
+            vec2 out = glm::normalize(outward[i]);
+            vertex.normal = glm::normalize(vec3(out, 1));
+            vertex.tangent = vec4(-out.y, out.x, 0, 1);
+        }
+        else
+        {
+            vertex.normal = vec3(0, 0, 1);
+            vertex.tangent = vec4(1, 0, 0, 1);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Renumbers a mesh's indices from 0, for meshes exported counting
+///         their vertices from some other number, like OBJ's 1.
+///
+/// \details Rebasing at import means no vertex has to be put in front of the
+///         mesh just to fill the indices nobody uses, and every mesh's first
+///         vertex is its first real one, so meshes sub-allocated from a
+///         shared buffer pack with nothing between them.
+///
+/// \param  indices The indices, which are replaced.
+/// \param  index_base The index of the first vertex.  Every index must be at
+///         least this.
+void rebaseIndices(std::vector<GLuint>& indices, GLuint index_base)
+{
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        if (indices[i] < index_base)
+        {
+            std::cerr << "Index " << i << " of a mesh is " << indices[i] << ", but its vertices start at "
+                      << index_base << "." << std::endl;
+            throw std::runtime_error("Mesh index below its index base!");
+        }
+        indices[i] -= index_base;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Renumbers the vertices of a morph target's deltas from 0, like
+///         rebaseIndices() does the mesh's indices.
+void rebaseIndices(std::vector<MorphDelta>& deltas, GLuint index_base)
+{
+    for (size_t i = 0; i < deltas.size(); ++i)
+    {
+        if (deltas[i].vertex < index_base)
+        {
+            std::cerr << "Delta " << i << " of a morph target moves vertex " << deltas[i].vertex
+                      << ", but the mesh's vertices start at " << index_base << "." << std::endl;
+            throw std::runtime_error("Mesh index below its index base!");
+        }
+        deltas[i].vertex -= index_base;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size in bytes of each vertex in a vertex format.
+size_t getVertexSize(VertexFormat format)
+{
+    switch (format)
+    {
+    case VERTEX_FORMAT_PACKED:          return sizeof(PackedVertex);
+    case VERTEX_FORMAT_PACKED_HALF:     return sizeof(HalfPackedVertex);
+    case VERTEX_FORMAT_FULL_3D:         return sizeof(Vertex3D);
+    case VERTEX_FORMAT_PACKED_3D:       return sizeof(PackedVertex3D);
+    case VERTEX_FORMAT_PACKED_HALF_3D:  return sizeof(HalfPackedVertex3D);
+    case VERTEX_FORMAT_QUANTIZED:       return sizeof(QuantizedVertex);
+    case VERTEX_FORMAT_QUANTIZED_3D:    return sizeof(QuantizedVertex3D);
+    default:                            return sizeof(Vertex);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of components of the positions in a vertex
+///         format; 2 or 3.
+size_t getPositionComponents(VertexFormat format)
+{
+    return getLayout(format) == format ? 2 : 3;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size in bytes of the leading fields of each vertex
+///         in a vertex format which skinning needs: the position, joint
+///         indices and joint weights, with any padding after them.
+///
+/// \details Every format puts those fields first, so a stream of just them
+///         is each vertex cut off at its normal.  The normal is always
+///         4-byte aligned, so the stream's vertices are too.
+size_t getSkinningVertexSize(VertexFormat format)
+{
+    switch (format)
+    {
+    case VERTEX_FORMAT_PACKED:          return offsetof(PackedVertex, normal);
+    case VERTEX_FORMAT_PACKED_HALF:     return offsetof(HalfPackedVertex, normal);
+    case VERTEX_FORMAT_FULL_3D:         return offsetof(Vertex3D, normal);
+    case VERTEX_FORMAT_PACKED_3D:       return offsetof(PackedVertex3D, normal);
+    case VERTEX_FORMAT_PACKED_HALF_3D:  return offsetof(HalfPackedVertex3D, normal);
+    case VERTEX_FORMAT_QUANTIZED:       return offsetof(QuantizedVertex, normal);
+    case VERTEX_FORMAT_QUANTIZED_3D:    return offsetof(QuantizedVertex3D, normal);
+    default:                            return offsetof(Vertex, normal);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Describes the attributes of a vertex format.
+///
+/// \param  format The format of the vertices.
+/// \param  attributes Receives the VERTEX_ATTRIBUTE_COUNT attributes, the
+///         SKINNING_VERTEX_ATTRIBUTE_COUNT that skinning needs first.
+void getVertexAttributes(VertexFormat format, VertexAttribute* attributes)
+{
+    switch (format)
+    {
+    case VERTEX_FORMAT_PACKED:          describeVertexType<PackedVertex>(attributes); break;
+    case VERTEX_FORMAT_PACKED_HALF:     describeVertexType<HalfPackedVertex>(attributes); break;
+    case VERTEX_FORMAT_FULL_3D:         describeVertexType<Vertex3D>(attributes); break;
+    case VERTEX_FORMAT_PACKED_3D:       describeVertexType<PackedVertex3D>(attributes); break;
+    case VERTEX_FORMAT_PACKED_HALF_3D:  describeVertexType<HalfPackedVertex3D>(attributes); break;
+    case VERTEX_FORMAT_QUANTIZED:       describeVertexType<QuantizedVertex>(attributes); break;
+    case VERTEX_FORMAT_QUANTIZED_3D:    describeVertexType<QuantizedVertex3D>(attributes); break;
+    default:                            describeVertexType<Vertex>(attributes); break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets up and enables the attribute pointers of the currently bound
+///         VAO for vertices in a vertex format, read from the buffer bound to
+///         GL_ARRAY_BUFFER.
+///
+/// \param  format The format of the vertices.
+/// \param  skinning_only Whether the buffer only holds the fields skinning
+///         needs (see getSkinningVertexSize()), in which case the normal and
+///         tangent attributes are left disabled.
+void setVertexAttributes(VertexFormat format, bool skinning_only)
+{
+    VertexAttribute attributes[VERTEX_ATTRIBUTE_COUNT];
+    getVertexAttributes(format, attributes);
+
+    GLsizei stride = GLsizei(skinning_only ? getSkinningVertexSize(format) : getVertexSize(format));
+    size_t count = skinning_only ? SKINNING_VERTEX_ATTRIBUTE_COUNT : VERTEX_ATTRIBUTE_COUNT;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const VertexAttribute& attribute = attributes[i];
+        void* offset = reinterpret_cast<void*>(attribute.offset);
+        if (attribute.integer)
+            glVertexAttribIPointer(attribute.location, attribute.components, attribute.type, stride, offset);
+        else
+            glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+                                  attribute.normalized, stride, offset);
+        glEnableVertexAttribArray(attribute.location);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Chooses the narrowest index type which can address every vertex
+///         of a mesh.
+///
+/// \details Narrower indices take less memory and bandwidth, so small meshes
+///         use GL_UNSIGNED_BYTE, and everything up to 65536 vertices uses
+///         GL_UNSIGNED_SHORT.  Primitive restart isn't used, so the largest
+///         value of each type is a valid index.
+///
+/// \param  vertex_count The number of vertices the indices refer to.
+/// \return GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+GLenum chooseIndexType(size_t vertex_count)
+{
+    if (vertex_count <= 0x100)
+        return GL_UNSIGNED_BYTE;
+    else if (vertex_count <= 0x10000)
+        return GL_UNSIGNED_SHORT;
+    else
+        return GL_UNSIGNED_INT;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size in bytes of each index of an index type.
+size_t getIndexSize(GLenum index_type)
+{
+    if (index_type == GL_UNSIGNED_BYTE)
+        return sizeof(GLubyte);
+    else if (index_type == GL_UNSIGNED_SHORT)
+        return sizeof(GLushort);
+    else
+        return sizeof(GLuint);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts indices to an index type, and stores their bytes in a
+///         buffer which can be uploaded to an IBO.
+///
+/// \param  indices The indices to convert.  Each must fit in index_type.
+/// \param  index_count The number of indices.
+/// \param  index_type GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or
+///         GL_UNSIGNED_INT.
+/// \param  index_data Receives the converted indices.
+void packIndices(const GLuint* indices, size_t index_count, GLenum index_type, std::vector<char>& index_data)
+{
+    if (index_type == GL_UNSIGNED_BYTE)
+        packIndicesAs<GLubyte>(indices, index_count, index_data);
+    else if (index_type == GL_UNSIGNED_SHORT)
+        packIndicesAs<GLushort>(indices, index_count, index_data);
+    else
+        packIndicesAs<GLuint>(indices, index_count, index_data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the bind-pose bounds of the vertices each joint influences.
+///
+/// \details Only influences with nonzero weights count, so a joint which
+///         influences no vertices gets an empty box.  See
+///         computeSkinnedBounds() for how the boxes bound the skinned mesh.
+///
+/// \param  format The layout of the vertex data.
+/// \param  vertex_data The vertices.
+/// \param  vertex_count The number of vertices.
+/// \param  joint_bounds Receives a box for each joint, up to the highest
+///         joint which influences any vertex.
+/// \param  quantization For the quantized formats, how the positions map
+///         to model space, which the boxes are in.  Ignored otherwise.
+void computeJointBounds(VertexFormat format, const void* vertex_data, size_t vertex_count,
+                        std::vector<BoundingBox>& joint_bounds, const PositionQuantization& quantization)
+{
+    PositionQuantization identity;
+    joint_bounds.clear();
+    switch (format)
+    {
+    case VERTEX_FORMAT_PACKED:
+        expandJointBounds<PackedVertex>(vertex_data, vertex_count, joint_bounds, identity);
+        break;
+    case VERTEX_FORMAT_PACKED_HALF:
+        expandJointBounds<HalfPackedVertex>(vertex_data, vertex_count, joint_bounds, identity);
+        break;
+    case VERTEX_FORMAT_FULL_3D:
+        expandJointBounds<Vertex3D>(vertex_data, vertex_count, joint_bounds, identity);
+        break;
+    case VERTEX_FORMAT_PACKED_3D:
+        expandJointBounds<PackedVertex3D>(vertex_data, vertex_count, joint_bounds, identity);
+        break;
+    case VERTEX_FORMAT_PACKED_HALF_3D:
+        expandJointBounds<HalfPackedVertex3D>(vertex_data, vertex_count, joint_bounds, identity);
+        break;
+    case VERTEX_FORMAT_QUANTIZED:
+        expandJointBounds<QuantizedVertex>(vertex_data, vertex_count, joint_bounds, quantization);
+        break;
+    case VERTEX_FORMAT_QUANTIZED_3D:
+        expandJointBounds<QuantizedVertex3D>(vertex_data, vertex_count, joint_bounds, quantization);
+        break;
+    default:
+        expandJointBounds<Vertex>(vertex_data, vertex_count, joint_bounds, identity);
+        break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs a new, empty skeletal mesh object.  No GL objects are
+///         created until the mesh is first uploaded, so this doesn't need a
+///         GL context.
+SkeletalMeshBase::SkeletalMeshBase()
+    : vertex_format(VERTEX_FORMAT_FULL),
+      vao_id(vao_id_),
+      vbo_id(vbo_id_),
+      ibo_id(ibo_id_),
+      morph_buffer_id(morph_buffer_id_),
+      deletion_queue_(nullptr),
+      vao_id_(0),
+      vbo_id_(0),
+      ibo_id_(0),
+      morph_buffer_id_(0),
+      vertex_count_(0),
+      index_count_(0),
+      index_type_(GL_UNSIGNED_SHORT),
+      vbo_size_(0),
+      ibo_size_(0),
+      dirty_vertices_begin_(0),
+      dirty_vertices_end_(0),
+      dirty_indices_begin_(0),
+      dirty_indices_end_(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the skeletal mesh, releasing the graphics buffers
+///         created when it was first uploaded.  A mesh which was never
+///         uploaded, or which has a deletion queue, can be destroyed
+///         without a GL context.
+SkeletalMeshBase::~SkeletalMeshBase()
+{
+    releaseBuffers();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Deletes the mesh's VAO and buffers, if it has any, leaving it
+///         as if it had never been uploaded, except that it remembers the
+///         layout of its last upload.
+///
+/// \details Anything attached to the VAO by other objects (such as
+///         RenderQueue::attachPaletteIndices()) has to be attached again
+///         after the mesh is next uploaded.  The morph targets' deltas are
+///         kept, and uploaded again with the mesh by uploadMesh().
+///
+///         With a deletion queue, the objects are only queued, and the ids
+///         read 0 straight away, as if they'd been deleted.
+void SkeletalMeshBase::releaseBuffers()
+{
+    if (vao_id_ == 0)
+        return;
+
+    if (deletion_queue_ != nullptr)
+    {
+        deletion_queue_->deleteVertexArray(vao_id_);
+        deletion_queue_->deleteBuffer(vbo_id_);
+        deletion_queue_->deleteBuffer(ibo_id_);
+        deletion_queue_->deleteBuffer(morph_buffer_id_);
+    }
+    else
+    {
+        glDeleteVertexArrays(1, &vao_id_);  // Delete VAO
+        glDeleteBuffers(1, &vbo_id_);       // Delete VBO
+        glDeleteBuffers(1, &ibo_id_);       // Delete IBO
+        if (morph_buffer_id_ != 0)
+            glDeleteBuffers(1, &morph_buffer_id_);
+    }
+
+    vao_id_ = 0;
+    vbo_id_ = 0;
+    ibo_id_ = 0;
+    morph_buffer_id_ = 0;
+    vbo_size_ = 0;
+    ibo_size_ = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the queue the mesh's GL objects are handed to when they're
+///         released or the mesh is destroyed, or null to delete them
+///         straight away, which needs the GL context to be current.
+void SkeletalMeshBase::setDeletionQueue(GLDeletionQueue* queue)
+{
+    deletion_queue_ = queue;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Swaps everything but the public id references with another
+///         mesh, including the GL objects and the deletion queue they're
+///         released to.
+void SkeletalMeshBase::swapBase(SkeletalMeshBase& other)
+{
+    std::swap(vertex_format, other.vertex_format);
+    std::swap(position_quantization, other.position_quantization);
+    std::swap(deletion_queue_, other.deletion_queue_);
+    std::swap(vao_id_, other.vao_id_);
+    std::swap(vbo_id_, other.vbo_id_);
+    std::swap(ibo_id_, other.ibo_id_);
+    std::swap(morph_buffer_id_, other.morph_buffer_id_);
+    std::swap(vertex_count_, other.vertex_count_);
+    std::swap(index_count_, other.index_count_);
+    std::swap(index_type_, other.index_type_);
+    partitions_.swap(other.partitions_);
+    joint_bounds_.swap(other.joint_bounds_);
+    morph_targets_.swap(other.morph_targets_);
+    morph_deltas_.swap(other.morph_deltas_);
+    std::swap(vbo_size_, other.vbo_size_);
+    std::swap(ibo_size_, other.ibo_size_);
+    remap_.vertices.swap(other.remap_.vertices);
+    remap_.triangles.swap(other.remap_.triangles);
+    std::swap(dirty_vertices_begin_, other.dirty_vertices_begin_);
+    std::swap(dirty_vertices_end_, other.dirty_vertices_end_);
+    std::swap(dirty_indices_begin_, other.dirty_indices_begin_);
+    std::swap(dirty_indices_end_, other.dirty_indices_end_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the VAO, VBO and IBO in the current OpenGL context, if
+///         they haven't been created already.
+void SkeletalMeshBase::createBuffers()
+{
+    if (vao_id_ != 0)
+        return;
+
+    glGenVertexArrays(1, &vao_id_);     // Create VAO
+    glGenBuffers(1, &vbo_id_);          // Create VBO
+    glGenBuffers(1, &ibo_id_);          // Create IBO
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs a new, empty skeletal mesh.
+template <typename VertexType>
+BasicSkeletalMesh<VertexType>::BasicSkeletalMesh()
+    : cpu_data_policy_(CPU_DATA_KEEP),
+      compressed_vertex_count_(0),
+      compressed_index_count_(0),
+      prepared_(false),
+      prepared_vertex_count_(0),
+      prepared_index_count_(0),
+      prepared_index_type_(GL_UNSIGNED_SHORT)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs a mesh which takes over vertices and indices built
+///         elsewhere, without copying them.  Nothing is uploaded yet.
+///
+/// \param  vertices The vertices, left empty.
+/// \param  indices The indices of the triangles, left empty.
+template <typename VertexType>
+BasicSkeletalMesh<VertexType>::BasicSkeletalMesh(std::vector<VertexType>&& vertices, std::vector<GLuint>&& indices)
+    : cpu_data_policy_(CPU_DATA_KEEP),
+      compressed_vertex_count_(0),
+      compressed_index_count_(0),
+      prepared_(false),
+      prepared_vertex_count_(0),
+      prepared_index_count_(0),
+      prepared_index_type_(GL_UNSIGNED_SHORT)
+{
+    this->vertices.swap(vertices);
+    this->indices.swap(indices);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs a mesh from vertices and indices stored anywhere,
+///         copying each of them once.  Nothing is uploaded yet.
+template <typename VertexType>
+BasicSkeletalMesh<VertexType>::BasicSkeletalMesh(const VertexType* vertices, size_t vertex_count,
+                                                 const GLuint* indices, size_t index_count)
+    : vertices(vertices, vertices + vertex_count),
+      indices(indices, indices + index_count),
+      cpu_data_policy_(CPU_DATA_KEEP),
+      compressed_vertex_count_(0),
+      compressed_index_count_(0),
+      prepared_(false),
+      prepared_vertex_count_(0),
+      prepared_index_count_(0),
+      prepared_index_type_(GL_UNSIGNED_SHORT)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes over another mesh's GL objects and data, leaving it as if
+///         it had just been constructed.
+template <typename VertexType>
+BasicSkeletalMesh<VertexType>::BasicSkeletalMesh(BasicSkeletalMesh&& other)
+    : cpu_data_policy_(CPU_DATA_KEEP),
+      compressed_vertex_count_(0),
+      compressed_index_count_(0),
+      prepared_(false),
+      prepared_vertex_count_(0),
+      prepared_index_count_(0),
+      prepared_index_type_(GL_UNSIGNED_SHORT)
+{
+    swap(other);
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  Constructs a new skeletal mesh object, allocating a new VAO,
-///         VBO, and IBO in the current OpenGL context.
-SkeletalMesh::SkeletalMesh()
-    : vao_id(vao_id_),
-      vbo_id(vbo_id_),
-      ibo_id(ibo_id_)
+/// \brief  Takes over another mesh's GL objects and data.  This mesh's own
+///         are handed to the other, and released when it's destroyed.
+template <typename VertexType>
+BasicSkeletalMesh<VertexType>& BasicSkeletalMesh<VertexType>::operator=(BasicSkeletalMesh&& other)
 {
-    glGenVertexArrays(1, &vao_id_);     // Create VAO
-    glGenBuffers(1, &vbo_id_);          // Create VBO
-    glGenBuffers(1, &ibo_id_);          // Create IBO
+    swap(other);
+    return *this;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief  Destroys the skeletal mesh, releasing the graphics buffers
-///         created in the constructor.
-SkeletalMesh::~SkeletalMesh()
+/// \brief  Swaps everything, GL objects included, with another mesh.
+///         Anything attached to either VAO by other objects goes with it.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::swap(BasicSkeletalMesh& other)
 {
-    glDeleteBuffers(1, &vao_id_);       // Delete VAO
-    glDeleteBuffers(1, &vbo_id_);       // Delete VBO
-    glDeleteBuffers(1, &ibo_id_);       // Delete IBO
+    swapBase(other);
+    vertices.swap(other.vertices);
+    indices.swap(other.indices);
+    std::swap(cpu_data_policy_, other.cpu_data_policy_);
+    std::swap(compressed_vertex_count_, other.compressed_vertex_count_);
+    std::swap(compressed_index_count_, other.compressed_index_count_);
+    compressed_vertices_.swap(other.compressed_vertices_);
+    compressed_indices_.swap(other.compressed_indices_);
+    std::swap(prepared_, other.prepared_);
+    std::swap(prepared_vertex_count_, other.prepared_vertex_count_);
+    std::swap(prepared_index_count_, other.prepared_index_count_);
+    prepared_vertex_data_.swap(other.prepared_vertex_data_);
+    std::swap(prepared_quantization_, other.prepared_quantization_);
+    std::swap(prepared_index_type_, other.prepared_index_type_);
+    prepared_index_data_.swap(other.prepared_index_data_);
+    prepared_partitions_.swap(other.prepared_partitions_);
+    prepared_remap_.vertices.swap(other.prepared_remap_.vertices);
+    prepared_remap_.triangles.swap(other.prepared_remap_.triangles);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Uploads the vertex and index data in the public indices and
-///         vertices fields to the graphics buffers created in the constructor.
+///         vertices fields to the mesh's graphics buffers.
+///
+/// \details The same as prepareMesh() followed by uploadPrepared().
+///
+/// \param  stats If not NULL, receives the ACMR of the indices before and
+///         after they were reordered for the vertex cache.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::uploadMesh(MeshOptimizationStats* stats)
+{
+    prepareMesh(stats);
+    uploadPrepared();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts the public indices and vertices fields into the data
+///         uploadPrepared() will upload, with buildMeshUploadData().  This
+///         doesn't need a GL context.
+///
+/// \details Anything prepared before and not uploaded yet is replaced.
+///
+/// \param  stats If not NULL, receives the ACMR of the indices before and
+///         after they were reordered for the vertex cache.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::prepareMesh(MeshOptimizationStats* stats)
+{
+    buildMeshUploadData(vertices, indices, vertex_format, prepared_vertex_data_, prepared_index_type_,
+                        prepared_index_data_, prepared_partitions_, stats, &prepared_remap_, &prepared_quantization_);
+    prepared_vertex_count_ = vertices.size();
+    prepared_index_count_ = indices.size();
+    prepared_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if prepareMesh() has been called since the last
+///         upload.
+template <typename VertexType>
+bool BasicSkeletalMesh<VertexType>::isPrepared() const
+{
+    return prepared_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads the data prepared by prepareMesh() with uploadData(),
+///         creating the mesh's GL objects if this is its first upload, and
+///         then frees the prepared copy.  The vertices and indices are then
+///         kept, released or compressed, depending on the CPU data policy.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::uploadPrepared()
+{
+    assert(prepared_);
+
+    position_quantization = prepared_quantization_;
+    uploadData(vertex_format, prepared_vertex_data_.data(), prepared_vertex_count_,
+               prepared_index_type_, prepared_index_data_.data(), prepared_index_count_, prepared_partitions_);
+
+    // uploadData() forgets the remap, since it can't know where its data came from.
+    remap_.vertices.swap(prepared_remap_.vertices);
+    remap_.triangles.swap(prepared_remap_.triangles);
+
+    // the vertices may have been reordered differently this time.
+    if (!morph_targets_.empty())
+        uploadMorphTargets();
+
+    std::vector<char>().swap(prepared_vertex_data_);
+    std::vector<char>().swap(prepared_index_data_);
+    prepared_partitions_.clear();
+    prepared_remap_.vertices.clear();
+    prepared_remap_.triangles.clear();
+    prepared_ = false;
+
+    applyCpuDataPolicy();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks a range of the vertices field as edited, so that the next
+///         call to updateMesh() uploads it.
+///
+/// \details Only a single range is tracked; marking several ranges marks
+///         everything from the first to the last.
+///
+/// \param  first The index of the first edited vertex.
+/// \param  count The number of edited vertices.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::markVerticesDirty(size_t first, size_t count)
+{
+    assert(first + count <= vertices.size());
+    if (count == 0)
+        return;
+
+    if (dirty_vertices_begin_ == dirty_vertices_end_)
+    {
+        dirty_vertices_begin_ = first;
+        dirty_vertices_end_ = first + count;
+    }
+    else
+    {
+        dirty_vertices_begin_ = std::min(dirty_vertices_begin_, first);
+        dirty_vertices_end_ = std::max(dirty_vertices_end_, first + count);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks a range of the indices field as edited, so that the next
+///         call to updateMesh() uploads the triangles it overlaps.
+///
+/// \details As with markVerticesDirty(), only a single range is tracked.
+///
+/// \param  first The first edited index.
+/// \param  count The number of edited indices.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::markIndicesDirty(size_t first, size_t count)
+{
+    assert(first + count <= indices.size());
+    if (count == 0)
+        return;
+
+    if (dirty_indices_begin_ == dirty_indices_end_)
+    {
+        dirty_indices_begin_ = first;
+        dirty_indices_end_ = first + count;
+    }
+    else
+    {
+        dirty_indices_begin_ = std::min(dirty_indices_begin_, first);
+        dirty_indices_end_ = std::max(dirty_indices_end_, first + count);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads the vertices and indices marked with markVerticesDirty()
+///         and markIndicesDirty().
+///
+/// \details If the edits can be applied without changing the partitioning,
+///         just the edited vertices and triangles are written to the
+///         buffers with glBufferSubData.  Edited triangles keep their place
+///         in the uploaded order, so heavy index edits may undo some of the
+///         vertex cache optimization until the next uploadMesh().  Otherwise,
+///         including when vertices or indices were added or removed, the
+///         whole mesh is uploaded again with uploadMesh().
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::updateMesh()
+{
+    if (dirty_vertices_begin_ == dirty_vertices_end_ && dirty_indices_begin_ == dirty_indices_end_)
+        return;
+
+    if (!canUpdateInPlace())
+    {
+        uploadMesh();
+        return;
+    }
+
+    if (dirty_vertices_begin_ != dirty_vertices_end_)
+        computeJointBounds(VertexLayout<VertexType>::fullFormat(), vertices.data(), vertices.size(), joint_bounds_);
+
+    updateVertices();
+    updateIndices();
+    clearDirtySpans();
+    applyCpuDataPolicy();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees the vertices and indices kept on the CPU, and anything
+///         prepared but not uploaded, once the mesh no longer needs them.
+///
+/// \details The buffers, layout, partitions and joint bounds are all kept,
+///         so the mesh can still be drawn, culled and copied, and morph
+///         targets can still be added.  It can't be edited or uploaded
+///         again with uploadMesh(), though, and if it's evicted (see
+///         ResidencyManager), only uploadData() can restore it, unless the
+///         policy is CPU_DATA_COMPRESS: the compressed copy is kept, so
+///         restoreCpuData() can bring them back.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::releaseCpuData()
+{
+    std::vector<VertexType>().swap(vertices);
+    std::vector<GLuint>().swap(indices);
+    std::vector<char>().swap(prepared_vertex_data_);
+    std::vector<char>().swap(prepared_index_data_);
+    prepared_partitions_.clear();
+    prepared_remap_.vertices.clear();
+    prepared_remap_.triangles.clear();
+    prepared_ = false;
+    std::vector<GLuint>().swap(remap_.triangles);  // only index edits need it; the morph targets need the vertices'
+    clearDirtySpans();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets what the next upload does with the vertices and indices.
+///
+/// \details Nothing already uploaded changes, except that switching away
+///         from CPU_DATA_COMPRESS frees the compressed copy.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::setCpuDataPolicy(CpuDataPolicy policy)
+{
+    cpu_data_policy_ = policy;
+    if (policy != CPU_DATA_COMPRESS)
+    {
+        std::vector<char>().swap(compressed_vertices_);
+        std::vector<char>().swap(compressed_indices_);
+        compressed_vertex_count_ = 0;
+        compressed_index_count_ = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns what uploads do with the vertices and indices.
+template <typename VertexType>
+typename BasicSkeletalMesh<VertexType>::CpuDataPolicy BasicSkeletalMesh<VertexType>::getCpuDataPolicy() const
+{
+    return cpu_data_policy_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if the vertices and indices fields hold any data.
+template <typename VertexType>
+bool BasicSkeletalMesh<VertexType>::hasCpuData() const
+{
+    return !vertices.empty() || !indices.empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decompresses the copy kept by CPU_DATA_COMPRESS back into the
+///         vertices and indices fields, if they were released.
+///
+/// \details The compressed copy is kept, so releaseCpuData() can free them
+///         again once they've been used.  Uploading them again, or editing
+///         them and calling updateMesh(), compresses them again.
+///
+/// \return false if there's nothing to restore them from: they were
+///         discarded, or never set.
+template <typename VertexType>
+bool BasicSkeletalMesh<VertexType>::restoreCpuData()
+{
+    if (hasCpuData())
+        return true;
+
+    if (compressed_vertex_count_ == 0 && compressed_index_count_ == 0)
+        return false;
+
+    vertices.resize(compressed_vertex_count_);
+    indices.resize(compressed_index_count_);
+    decompressBytes(compressed_vertices_, sizeof(VertexType), vertices.data(), vertices.size() * sizeof(VertexType));
+    if (!decodeIndices(compressed_indices_.data(), compressed_indices_.size(), indices.size(), GL_UNSIGNED_INT,
+                       indices.data()))
+    {
+        std::cerr << "A mesh's compressed indices are corrupt!" << std::endl;
+        throw std::runtime_error("A mesh's compressed indices are corrupt!");
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the CPU memory held by the vertices, the indices, the
+///         compressed copy and anything prepared but not uploaded, in
+///         bytes.
+template <typename VertexType>
+size_t BasicSkeletalMesh<VertexType>::getCpuDataBytes() const
+{
+    return vertices.capacity() * sizeof(VertexType) + indices.capacity() * sizeof(GLuint) +
+           compressed_vertices_.capacity() + compressed_indices_.capacity() +
+           prepared_vertex_data_.capacity() + prepared_index_data_.capacity();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Keeps, releases or compresses the vertices and indices after an
+///         upload, depending on the policy.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::applyCpuDataPolicy()
+{
+    if (cpu_data_policy_ == CPU_DATA_KEEP)
+        return;
+
+    if (cpu_data_policy_ == CPU_DATA_COMPRESS)
+    {
+        compressBytes(vertices.data(), vertices.size() * sizeof(VertexType), sizeof(VertexType), compressed_vertices_);
+        encodeIndices(indices.data(), indices.size(), GL_UNSIGNED_INT, compressed_indices_);
+        std::vector<char>(compressed_vertices_).swap(compressed_vertices_);     // trim the reserve()d slack
+        std::vector<char>(compressed_indices_).swap(compressed_indices_);
+        compressed_vertex_count_ = vertices.size();
+        compressed_index_count_ = indices.size();
+    }
+
+    releaseCpuData();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads every morph target's deltas to morph_buffer_id, with
+///         their vertices translated to where they ended up in the VBO.
+void SkeletalMeshBase::uploadMorphTargets()
+{
+    std::vector<MorphDelta> uploaded(morph_deltas_);
+    if (!remap_.vertices.empty())
+    {
+        for (size_t i = 0; i < uploaded.size(); ++i)
+            uploaded[i].vertex = remap_.vertices[uploaded[i].vertex];
+    }
+
+    if (morph_buffer_id_ == 0)
+        glGenBuffers(1, &morph_buffer_id_);
+
+    // an empty buffer can't be bound as shader storage, so there's always
+    // room for at least one delta.
+    glBindBuffer(GL_ARRAY_BUFFER, morph_buffer_id_);
+    glBufferData(GL_ARRAY_BUFFER, std::max(uploaded.size(), size_t(1)) * sizeof(MorphDelta),
+                 uploaded.empty() ? nullptr : uploaded.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Converts vertices and indices into the exact bytes that
+///         SkeletalMesh::uploadMesh() uploads.
+///
+/// \details The vertices are converted to vertex_format, with their
+///         influences sorted by weight, and both the vertices and the
+///         triangles are reordered so that each partition is contiguous.
+///         The triangles of each partition are also reordered for the
+///         post-transform vertex cache (see optimizeTriangleOrder()), and the
+///         vertices by when they are first used.  The indices are narrowed
+///         to the type chosen by chooseIndexType().  This doesn't need a GL
+///         context, so tools can use it to prepare mesh files offline.
+///
+/// \param  vertices The vertices of the mesh.
+/// \param  indices The indices of the mesh's triangles.
+/// \param  vertex_format The layout to convert the vertices to, which must
+///         have VertexType's dimension.
+/// \param  vertex_data Receives the vertices, in vertex_format.
+/// \param  index_type Receives the type of the indices in index_data.
+/// \param  index_data Receives the reordered and remapped indices.
+/// \param  partitions Receives the partitions of vertex_data and
+///         index_data.
+/// \param  stats If not NULL, receives the ACMR of the indices before and
+///         after they were reordered.
+/// \param  remap If not NULL, receives where each vertex and triangle was
+///         moved to.
+/// \param  quantization If not NULL, receives how the positions in
+///         vertex_data map to model space: for the quantized formats, the
+///         one choosePositionQuantization() picked, and otherwise the
+///         identity.
+template <typename VertexType>
+void buildMeshUploadData(const std::vector<VertexType>& vertices,
+                         const std::vector<GLuint>& indices,
+                         VertexFormat vertex_format,
+                         std::vector<char>& vertex_data,
+                         GLenum& index_type,
+                         std::vector<char>& index_data,
+                         std::vector<SkeletalMeshBase::Partition>& partitions,
+                         MeshOptimizationStats* stats,
+                         MeshUploadRemap* remap,
+                         PositionQuantization* quantization)
+{
+    if (getPositionComponents(vertex_format) != VertexLayout<VertexType>::POSITION_COMPONENTS)
+    {
+        std::cerr << "Vertex format " << vertex_format << " has " << getPositionComponents(vertex_format)
+                  << "D positions, but the vertices are " << VertexLayout<VertexType>::POSITION_COMPONENTS
+                  << "D." << std::endl;
+        throw std::runtime_error("A mesh's vertex format must match its vertices' dimensions.");
+    }
+
+    std::vector<size_t> influence_counts;
+    influence_counts.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+        influence_counts.push_back(getPartitionInfluenceCount(vertices[i]));
+
+    // a triangle needs as many influences as its most influenced vertex.
+    // Each partition's triangles are reordered for the vertex cache on their
+    // own, since the partitions have to stay contiguous.
+    std::vector<GLuint> sorted_indices;
+    std::vector<GLuint> source_triangles;   // the original triangle of each sorted triangle
+    std::vector<GLuint> triangle_order;
+    sorted_indices.reserve(indices.size());
+    source_triangles.reserve(indices.size() / 3);
+
+    size_t first_indices[MAX_JOINT_INFLUENCES + 1];
+    for (size_t count = 1; count <= MAX_JOINT_INFLUENCES; ++count)
+    {
+        first_indices[count - 1] = sorted_indices.size();
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            size_t triangle_count = std::max(influence_counts[indices[i]],
+                                    std::max(influence_counts[indices[i + 1]],
+                                             influence_counts[indices[i + 2]]));
+            if (triangle_count != count)
+                continue;
+
+            sorted_indices.push_back(indices[i]);
+            sorted_indices.push_back(indices[i + 1]);
+            sorted_indices.push_back(indices[i + 2]);
+            source_triangles.push_back(GLuint(i / 3));
+        }
+
+        size_t first_index = first_indices[count - 1];
+        if (sorted_indices.size() > first_index)
+        {
+            size_t first_triangle = first_index / 3;
+            triangle_order.resize(source_triangles.size() - first_triangle);
+            optimizeTriangleOrder(&sorted_indices[first_index], sorted_indices.size() - first_index,
+                                  vertices.size(), triangle_order.data());
+
+            std::vector<GLuint> unordered(source_triangles.begin() + first_triangle, source_triangles.end());
+            for (size_t i = 0; i < triangle_order.size(); ++i)
+                source_triangles[first_triangle + i] = unordered[triangle_order[i]];
+        }
+    }
+    first_indices[MAX_JOINT_INFLUENCES] = sorted_indices.size();
+
+    // the vertices are reordered by their influence counts too, so that each
+    // partition's vertices can be skinned on their own (see SkinnedVertexCache).
+    // Within each partition they are ordered by when the triangles first use
+    // them, so that vertex fetches walk through the buffer in order.
+    std::vector<VertexType> sorted_vertices;
+    std::vector<GLuint> new_vertex_index(vertices.size());
+    std::vector<bool> placed(vertices.size(), false);
+    sorted_vertices.reserve(vertices.size());
+
+    partitions.clear();
+    for (size_t count = 1; count <= MAX_JOINT_INFLUENCES; ++count)
+    {
+        size_t first_vertex = sorted_vertices.size();
+        for (size_t i = 0; i < sorted_indices.size(); ++i)
+        {
+            GLuint v = sorted_indices[i];
+            if (influence_counts[v] != count || placed[v])
+                continue;
+
+            new_vertex_index[v] = GLuint(sorted_vertices.size());
+            sorted_vertices.push_back(sortInfluences(vertices[v]));
+            placed[v] = true;
+        }
+
+        // vertices which no triangle uses go at the end.
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            if (influence_counts[i] != count || placed[i])
+                continue;
+
+            new_vertex_index[i] = GLuint(sorted_vertices.size());
+            sorted_vertices.push_back(sortInfluences(vertices[i]));
+            placed[i] = true;
+        }
+
+        size_t first_index = first_indices[count - 1];
+        size_t index_count = first_indices[count] - first_index;
+        if (sorted_vertices.size() > first_vertex || index_count > 0)
+        {
+            SkeletalMeshBase::Partition partition;
+            partition.influence_count = count;
+            partition.index_count = GLsizei(index_count);
+            partition.first_index = first_index;
+            partition.vertex_count = GLsizei(sorted_vertices.size() - first_vertex);
+            partition.first_vertex = first_vertex;
+            partitions.push_back(partition);
+        }
+    }
+
+    for (size_t i = 0; i < sorted_indices.size(); ++i)
+        sorted_indices[i] = new_vertex_index[sorted_indices[i]];
+
+    if (stats)
+    {
+        stats->acmr_before = computeACMR(indices.data(), indices.size());
+        stats->acmr_after = computeACMR(sorted_indices.data(), sorted_indices.size());
+    }
+
+    index_type = chooseIndexType(sorted_vertices.size());
+    packIndices(sorted_indices.data(), sorted_indices.size(), index_type, index_data);
+
+    if (remap)
+    {
+        remap->vertices = new_vertex_index;
+        remap->triangles.assign(indices.size() / 3, 0);
+        for (size_t i = 0; i < source_triangles.size(); ++i)
+            remap->triangles[source_triangles[i]] = GLuint(i);
+    }
+
+    typedef typename VertexLayout<VertexType>::Packed PackedVertexType;
+    typedef typename VertexLayout<VertexType>::HalfPacked HalfPackedVertexType;
+    typedef typename VertexLayout<VertexType>::Quantized QuantizedVertexType;
+    PositionQuantization chosen;
+    if (getLayout(vertex_format) == VERTEX_FORMAT_QUANTIZED)
+    {
+        chosen = choosePositionQuantization(vertices);
+        vertex_data.resize(sorted_vertices.size() * sizeof(QuantizedVertexType));
+        for (size_t i = 0; i < sorted_vertices.size(); ++i)
+        {
+            QuantizedVertexType packed = packVertexQuantized(sorted_vertices[i], chosen);
+            std::memcpy(&vertex_data[i * sizeof(QuantizedVertexType)], &packed, sizeof(QuantizedVertexType));
+        }
+    }
+    else if (getLayout(vertex_format) == VERTEX_FORMAT_PACKED)
+        packVertices<VertexType, PackedVertexType>(sorted_vertices, packVertex, vertex_data);
+    else if (getLayout(vertex_format) == VERTEX_FORMAT_PACKED_HALF)
+        packVertices<VertexType, HalfPackedVertexType>(sorted_vertices, packVertexHalf, vertex_data);
+    else
+    {
+        vertex_data.resize(sorted_vertices.size() * sizeof(VertexType));
+        if (!sorted_vertices.empty())
+            std::memcpy(&vertex_data[0], sorted_vertices.data(), vertex_data.size());
+    }
+
+    if (quantization)
+        *quantization = chosen;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Uploads vertices and indices which have already been prepared in
+///         the layout produced by buildMeshUploadData(), such as the contents of
+///         a mesh file, straight to the graphics buffers.
 ///
 /// \details In addition to uploading data, it ensures that the VAO vertex
-///         attribute pointers are setup and enabled.
-void SkeletalMesh::uploadMesh() const
+///         attribute pointers are setup and enabled.  The public vertices
+///         and indices fields aren't used or changed, so updateMesh() can't
+///         apply edits to them in place until the next uploadMesh().  The
+///         existing buffers are reused if the data fits in them.  If this is
+///         the mesh's first upload, its VAO and buffers are created first.
+///
+/// \param  format The layout of the vertex data.  vertex_format is set to it.
+///         If it's a quantized format, position_quantization must already
+///         be set to the data's quantization.
+/// \param  vertex_data The vertices, in the given format.
+/// \param  vertex_count The number of vertices.
+/// \param  index_type The type of each index; GL_UNSIGNED_BYTE,
+///         GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+/// \param  index_data The indices, reordered into partitions.
+/// \param  index_count The number of indices.
+/// \param  partitions The partitions of the vertices and indices.
+void SkeletalMeshBase::uploadData(VertexFormat format,
+                              const void* vertex_data, size_t vertex_count,
+                              GLenum index_type, const void* index_data, size_t index_count,
+                              const std::vector<Partition>& partitions)
+{
+    setLayout(format, vertex_count, index_type, index_count, partitions);
+    computeJointBounds(format, vertex_data, vertex_count, joint_bounds_, position_quantization);
+
+    glBindVertexArray(vao_id);  // bind VAO
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id);  // bind VBO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_id);  // bind IBO
+
+    uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_size_, index_count * ::getIndexSize(index_type), index_data);
+    uploadBuffer(GL_ARRAY_BUFFER, vbo_size_, vertex_count * getVertexSize(format), vertex_data);
+
+    setVertexAttributes(format);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(0);   // un-bind VAO
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Sets the mesh up exactly as uploadData() would, but only sizes
+///         its buffers, leaving their contents to be filled in separately
+///         (see MeshUploadQueue).
+///
+/// \details The mesh mustn't be drawn until its buffers have been filled.
+///         The parameters are the same as uploadData()'s, except that there
+///         are no indices; the vertices are only read to find the joint
+///         bounds.
+void SkeletalMeshBase::reserveData(VertexFormat format,
+                                   const void* vertex_data, size_t vertex_count,
+                                   GLenum index_type, size_t index_count,
+                                   const std::vector<Partition>& partitions)
+{
+    reserveStorage(format, vertex_count, index_type, index_count, partitions);
+    computeJointBounds(format, vertex_data, vertex_count, joint_bounds_, position_quantization);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Makes the mesh a copy of another uploaded mesh, copying the
+///         other mesh's buffers on the GPU with glCopyBufferSubData rather
+///         than uploading anything.
+///
+/// \details As with uploadData(), the vertices and indices fields aren't
+///         used or changed, and the morph targets are kept.
+///
+/// \param  source The mesh to copy; it must have been uploaded.
+void SkeletalMeshBase::copyData(const SkeletalMeshBase& source)
+{
+    assert(source.isResident());
+    reserveStorage(source.vertex_format, source.vertex_count_, source.index_type_, source.index_count_,
+                   source.partitions_);
+    position_quantization = source.position_quantization;
+    joint_bounds_ = source.joint_bounds_;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, source.vbo_id_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_id_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        vertex_count_ * getVertexSize(vertex_format));
+
+    glBindBuffer(GL_COPY_READ_BUFFER, source.ibo_id_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_id_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, index_count_ * getIndexSize());
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records a new layout for the mesh, and creates or resizes its
+///         buffers to fit it, leaving their contents undefined.
+void SkeletalMeshBase::reserveStorage(VertexFormat format, size_t vertex_count, GLenum index_type, size_t index_count,
+                                      const std::vector<Partition>& partitions)
 {
+    setLayout(format, vertex_count, index_type, index_count, partitions);
+
     glBindVertexArray(vao_id);  // bind VAO
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo_id);  // bind VBO
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_id);  // bind IBO
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
-
-    Vertex va[2];
-
-    void* attr_ptr_position      = nullptr;
-    void* attr_ptr_bone_index_0  = (void*)((char*)(&va[0].joint_indices[0]) - (char*)(&va[0]));
-    void* attr_ptr_bone_index_1  = (void*)((char*)(&va[0].joint_indices[1]) - (char*)(&va[0]));///reinterpret_cast<void*>(sizeof(vec2) + sizeof(GLuint));
-    void* attr_ptr_bone_index_2  = (void*)((char*)(&va[0].joint_indices[2]) - (char*)(&va[0]));//reinterpret_cast<void*>(sizeof(vec2) + sizeof(GLuint) * 2);
-    void* attr_ptr_bone_weight_0 = (void*)((char*)(&va[0].joint_weights[0]) - (char*)(&va[0]));//reinterpret_cast<void*>(sizeof(vec2) + sizeof(GLuint) * 3);
-    void* attr_ptr_bone_weight_1 = (void*)((char*)(&va[0].joint_weights[1]) - (char*)(&va[0]));//reinterpret_cast<void*>(sizeof(vec2) + sizeof(GLuint) * 3 + sizeof(GLfloat));
-    void* attr_ptr_bone_weight_2 = (void*)((char*)(&va[0].joint_weights[2]) - (char*)(&va[0]));//reinterpret_cast<void*>(sizeof(vec2) + sizeof(GLuint) * 3 + sizeof(GLfloat) * 2);
-    glVertexAttribPointer(0, 2, GL_FLOAT,        GL_FALSE, sizeof(Vertex), attr_ptr_position);
-    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(Vertex), attr_ptr_bone_index_0);
-    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(Vertex), attr_ptr_bone_index_1);
-    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(Vertex), attr_ptr_bone_index_2);
-    glVertexAttribPointer(4, 1, GL_FLOAT,        GL_FALSE, sizeof(Vertex), attr_ptr_bone_weight_0);
-    glVertexAttribPointer(5, 1, GL_FLOAT,        GL_FALSE, sizeof(Vertex), attr_ptr_bone_weight_1);
-    glVertexAttribPointer(6, 1, GL_FLOAT,        GL_FALSE, sizeof(Vertex), attr_ptr_bone_weight_2);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-    glEnableVertexAttribArray(3);
-    glEnableVertexAttribArray(4);
-    glEnableVertexAttribArray(5);
-    glEnableVertexAttribArray(6);
+    reserveBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_size_, index_count * ::getIndexSize(index_type));
+    reserveBuffer(GL_ARRAY_BUFFER, vbo_size_, vertex_count * getVertexSize(format));
+
+    setVertexAttributes(format);
 
     // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     glBindVertexArray(0);   // un-bind VAO
 }
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records the layout of the data about to be put in the buffers,
+///         forgets any edits and remap from the last upload, and creates the
+///         buffers if this is the first upload.
+void SkeletalMeshBase::setLayout(VertexFormat format, size_t vertex_count, GLenum index_type, size_t index_count,
+                                 const std::vector<Partition>& partitions)
+{
+    vertex_format = format;
+    vertex_count_ = vertex_count;
+    index_count_ = index_count;
+    index_type_ = index_type;
+    partitions_ = partitions;
+    remap_.vertices.clear();
+    remap_.triangles.clear();
+    clearDirtySpans();
+    createBuffers();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true once the mesh has been uploaded, and so has a VAO
+///         and buffers.
+bool SkeletalMeshBase::isResident() const
+{
+    return vao_id_ != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the storage of the mesh's VBO, IBO and morph
+///         target buffer, in bytes; 0 if it isn't resident.
+GLsizeiptr SkeletalMeshBase::getBufferBytes() const
+{
+    GLsizeiptr bytes = vbo_size_ + ibo_size_;
+    if (morph_buffer_id_ != 0)
+        bytes += GLsizeiptr(std::max(morph_deltas_.size(), size_t(1)) * sizeof(MorphDelta));
+    return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the partitions of the vertex and index buffers created by
+///         the last upload, ordered by increasing influence
+///         count.  Only influence counts which are actually used have a
+///         partition.
+const std::vector<SkeletalMeshBase::Partition>& SkeletalMeshBase::getPartitions() const
+{
+    return partitions_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of vertices in the uploaded VBO.
+size_t SkeletalMeshBase::getVertexCount() const
+{
+    return vertex_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of indices in the uploaded IBO.
+size_t SkeletalMeshBase::getIndexCount() const
+{
+    return index_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the type of the indices in the uploaded IBO, for passing
+///         to glDrawElements.
+GLenum SkeletalMeshBase::getIndexType() const
+{
+    return index_type_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the bind-pose bounds of the vertices each joint
+///         influences, as found by computeJointBounds() when the mesh was
+///         last uploaded or updated.
+const std::vector<BoundingBox>& SkeletalMeshBase::getJointBounds() const
+{
+    return joint_bounds_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns where the last uploadMesh() put each of the mesh's
+///         vertices and triangles.
+///
+/// \details Empty if the mesh was last uploaded from raw data instead; the
+///         triangles are also dropped by releaseCpuData().
+const MeshUploadRemap& SkeletalMeshBase::getUploadRemap() const
+{
+    return remap_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a morph target to the uploaded mesh.
+///
+/// \details Deltas of zero are dropped, so a target only costs anything for
+///         the vertices it actually moves.  Every target's deltas are
+///         uploaded again, which is only meant to happen while the mesh is
+///         being set up.
+///
+/// \param  deltas The vertices the target moves, and how far; each vertex
+///         should only appear once.
+/// \return The index of the new target.
+size_t SkeletalMeshBase::addMorphTarget(const std::vector<MorphDelta>& deltas)
+{
+    size_t vertex_limit = remap_.vertices.empty() ? vertex_count_ : remap_.vertices.size();
+
+    MorphTarget target;
+    target.first_delta = morph_deltas_.size();
+    for (size_t i = 0; i < deltas.size(); ++i)
+    {
+        if (deltas[i].vertex >= vertex_limit)
+        {
+            std::cerr << "Morph target " << morph_targets_.size() << " moves vertex " << deltas[i].vertex
+                      << ", but the mesh only has " << vertex_limit << "." << std::endl;
+            throw std::runtime_error("Morph targets can only move the mesh's vertices.");
+        }
+
+        if (deltas[i].delta != vec2(0, 0))
+            morph_deltas_.push_back(deltas[i]);
+    }
+    target.delta_count = morph_deltas_.size() - target.first_delta;
+    morph_targets_.push_back(target);
+
+    uploadMorphTargets();
+    return morph_targets_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of morph targets added.
+size_t SkeletalMeshBase::getMorphTargetCount() const
+{
+    return morph_targets_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns where each morph target's deltas are in morph_buffer_id.
+const std::vector<SkeletalMeshBase::MorphTarget>& SkeletalMeshBase::getMorphTargets() const
+{
+    return morph_targets_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size in bytes of each index in the uploaded IBO.
+size_t SkeletalMeshBase::getIndexSize() const
+{
+    return ::getIndexSize(index_type_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks whether the edited vertices and triangles can be written
+///         over their uploaded copies without changing the partitioning, or
+///         the quantization of a quantized mesh.
+template <typename VertexType>
+bool BasicSkeletalMesh<VertexType>::canUpdateInPlace() const
+{
+    if (remap_.vertices.size() != vertices.size() ||
+        remap_.triangles.size() != indices.size() / 3 ||
+        vertex_count_ != vertices.size() ||
+        index_count_ != indices.size())
+    {
+        return false;
+    }
+
+    for (size_t i = dirty_vertices_begin_; i < dirty_vertices_end_; ++i)
+    {
+        const Partition* partition = findVertexPartition(remap_.vertices[i]);
+        if (partition == nullptr || partition->influence_count != getPartitionInfluenceCount(vertices[i]))
+            return false;
+
+        // an edited vertex which has moved out of the bounds needs a new
+        // quantization.
+        if (isQuantizedFormat(vertex_format) &&
+            !fitsQuantization(toPosition3D(vertices[i].position), position_quantization))
+        {
+            return false;
+        }
+    }
+
+    // an edited vertex can also move the triangles using it to another
+    // partition, but only by changing its influence count, which was checked
+    // above.
+    size_t last_triangle = std::min(indices.size() / 3, (dirty_indices_end_ + 2) / 3);
+    for (size_t t = dirty_indices_begin_ / 3; t < last_triangle; ++t)
+    {
+        size_t count = std::max(getPartitionInfluenceCount(vertices[indices[t * 3]]),
+                       std::max(getPartitionInfluenceCount(vertices[indices[t * 3 + 1]]),
+                                getPartitionInfluenceCount(vertices[indices[t * 3 + 2]])));
+        const Partition* partition = findIndexPartition(remap_.triangles[t] * 3);
+        if (partition == nullptr || partition->influence_count != count)
+            return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the partition whose vertex range contains an uploaded
+///         vertex, or nullptr if there isn't one.
+const SkeletalMeshBase::Partition* SkeletalMeshBase::findVertexPartition(size_t uploaded_vertex) const
+{
+    for (size_t i = 0; i < partitions_.size(); ++i)
+    {
+        const Partition& partition = partitions_[i];
+        if (uploaded_vertex >= partition.first_vertex &&
+            uploaded_vertex < partition.first_vertex + partition.vertex_count)
+        {
+            return &partition;
+        }
+    }
+
+    return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the partition whose index range contains an uploaded
+///         index, or nullptr if there isn't one.
+const SkeletalMeshBase::Partition* SkeletalMeshBase::findIndexPartition(size_t uploaded_index) const
+{
+    for (size_t i = 0; i < partitions_.size(); ++i)
+    {
+        const Partition& partition = partitions_[i];
+        if (uploaded_index >= partition.first_index &&
+            uploaded_index < partition.first_index + partition.index_count)
+        {
+            return &partition;
+        }
+    }
+
+    return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the edited vertices over their uploaded copies.
+///
+/// \details The edited vertices are generally scattered through the VBO,
+///         since the upload reorders them, so they are sorted by their
+///         uploaded positions and each run of adjacent ones is written with
+///         a single glBufferSubData.  GL_COPY_WRITE_BUFFER is used so that
+///         no other binding is disturbed.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::updateVertices()
+{
+    if (dirty_vertices_begin_ == dirty_vertices_end_)
+        return;
+
+    std::vector<std::pair<GLuint, size_t> > targets;
+    targets.reserve(dirty_vertices_end_ - dirty_vertices_begin_);
+    for (size_t i = dirty_vertices_begin_; i < dirty_vertices_end_; ++i)
+        targets.push_back(std::make_pair(remap_.vertices[i], i));
+    std::sort(targets.begin(), targets.end());
+
+    size_t vertex_size = getVertexSize(vertex_format);
+    std::vector<char> run;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_id_);
+    for (size_t first = 0; first < targets.size(); )
+    {
+        size_t last = first + 1;
+        while (last < targets.size() && targets[last].first == targets[last - 1].first + 1)
+            ++last;
+
+        run.resize((last - first) * vertex_size);
+        for (size_t i = first; i < last; ++i)
+            writeVertex(vertices[targets[i].second], vertex_format, position_quantization,
+                        &run[(i - first) * vertex_size]);
+
+        glBufferSubData(GL_COPY_WRITE_BUFFER, targets[first].first * vertex_size, run.size(), run.data());
+        first = last;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes the triangles overlapping the edited indices over their
+///         uploaded copies, remapped and narrowed as they were uploaded.
+///
+/// \details As with updateVertices(), each run of triangles which are
+///         adjacent in the IBO is written with a single glBufferSubData.
+template <typename VertexType>
+void BasicSkeletalMesh<VertexType>::updateIndices()
+{
+    if (dirty_indices_begin_ == dirty_indices_end_)
+        return;
+
+    size_t last_triangle = std::min(indices.size() / 3, (dirty_indices_end_ + 2) / 3);
+    std::vector<std::pair<GLuint, size_t> > targets;
+    for (size_t t = dirty_indices_begin_ / 3; t < last_triangle; ++t)
+        targets.push_back(std::make_pair(remap_.triangles[t], t));
+    std::sort(targets.begin(), targets.end());
+
+    size_t index_size = getIndexSize();
+    std::vector<GLuint> run;
+    std::vector<char> run_data;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_id_);
+    for (size_t first = 0; first < targets.size(); )
+    {
+        size_t last = first + 1;
+        while (last < targets.size() && targets[last].first == targets[last - 1].first + 1)
+            ++last;
+
+        run.clear();
+        for (size_t i = first; i < last; ++i)
+        {
+            for (size_t k = 0; k < 3; ++k)
+                run.push_back(remap_.vertices[indices[targets[i].second * 3 + k]]);
+        }
+
+        packIndices(run.data(), run.size(), index_type_, run_data);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, targets[first].first * 3 * index_size, run_data.size(), run_data.data());
+        first = last;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Forgets the edited ranges, after they've been uploaded.
+void SkeletalMeshBase::clearDirtySpans()
+{
+    dirty_vertices_begin_ = 0;
+    dirty_vertices_end_ = 0;
+    dirty_indices_begin_ = 0;
+    dirty_indices_end_ = 0;
+}
+
+template class BasicSkeletalMesh<Vertex>;
+template class BasicSkeletalMesh<Vertex3D>;
+
+template void buildMeshUploadData(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                                  VertexFormat vertex_format, std::vector<char>& vertex_data,
+                                  GLenum& index_type, std::vector<char>& index_data,
+                                  std::vector<SkeletalMeshBase::Partition>& partitions,
+                                  MeshOptimizationStats* stats, MeshUploadRemap* remap,
+                                  PositionQuantization* quantization);
+template void buildMeshUploadData(const std::vector<Vertex3D>& vertices, const std::vector<GLuint>& indices,
+                                  VertexFormat vertex_format, std::vector<char>& vertex_data,
+                                  GLenum& index_type, std::vector<char>& index_data,
+                                  std::vector<SkeletalMeshBase::Partition>& partitions,
+                                  MeshOptimizationStats* stats, MeshUploadRemap* remap,
+                                  PositionQuantization* quantization);
@@ -3,59 +3,618 @@
 /// \file:  skeletal_mesh.h
 /// \author Ben Crist
 ///
-/// \brief  Class header for the Vertex struct and SkeletalMesh class.
+/// \brief  Class header for the Vertex structs and SkeletalMesh classes.
 
 #ifndef SKELETAL_MESH_H_
 #define SKELETAL_MESH_H_
 
 #include "demo.h"
+#include "joint_bounds.h"
+#include "mesh_optimizer.h"
+#include <glm/gtc/half_float.hpp>
 #include <vector>
 
+class GLDeletionQueue;
+
+/// The maximum number of joints which can influence a single vertex.
+const size_t MAX_JOINT_INFLUENCES = 4;
+
+/// Influences lighter than this are pruned by normalizeInfluences() when no
+/// threshold is given; they move a vertex by less than 1% of their joint's
+/// motion.
+const float DEFAULT_MIN_INFLUENCE_WEIGHT = 0.01f;
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  A vertex contains the coordinates of a point in bind-pose model
 ///         space and any extra data associated with it that the vertex shader
 ///         will need.
 ///
 /// \details For the purposes of this demo, the position is specified in 2D
-///         space, but skinning works the same way in 3D space.  The only
-///         other information specified are the indices of up to 3 joints
+///         space (Vertex), but skinning works the same way in 3D space
+///         (Vertex3D); PositionType is vec2 or vec3.  The only
+///         other information specified are the indices of up to 4 joints
 ///         which influence the vertex's final position, and the relative
 ///         weight of each influencing vertex.
 ///
-///         If there are fewer than 3 joints which influence a vertex, the
+///         If there are fewer than 4 joints which influence a vertex, the
 ///         weight for the extra joints can be set to 0, indicating that that
 ///         joint doesn't influence the vertex at all.  The sum of the values
-///         of joint_weights[0..2] must always be 1.0.
-struct Vertex
+///         of joint_weights[0..3] must always be 1.0.
+///
+///         The indices and weights are each uploaded as a single 4-component
+///         attribute.
+///
+///         A 2D mesh lies in the z = 0 plane, facing +z, but its normals and
+///         tangents are 3D so that it can be lit as if it were rounded (see
+///         computeOutlineNormals()).  They're skinned along with the
+///         position.
+template <typename PositionType>
+struct BasicVertex
+{
+    BasicVertex();
+
+    PositionType position;                          ///< The vertex's position in bind-pose model space.
+    GLuint joint_indices[MAX_JOINT_INFLUENCES];     ///< The indices of 4 joints which affect the vertex.
+    GLfloat joint_weights[MAX_JOINT_INFLUENCES];    ///< The amount that the joints identified above affect the vertex.
+    vec3 normal;                                    ///< The unit normal in bind-pose model space.
+    vec4 tangent;                                   ///< The unit tangent in xyz, and the bitangent's handedness (1 or -1) in w.
+};
+
+typedef BasicVertex<vec2> Vertex;
+typedef BasicVertex<vec3> Vertex3D;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A compact vertex layout for uploading to the GPU.
+///
+/// \details Joint indices are stored as bytes, and the weights as normalized
+///         bytes.  The weights are quantized so that their bytes always sum
+///         to exactly 255, so the shader sees weights that sum to 1 without
+///         having to renormalize them.  The normal and tangent are packed
+///         into 10:10:10:2 signed normalized integers (see packNormal()).
+///         This takes 24 bytes instead of the 68 of a full Vertex (28 and 72
+///         in 3D).
+template <typename PositionType>
+struct BasicPackedVertex
+{
+    PositionType position;                          ///< The vertex's position in bind-pose model space.
+    GLubyte joint_indices[MAX_JOINT_INFLUENCES];    ///< The indices of 4 joints which affect the vertex.
+    GLubyte joint_weights[MAX_JOINT_INFLUENCES];    ///< The normalized weights of the joints.
+    GLuint normal;                                  ///< The normal, as GL_INT_2_10_10_10_REV.
+    GLuint tangent;                                 ///< The tangent and handedness, as GL_INT_2_10_10_10_REV.
+};
+
+typedef BasicPackedVertex<vec2> PackedVertex;
+typedef BasicPackedVertex<vec3> PackedVertex3D;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A PackedVertex with its position stored as half floats, which
+///         brings the size of each vertex down to 20 bytes (24 in 3D, with
+///         2 bytes of padding after the position).
+template <typename HalfPositionType>
+struct BasicHalfPackedVertex
+{
+    HalfPositionType position;                      ///< The vertex's position in bind-pose model space.
+    GLubyte joint_indices[MAX_JOINT_INFLUENCES];    ///< The indices of 4 joints which affect the vertex.
+    GLubyte joint_weights[MAX_JOINT_INFLUENCES];    ///< The normalized weights of the joints.
+    GLuint normal;                                  ///< The normal, as GL_INT_2_10_10_10_REV.
+    GLuint tangent;                                 ///< The tangent and handedness, as GL_INT_2_10_10_10_REV.
+};
+
+typedef BasicHalfPackedVertex<glm::hvec2> HalfPackedVertex;
+typedef BasicHalfPackedVertex<glm::hvec3> HalfPackedVertex3D;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A PackedVertex with its position stored as 16-bit signed
+///         normalized integers, relative to the mesh's bounds (see
+///         PositionQuantization).
+///
+/// \details The same 20 bytes as a HalfPackedVertex (24 in 3D, with the
+///         fourth component as padding), but with the same precision
+///         everywhere in the mesh, where half floats lose it away from the
+///         origin.  The shaders see positions in [-1, 1]; folding the
+///         quantization into the inverse bind transforms (see
+///         foldPositionQuantization()) takes them back to model space
+///         without any extra work per vertex.
+template <size_t N_POSITION_SHORTS>
+struct BasicQuantizedVertex
+{
+    GLshort position[N_POSITION_SHORTS];            ///< The position, as GL_SHORT normalized to [-1, 1].
+    GLubyte joint_indices[MAX_JOINT_INFLUENCES];    ///< The indices of 4 joints which affect the vertex.
+    GLubyte joint_weights[MAX_JOINT_INFLUENCES];    ///< The normalized weights of the joints.
+    GLuint normal;                                  ///< The normal, as GL_INT_2_10_10_10_REV.
+    GLuint tangent;                                 ///< The tangent and handedness, as GL_INT_2_10_10_10_REV.
+};
+
+typedef BasicQuantizedVertex<2> QuantizedVertex;
+typedef BasicQuantizedVertex<4> QuantizedVertex3D;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  How a mesh's quantized positions map back to model space: a
+///         position p in [-1, 1] is at bias + p * scale.
+///
+/// \details The scale is the same on every axis, so the transform is a
+///         uniform scale and a translation, which joint transforms of every
+///         kind (matrices, dual quaternions and Affine2Ds) can absorb.  The
+///         default is the identity, which is what every other format uses.
+struct PositionQuantization
+{
+    PositionQuantization();
+
+    mat4 getTransform() const;
+
+    vec3 bias;      ///< The center of the mesh's bounds.
+    float scale;    ///< Half the largest extent of the mesh's bounds.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Identifies the layout that a SkeletalMesh's vertices are stored in
+///         on the GPU.
+///
+/// \details Each layout has a 2D and a 3D version.  A mesh's format has to
+///         match its vertex type (see VertexLayout).
+enum VertexFormat
+{
+    VERTEX_FORMAT_FULL = 0,         ///< Vertex; 68 bytes per vertex.
+    VERTEX_FORMAT_PACKED,           ///< PackedVertex; 24 bytes per vertex.
+    VERTEX_FORMAT_PACKED_HALF,      ///< HalfPackedVertex; 20 bytes per vertex.
+    VERTEX_FORMAT_FULL_3D,          ///< Vertex3D; 72 bytes per vertex.
+    VERTEX_FORMAT_PACKED_3D,        ///< PackedVertex3D; 28 bytes per vertex.
+    VERTEX_FORMAT_PACKED_HALF_3D,   ///< HalfPackedVertex3D; 24 bytes per vertex.
+    VERTEX_FORMAT_QUANTIZED,        ///< QuantizedVertex; 20 bytes per vertex.
+    VERTEX_FORMAT_QUANTIZED_3D      ///< QuantizedVertex3D; 24 bytes per vertex.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The types and formats which go with a vertex type, so that code
+///         templated on it picks its upload paths at compile time.
+template <typename VertexType>
+struct VertexLayout;
+
+template <>
+struct VertexLayout<Vertex>
+{
+    typedef PackedVertex Packed;
+    typedef HalfPackedVertex HalfPacked;
+    typedef QuantizedVertex Quantized;
+    static const size_t POSITION_COMPONENTS = 2;
+    static VertexFormat fullFormat() { return VERTEX_FORMAT_FULL; }
+};
+
+template <>
+struct VertexLayout<Vertex3D>
+{
+    typedef PackedVertex3D Packed;
+    typedef HalfPackedVertex3D HalfPacked;
+    typedef QuantizedVertex3D Quantized;
+    static const size_t POSITION_COMPONENTS = 3;
+    static VertexFormat fullFormat() { return VERTEX_FORMAT_FULL_3D; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One attribute of a vertex format: where it is in each vertex, how
+///         GL reads it, and how the skinning vertex shader declares it.
+///
+/// \details Every format has the same VERTEX_ATTRIBUTE_COUNT attributes, at
+///         the same locations; they're described from the fields of the
+///         format's vertex type (see getVertexAttributes()), so that the
+///         attribute pointers and the shader's inputs can't disagree.  The
+///         position, joint indices and joint weights come first, and are
+///         the only ones a skinning-only stream has (see
+///         getSkinningVertexSize()).
+struct VertexAttribute
+{
+    GLuint location;
+    GLint components;
+    GLenum type;
+    bool integer;               ///< Read with glVertexAttribIPointer, as integers.
+    bool normalized;            ///< Integer components are read as [0, 1] or [-1, 1].
+    size_t offset;              ///< From the start of the vertex.
+    const char* declaration;    ///< The shader's input, without its layout qualifier.
+};
+
+const size_t VERTEX_ATTRIBUTE_COUNT = 5;
+const size_t SKINNING_VERTEX_ATTRIBUTE_COUNT = 3;
+
+const GLuint POSITION_ATTRIBUTE = 0;        ///< The attribute location of the position.
+const GLuint JOINT_INDICES_ATTRIBUTE = 1;   ///< The attribute location of the joint indices.
+const GLuint JOINT_WEIGHTS_ATTRIBUTE = 2;   ///< The attribute location of the joint weights.
+const GLuint NORMAL_ATTRIBUTE = 6;          ///< The attribute location of the normal.
+const GLuint TANGENT_ATTRIBUTE = 7;         ///< The attribute location of the tangent.
+
+void getVertexAttributes(VertexFormat format, VertexAttribute* attributes);
+size_t getVertexSize(VertexFormat format);
+size_t getPositionComponents(VertexFormat format);
+size_t getSkinningVertexSize(VertexFormat format);
+void setVertexAttributes(VertexFormat format, bool skinning_only = false);
+
+GLuint packNormal(const vec4& normal);
+PackedVertex packVertex(const Vertex& vertex);
+PackedVertex3D packVertex(const Vertex3D& vertex);
+HalfPackedVertex packVertexHalf(const Vertex& vertex);
+HalfPackedVertex3D packVertexHalf(const Vertex3D& vertex);
+QuantizedVertex packVertexQuantized(const Vertex& vertex, const PositionQuantization& quantization);
+QuantizedVertex3D packVertexQuantized(const Vertex3D& vertex, const PositionQuantization& quantization);
+bool isQuantizedFormat(VertexFormat format);
+
+template <typename VertexType>
+PositionQuantization choosePositionQuantization(const std::vector<VertexType>& vertices);
+void foldPositionQuantization(const mat4* inverse_bind_transforms, size_t joint_count,
+                              const PositionQuantization& quantization, mat4* folded);
+
+GLenum chooseIndexType(size_t vertex_count);
+size_t getIndexSize(GLenum index_type);
+void packIndices(const GLuint* indices, size_t index_count, GLenum index_type, std::vector<char>& index_data);
+
+template <typename VertexType>
+VertexType sortInfluences(const VertexType& vertex);
+template <typename VertexType>
+size_t getInfluenceCount(const VertexType& vertex);
+template <typename VertexType>
+size_t getPartitionInfluenceCount(const VertexType& vertex);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  What normalizeInfluences() did to a mesh's vertices.
+struct InfluenceStats
+{
+    size_t normalized_vertices;     ///< Vertices whose weights were rescaled to sum to 1.
+    size_t pruned_influences;       ///< Nonzero weights which were below the threshold.
+    size_t influence_histogram[MAX_JOINT_INFLUENCES];   ///< influence_histogram[n - 1] vertices are left with n influences.
+};
+
+template <typename VertexType>
+VertexType normalizeInfluences(const VertexType& vertex, float min_weight = DEFAULT_MIN_INFLUENCE_WEIGHT);
+template <typename VertexType>
+void normalizeInfluences(std::vector<VertexType>& vertices, float min_weight = DEFAULT_MIN_INFLUENCE_WEIGHT,
+                         InfluenceStats* stats = NULL);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  What limitInfluences() did to a mesh's vertices, and how far it
+///         may have moved them.
+///
+/// \details A vertex which loses a weight w can end up, at most, w times the
+///         distance between where its dropped and kept joints put it away
+///         from where it should be; so the weights are the error, as a
+///         fraction of how far apart the joints move.
+struct InfluenceLimitStats
+{
+    size_t limited_vertices;        ///< Vertices which had more influences than the limit.
+    size_t dropped_influences;      ///< Nonzero weights dropped from them.
+    float max_dropped_weight;       ///< The most weight any one vertex lost, before the rest were rescaled.
+    float mean_dropped_weight;      ///< The weight the limited vertices lost, on average.
+    size_t worst_vertex;            ///< The vertex which lost max_dropped_weight.
+};
+
+template <typename VertexType>
+VertexType limitInfluences(const VertexType& vertex, size_t max_influences);
+template <typename VertexType>
+void limitInfluences(std::vector<VertexType>& vertices, size_t max_influences, InfluenceLimitStats* stats = NULL);
+
+void computeOutlineNormals(std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+void rebaseIndices(std::vector<GLuint>& indices, GLuint index_base);
+
+void computeJointBounds(VertexFormat format, const void* vertex_data, size_t vertex_count,
+                        std::vector<BoundingBox>& joint_bounds,
+                        const PositionQuantization& quantization = PositionQuantization());
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  How far a morph target moves one vertex from its bind-pose
+///         position, at the target's full weight.
+///
+/// \details The layout (12 bytes, tightly packed) is also how the deltas
+///         are stored on the GPU, with the vertex index translated to the
+///         vertex's place in the uploaded VBO.
+struct MorphDelta
 {
-    vec2 position;              ///< The vertex's 2D position in bind-pose model space.
-    GLuint joint_indices[3];    ///< The indices of 3 joints which affect the vertex.
-    GLfloat joint_weights[3];   ///< The amount that the joints identified above affect the vertex.
+    GLuint vertex;  ///< The index of the vertex in SkeletalMesh::vertices, or in the uploaded vertices if there are none.
+    vec2 delta;     ///< The offset added to the vertex's position, in bind-pose model space.
+};
+
+void rebaseIndices(std::vector<MorphDelta>& deltas, GLuint index_base);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records where buildMeshUploadData() put each of the vertices and
+///         triangles it was given, so that later edits can be applied to the
+///         uploaded buffers in place.
+struct MeshUploadRemap
+{
+    std::vector<GLuint> vertices;   ///< The position of each vertex in the uploaded vertices.
+    std::vector<GLuint> triangles;  ///< The position of each triangle in the uploaded indices, in triangles.
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  A skeletal mesh object is a Vertex Array Object (VAO) that has an
 ///         Index Buffer Object (IBO) and a Vertex Buffer Object (VBO) which
 ///         is suitable for use with a skinning vertex shader.
-class SkeletalMesh
+///
+/// \details SkeletalMeshBase is everything about a mesh which doesn't depend
+///         on whether it's 2D or 3D; the meshes themselves are
+///         BasicSkeletalMeshes, which keep their vertices on the CPU too.
+///         Code which only draws meshes, or copies their buffers, can take a
+///         SkeletalMeshBase and work with either.
+///
+///         vertex_format determines the layout the vertices are converted
+///         to when they are uploaded.  Every format uses the same attribute
+///         locations: 0 for the position, 1 for the joint indices (uvec4), 2
+///         for the joint weights (vec4), 6 for the normal (vec3) and 7 for
+///         the tangent (vec4), so the same shaders work with all of them.
+///
+///         When uploading, each vertex's influences are sorted by weight, and
+///         the triangles are grouped into partitions by the number of
+///         influences their vertices actually use.  Each partition can be
+///         drawn with a shader which only evaluates that many influences.
+///
+///         The indices are uploaded as the narrowest type which can address
+///         all of the vertices (see chooseIndexType()), so draws must use
+///         getIndexType() and getIndexSize() rather than assuming a type.
+///
+///         A mesh can be uploaded with uploadData() from vertices and
+///         indices that were prepared ahead of time (see mesh_file.h), in
+///         which case a BasicSkeletalMesh's vertices and indices fields stay
+///         empty; code which only needs the uploaded buffers should use
+///         getVertexCount() and getIndexCount() instead.
+///
+///         Whenever the mesh is uploaded, the vertices each joint influences
+///         are bounded (see computeJointBounds()), so that the mesh can be
+///         bounded in any pose without looking at its vertices.
+///
+///         The quantized formats store positions relative to the mesh's
+///         bounds, as recorded in position_quantization.  uploadMesh() and
+///         prepareMesh() choose it from the vertices; uploadData() and
+///         reserveData() take it from the field, which has to be set to
+///         match the data first.  Whatever draws the mesh has to fold it
+///         into the inverse bind transforms (see foldPositionQuantization()),
+///         and the joint bounds are always in model space.
+///
+///         Constructing a mesh doesn't touch GL; its VAO and buffers are
+///         only created by its first upload, and the ids read 0 until then
+///         (see isResident()).  So a mesh can be built and prepared on any
+///         thread, and only handed to the thread which owns the GL context
+///         to be uploaded.  releaseBuffers() deletes them again, but keeps
+///         the layout, partitions and joint bounds, so an evicted mesh can
+///         still be culled until it's uploaded again (see
+///         ResidencyManager).  Each kind of GL object is deleted with its
+///         own call; with a GLDeletionQueue set (see setDeletionQueue()),
+///         they're queued for the GL thread to delete instead, so a mesh
+///         can be destroyed on any thread, however many are churned
+///         through.
+///
+///         Meshes can't be copied, but BasicSkeletalMeshes can be moved
+///         (or swapped), which hands the GL objects over with everything
+///         else and leaves the source empty, so they can be kept by value
+///         in containers.
+///
+///         Morph targets (blend shapes) can be added once the mesh has been
+///         uploaded.  Each one is stored sparsely, as a delta for just the
+///         vertices it moves, and all of their deltas are kept one target
+///         after another in morph_buffer_id, ready for a pass like
+///         MorphTargetPass to apply before skinning.  The morph targets
+///         don't count toward the joint bounds.
+class SkeletalMeshBase
 {
 public:
-    SkeletalMesh();
-    ~SkeletalMesh();
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A range of the uploaded index buffer containing triangles
+    ///         whose vertices are influenced by at most influence_count
+    ///         joints, and a range of the uploaded vertex buffer containing
+    ///         the vertices influenced by exactly influence_count joints.
+    ///
+    /// \details The triangles of a partition may use vertices from earlier
+    ///         partitions, and either range may be empty.  The vertices of
+    ///         the partition with one influence are rigid: each follows its
+    ///         joint with a weight of exactly 1, so its shader skips the
+    ///         weights (see getPartitionInfluenceCount()).
+    struct Partition
+    {
+        size_t influence_count; ///< The number of influences the shader must evaluate (1 to MAX_JOINT_INFLUENCES).
+        GLsizei index_count;    ///< The number of indices in the partition.
+        size_t first_index;     ///< The index of the partition's first index in the IBO.
+        GLsizei vertex_count;   ///< The number of vertices in the partition.
+        size_t first_vertex;    ///< The index of the partition's first vertex in the VBO.
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The range of morph_buffer_id's deltas belonging to one morph
+    ///         target.
+    struct MorphTarget
+    {
+        size_t first_delta;
+        size_t delta_count;
+    };
+
+    void uploadData(VertexFormat format,
+                    const void* vertex_data, size_t vertex_count,
+                    GLenum index_type, const void* index_data, size_t index_count,
+                    const std::vector<Partition>& partitions);
+    void reserveData(VertexFormat format,
+                     const void* vertex_data, size_t vertex_count,
+                     GLenum index_type, size_t index_count,
+                     const std::vector<Partition>& partitions);
+    void copyData(const SkeletalMeshBase& source);
+    void releaseBuffers();
+    void setDeletionQueue(GLDeletionQueue* queue);
+
+    bool isResident() const;
+    GLsizeiptr getBufferBytes() const;
+    const std::vector<Partition>& getPartitions() const;
+    size_t getVertexCount() const;
+    size_t getIndexCount() const;
+    GLenum getIndexType() const;
+    size_t getIndexSize() const;
+    const std::vector<BoundingBox>& getJointBounds() const;
+    const MeshUploadRemap& getUploadRemap() const;
 
-    void uploadMesh() const;
+    size_t addMorphTarget(const std::vector<MorphDelta>& deltas);
+    size_t getMorphTargetCount() const;
+    const std::vector<MorphTarget>& getMorphTargets() const;
 
-    std::vector<Vertex> vertices;
-    std::vector<GLushort> indices;
+    VertexFormat vertex_format;
+    PositionQuantization position_quantization; ///< How the uploaded positions map to model space.
 
     const GLuint& vao_id;
     const GLuint& vbo_id;
     const GLuint& ibo_id;
+    const GLuint& morph_buffer_id;  ///< Every morph target's deltas; 0 until a target is added.
 
-private:
+protected:
+    SkeletalMeshBase();
+    ~SkeletalMeshBase();
+
+    const Partition* findVertexPartition(size_t uploaded_vertex) const;
+    const Partition* findIndexPartition(size_t uploaded_index) const;
+    void clearDirtySpans();
+    void createBuffers();
+    void setLayout(VertexFormat format, size_t vertex_count, GLenum index_type, size_t index_count,
+                   const std::vector<Partition>& partitions);
+    void reserveStorage(VertexFormat format, size_t vertex_count, GLenum index_type, size_t index_count,
+                        const std::vector<Partition>& partitions);
+    void uploadMorphTargets();
+    void swapBase(SkeletalMeshBase& other);
+
+    GLDeletionQueue* deletion_queue_;   ///< Where the GL objects go when they're released; null to delete them at once.
     GLuint vao_id_;
     GLuint vbo_id_;
     GLuint ibo_id_;
+    GLuint morph_buffer_id_;
+
+    size_t vertex_count_;
+    size_t index_count_;
+    GLenum index_type_;
+    std::vector<Partition> partitions_;
+    std::vector<BoundingBox> joint_bounds_;     ///< The bind-pose bounds of the vertices each joint influences.
+    std::vector<MorphTarget> morph_targets_;
+    std::vector<MorphDelta> morph_deltas_;      ///< Every target's deltas, with the vertex indices as they were added.
+
+    GLsizeiptr vbo_size_;       ///< The size of the VBO's storage, in bytes.
+    GLsizeiptr ibo_size_;       ///< The size of the IBO's storage, in bytes.
+    MeshUploadRemap remap_;     ///< Empty unless the last upload was from uploadMesh().
+
+    size_t dirty_vertices_begin_;   ///< The start of the edited range of vertices.
+    size_t dirty_vertices_end_;     ///< The end of the edited range of vertices; begin == end if none were edited.
+    size_t dirty_indices_begin_;    ///< The start of the edited range of indices.
+    size_t dirty_indices_end_;      ///< The end of the edited range of indices; begin == end if none were edited.
+
+private:
+    SkeletalMeshBase(const SkeletalMeshBase&);              // non-copyable
+    SkeletalMeshBase& operator=(const SkeletalMeshBase&);   // non-copyable
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A skeletal mesh with VertexType vertices (Vertex or Vertex3D),
+///         kept on the CPU so that they can be edited and uploaded again.
+///
+/// \details vertex_format must be one of the formats of VertexType's
+///         dimension.  The conversion to it is picked at compile time, so a
+///         2D mesh never pays for the 3D paths, or the other way around.
+///
+///         After editing some of the vertices or indices of a mesh uploaded
+///         with uploadMesh(), mark the edited ranges with
+///         markVerticesDirty() and markIndicesDirty(), then call
+///         updateMesh().  Only the edited vertices and triangles are
+///         uploaded, as long as no vertex changed its number of influences
+///         and no triangle moved to another partition; otherwise the whole
+///         mesh is rebuilt.  Either way, the existing buffers are reused
+///         whenever the data still fits in them, instead of being
+///         reallocated.
+///
+///         uploadMesh() can also be done in two steps: prepareMesh() does
+///         all of the conversion and optimization work without a GL
+///         context, so it can run on a worker thread, and uploadPrepared()
+///         then only has to copy the result into the buffers, on the
+///         thread which owns the context.  The mesh mustn't be used by
+///         another thread while it's being prepared.
+///
+///         A mesh built from vertices and indices which already exist can
+///         take them over by moving them in, or copy them from anywhere
+///         (mapped file memory, say) without building vectors first.  A
+///         mesh which will only ever be drawn doesn't need them once it's
+///         uploaded: releaseCpuData() frees them, so the mesh's data is
+///         only kept by the GPU.
+///
+///         The CPU data policy picks what uploadPrepared() (and so
+///         uploadMesh()) does with them afterwards.  CPU_DATA_KEEP keeps them,
+///         as before.  CPU_DATA_DISCARD releases them.  CPU_DATA_COMPRESS
+///         keeps a compressed copy (see byte_compression.h, and
+///         index_codec.h for the indices), usually a fraction of the size,
+///         and releases the rest; restoreCpuData() decompresses it back into
+///         vertices and indices whenever they're needed again, for picking,
+///         CPU skinning or restoring an evicted mesh.
+template <typename VertexType>
+class BasicSkeletalMesh : public SkeletalMeshBase
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  What happens to vertices and indices after an upload.
+    enum CpuDataPolicy
+    {
+        CPU_DATA_KEEP = 0,  ///< Keep them, so the mesh can be edited.
+        CPU_DATA_DISCARD,   ///< Release them; only the GPU has the data.
+        CPU_DATA_COMPRESS   ///< Keep them compressed, for restoreCpuData().
+    };
+
+    BasicSkeletalMesh();
+    BasicSkeletalMesh(std::vector<VertexType>&& vertices, std::vector<GLuint>&& indices);
+    BasicSkeletalMesh(const VertexType* vertices, size_t vertex_count, const GLuint* indices, size_t index_count);
+    BasicSkeletalMesh(BasicSkeletalMesh&& other);
+    BasicSkeletalMesh& operator=(BasicSkeletalMesh&& other);
+    void swap(BasicSkeletalMesh& other);
+
+    void uploadMesh(MeshOptimizationStats* stats = NULL);
+
+    void prepareMesh(MeshOptimizationStats* stats = NULL);
+    bool isPrepared() const;
+    void uploadPrepared();
+
+    void markVerticesDirty(size_t first, size_t count);
+    void markIndicesDirty(size_t first, size_t count);
+    void updateMesh();
+    void releaseCpuData();
+
+    void setCpuDataPolicy(CpuDataPolicy policy);
+    CpuDataPolicy getCpuDataPolicy() const;
+    bool hasCpuData() const;
+    bool restoreCpuData();
+    size_t getCpuDataBytes() const;
+
+    std::vector<VertexType> vertices;
+    std::vector<GLuint> indices;
+
+private:
+    bool canUpdateInPlace() const;
+    void updateVertices();
+    void updateIndices();
+    void applyCpuDataPolicy();
+
+    CpuDataPolicy cpu_data_policy_;
+    size_t compressed_vertex_count_;
+    size_t compressed_index_count_;
+    std::vector<char> compressed_vertices_;
+    std::vector<char> compressed_indices_;
+
+    // the output of prepareMesh(), waiting for uploadPrepared().
+    bool prepared_;
+    size_t prepared_vertex_count_;
+    size_t prepared_index_count_;
+    std::vector<char> prepared_vertex_data_;
+    PositionQuantization prepared_quantization_;
+    GLenum prepared_index_type_;
+    std::vector<char> prepared_index_data_;
+    std::vector<Partition> prepared_partitions_;
+    MeshUploadRemap prepared_remap_;
 };
 
+typedef BasicSkeletalMesh<Vertex> SkeletalMesh;
+typedef BasicSkeletalMesh<Vertex3D> SkeletalMesh3D;
+
+template <typename VertexType>
+void buildMeshUploadData(const std::vector<VertexType>& vertices,
+                         const std::vector<GLuint>& indices,
+                         VertexFormat vertex_format,
+                         std::vector<char>& vertex_data,
+                         GLenum& index_type,
+                         std::vector<char>& index_data,
+                         std::vector<SkeletalMeshBase::Partition>& partitions,
+                         MeshOptimizationStats* stats = NULL,
+                         MeshUploadRemap* remap = NULL,
+                         PositionQuantization* quantization = NULL);
+
 #endif
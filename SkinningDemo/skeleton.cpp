@@ -0,0 +1,314 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skeleton.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of Skeleton class functions.
+
+#include "skeleton.h"
+#include "simd_math.h"
+
+#include <cassert>
+
+const size_t Skeleton::NO_SOCKET;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Constructs a new skeleton with no joints.
+Skeleton::Skeleton()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Appends a new joint to the skeleton.
+///
+/// \details Joints must be added parents-first;  the parent must either be
+///         NO_PARENT or the index of a joint which has already been added.
+///
+/// \param  parent The index of the new joint's parent joint.
+/// \return The index of the new joint.
+size_t Skeleton::addJoint(int parent)
+{
+    assert(parent == NO_PARENT || (parent >= 0 && size_t(parent) < parents_.size()));
+    assert(!pose_pool_ && !color_pose_pool_ && "joints can't be added after poses have been allocated");
+
+    parents_.push_back(parent);
+    return parents_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of joints in the skeleton.
+size_t Skeleton::getJointCount() const
+{
+    return parents_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the index of a joint's parent joint, or NO_PARENT if the
+///         joint is a root joint.
+///
+/// \param  joint The index of the joint whose parent should be returned.
+int Skeleton::getParent(size_t joint) const
+{
+    return parents_[joint];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Allocates a new pose for this skeleton from one of the
+///         skeleton's pose pools.  The contents of the pose's channels are
+///         undefined.
+///
+/// \param  colors Whether the pose needs a color stream, to visualize its
+///         joints.
+Pose Skeleton::allocatePose(bool colors)
+{
+    return getPosePool(colors).allocate();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a pose allocated with allocatePose() to the skeleton's
+///         pose pool it came from.
+///
+/// \param  pose The pose to release.  It is reset to an empty pose.
+void Skeleton::releasePose(Pose& pose)
+{
+    std::unique_ptr<PosePool>& pool = pose.color != nullptr ? color_pose_pool_ : pose_pool_;
+    if (pool)
+        pool->release(pose);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a pool this skeleton's poses are allocated from, for
+///         things which allocate and release poses themselves.  Creating the
+///         pool counts as allocating the first pose.
+///
+/// \param  colors Whether to return the pool of poses with colors.
+PosePool& Skeleton::getPosePool(bool colors)
+{
+    std::unique_ptr<PosePool>& pool = colors ? color_pose_pool_ : pose_pool_;
+    if (!pool)
+        pool.reset(new PosePool(parents_.size(), 64, colors));
+
+    return *pool;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the local-to-model transformation matrix of every joint
+///         in a pose.
+///
+/// \details First all of the joints' local transforms are built in one batch
+///         with computeLocalTransforms().  Then, since parents always come
+///         before their children, each joint's parent transform has already
+///         been converted to model space by the time we get to it, so the
+///         whole pass is linear in the number of joints.
+///
+/// \param  pose The pose to evaluate.
+/// \param  transforms An array of getJointCount() matrices which will
+///         receive the joints' local-to-model transforms.
+void Skeleton::computeJointTransforms(const Pose& pose, mat4* transforms) const
+{
+    assert(pose.joint_count == parents_.size());
+    computeLocalTransforms(pose, transforms);
+
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+    {
+        int parent = parents_[joint];
+        if (parent != NO_PARENT)
+            transforms[joint] = multiplyMatrices(transforms[parent], transforms[joint]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the local-to-model transform of every joint in a pose,
+///         like computeJointTransforms(), as 2D affine transforms.
+///
+/// \details Each joint costs a composeAffine() instead of a mat4 product,
+///         so the pass does about a fifth of the arithmetic.
+///
+/// \param  pose The pose to evaluate.
+/// \param  affines An array of getJointCount() transforms which will
+///         receive the joints' local-to-model transforms.
+void Skeleton::computeJointAffines(const Pose& pose, Affine2D* affines) const
+{
+    assert(pose.joint_count == parents_.size());
+    computeLocalAffines(pose, affines);
+
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+    {
+        int parent = parents_[joint];
+        if (parent != NO_PARENT)
+            affines[joint] = composeAffine(affines[parent], affines[joint]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes and stores the inverse bind transforms of every joint:
+///         the transforms from model space to each joint's local space in
+///         the bind pose.
+///
+/// \details The joints only translate, rotate and scale uniformly, so each
+///         one is inverted analytically with inverseAffine() instead of a
+///         general 4x4 glm::inverse(), and the mat4s are expanded from the
+///         affines.  This is done once, when the skeleton is set up; every
+///         mesh, program and instance then reads the same arrays.
+///
+/// \param  bind_pose The pose the meshes bound to the skeleton were
+///         modeled in.
+void Skeleton::setBindPose(const Pose& bind_pose)
+{
+    inverse_bind_affines_.resize(parents_.size());
+    inverse_bind_transforms_.resize(parents_.size());
+
+    computeJointAffines(bind_pose, inverse_bind_affines_.data());
+    for (size_t joint = 0; joint < parents_.size(); ++joint)
+    {
+        inverse_bind_affines_[joint] = inverseAffine(inverse_bind_affines_[joint]);
+        inverse_bind_transforms_[joint] = affineToMat4(inverse_bind_affines_[joint]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true once setBindPose() has been called.
+bool Skeleton::hasBindPose() const
+{
+    return !inverse_bind_transforms_.empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the getJointCount() inverse bind transforms computed by
+///         setBindPose().
+const mat4* Skeleton::getInverseBindTransforms() const
+{
+    assert(hasBindPose());
+    return inverse_bind_transforms_.data();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the inverse bind transforms as Affine2D.
+const Affine2D* Skeleton::getInverseBindAffines() const
+{
+    assert(hasBindPose());
+    return inverse_bind_affines_.data();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a socket to attach props to.
+///
+/// \param  name The socket's name, which must be unique.
+/// \param  joint The joint the socket moves with.
+/// \param  offset The socket's transform relative to the joint.
+/// \return The socket's index, which it keeps.
+size_t Skeleton::addSocket(const std::string& name, size_t joint, const mat4& offset)
+{
+    assert(joint < parents_.size());
+    assert(findSocket(name) == NO_SOCKET && "socket names must be unique");
+
+    socket_names_.push_back(name);
+    socket_joints_.push_back(joint);
+    socket_offsets_.push_back(offset);
+    return socket_names_.size() - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the index of the socket with a name, or NO_SOCKET if
+///         there isn't one.  This compares strings, so it's for looking
+///         sockets up once, rather than every frame.
+size_t Skeleton::findSocket(const std::string& name) const
+{
+    for (size_t socket = 0; socket < socket_names_.size(); ++socket)
+    {
+        if (socket_names_[socket] == name)
+            return socket;
+    }
+    return NO_SOCKET;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of sockets on the skeleton.
+size_t Skeleton::getSocketCount() const
+{
+    return socket_names_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a socket's name.
+const std::string& Skeleton::getSocketName(size_t socket) const
+{
+    return socket_names_[socket];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the joint a socket moves with.
+size_t Skeleton::getSocketJoint(size_t socket) const
+{
+    return socket_joints_[socket];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a socket's transform relative to its joint.
+const mat4& Skeleton::getSocketOffset(size_t socket) const
+{
+    return socket_offsets_[socket];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the transform of every socket, in socket order.
+///
+/// \param  joint_transforms A pose's local-to-model joint transforms, as
+///         from computeJointTransforms() or a JointTransformCache.
+/// \param  model_transform Takes model space to the space the results
+///         should be in, such as an instance's world transform.
+/// \param  socket_transforms Receives getSocketCount() transforms, packed
+///         together, ready to use as the instance transforms of the props.
+void Skeleton::computeSocketTransforms(const mat4* joint_transforms, const mat4& model_transform,
+                                       mat4* socket_transforms) const
+{
+    for (size_t socket = 0; socket < socket_joints_.size(); ++socket)
+        socket_transforms[socket] = model_transform * joint_transforms[socket_joints_[socket]] * socket_offsets_[socket];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the transforms of some of the sockets, as for the props
+///         which are actually attached.
+///
+/// \param  joint_transforms A pose's local-to-model joint transforms.
+/// \param  model_transform Takes model space to the results' space.
+/// \param  sockets The indices of the sockets wanted, in any order.
+/// \param  socket_count The number of sockets wanted.
+/// \param  socket_transforms Receives socket_count transforms, packed
+///         together in the order of sockets.
+void Skeleton::computeSocketTransforms(const mat4* joint_transforms, const mat4& model_transform,
+                                       const size_t* sockets, size_t socket_count, mat4* socket_transforms) const
+{
+    for (size_t i = 0; i < socket_count; ++i)
+    {
+        size_t socket = sockets[i];
+        assert(socket < socket_joints_.size());
+        socket_transforms[i] = model_transform * joint_transforms[socket_joints_[socket]] * socket_offsets_[socket];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Brings the transforms from an earlier computeSocketTransforms()
+///         of every socket up to date, recomputing only those on joints
+///         which have moved since.
+///
+/// \details The dirty range is the one a JointTransformCache reports, which
+///         covers every joint it recomputed.  The model transform must be
+///         the same as last time; if it has changed, every socket has moved.
+///
+/// \param  joint_transforms The pose's local-to-model joint transforms.
+/// \param  model_transform Takes model space to the results' space.
+/// \param  first_dirty_joint The first joint which may have moved.
+/// \param  dirty_joint_end One past the last joint which may have moved.
+/// \param  socket_transforms The getSocketCount() transforms to update.
+void Skeleton::updateSocketTransforms(const mat4* joint_transforms, const mat4& model_transform,
+                                      size_t first_dirty_joint, size_t dirty_joint_end,
+                                      mat4* socket_transforms) const
+{
+    for (size_t socket = 0; socket < socket_joints_.size(); ++socket)
+    {
+        size_t joint = socket_joints_[socket];
+        if (joint >= first_dirty_joint && joint < dirty_joint_end)
+            socket_transforms[socket] = model_transform * joint_transforms[joint] * socket_offsets_[socket];
+    }
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skeleton.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the Skeleton class.
+
+#ifndef SKELETON_H_
+#define SKELETON_H_
+
+#include "affine_2d.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A skeleton describes the hierarchy of joints that poses are
+///         applied to.
+///
+/// \details Joints are stored in parent-before-child order, so every joint's
+///         parent index is less than its own index.  This means the
+///         model-space transform of every joint in a pose can be found with
+///         a single forward pass over the joints, instead of walking up the
+///         parent chain separately for each joint.
+///
+///         Each skeleton also owns the pools that the channel data for its
+///         poses is allocated from: one for poses with colors, and one for
+///         the far more common poses without.  Joints can't be added once
+///         the first pose has been allocated.
+///
+///         The inverse bind transforms belong to the skeleton too, since
+///         every mesh, program, instance and backend bound to it shares
+///         them.  setBindPose() computes them once; after that they're only
+///         read.
+///
+///         Sockets are named places on joints for attaching props: each is
+///         a joint and a fixed offset from it.  They're found by name once,
+///         with findSocket(), and then by index, and their transforms are
+///         computed in a batch from a pose's joint transforms, which are
+///         already in model space, so nothing walks up the hierarchy.
+class Skeleton
+{
+public:
+    static const int NO_PARENT = -1;    ///< Parent index of the root joint(s).
+    static const size_t NO_SOCKET = size_t(-1);
+
+    Skeleton();
+
+    size_t addJoint(int parent);
+
+    size_t getJointCount() const;
+    int getParent(size_t joint) const;
+
+    Pose allocatePose(bool colors = false);
+    void releasePose(Pose& pose);
+    PosePool& getPosePool(bool colors = false);
+
+    void computeJointTransforms(const Pose& pose, mat4* transforms) const;
+    void computeJointAffines(const Pose& pose, Affine2D* affines) const;
+
+    void setBindPose(const Pose& bind_pose);
+    bool hasBindPose() const;
+    const mat4* getInverseBindTransforms() const;
+    const Affine2D* getInverseBindAffines() const;
+
+    size_t addSocket(const std::string& name, size_t joint, const mat4& offset);
+    size_t findSocket(const std::string& name) const;
+    size_t getSocketCount() const;
+    const std::string& getSocketName(size_t socket) const;
+    size_t getSocketJoint(size_t socket) const;
+    const mat4& getSocketOffset(size_t socket) const;
+
+    void computeSocketTransforms(const mat4* joint_transforms, const mat4& model_transform,
+                                 mat4* socket_transforms) const;
+    void computeSocketTransforms(const mat4* joint_transforms, const mat4& model_transform,
+                                 const size_t* sockets, size_t socket_count, mat4* socket_transforms) const;
+    void updateSocketTransforms(const mat4* joint_transforms, const mat4& model_transform,
+                                size_t first_dirty_joint, size_t dirty_joint_end, mat4* socket_transforms) const;
+
+private:
+    Skeleton(const Skeleton&);              // non-copyable
+    Skeleton& operator=(const Skeleton&);   // non-copyable
+
+    std::vector<int> parents_;
+    std::unique_ptr<PosePool> pose_pool_;
+    std::unique_ptr<PosePool> color_pose_pool_;
+    std::vector<mat4> inverse_bind_transforms_;     ///< Each joint's model-to-local transform in the bind pose.
+    std::vector<Affine2D> inverse_bind_affines_;    ///< inverse_bind_transforms_ as Affine2D.
+
+    std::vector<std::string> socket_names_;
+    std::vector<size_t> socket_joints_;
+    std::vector<mat4> socket_offsets_;      ///< Each socket's transform relative to its joint.
+};
+
+#endif
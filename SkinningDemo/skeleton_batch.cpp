@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skeleton_batch.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the batch skeleton evaluation functions.
+
+#include "skeleton_batch.h"
+#include "joint_rotation.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+const size_t SINE_BLOCK = 64;   ///< Instances whose sines and cosines are found at a time.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Rounds an instance count up to a whole number of lanes.
+size_t getBatchStride(size_t instance_count)
+{
+    return (instance_count + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Builds a run of instances' local transforms for one joint from
+///         their sines and cosines, and composes them with their parent's
+///         model transforms, the same arithmetic as composeAffine().
+///
+/// \param  poses The batch of poses.
+/// \param  sines The sines of the run's rotations.
+/// \param  cosines The cosines of the run's rotations.
+/// \param  row The joint's row, plus the run's first instance.
+/// \param  parent_row The parent's row, plus the run's first instance; or
+///         size_t(-1) if the joint is a root.
+/// \param  count The number of instances in the run; a multiple of
+///         BATCH_LANES.
+/// \param  affines Receives the model transforms.
+void composeRun(const PoseBatch& poses, const float* sines, const float* cosines, size_t row, size_t parent_row,
+                size_t count, AffineBatch& affines)
+{
+    const float* scale = &poses.scale[row];
+    const float* tx = &poses.translation_x[row];
+    const float* ty = &poses.translation_y[row];
+    float* xx = &affines.x_axis_x[row];
+    float* xy = &affines.x_axis_y[row];
+    float* yx = &affines.y_axis_x[row];
+    float* yy = &affines.y_axis_y[row];
+    float* ox = &affines.translation_x[row];
+    float* oy = &affines.translation_y[row];
+
+    if (parent_row == size_t(-1))
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            xx[i] = cosines[i] * scale[i];
+            xy[i] = sines[i] * scale[i];
+            yx[i] = -sines[i] * scale[i];
+            yy[i] = cosines[i] * scale[i];
+            ox[i] = tx[i];
+            oy[i] = ty[i];
+        }
+        return;
+    }
+
+    const float* pxx = &affines.x_axis_x[parent_row];
+    const float* pxy = &affines.x_axis_y[parent_row];
+    const float* pyx = &affines.y_axis_x[parent_row];
+    const float* pyy = &affines.y_axis_y[parent_row];
+    const float* pox = &affines.translation_x[parent_row];
+    const float* poy = &affines.translation_y[parent_row];
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (size_t i = 0; i < count; i += BATCH_LANES)
+    {
+        __m128 s = _mm_loadu_ps(scale + i);
+        __m128 lxx = _mm_mul_ps(_mm_loadu_ps(cosines + i), s);
+        __m128 lxy = _mm_mul_ps(_mm_loadu_ps(sines + i), s);
+        __m128 lyx = _mm_xor_ps(lxy, sign);
+        __m128 lyy = lxx;
+        __m128 ltx = _mm_loadu_ps(tx + i);
+        __m128 lty = _mm_loadu_ps(ty + i);
+
+        __m128 axx = _mm_loadu_ps(pxx + i);
+        __m128 axy = _mm_loadu_ps(pxy + i);
+        __m128 ayx = _mm_loadu_ps(pyx + i);
+        __m128 ayy = _mm_loadu_ps(pyy + i);
+
+        _mm_storeu_ps(xx + i, _mm_add_ps(_mm_mul_ps(axx, lxx), _mm_mul_ps(ayx, lxy)));
+        _mm_storeu_ps(xy + i, _mm_add_ps(_mm_mul_ps(axy, lxx), _mm_mul_ps(ayy, lxy)));
+        _mm_storeu_ps(yx + i, _mm_add_ps(_mm_mul_ps(axx, lyx), _mm_mul_ps(ayx, lyy)));
+        _mm_storeu_ps(yy + i, _mm_add_ps(_mm_mul_ps(axy, lyx), _mm_mul_ps(ayy, lyy)));
+        _mm_storeu_ps(ox + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(axx, ltx), _mm_mul_ps(ayx, lty)),
+                                         _mm_loadu_ps(pox + i)));
+        _mm_storeu_ps(oy + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(axy, ltx), _mm_mul_ps(ayy, lty)),
+                                         _mm_loadu_ps(poy + i)));
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        float lxx = cosines[i] * scale[i];
+        float lxy = sines[i] * scale[i];
+        float lyx = -lxy;
+        float lyy = lxx;
+
+        xx[i] = pxx[i] * lxx + pyx[i] * lxy;
+        xy[i] = pxy[i] * lxx + pyy[i] * lxy;
+        yx[i] = pxx[i] * lyx + pyx[i] * lyy;
+        yy[i] = pxy[i] * lyx + pyy[i] * lyy;
+        ox[i] = pxx[i] * tx[i] + pyx[i] * ty[i] + pox[i];
+        oy[i] = pxy[i] * tx[i] + pyy[i] * ty[i] + poy[i];
+    }
+#endif
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a batch of instances in the rest pose: no translation or
+///         rotation, and a scale of 1.
+PoseBatch::PoseBatch(size_t joint_count, size_t instance_count)
+    : joint_count(joint_count),
+      instance_count(instance_count),
+      stride(getBatchStride(instance_count)),
+      translation_x(joint_count * stride, 0.0f),
+      translation_y(joint_count * stride, 0.0f),
+      rotation(joint_count * stride, 0.0f),
+      scale(joint_count * stride, 1.0f)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies one instance's pose into the batch.
+///
+/// \param  instance The instance to set.
+/// \param  pose A pose of the batch's skeleton.
+void PoseBatch::setPose(size_t instance, const Pose& pose)
+{
+    assert(instance < instance_count && pose.joint_count == joint_count);
+    for (size_t joint = 0, i = instance; joint < joint_count; ++joint, i += stride)
+    {
+        translation_x[i] = pose.translation[joint].x;
+        translation_y[i] = pose.translation[joint].y;
+        rotation[i] = pose.rotation[joint];
+        scale[i] = pose.scale[joint];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a batch of transforms for computeBatchJointAffines() to
+///         fill in.
+AffineBatch::AffineBatch(size_t joint_count, size_t instance_count)
+    : joint_count(joint_count),
+      instance_count(instance_count),
+      stride(getBatchStride(instance_count)),
+      x_axis_x(joint_count * stride),
+      x_axis_y(joint_count * stride),
+      y_axis_x(joint_count * stride),
+      y_axis_y(joint_count * stride),
+      translation_x(joint_count * stride),
+      translation_y(joint_count * stride)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Copies out one instance's transforms, in the layout
+///         Skeleton::computeJointAffines() gives them.
+///
+/// \param  instance The instance to get.
+/// \param  affines An array of joint_count transforms which receives them.
+void AffineBatch::getAffines(size_t instance, Affine2D* affines) const
+{
+    assert(instance < instance_count);
+    for (size_t joint = 0, i = instance; joint < joint_count; ++joint, i += stride)
+    {
+        affines[joint].x_axis = vec2(x_axis_x[i], x_axis_y[i]);
+        affines[joint].y_axis = vec2(y_axis_x[i], y_axis_y[i]);
+        affines[joint].translation = vec2(translation_x[i], translation_y[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Computes the local-to-model transform of every joint of every
+///         instance in a batch, as Skeleton::computeJointAffines() does for
+///         each instance's pose.
+///
+/// \details The pass walks the joints once, in the skeleton's
+///         parent-before-child order, and sweeps each joint's row of
+///         instances BATCH_LANES at a time.  The parent is looked up once
+///         per joint rather than once per instance, and every lane does the
+///         same work, so the inner loop has no branches and nothing to
+///         gather: a joint's row and its parent's row are both contiguous.
+///         The sines and cosines of each row are found with the stream
+///         sinCosDegrees(), SINE_BLOCK instances at a time.  Per-instance
+///         evaluation, by contrast, has one chain of dependent products per
+///         instance and can only use SIMD within a joint's 2x3 product.
+///
+/// \param  skeleton The skeleton every instance is a pose of.
+/// \param  poses The instances' poses.
+/// \param  affines Receives the transforms; it must have the same joint and
+///         instance counts as poses.
+void computeBatchJointAffines(const Skeleton& skeleton, const PoseBatch& poses, AffineBatch& affines)
+{
+    assert(poses.joint_count == skeleton.getJointCount());
+    assert(affines.joint_count == poses.joint_count && affines.stride == poses.stride);
+
+    ALIGN16 float sines[SINE_BLOCK];
+    ALIGN16 float cosines[SINE_BLOCK];
+    for (size_t joint = 0; joint < poses.joint_count; ++joint)
+    {
+        int parent = skeleton.getParent(joint);
+        for (size_t first = 0; first < poses.stride; first += SINE_BLOCK)
+        {
+            size_t count = std::min(SINE_BLOCK, poses.stride - first);
+            size_t row = joint * poses.stride + first;
+            sinCosDegrees(&poses.rotation[row], count, sines, cosines);
+            composeRun(poses, sines, cosines, row,
+                       parent == Skeleton::NO_PARENT ? size_t(-1) : size_t(parent) * poses.stride + first,
+                       count, affines);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skeleton_batch.h
+/// \author Ben Crist
+///
+/// \brief  The PoseBatch and AffineBatch structs, and the function which
+///         evaluates many instances of one skeleton at once.
+
+#ifndef SKELETON_BATCH_H_
+#define SKELETON_BATCH_H_
+
+#include "skeleton.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The number of instances a batch's rows are padded to a multiple
+///         of, so that they're evaluated a whole SIMD register at a time.
+const size_t BATCH_LANES = 4;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The poses of many instances of one skeleton, stored joint-major.
+///
+/// \details Each channel holds a row per joint, and each row holds that
+///         joint's value for every instance, at joint * stride + instance.
+///         All instances share the skeleton's parent table, so evaluating
+///         a joint is the same work in every instance, and a row of
+///         instances can go through it together (see
+///         computeBatchJointAffines()).  The padding at the end of each row
+///         is evaluated too, but its results are never read.
+struct PoseBatch
+{
+    PoseBatch(size_t joint_count, size_t instance_count);
+
+    void setPose(size_t instance, const Pose& pose);
+
+    size_t joint_count;
+    size_t instance_count;
+    size_t stride;                      ///< instance_count, rounded up to a multiple of BATCH_LANES.
+    std::vector<float> translation_x;
+    std::vector<float> translation_y;
+    std::vector<float> rotation;        ///< In degrees, like Pose::rotation.
+    std::vector<float> scale;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The local-to-model transforms of many instances of one skeleton,
+///         stored joint-major like a PoseBatch.
+///
+/// \details Each channel is one component of an Affine2D.
+struct AffineBatch
+{
+    AffineBatch(size_t joint_count, size_t instance_count);
+
+    void getAffines(size_t instance, Affine2D* affines) const;
+
+    size_t joint_count;
+    size_t instance_count;
+    size_t stride;                      ///< instance_count, rounded up to a multiple of BATCH_LANES.
+    std::vector<float> x_axis_x;
+    std::vector<float> x_axis_y;
+    std::vector<float> y_axis_x;
+    std::vector<float> y_axis_y;
+    std::vector<float> translation_x;
+    std::vector<float> translation_y;
+};
+
+void computeBatchJointAffines(const Skeleton& skeleton, const PoseBatch& poses, AffineBatch& affines);
+
+#endif
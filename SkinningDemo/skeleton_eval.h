@@ -0,0 +1,193 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skeleton_eval.h
+/// \author Ben Crist
+///
+/// \brief  The SkeletonEval class template, which evaluates poses of a
+///         skeleton whose hierarchy is known at compile time.
+
+#ifndef SKELETON_EVAL_H_
+#define SKELETON_EVAL_H_
+
+#include "affine_2d.h"
+#include "pose.h"
+#include "simd_math.h"
+#include "skeleton.h"
+#include <cassert>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Flattens the joints from JOINT up to END of a fixed hierarchy,
+///         one template instance per joint; see SkeletonEval.
+template <typename RigDesc, size_t JOINT, size_t END>
+struct FixedHierarchyPass
+{
+    enum { PARENT = RigDesc::template Parent<JOINT>::VALUE };
+
+    static void computeTransforms(const mat4* locals, mat4* transforms)
+    {
+        if (PARENT == Skeleton::NO_PARENT)
+            transforms[JOINT] = locals[JOINT];
+        else
+            transforms[JOINT] = multiplyMatrices(transforms[PARENT], locals[JOINT]);
+        FixedHierarchyPass<RigDesc, JOINT + 1, END>::computeTransforms(locals, transforms);
+    }
+
+    static void computeAffines(const Affine2D* locals, Affine2D* affines)
+    {
+        if (PARENT == Skeleton::NO_PARENT)
+            affines[JOINT] = locals[JOINT];
+        else
+            affines[JOINT] = composeAffine(affines[PARENT], locals[JOINT]);
+        FixedHierarchyPass<RigDesc, JOINT + 1, END>::computeAffines(locals, affines);
+    }
+
+    static void computeBlendedTransforms(const Pose& a, const Pose& b, float t, mat4* transforms)
+    {
+        mat4 local = getBlendedJointLocalTransform(a, b, t, JOINT);
+        if (PARENT == Skeleton::NO_PARENT)
+            transforms[JOINT] = local;
+        else
+            transforms[JOINT] = multiplyMatrices(transforms[PARENT], local);
+        FixedHierarchyPass<RigDesc, JOINT + 1, END>::computeBlendedTransforms(a, b, t, transforms);
+    }
+
+    static bool matches(const Skeleton& skeleton)
+    {
+        return skeleton.getParent(JOINT) == PARENT &&
+               FixedHierarchyPass<RigDesc, JOINT + 1, END>::matches(skeleton);
+    }
+
+    static void addJoints(Skeleton& skeleton)
+    {
+        skeleton.addJoint(PARENT);
+        FixedHierarchyPass<RigDesc, JOINT + 1, END>::addJoints(skeleton);
+    }
+
+    static_assert(int(PARENT) < int(JOINT), "Joints must come after their parents.");
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Ends a FixedHierarchyPass, past the last joint.
+template <typename RigDesc, size_t END>
+struct FixedHierarchyPass<RigDesc, END, END>
+{
+    static void computeTransforms(const mat4*, mat4*) {}
+    static void computeAffines(const Affine2D*, Affine2D*) {}
+    static void computeBlendedTransforms(const Pose&, const Pose&, float, mat4*) {}
+    static bool matches(const Skeleton&) { return true; }
+    static void addJoints(Skeleton&) {}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Evaluates poses of one particular skeleton, described at compile
+///         time, faster than the Skeleton it matches can.
+///
+/// \details Skeleton::computeJointTransforms() loads each joint's parent
+///         from the skeleton's table and loops over however many joints
+///         there turn out to be, so every product depends on a load, and
+///         nothing can be kept in registers from one joint to the next.
+///         Here the joint count and every parent are template constants,
+///         so the pass is unrolled into straight-line code, one product per
+///         joint with its operands' addresses fixed, and the compiler is
+///         free to keep a parent's transform in registers for its children
+///         and to interleave independent joints.  Roots cost nothing.
+///
+///         RigDesc describes the skeleton, in parent-before-child order:
+///
+///             struct ExampleRig
+///             {
+///                 enum { JOINT_COUNT = 3 };
+///                 template <size_t JOINT> struct Parent;
+///             };
+///             template <> struct ExampleRig::Parent<0> { enum { VALUE = Skeleton::NO_PARENT }; };
+///             template <> struct ExampleRig::Parent<1> { enum { VALUE = 0 }; };
+///             template <> struct ExampleRig::Parent<2> { enum { VALUE = 1 }; };
+///
+///         A joint which comes before its parent fails to compile.  Each
+///         rig costs its own copy of the code, so this is only worth it for
+///         the few rigs most instances share; everything else takes the
+///         Skeleton's own path.  The local transforms are the same either
+///         way, so only the hierarchy pass differs.
+template <typename RigDesc>
+class SkeletonEval
+{
+public:
+    enum { JOINT_COUNT = RigDesc::JOINT_COUNT };
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Adds the rig's joints to a skeleton with none, so the two
+    ///         always match.
+    static void buildSkeleton(Skeleton& skeleton)
+    {
+        assert(skeleton.getJointCount() == 0);
+        FixedHierarchyPass<RigDesc, 0, JOINT_COUNT>::addJoints(skeleton);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Returns true if a skeleton has exactly the rig's hierarchy,
+    ///         so its poses can be evaluated here.
+    static bool matches(const Skeleton& skeleton)
+    {
+        return skeleton.getJointCount() == size_t(JOINT_COUNT) &&
+               FixedHierarchyPass<RigDesc, 0, JOINT_COUNT>::matches(skeleton);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Computes the local-to-model transform of every joint in a
+    ///         pose, exactly as Skeleton::computeJointTransforms() does.
+    static void computeJointTransforms(const Pose& pose, mat4* transforms)
+    {
+        assert(pose.joint_count == size_t(JOINT_COUNT));
+        computeLocalTransforms(pose, transforms);
+        FixedHierarchyPass<RigDesc, 0, JOINT_COUNT>::computeTransforms(transforms, transforms);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Computes the local-to-model transform of every joint in a
+    ///         pose as 2D affine transforms, exactly as
+    ///         Skeleton::computeJointAffines() does.
+    static void computeJointAffines(const Pose& pose, Affine2D* affines)
+    {
+        assert(pose.joint_count == size_t(JOINT_COUNT));
+        computeLocalAffines(pose, affines);
+        FixedHierarchyPass<RigDesc, 0, JOINT_COUNT>::computeAffines(affines, affines);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Computes the local-to-model transform of every joint in a
+    ///         blend of two poses, as blendPoses() followed by
+    ///         computeJointTransforms() would, in a single pass.
+    ///
+    /// \details Each joint's channels are blended, turned into its local
+    ///         transform and composed with its parent's in turn, so the
+    ///         blended pose and the local transforms are never written out
+    ///         and read back; only the model transforms are stored, and each
+    ///         is read by its children while it's still in L1.  This gives
+    ///         up the 4-wide blend and local transform passes, which is the
+    ///         better deal whenever the blended pose would only have been
+    ///         read once.
+    static void blendJointTransforms(const Pose& a, const Pose& b, float t, mat4* transforms)
+    {
+        assert(a.joint_count == size_t(JOINT_COUNT) && b.joint_count == size_t(JOINT_COUNT));
+        FixedHierarchyPass<RigDesc, 0, JOINT_COUNT>::computeBlendedTransforms(a, b, t, transforms);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Flattens each joint's local transform into its local-to-model
+    ///         transform.  locals and transforms may be the same array.
+    static void flattenTransforms(const mat4* locals, mat4* transforms)
+    {
+        FixedHierarchyPass<RigDesc, 0, JOINT_COUNT>::computeTransforms(locals, transforms);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  Flattens each joint's local affine transform into its
+    ///         local-to-model transform.  locals and affines may be the same
+    ///         array.
+    static void flattenAffines(const Affine2D* locals, Affine2D* affines)
+    {
+        FixedHierarchyPass<RigDesc, 0, JOINT_COUNT>::computeAffines(locals, affines);
+    }
+};
+
+#endif
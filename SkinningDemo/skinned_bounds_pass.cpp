@@ -0,0 +1,180 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinned_bounds_pass.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of SkinnedBoundsPass class functions.
+
+#include "skinned_bounds_pass.h"
+
+#include <algorithm>
+#include <cstring>
+
+const GLuint SkinnedBoundsPass::WORKGROUP_SIZE;
+const size_t SkinnedBoundsPass::RESULT_COUNT;
+
+namespace {
+
+const GLuint MAX_WORKGROUPS = 64;   ///< Past this, more workgroups only add atomics on the same four words.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if a fence has signaled, without waiting for it.
+bool isSignaled(GLsync fence)
+{
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Undoes the shader's orderedBits(), which flips the floats' bits so
+///         that they sort as unsigned integers.
+float decodeOrderedBits(GLuint bits)
+{
+    bits = (bits & 0x80000000u) != 0 ? bits & 0x7FFFFFFFu : ~bits;
+    float value;
+    std::memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the result buffers.
+SkinnedBoundsPass::SkinnedBoundsPass()
+    : next_result_(0),
+      serial_(0),
+      bounds_serial_(0)
+{
+    for (size_t i = 0; i < RESULT_COUNT; ++i)
+    {
+        glGenBuffers(1, &results_[i].buffer_id);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, results_[i].buffer_id);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+        results_[i].fence = nullptr;
+        results_[i].serial = 0;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the result buffers, and any fences still waiting.
+SkinnedBoundsPass::~SkinnedBoundsPass()
+{
+    for (size_t i = 0; i < RESULT_COUNT; ++i)
+    {
+        if (results_[i].fence != nullptr)
+            glDeleteSync(results_[i].fence);
+        glDeleteBuffers(1, &results_[i].buffer_id);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts reducing a buffer of skinned vertices to their bounds.
+///
+/// \details If the next result buffer's reduction still hasn't been read,
+///         it's read now, waiting for it if it has to; with RESULT_COUNT
+///         buffers, that only happens when collect() isn't being called.
+///
+/// \param  compute_program_id The program compiled from
+///         skinned_bounds_shader_source.
+/// \param  vertex_buffer_id The skinned vertices.  The writes of any compute
+///         shader which skinned them are waited for.
+/// \param  vertex_count The number of vertices to bound, from the start of
+///         the buffer.
+/// \param  source_transform Takes the skinned vertices to world space: the
+///         inverse of the camera's view-projection for ComputeSkinner's,
+///         which are in clip space.
+void SkinnedBoundsPass::reduce(GLuint compute_program_id, GLuint vertex_buffer_id, size_t vertex_count,
+                               const mat4& source_transform)
+{
+    if (vertex_count == 0)
+        return;
+
+    Result& result = results_[next_result_];
+    next_result_ = (next_result_ + 1) % RESULT_COUNT;
+    if (result.fence != nullptr)
+        read(result);   // glGetBufferSubData() waits for the reduction by itself
+
+    // the atomics start from an empty box.
+    const GLuint empty[4] = { 0xFFFFFFFFu, 0xFFFFFFFFu, 0u, 0u };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, result.buffer_id);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(empty), empty);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vertex_buffer_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, result.buffer_id);
+
+    glUseProgram(compute_program_id);
+    glUniform1ui(glGetUniformLocation(compute_program_id, "vertex_count"), GLuint(vertex_count));
+    glUniformMatrix4fv(glGetUniformLocation(compute_program_id, "source_transform"), 1, GL_FALSE,
+                       &source_transform[0][0]);
+    GLuint group_count = GLuint(std::min<size_t>((vertex_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                                                 MAX_WORKGROUPS));
+    glDispatchCompute(group_count, 1, 1);
+    glUseProgram(0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+
+    // the result is read back with glGetBufferSubData().
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    result.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    result.serial = ++serial_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads back the reductions which have finished, without waiting
+///         for any which haven't.  Call it once a frame.
+void SkinnedBoundsPass::collect()
+{
+    for (size_t i = 0; i < RESULT_COUNT; ++i)
+    {
+        if (results_[i].fence != nullptr && isSignaled(results_[i].fence))
+            read(results_[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads back a dispatched reduction, and keeps its bounds if
+///         they're newer than bounds_.  Reductions finish in order, so an
+///         older one is only read to free its buffer.
+void SkinnedBoundsPass::read(Result& result)
+{
+    glDeleteSync(result.fence);
+    result.fence = nullptr;
+    if (result.serial < bounds_serial_)
+        return;
+
+    GLuint bits[4];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, result.buffer_id);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(bits), bits);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    bounds_.min = vec2(decodeOrderedBits(bits[0]), decodeOrderedBits(bits[1]));
+    bounds_.max = vec2(decodeOrderedBits(bits[2]), decodeOrderedBits(bits[3]));
+    bounds_serial_ = result.serial;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Gets the bounds of the latest reduction which has been read back.
+///
+/// \param  bounds Receives the bounds, in world space.
+/// \return false if no reduction has been read back yet, leaving bounds
+///         alone.
+bool SkinnedBoundsPass::getBounds(BoundingBox& bounds) const
+{
+    if (bounds_serial_ == 0)
+        return false;
+
+    bounds = bounds_;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how many reductions have been dispatched since the one
+///         getBounds() gives: roughly, how many frames old its bounds are.
+size_t SkinnedBoundsPass::getLatency() const
+{
+    return serial_ - bounds_serial_;
+}
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinned_bounds_pass.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the SkinnedBoundsPass class.
+
+#ifndef SKINNED_BOUNDS_PASS_H_
+#define SKINNED_BOUNDS_PASS_H_
+
+#include "joint_bounds.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finds the exact bounds of vertices which have already been skinned
+///         on the GPU, by SkinnedVertexCache or ComputeSkinner, with a
+///         parallel reduction in a compute shader (GL 4.3).
+///
+/// \details reduce() dispatches skinned_bounds_shader_source over a buffer of
+///         skinned vertices (a vec4 position and a vec4 color each): each
+///         workgroup reduces its share of the vertices to a min and a max
+///         in shared memory, and merges them into a small result buffer
+///         with atomics.  Nothing waits for it.  The result buffers are a
+///         ring of RESULT_COUNT, each with a fence, and collect() reads back
+///         the ones whose fences have signaled, so the bounds getBounds()
+///         gives are a frame or two behind the vertices: fine for anything
+///         which only needs to know roughly where the mesh is, and which
+///         would otherwise stall the pipeline to find out.
+///
+///         The bounds are tight, unlike those of computeSkinnedBounds(),
+///         whose joint boxes each cover every pose of their vertices.  The
+///         cost is a pass over every skinned vertex, rather than one box
+///         per joint.
+class SkinnedBoundsPass
+{
+public:
+    static const GLuint WORKGROUP_SIZE = 256;   ///< Must match the compute shader's local_size_x.
+    static const size_t RESULT_COUNT = 3;       ///< Reductions which may be in flight at once.
+
+    SkinnedBoundsPass();
+    ~SkinnedBoundsPass();
+
+    void reduce(GLuint compute_program_id, GLuint vertex_buffer_id, size_t vertex_count,
+                const mat4& source_transform);
+    void collect();
+
+    bool getBounds(BoundingBox& bounds) const;
+    size_t getLatency() const;
+
+private:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One result buffer, and the reduction which last wrote it.
+    struct Result
+    {
+        GLuint buffer_id;
+        GLsync fence;       ///< Set once the reduction has been dispatched; null once it's been read.
+        size_t serial;      ///< The reduction's number, counting from 1.
+    };
+
+    SkinnedBoundsPass(const SkinnedBoundsPass&);            // non-copyable
+    SkinnedBoundsPass& operator=(const SkinnedBoundsPass&); // non-copyable
+
+    void read(Result& result);
+
+    Result results_[RESULT_COUNT];
+    size_t next_result_;
+    size_t serial_;             ///< The number of reductions dispatched.
+    size_t bounds_serial_;      ///< The reduction bounds_ came from, or 0 if none has been read.
+    BoundingBox bounds_;
+};
+
+#endif
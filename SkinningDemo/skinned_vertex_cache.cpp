@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinned_vertex_cache.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of SkinnedVertexCache class functions.
+
+#include "skinned_vertex_cache.h"
+
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the transform feedback buffer for a mesh, and a VAO which
+///         reads vertices from it and indices from the mesh's IBO.
+///
+/// \param  mesh The mesh whose vertices will be captured.  It must already
+///         have been uploaded, and must outlive the cache.
+SkinnedVertexCache::SkinnedVertexCache(const SkeletalMesh& mesh)
+    : mesh_(mesh),
+      vao_id_(0),
+      vbo_id_(0)
+{
+    glGenVertexArrays(1, &vao_id_);
+    glGenBuffers(1, &vbo_id_);
+
+    glBindVertexArray(vao_id_);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    glBufferData(GL_ARRAY_BUFFER, mesh.getVertexCount() * sizeof(SkinnedVertex), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo_id);
+
+    void* position = reinterpret_cast<void*>(offsetof(SkinnedVertex, position));
+    void* color = reinterpret_cast<void*>(offsetof(SkinnedVertex, color));
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), position);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), color);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the cache's VAO and transform feedback buffer.
+SkinnedVertexCache::~SkinnedVertexCache()
+{
+    glDeleteVertexArrays(1, &vao_id_);
+    glDeleteBuffers(1, &vbo_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Prepares to capture skinned vertices.  Rasterization is disabled
+///         until endCapture() is called.
+void SkinnedVertexCache::beginCapture()
+{
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(mesh_.vao_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins a range of the mesh's vertices with the current program,
+///         and stores the results at the same indices in the cache.
+///
+/// \param  first_vertex The index of the first vertex to skin.
+/// \param  vertex_count The number of vertices to skin.
+void SkinnedVertexCache::captureVertices(size_t first_vertex, GLsizei vertex_count)
+{
+    if (vertex_count == 0)
+        return;
+
+    glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbo_id_,
+                      first_vertex * sizeof(SkinnedVertex), vertex_count * sizeof(SkinnedVertex));
+
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, GLint(first_vertex), vertex_count);
+    glEndTransformFeedback();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Finishes capturing skinned vertices and re-enables rasterization.
+void SkinnedVertexCache::endCapture()
+{
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws all of the mesh's triangles using the captured vertices and
+///         the current program.
+///
+/// \param  instance_count How many times to draw them, as one instanced
+///         draw; ShadowPass draws once per cascade.
+void SkinnedVertexCache::draw(GLsizei instance_count) const
+{
+    glBindVertexArray(vao_id_);
+    glDrawElementsInstanced(GL_TRIANGLES, GLsizei(mesh_.getIndexCount()), mesh_.getIndexType(), 0, instance_count);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the buffer the vertices are captured into, one
+///         SkinnedVertex per vertex of the mesh.
+GLuint SkinnedVertexCache::getVertexBuffer() const
+{
+    return vbo_id_;
+}
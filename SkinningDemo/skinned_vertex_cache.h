@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinned_vertex_cache.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the SkinnedVertexCache class.
+
+#ifndef SKINNED_VERTEX_CACHE_H_
+#define SKINNED_VERTEX_CACHE_H_
+
+#include "skeletal_mesh.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A buffer holding the final, skinned vertices of a SkeletalMesh,
+///         captured with transform feedback, so that the mesh can be drawn by
+///         several passes while only being skinned once per frame.
+///
+/// \details Each frame, the skinning shaders are run over the mesh's vertices
+///         as points with rasterization disabled, one partition at a time,
+///         between beginCapture() and endCapture().  The skinning programs
+///         must capture a vec4 clip-space position followed by a vec4 color
+///         (see SkinnedVertex).  Afterwards, draw() draws the mesh's
+///         triangles from the captured vertices; the shader used only has to
+///         pass them through.
+class SkinnedVertexCache
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The layout of each captured vertex.  The attribute locations
+    ///         used by draw() are 0 for the position and 1 for the color.
+    struct SkinnedVertex
+    {
+        vec4 position;
+        color4 color;
+    };
+
+    explicit SkinnedVertexCache(const SkeletalMesh& mesh);
+    ~SkinnedVertexCache();
+
+    void beginCapture();
+    void captureVertices(size_t first_vertex, GLsizei vertex_count);
+    void endCapture();
+
+    void draw(GLsizei instance_count = 1) const;
+
+    GLuint getVertexBuffer() const;
+
+private:
+    SkinnedVertexCache(const SkinnedVertexCache&);              // non-copyable
+    SkinnedVertexCache& operator=(const SkinnedVertexCache&);   // non-copyable
+
+    const SkeletalMesh& mesh_;
+    GLuint vao_id_;
+    GLuint vbo_id_;
+};
+
+#endif
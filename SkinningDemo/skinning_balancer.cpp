@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_balancer.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of SkinningBalancer class functions.
+
+#include "skinning_balancer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/// The share tried first, to find out how long the CPU takes per instance.
+const float PROBE_SHARE = 1.0f / 16;
+
+/// The most the CPU is ever given, so the GPU always has instances to time.
+const float MAX_SHARE = 0.75f;
+
+/// Changes to the share smaller than this are ignored.
+const float MIN_CHANGE = 0.02f;
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts with every instance on the GPU.
+///
+/// \param  min_idle The fraction of the time the job threads have to be
+///         idle before the CPU takes on any more of the crowd.
+/// \param  interval The number of frames averaged before each change.
+SkinningBalancer::SkinningBalancer(double min_idle, size_t interval)
+    : min_idle_(min_idle),
+      interval_(std::max(interval, size_t(1))),
+      share_(0),
+      frame_count_(0),
+      settle_count_(0),
+      gpu_milliseconds_(0),
+      cpu_milliseconds_(0),
+      idle_total_(0),
+      gpu_instances_(0),
+      cpu_instances_(0),
+      idle_fraction_(1)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds a frame's timings to the average, and adjusts the share at
+///         the end of each interval.
+///
+/// \param  gpu_instances The instances the frame skinned on the GPU.
+/// \param  cpu_instances The instances it skinned on the CPU.
+/// \param  gpu_milliseconds The GPU time of the latest frame measured.
+/// \param  cpu_milliseconds The time spent skinning the CPU's instances.
+/// \param  idle_fraction How much of the frame the job threads spent idle,
+///         from 0 to 1.
+/// \return The fraction of the visible instances to skin on the CPU next.
+float SkinningBalancer::update(size_t gpu_instances, size_t cpu_instances, double gpu_milliseconds,
+                               double cpu_milliseconds, double idle_fraction)
+{
+    if (settle_count_ > 0)
+    {
+        --settle_count_;
+        return share_;
+    }
+
+    gpu_milliseconds_ += gpu_milliseconds;
+    cpu_milliseconds_ += cpu_milliseconds;
+    idle_total_ += idle_fraction;
+    gpu_instances_ += gpu_instances;
+    cpu_instances_ += cpu_instances;
+    if (++frame_count_ < interval_)
+        return share_;
+
+    idle_fraction_ = idle_total_ / frame_count_;
+    double gpu_per_instance = gpu_instances_ > 0 ? gpu_milliseconds_ / gpu_instances_ : 0;
+    double cpu_per_instance = cpu_instances_ > 0 ? cpu_milliseconds_ / cpu_instances_ : 0;
+    frame_count_ = 0;
+    gpu_milliseconds_ = 0;
+    cpu_milliseconds_ = 0;
+    idle_total_ = 0;
+    gpu_instances_ = 0;
+    cpu_instances_ = 0;
+
+    float target = share_;
+    if (idle_fraction_ < min_idle_)
+        target = share_ * 0.5f;
+    else if (cpu_per_instance <= 0)
+        target = gpu_per_instance > 0 ? PROBE_SHARE : share_;
+    else if (gpu_per_instance > 0)
+        target = float(gpu_per_instance / (gpu_per_instance + cpu_per_instance));
+
+    // halving moves straight there, so that a saturated CPU sheds its share
+    // as soon as possible.
+    float share = idle_fraction_ < min_idle_ || cpu_per_instance <= 0 ? target : share_ + (target - share_) * 0.5f;
+    share = std::min(std::max(share, 0.0f), MAX_SHARE);
+    if (share < MIN_CHANGE)
+        share = 0;
+    if (std::abs(share - share_) >= MIN_CHANGE || (share == 0 && share_ != 0))
+    {
+        share_ = share;
+        settle_count_ = SETTLE_FRAMES;
+    }
+
+    return share_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Puts every instance back on the GPU and forgets everything
+///         measured.
+void SkinningBalancer::reset()
+{
+    share_ = 0;
+    frame_count_ = 0;
+    settle_count_ = 0;
+    gpu_milliseconds_ = 0;
+    cpu_milliseconds_ = 0;
+    idle_total_ = 0;
+    gpu_instances_ = 0;
+    cpu_instances_ = 0;
+    idle_fraction_ = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the fraction of the visible instances chosen by the last
+///         update() to skin on the CPU.
+float SkinningBalancer::getCpuShare() const
+{
+    return share_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns how idle the job threads were over the last interval,
+///         from 0 to 1.
+double SkinningBalancer::getIdleFraction() const
+{
+    return idle_fraction_;
+}
@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_balancer.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the SkinningBalancer class.
+
+#ifndef SKINNING_BALANCER_H_
+#define SKINNING_BALANCER_H_
+
+#include "demo.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Chooses how much of the compute crowd to skin on the CPU
+///         instead, so that neither the GPU nor the CPU sits idle while the
+///         other is saturated.
+///
+/// \details Each frame gives it the GPU's time, the CPU share's time, how
+///         many instances each skinned, and how idle the CPU's job threads
+///         were.  They're averaged over an interval, and at the end of each
+///         the share is moved halfway towards the one which would take the
+///         GPU and the CPU equally long, if each one's time were
+///         proportional to its instances.  The GPU's time includes work
+///         which doesn't depend on the crowd, so the estimate is always a
+///         little eager; moving only halfway lets the later intervals
+///         correct it.
+///
+///         The CPU only takes on more once its threads were idle for at
+///         least min_idle of the interval; below that, it's saturated with
+///         the rest of the simulation, and the share is halved, back
+///         towards the GPU.  Without any CPU timings yet, a small share is
+///         tried first to measure them.  Changes smaller than a couple of
+///         percent are ignored, so the share settles rather than hunting,
+///         and the frames just after a change are left out of the next
+///         average, since GPU timings lag a few frames behind.
+class SkinningBalancer
+{
+public:
+    explicit SkinningBalancer(double min_idle = 0.25, size_t interval = 30);
+
+    float update(size_t gpu_instances, size_t cpu_instances, double gpu_milliseconds, double cpu_milliseconds,
+                 double idle_fraction);
+    void reset();
+
+    float getCpuShare() const;
+    double getIdleFraction() const;
+
+private:
+    static const size_t SETTLE_FRAMES = 3;  ///< Frames left out after a change.
+
+    double min_idle_;
+    size_t interval_;
+    float share_;                   ///< The fraction of the visible instances skinned on the CPU.
+    size_t frame_count_;            ///< Frames averaged so far this interval.
+    size_t settle_count_;           ///< Frames still to be left out.
+    double gpu_milliseconds_;       ///< The interval's total GPU time.
+    double cpu_milliseconds_;       ///< The interval's total time skinning the CPU's share.
+    double idle_total_;             ///< The total of the frames' idle fractions.
+    size_t gpu_instances_;          ///< The interval's total instances skinned on the GPU.
+    size_t cpu_instances_;          ///< And on the CPU.
+    double idle_fraction_;          ///< The last interval's average idle fraction.
+};
+
+#endif
@@ -0,0 +1,537 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_kernels.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the batched CPU skinning kernels.
+///
+/// \details Every kernel is built into the same binary, whatever the
+///         compiler targets, and getSkinningKernel() hands out the ones the
+///         CPU can run.  GCC and Clang compile each wider kernel for its
+///         own instruction set with a target attribute, rather than the
+///         whole file with -mavx2 and the like, so that none of the glm
+///         functions they call can be emitted with instructions the rest of
+///         the program can't run.  MSVC needs no flags to use the
+///         intrinsics at all.
+
+#include "skinning_kernels.h"
+
+#include <cstddef>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define KERNEL_TARGET(isa)
+#if _MSC_VER >= 1700
+#define SKINNING_KERNEL_AVX2
+#endif
+#if _MSC_VER >= 1910
+#define SKINNING_KERNEL_AVX512
+#endif
+#elif defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#include <immintrin.h>
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#define SKINNING_KERNEL_AVX2
+#define SKINNING_KERNEL_AVX512
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SKINNING_KERNEL_NEON
+#endif
+
+namespace {
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a * b + c, fused into a single instruction when the
+///         compiler targets FMA.
+inline __m128 multiplyAdd(__m128 a, __m128 b, __m128 c)
+{
+#ifdef __FMA__
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins vertices four at a time with SSE2.
+///
+/// \details Each group of four vertices is transposed into SoA registers, so
+///         that each lane of a register belongs to one vertex.  For each
+///         influence, the four vertices' joint matrices are gathered and
+///         transposed the same way; since the vertices are 2D, only columns
+///         0, 1 and 3 are needed.  The weighted blend is then a handful of
+///         multiply-adds, and the results are transposed back into
+///         SkinnedVertex order.  Any leftover vertices are handled by
+///         skinVerticesReference().
+void skinVerticesSse2(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                      CpuSkinner::SkinnedVertex* skinned)
+{
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t v = 0;
+    for (; v + 4 <= count; v += 4)
+    {
+        const Vertex* in = vertices + v;
+        __m128 x = _mm_setr_ps(in[0].position.x, in[1].position.x, in[2].position.x, in[3].position.x);
+        __m128 y = _mm_setr_ps(in[0].position.y, in[1].position.y, in[2].position.y, in[3].position.y);
+
+        __m128 px = zero, py = zero, pz = zero, pw = zero;
+        __m128 cr = zero, cg = zero, cb = zero, ca = zero;
+
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            __m128 w = _mm_setr_ps(in[0].joint_weights[i], in[1].joint_weights[i],
+                                   in[2].joint_weights[i], in[3].joint_weights[i]);
+            if (_mm_movemask_ps(_mm_cmpneq_ps(w, zero)) == 0)
+                continue;
+
+            // unused influences have a weight of 0, so they contribute
+            // nothing even though their joint is still gathered.
+            const float* m0 = &palette[in[0].joint_indices[i]][0][0];
+            const float* m1 = &palette[in[1].joint_indices[i]][0][0];
+            const float* m2 = &palette[in[2].joint_indices[i]][0][0];
+            const float* m3 = &palette[in[3].joint_indices[i]][0][0];
+
+            __m128 c0x = _mm_loadu_ps(m0),      c0y = _mm_loadu_ps(m1),      c0z = _mm_loadu_ps(m2),      c0w = _mm_loadu_ps(m3);
+            __m128 c1x = _mm_loadu_ps(m0 + 4),  c1y = _mm_loadu_ps(m1 + 4),  c1z = _mm_loadu_ps(m2 + 4),  c1w = _mm_loadu_ps(m3 + 4);
+            __m128 c3x = _mm_loadu_ps(m0 + 12), c3y = _mm_loadu_ps(m1 + 12), c3z = _mm_loadu_ps(m2 + 12), c3w = _mm_loadu_ps(m3 + 12);
+            _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+            _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+            _MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+            px = multiplyAdd(w, multiplyAdd(c0x, x, multiplyAdd(c1x, y, c3x)), px);
+            py = multiplyAdd(w, multiplyAdd(c0y, x, multiplyAdd(c1y, y, c3y)), py);
+            pz = multiplyAdd(w, multiplyAdd(c0z, x, multiplyAdd(c1z, y, c3z)), pz);
+            pw = multiplyAdd(w, multiplyAdd(c0w, x, multiplyAdd(c1w, y, c3w)), pw);
+
+            __m128 r = _mm_loadu_ps(&colors[in[0].joint_indices[i]].r);
+            __m128 g = _mm_loadu_ps(&colors[in[1].joint_indices[i]].r);
+            __m128 b = _mm_loadu_ps(&colors[in[2].joint_indices[i]].r);
+            __m128 a = _mm_loadu_ps(&colors[in[3].joint_indices[i]].r);
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+
+            cr = multiplyAdd(w, r, cr);
+            cg = multiplyAdd(w, g, cg);
+            cb = multiplyAdd(w, b, cb);
+            ca = multiplyAdd(w, a, ca);
+        }
+
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+        _MM_TRANSPOSE4_PS(cr, cg, cb, ca);
+
+        CpuSkinner::SkinnedVertex* out = skinned + v;
+        _mm_storeu_ps(&out[0].position.x, px); _mm_storeu_ps(&out[0].color.r, cr);
+        _mm_storeu_ps(&out[1].position.x, py); _mm_storeu_ps(&out[1].color.r, cg);
+        _mm_storeu_ps(&out[2].position.x, pz); _mm_storeu_ps(&out[2].color.r, cb);
+        _mm_storeu_ps(&out[3].position.x, pw); _mm_storeu_ps(&out[3].color.r, ca);
+    }
+
+    skinVerticesReference(vertices + v, count - v, palette, colors, skinned + v);
+}
+#endif
+
+#ifdef SKINNING_KERNEL_AVX2
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Loads four floats from each of two places, into the low and
+///         high halves of a register.
+KERNEL_TARGET("avx2,fma")
+inline __m256 loadHalves(const float* low, const float* high)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Transposes the four 4x4 blocks in each half of four registers,
+///         like _MM_TRANSPOSE4_PS on each half.
+KERNEL_TARGET("avx2,fma")
+inline void transposeHalves(__m256& r0, __m256& r1, __m256& r2, __m256& r3)
+{
+    __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+    __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+    r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins vertices eight at a time with AVX2 and FMA.
+///
+/// \details The same math as skinVerticesSse2(), with vertices 0-3 of each
+///         group of eight in the low halves of the registers and 4-7 in the
+///         high halves.  The matrices and colors are loaded and transposed
+///         a half at a time, which beats gathering them element by element,
+///         and each vertex's position and color are stored together.
+KERNEL_TARGET("avx2,fma")
+void skinVerticesAvx2(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                      CpuSkinner::SkinnedVertex* skinned)
+{
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t v = 0;
+    for (; v + 8 <= count; v += 8)
+    {
+        const Vertex* in = vertices + v;
+        __m256 x = _mm256_setr_ps(in[0].position.x, in[1].position.x, in[2].position.x, in[3].position.x,
+                                  in[4].position.x, in[5].position.x, in[6].position.x, in[7].position.x);
+        __m256 y = _mm256_setr_ps(in[0].position.y, in[1].position.y, in[2].position.y, in[3].position.y,
+                                  in[4].position.y, in[5].position.y, in[6].position.y, in[7].position.y);
+
+        // the position's x, y, z and w, then the color's r, g, b and a.
+        __m256 p[4] = { zero, zero, zero, zero };
+        __m256 c[4] = { zero, zero, zero, zero };
+
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            __m256 w = _mm256_setr_ps(in[0].joint_weights[i], in[1].joint_weights[i], in[2].joint_weights[i],
+                                      in[3].joint_weights[i], in[4].joint_weights[i], in[5].joint_weights[i],
+                                      in[6].joint_weights[i], in[7].joint_weights[i]);
+            if (_mm256_movemask_ps(_mm256_cmp_ps(w, zero, _CMP_NEQ_OQ)) == 0)
+                continue;
+
+            __m256 c0[4], c1[4], c3[4], rgba[4];
+            for (size_t k = 0; k < 4; ++k)
+            {
+                const float* low = &palette[in[k].joint_indices[i]][0][0];
+                const float* high = &palette[in[k + 4].joint_indices[i]][0][0];
+                c0[k] = loadHalves(low, high);
+                c1[k] = loadHalves(low + 4, high + 4);
+                c3[k] = loadHalves(low + 12, high + 12);
+                rgba[k] = loadHalves(&colors[in[k].joint_indices[i]].r, &colors[in[k + 4].joint_indices[i]].r);
+            }
+            transposeHalves(c0[0], c0[1], c0[2], c0[3]);
+            transposeHalves(c1[0], c1[1], c1[2], c1[3]);
+            transposeHalves(c3[0], c3[1], c3[2], c3[3]);
+            transposeHalves(rgba[0], rgba[1], rgba[2], rgba[3]);
+
+            for (size_t k = 0; k < 4; ++k)
+            {
+                p[k] = _mm256_fmadd_ps(w, _mm256_fmadd_ps(c0[k], x, _mm256_fmadd_ps(c1[k], y, c3[k])), p[k]);
+                c[k] = _mm256_fmadd_ps(w, rgba[k], c[k]);
+            }
+        }
+
+        // each half of p[k] and c[k] is now one vertex: k and k + 4.
+        transposeHalves(p[0], p[1], p[2], p[3]);
+        transposeHalves(c[0], c[1], c[2], c[3]);
+
+        CpuSkinner::SkinnedVertex* out = skinned + v;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            _mm256_storeu_ps(&out[k].position.x, _mm256_permute2f128_ps(p[k], c[k], 0x20));
+            _mm256_storeu_ps(&out[k + 4].position.x, _mm256_permute2f128_ps(p[k], c[k], 0x31));
+        }
+    }
+
+    skinVerticesReference(vertices + v, count - v, palette, colors, skinned + v);
+}
+#endif
+
+#ifdef SKINNING_KERNEL_AVX512
+// GCC 12's AVX-512 intrinsics pass undefined registers to its builtins,
+// which -Wmaybe-uninitialized mistakes for our own.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Loads four floats from each of four places, into the quarters
+///         of a register.
+KERNEL_TARGET("avx512f")
+inline __m512 loadQuarters(const float* q0, const float* q1, const float* q2, const float* q3)
+{
+    __m512 result = _mm512_castps128_ps512(_mm_loadu_ps(q0));
+    result = _mm512_insertf32x4(result, _mm_loadu_ps(q1), 1);
+    result = _mm512_insertf32x4(result, _mm_loadu_ps(q2), 2);
+    return _mm512_insertf32x4(result, _mm_loadu_ps(q3), 3);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Transposes the 4x4 blocks in each quarter of four registers,
+///         like _MM_TRANSPOSE4_PS on each quarter.
+KERNEL_TARGET("avx512f")
+inline void transposeQuarters(__m512& r0, __m512& r1, __m512& r2, __m512& r3)
+{
+    __m512 t0 = _mm512_unpacklo_ps(r0, r1), t1 = _mm512_unpackhi_ps(r0, r1);
+    __m512 t2 = _mm512_unpacklo_ps(r2, r3), t3 = _mm512_unpackhi_ps(r2, r3);
+    r0 = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    r1 = _mm512_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    r2 = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    r3 = _mm512_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins vertices sixteen at a time with AVX-512.
+///
+/// \details Like skinVerticesAvx2(), with vertices k, k + 4, k + 8 and
+///         k + 12 sharing each register's 4x4 blocks.  The results are
+///         stored a quarter at a time.
+KERNEL_TARGET("avx512f")
+void skinVerticesAvx512(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                        CpuSkinner::SkinnedVertex* skinned)
+{
+    const __m512 zero = _mm512_setzero_ps();
+
+    size_t v = 0;
+    for (; v + 16 <= count; v += 16)
+    {
+        const Vertex* in = vertices + v;
+        float xs[16], ys[16];
+        for (size_t k = 0; k < 16; ++k)
+        {
+            xs[k] = in[k].position.x;
+            ys[k] = in[k].position.y;
+        }
+        __m512 x = _mm512_loadu_ps(xs);
+        __m512 y = _mm512_loadu_ps(ys);
+
+        __m512 p[4] = { zero, zero, zero, zero };
+        __m512 c[4] = { zero, zero, zero, zero };
+
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            float ws[16];
+            for (size_t k = 0; k < 16; ++k)
+                ws[k] = in[k].joint_weights[i];
+            __m512 w = _mm512_loadu_ps(ws);
+            if (_mm512_cmp_ps_mask(w, zero, _CMP_NEQ_OQ) == 0)
+                continue;
+
+            __m512 c0[4], c1[4], c3[4], rgba[4];
+            for (size_t k = 0; k < 4; ++k)
+            {
+                const float* m0 = &palette[in[k].joint_indices[i]][0][0];
+                const float* m1 = &palette[in[k + 4].joint_indices[i]][0][0];
+                const float* m2 = &palette[in[k + 8].joint_indices[i]][0][0];
+                const float* m3 = &palette[in[k + 12].joint_indices[i]][0][0];
+                c0[k] = loadQuarters(m0, m1, m2, m3);
+                c1[k] = loadQuarters(m0 + 4, m1 + 4, m2 + 4, m3 + 4);
+                c3[k] = loadQuarters(m0 + 12, m1 + 12, m2 + 12, m3 + 12);
+                rgba[k] = loadQuarters(&colors[in[k].joint_indices[i]].r, &colors[in[k + 4].joint_indices[i]].r,
+                                       &colors[in[k + 8].joint_indices[i]].r, &colors[in[k + 12].joint_indices[i]].r);
+            }
+            transposeQuarters(c0[0], c0[1], c0[2], c0[3]);
+            transposeQuarters(c1[0], c1[1], c1[2], c1[3]);
+            transposeQuarters(c3[0], c3[1], c3[2], c3[3]);
+            transposeQuarters(rgba[0], rgba[1], rgba[2], rgba[3]);
+
+            for (size_t k = 0; k < 4; ++k)
+            {
+                p[k] = _mm512_fmadd_ps(w, _mm512_fmadd_ps(c0[k], x, _mm512_fmadd_ps(c1[k], y, c3[k])), p[k]);
+                c[k] = _mm512_fmadd_ps(w, rgba[k], c[k]);
+            }
+        }
+
+        // each quarter of p[k] and c[k] is now one vertex: k, k + 4, k + 8
+        // and k + 12.
+        transposeQuarters(p[0], p[1], p[2], p[3]);
+        transposeQuarters(c[0], c[1], c[2], c[3]);
+
+        CpuSkinner::SkinnedVertex* out = skinned + v;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            _mm_storeu_ps(&out[k].position.x, _mm512_extractf32x4_ps(p[k], 0));
+            _mm_storeu_ps(&out[k].color.r, _mm512_extractf32x4_ps(c[k], 0));
+            _mm_storeu_ps(&out[k + 4].position.x, _mm512_extractf32x4_ps(p[k], 1));
+            _mm_storeu_ps(&out[k + 4].color.r, _mm512_extractf32x4_ps(c[k], 1));
+            _mm_storeu_ps(&out[k + 8].position.x, _mm512_extractf32x4_ps(p[k], 2));
+            _mm_storeu_ps(&out[k + 8].color.r, _mm512_extractf32x4_ps(c[k], 2));
+            _mm_storeu_ps(&out[k + 12].position.x, _mm512_extractf32x4_ps(p[k], 3));
+            _mm_storeu_ps(&out[k + 12].color.r, _mm512_extractf32x4_ps(c[k], 3));
+        }
+    }
+
+    skinVerticesReference(vertices + v, count - v, palette, colors, skinned + v);
+}
+#endif
+
+#ifdef SKINNING_KERNEL_NEON
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns a * b + c; fused on AArch64, where NEON always has FMA.
+inline float32x4_t multiplyAdd(float32x4_t a, float32x4_t b, float32x4_t c)
+{
+#ifdef __aarch64__
+    return vfmaq_f32(c, a, b);
+#else
+    return vmlaq_f32(c, a, b);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Transposes four registers of four floats, like
+///         _MM_TRANSPOSE4_PS.
+inline void transpose4(float32x4_t& r0, float32x4_t& r1, float32x4_t& r2, float32x4_t& r3)
+{
+    float32x4x2_t t01 = vtrnq_f32(r0, r1);
+    float32x4x2_t t23 = vtrnq_f32(r2, r3);
+    r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins vertices four at a time with NEON; a port of
+///         skinVerticesSse2().
+void skinVerticesNeon(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                      CpuSkinner::SkinnedVertex* skinned)
+{
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+
+    size_t v = 0;
+    for (; v + 4 <= count; v += 4)
+    {
+        const Vertex* in = vertices + v;
+        float xs[4] = { in[0].position.x, in[1].position.x, in[2].position.x, in[3].position.x };
+        float ys[4] = { in[0].position.y, in[1].position.y, in[2].position.y, in[3].position.y };
+        float32x4_t x = vld1q_f32(xs);
+        float32x4_t y = vld1q_f32(ys);
+
+        float32x4_t px = zero, py = zero, pz = zero, pw = zero;
+        float32x4_t cr = zero, cg = zero, cb = zero, ca = zero;
+
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            float ws[4] = { in[0].joint_weights[i], in[1].joint_weights[i], in[2].joint_weights[i], in[3].joint_weights[i] };
+            if (ws[0] == 0.0f && ws[1] == 0.0f && ws[2] == 0.0f && ws[3] == 0.0f)
+                continue;
+            float32x4_t w = vld1q_f32(ws);
+
+            const float* m0 = &palette[in[0].joint_indices[i]][0][0];
+            const float* m1 = &palette[in[1].joint_indices[i]][0][0];
+            const float* m2 = &palette[in[2].joint_indices[i]][0][0];
+            const float* m3 = &palette[in[3].joint_indices[i]][0][0];
+
+            float32x4_t c0x = vld1q_f32(m0),      c0y = vld1q_f32(m1),      c0z = vld1q_f32(m2),      c0w = vld1q_f32(m3);
+            float32x4_t c1x = vld1q_f32(m0 + 4),  c1y = vld1q_f32(m1 + 4),  c1z = vld1q_f32(m2 + 4),  c1w = vld1q_f32(m3 + 4);
+            float32x4_t c3x = vld1q_f32(m0 + 12), c3y = vld1q_f32(m1 + 12), c3z = vld1q_f32(m2 + 12), c3w = vld1q_f32(m3 + 12);
+            transpose4(c0x, c0y, c0z, c0w);
+            transpose4(c1x, c1y, c1z, c1w);
+            transpose4(c3x, c3y, c3z, c3w);
+
+            px = multiplyAdd(w, multiplyAdd(c0x, x, multiplyAdd(c1x, y, c3x)), px);
+            py = multiplyAdd(w, multiplyAdd(c0y, x, multiplyAdd(c1y, y, c3y)), py);
+            pz = multiplyAdd(w, multiplyAdd(c0z, x, multiplyAdd(c1z, y, c3z)), pz);
+            pw = multiplyAdd(w, multiplyAdd(c0w, x, multiplyAdd(c1w, y, c3w)), pw);
+
+            float32x4_t r = vld1q_f32(&colors[in[0].joint_indices[i]].r);
+            float32x4_t g = vld1q_f32(&colors[in[1].joint_indices[i]].r);
+            float32x4_t b = vld1q_f32(&colors[in[2].joint_indices[i]].r);
+            float32x4_t a = vld1q_f32(&colors[in[3].joint_indices[i]].r);
+            transpose4(r, g, b, a);
+
+            cr = multiplyAdd(w, r, cr);
+            cg = multiplyAdd(w, g, cg);
+            cb = multiplyAdd(w, b, cb);
+            ca = multiplyAdd(w, a, ca);
+        }
+
+        transpose4(px, py, pz, pw);
+        transpose4(cr, cg, cb, ca);
+
+        CpuSkinner::SkinnedVertex* out = skinned + v;
+        vst1q_f32(&out[0].position.x, px); vst1q_f32(&out[0].color.r, cr);
+        vst1q_f32(&out[1].position.x, py); vst1q_f32(&out[1].color.r, cg);
+        vst1q_f32(&out[2].position.x, pz); vst1q_f32(&out[2].color.r, cb);
+        vst1q_f32(&out[3].position.x, pw); vst1q_f32(&out[3].color.r, ca);
+    }
+
+    skinVerticesReference(vertices + v, count - v, palette, colors, skinned + v);
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the most capable level up to max_level, in SimdLevel
+///         order, which has a kernel the CPU can run.
+SimdLevel chooseSkinningSimdLevel(SimdLevel max_level)
+{
+    for (int level = max_level; level > SIMD_LEVEL_SCALAR; --level)
+    {
+        if (getSkinningKernel(SimdLevel(level)) && isSimdLevelSupported(SimdLevel(level)))
+            return SimdLevel(level);
+    }
+    return SIMD_LEVEL_SCALAR;
+}
+
+SimdLevel skinning_level = chooseSkinningSimdLevel(SIMD_LEVEL_NEON);
+SkinningKernel skinning_kernel = getSkinningKernel(skinning_level);
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the kernel built for a SIMD level, or NULL if the
+///         compiler couldn't build one.  SIMD_LEVEL_SCALAR is
+///         skinVerticesReference().
+///
+/// \details The kernel may still need instructions this CPU doesn't have
+///         (see isSimdLevelSupported()).
+SkinningKernel getSkinningKernel(SimdLevel level)
+{
+    switch (level)
+    {
+    case SIMD_LEVEL_SCALAR:
+        return skinVerticesReference;
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    case SIMD_LEVEL_SSE2:
+        return skinVerticesSse2;
+#endif
+#ifdef SKINNING_KERNEL_AVX2
+    case SIMD_LEVEL_AVX2:
+        return skinVerticesAvx2;
+#endif
+#ifdef SKINNING_KERNEL_AVX512
+    case SIMD_LEVEL_AVX512:
+        return skinVerticesAvx512;
+#endif
+#ifdef SKINNING_KERNEL_NEON
+    case SIMD_LEVEL_NEON:
+        return skinVerticesNeon;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the SIMD level of the kernel skinVerticesBatched() uses.
+SimdLevel getSkinningSimdLevel()
+{
+    return skinning_level;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Limits skinVerticesBatched() to kernels up to a SIMD level, such
+///         as one given on the command line.
+///
+/// \details To begin with, the most capable kernel the CPU can run is used.
+///         This must be called before any skinning starts, since the
+///         kernel isn't switched atomically.
+///
+/// \param  max_level The most capable level to use, in SimdLevel order.
+/// \return The level chosen, which may be below max_level if the CPU
+///         doesn't support it, or there's no kernel for it.
+SimdLevel setSkinningSimdLevel(SimdLevel max_level)
+{
+    skinning_level = chooseSkinningSimdLevel(max_level);
+    skinning_kernel = getSkinningKernel(skinning_level);
+    return skinning_level;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins vertices with the most capable kernel allowed (see
+///         setSkinningSimdLevel()).
+///
+/// \param  vertices The vertices to skin.
+/// \param  count The number of vertices.
+/// \param  palette The precombined skinning palette.
+/// \param  colors The color of each joint.
+/// \param  skinned Receives count skinned vertices.
+void skinVerticesBatched(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                         CpuSkinner::SkinnedVertex* skinned)
+{
+    skinning_kernel(vertices, count, palette, colors, skinned);
+}
@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_kernels.h
+/// \author Ben Crist
+///
+/// \brief  The batched CPU skinning kernels for each SIMD level, and the
+///         runtime dispatch between them.
+
+#ifndef SKINNING_KERNELS_H_
+#define SKINNING_KERNELS_H_
+
+#include "cpu_features.h"
+#include "cpu_skinner.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Skins count vertices with a precombined palette and the joints'
+///         colors, like skinVerticesReference().
+typedef void (*SkinningKernel)(const Vertex* vertices, size_t count, const mat4* palette, const color4* colors,
+                               CpuSkinner::SkinnedVertex* skinned);
+
+SkinningKernel getSkinningKernel(SimdLevel level);
+
+SimdLevel getSkinningSimdLevel();
+SimdLevel setSkinningSimdLevel(SimdLevel max_level);
+
+#endif
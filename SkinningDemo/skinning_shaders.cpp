@@ -0,0 +1,1288 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_shaders.cpp
+/// \author Ben Crist
+///
+/// \brief  GLSL sources of the skinning shaders.
+
+#include "skinning_shaders.h"
+
+// The vertex shader source doesn't start with a #version directive because
+// the program compiling it adds one, followed by a #define for N_JOINTS, the
+// number of joints in the skeleton, N_INFLUENCES, the number of joint
+// influences to evaluate per vertex, and optionally PRECOMBINED_PALETTE,
+// DUAL_QUATERNION, AFFINE_2D, TEXTURE_PALETTE, INSTANCED_PALETTE or
+// BAKED_PALETTE, JOINT_LOCAL_POSITIONS,
+// VERTEX_COLORS, MORPH_TARGETS, NONUNIFORM_SCALE and SKINNED_VERTEX_CAPTURE.
+// generateSkinningVertexShader() builds that preamble from a
+// SkinningPermutation.
+//
+// When VERTEX_COLORS is defined, each vertex's color is read from an
+// attribute which the CPU has already blended from its joints' colors (see
+// VertexColorCache), instead of being blended from current_pose_colors for
+// every vertex of every frame.  The colors stay in the uniform block either
+// way, so the block's layout doesn't depend on it.
+//
+// When MORPH_TARGETS is defined, each vertex's morph target offset is added
+// to its bind-pose position before it's skinned.  The offsets are 16.16
+// fixed point, as written by morph_target_shader_source.
+//
+// When PRECOMBINED_PALETTE is defined, the CPU uploads a single palette of
+// current_pose * bind_pose_inv matrices, so each influence costs one matrix
+// fetch and one mat4 * vec4 instead of a mat4 * mat4 as well.
+//
+// When JOINT_LOCAL_POSITIONS is defined, there's no bind pose at all: the
+// palette is current_pose, as uploaded for the separate palettes, and each
+// influence skins the vertex's position in its own joint's space, baked
+// ahead of time (see JointLocalStream) and read from consecutive attributes
+// from location 11.  That's a position per influence in the vertex stream
+// for no bind_pose_inv uniforms and no precombining on the CPU.  The
+// normal and tangent are still in model space, and are turned by the
+// current pose alone, which is only right for a bind pose without rotation
+// or scale, like the benchmark's rigs.
+//
+// Either way, the matrices are affine, so their bottom rows are always
+// (0, 0, 0, 1); current_pose, skinning_palette and bind_pose_inv only hold
+// the top three rows of each one, as three vec4s (see packAffineRows()),
+// which fits a third more joints in the same uniform space.
+//
+// When DUAL_QUATERNION is defined, the palette is uploaded as a real/dual
+// vec4 pair per joint (8 floats instead of 16), plus a packed array of each
+// joint's uniform scale.
+//
+// When AFFINE_2D is defined, the palette is uploaded as the 3x2 matrices of
+// Affine2D, 6 floats per joint, tightly packed so that every two joints
+// fill three vec4s.  The joints only ever have uniform scale, so each
+// matrix's z scale is the length of its x axis.
+//
+// When TEXTURE_PALETTE is defined, the precombined palette is fetched from
+// the skinning_palette_texture texture buffer instead, 3 texels of affine
+// rows per joint, followed by a texel of color per joint.  There's no
+// SkinningPalette block at all, and nothing else sized by N_JOINTS, so the
+// skeleton can have as many joints as the texture buffer has room for,
+// rather than as fit in a uniform block; texture buffers only need GL 3.1,
+// unlike storage buffers.
+//
+// When INSTANCED_PALETTE is defined, the mesh is drawn with
+// glDrawElementsInstanced, and each instance's precombined palette (with the
+// instance's placement folded in) is fetched from the instance_palettes
+// texture buffer, 4 texels per matrix.  All instances share the colors in the
+// uniform block.  The palette is chosen by palette_index, an instanced
+// attribute which is just the instance index for ordinary instanced draws,
+// and the base instance for the RenderQueue's indirect draws.  The texture
+// buffer is a PaletteRing, so the palettes are counted from the frame's
+// region, palette_region.x matrices in, and then from the draw's level of
+// detail, palette_bases.x matrices further; neither is a uniform, but a
+// generic attribute, set once per frame and once per draw.  When
+// palette_region.z is set, instance_palettes holds half floats instead, 3
+// texels per matrix: the top three rows of each matrix, with its translation
+// relative to the instance's origin, which is fetched in full from
+// instance_origins, one texel per instance counting from palette_region.y
+// plus palette_bases.y (see packHalfPalette()).  With MOTION_VECTORS defined
+// as well, each vertex is skinned a second time from the previous frame's
+// palettes, which the PaletteRing keeps in the region before this frame's,
+// counted from previous_palette_region; the camera is folded into those
+// too, so the clip space positions it takes the vertex to this frame and
+// last are passed on to motion_vector_fragment_shader_source.  The palettes
+// are laid out by palette_index and palette_bases, so they're only the
+// same instances' if the frames' layouts match, which the CPU checks.
+//
+// When BAKED_PALETTE is defined, the mesh is drawn instanced too, but the
+// CPU doesn't build any palettes: every instance plays the same clip, baked
+// ahead of time into the baked_palettes texture (see BakedAnimation), 3
+// texels per matrix and one row per frame.  Each instance's placement and
+// time offset into the clip are fetched from the baked_instances texture
+// buffer, 4 texels per instance, by palette_index; the texture filtering
+// interpolates between the frames around the instance's time.  Only the
+// colors are left in the uniform block.
+//
+// The position is always read as a vec3; 2D meshes only upload x and y, and
+// GL fills in z = 0, so the same programs skin 2D and 3D meshes.
+//
+// A lower level of detail of the mesh is skinned by a reduced skeleton,
+// with N_LOD_JOINTS joints.  Its palettes only have a matrix for each of
+// those joints, but the colors in the uniform block are still the full
+// skeleton's, so each reduced joint's color is looked up through
+// source_joints.
+//
+// Otherwise the per-frame joint data lives in the SkinningPalette uniform
+// block, using the std140 layout so that the CPU can write it straight into a
+// UniformRingBuffer without querying offsets; arrays of mat4 and vec4 are
+// tightly packed in std140.  bind_pose_inv never changes, so it stays an
+// ordinary uniform.
+//
+// Each vertex is influenced by up to 4 joints, sorted by decreasing weight.
+// The mesh is drawn in partitions, each with a program compiled for the
+// number of influences its vertices actually use, so rigid parts only pay
+// for one influence.  The rigid partition's vertices follow their joint with
+// a weight of exactly 1 (see getPartitionInfluenceCount()), so with
+// N_INFLUENCES 1 the weights aren't read at all: the vertex is just
+// transformed by its joint's matrix, and takes its joint's color.
+//
+// Each vertex's normal and tangent are skinned by the upper 3x3 of the same
+// blended matrix as its position, and used to light its color.  The joints
+// only ever have uniform scale, so that matrix is fine for normals too, once
+// they're renormalized; no inverse is needed.  The exceptions are the baked
+// palettes, which don't store a z axis and so scale x and y but not z, and
+// any program compiled with NONUNIFORM_SCALE.  Those transform normals by
+// the matrix's cofactor matrix instead, which is its inverse transpose
+// scaled by its determinant: three cross products rather than an inverse.
+//
+// The skinned position is in world space, which the Camera uniform block
+// (see Camera) takes to clip space; every program drawing the scene shares
+// the one block.  The instances' palettes are the exception: the camera is
+// folded into them on the CPU along with each instance's placement, so
+// INSTANCED_PALETTE programs skip the block.  With SKINNED_VERTEX_CAPTURE
+// defined, the program is capturing its outputs into a SkinnedVertexCache,
+// and leaves gl_Position in world space for the passthrough program to
+// take through the camera.
+const std::string vertex_shader_source =
+    "#if !defined(TEXTURE_PALETTE)"                                         "\n"
+    "layout(std140) uniform SkinningPalette"                                "\n"
+    "{"                                                                     "\n"
+    "#if defined(DUAL_QUATERNION)"                                          "\n"
+    "   vec4 dq_palette[N_JOINTS * 2];"                                     "\n"
+    "   vec4 palette_scales[(N_JOINTS + 3) / 4];"                           "\n"
+    "#elif defined(AFFINE_2D)"                                              "\n"
+    "   vec4 affine_palette[(N_JOINTS * 3 + 1) / 2];"                       "\n"
+    "#elif defined(PRECOMBINED_PALETTE)"                                    "\n"
+    "   vec4 skinning_palette[N_JOINTS * 3];"                               "\n"
+    "#elif !defined(INSTANCED_PALETTE) && !defined(BAKED_PALETTE)"          "\n"
+    "   vec4 current_pose[N_JOINTS * 3];"                                   "\n"
+    "#endif"                                                                "\n"
+    "   vec4 current_pose_colors[N_JOINTS];"                                "\n"
+    "#if defined(PALETTE_BLEND)"                                            "\n"
+    "   vec4 previous_dq_palette[N_JOINTS * 2];"                            "\n"
+    "   vec4 previous_palette_scales[(N_JOINTS + 3) / 4];"                  "\n"
+    "   vec4 palette_blend;"                                                "\n"
+    "#endif"                                                                "\n"
+    "};"                                                                    "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "layout(std140) uniform Camera"                                         "\n"
+    "{"                                                                     "\n"
+    "   mat4 view_projection;"                                              "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "#if defined(N_LOD_JOINTS)"                                             "\n"
+    "uniform uint source_joints[N_LOD_JOINTS];"                             "\n"
+    "#define PALETTE_JOINTS N_LOD_JOINTS"                                   "\n"
+    "#define JOINT_COLOR(j) current_pose_colors[source_joints[j]]"          "\n"
+    "#elif defined(TEXTURE_PALETTE)"                                        "\n"
+    "#define PALETTE_JOINTS N_JOINTS"                                       "\n"
+    "#define JOINT_COLOR(j) texelFetch(skinning_palette_texture, N_JOINTS * 3 + int(j))" "\n"
+    "#else"                                                                 "\n"
+    "#define PALETTE_JOINTS N_JOINTS"                                       "\n"
+    "#define JOINT_COLOR(j) current_pose_colors[j]"                         "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "mat4 affineRowsMatrix(vec4 row0, vec4 row1, vec4 row2)"                "\n"
+    "{"                                                                     "\n"
+    "   return mat4(vec4(row0.x, row1.x, row2.x, 0),"                       "\n"
+    "               vec4(row0.y, row1.y, row2.y, 0),"                       "\n"
+    "               vec4(row0.z, row1.z, row2.z, 0),"                       "\n"
+    "               vec4(row0.w, row1.w, row2.w, 1));"                      "\n"
+    "}"                                                                     "\n"
+    "#define ROWS_MATRIX(rows, j) affineRowsMatrix(rows[int(j) * 3], rows[int(j) * 3 + 1], rows[int(j) * 3 + 2])" "\n"
+                                                                            "\n"
+    "#if defined(INSTANCED_PALETTE)"                                        "\n"
+    "uniform samplerBuffer instance_palettes;"                              "\n"
+    "uniform samplerBuffer instance_origins;"                               "\n"
+    "layout(location = 3) in uint palette_index;"                           "\n"
+    "layout(location = 8) in ivec2 palette_bases;"                          "\n"
+    "layout(location = 9) in ivec3 palette_region;"                         "\n"
+    "#ifdef MOTION_VECTORS"                                                 "\n"
+    "layout(location = 10) in ivec3 previous_palette_region;"               "\n"
+    "#endif"                                                                "\n"
+    "mat4 instanceJointMatrix(ivec3 region, uint joint)"                    "\n"
+    "{"                                                                     "\n"
+    "   int matrix = region.x + palette_bases.x + int(palette_index) * PALETTE_JOINTS + int(joint);" "\n"
+    "   if (region.z != 0)"                                                 "\n"
+    "   {"                                                                  "\n"
+    "      vec4 row0 = texelFetch(instance_palettes, matrix * 3);"          "\n"
+    "      vec4 row1 = texelFetch(instance_palettes, matrix * 3 + 1);"      "\n"
+    "      vec4 row2 = texelFetch(instance_palettes, matrix * 3 + 2);"      "\n"
+    "      vec3 origin = texelFetch(instance_origins, region.y + palette_bases.y + int(palette_index)).xyz;" "\n"
+    "      return affineRowsMatrix(row0 + vec4(0, 0, 0, origin.x),"         "\n"
+    "                              row1 + vec4(0, 0, 0, origin.y),"         "\n"
+    "                              row2 + vec4(0, 0, 0, origin.z));"        "\n"
+    "   }"                                                                  "\n"
+    "   int texel = matrix * 4;"                                            "\n"
+    "   return mat4(texelFetch(instance_palettes, texel),"                  "\n"
+    "               texelFetch(instance_palettes, texel + 1),"              "\n"
+    "               texelFetch(instance_palettes, texel + 2),"              "\n"
+    "               texelFetch(instance_palettes, texel + 3));"             "\n"
+    "}"                                                                     "\n"
+    "#define JOINT_MATRIX(j) instanceJointMatrix(palette_region, j)"        "\n"
+    "#elif defined(BAKED_PALETTE)"                                          "\n"
+    "uniform sampler2D baked_palettes;"                                     "\n"
+    "uniform samplerBuffer baked_instances;"                                "\n"
+    "uniform float baked_frame_rate;"                                       "\n"
+    "uniform float baked_time;"                                             "\n"
+    "layout(location = 3) in uint palette_index;"                           "\n"
+    "mat4 instance_placement;"                                              "\n"
+    "float baked_row;"                                                      "\n"
+    "void setUpBakedInstance()"                                             "\n"
+    "{"                                                                     "\n"
+    "   int texel = int(palette_index) * 4;"                                "\n"
+    "   instance_placement = mat4(texelFetch(baked_instances, texel),"      "\n"
+    "                             texelFetch(baked_instances, texel + 1),"  "\n"
+    "                             vec4(0, 0, 1, 0),"                        "\n"
+    "                             texelFetch(baked_instances, texel + 2));" "\n"
+    "   float time = baked_time + texelFetch(baked_instances, texel + 3).x;" "\n"
+    "   baked_row = (time * baked_frame_rate + 0.5) / float(textureSize(baked_palettes, 0).y);" "\n"
+    "}"                                                                     "\n"
+    "mat4 bakedJointMatrix(uint joint)"                                     "\n"
+    "{"                                                                     "\n"
+    "   float texel_width = 1.0 / float(textureSize(baked_palettes, 0).x);" "\n"
+    "   float x = (float(joint) * 3.0 + 0.5) * texel_width;"                "\n"
+    "   return mat4(texture(baked_palettes, vec2(x, baked_row)),"           "\n"
+    "               texture(baked_palettes, vec2(x + texel_width, baked_row))," "\n"
+    "               vec4(0, 0, 1, 0),"                                      "\n"
+    "               texture(baked_palettes, vec2(x + 2.0 * texel_width, baked_row)));" "\n"
+    "}"                                                                     "\n"
+    "#define JOINT_MATRIX(j) bakedJointMatrix(j)"                           "\n"
+    "#elif defined(AFFINE_2D)"                                              "\n"
+    "mat4 affineJointMatrix(uint joint)"                                    "\n"
+    "{"                                                                     "\n"
+    "   int base = int(joint / 2u) * 3;"                                    "\n"
+    "   vec4 axes;"                                                         "\n"
+    "   vec2 translation;"                                                  "\n"
+    "   if ((joint & 1u) == 0u)"                                            "\n"
+    "   {"                                                                  "\n"
+    "      axes = affine_palette[base];"                                    "\n"
+    "      translation = affine_palette[base + 1].xy;"                      "\n"
+    "   }"                                                                  "\n"
+    "   else"                                                               "\n"
+    "   {"                                                                  "\n"
+    "      axes = vec4(affine_palette[base + 1].zw, affine_palette[base + 2].xy);" "\n"
+    "      translation = affine_palette[base + 2].zw;"                      "\n"
+    "   }"                                                                  "\n"
+    "   return mat4(vec4(axes.xy, 0, 0),"                                   "\n"
+    "               vec4(axes.zw, 0, 0),"                                   "\n"
+    "               vec4(0, 0, length(axes.xy), 0),"                        "\n"
+    "               vec4(translation, 0, 1));"                              "\n"
+    "}"                                                                     "\n"
+    "#define JOINT_MATRIX(j) affineJointMatrix(j)"                          "\n"
+    "#elif defined(TEXTURE_PALETTE)"                                        "\n"
+    "uniform samplerBuffer skinning_palette_texture;"                       "\n"
+    "mat4 textureJointMatrix(uint joint)"                                   "\n"
+    "{"                                                                     "\n"
+    "   int texel = int(joint) * 3;"                                        "\n"
+    "   return affineRowsMatrix(texelFetch(skinning_palette_texture, texel)," "\n"
+    "                           texelFetch(skinning_palette_texture, texel + 1)," "\n"
+    "                           texelFetch(skinning_palette_texture, texel + 2));" "\n"
+    "}"                                                                     "\n"
+    "#define JOINT_MATRIX(j) textureJointMatrix(j)"                         "\n"
+    "#elif defined(PRECOMBINED_PALETTE)"                                    "\n"
+    "#define JOINT_MATRIX(j) ROWS_MATRIX(skinning_palette, j)"              "\n"
+    "#elif defined(JOINT_LOCAL_POSITIONS)"                                  "\n"
+    "layout(location = 11) in vec3 joint_local_positions[N_INFLUENCES];"    "\n"
+    "#define JOINT_MATRIX(j) ROWS_MATRIX(current_pose, j)"                  "\n"
+    "#elif !defined(DUAL_QUATERNION)"                                       "\n"
+    "uniform vec4 bind_pose_inv[N_JOINTS * 3];"                             "\n"
+    "#define JOINT_MATRIX(j) (ROWS_MATRIX(current_pose, j) * ROWS_MATRIX(bind_pose_inv, j))" "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "// The vertex inputs, position, joint_indices, joint_weights, normal"  "\n"
+    "// and tangent, are declared by generateSkinningVertexShader()."       "\n"
+    "#ifdef VERTEX_COLORS"                                                  "\n"
+    "layout(location = 4) in vec4 vertex_color;"                            "\n"
+    "#endif"                                                                "\n"
+    "#ifdef MORPH_TARGETS"                                                  "\n"
+    "layout(location = 5) in ivec2 morph_offset;"                           "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "out vec4 color;"                                                       "\n"
+    "#ifdef MOTION_VECTORS"                                                 "\n"
+    "out vec4 current_position;"                                            "\n"
+    "out vec4 previous_position;"                                           "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "// The light shines from in front of the mesh, up and to the left."    "\n"
+    "const vec3 LIGHT_DIRECTION = vec3(-0.4216, 0.5270, 0.7379);"           "\n"
+                                                                            "\n"
+    "// Diffuse lighting from the normal, plus an anisotropic highlight"    "\n"
+    "// across the tangent (Kajiya-Kay), seen from +z."                     "\n"
+    "float lightVertex(vec3 n, vec3 t)"                                     "\n"
+    "{"                                                                     "\n"
+    "   vec3 half_vector = normalize(LIGHT_DIRECTION + vec3(0, 0, 1));"     "\n"
+    "   float t_dot_h = dot(t, half_vector);"                               "\n"
+    "   float diffuse = 0.4 + 0.6 * max(dot(n, LIGHT_DIRECTION), 0.0);"     "\n"
+    "   float highlight = 0.3 * pow(sqrt(max(1.0 - t_dot_h * t_dot_h, 0.0)), 32.0);" "\n"
+    "   return diffuse + highlight;"                                        "\n"
+    "}"                                                                     "\n"
+                                                                            "\n"
+    "#if defined(DUAL_QUATERNION) && defined(PALETTE_BLEND)"                "\n"
+    "// the previous palette is negated where it's in the other hemisphere," "\n"
+    "// so each joint takes the shortest path from it."                     "\n"
+    "float previousWeight(uint joint)"                                      "\n"
+    "{"                                                                     "\n"
+    "   float weight = 1.0 - palette_blend.x;"                              "\n"
+    "   return dot(previous_dq_palette[2 * int(joint)], dq_palette[2 * int(joint)]) < 0.0 ? -weight : weight;" "\n"
+    "}"                                                                     "\n"
+    "vec4 dqReal(uint joint)"                                               "\n"
+    "{"                                                                     "\n"
+    "   return previousWeight(joint) * previous_dq_palette[2 * int(joint)] + palette_blend.x * dq_palette[2 * int(joint)];" "\n"
+    "}"                                                                     "\n"
+    "vec4 dqDual(uint joint)"                                               "\n"
+    "{"                                                                     "\n"
+    "   return previousWeight(joint) * previous_dq_palette[2 * int(joint) + 1] +" "\n"
+    "          palette_blend.x * dq_palette[2 * int(joint) + 1];"           "\n"
+    "}"                                                                     "\n"
+    "float jointScale(uint joint)"                                          "\n"
+    "{"                                                                     "\n"
+    "   return mix(previous_palette_scales[int(joint) / 4][int(joint) % 4]," "\n"
+    "              palette_scales[int(joint) / 4][int(joint) % 4], palette_blend.x);" "\n"
+    "}"                                                                     "\n"
+    "#elif defined(DUAL_QUATERNION)"                                        "\n"
+    "vec4 dqReal(uint joint) { return dq_palette[2 * int(joint)]; }"        "\n"
+    "vec4 dqDual(uint joint) { return dq_palette[2 * int(joint) + 1]; }"    "\n"
+    "float jointScale(uint joint) { return palette_scales[int(joint) / 4][int(joint) % 4]; }" "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "#ifdef MORPH_TARGETS"                                                  "\n"
+    "   vec4 vertex_coords = vec4(position + vec3(vec2(morph_offset) / 65536.0, 0), 1);" "\n"
+    "#else"                                                                 "\n"
+    "   vec4 vertex_coords = vec4(position, 1);"                            "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "#ifdef VERTEX_COLORS"                                                  "\n"
+    "   color = vertex_color;"                                              "\n"
+    "#elif N_INFLUENCES == 1"                                               "\n"
+    "   color = JOINT_COLOR(joint_indices[0]);"                             "\n"
+    "#else"                                                                 "\n"
+    "   color = vec4(0,0,0,0);"                                             "\n"
+    "   for (int i = 0; i < N_INFLUENCES; ++i)"                             "\n"
+    "      color += joint_weights[i] * JOINT_COLOR(joint_indices[i]);"     "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "#ifdef DUAL_QUATERNION"                                                "\n"
+    "   // Blend the dual quaternions of each joint affecting this vertex." "\n"
+    "   // Quaternions in the opposite hemisphere from the first joint's are" "\n"
+    "   // negated so the blend takes the shortest path, then the result is" "\n"
+    "   // normalized to get a rigid transform; no candy-wrapper collapse." "\n"
+    "   vec4 real_0 = dqReal(joint_indices[0]);"                            "\n"
+    "#if N_INFLUENCES == 1"                                                 "\n"
+    "   vec4 real = real_0;"                                                "\n"
+    "   vec4 dual = dqDual(joint_indices[0]);"                              "\n"
+    "   float scale = jointScale(joint_indices[0]);"                        "\n"
+    "#else"                                                                 "\n"
+    "   vec4 real = vec4(0,0,0,0);"                                         "\n"
+    "   vec4 dual = vec4(0,0,0,0);"                                         "\n"
+    "   float scale = 0.0;"                                                 "\n"
+    "   for (int i = 0; i < N_INFLUENCES; ++i)"                             "\n"
+    "   {"                                                                  "\n"
+    "      vec4 real_i = dqReal(joint_indices[i]);"                         "\n"
+    "      float weight = dot(real_0, real_i) < 0.0 ? -joint_weights[i] : joint_weights[i];" "\n"
+    "      real += weight * real_i;"                                        "\n"
+    "      dual += weight * dqDual(joint_indices[i]);"                      "\n"
+    "      scale += joint_weights[i] * jointScale(joint_indices[i]);"       "\n"
+    "   }"                                                                  "\n"
+    "   scale /= dot(joint_weights, vec4(1,1,1,1));"                        "\n"
+    "#endif"                                                                "\n"
+    "   float norm = length(real);"                                         "\n"
+    "   real /= norm;"                                                      "\n"
+    "   dual /= norm;"                                                      "\n"
+                                                                            "\n"
+    "   vec3 p = vertex_coords.xyz * scale;"                                "\n"
+    "   vec3 t = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));" "\n"
+    "   p += 2.0 * cross(real.xyz, cross(real.xyz, p) + real.w * p) + t;"   "\n"
+    "   gl_Position = vec4(p, 1);"                                          "\n"
+                                                                            "\n"
+    "   // the normal and tangent are only rotated; scale doesn't affect"   "\n"
+    "   // their directions."                                               "\n"
+    "   vec3 skinned_normal = normal + 2.0 * cross(real.xyz, cross(real.xyz, normal) + real.w * normal);" "\n"
+    "   vec3 skinned_tangent = tangent.xyz +"                               "\n"
+    "                          2.0 * cross(real.xyz, cross(real.xyz, tangent.xyz) + real.w * tangent.xyz);" "\n"
+    "#else"                                                                 "\n"
+    "   gl_Position = vec4(0,0,0,0);"                                       "\n"
+    "#ifdef BAKED_PALETTE"                                                  "\n"
+    "   setUpBakedInstance();"                                              "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "   // For each joint affecting this vertex, find the vertex's"         "\n"
+    "   // position relative to the joint in bind pose by using"            "\n"
+    "   // bind_pose_inv, then transform that position using the"           "\n"
+    "   // current pose transform to find the position where the"           "\n"
+    "   // vertex should be considering only that joint."                   "\n"
+    "   //"                                                                 "\n"
+    "   // Take the weighted average of the positions where each"           "\n"
+    "   // joint thinks the vertex should be, and that is the"              "\n"
+    "   // final vertex position."                                          "\n"
+    "   //"                                                                 "\n"
+    "   // The normal and tangent are transformed by the weighted average"  "\n"
+    "   // of the joints' matrices, which is the same thing."               "\n"
+    "   //"                                                                 "\n"
+    "   // A rigid vertex's one weight is exactly 1, so it's left out."     "\n"
+    "#if N_INFLUENCES == 1"                                                 "\n"
+    "   mat4 joint_matrix = JOINT_MATRIX(joint_indices[0]);"                "\n"
+    "#ifdef JOINT_LOCAL_POSITIONS"                                          "\n"
+    "   gl_Position = joint_matrix * vec4(joint_local_positions[0], 1);"    "\n"
+    "#else"                                                                 "\n"
+    "   gl_Position = joint_matrix * vertex_coords;"                        "\n"
+    "#endif"                                                                "\n"
+    "   mat3 skin = mat3(joint_matrix);"                                    "\n"
+    "#else"                                                                 "\n"
+    "   mat3 skin = mat3(0);"                                               "\n"
+    "   for (int i = 0; i < N_INFLUENCES; ++i)"                             "\n"
+    "   {"                                                                  "\n"
+    "      mat4 joint_matrix = JOINT_MATRIX(joint_indices[i]);"             "\n"
+    "#ifdef JOINT_LOCAL_POSITIONS"                                          "\n"
+    "      gl_Position += joint_weights[i] * (joint_matrix * vec4(joint_local_positions[i], 1));" "\n"
+    "#else"                                                                 "\n"
+    "      gl_Position += joint_weights[i] * (joint_matrix * vertex_coords);" "\n"
+    "#endif"                                                                "\n"
+    "      skin += joint_weights[i] * mat3(joint_matrix);"                  "\n"
+    "   }"                                                                  "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "#ifdef MOTION_VECTORS"                                                 "\n"
+    "   current_position = gl_Position;"                                    "\n"
+    "#if N_INFLUENCES == 1"                                                 "\n"
+    "   previous_position = instanceJointMatrix(previous_palette_region, joint_indices[0]) * vertex_coords;" "\n"
+    "#else"                                                                 "\n"
+    "   previous_position = vec4(0,0,0,0);"                                 "\n"
+    "   for (int i = 0; i < N_INFLUENCES; ++i)"                             "\n"
+    "      previous_position += joint_weights[i] *"                         "\n"
+    "         (instanceJointMatrix(previous_palette_region, joint_indices[i]) * vertex_coords);" "\n"
+    "#endif"                                                                "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "   // the baked palettes are shared by every instance, so each one's"  "\n"
+    "   // placement is applied once, to the skinned position."             "\n"
+    "#ifdef BAKED_PALETTE"                                                  "\n"
+    "   gl_Position = instance_placement * gl_Position;"                    "\n"
+    "   skin = mat3(instance_placement) * skin;"                            "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "#if defined(BAKED_PALETTE) || defined(NONUNIFORM_SCALE)"               "\n"
+    "   mat3 normal_matrix = mat3(cross(skin[1], skin[2]),"                 "\n"
+    "                             cross(skin[2], skin[0]),"                 "\n"
+    "                             cross(skin[0], skin[1]));"                "\n"
+    "#else"                                                                 "\n"
+    "   mat3 normal_matrix = skin;"                                         "\n"
+    "#endif"                                                                "\n"
+    "   vec3 skinned_normal = normal_matrix * normal;"                      "\n"
+    "   vec3 skinned_tangent = skin * tangent.xyz;"                         "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "   // the instances' palettes have the camera folded in already, and"  "\n"
+    "   // captured vertices are drawn through it by the passthrough program." "\n"
+    "#if !defined(INSTANCED_PALETTE) && !defined(SKINNED_VERTEX_CAPTURE)"   "\n"
+    "   gl_Position = view_projection * gl_Position;"                       "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "   color.rgb *= lightVertex(normalize(skinned_normal), normalize(skinned_tangent));" "\n"
+    "}"                                                                     "\n";
+
+// The #version directive is also added to the fragment shader.
+const std::string fragment_shader_source = 
+    "in vec4 color;"                                                    "\n"
+                                                                        "\n"
+    "layout(location = 0) out vec4 out_fragcolor;"                      "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   out_fragcolor = color;"                                         "\n"
+    "}"                                                                 "\n";
+
+// The motion vector permutations of the instanced crowd (see MOTION_VECTORS
+// above) are linked with this instead of fragment_shader_source.  Each
+// fragment's motion since the last frame is the difference of its divided
+// clip space positions, halved to be in texture coordinates as a TAA or
+// motion blur pass would sample the frame; it's written to the second
+// color output, for a target which has one, and shown in the first, the
+// x and y motion in red and green around a gray of no motion at all.
+const std::string motion_vector_fragment_shader_source =
+    "in vec4 color;"                                                    "\n"
+    "in vec4 current_position;"                                         "\n"
+    "in vec4 previous_position;"                                        "\n"
+                                                                        "\n"
+    "layout(location = 0) out vec4 out_fragcolor;"                      "\n"
+    "layout(location = 1) out vec2 out_motion;"                         "\n"
+                                                                        "\n"
+    "const float MOTION_VIEW_SCALE = 16.0;"                             "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   vec2 motion = 0.5 * (current_position.xy / current_position.w -" "\n"
+    "                        previous_position.xy / previous_position.w);" "\n"
+    "   out_motion = motion;"                                           "\n"
+    "   out_fragcolor = vec4(clamp(0.5 + MOTION_VIEW_SCALE * motion, 0.0, 1.0), 0.5, color.a);" "\n"
+    "}"                                                                 "\n";
+
+// The wireframe overlay is drawn in the same pass as the faces it outlines:
+// this geometry shader goes between any of the programs' vertex shaders
+// (they all output gl_Position and color) and
+// wireframe_fragment_shader_source, and gives each corner of each triangle
+// one of the barycentric axes.  They're interpolated without perspective, so
+// their screen-space derivatives are the same all over the triangle, and the
+// fragment shader can draw edges of a constant width in pixels.  Both get the
+// same #version directive as the vertex shader.
+const std::string wireframe_geometry_shader_source =
+    "layout(triangles) in;"                                             "\n"
+    "layout(triangle_strip, max_vertices = 3) out;"                     "\n"
+                                                                        "\n"
+    "in vec4 color[];"                                                  "\n"
+                                                                        "\n"
+    "out vec4 face_color;"                                              "\n"
+    "noperspective out vec3 barycentric;"                               "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   for (int i = 0; i < 3; ++i)"                                    "\n"
+    "   {"                                                              "\n"
+    "      gl_Position = gl_in[i].gl_Position;"                         "\n"
+    "      face_color = color[i];"                                      "\n"
+    "      barycentric = vec3(0,0,0);"                                  "\n"
+    "      barycentric[i] = 1.0;"                                       "\n"
+    "      EmitVertex();"                                               "\n"
+    "   }"                                                              "\n"
+    "   EndPrimitive();"                                                "\n"
+    "}"                                                                 "\n";
+
+// A fragment is on an edge when its distance to it, the smallest of its
+// barycentric coordinates, is within EDGE_WIDTH pixels; smoothstep over that
+// width antialiases the lines.  Each triangle draws its half of a shared
+// edge.
+const std::string wireframe_fragment_shader_source =
+    "in vec4 face_color;"                                               "\n"
+    "noperspective in vec3 barycentric;"                                "\n"
+                                                                        "\n"
+    "layout(location = 0) out vec4 out_fragcolor;"                      "\n"
+                                                                        "\n"
+    "const float EDGE_WIDTH = 1.0;"                                     "\n"
+    "const vec4 EDGE_COLOR = vec4(0.05, 0.05, 0.05, 1.0);"              "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   vec3 coverage = smoothstep(vec3(0,0,0), fwidth(barycentric) * EDGE_WIDTH, barycentric);" "\n"
+    "   float edge = 1.0 - min(min(coverage.x, coverage.y), coverage.z);" "\n"
+    "   out_fragcolor = mix(face_color, EDGE_COLOR, edge);"             "\n"
+    "}"                                                                 "\n";
+
+// When pre-skinning is enabled, the skinning vertex shader's gl_Position and
+// color outputs are captured into a SkinnedVertexCache, and the mesh is drawn
+// from there with this shader, which just passes them through the camera.
+// It draws the CPU skinner's vertices and the debug lines too, which are in
+// world space as well.
+const std::string passthrough_vertex_shader_source =
+    "layout(std140) uniform Camera"                                     "\n"
+    "{"                                                                 "\n"
+    "   mat4 view_projection;"                                          "\n"
+    "};"                                                                "\n"
+                                                                        "\n"
+    "layout(location = 0) in vec4 skinned_position;"                    "\n"
+    "layout(location = 1) in vec4 skinned_color;"                       "\n"
+                                                                        "\n"
+    "out vec4 color;"                                                   "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   color = skinned_color;"                                         "\n"
+    "   gl_Position = view_projection * skinned_position;"              "\n"
+    "}"                                                                 "\n";
+
+// On GL 4.3 contexts, the SKINNING_MODE_COMPUTE crowd is skinned by this
+// compute shader instead (see ComputeSkinner).  Each invocation skins one
+// vertex of one visible instance, reading the mesh's VBO directly as a
+// storage buffer; the program compiling it adds the #version directive,
+// N_JOINTS, and VERTEX_FORMAT_PACKED, VERTEX_FORMAT_PACKED_HALF or
+// VERTEX_FORMAT_QUANTIZED to match the mesh.  Quantized positions are left in
+// [-1, 1], for palettes built from folded inverse bind transforms.
+const std::string compute_skinning_shader_source =
+    "layout(local_size_x = 64) in;"                                         "\n"
+                                                                            "\n"
+    "struct SkinnedVertex"                                                  "\n"
+    "{"                                                                     "\n"
+    "   vec4 position;"                                                     "\n"
+    "   vec4 color;"                                                        "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "layout(std430, binding = 0) readonly buffer Vertices { uint vertex_data[]; };" "\n"
+    "layout(std430, binding = 1) readonly buffer Palettes { mat4 palettes[]; };" "\n"
+    "layout(std430, binding = 2) readonly buffer Colors { vec4 joint_colors[]; };" "\n"
+    "layout(std430, binding = 3) readonly buffer VisibleInstances { uint visible_instances[]; };" "\n"
+    "layout(std430, binding = 4) writeonly buffer SkinnedVertices { SkinnedVertex skinned_vertices[]; };" "\n"
+                                                                            "\n"
+    "uniform uint vertex_count;"                                            "\n"
+    "uniform uint work_count;"                                              "\n"
+                                                                            "\n"
+    "#if defined(VERTEX_FORMAT_PACKED_HALF)"                                "\n"
+    "const uint VERTEX_STRIDE = 5u;"                                        "\n"
+    "vec2 vertexPosition(uint base) { return unpackHalf2x16(vertex_data[base]); }" "\n"
+    "uint vertexJoints(uint base) { return vertex_data[base + 1u]; }"       "\n"
+    "vec4 vertexWeights(uint base) { return unpackUnorm4x8(vertex_data[base + 2u]); }" "\n"
+    "#elif defined(VERTEX_FORMAT_QUANTIZED)"                                "\n"
+    "const uint VERTEX_STRIDE = 5u;"                                        "\n"
+    "vec2 vertexPosition(uint base) { return unpackSnorm2x16(vertex_data[base]); }" "\n"
+    "uint vertexJoints(uint base) { return vertex_data[base + 1u]; }"       "\n"
+    "vec4 vertexWeights(uint base) { return unpackUnorm4x8(vertex_data[base + 2u]); }" "\n"
+    "#elif defined(VERTEX_FORMAT_PACKED)"                                   "\n"
+    "const uint VERTEX_STRIDE = 6u;"                                        "\n"
+    "vec2 vertexPosition(uint base) { return uintBitsToFloat(uvec2(vertex_data[base], vertex_data[base + 1u])); }" "\n"
+    "uint vertexJoints(uint base) { return vertex_data[base + 2u]; }"       "\n"
+    "vec4 vertexWeights(uint base) { return unpackUnorm4x8(vertex_data[base + 3u]); }" "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint id = gl_GlobalInvocationID.x;"                                 "\n"
+    "   if (id >= work_count)"                                              "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   uint slot = id / vertex_count;"                                     "\n"
+    "   uint vertex = id % vertex_count;"                                   "\n"
+    "   uint palette_base = visible_instances[slot] * uint(N_JOINTS);"      "\n"
+                                                                            "\n"
+    "#if defined(VERTEX_FORMAT_PACKED_HALF) || defined(VERTEX_FORMAT_PACKED) || defined(VERTEX_FORMAT_QUANTIZED)" "\n"
+    "   uint base = vertex * VERTEX_STRIDE;"                                "\n"
+    "   vec4 vertex_coords = vec4(vertexPosition(base), 0, 1);"             "\n"
+    "   uint packed_joints = vertexJoints(base);"                           "\n"
+    "   uvec4 joint_indices = (uvec4(packed_joints) >> uvec4(0, 8, 16, 24)) & 0xFFu;" "\n"
+    "   vec4 joint_weights = vertexWeights(base);"                          "\n"
+    "#else"                                                                 "\n"
+    "   // a full Vertex is 2 position floats, 4 uint indices, 4 float weights," "\n"
+    "   // and a 3 float normal and 4 float tangent, which aren't used here." "\n"
+    "   uint base = vertex * 17u;"                                          "\n"
+    "   vec4 vertex_coords = vec4(uintBitsToFloat(vertex_data[base]), uintBitsToFloat(vertex_data[base + 1u]), 0, 1);" "\n"
+    "   uvec4 joint_indices = uvec4(vertex_data[base + 2u], vertex_data[base + 3u], vertex_data[base + 4u], vertex_data[base + 5u]);" "\n"
+    "   vec4 joint_weights = uintBitsToFloat(uvec4(vertex_data[base + 6u], vertex_data[base + 7u], vertex_data[base + 8u], vertex_data[base + 9u]));" "\n"
+    "#endif"                                                                "\n"
+                                                                            "\n"
+    "   // influences are sorted by decreasing weight, so stop at the first" "\n"
+    "   // unused one."                                                     "\n"
+    "   SkinnedVertex skinned;"                                             "\n"
+    "   skinned.position = vec4(0,0,0,0);"                                  "\n"
+    "   skinned.color = vec4(0,0,0,0);"                                     "\n"
+    "   for (int i = 0; i < 4; ++i)"                                        "\n"
+    "   {"                                                                  "\n"
+    "      if (joint_weights[i] == 0.0)"                                    "\n"
+    "         break;"                                                       "\n"
+                                                                            "\n"
+    "      skinned.position += joint_weights[i] * (palettes[palette_base + joint_indices[i]] * vertex_coords);" "\n"
+    "      skinned.color += joint_weights[i] * joint_colors[joint_indices[i]];" "\n"
+    "   }"                                                                  "\n"
+                                                                            "\n"
+    "   skinned_vertices[id] = skinned;"                                    "\n"
+    "}"                                                                     "\n";
+
+// The compute crowd's vertex shader pulls its skinned vertices directly out
+// of the compute shader's output buffer.
+const std::string compute_draw_vertex_shader_source =
+    "struct SkinnedVertex"                                                  "\n"
+    "{"                                                                     "\n"
+    "   vec4 position;"                                                     "\n"
+    "   vec4 color;"                                                        "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "layout(std430, binding = 4) readonly buffer SkinnedVertices { SkinnedVertex skinned_vertices[]; };" "\n"
+                                                                            "\n"
+    "uniform uint vertex_count;"                                            "\n"
+                                                                            "\n"
+    "out vec4 color;"                                                       "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   SkinnedVertex skinned = skinned_vertices[uint(gl_InstanceID) * vertex_count + uint(gl_VertexID)];" "\n"
+    "   color = skinned.color;"                                             "\n"
+    "   gl_Position = skinned.position;"                                    "\n"
+    "}"                                                                     "\n";
+
+// ShadowPass draws the vertices a frame has already skinned into every one
+// of its cascades with a single draw, so nothing is skinned again per
+// cascade: the draw is instanced once per cascade, the vertex shader takes
+// each vertex through its instance's cascade transform, and the geometry
+// shader routes the triangle to that cascade's layer of the shadow map.
+// This vertex shader reads the world-space vertices of a SkinnedVertexCache
+// or the CPU skinner.  cascade_transforms must be as long as
+// ShadowPass::MAX_CASCADES.  The shaders get the same #version directive.
+const std::string shadow_vertex_shader_source =
+    "uniform mat4 cascade_transforms[4];"                               "\n"
+    "uniform int cascade_count;"                                        "\n"
+                                                                        "\n"
+    "layout(location = 0) in vec4 skinned_position;"                    "\n"
+                                                                        "\n"
+    "flat out int cascade;"                                             "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   cascade = gl_InstanceID % cascade_count;"                       "\n"
+    "   gl_Position = cascade_transforms[cascade] * skinned_position;"  "\n"
+    "}"                                                                 "\n";
+
+// The compute skinner's vertices are in the camera's clip space, since the
+// crowd's palettes have the camera folded in, so their cascade transforms
+// start with the inverse of the camera's.  Each visible instance is drawn
+// once per cascade (see ComputeSkinner::draw()).
+const std::string shadow_compute_vertex_shader_source =
+    "struct SkinnedVertex"                                                  "\n"
+    "{"                                                                     "\n"
+    "   vec4 position;"                                                     "\n"
+    "   vec4 color;"                                                        "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "layout(std430, binding = 4) readonly buffer SkinnedVertices { SkinnedVertex skinned_vertices[]; };" "\n"
+                                                                            "\n"
+    "uniform uint vertex_count;"                                            "\n"
+    "uniform mat4 cascade_transforms[4];"                                   "\n"
+    "uniform int cascade_count;"                                            "\n"
+                                                                            "\n"
+    "flat out int cascade;"                                                 "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint instance = uint(gl_InstanceID / cascade_count);"               "\n"
+    "   cascade = gl_InstanceID % cascade_count;"                           "\n"
+    "   vec4 position = skinned_vertices[instance * vertex_count + uint(gl_VertexID)].position;" "\n"
+    "   gl_Position = cascade_transforms[cascade] * position;"              "\n"
+    "}"                                                                     "\n";
+
+const std::string shadow_geometry_shader_source =
+    "layout(triangles) in;"                                             "\n"
+    "layout(triangle_strip, max_vertices = 3) out;"                     "\n"
+                                                                        "\n"
+    "flat in int cascade[];"                                            "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   for (int i = 0; i < 3; ++i)"                                    "\n"
+    "   {"                                                              "\n"
+    "      gl_Position = gl_in[i].gl_Position;"                         "\n"
+    "      gl_Layer = cascade[0];"                                      "\n"
+    "      EmitVertex();"                                               "\n"
+    "   }"                                                              "\n"
+    "   EndPrimitive();"                                                "\n"
+    "}"                                                                 "\n";
+
+const std::string shadow_fragment_shader_source =
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "}"                                                                 "\n";
+
+// OcclusionQueries draws each object's proxy through the camera with this:
+// a unit quad, taken over the object's bounds in world space by
+// proxy_transform.  Only the depth test matters, so the fragment shader is
+// shadow_fragment_shader_source.  Both get "#version 330".
+const std::string occlusion_proxy_vertex_shader_source =
+    "layout(std140) uniform Camera"                                     "\n"
+    "{"                                                                 "\n"
+    "   mat4 view_projection;"                                          "\n"
+    "};"                                                                "\n"
+                                                                        "\n"
+    "uniform mat4 proxy_transform;"                                     "\n"
+                                                                        "\n"
+    "layout(location = 0) in vec2 corner;"                              "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   gl_Position = view_projection * proxy_transform * vec4(corner, 0.0, 1.0);" "\n"
+    "}"                                                                 "\n";
+
+// The far instances of the instanced crowd can be drawn from an
+// ImpostorAtlas instead, with one instanced draw of a four vertex strip
+// and no vertex attributes at all.  Each instance is three texels of
+// impostor_instances: the x and y axes of its world transform, and its
+// origin, with the atlas frame it shows in w.  The quad covers the square
+// of impostor_radius around the origin, which the frames were drawn to
+// fill.  The program compiling it adds the #version directive.
+const std::string impostor_vertex_shader_source =
+    "layout(std140) uniform Camera"                                     "\n"
+    "{"                                                                 "\n"
+    "   mat4 view_projection;"                                          "\n"
+    "};"                                                                "\n"
+                                                                        "\n"
+    "uniform samplerBuffer impostor_instances;"                         "\n"
+    "uniform float impostor_radius;"                                    "\n"
+    "uniform ivec2 impostor_grid;   // the atlas's columns and rows"   "\n"
+                                                                        "\n"
+    "out vec2 atlas_coordinate;"                                        "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;" "\n"
+    "   int base = gl_InstanceID * 3;"                                  "\n"
+    "   vec4 x_axis = texelFetch(impostor_instances, base);"            "\n"
+    "   vec4 y_axis = texelFetch(impostor_instances, base + 1);"        "\n"
+    "   vec4 origin = texelFetch(impostor_instances, base + 2);"        "\n"
+                                                                        "\n"
+    "   vec3 position = origin.xyz + (x_axis.xyz * corner.x + y_axis.xyz * corner.y) * impostor_radius;" "\n"
+    "   gl_Position = view_projection * vec4(position, 1.0);"           "\n"
+                                                                        "\n"
+    "   int frame = int(origin.w);"                                     "\n"
+    "   vec2 cell = vec2(frame % impostor_grid.x, frame / impostor_grid.x);" "\n"
+    "   atlas_coordinate = (cell + corner * 0.5 + 0.5) / vec2(impostor_grid);" "\n"
+    "}"                                                                 "\n";
+
+// The frames are transparent black around the mesh, so a filtered texel at
+// its edge is darkened by as much as its alpha is lowered, which is divided
+// back out.  The edge is cut at half coverage, so the quads need no
+// blending or sorting.
+const std::string impostor_fragment_shader_source =
+    "uniform sampler2D impostor_atlas;"                                 "\n"
+                                                                        "\n"
+    "in vec2 atlas_coordinate;"                                         "\n"
+                                                                        "\n"
+    "layout(location = 0) out vec4 out_fragcolor;"                      "\n"
+                                                                        "\n"
+    "void main()"                                                       "\n"
+    "{"                                                                 "\n"
+    "   vec4 texel = texture(impostor_atlas, atlas_coordinate);"        "\n"
+    "   if (texel.a < 0.5)"                                             "\n"
+    "       discard;"                                                   "\n"
+    "   out_fragcolor = vec4(texel.rgb / texel.a, 1.0);"                "\n"
+    "}"                                                                 "\n";
+
+// Before the mesh is skinned, MorphTargetPass adds up its active morph
+// targets with this compute shader.  Each invocation adds one delta of one
+// active target to its vertex's offset: the active targets' ranges of the
+// delta buffer are laid end to end, and each target's work_start is where
+// its range begins, so an invocation finds its target with a binary
+// search.  Several targets can move the same vertex, so the offsets are
+// added with atomics, in 16.16 fixed point since there are no float
+// atomics; integer sums also come out the same whatever order they run in.
+// The program compiling it adds the #version directive.
+const std::string morph_target_shader_source =
+    "layout(local_size_x = 64) in;"                                         "\n"
+                                                                            "\n"
+    "struct ActiveTarget"                                                   "\n"
+    "{"                                                                     "\n"
+    "   uint first_delta;"                                                  "\n"
+    "   uint delta_count;"                                                  "\n"
+    "   uint work_start;"                                                   "\n"
+    "   float weight;"                                                      "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "// each delta is a uint vertex index and a vec2 delta, tightly packed." "\n"
+    "layout(std430, binding = 0) readonly buffer MorphDeltas { uint delta_data[]; };" "\n"
+    "layout(std430, binding = 1) readonly buffer ActiveTargets { ActiveTarget active_targets[]; };" "\n"
+    "layout(std430, binding = 2) buffer MorphOffsets { int morph_offsets[]; };" "\n"
+                                                                            "\n"
+    "uniform uint active_count;"                                            "\n"
+    "uniform uint work_count;"                                              "\n"
+    "uniform uint first_vertex;"                                            "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint id = gl_GlobalInvocationID.x;"                                 "\n"
+    "   if (id >= work_count)"                                              "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   // find the last target whose work starts at or before id."         "\n"
+    "   uint low = 0u;"                                                     "\n"
+    "   uint high = active_count;"                                          "\n"
+    "   while (high - low > 1u)"                                            "\n"
+    "   {"                                                                  "\n"
+    "      uint middle = (low + high) / 2u;"                                "\n"
+    "      if (active_targets[middle].work_start <= id)"                    "\n"
+    "         low = middle;"                                                "\n"
+    "      else"                                                            "\n"
+    "         high = middle;"                                               "\n"
+    "   }"                                                                  "\n"
+                                                                            "\n"
+    "   ActiveTarget target = active_targets[low];"                         "\n"
+    "   uint base = (target.first_delta + id - target.work_start) * 3u;"    "\n"
+    "   uint vertex = first_vertex + delta_data[base];"                     "\n"
+    "   vec2 delta = uintBitsToFloat(uvec2(delta_data[base + 1u], delta_data[base + 2u])) * target.weight;" "\n"
+    "   ivec2 fixed_delta = ivec2(round(delta * 65536.0));"                 "\n"
+                                                                            "\n"
+    "   atomicAdd(morph_offsets[vertex * 2u], fixed_delta.x);"              "\n"
+    "   atomicAdd(morph_offsets[vertex * 2u + 1u], fixed_delta.y);"         "\n"
+    "}"                                                                     "\n";
+
+// HierarchyComputePass converts joint transforms to model space with this
+// compute shader, one dispatch per level of the hierarchy.  Each invocation
+// multiplies one joint of the level by its parent, for the instance given by
+// the work group's y; the parents' level has always finished by then.  The
+// program compiling it adds the #version directive.
+const std::string hierarchy_shader_source =
+    "layout(local_size_x = 64) in;"                                         "\n"
+                                                                            "\n"
+    "// each instance's joints, indexed like the skeleton's."               "\n"
+    "layout(std430, binding = 0) buffer JointTransforms { mat4 transforms[]; };" "\n"
+    "// each joint of every level, and its parent."                         "\n"
+    "layout(std430, binding = 1) readonly buffer LevelEntries { uvec2 entries[]; };" "\n"
+                                                                            "\n"
+    "uniform uint first_entry;"                                             "\n"
+    "uniform uint entry_count;"                                             "\n"
+    "uniform uint joint_count;"                                             "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint id = gl_GlobalInvocationID.x;"                                 "\n"
+    "   if (id >= entry_count)"                                             "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   uvec2 entry = entries[first_entry + id];"                           "\n"
+    "   uint base = gl_GlobalInvocationID.y * joint_count;"                 "\n"
+    "   transforms[base + entry.x] = transforms[base + entry.y] * transforms[base + entry.x];" "\n"
+    "}"                                                                     "\n";
+
+// HierarchyComputePass expands compact local transforms (see
+// computeCompactLocalTransforms()) into matrices with this compute shader,
+// before converting them to model space.  Each invocation rebuilds one
+// joint's matrix, for the instance given by the work group's y.  The program
+// compiling it adds the #version directive.
+const std::string local_expand_shader_source =
+    "layout(local_size_x = 64) in;"                                         "\n"
+                                                                            "\n"
+    "layout(std430, binding = 0) writeonly buffer JointTransforms { mat4 transforms[]; };" "\n"
+    "// (cos * scale, sin * scale, x, y) for each joint of each instance."  "\n"
+    "layout(std430, binding = 1) readonly buffer CompactLocals { vec4 locals[]; };" "\n"
+                                                                            "\n"
+    "uniform uint joint_count;"                                             "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint joint = gl_GlobalInvocationID.x;"                              "\n"
+    "   if (joint >= joint_count)"                                          "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   uint index = gl_GlobalInvocationID.y * joint_count + joint;"        "\n"
+    "   vec4 local = locals[index];"                                        "\n"
+    "   transforms[index] = mat4(local.x, local.y, 0, 0,"                   "\n"
+    "                            -local.y, local.x, 0, 0,"                  "\n"
+    "                            0, 0, length(local.xy), 0,"                "\n"
+    "                            local.z, local.w, 0, 1);"                  "\n"
+    "}"                                                                     "\n";
+
+// HierarchyComputePass builds the compute crowd's palettes with this compute
+// shader, once its leaders' transforms are in model space.  Each invocation
+// writes one joint's palette matrix for the target given by the work
+// group's y: the target's placement, which has the camera folded in, times
+// its leader's transform, times the joint's inverse bind transform.  The
+// palettes are indexed by instance, as ComputeSkinner reads them.  The
+// program compiling it adds the #version directive.
+const std::string palette_resolve_shader_source =
+    "layout(local_size_x = 64) in;"                                         "\n"
+                                                                            "\n"
+    "struct PaletteTarget"                                                  "\n"
+    "{"                                                                     "\n"
+    "   mat4 placement;"                                                    "\n"
+    "   uint instance;"                                                     "\n"
+    "   uint leader;"                                                       "\n"
+    "   uint padding0;"                                                     "\n"
+    "   uint padding1;"                                                     "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "// each leader's joints in model space, indexed like the skeleton's."  "\n"
+    "layout(std430, binding = 0) readonly buffer JointTransforms { mat4 transforms[]; };" "\n"
+    "layout(std430, binding = 1) readonly buffer InverseBinds { mat4 inverse_binds[]; };" "\n"
+    "layout(std430, binding = 2) readonly buffer Targets { PaletteTarget targets[]; };" "\n"
+    "layout(std430, binding = 3) writeonly buffer Palettes { mat4 palettes[]; };" "\n"
+                                                                            "\n"
+    "uniform uint joint_count;"                                             "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint joint = gl_GlobalInvocationID.x;"                              "\n"
+    "   if (joint >= joint_count)"                                          "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   PaletteTarget target = targets[gl_GlobalInvocationID.y];"           "\n"
+    "   mat4 transform = transforms[target.leader * joint_count + joint];"  "\n"
+    "   palettes[target.instance * joint_count + joint] = target.placement * transform * inverse_binds[joint];" "\n"
+    "}"                                                                     "\n";
+
+// InstanceCullPass culls the instanced crowd on the GPU with this compute
+// shader.  Each invocation bounds one candidate instance in its current
+// pose, by transforming the bind-pose bounds of each joint of its level of
+// detail with the joint's palette matrix (which has the instance's
+// placement folded in), and tests the result against the viewport, which
+// covers -1 to 1 since the projection is the identity.  A surviving
+// instance counts itself into the instance_count of every indirect command
+// of its level, and the first count it gets back is its place in the
+// level's part of the survivor list, where it writes its palette index for
+// the draws' palette_index attribute.  The program compiling it adds the
+// #version directive.
+const std::string instance_cull_shader_source =
+    "layout(local_size_x = 64) in;"                                         "\n"
+                                                                            "\n"
+    "struct CullLod"                                                        "\n"
+    "{"                                                                     "\n"
+    "   uint palette_base;"                                                 "\n"
+    "   uint joint_count;"                                                  "\n"
+    "   uint first_bound;"                                                  "\n"
+    "   uint first_command;"                                                "\n"
+    "   uint command_count;"                                                "\n"
+    "   uint first_survivor;"                                               "\n"
+    "   uint padding0;"                                                     "\n"
+    "   uint padding1;"                                                     "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "// each candidate's level of detail and palette index."                "\n"
+    "layout(std430, binding = 0) readonly buffer Candidates { uvec2 candidates[]; };" "\n"
+    "// each joint's bind-pose bounds, as min.xy and max.xy."               "\n"
+    "layout(std430, binding = 1) readonly buffer JointBounds { vec4 joint_bounds[]; };" "\n"
+    "layout(std430, binding = 2) readonly buffer Lods { CullLod lods[]; };" "\n"
+    "// DrawElementsIndirectCommands, 5 uints each."                        "\n"
+    "layout(std430, binding = 3) buffer Commands { uint commands[]; };"     "\n"
+    "layout(std430, binding = 4) writeonly buffer Survivors { uint survivors[]; };" "\n"
+                                                                            "\n"
+    "uniform samplerBuffer instance_palettes;"                              "\n"
+    "uniform uint candidate_count;"                                         "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint id = gl_GlobalInvocationID.x;"                                 "\n"
+    "   if (id >= candidate_count)"                                         "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   uvec2 candidate = candidates[id];"                                  "\n"
+    "   CullLod lod = lods[candidate.x];"                                   "\n"
+    "   int first_texel = int(lod.palette_base + candidate.y * lod.joint_count) * 4;" "\n"
+                                                                            "\n"
+    "   vec2 low = vec2(3.0e38);"                                           "\n"
+    "   vec2 high = vec2(-3.0e38);"                                         "\n"
+    "   for (uint joint = 0u; joint < lod.joint_count; ++joint)"            "\n"
+    "   {"                                                                  "\n"
+    "      // joints which influence no vertices have empty bounds."        "\n"
+    "      vec4 bounds = joint_bounds[lod.first_bound + joint];"            "\n"
+    "      if (bounds.x > bounds.z || bounds.y > bounds.w)"                 "\n"
+    "         continue;"                                                    "\n"
+                                                                            "\n"
+    "      int texel = first_texel + int(joint) * 4;"                       "\n"
+    "      vec2 x_axis = texelFetch(instance_palettes, texel).xy;"          "\n"
+    "      vec2 y_axis = texelFetch(instance_palettes, texel + 1).xy;"      "\n"
+    "      vec2 origin = texelFetch(instance_palettes, texel + 3).xy;"      "\n"
+                                                                            "\n"
+    "      vec2 center = (bounds.xy + bounds.zw) * 0.5;"                    "\n"
+    "      vec2 extent = (bounds.zw - bounds.xy) * 0.5;"                    "\n"
+    "      center = origin + x_axis * center.x + y_axis * center.y;"        "\n"
+    "      extent = abs(x_axis) * extent.x + abs(y_axis) * extent.y;"       "\n"
+    "      low = min(low, center - extent);"                                "\n"
+    "      high = max(high, center + extent);"                              "\n"
+    "   }"                                                                  "\n"
+                                                                            "\n"
+    "   if (any(greaterThan(low, vec2(1.0))) || any(lessThan(high, vec2(-1.0))))" "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   uint place = atomicAdd(commands[lod.first_command * 5u + 1u], 1u);" "\n"
+    "   for (uint i = 1u; i < lod.command_count; ++i)"                      "\n"
+    "      atomicAdd(commands[(lod.first_command + i) * 5u + 1u], 1u);"     "\n"
+    "   survivors[lod.first_survivor + place] = candidate.y;"               "\n"
+    "}"                                                                     "\n";
+
+// MeshletCullPass culls a mesh's meshlets on the GPU with this compute
+// shader, for the instance given by the work group's y.  Each invocation
+// bounds one meshlet in the instance's pose, from the bind-pose bounds of
+// the vertices each of its joints influences, and tests it against the
+// viewport, then, if asked, tests whether its normal cone faces entirely
+// away with every joint's rotation.  A surviving meshlet adds its indices
+// to the count of its partition's command for the instance, and writes its
+// triangles as mesh vertex indices where the count it gets back says.  The
+// program compiling it adds the #version directive.
+const std::string meshlet_cull_shader_source =
+    "layout(local_size_x = 64) in;"                                         "\n"
+                                                                            "\n"
+    "struct CullMeshlet"                                                    "\n"
+    "{"                                                                     "\n"
+    "   uint first_vertex;"                                                 "\n"
+    "   uint vertex_count;"                                                 "\n"
+    "   uint first_triangle;"                                               "\n"
+    "   uint triangle_count;"                                               "\n"
+    "   uint first_joint;"                                                  "\n"
+    "   uint joint_count;"                                                  "\n"
+    "   uint mesh_partition;"                                               "\n"
+    "   uint padding;"                                                      "\n"
+    "   vec4 cone;"                                                         "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "layout(std430, binding = 0) readonly buffer Meshlets { CullMeshlet meshlets[]; };" "\n"
+    "// the mesh's index of each meshlet vertex."                           "\n"
+    "layout(std430, binding = 1) readonly buffer MeshletVertices { uint meshlet_vertices[]; };" "\n"
+    "// each triangle's three meshlet vertex indices, one per byte."        "\n"
+    "layout(std430, binding = 2) readonly buffer MeshletTriangles { uint meshlet_triangles[]; };" "\n"
+    "layout(std430, binding = 3) readonly buffer MeshletJoints { uint meshlet_joints[]; };" "\n"
+    "// each meshlet joint's bind-pose bounds, as min.xy and max.xy."       "\n"
+    "layout(std430, binding = 4) readonly buffer JointBounds { vec4 joint_bounds[]; };" "\n"
+    "layout(std430, binding = 5) readonly buffer Palettes { mat4 palettes[]; };" "\n"
+    "// DrawElementsIndirectCommands, 5 uints each."                        "\n"
+    "layout(std430, binding = 6) buffer Commands { uint commands[]; };"     "\n"
+    "layout(std430, binding = 7) writeonly buffer Indices { uint indices[]; };" "\n"
+                                                                            "\n"
+    "uniform uint meshlet_count;"                                           "\n"
+    "uniform uint joint_count;"                                             "\n"
+    "uniform uint max_instances;"                                           "\n"
+    "uniform bool cull_back_faces;"                                         "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint id = gl_GlobalInvocationID.x;"                                 "\n"
+    "   uint instance = gl_GlobalInvocationID.y;"                           "\n"
+    "   if (id >= meshlet_count)"                                           "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   CullMeshlet meshlet = meshlets[id];"                                "\n"
+    "   uint palette_base = instance * joint_count;"                        "\n"
+                                                                            "\n"
+    "   vec2 low = vec2(3.0e38);"                                           "\n"
+    "   vec2 high = vec2(-3.0e38);"                                         "\n"
+    "   bool back_facing = cull_back_faces && meshlet.cone.w < 1.0;"        "\n"
+    "   for (uint joint = 0u; joint < meshlet.joint_count; ++joint)"        "\n"
+    "   {"                                                                  "\n"
+    "      mat4 transform = palettes[palette_base + meshlet_joints[meshlet.first_joint + joint]];" "\n"
+    "      vec4 bounds = joint_bounds[meshlet.first_joint + joint];"        "\n"
+                                                                            "\n"
+    "      vec2 center = (bounds.xy + bounds.zw) * 0.5;"                    "\n"
+    "      vec2 extent = (bounds.zw - bounds.xy) * 0.5;"                    "\n"
+    "      center = transform[3].xy + transform[0].xy * center.x + transform[1].xy * center.y;" "\n"
+    "      extent = abs(transform[0].xy) * extent.x + abs(transform[1].xy) * extent.y;" "\n"
+    "      low = min(low, center - extent);"                                "\n"
+    "      high = max(high, center + extent);"                              "\n"
+                                                                            "\n"
+    "      if (back_facing)"                                                "\n"
+    "      {"                                                               "\n"
+    "         // normals move with the cofactor matrix."                    "\n"
+    "         vec3 axis = meshlet.cone.x * cross(transform[1].xyz, transform[2].xyz) +" "\n"
+    "                     meshlet.cone.y * cross(transform[2].xyz, transform[0].xyz) +" "\n"
+    "                     meshlet.cone.z * cross(transform[0].xyz, transform[1].xyz);" "\n"
+    "         float axis_length = length(axis);"                            "\n"
+    "         back_facing = axis_length > 0.0 && -axis.z > meshlet.cone.w * axis_length;" "\n"
+    "      }"                                                               "\n"
+    "   }"                                                                  "\n"
+                                                                            "\n"
+    "   if (back_facing || any(greaterThan(low, vec2(1.0))) || any(lessThan(high, vec2(-1.0))))" "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   uint command = meshlet.mesh_partition * max_instances + instance;"  "\n"
+    "   uint place = atomicAdd(commands[command * 5u], meshlet.triangle_count * 3u);" "\n"
+    "   uint first_index = commands[command * 5u + 2u] + place;"            "\n"
+    "   for (uint i = 0u; i < meshlet.triangle_count; ++i)"                 "\n"
+    "   {"                                                                  "\n"
+    "      uint triangle = meshlet_triangles[meshlet.first_triangle + i];"  "\n"
+    "      indices[first_index + i * 3u] = meshlet_vertices[meshlet.first_vertex + (triangle & 255u)];" "\n"
+    "      indices[first_index + i * 3u + 1u] = meshlet_vertices[meshlet.first_vertex + ((triangle >> 8) & 255u)];" "\n"
+    "      indices[first_index + i * 3u + 2u] = meshlet_vertices[meshlet.first_vertex + (triangle >> 16)];" "\n"
+    "   }"                                                                  "\n"
+    "}"                                                                     "\n";
+
+// decodeVertexBlocks() expands a mesh's vertices, packed into blocks by
+// encodeVertexBlocks(), straight into its vertex buffer with this compute
+// shader.  Each invocation assembles the 32-bit words of one vertex, field
+// by field: each channel's minimum over the vertex's block, plus the
+// vertex's difference from it, unpacked from the block's bits, with the
+// sign bit of a signed field flipped back.  The program compiling it adds
+// the #version directive.
+const std::string vertex_decode_shader_source =
+    "layout(local_size_x = 64) in;"                                         "\n"
+                                                                            "\n"
+    "layout(std430, binding = 0) readonly buffer VertexBlocks { uint blocks[]; };" "\n"
+    "layout(std430, binding = 1) writeonly buffer Vertices { uint vertices[]; };" "\n"
+                                                                            "\n"
+    "uniform uint vertex_count;"                                            "\n"
+    "uniform uint vertex_words;"                                            "\n"
+    "uniform uint first_word;"                                              "\n"
+    "uniform uint channel_count;"                                           "\n"
+    "// each channel's word, shift, bits and sign bit."                     "\n"
+    "uniform uvec4 channels[20];"                                           "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   uint id = gl_GlobalInvocationID.x;"                                 "\n"
+    "   if (id >= vertex_count)"                                            "\n"
+    "      return;"                                                         "\n"
+                                                                            "\n"
+    "   uint block = id / 64u;"                                             "\n"
+    "   uint lane = id % 64u;"                                              "\n"
+    "   uint block_vertices = min(64u, vertex_count - block * 64u);"        "\n"
+    "   uint header = blocks[block];"                                       "\n"
+    "   uint bit = (header + channel_count) * 32u;"                         "\n"
+                                                                            "\n"
+    "   uint words[6] = uint[6](0u, 0u, 0u, 0u, 0u, 0u);"                   "\n"
+    "   for (uint c = 0u; c < channel_count; ++c)"                          "\n"
+    "   {"                                                                  "\n"
+    "      uint code = blocks[header + c];"                                 "\n"
+    "      uint width = code >> 16;"                                        "\n"
+    "      uint value = code & 0xFFFFu;"                                    "\n"
+    "      if (width > 0u)"                                                 "\n"
+    "      {"                                                               "\n"
+    "         uint position = bit + lane * width;"                          "\n"
+    "         uint word = position >> 5;"                                   "\n"
+    "         uint shift = position & 31u;"                                 "\n"
+    "         uint bits = blocks[word] >> shift;"                           "\n"
+    "         if (shift + width > 32u)"                                     "\n"
+    "            bits |= blocks[word + 1u] << (32u - shift);"               "\n"
+    "         value += bits & ((1u << width) - 1u);"                        "\n"
+    "      }"                                                               "\n"
+    "      bit += block_vertices * width;"                                  "\n"
+                                                                            "\n"
+    "      uvec4 channel = channels[c];"                                    "\n"
+    "      words[channel.x] |= (value ^ channel.w) << channel.y;"           "\n"
+    "   }"                                                                  "\n"
+                                                                            "\n"
+    "   for (uint i = 0u; i < vertex_words; ++i)"                           "\n"
+    "      vertices[first_word + id * vertex_words + i] = words[i];"        "\n"
+    "}"                                                                     "\n";
+
+// SkinnedBoundsPass bounds the skinned vertices of SkinnedVertexCache or
+// ComputeSkinner with this compute shader.  Each invocation takes the min
+// and max of every stride'th vertex, brought into world space by
+// source_transform, then each workgroup reduces its invocations' in shared
+// memory, halving the number of active ones each step, and only its first
+// invocation touches the result: the floats' bits are reordered so that
+// unsigned integer order is float order, for atomicMin() and atomicMax().
+// The program compiling it adds the #version directive.
+const std::string skinned_bounds_shader_source =
+    "layout(local_size_x = 256) in;"                                        "\n"
+                                                                            "\n"
+    "struct SkinnedVertex"                                                  "\n"
+    "{"                                                                     "\n"
+    "   vec4 position;"                                                     "\n"
+    "   vec4 color;"                                                        "\n"
+    "};"                                                                    "\n"
+                                                                            "\n"
+    "layout(std430, binding = 0) readonly buffer SkinnedVertices { SkinnedVertex skinned_vertices[]; };" "\n"
+    "layout(std430, binding = 1) buffer Bounds { uint bounds[4]; };"        "\n"
+                                                                            "\n"
+    "uniform uint vertex_count;"                                            "\n"
+    "uniform mat4 source_transform;"                                        "\n"
+                                                                            "\n"
+    "shared vec2 group_min[256];"                                           "\n"
+    "shared vec2 group_max[256];"                                           "\n"
+                                                                            "\n"
+    "uint orderedBits(float value)"                                         "\n"
+    "{"                                                                     "\n"
+    "   uint bits = floatBitsToUint(value);"                                "\n"
+    "   return (bits & 0x80000000u) != 0u ? ~bits : bits | 0x80000000u;"    "\n"
+    "}"                                                                     "\n"
+                                                                            "\n"
+    "void main()"                                                           "\n"
+    "{"                                                                     "\n"
+    "   vec2 lo = vec2(3.402823e38);"                                       "\n"
+    "   vec2 hi = vec2(-3.402823e38);"                                      "\n"
+    "   uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;"             "\n"
+    "   for (uint i = gl_GlobalInvocationID.x; i < vertex_count; i += stride)" "\n"
+    "   {"                                                                  "\n"
+    "      vec4 position = source_transform * skinned_vertices[i].position;" "\n"
+    "      lo = min(lo, position.xy / position.w);"                         "\n"
+    "      hi = max(hi, position.xy / position.w);"                         "\n"
+    "   }"                                                                  "\n"
+                                                                            "\n"
+    "   uint local = gl_LocalInvocationID.x;"                               "\n"
+    "   group_min[local] = lo;"                                             "\n"
+    "   group_max[local] = hi;"                                             "\n"
+    "   memoryBarrierShared();"                                             "\n"
+    "   barrier();"                                                         "\n"
+    "   for (uint width = gl_WorkGroupSize.x / 2u; width > 0u; width /= 2u)" "\n"
+    "   {"                                                                  "\n"
+    "      if (local < width)"                                              "\n"
+    "      {"                                                               "\n"
+    "         group_min[local] = min(group_min[local], group_min[local + width]);" "\n"
+    "         group_max[local] = max(group_max[local], group_max[local + width]);" "\n"
+    "      }"                                                               "\n"
+    "      memoryBarrierShared();"                                          "\n"
+    "      barrier();"                                                      "\n"
+    "   }"                                                                  "\n"
+                                                                            "\n"
+    "   if (local == 0u)"                                                   "\n"
+    "   {"                                                                  "\n"
+    "      atomicMin(bounds[0], orderedBits(group_min[0].x));"              "\n"
+    "      atomicMin(bounds[1], orderedBits(group_min[0].y));"              "\n"
+    "      atomicMax(bounds[2], orderedBits(group_max[0].x));"              "\n"
+    "      atomicMax(bounds[3], orderedBits(group_max[0].y));"              "\n"
+    "   }"                                                                  "\n"
+    "}"                                                                     "\n";
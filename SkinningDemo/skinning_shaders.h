@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_shaders.h
+/// \author Ben Crist
+///
+/// \brief  GLSL sources of the skinning shaders, shared by the demo and the
+///         benchmark.
+///
+/// \details None of the sources start with a #version directive; see the
+///         comments on each in skinning_shaders.cpp for the directive and
+///         #defines the program compiling them has to prepend.
+
+#ifndef SKINNING_SHADERS_H_
+#define SKINNING_SHADERS_H_
+
+#include <string>
+
+extern const std::string vertex_shader_source;              ///< Skins in the vertex shader (GLSL 3.30).
+extern const std::string fragment_shader_source;            ///< Outputs the interpolated vertex color.
+extern const std::string wireframe_geometry_shader_source;  ///< Gives each triangle barycentric coordinates.
+extern const std::string wireframe_fragment_shader_source;  ///< Outlines each triangle over its color.
+extern const std::string motion_vector_fragment_shader_source;  ///< Outputs each fragment's motion since the last frame.
+extern const std::string passthrough_vertex_shader_source;  ///< Draws already-skinned vertices.
+extern const std::string compute_skinning_shader_source;    ///< Skins into a storage buffer (GLSL 4.30).
+extern const std::string compute_draw_vertex_shader_source; ///< Draws the compute shader's output.
+extern const std::string shadow_vertex_shader_source;       ///< Takes already-skinned vertices into each shadow cascade.
+extern const std::string shadow_compute_vertex_shader_source;   ///< The same, for the compute shader's output (GLSL 4.30).
+extern const std::string shadow_geometry_shader_source;     ///< Sends each triangle to its cascade's layer.
+extern const std::string shadow_fragment_shader_source;     ///< Writes only depth.
+extern const std::string occlusion_proxy_vertex_shader_source;  ///< Stretches a unit quad over an object's bounds.
+extern const std::string impostor_vertex_shader_source;     ///< Draws each far instance as a quad of an impostor atlas.
+extern const std::string impostor_fragment_shader_source;   ///< Samples the atlas, discarding what's outside the mesh.
+extern const std::string morph_target_shader_source;        ///< Adds up weighted morph target deltas (GLSL 4.30).
+extern const std::string hierarchy_shader_source;           ///< Converts one hierarchy level to model space (GLSL 4.30).
+extern const std::string local_expand_shader_source;        ///< Expands compact local transforms into matrices (GLSL 4.30).
+extern const std::string palette_resolve_shader_source;     ///< Builds placed palettes from model space transforms (GLSL 4.30).
+extern const std::string instance_cull_shader_source;       ///< Culls the instanced crowd into indirect draws (GLSL 4.30).
+extern const std::string meshlet_cull_shader_source;        ///< Culls a mesh's meshlets into indirect draws (GLSL 4.30).
+extern const std::string vertex_decode_shader_source;       ///< Expands packed vertex blocks into a vertex buffer (GLSL 4.30).
+extern const std::string skinned_bounds_shader_source;      ///< Reduces skinned vertices to their bounds (GLSL 4.30).
+
+#endif
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_stream.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of SkinningStream class functions.
+
+#include "skinning_stream.h"
+
+#include <cstring>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the stream's VAO and buffer, and splits the mesh's
+///         vertices into it.
+///
+/// \param  mesh The mesh to split.  It must outlive the stream.
+SkinningStream::SkinningStream(const SkeletalMeshBase& mesh)
+    : mesh_(mesh),
+      vao_id_(0),
+      vbo_id_(0),
+      vbo_size_(0)
+{
+    glGenVertexArrays(1, &vao_id_);
+    glGenBuffers(1, &vbo_id_);
+    update();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the stream's VAO and buffer.
+SkinningStream::~SkinningStream()
+{
+    glDeleteVertexArrays(1, &vao_id_);
+    glDeleteBuffers(1, &vbo_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Splits the mesh's uploaded vertices into the stream again, and
+///         points the VAO at the mesh's current IBO.
+///
+/// \details The vertices are read back from the mesh's VBO, so this works
+///         however the mesh was uploaded, including from a file or by
+///         streaming, but it waits for the GPU; it's meant for when the mesh
+///         has changed, not for every frame.  Does nothing to the buffer if
+///         the mesh isn't resident.
+void SkinningStream::update()
+{
+    if (!mesh_.isResident())
+        return;
+
+    size_t vertex_count = mesh_.getVertexCount();
+    size_t vertex_size = getVertexSize(mesh_.vertex_format);
+    size_t stream_vertex_size = getSkinningVertexSize(mesh_.vertex_format);
+
+    std::vector<char> vertices(vertex_count * vertex_size);
+    glBindBuffer(GL_COPY_READ_BUFFER, mesh_.vbo_id);
+    if (!vertices.empty())
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, GLsizeiptr(vertices.size()), vertices.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    // each vertex's skinning fields come first, so they're each vertex cut
+    // off before its normal.
+    std::vector<char> stream(vertex_count * stream_vertex_size);
+    for (size_t i = 0; i < vertex_count; ++i)
+        std::memcpy(&stream[i * stream_vertex_size], &vertices[i * vertex_size], stream_vertex_size);
+
+    vbo_size_ = GLsizeiptr(stream.size());
+
+    glBindVertexArray(vao_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    glBufferData(GL_ARRAY_BUFFER, vbo_size_, stream.empty() ? nullptr : stream.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_.ibo_id);
+    setVertexAttributes(mesh_.vertex_format, true);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the VAO which draws the mesh's partitions from the
+///         stream, with the mesh's indices.
+GLuint SkinningStream::getVertexArray() const
+{
+    return vao_id_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the stream's buffer, in bytes.
+GLsizeiptr SkinningStream::getBufferBytes() const
+{
+    return vbo_size_;
+}
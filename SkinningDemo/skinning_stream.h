@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  skinning_stream.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the SkinningStream class.
+
+#ifndef SKINNING_STREAM_H_
+#define SKINNING_STREAM_H_
+
+#include "skeletal_mesh.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A copy of just the fields of a mesh's vertices which skinning
+///         needs, split out of its interleaved VBO into a stream of their
+///         own, for passes which only need skinned positions.
+///
+/// \details The mesh's VBO interleaves each vertex's position, joint
+///         indices and weights with its normal and tangent, so a depth or
+///         shadow pass drawing from it fetches the whole vertex even though
+///         it only uses the first few fields; that's half or more of each
+///         vertex in every format (see getSkinningVertexSize()).  The stream
+///         holds only those fields, tightly packed in the mesh's format, and
+///         its VAO reads them with the mesh's attribute locations and
+///         indices from the mesh's IBO, leaving the normal, tangent and
+///         vertex color attributes disabled, so the same skinning programs
+///         and partitions draw from it.  The secondary attributes stay in the
+///         mesh's own VBO, and the vertex colors in their own buffer (see
+///         VertexColorCache), for the passes which shade.
+///
+///         The mesh's VBO is what the compute skinner, the mesh arena and
+///         in-place edits address by vertex, so it isn't rearranged; the
+///         stream is split from it instead, and update() has to be called
+///         again whenever the mesh is uploaded again.
+class SkinningStream
+{
+public:
+    explicit SkinningStream(const SkeletalMeshBase& mesh);
+    ~SkinningStream();
+
+    void update();
+
+    GLuint getVertexArray() const;
+    GLsizeiptr getBufferBytes() const;
+
+private:
+    SkinningStream(const SkinningStream&);              // non-copyable
+    SkinningStream& operator=(const SkinningStream&);   // non-copyable
+
+    const SkeletalMeshBase& mesh_;
+    GLuint vao_id_;
+    GLuint vbo_id_;
+    GLsizeiptr vbo_size_;
+};
+
+#endif
@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  spline_kernels.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the cubic stream interpolation functions.
+///
+/// \details Each element of a stream is a separate curve, with its own
+///         control values and its own interpolation factor, so a clip's
+///         curves can all be sampled in one call however their keys fall.
+///         The results match glm::catmullRom() and glm::hermite() from
+///         gtx/spline.hpp, which only work on vectors, to within rounding.
+
+#include "spline_kernels.h"
+#include "demo.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Interpolates each element along the uniform Catmull-Rom spline
+///         through its four control values, as glm::catmullRom().
+///
+/// \details The curve passes through p1 at s == 0 and p2 at s == 1, and its
+///         tangents there are half of (p2 - p0) and (p3 - p1), so the curve
+///         through a track of keys is smooth across each one.
+///
+/// \param  p0 The stream of values before the first of each pair.
+/// \param  p1 The stream of values to use when s == 0.
+/// \param  p2 The stream of values to use when s == 1.
+/// \param  p3 The stream of values after the second of each pair.
+/// \param  s The stream of interpolation factors, from 0 to 1.
+/// \param  out The stream which receives the results.  It may alias any of
+///         the others.
+/// \param  count The number of floats in each stream.
+void catmullRomStream(const float* p0, const float* p1, const float* p2, const float* p3,
+                      const float* s, float* out, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128 four = _mm_set1_ps(4.0f);
+    const __m128 five = _mm_set1_ps(5.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 s1 = _mm_loadu_ps(s + i);
+        __m128 s2 = _mm_mul_ps(s1, s1);
+        __m128 s3 = _mm_mul_ps(s2, s1);
+
+        __m128 f1 = _mm_sub_ps(_mm_mul_ps(two, s2), _mm_add_ps(s3, s1));
+        __m128 f2 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(three, s3), _mm_mul_ps(five, s2)), two);
+        __m128 f3 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(four, s2), _mm_mul_ps(three, s3)), s1);
+        __m128 f4 = _mm_sub_ps(s3, s2);
+
+        __m128 sum = _mm_mul_ps(f1, _mm_loadu_ps(p0 + i));
+        sum = _mm_add_ps(sum, _mm_mul_ps(f2, _mm_loadu_ps(p1 + i)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(f3, _mm_loadu_ps(p2 + i)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(f4, _mm_loadu_ps(p3 + i)));
+        _mm_storeu_ps(out + i, _mm_mul_ps(sum, half));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        float s1 = s[i];
+        float s2 = s1 * s1;
+        float s3 = s2 * s1;
+
+        float f1 = 2.0f * s2 - s3 - s1;
+        float f2 = 3.0f * s3 - 5.0f * s2 + 2.0f;
+        float f3 = 4.0f * s2 - 3.0f * s3 + s1;
+        float f4 = s3 - s2;
+        out[i] = 0.5f * (f1 * p0[i] + f2 * p1[i] + f3 * p2[i] + f4 * p3[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Interpolates each element along the cubic Hermite curve between
+///         two values with given tangents, as glm::hermite().
+///
+/// \details The tangents are the curve's slopes with respect to s, so a
+///         slope per second must be multiplied by the length of the
+///         interval, in seconds, first.
+///
+/// \param  v1 The stream of values to use when s == 0.
+/// \param  t1 The stream of tangents at s == 0.
+/// \param  v2 The stream of values to use when s == 1.
+/// \param  t2 The stream of tangents at s == 1.
+/// \param  s The stream of interpolation factors, from 0 to 1.
+/// \param  out The stream which receives the results.  It may alias any of
+///         the others.
+/// \param  count The number of floats in each stream.
+void hermiteStream(const float* v1, const float* t1, const float* v2, const float* t2,
+                   const float* s, float* out, size_t count)
+{
+    size_t i = 0;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 three = _mm_set1_ps(3.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 s1 = _mm_loadu_ps(s + i);
+        __m128 s2 = _mm_mul_ps(s1, s1);
+        __m128 s3 = _mm_mul_ps(s2, s1);
+
+        __m128 f1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(two, s3), _mm_mul_ps(three, s2)), one);
+        __m128 f2 = _mm_sub_ps(_mm_mul_ps(three, s2), _mm_mul_ps(two, s3));
+        __m128 f3 = _mm_add_ps(_mm_sub_ps(s3, _mm_mul_ps(two, s2)), s1);
+        __m128 f4 = _mm_sub_ps(s3, s2);
+
+        __m128 sum = _mm_mul_ps(f1, _mm_loadu_ps(v1 + i));
+        sum = _mm_add_ps(sum, _mm_mul_ps(f2, _mm_loadu_ps(v2 + i)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(f3, _mm_loadu_ps(t1 + i)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(f4, _mm_loadu_ps(t2 + i)));
+        _mm_storeu_ps(out + i, sum);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        float s1 = s[i];
+        float s2 = s1 * s1;
+        float s3 = s2 * s1;
+
+        float f1 = 2.0f * s3 - 3.0f * s2 + 1.0f;
+        float f2 = 3.0f * s2 - 2.0f * s3;
+        float f3 = s3 - 2.0f * s2 + s1;
+        float f4 = s3 - s2;
+        out[i] = f1 * v1[i] + f2 * v2[i] + f3 * t1[i] + f4 * t2[i];
+    }
+}
@@ -0,0 +1,20 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  spline_kernels.h
+/// \author Ben Crist
+///
+/// \brief  Functions for interpolating streams of values along cubic
+///         curves.
+
+#ifndef SPLINE_KERNELS_H_
+#define SPLINE_KERNELS_H_
+
+#include <cstddef>
+
+void catmullRomStream(const float* p0, const float* p1, const float* p2, const float* p3,
+                      const float* s, float* out, size_t count);
+
+void hermiteStream(const float* v1, const float* t1, const float* v2, const float* t2,
+                   const float* s, float* out, size_t count);
+
+#endif
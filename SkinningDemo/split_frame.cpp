@@ -0,0 +1,345 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  split_frame.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of InstanceSplit, SplitFrameTarget and
+///         SplitFrameCompositor class functions.
+
+#include "split_frame.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+const double InstanceSplit::SMOOTHING = 0.2;
+
+namespace {
+
+// a single triangle covering the viewport, with no vertex buffer.
+const char* const COMPOSITE_VERTEX_SHADER_SOURCE =
+    "#version 330\n"
+    "out vec2 uv;\n"
+    "void main()\n"
+    "{\n"
+    "   vec2 corner = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1));\n"
+    "   uv = corner * 0.5;\n"
+    "   gl_Position = vec4(corner - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+const char* const COMPOSITE_FRAGMENT_SHADER_SOURCE =
+    "#version 330\n"
+    "uniform sampler2D layer;\n"
+    "in vec2 uv;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "   color = texture(layer, uv);\n"
+    "}\n";
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits for a fence to signal.
+void waitForFence(GLsync fence)
+{
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);    // 1 ms
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a split with every renderer unmeasured, so the first
+///         frame is split evenly.
+InstanceSplit::InstanceSplit(size_t renderer_count)
+    : milliseconds_per_instance_(renderer_count > 0 ? renderer_count : 1, 0.0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Divides the instances between the renderers.
+///
+/// \param  first_instances Receives renderer_count + 1 entries: renderer i
+///         draws the instances from first_instances[i] up to, but not
+///         including, first_instances[i + 1].  A slow renderer may get
+///         none.
+void InstanceSplit::split(size_t instance_count, std::vector<size_t>& first_instances) const
+{
+    size_t renderer_count = milliseconds_per_instance_.size();
+
+    double measured_total = 0;
+    size_t measured_count = 0;
+    for (size_t i = 0; i < renderer_count; ++i)
+    {
+        if (milliseconds_per_instance_[i] > 0)
+        {
+            measured_total += milliseconds_per_instance_[i];
+            ++measured_count;
+        }
+    }
+    double average = measured_count > 0 ? measured_total / measured_count : 1.0;
+
+    // each renderer's share is its speed, in instances per millisecond.
+    std::vector<double> speeds(renderer_count);
+    double total_speed = 0;
+    for (size_t i = 0; i < renderer_count; ++i)
+    {
+        double cost = milliseconds_per_instance_[i] > 0 ? milliseconds_per_instance_[i] : average;
+        speeds[i] = 1.0 / cost;
+        total_speed += speeds[i];
+    }
+
+    first_instances.resize(renderer_count + 1);
+    first_instances[0] = 0;
+    double cumulative_speed = 0;
+    for (size_t i = 0; i < renderer_count; ++i)
+    {
+        cumulative_speed += speeds[i];
+        size_t end = size_t(instance_count * (cumulative_speed / total_speed) + 0.5);
+        first_instances[i + 1] = std::min(std::max(end, first_instances[i]), instance_count);
+    }
+    first_instances[renderer_count] = instance_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records how long a renderer took to draw its share of a frame.
+///
+/// \details The time should cover the renderer's whole share, from its
+///         first draw to its layer being fetched, so that a GPU which reads
+///         back slowly is given less to do.  A renderer which drew nothing
+///         tells us nothing, and is ignored.
+void InstanceSplit::record(size_t renderer, size_t instance_count, double milliseconds)
+{
+    if (renderer >= milliseconds_per_instance_.size() || instance_count == 0)
+        return;
+
+    double cost = std::max(milliseconds, 0.0) / instance_count;
+    if (cost <= 0)
+        return;
+
+    double& smoothed = milliseconds_per_instance_[renderer];
+    smoothed = smoothed > 0 ? smoothed + (cost - smoothed) * SMOOTHING : cost;
+}
+
+size_t InstanceSplit::getRendererCount() const
+{
+    return milliseconds_per_instance_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty layer.
+SplitFrameLayer::SplitFrameLayer()
+    : width(0),
+      height(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the framebuffer and its pixel pack buffer, on the
+///         current context.
+///
+/// \details If the framebuffer is incomplete, the problem is reported to
+///         stderr and an exception is thrown.
+SplitFrameTarget::SplitFrameTarget(GLsizei width, GLsizei height)
+    : width_(width),
+      height_(height),
+      framebuffer_id_(0),
+      renderbuffer_id_(0),
+      buffer_id_(0),
+      fence_(0)
+{
+    glGenRenderbuffers(1, &renderbuffer_id_);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_id_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer_id_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer_id_);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(1, &buffer_id_);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer_id_);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(width_) * height_ * 4, nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        glDeleteBuffers(1, &buffer_id_);
+        glDeleteFramebuffers(1, &framebuffer_id_);
+        glDeleteRenderbuffers(1, &renderbuffer_id_);
+
+        std::cerr << "The split frame framebuffer is incomplete!" << std::endl
+                  << "  Size: " << width_ << "x" << height_ << std::endl;
+        throw std::runtime_error("The split frame framebuffer is incomplete!");
+    }
+}
+
+SplitFrameTarget::~SplitFrameTarget()
+{
+    if (fence_ != 0)
+        glDeleteSync(fence_);
+    glDeleteBuffers(1, &buffer_id_);
+    glDeleteFramebuffers(1, &framebuffer_id_);
+    glDeleteRenderbuffers(1, &renderbuffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Binds the framebuffer and sets the viewport to cover it, then
+///         clears it to transparent black.
+///
+/// \details The blend function is changed to blend alpha separately, with
+///         GL_ONE, so that what's drawn over transparent black comes out
+///         premultiplied, as the compositor needs.  Colors blend just as
+///         they would with glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).
+void SplitFrameTarget::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glViewport(0, 0, width_, height_);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Queues a copy of what has been drawn, for fetch() to collect,
+///         and flushes, so the GPU starts on it while the caller moves on to
+///         the other renderers.
+void SplitFrameTarget::readBack()
+{
+    if (fence_ != 0)
+        glDeleteSync(fence_);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_id_);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer_id_);
+    glReadPixels(0, 0, width_, height_, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Waits for the last readBack() to finish, and copies it into a
+///         layer.
+///
+/// \details Throws if nothing has been read back, or the buffer couldn't be
+///         mapped.
+void SplitFrameTarget::fetch(SplitFrameLayer& layer)
+{
+    if (fence_ == 0)
+        throw std::logic_error("The split frame target hasn't been read back.");
+
+    waitForFence(fence_);
+    glDeleteSync(fence_);
+    fence_ = 0;
+
+    size_t image_size = size_t(width_) * height_ * 4;
+    layer.width = width_;
+    layer.height = height_;
+    layer.pixels.resize(image_size);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer_id_);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(image_size), GL_MAP_READ_BIT);
+    if (data == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        std::cerr << "Failed to map the split frame readback!" << std::endl;
+        throw std::runtime_error("Failed to map pixel pack buffer!");
+    }
+    std::memcpy(layer.pixels.data(), data, image_size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+GLsizei SplitFrameTarget::getWidth() const
+{
+    return width_;
+}
+
+GLsizei SplitFrameTarget::getHeight() const
+{
+    return height_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compiles the compositing program, on the current context.
+SplitFrameCompositor::SplitFrameCompositor()
+    : program_id_(0),
+      vao_id_(0),
+      texture_id_(0),
+      texture_width_(0),
+      texture_height_(0)
+{
+    program_id_ = compileShaderProgram(COMPOSITE_VERTEX_SHADER_SOURCE, COMPOSITE_FRAGMENT_SHADER_SOURCE);
+    glUseProgram(program_id_);
+    glUniform1i(glGetUniformLocation(program_id_, "layer"), 0);
+    glUseProgram(0);
+
+    // core profiles won't draw without a vertex array, even an empty one.
+    glGenVertexArrays(1, &vao_id_);
+
+    glGenTextures(1, &texture_id_);
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+SplitFrameCompositor::~SplitFrameCompositor()
+{
+    glDeleteTextures(1, &texture_id_);
+    glDeleteVertexArrays(1, &vao_id_);
+    glDeleteProgram(program_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws a layer over the whole viewport of the bound framebuffer.
+///
+/// \details The blend function is left as it was, and blending is left
+///         enabled.
+void SplitFrameCompositor::composite(const SplitFrameLayer& layer)
+{
+    if (layer.width <= 0 || layer.height <= 0)
+        return;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (layer.width != texture_width_ || layer.height != texture_height_)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, layer.width, layer.height, 0, GL_BGRA, GL_UNSIGNED_BYTE,
+                     layer.pixels.data());
+        texture_width_ = layer.width;
+        texture_height_ = layer.height;
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, layer.width, layer.height, GL_BGRA, GL_UNSIGNED_BYTE,
+                        layer.pixels.data());
+    }
+
+    GLint source_rgb, destination_rgb, source_alpha, destination_alpha;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &source_rgb);
+    glGetIntegerv(GL_BLEND_DST_RGB, &destination_rgb);
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &source_alpha);
+    glGetIntegerv(GL_BLEND_DST_ALPHA, &destination_alpha);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(program_id_);
+    glBindVertexArray(vao_id_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBlendFuncSeparate(source_rgb, destination_rgb, source_alpha, destination_alpha);
+}
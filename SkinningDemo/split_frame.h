@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  split_frame.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the InstanceSplit, SplitFrameTarget and
+///         SplitFrameCompositor classes, which share the drawing of a crowd
+///         between several GL contexts, each possibly on its own GPU.
+
+#ifndef SPLIT_FRAME_H_
+#define SPLIT_FRAME_H_
+
+#include "demo.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Divides a crowd's instances between renderers, in proportion to
+///         how quickly each has been drawing them.
+///
+/// \details Each renderer gets a contiguous range of the instances, in
+///         renderer order, so that compositing the renderers' layers in the
+///         same order draws the instances in the order a single renderer
+///         would have; the demo blends without a depth buffer, so that order
+///         matters.
+///
+///         A renderer's cost per instance is smoothed over frames, so one
+///         slow frame doesn't move a lot of instances about.  Until a
+///         renderer has been measured, it's assumed to be as fast as the
+///         average of the ones which have.
+class InstanceSplit
+{
+public:
+    explicit InstanceSplit(size_t renderer_count);
+
+    void split(size_t instance_count, std::vector<size_t>& first_instances) const;
+    void record(size_t renderer, size_t instance_count, double milliseconds);
+
+    size_t getRendererCount() const;
+
+    static const double SMOOTHING;
+
+private:
+    std::vector<double> milliseconds_per_instance_; ///< Each renderer's smoothed cost, or 0 until it's measured.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One renderer's share of a frame, as it's handed from the context
+///         which drew it to the one which presents it.
+///
+/// \details GL contexts on different GPUs can't share objects, so the layer
+///         goes through memory.  Its pixels are premultiplied, so layers can
+///         be composited over each other in order.
+struct SplitFrameLayer
+{
+    SplitFrameLayer();
+
+    GLsizei width;
+    GLsizei height;
+    std::vector<unsigned char> pixels;  ///< width * height premultiplied BGRA pixels, bottom row first.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  An offscreen framebuffer a secondary context draws its share of
+///         a frame into, which is read back asynchronously as a layer.
+///
+/// \details readBack() only queues the copy into a pixel pack buffer, so a
+///         presenting thread can start every renderer's frame before
+///         fetching any of their layers, and the GPUs draw at the same time.
+///
+///         Must be created, used and destroyed with its own context current.
+class SplitFrameTarget
+{
+public:
+    SplitFrameTarget(GLsizei width, GLsizei height);
+    ~SplitFrameTarget();
+
+    void bind();
+    void readBack();
+    void fetch(SplitFrameLayer& layer);
+
+    GLsizei getWidth() const;
+    GLsizei getHeight() const;
+
+private:
+    SplitFrameTarget(const SplitFrameTarget&);              // non-copyable
+    SplitFrameTarget& operator=(const SplitFrameTarget&);   // non-copyable
+
+    GLsizei width_;
+    GLsizei height_;
+    GLuint framebuffer_id_;
+    GLuint renderbuffer_id_;
+    GLuint buffer_id_;
+    GLsync fence_;          ///< After the glReadPixels() into the buffer, or 0 if nothing's being read back.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Draws layers from the other renderers into the presenting
+///         context's framebuffer.
+///
+/// \details Each layer is uploaded into a texture and drawn over whatever
+///         is in the bound framebuffer, with premultiplied alpha, so the
+///         presenting context can draw its own share first and composite
+///         the rest over it in renderer order.  The texture is only
+///         reallocated when the layers change size.
+///
+///         Must be created, used and destroyed with the presenting context
+///         current.
+class SplitFrameCompositor
+{
+public:
+    SplitFrameCompositor();
+    ~SplitFrameCompositor();
+
+    void composite(const SplitFrameLayer& layer);
+
+private:
+    SplitFrameCompositor(const SplitFrameCompositor&);              // non-copyable
+    SplitFrameCompositor& operator=(const SplitFrameCompositor&);   // non-copyable
+
+    GLuint program_id_;
+    GLuint vao_id_;
+    GLuint texture_id_;
+    GLsizei texture_width_;
+    GLsizei texture_height_;
+};
+
+#endif
@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  thread_pool.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of ThreadPool class functions.
+
+#include "thread_pool.h"
+#include "trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Starts the pool's worker threads.
+///
+/// \param  thread_count The total number of threads which run tasks,
+///         including the thread calling parallelFor().  If 0, one thread is
+///         used per hardware thread.
+ThreadPool::ThreadPool(size_t thread_count)
+    : queues_(nullptr),
+      queue_count_(0),
+      task_(nullptr),
+      generation_(0),
+      busy_workers_(0),
+      stopping_(false)
+{
+    if (thread_count == 0)
+        thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0)
+        thread_count = 1;
+
+    queue_count_ = thread_count;
+    queues_ = new TaskQueue[queue_count_];
+    for (size_t i = 0; i < queue_count_; ++i)
+        queues_[i].begin = queues_[i].end = 0;
+
+    threads_.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i)
+        threads_.push_back(std::thread(&ThreadPool::workerMain, this, i));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Stops and joins all of the worker threads.
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); ++i)
+        threads_[i].join();
+
+    delete[] queues_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs task(0) through task(task_count - 1) across all of the
+///         pool's threads, and returns once all of them have finished.
+///
+/// \details The tasks may run in any order, and must not throw.  Only one
+///         thread may call parallelFor() at a time.
+///
+/// \param  task_count The number of tasks to run.
+/// \param  task The function to call with each task index.
+void ThreadPool::parallelFor(size_t task_count, const std::function<void(size_t)>& task)
+{
+    if (task_count == 0)
+        return;
+
+    if (threads_.empty())
+    {
+        for (size_t i = 0; i < task_count; ++i)
+            task(i);
+        return;
+    }
+
+    for (size_t i = 0; i < queue_count_; ++i)
+    {
+        std::lock_guard<std::mutex> lock(queues_[i].mutex);
+        queues_[i].begin = task_count * i / queue_count_;
+        queues_[i].end = task_count * (i + 1) / queue_count_;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        busy_workers_ = threads_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+
+    runTasks(0);
+
+    // the workers may still be running tasks they stole, even though every
+    // queue is empty by now.
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (busy_workers_ > 0)
+        finished_.wait(lock);
+
+    task_ = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the total number of threads which run tasks, including
+///         the calling thread.
+size_t ThreadPool::getThreadCount() const
+{
+    return queue_count_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The main loop of each worker thread; waits for each new batch of
+///         tasks, then helps run it.
+///
+/// \param  queue The index of the thread's own task queue.
+void ThreadPool::workerMain(size_t queue)
+{
+    TRACE_THREAD("thread pool worker");
+    size_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!stopping_ && generation_ == generation)
+                start_.wait(lock);
+
+            if (stopping_)
+                return;
+
+            generation = generation_;
+        }
+
+        runTasks(queue);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_workers_ == 0)
+            finished_.notify_one();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs tasks from a thread's own queue until it's empty, then
+///         steals tasks from the other queues until they're all empty.
+///
+/// \param  queue The index of the calling thread's own task queue.
+void ThreadPool::runTasks(size_t queue)
+{
+    const std::function<void(size_t)>& task = *task_;
+    size_t index;
+
+    while (takeTask(queue, false, index))
+        task(index);
+
+    // no new tasks are added during a batch, so once a full pass over the
+    // other queues finds nothing, there's nothing left to do.
+    bool found = true;
+    while (found)
+    {
+        found = false;
+        for (size_t i = 1; i < queue_count_; ++i)
+        {
+            size_t victim = (queue + i) % queue_count_;
+            while (takeTask(victim, true, index))
+            {
+                task(index);
+                found = true;
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Removes the next task from one of the queues.
+///
+/// \param  queue The index of the queue to take the task from.
+/// \param  steal If true, the task is taken from the back of the queue,
+///         which keeps thieves away from the tasks the owner is about to
+///         run.
+/// \param  task Receives the index of the task.
+/// \return false if the queue was empty.
+bool ThreadPool::takeTask(size_t queue, bool steal, size_t& task)
+{
+    TaskQueue& q = queues_[queue];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.begin == q.end)
+        return false;
+
+    task = steal ? --q.end : q.begin++;
+    return true;
+}
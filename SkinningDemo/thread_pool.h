@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  thread_pool.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the ThreadPool class.
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A fixed set of worker threads which run batches of independent
+///         tasks in parallel.
+///
+/// \details parallelFor() splits the task indices into one contiguous range
+///         per thread (including the calling thread, which works too), so
+///         that each thread normally works through neighbouring tasks and
+///         only touches its own queue.  When a thread runs out of tasks, it
+///         steals from the far end of another thread's range, so uneven
+///         tasks or preempted threads don't leave the rest waiting.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+
+    void parallelFor(size_t task_count, const std::function<void(size_t)>& task);
+
+    size_t getThreadCount() const;
+
+private:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The range of task indices which haven't been started yet for
+    ///         one thread.  The owner takes tasks from the front, and thieves
+    ///         take them from the back.
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        size_t begin;
+        size_t end;
+        char padding[64];   ///< Keeps each queue's lock on its own cache line.
+    };
+
+    ThreadPool(const ThreadPool&);              // non-copyable
+    ThreadPool& operator=(const ThreadPool&);   // non-copyable
+
+    void workerMain(size_t queue);
+    void runTasks(size_t queue);
+    bool takeTask(size_t queue, bool steal, size_t& task);
+
+    std::vector<std::thread> threads_;
+    TaskQueue* queues_;         ///< One per worker thread, plus one for the calling thread (queue 0).
+    size_t queue_count_;
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable finished_;
+    const std::function<void(size_t)>* task_;
+    size_t generation_;         ///< Incremented each time a new batch is started.
+    size_t busy_workers_;       ///< The number of worker threads still working on the current batch.
+    bool stopping_;
+};
+
+#endif
@@ -0,0 +1,320 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  trace.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of Tracer, TraceScope and TraceWriter class
+///         functions.
+
+#include "trace.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+namespace {
+
+/// The calling thread's ring, once it has recorded anything.  VS2012 has no
+/// thread_local, and __declspec(thread) only holds plain data, so it's
+/// kept as a void*.
+TRACE_THREAD_LOCAL void* thread_ring = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Writes a string as a JSON string literal.
+void writeJsonString(std::FILE* file, const char* text)
+{
+    std::fputc('"', file);
+    for (const char* c = text; *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            std::fputc('\\', file);
+        if (static_cast<unsigned char>(*c) >= 0x20)
+            std::fputc(*c, file);
+    }
+    std::fputc('"', file);
+}
+
+} // namespace
+
+const size_t Tracer::EVENTS_PER_THREAD;
+Tracer Tracer::instance_;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates an empty ring for a thread.
+Tracer::Ring::Ring(unsigned thread_id)
+    : events(EVENTS_PER_THREAD),
+      written(0),
+      read(0),
+      thread_id(thread_id)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the process's tracer, which isn't recording.
+Tracer::Tracer()
+    : enabled_(false)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Frees every thread's ring.  Every thread which recorded anything
+///         must have finished by now.
+Tracer::~Tracer()
+{
+    for (size_t i = 0; i < rings_.size(); ++i)
+        delete rings_[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the process's tracer.
+Tracer& Tracer::get()
+{
+    return instance_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if scopes are being recorded; that is, if a
+///         TraceWriter is open.
+bool Tracer::isEnabled() const
+{
+    return enabled_.load();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records a finished scope on the calling thread's ring.
+///
+/// \param  name The scope's name; see the class description.
+/// \param  start getTimeMilliseconds() when the scope began.
+/// \param  end getTimeMilliseconds() when it ended.
+void Tracer::record(const char* name, double start, double end)
+{
+    Ring& ring = getThreadRing();
+    size_t index = ring.written.load();
+    Event& event = ring.events[index % EVENTS_PER_THREAD];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    ring.written.store(index + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Names the calling thread in traces, like "GLUT" or "worker 2".
+///         The name is copied.
+void Tracer::setThreadName(const char* name)
+{
+    Ring& ring = getThreadRing();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring.thread_name = name;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the calling thread's ring, creating it the first time.
+Tracer::Ring& Tracer::getThreadRing()
+{
+    if (thread_ring == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Ring* ring = new Ring(unsigned(rings_.size() + 1));
+        rings_.push_back(ring);
+        thread_ring = ring;
+    }
+
+    return *static_cast<Ring*>(thread_ring);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Switches recording on or off.
+void Tracer::setEnabled(bool enabled)
+{
+    enabled_.store(enabled);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Begins a scope, if the tracer is recording.
+///
+/// \param  name The scope's name; see Tracer.
+TraceScope::TraceScope(const char* name)
+    : name_(nullptr),
+      start_(0)
+{
+    if (Tracer::get().isEnabled())
+    {
+        name_ = name;
+        start_ = getTimeMilliseconds();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Ends the scope, unless end() already has.
+TraceScope::~TraceScope()
+{
+    end();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Ends the scope early, and records it if it was begun while
+///         recording.
+void TraceScope::end()
+{
+    if (name_ != nullptr)
+        Tracer::get().record(name_, start_, getTimeMilliseconds());
+    name_ = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Opens a trace file, switches the tracer on, and starts the
+///         thread which streams events into the file.
+///
+/// \param  path The file to write, in the Chrome trace event format; by
+///         convention, something like trace.json.
+/// \param  flush_milliseconds How often new events are appended to the
+///         file.  Each thread's ring must not fill up in less time than
+///         this, or some of its events are lost.
+TraceWriter::TraceWriter(const std::string& path, unsigned flush_milliseconds)
+    : file_(std::fopen(path.c_str(), "w")),
+      flush_milliseconds_(flush_milliseconds),
+      start_(getTimeMilliseconds()),
+      first_event_(true),
+      dropped_(0),
+      stopping_(false)
+{
+    if (file_ == nullptr)
+    {
+        std::cerr << "Failed to open trace file " << path << " for writing!" << std::endl;
+        throw std::runtime_error("Failed to open trace file!");
+    }
+    std::fputs("[\n", file_);
+
+    // anything left from an earlier writer isn't part of this trace.
+    Tracer& tracer = Tracer::get();
+    {
+        std::lock_guard<std::mutex> lock(tracer.mutex_);
+        for (size_t i = 0; i < tracer.rings_.size(); ++i)
+            tracer.rings_[i]->read = tracer.rings_[i]->written.load();
+    }
+
+    tracer.setEnabled(true);
+    thread_ = std::thread(&TraceWriter::threadMain, this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Switches the tracer off, writes the last events, and closes the
+///         file.
+TraceWriter::~TraceWriter()
+{
+    Tracer::get().setEnabled(false);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+
+    flush();
+    std::fputs("\n]\n", file_);
+    std::fclose(file_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of events which were lost because a thread
+///         recorded a whole ring's worth between two flushes.
+size_t TraceWriter::getDroppedCount() const
+{
+    return dropped_.load();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The writer thread's main loop: flushes every flush interval until
+///         the writer is destroyed.
+void TraceWriter::threadMain()
+{
+    TRACE_THREAD("trace writer");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+        wake_.wait_for(lock, std::chrono::milliseconds(flush_milliseconds_));
+        if (stopping_)
+            break;
+
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Takes every thread's new events, and appends them to the file as
+///         complete ("X") events, naming any thread whose name is new.
+///
+/// \details A thread may be recording into the ring while its events are
+///         copied out, so the count is read again afterwards, and any event
+///         it may have overwritten in the meantime is dropped rather than
+///         written torn.
+void TraceWriter::flush()
+{
+    Tracer& tracer = Tracer::get();
+    std::vector<Tracer::Ring*> rings;
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(tracer.mutex_);
+        rings = tracer.rings_;
+        for (size_t i = 0; i < rings.size(); ++i)
+            names.push_back(rings[i]->thread_name);
+    }
+
+    const size_t capacity = Tracer::EVENTS_PER_THREAD;
+    thread_names_.resize(rings.size());
+    for (size_t i = 0; i < rings.size(); ++i)
+    {
+        Tracer::Ring& ring = *rings[i];
+        if (!names[i].empty() && names[i] != thread_names_[i])
+        {
+            std::fprintf(file_, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                         first_event_ ? "" : ",\n", ring.thread_id);
+            writeJsonString(file_, names[i].c_str());
+            std::fputs("}}", file_);
+            thread_names_[i] = names[i];
+            first_event_ = false;
+        }
+
+        size_t written = ring.written.load();
+        size_t first = ring.read;
+        if (written - first > capacity)
+            first = written - capacity;
+
+        scratch_.clear();
+        for (size_t index = first; index < written; ++index)
+            scratch_.push_back(ring.events[index % capacity]);
+
+        // the slot of the event capacity before the one being recorded now
+        // may be half overwritten.
+        size_t still_written = ring.written.load();
+        size_t skip = 0;
+        if (still_written - first >= capacity)
+            skip = std::min(still_written - capacity + 1 - first, scratch_.size());
+
+        dropped_ += (first - ring.read) + skip;
+        ring.read = written;
+
+        for (size_t j = skip; j < scratch_.size(); ++j)
+        {
+            const Tracer::Event& event = scratch_[j];
+            std::fputs(first_event_ ? "{\"name\":" : ",\n{\"name\":", file_);
+            writeJsonString(file_, event.name);
+            std::fprintf(file_, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                         ring.thread_id, (event.start - start_) * 1000.0, (event.end - event.start) * 1000.0);
+            first_event_ = false;
+        }
+    }
+
+    std::fflush(file_);
+}
@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  trace.h
+/// \author Ben Crist
+///
+/// \brief  Class headers for the Tracer, TraceScope and TraceWriter classes,
+///         and the TRACE_SCOPE() and TRACE_THREAD() macros.
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records timed scopes on every thread into a ring per thread, for
+///         a TraceWriter to export.
+///
+/// \details Recording is only switched on while a TraceWriter is open, so an
+///         idle scope costs one atomic load.  Each thread only ever writes
+///         its own ring, and the writer is the only reader, so neither side
+///         locks: a thread publishes each event by bumping its ring's count,
+///         and if it laps the writer, the oldest events are lost rather
+///         than the thread waiting.  Rings outlive their threads, so events
+///         recorded just before a thread exits still get written.
+///
+///         Scope names must be string literals, or otherwise outlive the
+///         tracer, since only the pointer is recorded.  There's one tracer
+///         per process, from get().
+class Tracer
+{
+public:
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  A finished scope, in milliseconds on getTimeMilliseconds()'s
+    ///         clock.
+    struct Event
+    {
+        const char* name;
+        double start;
+        double end;
+    };
+
+    static Tracer& get();
+
+    bool isEnabled() const;
+    void record(const char* name, double start, double end);
+    void setThreadName(const char* name);
+
+    static const size_t EVENTS_PER_THREAD = 16384;
+
+private:
+    friend class TraceWriter;
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  One thread's events.
+    struct Ring
+    {
+        explicit Ring(unsigned thread_id);
+
+        std::vector<Event> events;
+        std::atomic<size_t> written;    ///< The number of events ever recorded; only the thread changes it.
+        size_t read;                    ///< The number of events the writer has taken; only the writer uses it.
+        unsigned thread_id;             ///< The thread's number in the trace, counting from 1.
+        std::string thread_name;        ///< Guarded by the tracer's mutex.
+    };
+
+    Tracer();
+    ~Tracer();
+    Tracer(const Tracer&);              // non-copyable
+    Tracer& operator=(const Tracer&);   // non-copyable
+
+    Ring& getThreadRing();
+    void setEnabled(bool enabled);
+
+    static Tracer instance_;
+
+    std::atomic<bool> enabled_;
+    std::mutex mutex_;                  ///< Guards rings_, and their names.
+    std::vector<Ring*> rings_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Records the time between its construction and destruction, or
+///         end(), as a scope, if the tracer is recording.  Use TRACE_SCOPE(),
+///         or TRACE_BEGIN() and TRACE_END(), rather than creating one
+///         directly.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    void end();
+
+private:
+    TraceScope(const TraceScope&);              // non-copyable
+    TraceScope& operator=(const TraceScope&);   // non-copyable
+
+    const char* name_;  ///< Null if the tracer wasn't recording when the scope began.
+    double start_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Switches the tracer on, and streams everything it records to a
+///         file in the Chrome trace event format, until it's destroyed.
+///
+/// \details The writer's thread takes every thread's new events every
+///         flush interval and appends them to the file, so the file always
+///         holds everything up to the last flush, and a trace of a session
+///         which crashed or is still running can be opened as it is:
+///         chrome://tracing and Perfetto both accept a trace whose event
+///         array was never closed, and Tracy imports the same file with its
+///         import-chrome tool.  Destroying the writer takes the last events,
+///         closes the array and switches the tracer off again.
+///
+///         Only one writer may be open at a time.
+class TraceWriter
+{
+public:
+    explicit TraceWriter(const std::string& path, unsigned flush_milliseconds = 100);
+    ~TraceWriter();
+
+    size_t getDroppedCount() const;
+
+private:
+    TraceWriter(const TraceWriter&);            // non-copyable
+    TraceWriter& operator=(const TraceWriter&); // non-copyable
+
+    void threadMain();
+    void flush();
+
+    std::FILE* file_;
+    unsigned flush_milliseconds_;
+    double start_;                      ///< The timestamp the trace counts from.
+    bool first_event_;                  ///< Nothing has been written to the event array yet.
+    std::vector<std::string> thread_names_; ///< The name each thread was last written with, by thread_id - 1.
+    std::vector<Tracer::Event> scratch_;
+    std::atomic<size_t> dropped_;       ///< Events lost to threads lapping the writer.
+    bool stopping_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread thread_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  TRACE_SCOPE("name") times the rest of the enclosing block.
+///         TRACE_BEGIN(id, "name") to TRACE_END(id) times a span which ends
+///         before its block does, with id any identifier unique in the
+///         block.  TRACE_THREAD("name") names the calling thread in the
+///         trace.
+///
+/// \details They all compile to nothing unless SKINNING_TRACING is defined,
+///         so a build without it has no trace in it at all.
+#ifdef SKINNING_TRACING
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_BEGIN(id, name) TraceScope TRACE_CONCAT(trace_span_, id)(name)
+#define TRACE_END(id) TRACE_CONCAT(trace_span_, id).end()
+#define TRACE_THREAD(name) Tracer::get().setThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_BEGIN(id, name) ((void)0)
+#define TRACE_END(id) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#endif
+
+#endif
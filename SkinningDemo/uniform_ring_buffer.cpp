@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  uniform_ring_buffer.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of UniformRingBuffer class functions.
+
+#include "uniform_ring_buffer.h"
+
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates a new uniform buffer in the current OpenGL context, large
+///         enough to hold region_count copies of a uniform block.
+///
+/// \param  block_size The size of the uniform block in bytes.
+/// \param  region_count The number of copies of the block to cycle through.
+///         This should be at least the number of frames the GPU can be
+///         behind the CPU.
+UniformRingBuffer::UniformRingBuffer(GLsizeiptr block_size, size_t region_count)
+    : buffer_id_(0),
+      block_size_(block_size),
+      region_size_(block_size),
+      current_region_(0),
+      bound_region_(NO_REGION),
+      fences_(region_count, GLsync(0))
+{
+    GLint alignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    region_size_ = (block_size + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &buffer_id_);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+    glBufferData(GL_UNIFORM_BUFFER, region_size_ * region_count, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the uniform buffer and any outstanding fences.
+UniformRingBuffer::~UniformRingBuffer()
+{
+    for (size_t i = 0; i < fences_.size(); ++i)
+    {
+        if (fences_[i] != 0)
+            glDeleteSync(fences_[i]);
+    }
+
+    glDeleteBuffers(1, &buffer_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Maps the current region of the buffer for writing.
+///
+/// \details If the GPU may still be reading the region from the last time it
+///         was used, this waits until it's done.  The previous contents of
+///         the region are discarded, so the whole block must be written.
+///
+/// \return A pointer to block_size writable bytes.
+void* UniformRingBuffer::map()
+{
+    GLsync& region_fence = fences_[current_region_];
+    if (region_fence != 0)
+    {
+        GLenum result = glClientWaitSync(region_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(region_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);    // 1 ms
+
+        glDeleteSync(region_fence);
+        region_fence = 0;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+    void* data = glMapBufferRange(GL_UNIFORM_BUFFER, region_size_ * current_region_, block_size_,
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    if (data == nullptr)
+    {
+        std::cerr << "Failed to map uniform buffer region " << current_region_ << "!" << std::endl;
+        throw std::runtime_error("Failed to map uniform buffer!");
+    }
+
+    return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Unmaps the current region and binds it to a uniform buffer
+///         binding point so that it can be used by the following draw
+///         calls.
+///
+/// \param  binding The uniform buffer binding point to bind the region to.
+void UniformRingBuffer::unmap(GLuint binding)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer_id_, region_size_ * current_region_, block_size_);
+    bound_region_ = current_region_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Marks the end of the draw calls which use the bound region.
+///
+/// \details If the region was written this frame, the next map() moves on
+///         to the next region.  If it wasn't, it was reused from an earlier
+///         frame, so its fence is replaced with one after this frame's
+///         draws, and the next map() still writes the region after it.
+void UniformRingBuffer::fence()
+{
+    if (bound_region_ == NO_REGION)
+        return;
+
+    GLsync& region_fence = fences_[bound_region_];
+    if (region_fence != 0)
+        glDeleteSync(region_fence);
+
+    region_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (bound_region_ == current_region_)
+        current_region_ = (current_region_ + 1) % fences_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the whole buffer, every region included, in
+///         bytes.
+GLsizeiptr UniformRingBuffer::getBufferBytes() const
+{
+    return region_size_ * GLsizeiptr(fences_.size());
+}
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  uniform_ring_buffer.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the UniformRingBuffer class.
+
+#ifndef UNIFORM_RING_BUFFER_H_
+#define UNIFORM_RING_BUFFER_H_
+
+#include "demo.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A uniform buffer object divided into several equally sized
+///         regions, which are written by the CPU in round-robin order.
+///
+/// \details Each frame, map() returns a pointer to the next region, which
+///         is mapped unsynchronized; the driver doesn't have to wait for (or
+///         copy around) data the GPU might still be reading.  Instead, a
+///         fence is placed after the draw calls that read each region, and
+///         map() only waits on that fence when it comes back around to the
+///         region, which with 3 regions is normally long since signaled.
+///
+///         A frame whose block hasn't changed can skip map() and unmap()
+///         entirely and keep drawing with the region that's still bound;
+///         fence() then re-fences that region instead of moving on.
+///
+///         Persistent mapping (ARB_buffer_storage) would save the map and
+///         unmap calls, but it isn't available in the GLEW version used here.
+class UniformRingBuffer
+{
+public:
+    UniformRingBuffer(GLsizeiptr block_size, size_t region_count = 3);
+    ~UniformRingBuffer();
+
+    void* map();
+    void unmap(GLuint binding);
+    void fence();
+
+    GLsizeiptr getBufferBytes() const;
+
+private:
+    static const size_t NO_REGION = size_t(-1);
+
+    UniformRingBuffer(const UniformRingBuffer&);            // non-copyable
+    UniformRingBuffer& operator=(const UniformRingBuffer&); // non-copyable
+
+    GLuint buffer_id_;
+    GLsizeiptr block_size_;
+    GLsizeiptr region_size_;    ///< block_size_ rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+    size_t current_region_;
+    size_t bound_region_;       ///< The region last bound by unmap(), or NO_REGION.
+    std::vector<GLsync> fences_;
+};
+
+#endif
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  validation.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the skinning data checks.
+
+#include "validation.h"
+#include "skeletal_mesh.h"
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+/// How far a vertex's weights may sum from 1; normalizeInfluences() leaves
+/// them much closer than this, so anything further off wasn't normalized.
+const float WEIGHT_SUM_TOLERANCE = 1e-3f;
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that every vertex's weights sum to 1, and that each of its
+///         joint indices is within the palette it will be skinned with.
+///
+/// \details Every index is checked, even those with a weight of 0: the
+///         shader still reads the palette entry of each influence its
+///         partition evaluates, and only then multiplies it by nothing.
+///
+/// \param  vertices The vertices to check.
+/// \param  vertex_count The number of vertices.
+/// \param  palette_size The number of joints in the palette which skins
+///         them.
+/// \param  what Names the vertices in the error, like "mesh LOD 2".
+template <typename VertexType>
+void validateSkinningVertices(const VertexType* vertices, size_t vertex_count, size_t palette_size,
+                              const char* what)
+{
+    for (size_t v = 0; v < vertex_count; ++v)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < MAX_JOINT_INFLUENCES; ++i)
+        {
+            if (vertices[v].joint_indices[i] >= palette_size)
+            {
+                std::cerr << "Invalid skinning data!" << std::endl
+                          << "  Source: " << what << std::endl
+                          << "   Error: Vertex " << v << "'s influence " << i << " is joint "
+                          << vertices[v].joint_indices[i] << ", but the palette only has " << palette_size
+                          << " joints." << std::endl;
+                throw std::runtime_error("A vertex's joint index is out of range of the palette.");
+            }
+            sum += vertices[v].joint_weights[i];
+        }
+
+        if (std::abs(sum - 1.0f) > WEIGHT_SUM_TOLERANCE)
+        {
+            std::cerr << "Invalid skinning data!" << std::endl
+                      << "  Source: " << what << std::endl
+                      << "   Error: Vertex " << v << "'s weights sum to " << sum << ", not 1." << std::endl;
+            throw std::runtime_error("A vertex's joint weights don't sum to 1.");
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that a skeleton's parent table has no cycles, and that
+///         its joints are in the parent-before-child order the hierarchy
+///         is evaluated in.
+///
+/// \details A parent which comes before its child can't be its descendant,
+///         so checking the order also rules out cycles; a table which
+///         isn't ordered would have parents read before they're computed,
+///         whether or not it has a cycle.  Skeleton::addJoint() asserts
+///         this, but a rig file can be loaded into a build without asserts.
+///
+/// \param  skeleton The skeleton to check.
+/// \param  what Names the skeleton in the error, like a rig file's path.
+void validateSkeleton(const Skeleton& skeleton, const char* what)
+{
+    for (size_t joint = 0; joint < skeleton.getJointCount(); ++joint)
+    {
+        int parent = skeleton.getParent(joint);
+        if (parent != Skeleton::NO_PARENT && (parent < 0 || size_t(parent) >= joint))
+        {
+            std::cerr << "Invalid skeleton!" << std::endl
+                      << "  Source: " << what << std::endl
+                      << "   Error: Joint " << joint << "'s parent is joint " << parent
+                      << ", which doesn't come before it." << std::endl;
+            throw std::runtime_error("A skeleton's parent table isn't acyclic and ordered.");
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Checks that a linked program's uniform array has as many elements
+///         as the data which will be uploaded into it.
+///
+/// \details The array is looked up by name, in the default block or a
+///         uniform block without an instance name.  An array the linker
+///         optimized out isn't read, so it can't be read past the end of,
+///         and passes.
+///
+/// \param  program_id The linked program.
+/// \param  name The array's name, without a subscript.
+/// \param  expected_size The number of elements the caller will upload.
+void validateUniformArray(GLuint program_id, const char* name, size_t expected_size)
+{
+    GLuint index = GL_INVALID_INDEX;
+    glGetUniformIndices(program_id, 1, &name, &index);
+    if (index == GL_INVALID_INDEX)
+        return;
+
+    GLint size = 0;
+    glGetActiveUniformsiv(program_id, 1, &index, GL_UNIFORM_SIZE, &size);
+    if (size_t(size) != expected_size)
+    {
+        std::cerr << "Invalid skinning program!" << std::endl
+                  << " Program: " << program_id << std::endl
+                  << "   Error: The shader's " << name << " array has " << size << " elements, but "
+                  << expected_size << " are uploaded into it." << std::endl;
+        throw std::runtime_error("A shader's palette array doesn't match the palette's size.");
+    }
+}
+
+template void validateSkinningVertices(const Vertex*, size_t, size_t, const char*);
+template void validateSkinningVertices(const Vertex3D*, size_t, size_t, const char*);
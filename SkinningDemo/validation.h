@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  validation.h
+/// \author Ben Crist
+///
+/// \brief  Checks of skinning data which a debug build runs and a release
+///         build compiles out.
+
+#ifndef VALIDATION_H_
+#define VALIDATION_H_
+
+#include "demo.h"
+#include "skeleton.h"
+#include <cstddef>
+
+template <typename VertexType>
+void validateSkinningVertices(const VertexType* vertices, size_t vertex_count, size_t palette_size,
+                              const char* what);
+void validateSkeleton(const Skeleton& skeleton, const char* what);
+void validateUniformArray(GLuint program_id, const char* name, size_t expected_size);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  SKINNING_VALIDATE(check) runs check, a call to one of the
+///         validate functions above, which throws if the data it's given
+///         is bad.
+///
+/// \details Nothing on the GPU checks what it's given: a joint index past
+///         the end of the palette reads whatever uniforms or texels come
+///         after it, and weights which don't sum to 1 shrink or swell the
+///         mesh, so bad data just looks like a bad frame, or a slow one.
+///         The checks catch it where it comes in instead, but they aren't
+///         free, so they compile to nothing unless SKINNING_VALIDATION is
+///         defined, as it is in Debug builds; the check's arguments aren't
+///         even evaluated in a release build.
+#ifdef SKINNING_VALIDATION
+#define SKINNING_VALIDATE(check) (check)
+#else
+#define SKINNING_VALIDATE(check) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  vertex_blocks.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of the vertex block functions.
+
+#include "vertex_blocks.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+
+const size_t MAX_CHANNELS = 20;         ///< Must match the compute shader's channels array.
+const size_t MAX_VERTEX_WORDS = 6;      ///< Must match the compute shader's words array.
+const GLuint WORKGROUP_SIZE = 64;       ///< Must match the compute shader's local_size_x.
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  One field of a vertex, in the uvec4 layout the compute shader
+///         reads.
+struct Channel
+{
+    GLuint word;        ///< The 32-bit word of the vertex the field is in.
+    GLuint shift;       ///< The field's lowest bit in the word.
+    GLuint bits;
+    GLuint sign;        ///< The field's sign bit if it's signed, which is flipped to offset it, or 0.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Lists the fields of a quantized vertex, as channels.
+///
+/// \param  position_shorts The number of position shorts: 2 in 2D, or 4
+///         (x, y, z and padding) in 3D.
+/// \param  channels Receives the channels.
+/// \return The size of the vertex, in words.
+size_t getChannels(size_t position_shorts, std::vector<Channel>& channels)
+{
+    channels.clear();
+    for (size_t i = 0; i < position_shorts; ++i)
+    {
+        Channel position = { GLuint(i / 2), GLuint(16 * (i % 2)), 16, 0x8000 };
+        channels.push_back(position);
+    }
+
+    // joint indices, then weights.
+    GLuint word = GLuint(position_shorts / 2);
+    for (GLuint bytes = 0; bytes < 2; ++bytes, ++word)
+    {
+        for (GLuint i = 0; i < 4; ++i)
+        {
+            Channel byte = { word, 8 * i, 8, 0 };
+            channels.push_back(byte);
+        }
+    }
+
+    // the normal, then the tangent, as GL_INT_2_10_10_10_REV.
+    for (GLuint vectors = 0; vectors < 2; ++vectors, ++word)
+    {
+        for (GLuint i = 0; i < 3; ++i)
+        {
+            Channel component = { word, 10 * i, 10, 0x200 };
+            channels.push_back(component);
+        }
+        Channel w = { word, 30, 2, 0x2 };
+        channels.push_back(w);
+    }
+
+    assert(channels.size() <= MAX_CHANNELS && word <= MAX_VERTEX_WORDS);
+    return word;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the channels of a format, and the size of its vertices in
+///         words.
+size_t getFormatChannels(VertexFormat format, std::vector<Channel>& channels)
+{
+    assert(hasVertexBlockLayout(format));
+    return getChannels(format == VERTEX_FORMAT_QUANTIZED_3D ? 4 : 2, channels);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the number of bits needed to store a number.
+GLuint getBitWidth(GLuint value)
+{
+    GLuint bits = 0;
+    while (value >> bits)
+        ++bits;
+    return bits;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Appends bits to a bit-packed stream of words.
+///
+/// \param  value The bits, in its low bits.
+/// \param  bits The number of bits; at most 16.
+/// \param  bit_count The number of bits already in the stream, which starts
+///         in its last word if that isn't full.
+/// \param  words The stream.
+void appendBits(GLuint value, GLuint bits, size_t& bit_count, std::vector<GLuint>& words)
+{
+    if (bits == 0)
+        return;
+
+    size_t shift = bit_count % 32;
+    if (shift == 0)
+        words.push_back(0);
+    words.back() |= value << shift;
+    if (shift + bits > 32)
+        words.push_back(value >> (32 - shift));
+    bit_count += bits;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns true if vertices in a format can be packed into blocks;
+///         only the quantized formats can.
+bool hasVertexBlockLayout(VertexFormat format)
+{
+    return format == VERTEX_FORMAT_QUANTIZED || format == VERTEX_FORMAT_QUANTIZED_3D;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Packs vertices into blocks (see VERTEX_BLOCK_SIZE).
+///
+/// \details No GL context is needed, so this can be called from any
+///         thread.  The blocks are lossless: decodeVertexBlocks() expands
+///         them back into exactly the same bytes.
+///
+/// \param  format The vertices' format, which must have a block layout
+///         (see hasVertexBlockLayout()).
+/// \param  vertex_data The vertices.
+/// \param  vertex_count The number of vertices.
+/// \param  blocks Receives the blocks, in place of anything it held before.
+void encodeVertexBlocks(VertexFormat format, const void* vertex_data, size_t vertex_count,
+                        std::vector<GLuint>& blocks)
+{
+    std::vector<Channel> channels;
+    size_t vertex_words = getFormatChannels(format, channels);
+    const char* vertex_bytes = static_cast<const char*>(vertex_data);
+
+    size_t block_count = (vertex_count + VERTEX_BLOCK_SIZE - 1) / VERTEX_BLOCK_SIZE;
+    blocks.assign(block_count, 0);
+    blocks.reserve(block_count + vertex_count * vertex_words * 2 / 3);
+
+    std::vector<GLuint> values(channels.size() * VERTEX_BLOCK_SIZE);
+    for (size_t block = 0; block < block_count; ++block)
+    {
+        size_t first_vertex = block * VERTEX_BLOCK_SIZE;
+        size_t block_vertices = std::min(VERTEX_BLOCK_SIZE, vertex_count - first_vertex);
+
+        // gather each channel's values, offset if they're signed.
+        for (size_t v = 0; v < block_vertices; ++v)
+        {
+            GLuint words[MAX_VERTEX_WORDS];
+            std::memcpy(words, vertex_bytes + (first_vertex + v) * vertex_words * sizeof(GLuint),
+                        vertex_words * sizeof(GLuint));
+            for (size_t c = 0; c < channels.size(); ++c)
+            {
+                const Channel& channel = channels[c];
+                GLuint field = (words[channel.word] >> channel.shift) & ((1u << channel.bits) - 1);
+                values[c * VERTEX_BLOCK_SIZE + v] = field ^ channel.sign;
+            }
+        }
+
+        blocks[block] = GLuint(blocks.size());
+        size_t header = blocks.size();
+        blocks.resize(header + channels.size());
+
+        size_t bit_count = 0;
+        for (size_t c = 0; c < channels.size(); ++c)
+        {
+            const GLuint* channel_values = &values[c * VERTEX_BLOCK_SIZE];
+            GLuint minimum = *std::min_element(channel_values, channel_values + block_vertices);
+            GLuint maximum = *std::max_element(channel_values, channel_values + block_vertices);
+            GLuint width = getBitWidth(maximum - minimum);
+            blocks[header + c] = minimum | (width << 16);
+
+            for (size_t v = 0; v < block_vertices; ++v)
+                appendBits(channel_values[v] - minimum, width, bit_count, blocks);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Expands blocks packed by encodeVertexBlocks() into a vertex
+///         buffer, with vertex_decode_shader_source.  Needs GL 4.3.
+///
+/// \details The vertices are written by a compute shader, so a barrier is
+///         placed after it for drawing them, or copying them.
+///
+/// \param  compute_program_id The vertex decode compute shader program.
+/// \param  blocks_buffer_id A buffer holding the blocks, from its start.
+/// \param  format The vertices' format.
+/// \param  vertex_count The number of vertices the blocks hold.
+/// \param  vbo_id The buffer to expand them into.
+/// \param  first_vertex Where the first vertex goes in the buffer.
+void decodeVertexBlocks(GLuint compute_program_id, GLuint blocks_buffer_id, VertexFormat format,
+                        size_t vertex_count, GLuint vbo_id, size_t first_vertex)
+{
+    if (vertex_count == 0)
+        return;
+
+    std::vector<Channel> channels;
+    size_t vertex_words = getFormatChannels(format, channels);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, blocks_buffer_id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, vbo_id);
+
+    GLuint work_count = GLuint(vertex_count);
+    glUseProgram(compute_program_id);
+    glUniform1ui(glGetUniformLocation(compute_program_id, "vertex_count"), work_count);
+    glUniform1ui(glGetUniformLocation(compute_program_id, "vertex_words"), GLuint(vertex_words));
+    glUniform1ui(glGetUniformLocation(compute_program_id, "first_word"), GLuint(first_vertex * vertex_words));
+    glUniform1ui(glGetUniformLocation(compute_program_id, "channel_count"), GLuint(channels.size()));
+    glUniform4uiv(glGetUniformLocation(compute_program_id, "channels"), GLsizei(channels.size()), &channels[0].word);
+    glDispatchCompute((work_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+    glUseProgram(0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  vertex_blocks.h
+/// \author Ben Crist
+///
+/// \brief  Functions for packing quantized vertices into compressed blocks
+///         on the CPU, and expanding them into a vertex buffer on the GPU.
+
+#ifndef VERTEX_BLOCKS_H_
+#define VERTEX_BLOCKS_H_
+
+#include "skeletal_mesh.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  The number of vertices packed together in each block.
+///
+/// \details Blocks are made from vertices in VERTEX_FORMAT_QUANTIZED or
+///         VERTEX_FORMAT_QUANTIZED_3D, the only formats whose fields are all
+///         small integers.  Each field of the vertex (every position short,
+///         joint index and weight byte, and normal and tangent component) is
+///         a channel, and each block stores each channel as the minimum of
+///         its values over the block's vertices, then each vertex's
+///         difference from that minimum, in as few bits as the largest
+///         difference needs.  Signed fields are offset so that their
+///         minimum and differences work like unsigned ones.  Neighboring
+///         vertices share joints and lie close together once they've been
+///         reordered for the vertex cache, so most channels need only a few
+///         bits per vertex, and a block is about half the size of its
+///         vertices.
+///
+///         Every vertex can be found without decoding the ones before it,
+///         unlike deltas from one vertex to the next, so the compute shader
+///         expanding them (vertex_decode_shader_source) runs one invocation
+///         per vertex.  The encoded data is a stream of 32-bit words:
+///
+///         - the word offset of each block from the start of the stream
+///         - each block: a word per channel, with its minimum in the low
+///           16 bits and its width in bits above them; then each channel's
+///           differences, one after another, bit-packed from the low bit
+///           of each word up.
+const size_t VERTEX_BLOCK_SIZE = 64;
+
+bool hasVertexBlockLayout(VertexFormat format);
+void encodeVertexBlocks(VertexFormat format, const void* vertex_data, size_t vertex_count,
+                        std::vector<GLuint>& blocks);
+void decodeVertexBlocks(GLuint compute_program_id, GLuint blocks_buffer_id, VertexFormat format,
+                        size_t vertex_count, GLuint vbo_id, size_t first_vertex);
+
+#endif
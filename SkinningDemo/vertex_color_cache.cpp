@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  vertex_color_cache.cpp
+/// \author Ben Crist
+///
+/// \brief  Implementations of VertexColorCache class functions.
+
+#include "vertex_color_cache.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+const GLuint VertexColorCache::VERTEX_COLOR_ATTRIBUTE;
+
+namespace
+{
+
+float getInfluenceWeight(const Vertex& vertex, size_t influence)
+{
+    return vertex.joint_weights[influence];
+}
+
+float getInfluenceWeight(const PackedVertex& vertex, size_t influence)
+{
+    return vertex.joint_weights[influence] / 255.0f;
+}
+
+float getInfluenceWeight(const HalfPackedVertex& vertex, size_t influence)
+{
+    return vertex.joint_weights[influence] / 255.0f;
+}
+
+float getInfluenceWeight(const QuantizedVertex& vertex, size_t influence)
+{
+    return vertex.joint_weights[influence] / 255.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads the joint indices and weights of vertices stored in one of
+///         the vertex formats.
+template <typename VertexType>
+void readInfluences(const std::vector<char>& vertex_data, size_t vertex_count, GLuint* joints, vec4* weights)
+{
+    const VertexType* vertices = reinterpret_cast<const VertexType*>(vertex_data.data());
+    for (size_t i = 0; i < vertex_count; ++i)
+    {
+        for (size_t j = 0; j < MAX_JOINT_INFLUENCES; ++j)
+        {
+            joints[i * MAX_JOINT_INFLUENCES + j] = vertices[i].joint_indices[j];
+            weights[i][j] = getInfluenceWeight(vertices[i], j);
+        }
+    }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Creates the color buffer, with every vertex black until a mesh
+///         is added over it.
+///
+/// \param  vertex_capacity The number of vertices the buffer holds.
+/// \param  packed Whether to upload the colors as normalized bytes rather
+///         than floats.
+VertexColorCache::VertexColorCache(size_t vertex_capacity, bool packed)
+    : vbo_id_(0),
+      influences_(vertex_capacity),
+      colors_(vertex_capacity),
+      packed_(packed),
+      packed_colors_(packed ? vertex_capacity * 4 : 0),
+      valid_(false)
+{
+    for (size_t i = 0; i < influences_.size(); ++i)
+    {
+        std::fill(influences_[i].joints, influences_[i].joints + MAX_JOINT_INFLUENCES, 0);
+        influences_[i].weights = vec4(0);
+    }
+
+    glGenBuffers(1, &vbo_id_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    if (packed_)
+        glBufferData(GL_ARRAY_BUFFER, packed_colors_.size(), packed_colors_.data(), GL_STATIC_DRAW);
+    else
+        glBufferData(GL_ARRAY_BUFFER, colors_.size() * sizeof(color4), colors_.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Destroys the color buffer.
+VertexColorCache::~VertexColorCache()
+{
+    glDeleteBuffers(1, &vbo_id_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Reads a mesh's influences back from its VBO, so that its
+///         vertices' colors can be blended.  The colors are uploaded by the
+///         next update().
+///
+/// \param  mesh The mesh to add; it must already have been uploaded.
+/// \param  first_vertex Where the mesh's first vertex goes in the buffer.
+/// \param  joint_map The full skeleton's index of each joint the mesh's
+///         vertices refer to, if they refer to a reduced skeleton's (see
+///         SkeletonReduction::source_joints); null if they're the same.
+void VertexColorCache::addMesh(const SkeletalMesh& mesh, size_t first_vertex, const std::vector<GLuint>* joint_map)
+{
+    size_t vertex_count = mesh.getVertexCount();
+    if (first_vertex + vertex_count > influences_.size())
+    {
+        std::cerr << "A mesh of " << vertex_count << " vertices at vertex " << first_vertex
+                  << " doesn't fit in a VertexColorCache of " << influences_.size() << "." << std::endl;
+        throw std::runtime_error("The mesh doesn't fit in the VertexColorCache.");
+    }
+
+    std::vector<char> vertex_data(vertex_count * getVertexSize(mesh.vertex_format));
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo_id);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, vertex_data.size(), vertex_data.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::vector<GLuint> joints(vertex_count * MAX_JOINT_INFLUENCES);
+    std::vector<vec4> weights(vertex_count);
+    if (vertex_count > 0)
+    {
+        if (mesh.vertex_format == VERTEX_FORMAT_PACKED)
+            readInfluences<PackedVertex>(vertex_data, vertex_count, joints.data(), weights.data());
+        else if (mesh.vertex_format == VERTEX_FORMAT_PACKED_HALF)
+            readInfluences<HalfPackedVertex>(vertex_data, vertex_count, joints.data(), weights.data());
+        else if (mesh.vertex_format == VERTEX_FORMAT_QUANTIZED)
+            readInfluences<QuantizedVertex>(vertex_data, vertex_count, joints.data(), weights.data());
+        else
+            readInfluences<Vertex>(vertex_data, vertex_count, joints.data(), weights.data());
+    }
+
+    for (size_t i = 0; i < vertex_count; ++i)
+    {
+        Influences& influences = influences_[first_vertex + i];
+        for (size_t j = 0; j < MAX_JOINT_INFLUENCES; ++j)
+        {
+            GLuint joint = joints[i * MAX_JOINT_INFLUENCES + j];
+            influences.joints[j] = joint_map != NULL && joint < joint_map->size() ? (*joint_map)[joint] : joint;
+        }
+        influences.weights = weights[i];
+    }
+
+    valid_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds the colors to a VAO at VERTEX_COLOR_ATTRIBUTE.
+///
+/// \param  vao_id The VAO to add them to.
+/// \param  first_vertex The vertex of the buffer which the VAO's vertex 0
+///         corresponds to.
+void VertexColorCache::attach(GLuint vao_id, size_t first_vertex) const
+{
+    glBindVertexArray(vao_id);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    if (packed_)
+        glVertexAttribPointer(VERTEX_COLOR_ATTRIBUTE, 4, GL_UNSIGNED_BYTE, GL_TRUE, 4,
+                              reinterpret_cast<void*>(first_vertex * 4));
+    else
+        glVertexAttribPointer(VERTEX_COLOR_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(color4),
+                              reinterpret_cast<void*>(first_vertex * sizeof(color4)));
+    glEnableVertexAttribArray(VERTEX_COLOR_ATTRIBUTE);
+
+    // GL_ARRAY_BUFFER is not part of the VAO state, so we need to make sure we unbind the VBO.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Blends and uploads every vertex's color, unless the joint colors
+///         are the same as last time.
+///
+/// \param  joint_colors The color of each joint of the full skeleton.
+/// \param  joint_count The number of joints.
+/// \return true if the colors were uploaded.
+bool VertexColorCache::update(const color4* joint_colors, size_t joint_count)
+{
+    if (valid_ && joint_colors_.size() == joint_count &&
+        std::equal(joint_colors, joint_colors + joint_count, joint_colors_.begin()))
+        return false;
+
+    joint_colors_.assign(joint_colors, joint_colors + joint_count);
+    for (size_t i = 0; i < influences_.size(); ++i)
+    {
+        const Influences& influences = influences_[i];
+        color4 color(0);
+        for (size_t j = 0; j < MAX_JOINT_INFLUENCES; ++j)
+        {
+            if (influences.weights[j] != 0 && influences.joints[j] < joint_count)
+                color += influences.weights[j] * joint_colors[influences.joints[j]];
+        }
+        colors_[i] = color;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id_);
+    if (packed_)
+    {
+        for (size_t i = 0; i < colors_.size(); ++i)
+        {
+            for (int c = 0; c < 4; ++c)
+                packed_colors_[i * 4 + c] = GLubyte(glm::clamp(colors_[i][c], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, packed_colors_.size(), packed_colors_.data());
+    }
+    else
+        glBufferSubData(GL_ARRAY_BUFFER, 0, colors_.size() * sizeof(color4), colors_.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    valid_ = true;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Returns the size of the color buffer in bytes.
+size_t VertexColorCache::getBufferBytes() const
+{
+    return packed_ ? packed_colors_.size() : colors_.size() * sizeof(color4);
+}
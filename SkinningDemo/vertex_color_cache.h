@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \file:  vertex_color_cache.h
+/// \author Ben Crist
+///
+/// \brief  Class header for the VertexColorCache class.
+
+#ifndef VERTEX_COLOR_CACHE_H_
+#define VERTEX_COLOR_CACHE_H_
+
+#include "skeletal_mesh.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  A buffer holding each vertex's blend of its joints' colors, so
+///         the skinning shaders can read a finished color instead of
+///         blending the joint colors for every vertex of every frame.
+///
+/// \details The vertices of any number of meshes are laid out one after
+///         another in the buffer, in the same order as in their own VBOs;
+///         each mesh's range starts wherever addMesh() is told to put it, so
+///         the layout can match a MeshArena's.  The influences are read back
+///         from each mesh's VBO, so meshes uploaded from files work too, but
+///         edits made to a mesh afterwards aren't picked up.
+///
+///         update() only reblends the colors when the joint colors differ
+///         from the last ones it was given, which for most poses is never.
+///
+///         attach() adds the colors to a VAO at VERTEX_COLOR_ATTRIBUTE,
+///         where the skinning shaders compiled with VERTEX_COLORS read them.
+///         A packed cache uploads them as normalized bytes, a quarter of
+///         the size, which the shaders read just the same; it's meant for
+///         colors which are blended once and kept, like a MeshVariant's.
+class VertexColorCache
+{
+public:
+    static const GLuint VERTEX_COLOR_ATTRIBUTE = 4;    ///< The attribute location of the vec4 vertex color.
+
+    explicit VertexColorCache(size_t vertex_capacity, bool packed = false);
+    ~VertexColorCache();
+
+    void addMesh(const SkeletalMesh& mesh, size_t first_vertex, const std::vector<GLuint>* joint_map = NULL);
+    void attach(GLuint vao_id, size_t first_vertex) const;
+
+    bool update(const color4* joint_colors, size_t joint_count);
+
+    size_t getBufferBytes() const;
+
+private:
+    VertexColorCache(const VertexColorCache&);              // non-copyable
+    VertexColorCache& operator=(const VertexColorCache&);   // non-copyable
+
+    ///////////////////////////////////////////////////////////////////////////
+    /// \brief  The joints a vertex blends the colors of, in the full
+    ///         skeleton, and how much of each.
+    struct Influences
+    {
+        GLuint joints[MAX_JOINT_INFLUENCES];
+        vec4 weights;
+    };
+
+    GLuint vbo_id_;
+    std::vector<Influences> influences_;    ///< One per vertex of the buffer; unused vertices have no weight.
+    std::vector<color4> colors_;            ///< The blended color of each vertex, as uploaded unless packed_.
+    bool packed_;
+    std::vector<GLubyte> packed_colors_;    ///< colors_ as normalized bytes, 4 per vertex, as uploaded if packed_.
+    std::vector<color4> joint_colors_;      ///< The joint colors colors_ were blended from.
+    bool valid_;                            ///< colors_ matches influences_ and joint_colors_.
+};
+
+#endif